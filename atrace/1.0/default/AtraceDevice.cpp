@@ -14,9 +14,11 @@
  * limitations under the License.
  */
 
-#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/macros.h>
 #include <android-base/stringprintf.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "AtraceDevice.h"
 
@@ -72,6 +74,34 @@ AtraceDevice::AtraceDevice() {
                                                               "/sys/kernel/tracing or "
                                                               "/sys/kernel/debug/tracing";
     }
+
+    // Open the enable files once, so toggling categories doesn't go through path lookups.
+    for (auto& c : kTracingMap) {
+        auto& events = tracing_events_[c.first];
+        for (auto& p : c.second.paths) {
+            std::string tracefs_event_enable_path = android::base::StringPrintf(
+                    "%s%s/enable", tracefs_event_root_.c_str(), p.first.c_str());
+            android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+                    open(tracefs_event_enable_path.c_str(), O_WRONLY | O_CLOEXEC)));
+            events.push_back({tracefs_event_enable_path, p.second, std::move(fd), std::nullopt});
+        }
+    }
+}
+
+bool AtraceDevice::setEventEnabled(TracingEvent* event, bool enable) {
+    if (event->enabled == enable) {
+        return true;
+    }
+    // The event may show up later, e.g. once its kernel module is loaded.
+    if (event->fd == -1) {
+        event->fd.reset(TEMP_FAILURE_RETRY(open(event->enable_path.c_str(), O_WRONLY | O_CLOEXEC)));
+    }
+    if (event->fd == -1 || TEMP_FAILURE_RETRY(pwrite(event->fd, enable ? "1" : "0", 1, 0)) != 1) {
+        event->enabled.reset();
+        return false;
+    }
+    event->enabled = enable;
+    return true;
 }
 
 Return<::android::hardware::atrace::V1_0::Status> AtraceDevice::enableCategories(
@@ -80,37 +110,39 @@ Return<::android::hardware::atrace::V1_0::Status> AtraceDevice::enableCategories
         return Status::ERROR_INVALID_ARGUMENT;
     }
 
+    std::lock_guard<std::mutex> lock(lock_);
     for (auto& c : categories) {
-        if (kTracingMap.count(c)) {
-            for (auto& p : kTracingMap.at(c).paths) {
-                std::string tracefs_event_enable_path = android::base::StringPrintf(
-                        "%s%s/enable", tracefs_event_root_.c_str(), p.first.c_str());
-                if (!android::base::WriteStringToFile("1", tracefs_event_enable_path)) {
-                    LOG(ERROR) << "Failed to enable tracing on: " << tracefs_event_enable_path;
-                    if (p.second) {
-                        // disable before return
-                        disableAllCategories();
-                        return Status::ERROR_TRACING_POINT;
-                    }
+        auto it = tracing_events_.find(c);
+        if (it == tracing_events_.end()) {
+            return Status::ERROR_INVALID_ARGUMENT;
+        }
+        for (auto& e : it->second) {
+            if (!setEventEnabled(&e, true)) {
+                LOG(ERROR) << "Failed to enable tracing on: " << e.enable_path;
+                if (e.required) {
+                    // disable before return
+                    disableAllCategoriesLocked();
+                    return Status::ERROR_TRACING_POINT;
                 }
             }
-        } else {
-            return Status::ERROR_INVALID_ARGUMENT;
         }
     }
     return Status::SUCCESS;
 }
 
 Return<::android::hardware::atrace::V1_0::Status> AtraceDevice::disableAllCategories() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return disableAllCategoriesLocked();
+}
+
+Status AtraceDevice::disableAllCategoriesLocked() {
     auto ret = Status::SUCCESS;
 
-    for (auto& c : kTracingMap) {
-        for (auto& p : c.second.paths) {
-            std::string tracefs_event_enable_path = android::base::StringPrintf(
-                    "%s%s/enable", tracefs_event_root_.c_str(), p.first.c_str());
-            if (!android::base::WriteStringToFile("0", tracefs_event_enable_path)) {
-                LOG(ERROR) << "Failed to disable tracing on: " << tracefs_event_enable_path;
-                if (p.second) {
+    for (auto& c : tracing_events_) {
+        for (auto& e : c.second) {
+            if (!setEventEnabled(&e, false)) {
+                LOG(ERROR) << "Failed to disable tracing on: " << e.enable_path;
+                if (e.required) {
                     ret = Status::ERROR_TRACING_POINT;
                 }
             }
@@ -17,10 +17,17 @@
 #ifndef ANDROID_HARDWARE_ATRACE_V1_0_ATRACEDEVICE_H
 #define ANDROID_HARDWARE_ATRACE_V1_0_ATRACEDEVICE_H
 
+#include <android-base/unique_fd.h>
 #include <android/hardware/atrace/1.0/IAtraceDevice.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace atrace {
@@ -44,7 +51,22 @@ struct AtraceDevice : public IAtraceDevice {
     Return<::android::hardware::atrace::V1_0::Status> disableAllCategories() override;
 
   private:
+    // A tracefs event of a category, with its enable file kept open across toggles.
+    struct TracingEvent {
+        std::string enable_path;
+        // if error on failure
+        bool required;
+        android::base::unique_fd fd;
+        // Last state written, unset until the first successful write or after a failure.
+        std::optional<bool> enabled;
+    };
+
+    bool setEventEnabled(TracingEvent* event, bool enable);
+    ::android::hardware::atrace::V1_0::Status disableAllCategoriesLocked();
+
     std::string tracefs_event_root_;
+    std::mutex lock_;
+    std::map<std::string, std::vector<TracingEvent>> tracing_events_;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
 };
@@ -17,10 +17,90 @@
 #include <pthread.h>
 #include <sched.h>
 #include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 
 #include "include/StreamWorker.h"
 
-namespace android::hardware::audio::common::internal {
+namespace android::hardware::audio::common {
+
+namespace {
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+#if defined(__linux__)
+// The argument of sched_setattr(2), which has no libc wrapper.
+struct SchedAttr {
+    uint32_t size;
+    uint32_t schedPolicy;
+    uint64_t schedFlags;
+    int32_t schedNice;
+    uint32_t schedPriority;
+    uint64_t schedRuntime;
+    uint64_t schedDeadline;
+    uint64_t schedPeriod;
+};
+constexpr uint32_t kSchedDeadline = 6;
+constexpr uint64_t kSchedFlagResetOnFork = 0x01;
+#endif
+
+}  // namespace
+
+void WorkerCycleStats::record(int64_t cycleTimeNs) {
+    const int64_t cycleTimeUs = std::max(cycleTimeNs, static_cast<int64_t>(0)) / 1'000;
+    const size_t bucket = std::lower_bound(kBucketUpperBoundsUs.begin(),
+                                           kBucketUpperBoundsUs.end(), cycleTimeUs) -
+                          kBucketUpperBoundsUs.begin();
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    mCycleCount.fetch_add(1, std::memory_order_relaxed);
+    if (const int64_t limitNs = mOverrunLimitNs.load(std::memory_order_relaxed);
+        limitNs > 0 && cycleTimeNs > limitNs) {
+        mOverrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    // There is only one writer, so there is no need to compare and exchange.
+    if (cycleTimeNs > mMaxCycleTimeNs.load(std::memory_order_relaxed)) {
+        mMaxCycleTimeNs.store(cycleTimeNs, std::memory_order_relaxed);
+    }
+}
+
+std::string WorkerCycleStats::dump() const {
+    std::string result;
+    result.append("cycles: ")
+            .append(std::to_string(getCycleCount()))
+            .append(", overruns: ")
+            .append(std::to_string(getOverrunCount()))
+            .append(", max: ")
+            .append(std::to_string(getMaxCycleTimeNs() / 1'000))
+            .append(" us");
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        result.append(", <=")
+                .append(std::to_string(kBucketUpperBoundsUs[i]))
+                .append("us: ")
+                .append(std::to_string(getBucketCount(i)));
+    }
+    result.append(", >")
+            .append(std::to_string(kBucketUpperBoundsUs.back()))
+            .append("us: ")
+            .append(std::to_string(getBucketCount(kBucketCount)));
+    return result;
+}
+
+void StreamLogic::onCycleWorkStarted() {
+    mCycleStartNs = nowNs();
+}
+
+namespace internal {
 
 bool ThreadController::start(const std::string& name, int priority) {
     mThreadName = name;
@@ -99,6 +179,11 @@ void ThreadController::workerThread() {
             error.append("Failed to set thread priority: ").append(strerror(errCode));
         }
     }
+    if (error.empty()) {
+        std::string schedulingError = applySchedulingPolicy();
+        std::lock_guard<std::mutex> lock(mWorkerLock);
+        mSchedulingError = std::move(schedulingError);
+    }
     if (error.empty()) {
         error.append(mLogic->init());
     }
@@ -113,9 +198,15 @@ void ThreadController::workerThread() {
     mWorkerCv.notify_one();
     if (!error.empty()) return;
 
+    auto timedCycle = [this]() {
+        mLogic->mCycleStartNs = nowNs();
+        Status status = mLogic->cycle();
+        mCycleStats.record(nowNs() - mLogic->mCycleStartNs);
+        return status;
+    };
     for (WorkerState state = WorkerState::RUNNING; state != WorkerState::STOPPED;) {
         bool needToNotify = false;
-        if (Status status = state != WorkerState::PAUSED ? mLogic->cycle()
+        if (Status status = state != WorkerState::PAUSED ? timedCycle()
                                                          : (sched_yield(), Status::CONTINUE);
             status == Status::CONTINUE) {
             {
@@ -172,4 +263,56 @@ void ThreadController::workerThread() {
     }
 }
 
-}  // namespace android::hardware::audio::common::internal
+std::string ThreadController::applySchedulingPolicy() {
+    using Policy = WorkerSchedulingPolicy::Policy;
+
+    std::string error;
+    auto appendError = [&error](const char* message, int errCode) {
+        if (!error.empty()) error.append("; ");
+        error.append(message).append(strerror(errCode));
+    };
+#if defined(__linux__)
+    if (!mSchedulingPolicy.cpus.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : mSchedulingPolicy.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpuSet);
+        }
+        if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+            appendError("Failed to set CPU affinity: ", errno);
+        }
+    }
+    if (mSchedulingPolicy.policy == Policy::FIFO) {
+        struct sched_param param = {};
+        param.sched_priority = mSchedulingPolicy.fifoPriority;
+        if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+            appendError("Failed to set FIFO scheduler: ", errno);
+        }
+    } else if (mSchedulingPolicy.policy == Policy::DEADLINE) {
+        const int64_t periodNs = mSchedulingPolicy.periodNs;
+        const int64_t runtimeNs =
+                mSchedulingPolicy.runtimeNs > 0 ? mSchedulingPolicy.runtimeNs : periodNs / 2;
+        SchedAttr attr = {};
+        attr.size = sizeof(attr);
+        attr.schedPolicy = kSchedDeadline;
+        attr.schedFlags = kSchedFlagResetOnFork;
+        attr.schedRuntime = runtimeNs;
+        attr.schedDeadline = periodNs;
+        attr.schedPeriod = periodNs;
+        if (periodNs <= 0 || runtimeNs > periodNs) {
+            appendError("Failed to set deadline scheduler: ", EINVAL);
+        } else if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0) {
+            appendError("Failed to set deadline scheduler: ", errno);
+        }
+    }
+#else
+    if (mSchedulingPolicy.policy != Policy::DEFAULT || !mSchedulingPolicy.cpus.empty()) {
+        appendError("Failed to set scheduling policy: ", ENOTSUP);
+    }
+#endif
+    return error;
+}
+
+}  // namespace internal
+
+}  // namespace android::hardware::audio::common
@@ -18,11 +18,14 @@
 
 #include <sys/types.h>
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/thread_annotations.h>
 #include <system/thread_defs.h>
@@ -31,6 +34,53 @@ namespace android::hardware::audio::common {
 
 class StreamLogic;
 
+// Scheduling of the worker thread. It is applied by the worker thread itself before calling
+// 'StreamLogic::init'. Failing to apply it is not an error, because the host process might be
+// lacking the capability to request a real-time scheduler. The failure is reported by
+// 'getSchedulingError' instead.
+struct WorkerSchedulingPolicy {
+    enum class Policy { DEFAULT, FIFO, DEADLINE };
+
+    Policy policy = Policy::DEFAULT;
+    // The priority within SCHED_FIFO.
+    int fifoPriority = 1;
+    // The expected duration of one cycle. It is the period of SCHED_DEADLINE, and the limit used
+    // for counting cycle overruns. Zero disables overrun counting.
+    int64_t periodNs = 0;
+    // The runtime of SCHED_DEADLINE, uses half of the period if zero.
+    int64_t runtimeNs = 0;
+    // The CPUs the worker is pinned to, no pinning if empty. Note that the kernel does not
+    // allow a SCHED_DEADLINE thread to be pinned to a subset of CPUs.
+    std::vector<int> cpus;
+};
+
+// Cycle time statistics of a worker. Only the worker thread records, while any thread can read.
+class WorkerCycleStats {
+  public:
+    // Each bucket counts the cycles not longer than its upper bound and longer than the previous
+    // upper bound. An extra bucket counts the cycles longer than the last upper bound.
+    static constexpr size_t kBucketCount = 10;
+    static constexpr std::array<int64_t, kBucketCount> kBucketUpperBoundsUs = {
+            100, 200, 500, 1'000, 2'000, 5'000, 10'000, 20'000, 50'000, 100'000};
+
+    void setOverrunLimitNs(int64_t limitNs) { mOverrunLimitNs = limitNs; }
+    void record(int64_t cycleTimeNs);
+    uint64_t getCycleCount() const { return mCycleCount.load(std::memory_order_relaxed); }
+    uint64_t getOverrunCount() const { return mOverrunCount.load(std::memory_order_relaxed); }
+    int64_t getMaxCycleTimeNs() const { return mMaxCycleTimeNs.load(std::memory_order_relaxed); }
+    uint64_t getBucketCount(size_t bucket) const {
+        return mBuckets[bucket].load(std::memory_order_relaxed);
+    }
+    std::string dump() const;
+
+  private:
+    std::atomic<int64_t> mOverrunLimitNs = 0;
+    std::atomic<uint64_t> mCycleCount = 0;
+    std::atomic<uint64_t> mOverrunCount = 0;
+    std::atomic<int64_t> mMaxCycleTimeNs = 0;
+    std::array<std::atomic<uint64_t>, kBucketCount + 1> mBuckets = {};
+};
+
 namespace internal {
 
 class ThreadController {
@@ -41,6 +91,11 @@ class ThreadController {
     ~ThreadController() { stop(); }
 
     bool start(const std::string& name, int priority);
+    // Must be called before 'start'.
+    void setSchedulingPolicy(const WorkerSchedulingPolicy& policy) {
+        mSchedulingPolicy = policy;
+        mCycleStats.setOverrunLimitNs(policy.periodNs);
+    }
     // Note: 'pause' and 'resume' methods should only be used on the "driving" side.
     // In the case of audio HAL I/O, the driving side is the client, because the HAL
     // implementation always blocks on getting a command.
@@ -58,6 +113,11 @@ class ThreadController {
         std::lock_guard<std::mutex> lock(mWorkerLock);
         return mTid;
     }
+    std::string getSchedulingError() {
+        std::lock_guard<std::mutex> lock(mWorkerLock);
+        return mSchedulingError;
+    }
+    const WorkerCycleStats& getCycleStats() const { return mCycleStats; }
     void stop();
     // Direct use of 'join' assumes that the StreamLogic is not intended
     // to run forever, and is guaranteed to exit by itself. This normally
@@ -75,16 +135,20 @@ class ThreadController {
     void switchWorkerStateSync(WorkerState oldState, WorkerState newState,
                                WorkerState* finalState = nullptr);
     void workerThread();
+    std::string applySchedulingPolicy();
 
     StreamLogic* const mLogic;
     std::string mThreadName;
     int mThreadPriority = ANDROID_PRIORITY_DEFAULT;
+    WorkerSchedulingPolicy mSchedulingPolicy;
+    WorkerCycleStats mCycleStats;
     std::thread mWorker;
     std::mutex mWorkerLock;
     std::condition_variable mWorkerCv;
     WorkerState mWorkerState GUARDED_BY(mWorkerLock) = WorkerState::INITIAL;
     std::string mError GUARDED_BY(mWorkerLock);
     pid_t mTid GUARDED_BY(mWorkerLock) = -1;
+    std::string mSchedulingError GUARDED_BY(mWorkerLock);
     // The atomic lock-free variable is used to prevent priority inversions
     // that can occur when a high priority worker tries to acquire the lock
     // which has been taken by a lower priority control thread which in its turn
@@ -127,6 +191,15 @@ class StreamLogic {
      * of stopping the worker by its own initiative.
      */
     virtual Status cycle() = 0;
+
+    /* May be called from 'cycle' when it has finished waiting, e.g. for a command,
+     * and starts its actual work. The time spent in the cycle before this call
+     * is not counted in the cycle time statistics.
+     */
+    void onCycleWorkStarted();
+
+  private:
+    int64_t mCycleStartNs = 0;
 };
 
 template <class LogicImpl>
@@ -141,8 +214,7 @@ class StreamWorker : public LogicImpl {
     // Note that 'priority' here is what is known as the 'nice number' in *nix systems.
     // The nice number is used with the default scheduler. For threads that
     // need to use a specialized scheduler (e.g. SCHED_FIFO) and set the priority within it,
-    // it is recommended to implement an appropriate configuration sequence within
-    // 'LogicImpl' or 'StreamLogic::init'.
+    // it is recommended to call 'setSchedulingPolicy' prior to calling 'start'.
     bool start(const std::string& name = "", int priority = ANDROID_PRIORITY_DEFAULT) {
         return mThread.start(name, priority);
     }
@@ -151,6 +223,11 @@ class StreamWorker : public LogicImpl {
     bool hasError() { return mThread.hasError(); }
     std::string getError() { return mThread.getError(); }
     pid_t getTid() { return mThread.getTid(); }
+    void setSchedulingPolicy(const WorkerSchedulingPolicy& policy) {
+        mThread.setSchedulingPolicy(policy);
+    }
+    std::string getSchedulingError() { return mThread.getSchedulingError(); }
+    const WorkerCycleStats& getCycleStats() const { return mThread.getCycleStats(); }
     void stop() { mThread.stop(); }
     void join() { mThread.join(); }
     bool waitForAtLeastOneCycle() { return mThread.waitForAtLeastOneCycle(); }
@@ -291,6 +291,27 @@ TEST_P(StreamWorkerTest, ThreadPriority) {
     EXPECT_EQ(priority, worker.getPriority());
 }
 
+TEST_P(StreamWorkerTest, CycleStats) {
+    ASSERT_TRUE(worker.start()) << worker.getError();
+    EXPECT_TRUE(worker.waitForAtLeastOneCycle());
+    EXPECT_GT(worker.getCycleStats().getCycleCount(), 0u);
+    EXPECT_EQ(0u, worker.getCycleStats().getOverrunCount());
+}
+
+TEST_P(StreamWorkerTest, CpuAffinity) {
+    android::hardware::audio::common::WorkerSchedulingPolicy policy;
+    policy.cpus = {0};
+    worker.setSchedulingPolicy(policy);
+    ASSERT_TRUE(worker.start()) << worker.getError();
+    EXPECT_TRUE(worker.waitForAtLeastOneCycle());
+    EXPECT_EQ("", worker.getSchedulingError());
+    cpu_set_t cpuSet;
+    ASSERT_EQ(0, pthread_getaffinity_np(worker.testGetThreadNativeHandle(), sizeof(cpuSet),
+                                        &cpuSet));
+    EXPECT_EQ(1, CPU_COUNT(&cpuSet));
+    EXPECT_TRUE(CPU_ISSET(0, &cpuSet));
+}
+
 TEST_P(StreamWorkerTest, DeferredStartCheckNoError) {
     stream.setStopStatus();
     EXPECT_TRUE(worker.start(android::hardware::audio::common::internal::kTestSingleThread));
@@ -304,3 +325,22 @@ TEST_P(StreamWorkerTest, DeferredStartCheckWithError) {
 }
 
 INSTANTIATE_TEST_SUITE_P(StreamWorker, StreamWorkerTest, testing::Bool());
+
+TEST(WorkerCycleStatsTest, RecordAndDump) {
+    android::hardware::audio::common::WorkerCycleStats stats;
+    stats.setOverrunLimitNs(1'000'000);
+    stats.record(50'000);
+    stats.record(900'000);
+    stats.record(3'000'000);
+    EXPECT_EQ(3u, stats.getCycleCount());
+    EXPECT_EQ(1u, stats.getOverrunCount());
+    EXPECT_EQ(3'000'000, stats.getMaxCycleTimeNs());
+    EXPECT_EQ(1u, stats.getBucketCount(0));
+    EXPECT_EQ(1u, stats.getBucketCount(3));
+    EXPECT_EQ(1u, stats.getBucketCount(5));
+    EXPECT_EQ(
+            "cycles: 3, overruns: 1, max: 3000 us, <=100us: 1, <=200us: 0, <=500us: 0, "
+            "<=1000us: 1, <=2000us: 0, <=5000us: 1, <=10000us: 0, <=20000us: 0, <=50000us: 0, "
+            "<=100000us: 0, >100000us: 0",
+            stats.dump());
+}
@@ -14,54 +14,172 @@
  * limitations under the License.
  */
 
+#include <map>
+#include <vector>
+
 #define LOG_TAG "AHAL_Config"
 #include <android-base/logging.h>
+#include <android/binder_parcel_utils.h>
 
 #include <system/audio_config.h>
 
 #include "core-impl/AudioPolicyConfigXmlConverter.h"
 #include "core-impl/Config.h"
+#include "core-impl/ConfigCache.h"
 #include "core-impl/EngineConfigXmlConverter.h"
 
 using aidl::android::media::audio::common::AudioHalEngineConfig;
+using aidl::android::media::audio::common::AudioProfile;
 
 namespace aidl::android::hardware::audio::core {
-ndk::ScopedAStatus Config::getSurroundSoundConfig(SurroundSoundConfig* _aidl_return) {
+
+namespace internal {
+
+namespace {
+
+// Must be incremented on any change to the conversion code or to the serialization below.
+constexpr uint32_t kConfigCacheFormatVersion = 1;
+
+#define RETURN_IF_BINDER_ERROR(expr)                                   \
+    do {                                                               \
+        if (binder_status_t _status = (expr); _status != STATUS_OK) {  \
+            return _status;                                            \
+        }                                                              \
+    } while (false)
+
+binder_status_t writeModuleConfig(AParcel* parcel, const Module::Configuration& config) {
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, config.ports));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, config.portConfigs));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, config.initialConfigs));
+    RETURN_IF_BINDER_ERROR(
+            AParcel_writeInt32(parcel, static_cast<int32_t>(config.connectedProfiles.size())));
+    for (const auto& [portId, profiles] : config.connectedProfiles) {
+        RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, portId));
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, profiles));
+    }
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, config.routes));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeVector(parcel, config.patches));
+    RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, config.nextPortId));
+    return AParcel_writeInt32(parcel, config.nextPatchId);
+}
+
+binder_status_t readModuleConfig(const AParcel* parcel, Module::Configuration* config) {
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &config->ports));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &config->portConfigs));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &config->initialConfigs));
+    int32_t count = 0;
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    if (count < 0) return STATUS_BAD_VALUE;
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t portId = 0;
+        std::vector<AudioProfile> profiles;
+        RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &portId));
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &profiles));
+        config->connectedProfiles.emplace(portId, std::move(profiles));
+    }
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &config->routes));
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readVector(parcel, &config->patches));
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &config->nextPortId));
+    return AParcel_readInt32(parcel, &config->nextPatchId);
+}
+
+binder_status_t writeAudioHalConfigs(AParcel* parcel, const AudioHalConfigs& configs) {
+    const auto& moduleConfigs = *configs.moduleConfigs;
+    RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, static_cast<int32_t>(moduleConfigs.size())));
+    for (const auto& [name, config] : moduleConfigs) {
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeString(parcel, name));
+        // The configuration of the 'r_submix' module is not provided by the converter.
+        RETURN_IF_BINDER_ERROR(AParcel_writeBool(parcel, config != nullptr));
+        if (config != nullptr) RETURN_IF_BINDER_ERROR(writeModuleConfig(parcel, *config));
+    }
+    RETURN_IF_BINDER_ERROR(configs.surroundSoundConfig.writeToParcel(parcel));
+    return configs.engineConfig.writeToParcel(parcel);
+}
+
+binder_status_t readAudioHalConfigs(const AParcel* parcel, AudioHalConfigs* configs) {
+    int32_t count = 0;
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    if (count < 0) return STATUS_BAD_VALUE;
+    auto moduleConfigs = std::make_unique<AudioPolicyConfigXmlConverter::ModuleConfigs>();
+    for (int32_t i = 0; i < count; ++i) {
+        std::string name;
+        bool hasConfig = false;
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_readString(parcel, &name));
+        RETURN_IF_BINDER_ERROR(AParcel_readBool(parcel, &hasConfig));
+        std::unique_ptr<Module::Configuration> config;
+        if (hasConfig) {
+            config = std::make_unique<Module::Configuration>();
+            RETURN_IF_BINDER_ERROR(readModuleConfig(parcel, config.get()));
+        }
+        moduleConfigs->emplace_back(std::move(name), std::move(config));
+    }
+    RETURN_IF_BINDER_ERROR(configs->surroundSoundConfig.readFromParcel(parcel));
+    RETURN_IF_BINDER_ERROR(configs->engineConfig.readFromParcel(parcel));
+    configs->moduleConfigs = std::move(moduleConfigs);
+    return STATUS_OK;
+}
+
+#undef RETURN_IF_BINDER_ERROR
+
+AudioHalConfigs parseAudioHalConfigs(const std::string& apConfigFile,
+                                     const std::string& engConfigFile) {
     static const auto& func = __func__;
-    static const SurroundSoundConfig surroundSoundConfig = [this]() {
-        SurroundSoundConfig surroundCfg = mAudioPolicyConverter.getSurroundSoundConfig();
-        if (mAudioPolicyConverter.getStatus() != ::android::OK) {
-            LOG(WARNING) << func << ": " << mAudioPolicyConverter.getError();
+    AudioHalConfigs result;
+    AudioPolicyConfigXmlConverter apConverter{apConfigFile};
+    result.surroundSoundConfig = apConverter.getSurroundSoundConfig();
+    if (apConverter.getStatus() != ::android::OK) {
+        LOG(WARNING) << func << ": " << apConverter.getError();
+    }
+    EngineConfigXmlConverter engConverter{engConfigFile};
+    if (engConverter.getStatus() == ::android::OK) {
+        result.engineConfig = engConverter.getAidlEngineConfig();
+    } else {
+        LOG(INFO) << func << ": " << engConverter.getError();
+        if (apConverter.getStatus() == ::android::OK) {
+            result.engineConfig = apConverter.getAidlEngineConfig();
+        } else {
+            LOG(WARNING) << func << ": " << apConverter.getError();
         }
-        return surroundCfg;
-    }();
-    *_aidl_return = surroundSoundConfig;
+    }
+    result.moduleConfigs = apConverter.releaseModuleConfigs();
+    return result;
+}
+
+}  // namespace
+
+AudioHalConfigs loadAudioHalConfigs() {
+    const std::string apConfigFile = ::android::audio_get_audio_policy_config_file();
+    const std::string engConfigFile =
+            ::android::audio_find_readable_configuration_file(kEngineConfigFileName.c_str());
+    std::vector<std::string> sourceFiles{apConfigFile};
+    // The engine configuration file is optional.
+    if (!engConfigFile.empty()) sourceFiles.push_back(engConfigFile);
+    ConfigCache cache(kConfigCacheDir, "audio_hal_config", kConfigCacheFormatVersion, sourceFiles);
+    AudioHalConfigs result;
+    if (cache.load([&](const AParcel* parcel) { return readAudioHalConfigs(parcel, &result); })) {
+        LOG(INFO) << __func__ << ": using the cached configuration from " << cache.getPath();
+        return result;
+    }
+    result = parseAudioHalConfigs(apConfigFile, engConfigFile);
+    cache.store([&](AParcel* parcel) { return writeAudioHalConfigs(parcel, result); });
+    return result;
+}
+
+}  // namespace internal
+
+ndk::ScopedAStatus Config::getSurroundSoundConfig(SurroundSoundConfig* _aidl_return) {
+    *_aidl_return = mSurroundSoundConfig;
     LOG(DEBUG) << __func__ << ": returning " << _aidl_return->toString();
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Config::getEngineConfig(AudioHalEngineConfig* _aidl_return) {
-    static const auto& func = __func__;
-    static const AudioHalEngineConfig returnEngCfg = [this]() {
-        AudioHalEngineConfig engConfig;
-        if (mEngConfigConverter.getStatus() == ::android::OK) {
-            engConfig = mEngConfigConverter.getAidlEngineConfig();
-        } else {
-            LOG(INFO) << func << ": " << mEngConfigConverter.getError();
-            if (mAudioPolicyConverter.getStatus() == ::android::OK) {
-                engConfig = mAudioPolicyConverter.getAidlEngineConfig();
-            } else {
-                LOG(WARNING) << func << ": " << mAudioPolicyConverter.getError();
-            }
-        }
-        // Logging full contents of the config is an overkill, just provide statistics.
-        LOG(DEBUG) << func
-                   << ": number of strategies parsed: " << engConfig.productStrategies.size()
-                   << ", default strategy: " << engConfig.defaultProductStrategyId
-                   << ", number of volume groups parsed: " << engConfig.volumeGroups.size();
-        return engConfig;
-    }();
-    *_aidl_return = returnEngCfg;
+    *_aidl_return = mEngineConfig;
+    // Logging full contents of the config is an overkill, just provide statistics.
+    LOG(DEBUG) << __func__
+               << ": number of strategies: " << _aidl_return->productStrategies.size()
+               << ", default strategy: " << _aidl_return->defaultProductStrategyId
+               << ", number of volume groups: " << _aidl_return->volumeGroups.size();
     return ndk::ScopedAStatus::ok();
 }
 }  // namespace aidl::android::hardware::audio::core
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <deque>
+#include <set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_TAG "AHAL_ConfigCache"
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/scopeguard.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_auto_utils.h>
+
+#include "core-impl/ConfigCache.h"
+
+using android::base::unique_fd;
+
+namespace aidl::android::hardware::audio::core::internal {
+
+namespace {
+
+constexpr uint32_t kCacheMagic = 0x43434841;  // "AHCC"
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint64_t key;
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+std::string getDirName(const std::string& filePath) {
+    const size_t pos = filePath.rfind('/');
+    return pos != std::string::npos ? filePath.substr(0, pos + 1) : "";
+}
+
+}  // namespace
+
+ConfigCache::ConfigCache(const std::string& cacheDir, const std::string& name,
+                         uint32_t formatVersion, const std::vector<std::string>& sourceFiles)
+    : mCacheDir(cacheDir),
+      mPath(cacheDir + name + ".cache"),
+      mFormatVersion(formatVersion),
+      mKey(calculateKey(sourceFiles)) {}
+
+// static
+uint64_t ConfigCache::hash(const void* data, size_t size, uint64_t seed) {
+    // FNV-1a, unlike std::hash the result is stable across builds.
+    uint64_t result = seed;
+    for (const uint8_t* p = static_cast<const uint8_t*>(data); size > 0; ++p, --size) {
+        result = (result ^ *p) * kFnvPrime;
+    }
+    return result;
+}
+
+// static
+std::vector<std::string> ConfigCache::findIncludedFiles(const std::string& filePath) {
+    static const std::string kInclude = "xi:include";
+    static const std::string kHref = "href=\"";
+    std::vector<std::string> result;
+    std::string content;
+    if (!::android::base::ReadFileToString(filePath, &content)) return result;
+    const std::string dirName = getDirName(filePath);
+    for (size_t pos = content.find(kInclude); pos != std::string::npos;
+         pos = content.find(kInclude, pos)) {
+        pos += kInclude.size();
+        const size_t end = content.find('>', pos);
+        const size_t hrefPos = content.find(kHref, pos);
+        if (hrefPos == std::string::npos || hrefPos > end) continue;
+        const size_t start = hrefPos + kHref.size();
+        const size_t hrefEnd = content.find('"', start);
+        if (hrefEnd == std::string::npos) break;
+        const std::string href = content.substr(start, hrefEnd - start);
+        result.push_back(!href.empty() && href[0] == '/' ? href : dirName + href);
+        pos = hrefEnd;
+    }
+    return result;
+}
+
+uint64_t ConfigCache::calculateKey(const std::vector<std::string>& sourceFiles) const {
+    uint64_t key = hash(&mFormatVersion, sizeof(mFormatVersion), kFnvOffsetBasis);
+    // Any OTA may change both the conversion code and the files.
+    const std::string fingerprint = ::android::base::GetProperty("ro.vendor.build.fingerprint", "");
+    key = hash(fingerprint.data(), fingerprint.size(), key);
+    std::set<std::string> visited;
+    std::deque<std::pair<std::string, bool /*isIncluded*/>> files;
+    for (const auto& file : sourceFiles) files.emplace_back(file, false);
+    while (!files.empty()) {
+        const auto [file, isIncluded] = files.front();
+        files.pop_front();
+        if (!visited.insert(file).second) continue;
+        key = hash(file.data(), file.size(), key);
+        std::string content;
+        if (!::android::base::ReadFileToString(file, &content)) {
+            // A missing included file may be handled by an XInclude fallback.
+            if (isIncluded) continue;
+            LOG(WARNING) << __func__ << ": can not read \"" << file << "\", cache disabled";
+            return 0;
+        }
+        key = hash(content.data(), content.size(), key);
+        for (auto& included : findIncludedFiles(file)) files.emplace_back(included, true);
+    }
+    return key != 0 ? key : 1;
+}
+
+bool ConfigCache::load(const Reader& reader) const {
+    if (!isValid()) return false;
+    unique_fd fd(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd.get() < 0) {
+        LOG(DEBUG) << __func__ << ": no cache at \"" << mPath << "\"";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CacheHeader))) {
+        LOG(WARNING) << __func__ << ": invalid cache file \"" << mPath << "\"";
+        return false;
+    }
+    const size_t fileSize = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        PLOG(WARNING) << __func__ << ": failed to map \"" << mPath << "\"";
+        return false;
+    }
+    auto unmap = ::android::base::make_scope_guard([&] { munmap(mapping, fileSize); });
+    CacheHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    const uint8_t* data = static_cast<const uint8_t*>(mapping) + sizeof(header);
+    if (header.magic != kCacheMagic || header.formatVersion != mFormatVersion ||
+        header.key != mKey || header.dataSize != fileSize - sizeof(header)) {
+        LOG(INFO) << __func__ << ": cache \"" << mPath << "\" is out of date";
+        return false;
+    }
+    if (header.dataHash != hash(data, header.dataSize, kFnvOffsetBasis)) {
+        LOG(WARNING) << __func__ << ": cache \"" << mPath << "\" is corrupted";
+        return false;
+    }
+    ndk::ScopedAParcel parcel(AParcel_create());
+    if (binder_status_t status = AParcel_unmarshal(parcel.get(), data, header.dataSize);
+        status != STATUS_OK) {
+        LOG(WARNING) << __func__ << ": failed to unmarshal \"" << mPath << "\": " << status;
+        return false;
+    }
+    AParcel_setDataPosition(parcel.get(), 0);
+    if (binder_status_t status = reader(parcel.get()); status != STATUS_OK) {
+        LOG(WARNING) << __func__ << ": failed to read data from \"" << mPath << "\": " << status;
+        return false;
+    }
+    LOG(DEBUG) << __func__ << ": loaded \"" << mPath << "\", " << header.dataSize << " bytes";
+    return true;
+}
+
+bool ConfigCache::store(const Writer& writer) const {
+    if (!isValid()) return false;
+    ndk::ScopedAParcel parcel(AParcel_create());
+    if (binder_status_t status = writer(parcel.get()); status != STATUS_OK) {
+        LOG(WARNING) << __func__ << ": failed to write data: " << status;
+        return false;
+    }
+    const size_t dataSize = AParcel_getDataSize(parcel.get());
+    std::vector<uint8_t> buffer(sizeof(CacheHeader) + dataSize);
+    uint8_t* data = buffer.data() + sizeof(CacheHeader);
+    if (binder_status_t status = AParcel_marshal(parcel.get(), data, 0, dataSize);
+        status != STATUS_OK) {
+        LOG(WARNING) << __func__ << ": failed to marshal data: " << status;
+        return false;
+    }
+    const CacheHeader header{.magic = kCacheMagic,
+                             .formatVersion = mFormatVersion,
+                             .key = mKey,
+                             .dataSize = dataSize,
+                             .dataHash = hash(data, dataSize, kFnvOffsetBasis)};
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    if (mkdir(mCacheDir.c_str(), 0770) != 0 && errno != EEXIST) {
+        PLOG(WARNING) << __func__ << ": failed to create \"" << mCacheDir << "\"";
+        return false;
+    }
+    // Write into a temporary file first, so that a concurrent or interrupted write never leaves
+    // a partially written cache.
+    const std::string tempPath = mPath + ".tmp";
+    {
+        unique_fd fd(TEMP_FAILURE_RETRY(
+                open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660)));
+        if (fd.get() < 0 ||
+            !::android::base::WriteFully(fd.get(), buffer.data(), buffer.size()) ||
+            fsync(fd.get()) != 0) {
+            PLOG(WARNING) << __func__ << ": failed to write \"" << tempPath << "\"";
+            unlink(tempPath.c_str());
+            return false;
+        }
+    }
+    if (rename(tempPath.c_str(), mPath.c_str()) != 0) {
+        PLOG(WARNING) << __func__ << ": failed to rename \"" << tempPath << "\"";
+        unlink(tempPath.c_str());
+        return false;
+    }
+    LOG(DEBUG) << __func__ << ": stored \"" << mPath << "\", " << dataSize << " bytes";
+    return true;
+}
+
+}  // namespace aidl::android::hardware::audio::core::internal
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#define ATRACE_TAG ATRACE_TAG_AUDIO
+#define LOG_TAG "AHAL_EffectChain"
+#include <android-base/logging.h>
+#include <utils/Trace.h>
+
+#include "effectFactory-impl/EffectChain.h"
+
+using aidl::android::hardware::audio::effect::kEventFlagDataMqNotEmpty;
+using ::android::hardware::EventFlag;
+
+namespace aidl::android::hardware::audio::effect {
+
+EffectChain::EffectChain(const Parameter::Common& common, std::vector<Member> members)
+    : mMembers(std::move(members)),
+      mContext(std::make_unique<EffectContext>(1 /* statusMqDepth */, common)),
+      mEventFlag(mContext->getStatusEventFlag()) {
+    std::lock_guard lg(mMutex);
+    mLastStatus.resize(mMembers.size(), {STATUS_OK, 0, 0});
+}
+
+EffectChain::~EffectChain() {
+    close();
+}
+
+RetCode EffectChain::open(IEffect::OpenEffectReturn* ret) {
+    std::lock_guard lg(mMutex);
+    if (!mOpened) {
+        RETURN_VALUE_IF(createThread("EffectChain") != RetCode::SUCCESS, RetCode::ERROR_THREAD,
+                        "FailedToCreateWorker");
+        mOpened = true;
+    }
+    mContext->dupeFmq(ret);
+    LOG(INFO) << __func__ << " with " << mMembers.size() << " effects";
+    return RetCode::SUCCESS;
+}
+
+RetCode EffectChain::close() {
+    {
+        std::lock_guard lg(mMutex);
+        if (!mOpened) {
+            return RetCode::SUCCESS;
+        }
+        mOpened = mProcessing = false;
+    }
+    // wake up the worker thread so it can exit
+    notifyEventFlag();
+    destroyThread();
+    LOG(INFO) << __func__;
+    return RetCode::SUCCESS;
+}
+
+RetCode EffectChain::start() {
+    std::lock_guard lg(mMutex);
+    RETURN_VALUE_IF(!mOpened, RetCode::ERROR_THREAD, "chainNotOpen");
+    if (mProcessing) {
+        return RetCode::SUCCESS;
+    }
+    mProcessing = true;
+    RETURN_VALUE_IF(notifyEventFlag() != RetCode::SUCCESS, RetCode::ERROR_EVENT_FLAG_ERROR,
+                    "notifyEventFlagFailed");
+    return startThread();
+}
+
+RetCode EffectChain::stop() {
+    std::lock_guard lg(mMutex);
+    if (!mProcessing) {
+        return RetCode::SUCCESS;
+    }
+    mProcessing = false;
+    RETURN_VALUE_IF(notifyEventFlag() != RetCode::SUCCESS, RetCode::ERROR_EVENT_FLAG_ERROR,
+                    "notifyEventFlagFailed");
+    return stopThread();
+}
+
+std::vector<IEffect::Status> EffectChain::getLastStatus() {
+    std::lock_guard lg(mMutex);
+    return mLastStatus;
+}
+
+RetCode EffectChain::notifyEventFlag() {
+    if (!mEventFlag) {
+        LOG(ERROR) << __func__ << ": StatusEventFlag invalid";
+        return RetCode::ERROR_EVENT_FLAG_ERROR;
+    }
+    if (const auto ret = mEventFlag->wake(kEventFlagDataMqNotEmpty); ret != ::android::OK) {
+        LOG(ERROR) << __func__ << ": wake failure with ret " << ret;
+        return RetCode::ERROR_EVENT_FLAG_ERROR;
+    }
+    return RetCode::SUCCESS;
+}
+
+void EffectChain::process() {
+    ATRACE_NAME("EffectChain");
+    /**
+     * wait for the EventFlag without lock, it's ok because the mEventFlag pointer will not change
+     * in the life cycle of workerThread (threadLoop).
+     */
+    uint32_t efState = 0;
+    if (!mEventFlag ||
+        ::android::OK != mEventFlag->wait(kEventFlagDataMqNotEmpty, &efState, 0 /* no timeout */,
+                                          true /* retry */) ||
+        !(efState & kEventFlagDataMqNotEmpty)) {
+        LOG(ERROR) << __func__ << ": StatusEventFlag - " << mEventFlag << " efState - " << std::hex
+                   << efState;
+        return;
+    }
+
+    std::lock_guard lg(mMutex);
+    if (!mProcessing) {
+        LOG(DEBUG) << __func__ << " skip process when not processing";
+        return;
+    }
+    auto statusMQ = mContext->getStatusFmq();
+    auto inputMQ = mContext->getInputDataFmq();
+    auto outputMQ = mContext->getOutputDataFmq();
+    auto buffer = mContext->getWorkBuffer();
+    if (!statusMQ || !inputMQ || !outputMQ) {
+        return;
+    }
+
+    const size_t consumed = std::min(inputMQ->availableToRead(), outputMQ->availableToWrite());
+    if (!consumed) {
+        return;
+    }
+    inputMQ->read(buffer, consumed);
+
+    // All effects run in place on the work buffer, each one processes what the previous produced.
+    IEffect::Status chainStatus = {STATUS_OK, static_cast<int32_t>(consumed), 0};
+    size_t samples = consumed;
+    for (size_t i = 0; i < mMembers.size(); i++) {
+        const auto& member = mMembers[i];
+        IEffect::Status& status = mLastStatus[i];
+        if (member.processFunc(member.effect, buffer, buffer, static_cast<int>(samples),
+                              &status) != EX_NONE) {
+            status = {STATUS_INVALID_OPERATION, 0, 0};
+        }
+        if (status.status != STATUS_OK && chainStatus.status == STATUS_OK) {
+            LOG(ERROR) << __func__ << ": effect " << i << " failed with status " << status.status;
+            chainStatus.status = status.status;
+        }
+        samples = std::min(samples, static_cast<size_t>(std::max(status.fmqProduced, 0)));
+    }
+
+    outputMQ->write(buffer, samples);
+    chainStatus.fmqProduced = static_cast<int32_t>(samples);
+    statusMQ->writeBlocking(&chainStatus, 1);
+    LOG(VERBOSE) << __func__ << ": done processing, chain consumed " << chainStatus.fmqConsumed
+                 << " produced " << chainStatus.fmqProduced;
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -18,10 +18,12 @@
 #include <string>
 #define LOG_TAG "AHAL_EffectConfig"
 #include <android-base/logging.h>
+#include <android/binder_parcel_utils.h>
 #include <system/audio_aidl_utils.h>
 #include <system/audio_effects/audio_effects_conf.h>
 #include <system/audio_effects/effect_uuid.h>
 
+#include "core-impl/ConfigCache.h"
 #include "effectFactory-impl/EffectConfig.h"
 
 #ifdef __ANDROID_APEX__
@@ -30,11 +32,143 @@
 
 using aidl::android::media::audio::common::AudioSource;
 using aidl::android::media::audio::common::AudioStreamType;
+using aidl::android::hardware::audio::core::internal::ConfigCache;
+using aidl::android::hardware::audio::core::internal::kConfigCacheDir;
 using aidl::android::media::audio::common::AudioUuid;
 
 namespace aidl::android::hardware::audio::effect {
 
+#define RETURN_IF_BINDER_ERROR(expr)                                   \
+    do {                                                               \
+        if (binder_status_t _status = (expr); _status != STATUS_OK) {  \
+            return _status;                                            \
+        }                                                              \
+    } while (false)
+
+namespace {
+
+binder_status_t writeLibrary(AParcel* parcel, const EffectConfig::Library& library) {
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeString(parcel, library.name));
+    RETURN_IF_BINDER_ERROR(library.uuid.writeToParcel(parcel));
+    return ::ndk::AParcel_writeNullableParcelable(parcel, library.type);
+}
+
+binder_status_t readLibrary(const AParcel* parcel, EffectConfig::Library* library) {
+    RETURN_IF_BINDER_ERROR(::ndk::AParcel_readString(parcel, &library->name));
+    RETURN_IF_BINDER_ERROR(library->uuid.readFromParcel(parcel));
+    return ::ndk::AParcel_readNullableParcelable(parcel, &library->type);
+}
+
+binder_status_t writeEffectLibraries(AParcel* parcel,
+                                     const EffectConfig::EffectLibraries& effectLibraries) {
+    RETURN_IF_BINDER_ERROR(AParcel_writeBool(parcel, effectLibraries.proxyLibrary.has_value()));
+    if (effectLibraries.proxyLibrary.has_value()) {
+        RETURN_IF_BINDER_ERROR(writeLibrary(parcel, *effectLibraries.proxyLibrary));
+    }
+    RETURN_IF_BINDER_ERROR(
+            AParcel_writeInt32(parcel, static_cast<int32_t>(effectLibraries.libraries.size())));
+    for (const auto& library : effectLibraries.libraries) {
+        RETURN_IF_BINDER_ERROR(writeLibrary(parcel, library));
+    }
+    return STATUS_OK;
+}
+
+binder_status_t readEffectLibraries(const AParcel* parcel,
+                                    EffectConfig::EffectLibraries* effectLibraries) {
+    bool hasProxyLibrary = false;
+    RETURN_IF_BINDER_ERROR(AParcel_readBool(parcel, &hasProxyLibrary));
+    if (hasProxyLibrary) {
+        RETURN_IF_BINDER_ERROR(readLibrary(parcel, &effectLibraries->proxyLibrary.emplace()));
+    }
+    int32_t count = 0;
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    if (count < 0) return STATUS_BAD_VALUE;
+    effectLibraries->libraries.resize(count);
+    for (auto& library : effectLibraries->libraries) {
+        RETURN_IF_BINDER_ERROR(readLibrary(parcel, &library));
+    }
+    return STATUS_OK;
+}
+
+}  // namespace
+
 EffectConfig::EffectConfig(const std::string& file) {
+    ConfigCache cache(kConfigCacheDir, "audio_effects_config", kConfigCacheFormatVersion, {file});
+    if (cache.load([this](const AParcel* parcel) { return readFromParcel(parcel); })) {
+        LOG(DEBUG) << __func__ << " loaded " << file << " from the cache, skipping "
+                   << mSkippedElements << " element(s)";
+        return;
+    }
+    // The cache may have been read partially.
+    mSkippedElements = 0;
+    mLibraryMap.clear();
+    mEffectsMap.clear();
+    mProcessingMap.clear();
+    if (parseFile(file)) {
+        cache.store([this](AParcel* parcel) { return writeToParcel(parcel); });
+    }
+}
+
+binder_status_t EffectConfig::writeToParcel(AParcel* parcel) const {
+    RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, mSkippedElements));
+    RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, static_cast<int32_t>(mLibraryMap.size())));
+    for (const auto& [name, path] : mLibraryMap) {
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeString(parcel, name));
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeString(parcel, path));
+    }
+    RETURN_IF_BINDER_ERROR(AParcel_writeInt32(parcel, static_cast<int32_t>(mEffectsMap.size())));
+    for (const auto& [name, effectLibraries] : mEffectsMap) {
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_writeString(parcel, name));
+        RETURN_IF_BINDER_ERROR(writeEffectLibraries(parcel, effectLibraries));
+    }
+    RETURN_IF_BINDER_ERROR(
+            AParcel_writeInt32(parcel, static_cast<int32_t>(mProcessingMap.size())));
+    for (const auto& [type, effectLibrariesList] : mProcessingMap) {
+        RETURN_IF_BINDER_ERROR(type.writeToParcel(parcel));
+        RETURN_IF_BINDER_ERROR(
+                AParcel_writeInt32(parcel, static_cast<int32_t>(effectLibrariesList.size())));
+        for (const auto& effectLibraries : effectLibrariesList) {
+            RETURN_IF_BINDER_ERROR(writeEffectLibraries(parcel, effectLibraries));
+        }
+    }
+    return STATUS_OK;
+}
+
+binder_status_t EffectConfig::readFromParcel(const AParcel* parcel) {
+    int32_t count = 0;
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &mSkippedElements));
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    for (int32_t i = 0; i < count; ++i) {
+        std::string name, path;
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_readString(parcel, &name));
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_readString(parcel, &path));
+        mLibraryMap[name] = std::move(path);
+    }
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    for (int32_t i = 0; i < count; ++i) {
+        std::string name;
+        RETURN_IF_BINDER_ERROR(::ndk::AParcel_readString(parcel, &name));
+        RETURN_IF_BINDER_ERROR(readEffectLibraries(parcel, &mEffectsMap[name]));
+    }
+    RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &count));
+    for (int32_t i = 0; i < count; ++i) {
+        Processing::Type type;
+        int32_t listSize = 0;
+        RETURN_IF_BINDER_ERROR(type.readFromParcel(parcel));
+        RETURN_IF_BINDER_ERROR(AParcel_readInt32(parcel, &listSize));
+        if (listSize < 0) return STATUS_BAD_VALUE;
+        auto& effectLibrariesList = mProcessingMap[type];
+        effectLibrariesList.resize(listSize);
+        for (auto& effectLibraries : effectLibrariesList) {
+            RETURN_IF_BINDER_ERROR(readEffectLibraries(parcel, &effectLibraries));
+        }
+    }
+    return STATUS_OK;
+}
+
+#undef RETURN_IF_BINDER_ERROR
+
+bool EffectConfig::parseFile(const std::string& file) {
     tinyxml2::XMLDocument doc;
     doc.LoadFile(file.c_str());
     LOG(DEBUG) << __func__ << " loading " << file;
@@ -42,7 +176,7 @@ EffectConfig::EffectConfig(const std::string& file) {
     if (doc.Error()) {
         LOG(ERROR) << __func__ << " tinyxml2 failed to load " << file
                    << " error: " << doc.ErrorStr();
-        return;
+        return false;
     }
 
     auto registerFailure = [&](bool result) { mSkippedElements += result ? 0 : 1; };
@@ -80,6 +214,7 @@ EffectConfig::EffectConfig(const std::string& file) {
     }
     LOG(DEBUG) << __func__ << " successfully parsed " << file << ", skipping " << mSkippedElements
                << " element(s)";
+    return true;
 }
 
 std::vector<std::reference_wrapper<const tinyxml2::XMLElement>> EffectConfig::getChildren(
@@ -0,0 +1,511 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "effect-impl/EffectDspKernels.h"
+
+namespace aidl::android::hardware::audio::effect::dsp {
+
+namespace {
+
+// Four float lanes, mapped to the native vector type when there is one.
+constexpr size_t kLanes = 4;
+
+#if defined(__ARM_NEON)
+using FloatVec = float32x4_t;
+inline FloatVec simdLoad(const float* p) {
+    return vld1q_f32(p);
+}
+inline void simdStore(float* p, FloatVec v) {
+    vst1q_f32(p, v);
+}
+inline FloatVec simdSplat(float f) {
+    return vdupq_n_f32(f);
+}
+inline FloatVec simdAdd(FloatVec a, FloatVec b) {
+    return vaddq_f32(a, b);
+}
+inline FloatVec simdSub(FloatVec a, FloatVec b) {
+    return vsubq_f32(a, b);
+}
+inline FloatVec simdMul(FloatVec a, FloatVec b) {
+    return vmulq_f32(a, b);
+}
+inline FloatVec simdMax(FloatVec a, FloatVec b) {
+    return vmaxq_f32(a, b);
+}
+inline FloatVec simdAbs(FloatVec a) {
+    return vabsq_f32(a);
+}
+#elif defined(__SSE2__)
+using FloatVec = __m128;
+inline FloatVec simdLoad(const float* p) {
+    return _mm_loadu_ps(p);
+}
+inline void simdStore(float* p, FloatVec v) {
+    _mm_storeu_ps(p, v);
+}
+inline FloatVec simdSplat(float f) {
+    return _mm_set1_ps(f);
+}
+inline FloatVec simdAdd(FloatVec a, FloatVec b) {
+    return _mm_add_ps(a, b);
+}
+inline FloatVec simdSub(FloatVec a, FloatVec b) {
+    return _mm_sub_ps(a, b);
+}
+inline FloatVec simdMul(FloatVec a, FloatVec b) {
+    return _mm_mul_ps(a, b);
+}
+inline FloatVec simdMax(FloatVec a, FloatVec b) {
+    return _mm_max_ps(a, b);
+}
+inline FloatVec simdAbs(FloatVec a) {
+    return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+#else
+struct FloatVec {
+    float v[kLanes];
+};
+inline FloatVec simdLoad(const float* p) {
+    return {{p[0], p[1], p[2], p[3]}};
+}
+inline void simdStore(float* p, FloatVec v) {
+    std::copy(v.v, v.v + kLanes, p);
+}
+inline FloatVec simdSplat(float f) {
+    return {{f, f, f, f}};
+}
+template <typename Op>
+inline FloatVec simdApply(FloatVec a, FloatVec b, Op op) {
+    return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}};
+}
+inline FloatVec simdAdd(FloatVec a, FloatVec b) {
+    return simdApply(a, b, [](float x, float y) { return x + y; });
+}
+inline FloatVec simdSub(FloatVec a, FloatVec b) {
+    return simdApply(a, b, [](float x, float y) { return x - y; });
+}
+inline FloatVec simdMul(FloatVec a, FloatVec b) {
+    return simdApply(a, b, [](float x, float y) { return x * y; });
+}
+inline FloatVec simdMax(FloatVec a, FloatVec b) {
+    return simdApply(a, b, [](float x, float y) { return std::max(x, y); });
+}
+inline FloatVec simdAbs(FloatVec a) {
+    return {{std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3])}};
+}
+#endif
+
+inline float simdReduceAdd(FloatVec v) {
+    float lanes[kLanes];
+    simdStore(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+inline float simdReduceMax(FloatVec v) {
+    float lanes[kLanes];
+    simdStore(lanes, v);
+    return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+template <typename VecOp, typename ScalarOp>
+void binaryOp(const float* a, const float* b, float* out, size_t samples, VecOp vecOp,
+              ScalarOp scalarOp) {
+    size_t i = 0;
+    for (; i + kLanes <= samples; i += kLanes) {
+        simdStore(out + i, vecOp(simdLoad(a + i), simdLoad(b + i)));
+    }
+    for (; i < samples; i++) {
+        out[i] = scalarOp(a[i], b[i]);
+    }
+}
+
+// Returns true if the frequency can't be represented at the sample rate.
+bool isAboveNyquist(float sampleRate, float frequency) {
+    return frequency <= 0 || frequency >= sampleRate / 2;
+}
+
+}  // namespace
+
+float dbToAmplitude(float db) {
+    return std::pow(10.0f, db / 20.0f);
+}
+
+float amplitudeToDb(float amplitude) {
+    // clamp to -120dB, which is well below the noise floor of 24 bits audio
+    return 20.0f * std::log10(std::max(amplitude, 1e-6f));
+}
+
+void applyGain(const float* in, float* out, size_t samples, float gain) {
+    const FloatVec g = simdSplat(gain);
+    size_t i = 0;
+    for (; i + kLanes <= samples; i += kLanes) {
+        simdStore(out + i, simdMul(simdLoad(in + i), g));
+    }
+    for (; i < samples; i++) {
+        out[i] = in[i] * gain;
+    }
+}
+
+void applyGainRamp(const float* in, float* out, size_t frames, size_t channelCount,
+                   float startGain, float endGain) {
+    if (frames == 0) {
+        return;
+    }
+    const float step = frames > 1 ? (endGain - startGain) / (frames - 1) : 0.0f;
+    for (size_t frame = 0; frame < frames; frame++) {
+        const size_t offset = frame * channelCount;
+        applyGain(in + offset, out + offset, channelCount, startGain + step * frame);
+    }
+}
+
+void applyChannelGains(const float* in, float* out, size_t frames, size_t channelCount,
+                       const float* gains) {
+    if (channelCount == 0) {
+        return;
+    }
+    const size_t samples = frames * channelCount;
+    size_t i = 0;
+    // The gain pattern repeats every channelCount samples, so kLanes frames always cover a whole
+    // number of vectors.
+    constexpr size_t kMaxPatternChannels = 32;
+    if (channelCount <= kMaxPatternChannels) {
+        const size_t period = channelCount * kLanes;
+        float pattern[kMaxPatternChannels * kLanes];
+        for (size_t j = 0; j < period; j++) {
+            pattern[j] = gains[j % channelCount];
+        }
+        for (; i + period <= samples; i += period) {
+            for (size_t j = 0; j < period; j += kLanes) {
+                simdStore(out + i + j, simdMul(simdLoad(in + i + j), simdLoad(pattern + j)));
+            }
+        }
+    }
+    for (; i < samples; i++) {
+        out[i] = in[i] * gains[i % channelCount];
+    }
+}
+
+void add(const float* a, const float* b, float* out, size_t samples) {
+    binaryOp(
+            a, b, out, samples, [](FloatVec x, FloatVec y) { return simdAdd(x, y); },
+            [](float x, float y) { return x + y; });
+}
+
+void subtract(const float* a, const float* b, float* out, size_t samples) {
+    binaryOp(
+            a, b, out, samples, [](FloatVec x, FloatVec y) { return simdSub(x, y); },
+            [](float x, float y) { return x - y; });
+}
+
+float findPeak(const float* in, size_t samples) {
+    FloatVec peak = simdSplat(0.0f);
+    size_t i = 0;
+    for (; i + kLanes <= samples; i += kLanes) {
+        peak = simdMax(peak, simdAbs(simdLoad(in + i)));
+    }
+    float result = simdReduceMax(peak);
+    for (; i < samples; i++) {
+        result = std::max(result, std::fabs(in[i]));
+    }
+    return result;
+}
+
+float sumOfSquares(const float* in, size_t samples) {
+    FloatVec sum = simdSplat(0.0f);
+    size_t i = 0;
+    for (; i + kLanes <= samples; i += kLanes) {
+        const FloatVec x = simdLoad(in + i);
+        sum = simdAdd(sum, simdMul(x, x));
+    }
+    float result = simdReduceAdd(sum);
+    for (; i < samples; i++) {
+        result += in[i] * in[i];
+    }
+    return result;
+}
+
+void complexMultiplyAccumulate(const float* aRe, const float* aIm, const float* bRe,
+                               const float* bIm, float* accRe, float* accIm, size_t count) {
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        const FloatVec ar = simdLoad(aRe + i), ai = simdLoad(aIm + i);
+        const FloatVec br = simdLoad(bRe + i), bi = simdLoad(bIm + i);
+        const FloatVec productRe = simdSub(simdMul(ar, br), simdMul(ai, bi));
+        const FloatVec productIm = simdAdd(simdMul(ar, bi), simdMul(ai, br));
+        simdStore(accRe + i, simdAdd(simdLoad(accRe + i), productRe));
+        simdStore(accIm + i, simdAdd(simdLoad(accIm + i), productIm));
+    }
+    for (; i < count; i++) {
+        accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+}
+
+Fft::Fft(size_t size) : mSize(size), mBitReverse(size), mCos(size / 2), mSin(size / 2) {
+    size_t bits = 0;
+    while ((size_t{1} << bits) < size) bits++;
+    for (size_t i = 0; i < size; i++) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        mBitReverse[i] = reversed;
+    }
+    for (size_t i = 0; i < size / 2; i++) {
+        mCos[i] = std::cos(2 * M_PI * i / size);
+        mSin[i] = std::sin(2 * M_PI * i / size);
+    }
+}
+
+void Fft::forward(float* re, float* im) const {
+    for (size_t i = 0; i < mSize; i++) {
+        if (const size_t j = mBitReverse[i]; i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (size_t length = 2; length <= mSize; length *= 2) {
+        const size_t half = length / 2;
+        const size_t step = mSize / length;
+        for (size_t start = 0; start < mSize; start += length) {
+            for (size_t k = 0; k < half; k++) {
+                // multiply the odd element by exp(-2 * pi * i * k / length)
+                const float wRe = mCos[k * step], wIm = -mSin[k * step];
+                const size_t even = start + k, odd = even + half;
+                const float vRe = re[odd] * wRe - im[odd] * wIm;
+                const float vIm = re[odd] * wIm + im[odd] * wRe;
+                re[odd] = re[even] - vRe;
+                im[odd] = im[even] - vIm;
+                re[even] += vRe;
+                im[even] += vIm;
+            }
+        }
+    }
+}
+
+void Fft::inverse(float* re, float* im) const {
+    // ifft(x) = swap(fft(swap(x))), where swap exchanges the real and imaginary parts.
+    forward(im, re);
+}
+
+BiquadCoefficients BiquadCoefficients::lowPass(float sampleRate, float frequency, float q) {
+    if (isAboveNyquist(sampleRate, frequency)) {
+        return passthrough();
+    }
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double alpha = std::sin(w0) / (2 * q);
+    const double cosW0 = std::cos(w0);
+    const double a0 = 1 + alpha;
+    return {.b0 = static_cast<float>((1 - cosW0) / 2 / a0),
+            .b1 = static_cast<float>((1 - cosW0) / a0),
+            .b2 = static_cast<float>((1 - cosW0) / 2 / a0),
+            .a1 = static_cast<float>(-2 * cosW0 / a0),
+            .a2 = static_cast<float>((1 - alpha) / a0)};
+}
+
+BiquadCoefficients BiquadCoefficients::peaking(float sampleRate, float frequency, float q,
+                                               float gainDb) {
+    if (isAboveNyquist(sampleRate, frequency) || gainDb == 0) {
+        return passthrough();
+    }
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double alpha = std::sin(w0) / (2 * q);
+    const double cosW0 = std::cos(w0);
+    const double a0 = 1 + alpha / a;
+    return {.b0 = static_cast<float>((1 + alpha * a) / a0),
+            .b1 = static_cast<float>(-2 * cosW0 / a0),
+            .b2 = static_cast<float>((1 - alpha * a) / a0),
+            .a1 = static_cast<float>(-2 * cosW0 / a0),
+            .a2 = static_cast<float>((1 - alpha / a) / a0)};
+}
+
+BiquadCoefficients BiquadCoefficients::lowShelf(float sampleRate, float frequency, float gainDb) {
+    if (isAboveNyquist(sampleRate, frequency) || gainDb == 0) {
+        return passthrough();
+    }
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double cosW0 = std::cos(w0);
+    // shelf slope S = 1
+    const double alpha = std::sin(w0) / 2 * std::sqrt(2.0);
+    const double sqrtA2Alpha = 2 * std::sqrt(a) * alpha;
+    const double a0 = (a + 1) + (a - 1) * cosW0 + sqrtA2Alpha;
+    return {.b0 = static_cast<float>(a * ((a + 1) - (a - 1) * cosW0 + sqrtA2Alpha) / a0),
+            .b1 = static_cast<float>(2 * a * ((a - 1) - (a + 1) * cosW0) / a0),
+            .b2 = static_cast<float>(a * ((a + 1) - (a - 1) * cosW0 - sqrtA2Alpha) / a0),
+            .a1 = static_cast<float>(-2 * ((a - 1) + (a + 1) * cosW0) / a0),
+            .a2 = static_cast<float>(((a + 1) + (a - 1) * cosW0 - sqrtA2Alpha) / a0)};
+}
+
+BiquadCoefficients BiquadCoefficients::highShelf(float sampleRate, float frequency, float gainDb) {
+    if (isAboveNyquist(sampleRate, frequency) || gainDb == 0) {
+        return passthrough();
+    }
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double cosW0 = std::cos(w0);
+    // shelf slope S = 1
+    const double alpha = std::sin(w0) / 2 * std::sqrt(2.0);
+    const double sqrtA2Alpha = 2 * std::sqrt(a) * alpha;
+    const double a0 = (a + 1) - (a - 1) * cosW0 + sqrtA2Alpha;
+    return {.b0 = static_cast<float>(a * ((a + 1) + (a - 1) * cosW0 + sqrtA2Alpha) / a0),
+            .b1 = static_cast<float>(-2 * a * ((a - 1) + (a + 1) * cosW0) / a0),
+            .b2 = static_cast<float>(a * ((a + 1) + (a - 1) * cosW0 - sqrtA2Alpha) / a0),
+            .a1 = static_cast<float>(2 * ((a - 1) - (a + 1) * cosW0) / a0),
+            .a2 = static_cast<float>(((a + 1) - (a - 1) * cosW0 - sqrtA2Alpha) / a0)};
+}
+
+BiquadFilter::BiquadFilter(size_t channelCount)
+    : mChannelCount(channelCount),
+      mB0(channelCount, 1.0f),
+      mB1(channelCount, 0.0f),
+      mB2(channelCount, 0.0f),
+      mA1(channelCount, 0.0f),
+      mA2(channelCount, 0.0f),
+      mS1(channelCount, 0.0f),
+      mS2(channelCount, 0.0f) {}
+
+void BiquadFilter::setCoefficients(const BiquadCoefficients& coefficients) {
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        setCoefficients(channel, coefficients);
+    }
+}
+
+void BiquadFilter::setCoefficients(size_t channel, const BiquadCoefficients& coefficients) {
+    if (channel >= mChannelCount) {
+        return;
+    }
+    mB0[channel] = coefficients.b0;
+    mB1[channel] = coefficients.b1;
+    mB2[channel] = coefficients.b2;
+    mA1[channel] = coefficients.a1;
+    mA2[channel] = coefficients.a2;
+}
+
+void BiquadFilter::reset() {
+    std::fill(mS1.begin(), mS1.end(), 0.0f);
+    std::fill(mS2.begin(), mS2.end(), 0.0f);
+}
+
+void BiquadFilter::process(const float* in, float* out, size_t frames) {
+    const size_t stride = mChannelCount;
+    size_t channel = 0;
+    // Each frame of kLanes adjacent channels is contiguous in the interleaved buffer, so the
+    // channels run in parallel lanes while every lane iterates over the frames in order.
+    for (; channel + kLanes <= mChannelCount; channel += kLanes) {
+        const FloatVec b0 = simdLoad(&mB0[channel]);
+        const FloatVec b1 = simdLoad(&mB1[channel]);
+        const FloatVec b2 = simdLoad(&mB2[channel]);
+        const FloatVec a1 = simdLoad(&mA1[channel]);
+        const FloatVec a2 = simdLoad(&mA2[channel]);
+        FloatVec s1 = simdLoad(&mS1[channel]);
+        FloatVec s2 = simdLoad(&mS2[channel]);
+        for (size_t frame = 0; frame < frames; frame++) {
+            const size_t offset = frame * stride + channel;
+            const FloatVec x = simdLoad(in + offset);
+            const FloatVec y = simdAdd(simdMul(b0, x), s1);
+            s1 = simdAdd(simdSub(simdMul(b1, x), simdMul(a1, y)), s2);
+            s2 = simdSub(simdMul(b2, x), simdMul(a2, y));
+            simdStore(out + offset, y);
+        }
+        simdStore(&mS1[channel], s1);
+        simdStore(&mS2[channel], s2);
+    }
+    for (; channel < mChannelCount; channel++) {
+        const float b0 = mB0[channel], b1 = mB1[channel], b2 = mB2[channel];
+        const float a1 = mA1[channel], a2 = mA2[channel];
+        float s1 = mS1[channel], s2 = mS2[channel];
+        for (size_t frame = 0; frame < frames; frame++) {
+            const size_t offset = frame * stride + channel;
+            const float x = in[offset];
+            const float y = b0 * x + s1;
+            s1 = b1 * x - a1 * y + s2;
+            s2 = b2 * x - a2 * y;
+            out[offset] = y;
+        }
+        mS1[channel] = s1;
+        mS2[channel] = s2;
+    }
+}
+
+void Compressor::configure(float sampleRate, const Config& config) {
+    mConfig = config;
+    mConfig.kneeWidthDb = std::fabs(config.kneeWidthDb);
+    mPreGain = dbToAmplitude(config.preGainDb);
+    mPostGain = dbToAmplitude(config.postGainDb);
+    auto timeToCoefficient = [sampleRate](float timeMs) {
+        return timeMs > 0 ? std::exp(-1000.0f / (timeMs * sampleRate)) : 0.0f;
+    };
+    mAttackCoefficient = timeToCoefficient(config.attackTimeMs);
+    mReleaseCoefficient = timeToCoefficient(config.releaseTimeMs);
+    mUnityGainMin = config.expanderRatio > 1 ? dbToAmplitude(config.noiseGateThresholdDb) : 0.0f;
+    mUnityGainMax = config.ratio > 1 ? dbToAmplitude(config.thresholdDb - mConfig.kneeWidthDb / 2)
+                                     : INFINITY;
+}
+
+float Compressor::computeGainDb(float levelDb) const {
+    if (levelDb < mConfig.noiseGateThresholdDb) {
+        return (levelDb - mConfig.noiseGateThresholdDb) * (mConfig.expanderRatio - 1);
+    }
+    const float overshoot = levelDb - mConfig.thresholdDb;
+    const float knee = mConfig.kneeWidthDb;
+    const float slope = mConfig.ratio > 1 ? 1 / mConfig.ratio - 1 : 0.0f;
+    if (2 * overshoot < -knee) {
+        return 0.0f;
+    }
+    if (knee > 0 && 2 * std::fabs(overshoot) <= knee) {
+        const float x = overshoot + knee / 2;
+        return slope * x * x / (2 * knee);
+    }
+    return slope * overshoot;
+}
+
+void Compressor::process(const float* in, float* out, size_t frames, size_t stride) {
+    if (!mConfig.enable) {
+        if (in != out) {
+            for (size_t frame = 0; frame < frames; frame++) {
+                out[frame * stride] = in[frame * stride];
+            }
+        }
+        return;
+    }
+    float envelope = mEnvelope;
+    for (size_t frame = 0; frame < frames; frame++) {
+        const float x = in[frame * stride] * mPreGain;
+        const float level = std::fabs(x);
+        const float coefficient = level > envelope ? mAttackCoefficient : mReleaseCoefficient;
+        envelope = level + coefficient * (envelope - level);
+        float gain = mPostGain;
+        if (envelope < mUnityGainMin || envelope > mUnityGainMax) {
+            gain *= dbToAmplitude(computeGainDb(amplitudeToDb(envelope)));
+        }
+        out[frame * stride] = x * gain;
+    }
+    mEnvelope = envelope;
+}
+
+}  // namespace aidl::android::hardware::audio::effect::dsp
@@ -38,10 +38,16 @@ namespace aidl::android::hardware::audio::effect {
 
 Factory::Factory(const std::string& file) : mConfig(EffectConfig(file)) {
     LOG(DEBUG) << __func__ << " with config file: " << file;
-    loadEffectLibs();
+    registerEffectLibs();
+    // The libraries are opened in the background so that the factory can be served right away.
+    mPrewarmThread = std::thread(&Factory::prewarmEffectLibs, this);
 }
 
 Factory::~Factory() {
+    mStopPrewarm = true;
+    if (mPrewarmThread.joinable()) {
+        mPrewarmThread.join();
+    }
     if (auto count = mEffectMap.size()) {
         LOG(ERROR) << __func__ << " remaining " << count
                    << " effect instances not destroyed indicating resource leak!";
@@ -58,13 +64,18 @@ Factory::~Factory() {
 ndk::ScopedAStatus Factory::getDescriptorWithUuid_l(const AudioUuid& uuid, Descriptor* desc) {
     RETURN_IF(!desc, EX_NULL_POINTER, "nullDescriptor");
 
-    if (mEffectLibMap.count(uuid)) {
-        auto& entry = mEffectLibMap[uuid];
-        getDlSyms_l(entry);
-        auto& libInterface = std::get<kMapEntryInterfaceIndex>(entry);
+    // Descriptors don't change, so the library is only queried once.
+    if (auto cached = mDescriptorCache.find(uuid); cached != mDescriptorCache.end()) {
+        *desc = cached->second;
+        return ndk::ScopedAStatus::ok();
+    }
+
+    if (auto entry = loadEffectLibrary_l(uuid)) {
+        auto& libInterface = std::get<kMapEntryInterfaceIndex>(*entry);
         RETURN_IF(!libInterface || !libInterface->queryEffectFunc, EX_NULL_POINTER,
                   "dlNullQueryEffectFunc");
         RETURN_IF_BINDER_EXCEPTION(libInterface->queryEffectFunc(&uuid, desc));
+        mDescriptorCache[uuid] = *desc;
         return ndk::ScopedAStatus::ok();
     }
 
@@ -87,7 +98,8 @@ ndk::ScopedAStatus Factory::queryEffects(const std::optional<AudioUuid>& in_type
                  });
     // query through the matching list
     for (const auto& id : idList) {
-        if (mEffectLibMap.count(id.uuid)) {
+        // libraries failing to open are dropped, along with their identities
+        if (loadEffectLibrary_l(id.uuid)) {
             Descriptor desc;
             RETURN_IF_ASTATUS_NOT_OK(getDescriptorWithUuid_l(id.uuid, &desc),
                                      "getDescriptorFailed");
@@ -129,11 +141,8 @@ ndk::ScopedAStatus Factory::createEffect(const AudioUuid& in_impl_uuid,
                                          std::shared_ptr<IEffect>* _aidl_return) {
     LOG(DEBUG) << __func__ << ": UUID " << ::android::audio::utils::toString(in_impl_uuid);
     std::lock_guard lg(mMutex);
-    if (mEffectLibMap.count(in_impl_uuid)) {
-        auto& entry = mEffectLibMap[in_impl_uuid];
-        getDlSyms_l(entry);
-
-        auto& libInterface = std::get<kMapEntryInterfaceIndex>(entry);
+    if (auto entry = loadEffectLibrary_l(in_impl_uuid)) {
+        auto& libInterface = std::get<kMapEntryInterfaceIndex>(*entry);
         RETURN_IF(!libInterface || !libInterface->createEffectFunc, EX_NULL_POINTER,
                   "dlNullcreateEffectFunc");
         std::shared_ptr<IEffect> effectSp;
@@ -200,29 +209,105 @@ ndk::ScopedAStatus Factory::destroyEffect(const std::shared_ptr<IEffect>& in_han
     return status;
 }
 
-bool Factory::openEffectLibrary(const AudioUuid& impl,
-                                const std::string& path) NO_THREAD_SAFETY_ANALYSIS {
+ndk::ScopedAStatus Factory::createEffectChain(
+        const std::vector<std::shared_ptr<IEffect>>& in_effects,
+        const Parameter::Common& in_common, std::shared_ptr<EffectChain>* _aidl_return) {
+    RETURN_IF(!_aidl_return, EX_NULL_POINTER, "nullChain");
+    RETURN_IF(in_effects.empty(), EX_ILLEGAL_ARGUMENT, "emptyChain");
+    RETURN_IF(in_common.input.base != in_common.output.base, EX_ILLEGAL_ARGUMENT,
+              "chainInputOutputMismatch");
+
+    std::lock_guard lg(mMutex);
+    std::vector<EffectChain::Member> members;
+    members.reserve(in_effects.size());
+    for (const auto& effect : in_effects) {
+        RETURN_IF(!effect, EX_NULL_POINTER, "nullEffect");
+        auto effectIt = mEffectMap.find(std::weak_ptr<IEffect>(effect));
+        RETURN_IF(effectIt == mEffectMap.end(), EX_ILLEGAL_ARGUMENT, "effectNotFound");
+        auto libIt = mEffectLibMap.find(effectIt->second.first);
+        RETURN_IF(libIt == mEffectLibMap.end(), EX_ILLEGAL_ARGUMENT, "libraryNotFound");
+        auto& interface = std::get<kMapEntryInterfaceIndex>(libIt->second);
+        RETURN_IF(!interface || !interface->processEffectFunc, EX_UNSUPPORTED_OPERATION,
+                  "dlNullProcessEffectFunc");
+
+        Parameter param;
+        Parameter::Id id = Parameter::Id::make<Parameter::Id::commonTag>(Parameter::common);
+        RETURN_IF_ASTATUS_NOT_OK(effect->getParameter(id, &param), "getCommonFailed");
+        const auto& common = param.get<Parameter::common>();
+        RETURN_IF(common.input != in_common.input || common.output != in_common.output,
+                  EX_ILLEGAL_ARGUMENT, "effectConfigMismatch");
+        members.push_back({effect, interface->processEffectFunc});
+    }
+
+    *_aidl_return = std::make_shared<EffectChain>(in_common, std::move(members));
+    LOG(DEBUG) << __func__ << ": chain of " << in_effects.size() << " effects created";
+    return ndk::ScopedAStatus::ok();
+}
+
+void Factory::registerEffectLibrary(const AudioUuid& impl,
+                                    const std::string& path) NO_THREAD_SAFETY_ANALYSIS {
     std::function<void(void*)> dlClose = [](void* handle) -> void {
         if (handle && dlclose(handle)) {
             LOG(ERROR) << "dlclose failed " << dlerror();
         }
     };
 
-    auto libHandle =
-            std::unique_ptr<void, decltype(dlClose)>{dlopen(path.c_str(), RTLD_LAZY), dlClose};
+    // Opened on first use by loadEffectLibrary_l.
+    auto interface = new effect_dl_interface_s{nullptr, nullptr, nullptr, nullptr};
+    mEffectLibMap.insert(
+            {impl, std::make_tuple(std::unique_ptr<void, decltype(dlClose)>{nullptr, dlClose},
+                                   std::unique_ptr<struct effect_dl_interface_s>(interface),
+                                   path)});
+}
+
+Factory::DlEntry* Factory::loadEffectLibrary_l(const AudioUuid& impl) {
+    auto entryIt = mEffectLibMap.find(impl);
+    if (entryIt == mEffectLibMap.end()) {
+        return nullptr;
+    }
+    auto& entry = entryIt->second;
+    auto& libHandle = std::get<kMapEntryHandleIndex>(entry);
+    if (libHandle) {
+        return &entry;
+    }
+
+    const auto& path = std::get<kMapEntryLibNameIndex>(entry);
+    libHandle.reset(dlopen(path.c_str(), RTLD_LAZY));
     if (!libHandle) {
         LOG(ERROR) << __func__ << ": dlopen failed, err: " << dlerror();
-        return false;
+        // Not supported after all, as if it wasn't in the config.
+        for (auto it = mIdentitySet.begin(); it != mIdentitySet.end();) {
+            it = it->uuid == impl ? mIdentitySet.erase(it) : std::next(it);
+        }
+        mEffectLibMap.erase(entryIt);
+        return nullptr;
     }
 
     LOG(INFO) << __func__ << " dlopen lib:" << path
               << "\nimpl:" << ::android::audio::utils::toString(impl) << "\nhandle:" << libHandle;
-    auto interface = new effect_dl_interface_s{nullptr, nullptr, nullptr};
-    mEffectLibMap.insert(
-            {impl,
-             std::make_tuple(std::move(libHandle),
-                             std::unique_ptr<struct effect_dl_interface_s>(interface), path)});
-    return true;
+    getDlSyms_l(entry);
+    return &entry;
+}
+
+void Factory::prewarmEffectLibs() {
+    std::vector<AudioUuid> impls;
+    {
+        std::lock_guard lg(mMutex);
+        for (const auto& [impl, _] : mEffectLibMap) {
+            impls.push_back(impl);
+        }
+    }
+    // One library at a time, so the binder calls don't wait for all of them.
+    for (const auto& impl : impls) {
+        if (mStopPrewarm) {
+            return;
+        }
+        std::lock_guard lg(mMutex);
+        if (Descriptor desc; !getDescriptorWithUuid_l(impl, &desc).isOk()) {
+            LOG(WARNING) << __func__ << ": failed to query "
+                         << ::android::audio::utils::toString(impl);
+        }
+    }
 }
 
 void Factory::createIdentityWithConfig(
@@ -235,21 +320,20 @@ void Factory::createIdentityWithConfig(
         id.type = typeUuid;
         id.uuid = configLib.uuid;
         id.proxy = proxyUuid;
-        LOG(DEBUG) << __func__ << " loading lib " << path->second << ": typeUuid "
+        LOG(DEBUG) << __func__ << " registering lib " << path->second << ": typeUuid "
                    << ::android::audio::utils::toString(id.type) << "\nimplUuid "
                    << ::android::audio::utils::toString(id.uuid) << " proxyUuid "
                    << (proxyUuid.has_value() ? ::android::audio::utils::toString(proxyUuid.value())
                                              : "null");
-        if (openEffectLibrary(id.uuid, path->second)) {
-            mIdentitySet.insert(std::move(id));
-        }
+        registerEffectLibrary(id.uuid, path->second);
+        mIdentitySet.insert(std::move(id));
     } else {
         LOG(ERROR) << __func__ << ": library " << libName << " not exist!";
         return;
     }
 }
 
-void Factory::loadEffectLibs() {
+void Factory::registerEffectLibs() {
     const auto& configEffectsMap = mConfig.getEffectsMap();
     for (const auto& configEffects : configEffectsMap) {
         if (AudioUuid type; EffectConfig::findUuid(configEffects /* xml effect */, &type)) {
@@ -285,6 +369,11 @@ void Factory::getDlSyms_l(DlEntry& entry) {
         dlInterface->destroyEffectFunc =
                 (EffectDestroyFunctor)dlsym(dlHandle.get(), "destroyEffect");
     }
+    // optional, the effect instances can only run in a chain session if available
+    if (!dlInterface->processEffectFunc) {
+        dlInterface->processEffectFunc =
+                (EffectProcessFunctor)dlsym(dlHandle.get(), "processEffect");
+    }
 
     if (!dlInterface->createEffectFunc || !dlInterface->destroyEffectFunc ||
         !dlInterface->queryEffectFunc) {
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <memory>
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 #define LOG_TAG "AHAL_EffectImpl"
@@ -42,6 +43,19 @@ extern "C" binder_exception_t destroyEffect(const std::shared_ptr<IEffect>& inst
     return EX_NONE;
 }
 
+// Only called with the instances created by this library, which are all EffectImpl.
+extern "C" binder_exception_t processEffect(const std::shared_ptr<IEffect>& instanceSp, float* in,
+                                            float* out, int samples, IEffect::Status* status) {
+    if (!instanceSp || !in || !out || !status) {
+        LOG(ERROR) << __func__ << " invalid parameter";
+        return EX_ILLEGAL_ARGUMENT;
+    }
+    auto effectImpl = static_cast<aidl::android::hardware::audio::effect::EffectImpl*>(
+            instanceSp.get());
+    *status = effectImpl->processChained(in, out, samples);
+    return EX_NONE;
+}
+
 namespace aidl::android::hardware::audio::effect {
 
 ndk::ScopedAStatus EffectImpl::open(const Parameter::Common& common,
@@ -348,9 +362,8 @@ void EffectImpl::process() {
                std::max(inputMQ->availableToRead(), outputMQ->availableToWrite()));
         auto processSamples = std::min(inputMQ->availableToRead(), outputMQ->availableToWrite());
         if (processSamples) {
-            inputMQ->read(buffer, processSamples);
-            IEffect::Status status = effectProcessImpl(buffer, buffer, processSamples);
-            outputMQ->write(buffer, status.fmqProduced);
+            IEffect::Status status =
+                    processDataMq(inputMQ.get(), outputMQ.get(), buffer, processSamples);
             statusMQ->writeBlocking(&status, 1);
             LOG(VERBOSE) << getEffectName() << __func__ << ": done processing, effect consumed "
                          << status.fmqConsumed << " produced " << status.fmqProduced;
@@ -358,6 +371,66 @@ void EffectImpl::process() {
     }
 }
 
+IEffect::Status EffectImpl::processChained(float* in, float* out, int samples) {
+    std::lock_guard lg(mImplMutex);
+    if (mState != State::PROCESSING || !mImplContext) {
+        if (in != out) {
+            std::copy(in, in + samples, out);
+        }
+        return status(STATUS_OK, samples, samples);
+    }
+    ATRACE_NAME(getEffectNameWithVersion().c_str());
+    return effectProcessImpl(in, out, samples);
+}
+
+IEffect::Status EffectImpl::processDataMq(EffectContext::DataMQ* inputMQ,
+                                          EffectContext::DataMQ* outputMQ, float* buffer,
+                                          size_t samples) {
+    // The effect may produce more samples than it consumes if the output frame is larger.
+    const size_t inputFrameSize = mImplContext->getInputFrameSize();
+    const size_t outputFrameSize = mImplContext->getOutputFrameSize();
+    const size_t outputSamples =
+            inputFrameSize ? std::max(samples, samples * outputFrameSize / inputFrameSize)
+                           : samples;
+
+    EffectContext::DataMQ::MemTransaction readTx, writeTx;
+    if (outputSamples > outputMQ->availableToWrite() || !inputMQ->beginRead(samples, &readTx) ||
+        !outputMQ->beginWrite(outputSamples, &writeTx)) {
+        inputMQ->read(buffer, samples);
+        IEffect::Status status = effectProcessImpl(buffer, buffer, samples);
+        outputMQ->write(buffer, status.fmqProduced);
+        return status;
+    }
+
+    // Process directly on the FMQ memory when possible. If a region wraps around the end of its
+    // ring buffer, the data is gathered into or scattered from a contiguous buffer instead, which
+    // is the output FMQ region if it is contiguous, or the work buffer.
+    const auto& inRegion = readTx.getFirstRegion();
+    const auto& outRegion = writeTx.getFirstRegion();
+    const bool inContiguous = inRegion.getLength() >= samples;
+    const bool outContiguous = outRegion.getLength() >= outputSamples;
+    float* in = inContiguous ? inRegion.getAddress() : nullptr;
+    float* out = outContiguous ? outRegion.getAddress() : buffer;
+    if (!inContiguous) {
+        readTx.copyFrom(out, 0 /* startIdx */, samples);
+        in = out;
+    }
+
+    IEffect::Status status = effectProcessImpl(in, out, samples);
+    inputMQ->commitRead(samples);
+    size_t produced = status.fmqProduced;
+    if (produced > outputSamples) {
+        LOG(ERROR) << getEffectNameWithVersion() << __func__ << ": produced " << produced
+                   << " exceeds " << outputSamples;
+        produced = outputSamples;
+    }
+    if (!outContiguous) {
+        writeTx.copyTo(buffer, 0 /* startIdx */, produced);
+    }
+    outputMQ->commitWrite(produced);
+    return status;
+}
+
 // A placeholder processing implementation to copy samples from input to output
 IEffect::Status EffectImpl::effectProcessImpl(float* in, float* out, int samples) {
     for (int i = 0; i < samples; i++) {
@@ -177,7 +177,7 @@ ndk::ScopedAStatus Module::createStreamContext(
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
     auto& configs = getConfig().portConfigs;
-    auto portConfigIt = findById<AudioPortConfig>(configs, in_portConfigId);
+    auto portConfigIt = mPortConfigsIndex.find(configs, in_portConfigId);
     const int32_t nominalLatencyMs = getNominalLatencyMs(*portConfigIt);
     // Since this is a private method, it is assumed that
     // validity of the portConfigId has already been checked.
@@ -203,45 +203,66 @@ ndk::ScopedAStatus Module::createStreamContext(
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
     const auto& flags = portConfigIt->flags.value();
-    if ((flags.getTag() == AudioIoFlags::Tag::input &&
-         !isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::input>(),
-                               AudioInputFlags::MMAP_NOIRQ)) ||
-        (flags.getTag() == AudioIoFlags::Tag::output &&
-         !isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::output>(),
-                               AudioOutputFlags::MMAP_NOIRQ))) {
-        StreamContext::DebugParameters params{mDebug.streamTransientStateDelayMs,
-                                              mVendorDebug.forceTransientBurst,
-                                              mVendorDebug.forceSynchronousDrain};
-        std::shared_ptr<ISoundDose> soundDose;
-        if (!getSoundDose(&soundDose).isOk()) {
-            LOG(ERROR) << __func__ << ": could not create sound dose instance";
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-        }
-        StreamContext temp(
-                std::make_unique<StreamContext::CommandMQ>(1, true /*configureEventFlagWord*/),
-                std::make_unique<StreamContext::ReplyMQ>(1, true /*configureEventFlagWord*/),
-                portConfigIt->format.value(), portConfigIt->channelMask.value(),
-                portConfigIt->sampleRate.value().value, flags, nominalLatencyMs,
-                portConfigIt->ext.get<AudioPortExt::mix>().handle,
-                std::make_unique<StreamContext::DataMQ>(frameSize * in_bufferSizeFrames),
-                asyncCallback, outEventCallback, mSoundDose.getInstance(), params);
-        if (temp.isValid()) {
-            *out_context = std::move(temp);
-        } else {
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-        }
+    const bool isMmap = (flags.getTag() == AudioIoFlags::Tag::input &&
+                         isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::input>(),
+                                              AudioInputFlags::MMAP_NOIRQ)) ||
+                        (flags.getTag() == AudioIoFlags::Tag::output &&
+                         isBitPositionFlagSet(flags.get<AudioIoFlags::Tag::output>(),
+                                              AudioOutputFlags::MMAP_NOIRQ));
+    StreamContext::DebugParameters params{mDebug.streamTransientStateDelayMs,
+                                          mVendorDebug.forceTransientBurst,
+                                          mVendorDebug.forceSynchronousDrain};
+    std::shared_ptr<ISoundDose> soundDose;
+    if (!getSoundDose(&soundDose).isOk()) {
+        LOG(ERROR) << __func__ << ": could not create sound dose instance";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    // MMap streams do not have a data MQ, the shared buffer is created by the stream
+    // implementation once the stream is connected to a device, see 'openStreamMmapBuffer'.
+    StreamContext temp(
+            std::make_unique<StreamContext::CommandMQ>(1, true /*configureEventFlagWord*/),
+            std::make_unique<StreamContext::ReplyMQ>(1, true /*configureEventFlagWord*/),
+            portConfigIt->format.value(), portConfigIt->channelMask.value(),
+            portConfigIt->sampleRate.value().value, flags, nominalLatencyMs,
+            portConfigIt->ext.get<AudioPortExt::mix>().handle,
+            isMmap ? nullptr
+                   : std::make_unique<StreamContext::DataMQ>(frameSize * in_bufferSizeFrames),
+            asyncCallback, outEventCallback, mSoundDose.getInstance(), params,
+            isMmap ? static_cast<size_t>(in_bufferSizeFrames) : 0);
+    if (temp.isValid()) {
+        *out_context = std::move(temp);
     } else {
-        // TODO: Implement simulation of MMAP buffer allocation
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
     return ndk::ScopedAStatus::ok();
 }
 
+ndk::ScopedAStatus Module::openStreamMmapBuffer(
+        int32_t portConfigId, const std::shared_ptr<StreamCommonInterface>& stream,
+        StreamDescriptor* desc) {
+    if (!stream->getContext().isMmap()) {
+        return ndk::ScopedAStatus::ok();
+    }
+    if (mPatches.find(portConfigId) == mPatches.end()) {
+        LOG(ERROR) << __func__ << ": port config id " << portConfigId
+                   << " is not connected, can not create the MMap buffer";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    MmapBufferDescriptor mmapDesc;
+    RETURN_STATUS_IF_ERROR(stream->createMmapBuffer(&mmapDesc));
+    const size_t frameSize = stream->getContext().getFrameSize();
+    desc->frameSizeBytes = frameSize;
+    desc->bufferSizeFrames = mmapDesc.sharedMemory.size / frameSize;
+    desc->audio.set<StreamDescriptor::AudioBuffer::Tag::mmap>(std::move(mmapDesc));
+    return ndk::ScopedAStatus::ok();
+}
+
 std::vector<AudioDevice> Module::findConnectedDevices(int32_t portConfigId) {
     std::vector<AudioDevice> result;
     auto& ports = getConfig().ports;
     auto portIds = portIdsFromPortConfigIds(findConnectedPortConfigIds(portConfigId));
     for (auto it = portIds.begin(); it != portIds.end(); ++it) {
-        auto portIt = findById<AudioPort>(ports, *it);
+        auto portIt = mPortsIndex.find(ports, *it);
         if (portIt != ports.end() && portIt->ext.getTag() == AudioPortExt::Tag::device) {
             result.push_back(portIt->ext.template get<AudioPortExt::Tag::device>().device);
         }
@@ -254,7 +275,7 @@ std::set<int32_t> Module::findConnectedPortConfigIds(int32_t portConfigId) {
     auto patchIdsRange = mPatches.equal_range(portConfigId);
     auto& patches = getConfig().patches;
     for (auto it = patchIdsRange.first; it != patchIdsRange.second; ++it) {
-        auto patchIt = findById<AudioPatch>(patches, it->second);
+        auto patchIt = mPatchesIndex.find(patches, it->second);
         if (patchIt == patches.end()) {
             LOG(FATAL) << __func__ << ": patch with id " << it->second << " taken from mPatches "
                        << "not found in the configuration";
@@ -271,7 +292,7 @@ std::set<int32_t> Module::findConnectedPortConfigIds(int32_t portConfigId) {
 
 ndk::ScopedAStatus Module::findPortIdForNewStream(int32_t in_portConfigId, AudioPort** port) {
     auto& configs = getConfig().portConfigs;
-    auto portConfigIt = findById<AudioPortConfig>(configs, in_portConfigId);
+    auto portConfigIt = mPortConfigsIndex.find(configs, in_portConfigId);
     if (portConfigIt == configs.end()) {
         LOG(ERROR) << __func__ << ": existing port config id " << in_portConfigId << " not found";
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -280,7 +301,7 @@ ndk::ScopedAStatus Module::findPortIdForNewStream(int32_t in_portConfigId, Audio
     // In our implementation, configs of mix ports always have unique IDs.
     CHECK(portId != in_portConfigId);
     auto& ports = getConfig().ports;
-    auto portIt = findById<AudioPort>(ports, portId);
+    auto portIt = mPortsIndex.find(ports, portId);
     if (portIt == ports.end()) {
         LOG(ERROR) << __func__ << ": port id " << portId << " used by port config id "
                    << in_portConfigId << " not found";
@@ -351,7 +372,7 @@ std::set<int32_t> Module::portIdsFromPortConfigIds(C portConfigIds) {
     std::set<int32_t> result;
     auto& portConfigs = getConfig().portConfigs;
     for (auto it = portConfigIds.begin(); it != portConfigIds.end(); ++it) {
-        auto portConfigIt = findById<AudioPortConfig>(portConfigs, *it);
+        auto portConfigIt = mPortConfigsIndex.find(portConfigs, *it);
         if (portConfigIt != portConfigs.end()) {
             result.insert(portConfigIt->portId);
         }
@@ -370,17 +391,38 @@ int32_t Module::getNominalLatencyMs(const AudioPortConfig&) {
 }
 
 std::vector<AudioRoute*> Module::getAudioRoutesForAudioPortImpl(int32_t portId) {
-    std::vector<AudioRoute*> result;
     auto& routes = getConfig().routes;
-    for (auto& r : routes) {
-        const auto& srcs = r.sourcePortIds;
-        if (r.sinkPortId == portId || std::find(srcs.begin(), srcs.end(), portId) != srcs.end()) {
-            result.push_back(&r);
-        }
+    const RoutesIndex& index = getRoutesIndex();
+    // Keep the order of the routes in the configuration.
+    std::set<size_t> positions;
+    if (auto it = index.bySinkPortId.find(portId); it != index.bySinkPortId.end()) {
+        positions.insert(it->second.begin(), it->second.end());
+    }
+    if (auto it = index.bySourcePortId.find(portId); it != index.bySourcePortId.end()) {
+        positions.insert(it->second.begin(), it->second.end());
     }
+    std::vector<AudioRoute*> result;
+    for (size_t position : positions) result.push_back(&routes[position]);
     return result;
 }
 
+const Module::RoutesIndex& Module::getRoutesIndex() {
+    if (!mRoutesIndex.isValid) {
+        mRoutesIndex.bySinkPortId.clear();
+        mRoutesIndex.bySourcePortId.clear();
+        const auto& routes = getConfig().routes;
+        for (size_t i = 0; i < routes.size(); ++i) {
+            mRoutesIndex.bySinkPortId[routes[i].sinkPortId].push_back(i);
+            for (int32_t sourcePortId : std::set<int32_t>(routes[i].sourcePortIds.begin(),
+                                                          routes[i].sourcePortIds.end())) {
+                mRoutesIndex.bySourcePortId[sourcePortId].push_back(i);
+            }
+        }
+        mRoutesIndex.isValid = true;
+    }
+    return mRoutesIndex;
+}
+
 Module::Configuration& Module::getConfig() {
     if (!mConfig) {
         mConfig = std::move(initializeConfig());
@@ -410,7 +452,7 @@ void Module::registerPatch(const AudioPatch& patch) {
     auto& configs = getConfig().portConfigs;
     auto do_insert = [&](const std::vector<int32_t>& portConfigIds) {
         for (auto portConfigId : portConfigIds) {
-            auto configIt = findById<AudioPortConfig>(configs, portConfigId);
+            auto configIt = mPortConfigsIndex.find(configs, portConfigId);
             if (configIt != configs.end()) {
                 mPatches.insert(std::pair{portConfigId, patch.id});
                 if (configIt->portId != portConfigId) {
@@ -555,7 +597,7 @@ ndk::ScopedAStatus Module::connectExternalDevice(const AudioPort& in_templateIdA
     auto& ports = getConfig().ports;
     AudioPort connectedPort;
     {  // Scope the template port so that we don't accidentally modify it.
-        auto templateIt = findById<AudioPort>(ports, templateId);
+        auto templateIt = mPortsIndex.find(ports, templateId);
         if (templateIt == ports.end()) {
             LOG(ERROR) << __func__ << ": port id " << templateId << " not found";
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -584,7 +626,7 @@ ndk::ScopedAStatus Module::connectExternalDevice(const AudioPort& in_templateIdA
                    << connectedDevicePort.device.toString();
         // Check if there is already a connected port with for the same external device.
         for (auto connectedPortPair : mConnectedDevicePorts) {
-            auto connectedPortIt = findById<AudioPort>(ports, connectedPortPair.first);
+            auto connectedPortIt = mPortsIndex.find(ports, connectedPortPair.first);
             if (connectedPortIt->ext.get<AudioPortExt::Tag::device>().device ==
                 connectedDevicePort.device) {
                 LOG(ERROR) << __func__ << ": device " << connectedDevicePort.device.toString()
@@ -669,6 +711,7 @@ ndk::ScopedAStatus Module::connectExternalDevice(const AudioPort& in_templateIdA
     }
     auto& routes = getConfig().routes;
     routes.insert(routes.end(), newRoutes.begin(), newRoutes.end());
+    invalidateRoutesIndex();
 
     if (!hasDynamicProfilesOnly(connectedPort.profiles) && !routableMixPortIds.empty()) {
         // Note: this is a simplistic approach assuming that a mix port can only be populated
@@ -698,7 +741,7 @@ ndk::ScopedAStatus Module::connectExternalDevice(const AudioPort& in_templateIdA
 
 ndk::ScopedAStatus Module::disconnectExternalDevice(int32_t in_portId) {
     auto& ports = getConfig().ports;
-    auto portIt = findById<AudioPort>(ports, in_portId);
+    auto portIt = mPortsIndex.find(ports, in_portId);
     if (portIt == ports.end()) {
         LOG(ERROR) << __func__ << ": port id " << in_portId << " not found";
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -742,6 +785,7 @@ ndk::ScopedAStatus Module::disconnectExternalDevice(int32_t in_portId) {
             ++routesIt;
         }
     }
+    invalidateRoutesIndex();
 
     // Clear profiles for mix ports that are not connected to any other ports.
     std::set<int32_t> mixPortsToClear = std::move(connectedPortsIt->second);
@@ -752,7 +796,7 @@ ndk::ScopedAStatus Module::disconnectExternalDevice(int32_t in_portId) {
         }
     }
     for (int32_t mixPortId : mixPortsToClear) {
-        auto mixPortIt = findById<AudioPort>(ports, mixPortId);
+        auto mixPortIt = mPortsIndex.find(ports, mixPortId);
         if (mixPortIt != ports.end()) {
             mixPortIt->profiles = {};
         }
@@ -763,7 +807,7 @@ ndk::ScopedAStatus Module::disconnectExternalDevice(int32_t in_portId) {
 
 ndk::ScopedAStatus Module::prepareToDisconnectExternalDevice(int32_t in_portId) {
     auto& ports = getConfig().ports;
-    auto portIt = findById<AudioPort>(ports, in_portId);
+    auto portIt = mPortsIndex.find(ports, in_portId);
     if (portIt == ports.end()) {
         LOG(ERROR) << __func__ << ": port id " << in_portId << " not found";
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -791,7 +835,7 @@ ndk::ScopedAStatus Module::getAudioPatches(std::vector<AudioPatch>* _aidl_return
 
 ndk::ScopedAStatus Module::getAudioPort(int32_t in_portId, AudioPort* _aidl_return) {
     auto& ports = getConfig().ports;
-    auto portIt = findById<AudioPort>(ports, in_portId);
+    auto portIt = mPortsIndex.find(ports, in_portId);
     if (portIt != ports.end()) {
         *_aidl_return = *portIt;
         LOG(DEBUG) << __func__ << ": returning port by id " << in_portId;
@@ -822,7 +866,7 @@ ndk::ScopedAStatus Module::getAudioRoutes(std::vector<AudioRoute>* _aidl_return)
 ndk::ScopedAStatus Module::getAudioRoutesForAudioPort(int32_t in_portId,
                                                       std::vector<AudioRoute>* _aidl_return) {
     auto& ports = getConfig().ports;
-    if (auto portIt = findById<AudioPort>(ports, in_portId); portIt == ports.end()) {
+    if (auto portIt = mPortsIndex.find(ports, in_portId); portIt == ports.end()) {
         LOG(ERROR) << __func__ << ": port id " << in_portId << " not found";
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
@@ -855,6 +899,7 @@ ndk::ScopedAStatus Module::openInputStream(const OpenInputStreamArguments& in_ar
         RETURN_STATUS_IF_ERROR(
                 streamWrapper.setConnectedDevices(findConnectedDevices(in_args.portConfigId)));
     }
+    RETURN_STATUS_IF_ERROR(openStreamMmapBuffer(in_args.portConfigId, stream, &_aidl_return->desc));
     AIBinder_setMinSchedulerPolicy(streamWrapper.getBinder().get(), SCHED_NORMAL,
                                    ANDROID_PRIORITY_AUDIO);
     mStreams.insert(port->id, in_args.portConfigId, std::move(streamWrapper));
@@ -901,6 +946,7 @@ ndk::ScopedAStatus Module::openOutputStream(const OpenOutputStreamArguments& in_
         RETURN_STATUS_IF_ERROR(
                 streamWrapper.setConnectedDevices(findConnectedDevices(in_args.portConfigId)));
     }
+    RETURN_STATUS_IF_ERROR(openStreamMmapBuffer(in_args.portConfigId, stream, &_aidl_return->desc));
     AIBinder_setMinSchedulerPolicy(streamWrapper.getBinder().get(), SCHED_NORMAL,
                                    ANDROID_PRIORITY_AUDIO);
     mStreams.insert(port->id, in_args.portConfigId, std::move(streamWrapper));
@@ -937,13 +983,13 @@ ndk::ScopedAStatus Module::setAudioPatch(const AudioPatch& in_requested, AudioPa
     auto& configs = getConfig().portConfigs;
     std::vector<int32_t> missingIds;
     auto sources =
-            selectByIds<AudioPortConfig>(configs, in_requested.sourcePortConfigIds, &missingIds);
+            mPortConfigsIndex.select(configs, in_requested.sourcePortConfigIds, &missingIds);
     if (!missingIds.empty()) {
         LOG(ERROR) << __func__ << ": following source port config ids not found: "
                    << ::android::internal::ToString(missingIds);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
-    auto sinks = selectByIds<AudioPortConfig>(configs, in_requested.sinkPortConfigIds, &missingIds);
+    auto sinks = mPortConfigsIndex.select(configs, in_requested.sinkPortConfigIds, &missingIds);
     if (!missingIds.empty()) {
         LOG(ERROR) << __func__ << ": following sink port config ids not found: "
                    << ::android::internal::ToString(missingIds);
@@ -954,13 +1000,14 @@ ndk::ScopedAStatus Module::setAudioPatch(const AudioPatch& in_requested, AudioPa
     // established if there is any other patch which currently uses the sink port.
     std::map<int32_t, bool> allowedSinkPorts;
     auto& routes = getConfig().routes;
+    const RoutesIndex& routesIndex = getRoutesIndex();
     for (auto src : sources) {
-        for (const auto& r : routes) {
-            const auto& srcs = r.sourcePortIds;
-            if (std::find(srcs.begin(), srcs.end(), src->portId) != srcs.end()) {
-                if (!allowedSinkPorts[r.sinkPortId]) {  // prefer non-exclusive
-                    allowedSinkPorts[r.sinkPortId] = !r.isExclusive;
-                }
+        auto positionsIt = routesIndex.bySourcePortId.find(src->portId);
+        if (positionsIt == routesIndex.bySourcePortId.end()) continue;
+        for (size_t position : positionsIt->second) {
+            const auto& r = routes[position];
+            if (!allowedSinkPorts[r.sinkPortId]) {  // prefer non-exclusive
+                allowedSinkPorts[r.sinkPortId] = !r.isExclusive;
             }
         }
     }
@@ -976,7 +1023,7 @@ ndk::ScopedAStatus Module::setAudioPatch(const AudioPatch& in_requested, AudioPa
     auto existing = patches.end();
     std::optional<decltype(mPatches)> patchesBackup;
     if (in_requested.id != 0) {
-        existing = findById<AudioPatch>(patches, in_requested.id);
+        existing = mPatchesIndex.find(patches, in_requested.id);
         if (existing != patches.end()) {
             patchesBackup = mPatches;
             cleanUpPatch(existing->id);
@@ -1054,7 +1101,7 @@ ndk::ScopedAStatus Module::setAudioPortConfigImpl(
     auto& configs = getConfig().portConfigs;
     auto existing = configs.end();
     if (in_requested.id != 0) {
-        if (existing = findById<AudioPortConfig>(configs, in_requested.id);
+        if (existing = mPortConfigsIndex.find(configs, in_requested.id);
             existing == configs.end()) {
             LOG(ERROR) << __func__ << ": existing port config id " << in_requested.id
                        << " not found";
@@ -1068,7 +1115,7 @@ ndk::ScopedAStatus Module::setAudioPortConfigImpl(
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
     auto& ports = getConfig().ports;
-    auto portIt = findById<AudioPort>(ports, portId);
+    auto portIt = mPortsIndex.find(ports, portId);
     if (portIt == ports.end()) {
         LOG(ERROR) << __func__ << ": requested port config points to non-existent portId "
                    << portId;
@@ -1201,7 +1248,7 @@ ndk::ScopedAStatus Module::setAudioPortConfigImpl(
 
 ndk::ScopedAStatus Module::resetAudioPatch(int32_t in_patchId) {
     auto& patches = getConfig().patches;
-    auto patchIt = findById<AudioPatch>(patches, in_patchId);
+    auto patchIt = mPatchesIndex.find(patches, in_patchId);
     if (patchIt != patches.end()) {
         auto patchesBackup = mPatches;
         cleanUpPatch(patchIt->id);
@@ -1219,7 +1266,7 @@ ndk::ScopedAStatus Module::resetAudioPatch(int32_t in_patchId) {
 
 ndk::ScopedAStatus Module::resetAudioPortConfig(int32_t in_portConfigId) {
     auto& configs = getConfig().portConfigs;
-    auto configIt = findById<AudioPortConfig>(configs, in_portConfigId);
+    auto configIt = mPortConfigsIndex.find(configs, in_portConfigId);
     if (configIt != configs.end()) {
         if (mStreams.count(in_portConfigId) != 0) {
             LOG(ERROR) << __func__ << ": port config id " << in_portConfigId
@@ -1462,7 +1509,7 @@ ndk::ScopedAStatus Module::getMmapPolicyInfos(AudioMMapPolicyType mmapPolicyType
         if (mmapSinks.count(route.sinkPortId) != 0) {
             // The sink is a mix port, add the sources if they are device ports.
             for (int sourcePortId : route.sourcePortIds) {
-                auto sourcePortIt = findById<AudioPort>(ports, sourcePortId);
+                auto sourcePortIt = mPortsIndex.find(ports, sourcePortId);
                 if (sourcePortIt == ports.end()) {
                     // This must not happen
                     LOG(ERROR) << __func__ << ": port id " << sourcePortId << " cannot be found";
@@ -1480,7 +1527,7 @@ ndk::ScopedAStatus Module::getMmapPolicyInfos(AudioMMapPolicyType mmapPolicyType
                 _aidl_return->push_back(policyInfo);
             }
         } else {
-            auto sinkPortIt = findById<AudioPort>(ports, route.sinkPortId);
+            auto sinkPortIt = mPortsIndex.find(ports, route.sinkPortId);
             if (sinkPortIt == ports.end()) {
                 // This must not happen
                 LOG(ERROR) << __func__ << ": port id " << route.sinkPortId << " cannot be found";
@@ -18,9 +18,15 @@
 
 #include "core-impl/SoundDose.h"
 
+#include <pthread.h>
+#include <sys/resource.h>
+
 #include <aidl/android/hardware/audio/core/sounddose/ISoundDose.h>
 #include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
 #include <media/AidlConversionCppNdk.h>
+#include <system/audio.h>
+#include <system/thread_defs.h>
 #include <utils/Timers.h>
 
 using aidl::android::hardware::audio::core::sounddose::ISoundDose;
@@ -30,6 +36,17 @@ using aidl::android::media::audio::common::AudioFormatDescription;
 
 namespace aidl::android::hardware::audio::core::sounddose {
 
+SoundDose::~SoundDose() {
+    {
+        std::lock_guard l(mHelperMutex);
+        mHelperExit = true;
+    }
+    mHelperCv.notify_one();
+    if (mHelper.joinable()) {
+        mHelper.join();
+    }
+}
+
 ndk::ScopedAStatus SoundDose::setOutputRs2UpperBound(float in_rs2ValueDbA) {
     if (in_rs2ValueDbA < MIN_RS2 || in_rs2ValueDbA > DEFAULT_MAX_RS2) {
         LOG(ERROR) << __func__ << ": RS2 value is invalid: " << in_rs2ValueDbA;
@@ -72,6 +89,9 @@ ndk::ScopedAStatus SoundDose::registerSoundDoseCallback(
 
 void SoundDose::setAudioDevice(const AudioDevice& audioDevice) {
     ::android::audio_utils::lock_guard l(mCbMutex);
+    if (mAudioDevice != audioDevice) {
+        deliverMelValues_l();
+    }
     mAudioDevice = audioDevice;
 }
 
@@ -86,19 +106,112 @@ void SoundDose::startDataProcessor(uint32_t sampleRate, uint32_t channelCount,
         mMelProcessor = ::android::sp<::android::audio_utils::MelProcessor>::make(
                 sampleRate, channelCount, format, mMelCallback, /*deviceId=*/0, mRs2Value);
     } else {
+        // The pending data is still in the previous format.
+        processPendingData_l();
         mMelProcessor->updateAudioFormat(sampleRate, channelCount, format);
     }
+
+    const size_t capacity = format != AUDIO_FORMAT_INVALID
+                                    ? audio_bytes_per_frame(channelCount, format) * sampleRate *
+                                              kMaxPendingDataDuration.count() / 1000
+                                    : 0;
+    mProcessingData.reserve(capacity);
+    {
+        std::lock_guard l(mHelperMutex);
+        mPendingData.reserve(capacity);
+        mPendingDataCapacity = capacity;
+    }
+    if (!mHelper.joinable()) {
+        mHelper = std::thread(&SoundDose::helperLoop, this);
+    }
 }
 
 void SoundDose::process(const void* buffer, size_t bytes) {
+    {
+        std::lock_guard l(mHelperMutex);
+        if (mPendingData.size() + bytes <= mPendingDataCapacity) {
+            const uint8_t* data = static_cast<const uint8_t*>(buffer);
+            mPendingData.insert(mPendingData.end(), data, data + bytes);
+            mHelperCv.notify_one();
+            return;
+        }
+    }
+    // The helper is too far behind, catch up on this thread, keeping the order of the data.
     ::android::audio_utils::lock_guard l(mMutex);
+    processPendingData_l();
     if (mMelProcessor != nullptr) {
         mMelProcessor->process(buffer, bytes);
     }
 }
 
+void SoundDose::processPendingData_l() {
+    {
+        std::lock_guard l(mHelperMutex);
+        if (mPendingData.empty()) return;
+        // Both buffers have the same capacity, swapping never allocates.
+        mProcessingData.swap(mPendingData);
+    }
+    if (mMelProcessor != nullptr) {
+        mMelProcessor->process(mProcessingData.data(), mProcessingData.size());
+    }
+    mProcessingData.clear();
+}
+
+bool SoundDose::isMelDeliveryDue_l() const {
+    return mMelDeliveryDeadline.has_value() &&
+           std::chrono::steady_clock::now() >= mMelDeliveryDeadline.value();
+}
+
+void SoundDose::helperLoop() {
+    pthread_setname_np(pthread_self(), "SoundDose");
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_BACKGROUND);
+    bool exit = false;
+    while (!exit) {
+        bool hasPendingData, isMelDeliveryDue;
+        {
+            std::unique_lock l(mHelperMutex);
+            ::android::base::ScopedLockAssertion lock_assertion(mHelperMutex);
+            while (!mHelperExit && mPendingData.empty() && !isMelDeliveryDue_l()) {
+                if (mMelDeliveryDeadline.has_value()) {
+                    mHelperCv.wait_until(l, mMelDeliveryDeadline.value());
+                } else {
+                    mHelperCv.wait(l);
+                }
+            }
+            // Everything pending is handled before exiting.
+            exit = mHelperExit;
+            hasPendingData = !mPendingData.empty();
+            isMelDeliveryDue = exit || isMelDeliveryDue_l();
+        }
+        if (hasPendingData) {
+            ::android::audio_utils::lock_guard l(mMutex);
+            processPendingData_l();
+        }
+        if (isMelDeliveryDue) {
+            ::android::audio_utils::lock_guard l(mCbMutex);
+            deliverMelValues_l();
+        }
+    }
+}
+
+void SoundDose::deliverMelValues_l() {
+    if (mPendingMelCount == 0) return;
+    ISoundDose::IHalSoundDoseCallback::MelRecord melRecord;
+    melRecord.timestamp = mPendingMelTimestamp;
+    melRecord.melValues = std::vector<float>(mPendingMelValues.begin(),
+                                             mPendingMelValues.begin() + mPendingMelCount);
+    mPendingMelCount = 0;
+    {
+        std::lock_guard l(mHelperMutex);
+        mMelDeliveryDeadline.reset();
+    }
+    if (mCallback != nullptr && mAudioDevice.has_value()) {
+        mCallback->onNewMelValues(melRecord, mAudioDevice.value());
+    }
+}
+
 void SoundDose::onNewMelValues(const std::vector<float>& mels, size_t offset, size_t length,
-                               audio_port_handle_t deviceId __attribute__((__unused__))) const {
+                               audio_port_handle_t deviceId __attribute__((__unused__))) {
     ::android::audio_utils::lock_guard l(mCbMutex);
     if (!mAudioDevice.has_value()) {
         LOG(WARNING) << __func__ << ": New mel values without a registered device";
@@ -109,11 +222,24 @@ void SoundDose::onNewMelValues(const std::vector<float>& mels, size_t offset, si
         return;
     }
 
-    ISoundDose::IHalSoundDoseCallback::MelRecord melRecord;
-    melRecord.timestamp = nanoseconds_to_seconds(systemTime());
-    melRecord.melValues = std::vector<float>(mels.begin() + offset, mels.begin() + offset + length);
-
-    mCallback->onNewMelValues(melRecord, mAudioDevice.value());
+    // There is one MEL value per second, a record only holds contiguous values.
+    const int64_t timestamp = nanoseconds_to_seconds(systemTime());
+    if (mPendingMelCount > 0 &&
+        timestamp > mPendingMelTimestamp + static_cast<int64_t>(mPendingMelCount) + 1) {
+        deliverMelValues_l();
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (mPendingMelCount == mPendingMelValues.size()) {
+            deliverMelValues_l();
+        }
+        if (mPendingMelCount == 0) {
+            mPendingMelTimestamp = timestamp + static_cast<int64_t>(i);
+            std::lock_guard l(mHelperMutex);
+            mMelDeliveryDeadline = std::chrono::steady_clock::now() + mMelDeliveryInterval;
+            mHelperCv.notify_one();
+        }
+        mPendingMelValues[mPendingMelCount++] = mels[offset + i];
+    }
 }
 
 void SoundDose::MelCallback::onNewMelValues(const std::vector<float>& mels, size_t offset,
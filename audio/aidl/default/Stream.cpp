@@ -42,6 +42,7 @@ using aidl::android::media::audio::common::AudioOutputFlags;
 using aidl::android::media::audio::common::AudioPlaybackRate;
 using aidl::android::media::audio::common::MicrophoneDynamicInfo;
 using aidl::android::media::audio::common::MicrophoneInfo;
+using android::hardware::audio::common::WorkerSchedulingPolicy;
 
 namespace aidl::android::hardware::audio::core {
 
@@ -63,13 +64,22 @@ size_t StreamContext::getBufferSizeInFrames() const {
     if (mDataMQ) {
         return mDataMQ->getQuantumCount() * mDataMQ->getQuantumSize() / getFrameSize();
     }
-    return 0;
+    return mMmapBufferSizeFrames;
 }
 
 size_t StreamContext::getFrameSize() const {
     return getFrameSizeInBytes(mFormat, mChannelLayout);
 }
 
+bool StreamContext::isMmap() const {
+    return (mFlags.getTag() == AudioIoFlags::Tag::input &&
+            isBitPositionFlagSet(mFlags.get<AudioIoFlags::Tag::input>(),
+                                 AudioInputFlags::MMAP_NOIRQ)) ||
+           (mFlags.getTag() == AudioIoFlags::Tag::output &&
+            isBitPositionFlagSet(mFlags.get<AudioIoFlags::Tag::output>(),
+                                 AudioOutputFlags::MMAP_NOIRQ));
+}
+
 bool StreamContext::isValid() const {
     if (mCommandMQ && !mCommandMQ->isValid()) {
         LOG(ERROR) << "command FMQ is invalid";
@@ -115,17 +125,22 @@ pid_t StreamWorkerCommonLogic::getTid() const {
 std::string StreamWorkerCommonLogic::init() {
     if (mContext->getCommandMQ() == nullptr) return "Command MQ is null";
     if (mContext->getReplyMQ() == nullptr) return "Reply MQ is null";
-    StreamContext::DataMQ* const dataMQ = mContext->getDataMQ();
-    if (dataMQ == nullptr) return "Data MQ is null";
-    if (sizeof(DataBufferElement) != dataMQ->getQuantumSize()) {
-        return "Unexpected Data MQ quantum size: " + std::to_string(dataMQ->getQuantumSize());
-    }
-    mDataBufferSize = dataMQ->getQuantumCount() * dataMQ->getQuantumSize();
-    mDataBuffer.reset(new (std::nothrow) DataBufferElement[mDataBufferSize]);
-    if (mDataBuffer == nullptr) {
-        return "Failed to allocate data buffer for element count " +
-               std::to_string(dataMQ->getQuantumCount()) +
-               ", size in bytes: " + std::to_string(mDataBufferSize);
+    if (mContext->isMmap()) {
+        // Audio data is exchanged via the shared buffer, the data buffer is not used.
+        mDataBufferSize = 0;
+    } else {
+        StreamContext::DataMQ* const dataMQ = mContext->getDataMQ();
+        if (dataMQ == nullptr) return "Data MQ is null";
+        if (sizeof(DataBufferElement) != dataMQ->getQuantumSize()) {
+            return "Unexpected Data MQ quantum size: " + std::to_string(dataMQ->getQuantumSize());
+        }
+        mDataBufferSize = dataMQ->getQuantumCount() * dataMQ->getQuantumSize();
+        mDataBuffer.reset(new (std::nothrow) DataBufferElement[mDataBufferSize]);
+        if (mDataBuffer == nullptr) {
+            return "Failed to allocate data buffer for element count " +
+                   std::to_string(dataMQ->getQuantumCount()) +
+                   ", size in bytes: " + std::to_string(mDataBufferSize);
+        }
     }
     if (::android::status_t status = mDriver->init(); status != STATUS_OK) {
         return "Failed to initialize the driver: " + std::to_string(status);
@@ -136,7 +151,18 @@ std::string StreamWorkerCommonLogic::init() {
 void StreamWorkerCommonLogic::populateReply(StreamDescriptor::Reply* reply,
                                             bool isConnected) const {
     reply->status = STATUS_OK;
-    if (isConnected) {
+    if (mContext->isMmap()) {
+        if (isConnected &&
+            mDriver->getMmapPositionAndLatency(&reply->hardware, &reply->latencyMs) ==
+                    ::android::OK) {
+            // The hardware position is the only position known to the HAL.
+            reply->observable = reply->hardware;
+            return;
+        }
+        reply->hardware.frames = StreamDescriptor::Position::UNKNOWN;
+        reply->hardware.timeNs = StreamDescriptor::Position::UNKNOWN;
+        reply->latencyMs = StreamDescriptor::LATENCY_UNKNOWN;
+    } else if (isConnected) {
         reply->observable.frames = mContext->getFrameCount();
         reply->observable.timeNs = ::android::uptimeNanos();
         if (auto status = mDriver->refinePosition(&reply->observable); status == ::android::OK) {
@@ -169,6 +195,8 @@ StreamInWorkerLogic::Status StreamInWorkerLogic::cycle() {
         mState = StreamDescriptor::State::ERROR;
         return Status::ABORT;
     }
+    // Waiting for the command does not count towards the cycle time.
+    onCycleWorkStarted();
     using Tag = StreamDescriptor::Command::Tag;
     using LogSeverity = ::android::base::LogSeverity;
     const LogSeverity severity =
@@ -313,6 +341,11 @@ StreamInWorkerLogic::Status StreamInWorkerLogic::cycle() {
 
 bool StreamInWorkerLogic::read(size_t clientSize, StreamDescriptor::Reply* reply) {
     ATRACE_CALL();
+    if (mContext->isMmap()) {
+        // The client reads directly from the shared buffer, only report the position.
+        populateReply(reply, mIsConnected);
+        return true;
+    }
     StreamContext::DataMQ* const dataMQ = mContext->getDataMQ();
     const size_t byteCount = std::min({clientSize, dataMQ->availableToWrite(), mDataBufferSize});
     const bool isConnected = mIsConnected;
@@ -392,6 +425,8 @@ StreamOutWorkerLogic::Status StreamOutWorkerLogic::cycle() {
         mState = StreamDescriptor::State::ERROR;
         return Status::ABORT;
     }
+    // Waiting for the command does not count towards the cycle time.
+    onCycleWorkStarted();
     using Tag = StreamDescriptor::Command::Tag;
     using LogSeverity = ::android::base::LogSeverity;
     const LogSeverity severity =
@@ -585,6 +620,11 @@ StreamOutWorkerLogic::Status StreamOutWorkerLogic::cycle() {
 
 bool StreamOutWorkerLogic::write(size_t clientSize, StreamDescriptor::Reply* reply) {
     ATRACE_CALL();
+    if (mContext->isMmap()) {
+        // The client writes directly into the shared buffer, only report the position.
+        populateReply(reply, mIsConnected);
+        return true;
+    }
     StreamContext::DataMQ* const dataMQ = mContext->getDataMQ();
     const size_t readByteCount = dataMQ->availableToRead();
     const size_t frameSize = mContext->getFrameSize();
@@ -644,9 +684,24 @@ StreamCommonImpl::~StreamCommonImpl() {
 ndk::ScopedAStatus StreamCommonImpl::initInstance(
         const std::shared_ptr<StreamCommonInterface>& delegate) {
     mCommon = ndk::SharedRefBase::make<StreamCommonDelegator>(delegate);
+    mWorker->setSchedulingPolicy(getWorkerSchedulingPolicy());
     if (!mWorker->start()) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+    if (std::string error = mWorker->getSchedulingError(); !error.empty()) {
+        // The host process might be lacking the capability to request a real-time scheduler,
+        // thus a failure to set it is not an error.
+        LOG(WARNING) << __func__ << ": failed to apply the worker scheduling policy: " << error;
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+WorkerSchedulingPolicy StreamCommonImpl::getWorkerSchedulingPolicy() const {
+    WorkerSchedulingPolicy policy;
+    // One cycle is expected to complete within one buffer period.
+    policy.periodNs = std::chrono::nanoseconds(
+                              std::chrono::milliseconds(getContext().getNominalLatencyMs()))
+                              .count();
     if (auto flags = getContext().getFlags();
         (flags.getTag() == AudioIoFlags::Tag::input &&
          isBitPositionFlagSet(flags.template get<AudioIoFlags::Tag::input>(),
@@ -654,20 +709,15 @@ ndk::ScopedAStatus StreamCommonImpl::initInstance(
         (flags.getTag() == AudioIoFlags::Tag::output &&
          isBitPositionFlagSet(flags.template get<AudioIoFlags::Tag::output>(),
                               AudioOutputFlags::FAST))) {
-        // FAST workers should be run with a SCHED_FIFO scheduler, however the host process
-        // might be lacking the capability to request it, thus a failure to set is not an error.
-        pid_t workerTid = mWorker->getTid();
-        if (workerTid > 0) {
-            struct sched_param param;
-            param.sched_priority = 3;  // Must match SchedulingPolicyService.PRIORITY_MAX (Java).
-            if (sched_setscheduler(workerTid, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
-                PLOG(WARNING) << __func__ << ": failed to set FIFO scheduler for a fast thread";
-            }
-        } else {
-            LOG(WARNING) << __func__ << ": invalid worker tid: " << workerTid;
-        }
+        // FAST workers should be run with a SCHED_FIFO scheduler.
+        policy.policy = WorkerSchedulingPolicy::Policy::FIFO;
+        policy.fifoPriority = 3;  // Must match SchedulingPolicyService.PRIORITY_MAX (Java).
     }
-    return ndk::ScopedAStatus::ok();
+    return policy;
+}
+
+std::string StreamCommonImpl::dumpWorker() const {
+    return mWorker->dump();
 }
 
 ndk::ScopedAStatus StreamCommonImpl::getStreamCommonCommon(
@@ -784,6 +834,23 @@ ndk::ScopedAStatus StreamCommonImpl::bluetoothParametersUpdated() {
     return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
 }
 
+ndk::ScopedAStatus StreamCommonImpl::createMmapBuffer(MmapBufferDescriptor* desc) {
+    LOG(DEBUG) << __func__;
+    if (!mContext.isMmap()) {
+        LOG(ERROR) << __func__ << ": the stream is not opened in MMap No IRQ mode";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    if (mConnectedDevices.empty()) {
+        LOG(ERROR) << __func__ << ": the stream is not connected to devices";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    if (::android::status_t status = openMmapBuffer(desc); status != ::android::OK) {
+        LOG(ERROR) << __func__ << ": failed to open the MMap buffer: " << status;
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
 namespace {
 static std::map<AudioDevice, std::string> transformMicrophones(
         const std::vector<MicrophoneInfo>& microphones) {
@@ -803,6 +870,11 @@ void StreamIn::defaultOnClose() {
     mContextInstance.reset();
 }
 
+binder_status_t StreamIn::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    dprintf(fd, "\nWorker:\n%s\n", dumpWorker().c_str());
+    return STATUS_OK;
+}
+
 ndk::ScopedAStatus StreamIn::getActiveMicrophones(
         std::vector<MicrophoneDynamicInfo>* _aidl_return) {
     std::vector<MicrophoneDynamicInfo> result;
@@ -890,6 +962,11 @@ void StreamOut::defaultOnClose() {
     mContextInstance.reset();
 }
 
+binder_status_t StreamOut::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    dprintf(fd, "\nWorker:\n%s\n", dumpWorker().c_str());
+    return STATUS_OK;
+}
+
 ndk::ScopedAStatus StreamOut::updateOffloadMetadata(
         const AudioOffloadMetadata& in_offloadMetadata) {
     LOG(DEBUG) << __func__;
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <future>
 #include <limits>
 
 #define LOG_TAG "AHAL_StreamSwitcher"
@@ -46,6 +47,16 @@ ndk::ScopedAStatus StreamSwitcher::closeCurrentStream(bool validateStreamState)
     return ndk::ScopedAStatus::ok();
 }
 
+void StreamSwitcher::discardStream(std::unique_ptr<StreamCommonInterfaceEx> stream) {
+    // A stream which was never started would post its exit command into the queues of
+    // the context on destruction. Start and close it instead, this is safe because
+    // 'closeCurrentStream' only fails after the current stream has been closed.
+    if (!stream) return;
+    if (stream->initInstance(nullptr).isOk()) {
+        (void)stream->close();
+    }
+}
+
 ndk::ScopedAStatus StreamSwitcher::close() {
     if (mStream != nullptr) {
         auto status = closeCurrentStream(false /*validateStreamState*/);
@@ -184,15 +195,28 @@ ndk::ScopedAStatus StreamSwitcher::setConnectedDevices(const std::vector<AudioDe
         LOG(FATAL) << __func__
                    << ": switching to stub stream with connected devices is not allowed";
     }
+    std::optional<std::chrono::steady_clock::time_point> switchStart;
     if (behavior == USE_CURRENT_STREAM) {
         mIsStubStream = false;
     } else {
         LOG(DEBUG) << __func__ << ": connected devices changed, switching stream";
-        // Two streams can't be opened for the same context, thus we always need to close
-        // the current one before creating a new one.
-        RETURN_STATUS_IF_ERROR(closeCurrentStream(true /*validateStreamState*/));
+        switchStart = std::chrono::steady_clock::now();
+        // Two streams can't be running for the same context, thus the current one must be
+        // closed before the new one is started. However, the new stream does not use
+        // the queues of the context until 'initInstance', thus it is created while
+        // the worker of the current stream is shutting down.
+        std::future<std::unique_ptr<StreamCommonInterfaceEx>> newStream;
+        if (behavior == CREATE_NEW_STREAM) {
+            newStream = std::async(std::launch::async, [this, devices, metadata = mMetadata]() {
+                return createNewStream(devices, mContext, metadata);
+            });
+        }
+        if (auto status = closeCurrentStream(true /*validateStreamState*/); !status.isOk()) {
+            if (newStream.valid()) discardStream(newStream.get());
+            return status;
+        }
         if (behavior == CREATE_NEW_STREAM) {
-            mStream = createNewStream(devices, mContext, mMetadata);
+            mStream = newStream.get();
             mIsStubStream = false;
         } else {  // SWITCH_TO_STUB_STREAM
             mStream.reset(new InnerStreamWrapper<StreamStub>(mContext, mMetadata));
@@ -245,6 +269,14 @@ ndk::ScopedAStatus StreamSwitcher::setConnectedDevices(const std::vector<AudioDe
         }
         mBluetoothParametersUpdated = false;
     }
+    if (switchStart.has_value()) {
+        mLastSwitchDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - switchStart.value());
+        mMaxSwitchDuration = std::max(mMaxSwitchDuration, mLastSwitchDuration);
+        ++mSwitchCount;
+        LOG(DEBUG) << __func__ << ": the stream was offline for " << mLastSwitchDuration.count()
+                   << " us";
+    }
     return ndk::ScopedAStatus::ok();
 }
 
@@ -260,4 +292,31 @@ ndk::ScopedAStatus StreamSwitcher::bluetoothParametersUpdated() {
     return mStream->bluetoothParametersUpdated();
 }
 
+ndk::ScopedAStatus StreamSwitcher::createMmapBuffer(MmapBufferDescriptor* desc) {
+    if (mStream == nullptr) {
+        LOG(ERROR) << __func__ << ": stream was closed";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    if (mIsStubStream) {
+        // The buffer can not be moved to another stream instance after switching.
+        LOG(ERROR) << __func__ << ": not supported for the stub stream";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    return mStream->createMmapBuffer(desc);
+}
+
+std::string StreamSwitcher::dumpWorker() const {
+    std::string result = mStream != nullptr ? mStream->dumpWorker() : "";
+    if (mSwitchCount != 0) {
+        result.append("\nstream switches: ")
+                .append(std::to_string(mSwitchCount))
+                .append(", last offline: ")
+                .append(std::to_string(mLastSwitchDuration.count()))
+                .append(" us, max: ")
+                .append(std::to_string(mMaxSwitchDuration.count()))
+                .append(" us");
+    }
+    return result;
+}
+
 }  // namespace aidl::android::hardware::audio::core
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#define LOG_TAG "AHAL_AlsaDeviceWriter"
+#include <android-base/logging.h>
+#include <audio_utils/clock.h>
+
+#include "alsa/DeviceWriter.h"
+
+namespace aidl::android::hardware::audio::core::alsa {
+
+namespace {
+
+// The writer thread wakes up at least this often to check whether it must exit.
+struct timespec getReadTimeout(size_t bufferSizeFrames, int sampleRate) {
+    const int64_t timeoutNs =
+            std::min<int64_t>(2 * bufferSizeFrames * NANOS_PER_SECOND / sampleRate,
+                              100 * NANOS_PER_MILLISECOND);
+    return {.tv_sec = static_cast<time_t>(timeoutNs / NANOS_PER_SECOND),
+            .tv_nsec = static_cast<long>(timeoutNs % NANOS_PER_SECOND)};
+}
+
+}  // namespace
+
+// The FIFO holds two stream buffers, this leaves one buffer of headroom for the device
+// which is temporarily slower than the stream.
+DeviceWriterLogic::DeviceWriterLogic(DeviceProxy proxy, size_t frameSizeBytes,
+                                     size_t bufferSizeFrames, int sampleRate, int readWriteRetries)
+    : mProxy(std::move(proxy)),
+      mFrameSizeBytes(frameSizeBytes),
+      mFifoFrameCount(2 * bufferSizeFrames),
+      mSampleRate(sampleRate),
+      mReadWriteRetries(readWriteRetries),
+      mReadTimeout(getReadTimeout(bufferSizeFrames, sampleRate)),
+      mFifoBuffer(new int8_t[mFifoFrameCount * frameSizeBytes]),
+      mFifo(mFifoFrameCount, frameSizeBytes, mFifoBuffer.get()),
+      mFifoWriter(mFifo),
+      mFifoReader(mFifo),
+      mTransferBuffer(new int8_t[bufferSizeFrames * frameSizeBytes]),
+      mTransferFrameCount(bufferSizeFrames) {}
+
+DeviceWriterLogic::~DeviceWriterLogic() {
+    LOG(DEBUG) << __func__ << ": written " << mWrittenFrameCount << " frames, dropped "
+               << mDroppedFrameCount << " frames, underruns " << mUnderrunCount;
+}
+
+void DeviceWriterLogic::push(const void* buffer, size_t frameCount) {
+    // A null timeout makes the write non-blocking.
+    const ssize_t written = mFifoWriter.write(buffer, frameCount, nullptr /*timeout*/);
+    const size_t pushed = written > 0 ? static_cast<size_t>(written) : 0;
+    if (pushed < frameCount) {
+        mDroppedFrameCount += frameCount - pushed;
+        LOG(VERBOSE) << __func__ << ": dropped " << frameCount - pushed << " frames";
+    }
+}
+
+int32_t DeviceWriterLogic::getLatencyMs() {
+    const ssize_t available = mFifoWriter.available();
+    const size_t queuedFrames =
+            available >= 0 ? mFifoFrameCount - static_cast<size_t>(available) : 0;
+    const uint64_t latencyMs = mDeviceLatencyMs + queuedFrames * MILLIS_PER_SECOND / mSampleRate;
+    return static_cast<int32_t>(
+            std::min<uint64_t>(latencyMs, std::numeric_limits<int32_t>::max()));
+}
+
+std::string DeviceWriterLogic::init() {
+    if (mProxy.get() == nullptr) return "Device proxy is null";
+    return "";
+}
+
+DeviceWriterLogic::Status DeviceWriterLogic::cycle() {
+    const ssize_t frameCount =
+            mFifoReader.read(mTransferBuffer.get(), mTransferFrameCount, &mReadTimeout);
+    if (frameCount <= 0) {
+        // Only count the transition into the empty state, the stream may also be paused.
+        if (mIsTransferring) {
+            ++mUnderrunCount;
+            mIsTransferring = false;
+        }
+        return Status::CONTINUE;
+    }
+    // Waiting for the data does not count towards the cycle time.
+    onCycleWorkStarted();
+    mIsTransferring = true;
+    proxy_write_with_retries(mProxy.get(), mTransferBuffer.get(), frameCount * mFrameSizeBytes,
+                             mReadWriteRetries);
+    mWrittenFrameCount += frameCount;
+    mDeviceLatencyMs = proxy_get_latency(mProxy.get());
+    return Status::CONTINUE;
+}
+
+}  // namespace aidl::android::hardware::audio::core::alsa
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <StreamWorker.h>
+#include <audio_utils/fifo.h>
+
+#include "alsa/Utils.h"
+
+namespace aidl::android::hardware::audio::core::alsa {
+
+// Writes to one ALSA output device on its own thread, so that a slow device does not stall
+// the stream worker and the other devices of the same stream. The stream worker pushes data
+// into a lock-free single producer, single consumer FIFO, which the writer thread drains.
+class DeviceWriterLogic : public ::android::hardware::audio::common::StreamLogic {
+  public:
+    DeviceWriterLogic(DeviceProxy proxy, size_t frameSizeBytes, size_t bufferSizeFrames,
+                      int sampleRate, int readWriteRetries);
+    ~DeviceWriterLogic();
+
+    // The methods below are called on the stream worker thread only.
+    // Never blocks. The frames that do not fit into the FIFO are dropped.
+    void push(const void* buffer, size_t frameCount);
+    // The latency of the device, including the frames waiting in the FIFO.
+    int32_t getLatencyMs();
+
+    // These can be called from any thread.
+    uint64_t getWrittenFrameCount() const { return mWrittenFrameCount; }
+    uint64_t getDroppedFrameCount() const { return mDroppedFrameCount; }
+    uint64_t getUnderrunCount() const { return mUnderrunCount; }
+
+  protected:
+    std::string init() override;
+    Status cycle() override;
+
+  private:
+    DeviceProxy mProxy;
+    const size_t mFrameSizeBytes;
+    const size_t mFifoFrameCount;
+    const int mSampleRate;
+    const int mReadWriteRetries;
+    const struct timespec mReadTimeout;
+    std::unique_ptr<int8_t[]> mFifoBuffer;
+    audio_utils_fifo mFifo;
+    audio_utils_fifo_writer mFifoWriter;  // Only used on the stream worker thread.
+    audio_utils_fifo_reader mFifoReader;  // Only used on the writer thread.
+    // All fields below are only used on the writer thread, except for atomics.
+    std::unique_ptr<int8_t[]> mTransferBuffer;
+    const size_t mTransferFrameCount;
+    bool mIsTransferring = false;
+    std::atomic<unsigned> mDeviceLatencyMs = 0;
+    std::atomic<uint64_t> mWrittenFrameCount = 0;
+    std::atomic<uint64_t> mDroppedFrameCount = 0;
+    std::atomic<uint64_t> mUnderrunCount = 0;
+};
+using DeviceWriter = ::android::hardware::audio::common::StreamWorker<DeviceWriterLogic>;
+
+}  // namespace aidl::android::hardware::audio::core::alsa
@@ -55,13 +55,37 @@ const std::map<Mixer::Control, std::vector<Mixer::ControlNamesAndExpectedCtlType
 // static
 Mixer::Controls Mixer::initializeMixerControls(struct mixer* mixer) {
     if (mixer == nullptr) return {};
+    // Go over the controls of the card once, rather than searching them for every candidate name.
+    std::map<std::string, struct mixer_ctl*> ctlsByName;
+    for (const auto& [control, possibleCtls] : kPossibleControls) {
+        for (const auto& [ctlName, expectedCtlType] : possibleCtls) {
+            ctlsByName.emplace(ctlName, nullptr);
+        }
+    }
+    const unsigned int numCtls = mixer_get_num_ctls(mixer);
+    for (unsigned int id = 0; id < numCtls; id++) {
+        struct mixer_ctl* ctl = mixer_get_ctl(mixer, id);
+        const char* name = ctl != nullptr ? mixer_ctl_get_name(ctl) : nullptr;
+        if (name == nullptr) continue;
+        // Like 'mixer_get_ctl_by_name', use the first control with a given name.
+        if (auto it = ctlsByName.find(name); it != ctlsByName.end() && it->second == nullptr) {
+            it->second = ctl;
+        }
+    }
+
     Controls mixerControls;
     std::string mixerCtlNames;
     for (const auto& [control, possibleCtls] : kPossibleControls) {
         for (const auto& [ctlName, expectedCtlType] : possibleCtls) {
-            struct mixer_ctl* ctl = mixer_get_ctl_by_name(mixer, ctlName.c_str());
+            struct mixer_ctl* ctl = ctlsByName[ctlName];
             if (ctl != nullptr && mixer_ctl_get_type(ctl) == expectedCtlType) {
-                mixerControls.emplace(control, ctl);
+                ControlHandle& handle = mixerControls[control];
+                handle.ctl = ctl;
+                handle.numValues = mixer_ctl_get_num_values(ctl);
+                if (expectedCtlType == MIXER_CTL_TYPE_INT) {
+                    handle.min = mixer_ctl_get_range_min(ctl);
+                    handle.max = mixer_ctl_get_range_max(ctl);
+                }
                 if (!mixerCtlNames.empty()) {
                     mixerCtlNames += ",";
                 }
@@ -99,6 +123,12 @@ Mixer::Mixer(int card) : mMixer(mixer_open(card)), mMixerControls(initializeMixe
     if (!isValid()) {
         PLOG(ERROR) << __func__ << ": failed to open mixer for card=" << card;
     }
+    unsigned int maxNumValues = 0;
+    for (const auto& handle : mMixerControls) {
+        maxNumValues = std::max(maxNumValues, handle.numValues);
+    }
+    std::lock_guard l(mMixerAccess);
+    mCtlValues.resize(maxNumValues);
 }
 
 Mixer::~Mixer() {
@@ -125,11 +155,11 @@ ndk::ScopedAStatus Mixer::getMicMute(bool* muted) {
 }
 
 ndk::ScopedAStatus Mixer::getVolumes(std::vector<float>* volumes) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(Mixer::HW_VOLUME, &mctl));
     std::vector<int> percents;
     std::lock_guard l(mMixerAccess);
-    if (int err = getMixerControlPercent(mctl, &percents); err != 0) {
+    if (int err = getMixerControlPercent(*mctl, &percents); err != 0) {
         LOG(ERROR) << __func__ << ": failed to get volume, err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
@@ -155,37 +185,37 @@ ndk::ScopedAStatus Mixer::setMicMute(bool muted) {
 }
 
 ndk::ScopedAStatus Mixer::setVolumes(const std::vector<float>& volumes) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(Mixer::HW_VOLUME, &mctl));
     std::vector<int> percents;
     std::transform(
             volumes.begin(), volumes.end(), std::back_inserter(percents),
             [](float volume) -> int { return std::floor(std::clamp(volume, 0.0f, 1.0f) * 100); });
     std::lock_guard l(mMixerAccess);
-    if (int err = setMixerControlPercent(mctl, percents); err != 0) {
+    if (int err = setMixerControlPercent(*mctl, percents); err != 0) {
         LOG(ERROR) << __func__ << ": failed to set volume, err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Mixer::findControl(Control ctl, struct mixer_ctl** result) {
+ndk::ScopedAStatus Mixer::findControl(Control ctl, const ControlHandle** result) {
     if (!isValid()) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
-    if (auto it = mMixerControls.find(ctl); it != mMixerControls.end()) {
-        *result = it->second;
+    if (const ControlHandle& handle = mMixerControls[ctl]; handle.ctl != nullptr) {
+        *result = &handle;
         return ndk::ScopedAStatus::ok();
     }
     return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
 }
 
 ndk::ScopedAStatus Mixer::getMixerControlMute(Control ctl, bool* muted) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(ctl, &mctl));
     std::lock_guard l(mMixerAccess);
     std::vector<int> mutedValues;
-    if (int err = getMixerControlValues(mctl, &mutedValues); err != 0) {
+    if (int err = getMixerControlValues(*mctl, &mutedValues); err != 0) {
         LOG(ERROR) << __func__ << ": failed to get " << ctl << ", err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
@@ -198,11 +228,11 @@ ndk::ScopedAStatus Mixer::getMixerControlMute(Control ctl, bool* muted) {
 }
 
 ndk::ScopedAStatus Mixer::getMixerControlVolume(Control ctl, float* volume) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(ctl, &mctl));
     std::lock_guard l(mMixerAccess);
     std::vector<int> percents;
-    if (int err = getMixerControlPercent(mctl, &percents); err != 0) {
+    if (int err = getMixerControlPercent(*mctl, &percents); err != 0) {
         LOG(ERROR) << __func__ << ": failed to get " << ctl << ", err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
@@ -215,10 +245,10 @@ ndk::ScopedAStatus Mixer::getMixerControlVolume(Control ctl, float* volume) {
 }
 
 ndk::ScopedAStatus Mixer::setMixerControlMute(Control ctl, bool muted) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(ctl, &mctl));
     std::lock_guard l(mMixerAccess);
-    if (int err = setMixerControlValue(mctl, muted ? 0 : 1); err != 0) {
+    if (int err = setMixerControlValue(*mctl, muted ? 0 : 1); err != 0) {
         LOG(ERROR) << __func__ << ": failed to set " << ctl << " to " << muted << ", err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
@@ -226,72 +256,59 @@ ndk::ScopedAStatus Mixer::setMixerControlMute(Control ctl, bool muted) {
 }
 
 ndk::ScopedAStatus Mixer::setMixerControlVolume(Control ctl, float volume) {
-    struct mixer_ctl* mctl;
+    const ControlHandle* mctl;
     RETURN_STATUS_IF_ERROR(findControl(ctl, &mctl));
     volume = std::clamp(volume, 0.0f, 1.0f);
     std::lock_guard l(mMixerAccess);
-    if (int err = setMixerControlPercent(mctl, std::floor(volume * 100)); err != 0) {
+    if (int err = setMixerControlPercent(*mctl, std::floor(volume * 100)); err != 0) {
         LOG(ERROR) << __func__ << ": failed to set " << ctl << " to " << volume << ", err=" << err;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
     return ndk::ScopedAStatus::ok();
 }
 
-int Mixer::getMixerControlPercent(struct mixer_ctl* ctl, std::vector<int>* percents) {
-    const unsigned int n = mixer_ctl_get_num_values(ctl);
-    percents->resize(n);
-    for (unsigned int id = 0; id < n; id++) {
-        if (int valueOrError = mixer_ctl_get_percent(ctl, id); valueOrError >= 0) {
-            (*percents)[id] = valueOrError;
-        } else {
-            return valueOrError;
-        }
+int Mixer::getMixerControlPercent(const ControlHandle& ctl, std::vector<int>* percents) {
+    if (int error = readMixerControl(ctl); error != 0) {
+        return error;
+    }
+    percents->resize(ctl.numValues);
+    for (unsigned int id = 0; id < ctl.numValues; id++) {
+        (*percents)[id] = ctl.valueToPercent(mCtlValues[id]);
     }
     return 0;
 }
 
-int Mixer::getMixerControlValues(struct mixer_ctl* ctl, std::vector<int>* values) {
-    const unsigned int n = mixer_ctl_get_num_values(ctl);
-    values->resize(n);
-    for (unsigned int id = 0; id < n; id++) {
-        if (int valueOrError = mixer_ctl_get_value(ctl, id); valueOrError >= 0) {
-            (*values)[id] = valueOrError;
-        } else {
-            return valueOrError;
-        }
+int Mixer::getMixerControlValues(const ControlHandle& ctl, std::vector<int>* values) {
+    if (int error = readMixerControl(ctl); error != 0) {
+        return error;
     }
+    values->assign(mCtlValues.begin(), mCtlValues.begin() + ctl.numValues);
     return 0;
 }
 
-int Mixer::setMixerControlPercent(struct mixer_ctl* ctl, int percent) {
-    const unsigned int n = mixer_ctl_get_num_values(ctl);
-    for (unsigned int id = 0; id < n; id++) {
-        if (int error = mixer_ctl_set_percent(ctl, id, percent); error != 0) {
-            return error;
-        }
-    }
-    return 0;
+int Mixer::setMixerControlPercent(const ControlHandle& ctl, int percent) {
+    std::fill_n(mCtlValues.begin(), ctl.numValues, ctl.percentToValue(percent));
+    return writeMixerControl(ctl);
 }
 
-int Mixer::setMixerControlPercent(struct mixer_ctl* ctl, const std::vector<int>& percents) {
-    const unsigned int n = mixer_ctl_get_num_values(ctl);
-    for (unsigned int id = 0; id < n; id++) {
-        if (int error = mixer_ctl_set_percent(ctl, id, id < percents.size() ? percents[id] : 0);
-            error != 0) {
-            return error;
-        }
+int Mixer::setMixerControlPercent(const ControlHandle& ctl, const std::vector<int>& percents) {
+    for (unsigned int id = 0; id < ctl.numValues; id++) {
+        mCtlValues[id] = ctl.percentToValue(id < percents.size() ? percents[id] : 0);
     }
-    return 0;
+    return writeMixerControl(ctl);
 }
 
-int Mixer::setMixerControlValue(struct mixer_ctl* ctl, int value) {
-    const unsigned int n = mixer_ctl_get_num_values(ctl);
-    for (unsigned int id = 0; id < n; id++) {
-        if (int error = mixer_ctl_set_value(ctl, id, value); error != 0) {
-            return error;
-        }
-    }
-    return 0;
+int Mixer::setMixerControlValue(const ControlHandle& ctl, int value) {
+    std::fill_n(mCtlValues.begin(), ctl.numValues, value);
+    return writeMixerControl(ctl);
+}
+
+int Mixer::readMixerControl(const ControlHandle& ctl) {
+    return mixer_ctl_get_array(ctl.ctl, mCtlValues.data(), ctl.numValues);
+}
+
+int Mixer::writeMixerControl(const ControlHandle& ctl) {
+    return mixer_ctl_set_array(ctl.ctl, mCtlValues.data(), ctl.numValues);
 }
 
 }  // namespace aidl::android::hardware::audio::core::alsa
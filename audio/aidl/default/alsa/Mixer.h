@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <array>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -58,27 +59,45 @@ class Mixer {
         MIC_SWITCH,
         MIC_GAIN,
     };
+    static constexpr size_t kControlCount = MIC_GAIN + 1;
     using ControlNamesAndExpectedCtlType = std::pair<std::string, enum mixer_ctl_type>;
-    using Controls = std::map<Control, struct mixer_ctl*>;
+    // A control resolved at startup, along with the properties needed to access it.
+    struct ControlHandle {
+        struct mixer_ctl* ctl = nullptr;
+        unsigned int numValues = 0;
+        // The range of an integer control, percents are converted using it.
+        long min = 0;
+        long max = 0;
+
+        long percentToValue(int percent) const { return min + (max - min) * percent / 100; }
+        int valueToPercent(long value) const {
+            return max == min ? 0 : static_cast<int>((value - min) * 100 / (max - min));
+        }
+    };
+    // Indexed by Control, missing controls have a null 'ctl'.
+    using Controls = std::array<ControlHandle, kControlCount>;
 
     friend std::ostream& operator<<(std::ostream&, Control);
     static const std::map<Control, std::vector<ControlNamesAndExpectedCtlType>> kPossibleControls;
     static Controls initializeMixerControls(struct mixer* mixer);
 
-    ndk::ScopedAStatus findControl(Control ctl, struct mixer_ctl** result);
+    ndk::ScopedAStatus findControl(Control ctl, const ControlHandle** result);
     ndk::ScopedAStatus getMixerControlMute(Control ctl, bool* muted);
     ndk::ScopedAStatus getMixerControlVolume(Control ctl, float* volume);
     ndk::ScopedAStatus setMixerControlMute(Control ctl, bool muted);
     ndk::ScopedAStatus setMixerControlVolume(Control ctl, float volume);
 
-    int getMixerControlPercent(struct mixer_ctl* ctl, std::vector<int>* percents)
+    // All the values of a control are read or written at once, with a single ioctl.
+    int getMixerControlPercent(const ControlHandle& ctl, std::vector<int>* percents)
             REQUIRES(mMixerAccess);
-    int getMixerControlValues(struct mixer_ctl* ctl, std::vector<int>* values)
+    int getMixerControlValues(const ControlHandle& ctl, std::vector<int>* values)
             REQUIRES(mMixerAccess);
-    int setMixerControlPercent(struct mixer_ctl* ctl, int percent) REQUIRES(mMixerAccess);
-    int setMixerControlPercent(struct mixer_ctl* ctl, const std::vector<int>& percents)
+    int setMixerControlPercent(const ControlHandle& ctl, int percent) REQUIRES(mMixerAccess);
+    int setMixerControlPercent(const ControlHandle& ctl, const std::vector<int>& percents)
             REQUIRES(mMixerAccess);
-    int setMixerControlValue(struct mixer_ctl* ctl, int value) REQUIRES(mMixerAccess);
+    int setMixerControlValue(const ControlHandle& ctl, int value) REQUIRES(mMixerAccess);
+    int readMixerControl(const ControlHandle& ctl) REQUIRES(mMixerAccess);
+    int writeMixerControl(const ControlHandle& ctl) REQUIRES(mMixerAccess);
 
     // Since ALSA functions do not use internal locking, enforce thread safety at our level.
     std::mutex mMixerAccess;
@@ -88,6 +107,8 @@ class Mixer {
     // read but not be modified. Each mixer_ctl object is owned by ALSA, it's life span is
     // the same as of the mixer itself.
     const Controls mMixerControls;
+    // Values of the control being read or written, sized for the control with the most values.
+    std::vector<long> mCtlValues GUARDED_BY(mMixerAccess);
 };
 
 }  // namespace aidl::android::hardware::audio::core::alsa
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "AHAL_ModuleAlsa"
 
+#include <mutex>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -39,6 +40,20 @@ ndk::ScopedAStatus ModuleAlsa::populateConnectedDevicePort(AudioPort* audioPort,
     if (!deviceProfile.has_value()) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
+
+    // Probing opens the PCM, which takes long enough to stall routing on every reconnection.
+    const ProfileCacheKey key{deviceProfile->card, deviceProfile->device,
+                              deviceProfile->direction,
+                              alsa::getCardIdentity(deviceProfile->card)};
+    {
+        std::lock_guard<std::mutex> lock(mProfileCacheLock);
+        if (auto it = mProfileCache.find(key); it != mProfileCache.end()) {
+            audioPort->profiles.insert(audioPort->profiles.end(), it->second.begin(),
+                                       it->second.end());
+            return ndk::ScopedAStatus::ok();
+        }
+    }
+
     auto proxy = alsa::readAlsaDeviceInfo(*deviceProfile);
     if (proxy.get() == nullptr) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -48,6 +63,7 @@ ndk::ScopedAStatus ModuleAlsa::populateConnectedDevicePort(AudioPort* audioPort,
     std::vector<AudioChannelLayout> channels = alsa::getChannelMasksFromProfile(profile);
     std::vector<int> sampleRates = alsa::getSampleRatesFromProfile(profile);
 
+    std::vector<AudioProfile> audioProfiles;
     for (size_t i = 0; i < std::min(MAX_PROFILE_FORMATS, AUDIO_PORT_MAX_AUDIO_PROFILES) &&
                        profile->formats[i] != PCM_FORMAT_INVALID;
          ++i) {
@@ -60,9 +76,27 @@ ndk::ScopedAStatus ModuleAlsa::populateConnectedDevicePort(AudioPort* audioPort,
         AudioProfile audioProfile = {.format = audioFormatDescription,
                                      .channelMasks = channels,
                                      .sampleRates = sampleRates};
-        audioPort->profiles.push_back(std::move(audioProfile));
+        audioProfiles.push_back(std::move(audioProfile));
+    }
+    audioPort->profiles.insert(audioPort->profiles.end(), audioProfiles.begin(),
+                               audioProfiles.end());
+    if (!key.cardIdentity.empty()) {
+        std::lock_guard<std::mutex> lock(mProfileCacheLock);
+        mProfileCache[key] = std::move(audioProfiles);
     }
     return ndk::ScopedAStatus::ok();
 }
 
+void ModuleAlsa::invalidateProfileCache(int card) {
+    const std::string cardIdentity = alsa::getCardIdentity(card);
+    std::lock_guard<std::mutex> lock(mProfileCacheLock);
+    for (auto it = mProfileCache.begin(); it != mProfileCache.end();) {
+        if (it->first.card == card && it->first.cardIdentity != cardIdentity) {
+            it = mProfileCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 }  // namespace aidl::android::hardware::audio::core
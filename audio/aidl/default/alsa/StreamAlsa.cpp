@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
+#include <unistd.h>
+
 #define LOG_TAG "AHAL_StreamAlsa"
 #include <android-base/logging.h>
 
@@ -35,7 +38,8 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
       mSampleRate(getContext().getSampleRate()),
       mIsInput(isInput(metadata)),
       mConfig(alsa::getPcmConfig(getContext(), mIsInput)),
-      mReadWriteRetries(readWriteRetries) {}
+      mReadWriteRetries(readWriteRetries),
+      mIsMmap(getContext().isMmap()) {}
 
 ::android::status_t StreamAlsa::init() {
     return mConfig.has_value() ? ::android::OK : ::android::NO_INIT;
@@ -60,11 +64,34 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
 }
 
 ::android::status_t StreamAlsa::standby() {
+    if (mIsMmap) {
+        if (mMmapStarted) {
+            pcm_stop(mMmapPcm.get());
+            mMmapStarted = false;
+        }
+        return ::android::OK;
+    }
+    mDeviceWriters.clear();
     mAlsaDeviceProxies.clear();
     return ::android::OK;
 }
 
 ::android::status_t StreamAlsa::start() {
+    if (mIsMmap) {
+        if (mMmapPcm == nullptr) {
+            LOG(ERROR) << __func__ << ": the MMap buffer was not opened";
+            return ::android::NO_INIT;
+        }
+        if (!mMmapStarted) {
+            if (int ret = pcm_start(mMmapPcm.get()); ret != 0) {
+                LOG(ERROR) << __func__ << ": failed to start MMap PCM: "
+                           << pcm_get_error(mMmapPcm.get());
+                return ::android::INVALID_OPERATION;
+            }
+            mMmapStarted = true;
+        }
+        return ::android::OK;
+    }
     if (!mAlsaDeviceProxies.empty()) {
         // This is a resume after a pause.
         return ::android::OK;
@@ -88,12 +115,36 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
         }
         alsaDeviceProxies.push_back(std::move(proxy));
     }
+    decltype(mDeviceWriters) deviceWriters;
+    if (!mIsInput) {
+        // The first device paces the worker thread and provides the position.
+        const auto schedulingPolicy = getWorkerSchedulingPolicy();
+        while (alsaDeviceProxies.size() > 1) {
+            auto writer = std::make_unique<alsa::DeviceWriter>(
+                    std::move(alsaDeviceProxies.back()), mFrameSizeBytes, mBufferSizeFrames,
+                    mSampleRate, mReadWriteRetries);
+            alsaDeviceProxies.pop_back();
+            writer->setSchedulingPolicy(schedulingPolicy);
+            if (!writer->start("alsa_writer_" + std::to_string(alsaDeviceProxies.size()),
+                               ANDROID_PRIORITY_URGENT_AUDIO)) {
+                LOG(ERROR) << __func__ << ": failed to start device writer: "
+                           << writer->getError();
+                return ::android::NO_INIT;
+            }
+            deviceWriters.push_back(std::move(writer));
+        }
+    }
     mAlsaDeviceProxies = std::move(alsaDeviceProxies);
+    mDeviceWriters = std::move(deviceWriters);
     return ::android::OK;
 }
 
 ::android::status_t StreamAlsa::transfer(void* buffer, size_t frameCount, size_t* actualFrameCount,
                                          int32_t* latencyMs) {
+    if (mIsMmap) {
+        LOG(ERROR) << __func__ << ": no data transfer for MMap streams";
+        return ::android::INVALID_OPERATION;
+    }
     if (mAlsaDeviceProxies.empty()) {
         LOG(FATAL) << __func__ << ": no opened devices";
         return ::android::NO_INIT;
@@ -106,9 +157,15 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
                                 mReadWriteRetries);
         maxLatency = proxy_get_latency(mAlsaDeviceProxies[0].get());
     } else {
-        for (auto& proxy : mAlsaDeviceProxies) {
-            proxy_write_with_retries(proxy.get(), buffer, bytesToTransfer, mReadWriteRetries);
-            maxLatency = std::max(maxLatency, proxy_get_latency(proxy.get()));
+        // Feed the other devices first, so that they work in parallel with the first one.
+        for (auto& writer : mDeviceWriters) {
+            writer->push(buffer, frameCount);
+        }
+        proxy_write_with_retries(mAlsaDeviceProxies[0].get(), buffer, bytesToTransfer,
+                                 mReadWriteRetries);
+        maxLatency = proxy_get_latency(mAlsaDeviceProxies[0].get());
+        for (auto& writer : mDeviceWriters) {
+            maxLatency = std::max(maxLatency, static_cast<unsigned>(writer->getLatencyMs()));
         }
     }
     *actualFrameCount = frameCount;
@@ -151,8 +208,99 @@ StreamAlsa::StreamAlsa(StreamContext* context, const Metadata& metadata, int rea
     return ::android::OK;
 }
 
+::android::status_t StreamAlsa::openMmapBuffer(MmapBufferDescriptor* desc) {
+    if (!mIsMmap || !mConfig.has_value()) {
+        return ::android::INVALID_OPERATION;
+    }
+    if (mMmapPcm != nullptr) {
+        LOG(ERROR) << __func__ << ": the MMap buffer is already opened";
+        return ::android::INVALID_OPERATION;
+    }
+    const auto deviceProfiles = getDeviceProfiles();
+    if (deviceProfiles.empty()) {
+        LOG(ERROR) << __func__ << ": no connected devices";
+        return ::android::NO_INIT;
+    }
+    if (deviceProfiles.size() > 1) {
+        LOG(WARNING) << __func__ << ": only the first of " << deviceProfiles.size()
+                     << " devices is used in MMap mode";
+    }
+    const auto& device = deviceProfiles[0];
+    // The hardware runs freely over the whole buffer, the client keeps its own pointer
+    // at a safe distance from the hardware pointer.
+    struct pcm_config config = mConfig.value();
+    config.period_count = kMmapPeriodCount;
+    config.period_size = std::max<size_t>(1, mBufferSizeFrames / kMmapPeriodCount);
+    config.start_threshold = 0;
+    config.stop_threshold = std::numeric_limits<int>::max();
+    config.silence_threshold = 0;
+    config.silence_size = 0;
+    config.avail_min = config.period_size;
+    MmapPcm pcm(pcm_open(device.card, device.device,
+                         (mIsInput ? PCM_IN : PCM_OUT) | PCM_MMAP | PCM_NOIRQ | PCM_MONOTONIC,
+                         &config),
+                pcm_close);
+    if (pcm == nullptr || !pcm_is_ready(pcm.get())) {
+        LOG(ERROR) << __func__ << ": failed to open MMap PCM for " << device << ": "
+                   << (pcm != nullptr ? pcm_get_error(pcm.get()) : "");
+        return ::android::NO_INIT;
+    }
+    void* area = nullptr;
+    unsigned int offset = 0;
+    unsigned int frames = pcm_get_buffer_size(pcm.get());
+    if (int ret = pcm_mmap_begin(pcm.get(), &area, &offset, &frames); ret != 0) {
+        LOG(ERROR) << __func__ << ": failed to map the buffer: " << pcm_get_error(pcm.get());
+        return ::android::NO_INIT;
+    }
+    // The application pointer is not used for the data exchange, only the DMA buffer mapping.
+    if (int ret = pcm_mmap_commit(pcm.get(), offset, frames); ret < 0) {
+        LOG(ERROR) << __func__ << ": failed to commit the buffer: " << pcm_get_error(pcm.get());
+        return ::android::NO_INIT;
+    }
+    // The client maps the DMA buffer via a duplicate of the PCM file descriptor.
+    const int fd = dup(pcm_get_poll_fd(pcm.get()));
+    if (fd < 0) {
+        PLOG(ERROR) << __func__ << ": failed to duplicate the PCM file descriptor";
+        return ::android::NO_INIT;
+    }
+    desc->sharedMemory.fd = ndk::ScopedFileDescriptor(fd);
+    desc->sharedMemory.size = pcm_frames_to_bytes(pcm.get(), pcm_get_buffer_size(pcm.get()));
+    desc->burstSizeFrames = config.period_size;
+    // The PCM file descriptor also gives access to the device controls, thus the buffer
+    // must not be shared with untrusted applications.
+    desc->flags = 0;
+    mMmapBurstSizeFrames = config.period_size;
+    mMmapPcm = std::move(pcm);
+    LOG(DEBUG) << __func__ << ": opened MMap buffer for " << device << ", size "
+               << desc->sharedMemory.size << " bytes, burst " << desc->burstSizeFrames << " frames";
+    return ::android::OK;
+}
+
+::android::status_t StreamAlsa::getMmapPositionAndLatency(StreamDescriptor::Position* position,
+                                                          int32_t* latencyMs) {
+    if (mMmapPcm == nullptr) {
+        return ::android::NO_INIT;
+    }
+    unsigned int hwPtr = 0;
+    struct timespec timestamp = {};
+    // This fails while the PCM is not running, the position is unknown in this case.
+    if (int ret = pcm_mmap_get_hw_ptr(mMmapPcm.get(), &hwPtr, &timestamp); ret != 0) {
+        return ::android::INVALID_OPERATION;
+    }
+    position->frames = hwPtr;
+    position->timeNs = audio_utils_ns_from_timespec(&timestamp);
+    *latencyMs = static_cast<int32_t>(mMmapBurstSizeFrames * MILLIS_PER_SECOND / mSampleRate);
+    return ::android::OK;
+}
+
 void StreamAlsa::shutdown() {
+    mDeviceWriters.clear();
     mAlsaDeviceProxies.clear();
+    if (mMmapStarted) {
+        pcm_stop(mMmapPcm.get());
+        mMmapStarted = false;
+    }
+    mMmapPcm.reset();
 }
 
 }  // namespace aidl::android::hardware::audio::core
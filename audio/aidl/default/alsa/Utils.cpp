@@ -21,7 +21,9 @@
 #include <Utils.h>
 #include <aidl/android/media/audio/common/AudioFormatType.h>
 #include <aidl/android/media/audio/common/PcmType.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/strings.h>
 
 #include "Utils.h"
 #include "core-impl/utils.h"
@@ -323,6 +325,18 @@ DeviceProxy openProxyForExternalDevice(const DeviceProfile& deviceProfile,
     return proxy;
 }
 
+std::string getCardIdentity(int card) {
+    const std::string cardDir = "/proc/asound/card" + std::to_string(card);
+    std::string id;
+    if (!::android::base::ReadFileToString(cardDir + "/id", &id)) {
+        return "";
+    }
+    // Only present for USB devices.
+    std::string usbId;
+    ::android::base::ReadFileToString(cardDir + "/usbid", &usbId);
+    return ::android::base::Trim(usbId) + "/" + ::android::base::Trim(id);
+}
+
 DeviceProxy readAlsaDeviceInfo(const DeviceProfile& deviceProfile) {
     DeviceProxy proxy(deviceProfile);
     if (!profile_read_device_info(proxy.getProfile())) {
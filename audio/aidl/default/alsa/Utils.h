@@ -20,6 +20,7 @@
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include <aidl/android/media/audio/common/AudioChannelLayout.h>
@@ -71,6 +72,9 @@ std::optional<DeviceProfile> getDeviceProfile(
         const ::aidl::android::media::audio::common::AudioDevice& audioDevice, bool isInput);
 std::optional<DeviceProfile> getDeviceProfile(
         const ::aidl::android::media::audio::common::AudioPort& audioPort);
+// Returns the identity of the hardware behind an ALSA card: its USB vendor and product ids if it
+// is a USB device, and its card id. Returns an empty string if the card is not present.
+std::string getCardIdentity(int card);
 std::optional<struct pcm_config> getPcmConfig(const StreamContext& context, bool isInput);
 std::vector<int> getSampleRatesFromProfile(const alsa_device_profile* profile);
 DeviceProxy openProxyForAttachedDevice(const DeviceProfile& deviceProfile,
@@ -21,6 +21,7 @@
 #include <Utils.h>
 #include <android-base/logging.h>
 #include <audio_utils/clock.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
 #include "core-impl/StreamBluetooth.h"
@@ -69,6 +70,7 @@ StreamBluetooth::StreamBluetooth(StreamContext* context, const Metadata& metadat
                                                  1000),
       mPreferredFrameCount(
               frameCountFromDurationUs(mPreferredDataIntervalUs, pcmConfig.sampleRateHz)),
+      mSampleRate(pcmConfig.sampleRateHz),
       mBtDeviceProxy(btDeviceProxy) {}
 
 ::android::status_t StreamBluetooth::init() {
@@ -80,13 +82,49 @@ StreamBluetooth::StreamBluetooth(StreamContext* context, const Metadata& metadat
     return ::android::OK;
 }
 
-::android::status_t StreamBluetooth::drain(StreamDescriptor::DrainMode) {
-    usleep(1000);
+::android::status_t StreamBluetooth::drain(StreamDescriptor::DrainMode mode) {
+    if (mIsInput) {
+        return ::android::OK;
+    }
+    // Wait for the BT stack to send out the data queued in the BT HAL, or all but the last data
+    // interval of it when the client wants to be notified early to queue the next track.
+    const int64_t remainingUs = mode == StreamDescriptor::DrainMode::DRAIN_EARLY_NOTIFY
+                                        ? (int64_t)mPreferredDataIntervalUs
+                                        : 0;
+    std::unique_lock lock(mLock);
+    if (mBtDeviceProxy == nullptr || mBtDeviceProxy->getState() != BluetoothStreamState::STARTED) {
+        return ::android::OK;
+    }
+    refreshPresentationPositionLocked(true /*force*/);
+    // Do not wait for longer than it would take to play the queued data, plus a data interval
+    // for the BT stack to pick it up.
+    const int64_t startNs = ::android::uptimeNanos();
+    const int64_t deadlineNs =
+            startNs + (framesToUs(getQueuedFramesLocked(startNs)) +
+                       (int64_t)mPreferredDataIntervalUs) *
+                              NANOS_PER_MICROSECOND;
+    while (true) {
+        const int64_t nowNs = ::android::uptimeNanos();
+        const int64_t queuedUs = framesToUs(getQueuedFramesLocked(nowNs));
+        if (!mPresentationPosition.has_value() || queuedUs <= remainingUs || nowNs >= deadlineNs) {
+            break;
+        }
+        lock.unlock();
+        usleep(std::min<int64_t>(queuedUs - remainingUs, mPreferredDataIntervalUs));
+        lock.lock();
+        if (mBtDeviceProxy == nullptr) {
+            break;
+        }
+        refreshPresentationPositionLocked(true /*force*/);
+    }
     return ::android::OK;
 }
 
 ::android::status_t StreamBluetooth::flush() {
-    usleep(1000);
+    // The BT HAL has no way of dropping the data queued in it. The stream is paused, that is,
+    // suspended, at this point, so only forget about it.
+    std::lock_guard guard(mLock);
+    resetPositionLocked();
     return ::android::OK;
 }
 
@@ -96,7 +134,7 @@ StreamBluetooth::StreamBluetooth(StreamContext* context, const Metadata& metadat
 
 ::android::status_t StreamBluetooth::transfer(void* buffer, size_t frameCount,
                                               size_t* actualFrameCount, int32_t* latencyMs) {
-    std::lock_guard guard(mLock);
+    std::unique_lock lock(mLock);
     if (mBtDeviceProxy == nullptr || mBtDeviceProxy->getState() == BluetoothStreamState::DISABLED) {
         *actualFrameCount = 0;
         *latencyMs = StreamDescriptor::LATENCY_UNKNOWN;
@@ -104,30 +142,110 @@ StreamBluetooth::StreamBluetooth(StreamContext* context, const Metadata& metadat
     }
     *actualFrameCount = 0;
     *latencyMs = 0;
-    if (!mBtDeviceProxy->start()) {
+    // The state is only changed by the proxy, so the proxy is only asked to start the stream
+    // after the stream has been put in standby or suspended by the BT stack.
+    if (mBtDeviceProxy->getState() != BluetoothStreamState::STARTED && !mBtDeviceProxy->start()) {
         LOG(ERROR) << __func__ << ": state= " << mBtDeviceProxy->getState() << " failed to start";
         return -EIO;
     }
+    refreshPresentationPositionLocked(false /*force*/);
     const size_t fc = std::min(frameCount, mPreferredFrameCount);
+    if (!mIsInput) {
+        // Rather than blocking in the write, holding the lock, until the BT stack makes room,
+        // wait for it to send enough of the queued data. The wait is capped at the duration of
+        // the buffer, in case the position of the BT stack lags.
+        const int64_t excessUs =
+                framesToUs(getQueuedFramesLocked(::android::uptimeNanos()) + (int64_t)fc) -
+                kMaxQueuedIntervals * (int64_t)mPreferredDataIntervalUs;
+        if (excessUs > 0) {
+            lock.unlock();
+            ATRACE_INT("BTpacingUs", excessUs);
+            usleep(std::min<int64_t>(excessUs, framesToUs(fc)));
+            lock.lock();
+            if (mBtDeviceProxy == nullptr) {
+                *latencyMs = StreamDescriptor::LATENCY_UNKNOWN;
+                return ::android::OK;
+            }
+        }
+    }
     const size_t bytesToTransfer = fc * mFrameSizeBytes;
     const size_t bytesTransferred = mIsInput ? mBtDeviceProxy->readData(buffer, bytesToTransfer)
                                              : mBtDeviceProxy->writeData(buffer, bytesToTransfer);
     *actualFrameCount = bytesTransferred / mFrameSizeBytes;
+    mFramesTransferred += *actualFrameCount;
     ATRACE_INT("BTdropped", bytesToTransfer - bytesTransferred);
-    PresentationPosition presentation_position;
-    if (!mBtDeviceProxy->getPresentationPosition(presentation_position)) {
-        presentation_position.remoteDeviceAudioDelayNanos =
-                kBluetoothDefaultRemoteDelayMs * NANOS_PER_MILLISECOND;
-        LOG(WARNING) << __func__ << ": getPresentationPosition failed, latency info is unavailable";
-    }
-    // TODO(b/317117580): incorporate logic from
-    //                    packages/modules/Bluetooth/system/audio_bluetooth_hw/stream_apis.cc
-    //                    out_calculate_feeding_delay_ms / in_calculate_starving_delay_ms
-    *latencyMs = std::max(*latencyMs, (int32_t)(presentation_position.remoteDeviceAudioDelayNanos /
-                                                NANOS_PER_MILLISECOND));
+    *latencyMs = getLatencyMsLocked(::android::uptimeNanos());
     return ::android::OK;
 }
 
+void StreamBluetooth::resetPositionLocked() {
+    mFramesTransferred = 0;
+    mPresentationPosition.reset();
+    mPresentationPositionTimeNs = 0;
+    mTransmittedOctetsBase.reset();
+}
+
+void StreamBluetooth::refreshPresentationPositionLocked(bool force) {
+    const int64_t nowNs = ::android::uptimeNanos();
+    if (!force && mPresentationPositionTimeNs != 0 &&
+        nowNs - mPresentationPositionTimeNs < kPresentationPositionMaxAgeNs) {
+        return;
+    }
+    mPresentationPositionTimeNs = nowNs;
+    PresentationPosition position;
+    if (!mBtDeviceProxy->getPresentationPosition(position)) {
+        if (mPresentationPosition.has_value()) {
+            LOG(WARNING) << __func__
+                         << ": getPresentationPosition failed, latency info is unavailable";
+        }
+        mPresentationPosition.reset();
+        return;
+    }
+    if (!mTransmittedOctetsBase.has_value()) {
+        mTransmittedOctetsBase = position.transmittedOctets;
+    }
+    mPresentationPosition = position;
+}
+
+int64_t StreamBluetooth::getQueuedFramesLocked(int64_t nowNs) {
+    // There is no software data path to account for with hardware offload, and the BT stack
+    // leaves the timestamp at zero.
+    if (mBtDeviceProxy == nullptr || !mPresentationPosition.has_value() ||
+        !mTransmittedOctetsBase.has_value() ||
+        (mPresentationPosition->transmittedOctetsTimestamp.tvSec == 0 &&
+         mPresentationPosition->transmittedOctetsTimestamp.tvNSec == 0)) {
+        return 0;
+    }
+    // With the mono workaround, the BT stack gets half the bytes of each frame.
+    const int64_t transmittedFrameSize =
+            mBtDeviceProxy->isStereoToMono() ? mFrameSizeBytes / 2 : mFrameSizeBytes;
+    const int64_t timestampNs =
+            mPresentationPosition->transmittedOctetsTimestamp.tvSec * NANOS_PER_SECOND +
+            mPresentationPosition->transmittedOctetsTimestamp.tvNSec;
+    // The BT stack keeps sending or receiving data at the sample rate after the timestamp, as
+    // far as the age of a cached position goes.
+    const int64_t transmittedFrames =
+            (mPresentationPosition->transmittedOctets - *mTransmittedOctetsBase) /
+                    transmittedFrameSize +
+            std::clamp<int64_t>(nowNs - timestampNs, 0, kPresentationPositionMaxAgeNs) *
+                    mSampleRate / NANOS_PER_SECOND;
+    return std::max<int64_t>(mIsInput ? transmittedFrames - mFramesTransferred
+                                      : mFramesTransferred - transmittedFrames,
+                             0);
+}
+
+int32_t StreamBluetooth::getLatencyMsLocked(int64_t nowNs) {
+    const int64_t remoteDelayNs = mPresentationPosition.has_value()
+                                          ? mPresentationPosition->remoteDeviceAudioDelayNanos
+                                          : kBluetoothDefaultRemoteDelayMs * NANOS_PER_MILLISECOND;
+    return (remoteDelayNs + framesToUs(getQueuedFramesLocked(nowNs)) * NANOS_PER_MICROSECOND) /
+           NANOS_PER_MILLISECOND;
+}
+
+int64_t StreamBluetooth::framesToUs(int64_t frames) const {
+    return frames * MICROS_PER_SECOND / mSampleRate;
+}
+
 // static
 bool StreamBluetooth::checkConfigParams(const PcmConfiguration& pcmConfig,
                                         const AudioConfigBase& config) {
@@ -172,12 +290,15 @@ ndk::ScopedAStatus StreamBluetooth::prepareToClose() {
 ::android::status_t StreamBluetooth::standby() {
     std::lock_guard guard(mLock);
     if (mBtDeviceProxy != nullptr) mBtDeviceProxy->suspend();
+    resetPositionLocked();
     return ::android::OK;
 }
 
 ::android::status_t StreamBluetooth::start() {
     std::lock_guard guard(mLock);
     if (mBtDeviceProxy != nullptr) mBtDeviceProxy->start();
+    // Take a fresh position with the next transfer.
+    mPresentationPositionTimeNs = 0;
     return ::android::OK;
 }
 
@@ -15,6 +15,7 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <set>
 #include <unordered_set>
@@ -269,15 +270,170 @@ RetCode DynamicsProcessingSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status DynamicsProcessingSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+IEffect::Status DynamicsProcessingSwContext::process(float* in, float* out, int samples) {
+    if (mChannelCount == 0) {
+        return {EX_ILLEGAL_STATE, 0, 0};
+    }
+    if (mProcessingDirty) {
+        updateProcessing();
+    }
+    const size_t frames = samples / mChannelCount;
+
+    dsp::applyChannelGains(in, out, frames, mChannelCount, mInputGains.data());
+    for (auto& filter : mPreEqFilters) {
+        filter.process(out, out, frames);
+    }
+    if (mEngineSettings.mbcStage.inUse) {
+        processMbc(out, frames);
+    }
+    for (auto& filter : mPostEqFilters) {
+        filter.process(out, out, frames);
+    }
+    if (mEngineSettings.limiterInUse) {
+        // TODO: link the limiters of the channels in the same linkGroup
+        for (size_t channel = 0; channel < mChannelCount; channel++) {
+            mLimiters[channel].process(out + channel, out + channel, frames, mChannelCount);
+        }
+    }
+    // samples of an incomplete frame are passed through
+    if (in != out) {
+        std::copy(in + frames * mChannelCount, in + samples, out + frames * mChannelCount);
     }
     return {STATUS_OK, samples, samples};
 }
 
+void DynamicsProcessingSwContext::processMbc(float* buffer, size_t frames) {
+    const size_t samples = frames * mChannelCount;
+    const size_t bandCount = mEngineSettings.mbcStage.bandCount;
+    if (mMbcRemainder.size() < samples) {
+        mMbcRemainder.resize(samples);
+        mMbcBand.resize(samples);
+    }
+    // Each band is low passed from what the lower bands leave, so the bands always sum up to the
+    // input. The compressed bands are accumulated into the buffer.
+    std::copy(buffer, buffer + samples, mMbcRemainder.begin());
+    std::fill(buffer, buffer + samples, 0.0f);
+    for (size_t band = 0; band < bandCount; band++) {
+        float* bandBuffer = mMbcRemainder.data();
+        if (band + 1 < bandCount) {
+            bandBuffer = mMbcBand.data();
+            mMbcCrossovers[band].process(mMbcRemainder.data(), bandBuffer, frames);
+            dsp::subtract(mMbcRemainder.data(), bandBuffer, mMbcRemainder.data(), samples);
+        }
+        for (size_t channel = 0; channel < mChannelCount; channel++) {
+            mMbcCompressors[channel * bandCount + band].process(
+                    bandBuffer + channel, bandBuffer + channel, frames, mChannelCount);
+        }
+        dsp::add(buffer, bandBuffer, buffer, samples);
+    }
+}
+
+void DynamicsProcessingSwContext::updateEqFilters(
+        const std::vector<DynamicsProcessing::ChannelConfig>& channelCfgs,
+        const std::vector<DynamicsProcessing::EqBandConfig>& bandCfgs,
+        const DynamicsProcessing::StageEnablement& stage,
+        std::vector<dsp::BiquadFilter>& filters) {
+    const size_t bandCount = stage.inUse ? stage.bandCount : 0;
+    if (filters.size() != bandCount ||
+        (bandCount && filters[0].getChannelCount() != mChannelCount)) {
+        filters.assign(bandCount, dsp::BiquadFilter(mChannelCount));
+    }
+    const float sampleRate = mCommon.input.base.sampleRate;
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        const bool channelEnabled = channel < channelCfgs.size() && channelCfgs[channel].enable;
+        float lowerCutoff = 0;
+        for (size_t band = 0; band < bandCount; band++) {
+            const auto& cfg = bandCfgs[channel * bandCount + band];
+            dsp::BiquadCoefficients coefficients;
+            if (channelEnabled && cfg.channel != kInvalidChannelId && cfg.enable) {
+                // The band covers the frequencies from the cutoff of the previous band to its own
+                // cutoff, the first band is a low shelf.
+                if (band == 0 || lowerCutoff <= 0 || lowerCutoff >= cfg.cutoffFrequencyHz) {
+                    coefficients = dsp::BiquadCoefficients::lowShelf(
+                            sampleRate, cfg.cutoffFrequencyHz, cfg.gainDb);
+                } else {
+                    const float center = std::sqrt(lowerCutoff * cfg.cutoffFrequencyHz);
+                    const float q = std::clamp(center / (cfg.cutoffFrequencyHz - lowerCutoff),
+                                               0.3f, 10.0f);
+                    coefficients =
+                            dsp::BiquadCoefficients::peaking(sampleRate, center, q, cfg.gainDb);
+                }
+            }
+            if (cfg.channel != kInvalidChannelId) {
+                lowerCutoff = cfg.cutoffFrequencyHz;
+            }
+            filters[band].setCoefficients(channel, coefficients);
+        }
+    }
+}
+
+void DynamicsProcessingSwContext::updateProcessing() {
+    const float sampleRate = mCommon.input.base.sampleRate;
+
+    mInputGains.assign(mChannelCount, 1.0f);
+    for (const auto& cfg : mInputGainCfgs) {
+        if (cfg.channel != kInvalidChannelId && (size_t)cfg.channel < mChannelCount) {
+            mInputGains[cfg.channel] = dsp::dbToAmplitude(cfg.gainDb);
+        }
+    }
+
+    updateEqFilters(mPreEqChCfgs, mPreEqChBands, mEngineSettings.preEqStage, mPreEqFilters);
+    updateEqFilters(mPostEqChCfgs, mPostEqChBands, mEngineSettings.postEqStage, mPostEqFilters);
+
+    const size_t mbcBandCount = mEngineSettings.mbcStage.inUse ? mEngineSettings.mbcStage.bandCount
+                                                               : 0;
+    const size_t crossoverCount = mbcBandCount ? mbcBandCount - 1 : 0;
+    if (mMbcCrossovers.size() != crossoverCount ||
+        (crossoverCount && mMbcCrossovers[0].getChannelCount() != mChannelCount)) {
+        mMbcCrossovers.assign(crossoverCount, dsp::BiquadFilter(mChannelCount));
+    }
+    mMbcCompressors.resize(mChannelCount * mbcBandCount);
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        const bool channelEnabled = channel < mMbcChCfgs.size() && mMbcChCfgs[channel].enable;
+        for (size_t band = 0; band < mbcBandCount; band++) {
+            const auto& cfg = mMbcChBands[channel * mbcBandCount + band];
+            const bool valid = cfg.channel != kInvalidChannelId;
+            if (band < crossoverCount) {
+                // A Butterworth low pass, which passes the unconfigured bands through.
+                mMbcCrossovers[band].setCoefficients(
+                        channel, valid ? dsp::BiquadCoefficients::lowPass(
+                                                 sampleRate, cfg.cutoffFrequencyHz, M_SQRT1_2)
+                                       : dsp::BiquadCoefficients::passthrough());
+            }
+            mMbcCompressors[channel * mbcBandCount + band].configure(
+                    sampleRate, {.enable = channelEnabled && valid && cfg.enable,
+                                 .attackTimeMs = cfg.attackTimeMs,
+                                 .releaseTimeMs = cfg.releaseTimeMs,
+                                 .ratio = cfg.ratio,
+                                 .thresholdDb = cfg.thresholdDb,
+                                 .kneeWidthDb = cfg.kneeWidthDb,
+                                 .noiseGateThresholdDb = cfg.noiseGateThresholdDb,
+                                 .expanderRatio = cfg.expanderRatio,
+                                 .preGainDb = cfg.preGainDb,
+                                 .postGainDb = cfg.postGainDb});
+        }
+    }
+
+    mLimiters.resize(mChannelCount);
+    for (size_t channel = 0; channel < mChannelCount; channel++) {
+        const auto& cfg = mLimiterCfgs[channel];
+        mLimiters[channel].configure(
+                sampleRate, {.enable = cfg.channel != kInvalidChannelId && cfg.enable,
+                             .attackTimeMs = cfg.attackTimeMs,
+                             .releaseTimeMs = cfg.releaseTimeMs,
+                             .ratio = cfg.ratio,
+                             .thresholdDb = cfg.thresholdDb,
+                             .postGainDb = cfg.postGainDb});
+    }
+    mProcessingDirty = false;
+}
+
 RetCode DynamicsProcessingSwContext::setCommon(const Parameter::Common& common) {
+    mProcessingDirty = true;
     if (auto ret = updateIOFrameSize(common); ret != RetCode::SUCCESS) {
         return ret;
     }
@@ -292,6 +448,7 @@ RetCode DynamicsProcessingSwContext::setCommon(const Parameter::Common& common)
 
 RetCode DynamicsProcessingSwContext::setEngineArchitecture(
         const DynamicsProcessing::EngineArchitecture& cfg) {
+    mProcessingDirty = true;
     RETURN_VALUE_IF(!validateEngineConfig(cfg), RetCode::ERROR_ILLEGAL_PARAMETER,
                     "illegalEngineConfig");
 
@@ -308,6 +465,7 @@ RetCode DynamicsProcessingSwContext::setChannelCfgs(
         const std::vector<DynamicsProcessing::ChannelConfig>& cfgs,
         std::vector<DynamicsProcessing::ChannelConfig>& targetCfgs,
         const DynamicsProcessing::StageEnablement& stage) {
+    mProcessingDirty = true;
     RETURN_VALUE_IF(!stage.inUse, RetCode::ERROR_ILLEGAL_PARAMETER, "stageNotInUse");
 
     RetCode ret = RetCode::SUCCESS;
@@ -349,6 +507,7 @@ RetCode DynamicsProcessingSwContext::setEqBandCfgs(
         std::vector<DynamicsProcessing::EqBandConfig>& targetCfgs,
         const DynamicsProcessing::StageEnablement& stage,
         const std::vector<DynamicsProcessing::ChannelConfig>& channelConfig) {
+    mProcessingDirty = true;
     RETURN_VALUE_IF(!stage.inUse, RetCode::ERROR_ILLEGAL_PARAMETER, "eqStageNotInUse");
 
     RetCode ret = RetCode::SUCCESS;
@@ -383,6 +542,7 @@ RetCode DynamicsProcessingSwContext::setPostEqBandCfgs(
 
 RetCode DynamicsProcessingSwContext::setMbcBandCfgs(
         const std::vector<DynamicsProcessing::MbcBandConfig>& cfgs) {
+    mProcessingDirty = true;
     RETURN_VALUE_IF(!mEngineSettings.mbcStage.inUse, RetCode::ERROR_ILLEGAL_PARAMETER,
                     "mbcNotInUse");
 
@@ -411,6 +571,7 @@ RetCode DynamicsProcessingSwContext::setMbcBandCfgs(
 
 RetCode DynamicsProcessingSwContext::setLimiterCfgs(
         const std::vector<DynamicsProcessing::LimiterConfig>& cfgs) {
+    mProcessingDirty = true;
     RETURN_VALUE_IF(!mEngineSettings.limiterInUse, RetCode::ERROR_ILLEGAL_PARAMETER,
                     "limiterNotInUse");
 
@@ -469,6 +630,7 @@ void DynamicsProcessingSwContext::resizeBands() {
 
 RetCode DynamicsProcessingSwContext::setInputGainCfgs(
         const std::vector<DynamicsProcessing::InputGain>& cfgs) {
+    mProcessingDirty = true;
     for (const auto& cfg : cfgs) {
         RETURN_VALUE_IF(cfg.channel < 0 || (size_t)cfg.channel >= mChannelCount,
                         RetCode::ERROR_ILLEGAL_PARAMETER, "invalidChannel");
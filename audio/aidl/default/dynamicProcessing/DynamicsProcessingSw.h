@@ -24,6 +24,7 @@
 #include <aidl/android/hardware/audio/effect/BnEffect.h>
 #include <fmq/AidlMessageQueue.h>
 
+#include "effect-impl/EffectDspKernels.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -74,6 +75,9 @@ class DynamicsProcessingSwContext final : public EffectContext {
     std::vector<DynamicsProcessing::LimiterConfig> getLimiterCfgs() { return mLimiterCfgs; }
     std::vector<DynamicsProcessing::InputGain> getInputGainCfgs();
 
+    // input gain -> pre-EQ -> MBC -> post-EQ -> limiter
+    IEffect::Status process(float* in, float* out, int samples);
+
   private:
     static constexpr int32_t kInvalidChannelId = -1;
     size_t mChannelCount = 0;
@@ -88,6 +92,29 @@ class DynamicsProcessingSwContext final : public EffectContext {
     std::vector<DynamicsProcessing::EqBandConfig> mPreEqChBands;
     std::vector<DynamicsProcessing::EqBandConfig> mPostEqChBands;
     std::vector<DynamicsProcessing::MbcBandConfig> mMbcChBands;
+
+    // Processing state derived from the configs above, updated by the next process() call after
+    // any config changes. The filters and compressors keep their history across updates.
+    bool mProcessingDirty = true;
+    std::vector<float> mInputGains;
+    // one filter per band, each with a coefficient set per channel
+    std::vector<dsp::BiquadFilter> mPreEqFilters;
+    std::vector<dsp::BiquadFilter> mPostEqFilters;
+    // bandCount - 1 low pass filters, which split the signal into the MBC bands
+    std::vector<dsp::BiquadFilter> mMbcCrossovers;
+    // with index channel * bandCount + band
+    std::vector<dsp::Compressor> mMbcCompressors;
+    std::vector<dsp::Compressor> mLimiters;
+    // scratch buffers for the MBC band splitting
+    std::vector<float> mMbcRemainder;
+    std::vector<float> mMbcBand;
+
+    void updateProcessing();
+    void updateEqFilters(const std::vector<DynamicsProcessing::ChannelConfig>& channelCfgs,
+                         const std::vector<DynamicsProcessing::EqBandConfig>& bandCfgs,
+                         const DynamicsProcessing::StageEnablement& stage,
+                         std::vector<dsp::BiquadFilter>& filters);
+    void processMbc(float* buffer, size_t frames);
     bool validateStageEnablement(const DynamicsProcessing::StageEnablement& enablement);
     bool validateEngineConfig(const DynamicsProcessing::EngineArchitecture& engine);
     bool validateEqBandConfig(const DynamicsProcessing::EqBandConfig& band, int maxChannel,
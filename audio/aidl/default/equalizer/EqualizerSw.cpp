@@ -207,10 +207,63 @@ RetCode EqualizerSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status EqualizerSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+RetCode EqualizerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = EffectContext::setCommon(common); ret != RetCode::SUCCESS) {
+        return ret;
+    }
+    mFiltersDirty = true;
+    return RetCode::SUCCESS;
+}
+
+void EqualizerSwContext::updateFilters() {
+    const float sampleRate = mCommon.input.base.sampleRate;
+    for (int i = 0; i < kMaxBandNumber; i++) {
+        auto& filter = mBandFilters[i];
+        if (filter.getChannelCount() != mInputChannelCount) {
+            filter = dsp::BiquadFilter(mInputChannelCount);
+        }
+        const float frequency = kPresetsFrequencies[i];
+        const float gainDb = mBandLevels[i] / 100.0f;
+        dsp::BiquadCoefficients coefficients;
+        if (i == 0) {
+            coefficients = dsp::BiquadCoefficients::lowShelf(sampleRate, frequency, gainDb);
+        } else if (i == kMaxBandNumber - 1) {
+            coefficients = dsp::BiquadCoefficients::highShelf(sampleRate, frequency, gainDb);
+        } else {
+            coefficients = dsp::BiquadCoefficients::peaking(sampleRate, frequency, kBandQ, gainDb);
+        }
+        const bool active = gainDb != 0 && frequency < sampleRate / 2;
+        if (active && !mBandActive[i]) {
+            filter.reset();
+        }
+        mBandActive[i] = active;
+        filter.setCoefficients(coefficients);
+    }
+    mFiltersDirty = false;
+}
+
+IEffect::Status EqualizerSwContext::process(float* in, float* out, int samples) {
+    RETURN_VALUE_IF(mInputChannelCount == 0, (IEffect::Status{EX_ILLEGAL_STATE, 0, 0}),
+                    "zeroChannelCount");
+    if (mFiltersDirty) {
+        updateFilters();
+    }
+    const size_t frames = samples / mInputChannelCount;
+    const float* src = in;
+    for (int i = 0; i < kMaxBandNumber; i++) {
+        if (mBandActive[i]) {
+            mBandFilters[i].process(src, out, frames);
+            src = out;
+        }
+    }
+    // the samples not filtered, including those of an incomplete frame, are passed through
+    const size_t copyStart = src == out ? frames * mInputChannelCount : 0;
+    if (in != out) {
+        std::copy(in + copyStart, in + samples, out + copyStart);
     }
     return {STATUS_OK, samples, samples};
 }
@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <memory>
 
+#include "effect-impl/EffectDspKernels.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -54,6 +55,7 @@ class EqualizerSwContext final : public EffectContext {
                 ret = RetCode::ERROR_ILLEGAL_PARAMETER;
             } else {
                 mBandLevels[it.index] = it.levelMb;
+                mFiltersDirty = true;
             }
         }
         return ret;
@@ -70,6 +72,11 @@ class EqualizerSwContext final : public EffectContext {
     std::vector<int> getCenterFreqs() {
         return {std::begin(kPresetsFrequencies), std::end(kPresetsFrequencies)};
     }
+    RetCode setCommon(const Parameter::Common& common) override;
+
+    // Applies the band levels with a cascade of one biquad filter per band.
+    IEffect::Status process(float* in, float* out, int samples);
+
     static const int kMaxBandNumber = 5;
     static const int kMaxPresetNumber = 10;
     static const int kCustomPreset = -1;
@@ -77,11 +84,19 @@ class EqualizerSwContext final : public EffectContext {
   private:
     static constexpr std::array<uint16_t, kMaxBandNumber> kPresetsFrequencies = {60, 230, 910, 3600,
                                                                                  14000};
+    // the center frequencies are two octaves apart
+    static constexpr float kBandQ = 0.67f;
     // preset band level
     int mPreset = kCustomPreset;
     int32_t mBandLevels[kMaxBandNumber] = {3, 0, 0, 0, 3};
 
-    // Add equalizer specific context for processing here
+    // updated by the next process() call after the band levels or the common parameter change
+    bool mFiltersDirty = true;
+    std::array<dsp::BiquadFilter, kMaxBandNumber> mBandFilters;
+    // a band with zero level is skipped
+    std::array<bool, kMaxBandNumber> mBandActive = {};
+
+    void updateFilters();
 };
 
 class EqualizerSw final : public EffectImpl {
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include <aidl/android/hardware/audio/core/BnConfig.h>
 #include <system/audio_config.h>
 
@@ -25,19 +27,34 @@
 namespace aidl::android::hardware::audio::core {
 static const std::string kEngineConfigFileName = "audio_policy_engine_configuration.xml";
 
+namespace internal {
+
+// The result of converting the audio policy and the engine configuration files.
+struct AudioHalConfigs {
+    std::unique_ptr<AudioPolicyConfigXmlConverter::ModuleConfigs> moduleConfigs;
+    SurroundSoundConfig surroundSoundConfig;
+    ::aidl::android::media::audio::common::AudioHalEngineConfig engineConfig;
+};
+
+// Loads the configuration from the cache when it is up to date, otherwise parses the XML files
+// and updates the cache.
+AudioHalConfigs loadAudioHalConfigs();
+
+}  // namespace internal
+
 class Config : public BnConfig {
   public:
-    explicit Config(internal::AudioPolicyConfigXmlConverter& apConverter)
-        : mAudioPolicyConverter(apConverter) {}
+    Config(const SurroundSoundConfig& surroundSoundConfig,
+           const ::aidl::android::media::audio::common::AudioHalEngineConfig& engineConfig)
+        : mSurroundSoundConfig(surroundSoundConfig), mEngineConfig(engineConfig) {}
 
   private:
     ndk::ScopedAStatus getSurroundSoundConfig(SurroundSoundConfig* _aidl_return) override;
     ndk::ScopedAStatus getEngineConfig(
             aidl::android::media::audio::common::AudioHalEngineConfig* _aidl_return) override;
 
-    internal::AudioPolicyConfigXmlConverter& mAudioPolicyConverter;
-    internal::EngineConfigXmlConverter mEngConfigConverter{
-            ::android::audio_find_readable_configuration_file(kEngineConfigFileName.c_str())};
+    const SurroundSoundConfig mSurroundSoundConfig;
+    const ::aidl::android::media::audio::common::AudioHalEngineConfig mEngineConfig;
 };
 
 }  // namespace aidl::android::hardware::audio::core
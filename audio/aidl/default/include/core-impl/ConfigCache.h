@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <android/binder_parcel.h>
+
+namespace aidl::android::hardware::audio::core::internal {
+
+static const std::string kConfigCacheDir = "/data/vendor/audiohal/";
+
+/**
+ * A cache for the results of converting XML configuration files, which avoids parsing the files
+ * on every start of the service. The converted data is written into a parcel, which is stored
+ * in a file together with a header. The cache is only used when its key matches. The key is a
+ * hash of the contents of the source files, including the files pulled in via XInclude,
+ * the vendor build fingerprint, and the format version, which must be incremented whenever
+ * the conversion code or the layout of the data changes.
+ *
+ * The cache file is memory mapped for reading. It is replaced atomically when written.
+ * All failures are non fatal, the caller just falls back to parsing the source files.
+ */
+class ConfigCache {
+  public:
+    using Reader = std::function<binder_status_t(const AParcel*)>;
+    using Writer = std::function<binder_status_t(AParcel*)>;
+
+    ConfigCache(const std::string& cacheDir, const std::string& name, uint32_t formatVersion,
+                const std::vector<std::string>& sourceFiles);
+
+    // Returns false if the source files could not be read, the cache is not usable then.
+    bool isValid() const { return mKey != 0; }
+    uint64_t getKey() const { return mKey; }
+    const std::string& getPath() const { return mPath; }
+
+    // Returns true if the cache was present, up to date, and 'reader' has succeeded.
+    bool load(const Reader& reader) const;
+    // Returns true if the cache file has been written.
+    bool store(const Writer& writer) const;
+
+    // Public for testing purposes.
+    static uint64_t hash(const void* data, size_t size, uint64_t seed);
+    static std::vector<std::string> findIncludedFiles(const std::string& filePath);
+
+  private:
+    uint64_t calculateKey(const std::vector<std::string>& sourceFiles) const;
+
+    const std::string mCacheDir;
+    const std::string mPath;
+    const uint32_t mFormatVersion;
+    const uint64_t mKey;
+};
+
+}  // namespace aidl::android::hardware::audio::core::internal
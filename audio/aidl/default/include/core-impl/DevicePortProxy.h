@@ -188,6 +188,9 @@ class BluetoothAudioPortAidl : public BluetoothAudioPort {
 
     bool getPreferredDataIntervalUs(size_t& interval_us) const override;
 
+    // True if stereo data written to the port is sent to the Bluetooth stack as mono.
+    bool isStereoToMono() const { return mIsStereoToMono; }
+
   protected:
     uint16_t mCookie;
     BluetoothStreamState mState GUARDED_BY(mCvMutex);
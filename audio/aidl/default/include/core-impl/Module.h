@@ -22,12 +22,14 @@
 #include <memory>
 #include <optional>
 #include <set>
+#include <unordered_map>
 
 #include <Utils.h>
 #include <aidl/android/hardware/audio/core/BnModule.h>
 
 #include "core-impl/ChildInterface.h"
 #include "core-impl/Stream.h"
+#include "core-impl/utils.h"
 
 namespace aidl::android::hardware::audio::core {
 
@@ -158,9 +160,22 @@ class Module : public BnModule {
     // Maps port ids and port config ids to patch ids.
     // Multimap because both ports and configs can be used by multiple patches.
     using Patches = std::multimap<int32_t, int32_t>;
+    // Positions of the routes in 'Configuration::routes', by the ids of their ports.
+    struct RoutesIndex {
+        bool isValid = false;
+        std::unordered_map<int32_t, std::vector<size_t>> bySinkPortId;
+        std::unordered_map<int32_t, std::vector<size_t>> bySourcePortId;
+    };
+
+    const RoutesIndex& getRoutesIndex();
 
     const Type mType;
     std::unique_ptr<Configuration> mConfig;
+    // Indexes into the vectors of 'mConfig' for lookups by id.
+    IdIndex<::aidl::android::media::audio::common::AudioPort> mPortsIndex;
+    IdIndex<::aidl::android::media::audio::common::AudioPortConfig> mPortConfigsIndex;
+    IdIndex<AudioPatch> mPatchesIndex;
+    RoutesIndex mRoutesIndex;
     ModuleDebug mDebug;
     VendorDebug mVendorDebug;
     ConnectedDevicePorts mConnectedDevicePorts;
@@ -224,6 +239,11 @@ class Module : public BnModule {
             std::shared_ptr<IStreamCallback> asyncCallback,
             std::shared_ptr<IStreamOutEventCallback> outEventCallback,
             ::aidl::android::hardware::audio::core::StreamContext* out_context);
+    // Creates the shared buffer of an MMap No IRQ stream and puts it into the descriptor.
+    // Does nothing for other streams.
+    ndk::ScopedAStatus openStreamMmapBuffer(int32_t portConfigId,
+                                            const std::shared_ptr<StreamCommonInterface>& stream,
+                                            StreamDescriptor* desc);
     std::vector<::aidl::android::media::audio::common::AudioDevice> findConnectedDevices(
             int32_t portConfigId);
     std::set<int32_t> findConnectedPortConfigIds(int32_t portConfigId);
@@ -234,6 +254,8 @@ class Module : public BnModule {
                                    ::aidl::android::media::audio::common::AudioPortConfig* config);
     std::vector<AudioRoute*> getAudioRoutesForAudioPortImpl(int32_t portId);
     Configuration& getConfig();
+    // Must be called after modifying 'routes' of the configuration.
+    void invalidateRoutesIndex() { mRoutesIndex.isValid = false; }
     const ConnectedDevicePorts& getConnectedDevicePorts() const { return mConnectedDevicePorts; }
     bool getMasterMute() const { return mMasterMute; }
     bool getMasterVolume() const { return mMasterVolume; }
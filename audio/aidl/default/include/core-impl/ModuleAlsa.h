@@ -16,6 +16,14 @@
 
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+
 #include "core-impl/Module.h"
 
 namespace aidl::android::hardware::audio::core {
@@ -35,6 +43,28 @@ class ModuleAlsa : public Module {
     ndk::ScopedAStatus populateConnectedDevicePort(
             ::aidl::android::media::audio::common::AudioPort* audioPort,
             int32_t nextPortId) override;
+
+    // Drops the cached profiles of the devices of the card, unless the card still holds the
+    // same hardware.
+    void invalidateProfileCache(int card);
+
+  private:
+    // Profiles probed from a device, keyed by the address of the device and the identity of the
+    // card, so that a card number reused by other hardware is probed again.
+    struct ProfileCacheKey {
+        int card;
+        int device;
+        int direction;
+        std::string cardIdentity;
+        bool operator<(const ProfileCacheKey& other) const {
+            return std::tie(card, device, direction, cardIdentity) <
+                   std::tie(other.card, other.device, other.direction, other.cardIdentity);
+        }
+    };
+
+    std::mutex mProfileCacheLock;
+    std::map<ProfileCacheKey, std::vector<::aidl::android::media::audio::common::AudioProfile>>
+            mProfileCache GUARDED_BY(mProfileCacheLock);
 };
 
 }  // namespace aidl::android::hardware::audio::core
@@ -16,7 +16,13 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 #include <aidl/android/hardware/audio/core/sounddose/BnSoundDose.h>
 #include <aidl/android/media/audio/common/AudioDevice.h>
@@ -39,9 +45,28 @@ class StreamDataProcessorInterface {
     virtual void process(const void* buffer, size_t size) = 0;
 };
 
+/**
+ * The MEL processing runs on a low priority helper thread. The stream worker only copies its
+ * data into a preallocated buffer, it processes the data itself only when the helper falls
+ * behind by more than kMaxPendingDataDuration.
+ *
+ * The MEL values are accumulated into a fixed size array and delivered as a single record once
+ * per 'melDeliveryInterval'. A record is delivered earlier when the array is full, when the
+ * audio device changes, or when the values stop being contiguous. Momentary exposure warnings
+ * are never delayed.
+ */
 class SoundDose final : public BnSoundDose, public StreamDataProcessorInterface {
   public:
-    SoundDose() : mMelCallback(::android::sp<MelCallback>::make(this)){};
+    static constexpr std::chrono::milliseconds kDefaultMelDeliveryInterval{5000};
+    static constexpr std::chrono::milliseconds kMaxPendingDataDuration{200};
+    // MEL values are produced once per second.
+    static constexpr size_t kMaxPendingMelValues = 64;
+
+    explicit SoundDose(
+            std::chrono::milliseconds melDeliveryInterval = kDefaultMelDeliveryInterval)
+        : mMelDeliveryInterval(melDeliveryInterval),
+          mMelCallback(::android::sp<MelCallback>::make(this)){};
+    ~SoundDose();
 
     // -------------------------------------- BnSoundDose ------------------------------------------
     ndk::ScopedAStatus setOutputRs2UpperBound(float in_rs2ValueDbA) override;
@@ -71,17 +96,41 @@ class SoundDose final : public BnSoundDose, public StreamDataProcessorInterface
     };
 
     void onNewMelValues(const std::vector<float>& mels, size_t offset, size_t length,
-                        audio_port_handle_t deviceId) const;
+                        audio_port_handle_t deviceId);
     void onMomentaryExposure(float currentMel, audio_port_handle_t deviceId) const;
 
+    void helperLoop();
+    void processPendingData_l() REQUIRES(mMutex);
+    void deliverMelValues_l() REQUIRES(mCbMutex);
+    bool isMelDeliveryDue_l() const REQUIRES(mHelperMutex);
+
+    const std::chrono::milliseconds mMelDeliveryInterval;
+
+    // Lock order: mMutex, then mCbMutex, then mHelperMutex.
     mutable ::android::audio_utils::mutex mCbMutex;
     std::shared_ptr<ISoundDose::IHalSoundDoseCallback> mCallback GUARDED_BY(mCbMutex);
     std::optional<::aidl::android::media::audio::common::AudioDevice> mAudioDevice
             GUARDED_BY(mCbMutex);
+    // MEL values not delivered yet, all of them are for 'mAudioDevice'
+    std::array<float, kMaxPendingMelValues> mPendingMelValues GUARDED_BY(mCbMutex);
+    size_t mPendingMelCount GUARDED_BY(mCbMutex) = 0;
+    int64_t mPendingMelTimestamp GUARDED_BY(mCbMutex) = 0;
     mutable ::android::audio_utils::mutex mMutex;
     float mRs2Value GUARDED_BY(mMutex) = DEFAULT_MAX_RS2;
     ::android::sp<::android::audio_utils::MelProcessor> mMelProcessor GUARDED_BY(mMutex);
     ::android::sp<MelCallback> mMelCallback GUARDED_BY(mMutex);
+    // the data taken from 'mPendingData' by the thread processing it
+    std::vector<uint8_t> mProcessingData GUARDED_BY(mMutex);
+    std::thread mHelper GUARDED_BY(mMutex);
+
+    std::mutex mHelperMutex;
+    std::condition_variable mHelperCv;
+    bool mHelperExit GUARDED_BY(mHelperMutex) = false;
+    // the data written by the stream, not processed yet, never exceeds 'mPendingDataCapacity'
+    std::vector<uint8_t> mPendingData GUARDED_BY(mHelperMutex);
+    size_t mPendingDataCapacity GUARDED_BY(mHelperMutex) = 0;
+    std::optional<std::chrono::steady_clock::time_point> mMelDeliveryDeadline
+            GUARDED_BY(mHelperMutex);
 };
 
 }  // namespace aidl::android::hardware::audio::core::sounddose
@@ -88,7 +88,7 @@ class StreamContext {
                   std::shared_ptr<IStreamCallback> asyncCallback,
                   std::shared_ptr<IStreamOutEventCallback> outEventCallback,
                   std::weak_ptr<sounddose::StreamDataProcessorInterface> streamDataProcessor,
-                  DebugParameters debugParameters)
+                  DebugParameters debugParameters, size_t mmapBufferSizeFrames = 0)
         : mCommandMQ(std::move(commandMQ)),
           mInternalCommandCookie(std::rand() | 1 /* make sure it's not 0 */),
           mReplyMQ(std::move(replyMQ)),
@@ -102,7 +102,8 @@ class StreamContext {
           mAsyncCallback(asyncCallback),
           mOutEventCallback(outEventCallback),
           mStreamDataProcessor(streamDataProcessor),
-          mDebugParameters(debugParameters) {}
+          mDebugParameters(debugParameters),
+          mMmapBufferSizeFrames(mmapBufferSizeFrames) {}
 
     void fillDescriptor(StreamDescriptor* desc);
     std::shared_ptr<IStreamCallback> getAsyncCallback() const { return mAsyncCallback; }
@@ -132,6 +133,9 @@ class StreamContext {
     ReplyMQ* getReplyMQ() const { return mReplyMQ.get(); }
     int getTransientStateDelayMs() const { return mDebugParameters.transientStateDelayMs; }
     int getSampleRate() const { return mSampleRate; }
+    // MMap No IRQ streams exchange data via a shared buffer set up by the driver, they have no
+    // data FMQ, and the worker thread only reports positions.
+    bool isMmap() const;
     bool isValid() const;
     // 'reset' is called on a Binder thread when closing the stream. Does not use
     // locking because it only cleans MQ pointers which were also set on the Binder thread.
@@ -156,6 +160,7 @@ class StreamContext {
     std::shared_ptr<IStreamOutEventCallback> mOutEventCallback;  // Only used by output streams
     std::weak_ptr<sounddose::StreamDataProcessorInterface> mStreamDataProcessor;
     DebugParameters mDebugParameters;
+    size_t mMmapBufferSizeFrames;  // The buffer size requested by the client, MMap only.
     long mFrameCount = 0;
 };
 
@@ -177,6 +182,18 @@ struct DriverInterface {
     virtual ::android::status_t refinePosition(StreamDescriptor::Position* /*position*/) {
         return ::android::OK;
     }
+    // Only MMap No IRQ streams need to implement the methods below.
+    // 'openMmapBuffer' is called on a Binder thread when the stream is being opened, before the
+    // client can send any command to the worker thread. The driver keeps the ownership of
+    // the buffer, the file descriptor in the descriptor is a duplicate.
+    virtual ::android::status_t openMmapBuffer(MmapBufferDescriptor* /*desc*/) {
+        return ::android::INVALID_OPERATION;
+    }
+    // Provides the hardware read / write position in the shared buffer. Must not block.
+    virtual ::android::status_t getMmapPositionAndLatency(StreamDescriptor::Position* /*position*/,
+                                                          int32_t* /*latencyMs*/) {
+        return ::android::INVALID_OPERATION;
+    }
     virtual void shutdown() = 0;  // This function is only called once.
 };
 
@@ -238,8 +255,14 @@ struct StreamWorkerInterface {
     virtual bool isClosed() const = 0;
     virtual void setIsConnected(bool isConnected) = 0;
     virtual StreamDescriptor::State setClosed() = 0;
+    // Must be called before 'start'.
+    virtual void setSchedulingPolicy(
+            const ::android::hardware::audio::common::WorkerSchedulingPolicy& policy) = 0;
     virtual bool start() = 0;
     virtual pid_t getTid() = 0;
+    virtual std::string getSchedulingError() = 0;
+    // Returns the cycle time statistics of the worker for the stream dump.
+    virtual std::string dump() = 0;
     virtual void stop() = 0;
 };
 
@@ -254,11 +277,23 @@ class StreamWorkerImpl : public StreamWorkerInterface,
     bool isClosed() const override { return WorkerImpl::isClosed(); }
     void setIsConnected(bool isConnected) override { WorkerImpl::setIsConnected(isConnected); }
     StreamDescriptor::State setClosed() override { return WorkerImpl::setClosed(); }
+    void setSchedulingPolicy(
+            const ::android::hardware::audio::common::WorkerSchedulingPolicy& policy) override {
+        WorkerImpl::setSchedulingPolicy(policy);
+    }
     bool start() override {
         // This is an "audio service thread," must have elevated priority.
         return WorkerImpl::start(WorkerImpl::kThreadName, ANDROID_PRIORITY_URGENT_AUDIO);
     }
     pid_t getTid() override { return WorkerImpl::getTid(); }
+    std::string getSchedulingError() override { return WorkerImpl::getSchedulingError(); }
+    std::string dump() override {
+        std::string result = WorkerImpl::kThreadName + ": " + WorkerImpl::getCycleStats().dump();
+        if (std::string error = getSchedulingError(); !error.empty()) {
+            result.append(", scheduling error: ").append(error);
+        }
+        return result;
+    }
     void stop() override { return WorkerImpl::stop(); }
 };
 
@@ -335,6 +370,10 @@ struct StreamCommonInterface {
     virtual ndk::ScopedAStatus setConnectedDevices(
             const std::vector<::aidl::android::media::audio::common::AudioDevice>& devices) = 0;
     virtual ndk::ScopedAStatus bluetoothParametersUpdated() = 0;
+    // Only called for MMap No IRQ streams, after the connected devices have been set.
+    virtual ndk::ScopedAStatus createMmapBuffer(MmapBufferDescriptor* desc) = 0;
+    // Returns the worker statistics for the stream dump.
+    virtual std::string dumpWorker() const = 0;
 };
 
 // This is equivalent to automatically generated 'IStreamCommonDelegator' but uses
@@ -436,6 +475,8 @@ class StreamCommonImpl : virtual public StreamCommonInterface, virtual public Dr
             const std::vector<::aidl::android::media::audio::common::AudioDevice>& devices)
             override;
     ndk::ScopedAStatus bluetoothParametersUpdated() override;
+    ndk::ScopedAStatus createMmapBuffer(MmapBufferDescriptor* desc) override;
+    std::string dumpWorker() const override;
 
   protected:
     static StreamWorkerInterface::CreateInstance getDefaultInWorkerCreator() {
@@ -450,6 +491,11 @@ class StreamCommonImpl : virtual public StreamCommonInterface, virtual public Dr
     }
 
     virtual void onClose(StreamDescriptor::State statePriorToClosing) = 0;
+    // The default policy uses SCHED_FIFO for FAST streams, and counts the cycles taking longer
+    // than the nominal latency as overruns. Concrete streams can override it, e.g. for using
+    // SCHED_DEADLINE or pinning the worker to CPU cores.
+    virtual ::android::hardware::audio::common::WorkerSchedulingPolicy getWorkerSchedulingPolicy()
+            const;
     void stopWorker();
 
     const StreamContext& mContext;
@@ -465,6 +511,8 @@ class StreamIn : virtual public StreamCommonInterface, public BnStreamIn {
   protected:
     void defaultOnClose();
 
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
     ndk::ScopedAStatus getStreamCommon(std::shared_ptr<IStreamCommon>* _aidl_return) override {
         return getStreamCommonCommon(_aidl_return);
     }
@@ -506,6 +554,8 @@ class StreamOut : virtual public StreamCommonInterface, public BnStreamOut {
   protected:
     void defaultOnClose();
 
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
     ndk::ScopedAStatus getStreamCommon(std::shared_ptr<IStreamCommon>* _aidl_return) override {
         return getStreamCommonCommon(_aidl_return);
     }
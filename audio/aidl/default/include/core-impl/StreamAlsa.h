@@ -16,10 +16,12 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "Stream.h"
+#include "alsa/DeviceWriter.h"
 #include "alsa/Utils.h"
 
 namespace aidl::android::hardware::audio::core {
@@ -42,10 +44,16 @@ class StreamAlsa : public StreamCommonImpl {
     ::android::status_t transfer(void* buffer, size_t frameCount, size_t* actualFrameCount,
                                  int32_t* latencyMs) override;
     ::android::status_t refinePosition(StreamDescriptor::Position* position) override;
+    ::android::status_t openMmapBuffer(MmapBufferDescriptor* desc) override;
+    ::android::status_t getMmapPositionAndLatency(StreamDescriptor::Position* position,
+                                                  int32_t* latencyMs) override;
     void shutdown() override;
 
   protected:
+    static constexpr unsigned int kMmapPeriodCount = 4;
+
     // Called from 'start' to initialize 'mAlsaDeviceProxies', the vector must be non-empty.
+    // For MMap streams, it is called from 'openMmapBuffer' and only the first device is used.
     virtual std::vector<alsa::DeviceProfile> getDeviceProfiles() = 0;
 
     const size_t mBufferSizeFrames;
@@ -54,8 +62,18 @@ class StreamAlsa : public StreamCommonImpl {
     const bool mIsInput;
     const std::optional<struct pcm_config> mConfig;
     const int mReadWriteRetries;
+    const bool mIsMmap;
+    // The MMap PCM is opened on a Binder thread by 'openMmapBuffer' before the worker thread
+    // starts handling commands, and is only used on the worker thread after that.
+    using MmapPcm = std::unique_ptr<struct pcm, decltype(&pcm_close)>;
+    MmapPcm mMmapPcm{nullptr, pcm_close};
+    size_t mMmapBurstSizeFrames = 0;
     // All fields below are only used on the worker thread.
+    // For output streams with several devices, only the first device is written on the worker
+    // thread, the rest are written by 'mDeviceWriters' on their own threads.
     std::vector<alsa::DeviceProxy> mAlsaDeviceProxies;
+    std::vector<std::unique_ptr<alsa::DeviceWriter>> mDeviceWriters;
+    bool mMmapStarted = false;
 };
 
 }  // namespace aidl::android::hardware::audio::core
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <mutex>
+#include <optional>
 #include <vector>
 
 #include <aidl/android/hardware/audio/core/IBluetooth.h>
@@ -58,16 +59,42 @@ class StreamBluetooth : public StreamCommonImpl {
     ndk::ScopedAStatus bluetoothParametersUpdated() override;
 
   private:
+    // Getting the presentation position is an IPC to the BT stack, so a position is reused for
+    // this long, and extrapolated at the sample rate in the meantime.
+    static constexpr int64_t kPresentationPositionMaxAgeNs = 100'000'000;
+    // Writes are paced to keep at most this many data intervals queued in the BT HAL.
+    static constexpr int kMaxQueuedIntervals = 4;
+
+    // Forgets the frames transferred so far, when the BT HAL has dropped them.
+    void resetPositionLocked() REQUIRES(mLock);
+    void refreshPresentationPositionLocked(bool force) REQUIRES(mLock);
+    // The feeding delay of an output stream: frames written that the BT stack hasn't sent to the
+    // remote device yet. The starving delay of an input stream: frames received from the remote
+    // device that haven't been read yet.
+    int64_t getQueuedFramesLocked(int64_t nowNs) REQUIRES(mLock);
+    int32_t getLatencyMsLocked(int64_t nowNs) REQUIRES(mLock);
+    int64_t framesToUs(int64_t frames) const;
+
     const size_t mFrameSizeBytes;
     const bool mIsInput;
     const std::weak_ptr<IBluetoothA2dp> mBluetoothA2dp;
     const std::weak_ptr<IBluetoothLe> mBluetoothLe;
     const size_t mPreferredDataIntervalUs;
     const size_t mPreferredFrameCount;
+    const int32_t mSampleRate;
     mutable std::mutex mLock;
     // The lock is also used to serialize calls to the proxy.
     std::shared_ptr<::android::bluetooth::audio::aidl::BluetoothAudioPortAidl> mBtDeviceProxy
             GUARDED_BY(mLock);  // proxy may be null if the stream is not connected to a device
+    // Frames transferred since the stream was last reset.
+    int64_t mFramesTransferred GUARDED_BY(mLock) = 0;
+    // The last presentation position and when it was taken, per uptimeNanos(). The octet count
+    // of the BT stack only resets when the session stops, so mTransmittedOctetsBase holds its
+    // first value since the stream was reset.
+    std::optional<::aidl::android::hardware::bluetooth::audio::PresentationPosition>
+            mPresentationPosition GUARDED_BY(mLock);
+    int64_t mPresentationPositionTimeNs GUARDED_BY(mLock) = 0;
+    std::optional<int64_t> mTransmittedOctetsBase GUARDED_BY(mLock);
 };
 
 class StreamInBluetooth final : public StreamIn, public StreamBluetooth {
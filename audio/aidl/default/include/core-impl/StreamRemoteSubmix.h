@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 
 #include "core-impl/Stream.h"
@@ -43,10 +44,11 @@ class StreamRemoteSubmix : public StreamCommonImpl {
 
     // Overridden methods of 'StreamCommonImpl', called on a Binder thread.
     ndk::ScopedAStatus prepareToClose() override;
+    std::string dumpWorker() const override;
 
   private:
     long getDelayInUsForFrameCount(size_t frameCount);
-    size_t getStreamPipeSizeInFrames();
+    void refreshPipe();
     ::android::status_t outWrite(void* buffer, size_t frameCount, size_t* actualFrameCount);
     ::android::status_t inRead(void* buffer, size_t frameCount, size_t* actualFrameCount);
 
@@ -68,6 +70,16 @@ class StreamRemoteSubmix : public StreamCommonImpl {
     long mFramesSinceStart = 0;
     int mReadErrorCount = 0;
     int mReadFailureCount = 0;
+    // References to the pipe of the route, taken again when the route changes the pipe.
+    uint32_t mPipeGeneration = 0;
+    sp<MonoPipe> mSink;
+    sp<MonoPipeReader> mSource;
+    // The maximum size of the pipe buffer in frames for this stream.
+    size_t mStreamPipeSizeInFrames = 0;
+    // Capture statistics, updated on the worker thread and read by 'dump'.
+    std::atomic<int32_t> mCaptureLatencyMs = 0;
+    std::atomic<int32_t> mMaxCaptureLatencyMs = 0;
+    std::atomic<uint64_t> mShortReadCount = 0;
 };
 
 class StreamInRemoteSubmix final : public StreamIn, public StreamSwitcher {
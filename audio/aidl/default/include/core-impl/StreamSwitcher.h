@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include "Stream.h"
 
 namespace aidl::android::hardware::audio::core {
@@ -47,6 +49,12 @@ namespace aidl::android::hardware::audio::core {
 // reported to the caller of 'IModule.setAudioPatch' as the 'EX_ILLEGAL_STATE'
 // error.
 //
+// In order to shorten the time the stream is offline, the new stream implementation is
+// created by 'createNewStream' on a separate thread, while the current stream is being
+// stopped. Thus, 'createNewStream' must not access the current stream. The duration of
+// each switch, from stopping the current stream until the new one is fully set up,
+// is reported by 'dumpWorker'.
+//
 // The simplest use case, when the implementor just needs to emulate the legacy HAL API
 // behavior of receiving the connected devices upon stream creation, the implementation
 // of the extending class can look as follows. We assume that 'StreamLegacy' implementation
@@ -130,6 +138,8 @@ class StreamSwitcher : virtual public StreamCommonInterface {
             const std::vector<::aidl::android::media::audio::common::AudioDevice>& devices)
             override;
     ndk::ScopedAStatus bluetoothParametersUpdated() override;
+    ndk::ScopedAStatus createMmapBuffer(MmapBufferDescriptor* desc) override;
+    std::string dumpWorker() const override;
 
   protected:
     // Since switching a stream requires closing down the current stream, StreamSwitcher
@@ -172,6 +182,7 @@ class StreamSwitcher : virtual public StreamCommonInterface {
     }
 
     ndk::ScopedAStatus closeCurrentStream(bool validateStreamState);
+    static void discardStream(std::unique_ptr<StreamCommonInterfaceEx> stream);
 
     // StreamSwitcher does not own the context.
     StreamContext* mContext;
@@ -189,6 +200,10 @@ class StreamSwitcher : virtual public StreamCommonInterface {
     std::vector<VndParam> mMissedParameters;
     std::vector<std::shared_ptr<::aidl::android::hardware::audio::effect::IEffect>> mEffects;
     bool mBluetoothParametersUpdated = false;
+    // Statistics of the stream switches.
+    size_t mSwitchCount = 0;
+    std::chrono::microseconds mLastSwitchDuration{0};
+    std::chrono::microseconds mMaxSwitchDuration{0};
 };
 
 }  // namespace aidl::android::hardware::audio::core
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace aidl::android::hardware::audio::core {
@@ -102,6 +103,51 @@ std::vector<T*> selectByIds(std::vector<T>& v, const std::vector<int32_t>& ids,
     return result;
 }
 
+// Maps ids of the elements of a vector to their positions, for the vectors of elements
+// that have an 'id' field. Every hit is verified against the vector, and the index is rebuilt
+// on a miss. Thus, the index never returns a wrong element, and does not need to be notified
+// about changes to the vector. Lookups of existing elements are O(1) on average.
+template <typename T>
+class IdIndex {
+  public:
+    typename std::vector<T>::iterator find(std::vector<T>& v, int32_t id) {
+        if (auto it = lookup(v, id); it != v.end()) return it;
+        rebuild(v);
+        return lookup(v, id);
+    }
+
+    // Same as 'selectByIds', but returns the elements in the order of their ids.
+    std::vector<T*> select(std::vector<T>& v, const std::vector<int32_t>& ids,
+                           std::vector<int32_t>* missingIds = nullptr) {
+        std::vector<T*> result;
+        std::set<int32_t> idsSet(ids.begin(), ids.end());
+        if (missingIds) missingIds->clear();
+        for (int32_t id : idsSet) {
+            if (auto it = find(v, id); it != v.end()) {
+                result.push_back(&*it);
+            } else if (missingIds) {
+                missingIds->push_back(id);
+            }
+        }
+        return result;
+    }
+
+  private:
+    typename std::vector<T>::iterator lookup(std::vector<T>& v, int32_t id) const {
+        if (auto it = mPositions.find(id); it != mPositions.end()) {
+            if (it->second < v.size() && v[it->second].id == id) return v.begin() + it->second;
+        }
+        return v.end();
+    }
+    void rebuild(const std::vector<T>& v) {
+        mPositions.clear();
+        mPositions.reserve(v.size());
+        for (size_t i = 0; i < v.size(); ++i) mPositions.emplace(v[i].id, i);
+    }
+
+    std::unordered_map<int32_t, size_t> mPositions;
+};
+
 // Assuming that M is a map whose keys' type is K and values' type is V,
 // return the corresponding value of the given key from the map or default
 // value if the key is not found.
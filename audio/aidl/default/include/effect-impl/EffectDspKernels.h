@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * Float DSP primitives shared by the software effect implementations.
+ *
+ * All buffers are interleaved 32 bits float samples. Input and output buffers can be the same
+ * buffer, but must not partially overlap. The kernels are vectorized with NEON on ARM and SSE on
+ * x86, both of which are always available on the supported ABIs, and fall back to scalar code on
+ * any other architecture.
+ */
+namespace aidl::android::hardware::audio::effect::dsp {
+
+float dbToAmplitude(float db);
+float amplitudeToDb(float amplitude);
+
+// out[i] = in[i] * gain
+void applyGain(const float* in, float* out, size_t samples, float gain);
+
+// Applies a gain linearly ramping from startGain on the first frame to endGain on the last frame.
+void applyGainRamp(const float* in, float* out, size_t frames, size_t channelCount,
+                   float startGain, float endGain);
+
+// out[frame][channel] = in[frame][channel] * gains[channel]
+void applyChannelGains(const float* in, float* out, size_t frames, size_t channelCount,
+                       const float* gains);
+
+// out[i] = a[i] + b[i]
+void add(const float* a, const float* b, float* out, size_t samples);
+
+// out[i] = a[i] - b[i]
+void subtract(const float* a, const float* b, float* out, size_t samples);
+
+// Returns the largest absolute sample value.
+float findPeak(const float* in, size_t samples);
+
+// Returns the sum of the squared samples.
+float sumOfSquares(const float* in, size_t samples);
+
+// accRe[i] + j * accIm[i] += (aRe[i] + j * aIm[i]) * (bRe[i] + j * bIm[i])
+void complexMultiplyAccumulate(const float* aRe, const float* aIm, const float* bRe,
+                               const float* bIm, float* accRe, float* accIm, size_t count);
+
+/**
+ * In place radix-2 FFT of complex data stored as separate arrays of the real and the imaginary
+ * parts. The size must be a power of 2. The inverse transform is not scaled by 1 / size.
+ */
+class Fft {
+  public:
+    explicit Fft(size_t size);
+
+    size_t getSize() const { return mSize; }
+    void forward(float* re, float* im) const;
+    void inverse(float* re, float* im) const;
+
+  private:
+    size_t mSize;
+    std::vector<size_t> mBitReverse;
+    std::vector<float> mCos, mSin;
+};
+
+/**
+ * Normalized biquad coefficients, with a0 == 1:
+ * H(z) = (b0 + b1 * z^-1 + b2 * z^-2) / (1 + a1 * z^-1 + a2 * z^-2)
+ */
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+
+    // Designs from the Audio EQ Cookbook. Frequencies are in Hz. A frequency at or above the
+    // Nyquist frequency results in a passthrough filter.
+    static BiquadCoefficients passthrough() { return {}; }
+    static BiquadCoefficients lowPass(float sampleRate, float frequency, float q);
+    static BiquadCoefficients peaking(float sampleRate, float frequency, float q, float gainDb);
+    static BiquadCoefficients lowShelf(float sampleRate, float frequency, float gainDb);
+    static BiquadCoefficients highShelf(float sampleRate, float frequency, float gainDb);
+};
+
+/**
+ * A biquad filter in transposed direct form II, with separate coefficients and state for each
+ * channel. Channels are processed four at a time in vector lanes.
+ */
+class BiquadFilter {
+  public:
+    explicit BiquadFilter(size_t channelCount = 0);
+
+    size_t getChannelCount() const { return mChannelCount; }
+    void setCoefficients(const BiquadCoefficients& coefficients);
+    void setCoefficients(size_t channel, const BiquadCoefficients& coefficients);
+    // clear the filter history
+    void reset();
+    void process(const float* in, float* out, size_t frames);
+
+  private:
+    size_t mChannelCount;
+    // structure of arrays indexed by channel, so that four channels load into one vector
+    std::vector<float> mB0, mB1, mB2, mA1, mA2;
+    std::vector<float> mS1, mS2;
+};
+
+/**
+ * A feed-forward dynamic range compressor for one channel of an interleaved buffer. With a large
+ * ratio and a zero knee width it is a limiter. Below the noise gate threshold the signal is
+ * attenuated by the expander ratio. Ratios not larger than 1 disable the corresponding gain stage.
+ */
+class Compressor {
+  public:
+    struct Config {
+        bool enable = false;
+        float attackTimeMs = 0.0f;
+        float releaseTimeMs = 0.0f;
+        float ratio = 1.0f;
+        float thresholdDb = 0.0f;
+        float kneeWidthDb = 0.0f;
+        float noiseGateThresholdDb = -90.0f;
+        float expanderRatio = 1.0f;
+        float preGainDb = 0.0f;
+        float postGainDb = 0.0f;
+    };
+
+    void configure(float sampleRate, const Config& config);
+    void reset() { mEnvelope = 0.0f; }
+
+    // Processes the samples of one channel, which are stride samples apart.
+    void process(const float* in, float* out, size_t frames, size_t stride);
+
+  private:
+    Config mConfig;
+    float mPreGain = 1.0f;
+    float mPostGain = 1.0f;
+    float mAttackCoefficient = 0.0f;
+    float mReleaseCoefficient = 0.0f;
+    // The gain is unity while the envelope is between these two amplitudes, so the gain curve,
+    // which needs the level in dB, is skipped for most samples.
+    float mUnityGainMin = 0.0f;
+    float mUnityGainMax = 0.0f;
+    // peak envelope of the input after the pre gain, in amplitude
+    float mEnvelope = 0.0f;
+
+    float computeGainDb(float levelDb) const;
+};
+
+}  // namespace aidl::android::hardware::audio::effect::dsp
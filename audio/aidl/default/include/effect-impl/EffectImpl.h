@@ -30,6 +30,10 @@
 
 extern "C" binder_exception_t destroyEffect(
         const std::shared_ptr<aidl::android::hardware::audio::effect::IEffect>& instanceSp);
+extern "C" binder_exception_t processEffect(
+        const std::shared_ptr<aidl::android::hardware::audio::effect::IEffect>& instanceSp,
+        float* in, float* out, int samples,
+        aidl::android::hardware::audio::effect::IEffect::Status* status);
 
 namespace aidl::android::hardware::audio::effect {
 
@@ -76,7 +80,8 @@ class EffectImpl : public BnEffect, public EffectThread {
      * cause deadlock.
      *
      * @param in address of input float buffer.
-     * @param out address of output float buffer.
+     * @param out address of output float buffer, it may or may not be the same as in. Both could
+     * point directly to the data FMQ memory.
      * @param samples number of samples to process.
      * @return IEffect::Status
      */
@@ -88,6 +93,13 @@ class EffectImpl : public BnEffect, public EffectThread {
      */
     void process() override;
 
+    /**
+     * processChained() is called by an effect chain session, which runs several effects back to
+     * back on its own worker thread and buffer instead of the effect data FMQs. The samples are
+     * passed through unchanged if the effect is not in PROCESSING state.
+     */
+    IEffect::Status processChained(float* in, float* out, int samples);
+
   protected:
     // current Hal version
     int mVersion = 0;
@@ -118,5 +130,14 @@ class EffectImpl : public BnEffect, public EffectThread {
     }
 
     ::android::hardware::EventFlag* mEventFlag;
+
+  private:
+    /**
+     * Reads samples from inputMQ, processes them with effectProcessImpl() and writes the result
+     * to outputMQ. The samples are processed in place on the FMQ memory regions, the work buffer
+     * is only used when an FMQ region wraps around.
+     */
+    IEffect::Status processDataMq(EffectContext::DataMQ* inputMQ, EffectContext::DataMQ* outputMQ,
+                                  float* buffer, size_t samples) REQUIRES(mImplMutex);
 };
 }  // namespace aidl::android::hardware::audio::effect
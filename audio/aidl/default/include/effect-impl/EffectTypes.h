@@ -30,11 +30,17 @@ typedef binder_exception_t (*EffectDestroyFunctor)(
 typedef binder_exception_t (*EffectQueryFunctor)(
         const ::aidl::android::media::audio::common::AudioUuid*,
         ::aidl::android::hardware::audio::effect::Descriptor*);
+typedef binder_exception_t (*EffectProcessFunctor)(
+        const std::shared_ptr<::aidl::android::hardware::audio::effect::IEffect>&, float* /* in */,
+        float* /* out */, int /* samples */,
+        ::aidl::android::hardware::audio::effect::IEffect::Status*);
 
 struct effect_dl_interface_s {
     EffectCreateFunctor createEffectFunc;
     EffectDestroyFunctor destroyEffectFunc;
     EffectQueryFunctor queryEffectFunc;
+    // optional, only needed to run the effect in an effect chain session
+    EffectProcessFunctor processEffectFunc;
 };
 
 namespace aidl::android::hardware::audio::effect {
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aidl/android/hardware/audio/effect/BnEffect.h>
+#include <android-base/thread_annotations.h>
+
+#include "effect-impl/EffectContext.h"
+#include "effect-impl/EffectThread.h"
+#include "effect-impl/EffectTypes.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * An effect chain session runs a list of co-located effect instances back to back on one worker
+ * thread, over one shared buffer, with a single set of status and data FMQs for the whole chain.
+ *
+ * The effects are still opened, configured and commanded through their own IEffect interfaces.
+ * An effect not in PROCESSING state is bypassed by the chain. The data FMQs of the effects are
+ * not used while they are in the chain.
+ *
+ * The chain status FMQ gets one status per processed period, with the first error of any effect
+ * in the chain, the samples consumed from the chain input FMQ, and the samples produced into the
+ * chain output FMQ. The status of each effect is available with getLastStatus().
+ */
+class EffectChain : public EffectThread {
+  public:
+    struct Member {
+        std::shared_ptr<IEffect> effect;
+        EffectProcessFunctor processFunc;
+    };
+
+    // All effects in the chain process in place, so the input and output frame size must be same.
+    EffectChain(const Parameter::Common& common, std::vector<Member> members);
+    ~EffectChain();
+
+    RetCode open(IEffect::OpenEffectReturn* ret);
+    RetCode close();
+    RetCode start();
+    RetCode stop();
+
+    size_t getEffectCount() const { return mMembers.size(); }
+    // Status of each effect for the last processed period, in the chain order.
+    std::vector<IEffect::Status> getLastStatus();
+
+    void process() override;
+
+  private:
+    const std::vector<Member> mMembers;
+    // FMQs and work buffer of the chain
+    const std::unique_ptr<EffectContext> mContext;
+
+    std::mutex mMutex;
+    bool mOpened GUARDED_BY(mMutex) = false;
+    bool mProcessing GUARDED_BY(mMutex) = false;
+    std::vector<IEffect::Status> mLastStatus GUARDED_BY(mMutex);
+    // never changes after construction, so it can be waited on without lock
+    ::android::hardware::EventFlag* mEventFlag;
+
+    RetCode notifyEventFlag();
+};
+
+}  // namespace aidl::android::hardware::audio::effect
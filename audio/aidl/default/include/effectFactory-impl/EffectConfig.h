@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include <android/binder_parcel.h>
 #include <cutils/properties.h>
 #include <tinyxml2.h>
 
@@ -75,7 +76,10 @@ class EffectConfig {
     static constexpr const char* kEffectLibApexPath = SOUND_FX_PATH;
 #undef SOUND_FX_PATH
 
-    int mSkippedElements;
+    // Must be incremented on any change to the parsing code or to the cache serialization.
+    static constexpr uint32_t kConfigCacheFormatVersion = 1;
+
+    int mSkippedElements = 0;
     /* Parsed Libraries result */
     std::unordered_map<std::string, std::string> mLibraryMap;
     /* Parsed Effects result */
@@ -86,6 +90,13 @@ class EffectConfig {
      */
     ProcessingLibrariesMap mProcessingMap;
 
+    /** Parse the xml file into the maps, return false if the file can not be loaded. */
+    bool parseFile(const std::string& file);
+
+    /** Serialization of the parsed maps into the configuration cache. */
+    binder_status_t readFromParcel(const AParcel* parcel);
+    binder_status_t writeToParcel(AParcel* parcel) const;
+
     /** @return all `node`s children that are elements and match the tag if provided. */
     std::vector<std::reference_wrapper<const tinyxml2::XMLElement>> getChildren(
             const tinyxml2::XMLNode& node, const char* childTag = nullptr);
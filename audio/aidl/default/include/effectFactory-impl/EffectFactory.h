@@ -17,14 +17,17 @@
 #pragma once
 
 #include <any>
+#include <atomic>
 #include <map>
 #include <optional>
 #include <set>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 #include <aidl/android/hardware/audio/effect/BnFactory.h>
 #include <android-base/thread_annotations.h>
+#include "EffectChain.h"
 #include "EffectConfig.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -80,6 +83,22 @@ class Factory : public BnFactory {
             const std::shared_ptr<::aidl::android::hardware::audio::effect::IEffect>& in_handle)
             override;
 
+    /**
+     * @brief Create an effect chain session, which runs the effect instances back to back on one
+     * worker thread with a single set of FMQs. Not part of the IFactory AIDL interface, it is for
+     * the clients in the same process as the factory.
+     *
+     * @param in_effects Effect instances created by this factory, in processing order. Each of
+     * them must already be opened with in_common.
+     * @param in_common Common parameter of the chain, the input and output must have the same
+     * base audio config because the effects process in place.
+     * @param _aidl_return A pointer to the created chain session.
+     * @return ndk::ScopedAStatus
+     */
+    ndk::ScopedAStatus createEffectChain(const std::vector<std::shared_ptr<IEffect>>& in_effects,
+                                         const Parameter::Common& in_common,
+                                         std::shared_ptr<EffectChain>* _aidl_return);
+
   private:
     const EffectConfig mConfig;
     ~Factory();
@@ -97,8 +116,15 @@ class Factory : public BnFactory {
                        std::string /* library name */>
             DlEntry;
 
+    // Libraries are registered from the config and opened on first use.
     std::map<aidl::android::media::audio::common::AudioUuid /* implUUID */, DlEntry> mEffectLibMap
             GUARDED_BY(mMutex);
+    std::map<aidl::android::media::audio::common::AudioUuid /* implUUID */, Descriptor>
+            mDescriptorCache GUARDED_BY(mMutex);
+
+    // Opens the libraries ahead of their first use, started by the constructor.
+    std::thread mPrewarmThread;
+    std::atomic_bool mStopPrewarm = false;
 
     typedef std::pair<aidl::android::media::audio::common::AudioUuid, ndk::SpAIBinder> EffectEntry;
     std::map<std::weak_ptr<IEffect>, EffectEntry, std::owner_less<>> mEffectMap GUARDED_BY(mMutex);
@@ -106,8 +132,11 @@ class Factory : public BnFactory {
     ndk::ScopedAStatus destroyEffectImpl_l(const std::shared_ptr<IEffect>& in_handle)
             REQUIRES(mMutex);
     void cleanupEffectMap_l() REQUIRES(mMutex);
-    bool openEffectLibrary(const ::aidl::android::media::audio::common::AudioUuid& impl,
-                           const std::string& path);
+    void registerEffectLibrary(const ::aidl::android::media::audio::common::AudioUuid& impl,
+                               const std::string& path);
+    /* Open the library of an implementation if not yet, nullptr if it is not supported */
+    DlEntry* loadEffectLibrary_l(const ::aidl::android::media::audio::common::AudioUuid& impl)
+            REQUIRES(mMutex);
     void createIdentityWithConfig(
             const EffectConfig::Library& configLib,
             const ::aidl::android::media::audio::common::AudioUuid& typeUuidStr,
@@ -117,7 +146,8 @@ class Factory : public BnFactory {
             const aidl::android::media::audio::common::AudioUuid& uuid, Descriptor* desc)
             REQUIRES(mMutex);
 
-    void loadEffectLibs();
+    void registerEffectLibs();
+    void prewarmEffectLibs();
     /* Get effect_dl_interface_s from library handle */
     void getDlSyms_l(DlEntry& entry) REQUIRES(mMutex);
 };
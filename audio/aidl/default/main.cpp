@@ -26,7 +26,6 @@
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
-#include "core-impl/AudioPolicyConfigXmlConverter.h"
 #include "core-impl/ChildInterface.h"
 #include "core-impl/Config.h"
 #include "core-impl/Module.h"
@@ -34,7 +33,7 @@
 using aidl::android::hardware::audio::core::ChildInterface;
 using aidl::android::hardware::audio::core::Config;
 using aidl::android::hardware::audio::core::Module;
-using aidl::android::hardware::audio::core::internal::AudioPolicyConfigXmlConverter;
+using aidl::android::hardware::audio::core::internal::loadAudioHalConfigs;
 
 namespace {
 
@@ -75,11 +74,11 @@ int main() {
     // Guaranteed log for b/210919187 and logd_integration_test
     LOG(INFO) << "Init for Audio AIDL HAL";
 
-    AudioPolicyConfigXmlConverter audioPolicyConverter{
-            ::android::audio_get_audio_policy_config_file()};
+    auto configs = loadAudioHalConfigs();
 
     // Make the default config service
-    auto config = ndk::SharedRefBase::make<Config>(audioPolicyConverter);
+    auto config = ndk::SharedRefBase::make<Config>(configs.surroundSoundConfig,
+                                                   configs.engineConfig);
     const std::string configFqn = std::string().append(Config::descriptor).append("/default");
     binder_status_t status =
             AServiceManager_addService(config->asBinder().get(), configFqn.c_str());
@@ -89,8 +88,8 @@ int main() {
 
     // Make modules
     std::vector<ChildInterface<Module>> moduleInstances;
-    auto configs(audioPolicyConverter.releaseModuleConfigs());
-    for (std::pair<std::string, std::unique_ptr<Module::Configuration>>& configPair : *configs) {
+    for (std::pair<std::string, std::unique_ptr<Module::Configuration>>& configPair :
+         *configs.moduleConfigs) {
         std::string name = configPair.first;
         if (auto instance = createModule(name, std::move(configPair.second)); instance) {
             moduleInstances.push_back(std::move(instance));
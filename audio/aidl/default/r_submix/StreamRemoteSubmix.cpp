@@ -41,6 +41,7 @@ StreamRemoteSubmix::StreamRemoteSubmix(StreamContext* context, const Metadata& m
     mStreamConfig.format = context->getFormat();
     mStreamConfig.channelLayout = context->getChannelLayout();
     mStreamConfig.sampleRate = context->getSampleRate();
+    mStreamConfig.periodFrameCount = context->getBufferSizeInFrames();
 }
 
 ::android::status_t StreamRemoteSubmix::init() {
@@ -126,12 +127,15 @@ void StreamRemoteSubmix::shutdown() {
         LOG(DEBUG) << __func__ << ": pipe destroyed";
         SubmixRoute::removeRoute(mDeviceAddress);
     }
+    mSink.clear();
+    mSource.clear();
     mCurrentRoute.reset();
 }
 
 ::android::status_t StreamRemoteSubmix::transfer(void* buffer, size_t frameCount,
                                                  size_t* actualFrameCount, int32_t* latencyMs) {
-    *latencyMs = getDelayInUsForFrameCount(getStreamPipeSizeInFrames()) / 1000;
+    refreshPipe();
+    *latencyMs = getDelayInUsForFrameCount(mStreamPipeSizeInFrames) / 1000;
     LOG(VERBOSE) << __func__ << ": Latency " << *latencyMs << "ms";
     mCurrentRoute->exitStandby(mIsInput);
     RETURN_STATUS_IF_ERROR(mIsInput ? inRead(buffer, frameCount, actualFrameCount)
@@ -152,11 +156,11 @@ void StreamRemoteSubmix::shutdown() {
 }
 
 ::android::status_t StreamRemoteSubmix::refinePosition(StreamDescriptor::Position* position) {
-    sp<MonoPipeReader> source = mCurrentRoute->getSource();
-    if (source == nullptr) {
+    refreshPipe();
+    if (mSource == nullptr) {
         return ::android::NO_INIT;
     }
-    const ssize_t framesInPipe = source->availableToRead();
+    const ssize_t framesInPipe = mSource->availableToRead();
     if (framesInPipe <= 0) {
         // No need to update the position frames
         return ::android::OK;
@@ -173,19 +177,38 @@ long StreamRemoteSubmix::getDelayInUsForFrameCount(size_t frameCount) {
     return frameCount * MICROS_PER_SECOND / mStreamConfig.sampleRate;
 }
 
-// Calculate the maximum size of the pipe buffer in frames for the specified stream.
-size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
-    auto pipeConfig = mCurrentRoute->getPipeConfig();
-    const size_t maxFrameSize = std::max(mStreamConfig.frameSize, pipeConfig.frameSize);
-    return (pipeConfig.frameCount * pipeConfig.frameSize) / maxFrameSize;
+// Only takes the route lock when the pipe has changed since the last call.
+void StreamRemoteSubmix::refreshPipe() {
+    if (const uint32_t generation = mCurrentRoute->getPipeGeneration();
+        generation != mPipeGeneration) {
+        mSink = mCurrentRoute->getSink();
+        mSource = mCurrentRoute->getSource();
+        // Calculate the maximum size of the pipe buffer in frames for this stream.
+        const auto pipeConfig = mCurrentRoute->getPipeConfig();
+        const size_t maxFrameSize = std::max(mStreamConfig.frameSize, pipeConfig.frameSize);
+        mStreamPipeSizeInFrames = (pipeConfig.frameCount * pipeConfig.frameSize) / maxFrameSize;
+        mPipeGeneration = generation;
+    }
+}
+
+std::string StreamRemoteSubmix::dumpWorker() const {
+    std::string result = StreamCommonImpl::dumpWorker();
+    if (mIsInput) {
+        result.append("\ncapture latency: ")
+                .append(std::to_string(mCaptureLatencyMs))
+                .append(" ms, max: ")
+                .append(std::to_string(mMaxCaptureLatencyMs))
+                .append(" ms, short reads: ")
+                .append(std::to_string(mShortReadCount));
+    }
+    return result;
 }
 
 ::android::status_t StreamRemoteSubmix::outWrite(void* buffer, size_t frameCount,
                                                  size_t* actualFrameCount) {
-    sp<MonoPipe> sink = mCurrentRoute->getSink();
+    sp<MonoPipe> sink = mSink;
     if (sink != nullptr) {
         if (sink->isShutdown()) {
-            sink.clear();
             LOG(DEBUG) << __func__ << ": pipe shutdown, ignoring the write";
             *actualFrameCount = frameCount;
             return ::android::OK;
@@ -201,7 +224,7 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
     const bool shouldBlockWrite = mCurrentRoute->shouldBlockWrite();
     size_t availableToWrite = sink->availableToWrite();
     // NOTE: sink has been checked above and sink and source life cycles are synchronized
-    sp<MonoPipeReader> source = mCurrentRoute->getSource();
+    sp<MonoPipeReader> source = mSource;
     // If the write to the sink should be blocked, flush enough frames from the pipe to make space
     // to write the most recent data.
     if (!shouldBlockWrite && availableToWrite < frameCount) {
@@ -229,7 +252,6 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
     if (writtenFrames < 0) {
         if (writtenFrames == (ssize_t)::android::NEGOTIATE) {
             LOG(ERROR) << __func__ << ": write to pipe returned NEGOTIATE";
-            sink.clear();
             *actualFrameCount = 0;
             return ::android::UNKNOWN_ERROR;
         } else {
@@ -258,7 +280,7 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
     *actualFrameCount = frameCount;
 
     // about to read from audio source
-    sp<MonoPipeReader> source = mCurrentRoute->getSource();
+    sp<MonoPipeReader> source = mSource;
     if (source == nullptr) {
         if (++mReadErrorCount < kMaxReadErrorLogs) {
             LOG(ERROR) << __func__
@@ -271,6 +293,14 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
 
     LOG(VERBOSE) << __func__ << ": " << mDeviceAddress.toString() << ", " << frameCount
                  << " frames";
+    // The data in the pipe has been written this long ago by the output stream.
+    const ssize_t framesInPipe = source->availableToRead();
+    const int32_t captureLatencyMs =
+            framesInPipe > 0 ? static_cast<int32_t>(getDelayInUsForFrameCount(framesInPipe) / 1000)
+                             : 0;
+    mCaptureLatencyMs = captureLatencyMs;
+    if (captureLatencyMs > mMaxCaptureLatencyMs) mMaxCaptureLatencyMs = captureLatencyMs;
+
     // read the data from the pipe
     char* buff = (char*)buffer;
     size_t actuallyRead = 0;
@@ -295,6 +325,7 @@ size_t StreamRemoteSubmix::getStreamPipeSizeInFrames() {
         }
     }
     if (actuallyRead < frameCount) {
+        ++mShortReadCount;
         if (++mReadFailureCount < kMaxReadFailureAttempts) {
             LOG(WARNING) << __func__ << ": read " << actuallyRead << " vs. requested " << frameCount
                          << " (not all errors will be logged)";
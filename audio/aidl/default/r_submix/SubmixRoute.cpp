@@ -125,7 +125,6 @@ bool SubmixRoute::isStreamConfigCompatible(const AudioConfig& streamConfig) {
 }
 
 bool SubmixRoute::hasAtleastOneStreamOpen() {
-    std::lock_guard guard(mLock);
     return (mStreamInOpen || mStreamOutOpen);
 }
 
@@ -136,14 +135,13 @@ bool SubmixRoute::hasAtleastOneStreamOpen() {
 // - the input was never activated to avoid discarding first frames in the pipe in case capture
 // start was delayed
 bool SubmixRoute::shouldBlockWrite() {
-    std::lock_guard guard(mLock);
     return (mStreamInOpen || (mStreamInStandby && (mReadCounterFrames != 0)));
 }
 
+// Only called by the input stream worker, while 'exitStandby' may reset the counter
+// concurrently, thus the update must be atomic.
 long SubmixRoute::updateReadCounterFrames(size_t frameCount) {
-    std::lock_guard guard(mLock);
-    mReadCounterFrames += frameCount;
-    return mReadCounterFrames;
+    return mReadCounterFrames.fetch_add(frameCount) + frameCount;
 }
 
 void SubmixRoute::openStream(bool isInput) {
@@ -191,8 +189,10 @@ void SubmixRoute::closeStream(bool isInput) {
     size_t numCounterOffers = 0;
 
     const size_t pipeSizeInFrames =
-            r_submix::kDefaultPipeSizeInFrames *
-            ((float)streamConfig.sampleRate / r_submix::kDefaultSampleRateHz);
+            streamConfig.periodFrameCount != 0
+                    ? streamConfig.periodFrameCount * r_submix::kDefaultPipePeriodCount
+                    : r_submix::kDefaultPipeSizeInFrames *
+                              ((float)streamConfig.sampleRate / r_submix::kDefaultSampleRateHz);
     LOG(VERBOSE) << __func__ << ": creating pipe, rate : " << streamConfig.sampleRate
                  << ", pipe size : " << pipeSizeInFrames;
 
@@ -231,6 +231,7 @@ void SubmixRoute::closeStream(bool isInput) {
         mPipeConfig.frameCount = sink->maxFrames();
         mSink = std::move(sink);
         mSource = std::move(source);
+        mPipeGeneration.fetch_add(1, std::memory_order_release);
     }
 
     return ::android::OK;
@@ -241,6 +242,7 @@ AudioConfig SubmixRoute::releasePipe() {
     std::lock_guard guard(mLock);
     mSink.clear();
     mSource.clear();
+    mPipeGeneration.fetch_add(1, std::memory_order_release);
     return mPipeConfig;
 }
 
@@ -290,7 +292,9 @@ std::string SubmixRoute::dump() NO_THREAD_SAFETY_ANALYSIS {
                                  .append(mStreamOutOpen ? "open" : "closed")
                                  .append(mStreamOutStandby ? ", standby" : ", active")
                                  .append(", framesWritten: ")
-                                 .append(mSink ? std::to_string(mSink->framesWritten()) : "<null>");
+                                 .append(mSink ? std::to_string(mSink->framesWritten()) : "<null>")
+                                 .append("; pipe frames: ")
+                                 .append(std::to_string(mPipeConfig.frameCount));
     if (isLocked) mLock.unlock();
     return result;
 }
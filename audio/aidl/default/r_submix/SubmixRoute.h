@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <string>
 
@@ -44,7 +45,7 @@ static constexpr int kDefaultSampleRateHz = 48000;
 // read from the sink. The maximum latency of the device is the size of the MonoPipe's buffer
 // the minimum latency is the MonoPipe buffer size divided by this value.
 static constexpr int kDefaultPipePeriodCount = 4;
-// Size at the default sample rate
+// Size at the default sample rate, used when the stream does not specify the period size.
 // NOTE: This value will be rounded up to the nearest power of 2 by MonoPipe.
 static constexpr int kDefaultPipeSizeInFrames = 1024 * kDefaultPipePeriodCount;
 
@@ -58,6 +59,9 @@ struct AudioConfig {
                     AudioChannelLayout::LAYOUT_STEREO);
     size_t frameSize;
     size_t frameCount;
+    // The buffer size of the stream which has created the pipe. The pipe holds
+    // kDefaultPipePeriodCount periods. If zero, the pipe uses kDefaultPipeSizeInFrames.
+    size_t periodFrameCount = 0;
 };
 
 class SubmixRoute {
@@ -71,26 +75,16 @@ class SubmixRoute {
             const ::aidl::android::media::audio::common::AudioDeviceAddress& deviceAddress);
     static std::string dumpRoutes();
 
-    bool isStreamInOpen() {
-        std::lock_guard guard(mLock);
-        return mStreamInOpen;
-    }
-    bool getStreamInStandby() {
-        std::lock_guard guard(mLock);
-        return mStreamInStandby;
-    }
-    bool isStreamOutOpen() {
-        std::lock_guard guard(mLock);
-        return mStreamOutOpen;
-    }
-    bool getStreamOutStandby() {
-        std::lock_guard guard(mLock);
-        return mStreamOutStandby;
-    }
-    long getReadCounterFrames() {
-        std::lock_guard guard(mLock);
-        return mReadCounterFrames;
-    }
+    // The state accessors below are lock-free, they are called by the stream workers on every
+    // transfer. State changes are still serialized by 'mLock'.
+    bool isStreamInOpen() const { return mStreamInOpen; }
+    bool getStreamInStandby() const { return mStreamInStandby; }
+    bool isStreamOutOpen() const { return mStreamOutOpen; }
+    bool getStreamOutStandby() const { return mStreamOutStandby; }
+    long getReadCounterFrames() const { return mReadCounterFrames; }
+    // Changes every time the pipe is created or released. Allows the streams to keep their own
+    // references to the sink and the source, and to only take the lock when they have changed.
+    uint32_t getPipeGeneration() const { return mPipeGeneration.load(std::memory_order_acquire); }
     sp<MonoPipe> getSink() {
         std::lock_guard guard(mLock);
         return mSink;
@@ -140,14 +134,16 @@ class SubmixRoute {
 
     std::mutex mLock;
     AudioConfig mPipeConfig GUARDED_BY(mLock);
-    bool mStreamInOpen GUARDED_BY(mLock) = false;
+    // Atomic fields are only modified under 'mLock', but can be read without it.
+    std::atomic<bool> mStreamInOpen = false;
     int mInputRefCount GUARDED_BY(mLock) = 0;
-    bool mStreamInStandby GUARDED_BY(mLock) = true;
+    std::atomic<bool> mStreamInStandby = true;
     bool mStreamOutStandbyTransition GUARDED_BY(mLock) = false;
-    bool mStreamOutOpen GUARDED_BY(mLock) = false;
-    bool mStreamOutStandby GUARDED_BY(mLock) = true;
+    std::atomic<bool> mStreamOutOpen = false;
+    std::atomic<bool> mStreamOutStandby = true;
     // how many frames have been requested to be read since standby
-    long mReadCounterFrames GUARDED_BY(mLock) = 0;
+    std::atomic<long> mReadCounterFrames = 0;
+    std::atomic<uint32_t> mPipeGeneration = 0;
 
     // Pipe variables: they handle the ring buffer that "pipes" audio:
     //  - from the submix virtual audio output == what needs to be played
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#define LOG_TAG "AHAL_BinauralRenderer"
+#include <Utils.h>
+#include <android-base/logging.h>
+
+#include "BinauralRenderer.h"
+
+using aidl::android::media::audio::common::AudioChannelLayout;
+
+namespace aidl::android::hardware::audio::effect {
+
+namespace {
+
+// spherical head model
+constexpr double kHeadRadiusM = 0.0875;
+constexpr double kSpeedOfSoundMs = 343.0;
+// Leaves room for the pre-ringing of the fractional delay.
+constexpr double kBaseDelayFrames = 8.0;
+constexpr size_t kImpulseResponseFrames = HrtfTable::kPartitionCount * HrtfTable::kBlockFrames;
+// twice the impulse response, which keeps the time aliasing of the design low
+constexpr size_t kDesignFftSize = 2 * kImpulseResponseFrames;
+
+struct ChannelPosition {
+    int32_t channel;
+    float azimuthDegrees;
+    float gain;
+};
+
+// Elevation is not modeled, the height channels are rendered at the azimuth of their
+// horizontal counterpart.
+const ChannelPosition kChannelPositions[] = {
+        {AudioChannelLayout::CHANNEL_FRONT_LEFT, -30, 1.0f},
+        {AudioChannelLayout::CHANNEL_FRONT_RIGHT, 30, 1.0f},
+        {AudioChannelLayout::CHANNEL_FRONT_CENTER, 0, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_LOW_FREQUENCY, 0, 0.5f},
+        {AudioChannelLayout::CHANNEL_BACK_LEFT, -110, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_BACK_RIGHT, 110, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_FRONT_LEFT_OF_CENTER, -15, 1.0f},
+        {AudioChannelLayout::CHANNEL_FRONT_RIGHT_OF_CENTER, 15, 1.0f},
+        {AudioChannelLayout::CHANNEL_BACK_CENTER, 180, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_SIDE_LEFT, -90, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_SIDE_RIGHT, 90, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_TOP_CENTER, 0, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_LEFT, -30, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_CENTER, 0, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_FRONT_RIGHT, 30, M_SQRT1_2},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_LEFT, -110, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_CENTER, 180, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_BACK_RIGHT, 110, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_SIDE_LEFT, -90, 0.5f},
+        {AudioChannelLayout::CHANNEL_TOP_SIDE_RIGHT, 90, 0.5f},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_LEFT, -30, 0.5f},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_CENTER, 0, 0.5f},
+        {AudioChannelLayout::CHANNEL_BOTTOM_FRONT_RIGHT, 30, 0.5f},
+        {AudioChannelLayout::CHANNEL_LOW_FREQUENCY_2, 0, 0.5f},
+        {AudioChannelLayout::CHANNEL_FRONT_WIDE_LEFT, -60, 1.0f},
+        {AudioChannelLayout::CHANNEL_FRONT_WIDE_RIGHT, 60, 1.0f},
+};
+
+// Returns the positions of the channels in the order of interleaving.
+std::vector<ChannelPosition> getChannelPositions(const AudioChannelLayout& layout) {
+    std::vector<ChannelPosition> result;
+    if (layout.getTag() == AudioChannelLayout::layoutMask) {
+        const int32_t mask = layout.get<AudioChannelLayout::layoutMask>();
+        // Channels are interleaved in the ascending order of their bits.
+        for (int bit = 0; bit < 32; ++bit) {
+            const int32_t channel = static_cast<int32_t>(1u << bit);
+            if ((mask & channel) == 0) continue;
+            auto it = std::find_if(std::begin(kChannelPositions), std::end(kChannelPositions),
+                                   [&](const auto& p) { return p.channel == channel; });
+            // Channels without a position, like haptic ones, are not rendered.
+            result.push_back(it != std::end(kChannelPositions) ? *it
+                                                               : ChannelPosition{channel, 0, 0});
+        }
+        return result;
+    }
+    // Without positions, treat the channels as a front pair followed by centered ones.
+    const size_t count = ::aidl::android::hardware::audio::common::getChannelCount(layout);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back({0, i == 0 ? -30.0f : (i == 1 ? 30.0f : 0.0f), i < 2 ? 1.0f : 0.5f});
+    }
+    return result;
+}
+
+}  // namespace
+
+// static
+std::shared_ptr<const HrtfTable> HrtfTable::getForSampleRate(int sampleRate) {
+    static std::mutex mutex;
+    static std::map<int, std::weak_ptr<const HrtfTable>> tables;
+    std::lock_guard lock(mutex);
+    if (auto table = tables[sampleRate].lock()) return table;
+    auto table = std::make_shared<const HrtfTable>(sampleRate);
+    tables[sampleRate] = table;
+    return table;
+}
+
+// static
+size_t HrtfTable::getAzimuthIndex(float azimuthDegrees) {
+    float wrapped = std::fmod(azimuthDegrees, 360.0f);
+    if (wrapped < 0) wrapped += 360.0f;
+    return static_cast<size_t>(std::lround(wrapped / kAzimuthStepDegrees)) % kAzimuthCount;
+}
+
+HrtfTable::HrtfTable(int sampleRate)
+    : mSpectra(static_cast<float*>(::operator new[](
+              kAzimuthCount * EAR_COUNT * kPartitionCount * 2 * kBinStride * sizeof(float),
+              kAlignment))) {
+    std::fill(mSpectra.get(),
+              mSpectra.get() + kAzimuthCount * EAR_COUNT * kPartitionCount * 2 * kBinStride, 0.0f);
+    const dsp::Fft designFft(kDesignFftSize);
+    const dsp::Fft fft(kFftSize);
+    std::vector<float> impulseResponse(kImpulseResponseFrames);
+    std::vector<float> re(kFftSize), im(kFftSize);
+    for (size_t azimuthIndex = 0; azimuthIndex < kAzimuthCount; ++azimuthIndex) {
+        for (Ear ear : {LEFT, RIGHT}) {
+            computeImpulseResponse(azimuthIndex * kAzimuthStepDegrees, ear, sampleRate,
+                                   designFft, impulseResponse.data());
+            for (size_t partition = 0; partition < kPartitionCount; ++partition) {
+                const float* part = impulseResponse.data() + partition * kBlockFrames;
+                std::copy(part, part + kBlockFrames, re.begin());
+                std::fill(re.begin() + kBlockFrames, re.end(), 0.0f);
+                std::fill(im.begin(), im.end(), 0.0f);
+                fft.forward(re.data(), im.data());
+                float* outRe = mSpectra.get() + getOffset(azimuthIndex, ear, partition);
+                std::copy(re.begin(), re.begin() + kBinCount, outRe);
+                std::copy(im.begin(), im.begin() + kBinCount, outRe + kBinStride);
+            }
+        }
+    }
+    LOG(DEBUG) << __func__ << ": computed for " << sampleRate << " Hz";
+}
+
+void HrtfTable::computeImpulseResponse(float azimuthDegrees, Ear ear, int sampleRate,
+                                       const dsp::Fft& fft, float* out) const {
+    // the angle between the source and the ear, from 0 to pi
+    const float earAzimuthDegrees = ear == LEFT ? -90.0f : 90.0f;
+    const double theta =
+            std::fabs(std::remainder(azimuthDegrees - earAzimuthDegrees, 360.0)) * M_PI / 180.0;
+    // Woodworth
+    const double delaySeconds = theta < M_PI_2
+                                        ? kHeadRadiusM / kSpeedOfSoundMs * (1 - std::cos(theta))
+                                        : kHeadRadiusM / kSpeedOfSoundMs * (theta - M_PI_2 + 1);
+    const double delayFrames = kBaseDelayFrames + delaySeconds * sampleRate;
+    // Brown and Duda: H(w) = (1 + j * alpha * w / (2 * w0)) / (1 + j * w / (2 * w0))
+    const double alpha = 1.05 + 0.95 * std::cos(theta * 180.0 / 150.0);
+    const double w0 = kSpeedOfSoundMs / kHeadRadiusM;
+
+    std::vector<float> re(kDesignFftSize), im(kDesignFftSize);
+    for (size_t k = 0; k < kDesignFftSize; ++k) {
+        // the bins above the Nyquist frequency are the negative frequencies
+        const double bin = k <= kDesignFftSize / 2 ? static_cast<double>(k)
+                                                   : static_cast<double>(k) - kDesignFftSize;
+        const double w = 2 * M_PI * bin / kDesignFftSize * sampleRate;
+        const double x = w / (2 * w0);
+        // (1 + j * alpha * x) / (1 + j * x)
+        const double shadowRe = (1 + alpha * x * x) / (1 + x * x);
+        const double shadowIm = (alpha - 1) * x / (1 + x * x);
+        const double phase = -2 * M_PI * bin / kDesignFftSize * delayFrames;
+        re[k] = shadowRe * std::cos(phase) - shadowIm * std::sin(phase);
+        im[k] = shadowRe * std::sin(phase) + shadowIm * std::cos(phase);
+    }
+    // keep the response real
+    im[kDesignFftSize / 2] = 0;
+    fft.inverse(re.data(), im.data());
+    // fade out the last quarter of the truncated response
+    const size_t fadeStart = kImpulseResponseFrames * 3 / 4;
+    for (size_t n = 0; n < kImpulseResponseFrames; ++n) {
+        float window = 1.0f;
+        if (n >= fadeStart) {
+            window = 0.5f * (1 + std::cos(M_PI * (n - fadeStart) /
+                                          (kImpulseResponseFrames - fadeStart)));
+        }
+        out[n] = re[n] / kDesignFftSize * window;
+    }
+}
+
+BinauralRenderer::BinauralRenderer(int sampleRate, const AudioChannelLayout& inLayout)
+    : mTable(HrtfTable::getForSampleRate(sampleRate)),
+      mFftRe(HrtfTable::kFftSize),
+      mFftIm(HrtfTable::kFftSize),
+      mAccRe(HrtfTable::kBinCount),
+      mAccIm(HrtfTable::kBinCount),
+      mLeft(HrtfTable::kBlockFrames),
+      mRight(HrtfTable::kBlockFrames),
+      mPreviousLeft(HrtfTable::kBlockFrames),
+      mPreviousRight(HrtfTable::kBlockFrames),
+      mCrossfadeRamp(HrtfTable::kBlockFrames) {
+    for (const auto& position : getChannelPositions(inLayout)) {
+        Channel channel;
+        channel.azimuthDegrees = position.azimuthDegrees;
+        channel.gain = position.gain;
+        channel.azimuthIndex = HrtfTable::getAzimuthIndex(position.azimuthDegrees);
+        channel.previousAzimuthIndex = channel.azimuthIndex;
+        channel.history.resize(2 * HrtfTable::kBlockFrames);
+        channel.spectraRe.resize(HrtfTable::kPartitionCount * HrtfTable::kBinCount);
+        channel.spectraIm.resize(HrtfTable::kPartitionCount * HrtfTable::kBinCount);
+        mChannels.push_back(std::move(channel));
+    }
+    for (size_t i = 0; i < HrtfTable::kBlockFrames; ++i) {
+        mCrossfadeRamp[i] = static_cast<float>(i + 1) / HrtfTable::kBlockFrames;
+    }
+}
+
+void BinauralRenderer::process(const float* in, float* out, size_t frames,
+                               size_t outChannelCount) {
+    const size_t inChannelCount = mChannels.size();
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (size_t c = 0; c < inChannelCount; ++c) {
+            mChannels[c].history[HrtfTable::kBlockFrames + mBlockPosition] =
+                    in[c] * mChannels[c].gain;
+        }
+        out[0] = mLeft[mBlockPosition];
+        out[1] = mRight[mBlockPosition];
+        std::fill(out + 2, out + outChannelCount, 0.0f);
+        in += inChannelCount;
+        out += outChannelCount;
+        if (++mBlockPosition == HrtfTable::kBlockFrames) {
+            processBlock();
+            mBlockPosition = 0;
+        }
+    }
+}
+
+void BinauralRenderer::processBlock() {
+    constexpr size_t kBlockFrames = HrtfTable::kBlockFrames;
+    constexpr size_t kBinCount = HrtfTable::kBinCount;
+    mSpectraHead = (mSpectraHead + 1) % HrtfTable::kPartitionCount;
+    bool crossfade = false;
+    for (auto& channel : mChannels) {
+        // The channels move in the opposite direction to the head.
+        const size_t azimuthIndex =
+                HrtfTable::getAzimuthIndex(channel.azimuthDegrees - mHeadYawDegrees);
+        channel.previousAzimuthIndex = channel.azimuthIndex;
+        if (azimuthIndex != channel.azimuthIndex) {
+            channel.azimuthIndex = azimuthIndex;
+            crossfade = true;
+        }
+        std::copy(channel.history.begin(), channel.history.end(), mFftRe.begin());
+        std::fill(mFftIm.begin(), mFftIm.end(), 0.0f);
+        mFft.forward(mFftRe.data(), mFftIm.data());
+        std::copy(mFftRe.begin(), mFftRe.begin() + kBinCount,
+                  channel.spectraRe.begin() + mSpectraHead * kBinCount);
+        std::copy(mFftIm.begin(), mFftIm.begin() + kBinCount,
+                  channel.spectraIm.begin() + mSpectraHead * kBinCount);
+        // overlap-save, the current block becomes the previous one
+        std::copy(channel.history.begin() + kBlockFrames, channel.history.end(),
+                  channel.history.begin());
+    }
+    renderBlock(false /*usePreviousIndexes*/, &mLeft, &mRight);
+    if (crossfade) {
+        renderBlock(true /*usePreviousIndexes*/, &mPreviousLeft, &mPreviousRight);
+        for (size_t i = 0; i < kBlockFrames; ++i) {
+            mLeft[i] = mPreviousLeft[i] + (mLeft[i] - mPreviousLeft[i]) * mCrossfadeRamp[i];
+            mRight[i] = mPreviousRight[i] + (mRight[i] - mPreviousRight[i]) * mCrossfadeRamp[i];
+        }
+    }
+}
+
+void BinauralRenderer::renderBlock(bool usePreviousIndexes, std::vector<float>* left,
+                                   std::vector<float>* right) {
+    constexpr size_t kBlockFrames = HrtfTable::kBlockFrames;
+    constexpr size_t kBinCount = HrtfTable::kBinCount;
+    constexpr size_t kFftSize = HrtfTable::kFftSize;
+    constexpr size_t kPartitionCount = HrtfTable::kPartitionCount;
+    for (HrtfTable::Ear ear : {HrtfTable::LEFT, HrtfTable::RIGHT}) {
+        std::fill(mAccRe.begin(), mAccRe.end(), 0.0f);
+        std::fill(mAccIm.begin(), mAccIm.end(), 0.0f);
+        for (const auto& channel : mChannels) {
+            const size_t azimuthIndex =
+                    usePreviousIndexes ? channel.previousAzimuthIndex : channel.azimuthIndex;
+            for (size_t partition = 0; partition < kPartitionCount; ++partition) {
+                // partition k of the response applies to the input from k blocks ago
+                const size_t slot = (mSpectraHead + kPartitionCount - partition) % kPartitionCount;
+                dsp::complexMultiplyAccumulate(
+                        channel.spectraRe.data() + slot * kBinCount,
+                        channel.spectraIm.data() + slot * kBinCount,
+                        mTable->getRe(azimuthIndex, ear, partition),
+                        mTable->getIm(azimuthIndex, ear, partition), mAccRe.data(),
+                        mAccIm.data(), kBinCount);
+            }
+        }
+        // restore the conjugate symmetric half of the spectrum
+        std::copy(mAccRe.begin(), mAccRe.end(), mFftRe.begin());
+        std::copy(mAccIm.begin(), mAccIm.end(), mFftIm.begin());
+        for (size_t bin = 1; bin < kFftSize / 2; ++bin) {
+            mFftRe[kFftSize - bin] = mAccRe[bin];
+            mFftIm[kFftSize - bin] = -mAccIm[bin];
+        }
+        mFft.inverse(mFftRe.data(), mFftIm.data());
+        // only the second half is free of the circular wrap around
+        std::vector<float>& out = ear == HrtfTable::LEFT ? *left : *right;
+        dsp::applyGain(mFftRe.data() + kBlockFrames, out.data(), kBlockFrames, 1.0f / kFftSize);
+    }
+}
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <aidl/android/media/audio/common/AudioChannelLayout.h>
+
+#include "effect-impl/EffectDspKernels.h"
+
+namespace aidl::android::hardware::audio::effect {
+
+/**
+ * Head related transfer functions for the horizontal plane, precomputed for one sample rate.
+ * The impulse responses follow the spherical head model: the interaural time difference from
+ * the Woodworth formula, and the head shadow from the one pole, one zero filter by Brown and
+ * Duda. Each impulse response is split into partitions, which are stored as the spectra used
+ * by the partitioned convolution. The spectra are 64 bytes aligned.
+ *
+ * The tables are immutable, and shared by all renderers with the same sample rate.
+ */
+class HrtfTable {
+  public:
+    // also the size of a partition of the impulse responses
+    static constexpr size_t kBlockFrames = 64;
+    static constexpr size_t kFftSize = 2 * kBlockFrames;
+    // bins 0..kFftSize / 2, the other bins of the spectrum of a real signal are redundant
+    static constexpr size_t kBinCount = kFftSize / 2 + 1;
+    static constexpr size_t kPartitionCount = 4;
+    static constexpr int kAzimuthStepDegrees = 5;
+    static constexpr size_t kAzimuthCount = 360 / kAzimuthStepDegrees;
+    enum Ear { LEFT, RIGHT, EAR_COUNT };
+
+    static std::shared_ptr<const HrtfTable> getForSampleRate(int sampleRate);
+
+    explicit HrtfTable(int sampleRate);
+
+    // Azimuths are in degrees clockwise from the front, wrapped into [0, 360).
+    static size_t getAzimuthIndex(float azimuthDegrees);
+    const float* getRe(size_t azimuthIndex, Ear ear, size_t partition) const {
+        return mSpectra.get() + getOffset(azimuthIndex, ear, partition);
+    }
+    const float* getIm(size_t azimuthIndex, Ear ear, size_t partition) const {
+        return getRe(azimuthIndex, ear, partition) + kBinStride;
+    }
+
+  private:
+    static constexpr std::align_val_t kAlignment{64};
+    // bins padded to keep each array aligned
+    static constexpr size_t kBinStride = (kBinCount + 15) / 16 * 16;
+
+    struct AlignedDeleter {
+        void operator()(float* p) const { ::operator delete[](p, kAlignment); }
+    };
+
+    static size_t getOffset(size_t azimuthIndex, Ear ear, size_t partition) {
+        return ((azimuthIndex * EAR_COUNT + ear) * kPartitionCount + partition) * 2 * kBinStride;
+    }
+    void computeImpulseResponse(float azimuthDegrees, Ear ear, int sampleRate,
+                                const dsp::Fft& fft, float* out) const;
+
+    std::unique_ptr<float[], AlignedDeleter> mSpectra;
+};
+
+/**
+ * Renders a multichannel input to binaural stereo by uniformly partitioned convolution with
+ * the HRTF for the position of each input channel, overlap-save in the frequency domain.
+ * The audio is delayed by HrtfTable::kBlockFrames frames.
+ *
+ * The head rotation is applied at the start of the next block. When it moves any channel to
+ * another HRTF, the block is rendered both with the previous and the new HRTFs and crossfaded.
+ * Pose updates never allocate memory.
+ */
+class BinauralRenderer {
+  public:
+    BinauralRenderer(int sampleRate,
+                     const ::aidl::android::media::audio::common::AudioChannelLayout& inLayout);
+
+    size_t getInputChannelCount() const { return mChannels.size(); }
+    // Rotation of the head around the vertical axis, in degrees clockwise.
+    void setHeadYaw(float yawDegrees) { mHeadYawDegrees = yawDegrees; }
+    // Writes stereo frames into 'out', which is 'outChannelCount' channels wide.
+    void process(const float* in, float* out, size_t frames, size_t outChannelCount);
+
+  private:
+    struct Channel {
+        float azimuthDegrees = 0;
+        float gain = 1.0f;
+        size_t azimuthIndex = 0;
+        size_t previousAzimuthIndex = 0;
+        // the previous and the current input block
+        std::vector<float> history;
+        // spectra of the last kPartitionCount input blocks, the frequency-domain delay line
+        std::vector<float> spectraRe, spectraIm;
+    };
+
+    void processBlock();
+    void renderBlock(bool usePreviousIndexes, std::vector<float>* left, std::vector<float>* right);
+
+    const std::shared_ptr<const HrtfTable> mTable;
+    const dsp::Fft mFft{HrtfTable::kFftSize};
+    std::vector<Channel> mChannels;
+    float mHeadYawDegrees = 0;
+    // position of the newest block in the frequency-domain delay lines
+    size_t mSpectraHead = 0;
+    // position inside the current block, for both the input and the output
+    size_t mBlockPosition = 0;
+    // work buffers, allocated once
+    std::vector<float> mFftRe, mFftIm;
+    std::vector<float> mAccRe, mAccIm;
+    std::vector<float> mLeft, mRight, mPreviousLeft, mPreviousRight;
+    std::vector<float> mCrossfadeRamp;
+};
+
+}  // namespace aidl::android::hardware::audio::effect
@@ -21,6 +21,7 @@
 #include <android-base/logging.h>
 #include <system/audio_effects/effect_uuid.h>
 
+#include <cmath>
 #include <optional>
 
 using aidl::android::hardware::audio::common::getChannelCount;
@@ -160,10 +161,55 @@ IEffect::Status SpatializerSw::effectProcessImpl(float* in, float* out, int samp
 }
 
 SpatializerSwContext::SpatializerSwContext(int statusDepth, const Parameter::Common& common)
-    : EffectContext(statusDepth, common) {
+    : EffectContext(statusDepth, common),
+      mRenderer(std::make_unique<BinauralRenderer>(common.input.base.sampleRate,
+                                                   common.input.base.channelMask)) {
     LOG(DEBUG) << __func__;
 }
 
+RetCode SpatializerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = updateIOFrameSize(common); ret != RetCode::SUCCESS) {
+        return ret;
+    }
+    mCommon = common;
+    mRenderer = std::make_unique<BinauralRenderer>(common.input.base.sampleRate,
+                                                   common.input.base.channelMask);
+    updateHeadPose();
+    LOG(INFO) << __func__ << mCommon.toString();
+    return RetCode::SUCCESS;
+}
+
+// The pose is a translation followed by a rotation vector, which is the rotation axis scaled
+// by the angle in radians. Only the rotation around the vertical axis is rendered. The head frame
+// has X pointing to the right, Y to the front and Z up.
+void SpatializerSwContext::updateHeadPose() {
+    float yawDegrees = 0;
+    auto modeIt = mParamsMap.find(Spatializer::headTrackingMode);
+    auto dataIt = mParamsMap.find(Spatializer::headTrackingSensorData);
+    const bool enabled = modeIt == mParamsMap.end() ||
+                         modeIt->second.get<Spatializer::headTrackingMode>() !=
+                                 HeadTracking::Mode::DISABLED;
+    if (enabled && dataIt != mParamsMap.end()) {
+        const auto& sensorData = dataIt->second.get<Spatializer::headTrackingSensorData>();
+        if (sensorData.getTag() == HeadTracking::SensorData::headToStage) {
+            const auto& pose = sensorData.get<HeadTracking::SensorData::headToStage>();
+            if (pose.size() >= 6) {
+                const double angle = std::hypot(pose[3], pose[4], pose[5]);
+                // Rotate the forward vector (0, 1, 0) with the Rodrigues formula.
+                double x = 0, y = 1;
+                if (angle > 0) {
+                    const double kx = pose[3] / angle, ky = pose[4] / angle, kz = pose[5] / angle;
+                    const double c = std::cos(angle), s = std::sin(angle);
+                    x = -kz * s + kx * ky * (1 - c);
+                    y = c + ky * ky * (1 - c);
+                }
+                yawDegrees = std::atan2(x, y) * 180 / M_PI;
+            }
+        }
+    }
+    mRenderer->setHeadYaw(yawDegrees);
+}
+
 SpatializerSwContext::~SpatializerSwContext() {
     LOG(DEBUG) << __func__;
 }
@@ -187,27 +233,28 @@ ndk::ScopedAStatus SpatializerSwContext::setParam(TAG tag, Spatializer spatializ
               "supportedChannelLayoutGetOnly");
 
     mParamsMap[tag] = spatializer;
+    if (tag == Spatializer::headTrackingSensorData || tag == Spatializer::headTrackingMode) {
+        updateHeadPose();
+    }
     return ndk::ScopedAStatus::ok();
 }
 
 IEffect::Status SpatializerSwContext::process(float* in, float* out, int samples) {
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
     IEffect::Status status = {EX_ILLEGAL_ARGUMENT, 0, 0};
 
     const auto inputChannelCount = getChannelCount(mCommon.input.base.channelMask);
     const auto outputChannelCount = getChannelCount(mCommon.output.base.channelMask);
-    if (outputChannelCount < 2 || inputChannelCount < outputChannelCount) {
+    if (outputChannelCount < 2 || inputChannelCount < outputChannelCount ||
+        inputChannelCount != mRenderer->getInputChannelCount()) {
         LOG(ERROR) << __func__ << " invalid channel count, in: " << inputChannelCount
                    << " out: " << outputChannelCount;
         return status;
     }
 
+    // The renderer writes the output of the previous block before reading the input of the
+    // current one, so 'in' and 'out' may be the same buffer.
     int iFrames = samples / inputChannelCount;
-    for (int i = 0; i < iFrames; i++) {
-        std::memcpy(out, in, outputChannelCount);
-        in += inputChannelCount;
-        out += outputChannelCount;
-    }
+    mRenderer->process(in, out, iFrames, outputChannelCount);
     return {STATUS_OK, static_cast<int32_t>(iFrames * inputChannelCount),
             static_cast<int32_t>(iFrames * outputChannelCount)};
 }
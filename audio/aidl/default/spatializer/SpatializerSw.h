@@ -16,11 +16,13 @@
 
 #pragma once
 
+#include "BinauralRenderer.h"
 #include "effect-impl/EffectContext.h"
 #include "effect-impl/EffectImpl.h"
 
 #include <fmq/AidlMessageQueue.h>
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -36,10 +38,15 @@ class SpatializerSwContext final : public EffectContext {
     template <typename TAG>
     ndk::ScopedAStatus setParam(TAG tag, Spatializer spatializer);
 
+    RetCode setCommon(const Parameter::Common& common) override;
+
     IEffect::Status process(float* in, float* out, int samples);
 
   private:
     std::unordered_map<Spatializer::Tag, Spatializer> mParamsMap;
+    std::unique_ptr<BinauralRenderer> mRenderer;
+
+    void updateHeadPose();
 };
 
 class SpatializerSw final : public EffectImpl {
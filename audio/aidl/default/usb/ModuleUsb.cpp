@@ -123,6 +123,11 @@ void ModuleUsb::onExternalDeviceConnectionChanged(
     }
     usb::UsbAlsaMixerControl::getInstance().setDeviceConnectionState(profile->card, getMasterMute(),
                                                                      getMasterVolume(), connected);
+    if (!connected) {
+        // Keep the profiles of a device that is only detached from routing, they are still valid
+        // when it is attached again.
+        invalidateProfileCache(profile->card);
+    }
 }
 
 ndk::ScopedAStatus ModuleUsb::onMasterMuteChanged(bool mute) {
@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cmath>
+
 #define LOG_TAG "AHAL_VisualizerSw"
 
 #include <android-base/logging.h>
+#include <audio_utils/clock.h>
 #include <system/audio_effects/effect_uuid.h>
 
 #include "VisualizerSw.h"
@@ -199,14 +203,123 @@ RetCode VisualizerSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status VisualizerSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+void VisualizerSwContext::resetCaptureRing() {
+    mChannelCount = std::max<size_t>(
+            ::aidl::android::hardware::audio::common::getChannelCount(
+                    mCommon.input.base.channelMask),
+            1);
+    mCaptureRing.assign(kCaptureRingFrames * mChannelCount, 0.0f);
+    mWritePosition = 0;
+}
+
+RetCode VisualizerSwContext::setCommon(const Parameter::Common& common) {
+    if (auto ret = updateIOFrameSize(common); ret != RetCode::SUCCESS) {
+        return ret;
+    }
+    mCommon = common;
+    resetCaptureRing();
+    LOG(INFO) << __func__ << mCommon.toString();
+    return RetCode::SUCCESS;
+}
+
+template <typename F>
+void VisualizerSwContext::forEachRingPart(uint64_t position, size_t frames, F func) const {
+    const size_t start = position & (kCaptureRingFrames - 1);
+    const size_t firstPart = std::min(frames, kCaptureRingFrames - start);
+    func(start * mChannelCount, firstPart);
+    if (firstPart < frames) func(0, frames - firstPart);
+}
+
+// The processing thread only copies the samples, all the analysis is done when the client
+// asks for the capture or the measurement.
+IEffect::Status VisualizerSwContext::process(float* in, float* out, int samples) {
+    const size_t inFrames = samples / mChannelCount;
+    // Only the most recent frames of a buffer larger than the ring are kept.
+    const size_t frames = std::min(inFrames, kCaptureRingFrames);
+    const float* framesIn = in + (inFrames - frames) * mChannelCount;
+    forEachRingPart(mWritePosition + inFrames - frames, frames,
+                    [&](size_t offset, size_t partFrames) {
+                        std::copy(framesIn, framesIn + partFrames * mChannelCount,
+                                  mCaptureRing.begin() + offset);
+                        framesIn += partFrames * mChannelCount;
+                    });
+    mWritePosition += inFrames;
+    mLastProcessTime = std::chrono::steady_clock::now();
+    if (in != out) {
+        std::copy(in, in + samples, out);
     }
     return {STATUS_OK, samples, samples};
 }
 
+Visualizer::Measurement VisualizerSwContext::getVsMeasurement() const {
+    if (mMeasurementMode != Visualizer::MeasurementMode::PEAK_RMS || mWritePosition == 0) {
+        return {0, 0};
+    }
+    const size_t windowFrames = std::min<uint64_t>(
+            {mWritePosition, kCaptureRingFrames,
+             static_cast<uint64_t>(mCommon.input.base.sampleRate) * kMeasurementWindowMs /
+                     MILLIS_PER_SECOND});
+    if (windowFrames == 0) return {0, 0};
+    float peak = 0, sumOfSquares = 0;
+    forEachRingPart(mWritePosition - windowFrames, windowFrames,
+                    [&](size_t offset, size_t partFrames) {
+                        const float* part = mCaptureRing.data() + offset;
+                        peak = std::max(peak, dsp::findPeak(part, partFrames * mChannelCount));
+                        sumOfSquares += dsp::sumOfSquares(part, partFrames * mChannelCount);
+                    });
+    const float rms = std::sqrt(sumOfSquares / (windowFrames * mChannelCount));
+    // in millibels
+    return {.rms = static_cast<int>(dsp::amplitudeToDb(rms) * 100),
+            .peak = static_cast<int>(dsp::amplitudeToDb(peak) * 100)};
+}
+
+std::vector<uint8_t> VisualizerSwContext::getVsCaptureSampleBuffer() const {
+    // 0x80 is silence for unsigned 8 bits samples.
+    std::vector<uint8_t> result(mCaptureSize, 0x80);
+    const auto sinceLastProcessMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            std::chrono::steady_clock::now() - mLastProcessTime)
+                                            .count();
+    if (mWritePosition == 0 || sinceLastProcessMs > kMaxStallTimeMs) return result;
+
+    // The audio played out 'latency' ago is the one being heard now. Account for the time
+    // passed since the last processed buffer.
+    const int64_t latencyMs = std::max<int64_t>(mLatency - sinceLastProcessMs, 0);
+    const uint64_t available = std::min<uint64_t>(mWritePosition, kCaptureRingFrames);
+    const uint64_t latencyFrames = std::min<uint64_t>(
+            latencyMs * mCommon.input.base.sampleRate / MILLIS_PER_SECOND,
+            available > static_cast<uint64_t>(mCaptureSize) ? available - mCaptureSize : 0);
+    const uint64_t end = mWritePosition - latencyFrames;
+    const size_t frames = std::min<uint64_t>(end - (mWritePosition - available), mCaptureSize);
+
+    // Downmix to mono, the missing frames at the start remain silent.
+    std::vector<float> mono(mCaptureSize, 0.0f);
+    float* monoOut = mono.data() + (mCaptureSize - frames);
+    const float channelGain = 1.0f / mChannelCount;
+    forEachRingPart(end - frames, frames, [&](size_t offset, size_t partFrames) {
+        const float* part = mCaptureRing.data() + offset;
+        for (size_t i = 0; i < partFrames; ++i, part += mChannelCount) {
+            float sum = 0;
+            for (size_t c = 0; c < mChannelCount; ++c) sum += part[c];
+            *monoOut++ = sum * channelGain;
+        }
+    });
+    float gain = 1.0f;
+    if (mScalingMode == Visualizer::ScalingMode::NORMALIZED) {
+        // Scale the capture to use the full 8 bits range.
+        const float peak = dsp::findPeak(mono.data(), mono.size());
+        if (peak > 0) gain = 1.0f / peak;
+    }
+    dsp::applyGain(mono.data(), mono.data(), mono.size(), gain * 128.0f);
+    std::transform(mono.begin(), mono.end(), result.begin(), [](float sample) {
+        return static_cast<uint8_t>(std::clamp(std::lrint(sample) + 0x80, 0L, 0xFFL));
+    });
+    return result;
+}
+
 RetCode VisualizerSwContext::setVsCaptureSize(int captureSize) {
     mCaptureSize = captureSize;
     return RetCode::SUCCESS;
@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <vector>
 
+#include <Utils.h>
 #include <aidl/android/hardware/audio/effect/BnEffect.h>
 #include <system/audio_effects/effect_visualizer.h>
+#include "effect-impl/EffectDspKernels.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -31,13 +34,21 @@ class VisualizerSwContext final : public EffectContext {
     static constexpr int32_t kMinCaptureSize = VISUALIZER_CAPTURE_SIZE_MIN;
     static constexpr int32_t kMaxCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
     static constexpr int32_t kMaxLatencyMs = 3000;
+    // Must be a power of 2. Larger latencies are clamped to what the ring holds.
+    static constexpr size_t kCaptureRingFrames = 65536;
+    // The measurement covers the most recent audio of this duration.
+    static constexpr int32_t kMeasurementWindowMs = 200;
+    // The capture returns silence if no audio has been processed for this long.
+    static constexpr int32_t kMaxStallTimeMs = 1000;
+
     VisualizerSwContext(int statusDepth, const Parameter::Common& common)
         : EffectContext(statusDepth, common) {
         LOG(DEBUG) << __func__;
-        mCaptureSampleBuffer.resize(kMaxCaptureSize);
-        fill(mCaptureSampleBuffer.begin(), mCaptureSampleBuffer.end(), 0x80);
+        resetCaptureRing();
     }
 
+    RetCode setCommon(const Parameter::Common& common) override;
+
     RetCode setVsCaptureSize(int captureSize);
     int getVsCaptureSize() const { return mCaptureSize; }
 
@@ -50,16 +61,31 @@ class VisualizerSwContext final : public EffectContext {
     RetCode setVsLatency(int latency);
     int getVsLatency() const { return mLatency; }
 
-    Visualizer::Measurement getVsMeasurement() const { return mMeasurement; }
-    std::vector<uint8_t> getVsCaptureSampleBuffer() const { return mCaptureSampleBuffer; }
+    // The measurement and the capture are computed from the capture ring on request.
+    Visualizer::Measurement getVsMeasurement() const;
+    std::vector<uint8_t> getVsCaptureSampleBuffer() const;
+
+    // Passes the samples through and copies them into the capture ring.
+    IEffect::Status process(float* in, float* out, int samples);
 
   private:
     int mCaptureSize = kMaxCaptureSize;
     Visualizer::ScalingMode mScalingMode = Visualizer::ScalingMode::NORMALIZED;
     Visualizer::MeasurementMode mMeasurementMode = Visualizer::MeasurementMode::NONE;
     int mLatency = 0;
-    const Visualizer::Measurement mMeasurement = {0, 0};
-    std::vector<uint8_t> mCaptureSampleBuffer;
+
+    size_t mChannelCount = 0;
+    // interleaved frames, indexed by the position modulo kCaptureRingFrames
+    std::vector<float> mCaptureRing;
+    // total number of frames written into the ring
+    uint64_t mWritePosition = 0;
+    std::chrono::steady_clock::time_point mLastProcessTime;
+
+    void resetCaptureRing();
+    // Calls 'func(offset, frames)' for the one or two contiguous parts of the ring holding
+    // the frames [position, position + frames), the offset is in samples.
+    template <typename F>
+    void forEachRingPart(uint64_t position, size_t frames, F func) const;
 };
 
 class VisualizerSw final : public EffectImpl {
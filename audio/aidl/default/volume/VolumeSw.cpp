@@ -169,10 +169,36 @@ RetCode VolumeSw::releaseContext() {
 
 // Processing method running in EffectWorker thread.
 IEffect::Status VolumeSw::effectProcessImpl(float* in, float* out, int samples) {
-    // TODO: get data buffer and process.
-    LOG(DEBUG) << __func__ << " in " << in << " out " << out << " samples " << samples;
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++;
+    RETURN_VALUE_IF(!mContext, (IEffect::Status{EX_NULL_POINTER, 0, 0}), "nullContext");
+    return mContext->process(in, out, samples);
+}
+
+IEffect::Status VolumeSwContext::process(float* in, float* out, int samples) {
+    RETURN_VALUE_IF(mInputChannelCount == 0, (IEffect::Status{EX_ILLEGAL_STATE, 0, 0}),
+                    "zeroChannelCount");
+    const float targetGain = mMute ? 0.0f : dsp::dbToAmplitude(mLevel);
+    if (targetGain != mTargetGain) {
+        mTargetGain = targetGain;
+        mRampFramesLeft = std::max<size_t>(
+                1, mCommon.input.base.sampleRate * kRampDurationMs / 1000);
+        mRampStep = (mTargetGain - mCurrentGain) / mRampFramesLeft;
+    }
+
+    size_t processed = 0;
+    if (mRampFramesLeft > 0) {
+        const size_t frames = std::min(samples / mInputChannelCount, mRampFramesLeft);
+        const float startGain = mCurrentGain + mRampStep;
+        mRampFramesLeft -= frames;
+        mCurrentGain = mRampFramesLeft ? mCurrentGain + mRampStep * frames : mTargetGain;
+        dsp::applyGainRamp(in, out, frames, mInputChannelCount, startGain, mCurrentGain);
+        processed = frames * mInputChannelCount;
+    }
+    if (mCurrentGain == 1.0f) {
+        if (in != out) {
+            std::copy(in + processed, in + samples, out + processed);
+        }
+    } else {
+        dsp::applyGain(in + processed, out + processed, samples - processed, mCurrentGain);
     }
     return {STATUS_OK, samples, samples};
 }
@@ -183,7 +209,6 @@ RetCode VolumeSwContext::setVolLevel(int level) {
 }
 
 RetCode VolumeSwContext::setVolMute(bool mute) {
-    // TODO : Add implementation to modify mute
     mMute = mute;
     return RetCode::SUCCESS;
 }
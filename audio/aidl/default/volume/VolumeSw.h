@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <memory>
 
+#include "effect-impl/EffectDspKernels.h"
 #include "effect-impl/EffectImpl.h"
 
 namespace aidl::android::hardware::audio::effect {
@@ -40,9 +41,19 @@ class VolumeSwContext final : public EffectContext {
 
     bool getVolMute() const { return mMute; }
 
+    // Applies the level and mute. Whenever they change, the gain ramps linearly to the new value
+    // over kRampDurationMs to avoid zipper noise.
+    IEffect::Status process(float* in, float* out, int samples);
+
   private:
+    static constexpr int kRampDurationMs = 50;
     int mLevel = 0;
     bool mMute = false;
+    // the gain applied to the last processed frame
+    float mCurrentGain = 1.0f;
+    float mTargetGain = 1.0f;
+    float mRampStep = 0.0f;
+    size_t mRampFramesLeft = 0;
 };
 
 class VolumeSw final : public EffectImpl {
@@ -91,11 +91,20 @@ void ReadThread::doRead() {
             (int32_t)requestedToRead, (int32_t)availableToWrite);
         requestedToRead = availableToWrite;
     }
-    ssize_t readResult = mStream->read(mStream, &mBuffer[0], requestedToRead);
+    // Let the HAL read straight into the queue, unless the space wraps around.
+    StreamIn::DataMQ::MemTransaction tx;
+    uint8_t* data = &mBuffer[0];
+    const bool inPlace = mDataMQ->beginWrite(requestedToRead, &tx) &&
+                         tx.getFirstRegion().getAddress() != nullptr &&
+                         tx.getFirstRegion().getLength() >= requestedToRead;
+    if (inPlace) {
+        data = tx.getFirstRegion().getAddress();
+    }
+    ssize_t readResult = mStream->read(mStream, data, requestedToRead);
     mStatus.retval = Result::OK;
     if (readResult >= 0) {
         mStatus.reply.read = readResult;
-        if (!mDataMQ->write(&mBuffer[0], readResult)) {
+        if (!(inPlace ? mDataMQ->commitWrite(readResult) : mDataMQ->write(data, readResult))) {
             ALOGW("data message queue write failed");
         }
     } else {
@@ -376,9 +385,14 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
 
     // Create message queues.
     if (mDataMQ) {
-        ALOGE("the client attempts to call prepareForReading twice");
-        sendError(Result::INVALID_STATE);
-        return Void();
+        if (!isDataMQReplacementAllowed() ||
+            mStopReadThread.load(std::memory_order_relaxed)) {
+            ALOGE("the client attempts to call prepareForReading twice");
+            sendError(Result::INVALID_STATE);
+            return Void();
+        }
+        ALOGD("replacing the message queues, data MQ size %zu -> %u",
+              mDataMQ->getQuantumCount(), frameSize * framesCount);
     }
     std::unique_ptr<CommandMQ> tempCommandMQ(new CommandMQ(1));
 
@@ -424,6 +438,17 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
         sendError(Result::INVALID_ARGUMENTS);
         return Void();
     }
+    if (mReadThread.get()) {
+        // The previous thread uses the previous queues, which are about to be replaced.
+        mStopReadThread.store(true, std::memory_order_release);
+        mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::NOT_FULL));
+        status = mReadThread->join();
+        ALOGE_IF(status, "read thread exit error: %s", strerror(-status));
+        mStopReadThread.store(false, std::memory_order_release);
+        mReadThread.clear();
+        status = EventFlag::deleteEventFlag(&mEfGroup);
+        ALOGE_IF(status, "read MQ event flag deletion error: %s", strerror(-status));
+    }
     status = tempReadThread->run("reader", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start reader thread: %s", strerror(-status));
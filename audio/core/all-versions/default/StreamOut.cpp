@@ -88,8 +88,16 @@ void WriteThread::doWrite() {
     const size_t availToRead = mDataMQ->availableToRead();
     mStatus.retval = Result::OK;
     mStatus.reply.written = 0;
-    if (mDataMQ->read(&mBuffer[0], availToRead)) {
-        ssize_t writeResult = mStream->write(mStream, &mBuffer[0], availToRead);
+    StreamOut::DataMQ::MemTransaction tx;
+    if (mDataMQ->beginRead(availToRead, &tx)) {
+        // Pass the data to the HAL straight from the queue, unless it wraps around.
+        const uint8_t* data = tx.getFirstRegion().getAddress();
+        if (data == nullptr || tx.getFirstRegion().getLength() < availToRead) {
+            tx.copyTo(&mBuffer[0], 0, availToRead);
+            data = &mBuffer[0];
+        }
+        ssize_t writeResult = mStream->write(mStream, data, availToRead);
+        mDataMQ->commitRead(availToRead);
         if (writeResult >= 0) {
             mStatus.reply.written = writeResult;
         } else {
@@ -363,9 +371,14 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
 
     // Create message queues.
     if (mDataMQ) {
-        ALOGE("the client attempts to call prepareForWriting twice");
-        sendError(Result::INVALID_STATE);
-        return Void();
+        if (!isDataMQReplacementAllowed() ||
+            mStopWriteThread.load(std::memory_order_relaxed)) {
+            ALOGE("the client attempts to call prepareForWriting twice");
+            sendError(Result::INVALID_STATE);
+            return Void();
+        }
+        ALOGD("replacing the message queues, data MQ size %zu -> %u",
+              mDataMQ->getQuantumCount(), frameSize * framesCount);
     }
     std::unique_ptr<CommandMQ> tempCommandMQ(new CommandMQ(1));
 
@@ -410,6 +423,17 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
         sendError(Result::INVALID_ARGUMENTS);
         return Void();
     }
+    if (mWriteThread.get()) {
+        // The previous thread uses the previous queues, which are about to be replaced.
+        mStopWriteThread.store(true, std::memory_order_release);
+        mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::NOT_EMPTY));
+        status = mWriteThread->join();
+        ALOGE_IF(status, "write thread exit error: %s", strerror(-status));
+        mStopWriteThread.store(false, std::memory_order_release);
+        mWriteThread.clear();
+        status = EventFlag::deleteEventFlag(&mEfGroup);
+        ALOGE_IF(status, "write MQ event flag deletion error: %s", strerror(-status));
+    }
     status = tempWriteThread->run("writer", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start writer thread: %s", strerror(-status));
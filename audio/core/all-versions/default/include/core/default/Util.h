@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <vector>
 
+#include <cutils/properties.h>
 #include <system/audio.h>
 
 namespace android {
@@ -72,6 +73,15 @@ static inline Result analyzeStatus(const char* className, const char* funcName,
     return analyzeStatus(status);
 }
 
+/**
+ * @return true if a repeated call to prepareForWriting or prepareForReading may replace
+ *         the message queues of a stream, typically to resize the data queue after
+ *         the frame count used by the client has changed.
+ */
+static inline bool isDataMQReplacementAllowed() {
+    return property_get_bool("ro.vendor.audio.hal.replaceable_data_mq", false);
+}
+
 }  // namespace util
 }  // namespace implementation
 }  // namespace CORE_TYPES_CPP_VERSION
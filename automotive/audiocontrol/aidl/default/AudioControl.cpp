@@ -31,8 +31,11 @@
 #include <android_audio_policy_configuration_V7_0-enums.h>
 #include <private/android_filesystem_config.h>
 
+#include <algorithm>
+#include <chrono>
 #include <numeric>
 
+#include <inttypes.h>
 #include <stdio.h>
 
 namespace aidl::android::hardware::automotive::audiocontrol {
@@ -205,40 +208,74 @@ ndk::ScopedAStatus AudioControl::onAudioFocusChange(const string& in_usage, int3
 
 ndk::ScopedAStatus AudioControl::onDevicesToDuckChange(
         const std::vector<DuckingInfo>& in_duckingInfos) {
-    LOG(INFO) << "AudioControl::onDevicesToDuckChange";
+    const auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mDeviceStatesLock);
     for (const DuckingInfo& duckingInfo : in_duckingInfos) {
-        LOG(INFO) << "zone: " << duckingInfo.zoneId;
-        LOG(INFO) << "Devices to duck:";
-        for (const auto& addressToDuck : duckingInfo.deviceAddressesToDuck) {
-            LOG(INFO) << addressToDuck;
-        }
-        LOG(INFO) << "Devices to unduck:";
-        for (const auto& addressToUnduck : duckingInfo.deviceAddressesToUnduck) {
-            LOG(INFO) << addressToUnduck;
-        }
-        LOG(INFO) << "Usages holding focus:";
-        for (const auto& usage : duckingInfo.usagesHoldingFocus) {
-            LOG(INFO) << usage;
-        }
-    }
+        setDeviceStatesLocked(duckingInfo.zoneId, duckingInfo.deviceAddressesToDuck,
+                              &DeviceState::ducked, true);
+        setDeviceStatesLocked(duckingInfo.zoneId, duckingInfo.deviceAddressesToUnduck,
+                              &DeviceState::ducked, false);
+        LOG(VERBOSE) << "zone " << duckingInfo.zoneId << " usages holding focus: "
+                     << ::android::base::Join(duckingInfo.usagesHoldingFocus, ",");
+    }
+    applyDeviceStatesLocked("onDevicesToDuckChange", start);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus AudioControl::onDevicesToMuteChange(
         const std::vector<MutingInfo>& in_mutingInfos) {
-    LOG(INFO) << "AudioControl::onDevicesToMuteChange";
+    const auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mDeviceStatesLock);
     for (const MutingInfo& mutingInfo : in_mutingInfos) {
-        LOG(INFO) << "zone: " << mutingInfo.zoneId;
-        LOG(INFO) << "Devices to mute:";
-        for (const auto& addressToMute : mutingInfo.deviceAddressesToMute) {
-            LOG(INFO) << addressToMute;
+        setDeviceStatesLocked(mutingInfo.zoneId, mutingInfo.deviceAddressesToMute,
+                              &DeviceState::muted, true);
+        setDeviceStatesLocked(mutingInfo.zoneId, mutingInfo.deviceAddressesToUnmute,
+                              &DeviceState::muted, false);
+    }
+    applyDeviceStatesLocked("onDevicesToMuteChange", start);
+    return ndk::ScopedAStatus::ok();
+}
+
+void AudioControl::setDeviceStatesLocked(int32_t zoneId, const std::vector<std::string>& addresses,
+                                         bool DeviceState::*state, bool value) {
+    for (const auto& address : addresses) {
+        auto& device = *mDeviceStates.try_emplace(address).first;
+        device.second.zoneId = zoneId;
+        if (device.second.*state == value) {
+            continue;
         }
-        LOG(INFO) << "Devices to unmute:";
-        for (const auto& addressToUnmute : mutingInfo.deviceAddressesToUnmute) {
-            LOG(INFO) << addressToUnmute;
+        device.second.*state = value;
+        // A device changed twice in a transaction is still applied once
+        if (!device.second.pending) {
+            device.second.pending = true;
+            mChangedDevices.push_back(&device);
         }
     }
-    return ndk::ScopedAStatus::ok();
+}
+
+void AudioControl::applyDeviceStatesLocked(const char* transaction,
+                                           std::chrono::steady_clock::time_point start) {
+    if (!mChangedDevices.empty()) {
+        // There is no hardware behind this default implementation, so applying the changes of
+        // the transaction comes down to logging them all at once.
+        std::string changes;
+        for (auto* device : mChangedDevices) {
+            device->second.pending = false;
+            changes += (changes.empty() ? "" : ", ") + device->first + " (zone " +
+                       std::to_string(device->second.zoneId) +
+                       (device->second.ducked ? ", ducked" : "") +
+                       (device->second.muted ? ", muted" : "") + ")";
+        }
+        LOG(INFO) << transaction << ": " << changes;
+    }
+
+    const auto latency = std::chrono::steady_clock::now() - start;
+    mDeviceStateStats.transactions++;
+    mDeviceStateStats.changes += mChangedDevices.size();
+    mDeviceStateStats.totalLatency += latency;
+    mDeviceStateStats.maxLatency = std::max<std::chrono::nanoseconds>(
+            mDeviceStateStats.maxLatency, latency);
+    mChangedDevices.clear();
 }
 
 template <typename aidl_type>
@@ -342,12 +379,34 @@ binder_status_t AudioControl::dumpsys(int fd) {
         dprintf(fd, "Focus listener registered\n");
     }
     dprintf(fd, "AudioGainCallback %sregistered\n", (mAudioGainCallback == nullptr ? "NOT " : ""));
+
+    std::lock_guard<std::mutex> lock(mDeviceStatesLock);
+    const auto& stats = mDeviceStateStats;
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    const int64_t avgLatencyUs =
+            stats.transactions == 0
+                    ? 0
+                    : duration_cast<microseconds>(stats.totalLatency).count() / stats.transactions;
+    const int64_t maxLatencyUs = duration_cast<microseconds>(stats.maxLatency).count();
+    dprintf(fd,
+            "Ducking/muting: %" PRIu64 " transactions, %" PRIu64
+            " device changes, latency avg %" PRId64 " us, max %" PRId64 " us\n",
+            stats.transactions, stats.changes, avgLatencyUs, maxLatencyUs);
+    for (const auto& [address, state] : mDeviceStates) {
+        if (state.ducked || state.muted) {
+            dprintf(fd, "  %s (zone %d):%s%s\n", address.c_str(), state.zoneId,
+                    state.ducked ? " ducked" : "", state.muted ? " muted" : "");
+        }
+    }
     return STATUS_OK;
 }
 
 binder_status_t AudioControl::cmdHelp(int fd) const {
     dprintf(fd, "Usage: \n\n");
-    dprintf(fd, "[no args]: dumps focus listener / gain callback registered status\n");
+    dprintf(fd,
+            "[no args]: dumps focus listener / gain callback registered status, and ducked / "
+            "muted devices\n");
     dprintf(fd, "--help: shows this help\n");
     dprintf(fd,
             "--request <USAGE> <ZONE_ID> <FOCUS_GAIN>: requests audio focus for specified "
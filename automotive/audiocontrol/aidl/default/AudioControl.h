@@ -35,6 +35,12 @@
 #include <aidl/android/media/audio/common/AudioIoFlags.h>
 #include <aidl/android/media/audio/common/AudioOutputFlags.h>
 
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace aidl::android::hardware::automotive::audiocontrol {
 
 namespace audiohalcommon = ::aidl::android::hardware::audio::common;
@@ -81,6 +87,37 @@ class AudioControl : public BnAudioControl {
 
     std::shared_ptr<IModuleChangeCallback> mModuleChangeCallback = nullptr;
 
+    struct DeviceState {
+        int32_t zoneId = 0;
+        bool ducked = false;
+        bool muted = false;
+        /** Changed by the current transaction. */
+        bool pending = false;
+    };
+    using DeviceStates = std::unordered_map<std::string, DeviceState>;
+
+    struct DeviceStateStats {
+        uint64_t transactions = 0;
+        uint64_t changes = 0;
+        std::chrono::nanoseconds totalLatency{0};
+        std::chrono::nanoseconds maxLatency{0};
+    };
+
+    /**
+     * Ducked and muted state of the devices, indexed by bus address, so a transaction only
+     * applies the devices whose state it changes.
+     */
+    std::mutex mDeviceStatesLock;
+    DeviceStates mDeviceStates;
+    /** Devices changed by the current transaction, kept to reuse its storage. */
+    std::vector<DeviceStates::value_type*> mChangedDevices;
+    DeviceStateStats mDeviceStateStats;
+
+    void setDeviceStatesLocked(int32_t zoneId, const std::vector<std::string>& addresses,
+                               bool DeviceState::*state, bool value);
+    void applyDeviceStatesLocked(const char* transaction,
+                                 std::chrono::steady_clock::time_point start);
+
     binder_status_t cmdHelp(int fd) const;
     binder_status_t cmdRequestFocus(int fd, const char** args, uint32_t numArgs);
     binder_status_t cmdAbandonFocus(int fd, const char** args, uint32_t numArgs);
@@ -25,13 +25,17 @@
 #include <linux/can/error.h>
 #include <linux/can/raw.h>
 
+#include <algorithm>
+#include <shared_mutex>
+
 namespace android::hardware::automotive::can::V1_0::implementation {
 
 /** Whether to log sent/received packets. */
 static constexpr bool kSuperVerbose = false;
 
 Return<Result> CanBus::send(const CanMessage& message) {
-    std::lock_guard<std::mutex> lck(mIsUpGuard);
+    // Senders only share the lock, so that the transport can coalesce their frames
+    std::shared_lock<std::shared_mutex> lck(mIsUpGuard);
     if (!mIsUp) return Result::INTERFACE_DOWN;
 
     if (UNLIKELY(kSuperVerbose)) {
@@ -47,14 +51,29 @@ Return<Result> CanBus::send(const CanMessage& message) {
     frame.len = message.payload.size();
     memcpy(frame.data, message.payload.data(), message.payload.size());
 
-    if (!mSocket->send(frame)) return Result::TRANSMISSION_FAILURE;
+    if (!mTransport->send(frame)) return Result::TRANSMISSION_FAILURE;
 
     return Result::OK;
 }
 
+void CanBus::dump(std::ostream& out) {
+    std::shared_lock<std::shared_mutex> lck(mIsUpGuard);
+    out << mIfname << ": " << (mIsUp ? "up" : "down") << std::endl;
+    if (!mIsUp) return;
+
+    const auto stats = mTransport->getTxStats();
+    out << "  TX frames: " << stats.frames << ", dropped: " << stats.drops
+        << ", send calls: " << stats.sendCalls
+        << ", backpressure retries: " << stats.backpressureRetries << std::endl;
+    if (stats.requests > 0) {
+        out << "  TX latency: mean " << (stats.totalLatency / stats.requests).count() / 1000
+            << "us, max " << stats.maxLatency.count() / 1000 << "us" << std::endl;
+    }
+}
+
 Return<void> CanBus::listen(const hidl_vec<CanMessageFilter>& filter,
                             const sp<ICanMessageListener>& listenerCb, listen_cb _hidl_cb) {
-    std::lock_guard<std::mutex> lck(mIsUpGuard);
+    std::lock_guard<std::shared_mutex> lck(mIsUpGuard);
 
     if (listenerCb == nullptr) {
         _hidl_cb(Result::INVALID_ARGUMENTS, nullptr);
@@ -69,14 +88,21 @@ Return<void> CanBus::listen(const hidl_vec<CanMessageFilter>& filter,
 
     sp<CloseHandle> closeHandle = new CloseHandle([this, listenerCb]() {
         std::lock_guard<std::mutex> lck(mMsgListenersGuard);
-        std::erase_if(mMsgListeners, [&](const auto& e) { return e.callback == listenerCb; });
+        std::erase_if(mMsgListeners, [&](const auto& e) {
+            if (e.queue->getCallback() != listenerCb) return false;
+            e.queue->stop();
+            return true;
+        });
+        rebuildListenerTableLocked();
     });
-    mMsgListeners.emplace_back(CanMessageListener{listenerCb, filter, closeHandle});
+    mMsgListeners.emplace_back(
+            CanMessageListener{std::make_shared<ListenerQueue>(listenerCb), filter, closeHandle});
     auto& listener = mMsgListeners.back();
 
     // fix message IDs to have all zeros on bits not covered by mask
     std::for_each(listener.filter.begin(), listener.filter.end(),
                   [](auto& rule) { rule.id &= rule.mask; });
+    rebuildListenerTableLocked();
 
     _hidl_cb(Result::OK, closeHandle);
     return {};
@@ -87,7 +113,7 @@ CanBus::CanBus() {}
 CanBus::CanBus(const std::string& ifname) : mIfname(ifname) {}
 
 CanBus::~CanBus() {
-    std::lock_guard<std::mutex> lck(mIsUpGuard);
+    std::lock_guard<std::shared_mutex> lck(mIsUpGuard);
     CHECK(!mIsUp) << "Interface is still up while being destroyed";
 
     std::lock_guard<std::mutex> lckListeners(mMsgListenersGuard);
@@ -101,6 +127,12 @@ void CanBus::setErrorCallback(ErrorCallback errcb) {
     CHECK(!mIsUp) << "Can't set error callback while interface is up";
 }
 
+void CanBus::setReactor(std::shared_ptr<CanReactor> reactor, int priority) {
+    CHECK(!mIsUp) << "Can't set reactor while interface is up";
+    mReactor = reactor;
+    mReadPriority = priority;
+}
+
 ICanController::Result CanBus::preUp() {
     return ICanController::Result::OK;
 }
@@ -109,17 +141,10 @@ bool CanBus::postDown() {
     return true;
 }
 
-ICanController::Result CanBus::up() {
-    std::lock_guard<std::mutex> lck(mIsUpGuard);
-
-    if (mIsUp) {
-        LOG(WARNING) << "Interface is already up";
-        return ICanController::Result::INVALID_STATE;
-    }
-
-    const auto preResult = preUp();
-    if (preResult != ICanController::Result::OK) return preResult;
-
+ICanController::Result CanBus::openTransport(CanReactor& reactor, int priority,
+                                             CanTransport::ReadCallback rdcb,
+                                             CanTransport::ErrorCallback errcb,
+                                             std::unique_ptr<CanTransport>& transport) {
     const auto isUp = netdevice::isUp(mIfname);
     if (!isUp.has_value()) {
         // preUp() should prepare the interface (either create or make sure it's there)
@@ -133,14 +158,40 @@ ICanController::Result CanBus::up() {
     }
     mDownAfterUse = !*isUp;
 
-    using namespace std::placeholders;
-    CanSocket::ReadCallback rdcb = std::bind(&CanBus::onRead, this, _1, _2);
-    CanSocket::ErrorCallback errcb = std::bind(&CanBus::onError, this, _1);
-    mSocket = CanSocket::open(mIfname, rdcb, errcb);
-    if (!mSocket) {
+    transport = CanSocket::open(mIfname, reactor, priority, rdcb, errcb);
+    if (!transport) {
         if (mDownAfterUse) netdevice::down(mIfname);
+        mDownAfterUse = false;
         return ICanController::Result::UNKNOWN_ERROR;
     }
+    return ICanController::Result::OK;
+}
+
+ICanController::Result CanBus::up() {
+    std::lock_guard<std::shared_mutex> lck(mIsUpGuard);
+
+    if (mIsUp) {
+        LOG(WARNING) << "Interface is already up";
+        return ICanController::Result::INVALID_STATE;
+    }
+
+    const auto preResult = preUp();
+    if (preResult != ICanController::Result::OK) return preResult;
+
+    using namespace std::placeholders;
+    CanTransport::ReadCallback rdcb = std::bind(&CanBus::onRead, this, _1);
+    CanTransport::ErrorCallback errcb = std::bind(&CanBus::onError, this, _1);
+    CHECK(mReactor != nullptr) << "Reactor wasn't set";
+    mDownAfterUse = false;
+    std::unique_ptr<CanTransport> transport;
+    const auto openResult = openTransport(*mReactor, mReadPriority, rdcb, errcb, transport);
+    if (openResult != ICanController::Result::OK) return openResult;
+    {
+        std::lock_guard<std::mutex> lckListeners(mMsgListenersGuard);
+        mTransport = std::move(transport);
+        mKernelFilters.reset();
+        updateKernelFiltersLocked();
+    }
 
     mIsUp = true;
     return ICanController::Result::OK;
@@ -167,6 +218,75 @@ void CanBus::clearMsgListeners() {
     CHECK(mMsgListeners.empty()) << "Listeners list wasn't emptied";
 }
 
+void CanBus::rebuildListenerTableLocked() {
+    std::vector<ListenerTable::Listener> listeners;
+    listeners.reserve(mMsgListeners.size());
+    for (const auto& listener : mMsgListeners) {
+        listeners.push_back({listener.queue, listener.filter});
+    }
+    mListenerTable = std::make_shared<const ListenerTable>(std::move(listeners));
+    updateKernelFiltersLocked();
+}
+
+/**
+ * Convert a filter rule to a kernel filter passing (at least) the frames the rule matches.
+ *
+ * \param rule Non-exclude filter rule
+ * \return Kernel filter, see CAN_RAW_FILTER
+ */
+static struct can_filter toKernelFilter(const CanMessageFilter& rule) {
+    struct can_filter filter = {rule.id & CAN_EFF_MASK, rule.mask & CAN_EFF_MASK};
+    if (rule.extendedFormat != FilterFlag::DONT_CARE) {
+        filter.can_mask |= CAN_EFF_FLAG;
+        if (rule.extendedFormat == FilterFlag::SET) filter.can_id |= CAN_EFF_FLAG;
+    }
+    if (rule.rtr != FilterFlag::DONT_CARE) {
+        filter.can_mask |= CAN_RTR_FLAG;
+        if (rule.rtr == FilterFlag::SET) filter.can_id |= CAN_RTR_FLAG;
+    }
+    return filter;
+}
+
+void CanBus::updateKernelFiltersLocked() {
+    if (!mTransport) return;
+
+    /* The kernel filters are the union of the non-exclude rules of all listeners. Exclude rules
+     * only narrow a listener filter down, so they are left to the userspace matching. A listener
+     * without non-exclude rules may want any frame, so nothing gets filtered out then. */
+    std::vector<struct can_filter> filters;
+    bool passAll = false;
+    for (const auto& listener : mMsgListeners) {
+        const auto nFilters = filters.size();
+        for (const auto& rule : listener.filter) {
+            if (!rule.exclude) filters.push_back(toKernelFilter(rule));
+        }
+        if (filters.size() == nFilters) {
+            passAll = true;
+            break;
+        }
+    }
+    if (passAll || filters.size() > CAN_RAW_FILTER_MAX) {
+        filters = {{0, 0}};
+    }
+
+    const auto sameFilter = [](const auto& a, const auto& b) {
+        return a.can_id == b.can_id && a.can_mask == b.can_mask;
+    };
+    if (mKernelFilters.has_value() && std::equal(filters.begin(), filters.end(),
+                                                 mKernelFilters->begin(), mKernelFilters->end(),
+                                                 sameFilter)) {
+        return;
+    }
+
+    if (mTransport->setFilters(filters)) {
+        mKernelFilters = std::move(filters);
+    } else {
+        // Better wake up for every frame than miss some
+        mKernelFilters.reset();
+        mTransport->setFilters(std::vector<struct can_filter>{{0, 0}});
+    }
+}
+
 void CanBus::clearErrListeners() {
     std::lock_guard<std::mutex> lck(mErrListenersGuard);
     mErrListeners.clear();
@@ -177,7 +297,7 @@ Return<sp<ICloseHandle>> CanBus::listenForErrors(const sp<ICanErrorListener>& li
         return new CloseHandle();
     }
 
-    std::lock_guard<std::mutex> upLck(mIsUpGuard);
+    std::lock_guard<std::shared_mutex> upLck(mIsUpGuard);
     if (!mIsUp) {
         listener->onError(ErrorEvent::INTERFACE_DOWN, true);
         return new CloseHandle();
@@ -193,7 +313,7 @@ Return<sp<ICloseHandle>> CanBus::listenForErrors(const sp<ICanErrorListener>& li
 }
 
 bool CanBus::down() {
-    std::lock_guard<std::mutex> lck(mIsUpGuard);
+    std::lock_guard<std::shared_mutex> lck(mIsUpGuard);
 
     if (!mIsUp) {
         LOG(WARNING) << "Interface is already down";
@@ -203,7 +323,14 @@ bool CanBus::down() {
 
     clearMsgListeners();
     clearErrListeners();
-    mSocket.reset();
+
+    // The transport must be destroyed without the lock, as that waits for the reader thread
+    std::unique_ptr<CanTransport> transport;
+    {
+        std::lock_guard<std::mutex> lckListeners(mMsgListenersGuard);
+        transport = std::move(mTransport);
+    }
+    transport.reset();
 
     bool success = true;
 
@@ -218,52 +345,6 @@ bool CanBus::down() {
     return success;
 }
 
-/**
- * Helper function to determine if a flag meets the requirements of a
- * FilterFlag. See definition of FilterFlag in types.hal
- *
- * \param filterFlag FilterFlag object to match flag against
- * \param flag bool object from CanMessage object
- */
-static bool satisfiesFilterFlag(FilterFlag filterFlag, bool flag) {
-    if (filterFlag == FilterFlag::DONT_CARE) return true;
-    if (filterFlag == FilterFlag::SET) return flag;
-    if (filterFlag == FilterFlag::NOT_SET) return !flag;
-    return false;
-}
-
-/**
- * Match the filter set against message id.
- *
- * For details on the filters syntax, please see CanMessageFilter at
- * the HAL definition (types.hal).
- *
- * \param filter Filter to match against
- * \param id Message id to filter
- * \return true if the message id matches the filter, false otherwise
- */
-static bool match(const hidl_vec<CanMessageFilter>& filter, CanMessageId id, bool isRtr,
-                  bool isExtendedId) {
-    if (filter.size() == 0) return true;
-
-    bool anyNonExcludeRulePresent = false;
-    bool anyNonExcludeRuleSatisfied = false;
-    for (auto& rule : filter) {
-        const bool satisfied = ((id & rule.mask) == rule.id) &&
-                               satisfiesFilterFlag(rule.rtr, isRtr) &&
-                               satisfiesFilterFlag(rule.extendedFormat, isExtendedId);
-
-        if (rule.exclude) {
-            // Any exclude rule being satisfied invalidates the whole filter set.
-            if (satisfied) return false;
-        } else {
-            anyNonExcludeRulePresent = true;
-            if (satisfied) anyNonExcludeRuleSatisfied = true;
-        }
-    }
-    return !anyNonExcludeRulePresent || anyNonExcludeRuleSatisfied;
-}
-
 void CanBus::notifyErrorListeners(ErrorEvent err, bool isFatal) {
     std::lock_guard<std::mutex> lck(mErrListenersGuard);
     for (auto& listener : mErrListeners) {
@@ -297,34 +378,52 @@ static ErrorEvent parseErrorFrame(const struct canfd_frame& frame) {
     return ErrorEvent::UNKNOWN_ERROR;
 }
 
-void CanBus::onRead(const struct canfd_frame& frame, std::chrono::nanoseconds timestamp) {
-    if ((frame.can_id & CAN_ERR_FLAG) != 0) {
-        // error bit is set
-        LOG(WARNING) << "CAN Error frame received";
-        notifyErrorListeners(parseErrorFrame(frame), false);
-        return;
+void CanBus::onRead(std::span<const CanTransport::Frame> frames) {
+    std::shared_ptr<const ListenerTable> table;
+    {
+        std::lock_guard<std::mutex> lck(mMsgListenersGuard);
+        table = mListenerTable;
     }
+    if (table != nullptr) mReadBatches.resize(table->size());
 
-    CanMessage message = {};
-    message.id = frame.can_id & CAN_EFF_MASK;  // mask out eff/rtr/err flags
-    message.payload = hidl_vec<uint8_t>(frame.data, frame.data + frame.len);
-    message.timestamp = timestamp.count();
-    message.isExtendedId = (frame.can_id & CAN_EFF_FLAG) != 0;
-    message.remoteTransmissionRequest = (frame.can_id & CAN_RTR_FLAG) != 0;
+    for (const auto& [frame, timestamp] : frames) {
+        if ((frame.can_id & CAN_ERR_FLAG) != 0) {
+            // error bit is set
+            LOG(WARNING) << "CAN Error frame received";
+            notifyErrorListeners(parseErrorFrame(frame), false);
+            continue;
+        }
+        if (table == nullptr) continue;
 
-    if (UNLIKELY(kSuperVerbose)) {
-        LOG(VERBOSE) << "Got message " << toString(message);
-    }
+        const CanMessageId id = frame.can_id & CAN_EFF_MASK;  // mask out eff/rtr/err flags
+        const bool isExtendedId = (frame.can_id & CAN_EFF_FLAG) != 0;
+        const bool isRtr = (frame.can_id & CAN_RTR_FLAG) != 0;
 
-    std::lock_guard<std::mutex> lck(mMsgListenersGuard);
-    for (auto& listener : mMsgListeners) {
-        if (!match(listener.filter, message.id, message.remoteTransmissionRequest,
-                   message.isExtendedId))
-            continue;
-        if (!listener.callback->onReceive(message).isOk() && !listener.failedOnce) {
-            listener.failedOnce = true;
-            LOG(WARNING) << "Failed to notify listener about message";
+        // Don't build messages nobody listens to
+        const auto matches = table->match(id, isRtr, isExtendedId, mReadMatches);
+        if (matches.empty()) continue;
+
+        CanMessage message = {};
+        message.id = id;
+        message.payload = hidl_vec<uint8_t>(frame.data, frame.data + frame.len);
+        message.timestamp = timestamp.count();
+        message.isExtendedId = isExtendedId;
+        message.remoteTransmissionRequest = isRtr;
+
+        if (UNLIKELY(kSuperVerbose)) {
+            LOG(VERBOSE) << "Got message " << toString(message);
+        }
+
+        for (size_t i = 0; i + 1 < matches.size(); i++) {
+            mReadBatches[matches[i]].push_back(message);
         }
+        mReadBatches[matches.back()].push_back(std::move(message));
+    }
+    if (table == nullptr) return;
+
+    // Each listener gets the messages of this batch at once, delivered from its own thread
+    for (size_t i = 0; i < table->size(); i++) {
+        if (!mReadBatches[i].empty()) table->getQueue(i).push(mReadBatches[i]);
     }
 }
 
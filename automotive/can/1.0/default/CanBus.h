@@ -17,6 +17,7 @@
 #pragma once
 
 #include "CanSocket.h"
+#include "ListenerTable.h"
 
 #include <android-base/unique_fd.h>
 #include <android/hardware/automotive/can/1.0/ICanBus.h>
@@ -24,7 +25,13 @@
 #include <utils/Mutex.h>
 
 #include <atomic>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <span>
 #include <thread>
+#include <vector>
 
 namespace android::hardware::automotive::can::V1_0::implementation {
 
@@ -39,9 +46,20 @@ struct CanBus : public ICanBus {
     Return<sp<ICloseHandle>> listenForErrors(const sp<ICanErrorListener>& listener) override;
 
     void setErrorCallback(ErrorCallback errcb);
+
+    /**
+     * Set the reactor to read the bus with. Must be called before up().
+     *
+     * \param reactor Reactor shared between buses
+     * \param priority Read priority of the bus, see CanReactor::add
+     */
+    void setReactor(std::shared_ptr<CanReactor> reactor, int priority);
     ICanController::Result up();
     bool down();
 
+    /** Write the state and transmit statistics of the interface, for debugging. */
+    void dump(std::ostream& out);
+
   protected:
     /**
      * Blank constructor, since some interface types (such as SLCAN) don't get a name until after
@@ -71,31 +89,65 @@ struct CanBus : public ICanBus {
      */
     virtual bool postDown();
 
+    /**
+     * Open the transport the bus is used with.
+     *
+     * Called after preUp(). The default implementation brings the mIfname network interface up,
+     * if it isn't already, and opens a SocketCAN socket on it.
+     *
+     * \param reactor Reactor to read the transport with
+     * \param priority Read priority of the bus, see CanReactor::add
+     * \param rdcb Callback on received frames
+     * \param errcb Callback on transport failure
+     * \param transport Opened transport, on success
+     * \return OK on success, or an error state on failure. See ICanController::Result
+     */
+    virtual ICanController::Result openTransport(CanReactor& reactor, int priority,
+                                                 CanTransport::ReadCallback rdcb,
+                                                 CanTransport::ErrorCallback errcb,
+                                                 std::unique_ptr<CanTransport>& transport);
+
     /** Network interface name. */
     std::string mIfname;
 
   private:
     struct CanMessageListener {
-        sp<ICanMessageListener> callback;
+        std::shared_ptr<ListenerQueue> queue;
         hidl_vec<CanMessageFilter> filter;
         wp<ICloseHandle> closeHandle;
-        bool failedOnce = false;
     };
     void clearMsgListeners();
+    void rebuildListenerTableLocked() REQUIRES(mMsgListenersGuard);
+    void updateKernelFiltersLocked() REQUIRES(mMsgListenersGuard);
     void clearErrListeners();
 
     void notifyErrorListeners(ErrorEvent err, bool isFatal);
 
-    void onRead(const struct canfd_frame& frame, std::chrono::nanoseconds timestamp);
+    void onRead(std::span<const CanTransport::Frame> frames);
     void onError(int errnoVal);
 
     std::mutex mMsgListenersGuard;
     std::vector<CanMessageListener> mMsgListeners GUARDED_BY(mMsgListenersGuard);
+    /** Compiled filters of mMsgListeners, null until the first listener is added. */
+    std::shared_ptr<const ListenerTable> mListenerTable GUARDED_BY(mMsgListenersGuard);
+    /** Filters programmed into the transport, unset if they are unknown. */
+    std::optional<std::vector<struct can_filter>> mKernelFilters GUARDED_BY(mMsgListenersGuard);
 
     std::mutex mErrListenersGuard;
     std::vector<sp<ICanErrorListener>> mErrListeners GUARDED_BY(mErrListenersGuard);
 
-    std::unique_ptr<CanSocket> mSocket;
+    /**
+     * Messages of the batch being delivered to each listener, by table index. Only used by the
+     * transport reader thread, as is mReadMatches.
+     */
+    std::vector<std::vector<CanMessage>> mReadBatches;
+    /** Scratch space for the listeners matching a message. */
+    std::vector<uint16_t> mReadMatches;
+
+    /** Set with both mIsUpGuard and mMsgListenersGuard held, so either guards reading it. */
+    std::unique_ptr<CanTransport> mTransport;
+    std::shared_ptr<CanReactor> mReactor;
+    int mReadPriority = 0;
     bool mDownAfterUse;
 
     /**
@@ -103,7 +155,7 @@ struct CanBus : public ICanBus {
      * (i.e. message being sent), because we don't want the interface to be torn down while
      * executing that operation.
      */
-    std::mutex mIsUpGuard;
+    std::shared_mutex mIsUpGuard;
     bool mIsUp GUARDED_BY(mIsUpGuard) = false;
 
     ErrorCallback mErrCb;
@@ -16,6 +16,8 @@
 
 #include "CanBusSlcan.h"
 
+#include "SlcanTransport.h"
+
 #include <android-base/logging.h>
 #include <libnetdevice/can.h>
 #include <libnetdevice/libnetdevice.h>
@@ -39,13 +41,8 @@ static const std::map<uint32_t, std::string> kBitrateCommands = {
         {500000, "C\rS6\r"}, {800000, "C\rS7\r"}, {1000000, "C\rS8\r"}};
 }  // namespace slcanprotocol
 
-/**
- * Serial Line CAN constructor
- * \param string uartName - name of slcan device (e.x. /dev/ttyUSB0)
- * \param uint32_t bitrate - speed of the CAN bus (125k = MSCAN, 500k = HSCAN)
- */
-CanBusSlcan::CanBusSlcan(const std::string& uartName, uint32_t bitrate)
-    : CanBus(), mUartName(uartName), kBitrate(bitrate) {}
+CanBusSlcan::CanBusSlcan(const std::string& uartName, uint32_t bitrate, bool userspace)
+    : CanBus(), mUartName(uartName), kBitrate(bitrate), kUserspace(userspace) {}
 
 /** helper function to update CanBusSlcan object's iface name */
 ICanController::Result CanBusSlcan::updateIfaceName(base::unique_fd& uartFd) {
@@ -85,7 +82,7 @@ ICanController::Result CanBusSlcan::preUp() {
     }
 
     // If the device is already up, update the iface name in our CanBusSlcan object
-    if (kBitrate == 0) {
+    if (kBitrate == 0 && !kUserspace) {
         return updateIfaceName(mFd);
     }
 
@@ -125,6 +122,12 @@ ICanController::Result CanBusSlcan::preUp() {
         return ICanController::Result::UNKNOWN_ERROR;
     }
 
+    // drop whatever the adaptor sent before it was configured
+    if (kUserspace) tcflush(mFd.get(), TCIFLUSH);
+
+    // in userspace mode, an unset bitrate keeps the one the adaptor is configured with
+    if (!canBitrateCommand.has_value()) canBitrateCommand = slcanprotocol::kCloseCommand;
+
     // apply speed setting for CAN
     if (write(mFd.get(), canBitrateCommand->c_str(), canBitrateCommand->length()) <= 0) {
         PLOG(ERROR) << "Failed to apply CAN bitrate";
@@ -138,6 +141,12 @@ ICanController::Result CanBusSlcan::preUp() {
         return ICanController::Result::UNKNOWN_ERROR;
     }
 
+    // in userspace mode, the serial line is read directly instead of through a network interface
+    if (kUserspace) {
+        mIfname = mUartName;
+        return ICanController::Result::OK;
+    }
+
     // set line discipline to slcan
     if (ioctl(mFd.get(), TIOCSETD, &slcanprotocol::kSlcanDiscipline) < 0) {
         PLOG(ERROR) << "Failed to set line discipline to slcan";
@@ -148,9 +157,20 @@ ICanController::Result CanBusSlcan::preUp() {
     return updateIfaceName(mFd);
 }
 
+ICanController::Result CanBusSlcan::openTransport(CanReactor& reactor, int priority,
+                                                  CanTransport::ReadCallback rdcb,
+                                                  CanTransport::ErrorCallback errcb,
+                                                  std::unique_ptr<CanTransport>& transport) {
+    if (!kUserspace) return CanBus::openTransport(reactor, priority, rdcb, errcb, transport);
+
+    transport = SlcanTransport::open(mFd.get(), mUartName, reactor, priority, rdcb, errcb);
+    if (!transport) return ICanController::Result::UNKNOWN_ERROR;
+    return ICanController::Result::OK;
+}
+
 bool CanBusSlcan::postDown() {
     // reset the line discipline to TTY mode
-    if (ioctl(mFd.get(), TIOCSETD, &slcanprotocol::kDefaultDiscipline) < 0) {
+    if (!kUserspace && ioctl(mFd.get(), TIOCSETD, &slcanprotocol::kDefaultDiscipline) < 0) {
         LOG(ERROR) << "Failed to reset line discipline!";
         return false;
     }
@@ -25,17 +25,30 @@
 namespace android::hardware::automotive::can::V1_0::implementation {
 
 struct CanBusSlcan : public CanBus {
-    CanBusSlcan(const std::string& uartName, uint32_t bitrate);
+    /**
+     * Serial Line CAN constructor.
+     *
+     * \param uartName Name of the slcan device (e.x. /dev/ttyUSB0)
+     * \param bitrate Speed of the CAN bus (125k = MSCAN, 500k = HSCAN)
+     * \param userspace Whether to speak SLCAN from userspace instead of using the kernel slcan
+     *        line discipline, see SlcanTransport
+     */
+    CanBusSlcan(const std::string& uartName, uint32_t bitrate, bool userspace = false);
 
   protected:
     virtual ICanController::Result preUp() override;
     virtual bool postDown() override;
+    virtual ICanController::Result openTransport(CanReactor& reactor, int priority,
+                                                 CanTransport::ReadCallback rdcb,
+                                                 CanTransport::ErrorCallback errcb,
+                                                 std::unique_ptr<CanTransport>& transport) override;
 
   private:
     ICanController::Result updateIfaceName(base::unique_fd& uartFd);
 
     const std::string mUartName;
     const uint32_t kBitrate;
+    const bool kUserspace;
     base::unique_fd mFd;
 };
 
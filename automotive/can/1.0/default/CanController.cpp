@@ -20,12 +20,15 @@
 #include "CanBusSlcan.h"
 #include "CanBusVirtual.h"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <android/hidl/manager/1.2/IServiceManager.h>
 
 #include <automotive/filesystem>
 #include <fstream>
 #include <regex>
+#include <sstream>
 
 namespace android::hardware::automotive::can::V1_0::implementation {
 
@@ -48,6 +51,12 @@ static const std::regex kTtyRe("^tty[A-Z]+[0-9]+$");
 static constexpr auto kOpts = ~(fs::directory_options::follow_directory_symlink |
                                 fs::directory_options::skip_permission_denied);
 
+/**
+ * Set to true to speak SLCAN from userspace rather than with the kernel line discipline. Needed
+ * for the fastest USB-serial adaptors, which the kernel driver can't keep up with.
+ */
+static const std::string kSlcanUserspaceProperty = "ro.vendor.can.slcan_userspace";
+
 /**
  * A helper object to associate the interface name and type of a USB to CAN adapter.
  */
@@ -213,6 +222,11 @@ static std::optional<UsbCanIface> findUsbDevice(const hidl_vec<hidl_string>& con
     return std::nullopt;
 }
 
+/** Number of threads reading all buses. */
+static constexpr size_t kReaderThreads = 2;
+
+CanController::CanController() : mReactor(std::make_shared<CanReactor>(kReaderThreads)) {}
+
 Return<ICanController::Result> CanController::upInterface(const ICanController::BusConfig& config) {
     LOG(VERBOSE) << "Attempting to bring interface up: " << toString(config);
 
@@ -269,13 +283,18 @@ Return<ICanController::Result> CanController::upInterface(const ICanController::
             // Configure by tty name.
             ttyName = slcan.ttyname();
         }
-        busService = new CanBusSlcan(ttyName, config.bitrate);
+        busService = new CanBusSlcan(ttyName, config.bitrate,
+                                     base::GetBoolProperty(kSlcanUserspaceProperty, false));
     } else {
         return ICanController::Result::NOT_SUPPORTED;
     }
 
     busService->setErrorCallback([this, name = config.name]() { downInterface(name); });
 
+    /* Buses with higher bitrate fill their socket buffers sooner, so they are read first when
+     * multiple buses are ready at once. Bitrate fits int, as CAN tops out at a few Mbit/s. */
+    busService->setReactor(mReactor, static_cast<int>(config.bitrate));
+
     const auto result = busService->up();
     if (result != ICanController::Result::OK) return result;
 
@@ -313,4 +332,22 @@ Return<bool> CanController::downInterface(const hidl_string& name) {
     return success;
 }
 
+Return<void> CanController::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&) {
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
+        LOG(ERROR) << "Missing fd for writing debug output";
+        return {};
+    }
+
+    std::ostringstream out;
+    {
+        std::lock_guard<std::mutex> lck(mCanBusesGuard);
+        out << "Interfaces: " << mCanBuses.size() << std::endl;
+        for (const auto& [name, bus] : mCanBuses) bus->dump(out);
+    }
+    if (!base::WriteStringToFd(out.str(), fd->data[0])) {
+        PLOG(ERROR) << "Failed to write debug output";
+    }
+    return {};
+}
+
 }  // namespace android::hardware::automotive::can::V1_0::implementation
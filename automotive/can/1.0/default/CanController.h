@@ -23,12 +23,19 @@
 namespace android::hardware::automotive::can::V1_0::implementation {
 
 struct CanController : public ICanController {
+    CanController();
+
     Return<void> getSupportedInterfaceTypes(getSupportedInterfaceTypes_cb _hidl_cb) override;
 
     Return<ICanController::Result> upInterface(const ICanController::BusConfig& config) override;
     Return<bool> downInterface(const hidl_string& name) override;
 
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
+
   private:
+    /** Reads the sockets of all buses. */
+    const std::shared_ptr<CanReactor> mReactor;
+
     std::mutex mCanBusesGuard;
     std::map<std::string, sp<CanBus>> mCanBuses GUARDED_BY(mCanBusesGuard);
 };
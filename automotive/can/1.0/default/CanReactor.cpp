@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CanReactor.h"
+
+#include <android-base/logging.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <array>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/** Maximum number of ready sockets a thread picks up at once. */
+static constexpr size_t kMaxEvents = 16;
+
+/** epoll id of the stop eventfd; sockets are numbered from 1. */
+static constexpr uint64_t kStopEventId = 0;
+
+struct CanReactor::Source {
+    Source(uint64_t id, int fd, int priority, Handler handler)
+        : id(id), fd(fd), priority(priority), handler(std::move(handler)) {}
+
+    const uint64_t id;
+    const int fd;
+    const int priority;
+    const Handler handler;
+
+    std::mutex guard;
+    std::condition_variable handlerDone;
+    bool removed GUARDED_BY(guard) = false;
+    bool running GUARDED_BY(guard) = false;
+    std::thread::id runningThread GUARDED_BY(guard);
+};
+
+static bool watch(int epoll, int op, int fd, uint64_t id, uint32_t events) {
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = id;
+    return epoll_ctl(epoll, op, fd, &ev) == 0;
+}
+
+CanReactor::Registration::Registration(CanReactor& reactor, std::shared_ptr<Source> source)
+    : mReactor(reactor), mSource(source) {}
+
+CanReactor::Registration::~Registration() {
+    mReactor.remove(mSource);
+}
+
+CanReactor::CanReactor(size_t nThreads)
+    : mEpoll(epoll_create1(EPOLL_CLOEXEC)), mStopEvent(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    CHECK(mEpoll.ok()) << "Can't create epoll instance";
+    CHECK(mStopEvent.ok()) << "Can't create eventfd";
+
+    // Level triggered, so that it wakes all threads up
+    CHECK(watch(mEpoll.get(), EPOLL_CTL_ADD, mStopEvent.get(), kStopEventId, EPOLLIN))
+            << "Can't watch eventfd";
+
+    for (size_t i = 0; i < nThreads; i++) {
+        mThreads.emplace_back(&CanReactor::run, this);
+        pthread_setname_np(mThreads.back().native_handle(), "CanReactor");
+    }
+}
+
+CanReactor::~CanReactor() {
+    const uint64_t one = 1;
+    if (write(mStopEvent.get(), &one, sizeof(one)) != sizeof(one)) {
+        PLOG(ERROR) << "Can't stop reactor threads";
+    }
+    for (auto& thread : mThreads) thread.join();
+}
+
+std::unique_ptr<CanReactor::Registration> CanReactor::add(int fd, int priority, Handler handler) {
+    std::shared_ptr<Source> source;
+    {
+        std::lock_guard<std::mutex> lck(mSourcesGuard);
+        source = std::make_shared<Source>(mNextSourceId++, fd, priority, std::move(handler));
+        mSources[source->id] = source;
+    }
+
+    if (!watch(mEpoll.get(), EPOLL_CTL_ADD, fd, source->id, EPOLLIN | EPOLLONESHOT)) {
+        PLOG(ERROR) << "Can't watch socket";
+        std::lock_guard<std::mutex> lck(mSourcesGuard);
+        mSources.erase(source->id);
+        return nullptr;
+    }
+
+    // Can't use std::make_unique due to private Registration constructor.
+    return std::unique_ptr<Registration>(new Registration(*this, source));
+}
+
+void CanReactor::remove(const std::shared_ptr<Source>& source) {
+    {
+        std::lock_guard<std::mutex> lck(mSourcesGuard);
+        mSources.erase(source->id);
+    }
+
+    std::unique_lock<std::mutex> lck(source->guard);
+    source->removed = true;
+    if (epoll_ctl(mEpoll.get(), EPOLL_CTL_DEL, source->fd, nullptr) != 0) {
+        PLOG(WARNING) << "Can't stop watching socket";
+    }
+
+    // A handler removing its own source can't wait for itself
+    if (source->running && source->runningThread != std::this_thread::get_id()) {
+        source->handlerDone.wait(lck, [&source] { return !source->running; });
+    }
+}
+
+void CanReactor::run() {
+    std::array<struct epoll_event, kMaxEvents> events;
+    std::vector<std::shared_ptr<Source>> ready;
+
+    while (true) {
+        const auto nevents = epoll_wait(mEpoll.get(), events.data(), events.size(), -1);
+        if (nevents < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "epoll_wait failed";
+            return;
+        }
+
+        ready.clear();
+        {
+            std::lock_guard<std::mutex> lck(mSourcesGuard);
+            for (int i = 0; i < nevents; i++) {
+                if (events[i].data.u64 == kStopEventId) return;
+                // The source may have been removed after epoll reported it
+                const auto it = mSources.find(events[i].data.u64);
+                if (it != mSources.end()) ready.push_back(it->second);
+            }
+        }
+
+        std::stable_sort(ready.begin(), ready.end(), [](const auto& a, const auto& b) {
+            return a->priority > b->priority;
+        });
+        for (const auto& source : ready) handle(source);
+    }
+}
+
+void CanReactor::handle(const std::shared_ptr<Source>& source) {
+    {
+        std::lock_guard<std::mutex> lck(source->guard);
+        if (source->removed) return;
+        source->running = true;
+        source->runningThread = std::this_thread::get_id();
+    }
+
+    const auto keepWatching = source->handler();
+
+    std::lock_guard<std::mutex> lck(source->guard);
+    source->running = false;
+    if (keepWatching && !source->removed) {
+        // EPOLLONESHOT disabled the socket, so no other thread could pick it up meanwhile
+        if (!watch(mEpoll.get(), EPOLL_CTL_MOD, source->fd, source->id, EPOLLIN | EPOLLONESHOT)) {
+            PLOG(ERROR) << "Can't watch socket again";
+        }
+    }
+    source->handlerDone.notify_all();
+}
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+#include <utils/Mutex.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/**
+ * Services the reads of multiple sockets from a small, shared pool of threads.
+ *
+ * Sockets are watched with EPOLLONESHOT, so each one is handled by a single thread at a time and
+ * its data is delivered in order. When multiple sockets are ready at once, the ones with higher
+ * priority are handled first.
+ */
+struct CanReactor {
+    /**
+     * Called when the socket is readable.
+     *
+     * \return true to keep watching the socket, false to stop
+     */
+    using Handler = std::function<bool()>;
+
+    struct Source;
+
+    /** Watch over a socket. The socket stops being watched when this object is destroyed. */
+    struct Registration {
+        ~Registration();
+
+      private:
+        friend struct CanReactor;
+        Registration(CanReactor& reactor, std::shared_ptr<Source> source);
+
+        CanReactor& mReactor;
+        const std::shared_ptr<Source> mSource;
+
+        DISALLOW_COPY_AND_ASSIGN(Registration);
+    };
+
+    /**
+     * Create reactor.
+     *
+     * \param nThreads Number of threads handling the sockets
+     */
+    CanReactor(size_t nThreads);
+    ~CanReactor();
+
+    /**
+     * Start watching a socket.
+     *
+     * Destroying the returned registration waits for the handler to return, unless it's destroyed
+     * by the handler itself (in which case the handler must not touch its state afterwards).
+     *
+     * \param fd Socket to watch
+     * \param priority Priority of the socket, higher values are handled first
+     * \param handler Called whenever the socket is readable
+     * \return Registration, or nullptr on failure
+     */
+    std::unique_ptr<Registration> add(int fd, int priority, Handler handler);
+
+  private:
+    void run();
+    void handle(const std::shared_ptr<Source>& source);
+    void remove(const std::shared_ptr<Source>& source);
+
+    base::unique_fd mEpoll;
+    /** eventfd signalled to stop the threads. */
+    base::unique_fd mStopEvent;
+
+    std::mutex mSourcesGuard;
+    /** Watched sockets, by the id epoll reports them with. */
+    std::map<uint64_t, std::shared_ptr<Source>> mSources GUARDED_BY(mSourcesGuard);
+    uint64_t mNextSourceId GUARDED_BY(mSourcesGuard) = 1;
+
+    std::vector<std::thread> mThreads;
+
+    DISALLOW_COPY_AND_ASSIGN(CanReactor);
+};
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -20,131 +20,338 @@
 #include <libnetdevice/can.h>
 #include <libnetdevice/libnetdevice.h>
 #include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 
 namespace android::hardware::automotive::can::V1_0::implementation {
 
 using namespace std::chrono_literals;
 
-/* How frequently the read thread checks whether the interface was asked to be down.
+/** Maximum number of frames received with a single recvmmsg(2) call. */
+static constexpr size_t kReadBatchSize = 32;
+
+/**
+ * Maximum number of batches read before the reactor thread moves on to other sockets.
+ *
+ * If there is more to read, the socket is handled again as soon as a thread is available.
+ */
+static constexpr size_t kMaxReadBatchesPerWakeup = 4;
+
+/** Maximum number of frames sent with a single sendmmsg(2) call. */
+static constexpr size_t kSendBatchSize = 32;
+
+/* When the interface transmit queue is full, sending is retried with an exponential backoff, up
+ * to a total of kSendBackpressureTimeout before the frames are dropped. */
+static constexpr auto kSendBackoffMin = 100us;
+static constexpr auto kSendBackoffMax = 10ms;
+static constexpr auto kSendBackpressureTimeout = 100ms;
+
+/** How often the offset between the realtime and boottime clocks is measured again. */
+static constexpr auto kClockResyncPeriod = 1s;
+
+static std::chrono::nanoseconds toNanoseconds(const struct timespec& ts) {
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static std::chrono::nanoseconds clockNow(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return toNanoseconds(ts);
+}
+
+/**
+ * Converts socket timestamps, which use CLOCK_REALTIME, to a time since boot.
  *
- * Note: This does *not* affect read timing or bandwidth, just CPU load vs time to
- *       down the interface. */
-static constexpr auto kReadPooling = 100ms;
+ * There is no direct way to convert between these clocks, so the offset between them is measured
+ * by reading the realtime clock between two reads of the boottime clock, keeping the sample with
+ * the narrowest bracket. The offset is measured again periodically, to pick up adjustments of the
+ * realtime clock.
+ */
+class BoottimeConverter {
+  public:
+    std::chrono::nanoseconds fromRealtime(const struct timespec& realtime) {
+        const auto now = clockNow(CLOCK_BOOTTIME);
+        if (now - mLastSync >= kClockResyncPeriod) sync();
+        return toNanoseconds(realtime) - mOffset;
+    }
+
+  private:
+    void sync() {
+        auto bestBracket = std::chrono::nanoseconds::max();
+        for (int i = 0; i < 3; i++) {
+            const auto before = clockNow(CLOCK_BOOTTIME);
+            const auto realtime = clockNow(CLOCK_REALTIME);
+            const auto after = clockNow(CLOCK_BOOTTIME);
+            if (after - before < bestBracket) {
+                bestBracket = after - before;
+                mOffset = realtime - (before + bestBracket / 2);
+                mLastSync = after;
+            }
+        }
+    }
+
+    std::chrono::nanoseconds mOffset = 0ns;
+    std::chrono::nanoseconds mLastSync = std::chrono::nanoseconds::min();
+};
 
-std::unique_ptr<CanSocket> CanSocket::open(const std::string& ifname, ReadCallback rdcb,
-                                           ErrorCallback errcb) {
+/**
+ * Receive buffers for a batch of frames, along with the control messages carrying their
+ * timestamps.
+ */
+struct CanSocket::ReadState {
+    ReadState() {
+        for (size_t i = 0; i < kReadBatchSize; i++) {
+            iovecs[i] = {&frames[i].frame, CAN_MTU};
+        }
+    }
+
+    /** Resets the message headers, which the kernel updates on every recvmmsg(2) call. */
+    void reset() {
+        for (size_t i = 0; i < kReadBatchSize; i++) {
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls[i].data();
+            msgs[i].msg_hdr.msg_controllen = controls[i].size();
+        }
+    }
+
+    std::array<CanSocket::Frame, kReadBatchSize> frames;
+    std::array<struct iovec, kReadBatchSize> iovecs;
+    std::array<struct mmsghdr, kReadBatchSize> msgs;
+    std::array<std::array<uint8_t, CMSG_SPACE(sizeof(struct scm_timestamping))>, kReadBatchSize>
+            controls;
+
+    BoottimeConverter boottime;
+};
+
+/** Returns the software receive timestamp of a message, if the kernel attached one. */
+static const struct timespec* getRxTimestamp(struct msghdr& msg) {
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) continue;
+        const auto tss = reinterpret_cast<const struct scm_timestamping*>(CMSG_DATA(cmsg));
+        if (tss->ts[0].tv_sec == 0 && tss->ts[0].tv_nsec == 0) return nullptr;
+        return &tss->ts[0];
+    }
+    return nullptr;
+}
+
+std::unique_ptr<CanSocket> CanSocket::open(const std::string& ifname, CanReactor& reactor,
+                                           int priority, ReadCallback rdcb, ErrorCallback errcb) {
     auto sock = netdevice::can::socket(ifname);
     if (!sock.ok()) {
         LOG(ERROR) << "Can't open CAN socket on " << ifname;
         return nullptr;
     }
 
+    /* Ask for kernel receive timestamps. Frames are timestamped when they are received by the
+     * network stack, so that the reported time isn't skewed by the scheduling of the reader. */
+    const int tsFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(sock.get(), SOL_SOCKET, SO_TIMESTAMPING, &tsFlags, sizeof(tsFlags)) < 0) {
+        PLOG(WARNING) << "Can't enable receive timestamps on " << ifname;
+    }
+
     // Can't use std::make_unique due to private CanSocket constructor.
-    return std::unique_ptr<CanSocket>(new CanSocket(std::move(sock), rdcb, errcb));
+    std::unique_ptr<CanSocket> canSocket(new CanSocket(std::move(sock), rdcb, errcb));
+
+    auto socketPtr = canSocket.get();
+    canSocket->mRegistration = reactor.add(canSocket->mSocket.get(), priority,
+                                           [socketPtr] { return socketPtr->onReadable(); });
+    if (!canSocket->mRegistration) {
+        LOG(ERROR) << "Can't start reading from " << ifname;
+        return nullptr;
+    }
+    return canSocket;
 }
 
 CanSocket::CanSocket(base::unique_fd socket, ReadCallback rdcb, ErrorCallback errcb)
     : mReadCallback(rdcb),
       mErrorCallback(errcb),
       mSocket(std::move(socket)),
-      mReaderThread(&CanSocket::readerThread, this) {}
+      mReadState(std::make_unique<ReadState>()) {}
 
 CanSocket::~CanSocket() {
-    mStopReaderThread = true;
-
-    /* CanSocket can be brought down as a result of read failure, from the same thread,
-     * so let's just detach and let it finish on its own. */
-    if (mReaderThreadFinished) {
-        mReaderThread.detach();
-    } else {
-        mReaderThread.join();
+    // Waits for the reactor to finish reading, unless the socket is destroyed from onReadable()
+    mRegistration.reset();
+}
+
+bool CanSocket::send(std::span<const struct canfd_frame> frames) {
+    TxRequest request = {frames, clockNow(CLOCK_BOOTTIME)};
+
+    std::unique_lock<std::mutex> lck(mTxGuard);
+    mTxQueue.push_back(&request);
+    if (mTxBusy) {
+        mTxDone.wait(lck, [&request] { return request.done; });
+        return request.ok;
     }
+
+    mTxBusy = true;
+    while (!mTxQueue.empty()) {
+        std::swap(mTxFlushing, mTxQueue);
+        lck.unlock();
+        const auto stats = flushTxRequests(mTxFlushing);
+        lck.lock();
+
+        mTxStats.frames += stats.frames;
+        mTxStats.drops += stats.drops;
+        mTxStats.sendCalls += stats.sendCalls;
+        mTxStats.backpressureRetries += stats.backpressureRetries;
+        const auto now = clockNow(CLOCK_BOOTTIME);
+        for (auto req : mTxFlushing) {
+            const auto latency = now - req->enqueueTime;
+            mTxStats.requests++;
+            mTxStats.totalLatency += latency;
+            mTxStats.maxLatency = std::max(mTxStats.maxLatency, latency);
+            // Requests of the other senders are gone as soon as they see this, when unlocked
+            req->done = true;
+        }
+        mTxFlushing.clear();
+        mTxDone.notify_all();
+    }
+    mTxBusy = false;
+
+    return request.ok;
 }
 
-bool CanSocket::send(const struct canfd_frame& frame) {
-    const auto res = write(mSocket.get(), &frame, CAN_MTU);
-    if (res < 0) {
+CanSocket::TxStats CanSocket::flushTxRequests(const std::vector<TxRequest*>& requests) {
+    TxStats stats;
+
+    // Position of the next frame to send
+    size_t reqIdx = 0;
+    size_t frameIdx = 0;
+    const auto skipSentRequests = [&]() {
+        while (reqIdx < requests.size() && frameIdx == requests[reqIdx]->frames.size()) {
+            reqIdx++;
+            frameIdx = 0;
+        }
+    };
+
+    auto backoff = std::chrono::nanoseconds(kSendBackoffMin);
+    std::chrono::nanoseconds backpressureStart = {};
+    skipSentRequests();
+    while (reqIdx < requests.size()) {
+        // Coalesce frames of the following requests, up to the batch size
+        mTxMsgs.clear();
+        mTxIovecs.clear();
+        auto f = frameIdx;
+        for (auto r = reqIdx; r < requests.size() && mTxIovecs.size() < kSendBatchSize; r++) {
+            const auto frames = requests[r]->frames;
+            for (; f < frames.size() && mTxIovecs.size() < kSendBatchSize; f++) {
+                mTxIovecs.push_back({const_cast<struct canfd_frame*>(&frames[f]), CAN_MTU});
+            }
+            f = 0;
+        }
+        mTxMsgs.resize(mTxIovecs.size());
+        for (size_t i = 0; i < mTxIovecs.size(); i++) {
+            mTxMsgs[i] = {};
+            mTxMsgs[i].msg_hdr.msg_iov = &mTxIovecs[i];
+            mTxMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const auto res = sendmmsg(mSocket.get(), mTxMsgs.data(), mTxMsgs.size(), MSG_DONTWAIT);
+        if (res > 0) {
+            stats.sendCalls++;
+            stats.frames += res;
+            for (auto sent = size_t(res); sent > 0;) {
+                const auto n = std::min(sent, requests[reqIdx]->frames.size() - frameIdx);
+                frameIdx += n;
+                sent -= n;
+                skipSentRequests();
+            }
+            backoff = kSendBackoffMin;
+            backpressureStart = {};
+            continue;
+        }
+        if (res < 0 && errno == EINTR) continue;
+
+        if (res < 0 && (errno == ENOBUFS || errno == EAGAIN)) {
+            const auto now = clockNow(CLOCK_BOOTTIME);
+            if (backpressureStart == std::chrono::nanoseconds::zero()) backpressureStart = now;
+            if (now - backpressureStart < kSendBackpressureTimeout) {
+                stats.backpressureRetries++;
+                std::this_thread::sleep_for(backoff);
+                backoff = std::min<std::chrono::nanoseconds>(backoff * 2, kSendBackoffMax);
+                continue;
+            }
+        }
+
+        // Give up on the current request, but not on the following ones
         PLOG(DEBUG) << "CanSocket send failed";
-        return false;
+        requests[reqIdx]->ok = false;
+        stats.drops += requests[reqIdx]->frames.size() - frameIdx;
+        frameIdx = requests[reqIdx]->frames.size();
+        skipSentRequests();
+        backoff = kSendBackoffMin;
+        backpressureStart = {};
     }
-    if (res != CAN_MTU) {
-        LOG(DEBUG) << "CanSocket sent wrong number of bytes: " << res;
+
+    return stats;
+}
+
+CanSocket::TxStats CanSocket::getTxStats() const {
+    std::lock_guard<std::mutex> lck(mTxGuard);
+    return mTxStats;
+}
+
+bool CanSocket::setFilters(std::span<const struct can_filter> filters) {
+    if (setsockopt(mSocket.get(), SOL_CAN_RAW, CAN_RAW_FILTER,
+                   filters.empty() ? nullptr : filters.data(), filters.size_bytes()) < 0) {
+        PLOG(ERROR) << "Can't set CAN filters";
         return false;
     }
     return true;
 }
 
-static struct timeval toTimeval(std::chrono::microseconds t) {
-    struct timeval tv;
-    tv.tv_sec = t / 1s;
-    tv.tv_usec = (t % 1s) / 1us;
-    return tv;
-}
+bool CanSocket::onReadable() {
+    auto& batch = *mReadState;
 
-static int selectRead(const base::unique_fd& fd, std::chrono::microseconds timeout) {
-    auto timeouttv = toTimeval(timeout);
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(fd.get(), &readfds);
-    return select(fd.get() + 1, &readfds, nullptr, nullptr, &timeouttv);
-}
+    // Reads a few batches at most, then lets the other sockets in before reading more
+    for (size_t i = 0; i < kMaxReadBatchesPerWakeup; i++) {
+        batch.reset();
+        const auto nmsgs =
+                recvmmsg(mSocket.get(), batch.msgs.data(), kReadBatchSize, MSG_DONTWAIT, nullptr);
+        if (nmsgs < 0) {
+            if (errno == EAGAIN || errno == EINTR) return true;
 
-void CanSocket::readerThread() {
-    LOG(VERBOSE) << "Reader thread started";
-    int errnoCopy = 0;
-
-    while (!mStopReaderThread) {
-        /* The ideal would be to have a blocking read(3) call and interrupt it with shutdown(3).
-         * This is unfortunately not supported for SocketCAN, so we need to rely on select(3). */
-        const auto sel = selectRead(mSocket, kReadPooling);
-        if (sel == 0) continue;  // timeout
-        if (sel == -1) {
-            PLOG(ERROR) << "Select failed";
-            break;
+            PLOG(ERROR) << "Failed to read CAN packets";
+            return onReadFailed(errno);
         }
 
-        struct canfd_frame frame;
-        const auto nbytes = read(mSocket.get(), &frame, CAN_MTU);
-
-        /* We could use SIOCGSTAMP to get a precise UNIX timestamp for a given packet, but what
-         * we really need is a time since boot. There is no direct way to convert between these
-         * clocks. We could implement a class to calculate the difference between the clocks
-         * (querying both several times and picking the smallest difference); apply the difference
-         * to a SIOCGSTAMP returned value; re-synchronize if the elapsed time is too much in the
-         * past (indicating the UNIX timestamp might have been adjusted).
-         *
-         * Apart from the added complexity, it's possible the added calculations and system calls
-         * would add so much time to the processing pipeline so the precision of the reported time
-         * was buried under the subsystem latency. Let's just use a local time since boot here and
-         * leave precise hardware timestamps for custom proprietary implementations (if needed). */
-        const std::chrono::nanoseconds ts(elapsedRealtimeNano());
-
-        if (nbytes != CAN_MTU) {
-            if (nbytes >= 0) {
-                LOG(ERROR) << "Failed to read CAN packet, got " << nbytes << " bytes";
-                break;
-            }
-            if (errno == EAGAIN) continue;
-
-            errnoCopy = errno;
-            PLOG(ERROR) << "Failed to read CAN packet";
-            break;
+        // Only used for the frames the kernel didn't timestamp
+        const std::chrono::nanoseconds readTs(elapsedRealtimeNano());
+        int nframes = 0;
+        for (; nframes < nmsgs; nframes++) {
+            auto& msg = batch.msgs[nframes];
+            if (msg.msg_len != CAN_MTU) break;
+            const auto rxTs = getRxTimestamp(msg.msg_hdr);
+            batch.frames[nframes].timestamp =
+                    rxTs != nullptr ? batch.boottime.fromRealtime(*rxTs) : readTs;
         }
 
-        mReadCallback(frame, ts);
+        if (nframes > 0) mReadCallback(std::span<const Frame>(batch.frames.data(), nframes));
+        if (nframes != nmsgs) {
+            LOG(ERROR) << "Failed to read CAN packet, got " << batch.msgs[nframes].msg_len
+                       << " bytes";
+            return onReadFailed(0);
+        }
+        if (size_t(nmsgs) < kReadBatchSize) break;
     }
+    return true;
+}
 
-    bool failed = !mStopReaderThread;
+bool CanSocket::onReadFailed(int errnoVal) {
+    // The error callback may destroy this socket, so don't access any fields after calling it
     auto errCb = mErrorCallback;
-    mReaderThreadFinished = true;
-
-    // Don't access any fields from here, see CanSocket::~CanSocket comment about detached thread
-    if (failed) errCb(errnoCopy);
-
-    LOG(VERBOSE) << "Reader thread stopped";
+    errCb(errnoVal);
+    return false;
 }
 
 }  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -16,53 +16,108 @@
 
 #pragma once
 
+#include "CanReactor.h"
+#include "CanTransport.h"
+
 #include <android-base/macros.h>
 #include <android-base/unique_fd.h>
 #include <linux/can.h>
 
-#include <atomic>
+#include <sys/socket.h>
+
 #include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <thread>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace android::hardware::automotive::can::V1_0::implementation {
 
 /** Wrapper around SocketCAN socket. */
-struct CanSocket {
-    using ReadCallback = std::function<void(const struct canfd_frame&, std::chrono::nanoseconds)>;
-    using ErrorCallback = std::function<void(int errnoVal)>;
-
+struct CanSocket : public CanTransport {
     /**
      * Open and bind SocketCAN socket.
      *
+     * Received frames are read by the threads of the reactor, and the callbacks are called from
+     * there.
+     *
      * \param ifname SocketCAN network interface name (such as can0)
+     * \param reactor Reactor to read the socket with
+     * \param priority Read priority of the socket, see CanReactor::add
      * \param rdcb Callback on received messages
      * \param errcb Callback on socket failure
      * \return Socket instance, or nullptr if it wasn't possible to open one
      */
-    static std::unique_ptr<CanSocket> open(const std::string& ifname, ReadCallback rdcb,
-                                           ErrorCallback errcb);
+    static std::unique_ptr<CanSocket> open(const std::string& ifname, CanReactor& reactor,
+                                           int priority, ReadCallback rdcb, ErrorCallback errcb);
     virtual ~CanSocket();
 
+    using CanTransport::send;
+
+    /**
+     * Send CAN frames, in order.
+     *
+     * Frames of concurrent send calls are coalesced into as few system calls as possible. If the
+     * interface transmit queue is full, sending is retried for a while instead of failing.
+     *
+     * \param frames Frames to send
+     * \return true if all frames were sent, false otherwise
+     */
+    bool send(std::span<const struct canfd_frame> frames) override;
+
+    TxStats getTxStats() const override;
+
     /**
-     * Send CAN frame.
+     * Set the frames the kernel passes to this socket, see CAN_RAW_FILTER.
+     *
+     * Frames not matching any filter are dropped by the kernel, so they never wake the reader
+     * thread up. Error frames are not affected.
      *
-     * \param frame Frame to send
+     * \param filters Filters to apply, an empty list drops all frames
      * \return true in case of success, false otherwise
      */
-    bool send(const struct canfd_frame& frame);
+    bool setFilters(std::span<const struct can_filter> filters) override;
 
   private:
+    struct ReadState;
+
     CanSocket(base::unique_fd socket, ReadCallback rdcb, ErrorCallback errcb);
-    void readerThread();
+    bool onReadable();
+    bool onReadFailed(int errnoVal);
+
+    struct TxRequest {
+        std::span<const struct canfd_frame> frames;
+        std::chrono::nanoseconds enqueueTime;
+        bool done = false;
+        bool ok = true;
+    };
+    TxStats flushTxRequests(const std::vector<TxRequest*>& requests);
 
     ReadCallback mReadCallback;
     ErrorCallback mErrorCallback;
 
     const base::unique_fd mSocket;
-    std::thread mReaderThread;
-    std::atomic<bool> mStopReaderThread = false;
-    std::atomic<bool> mReaderThreadFinished = false;
+    /** Receive buffers, only used by the reactor thread handling the socket. */
+    const std::unique_ptr<ReadState> mReadState;
+    std::unique_ptr<CanReactor::Registration> mRegistration;
+
+    /**
+     * Transmit queue. The first sender to find it idle flushes it, including the frames other
+     * senders queue meanwhile, while the others wait for their frames to be sent.
+     */
+    mutable std::mutex mTxGuard;
+    std::condition_variable mTxDone;
+    std::vector<TxRequest*> mTxQueue;
+    bool mTxBusy = false;
+    TxStats mTxStats;
+
+    /** Only used by the sender flushing the queue. */
+    std::vector<TxRequest*> mTxFlushing;
+    std::vector<struct mmsghdr> mTxMsgs;
+    std::vector<struct iovec> mTxIovecs;
 
     DISALLOW_COPY_AND_ASSIGN(CanSocket);
 };
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <linux/can.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/**
+ * Channel CAN frames are sent and received with, such as a SocketCAN socket.
+ *
+ * Received frames are passed to the read callback in batches, from the thread reading the
+ * channel.
+ */
+struct CanTransport {
+    /** Received CAN frame, along with its receive time since boot. */
+    struct Frame {
+        struct canfd_frame frame;
+        std::chrono::nanoseconds timestamp;
+    };
+
+    /** Called with all the frames received in a single batch, in order. */
+    using ReadCallback = std::function<void(std::span<const Frame>)>;
+    using ErrorCallback = std::function<void(int errnoVal)>;
+
+    /** Statistics of the transmit path. */
+    struct TxStats {
+        /** Frames sent successfully. */
+        uint64_t frames = 0;
+        /** Frames that couldn't be sent. */
+        uint64_t drops = 0;
+        /** System calls sending frames, each sending one or more of them. */
+        uint64_t sendCalls = 0;
+        /** Times sending was retried because the transmit queue was full. */
+        uint64_t backpressureRetries = 0;
+        /** Send requests completed, and their total and maximum latency. */
+        uint64_t requests = 0;
+        std::chrono::nanoseconds totalLatency = {};
+        std::chrono::nanoseconds maxLatency = {};
+    };
+
+    virtual ~CanTransport() = default;
+
+    /**
+     * Send CAN frame.
+     *
+     * \param frame Frame to send
+     * \return true in case of success, false otherwise
+     */
+    bool send(const struct canfd_frame& frame) {
+        return send(std::span<const struct canfd_frame>(&frame, 1));
+    }
+
+    /**
+     * Send CAN frames, in order.
+     *
+     * \param frames Frames to send
+     * \return true if all frames were sent, false otherwise
+     */
+    virtual bool send(std::span<const struct canfd_frame> frames) = 0;
+
+    virtual TxStats getTxStats() const = 0;
+
+    /**
+     * Set the frames passed to the read callback, see CAN_RAW_FILTER.
+     *
+     * This is only an optimization: transports that can't filter frames pass all of them.
+     *
+     * \param filters Filters to apply, an empty list drops all frames
+     * \return true in case of success, false otherwise
+     */
+    virtual bool setFilters(std::span<const struct can_filter> filters) = 0;
+};
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
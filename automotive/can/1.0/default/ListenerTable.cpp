@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ListenerTable.h"
+
+#include <android-base/logging.h>
+#include <linux/can.h>
+
+#include <iterator>
+#include <limits>
+#include <thread>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/**
+ * How many messages may wait for delivery to a single listener.
+ *
+ * This bounds the memory used by a listener that stopped handling messages.
+ */
+static constexpr size_t kMaxPendingMessages = 4096;
+
+/** Number of standard id and RTR flag combinations. */
+static constexpr size_t kStandardKeys = (CAN_SFF_MASK + 1) * 2;
+
+ListenerQueue::ListenerQueue(sp<ICanMessageListener> callback)
+    : mCallback(callback), mState(std::make_shared<State>()) {
+    std::thread(&ListenerQueue::run, mState, mCallback).detach();
+}
+
+ListenerQueue::~ListenerQueue() {
+    stop();
+}
+
+void ListenerQueue::push(std::vector<CanMessage>& batch) {
+    {
+        std::lock_guard<std::mutex> lck(mState->mutex);
+        if (mState->stopped) {
+            batch.clear();
+            return;
+        }
+        if (mState->pending.size() + batch.size() > kMaxPendingMessages) {
+            if (!mState->overflowReported) {
+                mState->overflowReported = true;
+                LOG(WARNING) << "Listener is not keeping up, dropping messages";
+            }
+            batch.clear();
+            return;
+        }
+
+        if (mState->pending.empty()) {
+            std::swap(mState->pending, batch);
+        } else {
+            std::move(batch.begin(), batch.end(), std::back_inserter(mState->pending));
+        }
+    }
+    batch.clear();
+    mState->cv.notify_one();
+}
+
+void ListenerQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lck(mState->mutex);
+        mState->stopped = true;
+        mState->pending.clear();
+    }
+    mState->cv.notify_one();
+}
+
+void ListenerQueue::run(std::shared_ptr<State> state, sp<ICanMessageListener> callback) {
+    bool failedOnce = false;
+    std::vector<CanMessage> batch;
+
+    std::unique_lock<std::mutex> lck(state->mutex);
+    while (true) {
+        state->cv.wait(lck, [&state] { return state->stopped || !state->pending.empty(); });
+        if (state->stopped) break;
+
+        std::swap(batch, state->pending);
+        state->overflowReported = false;
+        lck.unlock();
+
+        for (const auto& message : batch) {
+            if (!callback->onReceive(message).isOk() && !failedOnce) {
+                failedOnce = true;
+                LOG(WARNING) << "Failed to notify listener about message";
+            }
+        }
+        batch.clear();
+
+        lck.lock();
+    }
+}
+
+/**
+ * Helper function to determine if a flag meets the requirements of a
+ * FilterFlag. See definition of FilterFlag in types.hal
+ *
+ * \param filterFlag FilterFlag object to match flag against
+ * \param flag bool object from CanMessage object
+ */
+static bool satisfiesFilterFlag(FilterFlag filterFlag, bool flag) {
+    if (filterFlag == FilterFlag::DONT_CARE) return true;
+    if (filterFlag == FilterFlag::SET) return flag;
+    if (filterFlag == FilterFlag::NOT_SET) return !flag;
+    return false;
+}
+
+/**
+ * Match the filter set against message id.
+ *
+ * For details on the filters syntax, please see CanMessageFilter at
+ * the HAL definition (types.hal).
+ *
+ * \param filter Filter to match against
+ * \param id Message id to filter
+ * \return true if the message id matches the filter, false otherwise
+ */
+static bool matchFilter(const hidl_vec<CanMessageFilter>& filter, CanMessageId id, bool isRtr,
+                        bool isExtendedId) {
+    if (filter.size() == 0) return true;
+
+    bool anyNonExcludeRulePresent = false;
+    bool anyNonExcludeRuleSatisfied = false;
+    for (auto& rule : filter) {
+        const bool satisfied = ((id & rule.mask) == rule.id) &&
+                               satisfiesFilterFlag(rule.rtr, isRtr) &&
+                               satisfiesFilterFlag(rule.extendedFormat, isExtendedId);
+
+        if (rule.exclude) {
+            // Any exclude rule being satisfied invalidates the whole filter set.
+            if (satisfied) return false;
+        } else {
+            anyNonExcludeRulePresent = true;
+            if (satisfied) anyNonExcludeRuleSatisfied = true;
+        }
+    }
+    return !anyNonExcludeRulePresent || anyNonExcludeRuleSatisfied;
+}
+
+ListenerTable::ListenerTable(std::vector<Listener> listeners) : mListeners(std::move(listeners)) {
+    CHECK(mListeners.size() <= std::numeric_limits<uint16_t>::max()) << "Too many listeners";
+
+    mStandardOffsets.reserve(kStandardKeys + 1);
+    for (size_t key = 0; key < kStandardKeys; key++) {
+        mStandardOffsets.push_back(mStandardMatches.size());
+        for (size_t i = 0; i < mListeners.size(); i++) {
+            if (matchFilter(mListeners[i].filter, key >> 1, (key & 1) != 0, false)) {
+                mStandardMatches.push_back(i);
+            }
+        }
+    }
+    mStandardOffsets.push_back(mStandardMatches.size());
+}
+
+std::span<const uint16_t> ListenerTable::match(CanMessageId id, bool isRtr, bool isExtendedId,
+                                               std::vector<uint16_t>& scratch) const {
+    if (!isExtendedId && id <= CAN_SFF_MASK) {
+        const size_t key = id << 1 | (isRtr ? 1 : 0);
+        const auto begin = mStandardOffsets[key];
+        return {mStandardMatches.data() + begin, mStandardOffsets[key + 1] - begin};
+    }
+
+    scratch.clear();
+    for (size_t i = 0; i < mListeners.size(); i++) {
+        if (matchFilter(mListeners[i].filter, id, isRtr, isExtendedId)) {
+            scratch.push_back(i);
+        }
+    }
+    return scratch;
+}
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/macros.h>
+#include <android/hardware/automotive/can/1.0/ICanMessageListener.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/**
+ * Delivers received messages to a single listener, from a thread of its own.
+ *
+ * This way a slow listener only delays its own messages and not the bus reader, nor the other
+ * listeners.
+ */
+struct ListenerQueue {
+    ListenerQueue(sp<ICanMessageListener> callback);
+    ~ListenerQueue();
+
+    const sp<ICanMessageListener>& getCallback() const { return mCallback; }
+
+    /**
+     * Queue a batch of messages for delivery.
+     *
+     * Messages are moved out of the batch, which is left empty. If the listener fell too far
+     * behind, the batch is dropped.
+     */
+    void push(std::vector<CanMessage>& batch);
+
+    /** Stop delivering messages. Doesn't wait for a delivery in progress to finish. */
+    void stop();
+
+  private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<CanMessage> pending;
+        bool stopped = false;
+        bool overflowReported = false;
+    };
+
+    static void run(std::shared_ptr<State> state, sp<ICanMessageListener> callback);
+
+    const sp<ICanMessageListener> mCallback;
+    /** Shared with the delivery thread, which outlives this object until its delivery is done. */
+    const std::shared_ptr<State> mState;
+
+    DISALLOW_COPY_AND_ASSIGN(ListenerQueue);
+};
+
+/**
+ * Filters of all message listeners, compiled for lookup by message ID.
+ *
+ * The table is immutable and rebuilt whenever a listener is added or removed, so the bus reader
+ * can use it without holding the listeners lock. Standard (11-bit) IDs are looked up directly in
+ * a precomputed table, extended IDs are matched against each listener filter.
+ */
+struct ListenerTable {
+    struct Listener {
+        std::shared_ptr<ListenerQueue> queue;
+        hidl_vec<CanMessageFilter> filter;
+    };
+
+    ListenerTable(std::vector<Listener> listeners);
+
+    size_t size() const { return mListeners.size(); }
+    ListenerQueue& getQueue(size_t index) const { return *mListeners[index].queue; }
+
+    /**
+     * Find listeners for a message.
+     *
+     * \param id Message id
+     * \param isRtr Whether the message is a remote transmission request
+     * \param isExtendedId Whether the message uses a 29 bit id
+     * \param scratch Storage for the result, if it's not precomputed
+     * \return Indices of the matching listeners, valid until the next call with the same scratch
+     */
+    std::span<const uint16_t> match(CanMessageId id, bool isRtr, bool isExtendedId,
+                                    std::vector<uint16_t>& scratch) const;
+
+  private:
+    const std::vector<Listener> mListeners;
+
+    /**
+     * Listeners matching each standard id and RTR flag, indexed by (id << 1 | rtr): listeners for
+     * key k are mStandardMatches[mStandardOffsets[k]] up to mStandardOffsets[k + 1].
+     */
+    std::vector<uint32_t> mStandardOffsets;
+    std::vector<uint16_t> mStandardMatches;
+
+    DISALLOW_COPY_AND_ASSIGN(ListenerTable);
+};
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
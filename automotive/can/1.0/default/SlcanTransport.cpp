@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlcanTransport.h"
+
+#include <android-base/logging.h>
+#include <utils/SystemClock.h>
+
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+using namespace std::chrono_literals;
+
+/** Size of the UART receive buffer, which is filled with a single read(2) call. */
+static constexpr size_t kReadBufferSize = 64 * 1024;
+
+/**
+ * Maximum number of reads before the reactor thread moves on to other sockets.
+ *
+ * If there is more to read, the UART is handled again as soon as a thread is available.
+ */
+static constexpr size_t kMaxReadsPerWakeup = 4;
+
+/**
+ * Longest line a well-formed frame may take: type, 29-bit id, length, 8 data bytes and a 16-bit
+ * timestamp. Anything longer is garbage and gets discarded.
+ */
+static constexpr size_t kMaxLineLength = 1 + 8 + 1 + 2 * CAN_MAX_DLEN + 4;
+
+/** How long sending waits for the UART to drain before giving up. */
+static constexpr auto kSendTimeout = 100ms;
+
+namespace slcanprotocol {
+static constexpr char kLineEnd = '\r';
+static constexpr char kError = '\a';
+static constexpr size_t kStandardIdLength = 3;
+static constexpr size_t kExtendedIdLength = 8;
+static constexpr size_t kTimestampLength = 4;
+}  // namespace slcanprotocol
+
+static constexpr auto kHexValues = [] {
+    std::array<int8_t, 256> values = {};
+    std::fill(values.begin(), values.end(), -1);
+    for (int i = 0; i < 10; i++) values['0' + i] = i;
+    for (int i = 0; i < 6; i++) values['A' + i] = values['a' + i] = 10 + i;
+    return values;
+}();
+
+static constexpr char kHexDigits[] = "0123456789ABCDEF";
+
+/**
+ * Parse a fixed number of hex digits.
+ *
+ * \param str Digits to parse
+ * \param length Number of digits
+ * \return Parsed value, or -1 if any of the characters isn't a hex digit
+ */
+static int64_t parseHex(const char* str, size_t length) {
+    int64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        const auto digit = kHexValues[static_cast<uint8_t>(str[i])];
+        if (digit < 0) return -1;
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+/**
+ * Parse a line of SLCAN input, without its terminator.
+ *
+ * \param line First character of the line
+ * \param end End of the line
+ * \param frame Parsed frame, if the line carries one
+ * \return 1 if the line carries a frame, 0 if it's something else (such as an acknowledgement),
+ *         -1 if it's malformed
+ */
+static int parseLine(const char* line, const char* end, struct canfd_frame& frame) {
+    // Error responses have no line terminator of their own, so they prefix the next line
+    if (const auto bel = static_cast<const char*>(memrchr(line, slcanprotocol::kError, end - line));
+        bel != nullptr) {
+        line = bel + 1;
+    }
+    if (line == end) return 0;
+
+    const char type = *line;
+    if (type != 't' && type != 'T' && type != 'r' && type != 'R') {
+        // Transmit acknowledgements, status flags, version information...
+        return 0;
+    }
+    const bool isExtended = type == 'T' || type == 'R';
+    const bool isRtr = type == 'r' || type == 'R';
+    line++;
+
+    const size_t idLength =
+            isExtended ? slcanprotocol::kExtendedIdLength : slcanprotocol::kStandardIdLength;
+    if (size_t(end - line) < idLength + 1) return -1;
+    const auto id = parseHex(line, idLength);
+    if (id < 0 || id > (isExtended ? CAN_EFF_MASK : CAN_SFF_MASK)) return -1;
+    line += idLength;
+
+    const auto len = parseHex(line, 1);
+    if (len < 0 || len > CAN_MAX_DLEN) return -1;
+    line++;
+
+    frame = {};
+    frame.can_id = id;
+    if (isExtended) frame.can_id |= CAN_EFF_FLAG;
+    if (isRtr) frame.can_id |= CAN_RTR_FLAG;
+    frame.len = len;
+
+    if (!isRtr) {
+        if (size_t(end - line) < size_t(len) * 2) return -1;
+        for (int i = 0; i < len; i++, line += 2) {
+            const auto byte = parseHex(line, 2);
+            if (byte < 0) return -1;
+            frame.data[i] = byte;
+        }
+    }
+
+    // Adaptors may be configured to append a timestamp, which isn't used
+    if (line != end && size_t(end - line) != slcanprotocol::kTimestampLength) return -1;
+    return 1;
+}
+
+/** Append a frame to the data to send, see parseLine for the format. */
+static void encodeFrame(const struct canfd_frame& frame, std::string& out) {
+    const bool isExtended = (frame.can_id & CAN_EFF_FLAG) != 0;
+    const bool isRtr = (frame.can_id & CAN_RTR_FLAG) != 0;
+
+    out.push_back(isRtr ? (isExtended ? 'R' : 'r') : (isExtended ? 'T' : 't'));
+    const auto id = frame.can_id & (isExtended ? CAN_EFF_MASK : CAN_SFF_MASK);
+    const size_t idLength =
+            isExtended ? slcanprotocol::kExtendedIdLength : slcanprotocol::kStandardIdLength;
+    for (size_t i = idLength; i > 0; i--) {
+        out.push_back(kHexDigits[(id >> (4 * (i - 1))) & 0xF]);
+    }
+    out.push_back(kHexDigits[frame.len]);
+    if (!isRtr) {
+        for (size_t i = 0; i < frame.len; i++) {
+            out.push_back(kHexDigits[frame.data[i] >> 4]);
+            out.push_back(kHexDigits[frame.data[i] & 0xF]);
+        }
+    }
+    out.push_back(slcanprotocol::kLineEnd);
+}
+
+struct SlcanTransport::ReadState {
+    std::array<char, kReadBufferSize> buffer;
+    /** Length of the partial line kept at the beginning of the buffer. */
+    size_t length = 0;
+    /** Whether the rest of the current line is discarded, because it got too long. */
+    bool discardLine = false;
+    std::vector<Frame> frames;
+    uint64_t malformedLines = 0;
+};
+
+std::unique_ptr<SlcanTransport> SlcanTransport::open(int uartFd, const std::string& name,
+                                                     CanReactor& reactor, int priority,
+                                                     ReadCallback rdcb, ErrorCallback errcb) {
+    // Can't use std::make_unique due to private SlcanTransport constructor.
+    std::unique_ptr<SlcanTransport> transport(new SlcanTransport(uartFd, name, rdcb, errcb));
+
+    auto transportPtr = transport.get();
+    transport->mRegistration = reactor.add(uartFd, priority,
+                                           [transportPtr] { return transportPtr->onReadable(); });
+    if (!transport->mRegistration) {
+        LOG(ERROR) << "Can't start reading from " << name;
+        return nullptr;
+    }
+    return transport;
+}
+
+SlcanTransport::SlcanTransport(int uartFd, const std::string& name, ReadCallback rdcb,
+                               ErrorCallback errcb)
+    : mReadCallback(rdcb),
+      mErrorCallback(errcb),
+      mUartFd(uartFd),
+      mName(name),
+      mReadState(std::make_unique<ReadState>()) {}
+
+SlcanTransport::~SlcanTransport() {
+    // Waits for the reactor to finish reading, unless the transport is destroyed from onReadable()
+    mRegistration.reset();
+}
+
+bool SlcanTransport::send(std::span<const struct canfd_frame> frames) {
+    const std::chrono::nanoseconds enqueueTime(elapsedRealtimeNano());
+
+    std::lock_guard<std::mutex> lck(mTxGuard);
+    mTxBuffer.clear();
+    mTxFrameEnds.clear();
+    bool ok = true;
+    for (const auto& frame : frames) {
+        if (frame.len > CAN_MAX_DLEN) {
+            mTxStats.drops++;
+            ok = false;
+            continue;
+        }
+        encodeFrame(frame, mTxBuffer);
+        mTxFrameEnds.push_back(mTxBuffer.size());
+    }
+
+    const auto written = writeAll(mTxBuffer, mTxStats);
+    const auto sent = std::upper_bound(mTxFrameEnds.begin(), mTxFrameEnds.end(), written) -
+                      mTxFrameEnds.begin();
+    mTxStats.frames += sent;
+    if (size_t(sent) != mTxFrameEnds.size()) {
+        mTxStats.drops += mTxFrameEnds.size() - sent;
+        ok = false;
+    }
+
+    const auto latency = std::chrono::nanoseconds(elapsedRealtimeNano()) - enqueueTime;
+    mTxStats.requests++;
+    mTxStats.totalLatency += latency;
+    mTxStats.maxLatency = std::max(mTxStats.maxLatency, latency);
+
+    return ok;
+}
+
+/**
+ * Write data to the UART, waiting for it to drain if needed.
+ *
+ * \param data Data to write
+ * \param stats Statistics to update
+ * \return Number of bytes written
+ */
+size_t SlcanTransport::writeAll(const std::string& data, TxStats& stats) {
+    const auto deadline = std::chrono::nanoseconds(elapsedRealtimeNano()) + kSendTimeout;
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto res = write(mUartFd, data.data() + written, data.size() - written);
+        if (res > 0) {
+            stats.sendCalls++;
+            written += res;
+            continue;
+        }
+        if (res < 0 && errno == EINTR) continue;
+
+        if (res < 0 && errno == EAGAIN) {
+            const auto remaining = deadline - std::chrono::nanoseconds(elapsedRealtimeNano());
+            if (remaining > 0ns) {
+                stats.backpressureRetries++;
+                struct pollfd pfd = {mUartFd, POLLOUT, 0};
+                const auto timeoutMs =
+                        std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+                poll(&pfd, 1, timeoutMs);
+                continue;
+            }
+        }
+
+        PLOG(DEBUG) << "SLCAN send failed on " << mName;
+        break;
+    }
+    return written;
+}
+
+SlcanTransport::TxStats SlcanTransport::getTxStats() const {
+    std::lock_guard<std::mutex> lck(mTxGuard);
+    return mTxStats;
+}
+
+bool SlcanTransport::setFilters(std::span<const struct can_filter>) {
+    // Frames are filtered by the listeners anyway
+    return true;
+}
+
+bool SlcanTransport::onReadable() {
+    auto& state = *mReadState;
+
+    for (size_t i = 0; i < kMaxReadsPerWakeup; i++) {
+        const auto space = state.buffer.size() - state.length;
+        const auto res = read(mUartFd, state.buffer.data() + state.length, space);
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EINTR) return true;
+
+            PLOG(ERROR) << "Failed to read from " << mName;
+            return onReadFailed(errno);
+        }
+        if (res == 0) {
+            LOG(ERROR) << mName << " was closed";
+            return onReadFailed(ENODEV);
+        }
+
+        // The frames of a chunk arrived at most a few milliseconds apart, so they share a timestamp
+        const std::chrono::nanoseconds readTs(elapsedRealtimeNano());
+        const char* line = state.buffer.data();
+        const char* const end = line + state.length + res;
+
+        // memchr is vectorized, so lines are found much faster than by checking every character
+        state.frames.clear();
+        while (auto lineEnd =
+                       static_cast<const char*>(memchr(line, slcanprotocol::kLineEnd, end - line))) {
+            if (state.discardLine) {
+                state.discardLine = false;
+            } else {
+                auto& frame = state.frames.emplace_back(Frame{{}, readTs});
+                const auto parsed = parseLine(line, lineEnd, frame.frame);
+                if (parsed <= 0) state.frames.pop_back();
+                if (parsed < 0 && state.malformedLines++ == 0) {
+                    LOG(WARNING) << "Malformed SLCAN input on " << mName;
+                }
+            }
+            line = lineEnd + 1;
+        }
+
+        // Keep the partial line for the next read, unless it's garbage
+        state.length = end - line;
+        if (state.length > kMaxLineLength) {
+            state.length = 0;
+            state.discardLine = true;
+        } else {
+            memmove(state.buffer.data(), line, state.length);
+        }
+
+        if (!state.frames.empty()) mReadCallback(state.frames);
+        if (size_t(res) < space) break;
+    }
+    return true;
+}
+
+bool SlcanTransport::onReadFailed(int errnoVal) {
+    // The error callback may destroy this transport, so don't access any fields after calling it
+    auto errCb = mErrorCallback;
+    errCb(errnoVal);
+    return false;
+}
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "CanReactor.h"
+#include "CanTransport.h"
+
+#include <android-base/macros.h>
+#include <utils/Mutex.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android::hardware::automotive::can::V1_0::implementation {
+
+/**
+ * SLCAN (Lawicel) protocol spoken over a serial line from userspace.
+ *
+ * This is an alternative to the kernel slcan line discipline, which reads the UART a few bytes at
+ * a time and delivers each frame on its own. Here the UART is read in large chunks, and all the
+ * frames of a chunk are delivered as a single batch.
+ */
+struct SlcanTransport : public CanTransport {
+    /**
+     * Start reading frames from a serial line.
+     *
+     * The serial line must be configured, in non-blocking mode and with the SLCAN channel already
+     * open.
+     *
+     * \param uartFd Serial line, must outlive the transport
+     * \param name Name of the serial line, for logging
+     * \param reactor Reactor to read the serial line with
+     * \param priority Read priority of the serial line, see CanReactor::add
+     * \param rdcb Callback on received frames
+     * \param errcb Callback on serial line failure
+     * \return Transport instance, or nullptr if it wasn't possible to start reading
+     */
+    static std::unique_ptr<SlcanTransport> open(int uartFd, const std::string& name,
+                                                CanReactor& reactor, int priority,
+                                                ReadCallback rdcb, ErrorCallback errcb);
+    virtual ~SlcanTransport();
+
+    using CanTransport::send;
+
+    /**
+     * Send CAN frames, in order.
+     *
+     * All the frames are written with a single system call, as long as the UART keeps up.
+     *
+     * \param frames Frames to send
+     * \return true if all frames were sent, false otherwise
+     */
+    bool send(std::span<const struct canfd_frame> frames) override;
+
+    TxStats getTxStats() const override;
+
+    /** SLCAN adaptors don't filter frames, so this doesn't do anything. */
+    bool setFilters(std::span<const struct can_filter> filters) override;
+
+  private:
+    struct ReadState;
+
+    SlcanTransport(int uartFd, const std::string& name, ReadCallback rdcb, ErrorCallback errcb);
+    bool onReadable();
+    bool onReadFailed(int errnoVal);
+    size_t writeAll(const std::string& data, TxStats& stats) REQUIRES(mTxGuard);
+
+    ReadCallback mReadCallback;
+    ErrorCallback mErrorCallback;
+
+    const int mUartFd;
+    const std::string mName;
+    /** Receive buffer and parser state, only used by the reactor thread handling the UART. */
+    const std::unique_ptr<ReadState> mReadState;
+    std::unique_ptr<CanReactor::Registration> mRegistration;
+
+    mutable std::mutex mTxGuard;
+    TxStats mTxStats GUARDED_BY(mTxGuard);
+    /** Encoded frames being sent, and the offset each of them ends at. */
+    std::string mTxBuffer GUARDED_BY(mTxGuard);
+    std::vector<size_t> mTxFrameEnds GUARDED_BY(mTxGuard);
+
+    DISALLOW_COPY_AND_ASSIGN(SlcanTransport);
+};
+
+}  // namespace android::hardware::automotive::can::V1_0::implementation
@@ -89,8 +89,7 @@ bool setBitrate(std::string ifname, uint32_t bitrate) {
         }
     }
 
-    nl::Socket sock(NETLINK_ROUTE);
-    return sock.send(req) && sock.receiveAck(req);
+    return sendAndAck(req);
 }
 
 }  // namespace android::netdevice::can
@@ -18,10 +18,15 @@
 
 #include <android-base/logging.h>
 
+#include <linux/rtnetlink.h>
 #include <net/if.h>
 
+#include <optional>
+
 namespace android::netdevice {
 
+static thread_local std::optional<nl::Socket> sRouteSocket;
+
 unsigned int nametoindex(const std::string& ifname) {
     const auto ifidx = if_nametoindex(ifname.c_str());
     if (ifidx != 0) return ifidx;
@@ -32,4 +37,13 @@ unsigned int nametoindex(const std::string& ifname) {
     return 0;
 }
 
+nl::Socket& routeSocket() {
+    if (!sRouteSocket.has_value()) sRouteSocket.emplace(NETLINK_ROUTE);
+    return *sRouteSocket;
+}
+
+void resetRouteSocket() {
+    sRouteSocket.reset();
+}
+
 }  // namespace android::netdevice
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <libnl++/MessageFactory.h>
+#include <libnl++/Socket.h>
+
 #include <linux/can.h>
 #include <net/if.h>
 
@@ -34,4 +37,33 @@ namespace android::netdevice {
  */
 unsigned int nametoindex(const std::string& ifname);
 
+/**
+ * Returns a NETLINK_ROUTE socket of the calling thread.
+ *
+ * The socket is kept open between requests, so configuring multiple interfaces doesn't open and
+ * bind a new socket (and allocate its receive buffer) for each of them.
+ */
+nl::Socket& routeSocket();
+
+/**
+ * Closes the NETLINK_ROUTE socket of the calling thread, so the next request uses a new one.
+ */
+void resetRouteSocket();
+
+/**
+ * Sends a NETLINK_ROUTE request and waits for its acknowledgment.
+ *
+ * \param req Request to send, with NLM_F_ACK flag set
+ * \return true if the request was acknowledged, false otherwise
+ */
+template <typename T, unsigned BUFSIZE>
+bool sendAndAck(nl::MessageFactory<T, BUFSIZE>& req) {
+    auto& sock = routeSocket();
+    if (sock.send(req) && sock.receiveAck(req)) return true;
+
+    // The socket could still have unread replies to this request, don't reuse it
+    resetRouteSocket();
+    return false;
+}
+
 }  // namespace android::netdevice
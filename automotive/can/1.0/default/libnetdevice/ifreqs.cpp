@@ -47,15 +47,31 @@ static SocketParams getSocketParams(int domain) {
     return params;
 }
 
-int trySend(unsigned long request, struct ifreq& ifr) {
-    const auto sp = getSocketParams(socketDomain);
-    base::unique_fd sock(socket(sp.domain, sp.type, sp.protocol));
+/**
+ * Sockets for ioctl requests, by domain.
+ *
+ * They are kept open instead of being created for every request, as bringing up a single interface
+ * takes several of them.
+ */
+static thread_local std::map<int, base::unique_fd> sSockets;
+
+static int getSocket(int domain) {
+    auto& sock = sSockets[domain];
     if (!sock.ok()) {
-        LOG(ERROR) << "Can't create socket";
-        return false;
+        const auto sp = getSocketParams(domain);
+        sock.reset(socket(sp.domain, sp.type | SOCK_CLOEXEC, sp.protocol));
+    }
+    return sock.get();
+}
+
+int trySend(unsigned long request, struct ifreq& ifr) {
+    const auto sock = getSocket(socketDomain);
+    if (sock < 0) {
+        PLOG(ERROR) << "Can't create socket";
+        return errno;
     }
 
-    if (ioctl(sock.get(), request, &ifr) < 0) return errno;
+    if (ioctl(sock, request, &ifr) < 0) return errno;
     return 0;
 }
 
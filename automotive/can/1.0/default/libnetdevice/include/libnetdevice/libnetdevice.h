@@ -111,6 +111,28 @@ bool up(std::string ifname);
  */
 bool down(std::string ifname);
 
+/**
+ * Brings multiple network interfaces up.
+ *
+ * Interfaces that are already up are left alone, and all requests go through the same socket.
+ * All interfaces are attempted, even if some of them fail.
+ *
+ * \param ifnames Interfaces to bring up
+ * \return true if all interfaces are up, false otherwise
+ */
+bool upAll(const std::set<std::string>& ifnames);
+
+/**
+ * Brings multiple network interfaces down.
+ *
+ * Interfaces that are already down are left alone, and all requests go through the same socket.
+ * All interfaces are attempted, even if some of them fail.
+ *
+ * \param ifnames Interfaces to bring down
+ * \return true if all interfaces are down, false otherwise
+ */
+bool downAll(const std::set<std::string>& ifnames);
+
 /**
  * Adds virtual link.
  *
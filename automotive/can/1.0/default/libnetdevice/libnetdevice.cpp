@@ -55,6 +55,33 @@ bool down(std::string ifname) {
     return ifreqs::send(SIOCSIFFLAGS, ifr);
 }
 
+static bool setUp(const std::set<std::string>& ifnames, bool up) {
+    bool success = true;
+    for (const auto& ifname : ifnames) {
+        auto ifr = ifreqs::fromName(ifname);
+        if (!ifreqs::send(SIOCGIFFLAGS, ifr)) {
+            success = false;
+            continue;
+        }
+        if (((ifr.ifr_flags & IFF_UP) != 0) == up) continue;
+        if (up) {
+            ifr.ifr_flags |= IFF_UP;
+        } else {
+            ifr.ifr_flags &= ~IFF_UP;
+        }
+        if (!ifreqs::send(SIOCSIFFLAGS, ifr)) success = false;
+    }
+    return success;
+}
+
+bool upAll(const std::set<std::string>& ifnames) {
+    return setUp(ifnames, true);
+}
+
+bool downAll(const std::set<std::string>& ifnames) {
+    return setUp(ifnames, false);
+}
+
 bool add(std::string dev, std::string type) {
     nl::MessageFactory<ifinfomsg> req(RTM_NEWLINK,
                                       NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL | NLM_F_ACK);
@@ -65,16 +92,14 @@ bool add(std::string dev, std::string type) {
         req.addBuffer(IFLA_INFO_KIND, type);
     }
 
-    nl::Socket sock(NETLINK_ROUTE);
-    return sock.send(req) && sock.receiveAck(req);
+    return sendAndAck(req);
 }
 
 bool del(std::string dev) {
     nl::MessageFactory<ifinfomsg> req(RTM_DELLINK, NLM_F_REQUEST | NLM_F_ACK);
     req.add(IFLA_IFNAME, dev);
 
-    nl::Socket sock(NETLINK_ROUTE);
-    return sock.send(req) && sock.receiveAck(req);
+    return sendAndAck(req);
 }
 
 std::optional<hwaddr_t> getHwAddr(const std::string& ifname) {
@@ -21,32 +21,45 @@
 
 namespace android::nl {
 
-static nlattr* tail(nlmsghdr* msg) {
-    return reinterpret_cast<nlattr*>(uintptr_t(msg) + impl::align(msg->nlmsg_len));
+/** Largest buffer kept for reuse by a thread, so a single huge message doesn't pin memory. */
+static constexpr size_t kMaxRecycledBufferSize = 16384;
+
+static thread_local std::vector<uint8_t> sRecycledBuffer;
+
+std::vector<uint8_t> MessageFactoryBase::acquireBuffer(size_t size) {
+    std::vector<uint8_t> buffer;
+    std::swap(buffer, sRecycledBuffer);
+    buffer.clear();
+    buffer.resize(size);
+    return buffer;
+}
+
+void MessageFactoryBase::releaseBuffer(std::vector<uint8_t> buffer) {
+    if (buffer.capacity() > kMaxRecycledBufferSize) return;
+    if (buffer.capacity() <= sRecycledBuffer.capacity()) return;
+    sRecycledBuffer = std::move(buffer);
 }
 
-nlattr* MessageFactoryBase::add(nlmsghdr* msg, size_t maxLen, nlattrtype_t type, const void* data,
-                                size_t dataLen) {
-    const auto totalAttrLen = impl::length<nlattr>(dataLen);
-    const auto newLen = impl::align(msg->nlmsg_len) + impl::align(totalAttrLen);
-    if (newLen > maxLen) {
-        LOG(ERROR) << "Can't add attribute of size " << dataLen  //
-                   << " - exceeded maxLen: " << newLen << " > " << maxLen;
-        return nullptr;
-    }
-
-    auto attr = tail(msg);
-    attr->nla_len = totalAttrLen;
+size_t MessageFactoryBase::lengthWithAttribute(const nlmsghdr& header, size_t dataLen) {
+    return impl::align(header.nlmsg_len) + impl::align(impl::length<nlattr>(dataLen));
+}
+
+size_t MessageFactoryBase::add(nlmsghdr& header, uint8_t* base, nlattrtype_t type,
+                               const void* data, size_t dataLen) {
+    const auto offset = impl::align(header.nlmsg_len);
+
+    auto attr = reinterpret_cast<nlattr*>(base + offset);
+    attr->nla_len = impl::length<nlattr>(dataLen);
     attr->nla_type = type;
     if (dataLen > 0) memcpy(impl::data<nlattr, void>(attr), data, dataLen);
 
-    msg->nlmsg_len = newLen;
-    return attr;
+    header.nlmsg_len = lengthWithAttribute(header, dataLen);
+    return offset;
 }
 
-void MessageFactoryBase::closeNested(nlmsghdr* msg, nlattr* nested) {
-    if (nested == nullptr) return;
-    nested->nla_len = uintptr_t(tail(msg)) - uintptr_t(nested);
+void MessageFactoryBase::closeNested(const nlmsghdr& header, uint8_t* base, size_t nestedOffset) {
+    auto nested = reinterpret_cast<nlattr*>(base + nestedOffset);
+    nested->nla_len = impl::align(header.nlmsg_len) - nestedOffset;
 }
 
 }  // namespace android::nl
@@ -20,6 +20,8 @@
 
 #include <android-base/logging.h>
 
+#include <algorithm>
+
 namespace android::nl {
 
 /**
@@ -147,12 +149,12 @@ bool Socket::receiveAck(uint32_t seq) {
     return false;
 }
 
-std::optional<Buffer<nlmsghdr>> Socket::receive(const std::set<nlmsgtype_t>& msgtypes,
+std::optional<Buffer<nlmsghdr>> Socket::receive(std::initializer_list<nlmsgtype_t> msgtypes,
                                                 size_t maxSize) {
     if (mFailed || !increaseReceiveBuffer(maxSize)) return std::nullopt;
 
     for (const auto rawMsg : *this) {
-        if (msgtypes.count(rawMsg->nlmsg_type) == 0) {
+        if (std::find(msgtypes.begin(), msgtypes.end(), rawMsg->nlmsg_type) == msgtypes.end()) {
             LOG(WARNING) << "Received (and ignored) unexpected Netlink message of type "
                          << rawMsg->nlmsg_type;
             continue;
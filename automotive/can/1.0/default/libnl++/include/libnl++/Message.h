@@ -19,7 +19,8 @@
 #include <libnl++/Attributes.h>
 #include <libnl++/Buffer.h>
 
-#include <set>
+#include <algorithm>
+#include <initializer_list>
 
 namespace android::nl {
 
@@ -63,11 +64,13 @@ class Message : public Buffer<nlmsghdr> {
      *         doesn't match.
      */
     static std::optional<Message<T>> parse(Buffer<nlmsghdr> buf,
-                                           const std::set<nlmsgtype_t>& msgtypes) {
+                                           std::initializer_list<nlmsgtype_t> msgtypes) {
         const auto& [nlOk, nlHeader] = buf.getFirst();  // we're doing it twice, but it's fine
         if (!nlOk) return std::nullopt;
 
-        if (msgtypes.count(nlHeader.nlmsg_type) == 0) return std::nullopt;
+        if (std::find(msgtypes.begin(), msgtypes.end(), nlHeader.nlmsg_type) == msgtypes.end()) {
+            return std::nullopt;
+        }
 
         return parse(buf);
     }
@@ -16,28 +16,55 @@
 
 #pragma once
 
+#include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <libnl++/Buffer.h>
 #include <libnl++/types.h>
 
 #include <linux/netlink.h>
 
+#include <algorithm>
+#include <cstring>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace android::nl {
 
 class MessageFactoryBase {
   protected:
-    static nlattr* add(nlmsghdr* msg, size_t maxLen, nlattrtype_t type, const void* data,
-                       size_t dataLen);
-    static void closeNested(nlmsghdr* msg, nlattr* nested);
+    /**
+     * Get a zero-filled buffer for a message outgrowing its inline storage.
+     *
+     * Buffers are recycled between the messages built by a thread, so building large messages
+     * over and over doesn't allocate each time.
+     */
+    static std::vector<uint8_t> acquireBuffer(size_t size);
+    static void releaseBuffer(std::vector<uint8_t> buffer);
+
+    /** Total message length after adding an attribute with dataLen bytes of payload. */
+    static size_t lengthWithAttribute(const nlmsghdr& header, size_t dataLen);
+
+    /**
+     * Add an attribute at the end of a message.
+     *
+     * \param header Message header, its length gets updated.
+     * \param base Message storage, large enough to fit the attribute.
+     * \return Offset of the attribute from the start of the message.
+     */
+    static size_t add(nlmsghdr& header, uint8_t* base, nlattrtype_t type, const void* data,
+                      size_t dataLen);
+    static void closeNested(const nlmsghdr& header, uint8_t* base, size_t nestedOffset);
 };
 
 /**
  * Wrapper around NETLINK_ROUTE messages, to build them in C++ style.
  *
+ * The message is built in place in an inline buffer. If attributes don't fit there, the message
+ * moves to a growable buffer on the heap.
+ *
  * \param T Message payload type (such as ifinfomsg).
- * \param BUFSIZE how much space to reserve for attributes.
+ * \param BUFSIZE how much space to reserve inline for attributes.
  */
 template <class T, unsigned int BUFSIZE = 128>
 class MessageFactory : private MessageFactoryBase {
@@ -61,6 +88,10 @@ class MessageFactory : private MessageFactoryBase {
         mMessage.header.nlmsg_flags = flags;
     }
 
+    ~MessageFactory() {
+        if (!mOverflow.empty()) releaseBuffer(std::move(mOverflow));
+    }
+
     /**
      * Netlink message header.
      *
@@ -81,16 +112,20 @@ class MessageFactory : private MessageFactoryBase {
      * Build netlink message.
      *
      * In fact, this operation is almost a no-op, since the factory builds the message in a single
-     * buffer, using native data structures.
+     * buffer, using native data structures. If the message outgrew the inline buffer, its header
+     * and payload are copied over to the heap buffer holding the attributes.
      *
-     * A likely failure case is when the BUFSIZE template parameter is too small to acommodate
-     * added attributes. In such a case, please increase this parameter.
+     * The returned buffer is valid until the factory is modified or destroyed.
      *
      * \return Netlink message or std::nullopt in case of failure.
      */
     std::optional<Buffer<nlmsghdr>> build() const {
         if (!mIsGood) return std::nullopt;
-        return {{&mMessage.header, mMessage.header.nlmsg_len}};
+        if (mOverflow.empty()) return {{&mMessage.header, mMessage.header.nlmsg_len}};
+
+        // header and data references always point to the inline copy
+        memcpy(mOverflow.data(), &mMessage, offsetof(Message, attributesBuffer));
+        return {{reinterpret_cast<const nlmsghdr*>(mOverflow.data()), mMessage.header.nlmsg_len}};
     }
 
     /**
@@ -98,8 +133,8 @@ class MessageFactory : private MessageFactoryBase {
      *
      * Template specializations may extend this function for other types, such as std::string.
      *
-     * If this method fails (i.e. due to insufficient space), a warning will be printed to the log
-     * and the message will be marked as bad, causing later \see build call to fail.
+     * If this method fails, a warning will be printed to the log and the message will be marked as
+     * bad, causing later \see build call to fail.
      *
      * \param type attribute type (such as IFLA_IFNAME)
      * \param attr attribute data
@@ -124,12 +159,16 @@ class MessageFactory : private MessageFactoryBase {
     class [[nodiscard]] NestedGuard {
       public:
         NestedGuard(MessageFactory& req, nlattrtype_t type)
-            : mReq(req), mAttr(req.addInternal(type)) {}
-        ~NestedGuard() { closeNested(&mReq.mMessage.header, mAttr); }
+            : mReq(req), mOffset(req.addInternal(type)) {}
+        ~NestedGuard() {
+            if (!mOffset.has_value()) return;
+            closeNested(mReq.mMessage.header, mReq.storage(), *mOffset);
+        }
 
       private:
         MessageFactory& mReq;
-        nlattr* mAttr;
+        /** Offset rather than pointer, as the message may move to a larger buffer meanwhile. */
+        std::optional<size_t> mOffset;
 
         DISALLOW_COPY_AND_ASSIGN(NestedGuard);
     };
@@ -158,14 +197,45 @@ class MessageFactory : private MessageFactoryBase {
     NestedGuard addNested(nlattrtype_t type) { return {*this, type}; }
 
   private:
+    /** Upper bound for messages, way larger than anything the kernel would accept. */
+    static constexpr size_t kMaxMessageSize = 1 << 20;
+
     Message mMessage = {};
+    /** Message storage once it doesn't fit mMessage; only the attributes are kept up to date. */
+    mutable std::vector<uint8_t> mOverflow;
     bool mIsGood = true;
 
-    nlattr* addInternal(nlattrtype_t type, const void* data = nullptr, size_t len = 0) {
-        if (!mIsGood) return nullptr;
-        auto attr = MessageFactoryBase::add(&mMessage.header, sizeof(mMessage), type, data, len);
-        if (attr == nullptr) mIsGood = false;
-        return attr;
+    uint8_t* storage() {
+        if (!mOverflow.empty()) return mOverflow.data();
+        return reinterpret_cast<uint8_t*>(&mMessage);
+    }
+
+    size_t capacity() const { return mOverflow.empty() ? sizeof(mMessage) : mOverflow.size(); }
+
+    std::optional<size_t> addInternal(nlattrtype_t type, const void* data = nullptr,
+                                      size_t len = 0) {
+        if (!mIsGood) return std::nullopt;
+
+        const auto newLen = lengthWithAttribute(mMessage.header, len);
+        if (newLen > kMaxMessageSize) {
+            LOG(ERROR) << "Can't add attribute of size " << len  //
+                       << " - exceeded maximum message size: " << newLen;
+            mIsGood = false;
+            return std::nullopt;
+        }
+        if (newLen > capacity()) grow(newLen);
+
+        return MessageFactoryBase::add(mMessage.header, storage(), type, data, len);
+    }
+
+    void grow(size_t minSize) {
+        const auto newSize = std::max(minSize, 2 * capacity());
+        if (!mOverflow.empty()) {
+            mOverflow.resize(newSize);
+            return;
+        }
+        mOverflow = acquireBuffer(newSize);
+        memcpy(mOverflow.data(), &mMessage, sizeof(mMessage));
     }
 };
 
@@ -25,8 +25,8 @@
 #include <linux/netlink.h>
 #include <poll.h>
 
+#include <initializer_list>
 #include <optional>
-#include <set>
 #include <vector>
 
 namespace android::nl {
@@ -149,7 +149,7 @@ class Socket {
      * \return Parsed message or std::nullopt in case of error.
      */
     template <typename T>
-    std::optional<Message<T>> receive(const std::set<nlmsgtype_t>& msgtypes,
+    std::optional<Message<T>> receive(std::initializer_list<nlmsgtype_t> msgtypes,
                                       size_t maxSize = defaultReceiveSize) {
         const auto msg = receive(msgtypes, maxSize);
         if (!msg.has_value()) return std::nullopt;
@@ -258,7 +258,8 @@ class Socket {
     uint32_t mSeq = 0;
 
     bool increaseReceiveBuffer(size_t maxSize);
-    std::optional<Buffer<nlmsghdr>> receive(const std::set<nlmsgtype_t>& msgtypes, size_t maxSize);
+    std::optional<Buffer<nlmsghdr>> receive(std::initializer_list<nlmsgtype_t> msgtypes,
+                                            size_t maxSize);
 
     DISALLOW_COPY_AND_ASSIGN(Socket);
 };
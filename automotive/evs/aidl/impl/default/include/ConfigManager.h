@@ -28,6 +28,7 @@
 #include <limits>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
@@ -50,6 +51,7 @@ typedef struct {
 class ConfigManager final {
   public:
     static std::unique_ptr<ConfigManager> Create();
+    ~ConfigManager();
     ConfigManager(const ConfigManager&) = delete;
     ConfigManager& operator=(const ConfigManager&) = delete;
 
@@ -227,10 +229,14 @@ class ConfigManager final {
 
   private:
     /* Constructors */
-    ConfigManager() : mBinaryFilePath("") {}
+    ConfigManager() : mBinaryFilePath(sConfigBinaryPath.data()) {}
+
+    class BinaryWriter;
+    class BinaryReader;
 
     static std::string_view sConfigDefaultPath;
     static std::string_view sConfigOverridePath;
+    static std::string_view sConfigBinaryPath;
 
     /* System configuration */
     SystemInfo mSystemInfo;
@@ -265,6 +271,9 @@ class ConfigManager final {
     /* Configuration data readiness */
     bool mIsReady = false;
 
+    /* Writes or refreshes the binary configuration file in the background */
+    std::thread mBinaryConfigThread;
+
     /*
      * Parse a given EVS configuration file and store the information
      * internally.
@@ -372,6 +381,9 @@ class ConfigManager final {
     /*
      * Read configuration data from the binary file
      *
+     * The file is only used if it was written from the XML configuration
+     * files as they are now, as far as their size and modification time tell.
+     *
      * @return bool
      *         True if it succeeds to read configuration data from a binary
      *         file.
@@ -382,10 +394,55 @@ class ConfigManager final {
      * Store configuration data to the file
      *
      * @return bool
-     *         True if it succeeds to serialize mCameraInfo to the file.
+     *         True if it succeeds to serialize configuration data to the file.
      */
     bool writeConfigDataToBinary();
 
+    /*
+     * Atomically replace the binary configuration file
+     *
+     * @param  data
+     *         Serialized configuration data.
+     *
+     * @return bool
+     *         True if the file is written successfully.
+     */
+    bool writeBinaryFile(const std::string& data) const;
+
+    /*
+     * Parse the XML configuration files and rewrite the binary configuration
+     * file if it does not match them anymore.
+     */
+    void refreshBinaryConfigData();
+
+    /*
+     * Describe the XML configuration files the binary configuration is
+     * derived from, to tell whether they have changed since.
+     */
+    static std::string describeConfigSources();
+
+    /*
+     * Serialize configuration data; mConfigLock must be held.
+     *
+     * @param  out
+     *         A buffer the serialized data is appended to.
+     */
+    void serializeConfigData(std::string& out) const;
+    static void serializeCameraInfo(const CameraInfo& info, BinaryWriter& writer);
+
+    /*
+     * Replace configuration data with serialized data and mark it ready.
+     *
+     * @param  reader
+     *         A reader positioned after the file header.
+     *
+     * @return bool
+     *         False if the data is malformed, in which case nothing is
+     *         replaced.
+     */
+    bool deserializeConfigData(BinaryReader& reader);
+    static bool deserializeCameraInfo(BinaryReader& reader, CameraInfo& info);
+
     /*
      * debugging method to print out all XML elements and their attributes in
      * logcat message.
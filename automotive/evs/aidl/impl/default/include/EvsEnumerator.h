@@ -68,7 +68,8 @@ class EvsEnumerator final : public ::aidl::android::hardware::automotive::evs::B
                   ::aidl::android::frameworks::automotive::display::ICarDisplayProxy>&
                           proxyService);
 
-    void notifyDeviceStatusChange(const std::string_view& deviceName, evs::DeviceStatusType type);
+    static void notifyDeviceStatusChange(const std::string_view& deviceName,
+                                         evs::DeviceStatusType type);
 
   private:
     struct CameraRecord {
@@ -107,10 +108,17 @@ class EvsEnumerator final : public ::aidl::android::hardware::automotive::evs::B
                                            evs::DisplayState* state);
 
     static bool qualifyCaptureDevice(const char* deviceName);
+    // Must be called with sLock held.
     static CameraRecord* findCameraById(const std::string& cameraId);
     static void enumerateCameras();
+    // V4L2 capture devices in the configuration are listed while their device nodes exist and
+    // qualify. These add or remove one such device, and return true if the list changed.
     static bool addCaptureDevice(const std::string& deviceName);
     static bool removeCaptureDevice(const std::string& deviceName);
+    // Brings the list in line with the device nodes present.
+    static void syncCaptureDevices();
+    // Watches /dev for capture devices coming and going. Runs on its own thread.
+    static void watchCaptureDevices();
     // Enumerate available displays and return an id of the internal display
     static uint64_t enumerateDisplays();
 
@@ -123,6 +131,9 @@ class EvsEnumerator final : public ::aidl::android::hardware::automotive::evs::B
     //        never accessed concurrently despite potentially having multiple instance objects
     //        using them.
     static std::unordered_map<std::string, CameraRecord> sCameraList;
+    // Descriptors of the V4L2 capture devices in the configuration, with their metadata, so
+    // that a device plugged in again is listed without looking up its configuration.
+    static std::unordered_map<std::string, evs::CameraDesc> sCaptureDeviceDescs;
     // Object destructs if client dies.
     static std::mutex sLock;                               // Mutex on shared camera device list.
     static std::condition_variable sCameraSignal;          // Signal on camera device addition.
@@ -131,8 +142,9 @@ class EvsEnumerator final : public ::aidl::android::hardware::automotive::evs::B
             sDisplayProxy;
     static std::unordered_map<uint8_t, uint64_t> sDisplayPortList;
 
+    static std::shared_ptr<evs::IEvsEnumeratorStatusCallback> sCallback;
+
     uint64_t mInternalDisplayId;
-    std::shared_ptr<evs::IEvsEnumeratorStatusCallback> mCallback;
 };
 
 }  // namespace aidl::android::hardware::automotive::evs::implementation
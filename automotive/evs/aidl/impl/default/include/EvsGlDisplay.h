@@ -75,6 +75,10 @@ class EvsGlDisplay final : public BnEvsDisplay {
     // semaphores.
     bool mBufferBusy = false;
 
+    // Signaled when the GPU is done reading the buffer after it's been rendered, so it
+    // can be handed out again before that.
+    ::android::base::unique_fd mBufferReleaseFence GUARDED_BY(mLock);
+
     // Variables to synchronize a rendering thread w/ main and binder threads
     std::thread mRenderThread;
     RenderThreadStates mState GUARDED_BY(mLock) = STOPPED;
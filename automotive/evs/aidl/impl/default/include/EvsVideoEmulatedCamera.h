@@ -103,6 +103,8 @@ class EvsVideoEmulatedCamera : public EvsCamera {
 
     void onCodecOutputAvailable(const int32_t index, const AMediaCodecBufferInfo& info);
 
+    void updateCodecOutputLayout();
+
     ::android::status_t allocateOneFrame(buffer_handle_t* handle) override;
 
     bool startVideoStreamImpl_locked(const std::shared_ptr<evs::IEvsCameraStream>& receiver,
@@ -148,6 +150,12 @@ class EvsVideoEmulatedCamera : public EvsCamera {
     // Bytes per line in the buffers
     uint32_t mStride = 0;
 
+    // Layout of the decoded frames: bytes per line, lines per plane, and whether the chroma
+    // samples are interleaved
+    int32_t mCodecStride = 0;
+    int32_t mCodecSliceHeight = 0;
+    bool mCodecSemiPlanar = false;
+
     // Camera parameters.
     std::unordered_map<CameraParam, std::shared_ptr<CameraParameterDesc>> mParams;
 
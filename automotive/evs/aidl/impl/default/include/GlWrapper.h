@@ -25,6 +25,7 @@
 #include <aidl/android/frameworks/automotive/display/ICarDisplayProxy.h>
 #include <aidl/android/hardware/automotive/evs/BufferDesc.h>
 #include <android-base/logging.h>
+#include <android-base/unique_fd.h>
 #include <cutils/native_handle.h>
 
 namespace aidl::android::hardware::automotive::evs::implementation {
@@ -41,7 +42,9 @@ class GlWrapper {
             buffer_handle_t handle,
             const ::aidl::android::hardware::graphics::common::HardwareBufferDescription&
                     description);
-    void renderImageToScreen();
+    // Returns a fence signaled when the GPU is done reading the image texture, or an invalid fd if
+    // it's already done.
+    ::android::base::unique_fd renderImageToScreen();
 
     void showWindow(const std::shared_ptr<automotivedisplay::ICarDisplayProxy>& svc,
                     uint64_t displayId);
@@ -61,6 +64,9 @@ class GlWrapper {
 
     EGLImageKHR mKHRimage = EGL_NO_IMAGE_KHR;
 
+    // Whether EGL_ANDROID_native_fence_sync is supported
+    bool mHasNativeFenceSync = false;
+
     GLuint mTextureMap = 0;
     GLuint mShaderProgram = 0;
 
@@ -16,11 +16,19 @@
 
 #include "ConfigManager.h"
 
+#include <android-base/file.h>
 #include <android-base/parseint.h>
+#include <android-base/unique_fd.h>
 #include <hardware/gralloc.h>
 #include <utils/SystemClock.h>
 
-#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
 #include <sstream>
 #include <string_view>
 #include <thread>
@@ -33,12 +41,176 @@ using ::tinyxml2::XMLAttribute;
 using ::tinyxml2::XMLDocument;
 using ::tinyxml2::XMLElement;
 
+/* "EVSC"; the version must be bumped whenever the binary layout changes */
+constexpr uint32_t kBinaryConfigMagic = 0x43535645;
+constexpr uint32_t kBinaryConfigVersion = 1;
+
+template <typename T>
+bool isPresent(const std::unique_ptr<T>& info) {
+    return info != nullptr;
+}
+
+bool isPresent(const std::unordered_set<std::string>&) {
+    return true;
+}
+
+/* getCameraInfo() and getCameraGroupInfo() insert empty entries for unknown identifiers */
+template <typename Map>
+std::vector<std::string> sortedKeys(const Map& map) {
+    std::vector<std::string> keys;
+    for (const auto& [key, value] : map) {
+        if (isPresent(value)) {
+            keys.push_back(key);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
 }  // namespace
 
+/*
+ * Appends plain values to a byte buffer, in the native byte order; the
+ * binary configuration is only ever read back by the device that wrote it.
+ */
+class ConfigManager::BinaryWriter final {
+  public:
+    explicit BinaryWriter(std::string& out) : mOut(out) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(const void* data, size_t size) {
+        mOut.append(static_cast<const char*>(data), size);
+    }
+
+    void writeString(std::string_view str) {
+        write(static_cast<uint32_t>(str.size()));
+        writeBytes(str.data(), str.size());
+    }
+
+    void writeStrings(const std::unordered_set<std::string>& strs) {
+        std::vector<std::string> sorted(strs.begin(), strs.end());
+        std::sort(sorted.begin(), sorted.end());
+        write(static_cast<uint32_t>(sorted.size()));
+        for (const auto& str : sorted) {
+            writeString(str);
+        }
+    }
+
+    void writeStreamConfigurations(const std::unordered_map<int32_t, StreamConfiguration>& cfgs) {
+        std::vector<int32_t> ids;
+        for (const auto& [id, cfg] : cfgs) {
+            ids.push_back(id);
+        }
+        std::sort(ids.begin(), ids.end());
+        write(static_cast<uint32_t>(ids.size()));
+        for (const auto id : ids) {
+            write(id);
+            write(cfgs.at(id));
+        }
+    }
+
+    /* pads the buffer, which starts at the beginning of the file */
+    void align(size_t alignment) {
+        mOut.resize((mOut.size() + alignment - 1) / alignment * alignment);
+    }
+
+  private:
+    std::string& mOut;
+};
+
+/* Reads the values BinaryWriter wrote, failing on truncated data. */
+class ConfigManager::BinaryReader final {
+  public:
+    BinaryReader(const uint8_t* data, size_t size) : mBegin(data), mPos(data), mEnd(data + size) {}
+
+    template <typename T>
+    bool read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t* data = readBytes(sizeof(T));
+        if (data == nullptr) {
+            return false;
+        }
+        memcpy(&value, data, sizeof(T));
+        return true;
+    }
+
+    const uint8_t* readBytes(size_t size) {
+        if (size > static_cast<size_t>(mEnd - mPos)) {
+            return nullptr;
+        }
+        const uint8_t* data = mPos;
+        mPos += size;
+        return data;
+    }
+
+    bool readString(std::string& str) {
+        uint32_t size = 0;
+        if (!read(size)) {
+            return false;
+        }
+        const uint8_t* data = readBytes(size);
+        if (data == nullptr) {
+            return false;
+        }
+        str.assign(reinterpret_cast<const char*>(data), size);
+        return true;
+    }
+
+    bool readStrings(std::unordered_set<std::string>& strs) {
+        uint32_t count = 0;
+        if (!read(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            std::string str;
+            if (!readString(str)) {
+                return false;
+            }
+            strs.insert(std::move(str));
+        }
+        return true;
+    }
+
+    bool readStreamConfigurations(std::unordered_map<int32_t, StreamConfiguration>& cfgs) {
+        uint32_t count = 0;
+        if (!read(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            int32_t id;
+            StreamConfiguration cfg;
+            if (!read(id) || !read(cfg)) {
+                return false;
+            }
+            cfgs.insert_or_assign(id, cfg);
+        }
+        return true;
+    }
+
+    void align(size_t alignment) {
+        const size_t offset = mPos - mBegin;
+        const size_t padding = (alignment - offset % alignment) % alignment;
+        mPos += std::min(padding, static_cast<size_t>(mEnd - mPos));
+    }
+
+    bool atEnd() const { return mPos == mEnd; }
+
+  private:
+    const uint8_t* const mBegin;
+    const uint8_t* mPos;
+    const uint8_t* const mEnd;
+};
+
 std::string_view ConfigManager::sConfigDefaultPath =
         "/vendor/etc/automotive/evs/evs_mock_hal_configuration.xml";
 std::string_view ConfigManager::sConfigOverridePath =
         "/vendor/etc/automotive/evs/evs_configuration_override.xml";
+std::string_view ConfigManager::sConfigBinaryPath = "/data/vendor/evs/evs_configuration.bin";
 
 ConfigManager::CameraInfo::DeviceType ConfigManager::CameraInfo::deviceTypeFromSV(
         const std::string_view sv) {
@@ -526,434 +698,309 @@ bool ConfigManager::readConfigDataFromXML() noexcept {
 }
 
 bool ConfigManager::readConfigDataFromBinary() {
-    /* Temporary buffer to hold configuration data read from a binary file */
-    char mBuffer[1024];
-
-    std::fstream srcFile;
     const int64_t readStart = android::elapsedRealtimeNano();
 
-    srcFile.open(mBinaryFilePath, std::fstream::in | std::fstream::binary);
-    if (!srcFile) {
-        LOG(ERROR) << "Failed to open a source binary file, " << mBinaryFilePath;
+    android::base::unique_fd fd(open(mBinaryFilePath, O_RDONLY | O_CLOEXEC));
+    if (!fd.ok()) {
+        PLOG(INFO) << "No binary configuration at " << mBinaryFilePath;
         return false;
     }
 
-    std::unique_lock<std::mutex> lock(mConfigLock);
-    mIsReady = false;
-
-    /* read configuration data into the internal buffer */
-    srcFile.read(mBuffer, sizeof(mBuffer));
-    LOG(VERBOSE) << __FUNCTION__ << ": " << srcFile.gcount() << " bytes are read.";
-    char* p = mBuffer;
-    size_t sz = 0;
-
-    /* read number of camera group information entries */
-    const size_t ngrps = *(reinterpret_cast<size_t*>(p));
-    p += sizeof(size_t);
-
-    /* read each camera information entry */
-    for (size_t cidx = 0; cidx < ngrps; ++cidx) {
-        /* read camera identifier */
-        std::string cameraId = *(reinterpret_cast<std::string*>(p));
-        p += sizeof(std::string);
-
-        /* size of camera_metadata_t */
-        const size_t num_entry = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        const size_t num_data = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-
-        /* create CameraInfo and add it to hash map */
-        std::unique_ptr<ConfigManager::CameraGroupInfo> aCamera;
-        if (aCamera == nullptr || !aCamera->allocate(num_entry, num_data)) {
-            LOG(ERROR) << "Failed to create new CameraInfo object";
-            mCameraInfo.clear();
-            return false;
-        }
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0 || st.st_size <= 0) {
+        LOG(WARNING) << "Binary configuration " << mBinaryFilePath << " is empty";
+        return false;
+    }
+    const size_t size = st.st_size;
+    void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (data == MAP_FAILED) {
+        PLOG(ERROR) << "Failed to map " << mBinaryFilePath;
+        return false;
+    }
 
-        /* controls */
-        typedef struct {
-            CameraParam cid;
-            int32_t min;
-            int32_t max;
-            int32_t step;
-        } CameraCtrl;
-        sz = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        CameraCtrl* ptr = reinterpret_cast<CameraCtrl*>(p);
-        for (size_t idx = 0; idx < sz; ++idx) {
-            CameraCtrl temp = *ptr++;
-            aCamera->controls.insert_or_assign(
-                    temp.cid, std::move(std::make_tuple(temp.min, temp.max, temp.step)));
-        }
-        p = reinterpret_cast<char*>(ptr);
-
-        /* stream configurations */
-        sz = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        int32_t* i32_ptr = reinterpret_cast<int32_t*>(p);
-        for (size_t idx = 0; idx < sz; ++idx) {
-            const int32_t id = *i32_ptr++;
-
-            StreamConfiguration temp;
-            memcpy(&temp, i32_ptr, sizeof(StreamConfiguration));
-            i32_ptr += sizeof(StreamConfiguration);
-            aCamera->streamConfigurations.insert_or_assign(id, temp);
-        }
-        p = reinterpret_cast<char*>(i32_ptr);
-
-        /* synchronization */
-        aCamera->synchronized = *(reinterpret_cast<int32_t*>(p));
-        p += sizeof(int32_t);
-
-        for (size_t idx = 0; idx < num_entry; ++idx) {
-            /* Read camera metadata entries */
-            camera_metadata_tag_t tag = *reinterpret_cast<camera_metadata_tag_t*>(p);
-            p += sizeof(camera_metadata_tag_t);
-            const size_t count = *reinterpret_cast<size_t*>(p);
-            p += sizeof(size_t);
-
-            const int32_t type = get_camera_metadata_tag_type(tag);
-            switch (type) {
-                case TYPE_BYTE: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(uint8_t);
-                    break;
-                }
-                case TYPE_INT32: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(int32_t);
-                    break;
-                }
-                case TYPE_FLOAT: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(float);
-                    break;
-                }
-                case TYPE_INT64: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(int64_t);
-                    break;
-                }
-                case TYPE_DOUBLE: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(double);
-                    break;
-                }
-                case TYPE_RATIONAL:
-                    p += count * sizeof(camera_metadata_rational_t);
-                    break;
-                default:
-                    LOG(WARNING) << "Type " << type << " is unknown; "
-                                 << "data may be corrupted.";
-                    break;
-            }
+    BinaryReader reader(static_cast<const uint8_t*>(data), size);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    std::string sources;
+    const bool valid = reader.read(magic) && magic == kBinaryConfigMagic &&
+                       reader.read(version) && version == kBinaryConfigVersion &&
+                       reader.readString(sources) && sources == describeConfigSources() &&
+                       deserializeConfigData(reader);
+    munmap(data, size);
+    if (!valid) {
+        LOG(WARNING) << "Binary configuration " << mBinaryFilePath
+                     << " is stale or corrupted, ignored";
+        return false;
+    }
+
+    const int64_t readEnd = android::elapsedRealtimeNano();
+    LOG(INFO) << __FUNCTION__ << " takes " << std::scientific
+              << (double)(readEnd - readStart) / 1000000.0 << " ms.";
+
+    return true;
+}
+
+bool ConfigManager::writeConfigDataToBinary() {
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(mConfigLock);
+        serializeConfigData(data);
+    }
+    return writeBinaryFile(data);
+}
+
+bool ConfigManager::writeBinaryFile(const std::string& data) const {
+    const int64_t writeStart = android::elapsedRealtimeNano();
+
+    /* write a temporary file first, so a crash never leaves a truncated file behind */
+    const std::string tmpPath = std::string(mBinaryFilePath) + ".tmp";
+    android::base::unique_fd fd(
+            open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (!fd.ok()) {
+        PLOG(ERROR) << "Failed to open a destination binary file, " << tmpPath;
+        return false;
+    }
+    if (!android::base::WriteFully(fd.get(), data.data(), data.size()) || fsync(fd.get()) != 0) {
+        PLOG(ERROR) << "Failed to write " << tmpPath;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    fd.reset();
+    if (rename(tmpPath.c_str(), mBinaryFilePath) != 0) {
+        PLOG(ERROR) << "Failed to rename " << tmpPath << " to " << mBinaryFilePath;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    const int64_t writeEnd = android::elapsedRealtimeNano();
+    LOG(INFO) << __FUNCTION__ << " takes " << std::scientific
+              << (double)(writeEnd - writeStart) / 1000000.0 << " ms.";
+
+    return true;
+}
+
+void ConfigManager::refreshBinaryConfigData() {
+    std::unique_ptr<ConfigManager> parsed(new ConfigManager());
+    if (!parsed->readConfigDataFromXML()) {
+        return;
+    }
+
+    std::string parsedData;
+    {
+        std::lock_guard<std::mutex> lock(parsed->mConfigLock);
+        parsed->serializeConfigData(parsedData);
+    }
+    std::string currentData;
+    {
+        std::lock_guard<std::mutex> lock(mConfigLock);
+        serializeConfigData(currentData);
+    }
+    if (parsedData == currentData) {
+        LOG(DEBUG) << "Binary configuration is up to date";
+        return;
+    }
+
+    /* configuration in use is handed out by reference, so it cannot be replaced now */
+    LOG(WARNING) << "EVS configuration has changed; it will be used after the next restart";
+    writeBinaryFile(parsedData);
+}
+
+std::string ConfigManager::describeConfigSources() {
+    std::ostringstream out;
+    for (const auto& path : {sConfigOverridePath, sConfigDefaultPath}) {
+        struct stat st;
+        out << path << ":";
+        if (stat(path.data(), &st) == 0) {
+            out << st.st_size << ":" << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
         }
+        out << ";";
+    }
+    return out.str();
+}
+
+void ConfigManager::serializeConfigData(std::string& out) const {
+    BinaryWriter writer(out);
+    writer.write(kBinaryConfigMagic);
+    writer.write(kBinaryConfigVersion);
+    writer.writeString(describeConfigSources());
+
+    writer.write(mSystemInfo.numCameras);
+
+    /* hash maps are written in the order of their keys, so equal data is serialized equally */
+    const auto cameraIds = sortedKeys(mCameraInfo);
+    writer.write(static_cast<uint32_t>(cameraIds.size()));
+    for (const auto& id : cameraIds) {
+        writer.writeString(id);
+        serializeCameraInfo(*mCameraInfo.at(id), writer);
+    }
+
+    const auto groupIds = sortedKeys(mCameraGroups);
+    writer.write(static_cast<uint32_t>(groupIds.size()));
+    for (const auto& id : groupIds) {
+        const auto& group = *mCameraGroups.at(id);
+        writer.writeString(id);
+        serializeCameraInfo(group, writer);
+        writer.writeStrings(group.devices);
+        writer.write(group.synchronized);
+    }
+
+    const auto displayIds = sortedKeys(mDisplayInfo);
+    writer.write(static_cast<uint32_t>(displayIds.size()));
+    for (const auto& id : displayIds) {
+        writer.writeString(id);
+        writer.writeStreamConfigurations(mDisplayInfo.at(id)->streamConfigurations);
+    }
+
+    const auto positions = sortedKeys(mCameraPosition);
+    writer.write(static_cast<uint32_t>(positions.size()));
+    for (const auto& position : positions) {
+        writer.writeString(position);
+        writer.writeStrings(mCameraPosition.at(position));
+    }
+}
 
-        mCameraInfo.insert_or_assign(cameraId, std::move(aCamera));
+void ConfigManager::serializeCameraInfo(const CameraInfo& info, BinaryWriter& writer) {
+    writer.write(info.deviceType);
+
+    std::vector<std::pair<CameraParam, std::tuple<int32_t, int32_t, int32_t>>> controls(
+            info.controls.begin(), info.controls.end());
+    std::sort(controls.begin(), controls.end());
+    writer.write(static_cast<uint32_t>(controls.size()));
+    for (const auto& [id, range] : controls) {
+        writer.write(id);
+        writer.write(std::get<0>(range));
+        writer.write(std::get<1>(range));
+        writer.write(std::get<2>(range));
     }
 
-    /* read number of camera information entries */
-    const size_t ncams = *(reinterpret_cast<size_t*>(p));
-    p += sizeof(size_t);
+    writer.writeStreamConfigurations(info.streamConfigurations);
 
-    /* read each camera information entry */
-    for (size_t cidx = 0; cidx < ncams; ++cidx) {
-        /* read camera identifier */
-        std::string cameraId = *(reinterpret_cast<std::string*>(p));
-        p += sizeof(std::string);
+    /* camera_metadata_t is position independent, so it is stored as is */
+    const size_t metadataSize =
+            info.characteristics ? get_camera_metadata_size(info.characteristics) : 0;
+    writer.write(static_cast<uint32_t>(metadataSize));
+    if (metadataSize > 0) {
+        writer.align(alignof(std::max_align_t));
+        writer.writeBytes(info.characteristics, metadataSize);
+    }
+}
 
-        /* size of camera_metadata_t */
-        const size_t num_entry = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        const size_t num_data = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
+bool ConfigManager::deserializeConfigData(BinaryReader& reader) {
+    SystemInfo systemInfo;
+    std::unordered_map<std::string, std::unique_ptr<CameraInfo>> cameraInfo;
+    std::unordered_map<std::string, std::unique_ptr<CameraGroupInfo>> cameraGroups;
+    std::unordered_map<std::string, std::unique_ptr<DisplayInfo>> displayInfo;
+    std::unordered_map<std::string, std::unordered_set<std::string>> cameraPosition;
+
+    if (!reader.read(systemInfo.numCameras)) {
+        return false;
+    }
 
-        /* create CameraInfo and add it to hash map */
-        std::unique_ptr<ConfigManager::CameraInfo> aCamera;
-        if (aCamera == nullptr || !aCamera->allocate(num_entry, num_data)) {
-            LOG(ERROR) << "Failed to create new CameraInfo object";
-            mCameraInfo.clear();
+    uint32_t count = 0;
+    if (!reader.read(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string id;
+        auto info = std::make_unique<CameraInfo>();
+        if (!reader.readString(id) || !deserializeCameraInfo(reader, *info)) {
             return false;
         }
+        cameraInfo.insert_or_assign(id, std::move(info));
+    }
 
-        /* controls */
-        typedef struct {
-            CameraParam cid;
-            int32_t min;
-            int32_t max;
-            int32_t step;
-        } CameraCtrl;
-        sz = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        CameraCtrl* ptr = reinterpret_cast<CameraCtrl*>(p);
-        for (size_t idx = 0; idx < sz; ++idx) {
-            CameraCtrl temp = *ptr++;
-            aCamera->controls.insert_or_assign(
-                    temp.cid, std::move(std::make_tuple(temp.min, temp.max, temp.step)));
-        }
-        p = reinterpret_cast<char*>(ptr);
-
-        /* stream configurations */
-        sz = *(reinterpret_cast<size_t*>(p));
-        p += sizeof(size_t);
-        int32_t* i32_ptr = reinterpret_cast<int32_t*>(p);
-        for (size_t idx = 0; idx < sz; ++idx) {
-            const int32_t id = *i32_ptr++;
-
-            StreamConfiguration temp;
-            memcpy(&temp, i32_ptr, sizeof(StreamConfiguration));
-            i32_ptr += sizeof(StreamConfiguration);
-            aCamera->streamConfigurations.insert_or_assign(id, temp);
-        }
-        p = reinterpret_cast<char*>(i32_ptr);
-
-        for (size_t idx = 0; idx < num_entry; ++idx) {
-            /* Read camera metadata entries */
-            camera_metadata_tag_t tag = *reinterpret_cast<camera_metadata_tag_t*>(p);
-            p += sizeof(camera_metadata_tag_t);
-            const size_t count = *reinterpret_cast<size_t*>(p);
-            p += sizeof(size_t);
-
-            const int32_t type = get_camera_metadata_tag_type(tag);
-            switch (type) {
-                case TYPE_BYTE: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(uint8_t);
-                    break;
-                }
-                case TYPE_INT32: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(int32_t);
-                    break;
-                }
-                case TYPE_FLOAT: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(float);
-                    break;
-                }
-                case TYPE_INT64: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(int64_t);
-                    break;
-                }
-                case TYPE_DOUBLE: {
-                    add_camera_metadata_entry(aCamera->characteristics, tag, p, count);
-                    p += count * sizeof(double);
-                    break;
-                }
-                case TYPE_RATIONAL:
-                    p += count * sizeof(camera_metadata_rational_t);
-                    break;
-                default:
-                    LOG(WARNING) << "Type " << type << " is unknown; "
-                                 << "data may be corrupted.";
-                    break;
-            }
+    if (!reader.read(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string id;
+        auto group = std::make_unique<CameraGroupInfo>();
+        if (!reader.readString(id) || !deserializeCameraInfo(reader, *group) ||
+            !reader.readStrings(group->devices) || !reader.read(group->synchronized)) {
+            return false;
+        }
+        cameraGroups.insert_or_assign(id, std::move(group));
+    }
+
+    if (!reader.read(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string id;
+        auto dpy = std::make_unique<DisplayInfo>();
+        if (!reader.readString(id) || !reader.readStreamConfigurations(dpy->streamConfigurations)) {
+            return false;
+        }
+        displayInfo.insert_or_assign(id, std::move(dpy));
+    }
+
+    if (!reader.read(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string position;
+        if (!reader.readString(position) || !reader.readStrings(cameraPosition[position])) {
+            return false;
         }
+    }
 
-        mCameraInfo.insert_or_assign(cameraId, std::move(aCamera));
+    if (!reader.atEnd()) {
+        return false;
     }
 
+    std::unique_lock<std::mutex> lock(mConfigLock);
+    mSystemInfo = systemInfo;
+    mCameraInfo = std::move(cameraInfo);
+    mCameraGroups = std::move(cameraGroups);
+    mDisplayInfo = std::move(displayInfo);
+    mCameraPosition = std::move(cameraPosition);
+
+    /* configuration data is ready to be consumed */
     mIsReady = true;
 
     /* notify that configuration data is ready */
     lock.unlock();
     mConfigCond.notify_all();
 
-    int64_t readEnd = android::elapsedRealtimeNano();
-    LOG(INFO) << __FUNCTION__ << " takes " << std::scientific
-              << (double)(readEnd - readStart) / 1000000.0 << " ms.";
-
     return true;
 }
 
-bool ConfigManager::writeConfigDataToBinary() {
-    std::fstream outFile;
-
-    const int64_t writeStart = android::elapsedRealtimeNano();
-
-    outFile.open(mBinaryFilePath, std::fstream::out | std::fstream::binary);
-    if (!outFile) {
-        LOG(ERROR) << "Failed to open a destination binary file, " << mBinaryFilePath;
+bool ConfigManager::deserializeCameraInfo(BinaryReader& reader, CameraInfo& info) {
+    uint32_t count = 0;
+    if (!reader.read(info.deviceType) || !reader.read(count)) {
         return false;
     }
-
-    /* lock a configuration data while it's being written to the filesystem */
-    std::lock_guard<std::mutex> lock(mConfigLock);
-
-    /* write camera group information */
-    size_t sz = mCameraGroups.size();
-    outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-    for (auto&& [camId, camInfo] : mCameraGroups) {
-        LOG(INFO) << "Storing camera group " << camId;
-
-        /* write a camera identifier string */
-        outFile.write(reinterpret_cast<const char*>(&camId), sizeof(std::string));
-
-        /* controls */
-        sz = camInfo->controls.size();
-        outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-        for (auto&& [ctrl, range] : camInfo->controls) {
-            outFile.write(reinterpret_cast<const char*>(&ctrl), sizeof(CameraParam));
-            outFile.write(reinterpret_cast<const char*>(&std::get<0>(range)), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&std::get<1>(range)), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&std::get<2>(range)), sizeof(int32_t));
-        }
-
-        /* stream configurations */
-        sz = camInfo->streamConfigurations.size();
-        outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-        for (auto&& [sid, cfg] : camInfo->streamConfigurations) {
-            outFile.write(reinterpret_cast<const char*>(sid), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&cfg), sizeof(cfg));
-        }
-
-        /* synchronization */
-        outFile.write(reinterpret_cast<const char*>(&camInfo->synchronized), sizeof(int32_t));
-
-        /* size of camera_metadata_t */
-        size_t num_entry = 0;
-        size_t num_data = 0;
-        if (camInfo->characteristics != nullptr) {
-            num_entry = get_camera_metadata_entry_count(camInfo->characteristics);
-            num_data = get_camera_metadata_data_count(camInfo->characteristics);
-        }
-        outFile.write(reinterpret_cast<const char*>(&num_entry), sizeof(size_t));
-        outFile.write(reinterpret_cast<const char*>(&num_data), sizeof(size_t));
-
-        /* write each camera metadata entry */
-        if (num_entry > 0) {
-            camera_metadata_entry_t entry;
-            for (size_t idx = 0; idx < num_entry; ++idx) {
-                if (get_camera_metadata_entry(camInfo->characteristics, idx, &entry)) {
-                    LOG(ERROR) << "Failed to retrieve camera metadata entry " << idx;
-                    outFile.close();
-                    return false;
-                }
-
-                outFile.write(reinterpret_cast<const char*>(&entry.tag), sizeof(entry.tag));
-                outFile.write(reinterpret_cast<const char*>(&entry.count), sizeof(entry.count));
-
-                int32_t type = get_camera_metadata_tag_type(entry.tag);
-                switch (type) {
-                    case TYPE_BYTE:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.u8),
-                                      sizeof(uint8_t) * entry.count);
-                        break;
-                    case TYPE_INT32:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.i32),
-                                      sizeof(int32_t) * entry.count);
-                        break;
-                    case TYPE_FLOAT:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.f),
-                                      sizeof(float) * entry.count);
-                        break;
-                    case TYPE_INT64:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.i64),
-                                      sizeof(int64_t) * entry.count);
-                        break;
-                    case TYPE_DOUBLE:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.d),
-                                      sizeof(double) * entry.count);
-                        break;
-                    case TYPE_RATIONAL:
-                        [[fallthrough]];
-                    default:
-                        LOG(WARNING) << "Type " << type << " is not supported.";
-                        break;
-                }
-            }
+    for (uint32_t i = 0; i < count; ++i) {
+        CameraParam id;
+        int32_t min, max, step;
+        if (!reader.read(id) || !reader.read(min) || !reader.read(max) || !reader.read(step)) {
+            return false;
         }
+        info.controls.insert_or_assign(id, std::make_tuple(min, max, step));
     }
 
-    /* write camera device information */
-    sz = mCameraInfo.size();
-    outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-    for (auto&& [camId, camInfo] : mCameraInfo) {
-        LOG(INFO) << "Storing camera " << camId;
-
-        /* write a camera identifier string */
-        outFile.write(reinterpret_cast<const char*>(&camId), sizeof(std::string));
-
-        /* controls */
-        sz = camInfo->controls.size();
-        outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-        for (auto& [ctrl, range] : camInfo->controls) {
-            outFile.write(reinterpret_cast<const char*>(&ctrl), sizeof(CameraParam));
-            outFile.write(reinterpret_cast<const char*>(&std::get<0>(range)), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&std::get<1>(range)), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&std::get<2>(range)), sizeof(int32_t));
-        }
-
-        /* stream configurations */
-        sz = camInfo->streamConfigurations.size();
-        outFile.write(reinterpret_cast<const char*>(&sz), sizeof(size_t));
-        for (auto&& [sid, cfg] : camInfo->streamConfigurations) {
-            outFile.write(reinterpret_cast<const char*>(sid), sizeof(int32_t));
-            outFile.write(reinterpret_cast<const char*>(&cfg), sizeof(cfg));
-        }
-
-        /* size of camera_metadata_t */
-        size_t num_entry = 0;
-        size_t num_data = 0;
-        if (camInfo->characteristics != nullptr) {
-            num_entry = get_camera_metadata_entry_count(camInfo->characteristics);
-            num_data = get_camera_metadata_data_count(camInfo->characteristics);
-        }
-        outFile.write(reinterpret_cast<const char*>(&num_entry), sizeof(size_t));
-        outFile.write(reinterpret_cast<const char*>(&num_data), sizeof(size_t));
-
-        /* write each camera metadata entry */
-        if (num_entry > 0) {
-            camera_metadata_entry_t entry;
-            for (size_t idx = 0; idx < num_entry; ++idx) {
-                if (get_camera_metadata_entry(camInfo->characteristics, idx, &entry)) {
-                    LOG(ERROR) << "Failed to retrieve camera metadata entry " << idx;
-                    outFile.close();
-                    return false;
-                }
+    if (!reader.readStreamConfigurations(info.streamConfigurations)) {
+        return false;
+    }
 
-                outFile.write(reinterpret_cast<const char*>(&entry.tag), sizeof(entry.tag));
-                outFile.write(reinterpret_cast<const char*>(&entry.count), sizeof(entry.count));
-
-                int32_t type = get_camera_metadata_tag_type(entry.tag);
-                switch (type) {
-                    case TYPE_BYTE:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.u8),
-                                      sizeof(uint8_t) * entry.count);
-                        break;
-                    case TYPE_INT32:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.i32),
-                                      sizeof(int32_t) * entry.count);
-                        break;
-                    case TYPE_FLOAT:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.f),
-                                      sizeof(float) * entry.count);
-                        break;
-                    case TYPE_INT64:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.i64),
-                                      sizeof(int64_t) * entry.count);
-                        break;
-                    case TYPE_DOUBLE:
-                        outFile.write(reinterpret_cast<const char*>(entry.data.d),
-                                      sizeof(double) * entry.count);
-                        break;
-                    case TYPE_RATIONAL:
-                        [[fallthrough]];
-                    default:
-                        LOG(WARNING) << "Type " << type << " is not supported.";
-                        break;
-                }
-            }
+    uint32_t metadataSize = 0;
+    if (!reader.read(metadataSize)) {
+        return false;
+    }
+    if (metadataSize > 0) {
+        reader.align(alignof(std::max_align_t));
+        const uint8_t* metadata = reader.readBytes(metadataSize);
+        if (metadata == nullptr) {
+            return false;
+        }
+        /* this validates the structure before copying it out of the mapped file */
+        info.characteristics = allocate_copy_camera_metadata_checked(
+                reinterpret_cast<const camera_metadata_t*>(metadata), metadataSize);
+        if (info.characteristics == nullptr) {
+            return false;
         }
     }
 
-    outFile.close();
-    int64_t writeEnd = android::elapsedRealtimeNano();
-    LOG(INFO) << __FUNCTION__ << " takes " << std::scientific
-              << (double)(writeEnd - writeStart) / 1000000.0 << " ms.";
-
     return true;
 }
 
@@ -961,17 +1008,29 @@ std::unique_ptr<ConfigManager> ConfigManager::Create() {
     std::unique_ptr<ConfigManager> cfgMgr(new ConfigManager());
 
     /*
-     * Read a configuration from XML file
-     *
-     * If this is too slow, ConfigManager::readConfigDataFromBinary() and
-     * ConfigManager::writeConfigDataToBinary()can serialize CameraInfo object
-     * to the filesystem and construct CameraInfo instead; this was
-     * evaluated as 10x faster.
+     * Read a configuration from the binary file written on a previous start,
+     * which is an order of magnitude faster than parsing XML.  The XML file is
+     * still parsed in the background, to pick up changes the file metadata
+     * does not reveal; these are used after the next restart.
      */
+    if (cfgMgr->readConfigDataFromBinary()) {
+        cfgMgr->mBinaryConfigThread =
+                std::thread([mgr = cfgMgr.get()]() { mgr->refreshBinaryConfigData(); });
+        return cfgMgr;
+    }
+
     if (!cfgMgr->readConfigDataFromXML()) {
         return nullptr;
-    } else {
-        return cfgMgr;
+    }
+
+    cfgMgr->mBinaryConfigThread =
+            std::thread([mgr = cfgMgr.get()]() { mgr->writeConfigDataToBinary(); });
+    return cfgMgr;
+}
+
+ConfigManager::~ConfigManager() {
+    if (mBinaryConfigThread.joinable()) {
+        mBinaryConfigThread.join();
     }
 }
 
@@ -24,7 +24,14 @@
 #include <aidl/android/hardware/automotive/evs/EvsResult.h>
 #include <aidl/android/hardware/graphics/common/BufferUsage.h>
 #include <aidl/android/hardware/graphics/common/PixelFormat.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/android_filesystem_config.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include <set>
 #include <string_view>
@@ -39,6 +46,8 @@ using std::chrono_literals::operator""s;
 // Constants
 constexpr std::chrono::seconds kEnumerationTimeout = 10s;
 constexpr uint64_t kInvalidDisplayId = std::numeric_limits<uint64_t>::max();
+constexpr std::string_view kDeviceDir = "/dev/";
+constexpr std::string_view kCaptureDevicePrefix = "video";
 const std::set<uid_t> kAllowedUids = {AID_AUTOMOTIVE_EVS, AID_SYSTEM, AID_ROOT};
 
 }  // namespace
@@ -49,6 +58,8 @@ namespace aidl::android::hardware::automotive::evs::implementation {
 //        That is to say, this is effectively a singleton despite the fact that HIDL
 //        constructs a new instance for each client.
 std::unordered_map<std::string, EvsEnumerator::CameraRecord> EvsEnumerator::sCameraList;
+std::unordered_map<std::string, CameraDesc> EvsEnumerator::sCaptureDeviceDescs;
+std::shared_ptr<IEvsEnumeratorStatusCallback> EvsEnumerator::sCallback;
 std::mutex EvsEnumerator::sLock;
 std::condition_variable EvsEnumerator::sCameraSignal;
 std::unique_ptr<ConfigManager> EvsEnumerator::sConfigManager;
@@ -94,15 +105,150 @@ void EvsEnumerator::enumerateCameras() {
         return;
     }
 
-    for (auto id : sConfigManager->getCameraIdList()) {
-        CameraRecord rec(id.data());
-        std::unique_ptr<ConfigManager::CameraInfo>& pInfo = sConfigManager->getCameraInfo(id);
-        if (pInfo) {
-            uint8_t* ptr = reinterpret_cast<uint8_t*>(pInfo->characteristics);
-            const size_t len = get_camera_metadata_size(pInfo->characteristics);
-            rec.desc.metadata.insert(rec.desc.metadata.end(), ptr, ptr + len);
+    {
+        std::lock_guard lock(sLock);
+        for (auto id : sConfigManager->getCameraIdList()) {
+            if (sCameraList.find(id) != sCameraList.end() ||
+                sCaptureDeviceDescs.find(id) != sCaptureDeviceDescs.end()) {
+                // Enumerated by a previous instance.
+                continue;
+            }
+            CameraRecord rec(id.data());
+            std::unique_ptr<ConfigManager::CameraInfo>& pInfo = sConfigManager->getCameraInfo(id);
+            if (pInfo) {
+                uint8_t* ptr = reinterpret_cast<uint8_t*>(pInfo->characteristics);
+                const size_t len = get_camera_metadata_size(pInfo->characteristics);
+                rec.desc.metadata.insert(rec.desc.metadata.end(), ptr, ptr + len);
+            }
+            if (pInfo && pInfo->deviceType == ConfigManager::CameraInfo::DeviceType::V4L2) {
+                sCaptureDeviceDescs.insert_or_assign(id, std::move(rec.desc));
+            } else {
+                sCameraList.insert_or_assign(id, std::move(rec));
+            }
+        }
+    }
+
+    static std::once_flag sWatchOnce;
+    std::call_once(sWatchOnce, [] {
+        if (!sCaptureDeviceDescs.empty()) {
+            std::thread(watchCaptureDevices).detach();
+        }
+    });
+}
+
+bool EvsEnumerator::qualifyCaptureDevice(const char* deviceName) {
+    ::android::base::unique_fd fd(
+            TEMP_FAILURE_RETRY(open(deviceName, O_RDWR | O_NONBLOCK | O_CLOEXEC)));
+    if (fd.get() < 0) {
+        return false;
+    }
+    v4l2_capability caps;
+    if (ioctl(fd.get(), VIDIOC_QUERYCAP, &caps) < 0) {
+        LOG(WARNING) << "Failed to query the capabilities of " << deviceName;
+        return false;
+    }
+    const uint32_t deviceCaps =
+            (caps.capabilities & V4L2_CAP_DEVICE_CAPS) ? caps.device_caps : caps.capabilities;
+    return (deviceCaps & V4L2_CAP_VIDEO_CAPTURE) && (deviceCaps & V4L2_CAP_STREAMING);
+}
+
+bool EvsEnumerator::addCaptureDevice(const std::string& deviceName) {
+    {
+        std::lock_guard lock(sLock);
+        if (sCaptureDeviceDescs.find(deviceName) == sCaptureDeviceDescs.end() ||
+            sCameraList.find(deviceName) != sCameraList.end()) {
+            return false;
+        }
+    }
+    if (!qualifyCaptureDevice(deviceName.data())) {
+        return false;
+    }
+    {
+        std::lock_guard lock(sLock);
+        auto desc = sCaptureDeviceDescs.find(deviceName);
+        if (desc == sCaptureDeviceDescs.end() ||
+            sCameraList.find(deviceName) != sCameraList.end()) {
+            return false;
+        }
+        CameraRecord rec(deviceName.data());
+        rec.desc = desc->second;
+        sCameraList.insert_or_assign(deviceName, std::move(rec));
+    }
+    LOG(INFO) << deviceName << " is added";
+    sCameraSignal.notify_all();
+    notifyDeviceStatusChange(deviceName, DeviceStatusType::CAMERA_AVAILABLE);
+    return true;
+}
+
+bool EvsEnumerator::removeCaptureDevice(const std::string& deviceName) {
+    std::shared_ptr<EvsCameraBase> pActiveCamera;
+    {
+        std::lock_guard lock(sLock);
+        auto found = sCameraList.find(deviceName);
+        if (sCaptureDeviceDescs.find(deviceName) == sCaptureDeviceDescs.end() ||
+            found == sCameraList.end()) {
+            return false;
+        }
+        pActiveCamera = found->second.activeInstance.lock();
+        sCameraList.erase(found);
+    }
+    LOG(INFO) << deviceName << " is removed";
+    if (pActiveCamera) {
+        pActiveCamera->shutdown();
+    }
+    notifyDeviceStatusChange(deviceName, DeviceStatusType::CAMERA_NOT_AVAILABLE);
+    return true;
+}
+
+void EvsEnumerator::syncCaptureDevices() {
+    std::vector<std::string> deviceNames;
+    {
+        std::lock_guard lock(sLock);
+        for (const auto& [deviceName, desc] : sCaptureDeviceDescs) {
+            deviceNames.push_back(deviceName);
+        }
+    }
+    for (const auto& deviceName : deviceNames) {
+        if (access(deviceName.data(), F_OK) == 0) {
+            addCaptureDevice(deviceName);
+        } else {
+            removeCaptureDevice(deviceName);
+        }
+    }
+}
+
+void EvsEnumerator::watchCaptureDevices() {
+    ::android::base::unique_fd fd(inotify_init1(IN_CLOEXEC));
+    if (fd.get() < 0 ||
+        inotify_add_watch(fd.get(), kDeviceDir.data(), IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+        PLOG(ERROR) << "Failed to watch " << kDeviceDir << ", camera hotplug is disabled";
+        return;
+    }
+    // Catch up with the devices that came or went before the watch was in place.
+    syncCaptureDevices();
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        const ssize_t length = TEMP_FAILURE_RETRY(read(fd.get(), buffer, sizeof(buffer)));
+        if (length <= 0) {
+            PLOG(ERROR) << "Failed to read inotify events, camera hotplug is disabled";
+            return;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0 ||
+                !::android::base::StartsWith(event->name, kCaptureDevicePrefix)) {
+                continue;
+            }
+            const std::string deviceName = std::string(kDeviceDir) + event->name;
+            if (event->mask & IN_DELETE) {
+                removeCaptureDevice(deviceName);
+            } else {
+                // The device node may only be accessible once its attributes are set.
+                addCaptureDevice(deviceName);
+            }
         }
-        sCameraList.insert_or_assign(id, std::move(rec));
     }
 }
 
@@ -156,6 +302,9 @@ ScopedAStatus EvsEnumerator::getCameraList(std::vector<CameraDesc>* _aidl_return
         }
     }
 
+    // Capture devices may come and go while the list is being built.
+    std::lock_guard lock(sLock);
+
     // Build up a packed array of CameraDesc for return
     _aidl_return->resize(sCameraList.size());
     unsigned i = 0;
@@ -237,14 +386,19 @@ ScopedAStatus EvsEnumerator::openCamera(const std::string& id, const Stream& cfg
     }
 
     // Is this a recognized camera id?
-    CameraRecord* pRecord = findCameraById(id);
-    if (!pRecord) {
-        LOG(ERROR) << id << " does not exist!";
-        return ScopedAStatus::fromServiceSpecificError(static_cast<int>(EvsResult::INVALID_ARG));
-    }
+    std::shared_ptr<EvsCameraBase> pActiveCamera;
+    {
+        std::lock_guard lock(sLock);
+        CameraRecord* pRecord = findCameraById(id);
+        if (!pRecord) {
+            LOG(ERROR) << id << " does not exist!";
+            return ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int>(EvsResult::INVALID_ARG));
+        }
 
-    // Has this camera already been instantiated by another caller?
-    std::shared_ptr<EvsCameraBase> pActiveCamera = pRecord->activeInstance.lock();
+        // Has this camera already been instantiated by another caller?
+        pActiveCamera = pRecord->activeInstance.lock();
+    }
     if (pActiveCamera) {
         LOG(WARNING) << "Killing previous camera because of new caller";
         closeCamera(pActiveCamera);
@@ -276,13 +430,25 @@ ScopedAStatus EvsEnumerator::openCamera(const std::string& id, const Stream& cfg
         }
     }
 
-    pRecord->activeInstance = pActiveCamera;
     if (!pActiveCamera) {
         LOG(ERROR) << "Failed to create new EVS camera object for " << id;
         return ScopedAStatus::fromServiceSpecificError(
                 static_cast<int>(EvsResult::UNDERLYING_SERVICE_ERROR));
     }
 
+    {
+        std::lock_guard lock(sLock);
+        CameraRecord* pRecord = findCameraById(id);
+        if (!pRecord) {
+            // The device has been unplugged in the meantime.
+            LOG(ERROR) << id << " has been removed";
+            pActiveCamera->shutdown();
+            return ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int>(EvsResult::RESOURCE_NOT_AVAILABLE));
+        }
+        pRecord->activeInstance = pActiveCamera;
+    }
+
     *obj = pActiveCamera;
     return ScopedAStatus::ok();
 }
@@ -434,13 +600,17 @@ ScopedAStatus EvsEnumerator::isHardware(bool* flag) {
 
 void EvsEnumerator::notifyDeviceStatusChange(const std::string_view& deviceName,
                                              DeviceStatusType type) {
-    std::lock_guard lock(sLock);
-    if (!mCallback) {
+    std::shared_ptr<IEvsEnumeratorStatusCallback> callback;
+    {
+        std::lock_guard lock(sLock);
+        callback = sCallback;
+    }
+    if (!callback) {
         return;
     }
 
     std::vector<DeviceStatus> status{{.id = std::string(deviceName), .status = type}};
-    if (!mCallback->deviceStatusChanged(status).isOk()) {
+    if (!callback->deviceStatusChanged(status).isOk()) {
         LOG(WARNING) << "Failed to notify a device status change, name = " << deviceName
                      << ", type = " << static_cast<int>(type);
     }
@@ -449,23 +619,31 @@ void EvsEnumerator::notifyDeviceStatusChange(const std::string_view& deviceName,
 ScopedAStatus EvsEnumerator::registerStatusCallback(
         const std::shared_ptr<IEvsEnumeratorStatusCallback>& callback) {
     std::lock_guard lock(sLock);
-    if (mCallback) {
+    if (sCallback) {
         LOG(INFO) << "Replacing an existing device status callback";
     }
-    mCallback = callback;
+    sCallback = callback;
     return ScopedAStatus::ok();
 }
 
 void EvsEnumerator::closeCamera_impl(const std::shared_ptr<IEvsCamera>& pCamera,
                                      const std::string& cameraId) {
     // Find the named camera
-    CameraRecord* pRecord = findCameraById(cameraId);
+    std::shared_ptr<EvsCameraBase> pActiveCamera;
+    bool found = false;
+    {
+        std::lock_guard lock(sLock);
+        CameraRecord* pRecord = findCameraById(cameraId);
+        if (pRecord) {
+            found = true;
+            pActiveCamera = pRecord->activeInstance.lock();
+        }
+    }
 
     // Is the display being destroyed actually the one we think is active?
-    if (!pRecord) {
+    if (!found) {
         LOG(ERROR) << "Asked to close a camera whose name isn't recognized";
     } else {
-        std::shared_ptr<EvsCameraBase> pActiveCamera = pRecord->activeInstance.lock();
         if (!pActiveCamera) {
             LOG(WARNING) << "Somehow a camera is being destroyed "
                          << "when the enumerator didn't know one existed";
@@ -21,6 +21,7 @@
 #include <aidl/android/hardware/graphics/common/PixelFormat.h>
 #include <aidlcommonsupport/NativeHandle.h>
 #include <android-base/thread_annotations.h>
+#include <android/sync.h>
 #include <linux/time.h>
 #include <ui/DisplayMode.h>
 #include <ui/DisplayState.h>
@@ -39,6 +40,7 @@ using ::android::base::ScopedLockAssertion;
 using ::ndk::ScopedAStatus;
 
 constexpr auto kTimeout = std::chrono::seconds(1);
+constexpr int kFenceTimeoutMs = std::chrono::milliseconds(kTimeout).count();
 
 bool debugFirstFrameDisplayed = false;
 
@@ -202,16 +204,18 @@ void EvsGlDisplay::renderFrames() {
         }
 
         // Put the image on the screen
-        mGlWrapper.renderImageToScreen();
+        ::android::base::unique_fd releaseFence = mGlWrapper.renderImageToScreen();
         if (!debugFirstFrameDisplayed) {
             LOG(DEBUG) << "EvsFirstFrameDisplayTiming start time: " << ::android::elapsedRealtime()
                        << " ms.";
             debugFirstFrameDisplayed = true;
         }
 
-        // Mark current frame is consumed.
+        // Mark current frame is consumed. The GPU may still be reading it, which
+        // getTargetBuffer() waits for.
         {
             std::lock_guard lock(mLock);
+            mBufferReleaseFence = std::move(releaseFence);
             mBufferBusy = false;
         }
         mBufferDone.notify_all();
@@ -219,6 +223,16 @@ void EvsGlDisplay::renderFrames() {
 
     LOG(DEBUG) << "A rendering thread is stopped.";
 
+    // Let the GPU finish reading the buffer before dropping it
+    ::android::base::unique_fd releaseFence;
+    {
+        std::lock_guard lock(mLock);
+        releaseFence = std::move(mBufferReleaseFence);
+    }
+    if (releaseFence.ok()) {
+        sync_wait(releaseFence.get(), kFenceTimeoutMs);
+    }
+
     // Drop the graphics buffer we've been using
     ::android::GraphicBufferAllocator& alloc(::android::GraphicBufferAllocator::get());
     alloc.free(mBuffer.handle);
@@ -346,6 +360,16 @@ ScopedAStatus EvsGlDisplay::getTargetBuffer(BufferDesc* _aidl_return) {
     // Mark our buffer as busy
     mBufferBusy = true;
 
+    // Wait for the GPU to be done with the previous frame before the client overwrites it
+    if (mBufferReleaseFence.ok()) {
+        ::android::base::unique_fd releaseFence = std::move(mBufferReleaseFence);
+        lock.unlock();
+        if (sync_wait(releaseFence.get(), kFenceTimeoutMs) != 0) {
+            PLOG(WARNING) << "Failed to wait for the previous frame to be rendered";
+        }
+        lock.lock();
+    }
+
     // Send the buffer to the client
     LOG(VERBOSE) << "Providing display buffer handle " << mBuffer.handle;
 
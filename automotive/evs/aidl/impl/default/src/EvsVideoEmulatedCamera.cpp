@@ -21,6 +21,9 @@
 #include <aidlcommonsupport/NativeHandle.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
+#include <libyuv/convert.h>
+#include <libyuv/convert_from.h>
+#include <libyuv/planar_functions.h>
 #include <media/stagefright/MediaCodecConstants.h>
 #include <ui/GraphicBufferAllocator.h>
 #include <utils/SystemClock.h>
@@ -41,6 +44,54 @@ namespace {
 struct FormatDeleter {
     void operator()(AMediaFormat* format) const { AMediaFormat_delete(format); }
 };
+
+// Copies a decoded frame, in a planar or semi-planar YUV 4:2:0 layout, into a locked buffer of
+// any YUV 4:2:0 layout gralloc may have picked. The copy is done by libyuv, which is vectorized.
+bool copyDecodedFrame(const uint8_t* src, int32_t srcStride, int32_t srcSliceHeight,
+                      bool srcSemiPlanar, const android_ycbcr& dst, int32_t width,
+                      int32_t height) {
+    const uint8_t* srcY = src;
+    const uint8_t* srcU = src + srcStride * srcSliceHeight;
+    auto dstY = static_cast<uint8_t*>(dst.y);
+    auto dstU = static_cast<uint8_t*>(dst.cb);
+    auto dstV = static_cast<uint8_t*>(dst.cr);
+    const int dstYStride = static_cast<int>(dst.ystride);
+    const int dstCStride = static_cast<int>(dst.cstride);
+
+    if (srcSemiPlanar) {
+        if (dst.chroma_step == 2 && dstV == dstU + 1) {
+            return libyuv::NV12Copy(srcY, srcStride, srcU, srcStride, dstY, dstYStride, dstU,
+                                    dstCStride, width, height) == 0;
+        }
+        if (dst.chroma_step == 2 && dstU == dstV + 1) {
+            // Swapping the chroma samples works both ways
+            return libyuv::NV21ToNV12(srcY, srcStride, srcU, srcStride, dstY, dstYStride, dstV,
+                                      dstCStride, width, height) == 0;
+        }
+        if (dst.chroma_step == 1) {
+            return libyuv::NV12ToI420(srcY, srcStride, srcU, srcStride, dstY, dstYStride, dstU,
+                                      dstCStride, dstV, dstCStride, width, height) == 0;
+        }
+        return false;
+    }
+
+    const int32_t srcCStride = srcStride / 2;
+    const uint8_t* srcV = srcU + srcCStride * (srcSliceHeight / 2);
+    if (dst.chroma_step == 2 && dstV == dstU + 1) {
+        return libyuv::I420ToNV12(srcY, srcStride, srcU, srcCStride, srcV, srcCStride, dstY,
+                                  dstYStride, dstU, dstCStride, width, height) == 0;
+    }
+    if (dst.chroma_step == 2 && dstU == dstV + 1) {
+        return libyuv::I420ToNV21(srcY, srcStride, srcU, srcCStride, srcV, srcCStride, dstY,
+                                  dstYStride, dstV, dstCStride, width, height) == 0;
+    }
+    if (dst.chroma_step == 1) {
+        return libyuv::I420Copy(srcY, srcStride, srcU, srcCStride, srcV, srcCStride, dstY,
+                                dstYStride, dstU, dstCStride, dstV, dstCStride, width,
+                                height) == 0;
+    }
+    return false;
+}
 }  // namespace
 
 EvsVideoEmulatedCamera::EvsVideoEmulatedCamera(Sigil, const char* deviceName,
@@ -133,9 +184,25 @@ bool EvsVideoEmulatedCamera::initialize() {
     format.reset(AMediaCodec_getOutputFormat(mVideoCodec.get()));
     AMediaFormat_getInt32(format.get(), AMEDIAFORMAT_KEY_WIDTH, &mWidth);
     AMediaFormat_getInt32(format.get(), AMEDIAFORMAT_KEY_HEIGHT, &mHeight);
+    updateCodecOutputLayout();
     return true;
 }
 
+void EvsVideoEmulatedCamera::updateCodecOutputLayout() {
+    std::unique_ptr<AMediaFormat, FormatDeleter> format(
+            AMediaCodec_getOutputFormat(mVideoCodec.get()));
+    if (!AMediaFormat_getInt32(format.get(), AMEDIAFORMAT_KEY_STRIDE, &mCodecStride)) {
+        mCodecStride = mWidth;
+    }
+    if (!AMediaFormat_getInt32(format.get(), AMEDIAFORMAT_KEY_SLICE_HEIGHT, &mCodecSliceHeight)) {
+        mCodecSliceHeight = mHeight;
+    }
+    int32_t colorFormat = COLOR_FormatYUV420Flexible;
+    AMediaFormat_getInt32(format.get(), AMEDIAFORMAT_KEY_COLOR_FORMAT, &colorFormat);
+    // Flexible output of the software decoders is planar
+    mCodecSemiPlanar = colorFormat == COLOR_FormatYUV420SemiPlanar;
+}
+
 void EvsVideoEmulatedCamera::generateFrames() {
     while (true) {
         {
@@ -220,30 +287,22 @@ void EvsVideoEmulatedCamera::onCodecOutputAvailable(const int32_t index,
                                  .count(),
     });
 
-    // Lock our output buffer for writing
-    uint8_t* pixels = nullptr;
+    // Lock our output buffer for writing, decoding its layout
+    android_ycbcr ycbcr = {};
     auto& mapper = ::android::GraphicBufferMapper::get();
-    mapper.lock(renderBufferHandle, GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_SW_READ_NEVER,
-                ::android::Rect(mWidth, mHeight), (void**)&pixels);
+    mapper.lockYCbCr(renderBufferHandle, GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_SW_READ_NEVER,
+                     ::android::Rect(mWidth, mHeight), &ycbcr);
 
     // If we failed to lock the pixel buffer, we're about to crash, but log it first
-    if (!pixels) {
+    if (!ycbcr.y) {
         LOG(ERROR) << __func__ << ": Camera failed to gain access to image buffer for writing";
         return;
     }
 
-    std::size_t ySize = mHeight * mStride;
-    std::size_t uvSize = ySize / 4;
-
-    std::memcpy(pixels, codecOutputBuffer, ySize);
-    pixels += ySize;
-
-    uint8_t* u_head = codecOutputBuffer + ySize;
-    uint8_t* v_head = u_head + uvSize;
-
-    for (size_t i = 0; i < uvSize; ++i) {
-        *(pixels++) = *(u_head++);
-        *(pixels++) = *(v_head++);
+    if (!copyDecodedFrame(codecOutputBuffer, mCodecStride, mCodecSliceHeight, mCodecSemiPlanar,
+                          ycbcr, mWidth, mHeight)) {
+        LOG(ERROR) << __func__ << ": Unsupported buffer layout, chroma step "
+                   << ycbcr.chroma_step;
     }
 
     // Release our output buffer
@@ -289,6 +348,10 @@ void EvsVideoEmulatedCamera::renderOneFrame() {
     AMediaCodecBufferInfo info;
     int codecOutputputBufferIdx = AMediaCodec_dequeueOutputBuffer(
             mVideoCodec.get(), &info, /* timeoutUs = */ duration_cast<microseconds>(1ms).count());
+    if (codecOutputputBufferIdx == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+        updateCodecOutputLayout();
+        return;
+    }
     if (codecOutputputBufferIdx < 0) {
         if (codecOutputputBufferIdx != AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
             LOG(ERROR) << __func__
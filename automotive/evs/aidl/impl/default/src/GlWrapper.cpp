@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <sys/ioctl.h>
 
+#include <string_view>
 #include <utility>
 
 namespace {
@@ -241,6 +242,12 @@ bool GlWrapper::initialize(const std::shared_ptr<ICarDisplayProxy>& pWindowProxy
         return false;
     }
 
+    // Without native fences, rendering has to be waited for before the image is reused
+    const char* extensions = eglQueryString(mDisplay, EGL_EXTENSIONS);
+    mHasNativeFenceSync = extensions != nullptr &&
+                          std::string_view(extensions).find("EGL_ANDROID_native_fence_sync") !=
+                                  std::string_view::npos;
+
     const EGLint config_attribs[] = {
             // clang-format off
             // Tag          Value
@@ -386,7 +393,7 @@ bool GlWrapper::updateImageTexture(buffer_handle_t handle,
     return true;
 }
 
-void GlWrapper::renderImageToScreen() {
+::android::base::unique_fd GlWrapper::renderImageToScreen() {
     // Set the viewport
     glViewport(0, 0, mWidth, mHeight);
 
@@ -436,11 +443,26 @@ void GlWrapper::renderImageToScreen() {
     glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
 
-    glFinish();
+    // Get a fence signaled once the GPU is done with the image, rather than waiting for it here
+    ::android::base::unique_fd releaseFence;
+    if (mHasNativeFenceSync) {
+        EGLSyncKHR sync = eglCreateSyncKHR(mDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+        if (sync != EGL_NO_SYNC_KHR) {
+            // The fence only gets a file descriptor once it's flushed
+            glFlush();
+            releaseFence.reset(eglDupNativeFenceFDANDROID(mDisplay, sync));
+            eglDestroySyncKHR(mDisplay, sync);
+        }
+    }
+    if (!releaseFence.ok()) {
+        glFinish();
+    }
 
     if (eglSwapBuffers(mDisplay, mSurface) == EGL_FALSE) {
         LOG(WARNING) << "Failed to swap EGL buffers, " << getEGLError();
     }
+
+    return releaseFence;
 }
 
 }  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -126,8 +126,16 @@ class RemoteAccessService
     bool mGrpcReadChannelOpen GUARDED_BY(mLock) = false;
     std::unordered_map<std::string, size_t> mClientIdToTaskCount GUARDED_BY(mLock);
 
-    // Default wait time before retry connecting to remote access client is 10s.
-    size_t mRetryWaitInMs = 10'000;
+    // Wait time before the first retry connecting to remote access client, doubled for each
+    // retry after that up to mMaxRetryWaitInMs.
+    size_t mRetryWaitInMs = 1'000;
+    size_t mMaxRetryWaitInMs = 60'000;
+    // Uptime when the AP last became ready for remote tasks.
+    int64_t mTaskLoopStartMillis GUARDED_BY(mLock) = 0;
+    // Time from the AP becoming ready to the first task delivered after that, -1 if none yet.
+    int64_t mFirstTaskLatencyMillis GUARDED_BY(mLock) = -1;
+    size_t mDeliveredTaskCount GUARDED_BY(mLock) = 0;
+    size_t mGetRemoteTasksRetryCount GUARDED_BY(mLock) = 0;
     std::shared_ptr<DebugRemoteTaskCallback> mDebugCallback;
 
     std::thread mInjectDebugTaskThread;
@@ -146,6 +154,7 @@ class RemoteAccessService
     void debugInjectTaskNextReboot(int fd, std::string_view clientId, std::string_view taskData,
                                    const char* latencyInSecStr);
     void updateGrpcReadChannelOpen(bool grpcReadChannelOpen);
+    void onRemoteTaskDelivered();
     android::base::Result<void> deliverRemoteTaskThroughCallback(const std::string& clientId,
                                                                  std::string_view taskData);
     bool isTaskScheduleSupported();
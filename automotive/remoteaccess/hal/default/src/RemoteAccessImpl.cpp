@@ -31,6 +31,11 @@ namespace {
 
 constexpr char GRPC_SERVICE_CONFIG_FILE[] = "/vendor/etc/automotive/powercontroller/serverconfig";
 constexpr char SERVICE_NAME[] = "android.hardware.automotive.remoteaccess.IRemoteAccess/default";
+// Pings the wakeup client while the connection is idle, so a dead connection is noticed and
+// replaced before the tasks of the next wakeup have to go through it.
+constexpr int KEEPALIVE_TIME_MS = 30'000;
+constexpr int KEEPALIVE_TIMEOUT_MS = 10'000;
+constexpr int MAX_RECONNECT_BACKOFF_MS = 10'000;
 
 void maybeGetGrpcServiceInfo(std::string* address, std::string* ifname) {
     std::ifstream ifs(GRPC_SERVICE_CONFIG_FILE);
@@ -79,7 +84,12 @@ int main(int /* argc */, char* /* argv */[]) {
                                         android::netdevice::WaitCondition::PRESENT_AND_UP);
             LOG(INFO) << "Waiting for interface: " << grpcServiceIfname << " done";
         }
-        auto channel = grpc::CreateChannel(grpcServiceAddress, grpc::InsecureChannelCredentials());
+        grpcargs.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, KEEPALIVE_TIME_MS);
+        grpcargs.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, KEEPALIVE_TIMEOUT_MS);
+        grpcargs.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+        grpcargs.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS, MAX_RECONNECT_BACKOFF_MS);
+        auto channel = grpc::CreateCustomChannel(grpcServiceAddress,
+                                                 grpc::InsecureChannelCredentials(), grpcargs);
         grpcStub = android::hardware::automotive::remoteaccess::WakeupClient::NewStub(channel);
     } else {
         LOG(INFO) << "grpcServiceAddress is not defined, work in fake mode";
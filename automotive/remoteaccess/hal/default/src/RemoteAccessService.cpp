@@ -25,7 +25,9 @@
 #include <private/android_filesystem_config.h>
 #include <sys/stat.h>
 #include <utils/Log.h>
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <fstream>
 #include <iostream>
 #include <thread>
@@ -151,6 +153,12 @@ void RemoteAccessService::maybeStartTaskLoop() {
         return;
     }
 
+    {
+        std::lock_guard<std::mutex> lockGuard(mLock);
+        mTaskWaitStopped = false;
+        mTaskLoopStartMillis = android::uptimeMillis();
+        mFirstTaskLatencyMillis = -1;
+    }
     mThread = std::thread([this]() { runTaskLoop(); });
 
     mTaskLoopRunning = true;
@@ -186,6 +194,16 @@ void RemoteAccessService::updateGrpcReadChannelOpen(bool grpcReadChannelOpen) {
     mGrpcReadChannelOpen = grpcReadChannelOpen;
 }
 
+void RemoteAccessService::onRemoteTaskDelivered() {
+    std::lock_guard<std::mutex> lockGuard(mLock);
+    mDeliveredTaskCount++;
+    if (mFirstTaskLatencyMillis < 0) {
+        mFirstTaskLatencyMillis = android::uptimeMillis() - mTaskLoopStartMillis;
+        ALOGI("First remote task delivered %" PRId64 " ms after ready for remote tasks",
+              mFirstTaskLatencyMillis);
+    }
+}
+
 Result<void> RemoteAccessService::deliverRemoteTaskThroughCallback(const std::string& clientId,
                                                                    std::string_view taskData) {
     std::shared_ptr<IRemoteTaskCallback> callback;
@@ -211,42 +229,56 @@ Result<void> RemoteAccessService::deliverRemoteTaskThroughCallback(const std::st
 void RemoteAccessService::runTaskLoop() {
     GetRemoteTasksRequest request = {};
     std::unique_ptr<ClientReaderInterface<GetRemoteTasksResponse>> reader;
+    size_t retryWaitInMs = mRetryWaitInMs;
     while (true) {
         {
             std::lock_guard<std::mutex> lockGuard(mLock);
             mGetRemoteTasksContext.reset(new ClientContext());
+            // Wait for the channel to connect instead of failing right away, the channel keeps
+            // reconnecting on its own with its own backoff.
+            mGetRemoteTasksContext->set_wait_for_ready(true);
             reader = mGrpcStub->GetRemoteTasks(mGetRemoteTasksContext.get(), request);
         }
         updateGrpcReadChannelOpen(true);
         GetRemoteTasksResponse response;
+        bool receivedTask = false;
         while (reader->Read(&response)) {
             ALOGI("Receiving one task from remote task client");
+            receivedTask = true;
 
+            // The callback is oneway, so tasks arriving together are not held up by each other.
             if (auto result =
                         deliverRemoteTaskThroughCallback(response.clientid(), response.data());
                 !result.ok()) {
                 ALOGE("%s", result.error().message().c_str());
                 continue;
             }
+            onRemoteTaskDelivered();
         }
         updateGrpcReadChannelOpen(false);
         Status status = reader->Finish();
         mGetRemoteTasksContext.reset();
 
-        ALOGE("GetRemoteTasks stream breaks, code: %d, message: %s, sleeping for 10s and retry",
-              status.error_code(), status.error_message().c_str());
+        // The stream worked before breaking, so the server is likely back soon.
+        if (receivedTask) {
+            retryWaitInMs = mRetryWaitInMs;
+        }
+        ALOGE("GetRemoteTasks stream breaks, code: %d, message: %s, sleeping for %zu ms and retry",
+              status.error_code(), status.error_message().c_str(), retryWaitInMs);
         // The long lasting connection should not return. But if the server returns, retry after
-        // 10s.
+        // a wait, growing while the server keeps failing.
         {
             std::unique_lock lk(mLock);
-            if (mCv.wait_for(lk, std::chrono::milliseconds(mRetryWaitInMs), [this] {
+            if (mCv.wait_for(lk, std::chrono::milliseconds(retryWaitInMs), [this] {
                     ScopedLockAssertion lockAssertion(mLock);
                     return mTaskWaitStopped;
                 })) {
                 // If the stopped flag is set, we are quitting, exit the loop.
                 break;
             }
+            mGetRemoteTasksRetryCount++;
         }
+        retryWaitInMs = std::min(retryWaitInMs * 2, mMaxRetryWaitInMs);
     }
 }
 
@@ -617,9 +649,13 @@ void RemoteAccessService::printCurrentStatus(int fd) {
             "Remote task callback registered: %s\n"
             "GRPC server exist: %s\n"
             "GRPC read channel for receiving tasks open: %s\n"
+            "GRPC read channel retry count: %zu\n"
+            "Delivered task count: %zu\n"
+            "First task latency since ready for remote tasks: %" PRId64 " ms\n"
             "Received task count by clientId: \n%s\n",
             boolToString(mRemoteTaskCallback.get()).c_str(), boolToString(mGrpcServerExist).c_str(),
-            boolToString(mGrpcReadChannelOpen).c_str(),
+            boolToString(mGrpcReadChannelOpen).c_str(), mGetRemoteTasksRetryCount,
+            mDeliveredTaskCount, mFirstTaskLatencyMillis,
             clientIdToTaskCountToStringLocked().c_str());
 }
 
@@ -26,6 +26,7 @@
 #include <grpcpp/test/mock_stream.h>
 #include <gtest/gtest.h>
 #include <wakeup_client.grpc.pb.h>
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -355,6 +356,37 @@ TEST_F(RemoteAccessServiceUnitTest, TestGetRemoteTasksRetryConnection) {
             << "Did not receive enough tasks";
 }
 
+TEST_F(RemoteAccessServiceUnitTest, TestGetRemoteTasksRetryBackoff) {
+    std::atomic<int> connectCount = 0;
+
+    ON_CALL(*getGrpcWakeupClientStub(), GetRemoteTasksRaw)
+            .WillByDefault([&connectCount]([[maybe_unused]] ClientContext* context,
+                                           [[maybe_unused]] const GetRemoteTasksRequest& request) {
+                connectCount++;
+                // mockReader ownership will be transferred to the client so we don't own it here.
+                MockClientReader<GetRemoteTasksResponse>* mockClientReader =
+                        new MockClientReader<GetRemoteTasksResponse>();
+                EXPECT_CALL(*mockClientReader, Finish()).WillOnce(Return(Status::OK));
+                // Connection keeps failing without any task.
+                EXPECT_CALL(*mockClientReader, Read(_)).WillRepeatedly(Return(false));
+                return mockClientReader;
+            });
+
+    setRetryWaitInMs(100);
+    ApState newState = {
+            .isReadyForRemoteTask = true,
+    };
+    ASSERT_TRUE(getService()->notifyApStateChange(newState).isOk());
+
+    // Connects at 0, 100, 300 and 700ms with the wait doubling, instead of every 100ms.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    newState.isReadyForRemoteTask = false;
+    ASSERT_TRUE(getService()->notifyApStateChange(newState).isOk());
+
+    EXPECT_GE(connectCount, 2);
+    EXPECT_LE(connectCount, 3);
+}
+
 TEST_F(RemoteAccessServiceUnitTest, TestGetRemoteTasksDefaultNotReady) {
     GetRemoteTasksResponse response1;
     std::vector<uint8_t> testData = {0xde, 0xad, 0xbe, 0xef};
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace sv {
+namespace V1_0 {
+namespace implementation {
+
+// Keeps track of the time frames of a stream spend in each stage, and logs
+// it every kReportFrames frames. Not thread safe, the session lock has to be
+// held.
+class FrameStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Frames are generated at this rate.
+    static constexpr Clock::duration kFramePeriod = std::chrono::nanoseconds(1000000000 / 30);
+
+    explicit FrameStats(const char* name) : mName(name) {}
+
+    // A frame was generated and delivered.
+    //   deadline:  When the frame was due.
+    //   started:   When the generation thread woke up for it.
+    //   generated: When the frame was ready to be delivered.
+    //   delivered: When receiveFrames() returned.
+    void onFrameDelivered(Clock::time_point deadline, Clock::time_point started,
+                          Clock::time_point generated, Clock::time_point delivered) {
+        mSchedule.add(started - deadline);
+        mGenerate.add(generated - started);
+        mDeliver.add(delivered - generated);
+        mLastDelivered = delivered;
+        onFrame();
+    }
+
+    // The client returned the last delivered frame.
+    void onFrameReturned(Clock::time_point returned) {
+        mClient.add(returned - mLastDelivered);
+    }
+
+    void onFrameDropped() {
+        mDropped++;
+        onFrame();
+    }
+
+    void reset() { *this = FrameStats(mName); }
+
+private:
+    static constexpr int kReportFrames = 300;
+
+    struct Stage {
+        Clock::duration total = Clock::duration::zero();
+        Clock::duration max = Clock::duration::zero();
+        int count = 0;
+
+        void add(Clock::duration latency) {
+            total += latency;
+            max = std::max(max, latency);
+            count++;
+        }
+
+        long long averageUs() const {
+            return count == 0 ? 0 : toUs(total) / count;
+        }
+
+        long long maxUs() const { return toUs(max); }
+
+        static long long toUs(Clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        }
+    };
+
+    void onFrame() {
+        if (++mFrames < kReportFrames) {
+            return;
+        }
+        ALOGI("%s: %d frames, %d dropped, avg/max latency in us: schedule %lld/%lld, "
+              "generate %lld/%lld, deliver %lld/%lld, client %lld/%lld",
+              mName, mFrames, mDropped, mSchedule.averageUs(), mSchedule.maxUs(),
+              mGenerate.averageUs(), mGenerate.maxUs(), mDeliver.averageUs(),
+              mDeliver.maxUs(), mClient.averageUs(), mClient.maxUs());
+        reset();
+    }
+
+    const char* mName;
+    int mFrames = 0;
+    int mDropped = 0;
+    Stage mSchedule;
+    Stage mGenerate;
+    Stage mDeliver;
+    Stage mClient;
+    Clock::time_point mLastDelivered;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace sv
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
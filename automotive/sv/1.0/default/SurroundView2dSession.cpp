@@ -27,7 +27,8 @@ namespace V1_0 {
 namespace implementation {
 
 SurroundView2dSession::SurroundView2dSession() :
-    mStreamState(STOPPED) {
+    mStreamState(STOPPED),
+    mFrameStats("SurroundView2dSession") {
     mEvsCameraIds = {"0" , "1", "2", "3"};
 
     mConfig.width = 640;
@@ -62,6 +63,7 @@ Return<SvResult> SurroundView2dSession::startStream(
 
     // Start the frame generation thread
     mStreamState = RUNNING;
+    mFrameStats.reset();
     mCaptureThread = std::thread([this](){ generateFrames(); });
 
     return SvResult::OK;
@@ -97,6 +99,7 @@ Return<void> SurroundView2dSession::doneWithFrames(
     std::unique_lock <std::mutex> lock(mAccessLock);
 
     framesRecord.inUse = false;
+    mFrameStats.onFrameReturned(FrameStats::Clock::now());
 
     (void)svFramesDesc;
     return android::hardware::Void();
@@ -191,6 +194,9 @@ void SurroundView2dSession::generateFrames() {
     ALOGD("SurroundView2dSession::generateFrames");
 
     int sequenceId = 0;
+    // Frames are due at fixed points in time, so that the time spent generating and delivering
+    // them doesn't slow the stream down.
+    FrameStats::Clock::time_point deadline = FrameStats::Clock::now();
 
     while(true) {
         {
@@ -207,10 +213,18 @@ void SurroundView2dSession::generateFrames() {
                 mConfig.width * 3 / 4;
         }
 
-        usleep(100 * 1000);
+        deadline += FrameStats::kFramePeriod;
+        std::this_thread::sleep_until(deadline);
+        const FrameStats::Clock::time_point frameDeadline = deadline;
+        const FrameStats::Clock::time_point started = FrameStats::Clock::now();
+        if (started - deadline > FrameStats::kFramePeriod) {
+            // Fell behind, skip the missed frames rather than sending them in a burst.
+            deadline = started;
+        }
 
         framesRecord.frames.timestampNs = elapsedRealtimeNano();
         framesRecord.frames.sequenceId = sequenceId++;
+        const FrameStats::Clock::time_point generated = FrameStats::Clock::now();
 
         {
             std::lock_guard<std::mutex> lock(mAccessLock);
@@ -218,9 +232,12 @@ void SurroundView2dSession::generateFrames() {
             if (framesRecord.inUse) {
                 ALOGD("Notify SvEvent::FRAME_DROPPED");
                 mStream->notify(SvEvent::FRAME_DROPPED);
+                mFrameStats.onFrameDropped();
             } else {
                 framesRecord.inUse = true;
                 mStream->receiveFrames(framesRecord.frames);
+                mFrameStats.onFrameDelivered(frameDeadline, started, generated,
+                                             FrameStats::Clock::now());
             }
         }
     }
@@ -35,7 +35,8 @@ namespace V1_0 {
 namespace implementation {
 
 SurroundView3dSession::SurroundView3dSession() :
-    mStreamState(STOPPED){
+    mStreamState(STOPPED),
+    mFrameStats("SurroundView3dSession"){
 
     mEvsCameraIds = {"0" , "1", "2", "3"};
 
@@ -74,6 +75,7 @@ Return<SvResult> SurroundView3dSession::startStream(
 
     // Start the frame generation thread
     mStreamState = RUNNING;
+    mFrameStats.reset();
     mCaptureThread = std::thread([this](){ generateFrames(); });
 
     return SvResult::OK;
@@ -108,6 +110,7 @@ Return<void> SurroundView3dSession::doneWithFrames(
     std::unique_lock <std::mutex> lock(mAccessLock);
 
     framesRecord.inUse = false;
+    mFrameStats.onFrameReturned(FrameStats::Clock::now());
 
     (void)svFramesDesc;
     return android::hardware::Void();
@@ -259,6 +262,9 @@ void SurroundView3dSession::generateFrames() {
     ALOGD("SurroundView3dSession::generateFrames");
 
     int sequenceId = 0;
+    // Frames are due at fixed points in time, so that the time spent generating and delivering
+    // them doesn't slow the stream down.
+    FrameStats::Clock::time_point deadline = FrameStats::Clock::now();
 
     while(true) {
         {
@@ -270,18 +276,38 @@ void SurroundView3dSession::generateFrames() {
             }
         }
 
-        usleep(100 * 1000);
+        deadline += FrameStats::kFramePeriod;
+        std::this_thread::sleep_until(deadline);
+        const FrameStats::Clock::time_point frameDeadline = deadline;
+        const FrameStats::Clock::time_point started = FrameStats::Clock::now();
+        if (started - deadline > FrameStats::kFramePeriod) {
+            // Fell behind, skip the missed frames rather than sending them in a burst.
+            deadline = started;
+        }
 
         framesRecord.frames.timestampNs = elapsedRealtimeNano();
         framesRecord.frames.sequenceId = sequenceId++;
 
-        framesRecord.frames.svBuffers.resize(mViews.size());
-        for (int i=0; i<mViews.size(); i++) {
-            framesRecord.frames.svBuffers[i].viewId = mViews[i].viewId;
-            framesRecord.frames.svBuffers[i].hardwareBuffer.nativeHandle = new native_handle_t();
-            framesRecord.frames.svBuffers[i].hardwareBuffer.description[0] = mConfig.width; // width
-            framesRecord.frames.svBuffers[i].hardwareBuffer.description[1] = mConfig.height; // height
+        {
+            std::lock_guard<std::mutex> lock(mAccessLock);
+
+            // Handles are only allocated for new views, instead of for every view of every frame.
+            auto& svBuffers = framesRecord.frames.svBuffers;
+            for (size_t i = mViews.size(); i < svBuffers.size(); i++) {
+                delete svBuffers[i].hardwareBuffer.nativeHandle.getNativeHandle();
+            }
+            size_t oldSize = svBuffers.size();
+            svBuffers.resize(mViews.size());
+            for (size_t i = 0; i < mViews.size(); i++) {
+                if (i >= oldSize) {
+                    svBuffers[i].hardwareBuffer.nativeHandle = new native_handle_t();
+                }
+                svBuffers[i].viewId = mViews[i].viewId;
+                svBuffers[i].hardwareBuffer.description[0] = mConfig.width; // width
+                svBuffers[i].hardwareBuffer.description[1] = mConfig.height; // height
+            }
         }
+        const FrameStats::Clock::time_point generated = FrameStats::Clock::now();
 
         {
             std::lock_guard<std::mutex> lock(mAccessLock);
@@ -289,9 +315,12 @@ void SurroundView3dSession::generateFrames() {
             if (framesRecord.inUse) {
                 ALOGD("Notify SvEvent::FRAME_DROPPED");
                 mStream->notify(SvEvent::FRAME_DROPPED);
+                mFrameStats.onFrameDropped();
             } else {
                 framesRecord.inUse = true;
                 mStream->receiveFrames(framesRecord.frames);
+                mFrameStats.onFrameDelivered(frameDeadline, started, generated,
+                                             FrameStats::Clock::now());
             }
         }
     }
@@ -22,6 +22,8 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include "FrameStats.h"
+
 #include <thread>
 
 using namespace ::android::hardware::automotive::sv::V1_0;
@@ -75,6 +77,8 @@ private:
 
     std::thread mCaptureThread; // The thread we'll use to synthesize frames
 
+    FrameStats mFrameStats;
+
     struct FramesRecord {
         SvFramesDesc frames;
         bool inUse = false;
@@ -21,6 +21,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <vector>
 
 #include <android/log.h>
 #include <hidl/HidlSupport.h>
@@ -75,7 +76,7 @@ public:
 
 struct HalClientValues {
     sp<HalClient> client;
-    std::list<VehiclePropValue *> values;
+    std::vector<VehiclePropValue *> values;
 };
 
 using ClientId = uint64_t;
@@ -114,6 +115,14 @@ public:
             const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
             SubscribeFlags flags) const;
 
+    /**
+     * Same as above, but stores the result in outClientValues, whose previous content is
+     * replaced. The caller could keep outClientValues across batches to reuse its buffers.
+     */
+    void distributeValuesToClients(
+            const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
+            SubscribeFlags flags, std::vector<HalClientValues>* outClientValues) const;
+
     std::list<sp<HalClient>> getSubscribedClients(int32_t propId, SubscribeFlags flags) const;
     /**
      * If there are no clients subscribed to given properties than callback function provided
@@ -145,7 +145,9 @@ public:
     std::unique_ptr<VehiclePropConfigIndex> mConfigIndex;
     SubscriptionManager mSubscriptionManager;
 
+    // Only accessed from the BatchingConsumer thread. Reused across batches to avoid allocations.
     hidl_vec<VehiclePropValue> mHidlVecOfVehiclePropValuePool;
+    std::vector<HalClientValues> mBatchClientValues;
 
     ConcurrentQueue<VehiclePropValuePtr> mEventQueue;
     BatchingConsumer<VehiclePropValuePtr> mBatchingConsumer;
@@ -17,11 +17,13 @@
 #ifndef android_hardware_automotive_vehicle_V2_0_impl_PropertyDb_H_
 #define android_hardware_automotive_vehicle_V2_0_impl_PropertyDb_H_
 
+#include <array>
 #include <cstdint>
 #include <unordered_map>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 
 #include <android/hardware/automotive/vehicle/2.0/types.h>
 
@@ -38,7 +40,9 @@ namespace V2_0 {
  * VehiclePropertyValues stored in a sorted map thus it makes easier to get range of values, e.g.
  * to get value for all areas for particular property.
  *
- * This class is thread-safe, however it uses blocking synchronization across all methods.
+ * This class is thread-safe. Property values are sharded by property ID, each shard has its own
+ * lock, so accesses to different properties rarely block each other. Property configs are
+ * protected by a reader-writer lock since they are rarely updated after initialization.
  */
 class VehiclePropertyStore {
 public:
@@ -83,6 +87,8 @@ public:
     void removeValue(const VehiclePropValue& propValue);
     void removeValuesForProperty(int32_t propId);
 
+    /* Returns the values for all properties. The values for the same property are sorted by area
+     * and token, but the values for different properties are not sorted. */
     std::vector<VehiclePropValue> readAllValues() const;
     std::vector<VehiclePropValue> readValuesForProperty(int32_t propId) const;
     std::unique_ptr<VehiclePropValue> readValueOrNull(const VehiclePropValue& request) const;
@@ -94,18 +100,28 @@ public:
     const VehiclePropConfig* getConfigOrDie(int32_t propId) const;
 
 private:
-    RecordId getRecordIdLocked(const VehiclePropValue& valuePrototype) const;
-    const VehiclePropValue* getValueOrNullLocked(const RecordId& recId) const;
-    PropertyMapRange findRangeLocked(int32_t propId) const;
+    static constexpr size_t kShardCount = 16;
+
+    struct Shard {
+        mutable std::mutex lock;
+        PropertyMap propertyValues;  // Sorted map of RecordId : VehiclePropValue.
+    };
+
+    /* Returns false if the config for the property is not registered. */
+    bool getRecordId(const VehiclePropValue& valuePrototype, RecordId* outRecId) const;
+    Shard& getShard(int32_t propId);
+    const Shard& getShard(int32_t propId) const;
+    static const VehiclePropValue* getValueOrNullLocked(const Shard& shard, const RecordId& recId);
+    static PropertyMapRange findRangeLocked(const Shard& shard, int32_t propId);
+    static bool writeValueLocked(Shard* shard, const RecordId& recId,
+                                 const VehiclePropValue& propValue, bool updateStatus);
 
 private:
     using MuxGuard = std::lock_guard<std::mutex>;
-    mutable std::mutex mLock;
+    mutable std::shared_mutex mConfigLock;
     std::unordered_map<int32_t /* VehicleProperty */, RecordConfig> mConfigs;
 
-    PropertyMap mPropertyValues;  // Sorted map of RecordId : VehiclePropValue.
-
-    bool writeValueLocked(const VehiclePropValue& propValue, bool updateStatus);
+    std::array<Shard, kShardCount> mShards;
 };
 
 }  // namespace V2_0
@@ -19,10 +19,13 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 
 #include <android/hardware/automotive/vehicle/2.0/types.h>
 
+#include "VehicleObjectPool.h"
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -180,6 +183,51 @@ std::unique_ptr<VehiclePropValue> createPublisherIdRequest(
 std::unique_ptr<VehiclePropValue> createStartSessionMessage(const int service_id,
                                                             const int client_id);
 
+// The following builders create the same messages as above, but obtain the VehiclePropValue from
+// the pool and fill the message in place. They are meant for clients sending VMS messages at a
+// high rate. Note that the pool only recycles values whose vector size is no larger than its
+// maxRecyclableVectorSize, so the pool should be created with a size large enough to hold the
+// messages, e.g. at least 5 for SUBSCRIBE_TO_PUBLISHER and DATA messages.
+VehiclePropValuePool::RecyclableType createBaseVmsMessage(VehiclePropValuePool* pool,
+                                                          size_t message_size);
+
+VehiclePropValuePool::RecyclableType createSubscribeMessage(VehiclePropValuePool* pool,
+                                                            const VmsLayer& layer);
+
+VehiclePropValuePool::RecyclableType createSubscribeToPublisherMessage(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer);
+
+VehiclePropValuePool::RecyclableType createUnsubscribeMessage(VehiclePropValuePool* pool,
+                                                              const VmsLayer& layer);
+
+VehiclePropValuePool::RecyclableType createUnsubscribeToPublisherMessage(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer);
+
+VehiclePropValuePool::RecyclableType createOfferingMessage(VehiclePropValuePool* pool,
+                                                           const VmsOffers& offers);
+
+VehiclePropValuePool::RecyclableType createStartSessionMessage(VehiclePropValuePool* pool,
+                                                               const int service_id,
+                                                               const int client_id);
+
+// Creates a VehiclePropValue containing a message of type VmsMessageType.DATA without copying
+// the vms_packet: the bytes of the returned value point to vms_packet, so vms_packet must outlive
+// the returned value. Copying the returned value copies the bytes as usual.
+VehiclePropValuePool::RecyclableType createDataMessageWithLayerPublisherInfo(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher,
+        const uint8_t* vms_packet, size_t vms_packet_size);
+
+// Appends a VmsMessageType.DATA message for each of the vms_packets, all published on the same
+// layer, to messages. As above, the packets are not copied and must outlive the messages.
+//
+// Every VehiclePropValue carries exactly one VMS message, so the packets cannot be merged into a
+// single value. Instead, the messages could be delivered together, e.g. in a single
+// onPropertyEvent callback.
+void createDataMessagesWithLayerPublisherInfo(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher,
+        const std::vector<std::string>& vms_packets,
+        std::vector<VehiclePropValuePool::RecyclableType>* messages);
+
 // Returns true if the VehiclePropValue pointed to by value contains a valid Vms
 // message, i.e. the VehicleProperty, VehicleArea, and VmsMessageType are all
 // valid. Note: If the VmsMessageType enum is extended, this function will
@@ -198,6 +246,10 @@ VmsMessageType parseMessageType(const VehiclePropValue& value);
 // function to ParseFromString.
 std::string parseData(const VehiclePropValue& value);
 
+// Same as parseData, but returns a view of the bytes in value instead of copying them. The view is
+// only valid as long as value is.
+std::string_view parseDataView(const VehiclePropValue& value);
+
 // Returns the publisher ID by parsing the VehiclePropValue containing the ID.
 // Returns null if the message is invalid.
 int32_t parsePublisherIdResponse(const VehiclePropValue& publisher_id_response);
@@ -221,6 +273,11 @@ int32_t getSequenceNumberForSubscriptionsState(const VehiclePropValue& subscript
 std::vector<VmsLayer> getSubscribedLayers(const VehiclePropValue& subscriptions_state,
                                           const VmsOffers& offers);
 
+// Same as above, but writes the layers to subscribed_layers so that a caller parsing many
+// messages could reuse its capacity. subscribed_layers is cleared first.
+void getSubscribedLayers(const VehiclePropValue& subscriptions_state, const VmsOffers& offers,
+                         std::vector<VmsLayer>* subscribed_layers);
+
 // Takes an availability change message and returns true if the parsed message implies that
 // the service has newly started or restarted.
 // If the message has a sequence number 0, it means that the service
@@ -251,6 +308,11 @@ int32_t getSequenceNumberForAvailabilityState(const VehiclePropValue& availabili
 // sequence number.
 std::vector<VmsAssociatedLayer> getAvailableLayers(const VehiclePropValue& availability_state);
 
+// Same as above, but writes the layers to available_layers, reusing its existing entries and their
+// publisher ID vectors. available_layers only contains the layers in this message on return.
+void getAvailableLayers(const VehiclePropValue& availability_state,
+                        std::vector<VmsAssociatedLayer>* available_layers);
+
 }  // namespace vms
 }  // namespace V2_0
 }  // namespace vehicle
@@ -20,6 +20,7 @@
 
 #include <cmath>
 #include <inttypes.h>
+#include <iterator>
 
 #include <android/log.h>
 
@@ -120,28 +121,52 @@ StatusCode SubscriptionManager::addOrUpdateSubscription(
 std::list<HalClientValues> SubscriptionManager::distributeValuesToClients(
         const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
         SubscribeFlags flags) const {
-    std::map<sp<HalClient>, std::list<VehiclePropValue*>> clientValuesMap;
+    std::vector<HalClientValues> clientValuesVector;
+    distributeValuesToClients(propValues, flags, &clientValuesVector);
+
+    return std::list<HalClientValues>(std::make_move_iterator(clientValuesVector.begin()),
+                                      std::make_move_iterator(clientValuesVector.end()));
+}
+
+void SubscriptionManager::distributeValuesToClients(
+        const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
+        SubscribeFlags flags, std::vector<HalClientValues>* outClientValues) const {
+    // The entries in outClientValues are reused so that their value buffers don't need to be
+    // allocated again for every batch.
+    size_t clientCount = 0;
 
     {
         MuxGuard g(mLock);
         for (const auto& propValue: propValues) {
             VehiclePropValue* v = propValue.get();
-            auto clients = getSubscribedClientsLocked(v->prop, flags);
-            for (const auto& client : clients) {
-                clientValuesMap[client].push_back(v);
+            sp<HalClientVector> propClients = getClientsForPropertyLocked(v->prop);
+            if (propClients.get() == nullptr) {
+                continue;
+            }
+            for (size_t i = 0; i < propClients->size(); i++) {
+                const auto& client = propClients->itemAt(i);
+                if (!client->isSubscribed(v->prop, flags)) {
+                    continue;
+                }
+                // There are usually only a few clients, linear search is faster than a map.
+                size_t index = 0;
+                while (index < clientCount && (*outClientValues)[index].client != client) {
+                    index++;
+                }
+                if (index == clientCount) {
+                    if (clientCount == outClientValues->size()) {
+                        outClientValues->emplace_back();
+                    }
+                    (*outClientValues)[index].client = client;
+                    (*outClientValues)[index].values.clear();
+                    clientCount++;
+                }
+                (*outClientValues)[index].values.push_back(v);
             }
         }
     }
 
-    std::list<HalClientValues> clientValues;
-    for (const auto& entry : clientValuesMap) {
-        clientValues.push_back(HalClientValues {
-            .client = entry.first,
-            .values = entry.second
-        });
-    }
-
-    return clientValues;
+    outClientValues->resize(clientCount);
 }
 
 std::list<sp<HalClient>> SubscriptionManager::getSubscribedClients(int32_t propId,
@@ -70,8 +70,8 @@ const std::unordered_set<std::string> kSetPropOptions = {
 }  // namespace
 
 /**
- * Indicates what's the maximum size of hidl_vec<VehiclePropValue> we want
- * to store in reusable object pool.
+ * Indicates the initial size of hidl_vec<VehiclePropValue> we store in reusable
+ * object pool. The pool grows to the largest batch delivered to one client.
  */
 constexpr auto kMaxHidlVecOfVehiclePropValuePoolSize = 20;
 
@@ -462,17 +462,19 @@ void VehicleHalManager::onHalPropertySetError(StatusCode errorCode,
 }
 
 void VehicleHalManager::onBatchHalEvent(const std::vector<VehiclePropValuePtr>& values) {
-    const auto& clientValues =
-        mSubscriptionManager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR);
+    mSubscriptionManager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR,
+                                                   &mBatchClientValues);
 
-    for (const HalClientValues& cv : clientValues) {
+    for (HalClientValues& cv : mBatchClientValues) {
         auto vecSize = cv.values.size();
-        hidl_vec<VehiclePropValue> vec;
-        if (vecSize < kMaxHidlVecOfVehiclePropValuePoolSize) {
-            vec.setToExternal(&mHidlVecOfVehiclePropValuePool[0], vecSize);
-        } else {
-            vec.resize(vecSize);
+        if (vecSize > mHidlVecOfVehiclePropValuePool.size()) {
+            // Don't resize in place because the existing elements still shallow-copy the values
+            // from previous batches, which might already be recycled.
+            mHidlVecOfVehiclePropValuePool = hidl_vec<VehiclePropValue>();
+            mHidlVecOfVehiclePropValuePool.resize(vecSize);
         }
+        hidl_vec<VehiclePropValue> vec;
+        vec.setToExternal(&mHidlVecOfVehiclePropValuePool[0], vecSize);
 
         int i = 0;
         for (VehiclePropValue* pValue : cv.values) {
@@ -484,6 +486,10 @@ void VehicleHalManager::onBatchHalEvent(const std::vector<VehiclePropValuePtr>&
                   toString(cv.client->getCallback()).c_str(),
                   status.description().c_str());
         }
+        // The values are recycled after this batch and the client should not be kept alive by
+        // the cached entry, but keep the capacity for the following batches.
+        cv.values.clear();
+        cv.client.clear();
     }
 }
 
@@ -127,6 +127,12 @@ void VehiclePropValuePool::InternalPool::recycle(VehiclePropValue* o) {
         return;
     }
 
+    if (mPropType != VehiclePropertyType::BYTES) {
+        // Some messages, e.g. VMS DATA messages, carry an additional byte payload. Drop it so that
+        // the value could still be recycled, setToExternal only frees the buffer if it is owned.
+        o->value.bytes.setToExternal(nullptr, 0);
+    }
+
     if (!check(&o->value)) {
         ALOGE("Discarding value for prop 0x%x because it contains "
                   "data that is not consistent with this pool. "
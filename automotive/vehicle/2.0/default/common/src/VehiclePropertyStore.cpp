@@ -38,17 +38,16 @@ bool VehiclePropertyStore::RecordId::operator<(const VehiclePropertyStore::Recor
 
 void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
                                             VehiclePropertyStore::TokenFunction tokenFunc) {
-    MuxGuard g(mLock);
+    std::unique_lock<std::shared_mutex> g(mConfigLock);
     mConfigs.insert({ config.prop, RecordConfig { config, tokenFunc } });
 }
 
-bool VehiclePropertyStore::writeValueLocked(const VehiclePropValue& propValue, bool updateStatus) {
-    if (!mConfigs.count(propValue.prop)) return false;
-
-    RecordId recId = getRecordIdLocked(propValue);
-    VehiclePropValue* valueToUpdate = const_cast<VehiclePropValue*>(getValueOrNullLocked(recId));
+bool VehiclePropertyStore::writeValueLocked(Shard* shard, const RecordId& recId,
+                                            const VehiclePropValue& propValue, bool updateStatus) {
+    VehiclePropValue* valueToUpdate =
+            const_cast<VehiclePropValue*>(getValueOrNullLocked(*shard, recId));
     if (valueToUpdate == nullptr) {
-        mPropertyValues.insert({ recId, propValue });
+        shard->propertyValues.insert({ recId, propValue });
         return true;
     }
 
@@ -68,28 +67,41 @@ bool VehiclePropertyStore::writeValueLocked(const VehiclePropValue& propValue, b
 }
 
 bool VehiclePropertyStore::writeValue(const VehiclePropValue& propValue, bool updateStatus) {
-    MuxGuard g(mLock);
+    RecordId recId;
+    if (!getRecordId(propValue, &recId)) return false;
 
-    return writeValueLocked(propValue, updateStatus);
+    Shard& shard = getShard(propValue.prop);
+    MuxGuard g(shard.lock);
+    return writeValueLocked(&shard, recId, propValue, updateStatus);
 }
 
 bool VehiclePropertyStore::writeValueWithCurrentTimestamp(VehiclePropValue* propValuePtr,
                                                           bool updateStatus) {
-    MuxGuard g(mLock);
+    RecordId recId;
+    if (!getRecordId(*propValuePtr, &recId)) return false;
 
+    Shard& shard = getShard(propValuePtr->prop);
+    MuxGuard g(shard.lock);
+    // Take the timestamp under the shard lock so that concurrent writes to the same property are
+    // stored in timestamp order.
     propValuePtr->timestamp = elapsedRealtimeNano();
-    return writeValueLocked(*propValuePtr, updateStatus);
+    return writeValueLocked(&shard, recId, *propValuePtr, updateStatus);
 }
 
 std::unique_ptr<VehiclePropValue> VehiclePropertyStore::refreshTimestamp(int32_t propId,
                                                                          int32_t areaId) {
-    MuxGuard g(mLock);
-    RecordId recId = getRecordIdLocked(VehiclePropValue{
-            .prop = propId,
-            .areaId = areaId,
-    });
-    auto it = mPropertyValues.find(recId);
-    if (it == mPropertyValues.end()) {
+    RecordId recId;
+    if (!getRecordId(VehiclePropValue{
+                             .prop = propId,
+                             .areaId = areaId,
+                     },
+                     &recId)) {
+        return nullptr;
+    }
+    Shard& shard = getShard(propId);
+    MuxGuard g(shard.lock);
+    auto it = shard.propertyValues.find(recId);
+    if (it == shard.propertyValues.end()) {
         return nullptr;
     }
 
@@ -98,34 +110,41 @@ std::unique_ptr<VehiclePropValue> VehiclePropertyStore::refreshTimestamp(int32_t
 }
 
 void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
-    MuxGuard g(mLock);
-    RecordId recId = getRecordIdLocked(propValue);
-    auto it = mPropertyValues.find(recId);
-    if (it != mPropertyValues.end()) {
-        mPropertyValues.erase(it);
+    RecordId recId;
+    if (!getRecordId(propValue, &recId)) return;
+
+    Shard& shard = getShard(propValue.prop);
+    MuxGuard g(shard.lock);
+    auto it = shard.propertyValues.find(recId);
+    if (it != shard.propertyValues.end()) {
+        shard.propertyValues.erase(it);
     }
 }
 
 void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
-    MuxGuard g(mLock);
-    auto range = findRangeLocked(propId);
-    mPropertyValues.erase(range.first, range.second);
+    Shard& shard = getShard(propId);
+    MuxGuard g(shard.lock);
+    auto range = findRangeLocked(shard, propId);
+    shard.propertyValues.erase(range.first, range.second);
 }
 
 std::vector<VehiclePropValue> VehiclePropertyStore::readAllValues() const {
-    MuxGuard g(mLock);
     std::vector<VehiclePropValue> allValues;
-    allValues.reserve(mPropertyValues.size());
-    for (auto&& it : mPropertyValues) {
-        allValues.push_back(it.second);
+    for (const Shard& shard : mShards) {
+        MuxGuard g(shard.lock);
+        allValues.reserve(allValues.size() + shard.propertyValues.size());
+        for (auto&& it : shard.propertyValues) {
+            allValues.push_back(it.second);
+        }
     }
     return allValues;
 }
 
 std::vector<VehiclePropValue> VehiclePropertyStore::readValuesForProperty(int32_t propId) const {
     std::vector<VehiclePropValue> values;
-    MuxGuard g(mLock);
-    auto range = findRangeLocked(propId);
+    const Shard& shard = getShard(propId);
+    MuxGuard g(shard.lock);
+    auto range = findRangeLocked(shard, propId);
     for (auto it = range.first; it != range.second; ++it) {
         values.push_back(it->second);
     }
@@ -135,23 +154,27 @@ std::vector<VehiclePropValue> VehiclePropertyStore::readValuesForProperty(int32_
 
 std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNull(
         const VehiclePropValue& request) const {
-    MuxGuard g(mLock);
-    RecordId recId = getRecordIdLocked(request);
-    const VehiclePropValue* internalValue = getValueOrNullLocked(recId);
+    RecordId recId;
+    if (!getRecordId(request, &recId)) return nullptr;
+
+    const Shard& shard = getShard(request.prop);
+    MuxGuard g(shard.lock);
+    const VehiclePropValue* internalValue = getValueOrNullLocked(shard, recId);
     return internalValue ? std::make_unique<VehiclePropValue>(*internalValue) : nullptr;
 }
 
 std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNull(
         int32_t prop, int32_t area, int64_t token) const {
     RecordId recId = {prop, isGlobalProp(prop) ? 0 : area, token };
-    MuxGuard g(mLock);
-    const VehiclePropValue* internalValue = getValueOrNullLocked(recId);
+    const Shard& shard = getShard(prop);
+    MuxGuard g(shard.lock);
+    const VehiclePropValue* internalValue = getValueOrNullLocked(shard, recId);
     return internalValue ? std::make_unique<VehiclePropValue>(*internalValue) : nullptr;
 }
 
 
 std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
-    MuxGuard g(mLock);
+    std::shared_lock<std::shared_mutex> g(mConfigLock);
     std::vector<VehiclePropConfig> configs;
     configs.reserve(mConfigs.size());
     for (auto&& recordConfigIt: mConfigs) {
@@ -161,7 +184,7 @@ std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
 }
 
 const VehiclePropConfig* VehiclePropertyStore::getConfigOrNull(int32_t propId) const {
-    MuxGuard g(mLock);
+    std::shared_lock<std::shared_mutex> g(mConfigLock);
     auto recordConfigIt = mConfigs.find(propId);
     return recordConfigIt != mConfigs.end() ? &recordConfigIt->second.propConfig : nullptr;
 }
@@ -175,33 +198,44 @@ const VehiclePropConfig* VehiclePropertyStore::getConfigOrDie(int32_t propId) co
     return cfg;
 }
 
-VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
-        const VehiclePropValue& valuePrototype) const {
-    RecordId recId = {
+bool VehiclePropertyStore::getRecordId(const VehiclePropValue& valuePrototype,
+                                       RecordId* outRecId) const {
+    *outRecId = {
         .prop = valuePrototype.prop,
         .area = isGlobalProp(valuePrototype.prop) ? 0 : valuePrototype.areaId,
         .token = 0
     };
 
-    auto it = mConfigs.find(recId.prop);
-    if (it == mConfigs.end()) return {};
+    std::shared_lock<std::shared_mutex> g(mConfigLock);
+    auto it = mConfigs.find(outRecId->prop);
+    if (it == mConfigs.end()) return false;
 
     if (it->second.tokenFunction != nullptr) {
-        recId.token = it->second.tokenFunction(valuePrototype);
+        outRecId->token = it->second.tokenFunction(valuePrototype);
     }
-    return recId;
+    return true;
+}
+
+VehiclePropertyStore::Shard& VehiclePropertyStore::getShard(int32_t propId) {
+    return mShards[static_cast<uint32_t>(propId) % kShardCount];
+}
+
+const VehiclePropertyStore::Shard& VehiclePropertyStore::getShard(int32_t propId) const {
+    return mShards[static_cast<uint32_t>(propId) % kShardCount];
 }
 
 const VehiclePropValue* VehiclePropertyStore::getValueOrNullLocked(
-        const VehiclePropertyStore::RecordId& recId) const  {
-    auto it = mPropertyValues.find(recId);
-    return it == mPropertyValues.end() ? nullptr : &it->second;
+        const Shard& shard, const VehiclePropertyStore::RecordId& recId) {
+    auto it = shard.propertyValues.find(recId);
+    return it == shard.propertyValues.end() ? nullptr : &it->second;
 }
 
-VehiclePropertyStore::PropertyMapRange VehiclePropertyStore::findRangeLocked(int32_t propId) const {
-    // Based on the fact that mPropertyValues is a sorted map by RecordId.
-    auto beginIt = mPropertyValues.lower_bound( RecordId { propId, INT32_MIN, 0 });
-    auto endIt = mPropertyValues.lower_bound( RecordId { propId + 1, INT32_MIN, 0 });
+VehiclePropertyStore::PropertyMapRange VehiclePropertyStore::findRangeLocked(const Shard& shard,
+                                                                             int32_t propId) {
+    // Based on the fact that propertyValues is a sorted map by RecordId and all the values for
+    // one property are in the same shard.
+    auto beginIt = shard.propertyValues.lower_bound( RecordId { propId, INT32_MIN, 0 });
+    auto endIt = shard.propertyValues.lower_bound( RecordId { propId + 1, INT32_MIN, 0 });
 
     return  PropertyMapRange { beginIt, endIt };
 }
@@ -18,6 +18,8 @@
 
 #include <common/include/vhal_v2_0/VehicleUtils.h>
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -46,92 +48,124 @@ static constexpr int kAvailabilitySequenceNumberIndex =
 static constexpr int kFirstMessageType = toInt(VmsMessageType::SUBSCRIBE);
 static constexpr int kLastMessageType = toInt(VmsMessageType::START_SESSION);
 
+namespace {
+
+void fillLayer(const VmsLayer& layer, int32_t** dst) {
+    *(*dst)++ = layer.type;
+    *(*dst)++ = layer.subtype;
+    *(*dst)++ = layer.version;
+}
+
+void fillBaseVmsMessage(VehiclePropValue* message) {
+    message->prop = toInt(VehicleProperty::VEHICLE_MAP_SERVICE);
+    message->areaId = toInt(VehicleArea::GLOBAL);
+    // Recycled values still carry the timestamp and status of their previous use.
+    message->timestamp = 0;
+    message->status = VehiclePropertyStatus::AVAILABLE;
+}
+
+void fillLayerMessage(VmsMessageType type, const VmsLayer& layer, VehiclePropValue* message) {
+    int32_t* dst = message->value.int32Values.data();
+    *dst++ = toInt(type);
+    fillLayer(layer, &dst);
+}
+
+void fillLayerAndPublisherMessage(VmsMessageType type, const VmsLayerAndPublisher& layer_publisher,
+                                  VehiclePropValue* message) {
+    int32_t* dst = message->value.int32Values.data();
+    *dst++ = toInt(type);
+    fillLayer(layer_publisher.layer, &dst);
+    *dst = layer_publisher.publisher_id;
+}
+
+size_t getOfferingMessageSize(const VmsOffers& offers) {
+    size_t message_size = kMessageTypeSize + kPublisherIdSize + kLayerNumberSize;
+    for (const auto& offer : offers.offerings) {
+        message_size += kLayerSize + kLayerNumberSize + (offer.dependencies.size() * kLayerSize);
+    }
+    return message_size;
+}
+
+void fillOfferingMessage(const VmsOffers& offers, VehiclePropValue* message) {
+    int32_t* dst = message->value.int32Values.data();
+    *dst++ = toInt(VmsMessageType::OFFERING);
+    *dst++ = offers.publisher_id;
+    *dst++ = static_cast<int32_t>(offers.offerings.size());
+    for (const auto& offer : offers.offerings) {
+        fillLayer(offer.layer, &dst);
+        *dst++ = static_cast<int32_t>(offer.dependencies.size());
+        for (const auto& dependency : offer.dependencies) {
+            fillLayer(dependency, &dst);
+        }
+    }
+}
+
+void fillStartSessionMessage(const int service_id, const int client_id,
+                             VehiclePropValue* message) {
+    int32_t* dst = message->value.int32Values.data();
+    *dst++ = toInt(VmsMessageType::START_SESSION);
+    *dst++ = service_id;
+    *dst = client_id;
+}
+
+}  // namespace
+
 std::unique_ptr<VehiclePropValue> createBaseVmsMessage(size_t message_size) {
     auto result = createVehiclePropValue(VehiclePropertyType::INT32, message_size);
-    result->prop = toInt(VehicleProperty::VEHICLE_MAP_SERVICE);
-    result->areaId = toInt(VehicleArea::GLOBAL);
+    fillBaseVmsMessage(result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createSubscribeMessage(const VmsLayer& layer) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kLayerSize);
-    result->value.int32Values = hidl_vec<int32_t>{toInt(VmsMessageType::SUBSCRIBE), layer.type,
-                                                  layer.subtype, layer.version};
+    fillLayerMessage(VmsMessageType::SUBSCRIBE, layer, result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createSubscribeToPublisherMessage(
     const VmsLayerAndPublisher& layer_publisher) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kLayerAndPublisherSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-        toInt(VmsMessageType::SUBSCRIBE_TO_PUBLISHER), layer_publisher.layer.type,
-        layer_publisher.layer.subtype, layer_publisher.layer.version, layer_publisher.publisher_id};
+    fillLayerAndPublisherMessage(VmsMessageType::SUBSCRIBE_TO_PUBLISHER, layer_publisher,
+                                 result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createUnsubscribeMessage(const VmsLayer& layer) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kLayerSize);
-    result->value.int32Values = hidl_vec<int32_t>{toInt(VmsMessageType::UNSUBSCRIBE), layer.type,
-                                                  layer.subtype, layer.version};
+    fillLayerMessage(VmsMessageType::UNSUBSCRIBE, layer, result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createUnsubscribeToPublisherMessage(
     const VmsLayerAndPublisher& layer_publisher) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kLayerAndPublisherSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-        toInt(VmsMessageType::UNSUBSCRIBE_TO_PUBLISHER), layer_publisher.layer.type,
-        layer_publisher.layer.subtype, layer_publisher.layer.version, layer_publisher.publisher_id};
+    fillLayerAndPublisherMessage(VmsMessageType::UNSUBSCRIBE_TO_PUBLISHER, layer_publisher,
+                                 result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createOfferingMessage(const VmsOffers& offers) {
-    int message_size = kMessageTypeSize + kPublisherIdSize + kLayerNumberSize;
-    for (const auto& offer : offers.offerings) {
-        message_size += kLayerSize + kLayerNumberSize + (offer.dependencies.size() * kLayerSize);
-    }
-    auto result = createBaseVmsMessage(message_size);
-
-    std::vector<int32_t> offerings = {toInt(VmsMessageType::OFFERING), offers.publisher_id,
-                                      static_cast<int>(offers.offerings.size())};
-    for (const auto& offer : offers.offerings) {
-        std::vector<int32_t> layer_vector = {offer.layer.type, offer.layer.subtype,
-                                             offer.layer.version,
-                                             static_cast<int32_t>(offer.dependencies.size())};
-        for (const auto& dependency : offer.dependencies) {
-            std::vector<int32_t> dependency_layer = {dependency.type, dependency.subtype,
-                                                     dependency.version};
-            layer_vector.insert(layer_vector.end(), dependency_layer.begin(),
-                                dependency_layer.end());
-        }
-        offerings.insert(offerings.end(), layer_vector.begin(), layer_vector.end());
-    }
-    result->value.int32Values = offerings;
+    auto result = createBaseVmsMessage(getOfferingMessageSize(offers));
+    fillOfferingMessage(offers, result.get());
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createAvailabilityRequest() {
     auto result = createBaseVmsMessage(kMessageTypeSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-        toInt(VmsMessageType::AVAILABILITY_REQUEST),
-    };
+    result->value.int32Values[kMessageIndex] = toInt(VmsMessageType::AVAILABILITY_REQUEST);
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createSubscriptionsRequest() {
     auto result = createBaseVmsMessage(kMessageTypeSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-        toInt(VmsMessageType::SUBSCRIPTIONS_REQUEST),
-    };
+    result->value.int32Values[kMessageIndex] = toInt(VmsMessageType::SUBSCRIPTIONS_REQUEST);
     return result;
 }
 
 std::unique_ptr<VehiclePropValue> createDataMessageWithLayerPublisherInfo(
         const VmsLayerAndPublisher& layer_publisher, const std::string& vms_packet) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kLayerAndPublisherSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-            toInt(VmsMessageType::DATA), layer_publisher.layer.type, layer_publisher.layer.subtype,
-            layer_publisher.layer.version, layer_publisher.publisher_id};
+    fillLayerAndPublisherMessage(VmsMessageType::DATA, layer_publisher, result.get());
     result->value.bytes = std::vector<uint8_t>(vms_packet.begin(), vms_packet.end());
     return result;
 }
@@ -139,9 +173,7 @@ std::unique_ptr<VehiclePropValue> createDataMessageWithLayerPublisherInfo(
 std::unique_ptr<VehiclePropValue> createPublisherIdRequest(
         const std::string& vms_provider_description) {
     auto result = createBaseVmsMessage(kMessageTypeSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-            toInt(VmsMessageType::PUBLISHER_ID_REQUEST),
-    };
+    result->value.int32Values[kMessageIndex] = toInt(VmsMessageType::PUBLISHER_ID_REQUEST);
     result->value.bytes =
             std::vector<uint8_t>(vms_provider_description.begin(), vms_provider_description.end());
     return result;
@@ -150,14 +182,84 @@ std::unique_ptr<VehiclePropValue> createPublisherIdRequest(
 std::unique_ptr<VehiclePropValue> createStartSessionMessage(const int service_id,
                                                             const int client_id) {
     auto result = createBaseVmsMessage(kMessageTypeSize + kSessionIdsSize);
-    result->value.int32Values = hidl_vec<int32_t>{
-            toInt(VmsMessageType::START_SESSION),
-            service_id,
-            client_id,
-    };
+    fillStartSessionMessage(service_id, client_id, result.get());
     return result;
 }
 
+VehiclePropValuePool::RecyclableType createBaseVmsMessage(VehiclePropValuePool* pool,
+                                                          size_t message_size) {
+    auto result = pool->obtain(VehiclePropertyType::INT32, message_size);
+    fillBaseVmsMessage(result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createSubscribeMessage(VehiclePropValuePool* pool,
+                                                            const VmsLayer& layer) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kLayerSize);
+    fillLayerMessage(VmsMessageType::SUBSCRIBE, layer, result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createSubscribeToPublisherMessage(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kLayerAndPublisherSize);
+    fillLayerAndPublisherMessage(VmsMessageType::SUBSCRIBE_TO_PUBLISHER, layer_publisher,
+                                 result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createUnsubscribeMessage(VehiclePropValuePool* pool,
+                                                              const VmsLayer& layer) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kLayerSize);
+    fillLayerMessage(VmsMessageType::UNSUBSCRIBE, layer, result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createUnsubscribeToPublisherMessage(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kLayerAndPublisherSize);
+    fillLayerAndPublisherMessage(VmsMessageType::UNSUBSCRIBE_TO_PUBLISHER, layer_publisher,
+                                 result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createOfferingMessage(VehiclePropValuePool* pool,
+                                                           const VmsOffers& offers) {
+    auto result = createBaseVmsMessage(pool, getOfferingMessageSize(offers));
+    fillOfferingMessage(offers, result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createStartSessionMessage(VehiclePropValuePool* pool,
+                                                               const int service_id,
+                                                               const int client_id) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kSessionIdsSize);
+    fillStartSessionMessage(service_id, client_id, result.get());
+    return result;
+}
+
+VehiclePropValuePool::RecyclableType createDataMessageWithLayerPublisherInfo(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher,
+        const uint8_t* vms_packet, size_t vms_packet_size) {
+    auto result = createBaseVmsMessage(pool, kMessageTypeSize + kLayerAndPublisherSize);
+    fillLayerAndPublisherMessage(VmsMessageType::DATA, layer_publisher, result.get());
+    result->value.bytes.setToExternal(const_cast<uint8_t*>(vms_packet), vms_packet_size,
+                                      /* shouldOwn = */ false);
+    return result;
+}
+
+void createDataMessagesWithLayerPublisherInfo(
+        VehiclePropValuePool* pool, const VmsLayerAndPublisher& layer_publisher,
+        const std::vector<std::string>& vms_packets,
+        std::vector<VehiclePropValuePool::RecyclableType>* messages) {
+    messages->reserve(messages->size() + vms_packets.size());
+    for (const auto& vms_packet : vms_packets) {
+        messages->push_back(createDataMessageWithLayerPublisherInfo(
+                pool, layer_publisher, reinterpret_cast<const uint8_t*>(vms_packet.data()),
+                vms_packet.size()));
+    }
+}
+
 bool isValidVmsProperty(const VehiclePropValue& value) {
     return (value.prop == toInt(VehicleProperty::VEHICLE_MAP_SERVICE));
 }
@@ -177,11 +279,16 @@ VmsMessageType parseMessageType(const VehiclePropValue& value) {
 }
 
 std::string parseData(const VehiclePropValue& value) {
+    return std::string(parseDataView(value));
+}
+
+std::string_view parseDataView(const VehiclePropValue& value) {
     if (isValidVmsMessage(value) && parseMessageType(value) == VmsMessageType::DATA &&
         value.value.bytes.size() > 0) {
-        return std::string(value.value.bytes.begin(), value.value.bytes.end());
+        return std::string_view(reinterpret_cast<const char*>(value.value.bytes.data()),
+                                value.value.bytes.size());
     } else {
-        return std::string();
+        return std::string_view();
     }
 }
 
@@ -216,32 +323,43 @@ int32_t getSequenceNumberForSubscriptionsState(const VehiclePropValue& subscript
 
 std::vector<VmsLayer> getSubscribedLayers(const VehiclePropValue& subscriptions_state,
                                           const VmsOffers& offers) {
+    std::vector<VmsLayer> subscribed_layers;
+    getSubscribedLayers(subscriptions_state, offers, &subscribed_layers);
+    return subscribed_layers;
+}
+
+void getSubscribedLayers(const VehiclePropValue& subscriptions_state, const VmsOffers& offers,
+                         std::vector<VmsLayer>* subscribed_layers) {
+    subscribed_layers->clear();
     if (isValidVmsMessage(subscriptions_state) &&
         (parseMessageType(subscriptions_state) == VmsMessageType::SUBSCRIPTIONS_CHANGE ||
          parseMessageType(subscriptions_state) == VmsMessageType::SUBSCRIPTIONS_RESPONSE) &&
         subscriptions_state.value.int32Values.size() >
                 toInt(VmsSubscriptionsStateIntegerValuesIndex::NUMBER_OF_LAYERS)) {
-        int subscriptions_state_int_size = subscriptions_state.value.int32Values.size();
-        std::unordered_set<VmsLayer, VmsLayer::VmsLayerHashFunction> offered_layers;
-        for (const auto& offer : offers.offerings) {
-            offered_layers.insert(offer.layer);
-        }
-        std::vector<VmsLayer> subscribed_layers;
+        const auto& int32_values = subscriptions_state.value.int32Values;
+        int subscriptions_state_int_size = int32_values.size();
+        // A publisher only offers a handful of layers, so a linear search is cheaper than
+        // building a hash set of the offered layers for every message.
+        auto is_offered = [&offers](const VmsLayer& layer) {
+            return std::any_of(
+                    offers.offerings.begin(), offers.offerings.end(),
+                    [&layer](const VmsLayerOffering& offer) { return offer.layer == layer; });
+        };
 
         int current_index = toInt(VmsSubscriptionsStateIntegerValuesIndex::SUBSCRIPTIONS_START);
 
         // Add all subscribed layers which are offered by the current publisher.
-        const int32_t num_of_layers = subscriptions_state.value.int32Values[toInt(
-                VmsSubscriptionsStateIntegerValuesIndex::NUMBER_OF_LAYERS)];
+        const int32_t num_of_layers =
+                int32_values[toInt(VmsSubscriptionsStateIntegerValuesIndex::NUMBER_OF_LAYERS)];
         for (int i = 0; i < num_of_layers; i++) {
             if (subscriptions_state_int_size < current_index + kLayerSize) {
-                return {};
+                subscribed_layers->clear();
+                return;
             }
-            VmsLayer layer = VmsLayer(subscriptions_state.value.int32Values[current_index],
-                                      subscriptions_state.value.int32Values[current_index + 1],
-                                      subscriptions_state.value.int32Values[current_index + 2]);
-            if (offered_layers.find(layer) != offered_layers.end()) {
-                subscribed_layers.push_back(std::move(layer));
+            VmsLayer layer = VmsLayer(int32_values[current_index], int32_values[current_index + 1],
+                                      int32_values[current_index + 2]);
+            if (is_offered(layer)) {
+                subscribed_layers->push_back(layer);
             }
             current_index += kLayerSize;
         }
@@ -251,36 +369,32 @@ std::vector<VmsLayer> getSubscribedLayers(const VehiclePropValue& subscriptions_
         // same as that of the current publisher.
         if (subscriptions_state_int_size >
             toInt(VmsSubscriptionsStateIntegerValuesIndex::NUMBER_OF_ASSOCIATED_LAYERS)) {
-            const int32_t num_of_associated_layers = subscriptions_state.value.int32Values[toInt(
+            const int32_t num_of_associated_layers = int32_values[toInt(
                     VmsSubscriptionsStateIntegerValuesIndex::NUMBER_OF_ASSOCIATED_LAYERS)];
 
             for (int i = 0; i < num_of_associated_layers; i++) {
                 if (subscriptions_state_int_size < current_index + kLayerSize) {
-                    return {};
+                    subscribed_layers->clear();
+                    return;
                 }
-                VmsLayer layer = VmsLayer(subscriptions_state.value.int32Values[current_index],
-                                          subscriptions_state.value.int32Values[current_index + 1],
-                                          subscriptions_state.value.int32Values[current_index + 2]);
+                VmsLayer layer =
+                        VmsLayer(int32_values[current_index], int32_values[current_index + 1],
+                                 int32_values[current_index + 2]);
                 current_index += kLayerSize;
-                if (offered_layers.find(layer) != offered_layers.end() &&
-                    subscriptions_state_int_size > current_index) {
-                    int32_t num_of_publisher_ids =
-                            subscriptions_state.value.int32Values[current_index];
+                if (is_offered(layer) && subscriptions_state_int_size > current_index) {
+                    int32_t num_of_publisher_ids = int32_values[current_index];
                     current_index++;
                     for (int j = 0; j < num_of_publisher_ids; j++) {
                         if (subscriptions_state_int_size > current_index &&
-                            subscriptions_state.value.int32Values[current_index] ==
-                                    offers.publisher_id) {
-                            subscribed_layers.push_back(std::move(layer));
+                            int32_values[current_index] == offers.publisher_id) {
+                            subscribed_layers->push_back(layer);
                         }
                         current_index++;
                     }
                 }
             }
         }
-        return subscribed_layers;
     }
-    return {};
 }
 
 bool hasServiceNewlyStarted(const VehiclePropValue& availability_change) {
@@ -337,41 +451,58 @@ int32_t getSequenceNumberForAvailabilityState(const VehiclePropValue& availabili
 }
 
 std::vector<VmsAssociatedLayer> getAvailableLayers(const VehiclePropValue& availability_state) {
+    std::vector<VmsAssociatedLayer> available_layers;
+    getAvailableLayers(availability_state, &available_layers);
+    return available_layers;
+}
+
+void getAvailableLayers(const VehiclePropValue& availability_state,
+                        std::vector<VmsAssociatedLayer>* available_layers) {
+    size_t num_of_available_layers = 0;
     if (isValidVmsMessage(availability_state) &&
         (parseMessageType(availability_state) == VmsMessageType::AVAILABILITY_CHANGE ||
          parseMessageType(availability_state) == VmsMessageType::AVAILABILITY_RESPONSE) &&
         availability_state.value.int32Values.size() >
                 toInt(VmsAvailabilityStateIntegerValuesIndex::NUMBER_OF_ASSOCIATED_LAYERS)) {
-        int availability_state_int_size = availability_state.value.int32Values.size();
-        const int32_t num_of_associated_layers = availability_state.value.int32Values[toInt(
+        const auto& int32_values = availability_state.value.int32Values;
+        int availability_state_int_size = int32_values.size();
+        const int32_t num_of_associated_layers = int32_values[toInt(
                 VmsAvailabilityStateIntegerValuesIndex::NUMBER_OF_ASSOCIATED_LAYERS)];
         int current_index = toInt(VmsAvailabilityStateIntegerValuesIndex::LAYERS_START);
-        std::vector<VmsAssociatedLayer> available_layers;
         for (int i = 0; i < num_of_associated_layers; i++) {
             if (availability_state_int_size < current_index + kLayerSize) {
-                return {};
+                available_layers->clear();
+                return;
             }
-            VmsLayer layer = VmsLayer(availability_state.value.int32Values[current_index],
-                                      availability_state.value.int32Values[current_index + 1],
-                                      availability_state.value.int32Values[current_index + 2]);
+            VmsLayer layer = VmsLayer(int32_values[current_index], int32_values[current_index + 1],
+                                      int32_values[current_index + 2]);
             current_index += kLayerSize;
-            std::vector<int> publisher_ids;
+            // Reuse the entries, and the capacity of their publisher ID vectors, left from the
+            // previous message.
+            if (num_of_available_layers == available_layers->size()) {
+                available_layers->emplace_back(layer, std::vector<int>());
+            } else {
+                (*available_layers)[num_of_available_layers].layer = layer;
+            }
+            std::vector<int>& publisher_ids =
+                    (*available_layers)[num_of_available_layers].publisher_ids;
+            publisher_ids.clear();
+            num_of_available_layers++;
             if (availability_state_int_size > current_index) {
-                int32_t num_of_publisher_ids = availability_state.value.int32Values[current_index];
+                int32_t num_of_publisher_ids = int32_values[current_index];
                 current_index++;
                 for (int j = 0; j < num_of_publisher_ids; j++) {
                     if (availability_state_int_size > current_index) {
-                        publisher_ids.push_back(
-                                availability_state.value.int32Values[current_index]);
+                        publisher_ids.push_back(int32_values[current_index]);
                         current_index++;
                     }
                 }
             }
-            available_layers.emplace_back(layer, std::move(publisher_ids));
         }
-        return available_layers;
     }
-    return {};
+    // VmsAssociatedLayer is not default constructible, so shrink by erasing the stale tail.
+    available_layers->erase(available_layers->begin() + num_of_available_layers,
+                            available_layers->end());
 }
 
 }  // namespace vms
@@ -188,6 +188,43 @@ TEST_F(SubscriptionManagerTest, unsubscribe) {
     assertLastUnsubscribedProperty(PROP1);
 }
 
+TEST_F(SubscriptionManagerTest, distributeValuesToClients) {
+    std::list<SubscribeOptions> updatedOptions;
+    ASSERT_EQ(StatusCode::OK,
+              manager.addOrUpdateSubscription(1, cb1, subscrToProp1, &updatedOptions));
+    ASSERT_EQ(StatusCode::OK,
+              manager.addOrUpdateSubscription(2, cb2, subscrToProp1and2, &updatedOptions));
+
+    VehiclePropValuePool pool;
+    std::vector<recyclable_ptr<VehiclePropValue>> values;
+    values.push_back(pool.obtainInt32(1));
+    values.back()->prop = PROP1;
+    values.push_back(pool.obtainInt32(2));
+    values.back()->prop = PROP2;
+    values.push_back(pool.obtainInt32(3));
+    values.back()->prop = toInt(VehicleProperty::AP_POWER_BOOTUP_REASON);
+
+    std::vector<HalClientValues> clientValues;
+    manager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR, &clientValues);
+
+    ASSERT_EQ(2u, clientValues.size());
+    std::unordered_map<IVehicleCallback*, std::vector<VehiclePropValue*>> valuesByCallback;
+    for (const auto& cv : clientValues) {
+        valuesByCallback[cv.client->getCallback().get()] = cv.values;
+    }
+    ASSERT_EQ(std::vector<VehiclePropValue*>({values[0].get()}), valuesByCallback[cb1.get()]);
+    ASSERT_EQ(std::vector<VehiclePropValue*>({values[0].get(), values[1].get()}),
+              valuesByCallback[cb2.get()]);
+
+    // The output is replaced by the following batch.
+    values.erase(values.begin());
+    manager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR, &clientValues);
+
+    ASSERT_EQ(1u, clientValues.size());
+    ASSERT_EQ(cb2, clientValues[0].client->getCallback());
+    ASSERT_EQ(std::vector<VehiclePropValue*>({values[0].get()}), clientValues[0].values);
+}
+
 }  // namespace anonymous
 
 }  // namespace V2_0
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "vhal_v2_0/VehiclePropertyStore.h"
+
+#include "VehicleHalTestUtils.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace {
+
+class VehiclePropertyStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (const auto& config : kVehicleProperties) {
+            store.registerProperty(config);
+        }
+    }
+
+    static VehiclePropValue newInt32Value(int32_t prop, int32_t areaId, int32_t value,
+                                          int64_t timestamp = 0) {
+        VehiclePropValue propValue;
+        propValue.prop = prop;
+        propValue.areaId = areaId;
+        propValue.timestamp = timestamp;
+        propValue.value.int32Values = hidl_vec<int32_t>{value};
+        return propValue;
+    }
+
+    VehiclePropertyStore store;
+};
+
+TEST_F(VehiclePropertyStoreTest, writeAndReadValues) {
+    for (const auto& config : kVehicleProperties) {
+        ASSERT_TRUE(store.writeValue(newInt32Value(config.prop, 0, config.prop),
+                                     /*updateStatus=*/true));
+    }
+
+    for (const auto& config : kVehicleProperties) {
+        auto value = store.readValueOrNull(config.prop);
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(config.prop, value->value.int32Values[0]);
+    }
+    ASSERT_EQ(sizeof(kVehicleProperties) / sizeof(kVehicleProperties[0]),
+              store.readAllValues().size());
+}
+
+TEST_F(VehiclePropertyStoreTest, writeValueNotRegistered) {
+    ASSERT_FALSE(store.writeValue(newInt32Value(toInt(VehicleProperty::INVALID), 0, 1),
+                                  /*updateStatus=*/true));
+    ASSERT_EQ(nullptr, store.readValueOrNull(toInt(VehicleProperty::INVALID)));
+}
+
+TEST_F(VehiclePropertyStoreTest, writeOutdatedValue) {
+    int32_t prop = toInt(VehicleProperty::HVAC_FAN_SPEED);
+    int32_t areaId = toInt(VehicleAreaSeat::ROW_1_LEFT);
+    ASSERT_TRUE(store.writeValue(newInt32Value(prop, areaId, 1, /*timestamp=*/2),
+                                 /*updateStatus=*/true));
+
+    ASSERT_FALSE(store.writeValue(newInt32Value(prop, areaId, 2, /*timestamp=*/1),
+                                  /*updateStatus=*/true));
+    ASSERT_EQ(1, store.readValueOrNull(prop, areaId)->value.int32Values[0]);
+}
+
+TEST_F(VehiclePropertyStoreTest, readAndRemoveValuesForProperty) {
+    int32_t prop = toInt(VehicleProperty::HVAC_FAN_SPEED);
+    int32_t otherProp = toInt(VehicleProperty::DISPLAY_BRIGHTNESS);
+    ASSERT_TRUE(store.writeValue(newInt32Value(prop, toInt(VehicleAreaSeat::ROW_1_LEFT), 1),
+                                 /*updateStatus=*/true));
+    ASSERT_TRUE(store.writeValue(newInt32Value(prop, toInt(VehicleAreaSeat::ROW_1_RIGHT), 2),
+                                 /*updateStatus=*/true));
+    ASSERT_TRUE(store.writeValue(newInt32Value(otherProp, 0, 3), /*updateStatus=*/true));
+
+    ASSERT_EQ(2u, store.readValuesForProperty(prop).size());
+
+    store.removeValuesForProperty(prop);
+
+    ASSERT_TRUE(store.readValuesForProperty(prop).empty());
+    ASSERT_EQ(1u, store.readValuesForProperty(otherProp).size());
+}
+
+TEST_F(VehiclePropertyStoreTest, concurrentWritesToDifferentProperties) {
+    std::vector<std::thread> threads;
+    for (const auto& config : kVehicleProperties) {
+        int32_t prop = config.prop;
+        threads.emplace_back([this, prop] {
+            for (int32_t i = 0; i < 100; i++) {
+                VehiclePropValue value = newInt32Value(prop, 0, i);
+                store.writeValueWithCurrentTimestamp(&value, /*updateStatus=*/true);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& config : kVehicleProperties) {
+        auto value = store.readValueOrNull(config.prop);
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(99, value->value.int32Values[0]);
+    }
+}
+
+}  // namespace anonymous
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -601,6 +601,122 @@ TEST(VmsUtilsTest, availableLayersForMalformedResponse) {
     testGetAvailableLayersMalformedData(VmsMessageType::AVAILABILITY_RESPONSE);
 }
 
+TEST(VmsUtilsTest, availableLayersReusesOutput) {
+    auto message = createBaseVmsMessage(8);
+    message->value.int32Values = hidl_vec<int32_t>{toInt(VmsMessageType::AVAILABILITY_CHANGE),
+                                                   1234,  // sequence number
+                                                   1,     // number of associated layers
+                                                   1,     // associated layer
+                                                   0,           1,
+                                                   1,     // number of publisher IDs
+                                                   111};  // publisher IDs
+    std::vector<VmsAssociatedLayer> result = {
+            VmsAssociatedLayer(VmsLayer(3, 0, 1), {222, 333}),
+            VmsAssociatedLayer(VmsLayer(4, 0, 1), {444}),
+    };
+
+    getAvailableLayers(*message, &result);
+
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result[0].layer, VmsLayer(1, 0, 1));
+    EXPECT_EQ(result[0].publisher_ids, std::vector<int>({111}));
+
+    message->value.int32Values = hidl_vec<int32_t>{toInt(VmsMessageType::AVAILABILITY_CHANGE),
+                                                   1235};  // sequence number
+    getAvailableLayers(*message, &result);
+
+    EXPECT_TRUE(result.empty());
+}
+
+TEST(VmsUtilsTest, subscribedLayersReusesOutput) {
+    VmsOffers offers = {123, {VmsLayerOffering(VmsLayer(1, 0, 1))}};
+    auto message = createBaseVmsMessage(7);
+    message->value.int32Values = hidl_vec<int32_t>{toInt(VmsMessageType::SUBSCRIPTIONS_CHANGE),
+                                                   1234,  // sequence number
+                                                   1,     // number of layers
+                                                   0,     // number of associated layers
+                                                   1,     // layer 1
+                                                   0,           1};
+    std::vector<VmsLayer> result = {VmsLayer(2, 0, 1), VmsLayer(3, 0, 1)};
+
+    getSubscribedLayers(*message, offers, &result);
+
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result[0], VmsLayer(1, 0, 1));
+}
+
+TEST(VmsUtilsTest, parseDataView) {
+    const std::string bytes = "aaa";
+    const VmsLayerAndPublisher layer_and_publisher(VmsLayer(1, 0, 1), 123);
+    auto message = createDataMessageWithLayerPublisherInfo(layer_and_publisher, bytes);
+
+    std::string_view data = parseDataView(*message);
+
+    EXPECT_EQ(data, bytes);
+    EXPECT_EQ(reinterpret_cast<const uint8_t*>(data.data()), message->value.bytes.data());
+    EXPECT_TRUE(parseDataView(*createSubscribeMessage(VmsLayer(1, 0, 1))).empty());
+}
+
+TEST(VmsUtilsTest, pooledMessagesMatchMessages) {
+    VehiclePropValuePool pool(/* maxRecyclableVectorSize = */ 16);
+    const VmsLayer layer(1, 0, 2);
+    const VmsLayerAndPublisher layer_and_publisher(VmsLayer(2, 0, 1), 123);
+    const VmsOffers offers = {123,
+                              {VmsLayerOffering(VmsLayer(1, 0, 1), {VmsLayer(4, 1, 1)}),
+                               VmsLayerOffering(VmsLayer(2, 0, 1))}};
+
+    EXPECT_EQ(*createSubscribeMessage(&pool, layer), *createSubscribeMessage(layer));
+    EXPECT_EQ(*createUnsubscribeMessage(&pool, layer), *createUnsubscribeMessage(layer));
+    EXPECT_EQ(*createSubscribeToPublisherMessage(&pool, layer_and_publisher),
+              *createSubscribeToPublisherMessage(layer_and_publisher));
+    EXPECT_EQ(*createUnsubscribeToPublisherMessage(&pool, layer_and_publisher),
+              *createUnsubscribeToPublisherMessage(layer_and_publisher));
+    EXPECT_EQ(*createOfferingMessage(&pool, offers), *createOfferingMessage(offers));
+    EXPECT_EQ(*createStartSessionMessage(&pool, 123, 456), *createStartSessionMessage(123, 456));
+}
+
+TEST(VmsUtilsTest, pooledMessageIsRecycled) {
+    VehiclePropValuePool pool(/* maxRecyclableVectorSize = */ 16);
+    const VmsLayer layer(1, 0, 2);
+
+    auto message = createSubscribeMessage(&pool, layer);
+    message->timestamp = 1000;
+    VehiclePropValue* address = message.get();
+    message.reset();
+
+    message = createSubscribeMessage(&pool, layer);
+
+    EXPECT_EQ(message.get(), address);
+    EXPECT_EQ(message->timestamp, 0);
+    EXPECT_EQ(*message, *createSubscribeMessage(layer));
+}
+
+TEST(VmsUtilsTest, pooledDataMessages) {
+    VehiclePropValuePool pool(/* maxRecyclableVectorSize = */ 16);
+    const VmsLayerAndPublisher layer_and_publisher(VmsLayer(2, 0, 1), 123);
+    const std::vector<std::string> packets = {"aaa", "bb"};
+    std::vector<VehiclePropValuePool::RecyclableType> messages;
+
+    createDataMessagesWithLayerPublisherInfo(&pool, layer_and_publisher, packets, &messages);
+
+    ASSERT_EQ(messages.size(), packets.size());
+    for (size_t i = 0; i < packets.size(); i++) {
+        EXPECT_EQ(*messages[i],
+                  *createDataMessageWithLayerPublisherInfo(layer_and_publisher, packets[i]));
+        // The payload is not copied.
+        EXPECT_EQ(messages[i]->value.bytes.data(),
+                  reinterpret_cast<const uint8_t*>(packets[i].data()));
+    }
+
+    // The messages are recycled even though they carry a payload.
+    VehiclePropValue* address = messages[1].get();
+    messages.pop_back();
+    auto message = createSubscribeToPublisherMessage(&pool, layer_and_publisher);
+
+    EXPECT_EQ(message.get(), address);
+    EXPECT_EQ(message->value.bytes.size(), 0u);
+}
+
 }  // namespace
 
 }  // namespace vms
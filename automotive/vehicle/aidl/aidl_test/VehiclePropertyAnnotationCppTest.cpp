@@ -27,8 +27,8 @@ using aidl_vehicle::ChangeModeForVehicleProperty;
 using aidl_vehicle::VehicleProperty;
 
 namespace {
-    template<class T>
-    bool doesAnnotationMapContainsAllProps(std::unordered_map<VehicleProperty, T> annotationMap) {
+    template<class AnnotationMap>
+    bool doesAnnotationMapContainsAllProps(const AnnotationMap& annotationMap) {
         for (const VehicleProperty& v : ::ndk::enum_range<VehicleProperty>()) {
             std::string name = aidl_vehicle::toString(v);
             if (name == "INVALID") {
@@ -54,3 +54,16 @@ TEST(VehiclePropertyAnnotationCppTest, testAccess) {
             << "Outdated annotation-generated AIDL files. Please run "
             << "generate_annotation_enums.py to update.";
 }
+
+TEST(VehiclePropertyAnnotationCppTest, testFind) {
+    for (const auto& entry : AccessForVehicleProperty) {
+        ASSERT_EQ(AccessForVehicleProperty.find(entry.first), &entry)
+                << "Failed to find property: " << aidl_vehicle::toString(entry.first);
+    }
+    for (const auto& entry : ChangeModeForVehicleProperty) {
+        ASSERT_EQ(ChangeModeForVehicleProperty.find(entry.first), &entry)
+                << "Failed to find property: " << aidl_vehicle::toString(entry.first);
+    }
+    ASSERT_EQ(AccessForVehicleProperty.find(VehicleProperty::INVALID),
+              AccessForVehicleProperty.end());
+}
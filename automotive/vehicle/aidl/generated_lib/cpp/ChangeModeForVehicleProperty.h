@@ -27,7 +27,7 @@
 #include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
 #include <aidl/android/hardware/automotive/vehicle/VehiclePropertyChangeMode.h>
 
-#include <unordered_map>
+#include "VehiclePropertyAnnotationTable.h"
 
 namespace aidl {
 namespace android {
@@ -35,7 +35,7 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-std::unordered_map<VehicleProperty, VehiclePropertyChangeMode> ChangeModeForVehicleProperty = {
+inline constexpr auto ChangeModeForVehicleProperty = makeVehiclePropertyAnnotationTable<VehiclePropertyChangeMode>({
         {VehicleProperty::INFO_VIN, VehiclePropertyChangeMode::STATIC},
         {VehicleProperty::INFO_MAKE, VehiclePropertyChangeMode::STATIC},
         {VehicleProperty::INFO_MODEL, VehiclePropertyChangeMode::STATIC},
@@ -302,7 +302,7 @@ std::unordered_map<VehicleProperty, VehiclePropertyChangeMode> ChangeModeForVehi
         {VehicleProperty::CROSS_TRAFFIC_MONITORING_WARNING_STATE, VehiclePropertyChangeMode::ON_CHANGE},
         {VehicleProperty::LOW_SPEED_AUTOMATIC_EMERGENCY_BRAKING_ENABLED, VehiclePropertyChangeMode::ON_CHANGE},
         {VehicleProperty::LOW_SPEED_AUTOMATIC_EMERGENCY_BRAKING_STATE, VehiclePropertyChangeMode::ON_CHANGE},
-};
+});
 
 }  // namespace vehicle
 }  // namespace automotive
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
+
+#include <array>
+#include <cstddef>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// An entry of a VehiclePropertyAnnotationTable, named like a std::pair so that lookups read the
+// same as they do on a map.
+template <class T>
+struct VehiclePropertyAnnotation {
+    VehicleProperty first;
+    T second;
+};
+
+// A read-only map from VehicleProperty to one of its annotations, used by the headers generated
+// by tools/generate_annotation_enums.py.
+//
+// The entries are sorted by property ID when the table is built, which happens at compile time
+// for a constexpr table, so there is neither static initialization nor heap allocation. find()
+// is a binary search whose number of steps only depends on the size of the table and not on the
+// property looked up.
+template <class T, size_t N>
+class VehiclePropertyAnnotationTable {
+  public:
+    using value_type = VehiclePropertyAnnotation<T>;
+    using const_iterator = const value_type*;
+
+    static_assert(N > 0, "annotation table must not be empty");
+
+    constexpr explicit VehiclePropertyAnnotationTable(const value_type (&entries)[N])
+        : mEntries(sortEntries(entries)) {}
+
+    constexpr const_iterator begin() const { return mEntries.data(); }
+    constexpr const_iterator end() const { return mEntries.data() + N; }
+    constexpr size_t size() const { return N; }
+
+    // Returns the entry for the property, or end() if the property has no annotation.
+    constexpr const_iterator find(VehicleProperty property) const {
+        const_iterator base = begin();
+        size_t length = N;
+        while (length > 1) {
+            const size_t half = length / 2;
+            base = (base[half - 1].first < property) ? base + half : base;
+            length -= half;
+        }
+        if (base->first < property) {
+            base++;
+        }
+        return (base != end() && base->first == property) ? base : end();
+    }
+
+    constexpr size_t count(VehicleProperty property) const {
+        return find(property) == end() ? 0 : 1;
+    }
+
+  private:
+    // Insertion sort, the tables are small and this only runs once, at compile time.
+    static constexpr std::array<value_type, N> sortEntries(const value_type (&entries)[N]) {
+        std::array<value_type, N> sorted{};
+        for (size_t i = 0; i < N; i++) {
+            size_t j = i;
+            for (; j > 0 && entries[i].first < sorted[j - 1].first; j--) {
+                sorted[j] = sorted[j - 1];
+            }
+            sorted[j] = entries[i];
+        }
+        return sorted;
+    }
+
+    std::array<value_type, N> mEntries;
+};
+
+template <class T, size_t N>
+constexpr VehiclePropertyAnnotationTable<T, N> makeVehiclePropertyAnnotationTable(
+        const VehiclePropertyAnnotation<T> (&entries)[N]) {
+    return VehiclePropertyAnnotationTable<T, N>(entries);
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
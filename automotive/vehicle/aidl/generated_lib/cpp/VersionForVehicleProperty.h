@@ -26,7 +26,7 @@
 
 #include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
 
-#include <unordered_map>
+#include "VehiclePropertyAnnotationTable.h"
 
 namespace aidl {
 namespace android {
@@ -34,7 +34,7 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-std::unordered_map<VehicleProperty, int32_t> VersionForVehicleProperty = {
+inline constexpr auto VersionForVehicleProperty = makeVehiclePropertyAnnotationTable<int32_t>({
         {VehicleProperty::INFO_VIN, 2},
         {VehicleProperty::INFO_MAKE, 2},
         {VehicleProperty::INFO_MODEL, 2},
@@ -301,7 +301,7 @@ std::unordered_map<VehicleProperty, int32_t> VersionForVehicleProperty = {
         {VehicleProperty::CROSS_TRAFFIC_MONITORING_WARNING_STATE, 3},
         {VehicleProperty::LOW_SPEED_AUTOMATIC_EMERGENCY_BRAKING_ENABLED, 3},
         {VehicleProperty::LOW_SPEED_AUTOMATIC_EMERGENCY_BRAKING_STATE, 3},
-};
+});
 
 }  // namespace vehicle
 }  // namespace automotive
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_ConfigCache_H_
+#define android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_ConfigCache_H_
+
+#include <ConfigDeclaration.h>
+
+#include <android-base/result.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// A binary cache for the parsed property config declarations.
+//
+// Parsing the JSON config files is slow, so the parsed result could be stored in a binary cache
+// file, which is memory mapped and deserialized directly at the following loads. The cache file is
+// tied to the JSON config file it is created from, it is considered stale and ignored if the size
+// or the modification time of the JSON config file changes.
+class ConfigCache final {
+  public:
+    // Reads the config declarations from the cache file for the JSON config file at
+    // {@code sourcePath}. Returns error if the cache does not exist, is stale or is malformed.
+    static android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> read(
+            const std::string& cachePath, const std::string& sourcePath);
+
+    // Writes the config declarations parsed from the JSON config file at {@code sourcePath} to
+    // the cache file. The cache file is replaced atomically.
+    static android::base::Result<void> write(
+            const std::string& cachePath, const std::string& sourcePath,
+            const std::unordered_map<int32_t, ConfigDeclaration>& configsByPropId);
+
+  private:
+    // "VHCC" in little endian.
+    static constexpr uint32_t MAGIC = 0x43434856;
+    // Must be increased whenever the cache format or ConfigDeclaration changes.
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        int64_t sourceSize;
+        int64_t sourceMtimeInNanos;
+        uint64_t payloadSize;
+    };
+
+    static android::base::Result<Header> getSourceHeader(const std::string& sourcePath);
+};
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_default_config_JsonConfigLoader_include_ConfigCache_H_
@@ -161,6 +161,11 @@ class JsonConfigLoader final {
     android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> loadPropConfig(
             const std::string& configPath);
 
+    // Same as above, but uses the binary config cache at {@code cachePath} if it is valid for the
+    // config file. Otherwise parses the JSON config file and writes the cache for the next load.
+    android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>> loadPropConfig(
+            const std::string& configPath, const std::string& cachePath);
+
   private:
     std::unique_ptr<jsonconfigloader_impl::JsonConfigParser> mParser;
 };
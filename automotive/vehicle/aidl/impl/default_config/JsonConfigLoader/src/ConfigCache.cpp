@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ConfigCache.h>
+
+#include <android-base/file.h>
+#include <android-base/scopeguard.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_auto_utils.h>
+#include <android/binder_parcel.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
+using ::android::base::Error;
+using ::android::base::ErrnoError;
+using ::android::base::make_scope_guard;
+using ::android::base::Result;
+using ::android::base::unique_fd;
+using ::ndk::ScopedAParcel;
+
+binder_status_t writeConfigDeclaration(AParcel* parcel, const ConfigDeclaration& declaration) {
+    if (binder_status_t status = declaration.config.writeToParcel(parcel); status != STATUS_OK) {
+        return status;
+    }
+    if (binder_status_t status = declaration.initialValue.writeToParcel(parcel);
+        status != STATUS_OK) {
+        return status;
+    }
+    if (binder_status_t status = AParcel_writeInt32(
+                parcel, static_cast<int32_t>(declaration.initialAreaValues.size()));
+        status != STATUS_OK) {
+        return status;
+    }
+    for (const auto& [areaId, value] : declaration.initialAreaValues) {
+        if (binder_status_t status = AParcel_writeInt32(parcel, areaId); status != STATUS_OK) {
+            return status;
+        }
+        if (binder_status_t status = value.writeToParcel(parcel); status != STATUS_OK) {
+            return status;
+        }
+    }
+    return STATUS_OK;
+}
+
+binder_status_t readConfigDeclaration(const AParcel* parcel, ConfigDeclaration* declaration) {
+    if (binder_status_t status = declaration->config.readFromParcel(parcel); status != STATUS_OK) {
+        return status;
+    }
+    if (binder_status_t status = declaration->initialValue.readFromParcel(parcel);
+        status != STATUS_OK) {
+        return status;
+    }
+    int32_t areaCount = 0;
+    if (binder_status_t status = AParcel_readInt32(parcel, &areaCount); status != STATUS_OK) {
+        return status;
+    }
+    for (int32_t i = 0; i < areaCount; i++) {
+        int32_t areaId = 0;
+        if (binder_status_t status = AParcel_readInt32(parcel, &areaId); status != STATUS_OK) {
+            return status;
+        }
+        RawPropValues value;
+        if (binder_status_t status = value.readFromParcel(parcel); status != STATUS_OK) {
+            return status;
+        }
+        declaration->initialAreaValues[areaId] = std::move(value);
+    }
+    return STATUS_OK;
+}
+
+}  // namespace
+
+Result<ConfigCache::Header> ConfigCache::getSourceHeader(const std::string& sourcePath) {
+    struct stat sourceStat;
+    if (stat(sourcePath.c_str(), &sourceStat) != 0) {
+        return ErrnoError() << "failed to stat config file: " << sourcePath;
+    }
+    return Header{
+            .magic = MAGIC,
+            .version = VERSION,
+            .sourceSize = static_cast<int64_t>(sourceStat.st_size),
+            .sourceMtimeInNanos = static_cast<int64_t>(sourceStat.st_mtim.tv_sec) * 1'000'000'000 +
+                                  static_cast<int64_t>(sourceStat.st_mtim.tv_nsec),
+            .payloadSize = 0,
+    };
+}
+
+Result<std::unordered_map<int32_t, ConfigDeclaration>> ConfigCache::read(
+        const std::string& cachePath, const std::string& sourcePath) {
+    auto sourceHeader = getSourceHeader(sourcePath);
+    if (!sourceHeader.ok()) {
+        return sourceHeader.error();
+    }
+
+    unique_fd fd(TEMP_FAILURE_RETRY(open(cachePath.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd.get() < 0) {
+        return ErrnoError() << "failed to open config cache: " << cachePath;
+    }
+    struct stat cacheStat;
+    if (fstat(fd.get(), &cacheStat) != 0) {
+        return ErrnoError() << "failed to stat config cache: " << cachePath;
+    }
+    size_t cacheSize = static_cast<size_t>(cacheStat.st_size);
+    if (cacheSize < sizeof(Header)) {
+        return Error() << "config cache: " << cachePath << " is truncated";
+    }
+    void* addr = mmap(nullptr, cacheSize, PROT_READ, MAP_PRIVATE, fd.get(), /*offset=*/0);
+    if (addr == MAP_FAILED) {
+        return ErrnoError() << "failed to mmap config cache: " << cachePath;
+    }
+    auto unmapGuard = make_scope_guard([addr, cacheSize] { munmap(addr, cacheSize); });
+    const uint8_t* data = static_cast<const uint8_t*>(addr);
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (header.magic != MAGIC || header.version != VERSION) {
+        return Error() << "config cache: " << cachePath << " has unsupported format";
+    }
+    if (header.sourceSize != sourceHeader->sourceSize ||
+        header.sourceMtimeInNanos != sourceHeader->sourceMtimeInNanos) {
+        return Error() << "config cache: " << cachePath << " is stale for " << sourcePath;
+    }
+    if (header.payloadSize != cacheSize - sizeof(Header)) {
+        return Error() << "config cache: " << cachePath << " is truncated";
+    }
+
+    ScopedAParcel parcel(AParcel_create());
+    if (AParcel_unmarshal(parcel.get(), data + sizeof(Header), header.payloadSize) != STATUS_OK) {
+        return Error() << "failed to unmarshal config cache: " << cachePath;
+    }
+    AParcel_setDataPosition(parcel.get(), 0);
+
+    int32_t count = 0;
+    if (AParcel_readInt32(parcel.get(), &count) != STATUS_OK || count < 0) {
+        return Error() << "config cache: " << cachePath << " is malformed";
+    }
+    std::unordered_map<int32_t, ConfigDeclaration> configsByPropId;
+    configsByPropId.reserve(count);
+    for (int32_t i = 0; i < count; i++) {
+        ConfigDeclaration declaration;
+        if (readConfigDeclaration(parcel.get(), &declaration) != STATUS_OK) {
+            return Error() << "config cache: " << cachePath << " is malformed";
+        }
+        int32_t propId = declaration.config.prop;
+        configsByPropId[propId] = std::move(declaration);
+    }
+    return configsByPropId;
+}
+
+Result<void> ConfigCache::write(
+        const std::string& cachePath, const std::string& sourcePath,
+        const std::unordered_map<int32_t, ConfigDeclaration>& configsByPropId) {
+    auto header = getSourceHeader(sourcePath);
+    if (!header.ok()) {
+        return header.error();
+    }
+
+    ScopedAParcel parcel(AParcel_create());
+    if (AParcel_writeInt32(parcel.get(), static_cast<int32_t>(configsByPropId.size())) !=
+        STATUS_OK) {
+        return Error() << "failed to serialize property configs";
+    }
+    for (const auto& [_, declaration] : configsByPropId) {
+        if (writeConfigDeclaration(parcel.get(), declaration) != STATUS_OK) {
+            return Error() << "failed to serialize property configs";
+        }
+    }
+
+    size_t payloadSize = static_cast<size_t>(AParcel_getDataSize(parcel.get()));
+    header->payloadSize = payloadSize;
+    std::vector<uint8_t> buffer(sizeof(Header) + payloadSize);
+    memcpy(buffer.data(), &(header.value()), sizeof(Header));
+    if (AParcel_marshal(parcel.get(), buffer.data() + sizeof(Header), /*start=*/0, payloadSize) !=
+        STATUS_OK) {
+        return Error() << "failed to marshal property configs";
+    }
+
+    // Write to a temporary file first so that a partially written cache is never used.
+    std::string tmpPath = cachePath + ".tmp";
+    if (!android::base::WriteStringToFile(
+                std::string(reinterpret_cast<const char*>(buffer.data()), buffer.size()),
+                tmpPath)) {
+        return ErrnoError() << "failed to write config cache: " << tmpPath;
+    }
+    if (rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return ErrnoError() << "failed to rename config cache to: " << cachePath;
+    }
+    return {};
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
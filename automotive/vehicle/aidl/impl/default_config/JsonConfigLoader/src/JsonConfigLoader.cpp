@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "JsonConfigLoader"
+
 #include <JsonConfigLoader.h>
 
 #include <AccessForVehicleProperty.h>
 #include <ChangeModeForVehicleProperty.h>
+#include <ConfigCache.h>
 #include <PropertyUtils.h>
 
 #ifdef ENABLE_VEHICLE_HAL_TEST_PROPERTIES
@@ -25,6 +28,8 @@
 #endif  // ENABLE_VEHICLE_HAL_TEST_PROPERTIES
 
 #include <android-base/strings.h>
+#include <utils/Log.h>
+
 #include <fstream>
 
 namespace android {
@@ -617,12 +622,12 @@ std::optional<ConfigDeclaration> JsonConfigParser::parseEachProperty(
 
     configDecl.config.prop = propId;
     std::string propStr = propJsonValue["property"].toStyledString();
-    VehiclePropertyAccess* defaultAccessMode = NULL;
+    const VehiclePropertyAccess* defaultAccessMode = NULL;
     auto itAccess = AccessForVehicleProperty.find(static_cast<VehicleProperty>(propId));
     if (itAccess != AccessForVehicleProperty.end()) {
         defaultAccessMode = &itAccess->second;
     }
-    VehiclePropertyChangeMode* defaultChangeMode = NULL;
+    const VehiclePropertyChangeMode* defaultChangeMode = NULL;
     auto itChangeMode = ChangeModeForVehicleProperty.find(static_cast<VehicleProperty>(propId));
     if (itChangeMode != ChangeModeForVehicleProperty.end()) {
         defaultChangeMode = &itChangeMode->second;
@@ -716,6 +721,25 @@ JsonConfigLoader::loadPropConfig(const std::string& configPath) {
     return loadPropConfig(ifs);
 }
 
+android::base::Result<std::unordered_map<int32_t, ConfigDeclaration>>
+JsonConfigLoader::loadPropConfig(const std::string& configPath, const std::string& cachePath) {
+    if (auto cacheResult = ConfigCache::read(cachePath, configPath); cacheResult.ok()) {
+        return cacheResult;
+    }
+
+    auto result = loadPropConfig(configPath);
+    if (!result.ok()) {
+        return result;
+    }
+    if (auto writeResult = ConfigCache::write(cachePath, configPath, result.value());
+        !writeResult.ok()) {
+        // The cache is only an optimization, failing to write it is not an error.
+        ALOGW("failed to write config cache for %s, error: %s", configPath.c_str(),
+              writeResult.error().message().c_str());
+    }
+    return result;
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
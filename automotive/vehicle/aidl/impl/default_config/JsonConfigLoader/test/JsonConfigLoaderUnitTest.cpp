@@ -14,11 +14,14 @@
  * limitations under the License.
  */
 
+#include <ConfigCache.h>
 #include <JsonConfigLoader.h>
 
 #include <PropertyUtils.h>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
 #include <sstream>
 
 namespace android {
@@ -803,6 +806,87 @@ TEST_F(JsonConfigLoaderUnitTest, testAccess_areaOverrideGlobal) {
     ASSERT_EQ(areaConfig2.areaId, 1);
 }
 
+TEST_F(JsonConfigLoaderUnitTest, testLoadPropConfigWithCache) {
+    TemporaryDir tempDir;
+    std::string configPath = std::string(tempDir.path) + "/config.json";
+    std::string cachePath = std::string(tempDir.path) + "/config.cache";
+    ASSERT_TRUE(android::base::WriteStringToFile(R"(
+    {
+        "properties": [{
+            "property": "VehicleProperty::INFO_FUEL_CAPACITY",
+            "defaultValue": {
+                "floatValues": [1.0]
+            },
+            "areas": [{
+                "areaId": 0,
+                "defaultValue": {
+                    "floatValues": [2.0]
+                }
+            }]
+        }]
+    }
+    )",
+                                                 configPath));
+
+    auto result = mLoader.loadPropConfig(configPath, cachePath);
+    ASSERT_TRUE(result.ok()) << result.error().message();
+
+    struct stat cacheStat;
+    ASSERT_EQ(stat(cachePath.c_str(), &cacheStat), 0) << "config cache must be created";
+
+    auto cacheResult = ConfigCache::read(cachePath, configPath);
+    ASSERT_TRUE(cacheResult.ok()) << cacheResult.error().message();
+    ASSERT_EQ(cacheResult.value(), result.value());
+
+    auto cachedLoadResult = mLoader.loadPropConfig(configPath, cachePath);
+    ASSERT_TRUE(cachedLoadResult.ok()) << cachedLoadResult.error().message();
+    ASSERT_EQ(cachedLoadResult.value(), result.value());
+}
+
+TEST_F(JsonConfigLoaderUnitTest, testLoadPropConfigWithStaleCache) {
+    TemporaryDir tempDir;
+    std::string configPath = std::string(tempDir.path) + "/config.json";
+    std::string cachePath = std::string(tempDir.path) + "/config.cache";
+    ASSERT_TRUE(android::base::WriteStringToFile(R"(
+    {
+        "properties": [{
+            "property": 291504388
+        }]
+    }
+    )",
+                                                 configPath));
+    ASSERT_TRUE(mLoader.loadPropConfig(configPath, cachePath).ok());
+
+    // Update the config file, the cache must not be used.
+    ASSERT_TRUE(android::base::WriteStringToFile(R"(
+    {
+        "properties": [{
+            "property": 291504388
+        },
+        {
+            "property": 291504389
+        }]
+    }
+    )",
+                                                 configPath));
+
+    ASSERT_FALSE(ConfigCache::read(cachePath, configPath).ok()) << "cache must be stale";
+
+    auto result = mLoader.loadPropConfig(configPath, cachePath);
+    ASSERT_TRUE(result.ok()) << result.error().message();
+    ASSERT_EQ(result.value().size(), 2u);
+}
+
+TEST_F(JsonConfigLoaderUnitTest, testReadConfigCacheMalformed) {
+    TemporaryDir tempDir;
+    std::string configPath = std::string(tempDir.path) + "/config.json";
+    std::string cachePath = std::string(tempDir.path) + "/config.cache";
+    ASSERT_TRUE(android::base::WriteStringToFile("{}", configPath));
+    ASSERT_TRUE(android::base::WriteStringToFile("not a config cache", cachePath));
+
+    ASSERT_FALSE(ConfigCache::read(cachePath, configPath).ok());
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -19,12 +19,14 @@
 
 #include "FakeValueGenerator.h"
 
+#include <ConcurrentQueue.h>
 #include <android-base/thread_annotations.h>
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -41,12 +43,18 @@ namespace fake {
 // queue to maintain generated events ordered by timestamp. The scheduler uses a single thread to
 // keep querying and updating the event queue to make sure events from all generators are produced
 // in order.
+//
+// By default the events are delivered on the scheduler thread. If {@code workerCount} is larger
+// than 0, the events are instead delivered on a pool of worker threads so that a slow event
+// handler does not delay the following events. Events for the same property are always delivered
+// on the same worker in timestamp order, but events for different properties may be delivered
+// out of order.
 class GeneratorHub {
   public:
     using OnHalEvent = std::function<void(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& event)>;
 
-    explicit GeneratorHub(OnHalEvent&& onHalEvent);
+    explicit GeneratorHub(OnHalEvent&& onHalEvent, size_t workerCount = 0);
     ~GeneratorHub();
 
     // Register a new generator. The generator will be discarded if it could not produce next event.
@@ -54,7 +62,8 @@ class GeneratorHub {
     void registerGenerator(int32_t generatorId, std::unique_ptr<FakeValueGenerator> generator);
 
     // Unregister a generator with the generatorId. If no registered generator is found, this
-    // function does nothing. Returns true if the generator is unregistered.
+    // function does nothing. Returns true if the generator is unregistered. If worker threads are
+    // used, events already dispatched to the workers might still be delivered after this returns.
     bool unregisterGenerator(int32_t generatorId);
 
   private:
@@ -75,6 +84,10 @@ class GeneratorHub {
     std::unordered_map<int32_t, std::unique_ptr<FakeValueGenerator>> mGenerators
             GUARDED_BY(mGeneratorsLock);
     OnHalEvent mOnHalEvent;
+    // Only set if events are delivered on worker threads.
+    std::unique_ptr<
+            AffinityWorkerPool<aidl::android::hardware::automotive::vehicle::VehiclePropValue>>
+            mEventWorkers;
     std::condition_variable mCond;
     std::thread mThread;
     std::atomic<bool> mShuttingDownFlag{false};
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_fake_impl_GeneratorHub_include_RecordingFakeValueGenerator_H_
+#define android_hardware_automotive_vehicle_aidl_impl_fake_impl_GeneratorHub_include_RecordingFakeValueGenerator_H_
+
+#include "FakeValueGenerator.h"
+
+#include <android-base/result.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace fake {
+
+// A fake value generator that replays a binary recording file.
+//
+// Unlike JsonFakeValueGenerator, which parses the whole JSON file into memory, the recording file
+// is memory mapped and each event is decoded only when it is generated, so a long recording could
+// be replayed with constant memory. A recording file is created from a JSON file in the
+// JsonFakeValueGenerator format using {@code convertFromJson}.
+//
+// Events are replayed in the order of their recorded timestamp, with the same interval as their
+// recorded timestamps, divided by the playback speed.
+//
+// This class is not thread-safe. {@code seek} and {@code setPlaybackSpeed} must be called before
+// the generator is registered to GeneratorHub.
+class RecordingFakeValueGenerator : public FakeValueGenerator {
+  public:
+    // Create a new recording fake value generator using the specified recording file path. All the
+    // events in the file would be generated for number of {@code iteration}. If iteration is 0, no
+    // value would be generated. If iteration is less than 0, it would iterate indefinitely.
+    RecordingFakeValueGenerator(const std::string& path, int32_t iteration);
+
+    ~RecordingFakeValueGenerator();
+
+    RecordingFakeValueGenerator(const RecordingFakeValueGenerator&) = delete;
+    RecordingFakeValueGenerator& operator=(const RecordingFakeValueGenerator&) = delete;
+
+    // Converts the JSON file at {@code jsonPath} to a recording file at {@code recordingPath}.
+    static android::base::Result<void> convertFromJson(const std::string& jsonPath,
+                                                       const std::string& recordingPath);
+
+    // Writes the events to a recording file at {@code recordingPath}. The events are sorted by
+    // timestamp. The file is replaced atomically.
+    static android::base::Result<void> write(
+            std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> events,
+            const std::string& recordingPath);
+
+    std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValue> nextEvent()
+            override;
+
+    // Whether there are events left to replay for this generator.
+    bool hasNext() const;
+
+    size_t getEventCount() const;
+
+    // Moves to the first event that is recorded no earlier than {@code offsetInNanos} after the
+    // first event. The next event is generated immediately. Seeking past the last event ends the
+    // current iteration.
+    void seek(int64_t offsetInNanos);
+
+    // Sets the playback speed multiplier, must be larger than 0. For example, 2 means replaying
+    // the events twice as fast as they are recorded.
+    void setPlaybackSpeed(float speed);
+
+  private:
+    // "VHRC" in little endian.
+    static constexpr uint32_t MAGIC = 0x43524856;
+    // Must be increased whenever the recording format changes.
+    static constexpr uint32_t VERSION = 1;
+
+    // The recording file contains a Header, followed by the records and then an index of
+    // {@code eventCount} IndexEntry sorted by timestamp.
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t eventCount;
+        uint64_t indexOffset;
+    };
+
+    // Each record is a RecordHeader followed by the int32 values, the int64 values, the float
+    // values, the byte values and the string value.
+    struct RecordHeader {
+        int64_t timestamp;
+        int32_t prop;
+        int32_t areaId;
+        int32_t status;
+        uint32_t int32Count;
+        uint32_t int64Count;
+        uint32_t floatCount;
+        uint32_t byteCount;
+        uint32_t stringSize;
+    };
+
+    struct IndexEntry {
+        int64_t timestamp;
+        uint64_t offset;
+    };
+
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    size_t mEventCount = 0;
+    const uint8_t* mIndex = nullptr;
+    size_t mEventIndex = 0;
+    int64_t mLastEventTimestamp = 0;
+    int32_t mNumOfIterations = 0;
+    float mPlaybackSpeed = 1.0f;
+
+    android::base::Result<void> init(const std::string& path);
+    IndexEntry getIndexEntry(size_t index) const;
+    std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValue> readEvent(
+            size_t index) const;
+};
+
+}  // namespace fake
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_fake_impl_GeneratorHub_include_RecordingFakeValueGenerator_H_
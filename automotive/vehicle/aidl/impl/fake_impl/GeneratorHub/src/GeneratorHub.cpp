@@ -27,9 +27,19 @@ namespace automotive {
 namespace vehicle {
 namespace fake {
 
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
 using ::android::base::ScopedLockAssertion;
 
-GeneratorHub::GeneratorHub(OnHalEvent&& onHalEvent) : mOnHalEvent(onHalEvent) {
+GeneratorHub::GeneratorHub(OnHalEvent&& onHalEvent, size_t workerCount)
+    : mOnHalEvent(onHalEvent) {
+    if (workerCount > 0) {
+        mEventWorkers = std::make_unique<AffinityWorkerPool<VehiclePropValue>>(
+                workerCount, [this](std::vector<VehiclePropValue> events) {
+                    for (const auto& event : events) {
+                        mOnHalEvent(event);
+                    }
+                });
+    }
     mThread = std::thread(&GeneratorHub::run, this);
 }
 
@@ -45,6 +55,9 @@ GeneratorHub::~GeneratorHub() {
     if (mThread.joinable()) {
         mThread.join();
     }
+    if (mEventWorkers != nullptr) {
+        mEventWorkers->stop();
+    }
 }
 
 void GeneratorHub::registerGenerator(int32_t id, std::unique_ptr<FakeValueGenerator> generator) {
@@ -108,7 +121,12 @@ void GeneratorHub::run() {
             }
         }
         // Now it's time to handle current event.
-        mOnHalEvent(curEvent.val);
+        if (mEventWorkers != nullptr) {
+            mEventWorkers->push(static_cast<uint32_t>(curEvent.val.prop),
+                                VehiclePropValue(curEvent.val));
+        } else {
+            mOnHalEvent(curEvent.val);
+        }
         // Update queue by popping current event and producing next event from the same generator
         int32_t id = curEvent.generatorId;
         mEventQueue.pop();
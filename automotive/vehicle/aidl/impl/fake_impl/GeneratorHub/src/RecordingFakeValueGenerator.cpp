@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RecordingFakeValueGenerator"
+
+#include "RecordingFakeValueGenerator.h"
+
+#include "JsonFakeValueGenerator.h"
+
+#include <android-base/unique_fd.h>
+#include <utils/Log.h>
+#include <utils/SystemClock.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace fake {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyStatus;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using ::android::base::Error;
+using ::android::base::ErrnoError;
+using ::android::base::Result;
+using ::android::base::unique_fd;
+
+// The delay before starting another iteration.
+constexpr int64_t ITERATION_INTERVAL_IN_NANOS = 1'000'000;
+
+template <typename T>
+void writeArray(std::ofstream& ofs, const std::vector<T>& values) {
+    ofs.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+void readArray(const uint8_t** data, uint32_t count, std::vector<T>* values) {
+    values->resize(count);
+    if (count == 0) {
+        return;
+    }
+    memcpy(values->data(), *data, count * sizeof(T));
+    *data += count * sizeof(T);
+}
+
+}  // namespace
+
+RecordingFakeValueGenerator::RecordingFakeValueGenerator(const std::string& path,
+                                                         int32_t iteration) {
+    if (auto result = init(path); !result.ok()) {
+        ALOGE("%s: failed to load recording, error: %s", __func__,
+              result.error().message().c_str());
+        return;
+    }
+    mNumOfIterations = iteration;
+}
+
+RecordingFakeValueGenerator::~RecordingFakeValueGenerator() {
+    if (mData != nullptr) {
+        munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+}
+
+Result<void> RecordingFakeValueGenerator::init(const std::string& path) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd.get() < 0) {
+        return ErrnoError() << "failed to open recording: " << path;
+    }
+    struct stat fileStat;
+    if (fstat(fd.get(), &fileStat) != 0) {
+        return ErrnoError() << "failed to stat recording: " << path;
+    }
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    if (size < sizeof(Header)) {
+        return Error() << "recording: " << path << " is truncated";
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), /*offset=*/0);
+    if (addr == MAP_FAILED) {
+        return ErrnoError() << "failed to mmap recording: " << path;
+    }
+    mData = static_cast<const uint8_t*>(addr);
+    mSize = size;
+    // Records are mostly read in order, so read ahead aggressively and let the kernel drop the
+    // pages already replayed.
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    Header header;
+    memcpy(&header, mData, sizeof(Header));
+    if (header.magic != MAGIC || header.version != VERSION) {
+        return Error() << "recording: " << path << " has unsupported format";
+    }
+    if (header.indexOffset < sizeof(Header) || header.indexOffset > size ||
+        header.eventCount != (size - header.indexOffset) / sizeof(IndexEntry) ||
+        (size - header.indexOffset) % sizeof(IndexEntry) != 0) {
+        return Error() << "recording: " << path << " is malformed";
+    }
+    mIndex = mData + header.indexOffset;
+    mEventCount = static_cast<size_t>(header.eventCount);
+    return {};
+}
+
+Result<void> RecordingFakeValueGenerator::convertFromJson(const std::string& jsonPath,
+                                                          const std::string& recordingPath) {
+    JsonFakeValueGenerator jsonGenerator(jsonPath, /*iteration=*/1);
+    const auto& events = jsonGenerator.getAllEvents();
+    if (events.empty()) {
+        return Error() << "no valid events in JSON file: " << jsonPath;
+    }
+    return write(events, recordingPath);
+}
+
+Result<void> RecordingFakeValueGenerator::write(std::vector<VehiclePropValue> events,
+                                                const std::string& recordingPath) {
+    std::stable_sort(events.begin(), events.end(),
+                     [](const VehiclePropValue& lhs, const VehiclePropValue& rhs) {
+                         return lhs.timestamp < rhs.timestamp;
+                     });
+
+    // Write to a temporary file first so that a partially written recording is never used.
+    std::string tmpPath = recordingPath + ".tmp";
+    std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        return ErrnoError() << "failed to open recording: " << tmpPath;
+    }
+
+    Header header = {
+            .magic = MAGIC,
+            .version = VERSION,
+            .eventCount = events.size(),
+            .indexOffset = 0,
+    };
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+    std::vector<IndexEntry> index;
+    index.reserve(events.size());
+    uint64_t offset = sizeof(Header);
+    for (const auto& event : events) {
+        const auto& value = event.value;
+        RecordHeader recordHeader = {
+                .timestamp = event.timestamp,
+                .prop = event.prop,
+                .areaId = event.areaId,
+                .status = static_cast<int32_t>(event.status),
+                .int32Count = static_cast<uint32_t>(value.int32Values.size()),
+                .int64Count = static_cast<uint32_t>(value.int64Values.size()),
+                .floatCount = static_cast<uint32_t>(value.floatValues.size()),
+                .byteCount = static_cast<uint32_t>(value.byteValues.size()),
+                .stringSize = static_cast<uint32_t>(value.stringValue.size()),
+        };
+        index.push_back({
+                .timestamp = event.timestamp,
+                .offset = offset,
+        });
+        ofs.write(reinterpret_cast<const char*>(&recordHeader), sizeof(RecordHeader));
+        writeArray(ofs, value.int32Values);
+        writeArray(ofs, value.int64Values);
+        writeArray(ofs, value.floatValues);
+        writeArray(ofs, value.byteValues);
+        ofs.write(value.stringValue.data(), value.stringValue.size());
+        offset += sizeof(RecordHeader) + value.int32Values.size() * sizeof(int32_t) +
+                  value.int64Values.size() * sizeof(int64_t) +
+                  value.floatValues.size() * sizeof(float) + value.byteValues.size() +
+                  value.stringValue.size();
+    }
+
+    header.indexOffset = offset;
+    writeArray(ofs, index);
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    ofs.close();
+    if (!ofs) {
+        unlink(tmpPath.c_str());
+        return ErrnoError() << "failed to write recording: " << tmpPath;
+    }
+    if (rename(tmpPath.c_str(), recordingPath.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return ErrnoError() << "failed to rename recording to: " << recordingPath;
+    }
+    return {};
+}
+
+RecordingFakeValueGenerator::IndexEntry RecordingFakeValueGenerator::getIndexEntry(
+        size_t index) const {
+    IndexEntry entry;
+    memcpy(&entry, mIndex + index * sizeof(IndexEntry), sizeof(IndexEntry));
+    return entry;
+}
+
+std::optional<VehiclePropValue> RecordingFakeValueGenerator::readEvent(size_t index) const {
+    uint64_t recordsEnd = static_cast<uint64_t>(mIndex - mData);
+    uint64_t offset = getIndexEntry(index).offset;
+    if (offset < sizeof(Header) || offset > recordsEnd ||
+        recordsEnd - offset < sizeof(RecordHeader)) {
+        return std::nullopt;
+    }
+    RecordHeader recordHeader;
+    memcpy(&recordHeader, mData + offset, sizeof(RecordHeader));
+    uint64_t payloadSize = static_cast<uint64_t>(recordHeader.int32Count) * sizeof(int32_t) +
+                           static_cast<uint64_t>(recordHeader.int64Count) * sizeof(int64_t) +
+                           static_cast<uint64_t>(recordHeader.floatCount) * sizeof(float) +
+                           recordHeader.byteCount + recordHeader.stringSize;
+    if (recordsEnd - offset - sizeof(RecordHeader) < payloadSize) {
+        return std::nullopt;
+    }
+
+    VehiclePropValue event = {
+            .timestamp = recordHeader.timestamp,
+            .areaId = recordHeader.areaId,
+            .prop = recordHeader.prop,
+            .status = static_cast<VehiclePropertyStatus>(recordHeader.status),
+    };
+    auto& value = event.value;
+    const uint8_t* data = mData + offset + sizeof(RecordHeader);
+    readArray(&data, recordHeader.int32Count, &value.int32Values);
+    readArray(&data, recordHeader.int64Count, &value.int64Values);
+    readArray(&data, recordHeader.floatCount, &value.floatValues);
+    readArray(&data, recordHeader.byteCount, &value.byteValues);
+    value.stringValue.assign(reinterpret_cast<const char*>(data), recordHeader.stringSize);
+    return event;
+}
+
+std::optional<VehiclePropValue> RecordingFakeValueGenerator::nextEvent() {
+    if (!hasNext()) {
+        return std::nullopt;
+    }
+
+    auto maybeEvent = readEvent(mEventIndex);
+    if (!maybeEvent.has_value()) {
+        ALOGE("%s: recording is malformed at event: %zu, stop replaying", __func__, mEventIndex);
+        mNumOfIterations = 0;
+        return std::nullopt;
+    }
+
+    if (mLastEventTimestamp == 0) {
+        mLastEventTimestamp = elapsedRealtimeNano();
+    } else if (mEventIndex > 0) {
+        // All events (start from 2nd one) are supposed to happen in the future with a delay
+        // equals to the duration between previous and current event.
+        int64_t interval =
+                getIndexEntry(mEventIndex).timestamp - getIndexEntry(mEventIndex - 1).timestamp;
+        mLastEventTimestamp += static_cast<int64_t>(interval / mPlaybackSpeed);
+    } else {
+        // We are starting another iteration, immediately send the next event after 1ms.
+        mLastEventTimestamp += ITERATION_INTERVAL_IN_NANOS;
+    }
+
+    mEventIndex++;
+    if (mEventIndex == mEventCount) {
+        mEventIndex = 0;
+        if (mNumOfIterations > 0) {
+            mNumOfIterations--;
+        }
+    }
+    maybeEvent->timestamp = mLastEventTimestamp;
+    return maybeEvent;
+}
+
+bool RecordingFakeValueGenerator::hasNext() const {
+    return mNumOfIterations != 0 && mEventCount > 0;
+}
+
+size_t RecordingFakeValueGenerator::getEventCount() const {
+    return mEventCount;
+}
+
+void RecordingFakeValueGenerator::seek(int64_t offsetInNanos) {
+    if (mEventCount == 0) {
+        return;
+    }
+    int64_t targetTimestamp = getIndexEntry(0).timestamp + offsetInNanos;
+    // Binary search the first event no earlier than the target in the index.
+    size_t low = 0;
+    size_t high = mEventCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (getIndexEntry(mid).timestamp < targetTimestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    mEventIndex = low;
+    if (mEventIndex == mEventCount) {
+        mEventIndex = 0;
+        if (mNumOfIterations > 0) {
+            mNumOfIterations--;
+        }
+    }
+    mLastEventTimestamp = 0;
+}
+
+void RecordingFakeValueGenerator::setPlaybackSpeed(float speed) {
+    if (speed <= 0) {
+        ALOGE("%s: invalid playback speed: %f, ignored", __func__, speed);
+        return;
+    }
+    mPlaybackSpeed = speed;
+}
+
+}  // namespace fake
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -17,6 +17,7 @@
 #include <GeneratorHub.h>
 #include <JsonFakeValueGenerator.h>
 #include <LinearFakeValueGenerator.h>
+#include <RecordingFakeValueGenerator.h>
 #include <VehicleUtils.h>
 #include <android-base/file.h>
 #include <android-base/thread_annotations.h>
@@ -25,6 +26,7 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -52,6 +54,12 @@ class FakeVehicleHalValueGeneratorsTest : public ::testing::Test {
 
     GeneratorHub* getHub() { return mHub.get(); }
 
+    // Replaces the hub with one that delivers events on {@code workerCount} worker threads.
+    void useEventWorkers(size_t workerCount) {
+        mHub = std::make_unique<GeneratorHub>(
+                [this](const VehiclePropValue& event) { return onHalEvent(event); }, workerCount);
+    }
+
     std::vector<VehiclePropValue> getEvents() {
         std::scoped_lock<std::mutex> lockGuard(mEventsLock);
         return mEvents;
@@ -169,6 +177,38 @@ TEST_F(FakeVehicleHalValueGeneratorsTest, testUnregisterGeneratorStopGeneration)
             << "Must stop generating event after generator is unregistered";
 }
 
+TEST_F(FakeVehicleHalValueGeneratorsTest, testEventWorkersKeepOrderPerProperty) {
+    useEventWorkers(/*workerCount=*/4);
+
+    size_t propCount = 8;
+    size_t eventCountPerProp = 10;
+    int64_t timestamp = elapsedRealtimeNano();
+    std::map<int32_t, std::vector<VehiclePropValue>> expectedEventsByProp;
+    for (size_t i = 0; i < propCount; i++) {
+        auto generator = std::make_unique<TestFakeValueGenerator>();
+        std::vector<VehiclePropValue> events;
+        int32_t propId = static_cast<int32_t>(i);
+        for (size_t j = 0; j < eventCountPerProp; j++) {
+            events.push_back(VehiclePropValue{
+                    .prop = propId,
+                    // Generate 1 event every 1ms.
+                    .timestamp = timestamp + static_cast<int64_t>(1000000 * j),
+            });
+        }
+        generator->setEvents(events);
+        expectedEventsByProp[propId] = events;
+        getHub()->registerGenerator(propId, std::move(generator));
+    }
+
+    waitForEvents(propCount * eventCountPerProp);
+
+    std::map<int32_t, std::vector<VehiclePropValue>> eventsByProp;
+    for (const auto& event : getEvents()) {
+        eventsByProp[event.prop].push_back(event);
+    }
+    ASSERT_EQ(eventsByProp, expectedEventsByProp);
+}
+
 TEST_F(FakeVehicleHalValueGeneratorsTest, testLinerFakeValueGeneratorFloat) {
     std::unique_ptr<LinearFakeValueGenerator> generator =
             std::make_unique<LinearFakeValueGenerator>(toInt(VehicleProperty::PERF_VEHICLE_SPEED),
@@ -476,6 +516,114 @@ TEST_F(FakeVehicleHalValueGeneratorsTest, testJsonFakeValueGeneratorDifferentTyp
     EXPECT_EQ(events, expectedValues);
 }
 
+TEST_F(FakeVehicleHalValueGeneratorsTest, testRecordingFakeValueGeneratorFromJson) {
+    TemporaryDir tmpDir;
+    std::string recordingPath = std::string(tmpDir.path) + "/prop.vhalrec";
+    auto result =
+            RecordingFakeValueGenerator::convertFromJson(getTestFilePath("prop.json"), recordingPath);
+    ASSERT_TRUE(result.ok()) << "failed to convert JSON file: " << result.error().message();
+
+    JsonFakeValueGenerator jsonGenerator(getTestFilePath("prop.json"), 1);
+    std::vector<VehiclePropValue> expectedValues = jsonGenerator.getAllEvents();
+    for (auto& value : expectedValues) {
+        value.timestamp = 0;
+    }
+    // We have two iterations.
+    for (size_t i = 0; i < 4; i++) {
+        expectedValues.push_back(expectedValues[i]);
+    }
+
+    int64_t currentTime = elapsedRealtimeNano();
+    auto generator = std::make_unique<RecordingFakeValueGenerator>(recordingPath, 2);
+    ASSERT_EQ(generator->getEventCount(), 4u);
+    getHub()->registerGenerator(0, std::move(generator));
+
+    waitForEvents(expectedValues.size());
+    auto events = getEvents();
+
+    int64_t lastEventTime = currentTime;
+    for (auto& event : events) {
+        EXPECT_GT(event.timestamp, lastEventTime);
+        lastEventTime = event.timestamp;
+        event.timestamp = 0;
+    }
+
+    EXPECT_EQ(events, expectedValues);
+}
+
+TEST_F(FakeVehicleHalValueGeneratorsTest, testRecordingFakeValueGeneratorDifferentTypes) {
+    TemporaryDir tmpDir;
+    std::string recordingPath = std::string(tmpDir.path) + "/prop.vhalrec";
+    auto result = RecordingFakeValueGenerator::convertFromJson(
+            getTestFilePath("prop_different_types.json"), recordingPath);
+    ASSERT_TRUE(result.ok()) << "failed to convert JSON file: " << result.error().message();
+
+    JsonFakeValueGenerator jsonGenerator(getTestFilePath("prop_different_types.json"), 1);
+    const auto& expectedValues = jsonGenerator.getAllEvents();
+    RecordingFakeValueGenerator generator(recordingPath, 1);
+
+    ASSERT_EQ(generator.getEventCount(), expectedValues.size());
+    for (const auto& expectedValue : expectedValues) {
+        auto event = generator.nextEvent();
+        ASSERT_TRUE(event.has_value());
+        event->timestamp = expectedValue.timestamp;
+        EXPECT_EQ(event.value(), expectedValue);
+    }
+    ASSERT_FALSE(generator.hasNext());
+    ASSERT_FALSE(generator.nextEvent().has_value());
+}
+
+TEST_F(FakeVehicleHalValueGeneratorsTest, testRecordingFakeValueGeneratorSeekAndSpeed) {
+    TemporaryDir tmpDir;
+    std::string recordingPath = std::string(tmpDir.path) + "/prop.vhalrec";
+    std::vector<VehiclePropValue> events;
+    // Write the events out of order, they must be replayed by timestamp.
+    for (int32_t i = 9; i >= 0; i--) {
+        events.push_back(VehiclePropValue{
+                .timestamp = 10'000'000 * static_cast<int64_t>(i),
+                .prop = toInt(VehicleProperty::GEAR_SELECTION),
+                .value.int32Values = {i},
+        });
+    }
+    ASSERT_TRUE(RecordingFakeValueGenerator::write(events, recordingPath).ok());
+
+    RecordingFakeValueGenerator generator(recordingPath, 1);
+    generator.setPlaybackSpeed(2.0);
+    // Start from the 6th event, which is the first one no earlier than 45ms.
+    generator.seek(45'000'000);
+
+    std::vector<VehiclePropValue> generatedEvents;
+    while (generator.hasNext()) {
+        auto event = generator.nextEvent();
+        ASSERT_TRUE(event.has_value());
+        generatedEvents.push_back(event.value());
+    }
+
+    ASSERT_EQ(generatedEvents.size(), 5u);
+    for (size_t i = 0; i < generatedEvents.size(); i++) {
+        EXPECT_EQ(generatedEvents[i].value.int32Values,
+                  std::vector<int32_t>({5 + static_cast<int32_t>(i)}));
+        if (i > 0) {
+            // The recorded interval is 10ms, replayed twice as fast.
+            EXPECT_EQ(generatedEvents[i].timestamp - generatedEvents[i - 1].timestamp, 5'000'000);
+        }
+    }
+}
+
+TEST_F(FakeVehicleHalValueGeneratorsTest, testRecordingFakeValueGeneratorInvalidFile) {
+    RecordingFakeValueGenerator generator(getTestFilePath("prop.json"), 1);
+
+    ASSERT_EQ(generator.getEventCount(), 0u);
+    ASSERT_FALSE(generator.hasNext());
+    ASSERT_FALSE(generator.nextEvent().has_value());
+}
+
+TEST_F(FakeVehicleHalValueGeneratorsTest, testRecordingFakeValueGeneratorNonExistingFile) {
+    RecordingFakeValueGenerator generator("non_existing_file", 1);
+
+    ASSERT_FALSE(generator.hasNext());
+}
+
 }  // namespace fake
 }  // namespace vehicle
 }  // namespace automotive
@@ -56,6 +56,14 @@ class FakeVehicleHardware : public IVehicleHardware {
     FakeVehicleHardware(std::string defaultConfigDir, std::string overrideConfigDir,
                         bool forceOverride);
 
+    // Same as above, but uses {@code workerCount} threads to handle get/set value requests and
+    // generated events instead of reading it from system property. Requests and events for the
+    // same property are always handled in order by the same thread. If {@code workerCount} is 1,
+    // all the requests are handled in order and generated events are delivered on the generator
+    // thread.
+    FakeVehicleHardware(std::string defaultConfigDir, std::string overrideConfigDir,
+                        bool forceOverride, size_t workerCount);
+
     ~FakeVehicleHardware();
 
     // Get all the property configs.
@@ -127,10 +135,12 @@ class FakeVehicleHardware : public IVehicleHardware {
         std::shared_ptr<const CallbackType> callback;
     };
 
+    // Handles the requests on {@code workerCount} threads. Requests for the same property are
+    // always handled by the same thread in the order they are added.
     template <class CallbackType, class RequestType>
     class PendingRequestHandler {
       public:
-        PendingRequestHandler(FakeVehicleHardware* hardware);
+        PendingRequestHandler(FakeVehicleHardware* hardware, size_t workerCount);
 
         void addRequest(RequestType request, std::shared_ptr<const CallbackType> callback);
 
@@ -138,10 +148,9 @@ class FakeVehicleHardware : public IVehicleHardware {
 
       private:
         FakeVehicleHardware* mHardware;
-        std::thread mThread;
-        ConcurrentQueue<RequestWithCallback<CallbackType, RequestType>> mRequests;
+        AffinityWorkerPool<RequestWithCallback<CallbackType, RequestType>> mWorkers;
 
-        void handleRequestsOnce();
+        void handleRequests(std::vector<RequestWithCallback<CallbackType, RequestType>> requests);
     };
 
     struct RefreshInfo {
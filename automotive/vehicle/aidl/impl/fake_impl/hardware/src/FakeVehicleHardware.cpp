@@ -23,6 +23,7 @@
 #include <FakeObd2Frame.h>
 #include <JsonFakeValueGenerator.h>
 #include <LinearFakeValueGenerator.h>
+#include <RecordingFakeValueGenerator.h>
 #include <PropertyUtils.h>
 #include <VehicleHalTypes.h>
 #include <VehicleUtils.h>
@@ -39,6 +40,7 @@
 #include <dirent.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <regex>
 #include <unordered_set>
 #include <vector>
@@ -121,6 +123,14 @@ constexpr char GRPC_SERVICE_CONFIG_FILE[] = "/vendor/etc/automotive/powercontrol
 // overwrite the default configs.
 constexpr char OVERRIDE_PROPERTY[] = "persist.vendor.vhal_init_value_override";
 constexpr char POWER_STATE_REQ_CONFIG_PROPERTY[] = "ro.vendor.fake_vhal.ap_power_state_req.config";
+// If CONFIG_CACHE_DIR_PROPERTY is set, the parsed configuration files are cached in binary format
+// in this directory to speed up the following boots.
+constexpr char CONFIG_CACHE_DIR_PROPERTY[] = "ro.vendor.fake_vhal.config_cache_dir";
+// The number of threads used to handle get/set value requests and generated events. Requests and
+// events for the same property are always handled by the same thread, but the ones for different
+// properties are handled concurrently, so the order between them is not kept if this is larger
+// than 1. Defaults to 1, which handles all the requests in order.
+constexpr char WORKER_COUNT_PROPERTY[] = "ro.vendor.fake_vhal.worker_count";
 // The value to be returned if VENDOR_PROPERTY_FOR_ERROR_CODE_TESTING is set as the property
 constexpr int VENDOR_ERROR_CODE = 0x00ab0005;
 // A list of supported options for "--set" command.
@@ -281,6 +291,14 @@ void maybeGetGrpcServiceInfo(std::string* address) {
     ifs.close();
 }
 
+int32_t getRequestPropId(const GetValueRequest& request) {
+    return request.prop.prop;
+}
+
+int32_t getRequestPropId(const SetValueRequest& request) {
+    return request.value.prop;
+}
+
 }  // namespace
 
 void FakeVehicleHardware::storePropInitialValue(const ConfigDeclaration& config) {
@@ -335,6 +353,13 @@ FakeVehicleHardware::FakeVehicleHardware()
 
 FakeVehicleHardware::FakeVehicleHardware(std::string defaultConfigDir,
                                          std::string overrideConfigDir, bool forceOverride)
+    : FakeVehicleHardware(defaultConfigDir, overrideConfigDir, forceOverride,
+                          android::base::GetUintProperty<size_t>(WORKER_COUNT_PROPERTY,
+                                                                 /*default_value=*/1)) {}
+
+FakeVehicleHardware::FakeVehicleHardware(std::string defaultConfigDir,
+                                         std::string overrideConfigDir, bool forceOverride,
+                                         size_t workerCount)
     : mValuePool(std::make_unique<VehiclePropValuePool>()),
       mServerSidePropStore(new VehiclePropertyStore(mValuePool)),
       mDefaultConfigDir(defaultConfigDir),
@@ -342,10 +367,12 @@ FakeVehicleHardware::FakeVehicleHardware(std::string defaultConfigDir,
       mFakeObd2Frame(new obd2frame::FakeObd2Frame(mServerSidePropStore)),
       mFakeUserHal(new FakeUserHal(mValuePool)),
       mRecurrentTimer(new RecurrentTimer()),
+      // With a single worker, generated events are delivered on the generator thread.
       mGeneratorHub(new GeneratorHub(
-              [this](const VehiclePropValue& value) { eventFromVehicleBus(value); })),
-      mPendingGetValueRequests(this),
-      mPendingSetValueRequests(this),
+              [this](const VehiclePropValue& value) { eventFromVehicleBus(value); },
+              /*workerCount=*/workerCount > 1 ? workerCount : 0)),
+      mPendingGetValueRequests(this, workerCount),
+      mPendingSetValueRequests(this, workerCount),
       mForceOverride(forceOverride) {
     init();
 }
@@ -1379,6 +1406,19 @@ provided, it would iterate indefinitely.
 
 --genfakedata --stopjson [generatorID(string)]: Stop a JSON generator.
 
+--genfakedata --convertjson [jsonFilePath] [recordingFilePath]: Convert a JSON file in the
+--startjson format to a binary recording file that could be replayed with constant memory.
+
+--genfakedata --startrecording [recordingFilePath] [repetition] [playbackSpeed] [startOffset]:
+Start a generator that would replay the events in a binary recording file.
+repetition(int32, optional): how many iterations the events would be generated. If it is not
+provided, it would iterate indefinitely.
+playbackSpeed(float, optional): the playback speed multiplier, default is 1.
+startOffset(int64, optional): start replaying from the first event recorded no earlier than this
+offset in nanoseconds after the first event, default is 0.
+
+--genfakedata --stoprecording [generatorID(string)]: Stop a recording generator.
+
 --genfakedata --keypress [keyCode(int32)] [display[int32]]: Generate key press.
 
 --genfakedata --keyinputv2 [area(int32)] [display(int32)] [keyCode[int32]] [action[int32]]
@@ -1519,6 +1559,63 @@ std::string FakeVehicleHardware::genFakeDataCommand(const std::vector<std::strin
         } else {
             return StringPrintf("No JSON event generator found for ID: %s", options[2].c_str());
         }
+    } else if (command == "--convertjson") {
+        // --genfakedata --convertjson [jsonFilePath] [recordingFilePath]
+        if (options.size() != 4) {
+            return "incorrect argument count, need 4 arguments for --genfakedata --convertjson\n";
+        }
+        if (auto result = RecordingFakeValueGenerator::convertFromJson(options[2], options[3]);
+            !result.ok()) {
+            return StringPrintf("failed to convert JSON file, error: %s",
+                                result.error().message().c_str());
+        }
+        return "JSON file converted successfully";
+    } else if (command == "--startrecording") {
+        // --genfakedata --startrecording [recordingFilePath] [repetition] [playbackSpeed]
+        // [startOffset]
+        if (options.size() < 3 || options.size() > 6) {
+            return "incorrect argument count, need 3 to 6 arguments for --genfakedata "
+                   "--startrecording\n";
+        }
+        // Iterate infinitely if repetition number is not provided
+        int32_t repetition = -1;
+        float playbackSpeed = 1.0;
+        int64_t startOffset = 0;
+        if (options.size() > 3 && !android::base::ParseInt(options[3], &repetition)) {
+            return parseErrMsg("repetition", options[3], "int");
+        }
+        if (options.size() > 4 &&
+            (!android::base::ParseFloat(options[4], &playbackSpeed) || playbackSpeed <= 0)) {
+            return parseErrMsg("playbackSpeed", options[4], "positive float");
+        }
+        if (options.size() > 5 && !android::base::ParseInt(options[5], &startOffset)) {
+            return parseErrMsg("startOffset", options[5], "int");
+        }
+        const std::string& fileName = options[2];
+        auto generator = std::make_unique<RecordingFakeValueGenerator>(fileName, repetition);
+        generator->setPlaybackSpeed(playbackSpeed);
+        generator->seek(startOffset);
+        if (!generator->hasNext()) {
+            return "invalid recording file, no events";
+        }
+        int32_t cookie = std::hash<std::string>()(fileName);
+        mGeneratorHub->registerGenerator(cookie, std::move(generator));
+        return StringPrintf("Recording event generator started successfully, ID: %" PRId32,
+                            cookie);
+    } else if (command == "--stoprecording") {
+        // --genfakedata --stoprecording [generatorID(string)]
+        if (options.size() != 3) {
+            return "incorrect argument count, need 3 arguments for --genfakedata "
+                   "--stoprecording\n";
+        }
+        int32_t cookie;
+        if (!android::base::ParseInt(options[2], &cookie)) {
+            return parseErrMsg("cookie", options[2], "int");
+        }
+        if (mGeneratorHub->unregisterGenerator(cookie)) {
+            return "Recording event generator stopped successfully";
+        }
+        return StringPrintf("No recording event generator found for ID: %s", options[2].c_str());
     } else if (command == "--keypress") {
         int32_t keyCode;
         int32_t display;
@@ -1793,6 +1890,7 @@ std::string FakeVehicleHardware::dumpAllProperties() {
     for (const VehiclePropConfig& config : configs) {
         msg += dumpOnePropertyByConfig(rowNumber++, config);
     }
+    msg += mServerSidePropStore->dump();
     return msg;
 }
 
@@ -2382,6 +2480,7 @@ void FakeVehicleHardware::loadPropConfigsFromDir(
         const std::string& dirPath,
         std::unordered_map<int32_t, ConfigDeclaration>* configsByPropId) {
     ALOGI("loading properties from %s", dirPath.c_str());
+    std::string cacheDir = android::base::GetProperty(CONFIG_CACHE_DIR_PROPERTY, "");
     if (auto dir = opendir(dirPath.c_str()); dir != NULL) {
         std::regex regJson(".*[.]json", std::regex::icase);
         while (auto f = readdir(dir)) {
@@ -2390,7 +2489,16 @@ void FakeVehicleHardware::loadPropConfigsFromDir(
             }
             std::string filePath = dirPath + "/" + std::string(f->d_name);
             ALOGI("loading properties from %s", filePath.c_str());
-            auto result = mLoader.loadPropConfig(filePath);
+            Result<std::unordered_map<int32_t, ConfigDeclaration>> result;
+            if (cacheDir.empty()) {
+                result = mLoader.loadPropConfig(filePath);
+            } else {
+                // Config files in different directories could have the same name, so use the
+                // whole path as the cache file name.
+                std::string cacheName = filePath;
+                std::replace(cacheName.begin(), cacheName.end(), '/', '_');
+                result = mLoader.loadPropConfig(filePath, cacheDir + "/" + cacheName + ".cache");
+            }
             if (!result.ok()) {
                 ALOGE("failed to load config file: %s, error: %s", filePath.c_str(),
                       result.error().message().c_str());
@@ -2449,40 +2557,36 @@ Result<std::vector<uint8_t>> FakeVehicleHardware::parseHexString(const std::stri
 
 template <class CallbackType, class RequestType>
 FakeVehicleHardware::PendingRequestHandler<CallbackType, RequestType>::PendingRequestHandler(
-        FakeVehicleHardware* hardware)
-    : mHardware(hardware) {
-    // Don't initialize mThread in initialization list because mThread depends on mRequests and we
-    // want mRequests to be initialized first.
-    mThread = std::thread([this] {
-        while (mRequests.waitForItems()) {
-            handleRequestsOnce();
-        }
-    });
-}
+        FakeVehicleHardware* hardware, size_t workerCount)
+    : mHardware(hardware),
+      mWorkers(workerCount,
+               [this](std::vector<RequestWithCallback<CallbackType, RequestType>> requests) {
+                   handleRequests(std::move(requests));
+               }) {}
 
 template <class CallbackType, class RequestType>
 void FakeVehicleHardware::PendingRequestHandler<CallbackType, RequestType>::addRequest(
         RequestType request, std::shared_ptr<const CallbackType> callback) {
-    mRequests.push({
-            request,
-            callback,
-    });
+    int32_t propId = getRequestPropId(request);
+    mWorkers.push(static_cast<uint32_t>(propId), {std::move(request), std::move(callback)});
 }
 
 template <class CallbackType, class RequestType>
 void FakeVehicleHardware::PendingRequestHandler<CallbackType, RequestType>::stop() {
-    mRequests.deactivate();
-    if (mThread.joinable()) {
-        mThread.join();
-    }
+    mWorkers.stop();
 }
 
+// With multiple workers, the requests from one setValues/getValues call may be handled by
+// different workers, in which case the callback is called once per worker with part of the
+// results.
 template <>
 void FakeVehicleHardware::PendingRequestHandler<FakeVehicleHardware::GetValuesCallback,
-                                                GetValueRequest>::handleRequestsOnce() {
+                                                GetValueRequest>::
+        handleRequests(std::vector<RequestWithCallback<GetValuesCallback, GetValueRequest>>
+                               requests) {
     std::unordered_map<std::shared_ptr<const GetValuesCallback>, std::vector<GetValueResult>>
             callbackToResults;
-    for (const auto& rwc : mRequests.flush()) {
+    for (const auto& rwc : requests) {
         ATRACE_BEGIN("FakeVehicleHardware:handleGetValueRequest");
         auto result = mHardware->handleGetValueRequest(rwc.request);
         ATRACE_END();
@@ -2497,10 +2601,12 @@ void FakeVehicleHardware::PendingRequestHandler<FakeVehicleHardware::GetValuesCa
 
 template <>
 void FakeVehicleHardware::PendingRequestHandler<FakeVehicleHardware::SetValuesCallback,
-                                                SetValueRequest>::handleRequestsOnce() {
+                                                SetValueRequest>::
+        handleRequests(std::vector<RequestWithCallback<SetValuesCallback, SetValueRequest>>
+                               requests) {
     std::unordered_map<std::shared_ptr<const SetValuesCallback>, std::vector<SetValueResult>>
             callbackToResults;
-    for (const auto& rwc : mRequests.flush()) {
+    for (const auto& rwc : requests) {
         ATRACE_BEGIN("FakeVehicleHardware:handleSetValueRequest");
         auto result = mHardware->handleSetValueRequest(rwc.request);
         ATRACE_END();
@@ -96,6 +96,7 @@ using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::IsSubsetOf;
 using ::testing::UnorderedElementsAre;
+using ::testing::UnorderedElementsAreArray;
 using ::testing::WhenSortedBy;
 
 using std::chrono::milliseconds;
@@ -671,6 +672,48 @@ TEST_F(FakeVehicleHardwareTest, testReadValues) {
     ASSERT_THAT(getValueResultsWithNoTimestamp, ContainerEq(expectedGetValueResults));
 }
 
+TEST_F(FakeVehicleHardwareTest, testReadValuesWithMultipleWorkers) {
+    setHardware(std::make_unique<FakeVehicleHardware>(android::base::GetExecutableDirectory(),
+                                                      /*overrideConfigDir=*/"",
+                                                      /*forceOverride=*/false,
+                                                      /*workerCount=*/4));
+
+    std::vector<SetValueRequest> setValueRequests;
+    std::vector<SetValueResult> expectedSetValueResults;
+
+    int64_t requestId = 1;
+    for (auto& value : getTestPropValues()) {
+        addSetValueRequest(setValueRequests, expectedSetValueResults, requestId++, value,
+                           StatusCode::OK);
+    }
+
+    StatusCode status = setValues(setValueRequests);
+
+    ASSERT_EQ(status, StatusCode::OK);
+    // Requests for different properties might be handled out of order by different workers.
+    ASSERT_THAT(getSetValueResults(), UnorderedElementsAreArray(expectedSetValueResults));
+
+    std::vector<GetValueRequest> getValueRequests;
+    std::vector<GetValueResult> expectedGetValueResults;
+    for (auto& value : getTestPropValues()) {
+        addGetValueRequest(getValueRequests, expectedGetValueResults, requestId++, value,
+                           StatusCode::OK);
+    }
+
+    status = getValues(getValueRequests);
+
+    ASSERT_EQ(status, StatusCode::OK);
+
+    std::vector<GetValueResult> getValueResultsWithNoTimestamp;
+    for (auto& result : getGetValueResults()) {
+        GetValueResult resultCopy = result;
+        resultCopy.prop->timestamp = 0;
+        getValueResultsWithNoTimestamp.push_back(std::move(resultCopy));
+    }
+    ASSERT_THAT(getValueResultsWithNoTimestamp,
+                UnorderedElementsAreArray(expectedGetValueResults));
+}
+
 TEST_F(FakeVehicleHardwareTest, testReadValuesErrorInvalidProp) {
     std::vector<SetValueRequest> setValueRequests;
     std::vector<SetValueResult> expectedSetValueResults;
@@ -2975,6 +3018,27 @@ std::vector<OptionsTestCase> GenInvalidOptions() {
             {"genfakedata_stopjson_no_args",
              {"--genfakedata", "--stopjson"},
              "incorrect argument count"},
+            {"genfakedata_convertjson_no_args",
+             {"--genfakedata", "--convertjson"},
+             "incorrect argument count"},
+            {"genfakedata_convertjson_invalid_file",
+             {"--genfakedata", "--convertjson", "non_existing_file", "/tmp/recording"},
+             "failed to convert JSON file"},
+            {"genfakedata_startrecording_no_args",
+             {"--genfakedata", "--startrecording"},
+             "incorrect argument count"},
+            {"genfakedata_startrecording_invalid_repetition",
+             {"--genfakedata", "--startrecording", "file", "0.1"},
+             "failed to parse repetition as int: \"0.1\""},
+            {"genfakedata_startrecording_invalid_playback_speed",
+             {"--genfakedata", "--startrecording", "file", "1", "-1"},
+             "failed to parse playbackSpeed as positive float: \"-1\""},
+            {"genfakedata_startrecording_invalid_file",
+             {"--genfakedata", "--startrecording", "non_existing_file"},
+             "invalid recording file, no events"},
+            {"genfakedata_stoprecording_invalid_id",
+             {"--genfakedata", "--stoprecording", "abcd"},
+             "failed to parse cookie as int: \"abcd\""},
             {"genfakedata_keypress_no_args",
              {"--genfakedata", "--keypress"},
              "incorrect argument count"},
@@ -24,6 +24,7 @@
 #include <cstdlib>
 #include <mutex>
 #include <shared_mutex>
+#include <unordered_map>
 #include <utility>
 
 namespace android::hardware::automotive::vehicle::virtualization {
@@ -33,11 +34,40 @@ static std::shared_ptr<::grpc::ChannelCredentials> getChannelCredentials() {
     return ::grpc::InsecureChannelCredentials();
 }
 
+static std::vector<aidlvhal::GetValueResult> toAidlGetValueResults(
+        const proto::GetValueResults& protoResults) {
+    std::vector<aidlvhal::GetValueResult> results;
+    for (const auto& protoResult : protoResults.results()) {
+        auto& result = results.emplace_back();
+        result.requestId = protoResult.request_id();
+        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
+        if (protoResult.has_value()) {
+            aidlvhal::VehiclePropValue value;
+            proto_msg_converter::protoToAidl(protoResult.value(), &value);
+            result.prop = std::move(value);
+        }
+    }
+    return results;
+}
+
+static std::vector<aidlvhal::SetValueResult> toAidlSetValueResults(
+        const proto::SetValueResults& protoResults) {
+    std::vector<aidlvhal::SetValueResult> results;
+    for (const auto& protoResult : protoResults.results()) {
+        auto& result = results.emplace_back();
+        result.requestId = protoResult.request_id();
+        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
+        // TODO(chenhaosjtuacm): call on-set-error callback.
+    }
+    return results;
+}
+
 GRPCVehicleHardware::GRPCVehicleHardware(std::string service_addr)
     : mServiceAddr(std::move(service_addr)),
       mGrpcChannel(::grpc::CreateChannel(mServiceAddr, getChannelCredentials())),
       mGrpcStub(proto::VehicleServer::NewStub(mGrpcChannel)),
-      mValuePollingThread([this] { ValuePollingLoop(); }) {}
+      mValuePollingThread([this] { ValuePollingLoop(); }),
+      mValueStreamThread([this] { ValueStreamLoop(); }) {}
 
 GRPCVehicleHardware::~GRPCVehicleHardware() {
     {
@@ -45,7 +75,14 @@ GRPCVehicleHardware::~GRPCVehicleHardware() {
         mShuttingDownFlag.store(true);
     }
     mShutdownCV.notify_all();
+    {
+        std::lock_guard lck(mValueStreamMutex);
+        if (mValueStreamContext != nullptr) {
+            mValueStreamContext->TryCancel();
+        }
+    }
     mValuePollingThread.join();
+    mValueStreamThread.join();
 }
 
 std::vector<aidlvhal::VehiclePropConfig> GRPCVehicleHardware::getAllPropertyConfigs() const {
@@ -69,15 +106,27 @@ std::vector<aidlvhal::VehiclePropConfig> GRPCVehicleHardware::getAllPropertyConf
 aidlvhal::StatusCode GRPCVehicleHardware::setValues(
         std::shared_ptr<const SetValuesCallback> callback,
         const std::vector<aidlvhal::SetValueRequest>& requests) {
-    ::grpc::ClientContext context;
-    proto::VehiclePropValueRequests protoRequests;
-    proto::SetValueResults protoResults;
+    proto::ValueRequests protoValueRequests;
+    PendingValueRequests pendingRequests;
+    auto& protoRequests = *protoValueRequests.mutable_set_value_requests();
     for (const auto& request : requests) {
         auto& protoRequest = *protoRequests.add_requests();
         protoRequest.set_request_id(request.requestId);
         proto_msg_converter::aidlToProto(request.value, protoRequest.mutable_value());
+        pendingRequests.requestIds.insert(request.requestId);
     }
-    // TODO(chenhaosjtuacm): Make it Async.
+    pendingRequests.setValuesCallback = callback;
+    if (sendThroughValueStream(&protoValueRequests, std::move(pendingRequests))) {
+        return aidlvhal::StatusCode::OK;
+    }
+    return setValuesUnary(std::move(callback), protoRequests);
+}
+
+aidlvhal::StatusCode GRPCVehicleHardware::setValuesUnary(
+        std::shared_ptr<const SetValuesCallback> callback,
+        const proto::VehiclePropValueRequests& protoRequests) {
+    ::grpc::ClientContext context;
+    proto::SetValueResults protoResults;
     auto grpc_status = mGrpcStub->SetValues(&context, protoRequests, &protoResults);
     if (!grpc_status.ok()) {
         LOG(ERROR) << __func__ << ": GRPC SetValues Failed: " << grpc_status.error_message();
@@ -87,14 +136,7 @@ aidlvhal::StatusCode GRPCVehicleHardware::setValues(
         }
         return aidlvhal::StatusCode::INTERNAL_ERROR;
     }
-    std::vector<aidlvhal::SetValueResult> results;
-    for (const auto& protoResult : protoResults.results()) {
-        auto& result = results.emplace_back();
-        result.requestId = protoResult.request_id();
-        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
-        // TODO(chenhaosjtuacm): call on-set-error callback.
-    }
-    (*callback)(std::move(results));
+    (*callback)(toAidlSetValueResults(protoResults));
 
     return aidlvhal::StatusCode::OK;
 }
@@ -102,34 +144,96 @@ aidlvhal::StatusCode GRPCVehicleHardware::setValues(
 aidlvhal::StatusCode GRPCVehicleHardware::getValues(
         std::shared_ptr<const GetValuesCallback> callback,
         const std::vector<aidlvhal::GetValueRequest>& requests) const {
-    ::grpc::ClientContext context;
-    proto::VehiclePropValueRequests protoRequests;
-    proto::GetValueResults protoResults;
+    proto::ValueRequests protoValueRequests;
+    PendingValueRequests pendingRequests;
+    auto& protoRequests = *protoValueRequests.mutable_get_value_requests();
     for (const auto& request : requests) {
         auto& protoRequest = *protoRequests.add_requests();
         protoRequest.set_request_id(request.requestId);
         proto_msg_converter::aidlToProto(request.prop, protoRequest.mutable_value());
+        pendingRequests.requestIds.insert(request.requestId);
     }
-    // TODO(chenhaosjtuacm): Make it Async.
+    pendingRequests.getValuesCallback = callback;
+    if (sendThroughValueStream(&protoValueRequests, std::move(pendingRequests))) {
+        return aidlvhal::StatusCode::OK;
+    }
+    return getValuesUnary(std::move(callback), protoRequests);
+}
+
+aidlvhal::StatusCode GRPCVehicleHardware::getValuesUnary(
+        std::shared_ptr<const GetValuesCallback> callback,
+        const proto::VehiclePropValueRequests& protoRequests) const {
+    ::grpc::ClientContext context;
+    proto::GetValueResults protoResults;
     auto grpc_status = mGrpcStub->GetValues(&context, protoRequests, &protoResults);
     if (!grpc_status.ok()) {
         LOG(ERROR) << __func__ << ": GRPC GetValues Failed: " << grpc_status.error_message();
         return aidlvhal::StatusCode::INTERNAL_ERROR;
     }
-    std::vector<aidlvhal::GetValueResult> results;
-    for (const auto& protoResult : protoResults.results()) {
-        auto& result = results.emplace_back();
-        result.requestId = protoResult.request_id();
-        result.status = static_cast<aidlvhal::StatusCode>(protoResult.status());
-        if (protoResult.has_value()) {
-            aidlvhal::VehiclePropValue value;
-            proto_msg_converter::protoToAidl(protoResult.value(), &value);
-            result.prop = std::move(value);
+    (*callback)(toAidlGetValueResults(protoResults));
+
+    return aidlvhal::StatusCode::OK;
+}
+
+bool GRPCVehicleHardware::sendThroughValueStream(proto::ValueRequests* requests,
+                                                 PendingValueRequests&& pendingRequests) const {
+    std::lock_guard writeLck(mValueStreamWriteMutex);
+    ValueStream* stream;
+    int64_t batchId;
+    {
+        std::lock_guard lck(mValueStreamMutex);
+        if (mValueStream == nullptr) {
+            return false;
         }
+        stream = mValueStream;
+        batchId = mNextBatchId++;
+        mPendingValueRequests[batchId] = std::move(pendingRequests);
     }
-    (*callback)(std::move(results));
+    requests->set_batch_id(batchId);
+    // The stream stays valid while we hold mValueStreamWriteMutex.
+    if (stream->Write(*requests)) {
+        return true;
+    }
+    LOG(WARNING) << __func__ << ": failed to write to the value stream, fall back to unary RPC";
+    std::lock_guard lck(mValueStreamMutex);
+    // If the requests are no longer pending, the value stream loop has already failed them
+    // through the callback.
+    return mPendingValueRequests.erase(batchId) == 0;
+}
 
-    return aidlvhal::StatusCode::OK;
+void GRPCVehicleHardware::onValueResults(const proto::ValueResults& protoResults) {
+    std::shared_ptr<const GetValuesCallback> getValuesCallback;
+    std::shared_ptr<const SetValuesCallback> setValuesCallback;
+    {
+        std::lock_guard lck(mValueStreamMutex);
+        auto it = mPendingValueRequests.find(protoResults.batch_id());
+        if (it == mPendingValueRequests.end()) {
+            LOG(WARNING) << __func__ << ": received results for unknown batch ID: "
+                         << protoResults.batch_id();
+            return;
+        }
+        auto& pendingRequests = it->second;
+        getValuesCallback = pendingRequests.getValuesCallback;
+        setValuesCallback = pendingRequests.setValuesCallback;
+        // The hardware may deliver the results of one batch in several callbacks.
+        for (const auto& protoResult : protoResults.get_value_results().results()) {
+            pendingRequests.requestIds.erase(protoResult.request_id());
+        }
+        for (const auto& protoResult : protoResults.set_value_results().results()) {
+            pendingRequests.requestIds.erase(protoResult.request_id());
+        }
+        if (pendingRequests.requestIds.empty()) {
+            mPendingValueRequests.erase(it);
+        }
+    }
+    if (protoResults.has_get_value_results() && getValuesCallback) {
+        (*getValuesCallback)(toAidlGetValueResults(protoResults.get_value_results()));
+    } else if (protoResults.has_set_value_results() && setValuesCallback) {
+        (*setValuesCallback)(toAidlSetValueResults(protoResults.set_value_results()));
+    } else {
+        LOG(ERROR) << __func__ << ": results type mismatch for batch ID: "
+                   << protoResults.batch_id();
+    }
 }
 
 void GRPCVehicleHardware::registerOnPropertyChangeEvent(
@@ -221,13 +325,11 @@ void GRPCVehicleHardware::ValuePollingLoop() {
         proto::VehiclePropValues protoValues;
         while (!mShuttingDownFlag.load() && value_stream->Read(&protoValues)) {
             std::vector<aidlvhal::VehiclePropValue> values;
-            for (const auto protoValue : protoValues.values()) {
-                values.push_back(aidlvhal::VehiclePropValue());
-                proto_msg_converter::protoToAidl(protoValue, &values.back());
-            }
+            // protoValues is overwritten by the next Read(), so its strings can be moved out.
+            proto_msg_converter::protoToAidl(std::move(protoValues), &values);
             std::shared_lock lck(mCallbackMutex);
             if (mOnPropChange) {
-                (*mOnPropChange)(values);
+                (*mOnPropChange)(std::move(values));
             }
         }
 
@@ -246,4 +348,73 @@ void GRPCVehicleHardware::ValuePollingLoop() {
     }
 }
 
+void GRPCVehicleHardware::ValueStreamLoop() {
+    while (!mShuttingDownFlag.load()) {
+        ::grpc::ClientContext context;
+        auto value_stream = mGrpcStub->StreamValues(&context);
+        {
+            std::lock_guard lck(mValueStreamMutex);
+            mValueStream = value_stream.get();
+            mValueStreamContext = &context;
+            if (mShuttingDownFlag.load()) {
+                context.TryCancel();
+            }
+        }
+
+        proto::ValueResults protoResults;
+        while (value_stream->Read(&protoResults)) {
+            onValueResults(protoResults);
+        }
+
+        std::unordered_map<int64_t, PendingValueRequests> failedRequests;
+        {
+            std::lock_guard writeLck(mValueStreamWriteMutex);
+            std::lock_guard lck(mValueStreamMutex);
+            mValueStream = nullptr;
+            mValueStreamContext = nullptr;
+            failedRequests = std::move(mPendingValueRequests);
+            mPendingValueRequests.clear();
+        }
+        auto grpc_status = value_stream->Finish();
+
+        // The requests sent through the lost stream will never get results, let the client retry.
+        for (const auto& [_, pendingRequests] : failedRequests) {
+            if (pendingRequests.getValuesCallback) {
+                std::vector<aidlvhal::GetValueResult> results;
+                for (int64_t requestId : pendingRequests.requestIds) {
+                    results.push_back({
+                            .requestId = requestId,
+                            .status = aidlvhal::StatusCode::TRY_AGAIN,
+                    });
+                }
+                (*pendingRequests.getValuesCallback)(std::move(results));
+            } else if (pendingRequests.setValuesCallback) {
+                std::vector<aidlvhal::SetValueResult> results;
+                for (int64_t requestId : pendingRequests.requestIds) {
+                    results.push_back({
+                            .requestId = requestId,
+                            .status = aidlvhal::StatusCode::TRY_AGAIN,
+                    });
+                }
+                (*pendingRequests.setValuesCallback)(std::move(results));
+            }
+        }
+
+        if (grpc_status.error_code() == ::grpc::StatusCode::UNIMPLEMENTED) {
+            LOG(INFO) << __func__ << ": GRPC StreamValues is not supported by the server, "
+                      << "use unary RPCs for get and set values";
+            return;
+        }
+        if (!mShuttingDownFlag.load()) {
+            LOG(ERROR) << __func__
+                       << ": GRPC StreamValues Failed: " << grpc_status.error_message();
+        }
+
+        // Wait before reconnecting so that we do not busy loop while the server is unavailable.
+        std::unique_lock<std::mutex> lck(mShutdownMutex);
+        mShutdownCV.wait_for(lck, kValueStreamReconnectInterval,
+                             [this]() { return mShuttingDownFlag.load(); });
+    }
+}
+
 }  // namespace android::hardware::automotive::vehicle::virtualization
@@ -20,6 +20,7 @@
 #include <VehicleHalTypes.h>
 #include <VehicleUtils.h>
 #include <android-base/result.h>
+#include <android-base/thread_annotations.h>
 
 #include "VehicleServer.grpc.pb.h"
 #include "VehicleServer.pb.h"
@@ -33,6 +34,8 @@
 #include <shared_mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android::hardware::automotive::vehicle::virtualization {
@@ -87,18 +90,62 @@ class GRPCVehicleHardware : public IVehicleHardware {
     std::unique_ptr<const PropertyChangeCallback> mOnPropChange;
 
   private:
+    using ValueStream = ::grpc::ClientReaderWriter<proto::ValueRequests, proto::ValueResults>;
+
+    // The requests sent through the value stream that are still waiting for results. Only one of
+    // the callbacks is set.
+    struct PendingValueRequests {
+        std::unordered_set<int64_t> requestIds;
+        std::shared_ptr<const GetValuesCallback> getValuesCallback;
+        std::shared_ptr<const SetValuesCallback> setValuesCallback;
+    };
+
     void ValuePollingLoop();
 
+    // Keeps the bidirectional value stream connected and dispatches the results read from it.
+    void ValueStreamLoop();
+
+    // Dispatches the results read from the value stream to the callback of the pending requests.
+    void onValueResults(const proto::ValueResults& protoResults);
+
+    // Sends the requests through the value stream without waiting for the results. Returns false
+    // if the value stream is not available, in which case the unary RPCs must be used instead.
+    bool sendThroughValueStream(proto::ValueRequests* requests,
+                                PendingValueRequests&& pendingRequests) const;
+
+    aidlvhal::StatusCode setValuesUnary(std::shared_ptr<const SetValuesCallback> callback,
+                                        const proto::VehiclePropValueRequests& protoRequests);
+
+    aidlvhal::StatusCode getValuesUnary(std::shared_ptr<const GetValuesCallback> callback,
+                                        const proto::VehiclePropValueRequests& protoRequests) const;
+
+    // The interval to wait before reconnecting the value stream.
+    static constexpr auto kValueStreamReconnectInterval = std::chrono::seconds(1);
+
     std::string mServiceAddr;
     std::shared_ptr<::grpc::Channel> mGrpcChannel;
     std::unique_ptr<proto::VehicleServer::Stub> mGrpcStub;
     std::thread mValuePollingThread;
 
+    // Serializes the writes to the value stream. Must be acquired before mValueStreamMutex.
+    mutable std::mutex mValueStreamWriteMutex;
+    mutable std::mutex mValueStreamMutex;
+    // The currently connected value stream, nullptr if not connected.
+    ValueStream* mValueStream GUARDED_BY(mValueStreamMutex) = nullptr;
+    ::grpc::ClientContext* mValueStreamContext GUARDED_BY(mValueStreamMutex) = nullptr;
+    mutable int64_t mNextBatchId GUARDED_BY(mValueStreamMutex) = 0;
+    mutable std::unordered_map<int64_t, PendingValueRequests> mPendingValueRequests
+            GUARDED_BY(mValueStreamMutex);
+
     std::unique_ptr<const PropertySetErrorCallback> mOnSetErr;
 
     std::mutex mShutdownMutex;
     std::condition_variable mShutdownCV;
     std::atomic<bool> mShuttingDownFlag{false};
+
+    // Must be the last member so that the thread starts after all the other members are
+    // initialized.
+    std::thread mValueStreamThread;
 };
 
 }  // namespace android::hardware::automotive::vehicle::virtualization
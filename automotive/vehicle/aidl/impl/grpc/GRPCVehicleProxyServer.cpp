@@ -31,6 +31,8 @@
 
 namespace android::hardware::automotive::vehicle::virtualization {
 
+using ::android::base::ScopedLockAssertion;
+
 std::atomic<uint64_t> GrpcVehicleProxyServer::ConnectionDescriptor::connection_id_counter_{0};
 
 static std::shared_ptr<::grpc::ServerCredentials> getServerCredentials() {
@@ -38,6 +40,100 @@ static std::shared_ptr<::grpc::ServerCredentials> getServerCredentials() {
     return ::grpc::InsecureServerCredentials();
 }
 
+static std::vector<aidlvhal::SetValueRequest> toAidlSetValueRequests(
+        const proto::VehiclePropValueRequests& requests) {
+    std::vector<aidlvhal::SetValueRequest> aidlRequests;
+    for (const auto& protoRequest : requests.requests()) {
+        auto& aidlRequest = aidlRequests.emplace_back();
+        aidlRequest.requestId = protoRequest.request_id();
+        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.value);
+    }
+    return aidlRequests;
+}
+
+static std::vector<aidlvhal::GetValueRequest> toAidlGetValueRequests(
+        const proto::VehiclePropValueRequests& requests) {
+    std::vector<aidlvhal::GetValueRequest> aidlRequests;
+    for (const auto& protoRequest : requests.requests()) {
+        auto& aidlRequest = aidlRequests.emplace_back();
+        aidlRequest.requestId = protoRequest.request_id();
+        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.prop);
+    }
+    return aidlRequests;
+}
+
+static void toProtoSetValueResults(const std::vector<aidlvhal::SetValueResult>& setValueResults,
+                                   proto::SetValueResults* results) {
+    for (const auto& aidlResult : setValueResults) {
+        auto& protoResult = *results->add_results();
+        protoResult.set_request_id(aidlResult.requestId);
+        protoResult.set_status(static_cast<proto::StatusCode>(aidlResult.status));
+    }
+}
+
+static void toProtoGetValueResults(const std::vector<aidlvhal::GetValueResult>& getValueResults,
+                                   proto::GetValueResults* results) {
+    for (const auto& aidlResult : getValueResults) {
+        auto& protoResult = *results->add_results();
+        protoResult.set_request_id(aidlResult.requestId);
+        protoResult.set_status(static_cast<proto::StatusCode>(aidlResult.status));
+        if (aidlResult.prop) {
+            auto* valuePtr = protoResult.mutable_value();
+            proto_msg_converter::aidlToProto(*aidlResult.prop, valuePtr);
+        }
+    }
+}
+
+// The hardware callbacks may be called from any thread and even after the StreamValues RPC
+// returns, so the writes to the stream are serialized here and dropped once the RPC is closed.
+class GrpcVehicleProxyServer::ValueResultsWriter {
+  public:
+    explicit ValueResultsWriter(
+            ::grpc::ServerReaderWriter<proto::ValueResults, proto::ValueRequests>* stream)
+        : mStream(stream) {}
+
+    // Marks that the results for {@code count} requests are expected.
+    void AddOutstandingRequests(size_t count) {
+        std::lock_guard lck(mMtx);
+        mOutstandingRequests += count;
+    }
+
+    void Write(const proto::ValueResults& results, size_t resultCount) {
+        {
+            std::lock_guard lck(mMtx);
+            mOutstandingRequests -= std::min(resultCount, mOutstandingRequests);
+            if (mStream == nullptr) {
+                LOG(WARNING) << __func__ << ": Value stream closed, results dropped for batch ID: "
+                             << results.batch_id();
+                return;
+            }
+            if (!mStream->Write(results)) {
+                LOG(ERROR) << __func__ << ": Server Write failed for batch ID: "
+                           << results.batch_id();
+            }
+        }
+        mCV.notify_all();
+    }
+
+    // Waits until all the outstanding results are written or the timeout, and then stops writing
+    // to the stream.
+    void Close(std::chrono::nanoseconds timeout) {
+        std::unique_lock lck(mMtx);
+        mCV.wait_for(lck, timeout, [this] {
+            ScopedLockAssertion lockAssertion(mMtx);
+            return mOutstandingRequests == 0;
+        });
+        mStream = nullptr;
+    }
+
+  private:
+    std::mutex mMtx;
+    std::condition_variable mCV;
+    ::grpc::ServerReaderWriter<proto::ValueResults, proto::ValueRequests>* mStream
+            GUARDED_BY(mMtx);
+    size_t mOutstandingRequests GUARDED_BY(mMtx) = 0;
+};
+
 GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
                                                std::unique_ptr<IVehicleHardware>&& hardware)
     : mServiceAddr(std::move(serverAddr)), mHardware(std::move(hardware)) {
@@ -64,12 +160,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
 ::grpc::Status GrpcVehicleProxyServer::SetValues(::grpc::ServerContext* context,
                                                  const proto::VehiclePropValueRequests* requests,
                                                  proto::SetValueResults* results) {
-    std::vector<aidlvhal::SetValueRequest> aidlRequests;
-    for (const auto& protoRequest : requests->requests()) {
-        auto& aidlRequest = aidlRequests.emplace_back();
-        aidlRequest.requestId = protoRequest.request_id();
-        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.value);
-    }
+    std::vector<aidlvhal::SetValueRequest> aidlRequests = toAidlSetValueRequests(*requests);
     auto waitMtx = std::make_shared<std::mutex>();
     auto waitCV = std::make_shared<std::condition_variable>();
     auto complete = std::make_shared<bool>(false);
@@ -78,12 +169,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
             std::make_shared<const IVehicleHardware::SetValuesCallback>(
                     [waitMtx, waitCV, complete,
                      tmpResults](std::vector<aidlvhal::SetValueResult> setValueResults) {
-                        for (const auto& aidlResult : setValueResults) {
-                            auto& protoResult = *tmpResults->add_results();
-                            protoResult.set_request_id(aidlResult.requestId);
-                            protoResult.set_status(
-                                    static_cast<proto::StatusCode>(aidlResult.status));
-                        }
+                        toProtoSetValueResults(setValueResults, tmpResults.get());
                         {
                             std::lock_guard lck(*waitMtx);
                             *complete = true;
@@ -109,12 +195,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
 ::grpc::Status GrpcVehicleProxyServer::GetValues(::grpc::ServerContext* context,
                                                  const proto::VehiclePropValueRequests* requests,
                                                  proto::GetValueResults* results) {
-    std::vector<aidlvhal::GetValueRequest> aidlRequests;
-    for (const auto& protoRequest : requests->requests()) {
-        auto& aidlRequest = aidlRequests.emplace_back();
-        aidlRequest.requestId = protoRequest.request_id();
-        proto_msg_converter::protoToAidl(protoRequest.value(), &aidlRequest.prop);
-    }
+    std::vector<aidlvhal::GetValueRequest> aidlRequests = toAidlGetValueRequests(*requests);
     auto waitMtx = std::make_shared<std::mutex>();
     auto waitCV = std::make_shared<std::condition_variable>();
     auto complete = std::make_shared<bool>(false);
@@ -123,16 +204,7 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
             std::make_shared<const IVehicleHardware::GetValuesCallback>(
                     [waitMtx, waitCV, complete,
                      tmpResults](std::vector<aidlvhal::GetValueResult> getValueResults) {
-                        for (const auto& aidlResult : getValueResults) {
-                            auto& protoResult = *tmpResults->add_results();
-                            protoResult.set_request_id(aidlResult.requestId);
-                            protoResult.set_status(
-                                    static_cast<proto::StatusCode>(aidlResult.status));
-                            if (aidlResult.prop) {
-                                auto* valuePtr = protoResult.mutable_value();
-                                proto_msg_converter::aidlToProto(*aidlResult.prop, valuePtr);
-                            }
-                        }
+                        toProtoGetValueResults(getValueResults, tmpResults.get());
                         {
                             std::lock_guard lck(*waitMtx);
                             *complete = true;
@@ -190,23 +262,111 @@ GrpcVehicleProxyServer::GrpcVehicleProxyServer(std::string serverAddr,
         std::lock_guard lck(mConnectionMutex);
         mValueStreamingConnections.push_back(conn);
     }
-    conn->Wait();
+    conn->WriteLoop();
     LOG(ERROR) << __func__ << ": Stream lost, ID : " << conn->ID();
     return ::grpc::Status(::grpc::StatusCode::ABORTED, "Connection lost.");
 }
 
+::grpc::Status GrpcVehicleProxyServer::StreamValues(
+        ::grpc::ServerContext* context,
+        ::grpc::ServerReaderWriter<proto::ValueResults, proto::ValueRequests>* stream) {
+    {
+        std::lock_guard lck(mValueRequestStreamsMutex);
+        if (mShuttingDown) {
+            return ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Server is shutting down.");
+        }
+        mValueRequestStreamContexts.insert(context);
+    }
+    auto writer = std::make_shared<ValueResultsWriter>(stream);
+    proto::ValueRequests requests;
+    while (stream->Read(&requests)) {
+        HandleValueRequests(requests, writer);
+    }
+    // Give the in-flight requests a chance to finish before the stream is closed.
+    writer->Close(kHardwareOpTimeout);
+    {
+        std::lock_guard lck(mValueRequestStreamsMutex);
+        mValueRequestStreamContexts.erase(context);
+    }
+    return ::grpc::Status::OK;
+}
+
+void GrpcVehicleProxyServer::HandleValueRequests(
+        const proto::ValueRequests& requests, const std::shared_ptr<ValueResultsWriter>& writer) {
+    int64_t batchId = requests.batch_id();
+    proto::ValueResults protoResults;
+    protoResults.set_batch_id(batchId);
+    if (requests.has_get_value_requests()) {
+        auto aidlRequests = toAidlGetValueRequests(requests.get_value_requests());
+        writer->AddOutstandingRequests(aidlRequests.size());
+        auto aidlStatus = mHardware->getValues(
+                std::make_shared<const IVehicleHardware::GetValuesCallback>(
+                        [writer, batchId](std::vector<aidlvhal::GetValueResult> getValueResults) {
+                            proto::ValueResults protoResults;
+                            protoResults.set_batch_id(batchId);
+                            toProtoGetValueResults(getValueResults,
+                                                   protoResults.mutable_get_value_results());
+                            writer->Write(protoResults, getValueResults.size());
+                        }),
+                aidlRequests);
+        if (aidlStatus != aidlvhal::StatusCode::OK) {
+            LOG(ERROR) << __func__ << ": The underlying hardware fails to get values, VHAL status: "
+                       << toString(aidlStatus);
+            std::vector<aidlvhal::GetValueResult> getValueResults;
+            for (const auto& aidlRequest : aidlRequests) {
+                getValueResults.push_back({
+                        .requestId = aidlRequest.requestId,
+                        .status = aidlStatus,
+                });
+            }
+            toProtoGetValueResults(getValueResults, protoResults.mutable_get_value_results());
+            writer->Write(protoResults, getValueResults.size());
+        }
+        return;
+    }
+    if (requests.has_set_value_requests()) {
+        auto aidlRequests = toAidlSetValueRequests(requests.set_value_requests());
+        writer->AddOutstandingRequests(aidlRequests.size());
+        auto aidlStatus = mHardware->setValues(
+                std::make_shared<const IVehicleHardware::SetValuesCallback>(
+                        [writer, batchId](std::vector<aidlvhal::SetValueResult> setValueResults) {
+                            proto::ValueResults protoResults;
+                            protoResults.set_batch_id(batchId);
+                            toProtoSetValueResults(setValueResults,
+                                                   protoResults.mutable_set_value_results());
+                            writer->Write(protoResults, setValueResults.size());
+                        }),
+                aidlRequests);
+        if (aidlStatus != aidlvhal::StatusCode::OK) {
+            LOG(ERROR) << __func__ << ": The underlying hardware fails to set values, VHAL status: "
+                       << toString(aidlStatus);
+            std::vector<aidlvhal::SetValueResult> setValueResults;
+            for (const auto& aidlRequest : aidlRequests) {
+                setValueResults.push_back({
+                        .requestId = aidlRequest.requestId,
+                        .status = aidlStatus,
+                });
+            }
+            toProtoSetValueResults(setValueResults, protoResults.mutable_set_value_results());
+            writer->Write(protoResults, setValueResults.size());
+        }
+        return;
+    }
+    LOG(ERROR) << __func__ << ": Received empty requests for batch ID: " << batchId;
+    // Still reply so that the client does not keep the batch pending.
+    writer->Write(protoResults, 0);
+}
+
 void GrpcVehicleProxyServer::OnVehiclePropChange(
         const std::vector<aidlvhal::VehiclePropValue>& values) {
     std::unordered_set<uint64_t> brokenConn;
-    proto::VehiclePropValues protoValues;
-    for (const auto& value : values) {
-        auto* protoValuePtr = protoValues.add_values();
-        proto_msg_converter::aidlToProto(value, protoValuePtr);
-    }
+    // The values and all their fields are freed at once with the arena.
+    ::google::protobuf::Arena arena;
+    const proto::VehiclePropValues* protoValues = proto_msg_converter::aidlToProto(values, &arena);
     {
         std::shared_lock read_lock(mConnectionMutex);
         for (auto& connection : mValueStreamingConnections) {
-            auto writeOK = connection->Write(protoValues);
+            auto writeOK = connection->Write(*protoValues);
             if (!writeOK) {
                 LOG(ERROR) << __func__
                            << ": Server Write failed, connection lost. ID: " << connection->ID();
@@ -241,6 +401,13 @@ GrpcVehicleProxyServer& GrpcVehicleProxyServer::Start() {
 }
 
 GrpcVehicleProxyServer& GrpcVehicleProxyServer::Shutdown() {
+    {
+        std::lock_guard lck(mValueRequestStreamsMutex);
+        mShuttingDown = true;
+        for (auto* context : mValueRequestStreamContexts) {
+            context->TryCancel();
+        }
+    }
     std::shared_lock read_lock(mConnectionMutex);
     for (auto& conn : mValueStreamingConnections) {
         conn->Shutdown();
@@ -270,19 +437,65 @@ bool GrpcVehicleProxyServer::ConnectionDescriptor::Write(const proto::VehiclePro
     }
     {
         std::lock_guard lck(*mMtx);
-        if (!mShutdownFlag && mStream->Write(values)) {
-            return true;
-        } else {
+        if (mShutdownFlag) {
             LOG(ERROR) << __func__ << ": Server Write failed, connection lost. ID: " << ID();
+            return false;
+        }
+        mPendingValues.insert(mPendingValues.end(), values.values().begin(),
+                              values.values().end());
+        mHasPendingWrite = true;
+        if (mPendingValues.size() > kMaxPendingValues) {
+            ConflatePendingValuesLocked();
         }
     }
-    Shutdown();
-    return false;
+    mCV->notify_all();
+    return true;
+}
+
+void GrpcVehicleProxyServer::ConnectionDescriptor::ConflatePendingValuesLocked() {
+    // Only keep the latest value for each [propId, areaId], in the order of the latest values.
+    std::unordered_set<int64_t> seenPropIdAreaIds;
+    std::vector<proto::VehiclePropValue> conflatedValues;
+    for (auto it = mPendingValues.rbegin(); it != mPendingValues.rend(); ++it) {
+        int64_t propIdAreaId = (static_cast<int64_t>(it->prop()) << 32) |
+                               static_cast<uint32_t>(it->area_id());
+        if (seenPropIdAreaIds.insert(propIdAreaId).second) {
+            conflatedValues.push_back(std::move(*it));
+        }
+    }
+    std::reverse(conflatedValues.begin(), conflatedValues.end());
+    if (conflatedValues.size() > kMaxPendingValues) {
+        size_t droppedCount = conflatedValues.size() - kMaxPendingValues;
+        LOG(WARNING) << __func__ << ": Client is too slow, dropping " << droppedCount
+                     << " oldest values. ID: " << ID();
+        conflatedValues.erase(conflatedValues.begin(), conflatedValues.begin() + droppedCount);
+    }
+    mPendingValues = std::move(conflatedValues);
 }
 
-void GrpcVehicleProxyServer::ConnectionDescriptor::Wait() {
-    std::unique_lock lck(*mMtx);
-    mCV->wait(lck, [this] { return mShutdownFlag; });
+void GrpcVehicleProxyServer::ConnectionDescriptor::WriteLoop() {
+    while (true) {
+        proto::VehiclePropValues values;
+        {
+            std::unique_lock lck(*mMtx);
+            mCV->wait(lck, [this] { return mShutdownFlag || mHasPendingWrite; });
+            if (mShutdownFlag) {
+                return;
+            }
+            for (auto& value : mPendingValues) {
+                *values.add_values() = std::move(value);
+            }
+            mPendingValues.clear();
+            mHasPendingWrite = false;
+        }
+        // Only this thread writes to the stream, so the lock is not held while the write blocks
+        // on a slow client.
+        if (!mStream || !mStream->Write(values)) {
+            LOG(ERROR) << __func__ << ": Server Write failed, connection lost. ID: " << ID();
+            Shutdown();
+            return;
+        }
+    }
 }
 
 void GrpcVehicleProxyServer::ConnectionDescriptor::Shutdown() {
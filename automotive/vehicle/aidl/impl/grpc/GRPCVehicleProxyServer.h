@@ -21,6 +21,7 @@
 #include "VehicleServer.grpc.pb.h"
 #include "VehicleServer.pb.h"
 
+#include <android-base/thread_annotations.h>
 #include <grpc++/grpc++.h>
 
 #include <atomic>
@@ -30,7 +31,9 @@
 #include <memory>
 #include <shared_mutex>
 #include <string>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace android::hardware::automotive::vehicle::virtualization {
 
@@ -67,6 +70,10 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
             ::grpc::ServerContext* context, const ::google::protobuf::Empty* request,
             ::grpc::ServerWriter<proto::VehiclePropValues>* stream) override;
 
+    ::grpc::Status StreamValues(
+            ::grpc::ServerContext* context,
+            ::grpc::ServerReaderWriter<proto::ValueResults, proto::ValueRequests>* stream) override;
+
     GrpcVehicleProxyServer& Start();
 
     GrpcVehicleProxyServer& Shutdown();
@@ -74,8 +81,16 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
     void Wait();
 
   private:
+    // Writes the results of the requests received from one StreamValues RPC back to the client.
+    class ValueResultsWriter;
+
     void OnVehiclePropChange(const std::vector<aidlvhal::VehiclePropValue>& values);
 
+    // Sends one batch of requests received from StreamValues to the hardware without waiting for
+    // the results.
+    void HandleValueRequests(const proto::ValueRequests& requests,
+                             const std::shared_ptr<ValueResultsWriter>& writer);
+
     // We keep long-lasting connection for streaming the prop values.
     struct ConnectionDescriptor {
         explicit ConnectionDescriptor(::grpc::ServerWriter<proto::VehiclePropValues>* stream)
@@ -93,18 +108,30 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
 
         uint64_t ID() const { return mConnectionID; }
 
+        // Queues the values to be written by WriteLoop. Returns false if the connection is lost.
         bool Write(const proto::VehiclePropValues& values);
 
-        void Wait();
+        // Writes the queued values to the stream until the connection is shut down or lost. All
+        // the values queued since the last write are sent in one message.
+        void WriteLoop();
 
         void Shutdown();
 
       private:
+        // The maximum number of values queued for a slow client. Beyond that, only the latest
+        // value for each [propId, areaId] is kept, and then the oldest values are dropped.
+        static constexpr size_t kMaxPendingValues = 1024;
+
+        void ConflatePendingValuesLocked();
+
         ::grpc::ServerWriter<proto::VehiclePropValues>* mStream;
         uint64_t mConnectionID{0};
         std::unique_ptr<std::mutex> mMtx;
         std::unique_ptr<std::condition_variable> mCV;
         bool mShutdownFlag{false};
+        std::vector<proto::VehiclePropValue> mPendingValues;
+        // Set even if the queued event has no values, so that it is still delivered.
+        bool mHasPendingWrite{false};
 
         static std::atomic<uint64_t> connection_id_counter_;
     };
@@ -116,6 +143,11 @@ class GrpcVehicleProxyServer : public proto::VehicleServer::Service {
     std::shared_mutex mConnectionMutex;
     std::vector<std::shared_ptr<ConnectionDescriptor>> mValueStreamingConnections;
 
+    std::mutex mValueRequestStreamsMutex;
+    std::unordered_set<::grpc::ServerContext*> mValueRequestStreamContexts
+            GUARDED_BY(mValueRequestStreamsMutex);
+    bool mShuttingDown GUARDED_BY(mValueRequestStreamsMutex) = false;
+
     static constexpr auto kHardwareOpTimeout = std::chrono::seconds(1);
 };
 
@@ -23,7 +23,9 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -63,6 +65,15 @@ class VehicleHardwareForTest : public IVehicleHardware {
             std::shared_ptr<const GetValuesCallback> callback,
             const std::vector<aidl::android::hardware::automotive::vehicle::GetValueRequest>&
                     requests) const override {
+        std::vector<aidl::android::hardware::automotive::vehicle::GetValueResult> results;
+        for (const auto& request : requests) {
+            results.push_back({
+                    .requestId = request.requestId,
+                    .status = aidl::android::hardware::automotive::vehicle::StatusCode::OK,
+                    .prop = request.prop,
+            });
+        }
+        (*callback)(std::move(results));
         return aidl::android::hardware::automotive::vehicle::StatusCode::OK;
     }
 
@@ -144,4 +155,65 @@ TEST(GRPCVehicleProxyServerUnitTest, ClientConnectDisconnect) {
     vehicleServer->Shutdown().Wait();
 }
 
+TEST(GRPCVehicleProxyServerUnitTest, GetValuesThroughValueStream) {
+    auto vehicleServer = std::make_unique<GrpcVehicleProxyServer>(
+            kFakeServerAddr, std::make_unique<VehicleHardwareForTest>());
+    vehicleServer->Start();
+
+    constexpr auto kWaitForConnectionMaxTime = std::chrono::seconds(5);
+    constexpr auto kWaitForStreamStartTime = std::chrono::seconds(1);
+    constexpr auto kWaitForResultsMaxTime = std::chrono::seconds(1);
+
+    auto vehicleHardware = std::make_unique<GRPCVehicleHardware>(kFakeServerAddr);
+    EXPECT_TRUE(vehicleHardware->waitForConnected(kWaitForConnectionMaxTime));
+    std::this_thread::sleep_for(kWaitForStreamStartTime);
+
+    struct Results {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<aidl::android::hardware::automotive::vehicle::GetValueResult> values;
+    };
+    auto results = std::make_shared<Results>();
+    std::vector<aidl::android::hardware::automotive::vehicle::GetValueRequest> requests;
+    for (int64_t requestId = 0; requestId < 10; ++requestId) {
+        requests.push_back({
+                .requestId = requestId,
+                .prop = {.prop = static_cast<int32_t>(requestId)},
+        });
+    }
+
+    // Send several batches without waiting for the results of the previous ones.
+    for (const auto& request : requests) {
+        auto status = vehicleHardware->getValues(
+                std::make_shared<const IVehicleHardware::GetValuesCallback>(
+                        [results](auto getValueResults) {
+                            {
+                                std::lock_guard lck(results->mtx);
+                                for (auto& result : getValueResults) {
+                                    results->values.push_back(std::move(result));
+                                }
+                            }
+                            results->cv.notify_all();
+                        }),
+                {request});
+        EXPECT_EQ(status, aidl::android::hardware::automotive::vehicle::StatusCode::OK);
+    }
+
+    {
+        std::unique_lock lck(results->mtx);
+        EXPECT_TRUE(results->cv.wait_for(lck, kWaitForResultsMaxTime, [&results, &requests] {
+            return results->values.size() == requests.size();
+        }));
+        for (const auto& result : results->values) {
+            EXPECT_EQ(result.status,
+                      aidl::android::hardware::automotive::vehicle::StatusCode::OK);
+            ASSERT_TRUE(result.prop.has_value());
+            EXPECT_EQ(result.prop->prop, static_cast<int32_t>(result.requestId));
+        }
+    }
+
+    vehicleHardware.reset();
+    vehicleServer->Shutdown().Wait();
+}
+
 }  // namespace android::hardware::automotive::vehicle::virtualization
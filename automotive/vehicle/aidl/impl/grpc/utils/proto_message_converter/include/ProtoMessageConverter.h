@@ -24,6 +24,9 @@
 #include <android/hardware/automotive/vehicle/VehiclePropertyAccess.pb.h>
 #include <android/hardware/automotive/vehicle/VehiclePropertyChangeMode.pb.h>
 #include <android/hardware/automotive/vehicle/VehiclePropertyStatus.pb.h>
+#include <google/protobuf/arena.h>
+
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -46,6 +49,36 @@ void aidlToProto(const ::aidl::android::hardware::automotive::vehicle::VehiclePr
 void protoToAidl(
         const ::android::hardware::automotive::vehicle::proto::VehiclePropValue& inProtoVal,
         ::aidl::android::hardware::automotive::vehicle::VehiclePropValue* outAidlVal);
+// Same as above, but moves the string value out of inProtoVal.
+void protoToAidl(::android::hardware::automotive::vehicle::proto::VehiclePropValue&& inProtoVal,
+                 ::aidl::android::hardware::automotive::vehicle::VehiclePropValue* outAidlVal);
+
+// Batch conversions of VehiclePropValues.
+//
+// The outputs are overwritten and may be reused across calls: clearing a repeated message field
+// keeps its elements allocated, and resizing a vector keeps the capacity of its elements, so a
+// steady stream of updates converts without allocating once the outputs have grown.
+
+// Convert AIDL VehiclePropValues to Protobuf VehiclePropValues.
+void aidlToProto(
+        const std::vector<::aidl::android::hardware::automotive::vehicle::VehiclePropValue>&
+                inAidlVals,
+        ::android::hardware::automotive::vehicle::proto::VehiclePropValues* outProtoVals);
+// Same as above, but the returned message is allocated on, and owned by, arena.
+::android::hardware::automotive::vehicle::proto::VehiclePropValues* aidlToProto(
+        const std::vector<::aidl::android::hardware::automotive::vehicle::VehiclePropValue>&
+                inAidlVals,
+        ::google::protobuf::Arena* arena);
+// Convert Protobuf VehiclePropValues to AIDL VehiclePropValues.
+void protoToAidl(
+        const ::android::hardware::automotive::vehicle::proto::VehiclePropValues& inProtoVals,
+        std::vector<::aidl::android::hardware::automotive::vehicle::VehiclePropValue>*
+                outAidlVals);
+// Same as above, but moves the string values out of inProtoVals.
+void protoToAidl(
+        ::android::hardware::automotive::vehicle::proto::VehiclePropValues&& inProtoVals,
+        std::vector<::aidl::android::hardware::automotive::vehicle::VehiclePropValue>*
+                outAidlVals);
 
 }  // namespace proto_msg_converter
 }  // namespace vehicle
@@ -21,6 +21,8 @@
 #include <VehicleUtils.h>
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -124,17 +126,11 @@ void aidlToProto(const aidl_vehicle::VehiclePropValue& in, proto::VehiclePropVal
     out->set_string_value(in.value.stringValue);
     out->set_byte_values(in.value.byteValues.data(), in.value.byteValues.size());
 
-    for (auto& int32Value : in.value.int32Values) {
-        out->add_int32_values(int32Value);
-    }
-
-    for (auto& int64Value : in.value.int64Values) {
-        out->add_int64_values(int64Value);
-    }
-
-    for (auto& floatValue : in.value.floatValues) {
-        out->add_float_values(floatValue);
-    }
+    // Bulk assignments copy each packed array at once, reusing the capacity already allocated by
+    // out.
+    out->mutable_int32_values()->Assign(in.value.int32Values.begin(), in.value.int32Values.end());
+    out->mutable_int64_values()->Assign(in.value.int64Values.begin(), in.value.int64Values.end());
+    out->mutable_float_values()->Assign(in.value.floatValues.begin(), in.value.floatValues.end());
 }
 
 void protoToAidl(const proto::VehiclePropValue& in, aidl_vehicle::VehiclePropValue* out) {
@@ -143,13 +139,50 @@ void protoToAidl(const proto::VehiclePropValue& in, aidl_vehicle::VehiclePropVal
     out->status = static_cast<aidl_vehicle::VehiclePropertyStatus>(in.status());
     out->areaId = in.area_id();
     out->value.stringValue = in.string_value();
-    for (const char& byte : in.byte_values()) {
-        out->value.byteValues.push_back(byte);
+    out->value.byteValues.assign(in.byte_values().begin(), in.byte_values().end());
+    out->value.int32Values.assign(in.int32_values().begin(), in.int32_values().end());
+    out->value.int64Values.assign(in.int64_values().begin(), in.int64_values().end());
+    out->value.floatValues.assign(in.float_values().begin(), in.float_values().end());
+}
+
+void protoToAidl(proto::VehiclePropValue&& in, aidl_vehicle::VehiclePropValue* out) {
+    // The numeric arrays have different storage on each side and are copied in bulk, but the
+    // string can be handed over.
+    std::string stringValue = std::move(*in.mutable_string_value());
+    protoToAidl(in, out);
+    out->value.stringValue = std::move(stringValue);
+}
+
+void aidlToProto(const std::vector<aidl_vehicle::VehiclePropValue>& in,
+                 proto::VehiclePropValues* out) {
+    // Cleared elements stay allocated and are handed out again by Add().
+    out->clear_values();
+    for (const auto& value : in) {
+        aidlToProto(value, out->add_values());
+    }
+}
+
+proto::VehiclePropValues* aidlToProto(const std::vector<aidl_vehicle::VehiclePropValue>& in,
+                                      ::google::protobuf::Arena* arena) {
+    auto* out = ::google::protobuf::Arena::CreateMessage<proto::VehiclePropValues>(arena);
+    out->mutable_values()->Reserve(in.size());
+    aidlToProto(in, out);
+    return out;
+}
+
+void protoToAidl(const proto::VehiclePropValues& in,
+                 std::vector<aidl_vehicle::VehiclePropValue>* out) {
+    out->resize(in.values_size());
+    for (int i = 0; i < in.values_size(); i++) {
+        protoToAidl(in.values(i), &(*out)[i]);
     }
+}
 
-    COPY_PROTOBUF_VEC_TO_VHAL_TYPE(in, int32_values, out, value.int32Values);
-    COPY_PROTOBUF_VEC_TO_VHAL_TYPE(in, int64_values, out, value.int64Values);
-    COPY_PROTOBUF_VEC_TO_VHAL_TYPE(in, float_values, out, value.floatValues);
+void protoToAidl(proto::VehiclePropValues&& in, std::vector<aidl_vehicle::VehiclePropValue>* out) {
+    out->resize(in.values_size());
+    for (int i = 0; i < in.values_size(); i++) {
+        protoToAidl(std::move(*in.mutable_values(i)), &(*out)[i]);
+    }
 }
 
 #undef COPY_PROTOBUF_VEC_TO_VHAL_TYPE
@@ -102,6 +102,37 @@ TEST_P(PropValueConversionTest, testConversion) {
     EXPECT_EQ(aidlVal, GetParam());
 }
 
+TEST(PropValuesConversionTest, testBatchConversion) {
+    std::vector<aidl_vehicle::VehiclePropValue> values = prepareTestValues();
+    ASSERT_FALSE(values.empty());
+    proto::VehiclePropValues protoVals;
+    std::vector<aidl_vehicle::VehiclePropValue> aidlVals;
+
+    aidlToProto(values, &protoVals);
+    protoToAidl(protoVals, &aidlVals);
+
+    EXPECT_EQ(aidlVals, values);
+
+    // Reusing the outputs for a smaller batch must not leave stale values behind.
+    std::vector<aidl_vehicle::VehiclePropValue> fewerValues(values.rbegin(), values.rbegin() + 1);
+    aidlToProto(fewerValues, &protoVals);
+    protoToAidl(std::move(protoVals), &aidlVals);
+
+    EXPECT_EQ(aidlVals, fewerValues);
+}
+
+TEST(PropValuesConversionTest, testBatchConversionOnArena) {
+    std::vector<aidl_vehicle::VehiclePropValue> values = prepareTestValues();
+    ::google::protobuf::Arena arena;
+    std::vector<aidl_vehicle::VehiclePropValue> aidlVals;
+
+    const proto::VehiclePropValues* protoVals = aidlToProto(values, &arena);
+    ASSERT_EQ(protoVals->GetArena(), &arena);
+    protoToAidl(*protoVals, &aidlVals);
+
+    EXPECT_EQ(aidlVals, values);
+}
+
 INSTANTIATE_TEST_SUITE_P(DefaultConfigs, PropConfigConversionTest,
                          ::testing::ValuesIn(prepareTestConfigs()),
                          [](const ::testing::TestParamInfo<aidl_vehicle::VehiclePropConfig>& info) {
@@ -20,6 +20,7 @@
 #include <VehicleHalTypes.h>
 
 #include <memory>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -117,6 +118,34 @@ class IVehicleHardware {
         return std::chrono::nanoseconds(0);
     }
 
+    // Gets the maximum number of property change events batched together by DefaultVehicleHal.
+    //
+    // If this many events are pending before the batching window ends, they are delivered
+    // immediately. This keeps the number of callbacks low under heavy load without adding latency
+    // beyond what is needed to fill a batch.
+    //
+    // 0 means no limit. Only used if getPropertyOnChangeEventBatchingWindow does not return 0.
+    virtual size_t getPropertyOnChangeEventBatchMaxSize() {
+        // By default the batch size is not limited.
+        return 0;
+    }
+
+    // Gets the property IDs whose change events are latency critical.
+    //
+    // Change events for these properties are delivered to the VHAL clients as soon as they are
+    // generated, even if batching is enabled in DefaultVehicleHal.
+    //
+    // Only used if getPropertyOnChangeEventBatchingWindow does not return 0.
+    virtual std::unordered_set<int32_t> getLatencyCriticalPropIds() {
+        using ::aidl::android::hardware::automotive::vehicle::VehicleProperty;
+        return {
+                static_cast<int32_t>(VehicleProperty::GEAR_SELECTION),
+                static_cast<int32_t>(VehicleProperty::CURRENT_GEAR),
+                static_cast<int32_t>(VehicleProperty::TURN_SIGNAL_STATE),
+                static_cast<int32_t>(VehicleProperty::HAZARD_LIGHTS_STATE),
+        };
+    }
+
     // A [propId, areaId] is newly subscribed or the subscribe options are changed.
     //
     // The subscribe options contain sample rate in Hz or enable/disable variable update rate.
@@ -19,11 +19,16 @@
 
 #include <android-base/thread_annotations.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -42,6 +47,19 @@ class ConcurrentQueue {
         return mIsActive;
     }
 
+    // Waits until there are at least {@code count} items in the queue, the deadline is reached or
+    // the queue is deactivated. Returns whether the queue is still active.
+    bool waitForItemsUntil(size_t count, std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lockGuard(mLock);
+        android::base::ScopedLockAssertion lockAssertion(mLock);
+        while (mQueue.size() < count && mIsActive) {
+            if (mCond.wait_until(lockGuard, deadline) == std::cv_status::timeout) {
+                break;
+            }
+        }
+        return mIsActive;
+    }
+
     std::vector<T> flush() {
         std::vector<T> items;
 
@@ -125,8 +143,16 @@ class BatchingConsumer {
 
     void run(ConcurrentQueue<T>* queue, std::chrono::nanoseconds batchInterval,
              const OnBatchReceivedFunc& func) {
+        run(queue, batchInterval, /*maxBatchSize=*/0, func);
+    }
+
+    // Same as above, but the batch is delivered as soon as {@code maxBatchSize} items are in the
+    // queue instead of waiting for the whole batch interval. 0 means no limit.
+    void run(ConcurrentQueue<T>* queue, std::chrono::nanoseconds batchInterval,
+             size_t maxBatchSize, const OnBatchReceivedFunc& func) {
         mQueue = queue;
         mBatchInterval = batchInterval;
+        mMaxBatchSize = maxBatchSize;
 
         mWorkerThread = std::thread(&BatchingConsumer<T>::runInternal, this, func);
     }
@@ -146,7 +172,12 @@ class BatchingConsumer {
                 mQueue->waitForItems();
                 if (State::STOP_REQUESTED == mState) break;
 
-                std::this_thread::sleep_for(mBatchInterval);
+                if (mMaxBatchSize == 0) {
+                    std::this_thread::sleep_for(mBatchInterval);
+                } else {
+                    mQueue->waitForItemsUntil(mMaxBatchSize,
+                                              std::chrono::steady_clock::now() + mBatchInterval);
+                }
                 if (State::STOP_REQUESTED == mState) break;
 
                 std::vector<T> items = mQueue->flush();
@@ -165,9 +196,68 @@ class BatchingConsumer {
 
     std::atomic<State> mState;
     std::chrono::nanoseconds mBatchInterval;
+    size_t mMaxBatchSize = 0;
     ConcurrentQueue<T>* mQueue;
 };
 
+// A group of worker threads, each consuming its own ConcurrentQueue. Items pushed with the same key
+// are always consumed by the same worker, in the order they are pushed. Items with different keys
+// may be consumed concurrently and in any relative order.
+template <typename T>
+class AffinityWorkerPool {
+  public:
+    using OnItemsReceivedFunc = std::function<void(std::vector<T> items)>;
+
+    // Starts {@code workerCount} (at least 1) worker threads. {@code func} is called from the
+    // worker threads with all the items flushed from one worker's queue at a time.
+    AffinityWorkerPool(size_t workerCount, OnItemsReceivedFunc&& func) : mFunc(std::move(func)) {
+        size_t count = std::max<size_t>(workerCount, 1);
+        // All the queues must be created before any worker starts.
+        for (size_t i = 0; i < count; i++) {
+            mQueues.push_back(std::make_unique<ConcurrentQueue<T>>());
+        }
+        for (size_t i = 0; i < count; i++) {
+            mWorkerThreads.emplace_back(&AffinityWorkerPool<T>::runWorker, this, mQueues[i].get());
+        }
+    }
+
+    ~AffinityWorkerPool() { stop(); }
+
+    AffinityWorkerPool(const AffinityWorkerPool&) = delete;
+    AffinityWorkerPool& operator=(const AffinityWorkerPool&) = delete;
+
+    void push(size_t key, T&& item) { mQueues[key % mQueues.size()]->push(std::move(item)); }
+
+    size_t getWorkerCount() const { return mQueues.size(); }
+
+    // Deactivates all the queues and waits for the worker threads to exit. Items that are not
+    // consumed yet are discarded. It is safe to call this multiple times.
+    void stop() {
+        for (auto& queue : mQueues) {
+            queue->deactivate();
+        }
+        for (auto& thread : mWorkerThreads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+  private:
+    const OnItemsReceivedFunc mFunc;
+    std::vector<std::unique_ptr<ConcurrentQueue<T>>> mQueues;
+    std::vector<std::thread> mWorkerThreads;
+
+    void runWorker(ConcurrentQueue<T>* queue) {
+        while (queue->waitForItems()) {
+            std::vector<T> items = queue->flush();
+            if (!items.empty()) {
+                mFunc(std::move(items));
+            }
+        }
+    }
+};
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
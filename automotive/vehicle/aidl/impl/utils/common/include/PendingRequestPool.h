@@ -21,11 +21,12 @@
 #include <android-base/result.h>
 #include <android-base/thread_annotations.h>
 
-#include <list>
+#include <map>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -72,8 +73,11 @@ class PendingRequestPool final {
     // The maximum number of pending requests allowed per client. If exceeds this number, adding
     // more requests would fail. This is to prevent spamming from client.
     static constexpr size_t MAX_PENDING_REQUEST_PER_CLIENT = 10000;
+    // The time range covered by one bucket in the deadline wheel.
+    static constexpr int64_t DEADLINE_BUCKET_IN_NANO = 10'000'000;
 
     struct PendingRequest {
+        const void* clientId;
         std::unordered_set<int64_t> requestIds;
         int64_t timeoutTimestamp;
         std::shared_ptr<const TimeoutCallbackFunc> callback;
@@ -81,15 +85,21 @@ class PendingRequestPool final {
 
     int64_t mTimeoutInNano;
     mutable std::mutex mLock;
-    std::unordered_map<const void*, std::list<PendingRequest>> mPendingRequestsByClient
-            GUARDED_BY(mLock);
+    // All the pending requests added through one {@code addRequests} call share one batch ID.
+    std::unordered_map<uint64_t, PendingRequest> mPendingRequestsByBatchId GUARDED_BY(mLock);
+    // The batch ID for each pending request ID, per client.
+    std::unordered_map<const void*, std::unordered_map<int64_t, uint64_t>>
+            mBatchIdByRequestIdByClient GUARDED_BY(mLock);
+    // The deadline wheel. The batch IDs are grouped into buckets by their timeout timestamp so
+    // that checking timeout only visits the expired buckets. Batches finished before timeout are
+    // removed lazily once their bucket expires.
+    std::map<int64_t, std::vector<uint64_t>> mBatchIdsByDeadlineBucket GUARDED_BY(mLock);
+    uint64_t mNextBatchId GUARDED_BY(mLock) = 0;
     std::thread mThread;
     bool mThreadStop = false;
     std::condition_variable mCv;
     std::mutex mCvLock;
 
-    bool isRequestPendingLocked(const void* clientId, int64_t requestId) const REQUIRES(mLock);
-
     // Checks whether the requests in the pool has timed-out, run periodically in a separate thread.
     void checkTimeout();
 };
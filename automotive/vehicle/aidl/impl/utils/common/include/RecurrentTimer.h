@@ -21,6 +21,7 @@
 
 #include <utils/Looper.h>
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -37,13 +38,24 @@ namespace vehicle {
 class RecurrentMessageHandler;
 
 // A thread-safe recurrent timer.
+//
+// All the registered callbacks share one timer thread and there is at most one pending wakeup at
+// any time, scheduled for the earliest deadline. When the timer wakes up, all the callbacks whose
+// deadline is within {@code slackInNanos} from now are invoked together, so that callbacks with
+// close deadlines are coalesced into a single wakeup.
 class RecurrentTimer final {
   public:
     // The class for the function that would be called recurrently.
     using Callback = std::function<void()>;
 
+    // Creates a timer that invokes callbacks exactly at their deadlines. Callbacks with the same
+    // deadline are still invoked in the same wakeup.
     RecurrentTimer();
 
+    // Creates a timer that may invoke a callback up to {@code slackInNanos} earlier than its
+    // deadline so that it could share the wakeup with another callback.
+    explicit RecurrentTimer(int64_t slackInNanos);
+
     ~RecurrentTimer();
 
     // Registers a recurrent callback for a given interval.
@@ -65,6 +77,16 @@ class RecurrentTimer final {
         int64_t nextTimeInNanos;
     };
 
+    // A pending deadline for a callback. A deadline is outdated if the callback has been
+    // unregistered or its nextTimeInNanos no longer matches the deadline.
+    struct Deadline {
+        int64_t timeInNanos;
+        int callbackId;
+
+        bool operator>(const Deadline& other) const { return timeInNanos > other.timeInNanos; }
+    };
+
+    const int64_t mSlackInNanos;
     android::sp<Looper> mLooper;
     android::sp<RecurrentMessageHandler> mHandler;
 
@@ -74,9 +96,17 @@ class RecurrentTimer final {
     std::thread mThread;
     std::unordered_map<std::shared_ptr<Callback>, int> mIdByCallback GUARDED_BY(mLock);
     std::unordered_map<int, std::unique_ptr<CallbackInfo>> mCallbackInfoById GUARDED_BY(mLock);
+    // A min-heap of all the pending deadlines.
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> mDeadlines
+            GUARDED_BY(mLock);
+    // The time for the currently scheduled wakeup, or -1 if no wakeup is scheduled.
+    int64_t mScheduledWakeupTimeInNanos GUARDED_BY(mLock) = -1;
 
     void handleMessage(const android::Message& message) EXCLUDES(mLock);
     int getCallbackIdLocked(std::shared_ptr<Callback> callback) REQUIRES(mLock);
+    bool isOutdatedLocked(const Deadline& deadline) REQUIRES(mLock);
+    // Schedules the wakeup for the earliest pending deadline, if not already scheduled.
+    void scheduleNextWakeupLocked() REQUIRES(mLock);
 };
 
 class RecurrentMessageHandler final : public android::MessageHandler {
@@ -17,10 +17,11 @@
 #ifndef android_hardware_automotive_vehicle_utils_include_VehicleObjectPool_H_
 #define android_hardware_automotive_vehicle_utils_include_VehicleObjectPool_H_
 
-#include <deque>
-#include <map>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <VehicleHalTypes.h>
 
@@ -31,8 +32,9 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-// Handy metric mostly for unit tests and debug.
-#define INC_METRIC_IF_DEBUG(val) PoolStats::instance()->val++;
+// Pool metrics. They are always collected (not only in debug builds), so that the pool hit rate
+// could be checked on a production build.
+#define INC_POOL_METRIC(val) PoolStats::instance()->val.fetch_add(1, std::memory_order_relaxed);
 
 struct PoolStats {
     std::atomic<uint32_t> Obtained{0};
@@ -40,6 +42,17 @@ struct PoolStats {
     std::atomic<uint32_t> Recycled{0};
     std::atomic<uint32_t> Deleted{0};
 
+    // Returns the ratio of obtained objects that were reused from a pool instead of being newly
+    // created. Returns 0 if no object has been obtained.
+    float getHitRate() const {
+        uint32_t obtained = Obtained.load(std::memory_order_relaxed);
+        uint32_t created = Created.load(std::memory_order_relaxed);
+        if (obtained == 0 || created > obtained) {
+            return 0.f;
+        }
+        return static_cast<float>(obtained - created) / static_cast<float>(obtained);
+    }
+
     static PoolStats* instance() {
         static PoolStats inst;
         return &inst;
@@ -76,21 +89,30 @@ class ObjectPool {
     using GetSizeFunc = std::function<size_t(const T&)>;
 
     ObjectPool(size_t maxPoolObjectsSize, GetSizeFunc getSizeFunc)
-        : mMaxPoolObjectsSize(maxPoolObjectsSize), mGetSizeFunc(getSizeFunc){};
+        : mMaxPoolObjectsSize(maxPoolObjectsSize),
+          mDeleter(std::make_unique<Deleter<T>>(
+                  std::bind(&ObjectPool::recycle, this, std::placeholders::_1))),
+          mGetSizeFunc(getSizeFunc){};
     virtual ~ObjectPool() = default;
 
     virtual recyclable_ptr<T> obtain() {
-        std::scoped_lock<std::mutex> lock(mLock);
-        INC_METRIC_IF_DEBUG(Obtained)
-        if (mObjects.empty()) {
-            INC_METRIC_IF_DEBUG(Created)
+        INC_POOL_METRIC(Obtained)
+        std::unique_ptr<T> o;
+        {
+            std::scoped_lock<std::mutex> lock(mLock);
+            if (!mObjects.empty()) {
+                // Reuse the most recently recycled object since it is most likely still in cache.
+                PooledObject& pooledObject = mObjects.back();
+                mPoolObjectsSize -= pooledObject.size;
+                o = std::move(pooledObject.object);
+                mObjects.pop_back();
+            }
+        }
+        if (o == nullptr) {
+            INC_POOL_METRIC(Created)
             return wrap(createObject());
         }
-
-        auto o = wrap(mObjects.front().release());
-        mObjects.pop_front();
-        mPoolObjectsSize -= mGetSizeFunc(*o);
-        return o;
+        return wrap(o.release());
     }
 
     ObjectPool& operator=(const ObjectPool&) = delete;
@@ -100,46 +122,49 @@ class ObjectPool {
     virtual T* createObject() = 0;
 
     virtual void recycle(T* o) {
-        std::scoped_lock<std::mutex> lock(mLock);
+        // The object size is calculated outside the lock since it might be expensive for objects
+        // containing vectors.
         size_t objectSize = mGetSizeFunc(*o);
-
-        if (objectSize > mMaxPoolObjectsSize ||
-            mPoolObjectsSize > mMaxPoolObjectsSize - objectSize) {
-            INC_METRIC_IF_DEBUG(Deleted)
-
-            // We have no space left in the pool.
-            delete o;
-            return;
+        {
+            std::scoped_lock<std::mutex> lock(mLock);
+            if (objectSize <= mMaxPoolObjectsSize &&
+                mPoolObjectsSize <= mMaxPoolObjectsSize - objectSize) {
+                mObjects.push_back(PooledObject{
+                        .object = std::unique_ptr<T>{o},
+                        .size = objectSize,
+                });
+                mPoolObjectsSize += objectSize;
+                INC_POOL_METRIC(Recycled)
+                return;
+            }
         }
 
-        INC_METRIC_IF_DEBUG(Recycled)
-
-        mObjects.push_back(std::unique_ptr<T>{o});
-        mPoolObjectsSize += objectSize;
+        INC_POOL_METRIC(Deleted)
+        // We have no space left in the pool.
+        delete o;
     }
 
     const size_t mMaxPoolObjectsSize;
 
   private:
-    const Deleter<T>& getDeleter() {
-        if (!mDeleter.get()) {
-            Deleter<T>* d =
-                    new Deleter<T>(std::bind(&ObjectPool::recycle, this, std::placeholders::_1));
-            mDeleter.reset(d);
-        }
-        return *mDeleter.get();
-    }
+    struct PooledObject {
+        std::unique_ptr<T> object;
+        // The size calculated by mGetSizeFunc when the object was recycled.
+        size_t size;
+    };
 
-    recyclable_ptr<T> wrap(T* raw) { return recyclable_ptr<T>{raw, getDeleter()}; }
+    recyclable_ptr<T> wrap(T* raw) { return recyclable_ptr<T>{raw, *mDeleter}; }
 
     mutable std::mutex mLock;
-    std::deque<std::unique_ptr<T>> mObjects GUARDED_BY(mLock);
-    std::unique_ptr<Deleter<T>> mDeleter;
-    size_t mPoolObjectsSize GUARDED_BY(mLock);
+    // Used as a stack, the most recently recycled object is obtained first.
+    std::vector<PooledObject> mObjects GUARDED_BY(mLock);
+    // Only initialized in constructor, so it is thread-safe.
+    const std::unique_ptr<Deleter<T>> mDeleter;
+    size_t mPoolObjectsSize GUARDED_BY(mLock) = 0;
     GetSizeFunc mGetSizeFunc;
 };
 
-#undef INC_METRIC_IF_DEBUG
+#undef INC_POOL_METRIC
 
 // This class provides a pool of recyclable VehiclePropertyValue objects.
 //
@@ -180,9 +205,9 @@ class VehiclePropValuePool {
     // @param maxPoolObjectsSize - The approximate upper bound of memory each internal recycling
     // pool could take. We have 4 different type pools, each with 4 different vector size, so
     // approximately this pool would at-most take 4 * 4 * 10240 = 160k memory.
-    VehiclePropValuePool(size_t maxRecyclableVectorSize = 4, size_t maxPoolObjectsSize = 10240)
-        : mMaxRecyclableVectorSize(maxRecyclableVectorSize),
-          mMaxPoolObjectsSize(maxPoolObjectsSize){};
+    // All the internal pools are created during construction, so obtaining an object only locks
+    // the internal pool for the requested type and vector size.
+    VehiclePropValuePool(size_t maxRecyclableVectorSize = 4, size_t maxPoolObjectsSize = 10240);
 
     // Obtain a recyclable VehiclePropertyValue object from the pool for the given type. If the
     // given type is not MIXED or STRING, the internal value vector size would be set to 1.
@@ -277,12 +302,13 @@ class VehiclePropValuePool {
                         delete v;
                     }};
 
-    mutable std::mutex mLock;
     const size_t mMaxRecyclableVectorSize;
     const size_t mMaxPoolObjectsSize;
     // A map with 'property_type' | 'value_vector_size' as key and a recyclable object pool as
-    // value. We would create a recyclable pool for each property type and vector size combination.
-    std::map<int32_t, std::unique_ptr<InternalPool>> mValueTypePools GUARDED_BY(mLock);
+    // value. A recyclable pool is created for each recyclable property type and vector size
+    // combination during construction and the map is never modified afterwards, so it could be
+    // read without lock.
+    std::unordered_map<int32_t, std::unique_ptr<InternalPool>> mValueTypePools;
 };
 
 }  // namespace vehicle
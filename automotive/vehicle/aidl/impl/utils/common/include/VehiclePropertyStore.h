@@ -17,10 +17,14 @@
 #ifndef android_hardware_automotive_vehicle_aidl_impl_utils_common_include_VehiclePropertyStore_H_
 #define android_hardware_automotive_vehicle_aidl_impl_utils_common_include_VehiclePropertyStore_H_
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <unordered_map>
 
 #include <VehicleHalTypes.h>
@@ -40,7 +44,9 @@ namespace vehicle {
 // VehiclePropertyValues stored in a sorted map thus it makes easier to get range of values, e.g.
 // to get value for all areas for particular property.
 //
-// This class is thread-safe, however it uses blocking synchronization across all methods.
+// This class is thread-safe. The records for each property are guarded by one of a fixed set of
+// lock stripes chosen by the property ID, so that reads and writes for unrelated properties could
+// proceed in parallel. Registering a property blocks all the other operations.
 class VehiclePropertyStore final {
   public:
     using ValueResultType = VhalResult<VehiclePropValuePool::RecyclableType>;
@@ -176,6 +182,13 @@ class VehiclePropertyStore final {
 
     inline std::shared_ptr<VehiclePropValuePool> getValuePool() { return mValuePool; }
 
+    // Returns how many times an operation had to wait for a record lock stripe held by another
+    // thread.
+    uint64_t getLockContentionCount() const;
+
+    // Dumps the internal state of the store, e.g. the lock contention statistics.
+    std::string dump() const;
+
   private:
     struct RecordId {
         int32_t area;
@@ -196,15 +209,29 @@ class VehiclePropertyStore final {
         std::unordered_map<RecordId, VehiclePropValuePool::RecyclableType, RecordIdHash> values;
     };
 
+    // The number of lock stripes guarding the property records.
+    static constexpr size_t LOCK_STRIPE_COUNT = 16;
+
     // {@code VehiclePropValuePool} is thread-safe.
     std::shared_ptr<VehiclePropValuePool> mValuePool;
-    mutable std::mutex mLock;
-    std::unordered_map<int32_t, Record> mRecordsByPropId GUARDED_BY(mLock);
-    OnValueChangeCallback mOnValueChangeCallback GUARDED_BY(mLock);
-    OnValuesChangeCallback mOnValuesChangeCallback GUARDED_BY(mLock);
-
+    // mLock guards the structure of mRecordsByPropId. It is held in shared mode while accessing a
+    // record and in exclusive mode while adding or replacing records. The content of each record
+    // is additionally guarded by the lock stripe returned by {@code getRecordLock}.
+    mutable std::shared_mutex mLock;
+    mutable std::array<std::mutex, LOCK_STRIPE_COUNT> mRecordLocks;
+    mutable std::atomic<uint64_t> mLockContentionCount = 0;
+    std::unordered_map<int32_t, Record> mRecordsByPropId;
+    mutable std::mutex mCallbackLock;
+    OnValueChangeCallback mOnValueChangeCallback GUARDED_BY(mCallbackLock);
+    OnValuesChangeCallback mOnValuesChangeCallback GUARDED_BY(mCallbackLock);
+
+    // Locks the lock stripe for the property. Must be called with mLock held.
+    std::unique_lock<std::mutex> lockRecord(int32_t propId) const;
+
+    // Must be called with mLock held.
     const Record* getRecordLocked(int32_t propId) const;
 
+    // Must be called with mLock held.
     Record* getRecordLocked(int32_t propId);
 
     RecordId getRecordIdLocked(
@@ -24,6 +24,10 @@
 #include <math/HashCombine.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -333,16 +337,37 @@ inline std::string propIdToString(int32_t propId) {
             static_cast<aidl::android::hardware::automotive::vehicle::VehicleProperty>(propId));
 }
 
+// Rounds {@code size} values in {@code input} to the nearest multiple of {@code resolution} and
+// writes them to {@code output}, which could be the same as {@code input}. The loop has no branch
+// so that it could be auto-vectorized.
 template <typename T>
-void roundToNearestResolution(std::vector<T>& arrayToSanitize, float resolution) {
+void roundToNearestResolution(const T* input, T* output, size_t size, float resolution) {
     if (resolution == 0) {
+        if (input != output) {
+            std::copy(input, input + size, output);
+        }
         return;
     }
-    for (size_t i = 0; i < arrayToSanitize.size(); i++) {
-        arrayToSanitize[i] = (T)((std::round(arrayToSanitize[i] / resolution)) * resolution);
+    for (size_t i = 0; i < size; i++) {
+        output[i] = (T)((std::round(input[i] / resolution)) * resolution);
     }
 }
 
+template <typename T>
+void roundToNearestResolution(std::vector<T>& arrayToSanitize, float resolution) {
+    roundToNearestResolution(arrayToSanitize.data(), arrayToSanitize.data(),
+                             arrayToSanitize.size(), resolution);
+}
+
+// Same as {@code roundToNearestResolution} above, but writes the result to {@code output}, reusing
+// its capacity.
+template <typename T>
+void roundToNearestResolution(const std::vector<T>& input, float resolution,
+                              std::vector<T>* output) {
+    output->resize(input.size());
+    roundToNearestResolution(input.data(), output->data(), input.size(), resolution);
+}
+
 inline void sanitizeByResolution(aidl::android::hardware::automotive::vehicle::RawPropValues* value,
                                  float resolution) {
     roundToNearestResolution(value->int32Values, resolution);
@@ -350,6 +375,18 @@ inline void sanitizeByResolution(aidl::android::hardware::automotive::vehicle::R
     roundToNearestResolution(value->int64Values, resolution);
 }
 
+// Copies {@code input} to {@code output} with the numeric values rounded by {@code resolution}.
+// Each array is copied and rounded in one pass.
+inline void sanitizeByResolution(
+        const aidl::android::hardware::automotive::vehicle::RawPropValues& input,
+        float resolution, aidl::android::hardware::automotive::vehicle::RawPropValues* output) {
+    roundToNearestResolution(input.int32Values, resolution, &output->int32Values);
+    roundToNearestResolution(input.floatValues, resolution, &output->floatValues);
+    roundToNearestResolution(input.int64Values, resolution, &output->int64Values);
+    output->byteValues = input.byteValues;
+    output->stringValue = input.stringValue;
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -69,12 +69,12 @@ PendingRequestPool::~PendingRequestPool() {
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
-        for (auto& [_, pendingRequests] : mPendingRequestsByClient) {
-            for (const auto& request : pendingRequests) {
-                (*request.callback)(request.requestIds);
-            }
+        for (const auto& [_, request] : mPendingRequestsByBatchId) {
+            (*request.callback)(request.requestIds);
         }
-        mPendingRequestsByClient.clear();
+        mPendingRequestsByBatchId.clear();
+        mBatchIdByRequestIdByClient.clear();
+        mBatchIdsByDeadlineBucket.clear();
     }
 }
 
@@ -82,37 +82,43 @@ VhalResult<void> PendingRequestPool::addRequests(
         const void* clientId, const std::unordered_set<int64_t>& requestIds,
         std::shared_ptr<const TimeoutCallbackFunc> callback) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
-    std::list<PendingRequest>* pendingRequests;
+
     size_t pendingRequestCount = 0;
-    if (mPendingRequestsByClient.find(clientId) != mPendingRequestsByClient.end()) {
-        pendingRequests = &mPendingRequestsByClient[clientId];
-        for (const auto& pendingRequest : *pendingRequests) {
-            const auto& pendingRequestIds = pendingRequest.requestIds;
-            for (int64_t requestId : requestIds) {
-                if (pendingRequestIds.find(requestId) != pendingRequestIds.end()) {
-                    return StatusError(StatusCode::INVALID_ARG)
-                           << "duplicate request ID: " << requestId;
-                }
+    auto clientIt = mBatchIdByRequestIdByClient.find(clientId);
+    if (clientIt != mBatchIdByRequestIdByClient.end()) {
+        const auto& batchIdByRequestId = clientIt->second;
+        for (int64_t requestId : requestIds) {
+            if (batchIdByRequestId.find(requestId) != batchIdByRequestId.end()) {
+                return StatusError(StatusCode::INVALID_ARG)
+                       << "duplicate request ID: " << requestId;
             }
-            pendingRequestCount += pendingRequestIds.size();
         }
-    } else {
-        // Create a new empty list for this client.
-        pendingRequests = &mPendingRequestsByClient[clientId];
+        pendingRequestCount = batchIdByRequestId.size();
     }
 
     if (requestIds.size() > MAX_PENDING_REQUEST_PER_CLIENT - pendingRequestCount) {
         return StatusError(StatusCode::TRY_AGAIN) << "too many pending requests";
     }
 
+    if (requestIds.empty()) {
+        return {};
+    }
+
     int64_t currentTime = elapsedRealtimeNano();
     int64_t timeoutTimestamp = currentTime + mTimeoutInNano;
+    uint64_t batchId = mNextBatchId++;
 
-    pendingRequests->push_back({
-            .requestIds = std::unordered_set<int64_t>(requestIds.begin(), requestIds.end()),
+    auto& batchIdByRequestId = mBatchIdByRequestIdByClient[clientId];
+    for (int64_t requestId : requestIds) {
+        batchIdByRequestId[requestId] = batchId;
+    }
+    mPendingRequestsByBatchId[batchId] = {
+            .clientId = clientId,
+            .requestIds = requestIds,
             .timeoutTimestamp = timeoutTimestamp,
             .callback = callback,
-    });
+    };
+    mBatchIdsByDeadlineBucket[timeoutTimestamp / DEADLINE_BUCKET_IN_NANO].push_back(batchId);
 
     return {};
 }
@@ -120,17 +126,19 @@ VhalResult<void> PendingRequestPool::addRequests(
 bool PendingRequestPool::isRequestPending(const void* clientId, int64_t requestId) const {
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
-    return isRequestPendingLocked(clientId, requestId);
+    auto it = mBatchIdByRequestIdByClient.find(clientId);
+    if (it == mBatchIdByRequestIdByClient.end()) {
+        return false;
+    }
+    return it->second.find(requestId) != it->second.end();
 }
 
 size_t PendingRequestPool::countPendingRequests() const {
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
     size_t count = 0;
-    for (const auto& [clientId, requests] : mPendingRequestsByClient) {
-        for (const auto& request : requests) {
-            count += request.requestIds.size();
-        }
+    for (const auto& [_, batchIdByRequestId] : mBatchIdByRequestIdByClient) {
+        count += batchIdByRequestId.size();
     }
     return count;
 }
@@ -138,31 +146,11 @@ size_t PendingRequestPool::countPendingRequests() const {
 size_t PendingRequestPool::countPendingRequests(const void* clientId) const {
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
-    auto it = mPendingRequestsByClient.find(clientId);
-    if (it == mPendingRequestsByClient.end()) {
+    auto it = mBatchIdByRequestIdByClient.find(clientId);
+    if (it == mBatchIdByRequestIdByClient.end()) {
         return 0;
     }
-
-    size_t count = 0;
-    for (const auto& pendingRequest : it->second) {
-        count += pendingRequest.requestIds.size();
-    }
-
-    return count;
-}
-
-bool PendingRequestPool::isRequestPendingLocked(const void* clientId, int64_t requestId) const {
-    auto it = mPendingRequestsByClient.find(clientId);
-    if (it == mPendingRequestsByClient.end()) {
-        return false;
-    }
-    for (const auto& pendingRequest : it->second) {
-        const auto& requestIds = pendingRequest.requestIds;
-        if (requestIds.find(requestId) != requestIds.end()) {
-            return true;
-        }
-    }
-    return false;
+    return it->second.size();
 }
 
 void PendingRequestPool::checkTimeout() {
@@ -172,25 +160,45 @@ void PendingRequestPool::checkTimeout() {
 
         int64_t currentTime = elapsedRealtimeNano();
 
-        std::vector<const void*> clientsWithEmptyRequests;
+        while (!mBatchIdsByDeadlineBucket.empty()) {
+            auto bucketIt = mBatchIdsByDeadlineBucket.begin();
+            if (bucketIt->first * DEADLINE_BUCKET_IN_NANO > currentTime) {
+                // All the remaining requests have not timed-out.
+                break;
+            }
 
-        for (auto& [clientId, pendingRequests] : mPendingRequestsByClient) {
-            auto it = pendingRequests.begin();
-            while (it != pendingRequests.end()) {
-                if (it->timeoutTimestamp >= currentTime) {
-                    break;
+            std::vector<uint64_t> notTimeoutBatchIds;
+            for (uint64_t batchId : bucketIt->second) {
+                auto batchIt = mPendingRequestsByBatchId.find(batchId);
+                if (batchIt == mPendingRequestsByBatchId.end()) {
+                    // All the requests in this batch are already finished.
+                    continue;
+                }
+                if (batchIt->second.timeoutTimestamp >= currentTime) {
+                    notTimeoutBatchIds.push_back(batchId);
+                    continue;
                 }
-                timeoutRequests.push_back(std::move(*it));
-                it = pendingRequests.erase(it);
-            }
 
-            if (pendingRequests.empty()) {
-                clientsWithEmptyRequests.push_back(clientId);
+                PendingRequest& request = batchIt->second;
+                auto clientIt = mBatchIdByRequestIdByClient.find(request.clientId);
+                if (clientIt != mBatchIdByRequestIdByClient.end()) {
+                    for (int64_t requestId : request.requestIds) {
+                        clientIt->second.erase(requestId);
+                    }
+                    if (clientIt->second.empty()) {
+                        mBatchIdByRequestIdByClient.erase(clientIt);
+                    }
+                }
+                timeoutRequests.push_back(std::move(request));
+                mPendingRequestsByBatchId.erase(batchIt);
             }
-        }
 
-        for (const void* clientId : clientsWithEmptyRequests) {
-            mPendingRequestsByClient.erase(clientId);
+            if (!notTimeoutBatchIds.empty()) {
+                // The current time is within this bucket, so the later buckets have not timed-out.
+                bucketIt->second = std::move(notTimeoutBatchIds);
+                break;
+            }
+            mBatchIdsByDeadlineBucket.erase(bucketIt);
         }
     }
 
@@ -206,27 +214,33 @@ std::unordered_set<int64_t> PendingRequestPool::tryFinishRequests(
 
     std::unordered_set<int64_t> foundIds;
 
-    if (mPendingRequestsByClient.find(clientId) == mPendingRequestsByClient.end()) {
+    auto clientIt = mBatchIdByRequestIdByClient.find(clientId);
+    if (clientIt == mBatchIdByRequestIdByClient.end()) {
         return foundIds;
     }
 
-    auto& pendingRequests = mPendingRequestsByClient[clientId];
-    auto it = pendingRequests.begin();
-    while (it != pendingRequests.end()) {
-        auto& pendingRequestIds = it->requestIds;
-        for (int64_t requestId : requestIds) {
-            auto idIt = pendingRequestIds.find(requestId);
-            if (idIt == pendingRequestIds.end()) {
-                continue;
-            }
-            pendingRequestIds.erase(idIt);
-            foundIds.insert(requestId);
+    auto& batchIdByRequestId = clientIt->second;
+    for (int64_t requestId : requestIds) {
+        auto idIt = batchIdByRequestId.find(requestId);
+        if (idIt == batchIdByRequestId.end()) {
+            continue;
         }
-        if (pendingRequestIds.empty()) {
-            it = pendingRequests.erase(it);
+        uint64_t batchId = idIt->second;
+        batchIdByRequestId.erase(idIt);
+        foundIds.insert(requestId);
+
+        auto batchIt = mPendingRequestsByBatchId.find(batchId);
+        if (batchIt == mPendingRequestsByBatchId.end()) {
             continue;
         }
-        it++;
+        batchIt->second.requestIds.erase(requestId);
+        if (batchIt->second.requestIds.empty()) {
+            // The batch ID in the deadline wheel would be removed once its bucket expires.
+            mPendingRequestsByBatchId.erase(batchIt);
+        }
+    }
+    if (batchIdByRequestId.empty()) {
+        mBatchIdByRequestIdByClient.erase(clientIt);
     }
 
     return foundIds;
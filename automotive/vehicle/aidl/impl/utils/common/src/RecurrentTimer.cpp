@@ -36,7 +36,9 @@ constexpr int INVALID_ID = -1;
 
 }  // namespace
 
-RecurrentTimer::RecurrentTimer() {
+RecurrentTimer::RecurrentTimer() : RecurrentTimer(/*slackInNanos=*/0) {}
+
+RecurrentTimer::RecurrentTimer(int64_t slackInNanos) : mSlackInNanos(slackInNanos) {
     mHandler = sp<RecurrentMessageHandler>::make(this);
     mLooper = sp<Looper>::make(/*allowNonCallbacks=*/false);
     mThread = std::thread([this] {
@@ -65,6 +67,32 @@ int RecurrentTimer::getCallbackIdLocked(std::shared_ptr<RecurrentTimer::Callback
     return INVALID_ID;
 }
 
+bool RecurrentTimer::isOutdatedLocked(const Deadline& deadline) {
+    auto it = mCallbackInfoById.find(deadline.callbackId);
+    return it == mCallbackInfoById.end() || it->second->nextTimeInNanos != deadline.timeInNanos;
+}
+
+void RecurrentTimer::scheduleNextWakeupLocked() {
+    // Drop the outdated deadlines so that we do not wake up for nothing.
+    while (!mDeadlines.empty() && isOutdatedLocked(mDeadlines.top())) {
+        mDeadlines.pop();
+    }
+    if (mDeadlines.empty()) {
+        if (mScheduledWakeupTimeInNanos != -1) {
+            mLooper->removeMessages(mHandler);
+            mScheduledWakeupTimeInNanos = -1;
+        }
+        return;
+    }
+    int64_t wakeupTimeInNanos = mDeadlines.top().timeInNanos;
+    if (wakeupTimeInNanos == mScheduledWakeupTimeInNanos) {
+        return;
+    }
+    mLooper->removeMessages(mHandler);
+    mLooper->sendMessageAtTime(wakeupTimeInNanos, mHandler, Message());
+    mScheduledWakeupTimeInNanos = wakeupTimeInNanos;
+}
+
 void RecurrentTimer::registerTimerCallback(int64_t intervalInNanos,
                                            std::shared_ptr<RecurrentTimer::Callback> callback) {
     {
@@ -79,7 +107,6 @@ void RecurrentTimer::registerTimerCallback(int64_t intervalInNanos,
             ALOGI("Replacing an existing timer callback with a new interval, current: %" PRId64
                   " ns, new: %" PRId64 " ns",
                   mCallbackInfoById[callbackId]->intervalInNanos, intervalInNanos);
-            mLooper->removeMessages(mHandler, callbackId);
         }
 
         // Aligns the nextTime to multiply of interval.
@@ -89,9 +116,11 @@ void RecurrentTimer::registerTimerCallback(int64_t intervalInNanos,
         info->callback = callback;
         info->intervalInNanos = intervalInNanos;
         info->nextTimeInNanos = nextTimeInNanos;
-        mCallbackInfoById.insert({callbackId, std::move(info)});
+        // The previous deadline for this callback, if any, becomes outdated.
+        mCallbackInfoById[callbackId] = std::move(info);
 
-        mLooper->sendMessageAtTime(nextTimeInNanos, mHandler, Message(callbackId));
+        mDeadlines.push({nextTimeInNanos, callbackId});
+        scheduleNextWakeupLocked();
     }
 }
 
@@ -106,37 +135,47 @@ void RecurrentTimer::unregisterTimerCallback(std::shared_ptr<RecurrentTimer::Cal
             return;
         }
 
-        mLooper->removeMessages(mHandler, callbackId);
         mCallbackInfoById.erase(callbackId);
         mIdByCallback.erase(callback);
+        scheduleNextWakeupLocked();
     }
 }
 
-void RecurrentTimer::handleMessage(const Message& message) {
-    std::shared_ptr<RecurrentTimer::Callback> callback;
+void RecurrentTimer::handleMessage(const Message&) {
+    std::vector<std::shared_ptr<RecurrentTimer::Callback>> callbacks;
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
-        int callbackId = message.what;
-
-        auto it = mCallbackInfoById.find(callbackId);
-        if (it == mCallbackInfoById.end()) {
-            ALOGW("The event for callback ID: %d is outdated, ignore", callbackId);
-            return;
-        }
-
-        CallbackInfo* callbackInfo = it->second.get();
-        callback = callbackInfo->callback;
+        mScheduledWakeupTimeInNanos = -1;
         int64_t nowNanos = uptimeNanos();
-        // intervalCount is the number of interval we have to advance until we pass now.
-        size_t intervalCount =
-                (nowNanos - callbackInfo->nextTimeInNanos) / callbackInfo->intervalInNanos + 1;
-        callbackInfo->nextTimeInNanos += intervalCount * callbackInfo->intervalInNanos;
+        while (!mDeadlines.empty() && mDeadlines.top().timeInNanos <= nowNanos + mSlackInNanos) {
+            Deadline deadline = mDeadlines.top();
+            mDeadlines.pop();
+            if (isOutdatedLocked(deadline)) {
+                continue;
+            }
+
+            CallbackInfo* callbackInfo = mCallbackInfoById[deadline.callbackId].get();
+            callbacks.push_back(callbackInfo->callback);
+            if (callbackInfo->nextTimeInNanos <= nowNanos) {
+                // intervalCount is the number of interval we have to advance until we pass now.
+                size_t intervalCount = (nowNanos - callbackInfo->nextTimeInNanos) /
+                                               callbackInfo->intervalInNanos +
+                                       1;
+                callbackInfo->nextTimeInNanos += intervalCount * callbackInfo->intervalInNanos;
+            } else {
+                // The callback is invoked early within the slack window.
+                callbackInfo->nextTimeInNanos += callbackInfo->intervalInNanos;
+            }
+            mDeadlines.push({callbackInfo->nextTimeInNanos, deadline.callbackId});
+        }
 
-        mLooper->sendMessageAtTime(callbackInfo->nextTimeInNanos, mHandler, Message(callbackId));
+        scheduleNextWakeupLocked();
     }
 
-    (*callback)();
+    for (const auto& callback : callbacks) {
+        (*callback)();
+    }
 }
 
 void RecurrentMessageHandler::handleMessage(const Message& message) {
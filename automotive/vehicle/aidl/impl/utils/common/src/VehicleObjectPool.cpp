@@ -33,6 +33,37 @@ using ::aidl::android::hardware::automotive::vehicle::VehicleProperty;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
 
+namespace {
+
+// All the property types that could be stored in a recyclable pool.
+constexpr VehiclePropertyType RECYCLABLE_TYPES[] = {
+        VehiclePropertyType::BOOLEAN,   VehiclePropertyType::INT32,
+        VehiclePropertyType::INT32_VEC, VehiclePropertyType::INT64,
+        VehiclePropertyType::INT64_VEC, VehiclePropertyType::FLOAT,
+        VehiclePropertyType::FLOAT_VEC, VehiclePropertyType::BYTES,
+};
+
+// VehiclePropertyType is not overlapping with vectorSize.
+int32_t getPoolKey(VehiclePropertyType type, size_t vectorSize) {
+    return static_cast<int32_t>(type) | static_cast<int32_t>(vectorSize);
+}
+
+}  // namespace
+
+VehiclePropValuePool::VehiclePropValuePool(size_t maxRecyclableVectorSize,
+                                           size_t maxPoolObjectsSize)
+    : mMaxRecyclableVectorSize(maxRecyclableVectorSize), mMaxPoolObjectsSize(maxPoolObjectsSize) {
+    for (VehiclePropertyType type : RECYCLABLE_TYPES) {
+        size_t maxVectorSize = isSingleValueType(type) ? 1 : mMaxRecyclableVectorSize;
+        for (size_t vectorSize = 1; vectorSize <= maxVectorSize; vectorSize++) {
+            mValueTypePools.emplace(
+                    getPoolKey(type, vectorSize),
+                    std::make_unique<InternalPool>(type, vectorSize, mMaxPoolObjectsSize,
+                                                   getVehiclePropValueSize));
+        }
+    }
+}
+
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(VehiclePropertyType type) {
     if (isComplexType(type)) {
         return obtain(type, 0);
@@ -96,17 +127,12 @@ VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainComplex() {
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainRecyclable(
         VehiclePropertyType type, size_t vectorSize) {
-    std::scoped_lock<std::mutex> lock(mLock);
     assert(vectorSize > 0);
 
-    // VehiclePropertyType is not overlapping with vectorSize.
-    int32_t key = static_cast<int32_t>(type) | static_cast<int32_t>(vectorSize);
-    auto it = mValueTypePools.find(key);
-
+    auto it = mValueTypePools.find(getPoolKey(type, vectorSize));
     if (it == mValueTypePools.end()) {
-        auto newPool(std::make_unique<InternalPool>(type, vectorSize, mMaxPoolObjectsSize,
-                                                    getVehiclePropValueSize));
-        it = mValueTypePools.emplace(key, std::move(newPool)).first;
+        // Not a known recyclable property type.
+        return obtainDisposable(type, vectorSize);
     }
     return it->second->obtain();
 }
@@ -56,28 +56,35 @@ size_t VehiclePropertyStore::RecordIdHash::operator()(RecordId const& recordId)
 }
 
 VehiclePropertyStore::~VehiclePropertyStore() {
-    std::scoped_lock<std::mutex> lockGuard(mLock);
+    std::unique_lock<std::shared_mutex> lockGuard(mLock);
 
     // Recycling record requires mValuePool, so need to recycle them before destroying mValuePool.
     mRecordsByPropId.clear();
     mValuePool.reset();
 }
 
-const VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId) const
-        REQUIRES(mLock) {
+std::unique_lock<std::mutex> VehiclePropertyStore::lockRecord(int32_t propId) const {
+    std::unique_lock<std::mutex> lock(
+            mRecordLocks[static_cast<uint32_t>(propId) % LOCK_STRIPE_COUNT], std::try_to_lock);
+    if (!lock.owns_lock()) {
+        mLockContentionCount++;
+        lock.lock();
+    }
+    return lock;
+}
+
+const VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId) const {
     auto RecordIt = mRecordsByPropId.find(propId);
     return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
 }
 
-VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId)
-        REQUIRES(mLock) {
+VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId) {
     auto RecordIt = mRecordsByPropId.find(propId);
     return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
 }
 
 VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
-        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const
-        REQUIRES(mLock) {
+        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const {
     VehiclePropertyStore::RecordId recId{
             .area = isGlobalProp(propValue.prop) ? 0 : propValue.areaId, .token = 0};
 
@@ -88,7 +95,7 @@ VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
 }
 
 VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValueLocked(
-        const RecordId& recId, const Record& record) const REQUIRES(mLock) {
+        const RecordId& recId, const Record& record) const {
     if (auto it = record.values.find(recId); it != record.values.end()) {
         return mValuePool->obtain(*(it->second));
     }
@@ -98,7 +105,7 @@ VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValue
 
 void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
                                             VehiclePropertyStore::TokenFunction tokenFunc) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::unique_lock<std::shared_mutex> g(mLock);
 
     mRecordsByPropId[config.prop] = Record{
             .propConfig = config,
@@ -117,7 +124,11 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
     int32_t propId;
     int32_t areaId;
     {
-        std::scoped_lock<std::mutex> g(mLock);
+        propId = propValue->prop;
+        areaId = propValue->areaId;
+
+        std::shared_lock<std::shared_mutex> g(mLock);
+        std::unique_lock<std::mutex> recordLock = lockRecord(propId);
 
         // Must set timestamp inside the lock to make sure no other writeValue will update the
         // the timestamp to a newer one while we are writing this value.
@@ -125,9 +136,6 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
             propValue->timestamp = elapsedRealtimeNano();
         }
 
-        propId = propValue->prop;
-        areaId = propValue->areaId;
-
         VehiclePropertyStore::Record* record = getRecordLocked(propId);
         if (record == nullptr) {
             return StatusError(StatusCode::INVALID_ARG)
@@ -167,6 +175,9 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
             return {};
         }
         updatedValue = *(record->values[recId]);
+    }
+    {
+        std::scoped_lock<std::mutex> g(mCallbackLock);
 
         onValuesChangeCallback = mOnValuesChangeCallback;
         onValueChangeCallback = mOnValueChangeCallback;
@@ -206,14 +217,18 @@ void VehiclePropertyStore::refreshTimestamps(
     OnValuesChangeCallback onValuesChangeCallback = nullptr;
     OnValueChangeCallback onValueChangeCallback = nullptr;
     {
-        std::scoped_lock<std::mutex> g(mLock);
+        std::scoped_lock<std::mutex> g(mCallbackLock);
 
         onValuesChangeCallback = mOnValuesChangeCallback;
         onValueChangeCallback = mOnValueChangeCallback;
+    }
+    {
+        std::shared_lock<std::shared_mutex> g(mLock);
 
         for (const auto& [propIdAreaId, eventMode] : eventModeByPropIdAreaId) {
             int32_t propId = propIdAreaId.propId;
             int32_t areaId = propIdAreaId.areaId;
+            std::unique_lock<std::mutex> recordLock = lockRecord(propId);
             VehiclePropertyStore::Record* record = getRecordLocked(propId);
             if (record == nullptr) {
                 continue;
@@ -261,7 +276,8 @@ void VehiclePropertyStore::refreshTimestamps(
 }
 
 void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
+    std::unique_lock<std::mutex> recordLock = lockRecord(propValue.prop);
 
     VehiclePropertyStore::Record* record = getRecordLocked(propValue.prop);
     if (record == nullptr) {
@@ -275,7 +291,8 @@ void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
 }
 
 void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
+    std::unique_lock<std::mutex> recordLock = lockRecord(propId);
 
     VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -286,11 +303,12 @@ void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
 }
 
 std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllValues() const {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
 
     std::vector<VehiclePropValuePool::RecyclableType> allValues;
 
-    for (auto const& [_, record] : mRecordsByPropId) {
+    for (auto const& [propId, record] : mRecordsByPropId) {
+        std::unique_lock<std::mutex> recordLock = lockRecord(propId);
         for (auto const& [_, value] : record.values) {
             allValues.push_back(std::move(mValuePool->obtain(*value)));
         }
@@ -301,7 +319,8 @@ std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllV
 
 VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProperty(
         int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
+    std::unique_lock<std::mutex> recordLock = lockRecord(propId);
 
     std::vector<VehiclePropValuePool::RecyclableType> values;
 
@@ -318,9 +337,10 @@ VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProper
 
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(
         const VehiclePropValue& propValue) const {
-    std::scoped_lock<std::mutex> g(mLock);
-
     int32_t propId = propValue.prop;
+
+    std::shared_lock<std::shared_mutex> g(mLock);
+    std::unique_lock<std::mutex> recordLock = lockRecord(propId);
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
@@ -333,7 +353,8 @@ VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t propId,
                                                                       int32_t areaId,
                                                                       int64_t token) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
+    std::unique_lock<std::mutex> recordLock = lockRecord(propId);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -345,7 +366,8 @@ VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t pr
 }
 
 std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
-    std::scoped_lock<std::mutex> g(mLock);
+    // Configs are only modified while holding mLock exclusively, so no record lock is required.
+    std::shared_lock<std::shared_mutex> g(mLock);
 
     std::vector<VehiclePropConfig> configs;
     configs.reserve(mRecordsByPropId.size());
@@ -356,7 +378,7 @@ std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
 }
 
 VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -367,7 +389,7 @@ VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t pro
 }
 
 VhalResult<VehiclePropConfig> VehiclePropertyStore::getPropConfig(int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::shared_lock<std::shared_mutex> g(mLock);
 
     const VehiclePropertyStore::Record* record = getRecordLocked(propId);
     if (record == nullptr) {
@@ -379,18 +401,27 @@ VhalResult<VehiclePropConfig> VehiclePropertyStore::getPropConfig(int32_t propId
 
 void VehiclePropertyStore::setOnValueChangeCallback(
         const VehiclePropertyStore::OnValueChangeCallback& callback) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::scoped_lock<std::mutex> g(mCallbackLock);
 
     mOnValueChangeCallback = callback;
 }
 
 void VehiclePropertyStore::setOnValuesChangeCallback(
         const VehiclePropertyStore::OnValuesChangeCallback& callback) {
-    std::scoped_lock<std::mutex> g(mLock);
+    std::scoped_lock<std::mutex> g(mCallbackLock);
 
     mOnValuesChangeCallback = callback;
 }
 
+uint64_t VehiclePropertyStore::getLockContentionCount() const {
+    return mLockContentionCount.load();
+}
+
+std::string VehiclePropertyStore::dump() const {
+    return StringPrintf("Property store lock stripes: %zu, lock contention count: %" PRIu64 "\n",
+                        LOCK_STRIPE_COUNT, getLockContentionCount());
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -140,6 +140,35 @@ TEST_F(PendingRequestPoolTest, testFinishHalfOfRequest) {
     ASSERT_THAT(timeoutRequestIds, WhenSorted(ElementsAre(5, 6, 7, 8, 9)));
 }
 
+TEST_F(PendingRequestPoolTest, testMultipleBatchesTimeout) {
+    int64_t timeout = getTimeout();
+    std::mutex lock;
+    std::vector<int64_t> timeoutRequestIds;
+
+    auto callback = std::make_shared<PendingRequestPool::TimeoutCallbackFunc>(
+            [&lock, &timeoutRequestIds](const std::unordered_set<int64_t>& requests) {
+                std::scoped_lock<std::mutex> lockGuard(lock);
+                for (int64_t request : requests) {
+                    timeoutRequestIds.push_back(request);
+                }
+            });
+
+    ASSERT_RESULT_OK(getPool()->addRequests(getTestClientId(), {0, 1}, callback));
+    ASSERT_RESULT_OK(getPool()->addRequests(getTestClientId(), {2, 3}, callback));
+    ASSERT_RESULT_OK(getPool()->addRequests(getTestClientId(), {4, 5}, callback));
+    ASSERT_EQ(getPool()->countPendingRequests(getTestClientId()), static_cast<size_t>(6));
+
+    // Finish the whole second batch and half of the third batch.
+    ASSERT_THAT(getPool()->tryFinishRequests(getTestClientId(), {2, 3, 4}),
+                UnorderedElementsAre(2, 3, 4));
+    ASSERT_EQ(getPool()->countPendingRequests(getTestClientId()), static_cast<size_t>(3));
+
+    std::this_thread::sleep_for(2 * std::chrono::nanoseconds(timeout));
+
+    std::scoped_lock<std::mutex> lockGuard(lock);
+    ASSERT_THAT(timeoutRequestIds, WhenSorted(ElementsAre(0, 1, 5)));
+}
+
 TEST_F(PendingRequestPoolTest, testFinishRequestTwice) {
     std::mutex lock;
     std::vector<int64_t> timeoutRequestIds;
@@ -185,6 +185,45 @@ TEST_F(RecurrentTimerTest, testRegisterMultipleCallbacks) {
     ASSERT_GE(action3Count, static_cast<size_t>(33));
 }
 
+TEST_F(RecurrentTimerTest, testRegisterMultipleCallbacksWithSlack) {
+    // 0.02s slack.
+    RecurrentTimer timer(/*slackInNanos=*/20'000'000);
+    // 0.1s
+    int64_t interval1 = 100'000'000;
+    auto action1 = getCallback(1);
+    timer.registerTimerCallback(interval1, action1);
+    // 0.09s
+    int64_t interval2 = 90'000'000;
+    auto action2 = getCallback(2);
+    timer.registerTimerCallback(interval2, action2);
+
+    // In 1s, we should generate 10 + 11 = 21 events.
+    // Use 5s as timeout to be safe.
+    ASSERT_TRUE(waitForCalledCallbacks(/* count= */ 21u, /* timeoutInMs= */ 5000))
+            << "Not enough callbacks called before timeout";
+
+    timer.unregisterTimerCallback(action1);
+    timer.unregisterTimerCallback(action2);
+
+    size_t action1Count = 0;
+    size_t action2Count = 0;
+    for (size_t token : getCalledCallbacks()) {
+        if (token == 1) {
+            action1Count++;
+        }
+        if (token == 2) {
+            action2Count++;
+        }
+    }
+
+    // Coalescing must not invoke a callback more often than its own interval. The ratio between
+    // the two counts must stay close to the ratio between the two intervals.
+    ASSERT_GE(action2Count + 2, action1Count);
+    ASSERT_LE(action2Count, action1Count * 2);
+    ASSERT_EQ(countCallbackInfoById(&timer), 0u);
+    ASSERT_EQ(countIdByCallback(&timer), 0u);
+}
+
 TEST_F(RecurrentTimerTest, testRegisterSameCallbackMultipleTimes) {
     RecurrentTimer timer;
     // 0.2s
@@ -187,6 +187,20 @@ TEST_F(VehicleObjectPoolTest, testObtainNewObject) {
     ASSERT_EQ(mStats->Created, 2u);
 }
 
+TEST_F(VehicleObjectPoolTest, testHitRate) {
+    ASSERT_EQ(mStats->getHitRate(), 0.f);
+
+    mValuePool->obtain(VehiclePropertyType::INT32).reset();
+    mValuePool->obtain(VehiclePropertyType::INT32).reset();
+    mValuePool->obtain(VehiclePropertyType::INT32).reset();
+    mValuePool->obtain(VehiclePropertyType::INT32).reset();
+
+    // Only the first obtain creates a new object.
+    ASSERT_EQ(mStats->Obtained, 4u);
+    ASSERT_EQ(mStats->Created, 1u);
+    ASSERT_FLOAT_EQ(mStats->getHitRate(), 0.75f);
+}
+
 TEST_F(VehicleObjectPoolTest, testObtainStrings) {
     mValuePool->obtain(VehiclePropertyType::STRING);
     auto stringProp = mValuePool->obtain(VehiclePropertyType::STRING);
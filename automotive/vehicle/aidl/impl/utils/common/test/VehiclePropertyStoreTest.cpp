@@ -22,6 +22,8 @@
 #include <gtest/gtest.h>
 #include <utils/SystemClock.h>
 
+#include <thread>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -40,6 +42,7 @@ using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
 using ::testing::ElementsAre;
 using ::testing::Eq;
+using ::testing::HasSubstr;
 using ::testing::WhenSortedBy;
 
 constexpr int INVALID_PROP_ID = 0;
@@ -655,6 +658,48 @@ TEST_F(VehiclePropertyStoreTest, testRefreshTimestamps) {
     ASSERT_GE(updatedValues[1].timestamp, now);
 }
 
+
+TEST_F(VehiclePropertyStoreTest, testConcurrentWriteReadDifferentProperties) {
+    constexpr int kIterations = 1000;
+
+    std::thread writer([this] {
+        for (int i = 0; i < kIterations; i++) {
+            VehiclePropValue tirePressure = {
+                    .prop = toInt(VehicleProperty::TIRE_PRESSURE),
+                    .value = {.floatValues = {static_cast<float>(i)}},
+                    .areaId = WHEEL_FRONT_LEFT,
+                    .timestamp = i,
+            };
+            ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(tirePressure)));
+        }
+    });
+    std::thread reader([this] {
+        VehiclePropValue fuelCapacity = {
+                .prop = toInt(VehicleProperty::INFO_FUEL_CAPACITY),
+                .value = {.floatValues = {1.0}},
+        };
+        ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(fuelCapacity)));
+        for (int i = 0; i < kIterations; i++) {
+            auto result = mStore->readValue(toInt(VehicleProperty::INFO_FUEL_CAPACITY));
+            ASSERT_RESULT_OK(result);
+            ASSERT_EQ(result.value()->value.floatValues, std::vector<float>({1.0}));
+        }
+    });
+    writer.join();
+    reader.join();
+
+    auto result = mStore->readValue(toInt(VehicleProperty::TIRE_PRESSURE), WHEEL_FRONT_LEFT);
+
+    ASSERT_RESULT_OK(result);
+    ASSERT_EQ(result.value()->value.floatValues,
+              std::vector<float>({static_cast<float>(kIterations - 1)}));
+}
+
+TEST_F(VehiclePropertyStoreTest, testDump) {
+    ASSERT_EQ(mStore->getLockContentionCount(), 0u);
+    ASSERT_THAT(mStore->dump(), HasSubstr("lock contention count: 0"));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -21,6 +21,9 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -31,6 +34,7 @@ namespace vehicle {
 
 namespace {
 
+using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
 using ::aidl::android::hardware::automotive::vehicle::StatusCode;
 using ::aidl::android::hardware::automotive::vehicle::VehicleArea;
 using ::aidl::android::hardware::automotive::vehicle::VehicleAreaConfig;
@@ -764,12 +768,102 @@ TEST(VehicleUtilsTest, testConcurrentQueueDeactivateNotifyWaitingThread) {
     t.join();
 }
 
+TEST(VehicleUtilsTest, testAffinityWorkerPoolKeepsOrderPerKey) {
+    constexpr size_t keyCount = 8;
+    constexpr int itemCountPerKey = 100;
+    std::mutex lock;
+    std::condition_variable cv;
+    // Maps key to the items received and the thread they are received on.
+    std::map<size_t, std::vector<int>> itemsByKey;
+    std::map<size_t, std::thread::id> threadByKey;
+    bool sameThreadPerKey = true;
+    size_t receivedCount = 0;
+
+    AffinityWorkerPool<std::pair<size_t, int>> pool(
+            /*workerCount=*/4, [&](std::vector<std::pair<size_t, int>> items) {
+                std::scoped_lock<std::mutex> lockGuard(lock);
+                for (const auto& [key, item] : items) {
+                    auto [it, inserted] = threadByKey.try_emplace(key, std::this_thread::get_id());
+                    if (!inserted && it->second != std::this_thread::get_id()) {
+                        sameThreadPerKey = false;
+                    }
+                    itemsByKey[key].push_back(item);
+                    receivedCount++;
+                }
+                cv.notify_all();
+            });
+
+    ASSERT_EQ(pool.getWorkerCount(), 4u);
+
+    for (int i = 0; i < itemCountPerKey; i++) {
+        for (size_t key = 0; key < keyCount; key++) {
+            pool.push(key, {key, i});
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> uniqueLock(lock);
+        ASSERT_TRUE(cv.wait_for(uniqueLock, std::chrono::seconds(10), [&] {
+            return receivedCount == keyCount * itemCountPerKey;
+        }));
+    }
+    pool.stop();
+
+    std::vector<int> expectedItems;
+    for (int i = 0; i < itemCountPerKey; i++) {
+        expectedItems.push_back(i);
+    }
+    ASSERT_TRUE(sameThreadPerKey);
+    for (size_t key = 0; key < keyCount; key++) {
+        ASSERT_EQ(itemsByKey[key], expectedItems) << "items out of order for key: " << key;
+    }
+}
+
+TEST(VehicleUtilsTest, testAffinityWorkerPoolZeroWorkerCount) {
+    AffinityWorkerPool<int> pool(/*workerCount=*/0, [](std::vector<int>) {});
+
+    ASSERT_EQ(pool.getWorkerCount(), 1u);
+}
+
 TEST(VehicleUtilsTest, testVhalError) {
     VhalResult<void> result = Error<VhalError>(StatusCode::INVALID_ARG) << "error message";
 
     ASSERT_EQ(result.error().message(), "error message: INVALID_ARG");
 }
 
+TEST(VehicleUtilsTest, testSanitizeByResolutionToOutput) {
+    RawPropValues input = {
+            .int32Values = {1, 12, -7},
+            .floatValues = {1.04, 2.06, -3.01},
+            .int64Values = {100, 149},
+            .byteValues = {0x1, 0x2},
+            .stringValue = "test",
+    };
+    RawPropValues inPlace = input;
+    sanitizeByResolution(&inPlace, 0.5);
+    // Reuse an output with larger arrays.
+    RawPropValues output = {
+            .int32Values = {0, 0, 0, 0},
+            .floatValues = {0, 0, 0, 0},
+    };
+
+    sanitizeByResolution(input, 0.5, &output);
+
+    ASSERT_EQ(output, inPlace);
+}
+
+TEST(VehicleUtilsTest, testSanitizeByResolutionToOutputZeroResolution) {
+    RawPropValues input = {
+            .int32Values = {1, 12},
+            .floatValues = {1.04, 2.06},
+    };
+    RawPropValues output;
+
+    sanitizeByResolution(input, 0, &output);
+
+    ASSERT_EQ(output, input);
+}
+
 class InvalidPropValueTest : public testing::TestWithParam<InvalidPropValueTestCase> {};
 
 INSTANTIATE_TEST_SUITE_P(InvalidPropValueTests, InvalidPropValueTest,
@@ -0,0 +1,580 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks that drive DefaultVehicleHal end-to-end with a synthetic IVehicleHardware, from the
+// hardware event (or client request) to the client callback.
+//
+// Run with:
+//   atest vhal_benchmark
+// or push the binary to the device and run it with --benchmark_filter=<regex>.
+
+#include "DefaultVehicleHal.h"
+
+#include <IVehicleHardware.h>
+#include <ParcelableUtils.h>
+#include <VehicleHalTypes.h>
+#include <aidl/android/hardware/automotive/vehicle/BnVehicleCallback.h>
+
+#include <android-base/thread_annotations.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+using ::aidl::android::hardware::automotive::vehicle::BnVehicleCallback;
+using ::aidl::android::hardware::automotive::vehicle::GetValueRequest;
+using ::aidl::android::hardware::automotive::vehicle::GetValueRequests;
+using ::aidl::android::hardware::automotive::vehicle::GetValueResult;
+using ::aidl::android::hardware::automotive::vehicle::GetValueResults;
+using ::aidl::android::hardware::automotive::vehicle::SetValueRequest;
+using ::aidl::android::hardware::automotive::vehicle::SetValueRequests;
+using ::aidl::android::hardware::automotive::vehicle::SetValueResult;
+using ::aidl::android::hardware::automotive::vehicle::SetValueResults;
+using ::aidl::android::hardware::automotive::vehicle::StatusCode;
+using ::aidl::android::hardware::automotive::vehicle::SubscribeOptions;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropErrors;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyAccess;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValues;
+
+using ::android::base::ScopedLockAssertion;
+
+using ::ndk::ScopedAStatus;
+using ::ndk::SharedRefBase;
+
+// Gives the benchmarks access to the test-only parts of DefaultVehicleHal.
+class DefaultVehicleHalBenchmark final {
+  public:
+    // A binder lifecycle handler that treats the in-process callbacks as alive. linkToDeath is
+    // not supported on local binders.
+    class AlwaysAliveBinderLifecycleHandler final
+        : public DefaultVehicleHal::BinderLifecycleInterface {
+      public:
+        binder_status_t linkToDeath(AIBinder*, AIBinder_DeathRecipient*, void*) override {
+            return STATUS_OK;
+        }
+
+        bool isAlive(const AIBinder*) override { return true; }
+    };
+
+    static std::shared_ptr<DefaultVehicleHal> createVhal(
+            std::unique_ptr<IVehicleHardware> hardware) {
+        auto vhal = SharedRefBase::make<DefaultVehicleHal>(std::move(hardware));
+        vhal->setBinderLifecycleHandler(std::make_unique<AlwaysAliveBinderLifecycleHandler>());
+        return vhal;
+    }
+};
+
+namespace {
+
+constexpr size_t kMaxPropCount = 256;
+constexpr auto kWaitTimeout = std::chrono::seconds(10);
+
+int32_t onChangeProp(size_t i) {
+    // VehiclePropertyGroup:VENDOR,VehicleArea:GLOBAL,VehiclePropertyType:INT32
+    return static_cast<int32_t>(i) + 20000 + 0x20000000 + 0x01000000 + 0x00400000;
+}
+
+int32_t continuousProp(size_t i) {
+    // VehiclePropertyGroup:VENDOR,VehicleArea:GLOBAL,VehiclePropertyType:INT32
+    return static_cast<int32_t>(i) + 30000 + 0x20000000 + 0x01000000 + 0x00400000;
+}
+
+std::vector<VehiclePropConfig> getBenchmarkConfigs() {
+    std::vector<VehiclePropConfig> configs;
+    for (size_t i = 0; i < kMaxPropCount; i++) {
+        configs.push_back({
+                .prop = onChangeProp(i),
+                .access = VehiclePropertyAccess::READ_WRITE,
+                .changeMode = VehiclePropertyChangeMode::ON_CHANGE,
+                .areaConfigs = {{.areaId = 0, .access = VehiclePropertyAccess::READ_WRITE}},
+        });
+        configs.push_back({
+                .prop = continuousProp(i),
+                .access = VehiclePropertyAccess::READ_WRITE,
+                .changeMode = VehiclePropertyChangeMode::CONTINUOUS,
+                .minSampleRate = 1.0,
+                .maxSampleRate = 100.0,
+                .areaConfigs = {{.areaId = 0, .access = VehiclePropertyAccess::READ_WRITE}},
+        });
+    }
+    return configs;
+}
+
+// A synthetic hardware that answers all requests inline and lets the benchmark inject property
+// change events.
+class BenchmarkVehicleHardware final : public IVehicleHardware {
+  public:
+    explicit BenchmarkVehicleHardware(std::chrono::nanoseconds eventBatchingWindow)
+        : mConfigs(getBenchmarkConfigs()), mEventBatchingWindow(eventBatchingWindow) {}
+
+    std::vector<VehiclePropConfig> getAllPropertyConfigs() const override { return mConfigs; }
+
+    StatusCode setValues(std::shared_ptr<const SetValuesCallback> callback,
+                         const std::vector<SetValueRequest>& requests) override {
+        std::vector<SetValueResult> results;
+        results.reserve(requests.size());
+        for (const auto& request : requests) {
+            results.push_back({
+                    .requestId = request.requestId,
+                    .status = StatusCode::OK,
+            });
+        }
+        (*callback)(std::move(results));
+        return StatusCode::OK;
+    }
+
+    StatusCode getValues(std::shared_ptr<const GetValuesCallback> callback,
+                         const std::vector<GetValueRequest>& requests) const override {
+        std::vector<GetValueResult> results;
+        results.reserve(requests.size());
+        for (const auto& request : requests) {
+            results.push_back({
+                    .requestId = request.requestId,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .timestamp = elapsedRealtimeNano(),
+                                    .areaId = request.prop.areaId,
+                                    .prop = request.prop.prop,
+                                    .value.int32Values = {0},
+                            },
+            });
+        }
+        (*callback)(std::move(results));
+        return StatusCode::OK;
+    }
+
+    DumpResult dump(const std::vector<std::string>&) override { return {}; }
+
+    StatusCode checkHealth() override { return StatusCode::OK; }
+
+    void registerOnPropertyChangeEvent(
+            std::unique_ptr<const PropertyChangeCallback> callback) override {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        mPropertyChangeCallback = std::move(callback);
+    }
+
+    void registerOnPropertySetErrorEvent(std::unique_ptr<const PropertySetErrorCallback>) override {
+    }
+
+    std::chrono::nanoseconds getPropertyOnChangeEventBatchingWindow() override {
+        return mEventBatchingWindow;
+    }
+
+    // Delivers the values to DefaultVehicleHal as if they were generated by the vehicle bus.
+    void sendEvents(std::vector<VehiclePropValue> values) {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        if (mPropertyChangeCallback) {
+            (*mPropertyChangeCallback)(std::move(values));
+        }
+    }
+
+  private:
+    const std::vector<VehiclePropConfig> mConfigs;
+    const std::chrono::nanoseconds mEventBatchingWindow;
+    std::mutex mLock;
+    std::unique_ptr<const PropertyChangeCallback> mPropertyChangeCallback GUARDED_BY(mLock);
+};
+
+// A client callback that counts the results and records the event delivery latency.
+class BenchmarkVehicleCallback final : public BnVehicleCallback {
+  public:
+    ScopedAStatus onGetValues(const GetValueResults& results) override {
+        auto parsedResults = fromStableLargeParcelable(results);
+        if (parsedResults.ok()) {
+            mGetValueResultCount.fetch_add(parsedResults.value().getObject()->payloads.size());
+        }
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus onSetValues(const SetValueResults& results) override {
+        auto parsedResults = fromStableLargeParcelable(results);
+        if (parsedResults.ok()) {
+            mSetValueResultCount.fetch_add(parsedResults.value().getObject()->payloads.size());
+        }
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus onPropertyEvent(const VehiclePropValues& values, int32_t) override {
+        int64_t now = elapsedRealtimeNano();
+        auto parsedValues = fromStableLargeParcelable(values);
+        if (!parsedValues.ok()) {
+            return ScopedAStatus::ok();
+        }
+        const auto& payloads = parsedValues.value().getObject()->payloads;
+        {
+            std::scoped_lock<std::mutex> lockGuard(mLock);
+            for (const auto& value : payloads) {
+                mEventLatenciesInNano.push_back(now - value.timestamp);
+            }
+            mEventCount += payloads.size();
+        }
+        mCond.notify_all();
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus onPropertySetError(const VehiclePropErrors&) override {
+        return ScopedAStatus::ok();
+    }
+
+    bool waitForEvents(size_t count) {
+        std::unique_lock<std::mutex> lk(mLock);
+        return mCond.wait_for(lk, kWaitTimeout, [this, count] {
+            ScopedLockAssertion lockAssertion(mLock);
+            return mEventCount >= count;
+        });
+    }
+
+    std::vector<int64_t> takeEventLatencies() {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        return std::exchange(mEventLatenciesInNano, {});
+    }
+
+    size_t getGetValueResultCount() { return mGetValueResultCount.load(); }
+
+    size_t getSetValueResultCount() { return mSetValueResultCount.load(); }
+
+  private:
+    std::mutex mLock;
+    std::condition_variable mCond;
+    size_t mEventCount GUARDED_BY(mLock) = 0;
+    std::vector<int64_t> mEventLatenciesInNano GUARDED_BY(mLock);
+    std::atomic<size_t> mGetValueResultCount = 0;
+    std::atomic<size_t> mSetValueResultCount = 0;
+};
+
+struct BenchmarkVhal {
+    BenchmarkVehicleHardware* hardware;
+    std::shared_ptr<DefaultVehicleHal> vhal;
+};
+
+BenchmarkVhal createBenchmarkVhal(
+        std::chrono::nanoseconds eventBatchingWindow = std::chrono::nanoseconds(0)) {
+    auto hardware = std::make_unique<BenchmarkVehicleHardware>(eventBatchingWindow);
+    BenchmarkVehicleHardware* hardwarePtr = hardware.get();
+    return {
+            .hardware = hardwarePtr,
+            .vhal = DefaultVehicleHalBenchmark::createVhal(std::move(hardware)),
+    };
+}
+
+std::vector<std::shared_ptr<BenchmarkVehicleCallback>> createCallbacks(size_t count) {
+    std::vector<std::shared_ptr<BenchmarkVehicleCallback>> callbacks;
+    for (size_t i = 0; i < count; i++) {
+        callbacks.push_back(SharedRefBase::make<BenchmarkVehicleCallback>());
+    }
+    return callbacks;
+}
+
+bool waitForEvents(const std::vector<std::shared_ptr<BenchmarkVehicleCallback>>& callbacks,
+                   size_t count) {
+    for (const auto& callback : callbacks) {
+        if (!callback->waitForEvents(count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<int64_t> takeEventLatencies(
+        const std::vector<std::shared_ptr<BenchmarkVehicleCallback>>& callbacks) {
+    std::vector<int64_t> latencies;
+    for (const auto& callback : callbacks) {
+        auto callbackLatencies = callback->takeEventLatencies();
+        latencies.insert(latencies.end(), callbackLatencies.begin(), callbackLatencies.end());
+    }
+    return latencies;
+}
+
+// Reports the percentiles of the latencies in microseconds as benchmark counters.
+void reportLatencyPercentiles(benchmark::State& state, std::vector<int64_t> latenciesInNano) {
+    if (latenciesInNano.empty()) {
+        return;
+    }
+    std::sort(latenciesInNano.begin(), latenciesInNano.end());
+    auto percentile = [&latenciesInNano](double p) {
+        size_t index = static_cast<size_t>(p * (latenciesInNano.size() - 1));
+        return static_cast<double>(latenciesInNano[index]) / 1000.0;
+    };
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p90_us"] = percentile(0.9);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["max_us"] = percentile(1.0);
+}
+
+// Measures the latency from the hardware generating an on-change event to all the subscribed
+// clients receiving it.
+// Args: subscriber count, property count per event batch, batching window in ms.
+void BM_PropertyEventFanOut(benchmark::State& state) {
+    size_t subscriberCount = static_cast<size_t>(state.range(0));
+    size_t propCount = static_cast<size_t>(state.range(1));
+    auto benchmarkVhal = createBenchmarkVhal(std::chrono::milliseconds(state.range(2)));
+    auto callbacks = createCallbacks(subscriberCount);
+
+    std::vector<SubscribeOptions> options;
+    for (size_t i = 0; i < propCount; i++) {
+        options.push_back({.propId = onChangeProp(i)});
+    }
+    for (const auto& callback : callbacks) {
+        if (!benchmarkVhal.vhal->subscribe(callback, options, /*maxSharedMemoryFileCount=*/0)
+                     .isOk()) {
+            state.SkipWithError("failed to subscribe");
+            return;
+        }
+    }
+
+    int32_t nextValue = 0;
+    size_t expectedEventCount = 0;
+    for (auto _ : state) {
+        std::vector<VehiclePropValue> values;
+        int64_t timestamp = elapsedRealtimeNano();
+        for (size_t i = 0; i < propCount; i++) {
+            values.push_back({
+                    .timestamp = timestamp,
+                    .prop = onChangeProp(i),
+                    .value.int32Values = {nextValue},
+            });
+        }
+        nextValue++;
+        expectedEventCount += propCount;
+        benchmarkVhal.hardware->sendEvents(std::move(values));
+        if (!waitForEvents(callbacks, expectedEventCount)) {
+            state.SkipWithError("timeout waiting for property events");
+            break;
+        }
+    }
+
+    reportLatencyPercentiles(state, takeEventLatencies(callbacks));
+    state.SetItemsProcessed(state.iterations() * propCount * subscriberCount);
+}
+BENCHMARK(BM_PropertyEventFanOut)
+        ->ArgNames({"subscribers", "props", "batch_ms"})
+        ->ArgsProduct({{1, 4, 16, 64}, {1, 16, 128}, {0}})
+        ->Args({16, 16, 10})
+        ->UseRealTime()
+        ->Unit(benchmark::kMicrosecond);
+
+// Measures the throughput of getValues for different batch sizes. With multiple threads, each
+// thread is a different client, so the pending request pool and the client maps are contended.
+void BM_GetValues(benchmark::State& state) {
+    static BenchmarkVhal benchmarkVhal = createBenchmarkVhal();
+    size_t batchSize = static_cast<size_t>(state.range(0));
+    auto callback = SharedRefBase::make<BenchmarkVehicleCallback>();
+
+    std::vector<GetValueRequest> requestVector;
+    for (size_t i = 0; i < batchSize; i++) {
+        requestVector.push_back({
+                .requestId = static_cast<int64_t>(i),
+                .prop = {.prop = onChangeProp(i % kMaxPropCount)},
+        });
+    }
+    GetValueRequests requests;
+    if (!vectorToStableLargeParcelable(std::move(requestVector), &requests).isOk()) {
+        state.SkipWithError("failed to create requests");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (!benchmarkVhal.vhal->getValues(callback, requests).isOk()) {
+            state.SkipWithError("getValues failed");
+            break;
+        }
+    }
+    if (!state.error_occurred() &&
+        callback->getGetValueResultCount() != state.iterations() * batchSize) {
+        state.SkipWithError("missing getValues results");
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_GetValues)
+        ->ArgName("batch")
+        ->RangeMultiplier(4)
+        ->Range(1, 256)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+// Measures the throughput of setValues for different batch sizes.
+void BM_SetValues(benchmark::State& state) {
+    static BenchmarkVhal benchmarkVhal = createBenchmarkVhal();
+    size_t batchSize = static_cast<size_t>(state.range(0));
+    auto callback = SharedRefBase::make<BenchmarkVehicleCallback>();
+
+    std::vector<SetValueRequest> requestVector;
+    for (size_t i = 0; i < batchSize; i++) {
+        requestVector.push_back({
+                .requestId = static_cast<int64_t>(i),
+                .value =
+                        {
+                                .prop = onChangeProp(i % kMaxPropCount),
+                                .value.int32Values = {1},
+                        },
+        });
+    }
+    SetValueRequests requests;
+    if (!vectorToStableLargeParcelable(std::move(requestVector), &requests).isOk()) {
+        state.SkipWithError("failed to create requests");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (!benchmarkVhal.vhal->setValues(callback, requests).isOk()) {
+            state.SkipWithError("setValues failed");
+            break;
+        }
+    }
+    if (!state.error_occurred() &&
+        callback->getSetValueResultCount() != state.iterations() * batchSize) {
+        state.SkipWithError("missing setValues results");
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_SetValues)
+        ->ArgName("batch")
+        ->RangeMultiplier(4)
+        ->Range(1, 256)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+// Measures one client subscribing and unsubscribing a continuous property while other clients
+// keep their subscriptions to the same property at different sample rates.
+// Args: existing subscriber count, sample rate of the churning client in Hz.
+void BM_SubscribeUnsubscribeChurn(benchmark::State& state) {
+    size_t subscriberCount = static_cast<size_t>(state.range(0));
+    float sampleRate = static_cast<float>(state.range(1));
+    auto benchmarkVhal = createBenchmarkVhal();
+    auto callbacks = createCallbacks(subscriberCount);
+    int32_t propId = continuousProp(0);
+
+    for (size_t i = 0; i < subscriberCount; i++) {
+        std::vector<SubscribeOptions> options = {{
+                .propId = propId,
+                .sampleRate = static_cast<float>(1 + i % 100),
+        }};
+        if (!benchmarkVhal.vhal->subscribe(callbacks[i], options, /*maxSharedMemoryFileCount=*/0)
+                     .isOk()) {
+            state.SkipWithError("failed to subscribe");
+            return;
+        }
+    }
+
+    auto churningCallback = SharedRefBase::make<BenchmarkVehicleCallback>();
+    std::vector<SubscribeOptions> options = {{
+            .propId = propId,
+            .sampleRate = sampleRate,
+    }};
+    for (auto _ : state) {
+        if (!benchmarkVhal.vhal->subscribe(churningCallback, options, /*maxSharedMemoryFileCount=*/0)
+                     .isOk()) {
+            state.SkipWithError("failed to subscribe");
+            break;
+        }
+        if (!benchmarkVhal.vhal->unsubscribe(churningCallback, {propId}).isOk()) {
+            state.SkipWithError("failed to unsubscribe");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_SubscribeUnsubscribeChurn)
+        ->ArgNames({"subscribers", "rate_hz"})
+        ->ArgsProduct({{0, 16, 128}, {1, 10, 100}})
+        ->Unit(benchmark::kMicrosecond);
+
+// Measures continuous property events delivered while another thread keeps changing the
+// subscriptions, so the event path and the subscribe path contend on SubscriptionManager.
+// Args: subscriber count.
+void BM_ContinuousEventsWithSubscriptionChurn(benchmark::State& state) {
+    size_t subscriberCount = static_cast<size_t>(state.range(0));
+    auto benchmarkVhal = createBenchmarkVhal();
+    auto callbacks = createCallbacks(subscriberCount);
+    int32_t propId = continuousProp(1);
+
+    std::vector<SubscribeOptions> options = {{
+            .propId = propId,
+            .sampleRate = 100.0,
+    }};
+    for (const auto& callback : callbacks) {
+        if (!benchmarkVhal.vhal->subscribe(callback, options, /*maxSharedMemoryFileCount=*/0)
+                     .isOk()) {
+            state.SkipWithError("failed to subscribe");
+            return;
+        }
+    }
+
+    std::atomic<bool> stopChurn = false;
+    std::thread churnThread([&benchmarkVhal, &stopChurn, propId] {
+        auto churningCallback = SharedRefBase::make<BenchmarkVehicleCallback>();
+        std::vector<SubscribeOptions> churnOptions = {{
+                .propId = propId,
+                .sampleRate = 10.0,
+        }};
+        while (!stopChurn.load()) {
+            (void)benchmarkVhal.vhal->subscribe(churningCallback, churnOptions,
+                                                /*maxSharedMemoryFileCount=*/0);
+            (void)benchmarkVhal.vhal->unsubscribe(churningCallback, {propId});
+        }
+    });
+
+    int32_t nextValue = 0;
+    size_t expectedEventCount = 0;
+    for (auto _ : state) {
+        benchmarkVhal.hardware->sendEvents({{
+                .timestamp = elapsedRealtimeNano(),
+                .prop = propId,
+                .value.int32Values = {nextValue++},
+        }});
+        expectedEventCount++;
+        if (!waitForEvents(callbacks, expectedEventCount)) {
+            state.SkipWithError("timeout waiting for property events");
+            break;
+        }
+    }
+    stopChurn.store(true);
+    churnThread.join();
+
+    reportLatencyPercentiles(state, takeEventLatencies(callbacks));
+}
+BENCHMARK(BM_ContinuousEventsWithSubscriptionChurn)
+        ->ArgName("subscribers")
+        ->Arg(1)
+        ->Arg(16)
+        ->Arg(64)
+        ->UseRealTime()
+        ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -18,6 +18,8 @@
 #define android_hardware_automotive_vehicle_aidl_impl_vhal_include_ConnectedClient_H_
 
 #include "PendingRequestPool.h"
+#include "PropertyLatencyStats.h"
+#include "SharedMemoryPool.h"
 
 #include <IVehicleHardware.h>
 #include <VehicleHalTypes.h>
@@ -77,7 +79,10 @@ class ConnectedClient {
 template <class ResultType, class ResultsType>
 class GetSetValuesClient final : public ConnectedClient {
   public:
-    GetSetValuesClient(std::shared_ptr<PendingRequestPool> requestPool, CallbackType callback);
+    // If {@code latencyStats} is not nullptr, the latency of the tracked requests is recorded to
+    // it.
+    GetSetValuesClient(std::shared_ptr<PendingRequestPool> requestPool, CallbackType callback,
+                       std::shared_ptr<PropertyLatencyStats> latencyStats = nullptr);
 
     // Sends the results to this client.
     void sendResults(std::vector<ResultType>&& results);
@@ -89,6 +94,14 @@ class GetSetValuesClient final : public ConnectedClient {
     // Gets the callback to be called when the request for this client has finished.
     std::shared_ptr<const std::function<void(std::vector<ResultType>)>> getResultCallback();
 
+    // Starts tracking the latency of the requests received at {@code startTimeInNanos} until their
+    // results are sent or they time out. Does nothing if the client has no latency stats.
+    void trackRequestLatency(int64_t startTimeInNanos,
+                             const std::vector<RequestLatencyTracker::Request>& requests);
+
+    // Stops tracking the latency of the requests, e.g. when they are never sent to the hardware.
+    void untrackRequestLatency(const std::unordered_set<int64_t>& requestIds);
+
   protected:
     // Gets the callback to be called when the request for this client has timeout.
     std::shared_ptr<const PendingRequestPool::TimeoutCallbackFunc> getTimeoutCallback() override;
@@ -97,6 +110,8 @@ class GetSetValuesClient final : public ConnectedClient {
     // The following members are only initialized during construction.
     std::shared_ptr<const PendingRequestPool::TimeoutCallbackFunc> mTimeoutCallback;
     std::shared_ptr<const std::function<void(std::vector<ResultType>)>> mResultCallback;
+    // nullptr if the latency is not recorded.
+    std::shared_ptr<RequestLatencyTracker> mLatencyTracker;
 };
 
 class SubscriptionClient {
@@ -106,10 +121,15 @@ class SubscriptionClient {
 
     // Marshals the updated values into largeParcelable and sends it through {@code onPropertyEvent}
     // callback.
+    // If the values are marshaled into a shared memory file, a shared memory ID is obtained from
+    // {@code sharedMemoryPool}. If the client already holds all the shared memory files it is
+    // allowed to, or {@code sharedMemoryPool} is null, the values would be sent separately, one
+    // value in each callback invocation.
     static void sendUpdatedValues(
             CallbackType callback,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
-                    updatedValues);
+                    updatedValues,
+            SharedMemoryPool* sharedMemoryPool);
     // Marshals the set property error events into largeParcelable and sends it through
     // {@code onPropertySetError} callback.
     static void sendPropertySetErrors(
@@ -20,6 +20,7 @@
 #include <ConnectedClient.h>
 #include <ParcelableUtils.h>
 #include <PendingRequestPool.h>
+#include <PropertyLatencyStats.h>
 #include <RecurrentTimer.h>
 #include <SubscriptionManager.h>
 
@@ -31,10 +32,13 @@
 #include <android-base/thread_annotations.h>
 #include <android/binder_auto_utils.h>
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -85,6 +89,8 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
   private:
     // friend class for unit testing.
     friend class DefaultVehicleHalTest;
+    // friend class for benchmarking.
+    friend class DefaultVehicleHalBenchmark;
 
     using GetValuesClient =
             GetSetValuesClient<aidl::android::hardware::automotive::vehicle::GetValueResult,
@@ -128,21 +134,73 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
         const AIBinder* clientId;
     };
 
+    // A simple histogram used to dump the property change event batching statistics.
+    // This class is not thread-safe.
+    class Histogram final {
+      public:
+        // Each bucket counts the values not larger than its upper bound and larger than the
+        // previous upper bound. An extra bucket counts the values larger than the last upper bound.
+        explicit Histogram(std::vector<int64_t> upperBounds);
+
+        void record(int64_t value);
+
+        std::string toString() const;
+
+      private:
+        std::vector<int64_t> mUpperBounds;
+        std::vector<uint64_t> mCounts;
+        uint64_t mTotalCount = 0;
+    };
+
+    // The serialized getPropConfigs result for one list of property IDs.
+    struct SerializedPropConfigs {
+        // The configs if they fit in the binder buffer.
+        std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropConfig> payloads;
+        // The shared memory file containing the configs, nullptr if the payloads are used.
+        std::unique_ptr<ndk::ScopedFileDescriptor> sharedMemoryFile;
+    };
+
+    // An immutable snapshot of the property configs from the hardware. Refreshing the configs
+    // replaces the whole snapshot, so readers holding the previous snapshot always see consistent
+    // configs and never need to copy them.
+    struct ConfigSnapshot {
+        std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropConfig> configs;
+        // The index into configs for each property ID.
+        std::unordered_map<int32_t, size_t> configIndexByPropId;
+        // The shared memory file containing all the configs, nullptr if the configs fit in the
+        // binder buffer.
+        std::unique_ptr<ndk::ScopedFileDescriptor> configFile;
+
+        mutable std::mutex serializedPropConfigsLock;
+        // The serialized getPropConfigs results for the recently requested property ID lists. The
+        // same lists are requested repeatedly by the clients.
+        mutable std::map<std::vector<int32_t>, std::shared_ptr<const SerializedPropConfigs>>
+                serializedPropConfigsByPropIds GUARDED_BY(serializedPropConfigsLock);
+
+        // Returns nullptr if there is no config for the property.
+        const aidl::android::hardware::automotive::vehicle::VehiclePropConfig* getConfig(
+                int32_t propId) const;
+    };
+
+    // The maximum number of serialized getPropConfigs results cached in one snapshot.
+    static constexpr size_t MAX_SERIALIZED_PROP_CONFIGS_COUNT = 32;
     // The default timeout of get or set value requests is 30s.
     // TODO(b/214605968): define TIMEOUT_IN_NANO in IVehicle and allow getValues/setValues/subscribe
     // to specify custom timeouts.
     static constexpr int64_t TIMEOUT_IN_NANO = 30'000'000'000;
+    // The dump option to dump the per-property latency stats, handled by DefaultVehicleHal instead
+    // of the hardware.
+    static constexpr char DUMP_STATS_OPTION[] = "--stats";
     // heart beat event interval: 3s
     static constexpr int64_t HEART_BEAT_INTERVAL_IN_NANO = 3'000'000'000;
     bool mShouldRefreshPropertyConfigs;
     std::unique_ptr<IVehicleHardware> mVehicleHardware;
 
-    // mConfigsByPropId and mConfigFile are only modified during initialization, so no need to
-    // lock guard them.
-    std::unordered_map<int32_t, aidl::android::hardware::automotive::vehicle::VehiclePropConfig>
-            mConfigsByPropId;
-    // Only modified in constructor, so thread-safe.
-    std::unique_ptr<ndk::ScopedFileDescriptor> mConfigFile;
+    mutable std::mutex mConfigSnapshotLock;
+    // Never nullptr. The lock only guards swapping the pointer, readers work on their own
+    // reference to the snapshot without holding it.
+    std::shared_ptr<const ConfigSnapshot> mConfigSnapshot GUARDED_BY(mConfigSnapshotLock) =
+            std::make_shared<const ConfigSnapshot>();
     // PendingRequestPool is thread-safe.
     std::shared_ptr<PendingRequestPool> mPendingRequestPool;
     // SubscriptionManager is thread-safe.
@@ -156,8 +214,15 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
             mPropertyChangeEventsBatchingConsumer;
     // Only set once during initialization.
     std::chrono::nanoseconds mEventBatchingWindow;
+    // Only set once during initialization.
+    size_t mEventBatchMaxSize = 0;
+    // Only set once during initialization.
+    std::unordered_set<int32_t> mLatencyCriticalPropIds;
     // Only used for testing.
     int32_t mTestInterfaceVersion = 0;
+    // PropertyLatencyStats is thread-safe.
+    std::shared_ptr<PropertyLatencyStats> mPropertyLatencyStats =
+            std::make_shared<PropertyLatencyStats>();
 
     std::mutex mLock;
     std::unordered_map<const AIBinder*, std::unique_ptr<OnBinderDiedContext>> mOnBinderDiedContexts
@@ -166,6 +231,14 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
             GUARDED_BY(mLock);
     std::unordered_map<const AIBinder*, std::shared_ptr<SetValuesClient>> mSetValuesClients
             GUARDED_BY(mLock);
+    std::mutex mBatchingStatsLock;
+    // The number of events in each batch.
+    Histogram mBatchSizeHistogram GUARDED_BY(mBatchingStatsLock) =
+            Histogram({1, 2, 4, 8, 16, 32, 64, 128, 256, 512});
+    // The time in milliseconds between the oldest event in each batch is generated and the batch
+    // is delivered.
+    Histogram mBatchLatencyHistogram GUARDED_BY(mBatchingStatsLock) =
+            Histogram({1, 2, 5, 10, 20, 50, 100, 200, 500, 1000});
     // mBinderLifecycleHandler is only going to be changed in test.
     std::unique_ptr<BinderLifecycleInterface> mBinderLifecycleHandler;
 
@@ -194,7 +267,8 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
                     requests);
     VhalResult<void> checkSubscribeOptions(
             const std::vector<aidl::android::hardware::automotive::vehicle::SubscribeOptions>&
-                    options);
+                    options,
+            const ConfigSnapshot& configSnapshot);
 
     VhalResult<void> checkPermissionHelper(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value,
@@ -206,7 +280,11 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
     VhalResult<void> checkWritePermission(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value) const;
 
-    android::base::Result<const aidl::android::hardware::automotive::vehicle::VehiclePropConfig*>
+    std::shared_ptr<const ConfigSnapshot> getConfigSnapshot() const;
+
+    // The returned config keeps the snapshot it belongs to alive.
+    android::base::Result<
+            std::shared_ptr<const aidl::android::hardware::automotive::vehicle::VehiclePropConfig>>
     getConfig(int32_t propId) const;
 
     void onBinderDiedWithContext(const AIBinder* clientId);
@@ -234,11 +312,15 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
 
     int32_t getVhalInterfaceVersion();
 
-    // Puts the property change events into a queue so that they can handled in batch.
+    // Puts the property change events into a queue so that they can handled in batch. The events
+    // for latency critical properties are delivered immediately instead.
     static void batchPropertyChangeEvent(
             const std::weak_ptr<ConcurrentQueue<
                     aidl::android::hardware::automotive::vehicle::VehiclePropValue>>&
                     batchedEventQueue,
+            const std::weak_ptr<SubscriptionManager>& subscriptionManager,
+            PropertyLatencyStats* latencyStats,
+            const std::unordered_set<int32_t>& latencyCriticalPropIds,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
                     updatedValues);
 
@@ -246,10 +328,13 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
     template <class T>
     static std::shared_ptr<T> getOrCreateClient(
             std::unordered_map<const AIBinder*, std::shared_ptr<T>>* clients,
-            const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool);
+            const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool,
+            std::shared_ptr<PropertyLatencyStats> latencyStats);
 
+    // Records the delivery latency of the events to {@code latencyStats} if it is not nullptr.
     static void onPropertyChangeEvent(
             const std::weak_ptr<SubscriptionManager>& subscriptionManager,
+            PropertyLatencyStats* latencyStats,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
                     updatedValues);
 
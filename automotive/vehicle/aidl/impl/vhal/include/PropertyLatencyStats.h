@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_vhal_include_PropertyLatencyStats_H_
+#define android_hardware_automotive_vehicle_aidl_impl_vhal_include_PropertyLatencyStats_H_
+
+#include <android-base/thread_annotations.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// Per-property latency histograms for the hot paths in DefaultVehicleHal.
+//
+// Recording a latency only updates atomic counters, so it is lock-free and could be called from
+// any thread. Only the properties set through {@code setPropIds} are recorded, the others are
+// ignored.
+//
+// If atrace is enabled for the HAL tag, each recorded latency is also emitted as a counter track
+// per property and latency type.
+//
+// This class is thread-safe.
+class PropertyLatencyStats final {
+  public:
+    enum class LatencyType : size_t {
+        // From the property change event is generated, according to its timestamp, to the
+        // onPropertyEvent callback for a client returns.
+        PROPERTY_EVENT = 0,
+        // From the getValues request is received to the onGetValues callback returns.
+        GET_VALUES = 1,
+        // From the setValues request is received to the onSetValues callback returns.
+        SET_VALUES = 2,
+    };
+
+    PropertyLatencyStats();
+
+    ~PropertyLatencyStats();
+
+    PropertyLatencyStats(const PropertyLatencyStats&) = delete;
+    PropertyLatencyStats& operator=(const PropertyLatencyStats&) = delete;
+
+    // Sets the properties to record the stats for. The stats already recorded for the properties
+    // still in {@code propIds} are kept.
+    //
+    // This is expected to be called rarely, e.g. when the property configs are refreshed, since
+    // the previous property tables are only freed when this object is destroyed.
+    void setPropIds(const std::vector<int32_t>& propIds);
+
+    void recordLatency(LatencyType type, int32_t propId, int64_t latencyInNanos);
+
+    void recordTimeout(LatencyType type, int32_t propId);
+
+    // Returns the number of recorded latencies, 0 if the property is not recorded.
+    uint64_t getCount(LatencyType type, int32_t propId) const;
+
+    // Returns the number of recorded timeouts, 0 if the property is not recorded.
+    uint64_t getTimeoutCount(LatencyType type, int32_t propId) const;
+
+    // Returns a human-readable dump of the stats for the properties that have any latency or
+    // timeout recorded.
+    std::string dump() const;
+
+  private:
+    static constexpr size_t LATENCY_TYPE_COUNT = 3;
+    static constexpr size_t BUCKET_COUNT = 12;
+    // Each bucket counts the latencies not larger than its upper bound and larger than the previous
+    // upper bound. An extra bucket counts the latencies larger than the last upper bound.
+    static constexpr std::array<int64_t, BUCKET_COUNT> BUCKET_UPPER_BOUNDS_IN_MICROS = {
+            50, 100, 200, 500, 1'000, 2'000, 5'000, 10'000, 20'000, 50'000, 100'000, 1'000'000};
+
+    struct LatencyHistogram {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT + 1> counts = {};
+        std::atomic<uint64_t> totalCount = 0;
+        std::atomic<uint64_t> totalLatencyInMicros = 0;
+        std::atomic<int64_t> maxLatencyInMicros = 0;
+        std::atomic<uint64_t> timeoutCount = 0;
+    };
+
+    struct PropertyStats {
+        std::array<LatencyHistogram, LATENCY_TYPE_COUNT> histograms;
+    };
+
+    // Immutable once published, only the counters in the entries are updated. Entries are shared
+    // between tables so that the stats survive {@code setPropIds}.
+    using StatsTable = std::unordered_map<int32_t, std::shared_ptr<PropertyStats>>;
+
+    // Never nullptr. Readers load the table without any lock.
+    std::atomic<const StatsTable*> mStatsTable;
+
+    std::mutex mLock;
+    // All the published tables, including the current one. They are never freed before this
+    // object is destroyed because readers might still be using them.
+    std::vector<std::unique_ptr<const StatsTable>> mStatsTables GUARDED_BY(mLock);
+
+    // Returns nullptr if the property is not recorded.
+    LatencyHistogram* getHistogram(LatencyType type, int32_t propId) const;
+};
+
+// Tracks the pending getValues or setValues requests for one client, so that the latency or the
+// timeout of each request could be recorded to {@code PropertyLatencyStats} once it finishes.
+//
+// This class is thread-safe.
+class RequestLatencyTracker final {
+  public:
+    struct Request {
+        int64_t requestId;
+        int32_t propId;
+    };
+
+    RequestLatencyTracker(std::shared_ptr<PropertyLatencyStats> stats,
+                          PropertyLatencyStats::LatencyType type);
+
+    // Starts tracking the requests which are received at {@code startTimeInNanos}.
+    void onRequestsStarted(int64_t startTimeInNanos, const std::vector<Request>& requests);
+
+    // Records the latency for the tracked requests whose results have been sent.
+    void onRequestsFinished(const std::unordered_set<int64_t>& requestIds);
+
+    // Records a timeout for the tracked requests.
+    void onRequestsTimeout(const std::unordered_set<int64_t>& requestIds);
+
+    // Stops tracking the requests without recording anything, e.g. when the requests are never
+    // sent to the hardware.
+    void onRequestsCancelled(const std::unordered_set<int64_t>& requestIds);
+
+  private:
+    struct PendingRequest {
+        int32_t propId;
+        int64_t startTimeInNanos;
+    };
+
+    const std::shared_ptr<PropertyLatencyStats> mStats;
+    const PropertyLatencyStats::LatencyType mType;
+
+    std::mutex mLock;
+    std::unordered_map<int64_t, PendingRequest> mPendingRequests GUARDED_BY(mLock);
+};
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_vhal_include_PropertyLatencyStats_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
+#define android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
+
+#include <VehicleUtils.h>
+
+#include <android-base/thread_annotations.h>
+
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+// A pool of shared memory file slots for one subscription client.
+//
+// Property events that do not fit the binder limitation are delivered to the client through a
+// shared memory file. The client may only hold {@code maxSharedMemoryFileCount} (specified in
+// {@code IVehicle.subscribe}) files at the same time. Each slot handed out is identified by a
+// unique shared memory ID that the client must give back through {@code returnSharedMemory}, after
+// which the slot is recycled for the following events.
+// This class is thread-safe.
+class SharedMemoryPool final {
+  public:
+    explicit SharedMemoryPool(int32_t maxFileCount);
+
+    // Updates the maximum number of shared memory files the client could hold. If the client
+    // currently holds more files than the new limit, no new file would be handed out until enough
+    // files are returned.
+    void setMaxFileCount(int32_t maxFileCount);
+
+    // Obtains a shared memory ID for a new shared memory file. A recycled ID is used first.
+    // Returns {@code IVehicle::INVALID_MEMORY_ID} if all the allowed files are in use by the
+    // client.
+    int64_t obtain();
+
+    // Recycles an obtained ID that has not been delivered to the client, e.g. because the callback
+    // failed.
+    void recycle(int64_t sharedMemoryId);
+
+    // Marks the shared memory file as returned by the client so that it could be reused.
+    // Returns {@code INVALID_ARG} error if the ID is not currently in use by the client.
+    VhalResult<void> returnSharedMemory(int64_t sharedMemoryId);
+
+    // Returns the number of shared memory files allocated for the client, including the ones in
+    // use and the ones returned and ready for reuse.
+    int32_t getFileCount() const;
+
+    // Returns the number of shared memory files currently in use by the client.
+    size_t countInUseFiles() const;
+
+  private:
+    mutable std::mutex mLock;
+    int32_t mMaxFileCount GUARDED_BY(mLock);
+    // The next ID to use when no recycled ID is available. ID 0 is reserved for
+    // INVALID_MEMORY_ID.
+    int64_t mNextId GUARDED_BY(mLock) = 1;
+    std::vector<int64_t> mFreeIds GUARDED_BY(mLock);
+    std::unordered_set<int64_t> mInUseIds GUARDED_BY(mLock);
+};
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_aidl_impl_vhal_include_SharedMemoryPool_H_
@@ -17,6 +17,8 @@
 #ifndef android_hardware_automotive_vehicle_aidl_impl_vhal_include_SubscriptionManager_H_
 #define android_hardware_automotive_vehicle_aidl_impl_vhal_include_SubscriptionManager_H_
 
+#include "SharedMemoryPool.h"
+
 #include <IVehicleHardware.h>
 #include <VehicleHalTypes.h>
 #include <VehicleUtils.h>
@@ -27,6 +29,7 @@
 
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
@@ -122,6 +125,13 @@ class SubscriptionManager final {
     // Returns the number of subscribed clients.
     size_t countClients();
 
+    // Sets the maximum number of shared memory files that could be used at the same time to
+    // deliver property events to the client. This must be called after the client subscribes.
+    void setMaxSharedMemoryFileCount(ClientIdType client, int32_t maxSharedMemoryFileCount);
+
+    // Returns the shared memory pool for the client, or nullptr if the client is not subscribed.
+    std::shared_ptr<SharedMemoryPool> getSharedMemoryPool(ClientIdType client);
+
     // Checks whether the sample rate is valid.
     static bool checkSampleRateHz(float sampleRateHz);
 
@@ -134,19 +144,40 @@ class SubscriptionManager final {
 
     IVehicleHardware* mVehicleHardware;
 
-    struct VehiclePropValueHashPropIdAreaId {
-        inline size_t operator()(const VehiclePropValue& vehiclePropValue) const {
-            size_t res = 0;
-            hashCombine(res, vehiclePropValue.prop);
-            hashCombine(res, vehiclePropValue.areaId);
-            return res;
-        }
+    // The last value sent to a subscriber. The arrays are compared with and overwritten by a new
+    // value in one pass and their capacity is reused across property events.
+    struct LastValue {
+        bool hasValue = false;
+        int64_t timestamp = 0;
+        aidl::android::hardware::automotive::vehicle::VehiclePropertyStatus status;
+        aidl::android::hardware::automotive::vehicle::RawPropValues value;
+    };
+
+    // A client subscribed to one [propId, areaId]. This contains everything required to deliver a
+    // property event to the client so that no other subscription map needs to be looked up.
+    struct Subscriber {
+        ClientIdType clientId;
+        CallbackType callback;
+        // The resolution requested by the client, 0 if not specified or for on-change properties.
+        float resolution;
+        // Whether variable update rate filtering must be done here, because the client enables VUR
+        // but VUR is not enabled in IVehicleHardware since another client does not enable it.
+        bool filterByVur;
+        // The index of the resolution in Subscribers.resolutions.
+        size_t resolutionIndex;
+        // Whether this is the last subscriber using the resolution at resolutionIndex, so that the
+        // value sanitized by the resolution could be moved to this subscriber.
+        bool lastForResolution;
+        // The last value sent to the client, only used if filterByVur is true.
+        LastValue lastValue;
     };
 
-    struct VehiclePropValueEqualPropIdAreaId {
-        inline bool operator()(const VehiclePropValue& left, const VehiclePropValue& right) const {
-            return left.prop == right.prop && left.areaId == right.areaId;
-        }
+    // All the subscribers for one [propId, areaId].
+    struct Subscribers {
+        // The distinct resolutions required by the subscribers. A property event is only rounded
+        // once for each resolution instead of once for each subscriber.
+        std::vector<float> resolutions;
+        std::vector<Subscriber> subscribers;
     };
 
     mutable std::mutex mLock;
@@ -157,10 +188,14 @@ class SubscriptionManager final {
             mSubscribedPropsByClient GUARDED_BY(mLock);
     std::unordered_map<PropIdAreaId, ContSubConfigs, PropIdAreaIdHash> mContSubConfigsByPropIdArea
             GUARDED_BY(mLock);
-    std::unordered_map<CallbackType,
-                       std::unordered_set<VehiclePropValue, VehiclePropValueHashPropIdAreaId,
-                                          VehiclePropValueEqualPropIdAreaId>>
-            mContSubValuesByCallback GUARDED_BY(mLock);
+    // An index from [propId, areaId] to all the subscribers. It is derived from
+    // mClientsByPropIdAreaId and mContSubConfigsByPropIdArea and refreshed whenever the
+    // subscriptions for a [propId, areaId] change, so that delivering property events only
+    // requires one lookup per event.
+    std::unordered_map<PropIdAreaId, Subscribers, PropIdAreaIdHash> mSubscribersByPropIdAreaId
+            GUARDED_BY(mLock);
+    std::unordered_map<ClientIdType, std::shared_ptr<SharedMemoryPool>> mSharedMemoryPoolByClient
+            GUARDED_BY(mLock);
 
     VhalResult<void> addContinuousSubscriberLocked(const ClientIdType& clientId,
                                                    const PropIdAreaId& propIdAreaId,
@@ -185,8 +220,15 @@ class SubscriptionManager final {
     // Checks whether the manager is empty. For testing purpose.
     bool isEmpty();
 
-    bool isValueUpdatedLocked(const CallbackType& callback, const VehiclePropValue& value)
-            REQUIRES(mLock);
+    // Rebuilds the subscribers for the [propId, areaId] in mSubscribersByPropIdAreaId.
+    void refreshSubscribersLocked(const PropIdAreaId& propIdAreaId) REQUIRES(mLock);
+
+    // Checks whether the value, with {@code sanitizedValue} as its values rounded by the
+    // subscriber's resolution, is different from the last value sent to the subscriber and stores
+    // it as the last value.
+    static bool isValueUpdated(
+            Subscriber* subscriber, const VehiclePropValue& value,
+            const aidl::android::hardware::automotive::vehicle::RawPropValues& sanitizedValue);
 
     // Get the interval in nanoseconds accroding to sample rate.
     static android::base::Result<int64_t> getIntervalNanos(float sampleRateHz);
@@ -19,9 +19,11 @@
 
 #include <VehicleHalTypes.h>
 
+#include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
 #include <utils/Log.h>
 
 #include <inttypes.h>
+#include <type_traits>
 #include <unordered_set>
 #include <vector>
 
@@ -34,6 +36,7 @@ namespace {
 
 using ::aidl::android::hardware::automotive::vehicle::GetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::GetValueResults;
+using ::aidl::android::hardware::automotive::vehicle::IVehicle;
 using ::aidl::android::hardware::automotive::vehicle::IVehicleCallback;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResults;
@@ -113,7 +116,8 @@ void sendGetOrSetValueResults(std::shared_ptr<IVehicleCallback> callback,
 template <class ResultType, class ResultsType>
 void onTimeout(
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        const std::unordered_set<int64_t>& timeoutIds) {
+        const std::unordered_set<int64_t>& timeoutIds,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker) {
     std::vector<ResultType> timeoutResults;
     for (int64_t requestId : timeoutIds) {
         ALOGD("hardware request timeout, request ID: %" PRId64, requestId);
@@ -123,6 +127,9 @@ void onTimeout(
         });
     }
     sendGetOrSetValueResults<ResultType, ResultsType>(callback, std::move(timeoutResults));
+    if (latencyTracker != nullptr) {
+        latencyTracker->onRequestsTimeout(timeoutIds);
+    }
 }
 
 // The on-results callback for GetValues/SetValues.
@@ -130,7 +137,8 @@ template <class ResultType, class ResultsType>
 void getOrSetValuesCallback(
         const void* clientId,
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        std::vector<ResultType>&& results, std::shared_ptr<PendingRequestPool> requestPool) {
+        std::vector<ResultType>&& results, std::shared_ptr<PendingRequestPool> requestPool,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker) {
     std::unordered_set<int64_t> requestIds;
     for (const auto& result : results) {
         requestIds.insert(result.requestId);
@@ -154,6 +162,9 @@ void getOrSetValuesCallback(
     if (!results.empty()) {
         sendGetOrSetValueResults<ResultType, ResultsType>(callback, std::move(results));
     }
+    if (latencyTracker != nullptr) {
+        latencyTracker->onRequestsFinished(finishedRequests);
+    }
 }
 
 // Specify the functions for GetValues and SetValues types.
@@ -174,19 +185,23 @@ template void sendGetOrSetValueResultsSeparately<SetValueResult, SetValueResults
 
 template void onTimeout<GetValueResult, GetValueResults>(
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        const std::unordered_set<int64_t>& timeoutIds);
+        const std::unordered_set<int64_t>& timeoutIds,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker);
 template void onTimeout<SetValueResult, SetValueResults>(
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        const std::unordered_set<int64_t>& timeoutIds);
+        const std::unordered_set<int64_t>& timeoutIds,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker);
 
 template void getOrSetValuesCallback<GetValueResult, GetValueResults>(
         const void* clientId,
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        std::vector<GetValueResult>&& results, std::shared_ptr<PendingRequestPool> requestPool);
+        std::vector<GetValueResult>&& results, std::shared_ptr<PendingRequestPool> requestPool,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker);
 template void getOrSetValuesCallback<SetValueResult, SetValueResults>(
         const void* clientId,
         std::shared_ptr<::aidl::android::hardware::automotive::vehicle::IVehicleCallback> callback,
-        std::vector<SetValueResult>&& results, std::shared_ptr<PendingRequestPool> requestPool);
+        std::vector<SetValueResult>&& results, std::shared_ptr<PendingRequestPool> requestPool,
+        const std::shared_ptr<RequestLatencyTracker>& latencyTracker);
 
 }  // namespace
 
@@ -209,18 +224,29 @@ std::unordered_set<int64_t> ConnectedClient::tryFinishRequests(
 
 template <class ResultType, class ResultsType>
 GetSetValuesClient<ResultType, ResultsType>::GetSetValuesClient(
-        std::shared_ptr<PendingRequestPool> requestPool, std::shared_ptr<IVehicleCallback> callback)
+        std::shared_ptr<PendingRequestPool> requestPool, std::shared_ptr<IVehicleCallback> callback,
+        std::shared_ptr<PropertyLatencyStats> latencyStats)
     : ConnectedClient(requestPool, callback) {
+    if (latencyStats != nullptr) {
+        mLatencyTracker = std::make_shared<RequestLatencyTracker>(
+                std::move(latencyStats), std::is_same_v<ResultType, GetValueResult>
+                                                 ? PropertyLatencyStats::LatencyType::GET_VALUES
+                                                 : PropertyLatencyStats::LatencyType::SET_VALUES);
+    }
+    auto latencyTrackerCopy = mLatencyTracker;
     mTimeoutCallback = std::make_shared<const PendingRequestPool::TimeoutCallbackFunc>(
-            [callback](const std::unordered_set<int64_t>& timeoutIds) {
-                return onTimeout<ResultType, ResultsType>(callback, timeoutIds);
+            [callback, latencyTrackerCopy](const std::unordered_set<int64_t>& timeoutIds) {
+                return onTimeout<ResultType, ResultsType>(callback, timeoutIds,
+                                                          latencyTrackerCopy);
             });
     auto requestPoolCopy = mRequestPool;
     const void* clientId = id();
     mResultCallback = std::make_shared<const std::function<void(std::vector<ResultType>)>>(
-            [clientId, callback, requestPoolCopy](std::vector<ResultType> results) {
+            [clientId, callback, requestPoolCopy,
+             latencyTrackerCopy](std::vector<ResultType> results) {
                 return getOrSetValuesCallback<ResultType, ResultsType>(
-                        clientId, callback, std::move(results), requestPoolCopy);
+                        clientId, callback, std::move(results), requestPoolCopy,
+                        latencyTrackerCopy);
             });
 }
 
@@ -236,6 +262,22 @@ GetSetValuesClient<ResultType, ResultsType>::getTimeoutCallback() {
     return mTimeoutCallback;
 }
 
+template <class ResultType, class ResultsType>
+void GetSetValuesClient<ResultType, ResultsType>::trackRequestLatency(
+        int64_t startTimeInNanos, const std::vector<RequestLatencyTracker::Request>& requests) {
+    if (mLatencyTracker != nullptr) {
+        mLatencyTracker->onRequestsStarted(startTimeInNanos, requests);
+    }
+}
+
+template <class ResultType, class ResultsType>
+void GetSetValuesClient<ResultType, ResultsType>::untrackRequestLatency(
+        const std::unordered_set<int64_t>& requestIds) {
+    if (mLatencyTracker != nullptr) {
+        mLatencyTracker->onRequestsCancelled(requestIds);
+    }
+}
+
 template <class ResultType, class ResultsType>
 void GetSetValuesClient<ResultType, ResultsType>::sendResults(std::vector<ResultType>&& results) {
     return sendGetOrSetValueResults<ResultType, ResultsType>(mCallback, std::move(results));
@@ -251,14 +293,19 @@ template class GetSetValuesClient<GetValueResult, GetValueResults>;
 template class GetSetValuesClient<SetValueResult, SetValueResults>;
 
 void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> callback,
-                                           std::vector<VehiclePropValue>&& updatedValues) {
+                                           std::vector<VehiclePropValue>&& updatedValues,
+                                           SharedMemoryPool* sharedMemoryPool) {
     if (updatedValues.empty()) {
         return;
     }
 
-    // TODO(b/205189110): Use memory pool here and fill in sharedMemoryId.
+    // Keep a copy so that we could still send the values in payloads if there is no shared memory
+    // file available for this client.
+    std::vector<VehiclePropValue> valuesCopy;
+    if (updatedValues.size() > 1) {
+        valuesCopy = updatedValues;
+    }
     VehiclePropValues vehiclePropValues;
-    int32_t sharedMemoryFileCount = 0;
     ScopedAStatus status =
             vectorToStableLargeParcelable(std::move(updatedValues), &vehiclePropValues);
     if (!status.isOk()) {
@@ -269,6 +316,31 @@ void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> cal
         return;
     }
 
+    int64_t sharedMemoryId = IVehicle::INVALID_MEMORY_ID;
+    int32_t sharedMemoryFileCount = 0;
+    if (vehiclePropValues.sharedMemoryFd.get() != -1) {
+        if (sharedMemoryPool != nullptr) {
+            sharedMemoryId = sharedMemoryPool->obtain();
+        }
+        if (sharedMemoryId == IVehicle::INVALID_MEMORY_ID) {
+            if (valuesCopy.empty()) {
+                ALOGE("subscribe: no shared memory file available for client ID: %p, a single "
+                      "property event is too large to be sent without shared memory, dropped",
+                      callback->asBinder().get());
+                return;
+            }
+            ALOGD("subscribe: no shared memory file available for client ID: %p, send %zu "
+                  "property events separately",
+                  callback->asBinder().get(), valuesCopy.size());
+            for (auto& value : valuesCopy) {
+                sendUpdatedValues(callback, {std::move(value)}, sharedMemoryPool);
+            }
+            return;
+        }
+        vehiclePropValues.sharedMemoryId = sharedMemoryId;
+        sharedMemoryFileCount = sharedMemoryPool->getFileCount();
+    }
+
     if (ScopedAStatus callbackStatus =
                 callback->onPropertyEvent(vehiclePropValues, sharedMemoryFileCount);
         !callbackStatus.isOk()) {
@@ -276,6 +348,10 @@ void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> cal
               "exception: %d, service specific error: %d",
               callback->asBinder().get(), callbackStatus.getMessage(),
               callbackStatus.getExceptionCode(), callbackStatus.getServiceSpecificError());
+        if (sharedMemoryId != IVehicle::INVALID_MEMORY_ID) {
+            // The client would never return the file, recycle it now.
+            sharedMemoryPool->recycle(sharedMemoryId);
+        }
     }
 }
 
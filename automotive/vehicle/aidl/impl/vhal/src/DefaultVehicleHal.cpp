@@ -33,6 +33,7 @@
 #include <utils/Trace.h>
 
 #include <inttypes.h>
+#include <algorithm>
 #include <chrono>
 #include <set>
 #include <unordered_set>
@@ -71,6 +72,7 @@ using ::android::base::StringPrintf;
 
 using ::ndk::ScopedAIBinder_DeathRecipient;
 using ::ndk::ScopedAStatus;
+using ::ndk::ScopedFileDescriptor;
 
 std::string toString(const std::unordered_set<int64_t>& values) {
     std::string str = "";
@@ -111,11 +113,13 @@ DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> vehicleHa
     mSubscriptionManager = std::make_shared<SubscriptionManager>(vehicleHardwarePtr);
     mEventBatchingWindow = mVehicleHardware->getPropertyOnChangeEventBatchingWindow();
     if (mEventBatchingWindow != std::chrono::nanoseconds(0)) {
+        mEventBatchMaxSize = mVehicleHardware->getPropertyOnChangeEventBatchMaxSize();
+        mLatencyCriticalPropIds = mVehicleHardware->getLatencyCriticalPropIds();
         mBatchedEventQueue = std::make_shared<ConcurrentQueue<VehiclePropValue>>();
         mPropertyChangeEventsBatchingConsumer =
                 std::make_shared<BatchingConsumer<VehiclePropValue>>();
         mPropertyChangeEventsBatchingConsumer->run(
-                mBatchedEventQueue.get(), mEventBatchingWindow,
+                mBatchedEventQueue.get(), mEventBatchingWindow, mEventBatchMaxSize,
                 [this](std::vector<VehiclePropValue> batchedEvents) {
                     handleBatchedPropertyEvents(std::move(batchedEvents));
                 });
@@ -123,16 +127,21 @@ DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> vehicleHa
 
     std::weak_ptr<ConcurrentQueue<VehiclePropValue>> batchedEventQueueCopy = mBatchedEventQueue;
     std::chrono::nanoseconds eventBatchingWindow = mEventBatchingWindow;
+    std::unordered_set<int32_t> latencyCriticalPropIdsCopy = mLatencyCriticalPropIds;
     std::weak_ptr<SubscriptionManager> subscriptionManagerCopy = mSubscriptionManager;
+    std::shared_ptr<PropertyLatencyStats> latencyStatsCopy = mPropertyLatencyStats;
     mVehicleHardware->registerOnPropertyChangeEvent(
             std::make_unique<IVehicleHardware::PropertyChangeCallback>(
-                    [subscriptionManagerCopy, batchedEventQueueCopy,
-                     eventBatchingWindow](std::vector<VehiclePropValue> updatedValues) {
+                    [subscriptionManagerCopy, latencyStatsCopy, batchedEventQueueCopy,
+                     eventBatchingWindow,
+                     latencyCriticalPropIdsCopy](std::vector<VehiclePropValue> updatedValues) {
                         if (eventBatchingWindow != std::chrono::nanoseconds(0)) {
-                            batchPropertyChangeEvent(batchedEventQueueCopy,
+                            batchPropertyChangeEvent(batchedEventQueueCopy, subscriptionManagerCopy,
+                                                     latencyStatsCopy.get(),
+                                                     latencyCriticalPropIdsCopy,
                                                      std::move(updatedValues));
                         } else {
-                            onPropertyChangeEvent(subscriptionManagerCopy,
+                            onPropertyChangeEvent(subscriptionManagerCopy, latencyStatsCopy.get(),
                                                   std::move(updatedValues));
                         }
                     }));
@@ -185,7 +194,30 @@ DefaultVehicleHal::~DefaultVehicleHal() {
 
 void DefaultVehicleHal::batchPropertyChangeEvent(
         const std::weak_ptr<ConcurrentQueue<VehiclePropValue>>& batchedEventQueue,
+        const std::weak_ptr<SubscriptionManager>& subscriptionManager,
+        PropertyLatencyStats* latencyStats,
+        const std::unordered_set<int32_t>& latencyCriticalPropIds,
         std::vector<VehiclePropValue>&& updatedValues) {
+    if (!latencyCriticalPropIds.empty()) {
+        std::vector<VehiclePropValue> latencyCriticalValues;
+        std::vector<VehiclePropValue> valuesToBatch;
+        for (auto& value : updatedValues) {
+            if (latencyCriticalPropIds.find(value.prop) != latencyCriticalPropIds.end()) {
+                latencyCriticalValues.push_back(std::move(value));
+            } else {
+                valuesToBatch.push_back(std::move(value));
+            }
+        }
+        if (!latencyCriticalValues.empty()) {
+            onPropertyChangeEvent(subscriptionManager, latencyStats,
+                                  std::move(latencyCriticalValues));
+        }
+        updatedValues = std::move(valuesToBatch);
+    }
+    if (updatedValues.empty()) {
+        return;
+    }
+
     auto batchedEventQueueStrong = batchedEventQueue.lock();
     if (batchedEventQueueStrong == nullptr) {
         ALOGW("the batched property events queue is destroyed, DefaultVehicleHal is ending");
@@ -195,12 +227,25 @@ void DefaultVehicleHal::batchPropertyChangeEvent(
 }
 
 void DefaultVehicleHal::handleBatchedPropertyEvents(std::vector<VehiclePropValue>&& batchedEvents) {
-    onPropertyChangeEvent(mSubscriptionManager, std::move(batchedEvents));
+    int64_t nowInNanos = elapsedRealtimeNano();
+    int64_t oldestTimestamp = nowInNanos;
+    for (const auto& event : batchedEvents) {
+        if (event.timestamp > 0) {
+            oldestTimestamp = std::min(oldestTimestamp, event.timestamp);
+        }
+    }
+    {
+        std::scoped_lock<std::mutex> lockGuard(mBatchingStatsLock);
+        mBatchSizeHistogram.record(static_cast<int64_t>(batchedEvents.size()));
+        mBatchLatencyHistogram.record((nowInNanos - oldestTimestamp) / 1'000'000);
+    }
+    onPropertyChangeEvent(mSubscriptionManager, mPropertyLatencyStats.get(),
+                          std::move(batchedEvents));
 }
 
 void DefaultVehicleHal::onPropertyChangeEvent(
         const std::weak_ptr<SubscriptionManager>& subscriptionManager,
-        std::vector<VehiclePropValue>&& updatedValues) {
+        PropertyLatencyStats* latencyStats, std::vector<VehiclePropValue>&& updatedValues) {
     ATRACE_CALL();
     auto manager = subscriptionManager.lock();
     if (manager == nullptr) {
@@ -208,8 +253,28 @@ void DefaultVehicleHal::onPropertyChangeEvent(
         return;
     }
     auto updatedValuesByClients = manager->getSubscribedClients(std::move(updatedValues));
+    // The [propId, timestamp] for the values sent to the current client, reused for all clients.
+    std::vector<std::pair<int32_t, int64_t>> sentEvents;
     for (auto& [callback, values] : updatedValuesByClients) {
-        SubscriptionClient::sendUpdatedValues(callback, std::move(values));
+        if (latencyStats != nullptr) {
+            sentEvents.clear();
+            for (const auto& value : values) {
+                if (value.timestamp > 0) {
+                    sentEvents.emplace_back(value.prop, value.timestamp);
+                }
+            }
+        }
+        std::shared_ptr<SharedMemoryPool> sharedMemoryPool =
+                manager->getSharedMemoryPool(callback->asBinder().get());
+        SubscriptionClient::sendUpdatedValues(callback, std::move(values),
+                                              sharedMemoryPool.get());
+        if (latencyStats != nullptr && !sentEvents.empty()) {
+            int64_t nowInNanos = elapsedRealtimeNano();
+            for (const auto& [propId, timestamp] : sentEvents) {
+                latencyStats->recordLatency(PropertyLatencyStats::LatencyType::PROPERTY_EVENT,
+                                            propId, nowInNanos - timestamp);
+            }
+        }
     }
 }
 
@@ -230,10 +295,11 @@ void DefaultVehicleHal::onPropertySetErrorEvent(
 template <class T>
 std::shared_ptr<T> DefaultVehicleHal::getOrCreateClient(
         std::unordered_map<const AIBinder*, std::shared_ptr<T>>* clients,
-        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool) {
+        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool,
+        std::shared_ptr<PropertyLatencyStats> latencyStats) {
     const AIBinder* clientId = callback->asBinder().get();
     if (clients->find(clientId) == clients->end()) {
-        (*clients)[clientId] = std::make_shared<T>(pendingRequestPool, callback);
+        (*clients)[clientId] = std::make_shared<T>(pendingRequestPool, callback, latencyStats);
     }
     return (*clients)[clientId];
 }
@@ -309,11 +375,13 @@ void DefaultVehicleHal::onBinderDiedUnlinkedHandler() {
 template std::shared_ptr<DefaultVehicleHal::GetValuesClient>
 DefaultVehicleHal::getOrCreateClient<DefaultVehicleHal::GetValuesClient>(
         std::unordered_map<const AIBinder*, std::shared_ptr<GetValuesClient>>* clients,
-        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool);
+        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool,
+        std::shared_ptr<PropertyLatencyStats> latencyStats);
 template std::shared_ptr<DefaultVehicleHal::SetValuesClient>
 DefaultVehicleHal::getOrCreateClient<DefaultVehicleHal::SetValuesClient>(
         std::unordered_map<const AIBinder*, std::shared_ptr<SetValuesClient>>* clients,
-        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool);
+        const CallbackType& callback, std::shared_ptr<PendingRequestPool> pendingRequestPool,
+        std::shared_ptr<PropertyLatencyStats> latencyStats);
 
 void DefaultVehicleHal::setTimeout(int64_t timeoutInNano) {
     mPendingRequestPool = std::make_unique<PendingRequestPool>(timeoutInNano);
@@ -354,44 +422,74 @@ bool DefaultVehicleHal::getAllPropConfigsFromHardware() {
         }
         filteredConfigs.push_back(std::move(config));
     }
+    auto snapshot = std::make_shared<ConfigSnapshot>();
     for (auto& config : filteredConfigs) {
-        mConfigsByPropId[config.prop] = config;
+        auto [it, inserted] =
+                snapshot->configIndexByPropId.try_emplace(config.prop, snapshot->configs.size());
+        if (inserted) {
+            snapshot->configs.push_back(std::move(config));
+        } else {
+            // The last config wins for duplicate property IDs.
+            snapshot->configs[it->second] = std::move(config);
+        }
     }
+
     VehiclePropConfigs vehiclePropConfigs;
-    vehiclePropConfigs.payloads = std::move(filteredConfigs);
+    vehiclePropConfigs.payloads = snapshot->configs;
     auto result = LargeParcelableBase::parcelableToStableLargeParcelable(vehiclePropConfigs);
     if (!result.ok()) {
         ALOGE("failed to convert configs to shared memory file, error: %s, code: %d",
               result.error().message().c_str(), static_cast<int>(result.error().code()));
-        mConfigFile = nullptr;
         return false;
     }
+    snapshot->configFile = std::move(result.value());
 
-    if (result.value() != nullptr) {
-        mConfigFile = std::move(result.value());
+    std::vector<int32_t> propIds;
+    propIds.reserve(snapshot->configs.size());
+    for (const auto& config : snapshot->configs) {
+        propIds.push_back(config.prop);
     }
+    mPropertyLatencyStats->setPropIds(propIds);
+
+    std::scoped_lock<std::mutex> lockGuard(mConfigSnapshotLock);
+    mConfigSnapshot = std::move(snapshot);
     return true;
 }
 
+std::shared_ptr<const DefaultVehicleHal::ConfigSnapshot> DefaultVehicleHal::getConfigSnapshot()
+        const {
+    std::scoped_lock<std::mutex> lockGuard(mConfigSnapshotLock);
+    return mConfigSnapshot;
+}
+
+const VehiclePropConfig* DefaultVehicleHal::ConfigSnapshot::getConfig(int32_t propId) const {
+    auto it = configIndexByPropId.find(propId);
+    if (it == configIndexByPropId.end()) {
+        return nullptr;
+    }
+    return &configs[it->second];
+}
+
 ScopedAStatus DefaultVehicleHal::getAllPropConfigs(VehiclePropConfigs* output) {
-    if (mConfigFile != nullptr) {
+    auto snapshot = getConfigSnapshot();
+    if (snapshot->configFile != nullptr) {
         output->payloads.clear();
-        output->sharedMemoryFd.set(dup(mConfigFile->get()));
+        output->sharedMemoryFd.set(dup(snapshot->configFile->get()));
         return ScopedAStatus::ok();
     }
-    output->payloads.reserve(mConfigsByPropId.size());
-    for (const auto& [_, config] : mConfigsByPropId) {
-        output->payloads.push_back(config);
-    }
+    output->payloads = snapshot->configs;
     return ScopedAStatus::ok();
 }
 
-Result<const VehiclePropConfig*> DefaultVehicleHal::getConfig(int32_t propId) const {
-    auto it = mConfigsByPropId.find(propId);
-    if (it == mConfigsByPropId.end()) {
+Result<std::shared_ptr<const VehiclePropConfig>> DefaultVehicleHal::getConfig(
+        int32_t propId) const {
+    auto snapshot = getConfigSnapshot();
+    const VehiclePropConfig* config = snapshot->getConfig(propId);
+    if (config == nullptr) {
         return Error() << "no config for property, ID: " << propId;
     }
-    return &(it->second);
+    // Share the ownership of the snapshot without copying the config.
+    return std::shared_ptr<const VehiclePropConfig>(std::move(snapshot), config);
 }
 
 Result<void> DefaultVehicleHal::checkProperty(const VehiclePropValue& propValue) {
@@ -400,7 +498,7 @@ Result<void> DefaultVehicleHal::checkProperty(const VehiclePropValue& propValue)
     if (!result.ok()) {
         return result.error();
     }
-    const VehiclePropConfig* config = result.value();
+    const VehiclePropConfig* config = result.value().get();
     const VehicleAreaConfig* areaConfig = getAreaConfig(propValue, *config);
     if (!isGlobalProp(propId) && areaConfig == nullptr) {
         // Ignore areaId for global property. For non global property, check whether areaId is
@@ -422,6 +520,7 @@ Result<void> DefaultVehicleHal::checkProperty(const VehiclePropValue& propValue)
 ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
                                            const GetValueRequests& requests) {
     ATRACE_CALL();
+    int64_t startTimeInNanos = elapsedRealtimeNano();
     if (callback == nullptr) {
         return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
     }
@@ -444,9 +543,27 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
     std::vector<GetValueResult> failedResults;
     // The list of requests that we would send to hardware.
     std::vector<GetValueRequest> hardwareRequests;
+    hardwareRequests.reserve(getValueRequests.size());
+    // The set of request Ids that we would send to hardware.
+    std::unordered_set<int64_t> hardwareRequestIds;
+    hardwareRequestIds.reserve(getValueRequests.size());
+    // The requests that we would send to hardware, to track their latency.
+    std::vector<RequestLatencyTracker::Request> trackedRequests;
+    trackedRequests.reserve(getValueRequests.size());
+    // The read permission only depends on [propId, areaId], so only check it once per batch.
+    std::unordered_map<PropIdAreaId, VhalResult<void>, PropIdAreaIdHash> readPermissionResults;
 
     for (const auto& request : getValueRequests) {
-        if (auto result = checkReadPermission(request.prop); !result.ok()) {
+        PropIdAreaId propIdAreaId = {
+                .propId = request.prop.prop,
+                .areaId = request.prop.areaId,
+        };
+        auto it = readPermissionResults.find(propIdAreaId);
+        if (it == readPermissionResults.end()) {
+            it = readPermissionResults.emplace(propIdAreaId, checkReadPermission(request.prop))
+                         .first;
+        }
+        if (const auto& result = it->second; !result.ok()) {
             ALOGW("property does not support reading: %s", getErrorMsg(result).c_str());
             failedResults.push_back(GetValueResult{
                     .requestId = request.requestId,
@@ -456,12 +573,11 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
             continue;
         }
         hardwareRequests.push_back(request);
-    }
-
-    // The set of request Ids that we would send to hardware.
-    std::unordered_set<int64_t> hardwareRequestIds;
-    for (const auto& request : hardwareRequests) {
         hardwareRequestIds.insert(request.requestId);
+        trackedRequests.push_back({
+                .requestId = request.requestId,
+                .propId = request.prop.prop,
+        });
     }
 
     std::shared_ptr<GetValuesClient> client;
@@ -473,7 +589,8 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
                                                                "client died");
         }
 
-        client = getOrCreateClient(&mGetValuesClients, callback, mPendingRequestPool);
+        client = getOrCreateClient(&mGetValuesClients, callback, mPendingRequestPool,
+                                   mPropertyLatencyStats);
     }
 
     // Register the pending hardware requests and also check for duplicate request Ids.
@@ -482,6 +599,7 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
               toString(hardwareRequestIds).c_str(), getErrorMsg(addRequestResult).c_str());
         return toScopedAStatus(addRequestResult);
     }
+    client->trackRequestLatency(startTimeInNanos, trackedRequests);
 
     if (!failedResults.empty()) {
         // First send the failed results we already know back to the client.
@@ -498,6 +616,7 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
         // If the hardware returns error, finish all the pending requests for this request because
         // we never expect hardware to call callback for these requests.
         client->tryFinishRequests(hardwareRequestIds);
+        client->untrackRequestLatency(hardwareRequestIds);
         ALOGE("getValues[%s]: failed to get value from VehicleHardware, status: %d",
               toString(hardwareRequestIds).c_str(), toInt(status));
         return ScopedAStatus::fromServiceSpecificErrorWithMessage(
@@ -509,6 +628,7 @@ ScopedAStatus DefaultVehicleHal::getValues(const CallbackType& callback,
 ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
                                            const SetValueRequests& requests) {
     ATRACE_CALL();
+    int64_t startTimeInNanos = elapsedRealtimeNano();
     if (callback == nullptr) {
         return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
     }
@@ -532,9 +652,28 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
         return toScopedAStatus(maybeRequestIds, StatusCode::INVALID_ARG);
     }
 
+    hardwareRequests.reserve(setValueRequests.size());
+    // The set of request Ids that we would send to hardware.
+    std::unordered_set<int64_t> hardwareRequestIds;
+    hardwareRequestIds.reserve(setValueRequests.size());
+    // The requests that we would send to hardware, to track their latency.
+    std::vector<RequestLatencyTracker::Request> trackedRequests;
+    trackedRequests.reserve(setValueRequests.size());
+    // The write permission only depends on [propId, areaId], so only check it once per batch.
+    std::unordered_map<PropIdAreaId, VhalResult<void>, PropIdAreaIdHash> writePermissionResults;
+
     for (auto& request : setValueRequests) {
         int64_t requestId = request.requestId;
-        if (auto result = checkWritePermission(request.value); !result.ok()) {
+        PropIdAreaId propIdAreaId = {
+                .propId = request.value.prop,
+                .areaId = request.value.areaId,
+        };
+        auto it = writePermissionResults.find(propIdAreaId);
+        if (it == writePermissionResults.end()) {
+            it = writePermissionResults.emplace(propIdAreaId, checkWritePermission(request.value))
+                         .first;
+        }
+        if (const auto& result = it->second; !result.ok()) {
             ALOGW("property does not support writing: %s", getErrorMsg(result).c_str());
             failedResults.push_back(SetValueResult{
                     .requestId = requestId,
@@ -553,12 +692,11 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
         }
 
         hardwareRequests.push_back(request);
-    }
-
-    // The set of request Ids that we would send to hardware.
-    std::unordered_set<int64_t> hardwareRequestIds;
-    for (const auto& request : hardwareRequests) {
-        hardwareRequestIds.insert(request.requestId);
+        hardwareRequestIds.insert(requestId);
+        trackedRequests.push_back({
+                .requestId = requestId,
+                .propId = request.value.prop,
+        });
     }
 
     std::shared_ptr<SetValuesClient> client;
@@ -569,7 +707,8 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
             return ScopedAStatus::fromExceptionCodeWithMessage(EX_TRANSACTION_FAILED,
                                                                "client died");
         }
-        client = getOrCreateClient(&mSetValuesClients, callback, mPendingRequestPool);
+        client = getOrCreateClient(&mSetValuesClients, callback, mPendingRequestPool,
+                                   mPropertyLatencyStats);
     }
 
     // Register the pending hardware requests and also check for duplicate request Ids.
@@ -578,6 +717,7 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
               toString(hardwareRequestIds).c_str(), getErrorMsg(addRequestResult).c_str());
         return toScopedAStatus(addRequestResult);
     }
+    client->trackRequestLatency(startTimeInNanos, trackedRequests);
 
     if (!failedResults.empty()) {
         // First send the failed results we already know back to the client.
@@ -594,6 +734,7 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
         // If the hardware returns error, finish all the pending requests for this request because
         // we never expect hardware to call callback for these requests.
         client->tryFinishRequests(hardwareRequestIds);
+        client->untrackRequestLatency(hardwareRequestIds);
         ALOGE("setValues[%s], failed to set value to VehicleHardware, status: %d",
               toString(hardwareRequestIds).c_str(), toInt(status));
         return ScopedAStatus::fromServiceSpecificErrorWithMessage(
@@ -633,17 +774,54 @@ ScopedAStatus DefaultVehicleHal::setValues(const CallbackType& callback,
 
 ScopedAStatus DefaultVehicleHal::getPropConfigs(const std::vector<int32_t>& props,
                                                 VehiclePropConfigs* output) {
-    std::vector<VehiclePropConfig> configs;
-    for (int32_t prop : props) {
-        if (mConfigsByPropId.find(prop) != mConfigsByPropId.end()) {
-            configs.push_back(mConfigsByPropId[prop]);
-        } else {
-            return ScopedAStatus::fromServiceSpecificErrorWithMessage(
-                    toInt(StatusCode::INVALID_ARG),
-                    StringPrintf("no config for property, ID: %" PRId32, prop).c_str());
+    auto snapshot = getConfigSnapshot();
+    std::shared_ptr<const SerializedPropConfigs> serializedConfigs;
+    {
+        std::scoped_lock<std::mutex> lockGuard(snapshot->serializedPropConfigsLock);
+        if (auto it = snapshot->serializedPropConfigsByPropIds.find(props);
+            it != snapshot->serializedPropConfigsByPropIds.end()) {
+            serializedConfigs = it->second;
+        }
+    }
+
+    if (serializedConfigs == nullptr) {
+        VehiclePropConfigs vehiclePropConfigs;
+        for (int32_t prop : props) {
+            const VehiclePropConfig* config = snapshot->getConfig(prop);
+            if (config == nullptr) {
+                return ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                        toInt(StatusCode::INVALID_ARG),
+                        StringPrintf("no config for property, ID: %" PRId32, prop).c_str());
+            }
+            vehiclePropConfigs.payloads.push_back(*config);
+        }
+        auto result = LargeParcelableBase::parcelableToStableLargeParcelable(vehiclePropConfigs);
+        if (!result.ok()) {
+            return toScopedAStatus(result, StatusCode::INTERNAL_ERROR);
+        }
+        auto newSerializedConfigs = std::make_shared<SerializedPropConfigs>();
+        newSerializedConfigs->sharedMemoryFile = std::move(result.value());
+        if (newSerializedConfigs->sharedMemoryFile == nullptr) {
+            newSerializedConfigs->payloads = std::move(vehiclePropConfigs.payloads);
+        }
+        serializedConfigs = newSerializedConfigs;
+
+        std::scoped_lock<std::mutex> lockGuard(snapshot->serializedPropConfigsLock);
+        auto& cache = snapshot->serializedPropConfigsByPropIds;
+        if (cache.size() >= MAX_SERIALIZED_PROP_CONFIGS_COUNT) {
+            cache.clear();
         }
+        cache[props] = serializedConfigs;
     }
-    return vectorToStableLargeParcelable(std::move(configs), output);
+
+    if (serializedConfigs->sharedMemoryFile != nullptr) {
+        output->payloads.clear();
+        output->sharedMemoryFd.set(dup(serializedConfigs->sharedMemoryFile->get()));
+        return ScopedAStatus::ok();
+    }
+    output->payloads = serializedConfigs->payloads;
+    output->sharedMemoryFd = ScopedFileDescriptor();
+    return ScopedAStatus::ok();
 }
 
 bool hasRequiredAccess(VehiclePropertyAccess access, VehiclePropertyAccess requiredAccess) {
@@ -664,14 +842,15 @@ bool areaConfigsHaveRequiredAccess(const std::vector<VehicleAreaConfig>& areaCon
 }
 
 VhalResult<void> DefaultVehicleHal::checkSubscribeOptions(
-        const std::vector<SubscribeOptions>& options) {
+        const std::vector<SubscribeOptions>& options, const ConfigSnapshot& configSnapshot) {
     for (const auto& option : options) {
         int32_t propId = option.propId;
-        if (mConfigsByPropId.find(propId) == mConfigsByPropId.end()) {
+        const VehiclePropConfig* configPtr = configSnapshot.getConfig(propId);
+        if (configPtr == nullptr) {
             return StatusError(StatusCode::INVALID_ARG)
                    << StringPrintf("no config for property, ID: %" PRId32, propId);
         }
-        const VehiclePropConfig& config = mConfigsByPropId[propId];
+        const VehiclePropConfig& config = *configPtr;
         std::vector<VehicleAreaConfig> areaConfigs;
         if (option.areaIds.empty()) {
             areaConfigs = config.areaConfigs;
@@ -733,12 +912,17 @@ VhalResult<void> DefaultVehicleHal::checkSubscribeOptions(
 
 ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
                                            const std::vector<SubscribeOptions>& options,
-                                           [[maybe_unused]] int32_t maxSharedMemoryFileCount) {
-    // TODO(b/205189110): Use shared memory file count.
+                                           int32_t maxSharedMemoryFileCount) {
     if (callback == nullptr) {
         return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
     }
-    if (auto result = checkSubscribeOptions(options); !result.ok()) {
+    if (maxSharedMemoryFileCount < 0) {
+        return ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                toInt(StatusCode::INVALID_ARG), "maxSharedMemoryFileCount must not be negative");
+    }
+    // Use the same snapshot for validating and handling the options.
+    auto configSnapshot = getConfigSnapshot();
+    if (auto result = checkSubscribeOptions(options, *configSnapshot); !result.ok()) {
         ALOGE("subscribe: invalid subscribe options: %s", getErrorMsg(result).c_str());
         return toScopedAStatus(result);
     }
@@ -747,7 +931,7 @@ ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
     for (const auto& option : options) {
         int32_t propId = option.propId;
         // We have already validate config exists.
-        const VehiclePropConfig& config = mConfigsByPropId[propId];
+        const VehiclePropConfig& config = *configSnapshot->getConfig(propId);
 
         SubscribeOptions optionCopy = option;
         // If areaIds is empty, subscribe to all areas.
@@ -824,6 +1008,8 @@ ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
                 return toScopedAStatus(result);
             }
         }
+        mSubscriptionManager->setMaxSharedMemoryFileCount(callback->asBinder().get(),
+                                                          maxSharedMemoryFileCount);
     }
     return ScopedAStatus::ok();
 }
@@ -836,9 +1022,18 @@ ScopedAStatus DefaultVehicleHal::unsubscribe(const CallbackType& callback,
     return toScopedAStatus(mSubscriptionManager->unsubscribe(callback->asBinder().get(), propIds));
 }
 
-ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType&, int64_t) {
-    // TODO(b/200737967): implement this.
-    return ScopedAStatus::ok();
+ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType& callback,
+                                                    int64_t sharedMemoryId) {
+    if (callback == nullptr) {
+        return ScopedAStatus::fromExceptionCode(EX_NULL_POINTER);
+    }
+    std::shared_ptr<SharedMemoryPool> sharedMemoryPool =
+            mSubscriptionManager->getSharedMemoryPool(callback->asBinder().get());
+    if (sharedMemoryPool == nullptr) {
+        return ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                toInt(StatusCode::INVALID_ARG), "no property was subscribed for the callback");
+    }
+    return toScopedAStatus(sharedMemoryPool->returnSharedMemory(sharedMemoryId));
 }
 
 IVehicleHardware* DefaultVehicleHal::getHardware() {
@@ -861,7 +1056,7 @@ VhalResult<void> DefaultVehicleHal::checkPermissionHelper(
         return StatusError(StatusCode::INVALID_ARG) << getErrorMsg(result);
     }
 
-    const VehiclePropConfig* config = result.value();
+    const VehiclePropConfig* config = result.value().get();
     const VehicleAreaConfig* areaConfig = getAreaConfig(value, *config);
 
     if (areaConfig == nullptr && !isGlobalProp(propId)) {
@@ -897,7 +1092,7 @@ void DefaultVehicleHal::checkHealth(IVehicleHardware* vehicleHardware,
             .status = VehiclePropertyStatus::AVAILABLE,
             .value.int64Values = {uptimeMillis()},
     }};
-    onPropertyChangeEvent(subscriptionManager, std::move(values));
+    onPropertyChangeEvent(subscriptionManager, /*latencyStats=*/nullptr, std::move(values));
     return;
 }
 
@@ -910,6 +1105,27 @@ bool DefaultVehicleHal::BinderLifecycleHandler::isAlive(const AIBinder* binder)
     return AIBinder_isAlive(binder);
 }
 
+DefaultVehicleHal::Histogram::Histogram(std::vector<int64_t> upperBounds)
+    : mUpperBounds(std::move(upperBounds)), mCounts(mUpperBounds.size() + 1, 0) {}
+
+void DefaultVehicleHal::Histogram::record(int64_t value) {
+    size_t i = std::lower_bound(mUpperBounds.begin(), mUpperBounds.end(), value) -
+               mUpperBounds.begin();
+    mCounts[i]++;
+    mTotalCount++;
+}
+
+std::string DefaultVehicleHal::Histogram::toString() const {
+    std::string str = StringPrintf("total: %" PRIu64, mTotalCount);
+    for (size_t i = 0; i < mUpperBounds.size(); i++) {
+        str += StringPrintf(", <=%" PRId64 ": %" PRIu64, mUpperBounds[i], mCounts[i]);
+    }
+    if (!mUpperBounds.empty()) {
+        str += StringPrintf(", >%" PRId64 ": %" PRIu64, mUpperBounds.back(), mCounts.back());
+    }
+    return str;
+}
+
 void DefaultVehicleHal::setBinderLifecycleHandler(
         std::unique_ptr<BinderLifecycleInterface> handler) {
     mBinderLifecycleHandler = std::move(handler);
@@ -934,6 +1150,10 @@ binder_status_t DefaultVehicleHal::dump(int fd, const char** args, uint32_t numA
         // Ignore "-a" option. Bugreport will call with this option.
         options.clear();
     }
+    if (options.size() == 1 && options[0] == DUMP_STATS_OPTION) {
+        dprintf(fd, "%s", mPropertyLatencyStats->dump().c_str());
+        return STATUS_OK;
+    }
     DumpResult result = mVehicleHardware->dump(options);
     if (result.refreshPropertyConfigs) {
         getAllPropConfigsFromHardware();
@@ -946,11 +1166,23 @@ binder_status_t DefaultVehicleHal::dump(int fd, const char** args, uint32_t numA
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
         dprintf(fd, "Interface version: %" PRId32 "\n", getVhalInterfaceVersion());
-        dprintf(fd, "Containing %zu property configs\n", mConfigsByPropId.size());
+        dprintf(fd, "Containing %zu property configs\n", getConfigSnapshot()->configs.size());
         dprintf(fd, "Currently have %zu getValues clients\n", mGetValuesClients.size());
         dprintf(fd, "Currently have %zu setValues clients\n", mSetValuesClients.size());
         dprintf(fd, "Currently have %zu subscribe clients\n", countSubscribeClients());
     }
+    if (mBatchedEventQueue) {
+        dprintf(fd,
+                "Property change event batching window: %" PRId64
+                "ns, max batch size: %zu, latency critical properties: %zu\n",
+                static_cast<int64_t>(mEventBatchingWindow.count()), mEventBatchMaxSize,
+                mLatencyCriticalPropIds.size());
+        std::scoped_lock<std::mutex> lockGuard(mBatchingStatsLock);
+        dprintf(fd, "Property change event batch size histogram: %s\n",
+                mBatchSizeHistogram.toString().c_str());
+        dprintf(fd, "Property change event batch latency histogram (ms): %s\n",
+                mBatchLatencyHistogram.toString().c_str());
+    }
     return STATUS_OK;
 }
 
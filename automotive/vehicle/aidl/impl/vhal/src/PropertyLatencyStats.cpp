@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_HAL
+
+#include "PropertyLatencyStats.h"
+
+#include <VehicleHalTypes.h>
+
+#include <android-base/stringprintf.h>
+#include <utils/SystemClock.h>
+#include <utils/Trace.h>
+
+#include <inttypes.h>
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::VehicleProperty;
+using ::android::base::StringPrintf;
+
+constexpr const char* LATENCY_TYPE_NAMES[] = {"property event", "getValues", "setValues"};
+
+const char* getLatencyTypeName(PropertyLatencyStats::LatencyType type) {
+    return LATENCY_TYPE_NAMES[static_cast<size_t>(type)];
+}
+
+std::string getPropertyName(int32_t propId) {
+    return StringPrintf("%s(0x%x)",
+                        aidl::android::hardware::automotive::vehicle::toString(
+                                static_cast<VehicleProperty>(propId))
+                                .c_str(),
+                        propId);
+}
+
+}  // namespace
+
+PropertyLatencyStats::PropertyLatencyStats() {
+    auto table = std::make_unique<const StatsTable>();
+    mStatsTable.store(table.get(), std::memory_order_release);
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mStatsTables.push_back(std::move(table));
+}
+
+PropertyLatencyStats::~PropertyLatencyStats() = default;
+
+void PropertyLatencyStats::setPropIds(const std::vector<int32_t>& propIds) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    const StatsTable* currentTable = mStatsTable.load(std::memory_order_acquire);
+    auto table = std::make_unique<StatsTable>();
+    table->reserve(propIds.size());
+    for (int32_t propId : propIds) {
+        auto it = currentTable->find(propId);
+        (*table)[propId] =
+                (it != currentTable->end()) ? it->second : std::make_shared<PropertyStats>();
+    }
+    mStatsTable.store(table.get(), std::memory_order_release);
+    mStatsTables.push_back(std::move(table));
+}
+
+PropertyLatencyStats::LatencyHistogram* PropertyLatencyStats::getHistogram(
+        LatencyType type, int32_t propId) const {
+    const StatsTable* table = mStatsTable.load(std::memory_order_acquire);
+    auto it = table->find(propId);
+    if (it == table->end()) {
+        return nullptr;
+    }
+    return &(it->second->histograms[static_cast<size_t>(type)]);
+}
+
+void PropertyLatencyStats::recordLatency(LatencyType type, int32_t propId,
+                                         int64_t latencyInNanos) {
+    LatencyHistogram* histogram = getHistogram(type, propId);
+    if (histogram == nullptr) {
+        return;
+    }
+    int64_t latencyInMicros = std::max(latencyInNanos, static_cast<int64_t>(0)) / 1'000;
+    size_t bucket = std::lower_bound(BUCKET_UPPER_BOUNDS_IN_MICROS.begin(),
+                                     BUCKET_UPPER_BOUNDS_IN_MICROS.end(), latencyInMicros) -
+                    BUCKET_UPPER_BOUNDS_IN_MICROS.begin();
+    histogram->counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram->totalCount.fetch_add(1, std::memory_order_relaxed);
+    histogram->totalLatencyInMicros.fetch_add(static_cast<uint64_t>(latencyInMicros),
+                                              std::memory_order_relaxed);
+    int64_t maxLatencyInMicros = histogram->maxLatencyInMicros.load(std::memory_order_relaxed);
+    while (latencyInMicros > maxLatencyInMicros &&
+           !histogram->maxLatencyInMicros.compare_exchange_weak(
+                   maxLatencyInMicros, latencyInMicros, std::memory_order_relaxed)) {
+    }
+
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT64(StringPrintf("VHAL %s latency(us) 0x%x", getLatencyTypeName(type), propId)
+                             .c_str(),
+                     latencyInMicros);
+    }
+}
+
+void PropertyLatencyStats::recordTimeout(LatencyType type, int32_t propId) {
+    LatencyHistogram* histogram = getHistogram(type, propId);
+    if (histogram == nullptr) {
+        return;
+    }
+    histogram->timeoutCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t PropertyLatencyStats::getCount(LatencyType type, int32_t propId) const {
+    const LatencyHistogram* histogram = getHistogram(type, propId);
+    return histogram == nullptr ? 0 : histogram->totalCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PropertyLatencyStats::getTimeoutCount(LatencyType type, int32_t propId) const {
+    const LatencyHistogram* histogram = getHistogram(type, propId);
+    return histogram == nullptr ? 0 : histogram->timeoutCount.load(std::memory_order_relaxed);
+}
+
+std::string PropertyLatencyStats::dump() const {
+    const StatsTable* table = mStatsTable.load(std::memory_order_acquire);
+    std::vector<int32_t> propIds;
+    propIds.reserve(table->size());
+    for (const auto& [propId, _] : *table) {
+        propIds.push_back(propId);
+    }
+    std::sort(propIds.begin(), propIds.end());
+
+    std::string str = "Per-property latency stats (us):\n";
+    for (int32_t propId : propIds) {
+        const PropertyStats& stats = *(table->at(propId));
+        for (size_t i = 0; i < LATENCY_TYPE_COUNT; i++) {
+            const LatencyHistogram& histogram = stats.histograms[i];
+            uint64_t totalCount = histogram.totalCount.load(std::memory_order_relaxed);
+            uint64_t timeoutCount = histogram.timeoutCount.load(std::memory_order_relaxed);
+            if (totalCount == 0 && timeoutCount == 0) {
+                continue;
+            }
+            uint64_t meanLatencyInMicros =
+                    totalCount == 0 ? 0
+                                    : histogram.totalLatencyInMicros.load(
+                                              std::memory_order_relaxed) /
+                                              totalCount;
+            str += StringPrintf("%s %s: total: %" PRIu64 ", timeout: %" PRIu64 ", mean: %" PRIu64
+                                ", max: %" PRId64,
+                                getPropertyName(propId).c_str(), LATENCY_TYPE_NAMES[i], totalCount,
+                                timeoutCount, meanLatencyInMicros,
+                                histogram.maxLatencyInMicros.load(std::memory_order_relaxed));
+            for (size_t j = 0; j < BUCKET_COUNT; j++) {
+                str += StringPrintf(", <=%" PRId64 ": %" PRIu64, BUCKET_UPPER_BOUNDS_IN_MICROS[j],
+                                    histogram.counts[j].load(std::memory_order_relaxed));
+            }
+            str += StringPrintf(", >%" PRId64 ": %" PRIu64 "\n",
+                                BUCKET_UPPER_BOUNDS_IN_MICROS.back(),
+                                histogram.counts[BUCKET_COUNT].load(std::memory_order_relaxed));
+        }
+    }
+    return str;
+}
+
+RequestLatencyTracker::RequestLatencyTracker(std::shared_ptr<PropertyLatencyStats> stats,
+                                             PropertyLatencyStats::LatencyType type)
+    : mStats(std::move(stats)), mType(type) {}
+
+void RequestLatencyTracker::onRequestsStarted(int64_t startTimeInNanos,
+                                              const std::vector<Request>& requests) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    for (const auto& request : requests) {
+        mPendingRequests[request.requestId] = {
+                .propId = request.propId,
+                .startTimeInNanos = startTimeInNanos,
+        };
+    }
+}
+
+void RequestLatencyTracker::onRequestsFinished(const std::unordered_set<int64_t>& requestIds) {
+    int64_t nowInNanos = elapsedRealtimeNano();
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    for (int64_t requestId : requestIds) {
+        auto it = mPendingRequests.find(requestId);
+        if (it == mPendingRequests.end()) {
+            continue;
+        }
+        mStats->recordLatency(mType, it->second.propId, nowInNanos - it->second.startTimeInNanos);
+        mPendingRequests.erase(it);
+    }
+}
+
+void RequestLatencyTracker::onRequestsTimeout(const std::unordered_set<int64_t>& requestIds) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    for (int64_t requestId : requestIds) {
+        auto it = mPendingRequests.find(requestId);
+        if (it == mPendingRequests.end()) {
+            continue;
+        }
+        mStats->recordTimeout(mType, it->second.propId);
+        mPendingRequests.erase(it);
+    }
+}
+
+void RequestLatencyTracker::onRequestsCancelled(const std::unordered_set<int64_t>& requestIds) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    for (int64_t requestId : requestIds) {
+        mPendingRequests.erase(requestId);
+    }
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
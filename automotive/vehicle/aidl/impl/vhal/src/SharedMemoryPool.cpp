@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedMemoryPool.h"
+
+#include <VehicleHalTypes.h>
+
+#include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+using ::aidl::android::hardware::automotive::vehicle::IVehicle;
+using ::aidl::android::hardware::automotive::vehicle::StatusCode;
+
+SharedMemoryPool::SharedMemoryPool(int32_t maxFileCount) : mMaxFileCount(maxFileCount) {}
+
+void SharedMemoryPool::setMaxFileCount(int32_t maxFileCount) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    mMaxFileCount = maxFileCount;
+    // Drop the free slots that exceed the new limit.
+    while (!mFreeIds.empty() &&
+           static_cast<int32_t>(mFreeIds.size() + mInUseIds.size()) > mMaxFileCount) {
+        mFreeIds.pop_back();
+    }
+}
+
+int64_t SharedMemoryPool::obtain() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    if (static_cast<int32_t>(mInUseIds.size()) >= mMaxFileCount) {
+        return IVehicle::INVALID_MEMORY_ID;
+    }
+    int64_t id;
+    if (!mFreeIds.empty()) {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    } else {
+        id = mNextId++;
+    }
+    mInUseIds.insert(id);
+    return id;
+}
+
+void SharedMemoryPool::recycle(int64_t sharedMemoryId) {
+    // Recycling an ID that was never delivered is the same as the client returning it.
+    (void)returnSharedMemory(sharedMemoryId);
+}
+
+VhalResult<void> SharedMemoryPool::returnSharedMemory(int64_t sharedMemoryId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    if (mInUseIds.erase(sharedMemoryId) == 0) {
+        return StatusError(StatusCode::INVALID_ARG)
+               << "shared memory ID: " << sharedMemoryId << " is not in use by the client";
+    }
+    if (static_cast<int32_t>(mFreeIds.size() + mInUseIds.size()) < mMaxFileCount) {
+        mFreeIds.push_back(sharedMemoryId);
+    }
+    return {};
+}
+
+int32_t SharedMemoryPool::getFileCount() const {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    return static_cast<int32_t>(mFreeIds.size() + mInUseIds.size());
+}
+
+size_t SharedMemoryPool::countInUseFiles() const {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    return mInUseIds.size();
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
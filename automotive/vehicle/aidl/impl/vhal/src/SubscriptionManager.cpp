@@ -22,6 +22,7 @@
 #include <utils/SystemClock.h>
 
 #include <inttypes.h>
+#include <algorithm>
 
 namespace android {
 namespace hardware {
@@ -31,6 +32,7 @@ namespace vehicle {
 namespace {
 
 using ::aidl::android::hardware::automotive::vehicle::IVehicleCallback;
+using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
 using ::aidl::android::hardware::automotive::vehicle::StatusCode;
 using ::aidl::android::hardware::automotive::vehicle::SubscribeOptions;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropError;
@@ -54,6 +56,42 @@ SubscribeOptions newSubscribeOptions(int32_t propId, int32_t areaId, float sampl
     return subscribedOptions;
 }
 
+// Overwrites {@code last} with {@code value} and returns whether they were different. The values
+// are compared and copied in the same branch-free pass so that it could be auto-vectorized.
+template <typename T>
+bool assignIfChanged(const std::vector<T>& value, std::vector<T>* last) {
+    if (value.size() != last->size()) {
+        *last = value;
+        return true;
+    }
+    const T* in = value.data();
+    T* out = last->data();
+    bool changed = false;
+    for (size_t i = 0; i < value.size(); i++) {
+        changed |= (in[i] != out[i]);
+        out[i] = in[i];
+    }
+    return changed;
+}
+
+bool assignIfChanged(const std::string& value, std::string* last) {
+    if (value == *last) {
+        return false;
+    }
+    *last = value;
+    return true;
+}
+
+// Overwrites {@code last} with {@code value} and returns whether they were different.
+bool assignIfChanged(const RawPropValues& value, RawPropValues* last) {
+    // Use bitwise or so that every array is always copied.
+    return assignIfChanged(value.int32Values, &last->int32Values) |
+           assignIfChanged(value.floatValues, &last->floatValues) |
+           assignIfChanged(value.int64Values, &last->int64Values) |
+           assignIfChanged(value.byteValues, &last->byteValues) |
+           assignIfChanged(value.stringValue, &last->stringValue);
+}
+
 }  // namespace
 
 SubscriptionManager::SubscriptionManager(IVehicleHardware* vehicleHardware)
@@ -64,6 +102,8 @@ SubscriptionManager::~SubscriptionManager() {
 
     mClientsByPropIdAreaId.clear();
     mSubscribedPropsByClient.clear();
+    mSubscribersByPropIdAreaId.clear();
+    mSharedMemoryPoolByClient.clear();
 }
 
 bool SubscriptionManager::checkSampleRateHz(float sampleRateHz) {
@@ -305,6 +345,7 @@ VhalResult<void> SubscriptionManager::subscribe(const std::shared_ptr<IVehicleCa
 
             mSubscribedPropsByClient[clientId].insert(propIdAreaId);
             mClientsByPropIdAreaId[propIdAreaId][clientId] = callback;
+            refreshSubscribersLocked(propIdAreaId);
         }
     }
     return {};
@@ -336,9 +377,68 @@ VhalResult<void> SubscriptionManager::unsubscribePropIdAreaIdLocked(
         mClientsByPropIdAreaId.erase(propIdAreaId);
         mContSubConfigsByPropIdArea.erase(propIdAreaId);
     }
+    refreshSubscribersLocked(propIdAreaId);
     return {};
 }
 
+void SubscriptionManager::refreshSubscribersLocked(const PropIdAreaId& propIdAreaId) {
+    auto clientsIt = mClientsByPropIdAreaId.find(propIdAreaId);
+    if (clientsIt == mClientsByPropIdAreaId.end()) {
+        mSubscribersByPropIdAreaId.erase(propIdAreaId);
+        return;
+    }
+
+    const ContSubConfigs* subConfigs = nullptr;
+    if (auto configsIt = mContSubConfigsByPropIdArea.find(propIdAreaId);
+        configsIt != mContSubConfigsByPropIdArea.end()) {
+        subConfigs = &configsIt->second;
+    }
+    Subscribers& subscribers = mSubscribersByPropIdAreaId[propIdAreaId];
+    Subscribers newSubscribers;
+    newSubscribers.subscribers.reserve(clientsIt->second.size());
+    for (const auto& [clientId, callback] : clientsIt->second) {
+        Subscriber subscriber = {
+                .clientId = clientId,
+                .callback = callback,
+                .resolution = 0.0f,
+                .filterByVur = false,
+                .resolutionIndex = 0,
+                .lastForResolution = false,
+        };
+        if (subConfigs != nullptr) {
+            subscriber.resolution = subConfigs->getResolutionForClient(clientId);
+            // If client wants VUR (and VUR is supported as checked in DefaultVehicleHal), it is
+            // possible that VUR is not enabled in IVehicleHardware because another client does
+            // not enable VUR. We will implement VUR filtering here for the client that enables
+            // it.
+            subscriber.filterByVur =
+                    subConfigs->isVurEnabledForClient(clientId) && !subConfigs->isVurEnabled();
+        }
+        auto& resolutions = newSubscribers.resolutions;
+        subscriber.resolutionIndex =
+                std::find(resolutions.begin(), resolutions.end(), subscriber.resolution) -
+                resolutions.begin();
+        if (subscriber.resolutionIndex == resolutions.size()) {
+            resolutions.push_back(subscriber.resolution);
+        }
+        // Keep the last sent value for the existing subscriber.
+        for (Subscriber& oldSubscriber : subscribers.subscribers) {
+            if (oldSubscriber.clientId == clientId) {
+                subscriber.lastValue = std::move(oldSubscriber.lastValue);
+                break;
+            }
+        }
+        newSubscribers.subscribers.push_back(std::move(subscriber));
+    }
+    std::vector<bool> resolutionUsed(newSubscribers.resolutions.size(), false);
+    for (auto it = newSubscribers.subscribers.rbegin(); it != newSubscribers.subscribers.rend();
+         it++) {
+        it->lastForResolution = !resolutionUsed[it->resolutionIndex];
+        resolutionUsed[it->resolutionIndex] = true;
+    }
+    subscribers = std::move(newSubscribers);
+}
+
 VhalResult<void> SubscriptionManager::unsubscribe(SubscriptionManager::ClientIdType clientId,
                                                   const std::vector<int32_t>& propIds) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
@@ -369,6 +469,7 @@ VhalResult<void> SubscriptionManager::unsubscribe(SubscriptionManager::ClientIdT
 
     if (subscribedPropIdsAreaIds.empty()) {
         mSubscribedPropsByClient.erase(clientId);
+        mSharedMemoryPoolByClient.erase(clientId);
     }
     return {};
 }
@@ -387,67 +488,81 @@ VhalResult<void> SubscriptionManager::unsubscribe(SubscriptionManager::ClientIdT
         }
     }
     mSubscribedPropsByClient.erase(clientId);
+    mSharedMemoryPoolByClient.erase(clientId);
     return {};
 }
 
-bool SubscriptionManager::isValueUpdatedLocked(const std::shared_ptr<IVehicleCallback>& callback,
-                                               const VehiclePropValue& value) {
-    const auto& it = mContSubValuesByCallback[callback].find(value);
-    if (it == mContSubValuesByCallback[callback].end()) {
-        mContSubValuesByCallback[callback].insert(value);
+bool SubscriptionManager::isValueUpdated(Subscriber* subscriber, const VehiclePropValue& value,
+                                         const RawPropValues& sanitizedValue) {
+    LastValue& lastValue = subscriber->lastValue;
+    if (!lastValue.hasValue) {
+        lastValue.hasValue = true;
+        lastValue.timestamp = value.timestamp;
+        lastValue.status = value.status;
+        lastValue.value = sanitizedValue;
         return true;
     }
 
-    if (it->timestamp > value.timestamp) {
+    if (lastValue.timestamp > value.timestamp) {
         ALOGE("The updated property value: %s is outdated, ignored", value.toString().c_str());
         return false;
     }
 
-    if (it->value == value.value && it->status == value.status) {
-        // Even though the property value is the same, we need to store the new property event to
-        // update the timestamp.
-        mContSubValuesByCallback[callback].insert(value);
+    // Even though the property value is the same, we need to store the new property event to
+    // update the timestamp.
+    bool changed = assignIfChanged(sanitizedValue, &lastValue.value);
+    changed |= (lastValue.status != value.status);
+    lastValue.timestamp = value.timestamp;
+    lastValue.status = value.status;
+    if (!changed) {
         ALOGD("The updated property value for propId: %" PRId32 ", areaId: %" PRId32
               " has the "
               "same value and status, ignored if VUR is enabled",
-              it->prop, it->areaId);
-        return false;
+              value.prop, value.areaId);
     }
-
-    mContSubValuesByCallback[callback].insert(value);
-    return true;
+    return changed;
 }
 
 std::unordered_map<std::shared_ptr<IVehicleCallback>, std::vector<VehiclePropValue>>
 SubscriptionManager::getSubscribedClients(std::vector<VehiclePropValue>&& updatedValues) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
     std::unordered_map<std::shared_ptr<IVehicleCallback>, std::vector<VehiclePropValue>> clients;
+    // The values sanitized by each resolution for the current property event. The arrays are
+    // reused across events unless they are moved to a client.
+    std::vector<RawPropValues> sanitizedValues;
 
     for (auto& value : updatedValues) {
         PropIdAreaId propIdAreaId{
                 .propId = value.prop,
                 .areaId = value.areaId,
         };
-        if (mClientsByPropIdAreaId.find(propIdAreaId) == mClientsByPropIdAreaId.end()) {
+        auto it = mSubscribersByPropIdAreaId.find(propIdAreaId);
+        if (it == mSubscribersByPropIdAreaId.end()) {
             continue;
         }
 
-        for (const auto& [client, callback] : mClientsByPropIdAreaId[propIdAreaId]) {
-            auto& subConfigs = mContSubConfigsByPropIdArea[propIdAreaId];
-            // Clients must be sent different VehiclePropValues with different levels of granularity
-            // as requested by the client using resolution.
-            VehiclePropValue newValue = value;
-            sanitizeByResolution(&(newValue.value), subConfigs.getResolutionForClient(client));
-            // If client wants VUR (and VUR is supported as checked in DefaultVehicleHal), it is
-            // possible that VUR is not enabled in IVehicleHardware because another client does not
-            // enable VUR. We will implement VUR filtering here for the client that enables it.
-            if (subConfigs.isVurEnabledForClient(client) && !subConfigs.isVurEnabled()) {
-                if (isValueUpdatedLocked(callback, newValue)) {
-                    clients[callback].push_back(newValue);
-                }
-            } else {
-                clients[callback].push_back(newValue);
+        // Clients must be sent different VehiclePropValues with different levels of granularity
+        // as requested by the client using resolution. Each value is only rounded once for each
+        // distinct resolution.
+        Subscribers& subscribers = it->second;
+        sanitizedValues.resize(subscribers.resolutions.size());
+        for (size_t i = 0; i < subscribers.resolutions.size(); i++) {
+            sanitizeByResolution(value.value, subscribers.resolutions[i], &sanitizedValues[i]);
+        }
+
+        for (Subscriber& subscriber : subscribers.subscribers) {
+            RawPropValues& sanitizedValue = sanitizedValues[subscriber.resolutionIndex];
+            if (subscriber.filterByVur && !isValueUpdated(&subscriber, value, sanitizedValue)) {
+                continue;
             }
+            clients[subscriber.callback].push_back({
+                    .timestamp = value.timestamp,
+                    .areaId = value.areaId,
+                    .prop = value.prop,
+                    .status = value.status,
+                    .value = subscriber.lastForResolution ? std::move(sanitizedValue)
+                                                          : sanitizedValue,
+            });
         }
     }
     return clients;
@@ -464,12 +579,13 @@ SubscriptionManager::getSubscribedClientsForErrorEvents(
                 .propId = errorEvent.propId,
                 .areaId = errorEvent.areaId,
         };
-        if (mClientsByPropIdAreaId.find(propIdAreaId) == mClientsByPropIdAreaId.end()) {
+        auto it = mSubscribersByPropIdAreaId.find(propIdAreaId);
+        if (it == mSubscribersByPropIdAreaId.end()) {
             continue;
         }
 
-        for (const auto& [_, client] : mClientsByPropIdAreaId[propIdAreaId]) {
-            clients[client].push_back({
+        for (const Subscriber& subscriber : it->second.subscribers) {
+            clients[subscriber.callback].push_back({
                     .propId = errorEvent.propId,
                     .areaId = errorEvent.areaId,
                     .errorCode = errorEvent.errorCode,
@@ -481,7 +597,8 @@ SubscriptionManager::getSubscribedClientsForErrorEvents(
 
 bool SubscriptionManager::isEmpty() {
     std::scoped_lock<std::mutex> lockGuard(mLock);
-    return mSubscribedPropsByClient.empty() && mClientsByPropIdAreaId.empty();
+    return mSubscribedPropsByClient.empty() && mClientsByPropIdAreaId.empty() &&
+           mSubscribersByPropIdAreaId.empty();
 }
 
 size_t SubscriptionManager::countClients() {
@@ -489,6 +606,31 @@ size_t SubscriptionManager::countClients() {
     return mSubscribedPropsByClient.size();
 }
 
+void SubscriptionManager::setMaxSharedMemoryFileCount(SubscriptionManager::ClientIdType clientId,
+                                                      int32_t maxSharedMemoryFileCount) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    if (mSubscribedPropsByClient.find(clientId) == mSubscribedPropsByClient.end()) {
+        return;
+    }
+    auto it = mSharedMemoryPoolByClient.find(clientId);
+    if (it == mSharedMemoryPoolByClient.end()) {
+        mSharedMemoryPoolByClient[clientId] =
+                std::make_shared<SharedMemoryPool>(maxSharedMemoryFileCount);
+        return;
+    }
+    it->second->setMaxFileCount(maxSharedMemoryFileCount);
+}
+
+std::shared_ptr<SharedMemoryPool> SubscriptionManager::getSharedMemoryPool(
+        SubscriptionManager::ClientIdType clientId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    auto it = mSharedMemoryPoolByClient.find(clientId);
+    if (it == mSharedMemoryPoolByClient.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
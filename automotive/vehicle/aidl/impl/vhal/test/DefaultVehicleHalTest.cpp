@@ -437,6 +437,8 @@ class DefaultVehicleHalTest : public testing::Test {
 
     size_t countPendingRequests() { return mVhal->mPendingRequestPool->countPendingRequests(); }
 
+    PropertyLatencyStats* getLatencyStats() { return mVhal->mPropertyLatencyStats.get(); }
+
     size_t countClients() {
         std::scoped_lock<std::mutex> lockGuard(mVhal->mLock);
         return mVhal->mGetValuesClients.size() + mVhal->mSetValuesClients.size() +
@@ -684,6 +686,62 @@ TEST_F(DefaultVehicleHalTest, testGetPropConfigsInvalidArg) {
     ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
 }
 
+TEST_F(DefaultVehicleHalTest, testGetPropConfigsAfterRefresh) {
+    int32_t propId1 = testInt32VecProp(1);
+    int32_t propId2 = testInt32VecProp(2);
+    auto hardware = std::make_unique<MockVehicleHardware>();
+    MockVehicleHardware* hardwarePtr = hardware.get();
+    hardware->setPropertyConfigs({
+            VehiclePropConfig{
+                    .prop = propId1,
+                    .access = VehiclePropertyAccess::READ,
+            },
+    });
+    auto vhal = ndk::SharedRefBase::make<DefaultVehicleHal>(std::move(hardware));
+    std::shared_ptr<IVehicle> client = IVehicle::fromBinder(vhal->asBinder());
+
+    // Request the same configs twice so that the second one is served from the cache.
+    for (int i = 0; i < 2; i++) {
+        VehiclePropConfigs output;
+        auto status = client->getPropConfigs(std::vector<int32_t>({propId1}), &output);
+
+        ASSERT_TRUE(status.isOk()) << "getPropConfigs failed: " << status.getMessage();
+        ASSERT_EQ(output.payloads.size(), 1u);
+        ASSERT_EQ(output.payloads[0].access, VehiclePropertyAccess::READ);
+    }
+
+    auto newConfigs = std::vector<VehiclePropConfig>({
+            VehiclePropConfig{
+                    .prop = propId1,
+                    .access = VehiclePropertyAccess::READ_WRITE,
+            },
+            VehiclePropConfig{
+                    .prop = propId2,
+            },
+    });
+    hardwarePtr->setPropertyConfigs(newConfigs);
+    hardwarePtr->setDumpResult({
+            .callerShouldDumpState = false,
+            .buffer = "",
+            .refreshPropertyConfigs = true,
+    });
+    int fd = memfd_create("memfile", 0);
+    vhal->dump(fd, nullptr, 0);
+    close(fd);
+
+    VehiclePropConfigs output;
+    auto status = client->getPropConfigs(std::vector<int32_t>({propId1, propId2}), &output);
+
+    ASSERT_TRUE(status.isOk()) << "getPropConfigs failed: " << status.getMessage();
+    ASSERT_EQ(output.payloads, newConfigs);
+
+    status = client->getPropConfigs(std::vector<int32_t>({propId1}), &output);
+
+    ASSERT_TRUE(status.isOk()) << "getPropConfigs failed: " << status.getMessage();
+    ASSERT_EQ(output.payloads.size(), 1u);
+    ASSERT_EQ(output.payloads[0].access, VehiclePropertyAccess::READ_WRITE);
+}
+
 TEST_F(DefaultVehicleHalTest, testGetValuesSmall) {
     GetValueRequests requests;
     std::vector<GetValueResult> expectedResults;
@@ -706,6 +764,29 @@ TEST_F(DefaultVehicleHalTest, testGetValuesSmall) {
     EXPECT_EQ(countClients(), static_cast<size_t>(1));
 }
 
+TEST_F(DefaultVehicleHalTest, testGetValuesRecordsLatency) {
+    GetValueRequests requests;
+    std::vector<GetValueResult> expectedResults;
+    std::vector<GetValueRequest> expectedHardwareRequests;
+
+    ASSERT_TRUE(getValuesTestCases(10, requests, expectedResults, expectedHardwareRequests).ok());
+
+    getHardware()->addGetValueResponses(expectedResults);
+
+    auto status = getClient()->getValues(getCallbackClient(), requests);
+
+    ASSERT_TRUE(status.isOk()) << "getValues failed: " << status.getMessage();
+    ASSERT_TRUE(getCallback()->nextGetValueResults().has_value()) << "no results in callback";
+    for (const auto& request : expectedHardwareRequests) {
+        EXPECT_EQ(getLatencyStats()->getCount(PropertyLatencyStats::LatencyType::GET_VALUES,
+                                              request.prop.prop),
+                  1u);
+        EXPECT_EQ(getLatencyStats()->getCount(PropertyLatencyStats::LatencyType::SET_VALUES,
+                                              request.prop.prop),
+                  0u);
+    }
+}
+
 TEST_F(DefaultVehicleHalTest, testGetValuesLarge) {
     GetValueRequests requests;
     std::vector<GetValueResult> expectedResults;
@@ -1018,6 +1099,26 @@ TEST_F(DefaultVehicleHalTest, testSetValuesSmall) {
     EXPECT_EQ(countClients(), static_cast<size_t>(1));
 }
 
+TEST_F(DefaultVehicleHalTest, testSetValuesRecordsLatency) {
+    SetValueRequests requests;
+    std::vector<SetValueResult> expectedResults;
+    std::vector<SetValueRequest> expectedHardwareRequests;
+
+    ASSERT_TRUE(setValuesTestCases(10, requests, expectedResults, expectedHardwareRequests).ok());
+
+    getHardware()->addSetValueResponses(expectedResults);
+
+    auto status = getClient()->setValues(getCallbackClient(), requests);
+
+    ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+    ASSERT_TRUE(getCallback()->nextSetValueResults().has_value()) << "no results in callback";
+    for (const auto& request : expectedHardwareRequests) {
+        EXPECT_EQ(getLatencyStats()->getCount(PropertyLatencyStats::LatencyType::SET_VALUES,
+                                              request.value.prop),
+                  1u);
+    }
+}
+
 TEST_F(DefaultVehicleHalTest, testSetValuesLarge) {
     SetValueRequests requests;
     std::vector<SetValueResult> expectedResults;
@@ -1301,6 +1402,48 @@ TEST_F(DefaultVehicleHalTest, testSubscribeGlobalOnChangeNormal) {
             << "expect 2 clients, 1 subscribe client and 1 setvalue client";
 }
 
+TEST_F(DefaultVehicleHalTest, testSubscribeRecordsPropertyEventLatency) {
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+    };
+
+    auto status = getClient()->subscribe(getCallbackClient(), options, 0);
+
+    ASSERT_TRUE(status.isOk()) << "subscribe failed: " << status.getMessage();
+
+    VehiclePropValue testValue{
+            .timestamp = elapsedRealtimeNano(),
+            .prop = GLOBAL_ON_CHANGE_PROP,
+            .value.int32Values = {0},
+    };
+    SetValueRequests setValueRequests = {
+            .payloads =
+                    {
+                            SetValueRequest{
+                                    .requestId = 0,
+                                    .value = testValue,
+                            },
+                    },
+    };
+    std::vector<SetValueResult> setValueResults = {{
+            .requestId = 0,
+            .status = StatusCode::OK,
+    }};
+
+    // Set the value to trigger a property change event.
+    getHardware()->addSetValueResponses(setValueResults);
+    status = getClient()->setValues(getCallbackClient(), setValueRequests);
+
+    ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+    ASSERT_TRUE(getCallback()->nextOnPropertyEventResults().has_value())
+            << "no results in callback";
+    EXPECT_EQ(getLatencyStats()->getCount(PropertyLatencyStats::LatencyType::PROPERTY_EVENT,
+                                          GLOBAL_ON_CHANGE_PROP),
+              1u);
+}
+
 TEST_F(DefaultVehicleHalTest, testSubscribeGlobalOnchangeUnrelatedEventIgnored) {
     std::vector<SubscribeOptions> options = {
             {
@@ -1777,6 +1920,43 @@ TEST_F(DefaultVehicleHalTest, testUnsubscribeFailure) {
     ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
 }
 
+TEST_F(DefaultVehicleHalTest, testSubscribeNegativeMaxSharedMemoryFileCount) {
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+    };
+
+    auto status = getClient()->subscribe(getCallbackClient(), options, -1);
+
+    ASSERT_FALSE(status.isOk()) << "subscribe with negative maxSharedMemoryFileCount must fail";
+    ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
+}
+
+TEST_F(DefaultVehicleHalTest, testReturnSharedMemoryNotSubscribed) {
+    auto status = getClient()->returnSharedMemory(getCallbackClient(), 1);
+
+    ASSERT_FALSE(status.isOk()) << "returnSharedMemory for a not-subscribed client must fail";
+    ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
+}
+
+TEST_F(DefaultVehicleHalTest, testReturnSharedMemoryInvalidId) {
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+    };
+
+    auto status = getClient()->subscribe(getCallbackClient(), options, 2);
+
+    ASSERT_TRUE(status.isOk()) << "subscribe failed: " << status.getMessage();
+
+    status = getClient()->returnSharedMemory(getCallbackClient(), 1);
+
+    ASSERT_FALSE(status.isOk()) << "returnSharedMemory for an unknown shared memory ID must fail";
+    ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
+}
+
 TEST_F(DefaultVehicleHalTest, testHeartbeatEvent) {
     std::vector<SubscribeOptions> options = {{
             .propId = toInt(VehicleProperty::VHAL_HEARTBEAT),
@@ -1913,6 +2093,36 @@ TEST_F(DefaultVehicleHalTest, testDumpCallerShouldNotDump) {
     ASSERT_EQ(msg.find("Vehicle HAL State: "), std::string::npos);
 }
 
+TEST_F(DefaultVehicleHalTest, testDumpStats) {
+    GetValueRequests requests;
+    std::vector<GetValueResult> expectedResults;
+    std::vector<GetValueRequest> expectedHardwareRequests;
+
+    ASSERT_TRUE(getValuesTestCases(1, requests, expectedResults, expectedHardwareRequests).ok());
+    getHardware()->addGetValueResponses(expectedResults);
+    ASSERT_TRUE(getClient()->getValues(getCallbackClient(), requests).isOk());
+
+    std::string buffer = "Dump from hardware";
+    getHardware()->setDumpResult({
+            .callerShouldDumpState = true,
+            .buffer = buffer,
+    });
+    int fd = memfd_create("memfile", 0);
+    const char* args[] = {"--stats"};
+    getClient()->dump(fd, args, 1);
+
+    lseek(fd, 0, SEEK_SET);
+    char buf[10240] = {};
+    read(fd, buf, sizeof(buf));
+    close(fd);
+
+    std::string msg(buf);
+
+    ASSERT_THAT(msg, ContainsRegex("Per-property latency stats"));
+    ASSERT_THAT(msg, ContainsRegex("getValues: total: 1, timeout: 0"));
+    ASSERT_EQ(msg.find(buffer), std::string::npos) << "hardware must not handle --stats";
+}
+
 TEST_F(DefaultVehicleHalTest, testOnPropertySetErrorEvent) {
     std::vector<SubscribeOptions> options = {
             {
@@ -2056,6 +2266,105 @@ TEST_F(DefaultVehicleHalTest, testBatchOnPropertyChangeEvents) {
     }
 }
 
+TEST_F(DefaultVehicleHalTest, testBatchOnPropertyChangeEvents_flushOnMaxSize) {
+    auto hardware = std::make_unique<MockVehicleHardware>();
+    // Use a long batching window so that only reaching the max batch size flushes the events.
+    hardware->setPropertyOnChangeEventBatchingWindow(std::chrono::seconds(10));
+    hardware->setPropertyOnChangeEventBatchMaxSize(3);
+    init(std::move(hardware));
+
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+            {
+                    .propId = AREA_ON_CHANGE_PROP,
+                    // No areaIds means subscribing to all area IDs.
+                    .areaIds = {},
+            },
+    };
+    getClient()->subscribe(getCallbackClient(), options, 0);
+
+    VehiclePropValue testValue1 = {
+            .prop = GLOBAL_ON_CHANGE_PROP,
+            .value.int32Values = {0},
+    };
+    VehiclePropValue testValue2 = {
+            .prop = AREA_ON_CHANGE_PROP,
+            .areaId = toInt(VehicleAreaWindow::ROW_1_LEFT),
+            .value.int32Values = {1},
+    };
+    VehiclePropValue testValue3 = {
+            .prop = AREA_ON_CHANGE_PROP,
+            .areaId = toInt(VehicleAreaWindow::ROW_1_RIGHT),
+            .value.int32Values = {1},
+    };
+    getHardware()->addSetValueResponses({{
+            .requestId = 1,
+            .status = StatusCode::OK,
+    }});
+    getHardware()->addSetValueResponses({{.requestId = 2, .status = StatusCode::OK},
+                                         {.requestId = 3, .status = StatusCode::ACCESS_DENIED}});
+
+    // Causes three property change events in total.
+    auto status = getClient()->setValues(
+            getCallbackClient(),
+            SetValueRequests{.payloads = {{.requestId = 1, .value = testValue1}}});
+    ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+    status = getClient()->setValues(getCallbackClient(),
+                                    SetValueRequests{.payloads = {
+                                                             {.requestId = 2, .value = testValue2},
+                                                             {.requestId = 3, .value = testValue3},
+                                                     }});
+    ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+
+    ASSERT_TRUE(getCallback()->waitForOnPropertyEventResults(/*size=*/1,
+                                                             /*timeoutInNano=*/1'000'000'000))
+            << "events must be delivered once the max batch size is reached";
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value()) << "no results in callback";
+    ASSERT_THAT(maybeResults.value().payloads, UnorderedElementsAre(testValue1, testValue2))
+            << "results mismatch, expect 2 batched on change events";
+}
+
+TEST_F(DefaultVehicleHalTest, testBatchOnPropertyChangeEvents_latencyCriticalNotBatched) {
+    auto hardware = std::make_unique<MockVehicleHardware>();
+    // Use a long batching window so that batched events would not arrive before timeout.
+    hardware->setPropertyOnChangeEventBatchingWindow(std::chrono::seconds(10));
+    hardware->setLatencyCriticalPropIds({GLOBAL_ON_CHANGE_PROP});
+    init(std::move(hardware));
+
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+    };
+    getClient()->subscribe(getCallbackClient(), options, 0);
+
+    VehiclePropValue testValue = {
+            .prop = GLOBAL_ON_CHANGE_PROP,
+            .value.int32Values = {0},
+    };
+    getHardware()->addSetValueResponses({{
+            .requestId = 1,
+            .status = StatusCode::OK,
+    }});
+
+    auto status = getClient()->setValues(
+            getCallbackClient(),
+            SetValueRequests{.payloads = {{.requestId = 1, .value = testValue}}});
+    ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+
+    ASSERT_TRUE(getCallback()->waitForOnPropertyEventResults(/*size=*/1,
+                                                             /*timeoutInNano=*/1'000'000'000))
+            << "latency critical events must not be batched";
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value()) << "no results in callback";
+    ASSERT_THAT(maybeResults.value().payloads, UnorderedElementsAre(testValue));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -261,6 +261,26 @@ std::chrono::nanoseconds MockVehicleHardware::getPropertyOnChangeEventBatchingWi
     return mEventBatchingWindow;
 }
 
+void MockVehicleHardware::setPropertyOnChangeEventBatchMaxSize(size_t maxSize) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mEventBatchMaxSize = maxSize;
+}
+
+size_t MockVehicleHardware::getPropertyOnChangeEventBatchMaxSize() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    return mEventBatchMaxSize;
+}
+
+void MockVehicleHardware::setLatencyCriticalPropIds(const std::unordered_set<int32_t>& propIds) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mLatencyCriticalPropIds = propIds;
+}
+
+std::unordered_set<int32_t> MockVehicleHardware::getLatencyCriticalPropIds() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    return mLatencyCriticalPropIds;
+}
+
 template <class ResultType>
 StatusCode MockVehicleHardware::returnResponse(
         std::shared_ptr<const std::function<void(std::vector<ResultType>)>> callback,
@@ -32,6 +32,7 @@
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -65,6 +66,8 @@ class MockVehicleHardware final : public IVehicleHardware {
     aidl::android::hardware::automotive::vehicle::StatusCode unsubscribe(int32_t propId,
                                                                          int32_t areaId) override;
     std::chrono::nanoseconds getPropertyOnChangeEventBatchingWindow() override;
+    size_t getPropertyOnChangeEventBatchMaxSize() override;
+    std::unordered_set<int32_t> getLatencyCriticalPropIds() override;
 
     // Test functions.
     void setPropertyConfigs(
@@ -92,6 +95,8 @@ class MockVehicleHardware final : public IVehicleHardware {
     void setDumpResult(DumpResult result);
     void sendOnPropertySetErrorEvent(const std::vector<SetValueErrorEvent>& errorEvents);
     void setPropertyOnChangeEventBatchingWindow(std::chrono::nanoseconds window);
+    void setPropertyOnChangeEventBatchMaxSize(size_t maxSize);
+    void setLatencyCriticalPropIds(const std::unordered_set<int32_t>& propIds);
 
     std::set<std::pair<int32_t, int32_t>> getSubscribedOnChangePropIdAreaIds();
     std::set<std::pair<int32_t, int32_t>> getSubscribedContinuousPropIdAreaIds();
@@ -123,6 +128,8 @@ class MockVehicleHardware final : public IVehicleHardware {
             const std::vector<aidl::android::hardware::automotive::vehicle::GetValueRequest>&)>
             mGetValueResponder GUARDED_BY(mLock);
     std::chrono::nanoseconds mEventBatchingWindow GUARDED_BY(mLock) = std::chrono::nanoseconds(0);
+    size_t mEventBatchMaxSize GUARDED_BY(mLock) = 0;
+    std::unordered_set<int32_t> mLatencyCriticalPropIds GUARDED_BY(mLock);
     std::set<std::pair<int32_t, int32_t>> mSubOnChangePropIdAreaIds GUARDED_BY(mLock);
     std::vector<aidl::android::hardware::automotive::vehicle::SubscribeOptions> mSubscribeOptions
             GUARDED_BY(mLock);
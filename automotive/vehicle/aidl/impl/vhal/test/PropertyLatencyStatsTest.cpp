@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PropertyLatencyStats.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <utils/SystemClock.h>
+
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+using ::testing::ContainsRegex;
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+using LatencyType = PropertyLatencyStats::LatencyType;
+
+constexpr int32_t TEST_PROP_ID_1 = 1;
+constexpr int32_t TEST_PROP_ID_2 = 2;
+
+TEST(PropertyLatencyStatsTest, testRecordLatency) {
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1, TEST_PROP_ID_2});
+
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 10'000);
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 20'000'000);
+    stats.recordLatency(LatencyType::PROPERTY_EVENT, TEST_PROP_ID_2, 10'000);
+
+    EXPECT_EQ(stats.getCount(LatencyType::GET_VALUES, TEST_PROP_ID_1), 2u);
+    EXPECT_EQ(stats.getCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 0u);
+    EXPECT_EQ(stats.getCount(LatencyType::PROPERTY_EVENT, TEST_PROP_ID_2), 1u);
+    EXPECT_EQ(stats.getTimeoutCount(LatencyType::GET_VALUES, TEST_PROP_ID_1), 0u);
+}
+
+TEST(PropertyLatencyStatsTest, testRecordTimeout) {
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1});
+
+    stats.recordTimeout(LatencyType::SET_VALUES, TEST_PROP_ID_1);
+
+    EXPECT_EQ(stats.getTimeoutCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 1u);
+    EXPECT_EQ(stats.getCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 0u);
+}
+
+TEST(PropertyLatencyStatsTest, testUnknownPropertyIgnored) {
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1});
+
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_2, 10'000);
+    stats.recordTimeout(LatencyType::GET_VALUES, TEST_PROP_ID_2);
+
+    EXPECT_EQ(stats.getCount(LatencyType::GET_VALUES, TEST_PROP_ID_2), 0u);
+    EXPECT_EQ(stats.getTimeoutCount(LatencyType::GET_VALUES, TEST_PROP_ID_2), 0u);
+}
+
+TEST(PropertyLatencyStatsTest, testSetPropIdsKeepsStats) {
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1, TEST_PROP_ID_2});
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 10'000);
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_2, 10'000);
+
+    stats.setPropIds({TEST_PROP_ID_1});
+
+    EXPECT_EQ(stats.getCount(LatencyType::GET_VALUES, TEST_PROP_ID_1), 1u);
+    EXPECT_EQ(stats.getCount(LatencyType::GET_VALUES, TEST_PROP_ID_2), 0u);
+}
+
+TEST(PropertyLatencyStatsTest, testRecordConcurrently) {
+    constexpr size_t THREAD_COUNT = 4;
+    constexpr size_t RECORD_COUNT = 1000;
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1});
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back([&stats] {
+            for (size_t j = 0; j < RECORD_COUNT; j++) {
+                stats.recordLatency(LatencyType::PROPERTY_EVENT, TEST_PROP_ID_1, j * 1'000);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(stats.getCount(LatencyType::PROPERTY_EVENT, TEST_PROP_ID_1),
+              THREAD_COUNT * RECORD_COUNT);
+}
+
+TEST(PropertyLatencyStatsTest, testDump) {
+    PropertyLatencyStats stats;
+    stats.setPropIds({TEST_PROP_ID_1, TEST_PROP_ID_2});
+
+    // 30us, 300us and 3ms.
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 30'000);
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 300'000);
+    stats.recordLatency(LatencyType::GET_VALUES, TEST_PROP_ID_1, 3'000'000);
+    stats.recordTimeout(LatencyType::GET_VALUES, TEST_PROP_ID_1);
+
+    std::string dump = stats.dump();
+
+    EXPECT_THAT(dump, ContainsRegex("\\(0x1\\) getValues: total: 3, timeout: 1, mean: 1110, "
+                                    "max: 3000, <=50: 1, <=100: 0, <=200: 0, <=500: 1, <=1000: 0, "
+                                    "<=2000: 0, <=5000: 1"));
+    // No stats for the property events or the other property.
+    EXPECT_THAT(dump, Not(HasSubstr("property event")));
+    EXPECT_THAT(dump, Not(HasSubstr("(0x2)")));
+}
+
+TEST(RequestLatencyTrackerTest, testRecordFinishedRequests) {
+    auto stats = std::make_shared<PropertyLatencyStats>();
+    stats->setPropIds({TEST_PROP_ID_1, TEST_PROP_ID_2});
+    RequestLatencyTracker tracker(stats, LatencyType::GET_VALUES);
+
+    std::vector<RequestLatencyTracker::Request> requests = {
+            {.requestId = 0, .propId = TEST_PROP_ID_1},
+            {.requestId = 1, .propId = TEST_PROP_ID_2},
+    };
+    tracker.onRequestsStarted(elapsedRealtimeNano(), requests);
+    tracker.onRequestsFinished({0});
+    // Finishing the same request again must not record again.
+    tracker.onRequestsFinished({0});
+
+    EXPECT_EQ(stats->getCount(LatencyType::GET_VALUES, TEST_PROP_ID_1), 1u);
+    EXPECT_EQ(stats->getCount(LatencyType::GET_VALUES, TEST_PROP_ID_2), 0u);
+}
+
+TEST(RequestLatencyTrackerTest, testRecordTimeoutRequests) {
+    auto stats = std::make_shared<PropertyLatencyStats>();
+    stats->setPropIds({TEST_PROP_ID_1});
+    RequestLatencyTracker tracker(stats, LatencyType::SET_VALUES);
+
+    tracker.onRequestsStarted(elapsedRealtimeNano(), {{.requestId = 0, .propId = TEST_PROP_ID_1}});
+    tracker.onRequestsTimeout({0});
+    // The result arrives after timeout.
+    tracker.onRequestsFinished({0});
+
+    EXPECT_EQ(stats->getTimeoutCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 1u);
+    EXPECT_EQ(stats->getCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 0u);
+}
+
+TEST(RequestLatencyTrackerTest, testCancelledRequestsNotRecorded) {
+    auto stats = std::make_shared<PropertyLatencyStats>();
+    stats->setPropIds({TEST_PROP_ID_1});
+    RequestLatencyTracker tracker(stats, LatencyType::SET_VALUES);
+
+    tracker.onRequestsStarted(elapsedRealtimeNano(), {{.requestId = 0, .propId = TEST_PROP_ID_1}});
+    tracker.onRequestsCancelled({0});
+    tracker.onRequestsFinished({0});
+    tracker.onRequestsTimeout({0});
+
+    EXPECT_EQ(stats->getTimeoutCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 0u);
+    EXPECT_EQ(stats->getCount(LatencyType::SET_VALUES, TEST_PROP_ID_1), 0u);
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedMemoryPool.h"
+
+#include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+using ::aidl::android::hardware::automotive::vehicle::IVehicle;
+using ::aidl::android::hardware::automotive::vehicle::StatusCode;
+
+TEST(SharedMemoryPoolTest, testObtainUntilExhausted) {
+    SharedMemoryPool pool(/*maxFileCount=*/2);
+
+    int64_t id1 = pool.obtain();
+    int64_t id2 = pool.obtain();
+
+    ASSERT_NE(id1, IVehicle::INVALID_MEMORY_ID);
+    ASSERT_NE(id2, IVehicle::INVALID_MEMORY_ID);
+    ASSERT_NE(id1, id2);
+    ASSERT_EQ(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(pool.getFileCount(), 2);
+    ASSERT_EQ(pool.countInUseFiles(), 2u);
+}
+
+TEST(SharedMemoryPoolTest, testZeroMaxFileCount) {
+    SharedMemoryPool pool(/*maxFileCount=*/0);
+
+    ASSERT_EQ(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(pool.getFileCount(), 0);
+}
+
+TEST(SharedMemoryPoolTest, testReturnSharedMemoryRecyclesId) {
+    SharedMemoryPool pool(/*maxFileCount=*/1);
+
+    int64_t id = pool.obtain();
+    ASSERT_EQ(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+
+    ASSERT_TRUE(pool.returnSharedMemory(id).ok());
+    ASSERT_EQ(pool.countInUseFiles(), 0u);
+    ASSERT_EQ(pool.getFileCount(), 1);
+    ASSERT_EQ(pool.obtain(), id);
+}
+
+TEST(SharedMemoryPoolTest, testReturnSharedMemoryInvalidId) {
+    SharedMemoryPool pool(/*maxFileCount=*/1);
+
+    auto result = pool.returnSharedMemory(IVehicle::INVALID_MEMORY_ID);
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), StatusCode::INVALID_ARG);
+
+    int64_t id = pool.obtain();
+    ASSERT_TRUE(pool.returnSharedMemory(id).ok());
+
+    // Returning the same ID twice is not allowed.
+    result = pool.returnSharedMemory(id);
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), StatusCode::INVALID_ARG);
+}
+
+TEST(SharedMemoryPoolTest, testRecycle) {
+    SharedMemoryPool pool(/*maxFileCount=*/1);
+
+    int64_t id = pool.obtain();
+    pool.recycle(id);
+
+    ASSERT_EQ(pool.countInUseFiles(), 0u);
+    ASSERT_EQ(pool.obtain(), id);
+}
+
+TEST(SharedMemoryPoolTest, testSetMaxFileCount) {
+    SharedMemoryPool pool(/*maxFileCount=*/2);
+
+    int64_t id1 = pool.obtain();
+    int64_t id2 = pool.obtain();
+    ASSERT_TRUE(pool.returnSharedMemory(id1).ok());
+
+    pool.setMaxFileCount(1);
+
+    // One file is still in use by the client, so the limit is reached.
+    ASSERT_EQ(pool.getFileCount(), 1);
+    ASSERT_EQ(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+
+    ASSERT_TRUE(pool.returnSharedMemory(id2).ok());
+    ASSERT_EQ(pool.obtain(), id2);
+
+    pool.setMaxFileCount(3);
+
+    ASSERT_NE(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+    ASSERT_NE(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(pool.obtain(), IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(pool.getFileCount(), 3);
+}
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -875,6 +875,151 @@ TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_timestampUpdated_filterO
             << "Must filter out outdated property events if VUR is enabled";
 }
 
+TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_keepLastValueOnSubscriptionChange) {
+    SpAIBinder binder1 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client1 = IVehicleCallback::fromBinder(binder1);
+    SpAIBinder binder2 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client2 = IVehicleCallback::fromBinder(binder2);
+    SpAIBinder binder3 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client3 = IVehicleCallback::fromBinder(binder3);
+    SubscribeOptions vurOption = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+            .enableVariableUpdateRate = true,
+    };
+    SubscribeOptions noVurOption = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+            .enableVariableUpdateRate = false,
+    };
+
+    auto result = getManager()->subscribe(client1, {vurOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    // Let client2 subscribe with VUR disabled so that we enabled VUR in DefaultVehicleHal layer.
+    result = getManager()->subscribe(client2, {noVurOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    VehiclePropValue value = {
+            .prop = 0,
+            .areaId = 0,
+            .value = {.int32Values = {0}},
+            .timestamp = 1,
+    };
+    auto clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_THAT(clients[client1], UnorderedElementsAre(value));
+
+    // The subscribers for the property change, the last value for client1 must be kept.
+    result = getManager()->subscribe(client3, {noVurOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    value.timestamp = 2;
+    clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_TRUE(clients.find(client1) == clients.end())
+            << "Must filter out duplicate property events if VUR is enabled";
+    ASSERT_THAT(clients[client2], UnorderedElementsAre(value));
+    ASSERT_THAT(clients[client3], UnorderedElementsAre(value));
+}
+
+TEST_F(SubscriptionManagerTest, testGetSubscribedClients_sameResolutionSharedByClients) {
+    SpAIBinder binder1 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client1 = IVehicleCallback::fromBinder(binder1);
+    SpAIBinder binder2 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client2 = IVehicleCallback::fromBinder(binder2);
+    SpAIBinder binder3 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client3 = IVehicleCallback::fromBinder(binder3);
+    SubscribeOptions option = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+            .resolution = 0.1,
+    };
+    SubscribeOptions noResolutionOption = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+    };
+
+    auto result = getManager()->subscribe(client1, {option}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    result = getManager()->subscribe(client2, {option}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    result = getManager()->subscribe(client3, {noResolutionOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    VehiclePropValue value = {
+            .prop = 0,
+            .areaId = 0,
+            .value = {.int32Values = {1, 12}, .floatValues = {1.04, 2.06, 3.0, 4.12}},
+            .timestamp = 1,
+    };
+    VehiclePropValue roundedValue = value;
+    sanitizeByResolution(&roundedValue.value, 0.1);
+    auto clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_THAT(clients[client1], ElementsAre(roundedValue));
+    ASSERT_THAT(clients[client2], ElementsAre(roundedValue));
+    ASSERT_THAT(clients[client3], ElementsAre(value));
+}
+
+TEST_F(SubscriptionManagerTest, testSubscribe_enableVur_filterUnchangedArrays) {
+    SpAIBinder binder1 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client1 = IVehicleCallback::fromBinder(binder1);
+    SpAIBinder binder2 = ndk::SharedRefBase::make<PropertyCallback>()->asBinder();
+    std::shared_ptr<IVehicleCallback> client2 = IVehicleCallback::fromBinder(binder2);
+    SubscribeOptions vurOption = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+            .enableVariableUpdateRate = true,
+    };
+    SubscribeOptions noVurOption = {
+            .propId = 0,
+            .areaIds = {0},
+            .sampleRate = 10.0,
+            .enableVariableUpdateRate = false,
+    };
+
+    auto result = getManager()->subscribe(client1, {vurOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    // Let client2 subscribe with VUR disabled so that we enabled VUR in DefaultVehicleHal layer.
+    result = getManager()->subscribe(client2, {noVurOption}, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    VehiclePropValue value = {
+            .prop = 0,
+            .areaId = 0,
+            .value = {.floatValues = {1.0, 2.0, 3.0, 4.0}},
+            .timestamp = 1,
+    };
+    auto clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_THAT(clients[client1], ElementsAre(value));
+
+    value.timestamp = 2;
+    clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_TRUE(clients.find(client1) == clients.end())
+            << "Must filter out duplicate property events if VUR is enabled";
+
+    value.timestamp = 3;
+    value.value.floatValues[3] = 5.0;
+    clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_THAT(clients[client1], ElementsAre(value))
+            << "Must not filter out property events if any element changes";
+
+    value.timestamp = 4;
+    value.value.floatValues.push_back(6.0);
+    clients = getManager()->getSubscribedClients({value});
+
+    ASSERT_THAT(clients[client1], ElementsAre(value))
+            << "Must not filter out property events if the array size changes";
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -92,7 +92,7 @@ CHANGE_MODE_CPP_HEADER = """#pragma once
 #include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
 #include <aidl/android/hardware/automotive/vehicle/VehiclePropertyChangeMode.h>
 
-#include <unordered_map>
+#include "VehiclePropertyAnnotationTable.h"
 
 namespace aidl {
 namespace android {
@@ -100,11 +100,11 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-std::unordered_map<VehicleProperty, VehiclePropertyChangeMode> ChangeModeForVehicleProperty = {
+inline constexpr auto ChangeModeForVehicleProperty = makeVehiclePropertyAnnotationTable<VehiclePropertyChangeMode>({
 """
 
 CPP_FOOTER = """
-};
+});
 
 }  // namespace vehicle
 }  // namespace automotive
@@ -118,7 +118,7 @@ ACCESS_CPP_HEADER = """#pragma once
 #include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
 #include <aidl/android/hardware/automotive/vehicle/VehiclePropertyAccess.h>
 
-#include <unordered_map>
+#include "VehiclePropertyAnnotationTable.h"
 
 namespace aidl {
 namespace android {
@@ -126,14 +126,14 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-std::unordered_map<VehicleProperty, VehiclePropertyAccess> AccessForVehicleProperty = {
+inline constexpr auto AccessForVehicleProperty = makeVehiclePropertyAnnotationTable<VehiclePropertyAccess>({
 """
 
 VERSION_CPP_HEADER = """#pragma once
 
 #include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
 
-#include <unordered_map>
+#include "VehiclePropertyAnnotationTable.h"
 
 namespace aidl {
 namespace android {
@@ -141,7 +141,7 @@ namespace hardware {
 namespace automotive {
 namespace vehicle {
 
-std::unordered_map<VehicleProperty, int32_t> VersionForVehicleProperty = {
+inline constexpr auto VersionForVehicleProperty = makeVehiclePropertyAnnotationTable<int32_t>({
 """
 
 CHANGE_MODE_JAVA_HEADER = """package android.hardware.automotive.vehicle;
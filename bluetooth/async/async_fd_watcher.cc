@@ -17,6 +17,9 @@
 #include "async_fd_watcher.h"
 
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #include <algorithm>
 #include <atomic>
@@ -28,10 +31,10 @@
 
 #include "fcntl.h"
 #include "log/log.h"
-#include "sys/select.h"
 #include "unistd.h"
 
 static const int INVALID_FD = -1;
+static const int kMaxEvents = 16;
 
 namespace android::hardware::bluetooth::async {
 
@@ -41,6 +44,9 @@ int AsyncFdWatcher::WatchFdForNonBlockingReads(
   {
     std::unique_lock<std::mutex> guard(internal_mutex_);
     watched_fds_[file_descriptor] = on_read_fd_ready_callback;
+    if (epoll_fd_ != INVALID_FD && addToEpollLocked(file_descriptor) != 0) {
+      return -1;
+    }
   }
 
   // Start the thread if not started yet
@@ -57,6 +63,7 @@ int AsyncFdWatcher::ConfigureTimeout(
     timeout_ms_ = timeout;
   }
 
+  // The thread re-arms the timer when it wakes up.
   notifyThread();
   return 0;
 }
@@ -70,12 +77,30 @@ AsyncFdWatcher::~AsyncFdWatcher() {}
 int AsyncFdWatcher::tryStartThread() {
   if (std::atomic_exchange(&running_, true)) return 0;
 
-  // Set up the communication channel
-  int pipe_fds[2];
-  if (pipe2(pipe_fds, O_NONBLOCK)) return -1;
+  {
+    std::unique_lock<std::mutex> guard(internal_mutex_);
 
-  notification_listen_fd_ = pipe_fds[0];
-  notification_write_fd_ = pipe_fds[1];
+    // Set up the communication channel and the timer.
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    notification_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd_ == INVALID_FD || notification_fd_ == INVALID_FD ||
+        timer_fd_ == INVALID_FD) {
+      return -1;
+    }
+
+    // Both are drained on every wakeup, so edge-triggered is enough.
+    for (int fd : {notification_fd_, timer_fd_}) {
+      struct epoll_event event = {};
+      event.events = EPOLLIN | EPOLLET;
+      event.data.fd = fd;
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) return -1;
+    }
+
+    for (auto& it : watched_fds_) {
+      if (addToEpollLocked(it.first) != 0) return -1;
+    }
+  }
 
   thread_ = std::thread([this]() { ThreadRoutine(); });
   if (!thread_.joinable()) return -1;
@@ -94,6 +119,11 @@ int AsyncFdWatcher::stopThread() {
   {
     std::unique_lock<std::mutex> guard(internal_mutex_);
     watched_fds_.clear();
+
+    for (int* fd : {&epoll_fd_, &notification_fd_, &timer_fd_}) {
+      if (*fd != INVALID_FD) close(*fd);
+      *fd = INVALID_FD;
+    }
   }
 
   {
@@ -101,48 +131,83 @@ int AsyncFdWatcher::stopThread() {
     timeout_cb_ = nullptr;
   }
 
-  close(notification_listen_fd_);
-  close(notification_write_fd_);
-
   return 0;
 }
 
 int AsyncFdWatcher::notifyThread() {
-  uint8_t buffer[] = {0};
-  if (TEMP_FAILURE_RETRY(write(notification_write_fd_, &buffer, 1)) < 0) {
+  uint64_t value = 1;
+  if (notification_fd_ == INVALID_FD ||
+      TEMP_FAILURE_RETRY(write(notification_fd_, &value, sizeof(value))) < 0) {
     return -1;
   }
   return 0;
 }
 
+int AsyncFdWatcher::addToEpollLocked(int file_descriptor) {
+  // Level-triggered: callbacks aren't required to drain the file descriptor.
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = file_descriptor;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, file_descriptor, &event) == 0 ||
+      errno == EEXIST) {
+    return 0;
+  }
+  ALOGE("%s: unable to watch fd %d (%s)", __func__, file_descriptor,
+        strerror(errno));
+  return -1;
+}
+
+void AsyncFdWatcher::armTimer(std::chrono::milliseconds timeout) {
+  // A zero timeout disarms the timer.
+  struct itimerspec spec = {};
+  spec.it_value.tv_sec = timeout.count() / 1000;
+  spec.it_value.tv_nsec = (timeout.count() % 1000) * 1000000;
+  timerfd_settime(timer_fd_, 0, &spec, nullptr);
+}
+
 void AsyncFdWatcher::ThreadRoutine() {
+  bool timer_armed = false;
   while (running_) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(notification_listen_fd_, &read_fds);
-    int max_read_fd = INVALID_FD;
-    for (auto& it : watched_fds_) {
-      FD_SET(it.first, &read_fds);
-      max_read_fd = std::max(max_read_fd, it.first);
+    // The timeout counts from the last wakeup, so the timer is re-armed every
+    // time.
+    std::chrono::milliseconds timeout;
+    {
+      std::unique_lock<std::mutex> guard(timeout_mutex_);
+      timeout = std::max(timeout_ms_, std::chrono::milliseconds(0));
     }
-
-    struct timeval timeout;
-    struct timeval* timeout_ptr = NULL;
-    if (timeout_ms_ > std::chrono::milliseconds(0)) {
-      timeout.tv_sec = timeout_ms_.count() / 1000;
-      timeout.tv_usec = (timeout_ms_.count() % 1000) * 1000;
-      timeout_ptr = &timeout;
+    if (timeout > std::chrono::milliseconds(0) || timer_armed) {
+      armTimer(timeout);
+      timer_armed = timeout > std::chrono::milliseconds(0);
     }
 
     // Wait until there is data available to read on some FD.
-    int nfds = std::max(notification_listen_fd_, max_read_fd);
-    int retval = select(nfds + 1, &read_fds, NULL, NULL, timeout_ptr);
+    struct epoll_event events[kMaxEvents];
+    int nevents = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
 
     // There was some error.
-    if (retval < 0) continue;
+    if (nevents < 0) continue;
+
+    bool notified = false;
+    bool timed_out = false;
+    int ready_fds = 0;
+    for (int i = 0; i < nevents; i++) {
+      int fd = events[i].data.fd;
+      if (fd == notification_fd_ || fd == timer_fd_) {
+        uint64_t value;
+        TEMP_FAILURE_RETRY(read(fd, &value, sizeof(value)));
+        if (fd == notification_fd_) {
+          notified = true;
+        } else {
+          timed_out = true;
+        }
+      } else {
+        events[ready_fds++] = events[i];
+      }
+    }
 
-    // Timeout.
-    if (retval == 0) {
+    // Timeout, only when nothing else happened.
+    if (timed_out && !notified && ready_fds == 0) {
+      timer_armed = false;
       // Allow the timeout callback to modify the timeout.
       TimeoutCallback saved_cb;
       {
@@ -153,20 +218,17 @@ void AsyncFdWatcher::ThreadRoutine() {
       continue;
     }
 
-    // Read data from the notification FD.
-    if (FD_ISSET(notification_listen_fd_, &read_fds)) {
-      char buffer[] = {0};
-      TEMP_FAILURE_RETRY(read(notification_listen_fd_, buffer, 1));
-      continue;
-    }
+    // Watched FDs are level-triggered and are reported again next time.
+    if (notified) continue;
 
     // Invoke the data ready callbacks if appropriate.
     {
       // Hold the mutex to make sure that the callbacks are still valid.
       std::unique_lock<std::mutex> guard(internal_mutex_);
-      for (auto& it : watched_fds_) {
-        if (FD_ISSET(it.first, &read_fds)) {
-          it.second(it.first);
+      for (int i = 0; i < ready_fds; i++) {
+        auto it = watched_fds_.find(events[i].data.fd);
+        if (it != watched_fds_.end()) {
+          it->second(it->first);
         }
       }
     }
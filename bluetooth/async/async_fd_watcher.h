@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <thread>
@@ -43,6 +46,10 @@ class AsyncFdWatcher {
   int tryStartThread();
   int stopThread();
   int notifyThread();
+  // Adds the watched file descriptor to the epoll set, internal_mutex_ must be
+  // held.
+  int addToEpollLocked(int file_descriptor);
+  void armTimer(std::chrono::milliseconds timeout);
   void ThreadRoutine();
 
   std::atomic_bool running_{false};
@@ -51,10 +58,13 @@ class AsyncFdWatcher {
   std::mutex timeout_mutex_;
 
   std::map<int, ReadCallback> watched_fds_;
-  int notification_listen_fd_;
-  int notification_write_fd_;
+  // Created by tryStartThread() and closed by stopThread(), under
+  // internal_mutex_.
+  int epoll_fd_ = -1;
+  int notification_fd_ = -1;
+  int timer_fd_ = -1;
   TimeoutCallback timeout_cb_;
-  std::chrono::milliseconds timeout_ms_;
+  std::chrono::milliseconds timeout_ms_{0};
 };
 
 }  // namespace android::hardware::bluetooth::async
@@ -24,6 +24,12 @@ namespace hardware {
 namespace bluetooth {
 namespace audio {
 
+/***
+ * The A2DP software data path. The provider only owns the data FMQ, which
+ * carries PCM between the audio HAL and the Bluetooth stack. The stack expects
+ * PCM on this queue for both session types, the codec encoding or decoding is
+ * done by the stack itself.
+ ***/
 class A2dpSoftwareAudioProvider : public BluetoothAudioProvider {
  public:
   A2dpSoftwareAudioProvider();
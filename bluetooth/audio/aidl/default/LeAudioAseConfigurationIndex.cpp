@@ -0,0 +1,603 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BTAudioProviderLeAudioHW"
+
+#include "LeAudioAseConfigurationIndex.h"
+
+#include <BluetoothAudioCodecs.h>
+#include <android-base/logging.h>
+
+#include <algorithm>
+#include <mutex>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace bluetooth {
+namespace audio {
+
+namespace {
+
+const std::map<CodecSpecificConfigurationLtv::SamplingFrequency, uint32_t>
+    freq_to_support_bitmask_map = {
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ8000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ8000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ11025,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ11025},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ16000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ16000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ22050,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ22050},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ24000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ24000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ32000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ32000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ48000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ48000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ88200,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ88200},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ96000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ96000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ176400,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ176400},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ192000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ192000},
+        {CodecSpecificConfigurationLtv::SamplingFrequency::HZ384000,
+         CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies::HZ384000},
+};
+
+const std::map<CodecSpecificConfigurationLtv::FrameDuration, uint32_t>
+    fduration_to_support_fduration_map = {
+        {CodecSpecificConfigurationLtv::FrameDuration::US7500,
+         CodecSpecificCapabilitiesLtv::SupportedFrameDurations::US7500},
+        {CodecSpecificConfigurationLtv::FrameDuration::US10000,
+         CodecSpecificCapabilitiesLtv::SupportedFrameDurations::US10000},
+};
+
+uint32_t getTagBit(CodecSpecificConfigurationLtv::Tag tag) {
+  const auto value = static_cast<uint32_t>(tag);
+  return value < 32 ? 1u << value : 0;
+}
+
+// The configuration tag that a capability is checked against.
+CodecSpecificConfigurationLtv::Tag getConfigurationTag(
+    CodecSpecificCapabilitiesLtv::Tag tag) {
+  switch (tag) {
+    case CodecSpecificCapabilitiesLtv::Tag::supportedSamplingFrequencies:
+      return CodecSpecificConfigurationLtv::Tag::samplingFrequency;
+    case CodecSpecificCapabilitiesLtv::Tag::supportedMaxCodecFramesPerSDU:
+      return CodecSpecificConfigurationLtv::Tag::codecFrameBlocksPerSDU;
+    case CodecSpecificCapabilitiesLtv::Tag::supportedFrameDurations:
+      return CodecSpecificConfigurationLtv::Tag::frameDuration;
+    case CodecSpecificCapabilitiesLtv::Tag::supportedAudioChannelCounts:
+      return CodecSpecificConfigurationLtv::Tag::audioChannelAllocation;
+    case CodecSpecificCapabilitiesLtv::Tag::supportedOctetsPerCodecFrame:
+      return CodecSpecificConfigurationLtv::Tag::octetsPerCodecFrame;
+  }
+  return CodecSpecificConfigurationLtv::Tag{};
+}
+
+}  // namespace
+
+uint32_t getSupportedSamplingFrequencyBit(
+    CodecSpecificConfigurationLtv::SamplingFrequency freq) {
+  auto it = freq_to_support_bitmask_map.find(freq);
+  return it != freq_to_support_bitmask_map.end() ? it->second : 0;
+}
+
+uint32_t getSupportedFrameDurationBit(
+    CodecSpecificConfigurationLtv::FrameDuration fduration) {
+  auto it = fduration_to_support_fduration_map.find(fduration);
+  return it != fduration_to_support_fduration_map.end() ? it->second : 0;
+}
+
+/***
+ *
+ * SettingSet
+ *
+ ***/
+
+LeAudioAseConfigurationIndex::SettingSet::SettingSet(size_t size, bool value)
+    : words_((size + 63) / 64, value ? ~0ULL : 0) {
+  if (value && size % 64 != 0) words_.back() = (1ULL << size % 64) - 1;
+}
+
+LeAudioAseConfigurationIndex::SettingSet&
+LeAudioAseConfigurationIndex::SettingSet::operator&=(const SettingSet& other) {
+  for (size_t i = 0; i < words_.size(); ++i) words_[i] &= other.words_[i];
+  return *this;
+}
+
+LeAudioAseConfigurationIndex::SettingSet&
+LeAudioAseConfigurationIndex::SettingSet::operator|=(const SettingSet& other) {
+  for (size_t i = 0; i < words_.size(); ++i) words_[i] |= other.words_[i];
+  return *this;
+}
+
+template <typename F>
+void LeAudioAseConfigurationIndex::SettingSet::forEach(F f) const {
+  for (size_t i = 0; i < words_.size(); ++i) {
+    for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+      if (!f(i * 64 + __builtin_ctzll(word))) return;
+    }
+  }
+}
+
+/***
+ *
+ * LeAudioAseConfigurationIndex
+ *
+ ***/
+
+// static
+std::shared_ptr<const LeAudioAseConfigurationIndex>
+LeAudioAseConfigurationIndex::get() {
+  static std::mutex mutex;
+  static std::shared_ptr<const LeAudioAseConfigurationIndex> index;
+  std::lock_guard<std::mutex> guard(mutex);
+  if (index == nullptr) {
+    auto settings = BluetoothAudioCodecs::GetLeAudioAseConfigurationSettings();
+    // Not cached, so that a failed load is retried on the next call.
+    if (settings.empty()) return nullptr;
+    index = std::make_shared<LeAudioAseConfigurationIndex>(std::move(settings));
+    LOG(INFO) << __func__ << ": Indexed " << index->settings_.size()
+              << " settings with " << index->codecs_.size() << " codecs";
+  }
+  return index;
+}
+
+LeAudioAseConfigurationIndex::LeAudioAseConfigurationIndex(
+    std::vector<LeAudioAseConfigurationSetting> settings)
+    : settings_(std::move(settings)) {
+  const size_t count = settings_.size();
+  for (auto& context_bit_set : context_bit_sets_) {
+    context_bit_set = SettingSet(count, false);
+  }
+  for (size_t direction = 0; direction < kDirectionCount; ++direction) {
+    direction_sets_[direction] = SettingSet(count, false);
+    configurations_[direction].resize(count);
+  }
+
+  for (size_t setting = 0; setting < count; ++setting) {
+    const int32_t context = settings_[setting].audioContext.bitmask;
+    for (size_t bit = 0; bit < kContextBitCount; ++bit) {
+      if (context & (1u << bit)) context_bit_sets_[bit].set(setting);
+    }
+    context_sets_.try_emplace(context, count, false).first->second.set(
+        setting);
+
+    for (size_t direction = 0; direction < kDirectionCount; ++direction) {
+      auto& direction_configurations = getDirectionConfigurations(
+          setting, static_cast<Direction>(direction));
+      if (!direction_configurations.has_value()) continue;
+      direction_sets_[direction].set(setting);
+      auto& compiled_configurations = configurations_[direction][setting];
+      for (size_t position = 0;
+           position < direction_configurations.value().size(); ++position) {
+        const auto& direction_configuration =
+            direction_configurations.value()[position];
+        CompiledAseConfiguration& compiled =
+            compiled_configurations.emplace_back();
+        compiled.position = position;
+        if (!direction_configuration.has_value()) continue;
+        compiled.has_value = true;
+        compiled.has_qos =
+            direction_configuration.value().qosConfiguration.has_value();
+
+        const auto& ase_configuration =
+            direction_configuration.value().aseConfiguration;
+        if (ase_configuration.codecId.has_value()) {
+          compiled.codec = findCodec(ase_configuration.codecId);
+          if (compiled.codec == kNoCodec) {
+            compiled.codec = codecs_.size();
+            codecs_.push_back(ase_configuration.codecId.value());
+            for (auto& codec_sets : codec_sets_) {
+              codec_sets.emplace_back(count, false);
+            }
+          }
+          codec_sets_[direction][compiled.codec].set(setting);
+        }
+        // The last value of a tag is used, as for a map of the tags.
+        for (const auto& ltv : ase_configuration.codecConfiguration) {
+          compiled.tag_mask |= getTagBit(ltv.getTag());
+          switch (ltv.getTag()) {
+            case CodecSpecificConfigurationLtv::Tag::samplingFrequency:
+              compiled.sampling_frequency_bit =
+                  getSupportedSamplingFrequencyBit(
+                      ltv.get<CodecSpecificConfigurationLtv::Tag::
+                                  samplingFrequency>());
+              break;
+            case CodecSpecificConfigurationLtv::Tag::frameDuration:
+              compiled.frame_duration_bit = getSupportedFrameDurationBit(
+                  ltv.get<CodecSpecificConfigurationLtv::Tag::frameDuration>());
+              break;
+            case CodecSpecificConfigurationLtv::Tag::codecFrameBlocksPerSDU:
+              compiled.codec_frame_blocks_per_sdu =
+                  ltv.get<CodecSpecificConfigurationLtv::Tag::
+                              codecFrameBlocksPerSDU>()
+                      .value;
+              break;
+            case CodecSpecificConfigurationLtv::Tag::octetsPerCodecFrame:
+              compiled.octets_per_codec_frame =
+                  ltv.get<CodecSpecificConfigurationLtv::Tag::
+                              octetsPerCodecFrame>()
+                      .value;
+              break;
+            default:
+              break;
+          }
+        }
+      }
+    }
+  }
+}
+
+int LeAudioAseConfigurationIndex::findCodec(
+    const std::optional<CodecId>& codec) const {
+  if (!codec.has_value()) return kNoCodec;
+  auto it = std::find(codecs_.begin(), codecs_.end(), codec.value());
+  return it != codecs_.end() ? static_cast<int>(it - codecs_.begin())
+                             : kNoCodec;
+}
+
+std::vector<bool> LeAudioAseConfigurationIndex::getDisabledCodecs(
+    const std::map<CodecId, uint32_t>& codec_priority_map) const {
+  std::vector<bool> disabled_codecs(codecs_.size(), false);
+  for (size_t codec = 0; codec < codecs_.size(); ++codec) {
+    auto priority = codec_priority_map.find(codecs_[codec]);
+    disabled_codecs[codec] =
+        priority != codec_priority_map.end() &&
+        static_cast<int32_t>(priority->second) ==
+            IBluetoothAudioProvider::CODEC_PRIORITY_DISABLED;
+  }
+  return disabled_codecs;
+}
+
+const std::optional<std::vector<std::optional<
+    LeAudioAseConfigurationIndex::AseDirectionConfiguration>>>&
+LeAudioAseConfigurationIndex::getDirectionConfigurations(
+    size_t setting, Direction direction) const {
+  return direction == kSink ? settings_[setting].sinkAseConfiguration
+                            : settings_[setting].sourceAseConfiguration;
+}
+
+LeAudioAseConfigurationIndex::CompiledCapabilities
+LeAudioAseConfigurationIndex::compileCapabilities(
+    const LeAudioDeviceCapabilities& capabilities, Direction direction) const {
+  CompiledCapabilities compiled;
+  compiled.codec = findCodec(capabilities.codecId);
+  if (compiled.codec == kNoCodec) {
+    compiled.candidates = SettingSet(settings_.size(), false);
+    return compiled;
+  }
+  for (const auto& ltv : capabilities.codecSpecificCapabilities) {
+    compiled.required_tag_mask |= getTagBit(getConfigurationTag(ltv.getTag()));
+    switch (ltv.getTag()) {
+      case CodecSpecificCapabilitiesLtv::Tag::supportedSamplingFrequencies:
+        compiled.sampling_frequency_mask &=
+            ltv.get<CodecSpecificCapabilitiesLtv::Tag::
+                        supportedSamplingFrequencies>()
+                .bitmask;
+        break;
+      case CodecSpecificCapabilitiesLtv::Tag::supportedFrameDurations:
+        compiled.frame_duration_mask &=
+            ltv.get<CodecSpecificCapabilitiesLtv::Tag::
+                        supportedFrameDurations>()
+                .bitmask;
+        break;
+      case CodecSpecificCapabilitiesLtv::Tag::supportedMaxCodecFramesPerSDU:
+        compiled.max_codec_frame_blocks_per_sdu =
+            std::min(compiled.max_codec_frame_blocks_per_sdu,
+                     ltv.get<CodecSpecificCapabilitiesLtv::Tag::
+                                 supportedMaxCodecFramesPerSDU>()
+                         .value);
+        break;
+      case CodecSpecificCapabilitiesLtv::Tag::supportedOctetsPerCodecFrame: {
+        const auto& octets = ltv.get<
+            CodecSpecificCapabilitiesLtv::Tag::supportedOctetsPerCodecFrame>();
+        compiled.min_octets_per_codec_frame =
+            std::max(compiled.min_octets_per_codec_frame, octets.min);
+        compiled.max_octets_per_codec_frame =
+            std::min(compiled.max_octets_per_codec_frame, octets.max);
+        break;
+      }
+      default:
+        // Only the presence of the audio channel allocation is checked.
+        break;
+    }
+  }
+  compiled.candidates = getContextCandidates(capabilities);
+  compiled.candidates &= codec_sets_[direction][compiled.codec];
+  return compiled;
+}
+
+LeAudioAseConfigurationIndex::SettingSet
+LeAudioAseConfigurationIndex::getContextCandidates(
+    const LeAudioDeviceCapabilities& capabilities) const {
+  // If has no metadata, assume match
+  if (!capabilities.metadata.has_value()) {
+    return SettingSet(settings_.size(), true);
+  }
+  uint32_t preferred_contexts = 0;
+  for (const auto& metadata : capabilities.metadata.value()) {
+    if (!metadata.has_value()) continue;
+    if (metadata.value().getTag() == MetadataLtv::Tag::preferredAudioContexts) {
+      preferred_contexts |=
+          metadata.value()
+              .get<MetadataLtv::Tag::preferredAudioContexts>()
+              .values.bitmask;
+    }
+  }
+  SettingSet candidates(settings_.size(), false);
+  for (size_t bit = 0; bit < kContextBitCount; ++bit) {
+    if (preferred_contexts & (1u << bit)) candidates |= context_bit_sets_[bit];
+  }
+  return candidates;
+}
+
+// static
+bool LeAudioAseConfigurationIndex::isMatchedCapabilities(
+    const CompiledAseConfiguration& cfg,
+    const CompiledCapabilities& capabilities) {
+  const uint32_t required = capabilities.required_tag_mask;
+  // Cannot find a tag for a capability
+  if ((cfg.tag_mask & required) != required) return false;
+  if ((required &
+       getTagBit(CodecSpecificConfigurationLtv::Tag::samplingFrequency)) &&
+      !(cfg.sampling_frequency_bit & capabilities.sampling_frequency_mask)) {
+    return false;
+  }
+  if ((required &
+       getTagBit(CodecSpecificConfigurationLtv::Tag::frameDuration)) &&
+      !(cfg.frame_duration_bit & capabilities.frame_duration_mask)) {
+    return false;
+  }
+  if ((required &
+       getTagBit(CodecSpecificConfigurationLtv::Tag::codecFrameBlocksPerSDU)) &&
+      cfg.codec_frame_blocks_per_sdu >
+          capabilities.max_codec_frame_blocks_per_sdu) {
+    return false;
+  }
+  if ((required &
+       getTagBit(CodecSpecificConfigurationLtv::Tag::octetsPerCodecFrame)) &&
+      (cfg.octets_per_codec_frame < capabilities.min_octets_per_codec_frame ||
+       cfg.octets_per_codec_frame > capabilities.max_octets_per_codec_frame)) {
+    return false;
+  }
+  return true;
+}
+
+bool LeAudioAseConfigurationIndex::isMatchedAseConfiguration(
+    size_t setting, Direction direction, const CompiledAseConfiguration& cfg,
+    const LeAudioAseConfiguration& requirement,
+    const std::vector<bool>& disabled_codecs) const {
+  // Also match if no CodecId requirement
+  if (requirement.codecId.has_value()) {
+    if (cfg.codec == kNoCodec || disabled_codecs[cfg.codec]) return false;
+    if (codecs_[cfg.codec] != requirement.codecId.value()) return false;
+  }
+  const LeAudioAseConfiguration& setting_cfg =
+      getDirectionConfigurations(setting, direction)
+          .value()[cfg.position]
+          .value()
+          .aseConfiguration;
+  if (setting_cfg.targetLatency != requirement.targetLatency) return false;
+  // Ignore PHY requirement
+
+  // Directly compare CodecSpecificConfigurationLtv, with the last value of
+  // each tag of the setting
+  const auto& codec_cfg = setting_cfg.codecConfiguration;
+  for (const auto& requirement_ltv : requirement.codecConfiguration) {
+    auto ltv = std::find_if(codec_cfg.rbegin(), codec_cfg.rend(),
+                            [&requirement_ltv](const auto& ltv) {
+                              return ltv.getTag() == requirement_ltv.getTag();
+                            });
+    if (ltv == codec_cfg.rend() || *ltv != requirement_ltv) return false;
+  }
+  // Ignore vendor configuration and metadata requirement
+  return true;
+}
+
+// static
+bool LeAudioAseConfigurationIndex::isMatchedQosRequirement(
+    const LeAudioAseQosConfiguration& setting_qos,
+    const AseQosDirectionRequirement& requirement_qos) {
+  if (setting_qos.retransmissionNum !=
+      requirement_qos.preferredRetransmissionNum)
+    return false;
+  if (setting_qos.maxTransportLatencyMs > requirement_qos.maxTransportLatencyMs)
+    return false;
+  // Ignore other parameters, as they are not populated in the setting_qos
+  return true;
+}
+
+LeAudioAseConfigurationIndex::LeAudioAseConfigurationSetting
+LeAudioAseConfigurationIndex::makeFilteredSetting(
+    size_t setting, Direction direction,
+    const std::vector<const CompiledAseConfiguration*>& configurations) const {
+  const auto& direction_configurations =
+      getDirectionConfigurations(setting, direction).value();
+  std::vector<std::optional<AseDirectionConfiguration>>
+      valid_direction_configuration;
+  valid_direction_configuration.reserve(configurations.size());
+  for (const CompiledAseConfiguration* cfg : configurations) {
+    valid_direction_configuration.push_back(
+        direction_configurations[cfg->position]);
+  }
+  LeAudioAseConfigurationSetting filtered_setting;
+  filtered_setting.audioContext = settings_[setting].audioContext;
+  filtered_setting.packing = settings_[setting].packing;
+  if (direction == kSink) {
+    filtered_setting.sinkAseConfiguration =
+        std::move(valid_direction_configuration);
+  } else {
+    filtered_setting.sourceAseConfiguration =
+        std::move(valid_direction_configuration);
+  }
+  filtered_setting.flags = settings_[setting].flags;
+  return filtered_setting;
+}
+
+std::vector<LeAudioAseConfigurationIndex::LeAudioAseConfigurationSetting>
+LeAudioAseConfigurationIndex::getAseConfiguration(
+    const std::vector<std::optional<LeAudioDeviceCapabilities>>& capabilities,
+    Direction direction,
+    const std::vector<LeAudioConfigurationRequirement>& requirements,
+    const std::map<CodecId, uint32_t>& codec_priority_map) const {
+  const std::vector<bool> disabled_codecs =
+      getDisabledCodecs(codec_priority_map);
+
+  // Setting candidates for each capabilities, with the ones for disabled
+  // codecs excluded.
+  std::vector<CompiledCapabilities> compiled_capabilities;
+  SettingSet candidates(settings_.size(), false);
+  for (const auto& capability : capabilities) {
+    if (!capability.has_value()) continue;
+    CompiledCapabilities compiled =
+        compileCapabilities(capability.value(), direction);
+    if (compiled.codec == kNoCodec || disabled_codecs[compiled.codec]) continue;
+    candidates |= compiled.candidates;
+    compiled_capabilities.push_back(std::move(compiled));
+  }
+
+  // Matching with remote capabilities, in the order of the settings and then
+  // of the capabilities.
+  std::vector<CapabilitiesMatch> capability_matches;
+  candidates.forEach([&](size_t setting) {
+    for (const auto& compiled : compiled_capabilities) {
+      if (!compiled.candidates.test(setting)) continue;
+      CapabilitiesMatch match{setting, {}};
+      for (const auto& cfg : configurations_[direction][setting]) {
+        if (cfg.has_value && cfg.codec == compiled.codec &&
+            isMatchedCapabilities(cfg, compiled)) {
+          match.configurations.push_back(&cfg);
+        }
+      }
+      if (!match.configurations.empty()) {
+        capability_matches.push_back(std::move(match));
+      }
+    }
+    return true;
+  });
+
+  // Matching with requirements
+  std::vector<LeAudioAseConfigurationSetting> result;
+  for (const auto& match : capability_matches) {
+    const auto& setting = settings_[match.setting];
+    for (const auto& requirement : requirements) {
+      if (setting.audioContext != requirement.audioContext) continue;
+      const auto& direction_requirements =
+          direction == kSink ? requirement.sinkAseRequirement
+                             : requirement.sourceAseRequirement;
+      // If there's no requirement, all are valid
+      if (!direction_requirements.has_value()) {
+        result.push_back(makeFilteredSetting(match.setting, direction,
+                                             match.configurations));
+        continue;
+      }
+      std::vector<const CompiledAseConfiguration*> valid_configurations;
+      for (const CompiledAseConfiguration* cfg : match.configurations) {
+        // Valid if match any requirement.
+        if (std::any_of(direction_requirements.value().begin(),
+                        direction_requirements.value().end(),
+                        [&](const auto& direction_requirement) {
+                          return direction_requirement.has_value() &&
+                                 isMatchedAseConfiguration(
+                                     match.setting, direction, *cfg,
+                                     direction_requirement.value()
+                                         .aseConfiguration,
+                                     disabled_codecs);
+                        })) {
+          valid_configurations.push_back(cfg);
+        }
+      }
+      if (valid_configurations.empty()) continue;
+      result.push_back(
+          makeFilteredSetting(match.setting, direction, valid_configurations));
+    }
+  }
+  return result;
+}
+
+LeAudioAseConfigurationIndex::LeAudioAseQosConfigurationPair
+LeAudioAseConfigurationIndex::getAseQosConfiguration(
+    const LeAudioAseQosConfigurationRequirement& requirement,
+    const std::map<CodecId, uint32_t>& codec_priority_map) const {
+  LeAudioAseQosConfigurationPair result;
+
+  // Direction QoS matching
+  // Only handle one direction input case
+  Direction direction = kSource;
+  const std::optional<AseQosDirectionRequirement>* direction_qos_requirement =
+      &requirement.sourceAseQosRequirement;
+  if (requirement.sinkAseQosRequirement.has_value()) {
+    direction = kSink;
+    direction_qos_requirement = &requirement.sinkAseQosRequirement;
+  }
+
+  // Context matching
+  auto context_set = context_sets_.find(requirement.audioContext.bitmask);
+  if (context_set == context_sets_.end()) return result;
+  SettingSet candidates = context_set->second;
+  candidates &= direction_sets_[direction];
+
+  // Match configuration flags
+  // Currently configuration flags are not populated, ignore.
+  const std::vector<bool> disabled_codecs =
+      getDisabledCodecs(codec_priority_map);
+  candidates.forEach([&](size_t setting) {
+    const auto& direction_configurations =
+        getDirectionConfigurations(setting, direction).value();
+    for (const auto& cfg : configurations_[direction][setting]) {
+      if (!cfg.has_value) continue;
+      const auto& qos_configuration =
+          direction_configurations[cfg.position].value().qosConfiguration;
+      // If no requirement, return the first QoS
+      if (!direction_qos_requirement->has_value()) {
+        result.sinkQosConfiguration = qos_configuration;
+        result.sourceQosConfiguration = qos_configuration;
+        return false;
+      }
+
+      // If has requirement, return the first matched QoS
+      // Try to match the ASE configuration
+      // and QoS with requirement
+      if (!cfg.has_qos) continue;
+      if (isMatchedAseConfiguration(
+              setting, direction, cfg,
+              direction_qos_requirement->value().aseConfiguration,
+              disabled_codecs) &&
+          isMatchedQosRequirement(qos_configuration.value(),
+                                  direction_qos_requirement->value())) {
+        if (direction == kSink)
+          result.sinkQosConfiguration = qos_configuration;
+        else
+          result.sourceQosConfiguration = qos_configuration;
+        return false;
+      }
+    }
+    return true;
+  });
+
+  return result;
+}
+
+}  // namespace audio
+}  // namespace bluetooth
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "aidl/android/hardware/bluetooth/audio/IBluetoothAudioProvider.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace bluetooth {
+namespace audio {
+
+// Conversions from a configured value to the matching capability bit, 0 if
+// the value has no capability bit.
+uint32_t getSupportedSamplingFrequencyBit(
+    CodecSpecificConfigurationLtv::SamplingFrequency freq);
+uint32_t getSupportedFrameDurationBit(
+    CodecSpecificConfigurationLtv::FrameDuration fduration);
+
+/***
+ * The LE Audio ASE configuration settings, compiled for matching against the
+ * remote capabilities and the requirements of the Bluetooth stack.
+ *
+ * Every ASE configuration is reduced to its codec index, the bits of the
+ * configured sampling frequency and frame duration, and the other values the
+ * capabilities are checked against. The settings are indexed by direction,
+ * codec and audio context bit with bitsets, so the candidates for a request
+ * are found with a few AND operations. The candidates are visited in the order
+ * of the settings, which keeps the order of the results of a linear search.
+ *
+ * The settings are immutable, a single index is shared by all the providers.
+ ***/
+class LeAudioAseConfigurationIndex {
+ public:
+  using LeAudioAseConfigurationSetting =
+      IBluetoothAudioProvider::LeAudioAseConfigurationSetting;
+  using LeAudioDeviceCapabilities =
+      IBluetoothAudioProvider::LeAudioDeviceCapabilities;
+  using LeAudioConfigurationRequirement =
+      IBluetoothAudioProvider::LeAudioConfigurationRequirement;
+  using LeAudioAseQosConfigurationRequirement =
+      IBluetoothAudioProvider::LeAudioAseQosConfigurationRequirement;
+  using LeAudioAseQosConfigurationPair =
+      IBluetoothAudioProvider::LeAudioAseQosConfigurationPair;
+
+  enum Direction : size_t { kSink, kSource, kDirectionCount };
+
+  // Returns the index of the settings of AudioSetConfigurationProviderJson,
+  // or nullptr if they can not be loaded.
+  static std::shared_ptr<const LeAudioAseConfigurationIndex> get();
+
+  explicit LeAudioAseConfigurationIndex(
+      std::vector<LeAudioAseConfigurationSetting> settings);
+
+  // Returns the settings, reduced to the ASE configurations for 'direction',
+  // that match any of 'capabilities' and then any of 'requirements'.
+  std::vector<LeAudioAseConfigurationSetting> getAseConfiguration(
+      const std::vector<std::optional<LeAudioDeviceCapabilities>>&
+          capabilities,
+      Direction direction,
+      const std::vector<LeAudioConfigurationRequirement>& requirements,
+      const std::map<CodecId, uint32_t>& codec_priority_map) const;
+  // Returns the QoS configuration of the first ASE configuration that
+  // matches 'requirement'.
+  LeAudioAseQosConfigurationPair getAseQosConfiguration(
+      const LeAudioAseQosConfigurationRequirement& requirement,
+      const std::map<CodecId, uint32_t>& codec_priority_map) const;
+
+ private:
+  using AseDirectionConfiguration =
+      LeAudioAseConfigurationSetting::AseDirectionConfiguration;
+  using AseDirectionRequirement =
+      LeAudioConfigurationRequirement::AseDirectionRequirement;
+  using AseQosDirectionRequirement =
+      LeAudioAseQosConfigurationRequirement::AseQosDirectionRequirement;
+
+  static constexpr int kNoCodec = -1;
+  static constexpr size_t kContextBitCount = 32;
+
+  // A set of settings, by their position in 'settings_'.
+  class SettingSet {
+   public:
+    SettingSet() = default;
+    SettingSet(size_t size, bool value);
+
+    void set(size_t position) {
+      words_[position / 64] |= 1ULL << position % 64;
+    }
+    bool test(size_t position) const {
+      return words_[position / 64] & 1ULL << position % 64;
+    }
+    SettingSet& operator&=(const SettingSet& other);
+    SettingSet& operator|=(const SettingSet& other);
+    // Calls 'f' with the positions in the set, in increasing order, until it
+    // returns false.
+    template <typename F>
+    void forEach(F f) const;
+
+   private:
+    std::vector<uint64_t> words_;
+  };
+
+  // An ASE configuration reduced to the values used for matching.
+  struct CompiledAseConfiguration {
+    // position in the direction configurations of the setting
+    size_t position = 0;
+    bool has_value = false;
+    bool has_qos = false;
+    int codec = kNoCodec;
+    // bits of the present CodecSpecificConfigurationLtv tags
+    uint32_t tag_mask = 0;
+    uint32_t sampling_frequency_bit = 0;
+    uint32_t frame_duration_bit = 0;
+    int32_t codec_frame_blocks_per_sdu = 0;
+    int32_t octets_per_codec_frame = 0;
+  };
+
+  // The capabilities reduced to the bounds of the matching configurations.
+  struct CompiledCapabilities {
+    int codec = kNoCodec;
+    uint32_t required_tag_mask = 0;
+    uint32_t sampling_frequency_mask = ~0u;
+    uint32_t frame_duration_mask = ~0u;
+    int32_t max_codec_frame_blocks_per_sdu = INT32_MAX;
+    int32_t min_octets_per_codec_frame = INT32_MIN;
+    int32_t max_octets_per_codec_frame = INT32_MAX;
+    SettingSet candidates;
+  };
+
+  // The match of a setting with one capabilities.
+  struct CapabilitiesMatch {
+    size_t setting;
+    std::vector<const CompiledAseConfiguration*> configurations;
+  };
+
+  int findCodec(const std::optional<CodecId>& codec) const;
+  std::vector<bool> getDisabledCodecs(
+      const std::map<CodecId, uint32_t>& codec_priority_map) const;
+  const std::optional<std::vector<std::optional<AseDirectionConfiguration>>>&
+  getDirectionConfigurations(size_t setting, Direction direction) const;
+  CompiledCapabilities compileCapabilities(
+      const LeAudioDeviceCapabilities& capabilities,
+      Direction direction) const;
+  SettingSet getContextCandidates(
+      const LeAudioDeviceCapabilities& capabilities) const;
+  static bool isMatchedCapabilities(const CompiledAseConfiguration& cfg,
+                                    const CompiledCapabilities& capabilities);
+  bool isMatchedAseConfiguration(
+      size_t setting, Direction direction, const CompiledAseConfiguration& cfg,
+      const LeAudioAseConfiguration& requirement,
+      const std::vector<bool>& disabled_codecs) const;
+  static bool isMatchedQosRequirement(
+      const LeAudioAseQosConfiguration& setting_qos,
+      const AseQosDirectionRequirement& requirement_qos);
+  LeAudioAseConfigurationSetting makeFilteredSetting(
+      size_t setting, Direction direction,
+      const std::vector<const CompiledAseConfiguration*>& configurations) const;
+
+  const std::vector<LeAudioAseConfigurationSetting> settings_;
+  // the distinct codecs of the configurations, indexed by
+  // CompiledAseConfiguration::codec
+  std::vector<CodecId> codecs_;
+  std::vector<std::vector<CompiledAseConfiguration>>
+      configurations_[kDirectionCount];
+  // settings with configurations for a direction
+  SettingSet direction_sets_[kDirectionCount];
+  // settings with any configuration for a direction and a codec
+  std::vector<SettingSet> codec_sets_[kDirectionCount];
+  // settings by the bits of their audio context
+  SettingSet context_bit_sets_[kContextBitCount];
+  // settings by their exact audio context
+  std::unordered_map<int32_t, SettingSet> context_sets_;
+};
+
+}  // namespace audio
+}  // namespace bluetooth
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
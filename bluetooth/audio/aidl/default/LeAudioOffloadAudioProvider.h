@@ -96,9 +96,6 @@ class LeAudioOffloadAudioProvider : public BluetoothAudioProvider {
 
   // Private matching function definitions
   bool isMatchedValidCodec(CodecId cfg_codec, CodecId req_codec);
-  bool isCapabilitiesMatchedContext(
-      AudioContext setting_context,
-      const IBluetoothAudioProvider::LeAudioDeviceCapabilities& capabilities);
   bool isMatchedSamplingFreq(
       CodecSpecificConfigurationLtv::SamplingFrequency& cfg_freq,
       CodecSpecificCapabilitiesLtv::SupportedSamplingFrequencies&
@@ -122,36 +119,9 @@ class LeAudioOffloadAudioProvider : public BluetoothAudioProvider {
   bool isCapabilitiesMatchedCodecConfiguration(
       std::vector<CodecSpecificConfigurationLtv>& codec_cfg,
       std::vector<CodecSpecificCapabilitiesLtv> codec_capabilities);
-  bool isMatchedAseConfiguration(LeAudioAseConfiguration setting_cfg,
-                                 LeAudioAseConfiguration requirement_cfg);
   bool isMatchedBISConfiguration(
       LeAudioBisConfiguration bis_cfg,
       const IBluetoothAudioProvider::LeAudioDeviceCapabilities& capabilities);
-  void filterCapabilitiesAseDirectionConfiguration(
-      std::vector<std::optional<AseDirectionConfiguration>>&
-          direction_configurations,
-      const IBluetoothAudioProvider::LeAudioDeviceCapabilities& capabilities,
-      std::vector<std::optional<AseDirectionConfiguration>>&
-          valid_direction_configurations);
-  void filterRequirementAseDirectionConfiguration(
-      std::vector<std::optional<AseDirectionConfiguration>>&
-          direction_configurations,
-      const std::optional<std::vector<std::optional<AseDirectionRequirement>>>&
-          requirements,
-      std::vector<std::optional<AseDirectionConfiguration>>&
-          valid_direction_configurations);
-  std::optional<LeAudioAseConfigurationSetting>
-  getCapabilitiesMatchedAseConfigurationSettings(
-      IBluetoothAudioProvider::LeAudioAseConfigurationSetting& setting,
-      const IBluetoothAudioProvider::LeAudioDeviceCapabilities& capabilities,
-      uint8_t direction);
-  std::optional<LeAudioAseConfigurationSetting>
-  getRequirementMatchedAseConfigurationSettings(
-      IBluetoothAudioProvider::LeAudioAseConfigurationSetting& setting,
-      const IBluetoothAudioProvider::LeAudioConfigurationRequirement&
-          requirement);
-  bool isMatchedQosRequirement(LeAudioAseQosConfiguration setting_qos,
-                               AseQosDirectionRequirement requirement_qos);
   std::optional<LeAudioBroadcastConfigurationSetting>
   getCapabilitiesMatchedBroadcastConfigurationSettings(
       LeAudioBroadcastConfigurationSetting& setting,
@@ -21,8 +21,13 @@
 #include <android-base/stringprintf.h>
 #include <android/binder_manager.h>
 #include <com_android_btaudio_hal_flags.h>
+#include <fmq/EventFlag.h>
 #include <hardware/audio.h>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include "BluetoothAudioSession.h"
 
 namespace aidl {
@@ -34,8 +39,83 @@ namespace audio {
 static constexpr int kFmqSendTimeoutMs = 1000;  // 1000 ms timeout for sending
 static constexpr int kFmqReceiveTimeoutMs =
     1000;                               // 1000 ms timeout for receiving
-static constexpr int kWritePollMs = 1;  // polled non-blocking interval
-static constexpr int kReadPollMs = 1;   // polled non-blocking interval
+// The longest wait for the FMQ while the peer has not been seen waking the
+// event flag yet, or if the FMQ has no event flag.
+static constexpr int kWritePollMs = 1;
+static constexpr int kReadPollMs = 1;
+// The event flag bits used by the blocking read and write of libfmq.
+static constexpr uint32_t kFmqNotEmpty = 1 << 0;
+static constexpr uint32_t kFmqNotFull = 1 << 1;
+
+using ::android::hardware::EventFlag;
+using std::chrono::steady_clock;
+
+/***
+ * The FMQ of a session together with its event flag. The PCM methods hold a
+ * reference while they block, so the session can end at any time: the data
+ * path is closed, which wakes up the blocked callers, and is freed by the
+ * last of them.
+ ***/
+class BluetoothAudioSession::DataPath {
+ public:
+  explicit DataPath(const DataMQDesc& mq_desc) : mq_(mq_desc) {
+    if (mq_.isValid() && mq_.getEventFlagWord() != nullptr &&
+        EventFlag::createEventFlag(mq_.getEventFlagWord(), &event_flag_) !=
+            ::android::OK) {
+      LOG(WARNING) << __func__ << " - failed to create the FMQ event flag";
+      event_flag_ = nullptr;
+    }
+  }
+  ~DataPath() {
+    if (event_flag_ != nullptr) EventFlag::deleteEventFlag(&event_flag_);
+  }
+
+  DataMQ& mq() { return mq_; }
+  bool IsClosed() const { return is_closed_; }
+  void Close() {
+    is_closed_ = true;
+    Wake(kFmqNotEmpty | kFmqNotFull);
+  }
+  void Wake(uint32_t bits) {
+    if (event_flag_ != nullptr) event_flag_->wake(bits);
+  }
+
+  /***
+   * Waits until the peer signals 'bits', the data path is closed, or
+   * 'deadline' has passed. The peer may use the non-blocking FMQ methods and
+   * never signal, so the wait is capped at 'poll_ms' until the first signal
+   * has been seen.
+   * @return: false if the deadline has already passed
+   ***/
+  bool WaitUntil(uint32_t bits, steady_clock::time_point deadline,
+                 int poll_ms) {
+    const auto now = steady_clock::now();
+    if (now >= deadline) return false;
+    std::chrono::nanoseconds timeout = deadline - now;
+    if (!is_peer_waking_ || event_flag_ == nullptr) {
+      timeout = std::min<std::chrono::nanoseconds>(
+          timeout, std::chrono::milliseconds(poll_ms));
+    }
+    if (event_flag_ == nullptr) {
+      std::this_thread::sleep_for(timeout);
+      return true;
+    }
+    uint32_t state = 0;
+    if (event_flag_->wait(bits, &state, timeout.count(), true /* retry */) ==
+            ::android::OK &&
+        (state & bits) != 0 && !is_closed_) {
+      is_peer_waking_ = true;
+    }
+    return true;
+  }
+
+ private:
+  DataMQ mq_;
+  EventFlag* event_flag_ = nullptr;
+  std::atomic<bool> is_closed_ = false;
+  // only accessed by the thread doing PCM I/O
+  bool is_peer_waking_ = false;
+};
 
 static std::string toString(const std::vector<LatencyMode>& latencies) {
   std::stringstream latencyModesStr;
@@ -46,7 +126,9 @@ static std::string toString(const std::vector<LatencyMode>& latencies) {
 }
 
 BluetoothAudioSession::BluetoothAudioSession(const SessionType& session_type)
-    : session_type_(session_type), stack_iface_(nullptr), data_mq_(nullptr) {}
+    : session_type_(session_type),
+      stack_iface_(nullptr),
+      data_path_(nullptr) {}
 
 /***
  *
@@ -70,12 +152,14 @@ void BluetoothAudioSession::OnSessionStarted(
     LOG(ERROR) << __func__ << " - SessionType=" << toString(session_type_)
                << " MqDescriptor Invalid";
     audio_config_ = nullptr;
+    UpdateSessionReady();
   } else {
     stack_iface_ = stack_iface;
     latency_modes_ = latency_modes;
     LOG(INFO) << __func__ << " - SessionType=" << toString(session_type_)
               << " - All LatencyModes=" << toString(latency_modes)
               << ", AudioConfiguration=" << audio_config.toString();
+    UpdateSessionReady();
     ReportSessionStatus();
   }
 }
@@ -87,6 +171,7 @@ void BluetoothAudioSession::OnSessionEnded() {
   audio_config_ = nullptr;
   stack_iface_ = nullptr;
   UpdateDataPath(nullptr);
+  UpdateSessionReady();
   if (toggled) {
     ReportSessionStatus();
   }
@@ -154,9 +239,9 @@ void BluetoothAudioSession::ReportAudioConfigChanged(
   }
 }
 
-bool BluetoothAudioSession::IsSessionReady() {
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
+bool BluetoothAudioSession::IsSessionReady() { return is_session_ready_; }
 
+bool BluetoothAudioSession::CheckSessionReady() {
   bool is_mq_valid =
       (session_type_ == SessionType::A2DP_HARDWARE_OFFLOAD_ENCODING_DATAPATH ||
        session_type_ ==
@@ -167,10 +252,21 @@ bool BluetoothAudioSession::IsSessionReady() {
            SessionType::LE_AUDIO_BROADCAST_HARDWARE_OFFLOAD_ENCODING_DATAPATH ||
        session_type_ == SessionType::A2DP_HARDWARE_OFFLOAD_DECODING_DATAPATH ||
        session_type_ == SessionType::HFP_HARDWARE_OFFLOAD_DATAPATH ||
-       (data_mq_ != nullptr && data_mq_->isValid()));
+       (data_path_ != nullptr && data_path_->mq().isValid()));
   return stack_iface_ != nullptr && is_mq_valid && audio_config_ != nullptr;
 }
 
+void BluetoothAudioSession::UpdateSessionReady() {
+  is_session_ready_ = CheckSessionReady();
+}
+
+std::shared_ptr<BluetoothAudioSession::DataPath>
+BluetoothAudioSession::GetDataPath() {
+  if (!IsSessionReady()) return nullptr;
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  return IsSessionReady() ? data_path_ : nullptr;
+}
+
 /***
  *
  * Status callback methods
@@ -268,18 +364,20 @@ void BluetoothAudioSession::StopStream() {
  ***/
 
 bool BluetoothAudioSession::UpdateDataPath(const DataMQDesc* mq_desc) {
+  if (data_path_ != nullptr) {
+    data_path_->Close();
+  }
   if (mq_desc == nullptr) {
     // usecase of reset by nullptr
-    data_mq_ = nullptr;
+    data_path_ = nullptr;
     return true;
   }
-  std::unique_ptr<DataMQ> temp_mq;
-  temp_mq.reset(new DataMQ(*mq_desc));
-  if (!temp_mq || !temp_mq->isValid()) {
-    data_mq_ = nullptr;
+  auto temp_path = std::make_shared<DataPath>(*mq_desc);
+  if (!temp_path->mq().isValid()) {
+    data_path_ = nullptr;
     return false;
   }
-  data_mq_ = std::move(temp_mq);
+  data_path_ = std::move(temp_path);
   return true;
 }
 
@@ -363,37 +461,32 @@ size_t BluetoothAudioSession::OutWritePcmData(const void* buffer,
   if (buffer == nullptr || bytes <= 0) {
     return 0;
   }
+  std::shared_ptr<DataPath> data_path = GetDataPath();
+  if (data_path == nullptr) {
+    return 0;
+  }
+  DataMQ& data_mq = data_path->mq();
+  const auto deadline =
+      steady_clock::now() + std::chrono::milliseconds(kFmqSendTimeoutMs);
   size_t total_written = 0;
-  int timeout_ms = kFmqSendTimeoutMs;
-  do {
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    if (!IsSessionReady()) {
-      break;
-    }
-    size_t num_bytes_to_write = data_mq_->availableToWrite();
+  while (total_written < bytes && !data_path->IsClosed()) {
+    size_t num_bytes_to_write =
+        std::min(data_mq.availableToWrite(), bytes - total_written);
     if (num_bytes_to_write) {
-      if (num_bytes_to_write > (bytes - total_written)) {
-        num_bytes_to_write = bytes - total_written;
-      }
-
-      if (!data_mq_->write(
-              static_cast<const MQDataType*>(buffer) + total_written,
-              num_bytes_to_write)) {
+      if (!data_mq.write(static_cast<const MQDataType*>(buffer) + total_written,
+                         num_bytes_to_write)) {
         LOG(ERROR) << "FMQ datapath writing " << total_written << "/" << bytes
                    << " failed";
         return total_written;
       }
       total_written += num_bytes_to_write;
-    } else if (timeout_ms >= kWritePollMs) {
-      lock.unlock();
-      usleep(kWritePollMs * 1000);
-      timeout_ms -= kWritePollMs;
-    } else {
+      data_path->Wake(kFmqNotEmpty);
+    } else if (!data_path->WaitUntil(kFmqNotFull, deadline, kWritePollMs)) {
       LOG(DEBUG) << "Data " << total_written << "/" << bytes << " overflow "
-                 << (kFmqSendTimeoutMs - timeout_ms) << " ms";
+                 << kFmqSendTimeoutMs << " ms";
       return total_written;
     }
-  } while (total_written < bytes);
+  }
   return total_written;
 }
 
@@ -401,36 +494,32 @@ size_t BluetoothAudioSession::InReadPcmData(void* buffer, size_t bytes) {
   if (buffer == nullptr || bytes <= 0) {
     return 0;
   }
+  std::shared_ptr<DataPath> data_path = GetDataPath();
+  if (data_path == nullptr) {
+    return 0;
+  }
+  DataMQ& data_mq = data_path->mq();
+  const auto deadline =
+      steady_clock::now() + std::chrono::milliseconds(kFmqReceiveTimeoutMs);
   size_t total_read = 0;
-  int timeout_ms = kFmqReceiveTimeoutMs;
-  do {
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    if (!IsSessionReady()) {
-      break;
-    }
-    size_t num_bytes_to_read = data_mq_->availableToRead();
+  while (total_read < bytes && !data_path->IsClosed()) {
+    size_t num_bytes_to_read =
+        std::min(data_mq.availableToRead(), bytes - total_read);
     if (num_bytes_to_read) {
-      if (num_bytes_to_read > (bytes - total_read)) {
-        num_bytes_to_read = bytes - total_read;
-      }
-      if (!data_mq_->read(static_cast<MQDataType*>(buffer) + total_read,
-                          num_bytes_to_read)) {
+      if (!data_mq.read(static_cast<MQDataType*>(buffer) + total_read,
+                        num_bytes_to_read)) {
         LOG(ERROR) << "FMQ datapath reading " << total_read << "/" << bytes
                    << " failed";
         return total_read;
       }
       total_read += num_bytes_to_read;
-    } else if (timeout_ms >= kReadPollMs) {
-      lock.unlock();
-      usleep(kReadPollMs * 1000);
-      timeout_ms -= kReadPollMs;
-      continue;
-    } else {
+      data_path->Wake(kFmqNotFull);
+    } else if (!data_path->WaitUntil(kFmqNotEmpty, deadline, kReadPollMs)) {
       LOG(DEBUG) << "Data " << total_read << "/" << bytes << " overflow "
-                 << (kFmqReceiveTimeoutMs - timeout_ms) << " ms";
+                 << kFmqReceiveTimeoutMs << " ms";
       return total_read;
     }
-  } while (total_read < bytes);
+  }
   return total_read;
 }
 
@@ -24,6 +24,8 @@
 #include <aidl/android/hardware/bluetooth/audio/SessionType.h>
 #include <fmq/AidlMessageQueue.h>
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -112,7 +114,8 @@ class BluetoothAudioSession {
   BluetoothAudioSession(const SessionType& session_type);
 
   /***
-   * The function helps to check if this session is ready or not
+   * The function helps to check if this session is ready or not. It does not
+   * take the session lock, so it is cheap enough for the data path.
    * @return: true if the Bluetooth stack has started the specified session
    ***/
   bool IsSessionReady();
@@ -193,9 +196,11 @@ class BluetoothAudioSession {
   std::vector<LatencyMode> GetSupportedLatencyModes();
   void SetLatencyMode(const LatencyMode& latency_mode);
 
-  // The control function writes stream to FMQ
+  // The control function writes stream to FMQ. It blocks on the event flag of
+  // the FMQ while the FMQ is full, without holding the session lock.
   size_t OutWritePcmData(const void* buffer, size_t bytes);
-  // The control function read stream from FMQ
+  // The control function read stream from FMQ. It blocks on the event flag of
+  // the FMQ while the FMQ is empty, without holding the session lock.
   size_t InReadPcmData(void* buffer, size_t bytes);
 
   // Return if IBluetoothAudioProviderFactory implementation existed
@@ -208,17 +213,24 @@ class BluetoothAudioSession {
 
   // audio control path to use for both software and offloading
   std::shared_ptr<IBluetoothAudioPort> stack_iface_;
-  // audio data path (FMQ) for software encoding
-  std::unique_ptr<DataMQ> data_mq_;
+  // audio data path (FMQ) for software encoding, shared with the PCM methods
+  // so they can keep using it after releasing the lock
+  class DataPath;
+  std::shared_ptr<DataPath> data_path_;
   // audio data configuration for both software and offloading
   std::unique_ptr<AudioConfiguration> audio_config_;
   std::vector<LatencyMode> latency_modes_;
   bool low_latency_allowed_ = true;
+  // the result of CheckSessionReady(), updated under mutex_
+  std::atomic<bool> is_session_ready_ = false;
 
   // saving those registered bluetooth_audio's callbacks
   std::unordered_map<uint16_t, std::shared_ptr<struct PortStatusCallbacks>>
       observers_;
 
+  bool CheckSessionReady();
+  void UpdateSessionReady();
+  std::shared_ptr<DataPath> GetDataPath();
   bool UpdateDataPath(const DataMQDesc* mq_desc);
   bool UpdateAudioConfig(const AudioConfiguration& audio_config);
   // invoking the registered session_changed_cb_
@@ -45,7 +45,19 @@
 #include <aidl/android/hardware/bluetooth/audio/ConfigurationFlags.h>
 #include <aidl/android/hardware/bluetooth/audio/LeAudioAseConfiguration.h>
 #include <aidl/android/hardware/bluetooth/audio/Phy.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/scopeguard.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_auto_utils.h>
+#include <android/binder_parcel_utils.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
 
 #include "flatbuffers/idl.h"
 #include "flatbuffers/util.h"
@@ -253,6 +265,33 @@ static const std::vector<
                              "/vendor/etc/aidl/le_audio/"
                              "aidl_audio_set_scenarios.json"}};
 
+/* Cache of the derived settings */
+static const char* kLeAudioAseConfigurationCache =
+    "/data/vendor/bluetooth/le_audio_ase_configuration_settings.cache";
+// Must be incremented whenever the derivation of the settings is changed.
+constexpr uint32_t kLeAudioAseConfigurationCacheVersion = 1;
+constexpr uint32_t kLeAudioAseConfigurationCacheMagic = 0x43414c42;  // "BLAC"
+
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+struct LeAudioAseConfigurationCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t data_size;
+  uint64_t data_hash;
+};
+
+// FNV-1a, unlike std::hash the result is stable across builds.
+static uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+  uint64_t result = seed;
+  for (auto p = static_cast<const uint8_t*>(data); size > 0; ++p, --size) {
+    result = (result ^ *p) * kFnvPrime;
+  }
+  return result;
+}
+
 /* Implementation */
 
 std::vector<LeAudioAseConfigurationSetting>
@@ -263,13 +302,21 @@ AudioSetConfigurationProviderJson::GetLeAudioAseConfigurationSettings() {
 
 void AudioSetConfigurationProviderJson::
     LoadAudioSetConfigurationProviderJson() {
-  if (configurations_.empty() || ase_configuration_settings_.empty()) {
-    ase_configuration_settings_.clear();
+  // 'configurations_' is only needed while the settings are derived, it stays
+  // empty when the settings are loaded from the cache.
+  if (ase_configuration_settings_.empty()) {
     configurations_.clear();
+    const uint64_t cache_key = GetCacheKey(
+        kLeAudioSetConfigs, kLeAudioSetScenarios, CodecLocation::HOST);
+    if (LoadCachedSettings(cache_key)) return;
+    ase_configuration_settings_.clear();
     auto loaded = LoadContent(kLeAudioSetConfigs, kLeAudioSetScenarios,
                               CodecLocation::HOST);
-    if (!loaded)
+    if (!loaded) {
       LOG(ERROR) << ": Unable to load le audio set configuration files.";
+    } else if (!ase_configuration_settings_.empty()) {
+      StoreCachedSettings(cache_key);
+    }
   } else
     LOG(INFO) << ": Reusing loaded le audio set configuration";
 }
@@ -737,6 +784,141 @@ bool AudioSetConfigurationProviderJson::LoadScenariosFromFiles(
   return true;
 }
 
+uint64_t AudioSetConfigurationProviderJson::GetCacheKey(
+    const std::vector<std::pair<const char* /*schema*/,
+                                const char* /*content*/>>& config_files,
+    const std::vector<std::pair<const char* /*schema*/,
+                                const char* /*content*/>>& scenario_files,
+    CodecLocation location) {
+  uint64_t key =
+      HashBytes(&kLeAudioAseConfigurationCacheVersion,
+                sizeof(kLeAudioAseConfigurationCacheVersion), kFnvOffsetBasis);
+  key = HashBytes(&location, sizeof(location), key);
+  // Any OTA may change both the derivation code and the files.
+  const std::string fingerprint =
+      ::android::base::GetProperty("ro.vendor.build.fingerprint", "");
+  key = HashBytes(fingerprint.data(), fingerprint.size(), key);
+  for (const auto* files : {&config_files, &scenario_files}) {
+    for (auto [schema, content] : *files) {
+      for (const char* file : {schema, content}) {
+        std::string data;
+        if (!::android::base::ReadFileToString(file, &data)) {
+          LOG(WARNING) << __func__ << ": can not read " << file
+                       << ", cache disabled";
+          return 0;
+        }
+        key = HashBytes(file, strlen(file), key);
+        key = HashBytes(data.data(), data.size(), key);
+      }
+    }
+  }
+  return key != 0 ? key : 1;
+}
+
+bool AudioSetConfigurationProviderJson::LoadCachedSettings(uint64_t key) {
+  if (key == 0) return false;
+  ::android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+      open(kLeAudioAseConfigurationCache, O_RDONLY | O_CLOEXEC)));
+  if (fd.get() < 0) {
+    LOG(DEBUG) << __func__ << ": no cache at " << kLeAudioAseConfigurationCache;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd.get(), &st) != 0 ||
+      st.st_size <
+          static_cast<off_t>(sizeof(LeAudioAseConfigurationCacheHeader))) {
+    LOG(WARNING) << __func__ << ": invalid cache file";
+    return false;
+  }
+  const size_t file_size = static_cast<size_t>(st.st_size);
+  void* mapping =
+      mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    PLOG(WARNING) << __func__ << ": failed to map the cache file";
+    return false;
+  }
+  auto unmap = ::android::base::make_scope_guard(
+      [&] { munmap(mapping, file_size); });
+  LeAudioAseConfigurationCacheHeader header;
+  memcpy(&header, mapping, sizeof(header));
+  const uint8_t* data = static_cast<const uint8_t*>(mapping) + sizeof(header);
+  if (header.magic != kLeAudioAseConfigurationCacheMagic ||
+      header.version != kLeAudioAseConfigurationCacheVersion ||
+      header.key != key || header.data_size != file_size - sizeof(header)) {
+    LOG(INFO) << __func__ << ": cache is out of date";
+    return false;
+  }
+  if (header.data_hash != HashBytes(data, header.data_size, kFnvOffsetBasis)) {
+    LOG(WARNING) << __func__ << ": cache is corrupted";
+    return false;
+  }
+  ndk::ScopedAParcel parcel(AParcel_create());
+  if (AParcel_unmarshal(parcel.get(), data, header.data_size) != STATUS_OK) {
+    LOG(WARNING) << __func__ << ": failed to unmarshal the cache";
+    return false;
+  }
+  AParcel_setDataPosition(parcel.get(), 0);
+  std::vector<LeAudioAseConfigurationSetting> settings;
+  if (::ndk::AParcel_readVector(parcel.get(), &settings) != STATUS_OK ||
+      settings.empty()) {
+    LOG(WARNING) << __func__ << ": failed to read the settings from the cache";
+    return false;
+  }
+  ase_configuration_settings_ = std::move(settings);
+  LOG(INFO) << __func__ << ": loaded " << ase_configuration_settings_.size()
+            << " le audio set configurations from the cache";
+  return true;
+}
+
+void AudioSetConfigurationProviderJson::StoreCachedSettings(uint64_t key) {
+  if (key == 0) return;
+  ndk::ScopedAParcel parcel(AParcel_create());
+  if (::ndk::AParcel_writeVector(parcel.get(), ase_configuration_settings_) !=
+      STATUS_OK) {
+    LOG(WARNING) << __func__ << ": failed to write the settings";
+    return;
+  }
+  const size_t data_size = AParcel_getDataSize(parcel.get());
+  std::vector<uint8_t> buffer(sizeof(LeAudioAseConfigurationCacheHeader) +
+                              data_size);
+  uint8_t* data = buffer.data() + sizeof(LeAudioAseConfigurationCacheHeader);
+  if (AParcel_marshal(parcel.get(), data, 0, data_size) != STATUS_OK) {
+    LOG(WARNING) << __func__ << ": failed to marshal the settings";
+    return;
+  }
+  const LeAudioAseConfigurationCacheHeader header{
+      .magic = kLeAudioAseConfigurationCacheMagic,
+      .version = kLeAudioAseConfigurationCacheVersion,
+      .key = key,
+      .data_size = data_size,
+      .data_hash = HashBytes(data, data_size, kFnvOffsetBasis)};
+  memcpy(buffer.data(), &header, sizeof(header));
+
+  // Write into a temporary file first, so that a concurrent or interrupted
+  // write never leaves a partially written cache.
+  const std::string temp_path =
+      std::string(kLeAudioAseConfigurationCache) + ".tmp";
+  {
+    ::android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+        open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0660)));
+    if (fd.get() < 0 ||
+        !::android::base::WriteFully(fd.get(), buffer.data(),
+                                     buffer.size()) ||
+        fsync(fd.get()) != 0) {
+      PLOG(WARNING) << __func__ << ": failed to write " << temp_path;
+      unlink(temp_path.c_str());
+      return;
+    }
+  }
+  if (rename(temp_path.c_str(), kLeAudioAseConfigurationCache) != 0) {
+    PLOG(WARNING) << __func__ << ": failed to rename " << temp_path;
+    unlink(temp_path.c_str());
+    return;
+  }
+  LOG(DEBUG) << __func__ << ": stored " << data_size << " bytes";
+}
+
 bool AudioSetConfigurationProviderJson::LoadContent(
     std::vector<std::pair<const char* /*schema*/, const char* /*content*/>>
         config_files,
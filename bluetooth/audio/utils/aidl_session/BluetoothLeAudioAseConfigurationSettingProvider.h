@@ -116,6 +116,21 @@ class AudioSetConfigurationProviderJson {
       std::vector<std::pair<const char* /*schema*/, const char* /*content*/>>
           scenario_files,
       CodecLocation location);
+
+  // The derived settings are cached in a file, as a parcel written after a
+  // header, so that the files are not parsed on every start. The cache is
+  // memory mapped for reading, and only used when its key matches. The key is
+  // a hash of the contents of the files, the codec location, the vendor build
+  // fingerprint and the version of the cache format. All the failures are non
+  // fatal, the settings are derived from the files then.
+  static uint64_t GetCacheKey(
+      const std::vector<std::pair<const char* /*schema*/,
+                                  const char* /*content*/>>& config_files,
+      const std::vector<std::pair<const char* /*schema*/,
+                                  const char* /*content*/>>& scenario_files,
+      CodecLocation location);
+  static bool LoadCachedSettings(uint64_t key);
+  static void StoreCachedSettings(uint64_t key);
 };
 
 }  // namespace audio
@@ -96,16 +96,16 @@ size_t H4Protocol::OnPacketReady(const std::vector<uint8_t>& packet) {
 }
 
 void H4Protocol::SendDataToPacketizer(uint8_t* buffer, size_t length) {
-  std::vector<uint8_t> input_buffer{buffer, buffer + length};
+  // Packets are assembled straight from the read buffer, so the only copy
+  // between the UART and the callbacks is into the packetizer's packet.
   size_t buffer_offset = 0;
-  while (buffer_offset < input_buffer.size()) {
+  while (buffer_offset < length) {
     if (hci_packet_type_ == PacketType::UNKNOWN) {
-      hci_packet_type_ =
-          static_cast<PacketType>(input_buffer.data()[buffer_offset]);
+      hci_packet_type_ = static_cast<PacketType>(buffer[buffer_offset]);
       buffer_offset += 1;
     } else {
-      bool packet_ready = hci_packetizer_.OnDataReady(
-          hci_packet_type_, input_buffer, &buffer_offset);
+      bool packet_ready = hci_packetizer_.OnDataReady(hci_packet_type_, buffer,
+                                                      length, &buffer_offset);
       if (packet_ready) {
         // Call packet callback.
         OnPacketReady(hci_packetizer_.GetPacket());
@@ -120,9 +120,8 @@ void H4Protocol::OnDataReady() {
   if (disconnected_) {
     return;
   }
-  uint8_t buffer[kMaxPacketLength];
-  ssize_t bytes_read =
-      TEMP_FAILURE_RETRY(read(uart_fd_, buffer, kMaxPacketLength));
+  ssize_t bytes_read = TEMP_FAILURE_RETRY(
+      read(uart_fd_, read_buffer_.data(), read_buffer_.size()));
   if (bytes_read == 0) {
     ALOGI("No bytes read, calling the disconnect callback");
     disconnected_ = true;
@@ -133,7 +132,7 @@ void H4Protocol::OnDataReady() {
     ALOGW("error reading from UART (%s)", strerror(errno));
     return;
   }
-  SendDataToPacketizer(buffer, bytes_read);
+  SendDataToPacketizer(read_buffer_.data(), bytes_read);
 }
 
 }  // namespace android::hardware::bluetooth::hci
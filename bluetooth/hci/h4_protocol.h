@@ -63,6 +63,8 @@ class H4Protocol {
    * ACL max length is 2 bytes, so using 64K as the buffer length.
    */
   static constexpr size_t kMaxPacketLength = 64 * 1024;
+  // Reused by every read, rather than taking 64K of stack each time.
+  std::vector<uint8_t> read_buffer_ = std::vector<uint8_t>(kMaxPacketLength);
 };
 
 }  // namespace android::hardware::bluetooth::hci
@@ -49,11 +49,10 @@ size_t HciGetPacketLengthForType(PacketType type,
 
 const std::vector<uint8_t>& HciPacketizer::GetPacket() const { return packet_; }
 
-bool HciPacketizer::OnDataReady(PacketType packet_type,
-                                const std::vector<uint8_t>& buffer,
-                                size_t* offset) {
+bool HciPacketizer::OnDataReady(PacketType packet_type, const uint8_t* buffer,
+                                size_t length, size_t* offset) {
   bool packet_completed = false;
-  size_t bytes_available = buffer.size() - *offset;
+  size_t bytes_available = length - *offset;
 
   switch (state_) {
     case HCI_HEADER: {
@@ -65,8 +64,8 @@ bool HciPacketizer::OnDataReady(PacketType packet_type,
       }
 
       size_t bytes_to_copy = std::min(bytes_remaining_, bytes_available);
-      packet_.insert(packet_.end(), buffer.begin() + *offset,
-                     buffer.begin() + *offset + bytes_to_copy);
+      packet_.insert(packet_.end(), buffer + *offset,
+                     buffer + *offset + bytes_to_copy);
       bytes_remaining_ -= bytes_to_copy;
       bytes_available -= bytes_to_copy;
       *offset += bytes_to_copy;
@@ -75,8 +74,11 @@ bool HciPacketizer::OnDataReady(PacketType packet_type,
         bytes_remaining_ = HciGetPacketLengthForType(packet_type, packet_);
         if (bytes_remaining_ > 0) {
           state_ = HCI_PAYLOAD;
+          // Grow once for the whole payload instead of for every chunk.
+          packet_.reserve(packet_.size() + bytes_remaining_);
           if (bytes_available > 0) {
-            packet_completed = OnDataReady(packet_type, buffer, offset);
+            packet_completed =
+                OnDataReady(packet_type, buffer, length, offset);
           }
         } else {
           packet_completed = true;
@@ -87,8 +89,8 @@ bool HciPacketizer::OnDataReady(PacketType packet_type,
 
     case HCI_PAYLOAD: {
       size_t bytes_to_copy = std::min(bytes_remaining_, bytes_available);
-      packet_.insert(packet_.end(), buffer.begin() + *offset,
-                     buffer.begin() + *offset + bytes_to_copy);
+      packet_.insert(packet_.end(), buffer + *offset,
+                     buffer + *offset + bytes_to_copy);
       bytes_remaining_ -= bytes_to_copy;
       *offset += bytes_to_copy;
       if (bytes_remaining_ == 0) {
@@ -27,8 +27,12 @@ namespace android::hardware::bluetooth::hci {
 class HciPacketizer {
  public:
   HciPacketizer() = default;
-  bool OnDataReady(PacketType packet_type, const std::vector<uint8_t>& data,
+  // Consumes bytes of data from *offset on, up to the end of the current
+  // packet. Returns true when the packet is complete.
+  bool OnDataReady(PacketType packet_type, const uint8_t* data, size_t length,
                    size_t* offset);
+  // The packet stays valid until the next call to OnDataReady(). Its storage
+  // is reused across packets.
   const std::vector<uint8_t>& GetPacket() const;
 
  protected:
@@ -46,6 +46,9 @@ inline constexpr std::chrono::milliseconds kSeekDelayTimeMs = 200ms;
 inline constexpr std::chrono::milliseconds kStepDelayTimeMs = 100ms;
 inline constexpr std::chrono::milliseconds kTuneDelayTimeMs = 150ms;
 inline constexpr std::chrono::seconds kListDelayTimeS = 1s;
+// Bounds the size of a single program list update, to stay well under the binder transaction
+// limit however many programs there are.
+inline constexpr size_t kProgramListChunkSize = 64;
 
 // clang-format off
 const AmFmBandRange kFmFullBandRange = {65000, 108000, 10, 0};
@@ -112,6 +115,20 @@ bool isProgramInBand(const ProgramSelector& sel,
     return isDigitalProgramAllowed(sel, forceAnalogFm, forceAnalogAm);
 }
 
+// Channel of a program when skipping sub-channels, as the type and value of its AM/FM frequency
+// or DAB SId. Programs with neither are not part of any channel.
+using Channel = std::pair<IdentifierType, uint32_t>;
+
+std::optional<Channel> getChannel(const ProgramSelector& sel) {
+    if (utils::hasAmFmFrequency(sel)) {
+        return Channel(IdentifierType::AMFM_FREQUENCY_KHZ, utils::getAmFmFrequency(sel));
+    }
+    if (utils::hasId(sel, IdentifierType::DAB_SID_EXT)) {
+        return Channel(IdentifierType::DAB_SID_EXT, utils::getDabSId(sel));
+    }
+    return std::nullopt;
+}
+
 // Makes ProgramInfo that does not point to any particular program
 ProgramInfo makeSampleProgramInfo(const ProgramSelector& selector) {
     ProgramInfo info = {};
@@ -261,6 +278,7 @@ ScopedAStatus BroadcastRadio::setTunerCallback(const std::shared_ptr<ITunerCallb
 
     lock_guard<mutex> lk(mMutex);
     mCallback = callback;
+    mSentProgramList.reset();
 
     return ScopedAStatus::ok();
 }
@@ -270,6 +288,7 @@ ScopedAStatus BroadcastRadio::unsetTunerCallback() {
 
     lock_guard<mutex> lk(mMutex);
     mCallback = nullptr;
+    mSentProgramList.reset();
 
     return ScopedAStatus::ok();
 }
@@ -340,54 +359,87 @@ ScopedAStatus BroadcastRadio::tune(const ProgramSelector& program) {
     return ScopedAStatus::ok();
 }
 
+void BroadcastRadio::updateProgramListLocked() {
+    auto key = std::make_pair(mCurrentAmFmBandRange, mConfigFlagValues);
+    if (mProgramListKey == key) {
+        return;
+    }
+    mProgramListKey = key;
+
+    // Sorting the indices keeps the programs in the order of the virtual radio list.
+    vector<size_t> indices;
+    mVirtualRadio.getProgramsInBand(mCurrentAmFmBandRange, &indices);
+    std::sort(indices.begin(), indices.end());
+    const auto& list = mVirtualRadio.getProgramList();
+    bool forceAnalogFm = isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_FM);
+    bool forceAnalogAm = isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_AM);
+    mProgramList.clear();
+    for (size_t index : indices) {
+        if (isProgramInBand(list[index].selector, mCurrentAmFmBandRange, forceAnalogFm,
+                            forceAnalogAm)) {
+            mProgramList.push_back(list[index]);
+        }
+    }
+
+    const size_t size = mProgramList.size();
+    vector<std::optional<Channel>> channels(size);
+    for (size_t i = 0; i < size; i++) {
+        channels[i] = getChannel(mProgramList[i].selector);
+    }
+    mChannelBounds.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        bool sameChannel = i > 0 && channels[i].has_value() && channels[i] == channels[i - 1];
+        mChannelBounds[i].first = sameChannel ? mChannelBounds[i - 1].first : i;
+    }
+    for (size_t i = size; i-- > 0;) {
+        bool sameChannel =
+                i + 1 < size && channels[i].has_value() && channels[i] == channels[i + 1];
+        mChannelBounds[i].second = sameChannel ? mChannelBounds[i + 1].second : i;
+    }
+}
+
 bool BroadcastRadio::findNextLocked(const ProgramSelector& current, bool directionUp,
                                     bool skipSubChannel, VirtualProgram* nextProgram) const {
     if (mProgramList.empty()) {
         return false;
     }
+    const size_t size = mProgramList.size();
     // The list is not sorted here since it has already stored in VirtualRadio.
-    bool hasAmFmFrequency = utils::hasAmFmFrequency(current);
-    bool hasDabSId = utils::hasId(current, IdentifierType::DAB_SID_EXT);
-    uint32_t currentChannel =
-            hasAmFmFrequency ? utils::getAmFmFrequency(current) : utils::getDabSId(current);
-    auto found =
-            std::lower_bound(mProgramList.begin(), mProgramList.end(), VirtualProgram({current}));
+    std::optional<Channel> currentChannel = getChannel(current);
+    size_t found = std::lower_bound(mProgramList.begin(), mProgramList.end(),
+                                    VirtualProgram({current})) -
+                   mProgramList.begin();
     if (directionUp) {
-        if (found < mProgramList.end() - 1) {
+        if (found < size - 1) {
             // When seeking up, tuner will jump to the first selector which is main program service
             // greater than and of the same band as the current program selector in the program
             // list (if not exist, jump to the first selector in the same band) for skipping
             // sub-channels case or AM/FM without HD radio enabled case. Otherwise, the tuner will
             // jump to the first selector which is greater than and of the same band as the current
             // program selector.
-            if (utils::tunesTo(current, found->selector)) found++;
-            if (skipSubChannel) {
-                if (hasAmFmFrequency || hasDabSId) {
-                    auto firstFound = found;
-                    while ((hasAmFmFrequency &&
-                            utils::getAmFmFrequency(found->selector) == currentChannel) ||
-                           (hasDabSId && utils::getDabSId(found->selector) == currentChannel)) {
-                        if (found < mProgramList.end() - 1) {
-                            found++;
-                        } else {
-                            found = mProgramList.begin();
-                        }
-                        if (found == firstFound) {
-                            // Only one main channel exists in the program list, the tuner cannot
-                            // skip sub-channel to the next program selector.
-                            return false;
-                        }
-                    }
+            if (utils::tunesTo(current, mProgramList[found].selector)) found++;
+            if (skipSubChannel && currentChannel.has_value() &&
+                getChannel(mProgramList[found].selector) == currentChannel) {
+                if (mChannelBounds[0].second == size - 1) {
+                    // Only one main channel exists in the program list, the tuner cannot skip
+                    // sub-channel to the next program selector.
+                    return false;
+                }
+                // Skip the rest of the current channel, which may continue at the start of the
+                // list when wrapping around.
+                found = (mChannelBounds[found].second + 1) % size;
+                if (getChannel(mProgramList[found].selector) == currentChannel) {
+                    found = mChannelBounds[found].second + 1;
                 }
             }
         } else {
             // If the selector of current program is no less than all selectors of the same band or
             // not found in the program list, seeking up should wrap the tuner to the first program
             // selector of the same band in the program list.
-            found = mProgramList.begin();
+            found = 0;
         }
     } else {
-        if (found > mProgramList.begin() && found != mProgramList.end()) {
+        if (found > 0 && found != size) {
             // When seeking down, tuner will jump to the first selector which is main program
             // service less than and of the same band as the current program selector in the
             // program list (if not exist, jump to the last main program service selector of the
@@ -395,21 +447,14 @@ bool BroadcastRadio::findNextLocked(const ProgramSelector& current, bool directi
             // Otherwise, the tuner will jump to the first selector less than and of the same band
             // as the current program selector.
             found--;
-            if ((hasAmFmFrequency && utils::hasAmFmFrequency(found->selector)) ||
-                (hasDabSId && utils::hasId(found->selector, IdentifierType::DAB_SID_EXT))) {
-                uint32_t nextChannel = hasAmFmFrequency ? utils::getAmFmFrequency(found->selector)
-                                                        : utils::getDabSId(found->selector);
+            std::optional<Channel> nextChannel = getChannel(mProgramList[found].selector);
+            if (currentChannel.has_value() && nextChannel.has_value() &&
+                nextChannel->first == currentChannel->first) {
                 if (nextChannel != currentChannel) {
-                    jumpToFirstSubChannelLocked(found);
+                    found = mChannelBounds[found].first;
                 } else if (skipSubChannel) {
-                    jumpToFirstSubChannelLocked(found);
-                    auto firstFound = found;
-                    if (found > mProgramList.begin()) {
-                        found--;
-                    } else {
-                        found = mProgramList.end() - 1;
-                    }
-                    jumpToFirstSubChannelLocked(found);
+                    size_t firstFound = mChannelBounds[found].first;
+                    found = mChannelBounds[firstFound > 0 ? firstFound - 1 : size - 1].first;
                     if (found == firstFound) {
                         // Only one main channel exists in the program list, the tuner cannot skip
                         // sub-channel to the next program selector.
@@ -423,39 +468,13 @@ bool BroadcastRadio::findNextLocked(const ProgramSelector& current, bool directi
             // selector of the same band in the program list. If the last program selector in the
             // program list is sub-channel and skipping sub-channels is needed, the tuner will jump
             // to the last main program service of the same band in the program list.
-            found = mProgramList.end() - 1;
-            jumpToFirstSubChannelLocked(found);
+            found = mChannelBounds[size - 1].first;
         }
     }
-    *nextProgram = *found;
+    *nextProgram = mProgramList[found];
     return true;
 }
 
-void BroadcastRadio::jumpToFirstSubChannelLocked(vector<VirtualProgram>::const_iterator& it) const {
-    if (it == mProgramList.begin()) {
-        return;
-    }
-    bool hasAmFmFrequency = utils::hasAmFmFrequency(it->selector);
-    bool hasDabSId = utils::hasId(it->selector, IdentifierType::DAB_SID_EXT);
-    if (hasAmFmFrequency || hasDabSId) {
-        uint32_t currentChannel = hasAmFmFrequency ? utils::getAmFmFrequency(it->selector)
-                                                   : utils::getDabSId(it->selector);
-        it--;
-        while (it != mProgramList.begin()) {
-            if (hasAmFmFrequency && utils::hasAmFmFrequency(it->selector) &&
-                utils::getAmFmFrequency(it->selector) == currentChannel) {
-                it--;
-            } else if (hasDabSId && utils::hasId(it->selector, IdentifierType::DAB_SID_EXT) &&
-                       utils::getDabSId(it->selector) == currentChannel) {
-                it--;
-            } else {
-                break;
-            }
-        }
-        it++;
-    }
-}
-
 ScopedAStatus BroadcastRadio::seek(bool directionUp, bool skipSubChannel) {
     LOG(DEBUG) << __func__ << ": seek " << (directionUp ? "up" : "down") << " with skipSubChannel? "
                << (skipSubChannel ? "yes" : "no") << "...";
@@ -469,14 +488,7 @@ ScopedAStatus BroadcastRadio::seek(bool directionUp, bool skipSubChannel) {
 
     cancelLocked();
 
-    auto filterCb = [this](const VirtualProgram& program) {
-        return isProgramInBand(program.selector, mCurrentAmFmBandRange,
-                               isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_FM),
-                               isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_AM));
-    };
-    const auto& list = mVirtualRadio.getProgramList();
-    mProgramList.clear();
-    std::copy_if(list.begin(), list.end(), std::back_inserter(mProgramList), filterCb);
+    updateProgramListLocked();
     std::shared_ptr<ITunerCallback> callback = mCallback;
     auto cancelTask = [callback]() { callback->onTuneFailed(Result::CANCELED, {}); };
 
@@ -583,21 +595,27 @@ ScopedAStatus BroadcastRadio::cancel() {
 }
 
 void BroadcastRadio::startProgramListUpdatesLocked(const ProgramFilter& filter) {
-    auto filterCb = [&filter, this](const VirtualProgram& program) {
-        return utils::satisfies(filter, program.selector) &&
-               isProgramInBand(program.selector, mCurrentAmFmBandRange,
-                               isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_FM),
-                               isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_AM));
-    };
-
     cancelProgramListUpdateLocked();
 
+    bool forceAnalogFm = isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_FM);
+    bool forceAnalogAm = isConfigFlagSetLocked(ConfigFlag::FORCE_ANALOG_AM);
     const auto& list = mVirtualRadio.getProgramList();
-    vector<VirtualProgram> filteredList;
-    std::copy_if(list.begin(), list.end(), std::back_inserter(filteredList), filterCb);
+    vector<size_t> candidates;
+    mVirtualRadio.getProgramsInBand(mCurrentAmFmBandRange, &candidates);
+
+    ProgramListMap programs;
+    for (size_t index : candidates) {
+        const ProgramSelector& sel = list[index].selector;
+        if (!utils::satisfies(filter, sel) ||
+            !isProgramInBand(sel, mCurrentAmFmBandRange, forceAnalogFm, forceAnalogAm)) {
+            continue;
+        }
+        programs.emplace(ProgramKey(sel.primaryId.type, sel.primaryId.value), index);
+    }
 
-    auto task = [this, filteredList]() {
+    auto task = [this, programs = std::move(programs)]() {
         std::shared_ptr<ITunerCallback> callback;
+        vector<ProgramListChunk> chunks;
         {
             lock_guard<mutex> lk(mMutex);
             if (mCallback == nullptr) {
@@ -605,18 +623,67 @@ void BroadcastRadio::startProgramListUpdatesLocked(const ProgramFilter& filter)
                 return;
             }
             callback = mCallback;
+            chunks = makeProgramListChunksLocked(programs);
         }
 
-        ProgramListChunk chunk = {};
-        chunk.purge = true;
-        chunk.complete = true;
-        chunk.modified = vector<ProgramInfo>(filteredList.begin(), filteredList.end());
-
-        callback->onProgramListUpdated(chunk);
+        for (const auto& chunk : chunks) {
+            callback->onProgramListUpdated(chunk);
+        }
     };
     mProgramListThread->schedule(task, kListDelayTimeS);
 }
 
+vector<ProgramListChunk> BroadcastRadio::makeProgramListChunksLocked(
+        const ProgramListMap& programs) {
+    const auto& infos = mVirtualRadio.getProgramInfoList();
+    bool purge = !mSentProgramList.has_value();
+    vector<size_t> modified;
+    vector<ProgramIdentifier> removed;
+    if (purge) {
+        for (const auto& [key, index] : programs) {
+            modified.push_back(index);
+        }
+    } else {
+        for (const auto& [key, index] : programs) {
+            auto sent = mSentProgramList->find(key);
+            if (sent == mSentProgramList->end() || sent->second != index) {
+                modified.push_back(index);
+            }
+        }
+        for (const auto& [key, index] : *mSentProgramList) {
+            if (programs.find(key) == programs.end()) {
+                removed.push_back(infos[index].selector.primaryId);
+            }
+        }
+    }
+    mSentProgramList = programs;
+
+    vector<ProgramListChunk> chunks;
+    size_t modifiedPos = 0;
+    size_t removedPos = 0;
+    do {
+        ProgramListChunk chunk = {};
+        chunk.purge = purge && chunks.empty();
+        size_t modifiedCount = std::min(kProgramListChunkSize, modified.size() - modifiedPos);
+        for (size_t i = 0; i < modifiedCount; i++) {
+            chunk.modified.push_back(infos[modified[modifiedPos++]]);
+        }
+        size_t removedCount =
+                std::min(kProgramListChunkSize - modifiedCount, removed.size() - removedPos);
+        if (removedCount > 0) {
+            chunk.removed = vector<std::optional<ProgramIdentifier>>(
+                    removed.begin() + removedPos, removed.begin() + removedPos + removedCount);
+            removedPos += removedCount;
+        }
+        chunk.complete = modifiedPos == modified.size() && removedPos == removed.size();
+        chunks.push_back(std::move(chunk));
+    } while (!chunks.back().complete);
+
+    LOG(DEBUG) << __func__ << ": " << modified.size() << " modified and " << removed.size()
+               << " removed programs in " << chunks.size() << " chunks, purge = " << purge;
+    return chunks;
+}
+
 ScopedAStatus BroadcastRadio::startProgramListUpdates(const ProgramFilter& filter) {
     LOG(DEBUG) << __func__ << ": requested program list updates, filter = " << filter.toString()
                << "...";
@@ -637,6 +704,8 @@ ScopedAStatus BroadcastRadio::stopProgramListUpdates() {
     LOG(DEBUG) << __func__ << ": requested program list updates to stop...";
     lock_guard<mutex> lk(mMutex);
     cancelProgramListUpdateLocked();
+    // The client drops its list when updates stop.
+    mSentProgramList.reset();
     return ScopedAStatus::ok();
 }
 
@@ -31,7 +31,10 @@
 
 #include <android-base/thread_annotations.h>
 
+#include <map>
 #include <optional>
+#include <utility>
+#include <vector>
 
 namespace aidl::android::hardware::broadcastradio {
 
@@ -69,6 +72,11 @@ class BroadcastRadio final : public BnBroadcastRadio {
     binder_status_t dump(int fd, const char** args, uint32_t numArgs) EXCLUDES(mMutex) override;
 
   private:
+    /** Primary identifier of a program, as its type and value. */
+    using ProgramKey = std::pair<IdentifierType, int64_t>;
+    /** Programs by primary identifier, as indices in the virtual radio program list. */
+    using ProgramListMap = std::map<ProgramKey, size_t>;
+
     const VirtualRadio& mVirtualRadio;
     std::mutex mMutex;
     AmFmRegionConfig mAmFmConfig GUARDED_BY(mMutex);
@@ -79,7 +87,21 @@ class BroadcastRadio final : public BnBroadcastRadio {
     bool mIsTuneCompleted GUARDED_BY(mMutex) = true;
     Properties mProperties GUARDED_BY(mMutex);
     ProgramSelector mCurrentProgram GUARDED_BY(mMutex) = {};
+    /** Programs that can be sought to in the current band, sorted. */
     std::vector<VirtualProgram> mProgramList GUARDED_BY(mMutex) = {};
+    /**
+     * For each program in mProgramList, the first and last index of the run of programs of the
+     * same AM/FM frequency or DAB SId it is part of, so that seeking skips sub-channels without
+     * walking through them.
+     */
+    std::vector<std::pair<size_t, size_t>> mChannelBounds GUARDED_BY(mMutex);
+    /** Band and config flags mProgramList was built for, it is only rebuilt when they change. */
+    std::optional<std::pair<std::optional<AmFmBandRange>, int>> mProgramListKey GUARDED_BY(mMutex);
+    /**
+     * Programs last sent to the callback, updates only carry the difference to them. Empty when
+     * the next update has to start from scratch.
+     */
+    std::optional<ProgramListMap> mSentProgramList GUARDED_BY(mMutex);
     std::optional<AmFmBandRange> mCurrentAmFmBandRange GUARDED_BY(mMutex);
     std::shared_ptr<ITunerCallback> mCallback GUARDED_BY(mMutex);
 
@@ -91,13 +113,14 @@ class BroadcastRadio final : public BnBroadcastRadio {
     ProgramInfo tuneInternalLocked(const ProgramSelector& sel) REQUIRES(mMutex);
     void startProgramListUpdatesLocked(const ProgramFilter& filter) REQUIRES(mMutex);
     void cancelProgramListUpdateLocked() REQUIRES(mMutex);
+    std::vector<ProgramListChunk> makeProgramListChunksLocked(const ProgramListMap& programs)
+            REQUIRES(mMutex);
     void handleProgramInfoUpdateRadioCallback(ProgramInfo programInfo,
                                               const std::shared_ptr<ITunerCallback>& callback)
             EXCLUDES(mMutex);
     bool findNextLocked(const ProgramSelector& current, bool directionUp, bool skipSubChannel,
                         VirtualProgram* nextProgram) const REQUIRES(mMutex);
-    void jumpToFirstSubChannelLocked(std::vector<VirtualProgram>::const_iterator& it) const
-            REQUIRES(mMutex);
+    void updateProgramListLocked() REQUIRES(mMutex);
     bool isConfigFlagSetLocked(ConfigFlag flag) const REQUIRES(mMutex);
 
     binder_status_t cmdHelp(int fd) const;
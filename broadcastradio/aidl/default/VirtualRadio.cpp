@@ -16,6 +16,7 @@
 
 #include "VirtualRadio.h"
 #include <broadcastradio-utils-aidl/Utils.h>
+#include <limits>
 #include <unordered_set>
 
 namespace aidl::android::hardware::broadcastradio {
@@ -30,6 +31,18 @@ using ::std::vector;
 VirtualRadio::VirtualRadio(const string& name, const vector<VirtualProgram>& initialList)
     : mName(name), mPrograms(initialList) {
     sort(mPrograms.begin(), mPrograms.end());
+
+    mProgramInfos.reserve(mPrograms.size());
+    for (size_t i = 0; i < mPrograms.size(); i++) {
+        mProgramInfos.push_back(mPrograms[i]);
+        const auto& selector = mPrograms[i].selector;
+        if (utils::hasAmFmFrequency(selector)) {
+            mAmFmIndex.emplace_back(static_cast<int32_t>(utils::getAmFmFrequency(selector)), i);
+        } else {
+            mNonAmFmIndex.push_back(i);
+        }
+    }
+    sort(mAmFmIndex.begin(), mAmFmIndex.end());
 }
 
 string VirtualRadio::getName() const {
@@ -40,6 +53,26 @@ const vector<VirtualProgram>& VirtualRadio::getProgramList() const {
     return mPrograms;
 }
 
+const vector<ProgramInfo>& VirtualRadio::getProgramInfoList() const {
+    return mProgramInfos;
+}
+
+void VirtualRadio::getProgramsInBand(const std::optional<AmFmBandRange>& band,
+                                     vector<size_t>* indices) const {
+    indices->assign(mNonAmFmIndex.begin(), mNonAmFmIndex.end());
+    if (!band.has_value()) {
+        return;
+    }
+    auto begin = std::lower_bound(mAmFmIndex.begin(), mAmFmIndex.end(),
+                                  std::make_pair(band->lowerBound, size_t{0}));
+    auto end = std::upper_bound(
+            begin, mAmFmIndex.end(),
+            std::make_pair(band->upperBound, std::numeric_limits<size_t>::max()));
+    for (auto it = begin; it != end; it++) {
+        indices->push_back(it->second);
+    }
+}
+
 bool VirtualRadio::getProgram(const ProgramSelector& selector, VirtualProgram* programOut) const {
     for (auto it = mPrograms.begin(); it != mPrograms.end(); it++) {
         if (!utils::tunesTo(selector, it->selector)) {
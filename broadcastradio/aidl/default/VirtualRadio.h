@@ -18,6 +18,9 @@
 
 #include "VirtualProgram.h"
 
+#include <aidl/android/hardware/broadcastradio/AmFmBandRange.h>
+
+#include <optional>
 #include <vector>
 
 namespace aidl::android::hardware::broadcastradio {
@@ -35,6 +38,20 @@ class VirtualRadio final {
     VirtualRadio(const std::string& name, const std::vector<VirtualProgram>& initialList);
     std::string getName() const;
     const std::vector<VirtualProgram>& getProgramList() const;
+    /** Programs converted to ProgramInfo, in the same order as getProgramList(). */
+    const std::vector<ProgramInfo>& getProgramInfoList() const;
+    /**
+     * Looks up the programs that may be in an AM/FM band.
+     *
+     * These are the AM/FM programs with a frequency within the band, and all programs without an
+     * AM/FM frequency. The AM/FM ones are found by binary search, without going through the
+     * whole list.
+     *
+     * @param band Current AM/FM band, or empty if there is none
+     * @param indices Set to the indices of the programs in getProgramList(), in no particular order
+     */
+    void getProgramsInBand(const std::optional<AmFmBandRange>& band,
+                           std::vector<size_t>* indices) const;
     bool getProgram(const ProgramSelector& selector, VirtualProgram* program) const;
     std::vector<IdentifierType> getSupportedIdentifierTypes() const;
 
@@ -44,6 +61,11 @@ class VirtualRadio final {
   private:
     const std::string mName;
     std::vector<VirtualProgram> mPrograms;
+    std::vector<ProgramInfo> mProgramInfos;
+    /** Programs with an AM/FM frequency, as (frequency, index) pairs sorted by frequency. */
+    std::vector<std::pair<int32_t, size_t>> mAmFmIndex;
+    /** Programs without an AM/FM frequency. */
+    std::vector<size_t> mNonAmFmIndex;
 };
 
 }  // namespace aidl::android::hardware::broadcastradio
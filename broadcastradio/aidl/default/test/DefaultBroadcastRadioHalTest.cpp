@@ -501,6 +501,27 @@ TEST_F(DefaultBroadcastRadioHalTest, StartProgramListUpdatesWithAmFmFilter) {
     }
 }
 
+TEST_F(DefaultBroadcastRadioHalTest, StartProgramListUpdatesWithFilterChange) {
+    ProgramFilter amFmFilter = {.identifierTypes = {IdentifierType::AMFM_FREQUENCY_KHZ},
+                                .identifiers = {},
+                                .includeCategories = false,
+                                .excludeModifications = false};
+    switchToFmBand();
+    mTunerCallback->reset();
+    ASSERT_TRUE(mBroadcastRadioHal->startProgramListUpdates({}).isOk());
+    ASSERT_TRUE(mTunerCallback->waitProgramReady());
+
+    // Without stopping, the new filter only sends the difference to the list the client has.
+    auto programList = getProgramList(amFmFilter);
+
+    ASSERT_TRUE(programList.has_value());
+    EXPECT_FALSE(programList->empty());
+    for (auto it = programList->begin(); it != programList->end(); it++) {
+        EXPECT_TRUE(utils::hasId(it->selector, IdentifierType::AMFM_FREQUENCY_KHZ));
+        EXPECT_NE(it->selector.primaryId.type, IdentifierType::HD_STATION_ID_EXT);
+    }
+}
+
 TEST_F(DefaultBroadcastRadioHalTest, StartProgramListUpdatesWhenHdIsDisabled) {
     switchToFmBand();
     mBroadcastRadioHal->setConfigFlag(ConfigFlag::FORCE_ANALOG_FM, /* value= */ true);
@@ -23,6 +23,8 @@
 #include "CameraMetadata.h"
 #include "VendorTagDescriptor.h"
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace camera {
@@ -107,6 +109,34 @@ void CameraMetadata::clear() {
     }
 }
 
+void CameraMetadata::reset() {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return;
+    }
+    if (mBuffer == NULL) {
+        return;
+    }
+    size_t entryCap = get_camera_metadata_entry_capacity(mBuffer);
+    size_t dataCap = get_camera_metadata_data_capacity(mBuffer);
+    metadata_vendor_id_t vendorId = get_camera_metadata_vendor_id(mBuffer);
+    place_camera_metadata(mBuffer, calculate_camera_metadata_size(entryCap, dataCap), entryCap,
+                          dataCap);
+    set_camera_metadata_vendor_id(mBuffer, vendorId);
+}
+
+status_t CameraMetadata::reserve(size_t entryCapacity, size_t dataCapacity) {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    if (mBuffer != NULL && get_camera_metadata_entry_capacity(mBuffer) >= entryCapacity &&
+        get_camera_metadata_data_capacity(mBuffer) >= dataCapacity) {
+        return OK;
+    }
+    return resizeTo(entryCapacity, dataCapacity);
+}
+
 void CameraMetadata::acquire(camera_metadata_t* buffer) {
     if (mLocked) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
@@ -296,14 +326,20 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void* data, size_t data_
 
     size_t data_size = calculate_camera_metadata_entry_data_size(type, data_count);
 
-    res = resizeIfNeeded(1, data_size);
-
-    if (res == OK) {
-        camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
-        if (res == NAME_NOT_FOUND) {
+    // Entry indices survive a resize, as the entries are copied over in order
+    camera_metadata_entry_t entry;
+    res = (mBuffer == NULL) ? NAME_NOT_FOUND : find_camera_metadata_entry(mBuffer, tag, &entry);
+    if (res == NAME_NOT_FOUND) {
+        res = resizeIfNeeded(1, data_size);
+        if (res == OK) {
             res = add_camera_metadata_entry(mBuffer, tag, data, data_count);
-        } else if (res == OK) {
+        }
+    } else if (res == OK) {
+        // An entry keeping its size is overwritten where it is
+        if (data_size != calculate_camera_metadata_entry_data_size(type, entry.count)) {
+            res = resizeIfNeeded(0, data_size);
+        }
+        if (res == OK) {
             res = update_camera_metadata_entry(mBuffer, entry.index, data, data_count, NULL);
         }
     }
@@ -404,19 +440,31 @@ status_t CameraMetadata::resizeIfNeeded(size_t extraEntries, size_t extraData) {
         newDataCount = (newDataCount > currentDataCap) ? newDataCount * 2 : currentDataCap;
 
         if (newEntryCount > currentEntryCap || newDataCount > currentDataCap) {
-            camera_metadata_t* oldBuffer = mBuffer;
-            mBuffer = allocate_camera_metadata(newEntryCount, newDataCount);
-            if (mBuffer == NULL) {
-                ALOGE("%s: Can't allocate larger metadata buffer", __FUNCTION__);
-                return NO_MEMORY;
-            }
-            append_camera_metadata(mBuffer, oldBuffer);
-            free_camera_metadata(oldBuffer);
+            return resizeTo(newEntryCount, newDataCount);
         }
     }
     return OK;
 }
 
+status_t CameraMetadata::resizeTo(size_t entryCapacity, size_t dataCapacity) {
+    camera_metadata_t* oldBuffer = mBuffer;
+    if (oldBuffer != NULL) {
+        entryCapacity = std::max(entryCapacity, get_camera_metadata_entry_capacity(oldBuffer));
+        dataCapacity = std::max(dataCapacity, get_camera_metadata_data_capacity(oldBuffer));
+    }
+    mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
+    if (mBuffer == NULL) {
+        ALOGE("%s: Can't allocate larger metadata buffer", __FUNCTION__);
+        mBuffer = oldBuffer;
+        return NO_MEMORY;
+    }
+    if (oldBuffer != NULL) {
+        append_camera_metadata(mBuffer, oldBuffer);
+        free_camera_metadata(oldBuffer);
+    }
+    return OK;
+}
+
 void CameraMetadata::swap(CameraMetadata& other) {
     if (mLocked) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
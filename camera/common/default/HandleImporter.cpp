@@ -68,7 +68,32 @@ android_ycbcr HandleImporter::lockYCbCr(buffer_handle_t& buf, uint64_t cpuUsage,
     if (!mInitialized) {
         initializeLocked();
     }
-    android_ycbcr layout;
+    android_ycbcr layout = {};
+
+    auto it = mYCbCrOffsets.find(buf);
+    if (it != mYCbCrOffsets.end()) {
+        YCbCrOffsets& offsets = it->second;
+        if (!offsets.queried) {
+            offsets.queried = true;
+            offsets.valid = getYCbCrOffsets(buf, &offsets);
+        }
+        if (offsets.valid) {
+            void* data = nullptr;
+            status_t status = GraphicBufferMapper::get().lock(buf, cpuUsage, accessRegion, &data);
+            if (status != OK) {
+                ALOGE("%s: failed to lock error %d!", __FUNCTION__, status);
+                return layout;
+            }
+            uint8_t* base = static_cast<uint8_t*>(data);
+            layout.y = base + offsets.y;
+            layout.cb = base + offsets.cb;
+            layout.cr = base + offsets.cr;
+            layout.ystride = offsets.ystride;
+            layout.cstride = offsets.cstride;
+            layout.chroma_step = offsets.chromaStep;
+            return layout;
+        }
+    }
 
     status_t status = GraphicBufferMapper::get().lockYCbCr(buf, cpuUsage, accessRegion, &layout);
 
@@ -89,6 +114,58 @@ std::vector<PlaneLayout> getPlaneLayouts(buffer_handle_t& buf) {
     return planeLayouts;
 }
 
+// Follows the conversion of the plane layouts in Gralloc4Mapper::lockYCbCr
+bool HandleImporter::getYCbCrOffsets(buffer_handle_t& buf, YCbCrOffsets* offsets) {
+    std::vector<PlaneLayout> planeLayouts = getPlaneLayouts(buf);
+    bool hasY = false, hasCb = false, hasCr = false;
+    for (const auto& planeLayout : planeLayouts) {
+        for (const auto& component : planeLayout.components) {
+            if (!gralloc4::isStandardPlaneLayoutComponentType(component.type)) {
+                continue;
+            }
+            if (planeLayout.sampleIncrementInBits % 8 != 0) {
+                return false;
+            }
+            size_t offset = planeLayout.offsetInBytes + component.offsetInBits / 8;
+            size_t step = planeLayout.sampleIncrementInBits / 8;
+            switch (static_cast<PlaneLayoutComponentType>(component.type.value)) {
+                case PlaneLayoutComponentType::Y:
+                    if (hasY) {
+                        return false;
+                    }
+                    hasY = true;
+                    offsets->y = offset;
+                    offsets->ystride = planeLayout.strideInBytes;
+                    break;
+                case PlaneLayoutComponentType::CB:
+                case PlaneLayoutComponentType::CR: {
+                    if (step != 1 && step != 2 && step != 4) {
+                        return false;
+                    }
+                    if (!hasCb && !hasCr) {
+                        offsets->cstride = planeLayout.strideInBytes;
+                        offsets->chromaStep = step;
+                    } else if (offsets->cstride != static_cast<size_t>(planeLayout.strideInBytes) ||
+                               offsets->chromaStep != step) {
+                        return false;
+                    }
+                    bool isCb = static_cast<PlaneLayoutComponentType>(component.type.value) ==
+                                PlaneLayoutComponentType::CB;
+                    bool& hasComponent = isCb ? hasCb : hasCr;
+                    if (hasComponent) {
+                        return false;
+                    }
+                    hasComponent = true;
+                    (isCb ? offsets->cb : offsets->cr) = offset;
+                } break;
+                default:
+                    break;
+            }
+        }
+    }
+    return hasY && hasCb && hasCr;
+}
+
 // In IComposer, any buffer_handle_t is owned by the caller and we need to
 // make a clone for hwcomposer2.  We also need to translate empty handle
 // to nullptr.  This function does that, in-place.
@@ -103,7 +180,11 @@ bool HandleImporter::importBuffer(buffer_handle_t& handle) {
         initializeLocked();
     }
 
-    return importBufferInternal(handle);
+    if (!importBufferInternal(handle)) {
+        return false;
+    }
+    mYCbCrOffsets[handle] = YCbCrOffsets();
+    return true;
 }
 
 void HandleImporter::freeBuffer(buffer_handle_t handle) {
@@ -116,6 +197,7 @@ void HandleImporter::freeBuffer(buffer_handle_t handle) {
         initializeLocked();
     }
 
+    mYCbCrOffsets.erase(handle);
     status_t status = GraphicBufferMapper::get().freeBuffer(handle);
     if (status != OK) {
         ALOGE("%s: mapper freeBuffer failed. Status %d", __FUNCTION__, status);
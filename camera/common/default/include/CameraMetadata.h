@@ -86,6 +86,19 @@ class CameraMetadata {
      */
     void clear();
 
+    /**
+     * Remove all entries but keep the storage, so that metadata rebuilt over
+     * and over (such as per-frame results) is only allocated once
+     */
+    void reset();
+
+    /**
+     * Make sure there is space for at least entryCapacity entries and
+     * dataCapacity bytes of data in total, so that later updates up to that
+     * size don't reallocate the buffer
+     */
+    status_t reserve(size_t entryCapacity, size_t dataCapacity);
+
     /**
      * Acquire a raw metadata buffer from the caller. After this call,
      * the caller no longer owns the raw buffer, and must not free or manipulate it.
@@ -126,8 +139,9 @@ class CameraMetadata {
 
     /**
      * Update metadata entry. Will create entry if it doesn't exist already, and
-     * will reallocate the buffer if insufficient space exists. Overloaded for
-     * the various types of valid data.
+     * will reallocate the buffer if insufficient space exists. An existing entry
+     * keeping its size is overwritten in place. Overloaded for the various types
+     * of valid data.
      */
     status_t update(uint32_t tag, const uint8_t* data, size_t data_count);
     status_t update(uint32_t tag, const int32_t* data, size_t data_count);
@@ -208,6 +222,11 @@ class CameraMetadata {
      * Resize metadata buffer if needed by reallocating it and copying it over.
      */
     status_t resizeIfNeeded(size_t extraEntries, size_t extraData);
+
+    /**
+     * Reallocate the metadata buffer with at least the given capacities and copy it over.
+     */
+    status_t resizeTo(size_t entryCapacity, size_t dataCapacity);
 };
 
 }  // namespace helper
@@ -21,6 +21,7 @@
 #include <system/graphics.h>
 #include <ui/Rect.h>
 #include <utils/Mutex.h>
+#include <unordered_map>
 
 namespace android {
 namespace hardware {
@@ -65,11 +66,28 @@ class HandleImporter {
     void initializeLocked();
     void cleanup();
 
+    // The YCbCr planes of a buffer, as offsets from the start of the buffer. They are read
+    // from the plane layouts on the first lockYCbCr of a buffer imported by importBuffer, and
+    // dropped by freeBuffer, so the next locks skip the plane layout metadata query.
+    struct YCbCrOffsets {
+        bool queried = false;
+        // false if the layout is not planar YCbCr, or the mapper has no plane layouts
+        bool valid = false;
+        size_t y = 0;
+        size_t cb = 0;
+        size_t cr = 0;
+        size_t ystride = 0;
+        size_t cstride = 0;
+        size_t chromaStep = 0;
+    };
+
     bool importBufferInternal(buffer_handle_t& handle);
     int unlockInternal(buffer_handle_t& buf);
+    static bool getYCbCrOffsets(buffer_handle_t& buf, YCbCrOffsets* offsets);
 
     Mutex mLock;
     bool mInitialized;
+    std::unordered_map<buffer_handle_t, YCbCrOffsets> mYCbCrOffsets;
 };
 
 }  // namespace helper
@@ -23,6 +23,9 @@
 #include <aidl/android/hardware/camera/common/Status.h>
 #include <convert.h>
 #include <linux/videodev2.h>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <regex>
 #include <set>
 
@@ -46,6 +49,58 @@ constexpr int MAX_RETRY = 5;                  // Allow retry v4l2 open failures
 constexpr int OPEN_RETRY_SLEEP_US = 100'000;  // 100ms * MAX_RETRY = 0.5 seconds
 
 const std::regex kDevicePathRE("/dev/video([0-9]+)");
+
+// Enumerating the formats and frame intervals of a camera takes hundreds of milliseconds, so the
+// characteristics probed from a camera are kept for when the same camera is attached again.
+constexpr size_t kMaxProbedCameras = 16;
+
+struct ProbedCharacteristics {
+    ::android::hardware::camera::common::V1_0::helper::CameraMetadata characteristics;
+    std::vector<SupportedV4L2Format> supportedFormats;
+    CroppingType croppingType;
+};
+
+std::mutex gProbeCacheLock;
+std::map<std::string, ProbedCharacteristics> gProbeCache;
+// Identities in gProbeCache, least recently probed first.
+std::deque<std::string> gProbeCacheOrder;
+
+// Returns the serial number of the USB device the video node belongs to, if any.
+std::string getUsbSerial(const std::string& devicePath) {
+    std::smatch sm;
+    if (!std::regex_match(devicePath, sm, kDevicePathRE)) {
+        return "";
+    }
+    // device/ is the USB interface of the camera, and its parent the USB device.
+    std::string serialPath = "/sys/class/video4linux/video" + sm[1].str() + "/device/../serial";
+    FILE* file = fopen(serialPath.c_str(), "re");
+    if (file == nullptr) {
+        return "";
+    }
+    char serial[128] = {0};
+    if (fgets(serial, sizeof(serial), file) == nullptr) {
+        serial[0] = '\0';
+    }
+    fclose(file);
+    std::string result(serial);
+    while (!result.empty() && isspace(result.back())) {
+        result.pop_back();
+    }
+    return result;
+}
+
+// Identifies the camera behind a video node, so that it is recognized when attached again, on
+// another node or not. Returns an empty string if the camera cannot be identified.
+std::string getCameraIdentity(int fd, const std::string& devicePath) {
+    struct v4l2_capability capability;
+    if (TEMP_FAILURE_RETRY(ioctl(fd, VIDIOC_QUERYCAP, &capability)) < 0) {
+        return "";
+    }
+    return std::string(reinterpret_cast<const char*>(capability.driver)) + "/" +
+           reinterpret_cast<const char*>(capability.card) + "/" +
+           reinterpret_cast<const char*>(capability.bus_info) + "/" +
+           std::to_string(capability.version) + "/" + getUsbSerial(devicePath);
+}
 }  // namespace
 
 std::string ExternalCameraDevice::kDeviceVersion = "1.1";
@@ -276,6 +331,20 @@ status_t ExternalCameraDevice::initCameraCharacteristics() {
         return DEAD_OBJECT;
     }
 
+    const std::string identity = getCameraIdentity(fd.get(), mDevicePath);
+    if (!identity.empty()) {
+        std::lock_guard<std::mutex> lock(gProbeCacheLock);
+        auto it = gProbeCache.find(identity);
+        if (it != gProbeCache.end()) {
+            ALOGV("%s: reusing the characteristics probed from %s", __FUNCTION__,
+                  identity.c_str());
+            mCameraCharacteristics = it->second.characteristics;
+            mSupportedFormats = it->second.supportedFormats;
+            mCroppingType = it->second.croppingType;
+            return OK;
+        }
+    }
+
     status_t ret;
     ret = initDefaultCharsKeys(&mCameraCharacteristics);
     if (ret != OK) {
@@ -305,6 +374,17 @@ status_t ExternalCameraDevice::initCameraCharacteristics() {
         return ret;
     }
 
+    if (!identity.empty()) {
+        std::lock_guard<std::mutex> lock(gProbeCacheLock);
+        if (gProbeCache.count(identity) == 0) {
+            gProbeCacheOrder.push_back(identity);
+            if (gProbeCacheOrder.size() > kMaxProbedCameras) {
+                gProbeCache.erase(gProbeCacheOrder.front());
+                gProbeCacheOrder.pop_front();
+            }
+        }
+        gProbeCache[identity] = {mCameraCharacteristics, mSupportedFormats, mCroppingType};
+    }
     return OK;
 }
 
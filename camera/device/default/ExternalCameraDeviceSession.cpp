@@ -35,8 +35,11 @@
 #include <aidlcommonsupport/NativeHandle.h>
 #include <convert.h>
 #include <linux/videodev2.h>
+#include <pthread.h>
 #include <sync/sync.h>
+#include <sys/resource.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <deque>
 
 #define HAVE_JPEG  // required for libyuv.h to export MJPEG decode APIs
@@ -53,6 +56,8 @@ namespace {
 
 // Size of request/result metadata fast message queue. Change to 0 to always use hwbinder buffer.
 static constexpr size_t kMetadataMsgQueueSize = 1 << 18 /* 256kB */;
+// Results the result metadata queue holds at least
+static constexpr size_t kResultMetadataQueueDepth = 32;
 
 const int kBadFramesAfterStreamOn = 1;  // drop x frames after streamOn to get rid of some initial
                                         // bad frames. TODO: develop a better bad frame detection
@@ -61,6 +66,12 @@ constexpr int MAX_RETRY = 15;  // Allow retry some ioctl failures a few times to
                                // webcam showing temporarily ioctl failures.
 constexpr int IOCTL_RETRY_SLEEP_US = 33000;  // 33ms * MAX_RETRY = 0.5 seconds
 
+// Bounds of the adaptive V4L2 buffer count
+constexpr int kMinV4L2BufferCount = 2;
+constexpr int kMaxV4L2BufferCountAdjust = 4;
+// Stream configurations with fewer frames do not change the buffer count
+constexpr uint64_t kMinFramesForBufferCountAdjust = 90;
+
 // Constants for tryLock during dumpstate
 static constexpr int kDumpLockRetries = 50;
 static constexpr int kDumpLockSleep = 60000;
@@ -123,7 +134,8 @@ ExternalCameraDeviceSession::ExternalCameraDeviceSession(
       mCameraId(cameraId),
       mV4l2Fd(std::move(v4l2Fd)),
       mMaxThumbResolution(getMaxThumbResolution()),
-      mMaxJpegResolution(getMaxJpegResolution()) {}
+      mMaxJpegResolution(getMaxJpegResolution()),
+      mResultTemplate(chars) {}
 
 Size ExternalCameraDeviceSession::getMaxThumbResolution() const {
     return getMaxThumbnailResolution(mCameraCharacteristics);
@@ -179,6 +191,8 @@ bool ExternalCameraDeviceSession::initialize() {
         return true;
     }
     mOutputThread->setExifMakeModel(mExifMake, mExifModel);
+    mOutputThread->setMjpegDecoder(
+            MjpegDecoder::create(mCfg.mjpegDecoderType, mCfg.mjpegDecoderDevice));
 
     status_t status = initDefaultRequests();
     if (status != OK) {
@@ -193,8 +207,21 @@ bool ExternalCameraDeviceSession::initialize() {
         return true;
     }
 
-    mResultMetadataQueue =
-            std::make_shared<ResultMetadataQueue>(kMetadataMsgQueueSize, false /* non blocking */);
+    // A result is the settings of its request with a few more tags, the result queue is sized
+    // from the results of the default requests
+    size_t maxResultSize = 0;
+    for (const auto& [type, request] : mDefaultRequests) {
+        common::V1_0::helper::CameraMetadata settings;
+        settings = reinterpret_cast<const camera_metadata_t*>(request.metadata.data());
+        std::vector<uint8_t> result;
+        if (mResultTemplate.fill(settings, ANDROID_CONTROL_AF_STATE_INACTIVE, 0, &result) == OK) {
+            maxResultSize = std::max(maxResultSize, result.size());
+        }
+    }
+    mResultMetadataQueue = std::make_shared<ResultMetadataQueue>(
+            getResultMetadataQueueSize(maxResultSize, kResultMetadataQueueDepth,
+                                       kMetadataMsgQueueSize),
+            false /* non blocking */);
     if (!mResultMetadataQueue->isValid()) {
         ALOGE("%s: invalid result fmq", __FUNCTION__);
         return true;
@@ -845,12 +872,18 @@ Status ExternalCameraDeviceSession::switchToOffline(
         afTrigger = mAfTrigger;
     }
 
+    size_t maxResultSize;
+    {
+        Mutex::Autolock _l(mProcessCaptureResultLock);
+        maxResultSize = mResultMetadataStats.maxResultSize;
+    }
+
     std::shared_ptr<ExternalCameraOfflineSession> sessionImpl =
             ndk::SharedRefBase::make<ExternalCameraOfflineSession>(
                     mCroppingType, mCameraCharacteristics, mCameraId, mExifMake, mExifModel,
                     mBlobBufferSize, afTrigger, streamInfos, offlineReqs, circulatingBuffers);
 
-    bool initFailed = sessionImpl->initialize();
+    bool initFailed = sessionImpl->initialize(maxResultSize);
     if (initFailed) {
         ALOGE("%s: offline session initialize failed!", __FUNCTION__);
         return Status::INTERNAL_ERROR;
@@ -1018,7 +1051,8 @@ status_t ExternalCameraDeviceSession::initDefaultRequests() {
 }
 
 status_t ExternalCameraDeviceSession::fillCaptureResult(common::V1_0::helper::CameraMetadata& md,
-                                                        nsecs_t timestamp) {
+                                                        nsecs_t timestamp,
+                                                        std::vector<uint8_t>* out) {
     bool afTrigger = false;
     {
         std::lock_guard<std::mutex> lk(mAfTriggerLock);
@@ -1042,12 +1076,8 @@ status_t ExternalCameraDeviceSession::fillCaptureResult(common::V1_0::helper::Ca
     } else {
         afState = ANDROID_CONTROL_AF_STATE_INACTIVE;
     }
-    UPDATE(md, ANDROID_CONTROL_AF_STATE, &afState, 1);
-
-    camera_metadata_ro_entry activeArraySize =
-            mCameraCharacteristics.find(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE);
 
-    return fillCaptureResultCommon(md, timestamp, activeArraySize);
+    return mResultTemplate.fill(md, afState, timestamp, out);
 }
 
 int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Format& v4l2Fmt,
@@ -1135,6 +1165,8 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
     }
 
     uint32_t v4lBufferCount = (fps >= kDefaultFps) ? mCfg.numVideoBuffers : mCfg.numStillBuffers;
+    v4lBufferCount = std::max(static_cast<int>(v4lBufferCount) + mV4l2BufferCountAdjust,
+                              kMinV4L2BufferCount);
 
     // VIDIOC_REQBUFS: create buffers
     v4l2_requestbuffers req_buffers{};
@@ -1208,7 +1240,14 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
         }
     }
 
-    ALOGI("%s: start V4L2 streaming %dx%d@%ffps", __FUNCTION__, v4l2Fmt.width, v4l2Fmt.height, fps);
+    {
+        std::lock_guard<std::mutex> lk(mV4l2BufferLock);
+        mV4l2QueueStats = V4l2QueueStats();
+        mV4l2QueueStats.inflightCounts.resize(mV4L2BufferCount);
+    }
+
+    ALOGI("%s: start V4L2 streaming %dx%d@%ffps with %zu buffers", __FUNCTION__, v4l2Fmt.width,
+          v4l2Fmt.height, fps, mV4L2BufferCount);
     mV4l2StreamingFmt = v4l2Fmt;
     mV4l2Streaming = true;
     return OK;
@@ -1225,7 +1264,9 @@ std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(n
     {
         std::unique_lock<std::mutex> lk(mV4l2BufferLock);
         if (mNumDequeuedV4l2Buffers == mV4L2BufferCount) {
+            nsecs_t waitStart = systemTime(SYSTEM_TIME_MONOTONIC);
             int waitRet = waitForV4L2BufferReturnLocked(lk);
+            mV4l2QueueStats.bufferReturnWait.add(systemTime(SYSTEM_TIME_MONOTONIC) - waitStart);
             if (waitRet != 0) {
                 return ret;
             }
@@ -1233,6 +1274,7 @@ std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(n
     }
 
     ATRACE_BEGIN("VIDIOC_DQBUF");
+    nsecs_t dequeueStart = systemTime(SYSTEM_TIME_MONOTONIC);
     v4l2_buffer buffer{};
     buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buffer.memory = V4L2_MEMORY_MMAP;
@@ -1240,6 +1282,7 @@ std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(n
         ALOGE("%s: DQBUF fails: %s", __FUNCTION__, strerror(errno));
         return ret;
     }
+    nsecs_t dequeueWait = systemTime(SYSTEM_TIME_MONOTONIC) - dequeueStart;
     ATRACE_END();
 
     if (buffer.index >= mV4L2BufferCount) {
@@ -1269,6 +1312,20 @@ std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(n
 
     {
         std::lock_guard<std::mutex> lk(mV4l2BufferLock);
+        V4l2QueueStats& stats = mV4l2QueueStats;
+        stats.dequeueWait.add(dequeueWait);
+        if (mNumDequeuedV4l2Buffers < stats.inflightCounts.size()) {
+            stats.inflightCounts[mNumDequeuedV4l2Buffers]++;
+        }
+        stats.frames++;
+        if (buffer.flags & V4L2_BUF_FLAG_ERROR) {
+            stats.errorFrames++;
+        }
+        if (stats.hasSequence && buffer.sequence > stats.lastSequence) {
+            stats.droppedFrames += buffer.sequence - stats.lastSequence - 1;
+        }
+        stats.hasSequence = true;
+        stats.lastSequence = buffer.sequence;
         mNumDequeuedV4l2Buffers++;
     }
 
@@ -1420,6 +1477,7 @@ int ExternalCameraDeviceSession::v4l2StreamOffLocked() {
             return -1;
         }
     }
+    updateV4l2BufferCountAdjustLocked();
     mV4L2BufferCount = 0;
 
     // VIDIOC_STREAMOFF
@@ -1523,22 +1581,8 @@ void ExternalCameraDeviceSession::invokeProcessCaptureResultCallback(
             return;
         }
     }
-    if (tryWriteFmq && mResultMetadataQueue->availableToWrite() > 0) {
-        for (CaptureResult& result : results) {
-            CameraMetadata& md = result.result;
-            if (!md.metadata.empty()) {
-                if (mResultMetadataQueue->write(reinterpret_cast<int8_t*>(md.metadata.data()),
-                                                md.metadata.size())) {
-                    result.fmqResultSize = md.metadata.size();
-                    md.metadata.resize(0);
-                } else {
-                    ALOGW("%s: couldn't utilize fmq, fall back to hwbinder", __FUNCTION__);
-                    result.fmqResultSize = 0;
-                }
-            } else {
-                result.fmqResultSize = 0;
-            }
-        }
+    if (tryWriteFmq) {
+        writeResultMetadataToFmq(*mResultMetadataQueue, results, &mResultMetadataStats);
     }
     auto status = mCallback->processCaptureResult(results);
     if (!status.isOk()) {
@@ -1567,6 +1611,73 @@ int ExternalCameraDeviceSession::waitForV4L2BufferReturnLocked(std::unique_lock<
     return 0;
 }
 
+void ExternalCameraDeviceSession::updateV4l2BufferCountAdjustLocked() {
+    std::lock_guard<std::mutex> lk(mV4l2BufferLock);
+    const V4l2QueueStats& stats = mV4l2QueueStats;
+    if (stats.frames < kMinFramesForBufferCountAdjust) {
+        return;
+    }
+
+    // The most buffers the HAL held when a frame was dequeued
+    size_t maxInflight = 0;
+    for (size_t i = 0; i < stats.inflightCounts.size(); i++) {
+        if (stats.inflightCounts[i] != 0) {
+            maxInflight = i;
+        }
+    }
+
+    int adjust = mV4l2BufferCountAdjust;
+    // Frames were lost, or the output thread waited for its own buffers: more buffers let the
+    // driver and the HAL absorb the jitter of each other
+    if (stats.droppedFrames * 100 > stats.frames ||
+        stats.bufferReturnWait.count * 20 > stats.frames) {
+        adjust++;
+    } else if (stats.droppedFrames == 0 && stats.bufferReturnWait.count == 0 &&
+               maxInflight + 2 < mV4L2BufferCount) {
+        // At least two buffers were always queued in the driver, one of them is not needed
+        adjust--;
+    }
+    adjust = std::min(adjust, kMaxV4L2BufferCountAdjust);
+    // Lowering the buffer count below the minimum changes nothing
+    adjust = std::max(adjust, kMinV4L2BufferCount - static_cast<int>(mV4L2BufferCount) +
+                                      mV4l2BufferCountAdjust);
+    if (adjust != mV4l2BufferCountAdjust) {
+        ALOGI("%s: V4L2 buffer count adjust %d -> %d (%" PRIu64 " frames, %" PRIu64
+              " dropped, %" PRIu64 " buffer waits, max in flight %zu/%zu)",
+              __FUNCTION__, mV4l2BufferCountAdjust, adjust, stats.frames, stats.droppedFrames,
+              stats.bufferReturnWait.count, maxInflight, mV4L2BufferCount);
+        mV4l2BufferCountAdjust = adjust;
+    }
+}
+
+void ExternalCameraDeviceSession::LatencyHistogram::add(nsecs_t duration) {
+    int bucket = 0;
+    for (nsecs_t bound = 1000000; bucket < kBucketCount - 1 && duration >= bound; bound *= 2) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    count++;
+    total += duration;
+    max = std::max(max, duration);
+}
+
+void ExternalCameraDeviceSession::LatencyHistogram::dump(int fd, const char* name) const {
+    dprintf(fd, "%s: %" PRIu64 " waits, avg %.2fms, max %.2fms\n", name, count,
+            count == 0 ? 0.0 : total / 1e6 / count, max / 1e6);
+    if (count == 0) {
+        return;
+    }
+    dprintf(fd, "   ");
+    for (int i = 0; i < kBucketCount; i++) {
+        if (i == kBucketCount - 1) {
+            dprintf(fd, " >=%dms: %" PRIu64, 1 << (i - 1), buckets[i]);
+        } else {
+            dprintf(fd, " <%dms: %" PRIu64, 1 << i, buckets[i]);
+        }
+    }
+    dprintf(fd, "\n");
+}
+
 bool ExternalCameraDeviceSession::supportOfflineLocked(int32_t streamId) {
     const Stream& stream = mStreamMap[streamId];
     if (stream.format == PixelFormat::BLOB &&
@@ -1792,10 +1903,7 @@ Status ExternalCameraDeviceSession::processCaptureResult(std::shared_ptr<HalRequ
     }
 
     // Fill capture result metadata
-    fillCaptureResult(req->setting, req->shutterTs);
-    const camera_metadata_t* rawResult = req->setting.getAndLock();
-    convertToAidl(rawResult, &result.result);
-    req->setting.unlock(rawResult);
+    fillCaptureResult(req->setting, req->shutterTs, &result.result.metadata);
 
     // update inflight records
     {
@@ -1806,6 +1914,7 @@ Status ExternalCameraDeviceSession::processCaptureResult(std::shared_ptr<HalRequ
     // Callback into framework
     invokeProcessCaptureResultCallback(results, /* tryWriteFmq */ true);
     freeReleaseFences(results);
+    mResultTemplate.recycle(std::move(result.result.metadata));
     return Status::OK;
 }
 
@@ -1858,6 +1967,7 @@ binder_status_t ExternalCameraDeviceSession::dump(int fd, const char** /*args*/,
 
     bool streaming = false;
     size_t v4L2BufferCount = 0;
+    int v4L2BufferCountAdjust = 0;
     SupportedV4L2Format streamingFmt;
     {
         bool sessionLocked = tryLock(mLock);
@@ -1867,6 +1977,7 @@ binder_status_t ExternalCameraDeviceSession::dump(int fd, const char** /*args*/,
         streaming = mV4l2Streaming;
         streamingFmt = mV4l2StreamingFmt;
         v4L2BufferCount = mV4L2BufferCount;
+        v4L2BufferCountAdjust = mV4l2BufferCountAdjust;
 
         if (sessionLocked) {
             mLock.unlock();
@@ -1898,12 +2009,37 @@ binder_status_t ExternalCameraDeviceSession::dump(int fd, const char** /*args*/,
                 mV4l2StreamingFps);
 
         size_t numDequeuedV4l2Buffers = 0;
+        V4l2QueueStats stats;
         {
             std::lock_guard<std::mutex> lk(mV4l2BufferLock);
             numDequeuedV4l2Buffers = mNumDequeuedV4l2Buffers;
+            stats = mV4l2QueueStats;
+        }
+        dprintf(fd, "V4L2 buffer queue size %zu (adjust %d), dequeued %zu\n", v4L2BufferCount,
+                v4L2BufferCountAdjust, numDequeuedV4l2Buffers);
+        dprintf(fd, "V4L2 frames %" PRIu64 ", dropped %" PRIu64 ", with error %" PRIu64 "\n",
+                stats.frames, stats.droppedFrames, stats.errorFrames);
+        stats.dequeueWait.dump(fd, "VIDIOC_DQBUF wait");
+        stats.bufferReturnWait.dump(fd, "V4L2 buffer return wait");
+        dprintf(fd, "Frames by buffers in flight:");
+        for (size_t i = 0; i < stats.inflightCounts.size(); i++) {
+            dprintf(fd, " %zu: %" PRIu64, i, stats.inflightCounts[i]);
+        }
+        dprintf(fd, "\n");
+    }
+
+    {
+        bool resultLocked = tryLock(mProcessCaptureResultLock);
+        if (!resultLocked) {
+            dprintf(fd,
+                    "!! ExternalCameraDeviceSession mProcessCaptureResultLock may be deadlocked "
+                    "!!\n");
+        }
+        ResultMetadataStats resultStats = mResultMetadataStats;
+        if (resultLocked) {
+            mProcessCaptureResultLock.unlock();
         }
-        dprintf(fd, "V4L2 buffer queue size %zu, dequeued %zu\n", v4L2BufferCount,
-                numDequeuedV4l2Buffers);
+        resultStats.dump(fd);
     }
 
     dprintf(fd, "In-flight frames (not sorted):");
@@ -2129,9 +2265,12 @@ ExternalCameraDeviceSession::OutputThread::OutputThread(
     : mParent(parent),
       mCroppingType(ct),
       mCameraCharacteristics(chars),
+      mMjpegDecoder(MjpegDecoder::create(ExternalCameraConfig::MjpegDecoderType::LIBYUV, "")),
       mBufferRequestThread(bufReqThread) {}
 
-ExternalCameraDeviceSession::OutputThread::~OutputThread() {}
+ExternalCameraDeviceSession::OutputThread::~OutputThread() {
+    stopPipeline();
+}
 
 Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         const Size& v4lSize, const Size& thumbSize, const std::vector<Stream>& streams,
@@ -2142,58 +2281,77 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
               mScaledYu12Frames.size());
         return Status::INTERNAL_ERROR;
     }
+    std::lock_guard<std::mutex> pipelineLk(mPipelineLock);
+    if (mFreeDecodedFrames.size() != mDecodedFrames.size()) {
+        ALOGE("%s: output pipeline has %zu inflight frames! (expect 0)", __FUNCTION__,
+              mDecodedFrames.size() - mFreeDecodedFrames.size());
+        return Status::INTERNAL_ERROR;
+    }
 
-    // Allocating intermediate YU12 frame
-    if (mYu12Frame == nullptr || mYu12Frame->mWidth != v4lSize.width ||
-        mYu12Frame->mHeight != v4lSize.height) {
-        mYu12Frame.reset();
-        mYu12Frame = std::make_shared<AllocatedFrame>(v4lSize.width, v4lSize.height);
-        int ret = mYu12Frame->allocate(&mYu12FrameLayout);
-        if (ret != 0) {
+    // The V4L2 frames might be decoded at a reduced size if all the streams are smaller
+    Size maxStreamSize = {0, 0};
+    for (const auto& stream : streams) {
+        maxStreamSize.width = std::max(maxStreamSize.width, stream.width);
+        maxStreamSize.height = std::max(maxStreamSize.height, stream.height);
+    }
+    const Size decodedSize = mMjpegDecoder->getOutputSize(v4lSize, maxStreamSize);
+    ALOGV("%s: %s decoder output %dx%d", __FUNCTION__, mMjpegDecoder->getName(),
+          decodedSize.width, decodedSize.height);
+
+    // Allocating intermediate YU12 frame, the replaced frames go back to the pool
+    if (mYu12Frame == nullptr || mYu12Frame->mWidth != decodedSize.width ||
+        mYu12Frame->mHeight != decodedSize.height) {
+        for (auto& frame : mDecodedFrames) {
+            if (frame != mYu12Frame) {
+                mFramePool.release(std::move(frame));
+            }
+        }
+        mDecodedFrames.clear();
+        mFreeDecodedFrames.clear();
+        mFramePool.release(std::move(mYu12Frame));
+        mYu12Frame = mFramePool.acquire(decodedSize.width, decodedSize.height);
+        if (mYu12Frame == nullptr) {
             ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
             return Status::INTERNAL_ERROR;
         }
+        mYu12Frame->getLayout(&mYu12FrameLayout);
+    }
+
+    // Allocating the YU12 frames decoded ahead of the pipeline stages, the intermediate YU12
+    // frame is reused as the first one
+    if (mDecodedFrames.empty()) {
+        mDecodedFrames = {mYu12Frame};
+        for (size_t i = 1; i < kDecodedFrameCount; i++) {
+            auto frame = mFramePool.acquire(decodedSize.width, decodedSize.height);
+            if (frame == nullptr) {
+                ALOGE("%s: allocating decoded YU12 frame failed!", __FUNCTION__);
+                mDecodedFrames.clear();
+                return Status::INTERNAL_ERROR;
+            }
+            mDecodedFrames.push_back(frame);
+        }
+        mFreeDecodedFrames = mDecodedFrames;
     }
 
     // Allocating intermediate YU12 thumbnail frame
     if (mYu12ThumbFrame == nullptr || mYu12ThumbFrame->mWidth != thumbSize.width ||
         mYu12ThumbFrame->mHeight != thumbSize.height) {
-        mYu12ThumbFrame.reset();
-        mYu12ThumbFrame = std::make_shared<AllocatedFrame>(thumbSize.width, thumbSize.height);
-        int ret = mYu12ThumbFrame->allocate(&mYu12ThumbFrameLayout);
-        if (ret != 0) {
+        mFramePool.release(std::move(mYu12ThumbFrame));
+        mYu12ThumbFrame = mFramePool.acquire(thumbSize.width, thumbSize.height);
+        if (mYu12ThumbFrame == nullptr) {
             ALOGE("%s: allocating YU12 thumb frame failed!", __FUNCTION__);
             return Status::INTERNAL_ERROR;
         }
+        mYu12ThumbFrame->getLayout(&mYu12ThumbFrameLayout);
     }
 
-    // Allocating scaled buffers
-    for (const auto& stream : streams) {
-        Size sz = {stream.width, stream.height};
-        if (sz == v4lSize) {
-            continue;  // Don't need an intermediate buffer same size as v4lBuffer
-        }
-        if (mIntermediateBuffers.count(sz) == 0) {
-            // Create new intermediate buffer
-            std::shared_ptr<AllocatedFrame> buf =
-                    std::make_shared<AllocatedFrame>(stream.width, stream.height);
-            int ret = buf->allocate();
-            if (ret != 0) {
-                ALOGE("%s: allocating intermediate YU12 frame %dx%d failed!", __FUNCTION__,
-                      stream.width, stream.height);
-                return Status::INTERNAL_ERROR;
-            }
-            mIntermediateBuffers[sz] = buf;
-        }
-    }
-
-    // Remove unconfigured buffers
+    // Remove unconfigured buffers before allocating, so that their memory is reused
     auto it = mIntermediateBuffers.begin();
     while (it != mIntermediateBuffers.end()) {
         bool configured = false;
         auto sz = it->first;
         for (const auto& stream : streams) {
-            if (stream.width == sz.width && stream.height == sz.height) {
+            if (stream.width == sz.width && stream.height == sz.height && !(sz == decodedSize)) {
                 configured = true;
                 break;
             }
@@ -2201,9 +2359,53 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         if (configured) {
             it++;
         } else {
+            mFramePool.release(std::move(it->second));
             it = mIntermediateBuffers.erase(it);
         }
     }
+    FrameMap jpegBuffers;
+    for (const auto& stream : streams) {
+        Size sz = {stream.width, stream.height};
+        auto jpegIt = mJpegIntermediateBuffers.find(sz);
+        if (stream.format == PixelFormat::BLOB && !(sz == decodedSize) &&
+            jpegIt != mJpegIntermediateBuffers.end()) {
+            jpegBuffers[sz] = std::move(jpegIt->second);
+            mJpegIntermediateBuffers.erase(jpegIt);
+        }
+    }
+    for (auto& [sz, buf] : mJpegIntermediateBuffers) {
+        mFramePool.release(std::move(buf));
+    }
+    mJpegIntermediateBuffers = std::move(jpegBuffers);
+
+    // Allocating scaled buffers
+    for (const auto& stream : streams) {
+        Size sz = {stream.width, stream.height};
+        if (sz == decodedSize) {
+            continue;  // Don't need an intermediate buffer same size as the decoded buffer
+        }
+        if (mIntermediateBuffers.count(sz) == 0) {
+            // Create new intermediate buffer
+            std::shared_ptr<AllocatedFrame> buf = mFramePool.acquire(stream.width, stream.height);
+            if (buf == nullptr) {
+                ALOGE("%s: allocating intermediate YU12 frame %dx%d failed!", __FUNCTION__,
+                      stream.width, stream.height);
+                return Status::INTERNAL_ERROR;
+            }
+            mIntermediateBuffers[sz] = buf;
+        }
+        // The scaled buffers of the JPEG stage
+        if (stream.format == PixelFormat::BLOB && mJpegIntermediateBuffers.count(sz) == 0) {
+            std::shared_ptr<AllocatedFrame> buf = mFramePool.acquire(stream.width, stream.height);
+            if (buf == nullptr) {
+                ALOGE("%s: allocating intermediate YU12 frame %dx%d failed!", __FUNCTION__,
+                      stream.width, stream.height);
+                return Status::INTERNAL_ERROR;
+            }
+            mJpegIntermediateBuffers[sz] = buf;
+        }
+    }
+    mFramePool.trim();
 
     // Allocate mute test pattern frame
     mMuteTestPatternFrame.resize(mYu12Frame->mWidth * mYu12Frame->mHeight * 3);
@@ -2232,12 +2434,9 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
-        auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
-            ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
-        }
+    auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
+    if (!mRequestDoneCond.wait_for(lk, timeout, [this] { return isIdleLocked(); })) {
+        ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
     }
 
     ALOGV("%s: flushing inflight requests", __FUNCTION__);
@@ -2254,6 +2453,11 @@ void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
     } else {
         dprintf(fd, "OutputThread not processing any frames\n");
     }
+    dprintf(fd, "OutputThread pipeline contains %zu frames\n", mPipelineRequestCount);
+    {
+        std::lock_guard<std::mutex> bufferLk(mBufferLock);
+        dprintf(fd, "OutputThread MJPEG decoder: %s\n", mMjpegDecoder->getName());
+    }
     dprintf(fd, "OutputThread request list contains frame: ");
     for (const auto& req : mRequestList) {
         dprintf(fd, "%d, ", req->frameNumber);
@@ -2267,6 +2471,12 @@ void ExternalCameraDeviceSession::OutputThread::setExifMakeModel(const std::stri
     mExifModel = model;
 }
 
+void ExternalCameraDeviceSession::OutputThread::setMjpegDecoder(
+        std::unique_ptr<MjpegDecoder> decoder) {
+    std::lock_guard<std::mutex> lk(mBufferLock);
+    mMjpegDecoder = std::move(decoder);
+}
+
 std::list<std::shared_ptr<HalRequest>>
 ExternalCameraDeviceSession::OutputThread::switchToOffline() {
     ATRACE_CALL();
@@ -2279,12 +2489,9 @@ ExternalCameraDeviceSession::OutputThread::switchToOffline() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
-        auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
-            ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
-        }
+    auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
+    if (!mRequestDoneCond.wait_for(lk, timeout, [this] { return isIdleLocked(); })) {
+        ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
     }
     lk.unlock();
     clearIntermediateBuffers();
@@ -2348,6 +2555,12 @@ void ExternalCameraDeviceSession::OutputThread::signalRequestDone() {
 
 int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         std::shared_ptr<AllocatedFrame>& in, const Size& outSz, YCbCrLayout* out) {
+    return cropAndScaleLocked(in, outSz, out, mIntermediateBuffers, &mScaledYu12Frames);
+}
+
+int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
+        std::shared_ptr<AllocatedFrame>& in, const Size& outSz, YCbCrLayout* out,
+        const FrameMap& intermediateBuffers, FrameMap* scaledYu12Frames) {
     Size inSz = {in->mWidth, in->mHeight};
 
     int ret;
@@ -2384,13 +2597,13 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return 0;
     }
 
-    auto it = mScaledYu12Frames.find(outSz);
+    auto it = scaledYu12Frames->find(outSz);
     std::shared_ptr<AllocatedFrame> scaledYu12Buf;
-    if (it != mScaledYu12Frames.end()) {
+    if (it != scaledYu12Frames->end()) {
         scaledYu12Buf = it->second;
     } else {
-        it = mIntermediateBuffers.find(outSz);
-        if (it == mIntermediateBuffers.end()) {
+        it = intermediateBuffers.find(outSz);
+        if (it == intermediateBuffers.end()) {
             ALOGE("%s: failed to find intermediate buffer size %dx%d", __FUNCTION__, outSz.width,
                   outSz.height);
             return -1;
@@ -2422,7 +2635,7 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
     }
 
     *out = outLayout;
-    mScaledYu12Frames.insert({outSz, scaledYu12Buf});
+    scaledYu12Frames->insert({outSz, scaledYu12Buf});
     return 0;
 }
 
@@ -2551,6 +2764,14 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleThumbLocked(
 
 int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         HalStreamBuffer& halBuf, const common::V1_0::helper::CameraMetadata& setting) {
+    return createJpegLocked(mYu12Frame, halBuf, setting, mIntermediateBuffers,
+                            &mScaledYu12Frames);
+}
+
+int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
+        std::shared_ptr<AllocatedFrame>& in, HalStreamBuffer& halBuf,
+        const common::V1_0::helper::CameraMetadata& setting, const FrameMap& intermediateBuffers,
+        FrameMap* scaledYu12Frames) {
     ATRACE_CALL();
     int ret;
     auto lfail = [&](auto... args) {
@@ -2568,7 +2789,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
           static_cast<uint64_t>(halBuf.bufferId), halBuf.width, halBuf.height);
     ALOGV("%s: HAL buffer fmt: %x usage: %" PRIx64 " ptr: %p", __FUNCTION__, halBuf.format,
           static_cast<uint64_t>(halBuf.usage), halBuf.bufPtr);
-    ALOGV("%s: YV12 buffer %d x %d", __FUNCTION__, mYu12Frame->mWidth, mYu12Frame->mHeight);
+    ALOGV("%s: YV12 buffer %d x %d", __FUNCTION__, in->mWidth, in->mHeight);
 
     int jpegQuality, thumbQuality;
     Size thumbSize;
@@ -2621,29 +2842,48 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     /* Temporary thumbnail code buffer */
     std::vector<uint8_t> thumbCode(outputThumbnail ? maxThumbCodeSize : 0);
 
-    YCbCrLayout yu12Thumb;
-    if (outputThumbnail) {
-        ret = cropAndScaleThumbLocked(mYu12Frame, thumbSize, &yu12Thumb);
-
-        if (ret != 0) {
-            return lfail("%s: crop and scale thumbnail failed!", __FUNCTION__);
-        }
-    }
-
     /* Scale and crop main jpeg */
-    ret = cropAndScaleLocked(mYu12Frame, jpegSize, &yu12Main);
+    ret = cropAndScaleLocked(in, jpegSize, &yu12Main, intermediateBuffers, scaledYu12Frames);
 
     if (ret != 0) {
         return lfail("%s: crop and scale main failed!", __FUNCTION__);
     }
 
-    /* Encode the thumbnail image */
+    /* Lock the HAL jpeg code buffer */
+    void* bufPtr = sHandleImporter.lock(*(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage),
+                                        maxJpegCodeSize);
+
+    if (!bufPtr) {
+        return lfail("%s: could not lock %zu bytes", __FUNCTION__, maxJpegCodeSize);
+    }
+
+    /* Start encoding the main jpeg image, the blob is kept at the end of the buffer */
+    mJpegEncoder.start(jpegSize, yu12Main, jpegQuality, bufPtr,
+                       maxJpegCodeSize - sizeof(CameraBlob));
+    auto lfailLocked = [&](auto... args) {
+        mJpegEncoder.cancel();
+        int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+        if (relFence >= 0) {
+            halBuf.acquireFence = relFence;
+        }
+        return lfail(args...);
+    };
+
+    /* Meanwhile, encode the thumbnail image */
+    YCbCrLayout yu12Thumb;
     if (outputThumbnail) {
+        ret = cropAndScaleThumbLocked(in, thumbSize, &yu12Thumb);
+
+        if (ret != 0) {
+            return lfailLocked("%s: crop and scale thumbnail failed!", __FUNCTION__);
+        }
+
         ret = encodeJpegYU12(thumbSize, yu12Thumb, thumbQuality, 0, 0, &thumbCode[0],
                              maxThumbCodeSize, thumbCodeSize);
 
         if (ret != 0) {
-            return lfail("%s: thumbnail encodeJpegYU12 failed with %d", __FUNCTION__, ret);
+            return lfailLocked("%s: thumbnail encodeJpegYU12 failed with %d", __FUNCTION__,
+                               ret);
         }
     }
 
@@ -2664,24 +2904,15 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     ret = utils->generateApp1(outputThumbnail ? &thumbCode[0] : nullptr, thumbCodeSize);
 
     if (!ret) {
-        return lfail("%s: generating APP1 failed", __FUNCTION__);
+        return lfailLocked("%s: generating APP1 failed", __FUNCTION__);
     }
 
     /* Get internal buffer */
     size_t exifDataSize = utils->getApp1Length();
     const uint8_t* exifData = utils->getApp1Buffer();
 
-    /* Lock the HAL jpeg code buffer */
-    void* bufPtr = sHandleImporter.lock(*(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage),
-                                        maxJpegCodeSize);
-
-    if (!bufPtr) {
-        return lfail("%s: could not lock %zu bytes", __FUNCTION__, maxJpegCodeSize);
-    }
-
-    /* Encode the main jpeg image */
-    ret = encodeJpegYU12(jpegSize, yu12Main, jpegQuality, exifData, exifDataSize, bufPtr,
-                         maxJpegCodeSize, jpegCodeSize);
+    /* Finish the main jpeg image with the APP1 segment */
+    ret = mJpegEncoder.finish(exifData, exifDataSize, jpegCodeSize);
 
     /* TODO: Not sure this belongs here, maybe better to pass jpegCodeSize out
      * and do this when returning buffer to parent */
@@ -2712,138 +2943,133 @@ void ExternalCameraDeviceSession::OutputThread::clearIntermediateBuffers() {
     mYu12Frame.reset();
     mYu12ThumbFrame.reset();
     mIntermediateBuffers.clear();
+    mJpegIntermediateBuffers.clear();
     mMuteTestPatternFrame.clear();
+    {
+        std::lock_guard<std::mutex> pipelineLk(mPipelineLock);
+        mDecodedFrames.clear();
+        mFreeDecodedFrames.clear();
+    }
+    // Nothing is reconfigured after this, the memory is freed at once
+    mFramePool.clear();
     mBlobBufferSize = 0;
 }
 
-bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
-    std::shared_ptr<HalRequest> req;
+void ExternalCameraDeviceSession::OutputThread::startPipeline() {
+    static const char* const kStageNames[PIPELINE_STAGE_COUNT] = {"ExtCamConvert", "ExtCamJpeg"};
+    {
+        std::lock_guard<std::mutex> lk(mPipelineLock);
+        mPipelineExit = false;
+        mPipelineFailed = false;
+        for (auto& exited : mStageExited) {
+            exited = false;
+        }
+    }
+    for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++) {
+        mPipelineThreads[stage] = std::thread([this, stage] {
+            pthread_setname_np(pthread_self(), kStageNames[stage]);
+            if (mThreadPriority.has_value()) {
+                setpriority(PRIO_PROCESS, 0, *mThreadPriority);
+            }
+            pipelineLoop(static_cast<PipelineStage>(stage));
+        });
+    }
+}
+
+void ExternalCameraDeviceSession::OutputThread::stopPipeline() {
+    {
+        std::lock_guard<std::mutex> lk(mPipelineLock);
+        mPipelineExit = true;
+    }
+    mPipelineCond.notify_all();
+    for (auto& thread : mPipelineThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ExternalCameraDeviceSession::OutputThread::pipelineLoop(PipelineStage stage) {
+    std::deque<PipelineJob>& queue = mPipelineQueues[stage];
+    std::unique_lock<std::mutex> lk(mPipelineLock);
+    while (true) {
+        // The queued jobs are always finished, a stage exits after the previous one
+        mPipelineCond.wait(lk, [&] {
+            return !queue.empty() ||
+                   (mPipelineExit && (stage == CONVERT_STAGE || mStageExited[stage - 1]));
+        });
+        if (queue.empty()) {
+            break;
+        }
+        PipelineJob job = std::move(queue.front());
+        queue.pop_front();
+        if (mPipelineFailed) {
+            job.failed = true;
+        }
+        lk.unlock();
+
+        bool dropped = false;
+        if (!job.failed && !processPipelineJob(stage, &job)) {
+            // The device error has been notified, the request is dropped
+            lk.lock();
+            mPipelineFailed = true;
+            lk.unlock();
+            job.req.reset();
+            dropped = true;
+        }
+        if (dropped || stage == PIPELINE_STAGE_COUNT - 1) {
+            finishPipelineJob(&job);
+            lk.lock();
+            continue;
+        }
+
+        lk.lock();
+        mPipelineQueues[stage + 1].push_back(std::move(job));
+        mPipelineCond.notify_all();
+    }
+    mStageExited[stage] = true;
+    lk.unlock();
+    mPipelineCond.notify_all();
+}
+
+bool ExternalCameraDeviceSession::OutputThread::processPipelineJob(PipelineStage stage,
+                                                                   PipelineJob* job) {
     auto parent = mParent.lock();
     if (parent == nullptr) {
         ALOGE("%s: session has been disconnected!", __FUNCTION__);
         return false;
     }
 
-    // TODO: maybe we need to setup a sensor thread to dq/enq v4l frames
-    //       regularly to prevent v4l buffer queue filled with stale buffers
-    //       when app doesn't program a preview request
-    waitForNextRequest(&req);
-    if (req == nullptr) {
-        // No new request, wait again
-        return true;
-    }
-
+    std::shared_ptr<HalRequest>& req = job->req;
     auto onDeviceError = [&](auto... args) {
         ALOGE(args...);
         parent->notifyError(req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
         return false;
     };
 
-    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
-        return onDeviceError("%s: do not support V4L2 format %c%c%c%c", __FUNCTION__,
-                             req->frameIn->mFourcc & 0xFF, (req->frameIn->mFourcc >> 8) & 0xFF,
-                             (req->frameIn->mFourcc >> 16) & 0xFF,
-                             (req->frameIn->mFourcc >> 24) & 0xFF);
-    }
-
-    int res = requestBufferStart(req->buffers);
-    if (res != 0) {
-        ALOGE("%s: send BufferRequest failed! res %d", __FUNCTION__, res);
-        return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
-    }
-
-    std::unique_lock<std::mutex> lk(mBufferLock);
-    // Convert input V4L2 frame to YU12 of the same size
-    // TODO: see if we can save some computation by converting to YV12 here
-    uint8_t* inData;
-    size_t inDataSize;
-    if (req->frameIn->getData(&inData, &inDataSize) != 0) {
-        lk.unlock();
-        return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
-    }
-
-    // Process camera mute state
-    auto testPatternMode = req->setting.find(ANDROID_SENSOR_TEST_PATTERN_MODE);
-    if (testPatternMode.count == 1) {
-        if (mCameraMuted != (testPatternMode.data.u8[0] != ANDROID_SENSOR_TEST_PATTERN_MODE_OFF)) {
-            mCameraMuted = !mCameraMuted;
-            // Get solid color for test pattern, if any was set
-            if (testPatternMode.data.u8[0] == ANDROID_SENSOR_TEST_PATTERN_MODE_SOLID_COLOR) {
-                auto entry = req->setting.find(ANDROID_SENSOR_TEST_PATTERN_DATA);
-                if (entry.count == 4) {
-                    // Update the mute frame if the pattern color has changed
-                    if (memcmp(entry.data.i32, mTestPatternData, sizeof(mTestPatternData)) != 0) {
-                        memcpy(mTestPatternData, entry.data.i32, sizeof(mTestPatternData));
-                        // Fill the mute frame with the solid color, use only 8 MSB of RGGB as RGB
-                        for (int i = 0; i < mMuteTestPatternFrame.size(); i += 3) {
-                            mMuteTestPatternFrame[i] = entry.data.i32[0] >> 24;
-                            mMuteTestPatternFrame[i + 1] = entry.data.i32[1] >> 24;
-                            mMuteTestPatternFrame[i + 2] = entry.data.i32[3] >> 24;
-                        }
-                    }
-                }
+    if (stage == JPEG_STAGE) {
+        mJpegScaledYu12Frames.clear();
+        for (auto& halBuf : req->buffers) {
+            if (halBuf.fenceTimeout || halBuf.format != PixelFormat::BLOB) {
+                continue;
             }
-        }
-    }
-
-    // TODO: in some special case maybe we can decode jpg directly to gralloc output?
-    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
-        ATRACE_BEGIN("MJPGtoI420");
-        res = 0;
-        if (mCameraMuted) {
-            res = libyuv::ConvertToI420(
-                    mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
-                    static_cast<uint8_t*>(mYu12FrameLayout.y), mYu12FrameLayout.yStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cb), mYu12FrameLayout.cStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cr), mYu12FrameLayout.cStride, 0, 0,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight, mYu12Frame->mWidth,
-                    mYu12Frame->mHeight, libyuv::kRotate0, libyuv::FOURCC_RAW);
-        } else {
-            res = libyuv::MJPGToI420(
-                    inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
-                    mYu12FrameLayout.yStride, static_cast<uint8_t*>(mYu12FrameLayout.cb),
-                    mYu12FrameLayout.cStride, static_cast<uint8_t*>(mYu12FrameLayout.cr),
-                    mYu12FrameLayout.cStride, mYu12Frame->mWidth, mYu12Frame->mHeight,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight);
-        }
-        ATRACE_END();
-
-        if (res != 0) {
-            // For some webcam, the first few V4L2 frames might be malformed...
-            ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
-
-            ATRACE_BEGIN("Wait for BufferRequest done");
-            res = waitForBufferRequestDone(&req->buffers);
-            ATRACE_END();
-
-            lk.unlock();
-            Status st = parent->processCaptureRequestError(req);
-            if (st != Status::OK) {
-                return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
+            int ret = createJpegLocked(job->yu12Frame, halBuf, req->setting,
+                                       mJpegIntermediateBuffers, &mJpegScaledYu12Frames);
+            if (ret != 0) {
+                return onDeviceError("%s: createJpegLocked failed with %d", __FUNCTION__, ret);
             }
-            signalRequestDone();
-            return true;
         }
+        mJpegScaledYu12Frames.clear();
+        return true;
     }
 
-    ATRACE_BEGIN("Wait for BufferRequest done");
-    res = waitForBufferRequestDone(&req->buffers);
-    ATRACE_END();
-
-    if (res != 0) {
-        // HAL buffer management buffer request can fail
-        ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
-        lk.unlock();
-        Status st = parent->processCaptureRequestError(req);
-        if (st != Status::OK) {
-            return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
-        }
-        signalRequestDone();
+    if (job->outputDecoded) {
+        // Done by 'threadLoop'
         return true;
     }
 
     ALOGV("%s processing new request", __FUNCTION__);
+    mScaledYu12Frames.clear();
     const int kSyncWaitTimeoutMs = 500;
     for (auto& halBuf : req->buffers) {
         if (*(halBuf.bufPtr) == nullptr) {
@@ -2865,15 +3091,15 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
 
         // Gralloc lockYCbCr the buffer
         switch (halBuf.format) {
-            case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req->setting);
-
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: createJpegLocked failed with %d", __FUNCTION__, ret);
-                }
-            } break;
+            case PixelFormat::BLOB:
+                // Filled by the JPEG stage
+                break;
             case PixelFormat::Y16: {
+                uint8_t* inData;
+                size_t inDataSize;
+                if (req->frameIn->getData(&inData, &inDataSize) != 0) {
+                    return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
+                }
                 void* outLayout = sHandleImporter.lock(
                         *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), inDataSize);
 
@@ -2912,11 +3138,10 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
 
                 YCbCrLayout cropAndScaled;
                 ATRACE_BEGIN("cropAndScaleLocked");
-                int ret = cropAndScaleLocked(mYu12Frame, Size{halBuf.width, halBuf.height},
+                int ret = cropAndScaleLocked(job->yu12Frame, Size{halBuf.width, halBuf.height},
                                              &cropAndScaled);
                 ATRACE_END();
                 if (ret != 0) {
-                    lk.unlock();
                     return onDeviceError("%s: crop and scale failed!", __FUNCTION__);
                 }
 
@@ -2925,7 +3150,6 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 ret = formatConvert(cropAndScaled, outLayout, sz, outputFourcc);
                 ATRACE_END();
                 if (ret != 0) {
-                    lk.unlock();
                     return onDeviceError("%s: format conversion failed!", __FUNCTION__);
                 }
                 int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
@@ -2934,22 +3158,324 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 }
             } break;
             default:
-                lk.unlock();
                 return onDeviceError("%s: unknown output format %x", __FUNCTION__, halBuf.format);
         }
     }  // for each buffer
     mScaledYu12Frames.clear();
+    return true;
+}
+
+std::shared_ptr<AllocatedFrame> ExternalCameraDeviceSession::OutputThread::acquireDecodedFrame() {
+    ATRACE_CALL();
+    std::unique_lock<std::mutex> lk(mPipelineLock);
+    while (mFreeDecodedFrames.empty()) {
+        if (exitPending() || mPipelineExit || mDecodedFrames.empty()) {
+            return nullptr;
+        }
+        mPipelineCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
+    }
+    std::shared_ptr<AllocatedFrame> frame = mFreeDecodedFrames.back();
+    mFreeDecodedFrames.pop_back();
+    return frame;
+}
+
+void ExternalCameraDeviceSession::OutputThread::submitPipelineJob(PipelineJob job) {
+    {
+        std::lock_guard<std::mutex> lk(mRequestListLock);
+        mProcessingRequest = false;
+        mProcessingFrameNumber = 0;
+        mPipelineRequestCount++;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mPipelineLock);
+        mPipelineQueues[CONVERT_STAGE].push_back(std::move(job));
+    }
+    mPipelineCond.notify_all();
+}
+
+void ExternalCameraDeviceSession::OutputThread::finishPipelineJob(PipelineJob* job) {
+    auto parent = mParent.lock();
+    if (job->req != nullptr && parent != nullptr) {
+        // Don't hold any lock while calling back to parent
+        Status st = job->failed ? parent->processCaptureRequestError(job->req)
+                                : parent->processCaptureResult(job->req);
+        if (st != Status::OK) {
+            ALOGE("%s: failed to process capture %s!", __FUNCTION__,
+                  job->failed ? "request error" : "result");
+            parent->notifyError(job->req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
+            std::lock_guard<std::mutex> lk(mPipelineLock);
+            mPipelineFailed = true;
+        }
+    }
+    job->req.reset();
+
+    {
+        std::lock_guard<std::mutex> lk(mPipelineLock);
+        if (job->yu12Frame != nullptr) {
+            mFreeDecodedFrames.push_back(std::move(job->yu12Frame));
+        }
+    }
+    mPipelineCond.notify_all();
+
+    {
+        std::lock_guard<std::mutex> lk(mRequestListLock);
+        mPipelineRequestCount--;
+    }
+    mRequestDoneCond.notify_all();
+}
+
+bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
+    std::shared_ptr<HalRequest> req;
+    auto parent = mParent.lock();
+    if (parent == nullptr) {
+        ALOGE("%s: session has been disconnected!", __FUNCTION__);
+        return false;
+    }
+
+    if (!mPipelineThreads[CONVERT_STAGE].joinable()) {
+        if (mThreadPriority.has_value()) {
+            setpriority(PRIO_PROCESS, 0, *mThreadPriority);
+        }
+        startPipeline();
+    }
+    {
+        std::lock_guard<std::mutex> lk(mPipelineLock);
+        if (mPipelineFailed) {
+            ALOGE("%s: output pipeline failed!", __FUNCTION__);
+            return false;
+        }
+    }
+
+    // TODO: maybe we need to setup a sensor thread to dq/enq v4l frames
+    //       regularly to prevent v4l buffer queue filled with stale buffers
+    //       when app doesn't program a preview request
+    waitForNextRequest(&req);
+    if (req == nullptr) {
+        // No new request, wait again
+        return true;
+    }
+
+    auto onDeviceError = [&](auto... args) {
+        ALOGE(args...);
+        parent->notifyError(req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
+        signalRequestDone();
+        return false;
+    };
+
+    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
+        return onDeviceError("%s: do not support V4L2 format %c%c%c%c", __FUNCTION__,
+                             req->frameIn->mFourcc & 0xFF, (req->frameIn->mFourcc >> 8) & 0xFF,
+                             (req->frameIn->mFourcc >> 16) & 0xFF,
+                             (req->frameIn->mFourcc >> 24) & 0xFF);
+    }
+
+    // Wait for a free decoded frame first, this bounds the number of requests in the pipeline
+    PipelineJob job;
+    job.req = req;
+    job.yu12Frame = acquireDecodedFrame();
+    if (job.yu12Frame == nullptr) {
+        ALOGW("%s: no decoded frame available, the thread is exiting", __FUNCTION__);
+        Status st = parent->processCaptureRequestError(req);
+        if (st != Status::OK) {
+            return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
+        }
+        signalRequestDone();
+        return true;
+    }
+    auto releaseDecodedFrame = [&]() {
+        std::unique_lock<std::mutex> pipelineLk(mPipelineLock);
+        mFreeDecodedFrames.push_back(std::move(job.yu12Frame));
+        pipelineLk.unlock();
+        mPipelineCond.notify_all();
+    };
+
+    int res = requestBufferStart(req->buffers);
+    if (res != 0) {
+        ALOGE("%s: send BufferRequest failed! res %d", __FUNCTION__, res);
+        releaseDecodedFrame();
+        return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
+    }
+
+    std::unique_lock<std::mutex> lk(mBufferLock);
+    // Convert input V4L2 frame to YU12 of the same size
+    // TODO: see if we can save some computation by converting to YV12 here
+    uint8_t* inData;
+    size_t inDataSize;
+    if (req->frameIn->getData(&inData, &inDataSize) != 0) {
+        lk.unlock();
+        releaseDecodedFrame();
+        return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
+    }
+
+    // Process camera mute state
+    auto testPatternMode = req->setting.find(ANDROID_SENSOR_TEST_PATTERN_MODE);
+    if (testPatternMode.count == 1) {
+        if (mCameraMuted != (testPatternMode.data.u8[0] != ANDROID_SENSOR_TEST_PATTERN_MODE_OFF)) {
+            mCameraMuted = !mCameraMuted;
+            // Get solid color for test pattern, if any was set
+            if (testPatternMode.data.u8[0] == ANDROID_SENSOR_TEST_PATTERN_MODE_SOLID_COLOR) {
+                auto entry = req->setting.find(ANDROID_SENSOR_TEST_PATTERN_DATA);
+                if (entry.count == 4) {
+                    // Update the mute frame if the pattern color has changed
+                    if (memcmp(entry.data.i32, mTestPatternData, sizeof(mTestPatternData)) != 0) {
+                        memcpy(mTestPatternData, entry.data.i32, sizeof(mTestPatternData));
+                        // Fill the mute frame with the solid color, use only 8 MSB of RGGB as RGB
+                        for (int i = 0; i < mMuteTestPatternFrame.size(); i += 3) {
+                            mMuteTestPatternFrame[i] = entry.data.i32[0] >> 24;
+                            mMuteTestPatternFrame[i + 1] = entry.data.i32[1] >> 24;
+                            mMuteTestPatternFrame[i + 2] = entry.data.i32[3] >> 24;
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-    // Don't hold the lock while calling back to parent
+    bool buffersReady = false;
+    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG &&
+        canDecodeToOutputLocked(*req, *job.yu12Frame)) {
+        // The output buffer is needed first, so the decode does not overlap the buffer request
+        ATRACE_BEGIN("Wait for BufferRequest done");
+        res = waitForBufferRequestDone(&req->buffers);
+        ATRACE_END();
+        buffersReady = true;
+        if (res != 0) {
+            ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
+            lk.unlock();
+            job.failed = true;
+            submitPipelineJob(std::move(job));
+            return true;
+        }
+
+        res = decodeToOutputLocked(req.get(), inData, inDataSize);
+        if (res != -EAGAIN) {
+            lk.unlock();
+            if (res != 0) {
+                // For some webcam, the first few V4L2 frames might be malformed...
+                ALOGE("%s: Decode V4L2 frame to output failed! res %d", __FUNCTION__, res);
+                job.failed = true;
+            }
+            job.outputDecoded = true;
+            submitPipelineJob(std::move(job));
+            return true;
+        }
+    }
+
+    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
+        std::shared_ptr<AllocatedFrame>& frame = job.yu12Frame;
+        YCbCrLayout layout;
+        frame->getLayout(&layout);
+        ATRACE_BEGIN("MJPGtoI420");
+        res = 0;
+        if (mCameraMuted) {
+            res = libyuv::ConvertToI420(
+                    mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
+                    static_cast<uint8_t*>(layout.y), layout.yStride,
+                    static_cast<uint8_t*>(layout.cb), layout.cStride,
+                    static_cast<uint8_t*>(layout.cr), layout.cStride, 0, 0, frame->mWidth,
+                    frame->mHeight, frame->mWidth, frame->mHeight, libyuv::kRotate0,
+                    libyuv::FOURCC_RAW);
+        } else {
+            res = mMjpegDecoder->decode(inData, inDataSize,
+                                        Size{req->frameIn->mWidth, req->frameIn->mHeight},
+                                        frame.get());
+        }
+        ATRACE_END();
+
+        if (res != 0) {
+            // For some webcam, the first few V4L2 frames might be malformed...
+            ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
+
+            if (!buffersReady) {
+                ATRACE_BEGIN("Wait for BufferRequest done");
+                res = waitForBufferRequestDone(&req->buffers);
+                ATRACE_END();
+            }
+
+            lk.unlock();
+            // Returned with an error after the requests already in the pipeline
+            job.failed = true;
+            submitPipelineJob(std::move(job));
+            return true;
+        }
+    }
     lk.unlock();
-    Status st = parent->processCaptureResult(req);
-    if (st != Status::OK) {
-        return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
+
+    if (!buffersReady) {
+        ATRACE_BEGIN("Wait for BufferRequest done");
+        res = waitForBufferRequestDone(&req->buffers);
+        ATRACE_END();
+
+        if (res != 0) {
+            // HAL buffer management buffer request can fail
+            ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
+            job.failed = true;
+        }
     }
-    signalRequestDone();
+    submitPipelineJob(std::move(job));
     return true;
 }
 
+bool ExternalCameraDeviceSession::OutputThread::canDecodeToOutputLocked(
+        const HalRequest& req, const AllocatedFrame& frame) const {
+    if (mCameraMuted || req.buffers.size() != 1) {
+        return false;
+    }
+    const HalStreamBuffer& halBuf = req.buffers[0];
+    if (halBuf.format != PixelFormat::YCBCR_420_888 && halBuf.format != PixelFormat::YV12) {
+        return false;
+    }
+    return halBuf.width == frame.mWidth && halBuf.height == frame.mHeight &&
+           halBuf.width == req.frameIn->mWidth && halBuf.height == req.frameIn->mHeight;
+}
+
+int ExternalCameraDeviceSession::OutputThread::decodeToOutputLocked(HalRequest* req,
+                                                                    const uint8_t* inData,
+                                                                    size_t inDataSize) {
+    ATRACE_CALL();
+    HalStreamBuffer& halBuf = req->buffers[0];
+    if (*(halBuf.bufPtr) == nullptr) {
+        ALOGW("%s: buffer for stream %d missing", __FUNCTION__, halBuf.streamId);
+        halBuf.fenceTimeout = true;
+        return 0;
+    }
+    if (halBuf.acquireFence >= 0) {
+        const int kSyncWaitTimeoutMs = 500;
+        if (sync_wait(halBuf.acquireFence, kSyncWaitTimeoutMs) != 0) {
+            halBuf.fenceTimeout = true;
+            return 0;
+        }
+        ::close(halBuf.acquireFence);
+        halBuf.acquireFence = -1;
+    }
+
+    android::Rect outRect{0, 0, static_cast<int32_t>(halBuf.width),
+                          static_cast<int32_t>(halBuf.height)};
+    android_ycbcr result = sHandleImporter.lockYCbCr(
+            *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), outRect);
+    int ret = -EAGAIN;
+    if (result.ystride <= UINT32_MAX && result.cstride <= UINT32_MAX &&
+        result.chroma_step <= UINT32_MAX) {
+        YCbCrLayout outLayout = {.y = result.y,
+                                 .cb = result.cb,
+                                 .cr = result.cr,
+                                 .yStride = static_cast<uint32_t>(result.ystride),
+                                 .cStride = static_cast<uint32_t>(result.cstride),
+                                 .chromaStep = static_cast<uint32_t>(result.chroma_step)};
+        // The decoders write YU12, which also fills YV12 through the swapped chroma planes
+        uint32_t outputFourcc = getFourCcFromLayout(outLayout);
+        if (outputFourcc == V4L2_PIX_FMT_YUV420 || outputFourcc == V4L2_PIX_FMT_YVU420) {
+            Size sz{halBuf.width, halBuf.height};
+            ret = mMjpegDecoder->decode(inData, inDataSize, sz, outLayout, sz);
+        }
+    }
+    int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+    if (relFence >= 0) {
+        halBuf.acquireFence = relFence;
+    }
+    return ret;
+}
+
 // End ExternalCameraDeviceSession::OutputThread functions
 
 }  // namespace implementation
@@ -31,6 +31,8 @@
 #include <utils/Thread.h>
 #include <deque>
 #include <list>
+#include <optional>
+#include <thread>
 
 namespace android {
 namespace hardware {
@@ -177,6 +179,11 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         bool threadLoop() override;
 
         void setExifMakeModel(const std::string& make, const std::string& model);
+        // Must be called before allocateIntermediateBuffers, the default decoder is libyuv
+        void setMjpegDecoder(std::unique_ptr<MjpegDecoder> decoder);
+        // Must be called before run(). The nice value of the thread and its pipeline stages,
+        // which the JPEG strip encoder threads inherit. The default is the caller's priority.
+        void setThreadPriority(int priority) { mThreadPriority = priority; }
 
         // The remaining request list is returned for offline processing
         std::list<std::shared_ptr<HalRequest>> switchToOffline();
@@ -205,6 +212,52 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
 
         void clearIntermediateBuffers();
 
+        using FrameMap = std::unordered_map<Size, std::shared_ptr<AllocatedFrame>, SizeHasher>;
+
+        // Variants of the methods above using the given buffers, so that the pipeline stages
+        // never share intermediate buffers.
+        int cropAndScaleLocked(std::shared_ptr<AllocatedFrame>& in, const Size& outSize,
+                               YCbCrLayout* out, const FrameMap& intermediateBuffers,
+                               FrameMap* scaledYu12Frames);
+        int createJpegLocked(std::shared_ptr<AllocatedFrame>& in, HalStreamBuffer& halBuf,
+                             const common::V1_0::helper::CameraMetadata& settings,
+                             const FrameMap& intermediateBuffers, FrameMap* scaledYu12Frames);
+
+        // The output pipeline of the session. 'threadLoop' requests the buffers and decodes
+        // the V4L2 frame, then the request is passed to the convert stage, which fills the
+        // YUV and Y16 buffers, and then to the JPEG stage, which fills the BLOB buffers and
+        // returns the result. Each stage runs on its own thread and owns its intermediate
+        // buffers. The stages are connected by FIFO queues, thus the results are returned in
+        // the order of the requests. The pipeline is bounded by the number of decoded frames.
+        enum PipelineStage { CONVERT_STAGE = 0, JPEG_STAGE, PIPELINE_STAGE_COUNT };
+        struct PipelineJob {
+            std::shared_ptr<HalRequest> req;
+            std::shared_ptr<AllocatedFrame> yu12Frame;
+            // the request is returned with an error by the last stage
+            bool failed = false;
+            // the V4L2 frame was decoded straight into the output buffer
+            bool outputDecoded = false;
+        };
+        static const size_t kDecodedFrameCount = PIPELINE_STAGE_COUNT + 1;
+
+        void startPipeline();
+        void stopPipeline();
+        void pipelineLoop(PipelineStage stage);
+        // Returns false on a device error.
+        bool processPipelineJob(PipelineStage stage, PipelineJob* job);
+        // Returns nullptr if the thread is exiting.
+        std::shared_ptr<AllocatedFrame> acquireDecodedFrame();
+        void submitPipelineJob(PipelineJob job);
+        void finishPipelineJob(PipelineJob* job);
+        bool isIdleLocked() const { return !mProcessingRequest && mPipelineRequestCount == 0; }
+
+        // Returns true if the MJPEG frame of 'req' might be decoded straight into its output
+        // buffer, i.e. the request has a single YUV buffer of the size 'frame' is decoded at.
+        bool canDecodeToOutputLocked(const HalRequest& req, const AllocatedFrame& frame) const;
+        // Decodes into the output buffer of 'req' once it is ready. Returns -EAGAIN if the
+        // buffer layout is not planar YUV420, in which case the buffer is left untouched.
+        int decodeToOutputLocked(HalRequest* req, const uint8_t* inData, size_t inDataSize);
+
         const std::weak_ptr<OutputThreadInterface> mParent;
         const CroppingType mCroppingType;
         const common::V1_0::helper::CameraMetadata mCameraCharacteristics;
@@ -216,6 +269,8 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         std::list<std::shared_ptr<HalRequest>> mRequestList;
         bool mProcessingRequest = false;
         uint32_t mProcessingFrameNumber = 0;
+        // requests passed to the pipeline stages and not returned yet
+        size_t mPipelineRequestCount = 0;
 
         // V4L2 frameIn
         // (MJPG decode)-> mYu12Frame
@@ -232,11 +287,36 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
         uint32_t mTestPatternData[4] = {0, 0, 0, 0};
         bool mCameraMuted = false;
         uint32_t mBlobBufferSize = 0;  // 0 -> HAL derive buffer size, else: use given size
+        // Decodes into frames smaller than the V4L2 frames when the streams allow it, which
+        // makes mYu12Frame and the decoded frames smaller too
+        std::unique_ptr<MjpegDecoder> mMjpegDecoder;
+        std::optional<int> mThreadPriority;
 
         std::string mExifMake;
         std::string mExifModel;
 
         const std::shared_ptr<BufferRequestThread> mBufferRequestThread;
+
+        std::mutex mPipelineLock;  // Protect access to the pipeline queues and decoded frames
+        std::condition_variable mPipelineCond;  // signaled when a job or a frame is available
+        std::deque<PipelineJob> mPipelineQueues[PIPELINE_STAGE_COUNT];
+        bool mStageExited[PIPELINE_STAGE_COUNT] = {false, false};
+        std::vector<std::shared_ptr<AllocatedFrame>> mFreeDecodedFrames;
+        bool mPipelineExit = false;
+        bool mPipelineFailed = false;
+        std::thread mPipelineThreads[PIPELINE_STAGE_COUNT];
+        // The V4L2 frames decoded by 'threadLoop', the first one is 'mYu12Frame'. All of them
+        // are kept in 'mFreeDecodedFrames' while the pipeline is idle. The other intermediate
+        // buffers are used by the convert stage, except the following ones, which are owned by
+        // the JPEG stage, together with 'mYu12ThumbFrame'. The buffers are only reallocated
+        // while the pipeline is idle, so the stages use them without holding 'mBufferLock'.
+        std::vector<std::shared_ptr<AllocatedFrame>> mDecodedFrames;
+        FrameMap mJpegIntermediateBuffers;
+        FrameMap mJpegScaledYu12Frames;
+        StripJpegEncoder mJpegEncoder;
+
+        // The frames of the previous stream configurations, for the next ones
+        AllocatedFramePool mFramePool;
     };
 
   private:
@@ -250,7 +330,9 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     Status initStatus() const;
     status_t initDefaultRequests();
 
-    status_t fillCaptureResult(common::V1_0::helper::CameraMetadata& md, nsecs_t timestamp);
+    // Writes the result metadata of a request with the settings 'md' into 'out'
+    status_t fillCaptureResult(common::V1_0::helper::CameraMetadata& md, nsecs_t timestamp,
+                               std::vector<uint8_t>* out);
     int configureV4l2StreamLocked(const SupportedV4L2Format& fmt, double fps = 0.0);
     int v4l2StreamOffLocked();
 
@@ -282,6 +364,9 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     Size getMaxThumbResolution() const;
 
     int waitForV4L2BufferReturnLocked(std::unique_lock<std::mutex>& lk);
+    // Adjusts the V4L2 buffer count of the next stream configurations from the statistics of
+    // the current one. Called with mLock held before the stream is turned off.
+    void updateV4l2BufferCountAdjustLocked();
 
     // Main body of switchToOffline. This method does not invoke any callbacks
     // but instead returns the necessary callbacks in output arguments so callers
@@ -332,12 +417,43 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     SupportedV4L2Format mV4l2StreamingFmt;
     double mV4l2StreamingFps = 0.0;
     size_t mV4L2BufferCount = 0;
+    // Added to the buffer count of ExternalCameraConfig, kept across stream configurations
+    int mV4l2BufferCountAdjust = 0;
+
+    // Durations counted in buckets doubling from 1ms, the last one is unbounded
+    struct LatencyHistogram {
+        static constexpr int kBucketCount = 10;
+        uint64_t buckets[kBucketCount] = {};
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+
+        void add(nsecs_t duration);
+        void dump(int fd, const char* name) const;
+    };
+
+    // Statistics of the V4L2 buffer queue, reset when the stream is turned on
+    struct V4l2QueueStats {
+        // waits for the HAL to return a buffer, when it holds all of them
+        LatencyHistogram bufferReturnWait;
+        // waits for the driver in VIDIOC_DQBUF
+        LatencyHistogram dequeueWait;
+        // dequeued frames by the number of buffers the HAL already held
+        std::vector<uint64_t> inflightCounts;
+        uint64_t frames = 0;
+        // frames the driver skipped, from the gaps in the buffer sequence numbers
+        uint64_t droppedFrames = 0;
+        uint64_t errorFrames = 0;
+        bool hasSequence = false;
+        uint32_t lastSequence = 0;
+    };
 
     static const int kBufferWaitTimeoutSec = 3;  // TODO: handle long exposure (or not allowing)
-    std::mutex mV4l2BufferLock;                  // protect the buffer count and condition below
+    std::mutex mV4l2BufferLock;  // protect the buffer count, condition and statistics below
     std::condition_variable mV4L2BufferReturned;
     size_t mNumDequeuedV4l2Buffers = 0;
     uint32_t mMaxV4L2BufferSize = 0;
+    V4l2QueueStats mV4l2QueueStats;
 
     // Not protected by mLock (but might be used when mLock is locked)
     std::shared_ptr<OutputThread> mOutputThread;
@@ -365,11 +481,11 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     /* Beginning of members not changed after initialize() */
     using RequestMetadataQueue = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
     std::unique_ptr<RequestMetadataQueue> mRequestMetadataQueue;
-    using ResultMetadataQueue = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
     std::shared_ptr<ResultMetadataQueue> mResultMetadataQueue;
 
     // Protect against invokeProcessCaptureResultCallback()
     Mutex mProcessCaptureResultLock;
+    ResultMetadataStats mResultMetadataStats;  // protected by mProcessCaptureResultLock
 
     // tracks last seen stream config counter
     int32_t mLastStreamConfigCounter = -1;
@@ -379,6 +495,8 @@ class ExternalCameraDeviceSession : public BnCameraDeviceSession, public OutputT
     const Size mMaxThumbResolution;
     const Size mMaxJpegResolution;
 
+    CaptureResultTemplate mResultTemplate;
+
     std::string mExifMake;
     std::string mExifModel;
     /* End of members not changed after initialize() */
@@ -26,12 +26,9 @@
 #include <aidlcommonsupport/NativeHandle.h>
 #include <convert.h>
 #include <linux/videodev2.h>
-#include <sync/sync.h>
+#include <system/thread_defs.h>
 #include <utils/Trace.h>
 
-#define HAVE_JPEG  // required for libyuv.h to export MJPEG decode APIs
-#include <libyuv.h>
-
 namespace {
 
 // Size of request/result metadata fast message queue. Change to 0 to always use hwbinder buffer.
@@ -66,6 +63,7 @@ ExternalCameraOfflineSession::ExternalCameraOfflineSession(
       mExifModel(exifModel),
       mBlobBufferSize(blobBufferSize),
       mAfTrigger(afTrigger),
+      mResultTemplate(chars),
       mOfflineStreams(offlineStreams),
       mOfflineReqs(offlineReqs),
       mCirculatingBuffers(circulatingBuffers) {}
@@ -74,9 +72,15 @@ ExternalCameraOfflineSession::~ExternalCameraOfflineSession() {
     close();
 }
 
-bool ExternalCameraOfflineSession::initialize() {
+bool ExternalCameraOfflineSession::initialize(size_t maxResultSize) {
+    // The queue only needs to hold the results of the offline requests
+    size_t queueSize = maxResultSize == 0
+                               ? kMetadataMsgQueueSize
+                               : getResultMetadataQueueSize(
+                                         maxResultSize,
+                                         std::max<size_t>(mOfflineReqs.size(), 1), maxResultSize);
     mResultMetadataQueue =
-            std::make_shared<ResultMetadataQueue>(kMetadataMsgQueueSize, false /* non blocking */);
+            std::make_shared<ResultMetadataQueue>(queueSize, false /* non blocking */);
     if (!mResultMetadataQueue->isValid()) {
         ALOGE("%s: invalid result fmq", __FUNCTION__);
         return true;
@@ -127,27 +131,18 @@ Status ExternalCameraOfflineSession::processCaptureResult(std::shared_ptr<HalReq
     }
 
     // Fill capture result metadata
-    fillCaptureResult(req->setting, req->shutterTs);
-    const camera_metadata_t* rawResult = req->setting.getAndLock();
-    convertToAidl(rawResult, &result.result);
-    req->setting.unlock(rawResult);
+    fillCaptureResult(req->setting, req->shutterTs, &result.result.metadata);
 
     // Callback into framework
     invokeProcessCaptureResultCallback(results, /* tryWriteFmq */ true);
     freeReleaseFences(results);
+    mResultTemplate.recycle(std::move(result.result.metadata));
     return Status::OK;
 }
 
-#define UPDATE(md, tag, data, size)               \
-    do {                                          \
-        if ((md).update((tag), (data), (size))) { \
-            ALOGE("Update " #tag " failed!");     \
-            return BAD_VALUE;                     \
-        }                                         \
-    } while (0)
-
-status_t ExternalCameraOfflineSession::fillCaptureResult(common::V1_0::helper::CameraMetadata md,
-                                                         nsecs_t timestamp) {
+status_t ExternalCameraOfflineSession::fillCaptureResult(common::V1_0::helper::CameraMetadata& md,
+                                                         nsecs_t timestamp,
+                                                         std::vector<uint8_t>* out) {
     bool afTrigger = false;
     {
         std::lock_guard<std::mutex> lk(mAfTriggerLock);
@@ -171,11 +166,8 @@ status_t ExternalCameraOfflineSession::fillCaptureResult(common::V1_0::helper::C
     } else {
         afState = ANDROID_CONTROL_AF_STATE_INACTIVE;
     }
-    UPDATE(md, ANDROID_CONTROL_AF_STATE, &afState, 1);
 
-    camera_metadata_ro_entry activeArraySize = mChars.find(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE);
-
-    return fillCaptureResultCommon(md, timestamp, activeArraySize);
+    return mResultTemplate.fill(md, afState, timestamp, out);
 }
 void ExternalCameraOfflineSession::invokeProcessCaptureResultCallback(
         std::vector<CaptureResult>& results, bool tryWriteFmq) {
@@ -187,22 +179,8 @@ void ExternalCameraOfflineSession::invokeProcessCaptureResultCallback(
             return;
         }
     }
-    if (tryWriteFmq && mResultMetadataQueue->availableToWrite() > 0) {
-        for (CaptureResult& result : results) {
-            if (!result.result.metadata.empty()) {
-                if (mResultMetadataQueue->write(
-                            reinterpret_cast<int8_t*>(result.result.metadata.data()),
-                            result.result.metadata.size())) {
-                    result.fmqResultSize = result.result.metadata.size();
-                    result.result.metadata.clear();
-                } else {
-                    ALOGW("%s: couldn't utilize fmq, fall back to hwbinder", __FUNCTION__);
-                    result.fmqResultSize = 0;
-                }
-            } else {
-                result.fmqResultSize = 0;
-            }
-        }
+    if (tryWriteFmq) {
+        writeResultMetadataToFmq(*mResultMetadataQueue, results, &mResultMetadataStats);
     }
     auto status = mCallback->processCaptureResult(results);
     if (!status.isOk()) {
@@ -312,6 +290,8 @@ void ExternalCameraOfflineSession::initOutputThread() {
                                                    mBufferRequestThread, mOfflineReqs);
 
     mOutputThread->setExifMakeModel(mExifMake, mExifModel);
+    // Offline captures must not compete with the preview of the next session
+    mOutputThread->setThreadPriority(ANDROID_PRIORITY_BACKGROUND);
 
     Size inputSize = {mOfflineReqs[0]->frameIn->mWidth, mOfflineReqs[0]->frameIn->mHeight};
     Size maxThumbSize = getMaxThumbnailResolution(mChars);
@@ -368,189 +348,27 @@ void ExternalCameraOfflineSession::cleanupBuffersLocked(int32_t id) {
 }
 
 bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
-    auto parent = mParent.lock();
-    if (parent == nullptr) {
-        ALOGE("%s: session has been disconnected!", __FUNCTION__);
-        return false;
-    }
-
-    if (mOfflineReqs.empty()) {
-        ALOGI("%s: all offline requests are processed. Stopping.", __FUNCTION__);
-        return false;
-    }
-
-    std::shared_ptr<HalRequest> req = mOfflineReqs.front();
-    mOfflineReqs.pop_front();
-
-    auto onDeviceError = [&](auto... args) {
-        ALOGE(args...);
-        parent->notifyError(req->frameNumber, /*stream*/ -1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
-        return false;
-    };
-
-    if (req->frameIn->mFourcc != V4L2_PIX_FMT_MJPEG && req->frameIn->mFourcc != V4L2_PIX_FMT_Z16) {
-        return onDeviceError("%s: do not support V4L2 format %c%c%c%c", __FUNCTION__,
-                             req->frameIn->mFourcc & 0xFF, (req->frameIn->mFourcc >> 8) & 0xFF,
-                             (req->frameIn->mFourcc >> 16) & 0xFF,
-                             (req->frameIn->mFourcc >> 24) & 0xFF);
-    }
-
-    int res = requestBufferStart(req->buffers);
-    if (res != 0) {
-        ALOGE("%s: send BufferRequest failed! res %d", __FUNCTION__, res);
-        return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
-    }
-
-    std::unique_lock<std::mutex> lk(mBufferLock);
-    // Convert input V4L2 frame to YU12 of the same size
-    // TODO: see if we can save some computation by converting to YV12 here
-    uint8_t* inData;
-    size_t inDataSize;
-    if (req->frameIn->getData(&inData, &inDataSize) != 0) {
-        lk.unlock();
-        return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
-    }
-
-    // TODO: in some special case maybe we can decode jpg directly to gralloc output?
-    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
-        ATRACE_BEGIN("MJPGtoI420");
-        int convRes = libyuv::MJPGToI420(
-                inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
-                mYu12FrameLayout.yStride, static_cast<uint8_t*>(mYu12FrameLayout.cb),
-                mYu12FrameLayout.cStride, static_cast<uint8_t*>(mYu12FrameLayout.cr),
-                mYu12FrameLayout.cStride, mYu12Frame->mWidth, mYu12Frame->mHeight,
-                mYu12Frame->mWidth, mYu12Frame->mHeight);
-        ATRACE_END();
-
-        if (convRes != 0) {
-            // For some webcam, the first few V4L2 frames might be malformed...
-            ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, convRes);
-            lk.unlock();
-            Status st = parent->processCaptureRequestError(req);
-            if (st != Status::OK) {
-                return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
-            }
-            signalRequestDone();
-            return true;
+    if (!mOfflineReqs.empty()) {
+        // The offline requests go through the same pipeline as the online ones
+        for (const auto& req : mOfflineReqs) {
+            submitRequest(req);
         }
+        mOfflineReqs.clear();
     }
 
-    ATRACE_BEGIN("Wait for BufferRequest done");
-    res = waitForBufferRequestDone(&req->buffers);
-    ATRACE_END();
-
-    if (res != 0) {
-        ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
-        lk.unlock();
-        return onDeviceError("%s: failed to process buffer request error!", __FUNCTION__);
-    }
-
-    ALOGV("%s processing new request", __FUNCTION__);
-    const int kSyncWaitTimeoutMs = 500;
-    for (auto& halBuf : req->buffers) {
-        if (*(halBuf.bufPtr) == nullptr) {
-            ALOGW("%s: buffer for stream %d missing", __FUNCTION__, halBuf.streamId);
-            halBuf.fenceTimeout = true;
-        } else if (halBuf.acquireFence >= 0) {
-            int ret = sync_wait(halBuf.acquireFence, kSyncWaitTimeoutMs);
-            if (ret) {
-                halBuf.fenceTimeout = true;
-            } else {
-                ::close(halBuf.acquireFence);
-                halBuf.acquireFence = -1;
+    {
+        std::unique_lock<std::mutex> lk(mRequestListLock);
+        if (mRequestList.empty()) {
+            // Wait for the last requests to leave the pipeline
+            while (!isIdleLocked() && !exitPending()) {
+                mRequestDoneCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
             }
+            ALOGI("%s: all offline requests are processed. Stopping.", __FUNCTION__);
+            return false;
         }
-
-        if (halBuf.fenceTimeout) {
-            continue;
-        }
-
-        // Gralloc lockYCbCr the buffer
-        switch (halBuf.format) {
-            case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req->setting);
-
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: createJpegLocked failed with %d", __FUNCTION__, ret);
-                }
-            } break;
-            case PixelFormat::Y16: {
-                void* outLayout = sHandleImporter.lock(
-                        *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), inDataSize);
-
-                std::memcpy(outLayout, inData, inDataSize);
-
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
-                }
-            } break;
-            case PixelFormat::YCBCR_420_888:
-            case PixelFormat::YV12: {
-                android::Rect outRect{0, 0, static_cast<int32_t>(halBuf.width),
-                                      static_cast<int32_t>(halBuf.height)};
-                android_ycbcr result = sHandleImporter.lockYCbCr(
-                        *(halBuf.bufPtr), static_cast<uint64_t>(halBuf.usage), outRect);
-                ALOGV("%s: outLayout y %p cb %p cr %p y_str %zu c_str %zu c_step %zu", __FUNCTION__,
-                      result.y, result.cb, result.cr, result.ystride, result.cstride,
-                      result.chroma_step);
-                if (result.ystride > UINT32_MAX || result.cstride > UINT32_MAX ||
-                    result.chroma_step > UINT32_MAX) {
-                    return onDeviceError("%s: lockYCbCr failed. Unexpected values!", __FUNCTION__);
-                }
-                YCbCrLayout outLayout = {.y = result.y,
-                                         .cb = result.cb,
-                                         .cr = result.cr,
-                                         .yStride = static_cast<uint32_t>(result.ystride),
-                                         .cStride = static_cast<uint32_t>(result.cstride),
-                                         .chromaStep = static_cast<uint32_t>(result.chroma_step)};
-
-                // Convert to output buffer size/format
-                uint32_t outputFourcc = getFourCcFromLayout(outLayout);
-                ALOGV("%s: converting to format %c%c%c%c", __FUNCTION__, outputFourcc & 0xFF,
-                      (outputFourcc >> 8) & 0xFF, (outputFourcc >> 16) & 0xFF,
-                      (outputFourcc >> 24) & 0xFF);
-
-                YCbCrLayout cropAndScaled;
-                ATRACE_BEGIN("cropAndScaleLocked");
-                int ret = cropAndScaleLocked(mYu12Frame, Size{halBuf.width, halBuf.height},
-                                             &cropAndScaled);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: crop and scale failed!", __FUNCTION__);
-                }
-
-                Size sz{halBuf.width, halBuf.height};
-                ATRACE_BEGIN("formatConvert");
-                ret = formatConvert(cropAndScaled, outLayout, sz, outputFourcc);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: format coversion failed!", __FUNCTION__);
-                }
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
-                }
-            } break;
-            default:
-                lk.unlock();
-                return onDeviceError("%s: unknown output format %x", __FUNCTION__, halBuf.format);
-        }
-    }  // for each buffer
-    mScaledYu12Frames.clear();
-
-    // Don't hold the lock while calling back to parent
-    lk.unlock();
-    Status st = parent->processCaptureResult(req);
-    if (st != Status::OK) {
-        return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
     }
-    signalRequestDone();
-    return true;
+
+    return ExternalCameraDeviceSession::OutputThread::threadLoop();
 }
 
 }  // namespace implementation
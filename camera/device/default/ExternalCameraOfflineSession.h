@@ -53,7 +53,8 @@ class ExternalCameraOfflineSession final : public BnCameraOfflineSession,
 
     ~ExternalCameraOfflineSession() override;
 
-    bool initialize();
+    // 'maxResultSize' is the largest result metadata of the device session, 0 if unknown
+    bool initialize(size_t maxResultSize);
 
     // Methods from OutputThreadInterface
     Status importBuffer(int32_t streamId, uint64_t bufId, buffer_handle_t buf,
@@ -92,7 +93,9 @@ class ExternalCameraOfflineSession final : public BnCameraOfflineSession,
         std::deque<std::shared_ptr<HalRequest>> mOfflineReqs;
     };  // OutputThread
 
-    status_t fillCaptureResult(common::V1_0::helper::CameraMetadata md, nsecs_t timestamp);
+    // Writes the result metadata of a request with the settings 'md' into 'out'
+    status_t fillCaptureResult(common::V1_0::helper::CameraMetadata& md, nsecs_t timestamp,
+                               std::vector<uint8_t>* out);
     void invokeProcessCaptureResultCallback(std::vector<CaptureResult>& results, bool tryWriteFmq);
     void initOutputThread();
     void cleanupBuffersLocked(int32_t id);
@@ -113,6 +116,8 @@ class ExternalCameraOfflineSession final : public BnCameraOfflineSession,
     std::mutex mAfTriggerLock;  // protect mAfTrigger
     bool mAfTrigger;
 
+    CaptureResultTemplate mResultTemplate;
+
     const std::vector<Stream> mOfflineStreams;
     std::deque<std::shared_ptr<HalRequest>> mOfflineReqs;
 
@@ -122,11 +127,11 @@ class ExternalCameraOfflineSession final : public BnCameraOfflineSession,
 
     static HandleImporter sHandleImporter;
 
-    using ResultMetadataQueue = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
     std::shared_ptr<ResultMetadataQueue> mResultMetadataQueue;
 
     // Protect against invokeProcessCaptureResultCallback()
     Mutex mProcessCaptureResultLock;
+    ResultMetadataStats mResultMetadataStats;  // protected by mProcessCaptureResultLock
 
     std::shared_ptr<ICameraDeviceCallback> mCallback;
 
@@ -20,12 +20,23 @@
 #include "ExternalCameraUtils.h"
 
 #include <aidlcommonsupport/NativeHandle.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
 #include <jpeglib.h>
 #include <linux/videodev2.h>
 #include <log/log.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <utils/Timers.h>
+#include <utils/Trace.h>
 #include <algorithm>
 #include <cinttypes>
 #include <cmath>
+#include <csetjmp>
+#include <cstring>
+#include <thread>
 
 #define HAVE_JPEG  // required for libyuv.h to export MJPEG decode APIs
 #include <libyuv.h>
@@ -168,10 +179,30 @@ ExternalCameraConfig ExternalCameraConfig::loadFromCfg(const char* cfgPath) {
         ret.orientation = orientation->IntAttribute("degree", /*Default*/ kDefaultOrientation);
     }
 
+    XMLElement* mjpegDecoder = deviceCfg->FirstChildElement("MjpegDecoder");
+    if (mjpegDecoder == nullptr) {
+        ALOGI("%s: no mjpeg decoder specified", __FUNCTION__);
+    } else {
+        const char* type = mjpegDecoder->Attribute("type");
+        if (type == nullptr || strcmp(type, "libyuv") == 0) {
+            ret.mjpegDecoderType = MjpegDecoderType::LIBYUV;
+        } else if (strcmp(type, "libjpeg_scaled") == 0) {
+            ret.mjpegDecoderType = MjpegDecoderType::LIBJPEG_SCALED;
+        } else if (strcmp(type, "v4l2_m2m") == 0) {
+            ret.mjpegDecoderType = MjpegDecoderType::V4L2_M2M;
+        } else {
+            ALOGW("%s: unknown mjpeg decoder type %s, using libyuv", __FUNCTION__, type);
+        }
+        const char* device = mjpegDecoder->Attribute("device");
+        if (device != nullptr) {
+            ret.mjpegDecoderDevice = device;
+        }
+    }
+
     ALOGI("%s: external camera cfg loaded: maxJpgBufSize %d,"
-          " num video buffers %d, num still buffers %d, orientation %d",
+          " num video buffers %d, num still buffers %d, orientation %d, mjpeg decoder %d",
           __FUNCTION__, ret.maxJpegBufSize, ret.numVideoBuffers, ret.numStillBuffers,
-          ret.orientation);
+          ret.orientation, static_cast<int>(ret.mjpegDecoderType));
     for (const auto& limit : ret.fpsLimits) {
         ALOGI("%s: fpsLimitList: %dx%d@%f", __FUNCTION__, limit.size.width, limit.size.height,
               limit.fpsUpperBound);
@@ -220,7 +251,8 @@ ExternalCameraConfig::ExternalCameraConfig()
       numVideoBuffers(kDefaultNumVideoBuffer),
       numStillBuffers(kDefaultNumStillBuffer),
       depthEnabled(false),
-      orientation(kDefaultOrientation) {
+      orientation(kDefaultOrientation),
+      mjpegDecoderType(MjpegDecoderType::LIBYUV) {
     fpsLimits.push_back({/* size */ {/* width */ 640, /* height */ 480}, /* fpsUpperBound */ 30.0});
     fpsLimits.push_back({/* size */ {/* width */ 1280, /* height */ 720}, /* fpsUpperBound */ 7.5});
     fpsLimits.push_back(
@@ -299,7 +331,7 @@ int AllocatedFrame::getData(uint8_t** outData, size_t* dataSize) {
     if (ret != 0) {
         return ret;
     }
-    *outData = mData.data();
+    *outData = mAlignedData;
     *dataSize = mBufferSize;
     return 0;
 }
@@ -341,15 +373,19 @@ int AllocatedFrame::allocate(YCbCrLayout* out) {
     size_t padding = requiredCbWidth - cbWidth;
     size_t finalSize = dataSize + padding;
 
-    if (mData.size() != finalSize) {
-        mData.resize(finalSize);
+    // The frame starts on a cache line, so do the planes of the frames whose width is a multiple
+    // of 32, which keeps the frame data contiguous for getData
+    if (mAlignedData == nullptr) {
+        mData.resize(finalSize + kAlignment - 1);
         mBufferSize = dataSize;
+        uintptr_t base = reinterpret_cast<uintptr_t>(mData.data());
+        mAlignedData = mData.data() + ((kAlignment - base % kAlignment) % kAlignment);
     }
 
     if (out != nullptr) {
-        out->y = mData.data();
+        out->y = mAlignedData;
         out->yStride = mWidth;
-        uint8_t* cbStart = mData.data() + mWidth * mHeight;
+        uint8_t* cbStart = mAlignedData + mWidth * mHeight;
         uint8_t* crStart = cbStart + mWidth * mHeight / 4;
         out->cb = cbStart;
         out->cr = crStart;
@@ -379,9 +415,9 @@ int AllocatedFrame::getCroppedLayout(const IMapper::Rect& rect, YCbCrLayout* out
         return -1;
     }
 
-    out->y = mData.data() + mWidth * rect.top + rect.left;
+    out->y = mAlignedData + mWidth * rect.top + rect.left;
     out->yStride = mWidth;
-    uint8_t* cbStart = mData.data() + mWidth * mHeight;
+    uint8_t* cbStart = mAlignedData + mWidth * mHeight;
     uint8_t* crStart = cbStart + mWidth * mHeight / 4;
     out->cb = cbStart + mWidth * rect.top / 4 + rect.left / 2;
     out->cr = crStart + mWidth * rect.top / 4 + rect.left / 2;
@@ -390,6 +426,61 @@ int AllocatedFrame::getCroppedLayout(const IMapper::Rect& rect, YCbCrLayout* out
     return 0;
 }
 
+std::shared_ptr<AllocatedFrame> AllocatedFramePool::acquire(int32_t width, int32_t height) {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        // The most recently released frames first, the others are more likely to be trimmed
+        for (auto it = mIdleFrames.rbegin(); it != mIdleFrames.rend(); ++it) {
+            if (it->frame->mWidth == width && it->frame->mHeight == height) {
+                std::shared_ptr<AllocatedFrame> frame = std::move(it->frame);
+                mIdleBytes -= frame->getAllocationSize();
+                mIdleFrames.erase(std::next(it).base());
+                return frame;
+            }
+        }
+    }
+
+    auto frame = std::make_shared<AllocatedFrame>(width, height);
+    if (frame->allocate() != 0) {
+        ALOGE("%s: allocating YU12 frame %dx%d failed!", __FUNCTION__, width, height);
+        return nullptr;
+    }
+    return frame;
+}
+
+void AllocatedFramePool::release(std::shared_ptr<AllocatedFrame> frame) {
+    if (frame == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(mLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    mIdleBytes += frame->getAllocationSize();
+    mIdleFrames.push_back({std::move(frame), now});
+    trimLocked(now);
+}
+
+void AllocatedFramePool::trim() {
+    std::lock_guard<std::mutex> lk(mLock);
+    trimLocked(systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
+void AllocatedFramePool::trimLocked(nsecs_t now) {
+    while (!mIdleFrames.empty() &&
+           (mIdleBytes > kMaxIdleBytes ||
+            now - mIdleFrames.front().releaseTime > milliseconds_to_nanoseconds(kIdleTrimTimeMs))) {
+        const auto& frame = mIdleFrames.front().frame;
+        ALOGV("%s: freeing idle frame %dx%d", __FUNCTION__, frame->mWidth, frame->mHeight);
+        mIdleBytes -= frame->getAllocationSize();
+        mIdleFrames.pop_front();
+    }
+}
+
+void AllocatedFramePool::clear() {
+    std::lock_guard<std::mutex> lk(mLock);
+    mIdleFrames.clear();
+    mIdleBytes = 0;
+}
+
 bool isAspectRatioClose(float ar1, float ar2) {
     constexpr float kAspectRatioMatchThres = 0.025f;  // This threshold is good enough to
                                                       // distinguish 4:3/16:9/20:9 1.33/1.78/2
@@ -567,9 +658,480 @@ int formatConvert(const YCbCrLayout& in, const YCbCrLayout& out, Size sz, uint32
     return 0;
 }
 
+namespace {
+
+class LibyuvMjpegDecoder : public MjpegDecoder {
+  public:
+    const char* getName() const override { return "libyuv"; }
+
+    int decode(const uint8_t* in, size_t inDataSize, const Size& inSize, const YCbCrLayout& out,
+               const Size& outSize) override {
+        ATRACE_NAME("MJPGToI420 libyuv");
+        return libyuv::MJPGToI420(in, inDataSize, static_cast<uint8_t*>(out.y), out.yStride,
+                                  static_cast<uint8_t*>(out.cb), out.cStride,
+                                  static_cast<uint8_t*>(out.cr), out.cStride, inSize.width,
+                                  inSize.height, outSize.width, outSize.height);
+    }
+};
+
+// Decodes with the DCT scaling of libjpeg-turbo, which skips most of the IDCT work when the
+// frame is decoded at 1/2, 1/4 or 1/8 of its size.
+class LibjpegScaledMjpegDecoder : public MjpegDecoder {
+  public:
+    const char* getName() const override { return "libjpeg_scaled"; }
+
+    Size getOutputSize(const Size& inSize, const Size& minSize) const override {
+        for (int denom : {8, 4, 2}) {
+            Size sz = getScaledSize(inSize, denom);
+            // AllocatedFrame only supports even sizes
+            if (sz.width % 2 == 0 && sz.height % 2 == 0 && sz.width >= minSize.width &&
+                sz.height >= minSize.height) {
+                return sz;
+            }
+        }
+        return inSize;
+    }
+
+    int decode(const uint8_t* in, size_t inDataSize, const Size& inSize, const YCbCrLayout& out,
+               const Size& outSize) override;
+
+  private:
+    // libjpeg rounds the scaled size up
+    static Size getScaledSize(const Size& sz, int denom) {
+        return {(sz.width + denom - 1) / denom, (sz.height + denom - 1) / denom};
+    }
+
+    std::vector<uint8_t> mArgb;
+};
+
+int LibjpegScaledMjpegDecoder::decode(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                                      const YCbCrLayout& out, const Size& outSize) {
+    ATRACE_NAME("MJPGToI420 libjpeg_scaled");
+    int denom = 1;
+    while (denom < 8 && !(getScaledSize(inSize, denom) == outSize)) {
+        denom *= 2;
+    }
+    if (!(getScaledSize(inSize, denom) == outSize)) {
+        ALOGE("%s: can not decode %dx%d frame to %dx%d", __FUNCTION__, inSize.width,
+              inSize.height, outSize.width, outSize.height);
+        return -EINVAL;
+    }
+
+    // Unlike the compressor, the decompressor can not go on after an error, so error_exit
+    // jumps back here
+    struct CustomJpegErrorMgr {
+        struct jpeg_error_mgr mgr;
+        jmp_buf jmp;
+    } jerr;
+    jpeg_decompress_struct cinfo = {};
+    cinfo.err = jpeg_std_error(&jerr.mgr);
+    jerr.mgr.output_message = [](j_common_ptr cinfo) {
+        char buffer[JMSG_LENGTH_MAX];
+        (*cinfo->err->format_message)(cinfo, buffer);
+        ALOGE("libjpeg error: %s", buffer);
+    };
+    jerr.mgr.error_exit = [](j_common_ptr cinfo) {
+        (*cinfo->err->output_message)(cinfo);
+        longjmp(reinterpret_cast<CustomJpegErrorMgr*>(cinfo->err)->jmp, 1);
+    };
+    jpeg_create_decompress(&cinfo);
+    if (setjmp(jerr.jmp) != 0) {
+        jpeg_destroy_decompress(&cinfo);
+        return -EINVAL;
+    }
+
+    jpeg_mem_src(&cinfo, const_cast<uint8_t*>(in), inDataSize);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    // The byte order of the libyuv ARGB format
+    cinfo.out_color_space = JCS_EXT_BGRA;
+    cinfo.dct_method = JDCT_IFAST;
+    jpeg_start_decompress(&cinfo);
+    if (cinfo.output_width != outSize.width || cinfo.output_height != outSize.height) {
+        ALOGE("%s: decoded size %ux%u, expected %dx%d", __FUNCTION__, cinfo.output_width,
+              cinfo.output_height, outSize.width, outSize.height);
+        jpeg_destroy_decompress(&cinfo);
+        return -EINVAL;
+    }
+
+    const size_t stride = outSize.width * 4;
+    mArgb.resize(stride * outSize.height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = mArgb.data() + cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    // Full range like the YCbCr of the JPEG frame, which libyuv::MJPGToI420 outputs as is
+    return libyuv::ARGBToJ420(mArgb.data(), stride, static_cast<uint8_t*>(out.y), out.yStride,
+                              static_cast<uint8_t*>(out.cb), out.cStride,
+                              static_cast<uint8_t*>(out.cr), out.cStride, outSize.width,
+                              outSize.height);
+}
+
+// Decodes with a V4L2 memory-to-memory JPEG decoder, one frame at a time with a single MMAP
+// buffer on each queue. The decoder must accept the capture format set by the HAL, YU12 or
+// NV12 in a single plane. It is replaced by libyuv when it stops working.
+class V4l2M2mMjpegDecoder : public MjpegDecoder {
+  public:
+    ~V4l2M2mMjpegDecoder() override { releaseBuffers(); }
+
+    bool open(const std::string& devicePath);
+
+    const char* getName() const override { return "v4l2_m2m"; }
+
+    int decode(const uint8_t* in, size_t inDataSize, const Size& inSize, const YCbCrLayout& out,
+               const Size& outSize) override;
+
+  private:
+    static const int kDecodeTimeoutMs = 1000;
+
+    struct MappedBuffer {
+        void* data = MAP_FAILED;
+        size_t length = 0;
+    };
+    enum Queue { OUTPUT_QUEUE, CAPTURE_QUEUE, QUEUE_COUNT };
+
+    int configure(const Size& size);
+    int setFormat(Queue queue, uint32_t fourcc, const Size& size, uint32_t sizeImage,
+                  v4l2_format* fmt);
+    int allocateBuffer(Queue queue);
+    void releaseBuffers();
+    int queueBuffer(Queue queue, uint32_t bytesUsed);
+    // Returns 1 if the buffer is flagged with an error
+    int dequeueBuffer(Queue queue);
+    int decodeFrame(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                    const YCbCrLayout& out);
+
+    ::android::base::unique_fd mFd;
+    bool mMultiPlanar = false;
+    uint32_t mTypes[QUEUE_COUNT] = {0, 0};
+    MappedBuffer mBuffers[QUEUE_COUNT];
+    bool mStreaming = false;
+    Size mConfiguredSize = {0, 0};
+    uint32_t mCaptureFourcc = 0;
+    uint32_t mCaptureStride = 0;
+    uint32_t mCaptureHeight = 0;
+    bool mFailed = false;
+    LibyuvMjpegDecoder mFallback;
+};
+
+bool V4l2M2mMjpegDecoder::open(const std::string& devicePath) {
+    mFd.reset(TEMP_FAILURE_RETRY(::open(devicePath.c_str(), O_RDWR | O_NONBLOCK)));
+    if (mFd.get() < 0) {
+        ALOGE("%s: open %s failed: %s", __FUNCTION__, devicePath.c_str(), strerror(errno));
+        return false;
+    }
+
+    v4l2_capability capability = {};
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_QUERYCAP, &capability)) < 0) {
+        ALOGE("%s: VIDIOC_QUERYCAP failed: %s", __FUNCTION__, strerror(errno));
+        return false;
+    }
+    uint32_t caps = (capability.capabilities & V4L2_CAP_DEVICE_CAPS) ? capability.device_caps
+                                                                      : capability.capabilities;
+    if (caps & V4L2_CAP_VIDEO_M2M_MPLANE) {
+        mMultiPlanar = true;
+    } else if (!(caps & V4L2_CAP_VIDEO_M2M)) {
+        ALOGE("%s: %s is not a memory-to-memory device", __FUNCTION__, devicePath.c_str());
+        return false;
+    }
+    if (!(caps & V4L2_CAP_STREAMING)) {
+        ALOGE("%s: %s does not support streaming", __FUNCTION__, devicePath.c_str());
+        return false;
+    }
+    mTypes[OUTPUT_QUEUE] =
+            mMultiPlanar ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    mTypes[CAPTURE_QUEUE] =
+            mMultiPlanar ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ALOGI("%s: using %s (%s)", __FUNCTION__, devicePath.c_str(), capability.card);
+    return true;
+}
+
+int V4l2M2mMjpegDecoder::setFormat(Queue queue, uint32_t fourcc, const Size& size,
+                                   uint32_t sizeImage, v4l2_format* fmt) {
+    *fmt = {};
+    fmt->type = mTypes[queue];
+    if (mMultiPlanar) {
+        fmt->fmt.pix_mp.width = size.width;
+        fmt->fmt.pix_mp.height = size.height;
+        fmt->fmt.pix_mp.pixelformat = fourcc;
+        fmt->fmt.pix_mp.num_planes = 1;
+        fmt->fmt.pix_mp.plane_fmt[0].sizeimage = sizeImage;
+    } else {
+        fmt->fmt.pix.width = size.width;
+        fmt->fmt.pix.height = size.height;
+        fmt->fmt.pix.pixelformat = fourcc;
+        fmt->fmt.pix.sizeimage = sizeImage;
+    }
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_S_FMT, fmt)) < 0) {
+        ALOGE("%s: VIDIOC_S_FMT failed: %s", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    if (mMultiPlanar && fmt->fmt.pix_mp.num_planes != 1) {
+        ALOGE("%s: %u planes are not supported", __FUNCTION__, fmt->fmt.pix_mp.num_planes);
+        return -EINVAL;
+    }
+    return 0;
+}
+
+int V4l2M2mMjpegDecoder::allocateBuffer(Queue queue) {
+    v4l2_requestbuffers reqBuffers = {};
+    reqBuffers.type = mTypes[queue];
+    reqBuffers.memory = V4L2_MEMORY_MMAP;
+    reqBuffers.count = 1;
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_REQBUFS, &reqBuffers)) < 0 ||
+        reqBuffers.count < 1) {
+        ALOGE("%s: VIDIOC_REQBUFS failed: %s", __FUNCTION__, strerror(errno));
+        return -EINVAL;
+    }
+
+    v4l2_plane plane = {};
+    v4l2_buffer buffer = {};
+    buffer.type = mTypes[queue];
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = 0;
+    if (mMultiPlanar) {
+        buffer.m.planes = &plane;
+        buffer.length = 1;
+    }
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_QUERYBUF, &buffer)) < 0) {
+        ALOGE("%s: VIDIOC_QUERYBUF failed: %s", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    size_t length = mMultiPlanar ? plane.length : buffer.length;
+    off_t offset = mMultiPlanar ? plane.m.mem_offset : buffer.m.offset;
+    void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, mFd.get(), offset);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: mmap failed: %s", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    mBuffers[queue] = {data, length};
+    return 0;
+}
+
+void V4l2M2mMjpegDecoder::releaseBuffers() {
+    for (int queue = 0; queue < QUEUE_COUNT; queue++) {
+        if (mStreaming) {
+            TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_STREAMOFF, &mTypes[queue]));
+        }
+        if (mBuffers[queue].data != MAP_FAILED) {
+            munmap(mBuffers[queue].data, mBuffers[queue].length);
+            mBuffers[queue] = {};
+        }
+        if (mFd.get() >= 0) {
+            v4l2_requestbuffers reqBuffers = {};
+            reqBuffers.type = mTypes[queue];
+            reqBuffers.memory = V4L2_MEMORY_MMAP;
+            reqBuffers.count = 0;
+            TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_REQBUFS, &reqBuffers));
+        }
+    }
+    mStreaming = false;
+    mConfiguredSize = {0, 0};
+}
+
+int V4l2M2mMjpegDecoder::configure(const Size& size) {
+    releaseBuffers();
+
+    v4l2_format fmt;
+    // The MJPEG frames of the V4L2 device are smaller than YUYV frames of the same size
+    int ret = setFormat(OUTPUT_QUEUE, V4L2_PIX_FMT_JPEG, size, size.width * size.height * 2,
+                        &fmt);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = setFormat(CAPTURE_QUEUE, V4L2_PIX_FMT_YUV420, size, 0, &fmt);
+    if (ret != 0) {
+        return ret;
+    }
+    if (mMultiPlanar) {
+        mCaptureFourcc = fmt.fmt.pix_mp.pixelformat;
+        mCaptureStride = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+        mCaptureHeight = fmt.fmt.pix_mp.height;
+    } else {
+        mCaptureFourcc = fmt.fmt.pix.pixelformat;
+        mCaptureStride = fmt.fmt.pix.bytesperline;
+        mCaptureHeight = fmt.fmt.pix.height;
+    }
+    if ((mCaptureFourcc != V4L2_PIX_FMT_YUV420 && mCaptureFourcc != V4L2_PIX_FMT_NV12) ||
+        mCaptureStride < static_cast<uint32_t>(size.width) ||
+        mCaptureHeight < static_cast<uint32_t>(size.height)) {
+        ALOGE("%s: unsupported capture format %c%c%c%c, stride %u, height %u", __FUNCTION__,
+              mCaptureFourcc & 0xFF, (mCaptureFourcc >> 8) & 0xFF, (mCaptureFourcc >> 16) & 0xFF,
+              (mCaptureFourcc >> 24) & 0xFF, mCaptureStride, mCaptureHeight);
+        return -EINVAL;
+    }
+
+    for (int queue = 0; queue < QUEUE_COUNT; queue++) {
+        ret = allocateBuffer(static_cast<Queue>(queue));
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    if (mBuffers[CAPTURE_QUEUE].length < mCaptureStride * mCaptureHeight * 3 / 2) {
+        ALOGE("%s: capture buffer of %zu bytes is too small", __FUNCTION__,
+              mBuffers[CAPTURE_QUEUE].length);
+        return -EINVAL;
+    }
+    for (int queue = 0; queue < QUEUE_COUNT; queue++) {
+        if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_STREAMON, &mTypes[queue])) < 0) {
+            ALOGE("%s: VIDIOC_STREAMON failed: %s", __FUNCTION__, strerror(errno));
+            return -errno;
+        }
+        mStreaming = true;
+    }
+    mConfiguredSize = size;
+    return 0;
+}
+
+int V4l2M2mMjpegDecoder::queueBuffer(Queue queue, uint32_t bytesUsed) {
+    v4l2_plane plane = {};
+    v4l2_buffer buffer = {};
+    buffer.type = mTypes[queue];
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = 0;
+    if (mMultiPlanar) {
+        plane.bytesused = bytesUsed;
+        plane.length = mBuffers[queue].length;
+        buffer.m.planes = &plane;
+        buffer.length = 1;
+    } else {
+        buffer.bytesused = bytesUsed;
+    }
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_QBUF, &buffer)) < 0) {
+        ALOGE("%s: VIDIOC_QBUF failed: %s", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    return 0;
+}
+
+int V4l2M2mMjpegDecoder::dequeueBuffer(Queue queue) {
+    pollfd pfd = {.fd = mFd.get(), .events = queue == OUTPUT_QUEUE ? POLLOUT : POLLIN};
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, kDecodeTimeoutMs));
+    if (ret <= 0) {
+        ALOGE("%s: poll %s", __FUNCTION__, ret == 0 ? "timed out" : strerror(errno));
+        return ret == 0 ? -ETIMEDOUT : -errno;
+    }
+
+    v4l2_plane plane = {};
+    v4l2_buffer buffer = {};
+    buffer.type = mTypes[queue];
+    buffer.memory = V4L2_MEMORY_MMAP;
+    if (mMultiPlanar) {
+        buffer.m.planes = &plane;
+        buffer.length = 1;
+    }
+    if (TEMP_FAILURE_RETRY(ioctl(mFd.get(), VIDIOC_DQBUF, &buffer)) < 0) {
+        ALOGE("%s: VIDIOC_DQBUF failed: %s", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    return (buffer.flags & V4L2_BUF_FLAG_ERROR) ? 1 : 0;
+}
+
+int V4l2M2mMjpegDecoder::decodeFrame(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                                     const YCbCrLayout& out) {
+    if (!(mConfiguredSize == inSize)) {
+        int ret = configure(inSize);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    if (inDataSize > mBuffers[OUTPUT_QUEUE].length) {
+        ALOGE("%s: frame of %zu bytes does not fit the %zu bytes buffer", __FUNCTION__,
+              inDataSize, mBuffers[OUTPUT_QUEUE].length);
+        return -EINVAL;
+    }
+    std::memcpy(mBuffers[OUTPUT_QUEUE].data, in, inDataSize);
+
+    int ret = queueBuffer(CAPTURE_QUEUE, 0);
+    if (ret == 0) {
+        ret = queueBuffer(OUTPUT_QUEUE, inDataSize);
+    }
+    int captureRet = ret == 0 ? dequeueBuffer(CAPTURE_QUEUE) : ret;
+    int outputRet = ret == 0 ? dequeueBuffer(OUTPUT_QUEUE) : ret;
+    if (captureRet < 0 || outputRet < 0) {
+        return captureRet < 0 ? captureRet : outputRet;
+    }
+    if (captureRet != 0) {
+        // A malformed frame, the decoder is still usable
+        return 1;
+    }
+
+    const uint8_t* y = static_cast<const uint8_t*>(mBuffers[CAPTURE_QUEUE].data);
+    const uint8_t* c = y + mCaptureStride * mCaptureHeight;
+    if (mCaptureFourcc == V4L2_PIX_FMT_NV12) {
+        libyuv::NV12ToI420(y, mCaptureStride, c, mCaptureStride, static_cast<uint8_t*>(out.y),
+                           out.yStride, static_cast<uint8_t*>(out.cb), out.cStride,
+                           static_cast<uint8_t*>(out.cr), out.cStride, inSize.width,
+                           inSize.height);
+    } else {
+        const uint32_t cStride = mCaptureStride / 2;
+        libyuv::I420Copy(y, mCaptureStride, c, cStride, c + cStride * mCaptureHeight / 2, cStride,
+                         static_cast<uint8_t*>(out.y), out.yStride,
+                         static_cast<uint8_t*>(out.cb), out.cStride,
+                         static_cast<uint8_t*>(out.cr), out.cStride, inSize.width,
+                         inSize.height);
+    }
+    return 0;
+}
+
+int V4l2M2mMjpegDecoder::decode(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                                const YCbCrLayout& out, const Size& outSize) {
+    if (mFailed) {
+        return mFallback.decode(in, inDataSize, inSize, out, outSize);
+    }
+    if (!(outSize == inSize)) {
+        ALOGE("%s: can not scale %dx%d frame to %dx%d", __FUNCTION__, inSize.width,
+              inSize.height, outSize.width, outSize.height);
+        return -EINVAL;
+    }
+    ATRACE_NAME("MJPGToI420 v4l2_m2m");
+    int ret = decodeFrame(in, inDataSize, inSize, out);
+    if (ret < 0) {
+        ALOGE("%s: hardware decoder failed (%d), switching to libyuv", __FUNCTION__, ret);
+        releaseBuffers();
+        mFd.reset();
+        mFailed = true;
+        return mFallback.decode(in, inDataSize, inSize, out, outSize);
+    }
+    return ret;
+}
+
+}  // anonymous namespace
+
+int MjpegDecoder::decode(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                         AllocatedFrame* out) {
+    YCbCrLayout layout;
+    if (out->getLayout(&layout) != 0) {
+        return -EINVAL;
+    }
+    return decode(in, inDataSize, inSize, layout, Size{out->mWidth, out->mHeight});
+}
+
+std::unique_ptr<MjpegDecoder> MjpegDecoder::create(Type type, const std::string& devicePath) {
+    switch (type) {
+        case Type::LIBJPEG_SCALED:
+            return std::make_unique<LibjpegScaledMjpegDecoder>();
+        case Type::V4L2_M2M: {
+            auto decoder = std::make_unique<V4l2M2mMjpegDecoder>();
+            if (decoder->open(devicePath)) {
+                return decoder;
+            }
+            ALOGW("%s: V4L2 M2M decoder '%s' unavailable, using libyuv", __FUNCTION__,
+                  devicePath.c_str());
+        } break;
+        case Type::LIBYUV:
+            break;
+    }
+    return std::make_unique<LibyuvMjpegDecoder>();
+}
+
 int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality,
                    const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
-                   size_t& actualCodeSize) {
+                   size_t& actualCodeSize, int restartInRows) {
     /* libjpeg is a C library so we use C-style "inheritance" by
      * putting libjpeg's jpeg_destination_mgr first in our custom
      * struct. This allows us to cast jpeg_destination_mgr* to
@@ -652,6 +1214,7 @@ int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQualit
     jpeg_set_colorspace(&cinfo, JCS_YCbCr);
     cinfo.raw_data_in = 1;
     cinfo.dct_method = JDCT_IFAST;
+    cinfo.restart_in_rows = restartInRows;
 
     /* Configure sampling factors. The sampling factor is JPEG subsampling 420
      * because the source format is YUV420. Note that libjpeg sampling factors
@@ -718,12 +1281,14 @@ int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQualit
         if (done != batchSize) {
             ALOGE("%s: compressed %u lines, expected %u (total %u/%u)", __FUNCTION__, done,
                   batchSize, cinfo.next_scanline, cinfo.image_height);
+            jpeg_destroy_compress(&cinfo);
             return -1;
         }
     }
 
     /* This will flush everything */
     jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
 
     /* Grab the actual code size and set it */
     actualCodeSize = dmgr.mEncodedSize;
@@ -731,6 +1296,175 @@ int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQualit
     return 0;
 }
 
+namespace {
+
+// Finds, in the JPEG image 'data' written by libjpeg, the end of the APP0 segment, the SOF
+// segment and the start of the entropy coded data. Returns false if the image is not complete.
+bool parseJpegHeader(const uint8_t* data, size_t size, size_t* app0End, size_t* sofPos,
+                     size_t* scanStart) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8 || data[size - 2] != 0xFF ||
+        data[size - 1] != JPEG_EOI) {
+        return false;
+    }
+    *app0End = 2;
+    *sofPos = 0;
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xFF) {
+        const uint8_t marker = data[pos + 1];
+        const size_t end = pos + 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+        if (end > size - 2) {
+            return false;
+        }
+        if (marker == JPEG_APP0) {
+            *app0End = end;
+        } else if (marker == 0xC0 || marker == 0xC1) {
+            *sofPos = pos;
+        } else if (marker == 0xDA) {
+            *scanStart = end;
+            return *sofPos != 0;
+        }
+        pos = end;
+    }
+    return false;
+}
+
+}  // anonymous namespace
+
+StripJpegEncoder::~StripJpegEncoder() {
+    join();
+}
+
+void StripJpegEncoder::cancel() {
+    join();
+    mStrips.clear();
+}
+
+void StripJpegEncoder::join() {
+    for (auto& strip : mStrips) {
+        if (strip.thread.joinable()) {
+            strip.thread.join();
+        }
+    }
+}
+
+void StripJpegEncoder::start(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality,
+                             void* out, size_t maxOutSize) {
+    ATRACE_CALL();
+    cancel();
+    mSize = inSz;
+    mLayout = inLayout;
+    mQuality = jpegQuality;
+    mOut = static_cast<uint8_t*>(out);
+    mMaxOutSize = maxOutSize;
+    if (maxOutSize <= kMaxApp1SegmentSize) {
+        return;
+    }
+
+    // MCU rows of YUV420 are 16 lines
+    const int32_t mcuRows = (inSz.height + 15) / 16;
+    size_t stripCount = 1;
+    if (inSz.width * inSz.height >= kMinStripPixels) {
+        stripCount = std::min<size_t>({kMaxStrips, std::thread::hardware_concurrency(),
+                                       static_cast<size_t>(mcuRows / 8)});
+        stripCount = std::max<size_t>(stripCount, 1);
+    }
+    const int32_t stripRows = (mcuRows + stripCount * 8 - 1) / (stripCount * 8) * 8;
+
+    // The buffer after the space kept for the APP1 segment is split in proportion to the rows
+    const size_t available = maxOutSize - kMaxApp1SegmentSize;
+    uint8_t* stripOut = mOut + kMaxApp1SegmentSize;
+    mStrips.resize(stripCount);
+    for (size_t i = 0; i < stripCount; i++) {
+        const int32_t top = i * stripRows * 16;
+        const int32_t height = (i + 1 == stripCount) ? inSz.height - top : stripRows * 16;
+        Strip& strip = mStrips[i];
+        strip.out = stripOut;
+        strip.maxOutSize = (i + 1 == stripCount)
+                                   ? mOut + maxOutSize - stripOut
+                                   : available * height / inSz.height;
+        stripOut += strip.maxOutSize;
+
+        YCbCrLayout layout = inLayout;
+        layout.y = static_cast<uint8_t*>(inLayout.y) + top * inLayout.yStride;
+        layout.cb = static_cast<uint8_t*>(inLayout.cb) + top / 2 * inLayout.cStride;
+        layout.cr = static_cast<uint8_t*>(inLayout.cr) + top / 2 * inLayout.cStride;
+        const int restartInRows = stripCount > 1 ? 1 : 0;
+        strip.thread = std::thread([&strip, layout, width = inSz.width, height, jpegQuality,
+                                    restartInRows]() {
+            ATRACE_NAME("encodeJpegStrip");
+            strip.ret = encodeJpegYU12(Size{width, height}, layout, jpegQuality, nullptr, 0,
+                                       strip.out, strip.maxOutSize, strip.codeSize,
+                                       restartInRows);
+        });
+    }
+}
+
+int StripJpegEncoder::finish(const void* app1Buffer, size_t app1Size, size_t& actualCodeSize) {
+    ATRACE_CALL();
+    join();
+    bool encoded = !mStrips.empty();
+    for (const auto& strip : mStrips) {
+        encoded = encoded && strip.ret == 0;
+    }
+    int ret = encoded ? joinStrips(app1Buffer, app1Size, actualCodeSize) : -1;
+    if (ret != 0) {
+        ALOGW("%s: encoding %dx%d in %zu strips failed, encoding it in one pass", __FUNCTION__,
+              mSize.width, mSize.height, mStrips.size());
+        ret = encodeJpegYU12(mSize, mLayout, mQuality, app1Buffer, app1Size, mOut, mMaxOutSize,
+                             actualCodeSize);
+    }
+    mStrips.clear();
+    return ret;
+}
+
+int StripJpegEncoder::joinStrips(const void* app1Buffer, size_t app1Size,
+                                 size_t& actualCodeSize) {
+    // The segment length includes the 2 bytes of the length itself
+    if (app1Size + 4 > kMaxApp1SegmentSize) {
+        return -1;
+    }
+
+    // The output is always written before the strip data it moves, so memmove is enough
+    size_t pos = 0;
+    for (size_t i = 0; i < mStrips.size(); i++) {
+        Strip& strip = mStrips[i];
+        size_t app0End, sofPos, scanStart;
+        if (!parseJpegHeader(strip.out, strip.codeSize, &app0End, &sofPos, &scanStart)) {
+            ALOGE("%s: strip %zu is not a valid JPEG image", __FUNCTION__, i);
+            return -1;
+        }
+        // Without the EOI marker
+        const size_t scanEnd = strip.codeSize - 2;
+        if (i == 0) {
+            // The header of the first strip is the header of the image, with the full height
+            strip.out[sofPos + 5] = mSize.height >> 8;
+            strip.out[sofPos + 6] = mSize.height & 0xFF;
+            memmove(mOut, strip.out, app0End);
+            pos = app0End;
+            if (app1Buffer && app1Size) {
+                mOut[pos++] = 0xFF;
+                mOut[pos++] = JPEG_APP0 + 1;
+                mOut[pos++] = (app1Size + 2) >> 8;
+                mOut[pos++] = (app1Size + 2) & 0xFF;
+                memcpy(mOut + pos, app1Buffer, app1Size);
+                pos += app1Size;
+            }
+            memmove(mOut + pos, strip.out + app0End, scanEnd - app0End);
+            pos += scanEnd - app0End;
+        } else {
+            // The previous strips had a multiple of 8 MCU rows, so this is always RST7
+            mOut[pos++] = 0xFF;
+            mOut[pos++] = 0xD7;
+            memmove(mOut + pos, strip.out + scanStart, scanEnd - scanStart);
+            pos += scanEnd - scanStart;
+        }
+    }
+    mOut[pos++] = 0xFF;
+    mOut[pos++] = JPEG_EOI;
+    actualCodeSize = pos;
+    return 0;
+}
+
 Size getMaxThumbnailResolution(const common::V1_0::helper::CameraMetadata& chars) {
     Size thumbSize{0, 0};
     camera_metadata_ro_entry entry = chars.find(ANDROID_JPEG_AVAILABLE_THUMBNAIL_SIZES);
@@ -821,9 +1555,117 @@ status_t fillCaptureResultCommon(CameraMetadata& md, nsecs_t timestamp,
     return OK;
 }
 
+CaptureResultTemplate::CaptureResultTemplate(const CameraMetadata& chars) : mChars(chars) {}
+
+status_t CaptureResultTemplate::fill(CameraMetadata& settings, uint8_t afState,
+                                     nsecs_t timestamp, std::vector<uint8_t>* out) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lk(mLock);
+    const camera_metadata_t* rawSettings = settings.getAndLock();
+    const size_t settingsSize = rawSettings ? get_camera_metadata_size(rawSettings) : 0;
+    status_t ret = OK;
+    if (mResult.isEmpty() || settingsSize != mSettings.size() ||
+        memcmp(rawSettings, mSettings.data(), settingsSize) != 0) {
+        ret = rebuildLocked(rawSettings);
+    }
+    settings.unlock(rawSettings);
+    if (ret != OK) {
+        return ret;
+    }
+
+    camera_metadata_entry entry = mResult.find(ANDROID_CONTROL_AF_STATE);
+    entry.data.u8[0] = afState;
+    entry = mResult.find(ANDROID_SENSOR_TIMESTAMP);
+    entry.data.i64[0] = timestamp;
+
+    if (out->capacity() == 0 && !mSpareBuffers.empty()) {
+        *out = std::move(mSpareBuffers.back());
+        mSpareBuffers.pop_back();
+    }
+    const camera_metadata_t* rawResult = mResult.getAndLock();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(rawResult);
+    out->assign(data, data + get_camera_metadata_size(rawResult));
+    mResult.unlock(rawResult);
+    return OK;
+}
+
+void CaptureResultTemplate::recycle(std::vector<uint8_t>&& buffer) {
+    std::lock_guard<std::mutex> lk(mLock);
+    if (buffer.capacity() != 0 && mSpareBuffers.size() < kMaxSpareBuffers) {
+        buffer.clear();
+        mSpareBuffers.push_back(std::move(buffer));
+    }
+}
+
+status_t CaptureResultTemplate::rebuildLocked(const camera_metadata_t* settings) {
+    ATRACE_CALL();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(settings);
+    mSettings.assign(data, data + (settings ? get_camera_metadata_size(settings) : 0));
+    status_t ret = OK;
+    // The result keeps its storage across rebuilds, reserving room for the settings and for the
+    // tags added below
+    mResult.reset();
+    if (settings != nullptr) {
+        ret = mResult.reserve(get_camera_metadata_entry_count(settings) + kResultEntries,
+                              get_camera_metadata_data_count(settings) + kResultData);
+        if (ret == OK) {
+            ret = mResult.append(settings);
+        }
+        if (ret != OK) {
+            mResult.reset();
+            return ret;
+        }
+    }
+    // The dynamic tags are added with placeholders, so fill only overwrites them
+    const uint8_t afState = ANDROID_CONTROL_AF_STATE_INACTIVE;
+    UPDATE(mResult, ANDROID_CONTROL_AF_STATE, &afState, 1);
+    camera_metadata_ro_entry activeArraySize = mChars.find(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE);
+    ret = fillCaptureResultCommon(mResult, /*timestamp*/ 0, activeArraySize);
+    if (ret != OK) {
+        mResult.reset();
+    }
+    return ret;
+}
+
 #undef ARRAY_SIZE
 #undef UPDATE
 
+void ResultMetadataStats::dump(int fd) const {
+    dprintf(fd, "Result metadata: %" PRIu64 " through fmq, %" PRIu64 " inline (%" PRIu64
+            " bytes), max size %zu\n",
+            fmqResults, inlineResults, inlineBytes, maxResultSize);
+}
+
+size_t getResultMetadataQueueSize(size_t resultSize, size_t resultCount, size_t minSize) {
+    // Whole pages, the FMQ is shared memory
+    const size_t kPageSize = 4096;
+    size_t size = (resultSize * resultCount + kPageSize - 1) / kPageSize * kPageSize;
+    return std::max(size, minSize);
+}
+
+void writeResultMetadataToFmq(ResultMetadataQueue& queue, std::vector<CaptureResult>& results,
+                              ResultMetadataStats* stats) {
+    for (CaptureResult& result : results) {
+        std::vector<uint8_t>& metadata = result.result.metadata;
+        result.fmqResultSize = 0;
+        if (metadata.empty()) {
+            continue;
+        }
+        stats->maxResultSize = std::max(stats->maxResultSize, metadata.size());
+        if (queue.availableToWrite() >= metadata.size() &&
+            queue.write(reinterpret_cast<int8_t*>(metadata.data()), metadata.size())) {
+            result.fmqResultSize = metadata.size();
+            // Keeps the storage, for CaptureResultTemplate::recycle
+            metadata.clear();
+            stats->fmqResults++;
+        } else {
+            ALOGW("%s: couldn't utilize fmq, fall back to hwbinder", __FUNCTION__);
+            stats->inlineResults++;
+            stats->inlineBytes += metadata.size();
+        }
+    }
+}
+
 AllocatedV4L2Frame::AllocatedV4L2Frame(std::shared_ptr<V4L2Frame> frameIn)
     : Frame(frameIn->mWidth, frameIn->mHeight, frameIn->mFourcc) {
     uint8_t* dataIn;
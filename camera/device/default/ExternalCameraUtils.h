@@ -28,10 +28,17 @@
 #include <android/hardware/graphics/mapper/2.0/IMapper.h>
 #include <android/hardware/graphics/mapper/3.0/IMapper.h>
 #include <android/hardware/graphics/mapper/4.0/IMapper.h>
+#include <fmq/AidlMessageQueue.h>
 #include <tinyxml2.h>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using ::aidl::android::hardware::camera::common::Status;
 using ::aidl::android::hardware::camera::device::CaptureResult;
@@ -107,6 +114,13 @@ struct ExternalCameraConfig {
     // The value of android.sensor.orientation
     int32_t orientation;
 
+    // The backend decoding the MJPEG frames, see MjpegDecoder
+    enum class MjpegDecoderType { LIBYUV, LIBJPEG_SCALED, V4L2_M2M };
+    MjpegDecoderType mjpegDecoderType;
+
+    // Video node of the V4L2 memory-to-memory JPEG decoder used by V4L2_M2M
+    std::string mjpegDecoderDevice;
+
   private:
     ExternalCameraConfig();
     static bool updateFpsList(tinyxml2::XMLElement* fpsList, std::vector<FpsLimitation>& fpsLimits);
@@ -182,11 +196,48 @@ class AllocatedFrame : public Frame {
     int allocate(YCbCrLayout* out = nullptr);
     int getLayout(YCbCrLayout* out);
     int getCroppedLayout(const IMapper::Rect&, YCbCrLayout* out);  // return non-zero for bad input
+    // Size of the frame data, including the padding for jpeglib
+    size_t getAllocationSize() const { return mData.size(); }
+
   private:
+    static constexpr size_t kAlignment = 64;  // a cache line
+
     std::mutex mLock;
     std::vector<uint8_t> mData;
-    size_t mBufferSize;  // size of mData before padding. Actual size of mData might be slightly
-                         // bigger to horizontally pad the frame for jpeglib.
+    uint8_t* mAlignedData = nullptr;  // the frame data in mData, aligned to kAlignment
+    size_t mBufferSize;  // size of the frame data before padding. Actual size of mData might be
+                         // slightly bigger to horizontally pad the frame for jpeglib.
+};
+
+// A pool of allocated frames bucketed by size, all frames are YU12. It lives as long as the
+// session, so a reconfiguration reuses the frames of the previous stream configuration instead of
+// allocating new ones. The idle frames are freed after kIdleTrimTimeMs, and the least recently
+// released ones as soon as the idle frames exceed kMaxIdleBytes.
+class AllocatedFramePool {
+  public:
+    static const int64_t kIdleTrimTimeMs = 10000;
+    static const size_t kMaxIdleBytes = 64 << 20;  // 64MB
+
+    // Returns an allocated frame of width x height, or nullptr if the allocation fails
+    std::shared_ptr<AllocatedFrame> acquire(int32_t width, int32_t height);
+    // Returns 'frame' to the pool, the caller must not use it anymore
+    void release(std::shared_ptr<AllocatedFrame> frame);
+    // Frees the frames idle for longer than kIdleTrimTimeMs
+    void trim();
+    void clear();
+
+  private:
+    struct IdleFrame {
+        std::shared_ptr<AllocatedFrame> frame;
+        nsecs_t releaseTime;
+    };
+
+    void trimLocked(nsecs_t now);
+
+    std::mutex mLock;
+    // idle frames in release order
+    std::list<IdleFrame> mIdleFrames;
+    size_t mIdleBytes = 0;
 };
 
 enum CroppingType { HORIZONTAL = 0, VERTICAL = 1 };
@@ -247,9 +298,84 @@ int getCropRect(CroppingType ct, const Size& inSize, const Size& outSize, IMappe
 
 int formatConvert(const YCbCrLayout& in, const YCbCrLayout& out, Size sz, uint32_t format);
 
+// Decodes the MJPEG frames of the V4L2 device into YU12 frames.
+class MjpegDecoder {
+  public:
+    using Type = ::android::hardware::camera::external::common::ExternalCameraConfig::
+            MjpegDecoderType;
+
+    // Falls back to libyuv if the backend can not be initialized. 'devicePath' is only used by
+    // the V4L2_M2M backend.
+    static std::unique_ptr<MjpegDecoder> create(Type type, const std::string& devicePath);
+
+    virtual ~MjpegDecoder() = default;
+
+    virtual const char* getName() const = 0;
+    // Returns the size of the frames decoded from frames of 'inSize', given the size the
+    // output streams need, i.e. the largest width and the largest height of the streams.
+    virtual Size getOutputSize(const Size& inSize, const Size& /*minSize*/) const {
+        return inSize;
+    }
+    // Decodes the MJPEG frame 'in' of 'inSize' into 'out', a planar YUV420 layout of
+    // 'outSize', which was returned by getOutputSize. Returns non-zero on error.
+    virtual int decode(const uint8_t* in, size_t inDataSize, const Size& inSize,
+                       const YCbCrLayout& out, const Size& outSize) = 0;
+    int decode(const uint8_t* in, size_t inDataSize, const Size& inSize, AllocatedFrame* out);
+};
+
+// 'restartInRows' is the restart interval in MCU rows, 0 for none.
 int encodeJpegYU12(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality,
                    const void* app1Buffer, size_t app1Size, void* out, size_t maxOutSize,
-                   size_t& actualCodeSize);
+                   size_t& actualCodeSize, int restartInRows = 0);
+
+// Encodes a YU12 image into a JPEG image in horizontal strips, each on a thread of its own.
+// A strip is encoded as a JPEG image with a restart marker after each MCU row, and the entropy
+// coded data of the strips are then joined with restart markers into the single scan of the
+// output image, which is decoded by any baseline decoder. Strips other than the last one have
+// a multiple of 8 MCU rows, so the restart markers of each strip are already numbered right.
+//
+// The strips are encoded straight into their part of the output buffer, without the APP1
+// segment, so the caller can generate the APP1 segment, e.g. the EXIF data with the thumbnail,
+// between start() and finish(). If any strip can not be encoded, finish() falls back to
+// encodeJpegYU12.
+class StripJpegEncoder {
+  public:
+    // Smaller images are encoded in a single strip
+    static constexpr int32_t kMinStripPixels = 2000000;
+    static constexpr size_t kMaxStrips = 4;
+
+    ~StripJpegEncoder();
+
+    // 'inLayout' and 'out' must stay valid until finish() returns.
+    void start(const Size& inSz, const YCbCrLayout& inLayout, int jpegQuality, void* out,
+               size_t maxOutSize);
+    // Returns non-zero on error, in which case the output buffer holds no image.
+    int finish(const void* app1Buffer, size_t app1Size, size_t& actualCodeSize);
+    // Waits for the strips, and drops them.
+    void cancel();
+
+  private:
+    struct Strip {
+        uint8_t* out = nullptr;
+        size_t maxOutSize = 0;
+        size_t codeSize = 0;
+        int ret = 0;
+        std::thread thread;
+    };
+
+    // The APP1 marker with the largest segment
+    static constexpr size_t kMaxApp1SegmentSize = 2 + 0xFFFF;
+
+    void join();
+    int joinStrips(const void* app1Buffer, size_t app1Size, size_t& actualCodeSize);
+
+    Size mSize;
+    YCbCrLayout mLayout;
+    int mQuality = 0;
+    uint8_t* mOut = nullptr;
+    size_t mMaxOutSize = 0;
+    std::vector<Strip> mStrips;
+};
 
 Size getMaxThumbnailResolution(const common::V1_0::helper::CameraMetadata&);
 
@@ -258,6 +384,60 @@ void freeReleaseFences(std::vector<CaptureResult>&);
 status_t fillCaptureResultCommon(common::V1_0::helper::CameraMetadata& md, nsecs_t timestamp,
                                  camera_metadata_ro_entry& activeArraySize);
 
+// The result metadata of the capture requests of a session. Repeating requests share their
+// settings, so the result of some settings is built once, by fillCaptureResultCommon, and
+// only the AF state and the timestamp are patched in place for each frame. The serialized
+// results are written into recycled buffers.
+class CaptureResultTemplate {
+  public:
+    explicit CaptureResultTemplate(const common::V1_0::helper::CameraMetadata& chars);
+
+    // Writes the result of a request with 'settings' into 'out'. Returns non-zero on error.
+    status_t fill(common::V1_0::helper::CameraMetadata& settings, uint8_t afState,
+                  nsecs_t timestamp, std::vector<uint8_t>* out);
+    // Keeps the storage of a result written by fill for the next ones.
+    void recycle(std::vector<uint8_t>&& buffer);
+
+  private:
+    static constexpr size_t kMaxSpareBuffers = 2;
+    // Entries and bytes of data added to the settings by rebuildLocked: AF state and the tags
+    // of fillCaptureResultCommon, of which only the crop region and the timestamp don't fit in
+    // an entry.
+    static constexpr size_t kResultEntries = 12;
+    static constexpr size_t kResultData = 4 * sizeof(int32_t) + sizeof(int64_t);
+
+    status_t rebuildLocked(const camera_metadata_t* settings);
+
+    std::mutex mLock;
+    common::V1_0::helper::CameraMetadata mChars;
+    // serialized settings the result was built from
+    std::vector<uint8_t> mSettings;
+    common::V1_0::helper::CameraMetadata mResult;
+    std::vector<std::vector<uint8_t>> mSpareBuffers;
+};
+
+using ResultMetadataQueue = ::android::AidlMessageQueue<
+        int8_t, ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>;
+
+// How the result metadata of a session reached the framework
+struct ResultMetadataStats {
+    uint64_t fmqResults = 0;
+    uint64_t inlineResults = 0;
+    uint64_t inlineBytes = 0;
+    size_t maxResultSize = 0;
+
+    void dump(int fd) const;
+};
+
+// Returns the size of a result FMQ holding 'resultCount' results of 'resultSize' bytes, at least
+// 'minSize' bytes.
+size_t getResultMetadataQueueSize(size_t resultSize, size_t resultCount, size_t minSize);
+
+// Moves the metadata of 'results' into 'queue', except for the results that do not fit in
+// the queue, which are sent inline over binder.
+void writeResultMetadataToFmq(ResultMetadataQueue& queue, std::vector<CaptureResult>& results,
+                              ResultMetadataStats* stats);
+
 // Interface for OutputThread calling back to parent
 struct OutputThreadInterface {
     virtual ~OutputThreadInterface() {}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the stages of the external camera output pipeline: the V4L2 dequeue, the MJPEG
+// decode, the scale, the JPEG encode and the result metadata. The frames are synthetic, except
+// for the V4L2 dequeue, which streams from the device in $EXTERNAL_CAMERA_BENCHMARK_DEVICE, e.g.
+// a vivid device, and is skipped without it.
+//
+// Run with:
+//   atest camera.device-external-benchmark
+// or push the binary to the device and run it with --benchmark_filter=<regex>. Each benchmark
+// reports the frames per second and the peak resident memory of the process.
+
+#include <ExternalCameraUtils.h>
+
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <libyuv.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace implementation {
+
+namespace {
+
+using ::android::base::unique_fd;
+using ::android::hardware::camera::external::common::ExternalCameraConfig;
+
+void setCounters(benchmark::State& state) {
+    state.counters["fps"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    state.counters["maxrss_kB"] = usage.ru_maxrss;
+}
+
+// Fills 'frame' with a gradient and some noise, which compresses like a real scene
+std::shared_ptr<AllocatedFrame> makeFrame(int32_t width, int32_t height, YCbCrLayout* layout) {
+    auto frame = std::make_shared<AllocatedFrame>(width, height);
+    if (frame->allocate(layout) != 0) {
+        return nullptr;
+    }
+    uint32_t seed = 1;
+    auto fill = [&](void* plane, uint32_t stride, int32_t w, int32_t h) {
+        for (int32_t y = 0; y < h; y++) {
+            uint8_t* row = static_cast<uint8_t*>(plane) + y * stride;
+            for (int32_t x = 0; x < w; x++) {
+                seed = seed * 1103515245 + 12345;
+                row[x] = static_cast<uint8_t>((x + y) / 4 + (seed >> 28));
+            }
+        }
+    };
+    fill(layout->y, layout->yStride, width, height);
+    fill(layout->cb, layout->cStride, width / 2, height / 2);
+    fill(layout->cr, layout->cStride, width / 2, height / 2);
+    return frame;
+}
+
+std::vector<uint8_t> makeMjpegFrame(int32_t width, int32_t height) {
+    YCbCrLayout layout;
+    auto frame = makeFrame(width, height, &layout);
+    std::vector<uint8_t> jpeg(width * height * 2);
+    size_t size = 0;
+    if (frame == nullptr || encodeJpegYU12(Size{width, height}, layout, /*jpegQuality*/ 90,
+                                           nullptr, 0, jpeg.data(), jpeg.size(), size) != 0) {
+        return {};
+    }
+    jpeg.resize(size);
+    return jpeg;
+}
+
+// Args: width, height, MjpegDecoderType, and the divisor of the frame size the streams need
+void BM_MjpegDecode(benchmark::State& state) {
+    const Size inSize{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    auto type = static_cast<ExternalCameraConfig::MjpegDecoderType>(state.range(2));
+    const Size minSize{inSize.width / static_cast<int32_t>(state.range(3)),
+                       inSize.height / static_cast<int32_t>(state.range(3))};
+    std::vector<uint8_t> jpeg = makeMjpegFrame(inSize.width, inSize.height);
+    std::unique_ptr<MjpegDecoder> decoder = MjpegDecoder::create(type, "");
+    Size outSize = decoder->getOutputSize(inSize, minSize);
+    AllocatedFrame out(outSize.width, outSize.height);
+    if (jpeg.empty() || out.allocate() != 0) {
+        state.SkipWithError("cannot create the input frame");
+        return;
+    }
+    state.SetLabel(decoder->getName());
+    for (auto _ : state) {
+        if (decoder->decode(jpeg.data(), jpeg.size(), inSize, &out) != 0) {
+            state.SkipWithError("decode failed");
+            return;
+        }
+    }
+    setCounters(state);
+}
+
+// Args: input width, height, output width, height
+void BM_Scale(benchmark::State& state) {
+    YCbCrLayout in, out;
+    const int32_t inWidth = state.range(0), inHeight = state.range(1);
+    const int32_t outWidth = state.range(2), outHeight = state.range(3);
+    auto inFrame = makeFrame(inWidth, inHeight, &in);
+    AllocatedFrame outFrame(outWidth, outHeight);
+    if (inFrame == nullptr || outFrame.allocate(&out) != 0) {
+        state.SkipWithError("cannot allocate the frames");
+        return;
+    }
+    for (auto _ : state) {
+        // The filter of OutputThread::cropAndScaleLocked
+        libyuv::I420Scale(static_cast<uint8_t*>(in.y), in.yStride, static_cast<uint8_t*>(in.cb),
+                          in.cStride, static_cast<uint8_t*>(in.cr), in.cStride, inWidth,
+                          inHeight, static_cast<uint8_t*>(out.y), out.yStride,
+                          static_cast<uint8_t*>(out.cb), out.cStride,
+                          static_cast<uint8_t*>(out.cr), out.cStride, outWidth, outHeight,
+                          libyuv::FilterMode::kFilterNone);
+    }
+    setCounters(state);
+}
+
+// Args: width, height, and whether the StripJpegEncoder is used
+void BM_JpegEncode(benchmark::State& state) {
+    const Size size{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    const bool strips = state.range(2) != 0;
+    YCbCrLayout layout;
+    auto frame = makeFrame(size.width, size.height, &layout);
+    std::vector<uint8_t> out(size.width * size.height * 2);
+    // An APP1 segment the size of the EXIF data without the thumbnail
+    std::vector<uint8_t> app1(1024);
+    if (frame == nullptr) {
+        state.SkipWithError("cannot allocate the frame");
+        return;
+    }
+    StripJpegEncoder encoder;
+    state.SetLabel(strips ? "strips" : "serial");
+    for (auto _ : state) {
+        size_t codeSize = 0;
+        int ret;
+        if (strips) {
+            encoder.start(size, layout, /*jpegQuality*/ 90, out.data(), out.size());
+            ret = encoder.finish(app1.data(), app1.size(), codeSize);
+        } else {
+            ret = encodeJpegYU12(size, layout, /*jpegQuality*/ 90, app1.data(), app1.size(),
+                                 out.data(), out.size(), codeSize);
+        }
+        if (ret != 0) {
+            state.SkipWithError("encode failed");
+            return;
+        }
+    }
+    setCounters(state);
+}
+
+void BM_CaptureResult(benchmark::State& state) {
+    CameraMetadata chars;
+    const int32_t activeArray[] = {0, 0, 1920, 1080};
+    chars.update(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE, activeArray, 4);
+    CameraMetadata settings;
+    const uint8_t afMode = ANDROID_CONTROL_AF_MODE_OFF;
+    settings.update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
+    const uint8_t intent = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
+    settings.update(ANDROID_CONTROL_CAPTURE_INTENT, &intent, 1);
+    const uint8_t jpegQuality = 90;
+    settings.update(ANDROID_JPEG_QUALITY, &jpegQuality, 1);
+    const int32_t thumbnailSize[] = {240, 180};
+    settings.update(ANDROID_JPEG_THUMBNAIL_SIZE, thumbnailSize, 2);
+    const int32_t fpsRange[] = {30, 30};
+    settings.update(ANDROID_CONTROL_AE_TARGET_FPS_RANGE, fpsRange, 2);
+
+    CaptureResultTemplate resultTemplate(chars);
+    nsecs_t timestamp = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> result;
+        if (resultTemplate.fill(settings, ANDROID_CONTROL_AF_STATE_INACTIVE, timestamp++,
+                                &result) != OK) {
+            state.SkipWithError("fill failed");
+            return;
+        }
+        resultTemplate.recycle(std::move(result));
+    }
+    setCounters(state);
+}
+
+// Streams from $EXTERNAL_CAMERA_BENCHMARK_DEVICE in its current format. Args: buffer count
+void BM_V4l2Dequeue(benchmark::State& state) {
+    const char* devicePath = getenv("EXTERNAL_CAMERA_BENCHMARK_DEVICE");
+    if (devicePath == nullptr) {
+        state.SkipWithError("EXTERNAL_CAMERA_BENCHMARK_DEVICE is not set");
+        return;
+    }
+    unique_fd fd(TEMP_FAILURE_RETRY(open(devicePath, O_RDWR)));
+    v4l2_format fmt{.type = V4L2_BUF_TYPE_VIDEO_CAPTURE};
+    if (fd.get() < 0 || ioctl(fd.get(), VIDIOC_G_FMT, &fmt) < 0) {
+        state.SkipWithError("cannot open the V4L2 device");
+        return;
+    }
+    v4l2_requestbuffers reqBuffers{.count = static_cast<uint32_t>(state.range(0)),
+                                   .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                   .memory = V4L2_MEMORY_MMAP};
+    if (ioctl(fd.get(), VIDIOC_REQBUFS, &reqBuffers) < 0) {
+        state.SkipWithError("VIDIOC_REQBUFS failed");
+        return;
+    }
+    for (uint32_t i = 0; i < reqBuffers.count; i++) {
+        v4l2_buffer buffer{
+                .index = i, .type = V4L2_BUF_TYPE_VIDEO_CAPTURE, .memory = V4L2_MEMORY_MMAP};
+        if (ioctl(fd.get(), VIDIOC_QUERYBUF, &buffer) < 0 ||
+            ioctl(fd.get(), VIDIOC_QBUF, &buffer) < 0) {
+            state.SkipWithError("cannot queue the V4L2 buffers");
+            return;
+        }
+    }
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(fd.get(), VIDIOC_STREAMON, &type) < 0) {
+        state.SkipWithError("VIDIOC_STREAMON failed");
+        return;
+    }
+    state.SetLabel(std::to_string(fmt.fmt.pix.width) + "x" + std::to_string(fmt.fmt.pix.height));
+    uint64_t droppedFrames = 0;
+    bool hasSequence = false;
+    uint32_t lastSequence = 0;
+    for (auto _ : state) {
+        v4l2_buffer buffer{.type = V4L2_BUF_TYPE_VIDEO_CAPTURE, .memory = V4L2_MEMORY_MMAP};
+        if (TEMP_FAILURE_RETRY(ioctl(fd.get(), VIDIOC_DQBUF, &buffer)) < 0) {
+            state.SkipWithError("VIDIOC_DQBUF failed");
+            break;
+        }
+        if (hasSequence && buffer.sequence > lastSequence) {
+            droppedFrames += buffer.sequence - lastSequence - 1;
+        }
+        hasSequence = true;
+        lastSequence = buffer.sequence;
+        if (TEMP_FAILURE_RETRY(ioctl(fd.get(), VIDIOC_QBUF, &buffer)) < 0) {
+            state.SkipWithError("VIDIOC_QBUF failed");
+            break;
+        }
+    }
+    ioctl(fd.get(), VIDIOC_STREAMOFF, &type);
+    state.counters["dropped"] = droppedFrames;
+    setCounters(state);
+}
+
+constexpr int kLibyuv = static_cast<int>(ExternalCameraConfig::MjpegDecoderType::LIBYUV);
+constexpr int kLibjpegScaled =
+        static_cast<int>(ExternalCameraConfig::MjpegDecoderType::LIBJPEG_SCALED);
+
+}  // namespace
+
+BENCHMARK(BM_MjpegDecode)
+        ->ArgNames({"w", "h", "decoder", "downscale"})
+        ->Args({1280, 720, kLibyuv, 1})
+        ->Args({1920, 1080, kLibyuv, 1})
+        ->Args({3840, 2160, kLibyuv, 1})
+        ->Args({1920, 1080, kLibjpegScaled, 2})
+        ->Args({3840, 2160, kLibjpegScaled, 2})
+        ->Args({3840, 2160, kLibjpegScaled, 4})
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Scale)
+        ->ArgNames({"in_w", "in_h", "out_w", "out_h"})
+        ->Args({1920, 1080, 1280, 720})
+        ->Args({1920, 1080, 640, 360})
+        ->Args({3840, 2160, 1920, 1080})
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_JpegEncode)
+        ->ArgNames({"w", "h", "strips"})
+        ->Args({1920, 1080, 0})
+        ->Args({1920, 1080, 1})
+        ->Args({3840, 2160, 0})
+        ->Args({3840, 2160, 1})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+BENCHMARK(BM_CaptureResult);
+BENCHMARK(BM_V4l2Dequeue)->ArgName("buffers")->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+}  // namespace implementation
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -26,6 +26,7 @@
 #include <linux/videodev2.h>
 #include <log/log.h>
 #include <sys/inotify.h>
+#include <algorithm>
 #include <regex>
 
 namespace android {
@@ -307,8 +308,13 @@ bool ExternalCameraProvider::HotplugThread::threadLoop() {
         return true;
     }
 
+    int timeoutMs = 250;
+    if (int pendingMs = handlePendingEvents(); pendingMs >= 0) {
+        timeoutMs = std::min(timeoutMs, pendingMs);
+    }
+
     // poll /dev/* and handle timeouts and error
-    int pollRet = poll(&mPollFd, /* fd_count= */ 1, /* timeout= */ 250);
+    int pollRet = poll(&mPollFd, /* fd_count= */ 1, timeoutMs);
     if (pollRet == 0) {
         // no read event in 100ms
         mPollFd.revents = 0;
@@ -364,15 +370,40 @@ bool ExternalCameraProvider::HotplugThread::threadLoop() {
         char v4l2DevicePath[kMaxDevicePathLen];
         snprintf(v4l2DevicePath, kMaxDevicePathLen, "%s%s", kDevicePath, event->name);
 
-        if (event->mask & IN_CREATE) {
-            mParent->deviceAdded(v4l2DevicePath);
-        } else if (event->mask & IN_DELETE) {
-            mParent->deviceRemoved(v4l2DevicePath);
+        if (event->mask & (IN_CREATE | IN_DELETE)) {
+            PendingEvent& pending = mPendingEvents[v4l2DevicePath];
+            pending.added = (event->mask & IN_CREATE) != 0;
+            pending.removed |= (event->mask & IN_DELETE) != 0;
+            pending.lastEventTime = std::chrono::steady_clock::now();
         }
     }
     return true;
 }
 
+int ExternalCameraProvider::HotplugThread::handlePendingEvents() {
+    const auto now = std::chrono::steady_clock::now();
+    auto nextDue = std::chrono::steady_clock::time_point::max();
+    for (auto it = mPendingEvents.begin(); it != mPendingEvents.end();) {
+        const auto due = it->second.lastEventTime + kDebounceDelay;
+        if (due > now) {
+            nextDue = std::min(nextDue, due);
+            ++it;
+            continue;
+        }
+        if (it->second.removed) {
+            mParent->deviceRemoved(it->first.c_str());
+        }
+        if (it->second.added) {
+            mParent->deviceAdded(it->first.c_str());
+        }
+        it = mPendingEvents.erase(it);
+    }
+    if (nextDue == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+    return std::chrono::ceil<std::chrono::milliseconds>(nextDue - now).count();
+}
+
 // End ExternalCameraProvider::HotplugThread functions
 
 }  // namespace implementation
@@ -29,6 +29,8 @@
 #include <poll.h>
 #include <utils/Mutex.h>
 #include <utils/Thread.h>
+#include <chrono>
+#include <map>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -88,6 +90,10 @@ class ExternalCameraProvider : public BnCameraProvider {
         // failed.
         bool initialize();
 
+        // Handles the nodes that have been quiet for kDebounceDelay and returns the time to wait
+        // for the next one, in milliseconds, or -1 if none is pending.
+        int handlePendingEvents();
+
         ExternalCameraProvider* mParent = nullptr;
         const std::unordered_set<std::string> mInternalDevices;
 
@@ -99,6 +105,17 @@ class ExternalCameraProvider : public BnCameraProvider {
         // struct to wrap mINotifyFD and poll it with timeout
         struct pollfd mPollFd = {};
         char mEventBuf[512] = {0};
+
+        // Flaky cameras come and go several times in a row, so the events of a /dev/video* node
+        // are only acted upon once it has settled.
+        static constexpr std::chrono::milliseconds kDebounceDelay{200};
+        struct PendingEvent {
+            // Whether the node was removed at any point, and whether it is there in the end.
+            bool removed = false;
+            bool added = false;
+            std::chrono::steady_clock::time_point lastEventTime;
+        };
+        std::map<std::string, PendingEvent> mPendingEvents;  // device path -> pending event
     };
 
     Mutex mLock;
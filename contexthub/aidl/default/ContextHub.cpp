@@ -16,6 +16,9 @@
 
 #include "contexthub-impl/ContextHub.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+
 namespace aidl::android::hardware::contexthub {
 
 using ::ndk::ScopedAStatus;
@@ -27,7 +30,7 @@ ScopedAStatus ContextHub::getContextHubs(std::vector<ContextHubInfo>* out_contex
     hub.toolchain = "n/a";
     hub.id = kMockHubId;
     hub.peakMips = 1;
-    hub.maxSupportedMessageLengthBytes = 4096;
+    hub.maxSupportedMessageLengthBytes = kMaxFrameBytes;
     hub.chrePlatformId = UINT64_C(0x476f6f6754000000);
     hub.chreApiMajorVersion = 1;
     hub.chreApiMinorVersion = 6;
@@ -94,6 +97,7 @@ ScopedAStatus ContextHub::registerCallback(int32_t in_contextHubId,
                                            const std::shared_ptr<IContextHubCallback>& in_cb) {
     if (in_contextHubId == kMockHubId) {
         mCallback = in_cb;
+        mTransport.setCallback(in_cb);
         return ScopedAStatus::ok();
     } else {
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -101,11 +105,12 @@ ScopedAStatus ContextHub::registerCallback(int32_t in_contextHubId,
 }
 
 ScopedAStatus ContextHub::sendMessageToHub(int32_t in_contextHubId,
-                                           const ContextHubMessage& /* in_message */) {
+                                           const ContextHubMessage& in_message) {
     if (in_contextHubId == kMockHubId) {
         // Return true here to indicate that the HAL has accepted the message.
         // Successful delivery of the message to a nanoapp should be handled at
         // a higher level protocol.
+        mTransport.send(in_message);
         return ScopedAStatus::ok();
     } else {
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -126,6 +131,7 @@ ScopedAStatus ContextHub::onHostEndpointDisconnected(char16_t in_hostEndpointId)
     if (mConnectedHostEndpoints.count(in_hostEndpointId) > 0) {
         mConnectedHostEndpoints.erase(in_hostEndpointId);
     }
+    mTransport.onHostEndpointDisconnected(in_hostEndpointId);
 
     return ScopedAStatus::ok();
 }
@@ -136,4 +142,24 @@ ScopedAStatus ContextHub::sendMessageDeliveryStatusToHub(
     return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
 }
 
+binder_status_t ContextHub::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    const auto stats = mTransport.getStats();
+    const auto averageLatency = stats.messagesDelivered > 0
+                                        ? stats.totalLatency / stats.messagesDelivered
+                                        : std::chrono::nanoseconds(0);
+
+    dprintf(fd, "Loopback transport:\n");
+    dprintf(fd, "  Messages sent: %" PRIu64 " in %" PRIu64 " frames\n", stats.messagesSent,
+            stats.framesSent);
+    dprintf(fd, "  Messages delivered: %" PRIu64 ", dropped: %" PRIu64 "\n",
+            stats.messagesDelivered, stats.messagesDropped);
+    dprintf(fd, "  Latency average: %" PRId64 " us, max: %" PRId64 " us\n",
+            static_cast<int64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(averageLatency).count()),
+            static_cast<int64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(stats.maxLatency)
+                            .count()));
+    return STATUS_OK;
+}
+
 }  // namespace aidl::android::hardware::contexthub
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contexthub-impl/LoopbackTransport.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+
+namespace aidl::android::hardware::contexthub {
+
+LoopbackTransport::LoopbackTransport(std::chrono::microseconds flushDeadline, size_t maxFrameBytes,
+                                     size_t maxQueuedMessages)
+    : mFlushDeadline(flushDeadline),
+      mMaxFrameBytes(maxFrameBytes),
+      mMaxQueuedMessages(maxQueuedMessages) {}
+
+LoopbackTransport::~LoopbackTransport() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mCv.notify_one();
+    if (mThread.joinable()) mThread.join();
+}
+
+void LoopbackTransport::setCallback(std::shared_ptr<IContextHubCallback> callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCallback = std::move(callback);
+}
+
+void LoopbackTransport::send(const ContextHubMessage& message) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const auto now = Clock::now();
+        if (mFrame.empty()) mFrameDeadline = now + mFlushDeadline;
+        mFrame.push_back({message, now});
+        mFrameBytes += message.messageBody.size();
+        mStats.messagesSent++;
+
+        if (!mThread.joinable()) mThread = std::thread(&LoopbackTransport::run, this);
+
+        // The thread only needs waking up for a new deadline or a full frame.
+        if (mFrame.size() > 1 && mFrameBytes < mMaxFrameBytes) return;
+    }
+    mCv.notify_one();
+}
+
+void LoopbackTransport::onHostEndpointDisconnected(char16_t hostEndpointId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEndpointQueues.erase(hostEndpointId);
+}
+
+LoopbackTransport::Stats LoopbackTransport::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void LoopbackTransport::flushLocked() {
+    auto frame = std::move(mFrame);
+    mFrame.clear();
+    mFrameBytes = 0;
+    mStats.framesSent++;
+
+    for (auto& pending : frame) {
+        if (pending.message.nanoappId != kLoopbackNanoappId) continue;
+
+        auto& queue = mEndpointQueues[pending.message.hostEndPoint];
+        if (queue.size() >= mMaxQueuedMessages) {
+            queue.pop_front();
+            mStats.messagesDropped++;
+        }
+        queue.push_back(std::move(pending));
+    }
+}
+
+void LoopbackTransport::deliverNext(std::unique_lock<std::mutex>& lock) {
+    auto it = mEndpointQueues.lower_bound(static_cast<char16_t>(mNextEndpoint));
+    if (mNextEndpoint > UINT16_MAX || it == mEndpointQueues.end()) it = mEndpointQueues.begin();
+
+    Pending pending = std::move(it->second.front());
+    it->second.pop_front();
+    mNextEndpoint = static_cast<uint32_t>(it->first) + 1;
+    if (it->second.empty()) mEndpointQueues.erase(it);
+
+    auto callback = mCallback;
+    lock.unlock();
+    bool delivered = false;
+    if (callback != nullptr) {
+        delivered = callback->handleContextHubMessage(pending.message, {}).isOk();
+        if (!delivered) {
+            LOG(ERROR) << "Failed to deliver message to host endpoint "
+                       << static_cast<int>(pending.message.hostEndPoint);
+        }
+    }
+    const auto latency = Clock::now() - pending.sendTime;
+    lock.lock();
+
+    if (!delivered) {
+        mStats.messagesDropped++;
+        return;
+    }
+    mStats.messagesDelivered++;
+    mStats.totalLatency += latency;
+    mStats.maxLatency = std::max<std::chrono::nanoseconds>(mStats.maxLatency, latency);
+}
+
+void LoopbackTransport::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mShutdown) {
+        if (!mFrame.empty() && (mFrameBytes >= mMaxFrameBytes || Clock::now() >= mFrameDeadline)) {
+            flushLocked();
+            continue;
+        }
+
+        // Echoes go out while the next frame fills up.
+        if (!mEndpointQueues.empty()) {
+            deliverNext(lock);
+            continue;
+        }
+
+        if (mFrame.empty()) {
+            mCv.wait(lock);
+        } else {
+            mCv.wait_until(lock, mFrameDeadline);
+        }
+    }
+}
+
+}  // namespace aidl::android::hardware::contexthub
@@ -18,6 +18,8 @@
 
 #include <aidl/android/hardware/contexthub/BnContextHub.h>
 
+#include "LoopbackTransport.h"
+
 #include <unordered_set>
 #include <vector>
 
@@ -53,9 +55,16 @@ class ContextHub : public BnContextHub {
             int32_t in_contextHubId,
             const MessageDeliveryStatus& in_messageDeliveryStatus) override;
 
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
   private:
     static constexpr uint32_t kMockHubId = 0;
+    static constexpr std::chrono::microseconds kFlushDeadline{2000};
+    static constexpr size_t kMaxFrameBytes = 4096;
+    static constexpr size_t kMaxQueuedMessagesPerEndpoint = 64;
+
     std::shared_ptr<IContextHubCallback> mCallback;
+    LoopbackTransport mTransport{kFlushDeadline, kMaxFrameBytes, kMaxQueuedMessagesPerEndpoint};
 
     std::unordered_set<char16_t> mConnectedHostEndpoints;
 };
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/contexthub/ContextHubMessage.h>
+#include <aidl/android/hardware/contexthub/IContextHubCallback.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace contexthub {
+
+/**
+ * Transport between the host and the mock hub, looping messages back to the host.
+ *
+ * Messages sent to the hub are batched into a frame, which goes out once it's full or once the
+ * flush deadline of its first message passes. On the hub side, messages for kLoopbackNanoappId
+ * are echoed back to the host endpoint that sent them and all others are dropped, as there are
+ * no real nanoapps.
+ *
+ * Echoed messages are queued per host endpoint and the queues are served in turn, so an endpoint
+ * sending a lot of messages doesn't hold up the others. A queue is bounded and drops its oldest
+ * message when full.
+ */
+class LoopbackTransport {
+  public:
+    /** Nanoapp ID of the echo nanoapp on the mock hub. */
+    static constexpr int64_t kLoopbackNanoappId = INT64_C(0x476f6f675400ffff);
+
+    struct Stats {
+        uint64_t messagesSent = 0;
+        uint64_t framesSent = 0;
+        uint64_t messagesDelivered = 0;
+        uint64_t messagesDropped = 0;
+        /** Time from sending a message to delivering its echo. */
+        std::chrono::nanoseconds totalLatency{0};
+        std::chrono::nanoseconds maxLatency{0};
+    };
+
+    /**
+     * \param flushDeadline How long a message may wait for more to fill its frame
+     * \param maxFrameBytes Size of message bodies making a frame full
+     * \param maxQueuedMessages Number of messages held for each host endpoint
+     */
+    LoopbackTransport(std::chrono::microseconds flushDeadline, size_t maxFrameBytes,
+                      size_t maxQueuedMessages);
+    ~LoopbackTransport();
+
+    void setCallback(std::shared_ptr<IContextHubCallback> callback);
+
+    void send(const ContextHubMessage& message);
+
+    /** Drops the messages waiting to be delivered to an endpoint. */
+    void onHostEndpointDisconnected(char16_t hostEndpointId);
+
+    Stats getStats();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        ContextHubMessage message;
+        Clock::time_point sendTime;
+    };
+
+    void run();
+    /** Hands the current frame to the hub side, mMutex must be held. */
+    void flushLocked();
+    /** Delivers the next message in turn, mMutex must be held by lock. */
+    void deliverNext(std::unique_lock<std::mutex>& lock);
+
+    const std::chrono::microseconds mFlushDeadline;
+    const size_t mMaxFrameBytes;
+    const size_t mMaxQueuedMessages;
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::shared_ptr<IContextHubCallback> mCallback;
+
+    std::vector<Pending> mFrame;
+    size_t mFrameBytes = 0;
+    Clock::time_point mFrameDeadline;
+
+    std::map<char16_t, std::deque<Pending>> mEndpointQueues;
+    /** Endpoint ID from which to look for the next queue to serve. */
+    uint32_t mNextEndpoint = 0;
+
+    Stats mStats;
+    bool mShutdown = false;
+
+    /** Started along with the first message. */
+    std::thread mThread;
+};
+
+}  // namespace contexthub
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
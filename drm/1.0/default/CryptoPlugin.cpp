@@ -32,6 +32,10 @@ namespace drm {
 namespace V1_0 {
 namespace implementation {
 
+    // Most samples have only a handful of sub-samples, convert those on the
+    // stack rather than allocating for every decrypt call.
+    static constexpr size_t kMaxStackSubSamples = 16;
+
     // Methods from ::android::hardware::drm::V1_0::ICryptoPlugin follow
     Return<bool> CryptoPlugin::requiresSecureDecoderComponent(
             const hidl_string& mime) {
@@ -68,14 +72,18 @@ namespace implementation {
             const DestinationBuffer& destination,
             decrypt_cb _hidl_cb) {
         std::unique_lock<std::mutex> shared_buffer_lock(mSharedBufferLock);
-        if (mSharedBufferMap.find(source.bufferId) == mSharedBufferMap.end()) {
+        auto sourceEntry = mSharedBufferMap.find(source.bufferId);
+        if (sourceEntry == mSharedBufferMap.end()) {
             _hidl_cb(Status::ERROR_DRM_CANNOT_HANDLE, 0, "source decrypt buffer base not set");
             return Void();
         }
 
+        auto destEntry = mSharedBufferMap.end();
         if (destination.type == BufferType::SHARED_MEMORY) {
             const SharedBuffer& dest = destination.nonsecureMemory;
-            if (mSharedBufferMap.find(dest.bufferId) == mSharedBufferMap.end()) {
+            destEntry = dest.bufferId == source.bufferId ? sourceEntry
+                                                         : mSharedBufferMap.find(dest.bufferId);
+            if (destEntry == mSharedBufferMap.end()) {
                 _hidl_cb(Status::ERROR_DRM_CANNOT_HANDLE, 0, "destination decrypt buffer base not set");
                 return Void();
             }
@@ -100,8 +108,14 @@ namespace implementation {
         legacyPattern.mEncryptBlocks = pattern.encryptBlocks;
         legacyPattern.mSkipBlocks = pattern.skipBlocks;
 
-        std::unique_ptr<android::CryptoPlugin::SubSample[]> legacySubSamples =
-                std::make_unique<android::CryptoPlugin::SubSample[]>(subSamples.size());
+        android::CryptoPlugin::SubSample stackSubSamples[kMaxStackSubSamples];
+        std::unique_ptr<android::CryptoPlugin::SubSample[]> heapSubSamples;
+        android::CryptoPlugin::SubSample *legacySubSamples = stackSubSamples;
+        if (subSamples.size() > kMaxStackSubSamples) {
+            heapSubSamples =
+                    std::make_unique<android::CryptoPlugin::SubSample[]>(subSamples.size());
+            legacySubSamples = heapSubSamples.get();
+        }
 
         size_t destSize = 0;
         for (size_t i = 0; i < subSamples.size(); i++) {
@@ -120,7 +134,7 @@ namespace implementation {
         }
 
         AString detailMessage;
-        sp<IMemory> sourceBase = mSharedBufferMap[source.bufferId];
+        sp<IMemory> sourceBase = sourceEntry->second;
         if (sourceBase == nullptr) {
             _hidl_cb(Status::ERROR_DRM_CANNOT_HANDLE, 0, "source is a nullptr");
             return Void();
@@ -142,7 +156,7 @@ namespace implementation {
         void *destPtr = NULL;
         if (destination.type == BufferType::SHARED_MEMORY) {
             const SharedBuffer& destBuffer = destination.nonsecureMemory;
-            sp<IMemory> destBase = mSharedBufferMap[destBuffer.bufferId];
+            sp<IMemory> destBase = destEntry->second;
             if (destBase == nullptr) {
                 _hidl_cb(Status::ERROR_DRM_CANNOT_HANDLE, 0, "destination is a nullptr");
                 return Void();
@@ -180,7 +194,7 @@ namespace implementation {
         shared_buffer_lock.unlock();
 
         ssize_t result = mLegacyPlugin->decrypt(secure, keyId.data(), iv.data(),
-                legacyMode, legacyPattern, srcPtr, legacySubSamples.get(),
+                legacyMode, legacyPattern, srcPtr, legacySubSamples,
                 subSamples.size(), destPtr, &detailMessage);
 
         uint32_t status;
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DumpSections.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+using ::android::base::unique_fd;
+using ::android::base::WriteFully;
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace dumpstate {
+
+namespace {
+
+// Copies what has been written to the buffer of a section so far to fd.
+void copyBuffer(int bufferFd, int fd) {
+    struct stat st;
+    if (fstat(bufferFd, &st) != 0) {
+        return;
+    }
+    char buf[16 * 1024];
+    for (off_t offset = 0; offset < st.st_size;) {
+        size_t length = std::min<off_t>(sizeof(buf), st.st_size - offset);
+        ssize_t n = TEMP_FAILURE_RETRY(pread(bufferFd, buf, length, offset));
+        if (n <= 0 || !WriteFully(fd, buf, n)) {
+            return;
+        }
+        offset += n;
+    }
+}
+
+}  // namespace
+
+void DumpSections::add(std::string name, Dumper dumper, std::chrono::milliseconds timeout) {
+    mSections.push_back({std::move(name), std::move(dumper), timeout});
+}
+
+void DumpSections::dump(int fd, std::chrono::steady_clock::time_point deadline) {
+    struct Running {
+        // Shared with the worker, which may outlive dump() if the section times out.
+        std::shared_ptr<unique_fd> buffer;
+        std::future<void> done;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Running> running;
+    running.reserve(mSections.size());
+    for (const Section& section : mSections) {
+        auto buffer = std::make_shared<unique_fd>(memfd_create(section.name.c_str(), MFD_CLOEXEC));
+        if (*buffer == -1) {
+            ALOGE("Cannot create the buffer of section %s: %s", section.name.c_str(),
+                  strerror(errno));
+            running.push_back({nullptr, {}});
+            continue;
+        }
+
+        std::promise<void> promise;
+        running.push_back({buffer, promise.get_future()});
+        std::thread([dumper = section.dumper, buffer, promise = std::move(promise)]() mutable {
+            dumper(buffer->get());
+            promise.set_value();
+        }).detach();
+    }
+
+    for (size_t i = 0; i < mSections.size(); i++) {
+        const Section& section = mSections[i];
+        Running& result = running[i];
+        if (result.buffer == nullptr) {
+            // Dump the section in place rather than losing it.
+            section.dumper(fd);
+            continue;
+        }
+
+        const auto sectionDeadline = std::min(start + section.timeout, deadline);
+        const bool finished =
+                result.done.wait_until(sectionDeadline) == std::future_status::ready;
+        copyBuffer(result.buffer->get(), fd);
+        if (!finished) {
+            ALOGW("Section %s timed out", section.name.c_str());
+            dprintf(fd, "\n*** section %s timed out after %lld ms ***\n", section.name.c_str(),
+                    static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                   sectionDeadline - start)
+                                                   .count()));
+        }
+    }
+}
+
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
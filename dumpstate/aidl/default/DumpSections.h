@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace dumpstate {
+
+// Collects the sections of a board dump.
+//
+// The sections are dumped concurrently, each into its own buffer, and are then written out in the
+// order they were added. A section that is still running at its deadline is written out as far as
+// it got, followed by a note, so that a slow node only delays the dump by its own timeout instead
+// of blocking every section after it.
+class DumpSections {
+  public:
+    static constexpr std::chrono::milliseconds kDefaultSectionTimeout{5000};
+
+    // Writes a section to the given fd.
+    using Dumper = std::function<void(int fd)>;
+
+    void add(std::string name, Dumper dumper,
+             std::chrono::milliseconds timeout = kDefaultSectionTimeout);
+
+    // Dumps the sections to fd, giving up on the sections still running at the deadline.
+    void dump(int fd, std::chrono::steady_clock::time_point deadline);
+
+  private:
+    struct Section {
+        std::string name;
+        Dumper dumper;
+        std::chrono::milliseconds timeout;
+    };
+
+    std::vector<Section> mSections;
+};
+
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -18,6 +18,7 @@
 #include <log/log.h>
 #include "DumpstateUtil.h"
 
+#include "DumpSections.h"
 #include "Dumpstate.h"
 
 using android::os::dumpstate::DumpFileToFd;
@@ -28,12 +29,12 @@ namespace hardware {
 namespace dumpstate {
 
 const char kVerboseLoggingProperty[] = "persist.dumpstate.verbose_logging.enabled";
+// Used when the caller does not give a timeout.
+constexpr std::chrono::milliseconds kDefaultDumpTimeout{30000};
 
 ndk::ScopedAStatus Dumpstate::dumpstateBoard(const std::vector<::ndk::ScopedFileDescriptor>& in_fds,
                                              IDumpstateDevice::DumpstateMode in_mode,
                                              int64_t in_timeoutMillis) {
-    (void)in_timeoutMillis;
-
     if (in_fds.size() < 1) {
         return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                 "No file descriptor");
@@ -47,10 +48,10 @@ ndk::ScopedAStatus Dumpstate::dumpstateBoard(const std::vector<::ndk::ScopedFile
 
     switch (in_mode) {
         case IDumpstateDevice::DumpstateMode::FULL:
-            return dumpstateBoardImpl(fd, true);
+            return dumpstateBoardImpl(fd, true, in_timeoutMillis);
 
         case IDumpstateDevice::DumpstateMode::DEFAULT:
-            return dumpstateBoardImpl(fd, false);
+            return dumpstateBoardImpl(fd, false, in_timeoutMillis);
 
         case IDumpstateDevice::DumpstateMode::INTERACTIVE:
         case IDumpstateDevice::DumpstateMode::REMOTE:
@@ -83,15 +84,28 @@ bool Dumpstate::getVerboseLoggingEnabledImpl() {
     return ::android::base::GetBoolProperty(kVerboseLoggingProperty, false);
 }
 
-ndk::ScopedAStatus Dumpstate::dumpstateBoardImpl(const int fd, const bool full) {
+ndk::ScopedAStatus Dumpstate::dumpstateBoardImpl(const int fd, const bool full,
+                                                 const int64_t timeoutMillis) {
     ALOGD("DumpstateDevice::dumpstateBoard() FD: %d\n", fd);
 
-    dprintf(fd, "verbose logging: %s\n", getVerboseLoggingEnabledImpl() ? "enabled" : "disabled");
-    dprintf(fd, "[%s] %s\n", (full ? "full" : "default"), "Hello, world!");
+    const auto timeout = timeoutMillis > 0 ? std::chrono::milliseconds(timeoutMillis)
+                                           : kDefaultDumpTimeout;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    // Sections run concurrently, so they must not refer to anything on this stack.
+    DumpSections sections;
+    const bool verboseLogging = getVerboseLoggingEnabledImpl();
+    sections.add("verbose logging", [verboseLogging](int out) {
+        dprintf(out, "verbose logging: %s\n", verboseLogging ? "enabled" : "disabled");
+    });
+    sections.add("hello", [full](int out) {
+        dprintf(out, "[%s] %s\n", (full ? "full" : "default"), "Hello, world!");
+    });
 
     // Shows an example on how to use the libdumpstateutil API.
-    DumpFileToFd(fd, "cmdline", "/proc/self/cmdline");
+    sections.add("cmdline", [](int out) { DumpFileToFd(out, "cmdline", "/proc/self/cmdline"); });
 
+    sections.dump(fd, deadline);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -19,6 +19,7 @@
 #include "Gnss.h"
 #include <inttypes.h>
 #include <log/log.h>
+#include <utils/SystemClock.h>
 #include <utils/Timers.h>
 #include "AGnss.h"
 #include "AGnssRil.h"
@@ -36,6 +37,7 @@
 #include "Utils.h"
 
 namespace aidl::android::hardware::gnss {
+using ::android::hardware::gnss::common::ReplayClock;
 using ::android::hardware::gnss::common::Utils;
 
 using ndk::ScopedAStatus;
@@ -118,20 +120,35 @@ ScopedAStatus Gnss::start() {
         if (!mGnssMeasurementEnabled || mMinIntervalMs <= mGnssMeasurementIntervalMs) {
             this->reportSvStatus();
         }
-        if (!mFirstFixReceived) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(TTFF_MILLIS));
+        if (!mFirstFixReceived && mThreadBlocker.wait_for(std::chrono::milliseconds(TTFF_MILLIS))) {
             mFirstFixReceived = true;
         }
+        mReplayClock.reset();
+        bool replayed;
         do {
             if (!mIsActive) {
                 break;
             }
+            // A replayed fix is reported at its recorded time, scaled by the replay speed, and
+            // the next one is read right after. Other fixes are reported every mMinIntervalMs.
+            auto currentLocation = getLocationFromHW();
+            std::optional<ReplayClock::Clock::time_point> deadline;
+            if (currentLocation != nullptr) {
+                deadline = mReplayClock.getDeadline(currentLocation->timestampMillis * 1000000);
+            }
+            replayed = deadline.has_value();
+            if (replayed) {
+                if (!mThreadBlocker.wait_until(*deadline)) {
+                    break;
+                }
+                currentLocation->elapsedRealtime.timestampNs = ::android::elapsedRealtimeNano();
+            }
+
             if (!mGnssMeasurementEnabled || mMinIntervalMs <= mGnssMeasurementIntervalMs) {
                 this->reportSvStatus();
             }
             this->reportNmea();
 
-            auto currentLocation = getLocationFromHW();
             mGnssPowerIndication->notePowerConsumption();
             if (currentLocation != nullptr) {
                 this->reportLocation(*currentLocation);
@@ -139,7 +156,9 @@ ScopedAStatus Gnss::start() {
                 const auto location = Utils::getMockLocation();
                 this->reportLocation(location);
             }
-        } while (mIsActive && mThreadBlocker.wait_for(std::chrono::milliseconds(mMinIntervalMs)));
+        } while (mIsActive &&
+                 (replayed || mThreadBlocker.wait_until(mReplayClock.getNextDeadline(
+                                      std::chrono::milliseconds(mMinIntervalMs)))));
     });
     return ScopedAStatus::ok();
 }
@@ -34,6 +34,7 @@
 #include "GnssConfiguration.h"
 #include "GnssMeasurementInterface.h"
 #include "GnssPowerIndication.h"
+#include "ReplayClock.h"
 #include "Utils.h"
 
 namespace aidl::android::hardware::gnss {
@@ -111,6 +112,8 @@ class Gnss : public BnGnss {
     std::atomic<bool> mGnssMeasurementEnabled;
     std::thread mThread;
     ::android::hardware::gnss::common::ThreadBlocker mThreadBlocker;
+    // Only used on mThread
+    ::android::hardware::gnss::common::ReplayClock mReplayClock;
 
     mutable std::mutex mMutex;
 };
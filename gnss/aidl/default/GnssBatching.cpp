@@ -21,20 +21,110 @@
 #include <inttypes.h>
 #include <log/log.h>
 #include <utils/SystemClock.h>
+#include <algorithm>
+#include <cmath>
 #include "Utils.h"
 
 namespace aidl::android::hardware::gnss {
 
 using namespace ::android::hardware::gnss;
 
-constexpr int BATCH_SIZE = 10;
+constexpr int BATCH_SIZE = 64;
+constexpr double kEarthRadiusMeters = 6371000.0;
+
+namespace {
+
+// Great-circle distance between two positions
+double distanceMeters(double latitudeDegrees1, double longitudeDegrees1, double latitudeDegrees2,
+                      double longitudeDegrees2) {
+    const double lat1 = latitudeDegrees1 * M_PI / 180.0;
+    const double lat2 = latitudeDegrees2 * M_PI / 180.0;
+    const double sinHalfDeltaLat = std::sin((lat2 - lat1) / 2);
+    const double sinHalfDeltaLng =
+            std::sin((longitudeDegrees2 - longitudeDegrees1) * M_PI / 180.0 / 2);
+    const double a = sinHalfDeltaLat * sinHalfDeltaLat +
+                     std::cos(lat1) * std::cos(lat2) * sinHalfDeltaLng * sinHalfDeltaLng;
+    return 2 * kEarthRadiusMeters * std::asin(std::sqrt(std::min(a, 1.0)));
+}
+
+}  // namespace
+
+LocationRing::LocationRing(size_t capacity)
+    : mCapacity(capacity),
+      mHead(0),
+      mSize(0),
+      mLocationFlags(capacity),
+      mLatitudeDegrees(capacity),
+      mLongitudeDegrees(capacity),
+      mAltitudeMeters(capacity),
+      mSpeedMetersPerSec(capacity),
+      mBearingDegrees(capacity),
+      mHorizontalAccuracyMeters(capacity),
+      mVerticalAccuracyMeters(capacity),
+      mSpeedAccuracyMetersPerSecond(capacity),
+      mBearingAccuracyDegrees(capacity),
+      mTimestampMillis(capacity),
+      mElapsedRealtimeFlags(capacity),
+      mElapsedRealtimeNs(capacity),
+      mElapsedRealtimeUncertaintyNs(capacity) {}
+
+void LocationRing::push(const GnssLocation& location) {
+    size_t i = (mHead + mSize) % mCapacity;
+    if (full()) {
+        mHead = (mHead + 1) % mCapacity;
+    } else {
+        mSize++;
+    }
+    mLocationFlags[i] = location.gnssLocationFlags;
+    mLatitudeDegrees[i] = location.latitudeDegrees;
+    mLongitudeDegrees[i] = location.longitudeDegrees;
+    mAltitudeMeters[i] = location.altitudeMeters;
+    mSpeedMetersPerSec[i] = location.speedMetersPerSec;
+    mBearingDegrees[i] = location.bearingDegrees;
+    mHorizontalAccuracyMeters[i] = location.horizontalAccuracyMeters;
+    mVerticalAccuracyMeters[i] = location.verticalAccuracyMeters;
+    mSpeedAccuracyMetersPerSecond[i] = location.speedAccuracyMetersPerSecond;
+    mBearingAccuracyDegrees[i] = location.bearingAccuracyDegrees;
+    mTimestampMillis[i] = location.timestampMillis;
+    mElapsedRealtimeFlags[i] = location.elapsedRealtime.flags;
+    mElapsedRealtimeNs[i] = location.elapsedRealtime.timestampNs;
+    mElapsedRealtimeUncertaintyNs[i] = location.elapsedRealtime.timeUncertaintyNs;
+}
+
+void LocationRing::drain(std::vector<GnssLocation>* locations) {
+    locations->reserve(locations->size() + mSize);
+    for (size_t n = 0; n < mSize; n++) {
+        size_t i = (mHead + n) % mCapacity;
+        locations->push_back({
+                .gnssLocationFlags = mLocationFlags[i],
+                .latitudeDegrees = mLatitudeDegrees[i],
+                .longitudeDegrees = mLongitudeDegrees[i],
+                .altitudeMeters = mAltitudeMeters[i],
+                .speedMetersPerSec = mSpeedMetersPerSec[i],
+                .bearingDegrees = mBearingDegrees[i],
+                .horizontalAccuracyMeters = mHorizontalAccuracyMeters[i],
+                .verticalAccuracyMeters = mVerticalAccuracyMeters[i],
+                .speedAccuracyMetersPerSecond = mSpeedAccuracyMetersPerSecond[i],
+                .bearingAccuracyDegrees = mBearingAccuracyDegrees[i],
+                .timestampMillis = mTimestampMillis[i],
+                .elapsedRealtime = {.flags = mElapsedRealtimeFlags[i],
+                                    .timestampNs = mElapsedRealtimeNs[i],
+                                    .timeUncertaintyNs = mElapsedRealtimeUncertaintyNs[i]},
+        });
+    }
+    mHead = 0;
+    mSize = 0;
+}
 
 std::shared_ptr<IGnssBatchingCallback> GnssBatching::sCallback = nullptr;
 
 GnssBatching::GnssBatching()
     : mMinIntervalMs(1000),
       mWakeUpOnFifoFull(false),
-      mBatchedLocations(std::vector<GnssLocation>()) {}
+      mBatchedLocations(BATCH_SIZE),
+      mHasLastBatchedLocation(false),
+      mLastLatitudeDegrees(0),
+      mLastLongitudeDegrees(0) {}
 GnssBatching::~GnssBatching() {
     cleanup();
 }
@@ -65,14 +155,19 @@ ndk::ScopedAStatus GnssBatching::start(const Options& options) {
     mMinIntervalMs = periodNanos / 1e6;
     mWakeUpOnFifoFull = (options.flags & IGnssBatching::WAKEUP_ON_FIFO_FULL) ? true : false;
     mMinDistanceMeters = options.minDistanceMeters;
+    {
+        std::unique_lock<std::mutex> lock(mBatchMutex);
+        mHasLastBatchedLocation = false;
+    }
 
     mIsActive = true;
+    mThreadBlocker.reset();
     mThread = std::thread([this]() {
-        while (mIsActive == true) {
+        do {
             const auto location = common::Utils::getMockLocation();
             this->batchLocation(location);
-            std::this_thread::sleep_for(std::chrono::milliseconds(mMinIntervalMs));
-        }
+        } while (mIsActive &&
+                 mThreadBlocker.wait_for(std::chrono::milliseconds(mMinIntervalMs)));
     });
 
     return ndk::ScopedAStatus::ok();
@@ -80,23 +175,30 @@ ndk::ScopedAStatus GnssBatching::start(const Options& options) {
 
 ndk::ScopedAStatus GnssBatching::flush() {
     ALOGD("flush");
-    std::vector<GnssLocation> copy = std::vector<GnssLocation>(mBatchedLocations);
-    ndk::ScopedAStatus status;
-    if (sCallback != nullptr) {
-        sCallback->gnssLocationBatchCb(copy);
-        status = ndk::ScopedAStatus::ok();
-    } else {
+    std::unique_lock<std::mutex> flushLock(mFlushMutex);
+    mFlushedLocations.clear();
+    {
+        std::unique_lock<std::mutex> lock(mBatchMutex);
+        mBatchedLocations.drain(&mFlushedLocations);
+    }
+    std::shared_ptr<IGnssBatchingCallback> callbackCopy;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        callbackCopy = sCallback;
+    }
+    if (callbackCopy == nullptr) {
         ALOGE("GnssBatchingCallback is null. flush() failed.");
-        status = ndk::ScopedAStatus::fromServiceSpecificError(IGnss::ERROR_GENERIC);
+        return ndk::ScopedAStatus::fromServiceSpecificError(IGnss::ERROR_GENERIC);
     }
-    mBatchedLocations.clear();
-    return status;
+    callbackCopy->gnssLocationBatchCb(mFlushedLocations);
+    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus GnssBatching::stop() {
     ALOGD("stop");
     // Do not call flush() at stop()
     mIsActive = false;
+    mThreadBlocker.notify();
     if (mThread.joinable()) {
         mThread.join();
     }
@@ -105,22 +207,34 @@ ndk::ScopedAStatus GnssBatching::stop() {
 
 ndk::ScopedAStatus GnssBatching::cleanup() {
     ALOGD("cleanup");
-    std::unique_lock<std::mutex> lock(mMutex);
     if (mIsActive) {
         stop();
     }
     flush();
 
+    std::unique_lock<std::mutex> lock(mMutex);
     sCallback = nullptr;
     return ndk::ScopedAStatus::ok();
 }
 
 void GnssBatching::batchLocation(const GnssLocation& location) {
-    if (mBatchedLocations.size() > BATCH_SIZE) {
-        mBatchedLocations.erase(mBatchedLocations.begin());
+    bool shouldFlush;
+    {
+        std::unique_lock<std::mutex> lock(mBatchMutex);
+        if (mHasLastBatchedLocation && mMinDistanceMeters > 0 &&
+            distanceMeters(mLastLatitudeDegrees, mLastLongitudeDegrees, location.latitudeDegrees,
+                           location.longitudeDegrees) < mMinDistanceMeters) {
+            return;
+        }
+        mHasLastBatchedLocation = true;
+        mLastLatitudeDegrees = location.latitudeDegrees;
+        mLastLongitudeDegrees = location.longitudeDegrees;
+
+        // Without WAKEUP_ON_FIFO_FULL the oldest location is dropped once the ring is full
+        mBatchedLocations.push(location);
+        shouldFlush = mWakeUpOnFifoFull && mBatchedLocations.full();
     }
-    mBatchedLocations.push_back(location);
-    if (mWakeUpOnFifoFull && mBatchedLocations.size() == BATCH_SIZE) {
+    if (shouldFlush) {
         flush();
     }
 }
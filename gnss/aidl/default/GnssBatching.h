@@ -18,10 +18,50 @@
 
 #include <aidl/android/hardware/gnss/BnGnssBatching.h>
 #include <atomic>
+#include <mutex>
 #include <thread>
+#include <vector>
+#include "Utils.h"
 
 namespace aidl::android::hardware::gnss {
 
+// Fixed capacity ring of batched locations. The locations are stored as a struct of arrays, with
+// the fields that don't need double precision narrowed to float, so that a full batch stays
+// compact. When full, pushing a location overwrites the oldest one.
+class LocationRing {
+  public:
+    explicit LocationRing(size_t capacity);
+
+    size_t capacity() const { return mCapacity; }
+    size_t size() const { return mSize; }
+    bool full() const { return mSize == mCapacity; }
+
+    void push(const GnssLocation& location);
+
+    // Appends the batched locations to |locations|, oldest first, and empties the ring.
+    void drain(std::vector<GnssLocation>* locations);
+
+  private:
+    const size_t mCapacity;
+    size_t mHead;
+    size_t mSize;
+
+    std::vector<int32_t> mLocationFlags;
+    std::vector<double> mLatitudeDegrees;
+    std::vector<double> mLongitudeDegrees;
+    std::vector<float> mAltitudeMeters;
+    std::vector<float> mSpeedMetersPerSec;
+    std::vector<float> mBearingDegrees;
+    std::vector<float> mHorizontalAccuracyMeters;
+    std::vector<float> mVerticalAccuracyMeters;
+    std::vector<float> mSpeedAccuracyMetersPerSecond;
+    std::vector<float> mBearingAccuracyDegrees;
+    std::vector<int64_t> mTimestampMillis;
+    std::vector<int32_t> mElapsedRealtimeFlags;
+    std::vector<int64_t> mElapsedRealtimeNs;
+    std::vector<float> mElapsedRealtimeUncertaintyNs;
+};
+
 struct GnssBatching : public BnGnssBatching {
   public:
     GnssBatching();
@@ -44,11 +84,23 @@ struct GnssBatching : public BnGnssBatching {
     std::atomic<long> mMinIntervalMs;
     std::atomic<float> mMinDistanceMeters;
     std::atomic<bool> mWakeUpOnFifoFull;
+    ::android::hardware::gnss::common::ThreadBlocker mThreadBlocker;
 
     // Synchronization lock for sCallback
     mutable std::mutex mMutex;
 
-    std::vector<GnssLocation> mBatchedLocations;
+    // Synchronization lock for the batch, as locations are batched by mThread and flushed from
+    // binder threads
+    std::mutex mBatchMutex;
+    LocationRing mBatchedLocations;
+    // The position of the last batched location, for the distance filter
+    bool mHasLastBatchedLocation;
+    double mLastLatitudeDegrees;
+    double mLastLongitudeDegrees;
+    // Serializes flushes, so that batches reach the callback in order
+    std::mutex mFlushMutex;
+    // Guarded by mFlushMutex, and reused for the locations handed to the callback
+    std::vector<GnssLocation> mFlushedLocations;
 };
 
 }  // namespace aidl::android::hardware::gnss
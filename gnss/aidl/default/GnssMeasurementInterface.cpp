@@ -109,12 +109,18 @@ void GnssMeasurementInterface::start(const bool enableCorrVecOutputs,
     mThreads.emplace_back(std::thread([this, enableCorrVecOutputs, enableFullTracking]() {
         waitForStoppingThreads();
         mThreadBlocker.reset();
+        // A new client needs the correlation vectors of all the signals once
+        mLastCorrelationVectors.clear();
+
+        mReplayClock.reset();
 
         int intervalMs;
+        bool replayed;
         do {
             if (!mIsActive) {
                 break;
             }
+            replayed = false;
             std::string rawMeasurementStr = "";
             if (ReplayUtils::hasGnssDeviceFile() &&
                 ReplayUtils::isGnssRawMeasurement(
@@ -125,11 +131,19 @@ void GnssMeasurementInterface::start(const bool enableCorrVecOutputs,
                 auto measurement =
                         GnssRawMeasurementParser::getMeasurementFromStrs(rawMeasurementStr);
                 if (measurement != nullptr) {
+                    // Replay the epoch at its recorded time, scaled by the replay speed.
+                    auto deadline = mReplayClock.getDeadline(getRecordedTimeNs(*measurement));
+                    replayed = deadline.has_value();
+                    if (replayed && !mThreadBlocker.wait_until(*deadline)) {
+                        break;
+                    }
+                    dropUnchangedCorrelationVectors(*measurement);
                     this->reportMeasurement(*measurement);
                 }
             } else {
                 auto measurement =
                         Utils::getMockMeasurement(enableCorrVecOutputs, enableFullTracking);
+                dropUnchangedCorrelationVectors(measurement);
                 this->reportMeasurement(measurement);
                 if (!mLocationEnabled || mLocationIntervalMs > mIntervalMs) {
                     mGnss->reportSvStatus();
@@ -137,7 +151,9 @@ void GnssMeasurementInterface::start(const bool enableCorrVecOutputs,
             }
             intervalMs =
                     (mLocationEnabled) ? std::min(mLocationIntervalMs, mIntervalMs) : mIntervalMs;
-        } while (mIsActive && mThreadBlocker.wait_for(std::chrono::milliseconds(intervalMs)));
+        } while (mIsActive &&
+                 (replayed || mThreadBlocker.wait_until(mReplayClock.getNextDeadline(
+                                      std::chrono::milliseconds(intervalMs)))));
     }));
 }
 
@@ -172,6 +188,38 @@ void GnssMeasurementInterface::reportMeasurement(const GnssData& data) {
     callbackCopy->gnssMeasurementCb(data);
 }
 
+void GnssMeasurementInterface::dropUnchangedCorrelationVectors(GnssData& data) {
+    // Correlation vectors make up most of the parcel when they are enabled, and they rarely
+    // change between epochs for a tracked signal.
+    for (auto& measurement : data.measurements) {
+        if (!(measurement.flags & GnssMeasurement::HAS_CORRELATION_VECTOR)) {
+            continue;
+        }
+        SignalKey key(measurement.signalType.constellation, measurement.svid,
+                      static_cast<int64_t>(measurement.signalType.carrierFrequencyHz),
+                      measurement.signalType.codeType);
+        auto lastCorrelationVectors = mLastCorrelationVectors.find(key);
+        if (lastCorrelationVectors == mLastCorrelationVectors.end()) {
+            mLastCorrelationVectors.emplace(std::move(key), measurement.correlationVectors);
+        } else if (lastCorrelationVectors->second != measurement.correlationVectors) {
+            // Copy into the cached vectors to reuse their storage
+            lastCorrelationVectors->second = measurement.correlationVectors;
+        } else {
+            measurement.correlationVectors.clear();
+            measurement.flags &= ~GnssMeasurement::HAS_CORRELATION_VECTOR;
+        }
+    }
+}
+
+int64_t GnssMeasurementInterface::getRecordedTimeNs(const GnssData& data) {
+    // Logs taken without the chipset elapsed realtime still have the receiver clock.
+    if ((data.elapsedRealtime.flags & ElapsedRealtime::HAS_TIMESTAMP_NS) &&
+        data.elapsedRealtime.timestampNs > 0) {
+        return data.elapsedRealtime.timestampNs;
+    }
+    return data.clock.timeNs;
+}
+
 void GnssMeasurementInterface::setLocationInterval(const int intervalMs) {
     mLocationIntervalMs = intervalMs;
 }
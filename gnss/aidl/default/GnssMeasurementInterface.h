@@ -20,8 +20,12 @@
 #include <aidl/android/hardware/gnss/BnGnssMeasurementInterface.h>
 #include <atomic>
 #include <future>
+#include <map>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <tuple>
+#include "ReplayClock.h"
 #include "Utils.h"
 
 namespace aidl::android::hardware::gnss {
@@ -46,6 +50,8 @@ struct GnssMeasurementInterface : public BnGnssMeasurementInterface {
     void start(const bool enableCorrVecOutputs, const bool enableFullTracking);
     void stop();
     void reportMeasurement(const GnssData&);
+    void dropUnchangedCorrelationVectors(GnssData& data);
+    static int64_t getRecordedTimeNs(const GnssData& data);
     void waitForStoppingThreads();
 
     std::atomic<long> mIntervalMs;
@@ -55,6 +61,13 @@ struct GnssMeasurementInterface : public BnGnssMeasurementInterface {
     std::vector<std::thread> mThreads;
     std::vector<std::future<void>> mFutures;
     ::android::hardware::gnss::common::ThreadBlocker mThreadBlocker;
+    // Only used on the measurement thread
+    ::android::hardware::gnss::common::ReplayClock mReplayClock;
+
+    // The correlation vectors last reported for each signal, so that they are only reported again
+    // once they change. Only used by the measurement thread.
+    using SignalKey = std::tuple<GnssConstellationType, int32_t, int64_t, std::string>;
+    std::map<SignalKey, std::vector<CorrelationVector>> mLastCorrelationVectors;
 
     // Guarded by mMutex
     static std::shared_ptr<IGnssMeasurementCallback> sCallback;
@@ -15,13 +15,58 @@
  */
 #include "DeviceFileReader.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
 namespace android {
 namespace hardware {
 namespace gnss {
 namespace common {
 
+DeviceFileReader::DeviceFile* DeviceFileReader::openDeviceFile(
+        const std::string& deviceFilePath) {
+    DeviceFile& deviceFile = deviceFiles_[deviceFilePath];
+    if (deviceFile.fd >= 0) {
+        return &deviceFile;
+    }
+
+    if ((deviceFile.fd = open(deviceFilePath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)) == -1) {
+        return nullptr;
+    }
+
+    // Create an epoll instance.
+    if ((deviceFile.epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        closeDeviceFile(deviceFile);
+        return nullptr;
+    }
+
+    // Add file descriptor to epoll instance.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = deviceFile.fd;
+    ev.events = EPOLLIN;
+    if (epoll_ctl(deviceFile.epollFd, EPOLL_CTL_ADD, deviceFile.fd, &ev) == -1) {
+        closeDeviceFile(deviceFile);
+        return nullptr;
+    }
+    return &deviceFile;
+}
+
+void DeviceFileReader::closeDeviceFile(DeviceFile& deviceFile) {
+    if (deviceFile.fd >= 0) {
+        close(deviceFile.fd);
+        deviceFile.fd = -1;
+    }
+    if (deviceFile.epollFd >= 0) {
+        close(deviceFile.epollFd);
+        deviceFile.epollFd = -1;
+    }
+}
+
 void DeviceFileReader::getDataFromDeviceFile(const std::string& command, int mMinIntervalMs) {
-    char inputBuffer[INPUT_BUFFER_SIZE];
     std::string deviceFilePath = "";
     if (command == CMD_GET_LOCATION) {
         deviceFilePath = ReplayUtils::getFixedLocationPath();
@@ -32,69 +77,62 @@ void DeviceFileReader::getDataFromDeviceFile(const std::string& command, int mMi
         return;
     }
 
-    int gnss_fd, epoll_fd;
-    if ((gnss_fd = open(deviceFilePath.c_str(), O_RDWR | O_NONBLOCK)) == -1) {
-        return;
-    }
-    if (write(gnss_fd, command.c_str(), command.size()) <= 0) {
-        close(gnss_fd);
+    DeviceFile* deviceFile = openDeviceFile(deviceFilePath);
+    if (deviceFile == nullptr) {
         return;
     }
-
-    // Create an epoll instance.
-    if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
-        close(gnss_fd);
-        return;
-    }
-
-    // Add file descriptor to epoll instance.
-    struct epoll_event ev, events[1];
-    memset(&ev, 0, sizeof(ev));
-    ev.data.fd = gnss_fd;
-    ev.events = EPOLLIN;
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gnss_fd, &ev) == -1) {
-        close(gnss_fd);
-        close(epoll_fd);
+    if (write(deviceFile->fd, command.c_str(), command.size()) <= 0) {
+        closeDeviceFile(*deviceFile);
         return;
     }
 
     // Wait for device file event.
-    if (epoll_wait(epoll_fd, events, 1, mMinIntervalMs) == -1) {
-        close(gnss_fd);
-        close(epoll_fd);
+    struct epoll_event events[1];
+    if (epoll_wait(deviceFile->epollFd, events, 1, mMinIntervalMs) == -1) {
+        if (errno != EINTR) {
+            closeDeviceFile(*deviceFile);
+        }
         return;
     }
 
-    // Handle event and write data to string buffer.
-    int bytes_read = -1;
-    std::string inputStr = "";
+    // Handle event and append the data straight to the buffer.
+    std::string& buffer = deviceFile->buffer;
     while (true) {
-        memset(inputBuffer, 0, INPUT_BUFFER_SIZE);
-        bytes_read = read(gnss_fd, &inputBuffer, INPUT_BUFFER_SIZE);
-        if (bytes_read <= 0) {
+        size_t size = buffer.size();
+        buffer.resize(size + INPUT_BUFFER_SIZE);
+        ssize_t bytes_read = read(deviceFile->fd, buffer.data() + size, INPUT_BUFFER_SIZE);
+        buffer.resize(size + std::max<ssize_t>(bytes_read, 0));
+        if (bytes_read == 0) {
+            // A regular file was read to its end, reopen it to replay it from the start next time
+            closeDeviceFile(*deviceFile);
+            break;
+        }
+        if (bytes_read < 0) {
             break;
         }
-        s_buffer_ += std::string(inputBuffer, bytes_read);
     }
-    close(gnss_fd);
-    close(epoll_fd);
 
     // Trim end of file mark(\n\n\n\n).
-    auto pos = s_buffer_.find("\n\n\n\n");
-    if (pos != std::string::npos) {
-        inputStr = s_buffer_.substr(0, pos);
-        s_buffer_ = s_buffer_.substr(pos + 4);
-    } else {
+    std::string_view pending(buffer);
+    pending.remove_prefix(deviceFile->bufferStart);
+    auto pos = pending.find("\n\n\n\n");
+    if (pos == std::string_view::npos) {
         return;
     }
+    std::string inputStr(pending.substr(0, pos));
+    deviceFile->bufferStart += pos + 4;
+    if (deviceFile->bufferStart * 2 > buffer.size()) {
+        buffer.erase(0, deviceFile->bufferStart);
+        deviceFile->bufferStart = 0;
+    }
 
     // Cache the injected data.
     if (command == CMD_GET_LOCATION) {
         // TODO validate data
-        data_[CMD_GET_LOCATION] = inputStr;
+        data_[CMD_GET_LOCATION] = std::move(inputStr);
     } else if (command == CMD_GET_RAWMEASUREMENT) {
         if (ReplayUtils::isGnssRawMeasurement(inputStr)) {
-            data_[CMD_GET_RAWMEASUREMENT] = inputStr;
+            data_[CMD_GET_RAWMEASUREMENT] = std::move(inputStr);
         }
     }
 }
@@ -113,7 +151,11 @@ std::string DeviceFileReader::getGnssRawMeasurementData() {
 
 DeviceFileReader::DeviceFileReader() {}
 
-DeviceFileReader::~DeviceFileReader() {}
+DeviceFileReader::~DeviceFileReader() {
+    for (auto& [path, deviceFile] : deviceFiles_) {
+        closeDeviceFile(deviceFile);
+    }
+}
 
 }  // namespace common
 }  // namespace gnss
@@ -34,14 +34,12 @@ std::unique_ptr<GnssLocation> FixLocationParser::getLocationFromInputStr(
     if (locationStr.empty()) {
         return nullptr;
     }
-    std::vector<std::string> locationStrRecords;
-    ParseUtils::splitStr(locationStr, LINE_SEPARATOR, locationStrRecords);
-    if (locationStrRecords.empty()) {
-        return nullptr;
-    }
+    // Only the first record is used
+    std::string_view firstRecord = locationStr;
+    firstRecord = firstRecord.substr(0, firstRecord.find(LINE_SEPARATOR));
 
-    std::vector<std::string> locationValues;
-    ParseUtils::splitStr(locationStrRecords[0], COMMA_SEPARATOR, locationValues);
+    std::vector<std::string_view> locationValues;
+    ParseUtils::splitStr(firstRecord, COMMA_SEPARATOR, locationValues);
     if (locationValues.size() < 12) {
         return nullptr;
     }
@@ -16,6 +16,9 @@
 
 #include "GnssRawMeasurementParser.h"
 
+#include <algorithm>
+#include <cctype>
+
 namespace android {
 namespace hardware {
 namespace gnss {
@@ -32,31 +35,31 @@ using aidl::android::hardware::gnss::GnssSignalType;
 using ParseUtils = ::android::hardware::gnss::common::ParseUtils;
 
 std::unordered_map<std::string, int> GnssRawMeasurementParser::getColumnIdNameMappingFromHeader(
-        const std::string& header) {
-    std::vector<std::string> columnNames;
+        std::string_view header) {
+    std::vector<std::string_view> columnNames;
     std::unordered_map<std::string, int> columnNameIdMapping;
-    std::string s = header;
-    // Trim left spaces
-    s.erase(s.begin(),
-            std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
     // Trim right spaces
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) { return !std::isspace(ch); })
-                    .base(),
-            s.end());
-    // Remove comment symbol, start from `Raw`.
-    s = s.substr(s.find("Raw"));
+    while (!header.empty() && std::isspace(static_cast<unsigned char>(header.back()))) {
+        header.remove_suffix(1);
+    }
+    // Remove comment symbol and left spaces, start from `Raw`.
+    size_t rawPos = header.find("Raw");
+    if (rawPos == std::string_view::npos) {
+        return columnNameIdMapping;
+    }
+    header.remove_prefix(rawPos);
 
-    ParseUtils::splitStr(s, COMMA_SEPARATOR, columnNames);
+    ParseUtils::splitStr(header, COMMA_SEPARATOR, columnNames);
     int columnId = 0;
-    for (auto& name : columnNames) {
-        columnNameIdMapping[name] = columnId++;
+    for (auto name : columnNames) {
+        columnNameIdMapping[std::string(name)] = columnId++;
     }
 
     return columnNameIdMapping;
 }
 
 int GnssRawMeasurementParser::getClockFlags(
-        const std::vector<std::string>& rawMeasurementRecordValues,
+        const std::vector<std::string_view>& rawMeasurementRecordValues,
         const std::unordered_map<std::string, int>& columnNameIdMapping) {
     int clockFlags = 0;
     if (!rawMeasurementRecordValues[columnNameIdMapping.at("LeapSecond")].empty()) {
@@ -82,7 +85,7 @@ int GnssRawMeasurementParser::getClockFlags(
 }
 
 int GnssRawMeasurementParser::getElapsedRealtimeFlags(
-        const std::vector<std::string>& rawMeasurementRecordValues,
+        const std::vector<std::string_view>& rawMeasurementRecordValues,
         const std::unordered_map<std::string, int>& columnNameIdMapping) {
     int elapsedRealtimeFlags = ElapsedRealtime::HAS_TIMESTAMP_NS;
     if (!rawMeasurementRecordValues[columnNameIdMapping.at("TimeUncertaintyNanos")].empty()) {
@@ -92,7 +95,7 @@ int GnssRawMeasurementParser::getElapsedRealtimeFlags(
 }
 
 int GnssRawMeasurementParser::getRawMeasurementFlags(
-        const std::vector<std::string>& rawMeasurementRecordValues,
+        const std::vector<std::string_view>& rawMeasurementRecordValues,
         const std::unordered_map<std::string, int>& columnNameIdMapping) {
     int rawMeasurementFlags = 0;
     if (!rawMeasurementRecordValues[columnNameIdMapping.at("SnrInDb")].empty()) {
@@ -182,7 +185,7 @@ std::unique_ptr<GnssData> GnssRawMeasurementParser::getMeasurementFromStrs(
     if (rawMeasurementStr.empty()) {
         return nullptr;
     }
-    std::vector<std::string> rawMeasurementStrRecords;
+    std::vector<std::string_view> rawMeasurementStrRecords;
     ParseUtils::splitStr(rawMeasurementStr, LINE_SEPARATOR, rawMeasurementStrRecords);
     if (rawMeasurementStrRecords.size() <= 1) {
         ALOGE("Raw GNSS Measurements parser failed. (No records) ");
@@ -200,8 +203,10 @@ std::unique_ptr<GnssData> GnssRawMeasurementParser::getMeasurementFromStrs(
 
     // Set GnssClock from 1st record.
     std::size_t pointer = 1;
-    std::vector<std::string> firstRecordValues;
+    std::vector<std::string_view> firstRecordValues;
     ParseUtils::splitStr(rawMeasurementStrRecords[pointer], COMMA_SEPARATOR, firstRecordValues);
+    // Trailing empty values aren't split out, so they are filled in as empty values
+    firstRecordValues.resize(std::max(firstRecordValues.size(), columnNameIdMapping.size()));
     GnssClock clock = {
             .gnssClockFlags = getClockFlags(firstRecordValues, columnNameIdMapping),
             .timeNs = ParseUtils::tryParseLongLong(
@@ -228,16 +233,24 @@ std::unique_ptr<GnssData> GnssRawMeasurementParser::getMeasurementFromStrs(
                     firstRecordValues[columnNameIdMapping.at("TimeUncertaintyNanos")], 0)};
 
     std::vector<GnssMeasurement> measurementsVec;
+    measurementsVec.reserve(rawMeasurementStrRecords.size() - 1);
+    // The values of each record point into rawMeasurementStr, and the vector holding them is
+    // reused across records.
+    std::vector<std::string_view> rawMeasurementValues;
+    rawMeasurementValues.reserve(columnNameIdMapping.size());
     for (pointer = 1; pointer < rawMeasurementStrRecords.size(); pointer++) {
-        std::vector<std::string> rawMeasurementValues;
-        std::string line = rawMeasurementStrRecords[pointer];
-        ParseUtils::splitStr(line, COMMA_SEPARATOR, rawMeasurementValues);
+        rawMeasurementValues.clear();
+        ParseUtils::splitStr(rawMeasurementStrRecords[pointer], COMMA_SEPARATOR,
+                             rawMeasurementValues);
+        rawMeasurementValues.resize(
+                std::max(rawMeasurementValues.size(), columnNameIdMapping.size()));
         GnssSignalType signalType = {
                 .constellation = getGnssConstellationType(ParseUtils::tryParseInt(
                         rawMeasurementValues[columnNameIdMapping.at("ConstellationType")], 0)),
                 .carrierFrequencyHz = ParseUtils::tryParseDouble(
                         rawMeasurementValues[columnNameIdMapping.at("CarrierFrequencyHz")], 0),
-                .codeType = rawMeasurementValues[columnNameIdMapping.at("CodeType")],
+                .codeType =
+                        std::string(rawMeasurementValues[columnNameIdMapping.at("CodeType")]),
         };
         GnssMeasurement measurement = {
                 .flags = getRawMeasurementFlags(rawMeasurementValues, columnNameIdMapping),
@@ -291,11 +304,13 @@ std::unique_ptr<GnssData> GnssRawMeasurementParser::getMeasurementFromStrs(
                         0),
                 .satellitePvt = {},
                 .correlationVectors = {}};
-        measurementsVec.push_back(measurement);
+        measurementsVec.push_back(std::move(measurement));
     }
 
     GnssData gnssData = {
-            .measurements = measurementsVec, .clock = clock, .elapsedRealtime = timestamp};
+            .measurements = std::move(measurementsVec),
+            .clock = clock,
+            .elapsedRealtime = timestamp};
     return std::make_unique<GnssData>(gnssData);
 }
 
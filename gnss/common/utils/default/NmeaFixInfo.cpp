@@ -18,6 +18,7 @@
 
 #include <Constants.h>
 #include <NmeaFixInfo.h>
+#include <ParseUtils.h>
 #include <Utils.h>
 #include <log/log.h>
 #include <sys/stat.h>
@@ -25,7 +26,6 @@
 #include <unistd.h>
 #include <utils/SystemClock.h>
 #include <limits>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -43,11 +43,8 @@ float NmeaFixInfo::getAltitudeMeters() const {
     return altitudeMeters;
 }
 
-float NmeaFixInfo::checkAndConvertToFloat(const std::string& sentence) {
-    if (sentence.empty()) {
-        return std::numeric_limits<float>::quiet_NaN();
-    }
-    return std::stof(sentence);
+float NmeaFixInfo::checkAndConvertToFloat(std::string_view sentence) {
+    return ParseUtils::tryParsefloat(sentence, std::numeric_limits<float>::quiet_NaN());
 }
 
 float NmeaFixInfo::getBearingAccuracyDegrees() const {
@@ -89,7 +86,7 @@ float NmeaFixInfo::getVerticalAccuracyMeters() const {
     return kMockVerticalAccuracyMeters;
 }
 
-int64_t NmeaFixInfo::nmeaPartsToTimestamp(const std::string& timeStr, const std::string& dateStr) {
+int64_t NmeaFixInfo::nmeaPartsToTimestamp(std::string_view timeStr, std::string_view dateStr) {
     /**
      * In NMEA format, the full time can only get from the $GPRMC record, see
      * the following example:
@@ -100,12 +97,12 @@ int64_t NmeaFixInfo::nmeaPartsToTimestamp(const std::string& timeStr, const std:
      */
     struct tm tm;
     const int32_t unixYearOffset = 100;
-    tm.tm_mday = std::stoi(dateStr.substr(0, 2).c_str());
-    tm.tm_mon = std::stoi(dateStr.substr(2, 2).c_str()) - 1;
-    tm.tm_year = std::stoi(dateStr.substr(4, 2).c_str()) + unixYearOffset;
-    tm.tm_hour = std::stoi(timeStr.substr(0, 2).c_str());
-    tm.tm_min = std::stoi(timeStr.substr(2, 2).c_str());
-    tm.tm_sec = std::stoi(timeStr.substr(4, 2).c_str());
+    tm.tm_mday = ParseUtils::tryParseInt(dateStr.substr(0, 2));
+    tm.tm_mon = ParseUtils::tryParseInt(dateStr.substr(2, 2)) - 1;
+    tm.tm_year = ParseUtils::tryParseInt(dateStr.substr(4, 2)) + unixYearOffset;
+    tm.tm_hour = ParseUtils::tryParseInt(timeStr.substr(0, 2));
+    tm.tm_min = ParseUtils::tryParseInt(timeStr.substr(2, 2));
+    tm.tm_sec = ParseUtils::tryParseInt(timeStr.substr(4, 2));
     return static_cast<int64_t>(mktime(&tm) - timezone);
 }
 
@@ -113,32 +110,31 @@ bool NmeaFixInfo::isValidFix() const {
     return hasGMCRecord && hasGGARecord;
 }
 
-void NmeaFixInfo::parseGGALine(const std::vector<std::string>& sentenceValues) {
+void NmeaFixInfo::parseGGALine(const std::vector<std::string_view>& sentenceValues) {
     if (sentenceValues.size() == 0 || sentenceValues[0].compare(GPGA_RECORD_TAG) != 0) {
         return;
     }
     // LatDeg, need covert to degree, if it is 'N', should be negative value
-    this->latDeg = std::stof(sentenceValues[2].substr(0, 2)) +
-                   (std::stof(sentenceValues[2].substr(2)) / 60.0);
+    this->latDeg = ParseUtils::tryParsefloat(sentenceValues[2].substr(0, 2)) +
+                   (ParseUtils::tryParsefloat(sentenceValues[2].substr(2)) / 60.0);
     if (sentenceValues[3].compare("N") != 0) {
         this->latDeg *= -1;
     }
 
     // LngDeg, need covert to degree, if it is 'E', should be negative value
-    this->lngDeg = std::stof(sentenceValues[4].substr(0, 3)) +
-                   std::stof(sentenceValues[4].substr(3)) / 60.0;
+    this->lngDeg = ParseUtils::tryParsefloat(sentenceValues[4].substr(0, 3)) +
+                   ParseUtils::tryParsefloat(sentenceValues[4].substr(3)) / 60.0;
     if (sentenceValues[5].compare("E") != 0) {
         this->lngDeg *= -1;
     }
 
-    this->altitudeMeters = std::stof(sentenceValues[9]);
+    this->altitudeMeters = ParseUtils::tryParsefloat(sentenceValues[9]);
 
-    this->hDop = sentenceValues[8].empty() ? std::numeric_limits<float>::quiet_NaN()
-                                           : std::stof(sentenceValues[8]);
+    this->hDop = checkAndConvertToFloat(sentenceValues[8]);
     this->hasGGARecord = true;
 }
 
-void NmeaFixInfo::parseRMCLine(const std::vector<std::string>& sentenceValues) {
+void NmeaFixInfo::parseRMCLine(const std::vector<std::string_view>& sentenceValues) {
     if (sentenceValues.size() == 0 || sentenceValues[0].compare(GPRMC_RECORD_TAG) != 0) {
         return;
     }
@@ -164,15 +160,6 @@ void NmeaFixInfo::reset() {
     this->timestamp = 0;
 }
 
-void NmeaFixInfo::splitStr(const std::string& line, const char& delimiter,
-                           std::vector<std::string>& out) {
-    std::istringstream iss(line);
-    std::string item;
-    while (std::getline(iss, item, delimiter)) {
-        out.push_back(item);
-    }
-}
-
 NmeaFixInfo& NmeaFixInfo::operator=(const NmeaFixInfo& rhs) {
     if (this == &rhs) return *this;
     this->altitudeMeters = rhs.altitudeMeters;
@@ -198,23 +185,24 @@ NmeaFixInfo& NmeaFixInfo::operator=(const NmeaFixInfo& rhs) {
  */
 std::unique_ptr<V2_0::GnssLocation> NmeaFixInfo::getLocationFromInputStr(
         const std::string& inputStr) {
-    std::vector<std::string> nmeaRecords;
-    splitStr(inputStr, LINE_SEPARATOR, nmeaRecords);
+    std::vector<std::string_view> nmeaRecords;
+    ParseUtils::splitStr(inputStr, LINE_SEPARATOR, nmeaRecords);
     NmeaFixInfo nmeaFixInfo;
     NmeaFixInfo candidateFixInfo;
     uint32_t fixId = 0;
     double lastTimeStamp = 0;
+    std::vector<std::string_view> sentenceValues;
     for (const auto& line : nmeaRecords) {
         if (line.compare(0, strlen(GPGA_RECORD_TAG), GPGA_RECORD_TAG) != 0 &&
             line.compare(0, strlen(GPRMC_RECORD_TAG), GPRMC_RECORD_TAG) != 0) {
             continue;
         }
-        std::vector<std::string> sentenceValues;
-        splitStr(line, COMMA_SEPARATOR, sentenceValues);
+        sentenceValues.clear();
+        ParseUtils::splitStr(line, COMMA_SEPARATOR, sentenceValues);
         if (sentenceValues.size() < MIN_COL_NUM) {
             continue;
         }
-        double currentTimeStamp = std::stof(sentenceValues[1]);
+        double currentTimeStamp = ParseUtils::tryParsefloat(sentenceValues[1]);
         // If see a new timestamp, report correct location.
         if ((currentTimeStamp - lastTimeStamp) > TIMESTAMP_EPSILON &&
             candidateFixInfo.isValidFix()) {
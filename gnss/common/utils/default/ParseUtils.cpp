@@ -15,60 +15,71 @@
  */
 
 #include <ParseUtils.h>
-#include <sstream>
-#include <stdexcept>
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 
 namespace android {
 namespace hardware {
 namespace gnss {
 namespace common {
 
-int ParseUtils::tryParseInt(const std::string& s, int defaultVal) {
-    if (s.empty()) {
-        return defaultVal;
-    } else {
-        return std::stoi(s);
-    }
+namespace {
+
+template <typename T>
+T parseInteger(std::string_view s, T defaultVal) {
+    T value;
+    auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), value);
+    return (error == std::errc() && end != s.data()) ? value : defaultVal;
 }
 
-float ParseUtils::tryParsefloat(const std::string& s, float defaultVal) {
-    if (s.empty()) {
+// std::from_chars doesn't take floating point values on all the toolchains, so the field is
+// copied to a NUL terminated buffer on the stack for strtod
+template <typename T>
+T parseFloatingPoint(std::string_view s, T defaultVal, T (*parse)(const char*, char**)) {
+    char buffer[64];
+    if (s.empty() || s.size() >= sizeof(buffer)) {
         return defaultVal;
-    } else {
-        return std::stof(s);
     }
+    memcpy(buffer, s.data(), s.size());
+    buffer[s.size()] = '\0';
+    char* end;
+    T value = parse(buffer, &end);
+    return end != buffer ? value : defaultVal;
 }
 
-double ParseUtils::tryParseDouble(const std::string& s, double defaultVal) {
-    if (s.empty()) {
-        return defaultVal;
-    } else {
-        return std::stod(s);
-    }
+}  // namespace
+
+int ParseUtils::tryParseInt(std::string_view s, int defaultVal) {
+    return parseInteger(s, defaultVal);
 }
 
-long ParseUtils::tryParseLong(const std::string& s, long defaultVal) {
-    if (s.empty()) {
-        return defaultVal;
-    } else {
-        return std::stol(s);
-    }
+float ParseUtils::tryParsefloat(std::string_view s, float defaultVal) {
+    return parseFloatingPoint(s, defaultVal, strtof);
 }
 
-long long ParseUtils::tryParseLongLong(const std::string& s, long long defaultVal) {
-    if (s.empty()) {
-        return defaultVal;
-    } else {
-        return std::stoll(s);
-    }
+double ParseUtils::tryParseDouble(std::string_view s, double defaultVal) {
+    return parseFloatingPoint(s, defaultVal, strtod);
+}
+
+long ParseUtils::tryParseLong(std::string_view s, long defaultVal) {
+    return parseInteger(s, defaultVal);
+}
+
+long long ParseUtils::tryParseLongLong(std::string_view s, long long defaultVal) {
+    return parseInteger(s, defaultVal);
 }
 
-void ParseUtils::splitStr(const std::string& line, const char& delimiter,
-                          std::vector<std::string>& out) {
-    std::istringstream iss(line);
-    std::string item;
-    while (std::getline(iss, item, delimiter)) {
-        out.push_back(item);
+void ParseUtils::splitStr(std::string_view line, char delimiter,
+                          std::vector<std::string_view>& out) {
+    while (!line.empty()) {
+        size_t pos = line.find(delimiter);
+        out.push_back(line.substr(0, pos));
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        line.remove_prefix(pos + 1);
     }
 }
 
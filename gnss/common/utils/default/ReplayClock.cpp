@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ReplayClock.h"
+
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+ReplayClock::ReplayClock() {
+    reset();
+}
+
+double ReplayClock::readSpeed() {
+    std::array<char, PROPERTY_VALUE_MAX> value;
+    value.fill(0);
+    if (property_get("debug.location.gnss.replay_speed", value.begin(), NULL) <= 0) {
+        return 1;
+    }
+    char* end;
+    double speed = strtod(value.begin(), &end);
+    if (end == value.begin() || !std::isfinite(speed) || speed <= 0) {
+        ALOGW("Ignoring invalid replay speed %s", value.begin());
+        return 1;
+    }
+    return speed;
+}
+
+void ReplayClock::reset() {
+    mSpeed = readSpeed();
+    ALOGD("Replaying at %gx", mSpeed);
+    mRecordedStartNs.reset();
+    mLastRecordedNs = 0;
+    mStart = mLastDeadline = Clock::now();
+}
+
+std::optional<ReplayClock::Clock::time_point> ReplayClock::getDeadline(int64_t recordedTimeNs) {
+    if (recordedTimeNs <= 0 || recordedTimeNs == mLastRecordedNs) {
+        return std::nullopt;
+    }
+    if (!mRecordedStartNs.has_value() || recordedTimeNs < mLastRecordedNs ||
+        recordedTimeNs - mLastRecordedNs > std::chrono::nanoseconds(kMaxRecordedGap).count()) {
+        mRecordedStartNs = recordedTimeNs;
+        mStart = std::max(mLastDeadline, Clock::now());
+    }
+    mLastRecordedNs = recordedTimeNs;
+    std::chrono::duration<double, std::nano> offset((recordedTimeNs - *mRecordedStartNs) / mSpeed);
+    mLastDeadline = mStart + std::chrono::duration_cast<Clock::duration>(offset);
+    return mLastDeadline;
+}
+
+ReplayClock::Clock::time_point ReplayClock::getNextDeadline(std::chrono::milliseconds interval) {
+    // The recorded times no longer line up with the deadlines.
+    mRecordedStartNs.reset();
+    mLastDeadline = std::max(mLastDeadline + interval, Clock::now());
+    return mLastDeadline;
+}
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
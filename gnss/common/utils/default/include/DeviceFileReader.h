@@ -39,10 +39,23 @@ class DeviceFileReader {
     void getDataFromDeviceFile(const std::string& command, int mMinIntervalMs);
 
   private:
+    // A device file kept open across reads, along with the data read from it that doesn't make up
+    // a full batch yet. The consumed prefix of the buffer is only dropped once it takes more than
+    // half of the buffer, so that taking a batch doesn't move the rest of the data every time.
+    struct DeviceFile {
+        int fd = -1;
+        int epollFd = -1;
+        std::string buffer;
+        size_t bufferStart = 0;
+    };
+
     DeviceFileReader();
     ~DeviceFileReader();
+    DeviceFile* openDeviceFile(const std::string& deviceFilePath);
+    void closeDeviceFile(DeviceFile& deviceFile);
     std::unordered_map<std::string, std::string> data_;
-    std::string s_buffer_;
+    // Keyed by path, so that commands sent to the same device share its data
+    std::unordered_map<std::string, DeviceFile> deviceFiles_;
     std::mutex mMutex;
 };
 }  // namespace common
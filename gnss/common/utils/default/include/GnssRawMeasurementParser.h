@@ -21,6 +21,7 @@
 #include <log/log.h>
 #include <utils/SystemClock.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "Constants.h"
@@ -34,16 +35,16 @@ namespace common {
 struct GnssRawMeasurementParser {
     static std::unique_ptr<aidl::android::hardware::gnss::GnssData> getMeasurementFromStrs(
             std::string& rawMeasurementStr);
-    static int getClockFlags(const std::vector<std::string>& rawMeasurementRecordValues,
+    static int getClockFlags(const std::vector<std::string_view>& rawMeasurementRecordValues,
                              const std::unordered_map<std::string, int>& columnNameIdMapping);
     static int getElapsedRealtimeFlags(
-            const std::vector<std::string>& rawMeasurementRecordValues,
+            const std::vector<std::string_view>& rawMeasurementRecordValues,
             const std::unordered_map<std::string, int>& columnNameIdMapping);
     static int getRawMeasurementFlags(
-            const std::vector<std::string>& rawMeasurementRecordValues,
+            const std::vector<std::string_view>& rawMeasurementRecordValues,
             const std::unordered_map<std::string, int>& columnNameIdMapping);
     static std::unordered_map<std::string, int> getColumnIdNameMappingFromHeader(
-            const std::string& header);
+            std::string_view header);
     static aidl::android::hardware::gnss::GnssConstellationType getGnssConstellationType(
             int constellationType);
 };
@@ -19,6 +19,7 @@
 
 #include <log/log.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -27,14 +28,18 @@ namespace hardware {
 namespace gnss {
 namespace common {
 
+// The parsers take string_views into the replayed data, so that fields are parsed in place
+// without being copied out first. Empty or malformed fields parse to the default value.
 struct ParseUtils {
-    static int tryParseInt(const std::string& s, int defaultVal = 0);
-    static float tryParsefloat(const std::string& s, float defaultVal = 0.0);
-    static double tryParseDouble(const std::string& s, double defaultVal = 0.0);
-    static long tryParseLong(const std::string& s, long defaultVal = 0);
-    static long long tryParseLongLong(const std::string& s, long long defaultVal = 0);
-    static void splitStr(const std::string& line, const char& delimiter,
-                         std::vector<std::string>& out);
+    static int tryParseInt(std::string_view s, int defaultVal = 0);
+    static float tryParsefloat(std::string_view s, float defaultVal = 0.0);
+    static double tryParseDouble(std::string_view s, double defaultVal = 0.0);
+    static long tryParseLong(std::string_view s, long defaultVal = 0);
+    static long long tryParseLongLong(std::string_view s, long long defaultVal = 0);
+    // Splits like std::getline would: a trailing delimiter doesn't add an empty field. The views
+    // point into |line|, which must outlive them.
+    static void splitStr(std::string_view line, char delimiter,
+                         std::vector<std::string_view>& out);
     static bool isValidHeader(const std::unordered_map<std::string, int>& columnNameIdMapping);
 };
 
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef android_hardware_gnss_common_default_ReplayClock_H_
+#define android_hardware_gnss_common_default_ReplayClock_H_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+// Schedules replayed records at the pace they were recorded at, sped up by the factor set in the
+// debug.location.gnss.replay_speed property (1 by default).
+//
+// The deadlines are absolute: a record is due at the offset of its recorded time from the first
+// replayed record, divided by the speed, so the time spent reading and reporting the records
+// doesn't add up over a session. The schedule starts over from the next record when the recorded
+// time goes backwards, as when a replayed file loops, or jumps ahead by more than kMaxRecordedGap.
+class ReplayClock {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds kMaxRecordedGap{60};
+
+    ReplayClock();
+
+    // Starts a new session, reading the speed again.
+    void reset();
+
+    // Returns when to report the record taken at recordedTimeNs, or std::nullopt if it has no
+    // timestamp or is the record that was last scheduled.
+    std::optional<Clock::time_point> getDeadline(int64_t recordedTimeNs);
+
+    // Returns the deadline interval after the last one, for data that isn't timestamped. The
+    // interval isn't scaled by the speed. A deadline that has already passed is moved to now
+    // rather than reporting the missed ones back to back.
+    Clock::time_point getNextDeadline(std::chrono::milliseconds interval);
+
+  private:
+    static double readSpeed();
+
+    double mSpeed;
+    // Recorded time of the first and of the last scheduled record since the schedule started.
+    std::optional<int64_t> mRecordedStartNs;
+    int64_t mLastRecordedNs;
+    Clock::time_point mStart;
+    Clock::time_point mLastDeadline;
+};
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_gnss_common_default_ReplayClock_H_
@@ -64,6 +64,13 @@ struct ThreadBlocker {
         return !cv.wait_for(lock, time, [&] { return terminate; });
     }
 
+    // returns false if unblocked:
+    template <class C, class D>
+    bool wait_until(std::chrono::time_point<C, D> const& time) {
+        std::unique_lock<std::mutex> lock(m);
+        return !cv.wait_until(lock, time, [&] { return terminate; });
+    }
+
     void notify() {
         std::unique_lock<std::mutex> lock(m);
         terminate = true;
@@ -108,8 +108,9 @@ class CommandWriterBase {
             }
         }
 
-        // write data to queue, optionally resizing it
-        if (mQueue && (mDataMaxSize <= mQueue->getQuantumCount())) {
+        // write data to queue, resizing it only when the commands of this
+        // frame do not fit; the queue is otherwise kept across frames
+        if (mQueue && (mDataWritten <= mQueue->getQuantumCount())) {
             if (!mQueue->write(mData.get(), mDataWritten)) {
                 ALOGE("failed to write commands to message queue");
                 return false;
@@ -117,7 +118,12 @@ class CommandWriterBase {
 
             *outQueueChanged = false;
         } else {
-            auto newQueue = std::make_unique<CommandQueueType>(mDataMaxSize);
+            // mDataMaxSize grows geometrically, and so does the queue
+            size_t newQueueSize = mDataMaxSize;
+            if (mQueue) {
+                newQueueSize = std::max(newQueueSize, mQueue->getQuantumCount() * 2);
+            }
+            auto newQueue = std::make_unique<CommandQueueType>(newQueueSize);
             if (!newQueue->isValid() || !newQueue->write(mData.get(), mDataWritten)) {
                 ALOGE("failed to prepare a new message queue ");
                 return false;
@@ -304,16 +310,10 @@ class CommandWriterBase {
     }
 
     void setLayerSurfaceDamage(const std::vector<IComposerClient::Rect>& damage) {
-        bool doWrite = (damage.size() <= kMaxLength / 4);
-        size_t length = (doWrite) ? damage.size() * 4 : 0;
-
-        beginCommand(IComposerClient::Command::SET_LAYER_SURFACE_DAMAGE, length);
-        // When there are too many rectangles in the damage region and doWrite
-        // is false, we write no rectangle at all which means the entire
-        // layer is damaged.
-        if (doWrite) {
-            writeRegion(damage);
-        }
+        const auto& region = boundRegion(damage, kMaxLength / 4);
+
+        beginCommand(IComposerClient::Command::SET_LAYER_SURFACE_DAMAGE, region.size() * 4);
+        writeRegion(region);
         endCommand();
     }
 
@@ -382,16 +382,10 @@ class CommandWriterBase {
     }
 
     void setLayerVisibleRegion(const std::vector<IComposerClient::Rect>& visible) {
-        bool doWrite = (visible.size() <= kMaxLength / 4);
-        size_t length = (doWrite) ? visible.size() * 4 : 0;
-
-        beginCommand(IComposerClient::Command::SET_LAYER_VISIBLE_REGION, length);
-        // When there are too many rectangles in the visible region and
-        // doWrite is false, we write no rectangle at all which means the
-        // entire layer is visible.
-        if (doWrite) {
-            writeRegion(visible);
-        }
+        const auto& region = boundRegion(visible, kMaxLength / 4);
+
+        beginCommand(IComposerClient::Command::SET_LAYER_VISIBLE_REGION, region.size() * 4);
+        writeRegion(region);
         endCommand();
     }
 
@@ -411,20 +405,14 @@ class CommandWriterBase {
     void setClientTargetInternal(uint32_t slot, const native_handle_t* target, int acquireFence,
                                  int32_t dataspace,
                                  const std::vector<IComposerClient::Rect>& damage) {
-        bool doWrite = (damage.size() <= (kMaxLength - 4) / 4);
-        size_t length = 4 + ((doWrite) ? damage.size() * 4 : 0);
+        const auto& region = boundRegion(damage, (kMaxLength - 4) / 4);
 
-        beginCommand(IComposerClient::Command::SET_CLIENT_TARGET, length);
+        beginCommand(IComposerClient::Command::SET_CLIENT_TARGET, 4 + region.size() * 4);
         write(slot);
         writeHandle(target, true);
         writeFence(acquireFence);
         writeSigned(dataspace);
-        // When there are too many rectangles in the damage region and doWrite
-        // is false, we write no rectangle at all which means the entire
-        // client target is damaged.
-        if (doWrite) {
-            writeRegion(damage);
-        }
+        writeRegion(region);
         endCommand();
     }
 
@@ -487,6 +475,34 @@ class CommandWriterBase {
         }
     }
 
+    // Returns the region if it has at most maxRects rectangles.  Otherwise,
+    // returns a coarser region covering it, where each rectangle bounds a run
+    // of consecutive rectangles of the original region.  Regions are banded
+    // top to bottom, so neighbouring rectangles are close to each other and
+    // this stays much tighter than the entire layer, which is what an empty
+    // region would mean to the reader.
+    const std::vector<IComposerClient::Rect>& boundRegion(
+            const std::vector<IComposerClient::Rect>& region, size_t maxRects) {
+        if (region.size() <= maxRects) {
+            return region;
+        }
+
+        const size_t runLength = (region.size() + maxRects - 1) / maxRects;
+        mBoundedRegion.clear();
+        for (size_t begin = 0; begin < region.size(); begin += runLength) {
+            const size_t end = std::min(begin + runLength, region.size());
+            IComposerClient::Rect bounds = region[begin];
+            for (size_t i = begin + 1; i < end; i++) {
+                bounds.left = std::min(bounds.left, region[i].left);
+                bounds.top = std::min(bounds.top, region[i].top);
+                bounds.right = std::max(bounds.right, region[i].right);
+                bounds.bottom = std::max(bounds.bottom, region[i].bottom);
+            }
+            mBoundedRegion.push_back(bounds);
+        }
+        return mBoundedRegion;
+    }
+
     void writeFRect(const IComposerClient::FRect& rect) {
         writeFloat(rect.left);
         writeFloat(rect.top);
@@ -572,6 +588,9 @@ class CommandWriterBase {
     std::vector<hidl_handle> mDataHandles;
     std::vector<native_handle_t*> mTemporaryHandles;
 
+    // scratch space of boundRegion, kept to avoid reallocating every frame
+    std::vector<IComposerClient::Rect> mBoundedRegion;
+
     std::unique_ptr<CommandQueueType> mQueue;
 };
 
@@ -528,7 +528,8 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
     mHwc1LayerMap(),
     mNumAvailableRects(0),
     mNextAvailableRect(nullptr),
-    mGeometryChanged(false)
+    mGeometryChanged(false),
+    mLayoutChanged(true)
     {}
 
 Error HWC2On1Adapter::Display::acceptChanges() {
@@ -566,7 +567,7 @@ Error HWC2On1Adapter::Display::createLayer(hwc2_layer_t* outLayerId) {
     mDevice.mLayers.emplace(std::make_pair(layer->getId(), layer));
     *outLayerId = layer->getId();
     ALOGV("[%" PRIu64 "] created layer %" PRIu64, mId, *outLayerId);
-    markGeometryChanged();
+    markLayoutChanged();
     return Error::None;
 }
 
@@ -589,7 +590,7 @@ Error HWC2On1Adapter::Display::destroyLayer(hwc2_layer_t layerId) {
         }
     }
     ALOGV("[%" PRIu64 "] destroyed layer %" PRIu64, mId, layerId);
-    markGeometryChanged();
+    markLayoutChanged();
     return Error::None;
 }
 
@@ -829,6 +830,7 @@ Error HWC2On1Adapter::Display::setActiveConfig(hwc2_config_t configId) {
             return Error::BadConfig;
         }
         mActiveConfig = config;
+        markGeometryChanged();
     }
 
     return Error::None;
@@ -883,7 +885,12 @@ Error HWC2On1Adapter::Display::setColorTransform(android_color_transform_t hint)
 
     ALOGV("%" PRIu64 "] setColorTransform(%d)", mId,
             static_cast<int32_t>(hint));
-    mHasColorTransform = (hint != HAL_COLOR_TRANSFORM_IDENTITY);
+    bool hasColorTransform = (hint != HAL_COLOR_TRANSFORM_IDENTITY);
+    if (hasColorTransform != mHasColorTransform) {
+        // The composition types of all layers depend on it
+        mHasColorTransform = hasColorTransform;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
@@ -1023,7 +1030,7 @@ Error HWC2On1Adapter::Display::updateLayerZ(hwc2_layer_t layerId, uint32_t z) {
 
     layer->setZ(z);
     mLayers.emplace(std::move(layer));
-    markGeometryChanged();
+    markLayoutChanged();
 
     return Error::None;
 }
@@ -1214,8 +1221,19 @@ bool HWC2On1Adapter::Display::prepare() {
         return false;
     }
 
-    allocateRequestedContents();
-    assignHwc1LayerIds();
+    // The contents of the previous frame are reused unless the layout
+    // changed, in which case every layer is written from scratch. Otherwise
+    // only layers whose geometry changed are rewritten, and on frames without
+    // any geometry change only the buffers are updated and HWC1 keeps the
+    // composition types it picked during the previous prepare().
+    if (mLayoutChanged || !mHwc1RequestedContents) {
+        allocateRequestedContents();
+        assignHwc1LayerIds();
+        for (auto& layer : mLayers) {
+            layer->markGeometryChanged();
+        }
+        mLayoutChanged = false;
+    }
 
     mHwc1RequestedContents->retireFenceFd = -1;
     mHwc1RequestedContents->flags = 0;
@@ -1887,7 +1905,10 @@ void HWC2On1Adapter::Display::prepareFramebufferTarget() {
     hwc1Target.planeAlpha = 255;
 
     hwc1Target.visibleRegionScreen.numRects = 1;
-    hwc_rect_t* rects = GetRects(1);
+    auto rects = const_cast<hwc_rect_t*>(hwc1Target.visibleRegionScreen.rects);
+    if (!rects) {
+        rects = GetRects(1);
+    }
     rects[0].left = 0;
     rects[0].top = 0;
     rects[0].right = width;
@@ -1919,7 +1940,8 @@ HWC2On1Adapter::Layer::Layer(Display& display)
     mZ(0),
     mReleaseFence(),
     mHwc1Id(0),
-    mHasUnsupportedPlaneAlpha(false) {}
+    mHasUnsupportedPlaneAlpha(false),
+    mGeometryChanged(true) {}
 
 bool HWC2On1Adapter::SortLayersByZ::operator()(const std::shared_ptr<Layer>& lhs,
                                                const std::shared_ptr<Layer>& rhs) const {
@@ -1962,20 +1984,27 @@ Error HWC2On1Adapter::Layer::setSurfaceDamage(hwc_region_t damage) {
 // Layer state functions
 
 Error HWC2On1Adapter::Layer::setBlendMode(BlendMode mode) {
-    mBlendMode = mode;
-    mDisplay.markGeometryChanged();
+    if (mode != mBlendMode) {
+        mBlendMode = mode;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setColor(hwc_color_t color) {
-    mColor = color;
-    mDisplay.markGeometryChanged();
+    if (color.r != mColor.r || color.g != mColor.g || color.b != mColor.b ||
+            color.a != mColor.a) {
+        mColor = color;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setCompositionType(Composition type) {
-    mCompositionType = type;
-    mDisplay.markGeometryChanged();
+    if (type != mCompositionType) {
+        mCompositionType = type;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
@@ -1983,50 +2012,66 @@ Error HWC2On1Adapter::Layer::setDataspace(android_dataspace_t) {
     return Error::None;
 }
 
+static bool compareRects(const hwc_rect_t& rect1, const hwc_rect_t& rect2) {
+    return rect1.left == rect2.left &&
+            rect1.right == rect2.right &&
+            rect1.top == rect2.top &&
+            rect1.bottom == rect2.bottom;
+}
+
 Error HWC2On1Adapter::Layer::setDisplayFrame(hwc_rect_t frame) {
-    mDisplayFrame = frame;
-    mDisplay.markGeometryChanged();
+    if (!compareRects(frame, mDisplayFrame)) {
+        mDisplayFrame = frame;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setPlaneAlpha(float alpha) {
-    mPlaneAlpha = alpha;
-    mDisplay.markGeometryChanged();
+    if (alpha != mPlaneAlpha) {
+        mPlaneAlpha = alpha;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSidebandStream(const native_handle_t* stream) {
-    mSidebandStream = stream;
-    mDisplay.markGeometryChanged();
+    if (stream != mSidebandStream) {
+        mSidebandStream = stream;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSourceCrop(hwc_frect_t crop) {
-    mSourceCrop = crop;
-    mDisplay.markGeometryChanged();
+    if (crop.left != mSourceCrop.left || crop.top != mSourceCrop.top ||
+            crop.right != mSourceCrop.right ||
+            crop.bottom != mSourceCrop.bottom) {
+        mSourceCrop = crop;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setTransform(Transform transform) {
-    mTransform = transform;
-    mDisplay.markGeometryChanged();
+    if (transform != mTransform) {
+        mTransform = transform;
+        markGeometryChanged();
+    }
     return Error::None;
 }
 
-static bool compareRects(const hwc_rect_t& rect1, const hwc_rect_t& rect2) {
-    return rect1.left == rect2.left &&
-            rect1.right == rect2.right &&
-            rect1.top == rect2.top &&
-            rect1.bottom == rect2.bottom;
-}
-
 Error HWC2On1Adapter::Layer::setVisibleRegion(hwc_region_t visible) {
+    if (getNumVisibleRegions() != visible.numRects) {
+        // The rects of the HWC1 visible region are allocated per layout
+        mDisplay.markLayoutChanged();
+    }
     if ((getNumVisibleRegions() != visible.numRects) ||
         !std::equal(mVisibleRegion.begin(), mVisibleRegion.end(), visible.rects,
                     compareRects)) {
         mVisibleRegion.resize(visible.numRects);
         std::copy_n(visible.rects, visible.numRects, mVisibleRegion.begin());
-        mDisplay.markGeometryChanged();
+        markGeometryChanged();
     }
     return Error::None;
 }
@@ -2045,9 +2090,29 @@ const sp<MiniFence>& HWC2On1Adapter::Layer::getReleaseFence() const {
     return mReleaseFence.get();
 }
 
+void HWC2On1Adapter::Layer::markGeometryChanged() {
+    mGeometryChanged = true;
+    mDisplay.markGeometryChanged();
+}
+
 void HWC2On1Adapter::Layer::applyState(hwc_layer_1_t& hwc1Layer) {
-    applyCommonState(hwc1Layer);
-    applyCompositionType(hwc1Layer);
+    if (mGeometryChanged) {
+        applyCommonState(hwc1Layer);
+        mGeometryChanged = false;
+    }
+    // HWC1 only expects composition types to be set along with
+    // HWC_GEOMETRY_CHANGED.
+    if (mDisplay.isGeometryChanged()) {
+        applyCompositionType(hwc1Layer);
+    }
+    // Hints are also written by HWC1 during prepare(), so they are reset on
+    // every frame.
+    hwc1Layer.hints = 0;
+    if (mCompositionType == Composition::Cursor &&
+            (hwc1Layer.flags & HWC_SKIP_LAYER) == 0 &&
+            mDisplay.getDevice().getHwc1MinorVersion() >= 4) {
+        hwc1Layer.hints |= HWC_IS_CURSOR_LAYER;
+    }
     switch (mCompositionType) {
         case Composition::SolidColor : applySolidColorState(hwc1Layer); break;
         case Composition::Sideband : applySidebandState(hwc1Layer); break;
@@ -2151,10 +2216,15 @@ void HWC2On1Adapter::Layer::applyCommonState(hwc_layer_1_t& hwc1Layer) {
 
     hwc1Layer.transform = static_cast<uint32_t>(mTransform);
 
+    // The rects are only allocated with new contents. Reused contents have
+    // as many rects as the visible region, see setVisibleRegion().
     auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
-    hwc1VisibleRegion.numRects = mVisibleRegion.size();
-    hwc_rect_t* rects = mDisplay.GetRects(hwc1VisibleRegion.numRects);
-    hwc1VisibleRegion.rects = rects;
+    auto rects = const_cast<hwc_rect_t*>(hwc1VisibleRegion.rects);
+    if (!rects) {
+        hwc1VisibleRegion.numRects = mVisibleRegion.size();
+        rects = mDisplay.GetRects(hwc1VisibleRegion.numRects);
+        hwc1VisibleRegion.rects = rects;
+    }
     for (size_t i = 0; i < mVisibleRegion.size(); i++) {
         rects[i] = mVisibleRegion[i];
     }
@@ -2214,9 +2284,6 @@ void HWC2On1Adapter::Layer::applyCompositionType(hwc_layer_1_t& hwc1Layer) {
             break;
         case Composition::Cursor:
             hwc1Layer.compositionType = HWC_FRAMEBUFFER;
-            if (mDisplay.getDevice().getHwc1MinorVersion() >= 4) {
-                hwc1Layer.hints |= HWC_IS_CURSOR_LAYER;
-            }
             break;
         case Composition::Sideband:
             if (mDisplay.getDevice().getHwc1MinorVersion() < 4) {
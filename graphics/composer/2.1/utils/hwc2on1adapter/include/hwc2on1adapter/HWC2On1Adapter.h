@@ -278,6 +278,15 @@ private:
 
             void markGeometryChanged() { mGeometryChanged = true; }
             void resetGeometryMarker() { mGeometryChanged = false;}
+            bool isGeometryChanged() const { return mGeometryChanged; }
+
+            // Layers were added, removed or reordered, or the number of
+            // rects in a visible region changed, so the HWC1 contents must be
+            // reallocated.
+            void markLayoutChanged() {
+                mLayoutChanged = true;
+                mGeometryChanged = true;
+            }
         private:
             class Config {
                 public:
@@ -458,6 +467,10 @@ private:
             // updated with anything other than a buffer since last call to
             // Display::set()
             bool mGeometryChanged;
+
+            // True if mHwc1RequestedContents can't be reused by the next
+            // prepare(), see markLayoutChanged()
+            bool mLayoutChanged;
     };
 
     // Utility template calling a Display object method directly based on the
@@ -560,7 +573,13 @@ private:
             void setHwc1Id(size_t id) { mHwc1Id = id; }
             size_t getHwc1Id() const { return mHwc1Id; }
 
-            // Write state to HWC1 communication struct.
+            // Marks this layer and its display as having changed anything
+            // other than a buffer since the last prepare().
+            void markGeometryChanged();
+
+            // Write state to HWC1 communication struct. Only the buffer state
+            // is written unless the layer geometry has changed, since hwc1Layer
+            // is reused across frames.
             void applyState(struct hwc_layer_1& hwc1Layer);
 
             std::string dump() const;
@@ -605,6 +624,7 @@ private:
 
             size_t mHwc1Id;
             bool mHasUnsupportedPlaneAlpha;
+            bool mGeometryChanged;
     };
 
     // Utility tempate calling a Layer object method based on ID parameters:
@@ -23,8 +23,13 @@
 #include <algorithm>
 #include <type_traits>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <sys/ioctl.h>
 #include <sys/prctl.h>
 #include <unistd.h> // for close
 
@@ -38,6 +43,17 @@ namespace android {
 
 namespace {
 
+// sw_sync ABI, as in drivers/dma-buf/sw_sync.c
+struct sw_sync_create_fence_data {
+    uint32_t value;
+    char name[32];
+    int32_t fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE _IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, uint32_t)
+
 void dumpHook(hwc2_device_t* device, uint32_t* outSize, char* outBuffer) {
     auto& adapter = HWC2OnFbAdapter::cast(device);
     if (outBuffer) {
@@ -217,7 +233,7 @@ int32_t getClientTargetSupportHook(hwc2_device_t* device, hwc2_display_t display
 }
 
 int32_t setClientTargetHook(hwc2_device_t* device, hwc2_display_t display, buffer_handle_t target,
-                            int32_t acquireFence, int32_t dataspace, hwc_region_t /*damage*/) {
+                            int32_t acquireFence, int32_t dataspace, hwc_region_t damage) {
     if (acquireFence >= 0) {
         sync_wait(acquireFence, -1);
         close(acquireFence);
@@ -232,7 +248,7 @@ int32_t setClientTargetHook(hwc2_device_t* device, hwc2_display_t display, buffe
     }
 
     // no state change
-    adapter.setBuffer(target);
+    adapter.setBuffer(target, damage);
     return HWC2_ERROR_NONE;
 }
 
@@ -399,8 +415,7 @@ int32_t presentDisplayHook(hwc2_device_t* device, hwc2_display_t display,
         return HWC2_ERROR_NOT_VALIDATED;
     }
 
-    adapter.postBuffer();
-    *outPresentFence = -1;
+    adapter.postBuffer(outPresentFence);
 
     return HWC2_ERROR_NONE;
 }
@@ -659,8 +674,8 @@ HWC2OnFbAdapter::HWC2OnFbAdapter(framebuffer_device_t* fbDevice)
     mFbInfo.xdpi_scaled = int(mFbDevice->xdpi * 1000.0f);
     mFbInfo.ydpi_scaled = int(mFbDevice->ydpi * 1000.0f);
 
-    // Present fences aren't supported, always indicate PresentFenceIsNotReliable
-    // for FB devices
+    // Present fences are at best synthesized from the software vsync, always
+    // indicate PresentFenceIsNotReliable for FB devices
     mCapabilities.insert(Capability::PresentFenceIsNotReliable);
 
     mVsyncThread.start(0, mFbInfo.vsync_period_ns);
@@ -768,26 +783,58 @@ void HWC2OnFbAdapter::clearDirtyLayers() {
  *  - schedules the buffer for presentation on the next vsync
  *  - locks the buffer and blocks all other users trying to lock it
  *
- * It does not give us a way to return a present fence, and we need to live
- * with that.  The implication is that, when we are double-buffered,
+ * It does not give us a way to return a present fence.  When sw_sync is
+ * available, we return a fence that the vsync thread signals on the vsync
+ * following the post instead.  Otherwise, when we are double-buffered,
  * SurfaceFlinger assumes the front buffer is available for rendering again
  * immediately after the back buffer is posted.  The locking semantics
  * hopefully are strong enough that the rendering will be blocked.
+ *
+ * Devices with update-on-demand framebuffers implement setUpdateRect, in
+ * which case only the bounds of the client target damage are updated.
  */
-void HWC2OnFbAdapter::setBuffer(buffer_handle_t buffer) {
+void HWC2OnFbAdapter::setBuffer(buffer_handle_t buffer, const hwc_region_t& damage) {
     if (mFbDevice->compositionComplete) {
         mFbDevice->compositionComplete(mFbDevice);
     }
     mBuffer = buffer;
+
+    // an empty damage region means the whole buffer has changed
+    const int width = mFbInfo.width;
+    const int height = mFbInfo.height;
+    hwc_rect_t bounds{width, height, 0, 0};
+    for (size_t i = 0; i < damage.numRects; i++) {
+        const hwc_rect_t& rect = damage.rects[i];
+        bounds.left = std::min(bounds.left, std::max(rect.left, 0));
+        bounds.top = std::min(bounds.top, std::max(rect.top, 0));
+        bounds.right = std::max(bounds.right, std::min(rect.right, width));
+        bounds.bottom = std::max(bounds.bottom, std::min(rect.bottom, height));
+    }
+    if (bounds.left >= bounds.right || bounds.top >= bounds.bottom) {
+        bounds = {0, 0, width, height};
+    }
+    mDamageBounds = bounds;
 }
 
-bool HWC2OnFbAdapter::postBuffer() {
-    int error = 0;
-    if (mBuffer) {
-        error = mFbDevice->post(mFbDevice, mBuffer);
+bool HWC2OnFbAdapter::postBuffer(int32_t* outPresentFence) {
+    *outPresentFence = -1;
+    if (!mBuffer) {
+        return true;
+    }
+
+    if (mFbDevice->setUpdateRect) {
+        const hwc_rect_t& rect = mDamageBounds;
+        mFbDevice->setUpdateRect(mFbDevice, rect.left, rect.top, rect.right - rect.left,
+                                 rect.bottom - rect.top);
     }
 
-    return error == 0;
+    int error = mFbDevice->post(mFbDevice, mBuffer);
+    if (error) {
+        return false;
+    }
+
+    *outPresentFence = mVsyncThread.createPresentFence();
+    return true;
 }
 
 void HWC2OnFbAdapter::setVsyncCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data) {
@@ -840,9 +887,22 @@ bool HWC2OnFbAdapter::VsyncThread::sleepUntil(int64_t t) {
     }
 }
 
+int HWC2OnFbAdapter::VsyncThread::openTimeline() {
+    for (const char* path : {"/dev/sw_sync", "/sys/kernel/debug/sync/sw_sync"}) {
+        int fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+
+    ALOGI("sw_sync is not available, present fences are disabled");
+    return -1;
+}
+
 void HWC2OnFbAdapter::VsyncThread::start(int64_t firstVsync, int64_t period) {
     mNextVsync = firstVsync;
     mPeriod = period;
+    mTimeline = openTimeline();
     mStarted = true;
     mThread = std::thread(&VsyncThread::vsyncLoop, this);
 }
@@ -854,6 +914,45 @@ void HWC2OnFbAdapter::VsyncThread::stop() {
     }
     mCondition.notify_all();
     mThread.join();
+
+    // pending fences are signaled when the timeline is closed
+    if (mTimeline >= 0) {
+        ::close(mTimeline);
+        mTimeline = -1;
+    }
+}
+
+int HWC2OnFbAdapter::VsyncThread::createPresentFence() {
+    struct sw_sync_create_fence_data data{};
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mTimeline < 0) {
+            return -1;
+        }
+
+        data.value = mFenceValue + 1;
+        snprintf(data.name, sizeof(data.name), "hwc2onfb-present");
+        if (ioctl(mTimeline, SW_SYNC_IOC_CREATE_FENCE, &data) < 0) {
+            ALOGE("failed to create present fence: %s", strerror(errno));
+            return -1;
+        }
+        mFenceValue = data.value;
+    }
+    mCondition.notify_all();
+
+    return data.fence;
+}
+
+void HWC2OnFbAdapter::VsyncThread::signalPresentFencesLocked() {
+    if (mTimelineValue == mFenceValue) {
+        return;
+    }
+
+    uint32_t increment = mFenceValue - mTimelineValue;
+    if (ioctl(mTimeline, SW_SYNC_IOC_INC, &increment) < 0) {
+        ALOGE("failed to signal present fences: %s", strerror(errno));
+    }
+    mTimelineValue = mFenceValue;
 }
 
 void HWC2OnFbAdapter::VsyncThread::setCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data) {
@@ -879,8 +978,11 @@ void HWC2OnFbAdapter::VsyncThread::vsyncLoop() {
     }
 
     while (true) {
-        if (!mCallbackEnabled) {
-            mCondition.wait(lock, [this] { return mCallbackEnabled || !mStarted; });
+        // keep ticking while present fences are pending, even without callback
+        if (!mCallbackEnabled && mTimelineValue == mFenceValue) {
+            mCondition.wait(lock, [this] {
+                return mCallbackEnabled || mTimelineValue != mFenceValue || !mStarted;
+            });
             if (!mStarted) {
                 break;
             }
@@ -900,7 +1002,8 @@ void HWC2OnFbAdapter::VsyncThread::vsyncLoop() {
 
         if (fire) {
             ALOGV("VsyncThread(%" PRId64 ")", mNextVsync);
-            if (mCallback) {
+            signalPresentFencesLocked();
+            if (mCallbackEnabled && mCallback) {
                 mCallback(mCallbackData, getDisplayId(), mNextVsync);
             }
             mNextVsync += mPeriod;
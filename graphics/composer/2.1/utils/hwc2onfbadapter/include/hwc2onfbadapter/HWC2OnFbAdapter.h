@@ -74,8 +74,8 @@ public:
     const std::unordered_set<hwc2_layer_t>& getDirtyLayers() const;
     void clearDirtyLayers();
 
-    void setBuffer(buffer_handle_t buffer);
-    bool postBuffer();
+    void setBuffer(buffer_handle_t buffer, const hwc_region_t& damage);
+    bool postBuffer(int32_t* outPresentFence);
 
     void setVsyncCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data);
     void enableVsync(bool enable);
@@ -94,6 +94,8 @@ private:
     std::unordered_set<hwc2_layer_t> mDirtyLayers;
 
     buffer_handle_t mBuffer{nullptr};
+    // bounds of the damage of mBuffer, clipped to the display
+    hwc_rect_t mDamageBounds{};
 
     std::unordered_set<HWC2::Capability> mCapabilities;
 
@@ -106,10 +108,15 @@ private:
         void stop();
         void setCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data);
         void enableCallback(bool enable);
+        // returns a fence signaled on the next vsync, or -1 without sw_sync
+        int createPresentFence();
 
     private:
+        static int openTimeline();
+
         void vsyncLoop();
         bool waitUntilNextVsync();
+        void signalPresentFencesLocked();
 
         std::thread mThread;
         int64_t mNextVsync{0};
@@ -121,6 +128,11 @@ private:
         HWC2_PFN_VSYNC mCallback{nullptr};
         hwc2_callback_data_t mCallbackData{nullptr};
         bool mCallbackEnabled{false};
+
+        // sw_sync timeline of the present fences
+        int mTimeline{-1};
+        uint32_t mFenceValue{0};
+        uint32_t mTimelineValue{0};
     };
     VsyncThread mVsyncThread;
 };
@@ -173,7 +173,8 @@ ComposerDisplayResource::ComposerDisplayResource(DisplayType type, ComposerHandl
     : mType(type),
       mClientTargetCache(importer),
       mOutputBufferCache(importer, ComposerHandleCache::HandleType::BUFFER, outputBufferCacheSize),
-      mMustValidate(true) {}
+      mMustValidate(true),
+      mLayerResources(std::make_shared<const LayerResources>()) {}
 
 bool ComposerDisplayResource::initClientTargetCache(uint32_t cacheSize) {
     return mClientTargetCache.initCache(ComposerHandleCache::HandleType::BUFFER, cacheSize);
@@ -207,38 +208,53 @@ Error ComposerDisplayResource::getOutputBuffer(uint32_t slot, bool fromCache,
 
 bool ComposerDisplayResource::addLayer(Layer layer,
                                        std::unique_ptr<ComposerLayerResource> layerResource) {
-    auto result = mLayerResources.emplace(layer, std::move(layerResource));
-    return result.second;
+    auto layerResources = std::make_shared<LayerResources>(*std::atomic_load(&mLayerResources));
+    auto result = layerResources->emplace(layer, std::move(layerResource));
+    if (!result.second) {
+        return false;
+    }
+
+    std::atomic_store(&mLayerResources, std::shared_ptr<const LayerResources>(layerResources));
+    return true;
 }
 
 bool ComposerDisplayResource::removeLayer(Layer layer) {
-    return mLayerResources.erase(layer) > 0;
+    auto layerResources = std::make_shared<LayerResources>(*std::atomic_load(&mLayerResources));
+    if (layerResources->erase(layer) == 0) {
+        return false;
+    }
+
+    std::atomic_store(&mLayerResources, std::shared_ptr<const LayerResources>(layerResources));
+    return true;
 }
 
-ComposerLayerResource* ComposerDisplayResource::findLayerResource(Layer layer) {
-    auto layerIter = mLayerResources.find(layer);
-    if (layerIter == mLayerResources.end()) {
+std::shared_ptr<ComposerLayerResource> ComposerDisplayResource::findLayerResource(
+        Layer layer) const {
+    const auto layerResources = std::atomic_load(&mLayerResources);
+    auto layerIter = layerResources->find(layer);
+    if (layerIter == layerResources->end()) {
         return nullptr;
     }
 
-    return layerIter->second.get();
+    return layerIter->second;
 }
 
 std::vector<Layer> ComposerDisplayResource::getLayers() const {
+    const auto layerResources = std::atomic_load(&mLayerResources);
     std::vector<Layer> layers;
-    layers.reserve(mLayerResources.size());
-    for (const auto& layerKey : mLayerResources) {
+    layers.reserve(layerResources->size());
+    for (const auto& layerKey : *layerResources) {
         layers.push_back(layerKey.first);
     }
     return layers;
 }
 
 void ComposerDisplayResource::setMustValidateState(bool mustValidate) {
-    mMustValidate = mustValidate;
+    mMustValidate.store(mustValidate, std::memory_order_relaxed);
 }
 
 bool ComposerDisplayResource::mustValidate() const {
-    return mMustValidate;
+    return mMustValidate.load(std::memory_order_relaxed);
 }
 
 std::unique_ptr<ComposerResources> ComposerResources::create() {
@@ -252,24 +268,33 @@ bool ComposerResources::init() {
 
 void ComposerResources::clear(RemoveDisplay removeDisplay) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    for (const auto& displayKey : mDisplayResources) {
+    const auto displayResources = std::atomic_load(&mDisplayResources);
+    for (const auto& displayKey : *displayResources) {
         Display display = displayKey.first;
         const ComposerDisplayResource& displayResource = *displayKey.second;
         removeDisplay(display, displayResource.isVirtual(), displayResource.getLayers());
     }
-    mDisplayResources.clear();
+    std::atomic_store(&mDisplayResources, std::make_shared<const DisplayResources>());
 }
 
 bool ComposerResources::hasDisplay(Display display) {
-    return mDisplayResources.count(display) > 0;
+    return findDisplayResource(display) != nullptr;
 }
 
 Error ComposerResources::addPhysicalDisplay(Display display) {
     auto displayResource = createDisplayResource(ComposerDisplayResource::DisplayType::PHYSICAL, 0);
 
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto result = mDisplayResources.emplace(display, std::move(displayResource));
-    return result.second ? Error::NONE : Error::BAD_DISPLAY;
+    auto displayResources =
+            std::make_shared<DisplayResources>(*std::atomic_load(&mDisplayResources));
+    auto result = displayResources->emplace(display, std::move(displayResource));
+    if (!result.second) {
+        return Error::BAD_DISPLAY;
+    }
+
+    std::atomic_store(&mDisplayResources,
+                      std::shared_ptr<const DisplayResources>(displayResources));
+    return Error::NONE;
 }
 
 Error ComposerResources::addVirtualDisplay(Display display, uint32_t outputBufferCacheSize) {
@@ -277,19 +302,35 @@ Error ComposerResources::addVirtualDisplay(Display display, uint32_t outputBuffe
                                                  outputBufferCacheSize);
 
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto result = mDisplayResources.emplace(display, std::move(displayResource));
-    return result.second ? Error::NONE : Error::BAD_DISPLAY;
+    auto displayResources =
+            std::make_shared<DisplayResources>(*std::atomic_load(&mDisplayResources));
+    auto result = displayResources->emplace(display, std::move(displayResource));
+    if (!result.second) {
+        return Error::BAD_DISPLAY;
+    }
+
+    std::atomic_store(&mDisplayResources,
+                      std::shared_ptr<const DisplayResources>(displayResources));
+    return Error::NONE;
 }
 
 Error ComposerResources::removeDisplay(Display display) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    return mDisplayResources.erase(display) > 0 ? Error::NONE : Error::BAD_DISPLAY;
+    auto displayResources =
+            std::make_shared<DisplayResources>(*std::atomic_load(&mDisplayResources));
+    if (displayResources->erase(display) == 0) {
+        return Error::BAD_DISPLAY;
+    }
+
+    std::atomic_store(&mDisplayResources,
+                      std::shared_ptr<const DisplayResources>(displayResources));
+    return Error::NONE;
 }
 
 Error ComposerResources::setDisplayClientTargetCacheSize(Display display,
                                                          uint32_t clientTargetCacheSize) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
@@ -299,8 +340,7 @@ Error ComposerResources::setDisplayClientTargetCacheSize(Display display,
 }
 
 Error ComposerResources::getDisplayClientTargetCacheSize(Display display, size_t* outCacheSize) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
@@ -309,8 +349,7 @@ Error ComposerResources::getDisplayClientTargetCacheSize(Display display, size_t
 }
 
 Error ComposerResources::getDisplayOutputBufferCacheSize(Display display, size_t* outCacheSize) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
@@ -322,7 +361,7 @@ Error ComposerResources::addLayer(Display display, Layer layer, uint32_t bufferC
     auto layerResource = createLayerResource(bufferCacheSize);
 
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
@@ -333,7 +372,7 @@ Error ComposerResources::addLayer(Display display, Layer layer, uint32_t bufferC
 
 Error ComposerResources::removeLayer(Display display, Layer layer) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
@@ -374,16 +413,14 @@ Error ComposerResources::getLayerSidebandStream(Display display, Layer layer,
 }
 
 void ComposerResources::setDisplayMustValidateState(Display display, bool mustValidate) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (displayResource) {
         displayResource->setMustValidateState(mustValidate);
     }
 }
 
 bool ComposerResources::mustValidateDisplay(Display display) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (displayResource) {
         return displayResource->mustValidate();
     }
@@ -400,12 +437,14 @@ std::unique_ptr<ComposerLayerResource> ComposerResources::createLayerResource(
     return std::make_unique<ComposerLayerResource>(mImporter, bufferCacheSize);
 }
 
-ComposerDisplayResource* ComposerResources::findDisplayResourceLocked(Display display) {
-    auto iter = mDisplayResources.find(display);
-    if (iter == mDisplayResources.end()) {
+std::shared_ptr<ComposerDisplayResource> ComposerResources::findDisplayResource(
+        Display display) const {
+    const auto displayResources = std::atomic_load(&mDisplayResources);
+    auto iter = displayResources->find(display);
+    if (iter == displayResources->end()) {
         return nullptr;
     }
-    return iter->second.get();
+    return iter->second;
 }
 
 Error ComposerResources::getHandle(Display display, Layer layer, uint32_t slot, Cache cache,
@@ -425,13 +464,11 @@ Error ComposerResources::getHandle(Display display, Layer layer, uint32_t slot,
         }
     }
 
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-
     // find display/layer resource
     const bool needLayerResource = (cache == ComposerResources::Cache::LAYER_BUFFER ||
                                     cache == ComposerResources::Cache::LAYER_SIDEBAND_STREAM);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
-    ComposerLayerResource* layerResource = (displayResource && needLayerResource)
+    auto displayResource = findDisplayResource(display);
+    auto layerResource = (displayResource && needLayerResource)
                                                    ? displayResource->findLayerResource(layer)
                                                    : nullptr;
 
@@ -20,6 +20,7 @@
 #warning "ComposerResources.h included without LOG_TAG"
 #endif
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -87,6 +88,9 @@ class ComposerHandleCache {
 };
 
 // layer resource
+//
+// The handle caches of a layer are only accessed while processing commands, which the composer
+// client serializes, so they are not locked.
 class ComposerLayerResource {
   public:
     ComposerLayerResource(ComposerHandleImporter& importer, uint32_t bufferCacheSize);
@@ -105,6 +109,10 @@ class ComposerLayerResource {
 };
 
 // display resource
+//
+// Like the layer caches, the client target and output buffer caches are only accessed while
+// processing commands. The layer table is replaced as a whole by addLayer and removeLayer, which
+// the caller must serialize, so that findLayerResource does not need a lock.
 class ComposerDisplayResource {
   public:
     enum class DisplayType {
@@ -132,7 +140,7 @@ class ComposerDisplayResource {
 
     bool addLayer(Layer layer, std::unique_ptr<ComposerLayerResource> layerResource);
     bool removeLayer(Layer layer);
-    ComposerLayerResource* findLayerResource(Layer layer);
+    std::shared_ptr<ComposerLayerResource> findLayerResource(Layer layer) const;
     std::vector<Layer> getLayers() const;
 
     void setMustValidateState(bool mustValidate);
@@ -140,12 +148,15 @@ class ComposerDisplayResource {
     bool mustValidate() const;
 
   protected:
+    using LayerResources = std::unordered_map<Layer, std::shared_ptr<ComposerLayerResource>>;
+
     const DisplayType mType;
     ComposerHandleCache mClientTargetCache;
     ComposerHandleCache mOutputBufferCache;
-    bool mMustValidate;
+    std::atomic<bool> mMustValidate;
 
-    std::unordered_map<Layer, std::unique_ptr<ComposerLayerResource>> mLayerResources;
+    // accessed with std::atomic_load and std::atomic_store
+    std::shared_ptr<const LayerResources> mLayerResources;
 };
 
 class ComposerResources {
@@ -235,12 +246,21 @@ class ComposerResources {
 
     virtual std::unique_ptr<ComposerLayerResource> createLayerResource(uint32_t bufferCacheSize);
 
-    ComposerDisplayResource* findDisplayResourceLocked(Display display);
+    using DisplayResources =
+            std::unordered_map<Display, std::shared_ptr<ComposerDisplayResource>>;
+
+    // Returns the display resource without locking. The returned reference keeps the resource
+    // alive even if the display is removed concurrently.
+    std::shared_ptr<ComposerDisplayResource> findDisplayResource(Display display) const;
 
     ComposerHandleImporter mImporter;
 
+    // The display table is immutable once published. Adding or removing a display copies it and
+    // publishes the copy with mDisplayResourcesMutex held, while per-frame lookups only load the
+    // current table. Accessed with std::atomic_load and std::atomic_store.
     std::mutex mDisplayResourcesMutex;
-    std::unordered_map<Display, std::unique_ptr<ComposerDisplayResource>> mDisplayResources;
+    std::shared_ptr<const DisplayResources> mDisplayResources =
+            std::make_shared<const DisplayResources>();
 
   private:
     enum class Cache {
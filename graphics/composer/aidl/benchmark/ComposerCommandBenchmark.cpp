@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the per-frame cost of the composer3 command helpers: building commands with
+// ComposerClientWriter, marshalling them through a parcel, and building and parsing the command
+// results with ComposerServiceWriter and ComposerClientReader. Each benchmark takes the number of
+// displays and the number of layers per display, and reports heap allocations per frame next to
+// the time.
+
+#include <android/binder_parcel.h>
+#include <android/binder_parcel_utils.h>
+#include <android/hardware/graphics/composer3/ComposerClientReader.h>
+#include <android/hardware/graphics/composer3/ComposerClientWriter.h>
+#include <android/hardware/graphics/composer3/ComposerServiceWriter.h>
+#include <benchmark/benchmark.h>
+#include <cutils/native_handle.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> gAllocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+
+namespace aidl::android::hardware::graphics::composer3 {
+namespace {
+
+constexpr int64_t kFirstDisplay = 1;
+constexpr uint32_t kBufferSlotCount = 3;
+
+struct NativeHandleDeleter {
+    void operator()(native_handle_t* handle) const { native_handle_delete(handle); }
+};
+using UniqueNativeHandle = std::unique_ptr<native_handle_t, NativeHandleDeleter>;
+
+// A gralloc-like handle made of ints only, so that duplicating it doesn't need file descriptors
+UniqueNativeHandle createBufferHandle(int seed) {
+    UniqueNativeHandle handle(native_handle_create(/*numFds=*/0, /*numInts=*/8));
+    for (int i = 0; i < handle->numInts; i++) {
+        handle->data[i] = seed + i;
+    }
+    return handle;
+}
+
+class Scene {
+  public:
+    Scene(int64_t numDisplays, int64_t numLayers) : mNumDisplays(numDisplays), mNumLayers(numLayers) {
+        for (int64_t i = 0; i < numLayers * kBufferSlotCount; i++) {
+            mBuffers.push_back(createBufferHandle(static_cast<int>(i)));
+        }
+    }
+
+    int64_t numDisplays() const { return mNumDisplays; }
+    int64_t numLayers() const { return mNumLayers; }
+
+    // Writes the commands of a typical frame: every layer latches a new buffer with its damage,
+    // and one layer in four also moves.
+    template <typename SetBuffer>
+    void writeFrame(ComposerClientWriter& writer, uint32_t frame, SetBuffer&& setBuffer) const {
+        const std::vector<Rect> damage{Rect{0, 0, 64, 64}};
+        for (int64_t display = kFirstDisplay; display < kFirstDisplay + mNumDisplays; display++) {
+            for (int64_t layer = 0; layer < mNumLayers; layer++) {
+                const uint32_t slot = frame % kBufferSlotCount;
+                setBuffer(writer, display, layer, slot,
+                          mBuffers[layer * kBufferSlotCount + slot].get());
+                writer.setLayerSurfaceDamage(display, layer, damage);
+                if (layer % 4 == frame % 4) {
+                    const int32_t offset = static_cast<int32_t>(frame % 16);
+                    writer.setLayerDisplayFrame(display, layer,
+                                                Rect{offset, offset, offset + 512, offset + 512});
+                    writer.setLayerPlaneAlpha(display, layer, 1.0f);
+                }
+            }
+            writer.presentOrvalidateDisplay(display, ClockMonotonicTimestamp{0},
+                                            /*frameIntervalNs=*/16'666'666);
+        }
+    }
+
+    // Writes the results of a frame that the composer had to validate, with one layer in eight
+    // falling back to client composition.
+    void writeResults(ComposerServiceWriter& writer) const {
+        std::vector<int64_t> changedLayers;
+        std::vector<Composition> changedTypes;
+        for (int64_t layer = 0; layer < mNumLayers; layer += 8) {
+            changedLayers.push_back(layer);
+            changedTypes.push_back(Composition::CLIENT);
+        }
+        for (int64_t display = kFirstDisplay; display < kFirstDisplay + mNumDisplays; display++) {
+            writer.setChangedCompositionTypes(display, changedLayers, changedTypes);
+            writer.setDisplayRequests(display, /*displayRequestMask=*/0, {}, {});
+            writer.setPresentOrValidateResult(display, PresentOrValidate::Result::Validated);
+        }
+    }
+
+  private:
+    const int64_t mNumDisplays;
+    const int64_t mNumLayers;
+    std::vector<UniqueNativeHandle> mBuffers;
+};
+
+template <typename T>
+void roundTripThroughParcel(const std::vector<T>& values, std::vector<T>* outValues) {
+    ndk::ScopedAParcel parcel(AParcel_create());
+    ndk::AParcel_writeVector(parcel.get(), values);
+    AParcel_setDataPosition(parcel.get(), 0);
+    ndk::AParcel_readVector(parcel.get(), outValues);
+}
+
+void setAllocationsCounter(benchmark::State& state, uint64_t allocationsBefore) {
+    state.counters["allocs/frame"] = benchmark::Counter(
+            static_cast<double>(gAllocations.load(std::memory_order_relaxed) - allocationsBefore),
+            benchmark::Counter::kAvgIterations);
+}
+
+void setLayerBuffer(ComposerClientWriter& writer, int64_t display, int64_t layer, uint32_t slot,
+                    const native_handle_t* buffer) {
+    writer.setLayerBuffer(display, layer, slot, buffer, /*acquireFence=*/-1);
+}
+
+void setLayerBufferIfNotCached(ComposerClientWriter& writer, int64_t display, int64_t layer,
+                               uint32_t slot, const native_handle_t* buffer) {
+    writer.setLayerBufferIfNotCached(display, layer, slot, buffer, /*acquireFence=*/-1);
+}
+
+// Building and taking the commands of a frame, discarding them afterwards
+void BM_WriteCommands(benchmark::State& state) {
+    const Scene scene(state.range(0), state.range(1));
+    ComposerClientWriter writer(kFirstDisplay);
+    uint32_t frame = 0;
+    const uint64_t allocationsBefore = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        scene.writeFrame(writer, frame++, setLayerBuffer);
+        auto commands = writer.takePendingCommands();
+        benchmark::DoNotOptimize(commands.data());
+    }
+    setAllocationsCounter(state, allocationsBefore);
+}
+
+// Same as BM_WriteCommands, with the command storage recycled and the buffer handles only sent
+// the first time each slot is used
+void BM_WriteCommandsRecycled(benchmark::State& state) {
+    const Scene scene(state.range(0), state.range(1));
+    ComposerClientWriter writer(kFirstDisplay);
+    uint32_t frame = 0;
+    const uint64_t allocationsBefore = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        scene.writeFrame(writer, frame++, setLayerBufferIfNotCached);
+        auto commands = writer.takePendingCommands();
+        benchmark::DoNotOptimize(commands.data());
+        writer.recycleCommands(std::move(commands));
+    }
+    setAllocationsCounter(state, allocationsBefore);
+}
+
+// Marshalling and unmarshalling the commands of a frame, as executeCommands does over binder
+void BM_ParcelCommands(benchmark::State& state) {
+    const Scene scene(state.range(0), state.range(1));
+    ComposerClientWriter writer(kFirstDisplay);
+    scene.writeFrame(writer, /*frame=*/0, setLayerBuffer);
+    const auto commands = writer.takePendingCommands();
+    const uint64_t allocationsBefore = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        std::vector<DisplayCommand> received;
+        roundTripThroughParcel(commands, &received);
+        benchmark::DoNotOptimize(received.data());
+    }
+    setAllocationsCounter(state, allocationsBefore);
+}
+
+// Building the results of a frame on the composer side, marshalling them, and parsing them on the
+// client side
+void BM_ResultsRoundTrip(benchmark::State& state) {
+    const Scene scene(state.range(0), state.range(1));
+    ComposerServiceWriter serviceWriter;
+    ComposerClientReader reader;
+    const uint64_t allocationsBefore = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        scene.writeResults(serviceWriter);
+        std::vector<CommandResultPayload> received;
+        roundTripThroughParcel(serviceWriter.getPendingCommandResults(), &received);
+        reader.parse(std::move(received));
+        for (int64_t display = kFirstDisplay; display < kFirstDisplay + scene.numDisplays();
+             display++) {
+            benchmark::DoNotOptimize(reader.getChangedCompositionTypes(display).size());
+            benchmark::DoNotOptimize(reader.takePresentOrValidateStage(display));
+        }
+    }
+    setAllocationsCounter(state, allocationsBefore);
+}
+
+// Displays x layers per display, from a single phone display to a multi-display device with busy
+// scenes
+void sceneSizes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"displays", "layers"});
+    for (int64_t displays : {1, 2, 4}) {
+        for (int64_t layers : {4, 16, 64}) {
+            benchmark->Args({displays, layers});
+        }
+    }
+}
+
+BENCHMARK(BM_WriteCommands)->Apply(sceneSizes);
+BENCHMARK(BM_WriteCommandsRecycled)->Apply(sceneSizes);
+BENCHMARK(BM_ParcelCommands)->Apply(sceneSizes);
+BENCHMARK(BM_ResultsRoundTrip)->Apply(sceneSizes);
+
+}  // namespace
+}  // namespace aidl::android::hardware::graphics::composer3
+
+BENCHMARK_MAIN();
@@ -20,7 +20,8 @@
 #include <limits>
 #include <memory>
 #include <optional>
-#include <unordered_map>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include <inttypes.h>
@@ -93,14 +94,14 @@ class ComposerClientReader {
     void hasChanges(int64_t display, uint32_t* outNumChangedCompositionTypes,
                     uint32_t* outNumLayerRequestMasks) const {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        const ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             *outNumChangedCompositionTypes = 0;
             *outNumLayerRequestMasks = 0;
             return;
         }
 
-        const ReturnData& data = found->second;
+        const ReturnData& data = *found;
 
         *outNumChangedCompositionTypes = static_cast<uint32_t>(data.changedLayers.size());
         *outNumLayerRequestMasks = static_cast<uint32_t>(data.displayRequests.layerRequests.size());
@@ -109,121 +110,175 @@ class ComposerClientReader {
     // Get and clear saved changed composition types.
     std::vector<ChangedCompositionLayer> takeChangedCompositionTypes(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             return {};
         }
 
-        ReturnData& data = found->second;
+        ReturnData& data = *found;
         return std::move(data.changedLayers);
     }
 
     // Get and clear saved display requests.
     DisplayRequest takeDisplayRequests(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             return {};
         }
 
-        ReturnData& data = found->second;
+        ReturnData& data = *found;
         return std::move(data.displayRequests);
     }
 
     // Get and clear saved release fences.
     std::vector<ReleaseFences::Layer> takeReleaseFences(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             return {};
         }
 
-        ReturnData& data = found->second;
+        ReturnData& data = *found;
         return std::move(data.releasedLayers);
     }
 
     // Get and clear saved present fence.
     ndk::ScopedFileDescriptor takePresentFence(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             return {};
         }
 
-        ReturnData& data = found->second;
+        ReturnData& data = *found;
         return std::move(data.presentFence);
     }
 
     // Get what stage succeeded during PresentOrValidate: Present or Validate
     std::optional<PresentOrValidate::Result> takePresentOrValidateStage(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
-        if (found == mReturnData.end()) {
+        const ReturnData* found = findReturnData(display);
+        if (found == nullptr) {
             return std::nullopt;
         }
-        ReturnData& data = found->second;
+        const ReturnData& data = *found;
         return data.presentOrValidateState;
     }
 
     // Get the client target properties requested by hardware composer.
     ClientTargetPropertyWithBrightness takeClientTargetProperty(int64_t display) {
         LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
-        auto found = mReturnData.find(display);
+        ReturnData* found = findReturnData(display);
 
         // If not found, return the default values.
-        if (found == mReturnData.end()) {
+        if (found == nullptr) {
             return ClientTargetPropertyWithBrightness{
                     .clientTargetProperty = {common::PixelFormat::RGBA_8888, Dataspace::UNKNOWN},
                     .brightness = 1.f,
             };
         }
 
-        ReturnData& data = found->second;
+        ReturnData& data = *found;
         return std::move(data.clientTargetProperty);
     }
 
+    // Views of the saved results of a display. Unlike the take* methods, these do not move the
+    // results out, and stay valid until the next call to parse.
+    std::span<const ChangedCompositionLayer> getChangedCompositionTypes(int64_t display) const {
+        LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
+        const ReturnData* found = findReturnData(display);
+        return found == nullptr ? std::span<const ChangedCompositionLayer>()
+                                : std::span(found->changedLayers);
+    }
+
+    std::span<const DisplayRequest::LayerRequest> getLayerRequests(int64_t display) const {
+        LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
+        const ReturnData* found = findReturnData(display);
+        return found == nullptr ? std::span<const DisplayRequest::LayerRequest>()
+                                : std::span(found->displayRequests.layerRequests);
+    }
+
+    std::span<const ReleaseFences::Layer> getReleaseFences(int64_t display) const {
+        LOG_ALWAYS_FATAL_IF(mDisplay && display != *mDisplay);
+        const ReturnData* found = findReturnData(display);
+        return found == nullptr ? std::span<const ReleaseFences::Layer>()
+                                : std::span(found->releasedLayers);
+    }
+
   private:
+    // The results of each display are kept in a slot of mReturnData. Slots are reset rather than
+    // freed between frames, and a reader usually serves a single display, so looking up and
+    // resetting the results of a frame neither allocates nor hashes.
     void resetData() {
         mErrors.clear();
-        mReturnData.clear();
+        for (size_t i = 0; i < mNumReturnData; ++i) {
+            mReturnData[i].second = ReturnData();
+        }
+        mNumReturnData = 0;
+    }
+
+    const ReturnData* findReturnData(int64_t display) const {
+        for (size_t i = 0; i < mNumReturnData; ++i) {
+            if (mReturnData[i].first == display) {
+                return &mReturnData[i].second;
+            }
+        }
+        return nullptr;
+    }
+
+    ReturnData* findReturnData(int64_t display) {
+        return const_cast<ReturnData*>(std::as_const(*this).findReturnData(display));
+    }
+
+    ReturnData& getOrCreateReturnData(int64_t display) {
+        if (ReturnData* found = findReturnData(display)) {
+            return *found;
+        }
+        if (mNumReturnData == mReturnData.size()) {
+            mReturnData.emplace_back();
+        }
+        auto& [slotDisplay, data] = mReturnData[mNumReturnData++];
+        slotDisplay = display;
+        return data;
     }
 
     void parseSetError(CommandError&& error) { mErrors.emplace_back(error); }
 
     void parseSetChangedCompositionTypes(ChangedCompositionTypes&& changedCompositionTypes) {
         LOG_ALWAYS_FATAL_IF(mDisplay && changedCompositionTypes.display != *mDisplay);
-        auto& data = mReturnData[changedCompositionTypes.display];
+        auto& data = getOrCreateReturnData(changedCompositionTypes.display);
         data.changedLayers = std::move(changedCompositionTypes.layers);
     }
 
     void parseSetDisplayRequests(DisplayRequest&& displayRequest) {
         LOG_ALWAYS_FATAL_IF(mDisplay && displayRequest.display != *mDisplay);
-        auto& data = mReturnData[displayRequest.display];
+        auto& data = getOrCreateReturnData(displayRequest.display);
         data.displayRequests = std::move(displayRequest);
     }
 
     void parseSetPresentFence(PresentFence&& presentFence) {
         LOG_ALWAYS_FATAL_IF(mDisplay && presentFence.display != *mDisplay);
-        auto& data = mReturnData[presentFence.display];
+        auto& data = getOrCreateReturnData(presentFence.display);
         data.presentFence = std::move(presentFence.fence);
     }
 
     void parseSetReleaseFences(ReleaseFences&& releaseFences) {
         LOG_ALWAYS_FATAL_IF(mDisplay && releaseFences.display != *mDisplay);
-        auto& data = mReturnData[releaseFences.display];
+        auto& data = getOrCreateReturnData(releaseFences.display);
         data.releasedLayers = std::move(releaseFences.layers);
     }
 
     void parseSetPresentOrValidateDisplayResult(const PresentOrValidate&& presentOrValidate) {
         LOG_ALWAYS_FATAL_IF(mDisplay && presentOrValidate.display != *mDisplay);
-        auto& data = mReturnData[presentOrValidate.display];
+        auto& data = getOrCreateReturnData(presentOrValidate.display);
         data.presentOrValidateState = std::move(presentOrValidate.result);
     }
 
     void parseSetClientTargetProperty(
             const ClientTargetPropertyWithBrightness&& clientTargetProperty) {
         LOG_ALWAYS_FATAL_IF(mDisplay && clientTargetProperty.display != *mDisplay);
-        auto& data = mReturnData[clientTargetProperty.display];
+        auto& data = getOrCreateReturnData(clientTargetProperty.display);
         data.clientTargetProperty = std::move(clientTargetProperty);
     }
 
@@ -241,7 +296,8 @@ class ComposerClientReader {
     };
 
     std::vector<CommandError> mErrors;
-    std::unordered_map<int64_t, ReturnData> mReturnData;
+    std::vector<std::pair<int64_t, ReturnData>> mReturnData;
+    size_t mNumReturnData = 0;
     const std::optional<int64_t> mDisplay;
 };
 
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <inttypes.h>
@@ -72,8 +73,7 @@ class ComposerClientWriter final {
     ComposerClientWriter& operator=(const ComposerClientWriter&) = delete;
 
     void setColorTransform(int64_t display, const float* matrix) {
-        std::vector<float> matVec;
-        matVec.reserve(16);
+        std::vector<float> matVec = takeSpare(mSpareFloatVectors);
         matVec.assign(matrix, matrix + 16);
         getDisplayCommand(display).colorTransformMatrix.emplace(std::move(matVec));
     }
@@ -89,6 +89,7 @@ class ComposerClientWriter final {
         ClientTarget clientTargetCommand;
         clientTargetCommand.buffer = getBufferCommand(slot, target, acquireFence);
         clientTargetCommand.dataspace = dataspace;
+        clientTargetCommand.damage = takeSpare(mSpareRectVectors);
         clientTargetCommand.damage.assign(damage.begin(), damage.end());
         clientTargetCommand.hdrSdrRatio = hdrSdrRatio;
         getDisplayCommand(display).clientTarget.emplace(std::move(clientTargetCommand));
@@ -102,10 +103,19 @@ class ComposerClientWriter final {
 
     void setLayerLifecycleBatchCommandType(int64_t display, int64_t layer,
                                            LayerLifecycleBatchCommandType cmd) {
+        if (cmd != LayerLifecycleBatchCommandType::MODIFY) {
+            mSentLayerBuffers.erase(layer);
+        }
         getLayerCommand(display, layer).layerLifecycleBatchCommandType = cmd;
     }
 
     void setNewBufferSlotCount(int64_t display, int64_t layer, int32_t newBufferSlotToCount) {
+        if (const auto it = mSentLayerBuffers.find(layer); it != mSentLayerBuffers.end()) {
+            const auto count = static_cast<size_t>(std::max(newBufferSlotToCount, 0));
+            if (it->second.size() > count) {
+                it->second.resize(count);
+            }
+        }
         getLayerCommand(display, layer).newBufferSlotCount = newBufferSlotToCount;
     }
 
@@ -145,6 +155,25 @@ class ComposerClientWriter final {
         getLayerCommand(display, layer).buffer = getBufferCommand(slot, buffer, acquireFence);
     }
 
+    // Like setLayerBuffer, but sends the handle only if it is not the one this writer last sent
+    // for the slot of the layer. The composer keeps the buffer of each slot, so a slot that already
+    // holds |buffer| is updated with its slot number alone, without duplicating the handle. A
+    // handle must not be reused for a different buffer in the same slot unless the slot has been
+    // cleared with setLayerBufferSlotsToClear in between.
+    void setLayerBufferIfNotCached(int64_t display, int64_t layer, uint32_t slot,
+                                   const native_handle_t* buffer, int acquireFence) {
+        auto& sentBuffers = mSentLayerBuffers[layer];
+        if (buffer != nullptr && slot < sentBuffers.size() && sentBuffers[slot] == buffer) {
+            buffer = nullptr;
+        } else if (buffer != nullptr) {
+            if (slot >= sentBuffers.size()) {
+                sentBuffers.resize(slot + 1, nullptr);
+            }
+            sentBuffers[slot] = buffer;
+        }
+        setLayerBuffer(display, layer, slot, buffer, acquireFence);
+    }
+
     void setLayerBufferWithNewCommand(int64_t display, int64_t layer, uint32_t slot,
                                       const native_handle_t* buffer, int acquireFence) {
         flushLayerCommand();
@@ -154,12 +183,19 @@ class ComposerClientWriter final {
 
     void setLayerBufferSlotsToClear(int64_t display, int64_t layer,
                                     const std::vector<uint32_t>& slotsToClear) {
+        if (const auto it = mSentLayerBuffers.find(layer); it != mSentLayerBuffers.end()) {
+            for (const uint32_t slot : slotsToClear) {
+                if (slot < it->second.size()) {
+                    it->second[slot] = nullptr;
+                }
+            }
+        }
         getLayerCommand(display, layer)
                 .bufferSlotsToClear.emplace(slotsToClear.begin(), slotsToClear.end());
     }
 
     void setLayerSurfaceDamage(int64_t display, int64_t layer, const std::vector<Rect>& damage) {
-        getLayerCommand(display, layer).damage.emplace(damage.begin(), damage.end());
+        getLayerCommand(display, layer).damage.emplace(copyRects(damage));
     }
 
     void setLayerBlendMode(int64_t display, int64_t layer, BlendMode mode) {
@@ -211,7 +247,7 @@ class ComposerClientWriter final {
     }
 
     void setLayerVisibleRegion(int64_t display, int64_t layer, const std::vector<Rect>& visible) {
-        getLayerCommand(display, layer).visibleRegion.emplace(visible.begin(), visible.end());
+        getLayerCommand(display, layer).visibleRegion.emplace(copyRects(visible));
     }
 
     void setLayerZOrder(int64_t display, int64_t layer, uint32_t z) {
@@ -227,7 +263,9 @@ class ComposerClientWriter final {
     }
 
     void setLayerColorTransform(int64_t display, int64_t layer, const float* matrix) {
-        getLayerCommand(display, layer).colorTransform.emplace(matrix, matrix + 16);
+        std::vector<float> matVec = takeSpare(mSpareFloatVectors);
+        matVec.assign(matrix, matrix + 16);
+        getLayerCommand(display, layer).colorTransform.emplace(std::move(matVec));
     }
 
     void setLayerPerFrameMetadataBlobs(int64_t display, int64_t layer,
@@ -242,7 +280,7 @@ class ComposerClientWriter final {
     }
 
     void setLayerBlockingRegion(int64_t display, int64_t layer, const std::vector<Rect>& blocking) {
-        getLayerCommand(display, layer).blockingRegion.emplace(blocking.begin(), blocking.end());
+        getLayerCommand(display, layer).blockingRegion.emplace(copyRects(blocking));
     }
 
     std::vector<DisplayCommand> takePendingCommands() {
@@ -253,12 +291,78 @@ class ComposerClientWriter final {
         return moved;
     }
 
+    // Hands back commands returned by takePendingCommands once they have been sent, so that the
+    // storage of their command, layer, region and matrix vectors is reused by the following
+    // frames. A caller that recycles every frame submits frames without allocating once the
+    // writer has seen its largest frame.
+    void recycleCommands(std::vector<DisplayCommand>&& commands) {
+        for (auto& command : commands) {
+            recycleOptional(command.colorTransformMatrix, mSpareFloatVectors);
+            if (command.clientTarget.has_value()) {
+                putSpare(std::move(command.clientTarget->damage), mSpareRectVectors);
+            }
+            for (auto& layerCommand : command.layers) {
+                recycleOptional(layerCommand.damage, mSpareRectVectors);
+                recycleOptional(layerCommand.visibleRegion, mSpareRectVectors);
+                recycleOptional(layerCommand.blockingRegion, mSpareRectVectors);
+                recycleOptional(layerCommand.colorTransform, mSpareFloatVectors);
+            }
+            putSpare(std::move(command.layers), mSpareLayerVectors);
+        }
+        if (mCommands.empty() && mCommands.capacity() < commands.capacity()) {
+            commands.clear();
+            mCommands = std::move(commands);
+        }
+    }
+
   private:
     std::optional<DisplayCommand> mDisplayCommand;
     std::optional<LayerCommand> mLayerCommand;
     std::vector<DisplayCommand> mCommands;
     const int64_t mDisplay;
 
+    // Cleared vectors whose capacity is kept for reuse, filled by recycleCommands.
+    std::vector<std::vector<LayerCommand>> mSpareLayerVectors;
+    std::vector<std::vector<Rect>> mSpareRectVectors;
+    std::vector<std::vector<float>> mSpareFloatVectors;
+
+    // Handle last sent for each buffer slot of each layer, by setLayerBufferIfNotCached.
+    std::unordered_map<int64_t, std::vector<const native_handle_t*>> mSentLayerBuffers;
+
+    template <typename T>
+    static std::vector<T> takeSpare(std::vector<std::vector<T>>& spares) {
+        if (spares.empty()) {
+            return {};
+        }
+        std::vector<T> spare = std::move(spares.back());
+        spares.pop_back();
+        return spare;
+    }
+
+    template <typename T>
+    static void putSpare(std::vector<T>&& vec, std::vector<std::vector<T>>& spares) {
+        if (vec.capacity() == 0) {
+            return;
+        }
+        vec.clear();
+        spares.emplace_back(std::move(vec));
+    }
+
+    template <typename T>
+    static void recycleOptional(std::optional<std::vector<T>>& vec,
+                                std::vector<std::vector<T>>& spares) {
+        if (vec.has_value()) {
+            putSpare(std::move(*vec), spares);
+            vec.reset();
+        }
+    }
+
+    std::vector<Rect> copyRects(const std::vector<Rect>& rects) {
+        std::vector<Rect> copy = takeSpare(mSpareRectVectors);
+        copy.assign(rects.begin(), rects.end());
+        return copy;
+    }
+
     Buffer getBufferCommand(uint32_t slot, const native_handle_t* bufferHandle, int fence) {
         Buffer bufferCommand;
         bufferCommand.slot = static_cast<int32_t>(slot);
@@ -288,6 +392,7 @@ class ComposerClientWriter final {
             flushDisplayCommand();
             mDisplayCommand.emplace();
             mDisplayCommand->display = display;
+            mDisplayCommand->layers = takeSpare(mSpareLayerVectors);
         }
         return *mDisplayCommand;
     }
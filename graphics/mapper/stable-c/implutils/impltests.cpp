@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include <android/hardware/graphics/mapper/utils/IMapperMetadataCache.h>
 #include <android/hardware/graphics/mapper/utils/IMapperMetadataTypes.h>
 #include <android/hardware/graphics/mapper/utils/IMapperProvider.h>
 #include <drm/drm_fourcc.h>
@@ -223,6 +224,23 @@ TEST(Metadata, setGetRects) {
     EXPECT_EQ(cropRects, *read);
 }
 
+TEST(Metadata, getRectsWithBadCount) {
+    using RectsValue = StandardMetadata<StandardMetadataType::CROP>::value;
+    std::vector<uint8_t> buffer(10000, 0);
+    std::vector<Rect> cropRects{2};
+
+    constexpr int expectedSize = sizeof(int64_t) + (8 * sizeof(int32_t)) + HeaderSize;
+    ASSERT_EQ(expectedSize, RectsValue::encode(cropRects, buffer.data(), buffer.size()));
+    EXPECT_FALSE(RectsValue::decode(buffer.data(), expectedSize - 1).has_value());
+
+    // A count that can't fit in the metadata must not be trusted
+    int64_t* count = reinterpret_cast<int64_t*>(SkipHeader(buffer).data());
+    *count = std::numeric_limits<int64_t>::max();
+    EXPECT_FALSE(RectsValue::decode(buffer.data(), buffer.size()).has_value());
+    *count = -1;
+    EXPECT_FALSE(RectsValue::decode(buffer.data(), buffer.size()).has_value());
+}
+
 TEST(Metadata, setGetSmpte2086) {
     using Smpte2086Value = StandardMetadata<StandardMetadataType::SMPTE2086>::value;
     Smpte2086 source;
@@ -343,6 +361,53 @@ TEST(MetadataProvider, outOfBounds) {
             << "100 (out of range) should have resulted in UNSUPPORTED";
 }
 
+TEST(MetadataCache, immutableMetadataIsEncodedOnce) {
+    using Width = StandardMetadata<StandardMetadataType::WIDTH>::value;
+    StandardMetadataCache cache;
+    const auto buffer = reinterpret_cast<buffer_handle_t>(0x1000);
+    const auto type = static_cast<int64_t>(StandardMetadataType::WIDTH);
+    int encodeCount = 0;
+    auto encodeWidth = [&](void* dest, size_t destSize) {
+        encodeCount++;
+        return Width::encode(100, dest, destSize);
+    };
+
+    // Querying the size also fills the cache
+    EXPECT_EQ(8 + HeaderSize, cache.getStandardMetadata(buffer, 0, type, nullptr, 0, encodeWidth));
+    std::vector<uint8_t> data(8 + HeaderSize, 0);
+    EXPECT_EQ(8 + HeaderSize, cache.getStandardMetadata(buffer, 1, type, data.data(), data.size(),
+                                                        encodeWidth));
+    EXPECT_EQ(2, encodeCount);
+    EXPECT_EQ(100, Width::decode(data.data(), data.size()).value_or(0));
+
+    cache.erase(buffer);
+    EXPECT_EQ(8 + HeaderSize, cache.getStandardMetadata(buffer, 1, type, data.data(), data.size(),
+                                                        encodeWidth));
+    EXPECT_EQ(3, encodeCount);
+}
+
+TEST(MetadataCache, mutableMetadataFollowsGeneration) {
+    using DataspaceValue = StandardMetadata<StandardMetadataType::DATASPACE>::value;
+    StandardMetadataCache cache;
+    const auto buffer = reinterpret_cast<buffer_handle_t>(0x1000);
+    const auto type = static_cast<int64_t>(StandardMetadataType::DATASPACE);
+    Dataspace dataspace = Dataspace::SRGB;
+    auto encodeDataspace = [&](void* dest, size_t destSize) {
+        return DataspaceValue::encode(dataspace, dest, destSize);
+    };
+
+    std::vector<uint8_t> data(10000, 0);
+    cache.getStandardMetadata(buffer, 0, type, data.data(), data.size(), encodeDataspace);
+    EXPECT_EQ(Dataspace::SRGB, DataspaceValue::decode(data.data(), data.size()));
+
+    // A stale generation is not served from the cache
+    dataspace = Dataspace::DISPLAY_P3;
+    cache.getStandardMetadata(buffer, 0, type, data.data(), data.size(), encodeDataspace);
+    EXPECT_EQ(Dataspace::SRGB, DataspaceValue::decode(data.data(), data.size()));
+    cache.getStandardMetadata(buffer, 1, type, data.data(), data.size(), encodeDataspace);
+    EXPECT_EQ(Dataspace::DISPLAY_P3, DataspaceValue::decode(data.data(), data.size()));
+}
+
 template <StandardMetadataType T>
 std::vector<uint8_t> encode(const typename StandardMetadata<T>::value_type& value) {
     using Value = typename StandardMetadata<T>::value;
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/hardware/graphics/mapper/utils/IMapperMetadataTypes.h>
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace android::hardware::graphics::mapper {
+
+/**
+ * Opt-in cache of encoded standard metadata, for IMapper implementations whose
+ * getStandardMetadata re-encodes the same values on every call.
+ *
+ * The first query of a metadata type for a buffer encodes it and keeps the encoded blob. Later
+ * queries are served by copying the blob. Metadata that can't change for the lifetime of a buffer
+ * is cached unconditionally. Metadata that can be changed by setStandardMetadata is tagged with the
+ * generation passed by the implementation, which must change whenever any metadata of the buffer
+ * is set, and is re-encoded when the generation doesn't match.
+ *
+ * The implementation must call erase() when the buffer is freed, as buffer handles may be reused.
+ *
+ * Example:
+ *
+ *     int32_t getStandardMetadata(buffer_handle_t buffer, int64_t type, void* destBuffer,
+ *                                 size_t destBufferSize) override {
+ *         auto* handle = MyHandle::from(buffer);
+ *         return mMetadataCache.getStandardMetadata(
+ *                 buffer, handle->metadataGeneration(), type, destBuffer, destBufferSize,
+ *                 [&](void* dest, size_t destSize) {
+ *                     return encodeStandardMetadata(handle, type, dest, destSize);
+ *                 });
+ *     }
+ */
+class StandardMetadataCache {
+  public:
+    // Returns true if `type` can't change for the lifetime of a buffer
+    static constexpr bool isImmutable(StandardMetadataType type) {
+        switch (type) {
+            case StandardMetadataType::BUFFER_ID:
+            case StandardMetadataType::NAME:
+            case StandardMetadataType::WIDTH:
+            case StandardMetadataType::HEIGHT:
+            case StandardMetadataType::LAYER_COUNT:
+            case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+            case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+            case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+            case StandardMetadataType::USAGE:
+            case StandardMetadataType::ALLOCATION_SIZE:
+            case StandardMetadataType::PLANE_LAYOUTS:
+            case StandardMetadataType::STRIDE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Copies the metadata of `standardMetadataType` for `buffer` into `destBuffer`, encoding it
+     * with `encode(void* destBuffer, size_t destBufferSize) -> int32_t` if it isn't cached. The
+     * return value follows the contract of AIMapper_v5::getStandardMetadata, and errors returned
+     * by `encode` aren't cached.
+     */
+    template <typename F>
+    int32_t getStandardMetadata(buffer_handle_t _Nonnull buffer, uint64_t generation,
+                                int64_t standardMetadataType, void* _Nullable destBuffer,
+                                size_t destBufferSize, F&& encode) {
+        if (standardMetadataType <= 0 ||
+            static_cast<uint64_t>(standardMetadataType) >= kNumStandardMetadataTypes) {
+            return encode(destBuffer, destBufferSize);
+        }
+        const auto type = static_cast<StandardMetadataType>(standardMetadataType);
+
+        {
+            std::lock_guard lock(mMutex);
+            auto iter = mBuffers.find(buffer);
+            if (iter != mBuffers.end()) {
+                const Blob& blob = iter->second[static_cast<size_t>(standardMetadataType)];
+                if (blob.valid && (isImmutable(type) || blob.generation == generation)) {
+                    return copyOut(blob.data, destBuffer, destBufferSize);
+                }
+            }
+        }
+
+        int32_t size = encode(destBuffer, destBufferSize);
+        if (size <= 0) {
+            return size;
+        }
+        std::vector<uint8_t> data;
+        if (static_cast<size_t>(size) <= destBufferSize) {
+            const auto* src = reinterpret_cast<const uint8_t*>(destBuffer);
+            data.assign(src, src + size);
+        } else {
+            // The caller is querying the size. Encode into our own storage so that the next call,
+            // which usually comes with a buffer of that size, is a hit.
+            data.resize(size);
+            if (encode(data.data(), data.size()) != size) {
+                return size;
+            }
+        }
+
+        std::lock_guard lock(mMutex);
+        Blob& blob = mBuffers[buffer][static_cast<size_t>(standardMetadataType)];
+        blob.data = std::move(data);
+        blob.generation = generation;
+        blob.valid = true;
+        return size;
+    }
+
+    // Drops all the metadata cached for `buffer`. Must be called when the buffer is freed.
+    void erase(buffer_handle_t _Nonnull buffer) {
+        std::lock_guard lock(mMutex);
+        mBuffers.erase(buffer);
+    }
+
+  private:
+    static constexpr size_t kNumStandardMetadataTypes =
+            ndk::internal::enum_values<StandardMetadataType>.size();
+
+    struct Blob {
+        std::vector<uint8_t> data;
+        uint64_t generation = 0;
+        bool valid = false;
+    };
+
+    static int32_t copyOut(const std::vector<uint8_t>& data, void* _Nullable destBuffer,
+                           size_t destBufferSize) {
+        if (data.size() <= destBufferSize) {
+            memcpy(destBuffer, data.data(), data.size());
+        }
+        return static_cast<int32_t>(data.size());
+    }
+
+    std::mutex mMutex;
+    std::unordered_map<buffer_handle_t, std::array<Blob, kNumStandardMetadataTypes>> mBuffers;
+};
+
+}  // namespace android::hardware::graphics::mapper
@@ -30,7 +30,9 @@
 #include <aidl/android/hardware/graphics/common/XyColor.h>
 #include <android/hardware/graphics/mapper/IMapper.h>
 
+#include <array>
 #include <cinttypes>
+#include <cstring>
 #include <string_view>
 #include <type_traits>
 #include <vector>
@@ -50,7 +52,52 @@ using ::aidl::android::hardware::graphics::common::Smpte2086;
 using ::aidl::android::hardware::graphics::common::StandardMetadataType;
 using ::aidl::android::hardware::graphics::common::XyColor;
 
+// Size of the encoding of HEADER, which is known at compile time for every metadata type
+template <typename HEADER>
+inline constexpr size_t kMetadataHeaderSize =
+        sizeof(int64_t) + std::string_view(HEADER::name).length() + sizeof(int64_t);
+
 class MetadataWriter {
+  public:
+    // Writes into a range that has already been bounds-checked as a whole, see writeBlock()
+    class Block {
+      private:
+        uint8_t* _Nonnull mDest;
+
+      public:
+        explicit Block(uint8_t* _Nonnull dest) : mDest(dest) {}
+
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+        Block& put(T value) {
+            memcpy(mDest, &value, sizeof(T));
+            mDest += sizeof(T);
+            return *this;
+        }
+
+        Block& put(float value) {
+            memcpy(mDest, &value, sizeof(float));
+            mDest += sizeof(float);
+            return *this;
+        }
+
+        Block& put(const std::string_view& value) {
+            put<int64_t>(value.length());
+            return putBytes(value.data(), value.length());
+        }
+
+        Block& put(const ExtendableType& value) { return put(value.name).put(value.value); }
+
+        Block& put(const XyColor& value) { return put(value.x).put(value.y); }
+
+        Block& putBytes(const void* _Nullable src, size_t size) {
+            if (size > 0) {
+                memcpy(mDest, src, size);
+                mDest += size;
+            }
+            return *this;
+        }
+    };
+
   private:
     uint8_t* _Nonnull mDest;
     size_t mSizeRemaining = 0;
@@ -86,7 +133,20 @@ class MetadataWriter {
 
     template <typename HEADER>
     MetadataWriter& writeHeader() {
-        return write(HEADER::name).template write<int64_t>(HEADER::value);
+        return writeBlock(kMetadataHeaderSize<HEADER>, [](Block block) {
+            block.put(std::string_view(HEADER::name)).template put<int64_t>(HEADER::value);
+        });
+    }
+
+    // Reserves `size` bytes with a single bounds check and passes them to `fill`, which must write
+    // exactly `size` bytes. If they don't fit, `fill` isn't called but the size is still accounted
+    // for in desiredSize().
+    template <typename F>
+    MetadataWriter& writeBlock(size_t size, F&& fill) {
+        if (void* dest = reserve(size)) {
+            fill(Block{reinterpret_cast<uint8_t*>(dest)});
+        }
+        return *this;
     }
 
     template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
@@ -132,6 +192,39 @@ class MetadataWriter {
 };
 
 class MetadataReader {
+  public:
+    // Reads from a range that has already been bounds-checked as a whole, see readBlock()
+    class Block {
+      private:
+        const uint8_t* _Nonnull mSrc;
+
+      public:
+        explicit Block(const uint8_t* _Nonnull src) : mSrc(src) {}
+
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+        Block& get(T& dest) {
+            memcpy(&dest, mSrc, sizeof(T));
+            mSrc += sizeof(T);
+            return *this;
+        }
+
+        Block& get(float& dest) {
+            memcpy(&dest, mSrc, sizeof(float));
+            mSrc += sizeof(float);
+            return *this;
+        }
+
+        Block& get(XyColor& dest) { return get(dest.x).get(dest.y); }
+
+        Block& getBytes(void* _Nullable dest, size_t size) {
+            if (size > 0) {
+                memcpy(dest, mSrc, size);
+                mSrc += size;
+            }
+            return *this;
+        }
+    };
+
   private:
     const uint8_t* _Nonnull mSrc;
     size_t mSizeRemaining = 0;
@@ -157,14 +250,40 @@ class MetadataReader {
 
     template <typename HEADER>
     MetadataReader& checkHeader() {
-        if (HEADER::name != readString()) {
-            mOk = false;
+        return readBlock(kMetadataHeaderSize<HEADER>, [this](Block block) {
+            constexpr std::string_view name{HEADER::name};
+            int64_t length = 0;
+            int64_t value = 0;
+            std::array<char, name.length()> readName;
+            block.get(length).getBytes(readName.data(), readName.size()).get(value);
+            if (length != static_cast<int64_t>(name.length()) ||
+                std::string_view(readName.data(), readName.size()) != name ||
+                value != HEADER::value) {
+                mOk = false;
+            }
+        });
+    }
+
+    // Checks once that `size` bytes are available and passes them to `parse`, which must read
+    // exactly `size` bytes. `parse` isn't called if they aren't.
+    template <typename F>
+    MetadataReader& readBlock(size_t size, F&& parse) {
+        if (const void* src = advance(size)) {
+            parse(Block{reinterpret_cast<const uint8_t*>(src)});
         }
-        auto value = readInt<int64_t>();
-        if (!value || *value != HEADER::value) {
+        return *this;
+    }
+
+    // Reads the element count of an array whose elements take at least `minElementSize` bytes,
+    // failing if the remaining metadata cannot hold that many elements. This keeps a corrupt
+    // count from turning into a huge allocation.
+    [[nodiscard]] size_t readCount(size_t minElementSize) {
+        auto count = readInt<int64_t>();
+        if (!count || *count < 0 || static_cast<uint64_t>(*count) > mSizeRemaining / minElementSize) {
             mOk = false;
+            return 0;
         }
-        return *this;
+        return static_cast<size_t>(*count);
     }
 
     template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
@@ -325,27 +444,42 @@ struct MetadataValue<HEADER, ExtendableType> {
 
 template <typename HEADER>
 struct MetadataValue<HEADER, std::vector<PlaneLayout>> {
+    // The fixed-size fields of a component, after its type name, and of a plane, after its
+    // components
+    static constexpr size_t kComponentFieldsSize = 3 * sizeof(int64_t);
+    static constexpr size_t kPlaneFieldsSize = 8 * sizeof(int64_t);
+
     [[nodiscard]] static int32_t encode(const std::vector<PlaneLayout>& values,
                                         void* _Nullable destBuffer, size_t destBufferSize) {
-        MetadataWriter writer{destBuffer, destBufferSize};
-        writer.template writeHeader<HEADER>();
-        writer.write<int64_t>(values.size());
+        size_t size = sizeof(int64_t);
         for (const auto& value : values) {
-            writer.write<int64_t>(value.components.size());
+            size += sizeof(int64_t) + kPlaneFieldsSize;
             for (const auto& component : value.components) {
-                writer.write(component.type)
-                        .write<int64_t>(component.offsetInBits)
-                        .write<int64_t>(component.sizeInBits);
+                size += sizeof(int64_t) + component.type.name.length() + kComponentFieldsSize;
             }
-            writer.write<int64_t>(value.offsetInBytes)
-                    .write<int64_t>(value.sampleIncrementInBits)
-                    .write<int64_t>(value.strideInBytes)
-                    .write<int64_t>(value.widthInSamples)
-                    .write<int64_t>(value.heightInSamples)
-                    .write<int64_t>(value.totalSizeInBytes)
-                    .write<int64_t>(value.horizontalSubsampling)
-                    .write<int64_t>(value.verticalSubsampling);
         }
+
+        MetadataWriter writer{destBuffer, destBufferSize};
+        writer.template writeHeader<HEADER>();
+        writer.writeBlock(size, [&values](MetadataWriter::Block block) {
+            block.put<int64_t>(values.size());
+            for (const auto& value : values) {
+                block.put<int64_t>(value.components.size());
+                for (const auto& component : value.components) {
+                    block.put(component.type)
+                            .put<int64_t>(component.offsetInBits)
+                            .put<int64_t>(component.sizeInBits);
+                }
+                block.put<int64_t>(value.offsetInBytes)
+                        .put<int64_t>(value.sampleIncrementInBits)
+                        .put<int64_t>(value.strideInBytes)
+                        .put<int64_t>(value.widthInSamples)
+                        .put<int64_t>(value.heightInSamples)
+                        .put<int64_t>(value.totalSizeInBytes)
+                        .put<int64_t>(value.horizontalSubsampling)
+                        .put<int64_t>(value.verticalSubsampling);
+            }
+        });
         return writer.desiredSize();
     }
 
@@ -354,26 +488,31 @@ struct MetadataValue<HEADER, std::vector<PlaneLayout>> {
         std::vector<PlaneLayout> values;
         MetadataReader reader{metadata, metadataSize};
         reader.template checkHeader<HEADER>();
-        auto numPlanes = reader.readInt<int64_t>().value_or(0);
+        auto numPlanes = reader.readCount(sizeof(int64_t) + kPlaneFieldsSize);
         values.reserve(numPlanes);
-        for (int i = 0; i < numPlanes && reader.ok(); i++) {
+        for (size_t i = 0; i < numPlanes && reader.ok(); i++) {
             PlaneLayout& value = values.emplace_back();
-            auto numPlaneComponents = reader.readInt<int64_t>().value_or(0);
+            auto numPlaneComponents = reader.readCount(sizeof(int64_t) + kComponentFieldsSize);
             value.components.reserve(numPlaneComponents);
-            for (int j = 0; j < numPlaneComponents && reader.ok(); j++) {
+            for (size_t j = 0; j < numPlaneComponents && reader.ok(); j++) {
                 PlaneLayoutComponent& component = value.components.emplace_back();
-                reader.read(component.type)
-                        .read<int64_t>(component.offsetInBits)
-                        .read<int64_t>(component.sizeInBits);
+                component.type.name = reader.readString();
+                reader.readBlock(kComponentFieldsSize, [&component](MetadataReader::Block block) {
+                    block.get<int64_t>(component.type.value)
+                            .get<int64_t>(component.offsetInBits)
+                            .get<int64_t>(component.sizeInBits);
+                });
             }
-            reader.read<int64_t>(value.offsetInBytes)
-                    .read<int64_t>(value.sampleIncrementInBits)
-                    .read<int64_t>(value.strideInBytes)
-                    .read<int64_t>(value.widthInSamples)
-                    .read<int64_t>(value.heightInSamples)
-                    .read<int64_t>(value.totalSizeInBytes)
-                    .read<int64_t>(value.horizontalSubsampling)
-                    .read<int64_t>(value.verticalSubsampling);
+            reader.readBlock(kPlaneFieldsSize, [&value](MetadataReader::Block block) {
+                block.get<int64_t>(value.offsetInBytes)
+                        .get<int64_t>(value.sampleIncrementInBits)
+                        .get<int64_t>(value.strideInBytes)
+                        .get<int64_t>(value.widthInSamples)
+                        .get<int64_t>(value.heightInSamples)
+                        .get<int64_t>(value.totalSizeInBytes)
+                        .get<int64_t>(value.horizontalSubsampling)
+                        .get<int64_t>(value.verticalSubsampling);
+            });
         }
         return reader.ok() ? DecodeResult{std::move(values)} : std::nullopt;
     }
@@ -381,17 +520,32 @@ struct MetadataValue<HEADER, std::vector<PlaneLayout>> {
 
 template <typename HEADER>
 struct MetadataValue<HEADER, std::vector<Rect>> {
+    static constexpr size_t kRectSize = 4 * sizeof(int32_t);
+
+    // Rects are encoded as their four int32_t fields in declaration order, so arrays of them can be
+    // copied as a whole when Rect has no padding.
+    static constexpr bool kIsRectPacked = std::is_trivially_copyable_v<Rect> &&
+                                          std::is_standard_layout_v<Rect> &&
+                                          sizeof(Rect) == kRectSize;
+
     [[nodiscard]] static int32_t encode(const std::vector<Rect>& value, void* _Nullable destBuffer,
                                         size_t destBufferSize) {
         MetadataWriter writer{destBuffer, destBufferSize};
         writer.template writeHeader<HEADER>();
-        writer.write<int64_t>(value.size());
-        for (auto& rect : value) {
-            writer.write<int32_t>(rect.left)
-                    .write<int32_t>(rect.top)
-                    .write<int32_t>(rect.right)
-                    .write<int32_t>(rect.bottom);
-        }
+        writer.writeBlock(sizeof(int64_t) + value.size() * kRectSize,
+                          [&value](MetadataWriter::Block block) {
+                              block.put<int64_t>(value.size());
+                              if constexpr (kIsRectPacked) {
+                                  block.putBytes(value.data(), value.size() * kRectSize);
+                              } else {
+                                  for (auto& rect : value) {
+                                      block.put<int32_t>(rect.left)
+                                              .put<int32_t>(rect.top)
+                                              .put<int32_t>(rect.right)
+                                              .put<int32_t>(rect.bottom);
+                                  }
+                              }
+                          });
         return writer.desiredSize();
     }
 
@@ -399,34 +553,43 @@ struct MetadataValue<HEADER, std::vector<Rect>> {
     [[nodiscard]] static DecodeResult decode(const void* _Nonnull metadata, size_t metadataSize) {
         MetadataReader reader{metadata, metadataSize};
         reader.template checkHeader<HEADER>();
-        std::vector<Rect> value;
-        auto numRects = reader.readInt<int64_t>().value_or(0);
-        value.reserve(numRects);
-        for (int i = 0; i < numRects && reader.ok(); i++) {
-            Rect& rect = value.emplace_back();
-            reader.read<int32_t>(rect.left)
-                    .read<int32_t>(rect.top)
-                    .read<int32_t>(rect.right)
-                    .read<int32_t>(rect.bottom);
-        }
+        std::vector<Rect> value(reader.readCount(kRectSize));
+        reader.readBlock(value.size() * kRectSize, [&value](MetadataReader::Block block) {
+            if constexpr (kIsRectPacked) {
+                block.getBytes(value.data(), value.size() * kRectSize);
+            } else {
+                for (auto& rect : value) {
+                    block.get<int32_t>(rect.left)
+                            .get<int32_t>(rect.top)
+                            .get<int32_t>(rect.right)
+                            .get<int32_t>(rect.bottom);
+                }
+            }
+        });
         return reader.ok() ? DecodeResult{std::move(value)} : std::nullopt;
     }
 };
 
 template <typename HEADER>
 struct MetadataValue<HEADER, std::optional<Smpte2086>> {
+    // Three primaries and the white point, each an XyColor, then two luminances
+    static constexpr size_t kSmpte2086Size = 10 * sizeof(float);
+
     [[nodiscard]] static int32_t encode(const std::optional<Smpte2086>& optValue,
                                         void* _Nullable destBuffer, size_t destBufferSize) {
         if (optValue.has_value()) {
             const auto& value = *optValue;
             return MetadataWriter{destBuffer, destBufferSize}
                     .template writeHeader<HEADER>()
-                    .write(value.primaryRed)
-                    .write(value.primaryGreen)
-                    .write(value.primaryBlue)
-                    .write(value.whitePoint)
-                    .write(value.maxLuminance)
-                    .write(value.minLuminance)
+                    .writeBlock(kSmpte2086Size,
+                                [&value](MetadataWriter::Block block) {
+                                    block.put(value.primaryRed)
+                                            .put(value.primaryGreen)
+                                            .put(value.primaryBlue)
+                                            .put(value.whitePoint)
+                                            .put(value.maxLuminance)
+                                            .put(value.minLuminance);
+                                })
                     .desiredSize();
         } else {
             return 0;
@@ -441,12 +604,14 @@ struct MetadataValue<HEADER, std::optional<Smpte2086>> {
             Smpte2086 value;
             MetadataReader reader{metadata, metadataSize};
             reader.template checkHeader<HEADER>();
-            reader.read(value.primaryRed)
-                    .read(value.primaryGreen)
-                    .read(value.primaryBlue)
-                    .read(value.whitePoint)
-                    .read(value.maxLuminance)
-                    .read(value.minLuminance);
+            reader.readBlock(kSmpte2086Size, [&value](MetadataReader::Block block) {
+                block.get(value.primaryRed)
+                        .get(value.primaryGreen)
+                        .get(value.primaryBlue)
+                        .get(value.whitePoint)
+                        .get(value.maxLuminance)
+                        .get(value.minLuminance);
+            });
             if (reader.ok()) {
                 optValue = std::move(value);
             } else {
@@ -459,14 +624,19 @@ struct MetadataValue<HEADER, std::optional<Smpte2086>> {
 
 template <typename HEADER>
 struct MetadataValue<HEADER, std::optional<Cta861_3>> {
+    static constexpr size_t kCta861_3Size = 2 * sizeof(float);
+
     [[nodiscard]] static int32_t encode(const std::optional<Cta861_3>& optValue,
                                         void* _Nullable destBuffer, size_t destBufferSize) {
         if (optValue.has_value()) {
             const auto& value = *optValue;
             return MetadataWriter{destBuffer, destBufferSize}
                     .template writeHeader<HEADER>()
-                    .write(value.maxContentLightLevel)
-                    .write(value.maxFrameAverageLightLevel)
+                    .writeBlock(kCta861_3Size,
+                                [&value](MetadataWriter::Block block) {
+                                    block.put(value.maxContentLightLevel)
+                                            .put(value.maxFrameAverageLightLevel);
+                                })
                     .desiredSize();
         } else {
             return 0;
@@ -481,7 +651,9 @@ struct MetadataValue<HEADER, std::optional<Cta861_3>> {
             MetadataReader reader{metadata, metadataSize};
             reader.template checkHeader<HEADER>();
             Cta861_3 value;
-            reader.read(value.maxContentLightLevel).read(value.maxFrameAverageLightLevel);
+            reader.readBlock(kCta861_3Size, [&value](MetadataReader::Block block) {
+                block.get(value.maxContentLightLevel).get(value.maxFrameAverageLightLevel);
+            });
             if (reader.ok()) {
                 optValue = std::move(value);
             } else {
@@ -16,6 +16,9 @@
 
 #include "health-impl/Health.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android/binder_manager.h>
@@ -64,9 +67,17 @@ Health::Health(std::string_view instance_name, std::unique_ptr<struct healthd_co
       death_recipient_(AIBinder_DeathRecipient_new(&OnCallbackDiedWrapped)) {
     AIBinder_DeathRecipient_setOnUnlinked(death_recipient_.get(), onCallbackUnlinked);
     battery_monitor_.init(healthd_config_.get());
+    notifier_thread_ = std::thread(&Health::CallbackNotifierLoop, this);
 }
 
-Health::~Health() {}
+Health::~Health() {
+    {
+        std::lock_guard<decltype(notify_lock_)> lock(notify_lock_);
+        stop_notifier_ = true;
+    }
+    notify_cv_.notify_one();
+    notifier_thread_.join();
+}
 
 static inline ndk::ScopedAStatus TranslateStatus(::android::status_t err) {
     switch (err) {
@@ -180,16 +191,22 @@ ndk::ScopedAStatus Health::getBatteryHealthData(BatteryHealthData* out) {
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Health::getDiskStats(std::vector<DiskStats>*) {
-    // This implementation does not support DiskStats. An implementation may extend this
-    // class and override this function to support disk stats.
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Health::getDiskStats(std::vector<DiskStats>* out) {
+    // An implementation may extend this class and override this function if the disks are not
+    // listed in /sys/block.
+    if (!storage_stats_.GetDiskStats(out)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Health::getStorageInfo(std::vector<StorageInfo>*) {
-    // This implementation does not support StorageInfo. An implementation may extend this
-    // class and override this function to support storage info.
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Health::getStorageInfo(std::vector<StorageInfo>* out) {
+    // An implementation may extend this class and override this function if the storage is
+    // neither eMMC nor UFS, or does not expose its health in sysfs.
+    if (!storage_stats_.GetStorageInfo(out)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Health::getHealthInfo(HealthInfo* out) {
@@ -230,6 +247,9 @@ ndk::ScopedAStatus Health::getHealthInfo(HealthInfo* out) {
 binder_status_t Health::dump(int fd, const char**, uint32_t) {
     battery_monitor_.dumpState(fd);
 
+    // Dumped before getHealthInfo() below takes a new sample.
+    storage_stats_.Dump(fd);
+
     ::android::base::WriteStringToFd("\ngetHealthInfo -> ", fd);
     HealthInfo health_info;
     auto res = getHealthInfo(&health_info);
@@ -362,19 +382,121 @@ ndk::ScopedAStatus Health::update() {
     return ndk::ScopedAStatus::ok();
 }
 
+namespace {
+
+enum class HealthInfoChange {
+    NONE,
+    // Only readings changed, beyond the thresholds.
+    READINGS,
+    // Any other field changed.
+    STATE,
+};
+
+HealthInfoChange CompareHealthInfo(const HealthInfo& old_info, const HealthInfo& new_info,
+                                   const Health::CallbackNotificationLimits& limits) {
+    HealthInfo masked = new_info;
+    masked.batteryCurrentMicroamps = old_info.batteryCurrentMicroamps;
+    masked.batteryCurrentAverageMicroamps = old_info.batteryCurrentAverageMicroamps;
+    masked.batteryVoltageMillivolts = old_info.batteryVoltageMillivolts;
+    masked.batteryTemperatureTenthsCelsius = old_info.batteryTemperatureTenthsCelsius;
+    masked.batteryChargeCounterUah = old_info.batteryChargeCounterUah;
+    if (masked != old_info) {
+        return HealthInfoChange::STATE;
+    }
+
+    auto exceeds = [](int32_t old_value, int32_t new_value, int32_t threshold) {
+        return std::abs(static_cast<int64_t>(new_value) - old_value) > threshold;
+    };
+    if (exceeds(old_info.batteryCurrentMicroamps, new_info.batteryCurrentMicroamps,
+                limits.current_microamps) ||
+        exceeds(old_info.batteryCurrentAverageMicroamps, new_info.batteryCurrentAverageMicroamps,
+                limits.current_average_microamps) ||
+        exceeds(old_info.batteryVoltageMillivolts, new_info.batteryVoltageMillivolts,
+                limits.voltage_millivolts) ||
+        exceeds(old_info.batteryTemperatureTenthsCelsius, new_info.batteryTemperatureTenthsCelsius,
+                limits.temperature_tenths_celsius) ||
+        exceeds(old_info.batteryChargeCounterUah, new_info.batteryChargeCounterUah,
+                limits.charge_counter_uah)) {
+        return HealthInfoChange::READINGS;
+    }
+    return HealthInfoChange::NONE;
+}
+
+}  // namespace
+
+void Health::SetCallbackNotificationLimits(const CallbackNotificationLimits& limits) {
+    std::lock_guard<decltype(notify_lock_)> lock(notify_lock_);
+    notification_limits_ = limits;
+}
+
+void Health::SetStorageStatsMaxAge(std::chrono::milliseconds max_age) {
+    storage_stats_.SetMaxAge(max_age);
+}
+
 void Health::OnHealthInfoChanged(const HealthInfo& health_info) {
-    // Notify all callbacks
-    std::unique_lock<decltype(callbacks_lock_)> lock(callbacks_lock_);
-    for (const auto& [_, callback] : callbacks_) {
+    // Callbacks are notified from CallbackNotifierLoop(). Only the latest health info is kept, so
+    // changes that arrive faster than they are sent are coalesced.
+    std::lock_guard<decltype(notify_lock_)> lock(notify_lock_);
+    auto change = last_notified_.has_value()
+                          ? CompareHealthInfo(*last_notified_, health_info, notification_limits_)
+                          : HealthInfoChange::STATE;
+    if (change == HealthInfoChange::NONE) {
+        // Nothing clients haven't seen yet.
+        pending_.reset();
+        return;
+    }
+
+    auto deadline = change == HealthInfoChange::STATE
+                            ? std::chrono::steady_clock::now()
+                            : last_notified_time_ + notification_limits_.min_interval;
+    if (pending_.has_value()) deadline = std::min(deadline, pending_deadline_);
+    pending_ = health_info;
+    pending_deadline_ = deadline;
+    notify_cv_.notify_one();
+
+    // Let HalHealthLoop::OnHealthInfoChanged() adjusts uevent / wakealarm periods
+}
+
+void Health::CallbackNotifierLoop() {
+    std::unique_lock<decltype(notify_lock_)> lock(notify_lock_);
+    while (!stop_notifier_) {
+        if (!pending_.has_value()) {
+            notify_cv_.wait(lock);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < pending_deadline_) {
+            notify_cv_.wait_until(lock, pending_deadline_);
+            continue;
+        }
+        HealthInfo health_info = std::move(*pending_);
+        pending_.reset();
+        last_notified_ = health_info;
+        last_notified_time_ = std::chrono::steady_clock::now();
+
+        lock.unlock();
+        NotifyCallbacks(health_info);
+        lock.lock();
+    }
+}
+
+void Health::NotifyCallbacks(const HealthInfo& health_info) {
+    // Do not hold callbacks_lock_ during the binder calls, so registering and unregistering
+    // callbacks is not blocked by a slow callback.
+    std::vector<std::shared_ptr<IHealthInfoCallback>> callbacks;
+    {
+        std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
+        callbacks.reserve(callbacks_.size());
+        for (const auto& [_, callback] : callbacks_) {
+            callbacks.push_back(callback);
+        }
+    }
+    for (const auto& callback : callbacks) {
         auto res = callback->healthInfoChanged(health_info);
         if (!res.isOk()) {
             LOG(DEBUG) << "Cannot call healthInfoChanged:" << res.getDescription()
                        << ". Do nothing here if callback is dead as it will be cleaned up later.";
         }
     }
-    lock.unlock();
-
-    // Let HalHealthLoop::OnHealthInfoChanged() adjusts uevent / wakealarm periods
 }
 
 void Health::BinderEvent(uint32_t /*epevents*/) {
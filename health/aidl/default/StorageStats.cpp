@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "health-impl/StorageStats.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+using ::android::base::StartsWith;
+using ::android::base::StringPrintf;
+using ::android::base::unique_fd;
+
+namespace aidl::android::hardware::health {
+
+namespace {
+
+constexpr char kSysBlock[] = "/sys/block/";
+constexpr char kUfsHealthDescriptors[] = "/sys/bus/platform/drivers/ufshcd/*/health_descriptor";
+constexpr size_t kDiskStatsFields = 11;
+
+unique_fd OpenNode(const std::string& path) {
+    return unique_fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+}
+
+// sysfs regenerates the contents of a node on each read from offset 0, so the fd can be reused.
+bool ReadNode(int fd, std::string* out) {
+    char buf[256];
+    ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf) - 1, 0));
+    if (n < 0) {
+        return false;
+    }
+    out->assign(buf, n);
+    return true;
+}
+
+// Parse whitespace separated numbers, in hexadecimal if prefixed with 0x.
+std::vector<int64_t> ParseNumbers(const std::string& content) {
+    std::vector<int64_t> numbers;
+    const char* p = content.c_str();
+    while (true) {
+        char* end;
+        int64_t value = strtoull(p, &end, 0);
+        if (end == p) {
+            break;
+        }
+        numbers.push_back(value);
+        p = end;
+    }
+    return numbers;
+}
+
+bool ReadNumbers(int fd, std::vector<int64_t>* out) {
+    std::string content;
+    if (fd == -1 || !ReadNode(fd, &content)) {
+        return false;
+    }
+    *out = ParseNumbers(content);
+    return !out->empty();
+}
+
+bool IsPhysicalDisk(const std::string& name) {
+    for (const char* prefix : {"loop", "ram", "zram", "dm-", "md"}) {
+        if (StartsWith(name, prefix)) {
+            return false;
+        }
+    }
+    // eMMC boot and RPMB partitions are listed next to the user area.
+    if (name.find("boot") != std::string::npos || name.find("rpmb") != std::string::npos) {
+        return false;
+    }
+    return access((kSysBlock + name + "/device").c_str(), F_OK) == 0;
+}
+
+// Counters are cumulative, except for the number of I/Os in flight.
+DiskStats Subtract(const DiskStats& a, const DiskStats& b) {
+    DiskStats delta;
+    delta.reads = a.reads - b.reads;
+    delta.readMerges = a.readMerges - b.readMerges;
+    delta.readSectors = a.readSectors - b.readSectors;
+    delta.readTicks = a.readTicks - b.readTicks;
+    delta.writes = a.writes - b.writes;
+    delta.writeMerges = a.writeMerges - b.writeMerges;
+    delta.writeSectors = a.writeSectors - b.writeSectors;
+    delta.writeTicks = a.writeTicks - b.writeTicks;
+    delta.ioInFlight = a.ioInFlight;
+    delta.ioTicks = a.ioTicks - b.ioTicks;
+    delta.ioInQueue = a.ioInQueue - b.ioInQueue;
+    return delta;
+}
+
+}  // namespace
+
+StorageStats::StorageStats(std::chrono::milliseconds max_age) : max_age_(max_age) {
+    FindDisks();
+    FindStorages();
+}
+
+void StorageStats::FindDisks() {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kSysBlock), closedir);
+    if (dir == nullptr) {
+        PLOG(WARNING) << "Cannot open " << kSysBlock;
+        return;
+    }
+    while (struct dirent* entry = readdir(dir.get())) {
+        std::string name = entry->d_name;
+        if (name[0] == '.' || !IsPhysicalDisk(name)) {
+            continue;
+        }
+        Disk disk;
+        disk.name = name;
+        disk.stat_fd = OpenNode(kSysBlock + name + "/stat");
+        if (disk.stat_fd == -1) {
+            PLOG(WARNING) << "Cannot open stat of " << name;
+            continue;
+        }
+        disks_.push_back(std::move(disk));
+    }
+    std::sort(disks_.begin(), disks_.end(),
+              [](const Disk& a, const Disk& b) { return a.name < b.name; });
+}
+
+void StorageStats::FindStorages() {
+    for (const Disk& disk : disks_) {
+        if (!StartsWith(disk.name, "mmcblk")) {
+            continue;
+        }
+        // SD cards have no health nodes.
+        std::string device = kSysBlock + disk.name + "/device/";
+        Storage storage;
+        storage.eol_fd = OpenNode(device + "pre_eol_info");
+        storage.lifetime_a_fd = OpenNode(device + "life_time");
+        if (storage.eol_fd == -1 || storage.lifetime_a_fd == -1) {
+            continue;
+        }
+        std::string rev;
+        if (::android::base::ReadFileToString(device + "rev", &rev)) {
+            storage.version = "emmc " + ::android::base::Trim(rev);
+        }
+        storages_.push_back(std::move(storage));
+    }
+
+    glob_t descriptors;
+    if (glob(kUfsHealthDescriptors, GLOB_NOSORT, nullptr, &descriptors) == 0) {
+        for (size_t i = 0; i < descriptors.gl_pathc; i++) {
+            std::string descriptor = std::string(descriptors.gl_pathv[i]) + "/";
+            Storage storage;
+            storage.eol_fd = OpenNode(descriptor + "eol_info");
+            storage.lifetime_a_fd = OpenNode(descriptor + "life_time_estimation_a");
+            storage.lifetime_b_fd = OpenNode(descriptor + "life_time_estimation_b");
+            if (storage.eol_fd == -1 || storage.lifetime_a_fd == -1 ||
+                storage.lifetime_b_fd == -1) {
+                continue;
+            }
+            std::string spec;
+            if (::android::base::ReadFileToString(
+                        descriptor + "../device_descriptor/specification_version", &spec)) {
+                storage.version = "ufs " + ::android::base::Trim(spec);
+            }
+            storages_.push_back(std::move(storage));
+        }
+    }
+    globfree(&descriptors);
+}
+
+bool StorageStats::IsStaleLocked(const std::optional<Clock::time_point>& sample_time) const {
+    return !sample_time.has_value() || Clock::now() - *sample_time >= max_age_;
+}
+
+void StorageStats::SampleDiskStatsLocked() {
+    auto now = Clock::now();
+    if (disk_stats_time_.has_value()) {
+        disk_stats_interval_ = now - *disk_stats_time_;
+    }
+    disk_stats_time_ = now;
+
+    std::vector<int64_t> fields;
+    for (Disk& disk : disks_) {
+        if (!ReadNumbers(disk.stat_fd, &fields) || fields.size() < kDiskStatsFields) {
+            LOG(DEBUG) << "Cannot read stat of " << disk.name;
+            disk.stats.reset();
+            continue;
+        }
+        DiskStats stats;
+        stats.reads = fields[0];
+        stats.readMerges = fields[1];
+        stats.readSectors = fields[2];
+        stats.readTicks = fields[3];
+        stats.writes = fields[4];
+        stats.writeMerges = fields[5];
+        stats.writeSectors = fields[6];
+        stats.writeTicks = fields[7];
+        stats.ioInFlight = fields[8];
+        stats.ioTicks = fields[9];
+        stats.ioInQueue = fields[10];
+        disk.delta = disk.stats.has_value() ? Subtract(stats, *disk.stats) : DiskStats{};
+        disk.stats = stats;
+    }
+}
+
+void StorageStats::SampleStorageInfoLocked() {
+    storage_info_time_ = Clock::now();
+
+    std::vector<int64_t> eol;
+    std::vector<int64_t> lifetime_a;
+    std::vector<int64_t> lifetime_b;
+    for (Storage& storage : storages_) {
+        storage.info.reset();
+        if (!ReadNumbers(storage.eol_fd, &eol) ||
+            !ReadNumbers(storage.lifetime_a_fd, &lifetime_a)) {
+            continue;
+        }
+        if (storage.lifetime_b_fd != -1) {
+            if (!ReadNumbers(storage.lifetime_b_fd, &lifetime_b)) {
+                continue;
+            }
+        } else if (lifetime_a.size() >= 2) {
+            lifetime_b = {lifetime_a[1]};
+        } else {
+            continue;
+        }
+        StorageInfo info;
+        info.eol = eol[0];
+        info.lifetimeA = lifetime_a[0];
+        info.lifetimeB = lifetime_b[0];
+        info.version = storage.version;
+        // Values out of the JEDEC ranges are not reported.
+        if (info.eol < 0 || info.eol > 3 || info.lifetimeA < 0 || info.lifetimeA > 0x0B ||
+            info.lifetimeB < 0 || info.lifetimeB > 0x0B) {
+            continue;
+        }
+        storage.info = std::move(info);
+    }
+}
+
+bool StorageStats::GetDiskStats(std::vector<DiskStats>* out) {
+    std::lock_guard<decltype(lock_)> lock(lock_);
+    if (disks_.empty()) {
+        return false;
+    }
+    if (IsStaleLocked(disk_stats_time_)) {
+        SampleDiskStatsLocked();
+    }
+    out->clear();
+    for (const Disk& disk : disks_) {
+        if (disk.stats.has_value()) {
+            out->push_back(*disk.stats);
+        }
+    }
+    return true;
+}
+
+bool StorageStats::GetStorageInfo(std::vector<StorageInfo>* out) {
+    std::lock_guard<decltype(lock_)> lock(lock_);
+    if (storages_.empty()) {
+        return false;
+    }
+    if (IsStaleLocked(storage_info_time_)) {
+        SampleStorageInfoLocked();
+    }
+    out->clear();
+    for (const Storage& storage : storages_) {
+        if (storage.info.has_value()) {
+            out->push_back(*storage.info);
+        }
+    }
+    return true;
+}
+
+void StorageStats::SetMaxAge(std::chrono::milliseconds max_age) {
+    std::lock_guard<decltype(lock_)> lock(lock_);
+    max_age_ = max_age;
+}
+
+void StorageStats::Dump(int fd) {
+    std::lock_guard<decltype(lock_)> lock(lock_);
+    std::string out = StringPrintf("\nstorage stats (max age %lldms):\n",
+                                   static_cast<long long>(max_age_.count()));
+    auto interval_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(disk_stats_interval_).count();
+    out += StringPrintf("  disk stats (change over the last %lldms):\n",
+                        static_cast<long long>(interval_ms));
+    for (const Disk& disk : disks_) {
+        if (!disk.stats.has_value()) {
+            out += StringPrintf("    %s: unavailable\n", disk.name.c_str());
+            continue;
+        }
+        const DiskStats& s = *disk.stats;
+        const DiskStats& d = disk.delta;
+        out += StringPrintf(
+                "    %s: reads %lld (+%lld), sectors read %lld (+%lld), writes %lld (+%lld), "
+                "sectors written %lld (+%lld), io ticks %lld (+%lld), in flight %lld\n",
+                disk.name.c_str(), static_cast<long long>(s.reads),
+                static_cast<long long>(d.reads), static_cast<long long>(s.readSectors),
+                static_cast<long long>(d.readSectors), static_cast<long long>(s.writes),
+                static_cast<long long>(d.writes), static_cast<long long>(s.writeSectors),
+                static_cast<long long>(d.writeSectors), static_cast<long long>(s.ioTicks),
+                static_cast<long long>(d.ioTicks), static_cast<long long>(s.ioInFlight));
+    }
+    out += "  storage info:\n";
+    for (const Storage& storage : storages_) {
+        out += "    ";
+        out += storage.info.has_value() ? storage.info->toString() : "unavailable";
+        out += "\n";
+    }
+    ::android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace aidl::android::hardware::health
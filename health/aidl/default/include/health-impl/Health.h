@@ -16,14 +16,19 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 
 #include <aidl/android/hardware/health/BnHealth.h>
 #include <aidl/android/hardware/health/IHealthInfoCallback.h>
 #include <android/binder_auto_utils.h>
 #include <health-impl/HalHealthLoop.h>
+#include <health-impl/StorageStats.h>
 #include <healthd/BatteryMonitor.h>
 #include <healthd/healthd.h>
 
@@ -69,7 +74,7 @@ class Health : public BnHealth, public HalHealthLoopCallback {
     ndk::ScopedAStatus getEnergyCounterNwh(int64_t* out) override;
 
     // A subclass may override these for a specific device.
-    // The default implementations return nothing in |out|.
+    // The default implementations read sysfs, see StorageStats.
     ndk::ScopedAStatus getDiskStats(std::vector<DiskStats>* out) override;
     ndk::ScopedAStatus getStorageInfo(std::vector<StorageInfo>* out) override;
 
@@ -94,7 +99,28 @@ class Health : public BnHealth, public HalHealthLoopCallback {
     // for efficiency.
     virtual std::optional<bool> ShouldKeepScreenOn();
 
+    // Limits on notifying registered callbacks of health info changes.
+    // Changes of the readings below that don't exceed the threshold, relative to the value last
+    // notified, are not notified. Changes that exceed any threshold are notified at most once per
+    // |min_interval|. Changes of any other field are notified right away.
+    // The default limits notify every change right away.
+    struct CallbackNotificationLimits {
+        int32_t current_microamps = 0;
+        int32_t current_average_microamps = 0;
+        int32_t voltage_millivolts = 0;
+        int32_t temperature_tenths_celsius = 0;
+        int32_t charge_counter_uah = 0;
+        std::chrono::milliseconds min_interval{0};
+    };
+
   protected:
+    // A subclass may call this, typically in the constructor, to notify callbacks less often.
+    void SetCallbackNotificationLimits(const CallbackNotificationLimits& limits);
+
+    // A subclass may call this to change how long disk stats and storage info are cached for.
+    // Default is StorageStats::kDefaultMaxAge.
+    void SetStorageStatsMaxAge(std::chrono::milliseconds max_age);
+
     // A subclass can override this to modify any health info object before
     // returning to clients. This is similar to healthd_board_battery_update().
     // By default, it does nothing.
@@ -106,14 +132,32 @@ class Health : public BnHealth, public HalHealthLoopCallback {
 
     bool unregisterCallbackInternal(std::shared_ptr<IHealthInfoCallback> callback);
 
+    // Notifies callbacks of pending health info changes, so a slow callback doesn't delay the
+    // health loop.
+    void CallbackNotifierLoop();
+    void NotifyCallbacks(const HealthInfo& health_info);
+
     std::string instance_name_;
     ::android::BatteryMonitor battery_monitor_;
     std::unique_ptr<struct healthd_config> healthd_config_;
+    StorageStats storage_stats_;
 
     ndk::ScopedAIBinder_DeathRecipient death_recipient_;
     int binder_fd_ = -1;
     std::mutex callbacks_lock_;
     std::map<LinkedCallback*, std::shared_ptr<IHealthInfoCallback>> callbacks_;
+
+    std::mutex notify_lock_;
+    std::condition_variable notify_cv_;
+    CallbackNotificationLimits notification_limits_;
+    // The health info last sent to the callbacks, and when.
+    std::optional<HealthInfo> last_notified_;
+    std::chrono::steady_clock::time_point last_notified_time_;
+    // The health info to be sent to the callbacks, and when.
+    std::optional<HealthInfo> pending_;
+    std::chrono::steady_clock::time_point pending_deadline_;
+    bool stop_notifier_ = false;
+    std::thread notifier_thread_;
 };
 
 }  // namespace aidl::android::hardware::health
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <aidl/android/hardware/health/DiskStats.h>
+#include <aidl/android/hardware/health/StorageInfo.h>
+#include <android-base/unique_fd.h>
+
+namespace aidl::android::hardware::health {
+
+// Default source of DiskStats and StorageInfo for Health.
+//
+// Disk stats are read from /sys/block/<disk>/stat of each physical disk, and storage info from
+// the health nodes of eMMC (pre_eol_info and life_time) and UFS (health_descriptor) devices.
+// The nodes are looked up and opened once. A sample is reused until it is older than the
+// staleness window, so that clients polling faster than that don't re-read sysfs.
+class StorageStats {
+  public:
+    static constexpr std::chrono::milliseconds kDefaultMaxAge{1000};
+
+    explicit StorageStats(std::chrono::milliseconds max_age = kDefaultMaxAge);
+
+    // Return false if the device has no such node.
+    bool GetDiskStats(std::vector<DiskStats>* out);
+    bool GetStorageInfo(std::vector<StorageInfo>* out);
+
+    void SetMaxAge(std::chrono::milliseconds max_age);
+
+    // Dump the last sample, and the change of the disk stats since the sample before it.
+    void Dump(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Disk {
+        std::string name;
+        ::android::base::unique_fd stat_fd;
+        std::optional<DiskStats> stats;
+        // Change of |stats| since the previous sample.
+        DiskStats delta;
+    };
+
+    struct Storage {
+        ::android::base::unique_fd eol_fd;
+        // eMMC reports both life time estimations in |lifetime_a_fd|.
+        ::android::base::unique_fd lifetime_a_fd;
+        ::android::base::unique_fd lifetime_b_fd;
+        std::optional<StorageInfo> info;
+        std::string version;
+    };
+
+    void FindDisks();
+    void FindStorages();
+    void SampleDiskStatsLocked();
+    void SampleStorageInfoLocked();
+    bool IsStaleLocked(const std::optional<Clock::time_point>& sample_time) const;
+
+    std::mutex lock_;
+    std::chrono::milliseconds max_age_;
+    std::vector<Disk> disks_;
+    std::vector<Storage> storages_;
+    std::optional<Clock::time_point> disk_stats_time_;
+    Clock::duration disk_stats_interval_{};
+    std::optional<Clock::time_point> storage_info_time_;
+};
+
+}  // namespace aidl::android::hardware::health
@@ -119,9 +119,48 @@ void HealthLoop::AdjustWakealarmPeriods(bool charger_online) {
 }
 
 void HealthLoop::PeriodicChores() {
+    BatteryUpdate();
+}
+
+void HealthLoop::BatteryUpdate() {
+    battery_update_pending_ = false;
+    last_battery_update_ = android::base::boot_clock::now();
     ScheduleBatteryUpdate();
 }
 
+// Power_supply uevents closer than this are coalesced into one battery update.
+static constexpr auto kUeventDebounce = 500ms;
+
+void HealthLoop::DebouncedBatteryUpdate() {
+    if (battery_update_pending_) return;
+
+    auto elapsed = android::base::boot_clock::now() - last_battery_update_;
+    if (uevent_debounce_fd_ == -1 || elapsed >= kUeventDebounce) {
+        BatteryUpdate();
+        return;
+    }
+
+    auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(kUeventDebounce - elapsed);
+    struct itimerspec itval = {};
+    itval.it_value.tv_sec = delay.count() / 1000000000;
+    itval.it_value.tv_nsec = delay.count() % 1000000000;
+    if (timerfd_settime(uevent_debounce_fd_, 0, &itval, NULL) == -1) {
+        KLOG_ERROR(LOG_TAG, "uevent_debounce: timerfd_settime failed\n");
+        BatteryUpdate();
+        return;
+    }
+    battery_update_pending_ = true;
+}
+
+void HealthLoop::UeventDebounceEvent(uint32_t /*epevents*/) {
+    unsigned long long expirations;
+
+    if (read(uevent_debounce_fd_, &expirations, sizeof(expirations)) == -1) return;
+
+    // The update may have been done meanwhile by the periodic chores.
+    if (battery_update_pending_) BatteryUpdate();
+}
+
 // TODO(b/140330870): Use BPF instead.
 #define UEVENT_MSG_LEN 2048
 void HealthLoop::UeventEvent(uint32_t /*epevents*/) {
@@ -130,26 +169,30 @@ void HealthLoop::UeventEvent(uint32_t /*epevents*/) {
     char msg[UEVENT_MSG_LEN + 2];
     char* cp;
     int n;
+    bool power_supply_changed = false;
 
-    n = uevent_kernel_multicast_recv(uevent_fd_, msg, UEVENT_MSG_LEN);
-    if (n <= 0) return;
-    if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
-        return;
+    // Drain all queued uevents, so a burst results in a single update.
+    while ((n = uevent_kernel_multicast_recv(uevent_fd_, msg, UEVENT_MSG_LEN)) > 0) {
+        if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
+            continue;
 
-    msg[n] = '\0';
-    msg[n + 1] = '\0';
-    cp = msg;
+        msg[n] = '\0';
+        msg[n + 1] = '\0';
+        cp = msg;
 
-    while (*cp) {
-        if (!strcmp(cp, "SUBSYSTEM=power_supply")) {
-            ScheduleBatteryUpdate();
-            break;
-        }
+        while (*cp) {
+            if (!strcmp(cp, "SUBSYSTEM=power_supply")) {
+                power_supply_changed = true;
+                break;
+            }
 
-        /* advance to after the next \0 */
-        while (*cp++)
-            ;
+            /* advance to after the next \0 */
+            while (*cp++)
+                ;
+        }
     }
+
+    if (power_supply_changed) DebouncedBatteryUpdate();
 }
 
 void HealthLoop::UeventInit(void) {
@@ -163,6 +206,18 @@ void HealthLoop::UeventInit(void) {
     fcntl(uevent_fd_, F_SETFL, O_NONBLOCK);
     if (RegisterEvent(uevent_fd_, &HealthLoop::UeventEvent, EVENT_WAKEUP_FD))
         KLOG_ERROR(LOG_TAG, "register for uevent events failed\n");
+
+    // An alarm timer, so the deferred update is not postponed by suspend.
+    uevent_debounce_fd_.reset(timerfd_create(CLOCK_BOOTTIME_ALARM, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (uevent_debounce_fd_ == -1) {
+        KLOG_ERROR(LOG_TAG, "uevent_init: timerfd_create failed; uevents are not debounced\n");
+        return;
+    }
+
+    if (RegisterEvent(uevent_debounce_fd_, &HealthLoop::UeventDebounceEvent, EVENT_WAKEUP_FD)) {
+        KLOG_ERROR(LOG_TAG, "register for uevent debounce events failed\n");
+        uevent_debounce_fd_.reset();
+    }
 }
 
 void HealthLoop::WakeAlarmEvent(uint32_t /*epevents*/) {
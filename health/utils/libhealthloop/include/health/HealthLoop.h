@@ -20,6 +20,7 @@
 #include <mutex>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/unique_fd.h>
 #include <healthd/healthd.h>
 
@@ -92,19 +93,32 @@ class HealthLoop {
     void WakeAlarmEvent(uint32_t);
     void UeventInit();
     void UeventEvent(uint32_t);
+    void UeventDebounceEvent(uint32_t);
     void WakeAlarmSetInterval(int interval);
     void PeriodicChores();
+    // Updates the battery now, or at the end of the debounce window if the
+    // battery was updated recently. Used for power_supply uevents, which can
+    // come in storms while charging.
+    void DebouncedBatteryUpdate();
+    // Calls ScheduleBatteryUpdate() and records the time of the update.
+    void BatteryUpdate();
 
     // These are fixed after InitInternal() is called.
     struct healthd_config healthd_config_;
     android::base::unique_fd wakealarm_fd_;
     android::base::unique_fd uevent_fd_;
+    // One-shot timer for the battery update at the end of the debounce window.
+    android::base::unique_fd uevent_debounce_fd_;
 
     android::base::unique_fd epollfd_;
     std::vector<std::unique_ptr<EventHandler>> event_handlers_;
     int awake_poll_interval_;  // -1 for no epoll timeout
     int wakealarm_wake_interval_;
 
+    android::base::boot_clock::time_point last_battery_update_;
+    // Whether a battery update is deferred to the end of the debounce window.
+    bool battery_update_pending_ = false;
+
     // If set to true, future RegisterEvent() will be rejected. This is to ensure all
     // events are registered before StartLoop().
     bool reject_event_register_ = false;
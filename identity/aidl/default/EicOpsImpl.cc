@@ -55,6 +55,14 @@ using ::std::string;
 using ::std::tuple;
 using ::std::vector;
 
+// Reader and access control profile certificates and keys in parsed form. The
+// EicOps interface has no notion of a session, so this is shared by all of
+// them. Only public keys and certificates go in here.
+static android::hardware::identity::support::ParsedObjectCache& parsedObjects() {
+    static android::hardware::identity::support::ParsedObjectCache cache;
+    return cache;
+}
+
 void* eicMemSet(void* s, int c, size_t n) {
     return memset(s, c, n);
 }
@@ -153,35 +161,11 @@ bool eicOpsEncryptAes128Gcm(
         size_t dataSize,
         const uint8_t* additionalAuthenticationData,  // May be NULL if size is 0
         size_t additionalAuthenticationDataSize, uint8_t* encryptedData) {
-    vector<uint8_t> cppKey;
-    cppKey.resize(16);
-    memcpy(cppKey.data(), key, 16);
-
-    vector<uint8_t> cppData;
-    cppData.resize(dataSize);
-    if (dataSize > 0) {
-        memcpy(cppData.data(), data, dataSize);
-    }
-
-    vector<uint8_t> cppAAD;
-    cppAAD.resize(additionalAuthenticationDataSize);
-    if (additionalAuthenticationDataSize > 0) {
-        memcpy(cppAAD.data(), additionalAuthenticationData, additionalAuthenticationDataSize);
-    }
-
-    vector<uint8_t> cppNonce;
-    cppNonce.resize(12);
-    memcpy(cppNonce.data(), nonce, 12);
-
-    optional<vector<uint8_t>> cppEncryptedData =
-            android::hardware::identity::support::encryptAes128Gcm(cppKey, cppNonce, cppData,
-                                                                   cppAAD);
-    if (!cppEncryptedData.has_value()) {
-        return false;
-    }
-
-    memcpy(encryptedData, cppEncryptedData.value().data(), cppEncryptedData.value().size());
-    return true;
+    // Encrypt straight from and into the caller's buffers, entries can be large.
+    return android::hardware::identity::support::encryptAes128Gcm(
+            {key, 16}, {nonce, 12}, {data, dataSize},
+            {additionalAuthenticationData, additionalAuthenticationDataSize},
+            {encryptedData, dataSize + 28});
 }
 
 // Decrypts |encryptedData| using |key| and |additionalAuthenticatedData|,
@@ -193,38 +177,17 @@ bool eicOpsDecryptAes128Gcm(const uint8_t* key,  // Must be 16 bytes
                             const uint8_t* encryptedData, size_t encryptedDataSize,
                             const uint8_t* additionalAuthenticationData,
                             size_t additionalAuthenticationDataSize, uint8_t* data) {
-    vector<uint8_t> keyVec;
-    keyVec.resize(16);
-    memcpy(keyVec.data(), key, 16);
-
-    vector<uint8_t> encryptedDataVec;
-    encryptedDataVec.resize(encryptedDataSize);
-    if (encryptedDataSize > 0) {
-        memcpy(encryptedDataVec.data(), encryptedData, encryptedDataSize);
-    }
-
-    vector<uint8_t> aadVec;
-    aadVec.resize(additionalAuthenticationDataSize);
-    if (additionalAuthenticationDataSize > 0) {
-        memcpy(aadVec.data(), additionalAuthenticationData, additionalAuthenticationDataSize);
-    }
-
-    optional<vector<uint8_t>> decryptedDataVec =
-            android::hardware::identity::support::decryptAes128Gcm(keyVec, encryptedDataVec,
-                                                                   aadVec);
-    if (!decryptedDataVec.has_value()) {
-        eicDebug("Error decrypting data");
+    if (encryptedDataSize < 28) {
+        eicDebug("Encrypted data is size %zd, expected at least 28", encryptedDataSize);
         return false;
     }
-    if (decryptedDataVec.value().size() != encryptedDataSize - 28) {
-        eicDebug("Decrypted data is size %zd, expected %zd", decryptedDataVec.value().size(),
-                 encryptedDataSize - 28);
+    if (!android::hardware::identity::support::decryptAes128Gcm(
+                {key, 16}, {encryptedData, encryptedDataSize},
+                {additionalAuthenticationData, additionalAuthenticationDataSize},
+                {data, encryptedDataSize - 28})) {
+        eicDebug("Error decrypting data");
         return false;
     }
-
-    if (decryptedDataVec.value().size() > 0) {
-        memcpy(data, decryptedDataVec.value().data(), decryptedDataVec.value().size());
-    }
     return true;
 }
 
@@ -442,7 +405,8 @@ bool eicOpsX509GetPublicKey(const uint8_t* x509Cert, size_t x509CertSize, uint8_
     chain.resize(x509CertSize);
     memcpy(chain.data(), x509Cert, x509CertSize);
     optional<vector<uint8_t>> res =
-            android::hardware::identity::support::certificateChainGetTopMostKey(chain);
+            android::hardware::identity::support::certificateChainGetTopMostKey(chain,
+                                                                                parsedObjects());
     if (!res) {
         return false;
     }
@@ -462,8 +426,8 @@ bool eicOpsX509CertSignedByPublicKey(const uint8_t* x509Cert, size_t x509CertSiz
                                      const uint8_t* publicKey, size_t publicKeySize) {
     vector<uint8_t> certVec(x509Cert, x509Cert + x509CertSize);
     vector<uint8_t> publicKeyVec(publicKey, publicKey + publicKeySize);
-    return android::hardware::identity::support::certificateSignedByPublicKey(certVec,
-                                                                              publicKeyVec);
+    return android::hardware::identity::support::certificateSignedByPublicKey(
+            certVec, publicKeyVec, parsedObjects());
 }
 
 bool eicOpsEcDsaVerifyWithPublicKey(const uint8_t* digest, size_t digestSize,
@@ -481,7 +445,7 @@ bool eicOpsEcDsaVerifyWithPublicKey(const uint8_t* digest, size_t digestSize,
     }
 
     if (!android::hardware::identity::support::checkEcDsaSignature(digestVec, derSignature,
-                                                                   publicKeyVec)) {
+                                                                   publicKeyVec, parsedObjects())) {
         LOG(ERROR) << "Signature check failed";
         return false;
     }
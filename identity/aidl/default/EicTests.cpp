@@ -15,6 +15,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <cstring>
 #include <optional>
 #include <string>
 #include <vector>
@@ -80,6 +81,46 @@ TEST(EicTest, AccessControlIsEnforced) {
     ASSERT_FALSE(decContent.has_value());
 }
 
+TEST(EicTest, CachedEntryAdditionalDataMatches) {
+    EicCborAdditionalDataCache cache = {};
+    vector<uint8_t> acpIds = {0, 1, 31};
+    string longNameSpace(EIC_CBOR_MAX_CACHED_NAMESPACE_SIZE + 1, 'x');
+
+    for (const string& nameSpace : {string("org.iso.18013.5.1"), string("org.iso.18013.5.1"),
+                                    string("org.example"), longNameSpace, string("org.example")}) {
+        string name = "Element";
+        size_t expectedSize = eicCborCalcEntryAdditionalDataSize(acpIds.data(), acpIds.size(),
+                                                                 nameSpace.size(), name.size());
+
+        vector<uint8_t> expected(256);
+        size_t expectedCborSize = 0;
+        uint8_t expectedSha256[EIC_SHA256_DIGEST_SIZE];
+        ASSERT_TRUE(eicCborCalcEntryAdditionalData(
+                acpIds.data(), acpIds.size(), nameSpace.data(), nameSpace.size(), name.data(),
+                name.size(), expected.data(), expected.size(), &expectedCborSize, expectedSha256));
+        ASSERT_EQ(expectedSize, expectedCborSize);
+        expected.resize(expectedCborSize);
+
+        vector<uint8_t> cached(256);
+        size_t cachedCborSize = 0;
+        uint8_t cachedSha256[EIC_SHA256_DIGEST_SIZE];
+        ASSERT_TRUE(eicCborCalcEntryAdditionalDataCached(
+                &cache, acpIds.data(), acpIds.size(), nameSpace.data(), nameSpace.size(),
+                name.data(), name.size(), cached.data(), cached.size(), &cachedCborSize,
+                cachedSha256));
+        cached.resize(cachedCborSize);
+
+        EXPECT_EQ(expected, cached);
+        EXPECT_EQ(0, memcmp(expectedSha256, cachedSha256, EIC_SHA256_DIGEST_SIZE));
+
+        // Too small a buffer is rejected up front.
+        EXPECT_FALSE(eicCborCalcEntryAdditionalDataCached(
+                &cache, acpIds.data(), acpIds.size(), nameSpace.data(), nameSpace.size(),
+                name.data(), name.size(), cached.data(), expectedSize - 1, nullptr,
+                cachedSha256));
+    }
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
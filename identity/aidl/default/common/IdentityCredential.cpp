@@ -354,7 +354,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
         // First, feed all the reader certificates to the secure hardware. We start
         // at the end..
         optional<vector<vector<uint8_t>>> splitCerts =
-                support::certificateChainSplit(readerCertificateChain.value());
+                support::certificateChainSplit(readerCertificateChain.value(), parsedObjects_);
         if (!splitCerts || splitCerts.value().size() == 0) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
@@ -375,7 +375,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
             // not bitwise comparison of the certificates.
             //
             optional<vector<uint8_t>> x509CertPubKey =
-                    support::certificateChainGetTopMostKey(x509Cert);
+                    support::certificateChainGetTopMostKey(x509Cert, parsedObjects_);
             if (!x509CertPubKey) {
                 return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                         IIdentityCredentialStore::STATUS_FAILED,
@@ -390,7 +390,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
                     continue;
                 }
                 optional<vector<uint8_t>> profilePubKey = support::certificateChainGetTopMostKey(
-                        profile.readerCertificate.encodedCertificate);
+                        profile.readerCertificate.encodedCertificate, parsedObjects_);
                 if (!profilePubKey) {
                     return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                             IIdentityCredentialStore::STATUS_FAILED,
@@ -119,6 +119,10 @@ class IdentityCredential : public BnIdentityCredential {
     // Set by ensureHwProxy()
     sp<SecureHardwarePresentationProxy> hwProxy_;
 
+    // Reader and access control profile certificates in parsed form, startRetrieval()
+    // looks at the same ones over and over.
+    ::android::hardware::identity::support::ParsedObjectCache parsedObjects_;
+
     // Set by createEphemeralKeyPair()
     vector<uint8_t> ephemeralPublicKey_;
 
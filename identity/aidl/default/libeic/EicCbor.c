@@ -35,6 +35,14 @@ void eicCborInitHmacSha256(EicCbor* cbor, uint8_t* buffer, size_t bufferSize,
     eicOpsHmacSha256Init(&cbor->digester.hmacSha256, hmacKey, hmacKeySize);
 }
 
+void eicCborInitNoDigest(EicCbor* cbor, uint8_t* buffer, size_t bufferSize) {
+    eicMemSet(cbor, '\0', sizeof(EicCbor));
+    cbor->size = 0;
+    cbor->bufferSize = bufferSize;
+    cbor->buffer = buffer;
+    cbor->digestType = EIC_CBOR_DIGEST_TYPE_NONE;
+}
+
 void eicCborEnableSecondaryDigesterSha256(EicCbor* cbor, EicSha256Ctx* sha256) {
     cbor->secondaryDigesterSha256 = sha256;
 }
@@ -47,6 +55,10 @@ void eicCborFinal(EicCbor* cbor, uint8_t digest[EIC_SHA256_DIGEST_SIZE]) {
         case EIC_CBOR_DIGEST_TYPE_HMAC_SHA256:
             eicOpsHmacSha256Final(&cbor->digester.hmacSha256, digest);
             break;
+        case EIC_CBOR_DIGEST_TYPE_NONE:
+            eicDebug("No digest to return");
+            eicMemSet(digest, '\0', EIC_SHA256_DIGEST_SIZE);
+            break;
     }
 }
 
@@ -58,6 +70,8 @@ void eicCborAppend(EicCbor* cbor, const uint8_t* data, size_t size) {
         case EIC_CBOR_DIGEST_TYPE_HMAC_SHA256:
             eicOpsHmacSha256Update(&cbor->digester.hmacSha256, data, size);
             break;
+        case EIC_CBOR_DIGEST_TYPE_NONE:
+            break;
     }
     if (cbor->secondaryDigesterSha256 != NULL) {
         eicOpsSha256Update(cbor->secondaryDigesterSha256, data, size);
@@ -217,30 +231,101 @@ bool eicCborCalcAccessControl(EicCbor* cborBuilder, int id, const uint8_t* reade
     return true;
 }
 
+// AdditionalData is the CBOR map
+//
+//   {
+//     "Namespace" : tstr,
+//     "Name" : tstr,
+//     "AccessControlProfileIds" : [ + uint ],
+//   }
+//
+// which is built in two parts: the prefix, which is the same for all entries in a
+// namespace, and the rest.
+//
+static void appendEntryAdditionalDataPrefix(EicCbor* cbor, const char* nameSpace,
+                                            size_t nameSpaceLength) {
+    eicCborAppendMap(cbor, 3);
+    eicCborAppendStringZ(cbor, "Namespace");
+    eicCborAppendString(cbor, nameSpace, nameSpaceLength);
+    eicCborAppendStringZ(cbor, "Name");
+}
+
+static void appendEntryAdditionalDataRest(EicCbor* cbor, const char* name, size_t nameLength,
+                                          const uint8_t* accessControlProfileIds,
+                                          size_t numAccessControlProfileIds) {
+    eicCborAppendString(cbor, name, nameLength);
+    eicCborAppendStringZ(cbor, "AccessControlProfileIds");
+    eicCborAppendArray(cbor, numAccessControlProfileIds);
+    for (size_t n = 0; n < numAccessControlProfileIds; n++) {
+        eicCborAppendNumber(cbor, accessControlProfileIds[n]);
+    }
+}
+
+size_t eicCborCalcEntryAdditionalDataSize(const uint8_t* accessControlProfileIds,
+                                          size_t numAccessControlProfileIds,
+                                          size_t nameSpaceLength, size_t nameLength) {
+    // Without a buffer and a digest the string contents are never read.
+    EicCbor cborBuilder;
+    eicCborInitNoDigest(&cborBuilder, NULL, 0);
+    appendEntryAdditionalDataPrefix(&cborBuilder, NULL, nameSpaceLength);
+    appendEntryAdditionalDataRest(&cborBuilder, NULL, nameLength, accessControlProfileIds,
+                                  numAccessControlProfileIds);
+    return cborBuilder.size;
+}
+
 bool eicCborCalcEntryAdditionalData(const uint8_t* accessControlProfileIds,
                                     size_t numAccessControlProfileIds, const char* nameSpace,
                                     size_t nameSpaceLength, const char* name,
                                     size_t nameLength, uint8_t* cborBuffer,
                                     size_t cborBufferSize, size_t* outAdditionalDataCborSize,
                                     uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE]) {
-    EicCbor cborBuilder;
+    return eicCborCalcEntryAdditionalDataCached(
+            NULL, accessControlProfileIds, numAccessControlProfileIds, nameSpace,
+            nameSpaceLength, name, nameLength, cborBuffer, cborBufferSize,
+            outAdditionalDataCborSize, additionalDataSha256);
+}
 
-    eicCborInit(&cborBuilder, cborBuffer, cborBufferSize);
-    eicCborAppendMap(&cborBuilder, 3);
-    eicCborAppendStringZ(&cborBuilder, "Namespace");
-    eicCborAppendString(&cborBuilder, nameSpace, nameSpaceLength);
-    eicCborAppendStringZ(&cborBuilder, "Name");
-    eicCborAppendString(&cborBuilder, name, nameLength);
-    eicCborAppendStringZ(&cborBuilder, "AccessControlProfileIds");
-    eicCborAppendArray(&cborBuilder, numAccessControlProfileIds);
-    for (size_t n = 0; n < numAccessControlProfileIds; n++) {
-        eicCborAppendNumber(&cborBuilder, accessControlProfileIds[n]);
-    }
-    if (cborBuilder.size > cborBufferSize) {
+bool eicCborCalcEntryAdditionalDataCached(EicCborAdditionalDataCache* cache,
+                                          const uint8_t* accessControlProfileIds,
+                                          size_t numAccessControlProfileIds,
+                                          const char* nameSpace, size_t nameSpaceLength,
+                                          const char* name, size_t nameLength,
+                                          uint8_t* cborBuffer, size_t cborBufferSize,
+                                          size_t* outAdditionalDataCborSize,
+                                          uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE]) {
+    // Check the size first so we don't waste time digesting if it doesn't fit.
+    size_t size = eicCborCalcEntryAdditionalDataSize(
+            accessControlProfileIds, numAccessControlProfileIds, nameSpaceLength, nameLength);
+    if (size > cborBufferSize) {
         eicDebug("Not enough space for additionalData - buffer is only %zd bytes, content is %zd",
-                 cborBufferSize, cborBuilder.size);
+                 cborBufferSize, size);
         return false;
     }
+
+    bool cacheable = cache != NULL && nameSpaceLength <= EIC_CBOR_MAX_CACHED_NAMESPACE_SIZE;
+    bool cacheHit = cacheable && cache->valid && cache->nameSpaceLength == nameSpaceLength &&
+                    eicCryptoMemCmp(cache->nameSpace, nameSpace, nameSpaceLength) == 0;
+
+    EicCbor cborBuilder;
+    if (cacheHit) {
+        // The prefix only needs to be written out, its digest is in the cache.
+        eicCborInitNoDigest(&cborBuilder, cborBuffer, cborBufferSize);
+        appendEntryAdditionalDataPrefix(&cborBuilder, nameSpace, nameSpaceLength);
+        cborBuilder.digestType = EIC_CBOR_DIGEST_TYPE_SHA256;
+        eicMemCpy(&cborBuilder.digester.sha256, &cache->prefixSha256, sizeof(EicSha256Ctx));
+    } else {
+        eicCborInit(&cborBuilder, cborBuffer, cborBufferSize);
+        appendEntryAdditionalDataPrefix(&cborBuilder, nameSpace, nameSpaceLength);
+        if (cacheable) {
+            eicMemCpy(cache->nameSpace, nameSpace, nameSpaceLength);
+            cache->nameSpaceLength = nameSpaceLength;
+            eicMemCpy(&cache->prefixSha256, &cborBuilder.digester.sha256, sizeof(EicSha256Ctx));
+            cache->valid = true;
+        }
+    }
+    appendEntryAdditionalDataRest(&cborBuilder, name, nameLength, accessControlProfileIds,
+                                  numAccessControlProfileIds);
+
     if (outAdditionalDataCborSize != NULL) {
         *outAdditionalDataCborSize = cborBuilder.size;
     }
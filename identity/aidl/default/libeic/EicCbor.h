@@ -30,6 +30,7 @@ extern "C" {
 typedef enum {
     EIC_CBOR_DIGEST_TYPE_SHA256,
     EIC_CBOR_DIGEST_TYPE_HMAC_SHA256,
+    EIC_CBOR_DIGEST_TYPE_NONE,
 } EicCborDigestType;
 
 /* EicCbor is a utility class to build CBOR data structures and calculate
@@ -73,6 +74,14 @@ void eicCborInit(EicCbor* cbor, uint8_t* buffer, size_t bufferSize);
 void eicCborInitHmacSha256(EicCbor* cbor, uint8_t* buffer, size_t bufferSize,
                            const uint8_t* hmacKey, size_t hmacKeySize);
 
+/* Like eicCborInit() but doesn't calculate a digest.
+ *
+ * This is useful for a first pass calculating the size of CBOR to be written
+ * (pass a bufferSize of 0 and read |size| afterwards) and for writing out CBOR
+ * for which the digest is already known.
+ */
+void eicCborInitNoDigest(EicCbor* cbor, uint8_t* buffer, size_t bufferSize);
+
 /* Enables a secondary digester.
  *
  * May be enabled midway through processing, this can be used to e.g. calculate
@@ -81,7 +90,10 @@ void eicCborInitHmacSha256(EicCbor* cbor, uint8_t* buffer, size_t bufferSize,
  */
 void eicCborEnableSecondaryDigesterSha256(EicCbor* cbor, EicSha256Ctx* sha256);
 
-/* Finishes building CBOR and returns the digest. */
+/* Finishes building CBOR and returns the digest.
+ *
+ * Must not be called on an EicCbor initialized with eicCborInitNoDigest().
+ */
 void eicCborFinal(EicCbor* cbor, uint8_t digest[EIC_SHA256_DIGEST_SIZE]);
 
 /* Appends CBOR data to the EicCbor. */
@@ -154,6 +166,45 @@ bool eicCborCalcEntryAdditionalData(const uint8_t* accessControlProfileIds,
                                     size_t cborBufferSize, size_t* outAdditionalDataCborSize,
                                     uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE]);
 
+/* Calculates the size of the AdditionalData CBOR for an entry, without digesting anything. */
+size_t eicCborCalcEntryAdditionalDataSize(const uint8_t* accessControlProfileIds,
+                                          size_t numAccessControlProfileIds,
+                                          size_t nameSpaceLength, size_t nameLength);
+
+#define EIC_CBOR_MAX_CACHED_NAMESPACE_SIZE 64
+
+/* Caches the digest state of the AdditionalData prefix shared by all entries of a namespace.
+ *
+ * AdditionalData starts with the namespace so for all entries in a namespace the
+ * first part of the CBOR is the same. Entries are processed namespace by namespace
+ * so caching the SHA-256 state after that part means it only has to be digested
+ * once per namespace instead of twice per entry.
+ *
+ * An all-zeroes EicCborAdditionalDataCache is empty.
+ */
+typedef struct {
+    bool valid;
+
+    char nameSpace[EIC_CBOR_MAX_CACHED_NAMESPACE_SIZE];
+    size_t nameSpaceLength;
+
+    // SHA-256 state after digesting everything before the entry name.
+    EicSha256Ctx prefixSha256;
+} EicCborAdditionalDataCache;
+
+/* Like eicCborCalcEntryAdditionalData() but uses and updates |cache|.
+ *
+ * Namespaces longer than EIC_CBOR_MAX_CACHED_NAMESPACE_SIZE are not cached.
+ */
+bool eicCborCalcEntryAdditionalDataCached(EicCborAdditionalDataCache* cache,
+                                          const uint8_t* accessControlProfileIds,
+                                          size_t numAccessControlProfileIds,
+                                          const char* nameSpace, size_t nameSpaceLength,
+                                          const char* name, size_t nameLength,
+                                          uint8_t* cborBuffer, size_t cborBufferSize,
+                                          size_t* outAdditionalDataCborSize,
+                                          uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE]);
+
 #ifdef __cplusplus
 }
 #endif
@@ -780,11 +780,12 @@ EicAccessCheckResult eicPresentationStartRetrieveEntryValue(
     // additionalData being passed in for every eicPresentationRetrieveEntryValue() call...
     //
     ctx->accessCheckOk = false;
-    if (!eicCborCalcEntryAdditionalData(accessControlProfileIds, numAccessControlProfileIds,
-                                        nameSpace, nameSpaceLength, name, nameLength,
-                                        additionalDataCbor, additionalDataCborBufferSize,
-                                        &additionalDataCborSize,
-                                        ctx->additionalDataSha256)) {
+    if (!eicCborCalcEntryAdditionalDataCached(&ctx->additionalDataCache,
+                                              accessControlProfileIds, numAccessControlProfileIds,
+                                              nameSpace, nameSpaceLength, name, nameLength,
+                                              additionalDataCbor, additionalDataCborBufferSize,
+                                              &additionalDataCborSize,
+                                              ctx->additionalDataSha256)) {
         return EIC_ACCESS_CHECK_RESULT_FAILED;
     }
 
@@ -848,11 +849,12 @@ bool eicPresentationRetrieveEntryValue(EicPresentation* ctx, const uint8_t* encr
     size_t additionalDataCborSize;
 
     uint8_t calculatedSha256[EIC_SHA256_DIGEST_SIZE];
-    if (!eicCborCalcEntryAdditionalData(accessControlProfileIds, numAccessControlProfileIds,
-                                        nameSpace, nameSpaceLength, name, nameLength,
-                                        additionalDataCbor, additionalDataCborBufferSize,
-                                        &additionalDataCborSize,
-                                        calculatedSha256)) {
+    if (!eicCborCalcEntryAdditionalDataCached(&ctx->additionalDataCache,
+                                              accessControlProfileIds, numAccessControlProfileIds,
+                                              nameSpace, nameSpaceLength, name, nameLength,
+                                              additionalDataCbor, additionalDataCborBufferSize,
+                                              &additionalDataCborSize,
+                                              calculatedSha256)) {
         return false;
     }
 
@@ -96,6 +96,9 @@ typedef struct {
     // SHA-256 for AdditionalData, updated for each entry.
     uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE];
 
+    // Digest state of the AdditionalData part shared by entries in the current namespace.
+    EicCborAdditionalDataCache additionalDataCache;
+
     // SHA-256 of ProofOfProvisioning. Set to NUL-bytes or initialized from CredentialKeys data
     // if credential was created with feature version 202101 or later.
     uint8_t proofOfProvisioningSha256[EIC_SHA256_DIGEST_SIZE];
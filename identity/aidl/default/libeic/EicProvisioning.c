@@ -274,10 +274,11 @@ bool eicProvisioningBeginAddEntry(EicProvisioning* ctx, const uint8_t* accessCon
 
     // We'll need to calc and store a digest of additionalData to check that it's the same
     // additionalData being passed in for every eicProvisioningAddEntryValue() call...
-    if (!eicCborCalcEntryAdditionalData(accessControlProfileIds, numAccessControlProfileIds,
-                                        nameSpace, nameSpaceLength, name, nameLength,
-                                        additionalDataCbor, additionalDataCborBufSize,
-                                        &additionalDataCborSize, ctx->additionalDataSha256)) {
+    if (!eicCborCalcEntryAdditionalDataCached(&ctx->additionalDataCache,
+                                              accessControlProfileIds, numAccessControlProfileIds,
+                                              nameSpace, nameSpaceLength, name, nameLength,
+                                              additionalDataCbor, additionalDataCborBufSize,
+                                              &additionalDataCborSize, ctx->additionalDataSha256)) {
         return false;
     }
 
@@ -323,11 +324,12 @@ bool eicProvisioningAddEntryValue(EicProvisioning* ctx, const uint8_t* accessCon
     size_t additionalDataCborSize;
     uint8_t calculatedSha256[EIC_SHA256_DIGEST_SIZE];
 
-    if (!eicCborCalcEntryAdditionalData(accessControlProfileIds, numAccessControlProfileIds,
-                                        nameSpace, nameSpaceLength, name, nameLength,
-                                        additionalDataCbor, additionalDataCborBufSize,
-                                        &additionalDataCborSize,
-                                        calculatedSha256)) {
+    if (!eicCborCalcEntryAdditionalDataCached(&ctx->additionalDataCache,
+                                              accessControlProfileIds, numAccessControlProfileIds,
+                                              nameSpace, nameSpaceLength, name, nameLength,
+                                              additionalDataCbor, additionalDataCborBufSize,
+                                              &additionalDataCborSize,
+                                              calculatedSha256)) {
         return false;
     }
     if (eicCryptoMemCmp(calculatedSha256, ctx->additionalDataSha256, EIC_SHA256_DIGEST_SIZE) != 0) {
@@ -54,6 +54,9 @@ typedef struct {
     // SHA-256 for AdditionalData, updated for each entry.
     uint8_t additionalDataSha256[EIC_SHA256_DIGEST_SIZE];
 
+    // Digest state of the AdditionalData part shared by entries in the current namespace.
+    EicCborAdditionalDataCache additionalDataCache;
+
     // Digester just for ProofOfProvisioning (without Sig_structure).
     EicSha256Ctx proofOfProvisioningDigester;
 
@@ -18,10 +18,16 @@
 #define IDENTITY_SUPPORT_INCLUDE_IDENTITY_CREDENTIAL_UTILS_H_
 
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
 
 #include <cstdint>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -35,6 +41,7 @@ namespace support {
 using ::std::map;
 using ::std::optional;
 using ::std::pair;
+using ::std::span;
 using ::std::string;
 using ::std::tuple;
 using ::std::vector;
@@ -112,6 +119,114 @@ optional<vector<uint8_t>> encryptAes128Gcm(const vector<uint8_t>& key, const vec
                                            const vector<uint8_t>& data,
                                            const vector<uint8_t>& additionalAuthenticatedData);
 
+// Like decryptAes128Gcm() above but writes the plaintext to |data|, which must
+// be exactly kAesGcmIvSize + kAesGcmTagSize bytes smaller than |encryptedData|.
+bool decryptAes128Gcm(span<const uint8_t> key, span<const uint8_t> encryptedData,
+                      span<const uint8_t> additionalAuthenticatedData, span<uint8_t> data);
+
+// Like encryptAes128Gcm() above but writes (nonce || ciphertext || tag) to
+// |encryptedData|, which must be exactly kAesGcmIvSize + kAesGcmTagSize bytes
+// larger than |data|.
+bool encryptAes128Gcm(span<const uint8_t> key, span<const uint8_t> nonce, span<const uint8_t> data,
+                      span<const uint8_t> additionalAuthenticatedData,
+                      span<uint8_t> encryptedData);
+
+// ---------------------------------------------------------------------------
+// Incremental crypto functionality, for data which is produced or consumed in
+// pieces and shouldn't have to be collected in a single buffer first.
+// ---------------------------------------------------------------------------
+
+// Calculates the SHA-256 of all the data passed to update().
+class Sha256 {
+  public:
+    Sha256();
+
+    void update(span<const uint8_t> data);
+
+    // Returns the digest. The object must not be used afterwards.
+    vector<uint8_t> final();
+
+  private:
+    SHA256_CTX ctx_;
+};
+
+// Calculates the HMAC with SHA-256 of all the data passed to update().
+class HmacSha256 {
+  public:
+    static optional<HmacSha256> create(span<const uint8_t> key);
+
+    bool update(span<const uint8_t> data);
+
+    // Returns the 32 bytes HMAC. The object must not be used afterwards.
+    optional<vector<uint8_t>> final();
+
+  private:
+    explicit HmacSha256(bssl::UniquePtr<HMAC_CTX> ctx) : ctx_(std::move(ctx)) {}
+
+    bssl::UniquePtr<HMAC_CTX> ctx_;
+};
+
+// Signs all the data passed to update() with |key|, like signEcDsa().
+class EcDsaSigner {
+  public:
+    // |key| must be in the format returned by ecKeyPairGetPrivateKey().
+    explicit EcDsaSigner(const vector<uint8_t>& key) : key_(key) {}
+
+    void update(span<const uint8_t> data) { digest_.update(data); }
+
+    // Returns the signature in DER format. The object must not be used afterwards.
+    optional<vector<uint8_t>> final();
+
+  private:
+    vector<uint8_t> key_;
+    Sha256 digest_;
+};
+
+// Encrypts data with AES-128-GCM as it's passed to update(). Unlike
+// encryptAes128Gcm(), the nonce and the tag aren't part of the output.
+class Aes128GcmEncrypter {
+  public:
+    static optional<Aes128GcmEncrypter> create(span<const uint8_t> key, span<const uint8_t> nonce,
+                                               span<const uint8_t> additionalAuthenticatedData);
+
+    // Writes the ciphertext for |data| to |encryptedData|, which must be the
+    // same size.
+    bool update(span<const uint8_t> data, span<uint8_t> encryptedData);
+
+    // Writes the kAesGcmTagSize bytes tag to |tag|. The object must not be
+    // used afterwards.
+    bool final(span<uint8_t> tag);
+
+  private:
+    explicit Aes128GcmEncrypter(bssl::UniquePtr<EVP_CIPHER_CTX> ctx) : ctx_(std::move(ctx)) {}
+
+    bssl::UniquePtr<EVP_CIPHER_CTX> ctx_;
+};
+
+// Decrypts data with AES-128-GCM as it's passed to update(). Unlike
+// decryptAes128Gcm(), the nonce and the tag aren't part of the input.
+//
+// The plaintext isn't authenticated until final() succeeds, so it must not be
+// used before that.
+class Aes128GcmDecrypter {
+  public:
+    static optional<Aes128GcmDecrypter> create(span<const uint8_t> key, span<const uint8_t> nonce,
+                                               span<const uint8_t> additionalAuthenticatedData);
+
+    // Writes the plaintext for |encryptedData| to |data|, which must be the
+    // same size.
+    bool update(span<const uint8_t> encryptedData, span<uint8_t> data);
+
+    // Checks that the kAesGcmTagSize bytes |tag| matches the data decrypted so
+    // far. The object must not be used afterwards.
+    bool final(span<const uint8_t> tag);
+
+  private:
+    explicit Aes128GcmDecrypter(bssl::UniquePtr<EVP_CIPHER_CTX> ctx) : ctx_(std::move(ctx)) {}
+
+    bssl::UniquePtr<EVP_CIPHER_CTX> ctx_;
+};
+
 // ---------------------------------------------------------------------------
 // EC crypto functionality / abstraction (only supports P-256).
 // ---------------------------------------------------------------------------
@@ -385,6 +500,90 @@ optional<vector<uint8_t>> coseMac0(const vector<uint8_t>& key, const vector<uint
 optional<vector<uint8_t>> coseMacWithDigest(const vector<uint8_t>& digestToBeMaced,
                                             const vector<uint8_t>& data);
 
+// ---------------------------------------------------------------------------
+// Caching of parsed keys and certificates.
+// ---------------------------------------------------------------------------
+
+// Keeps EC keys and X.509 certificates in parsed form, keyed by the SHA-256 of
+// their encoding, so the same key or certificate passed to the functions below
+// is only parsed once.
+//
+// This is meant to live as long as e.g. a presentation session, during which
+// the same reader and access control profile certificates are used over and
+// over. At most |maxEntries| encodings are kept, the oldest ones are dropped
+// first. It's safe to use from multiple threads.
+//
+class ParsedObjectCache {
+  public:
+    static constexpr size_t kDefaultMaxEntries = 64;
+
+    explicit ParsedObjectCache(size_t maxEntries = kDefaultMaxEntries);
+
+    // Returns the key in |keyPair| (in the format returned by createEcKeyPair())
+    // or nullptr if it can't be parsed.
+    bssl::UniquePtr<EVP_PKEY> ecKeyPair(span<const uint8_t> keyPair);
+
+    // Returns the key in |publicKey| (in the format returned by
+    // ecKeyPairGetPublicKey()) or nullptr if it can't be parsed.
+    bssl::UniquePtr<EVP_PKEY> ecPublicKey(span<const uint8_t> publicKey);
+
+    // Returns the certificates in |certificateChain| (a concatenated chain of
+    // DER-encoded X.509 certificates), or nothing if it can't be parsed. If
+    // |encodedSizes| isn't null, it's set to the size of each certificate in
+    // |certificateChain|.
+    optional<vector<bssl::UniquePtr<X509>>> certificateChain(
+            span<const uint8_t> certificateChain, vector<size_t>* encodedSizes = nullptr);
+
+  private:
+    struct Entry {
+        bssl::UniquePtr<EVP_PKEY> key;
+        vector<bssl::UniquePtr<X509>> certificates;
+        vector<size_t> encodedSizes;
+    };
+
+    // Returns the entry for |encoded| parsed as |kind|, calling |parse| to
+    // create it if it isn't cached. Returns nothing if parsing fails.
+    optional<Entry> lookup(char kind, span<const uint8_t> encoded,
+                           bool (*parse)(span<const uint8_t> encoded, Entry* entry));
+
+    const size_t maxEntries_;
+
+    std::mutex mutex_;
+    // Entries by kind and digest of their encoding.
+    map<vector<uint8_t>, Entry> entries_;
+    // Keys of entries_, oldest first.
+    std::deque<vector<uint8_t>> order_;
+};
+
+// Like the functions of the same name above, but using |cache| to avoid
+// parsing the same keys and certificates repeatedly.
+//
+optional<vector<uint8_t>> ecKeyPairGetPublicKey(const vector<uint8_t>& keyPair,
+                                                ParsedObjectCache& cache);
+
+optional<vector<uint8_t>> ecKeyPairGetPrivateKey(const vector<uint8_t>& keyPair,
+                                                 ParsedObjectCache& cache);
+
+optional<vector<vector<uint8_t>>> certificateChainSplit(const vector<uint8_t>& certificateChain,
+                                                        ParsedObjectCache& cache);
+
+bool certificateChainValidate(const vector<uint8_t>& certificateChain, ParsedObjectCache& cache);
+
+optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& certificateChain,
+                                                        ParsedObjectCache& cache);
+
+optional<pair<size_t, size_t>> certificateFindPublicKey(const vector<uint8_t>& x509Certificate,
+                                                        ParsedObjectCache& cache);
+
+bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
+                                  const vector<uint8_t>& publicKey, ParsedObjectCache& cache);
+
+bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& signature,
+                         const vector<uint8_t>& publicKey, ParsedObjectCache& cache);
+
+optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey, const vector<uint8_t>& privateKey,
+                               ParsedObjectCache& cache);
+
 // ---------------------------------------------------------------------------
 // Utility functions specific to IdentityCredential.
 // ---------------------------------------------------------------------------
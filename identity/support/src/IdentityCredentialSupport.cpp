@@ -24,7 +24,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <time.h>
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <iomanip>
 
 #include <openssl/aes.h>
@@ -428,172 +430,211 @@ optional<vector<uint8_t>> getRandom(size_t numBytes) {
     return output;
 }
 
-optional<vector<uint8_t>> decryptAes128Gcm(const vector<uint8_t>& key,
-                                           const vector<uint8_t>& encryptedData,
-                                           const vector<uint8_t>& additionalAuthenticatedData) {
-    int cipherTextSize = int(encryptedData.size()) - kAesGcmIvSize - kAesGcmTagSize;
-    if (cipherTextSize < 0) {
-        LOG(ERROR) << "encryptedData too small";
-        return {};
+// Sets up |ctx| for AES-128-GCM with |key| and |nonce|, and authenticates
+// |additionalAuthenticatedData|.
+static EvpCipherCtxPtr aes128GcmInit(bool encrypt, span<const uint8_t> key,
+                                     span<const uint8_t> nonce,
+                                     span<const uint8_t> additionalAuthenticatedData) {
+    if (key.size() != kAes128GcmKeySize) {
+        LOG(ERROR) << "key is not kAes128GcmKeySize bytes";
+        return nullptr;
+    }
+    if (nonce.size() != kAesGcmIvSize) {
+        LOG(ERROR) << "nonce is not kAesGcmIvSize bytes";
+        return nullptr;
     }
-    unsigned char* nonce = (unsigned char*)encryptedData.data();
-    unsigned char* cipherText = nonce + kAesGcmIvSize;
-    unsigned char* tag = cipherText + cipherTextSize;
-
-    vector<uint8_t> plainText;
-    plainText.resize(cipherTextSize);
 
     auto ctx = EvpCipherCtxPtr(EVP_CIPHER_CTX_new());
     if (ctx.get() == nullptr) {
         LOG(ERROR) << "EVP_CIPHER_CTX_new: failed";
-        return {};
+        return nullptr;
     }
 
-    if (EVP_DecryptInit_ex(ctx.get(), EVP_aes_128_gcm(), NULL, NULL, NULL) != 1) {
-        LOG(ERROR) << "EVP_DecryptInit_ex: failed";
-        return {};
+    if (EVP_CipherInit_ex(ctx.get(), EVP_aes_128_gcm(), NULL, NULL, NULL, encrypt) != 1) {
+        LOG(ERROR) << "EVP_CipherInit_ex: failed";
+        return nullptr;
     }
 
     if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, kAesGcmIvSize, NULL) != 1) {
         LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting nonce length";
-        return {};
+        return nullptr;
     }
 
-    if (EVP_DecryptInit_ex(ctx.get(), NULL, NULL, (unsigned char*)key.data(), nonce) != 1) {
-        LOG(ERROR) << "EVP_DecryptInit_ex: failed";
-        return {};
+    if (EVP_CipherInit_ex(ctx.get(), NULL, NULL, key.data(), nonce.data(), encrypt) != 1) {
+        LOG(ERROR) << "EVP_CipherInit_ex: failed";
+        return nullptr;
     }
 
     int numWritten;
     if (additionalAuthenticatedData.size() > 0) {
-        if (EVP_DecryptUpdate(ctx.get(), NULL, &numWritten,
-                              (unsigned char*)additionalAuthenticatedData.data(),
-                              additionalAuthenticatedData.size()) != 1) {
-            LOG(ERROR) << "EVP_DecryptUpdate: failed for additionalAuthenticatedData";
-            return {};
+        if (EVP_CipherUpdate(ctx.get(), NULL, &numWritten, additionalAuthenticatedData.data(),
+                             additionalAuthenticatedData.size()) != 1) {
+            LOG(ERROR) << "EVP_CipherUpdate: failed for additionalAuthenticatedData";
+            return nullptr;
         }
         if ((size_t)numWritten != additionalAuthenticatedData.size()) {
-            LOG(ERROR) << "EVP_DecryptUpdate: Unexpected outl=" << numWritten << " (expected "
+            LOG(ERROR) << "EVP_CipherUpdate: Unexpected outl=" << numWritten << " (expected "
                        << additionalAuthenticatedData.size() << ") for additionalAuthenticatedData";
-            return {};
+            return nullptr;
         }
     }
+    return ctx;
+}
 
-    if (EVP_DecryptUpdate(ctx.get(), (unsigned char*)plainText.data(), &numWritten, cipherText,
-                          cipherTextSize) != 1) {
-        LOG(ERROR) << "EVP_DecryptUpdate: failed";
-        return {};
-    }
-    if (numWritten != cipherTextSize) {
-        LOG(ERROR) << "EVP_DecryptUpdate: Unexpected outl=" << numWritten << " (expected "
-                   << cipherTextSize << ")";
-        return {};
+// Runs |in| through |ctx| into |out|, which must be the same size.
+static bool aes128GcmUpdate(EVP_CIPHER_CTX* ctx, span<const uint8_t> in, span<uint8_t> out) {
+    if (out.size() != in.size()) {
+        LOG(ERROR) << "Output is " << out.size() << " bytes, expected " << in.size();
+        return false;
     }
+    if (in.size() == 0) return true;
 
-    if (!EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, kAesGcmTagSize, tag)) {
-        LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting expected tag";
-        return {};
+    int numWritten;
+    if (EVP_CipherUpdate(ctx, out.data(), &numWritten, in.data(), in.size()) != 1) {
+        LOG(ERROR) << "EVP_CipherUpdate: failed";
+        return false;
+    }
+    if ((size_t)numWritten != in.size()) {
+        LOG(ERROR) << "EVP_CipherUpdate: Unexpected outl=" << numWritten << " (expected "
+                   << in.size() << ")";
+        return false;
     }
+    return true;
+}
 
-    int ret = EVP_DecryptFinal_ex(ctx.get(), (unsigned char*)plainText.data() + numWritten,
-                                  &numWritten);
-    if (ret != 1) {
-        LOG(ERROR) << "EVP_DecryptFinal_ex: failed";
-        return {};
+// Finishes the operation on |ctx|, which being a stream cipher produces no
+// more output.
+static bool aes128GcmFinal(EVP_CIPHER_CTX* ctx) {
+    uint8_t unused[EVP_MAX_BLOCK_LENGTH];
+    int numWritten;
+    if (EVP_CipherFinal_ex(ctx, unused, &numWritten) != 1) {
+        LOG(ERROR) << "EVP_CipherFinal_ex: failed";
+        return false;
     }
     if (numWritten != 0) {
-        LOG(ERROR) << "EVP_DecryptFinal_ex: Unexpected non-zero outl=" << numWritten;
-        return {};
+        LOG(ERROR) << "EVP_CipherFinal_ex: Unexpected non-zero outl=" << numWritten;
+        return false;
     }
+    return true;
+}
 
-    return plainText;
+optional<Aes128GcmEncrypter> Aes128GcmEncrypter::create(
+        span<const uint8_t> key, span<const uint8_t> nonce,
+        span<const uint8_t> additionalAuthenticatedData) {
+    auto ctx = aes128GcmInit(true /* encrypt */, key, nonce, additionalAuthenticatedData);
+    if (ctx.get() == nullptr) return {};
+    return Aes128GcmEncrypter(std::move(ctx));
 }
 
-optional<vector<uint8_t>> encryptAes128Gcm(const vector<uint8_t>& key, const vector<uint8_t>& nonce,
-                                           const vector<uint8_t>& data,
-                                           const vector<uint8_t>& additionalAuthenticatedData) {
-    if (key.size() != kAes128GcmKeySize) {
-        LOG(ERROR) << "key is not kAes128GcmKeySize bytes";
-        return {};
+bool Aes128GcmEncrypter::update(span<const uint8_t> data, span<uint8_t> encryptedData) {
+    return aes128GcmUpdate(ctx_.get(), data, encryptedData);
+}
+
+bool Aes128GcmEncrypter::final(span<uint8_t> tag) {
+    if (tag.size() != kAesGcmTagSize) {
+        LOG(ERROR) << "tag is not kAesGcmTagSize bytes";
+        return false;
     }
-    if (nonce.size() != kAesGcmIvSize) {
-        LOG(ERROR) << "nonce is not kAesGcmIvSize bytes";
-        return {};
+    if (!aes128GcmFinal(ctx_.get())) return false;
+
+    if (EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_GCM_GET_TAG, kAesGcmTagSize, tag.data()) != 1) {
+        LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed getting tag";
+        return false;
     }
+    return true;
+}
 
-    // The result is the nonce (kAesGcmIvSize bytes), the ciphertext, and
-    // finally the tag (kAesGcmTagSize bytes).
-    vector<uint8_t> encryptedData;
-    encryptedData.resize(data.size() + kAesGcmIvSize + kAesGcmTagSize);
-    unsigned char* noncePtr = (unsigned char*)encryptedData.data();
-    unsigned char* cipherText = noncePtr + kAesGcmIvSize;
-    unsigned char* tag = cipherText + data.size();
-    memcpy(noncePtr, nonce.data(), kAesGcmIvSize);
+optional<Aes128GcmDecrypter> Aes128GcmDecrypter::create(
+        span<const uint8_t> key, span<const uint8_t> nonce,
+        span<const uint8_t> additionalAuthenticatedData) {
+    auto ctx = aes128GcmInit(false /* encrypt */, key, nonce, additionalAuthenticatedData);
+    if (ctx.get() == nullptr) return {};
+    return Aes128GcmDecrypter(std::move(ctx));
+}
 
-    auto ctx = EvpCipherCtxPtr(EVP_CIPHER_CTX_new());
-    if (ctx.get() == nullptr) {
-        LOG(ERROR) << "EVP_CIPHER_CTX_new: failed";
-        return {};
+bool Aes128GcmDecrypter::update(span<const uint8_t> encryptedData, span<uint8_t> data) {
+    return aes128GcmUpdate(ctx_.get(), encryptedData, data);
+}
+
+bool Aes128GcmDecrypter::final(span<const uint8_t> tag) {
+    if (tag.size() != kAesGcmTagSize) {
+        LOG(ERROR) << "tag is not kAesGcmTagSize bytes";
+        return false;
+    }
+    if (!EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_GCM_SET_TAG, kAesGcmTagSize,
+                             const_cast<uint8_t*>(tag.data()))) {
+        LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting expected tag";
+        return false;
     }
+    return aes128GcmFinal(ctx_.get());
+}
 
-    if (EVP_EncryptInit_ex(ctx.get(), EVP_aes_128_gcm(), NULL, NULL, NULL) != 1) {
-        LOG(ERROR) << "EVP_EncryptInit_ex: failed";
-        return {};
+bool decryptAes128Gcm(span<const uint8_t> key, span<const uint8_t> encryptedData,
+                      span<const uint8_t> additionalAuthenticatedData, span<uint8_t> data) {
+    if (encryptedData.size() < kAesGcmIvSize + kAesGcmTagSize) {
+        LOG(ERROR) << "encryptedData too small";
+        return false;
     }
+    span<const uint8_t> nonce = encryptedData.first(kAesGcmIvSize);
+    span<const uint8_t> cipherText = encryptedData.subspan(
+            kAesGcmIvSize, encryptedData.size() - kAesGcmIvSize - kAesGcmTagSize);
+    span<const uint8_t> tag = encryptedData.last(kAesGcmTagSize);
 
-    if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, kAesGcmIvSize, NULL) != 1) {
-        LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting nonce length";
-        return {};
+    optional<Aes128GcmDecrypter> decrypter =
+            Aes128GcmDecrypter::create(key, nonce, additionalAuthenticatedData);
+    if (!decrypter) {
+        return false;
     }
+    return decrypter->update(cipherText, data) && decrypter->final(tag);
+}
 
-    if (EVP_EncryptInit_ex(ctx.get(), NULL, NULL, (unsigned char*)key.data(),
-                           (unsigned char*)nonce.data()) != 1) {
-        LOG(ERROR) << "EVP_EncryptInit_ex: failed";
+optional<vector<uint8_t>> decryptAes128Gcm(const vector<uint8_t>& key,
+                                           const vector<uint8_t>& encryptedData,
+                                           const vector<uint8_t>& additionalAuthenticatedData) {
+    if (encryptedData.size() < kAesGcmIvSize + kAesGcmTagSize) {
+        LOG(ERROR) << "encryptedData too small";
         return {};
     }
-
-    int numWritten;
-    if (additionalAuthenticatedData.size() > 0) {
-        if (EVP_EncryptUpdate(ctx.get(), NULL, &numWritten,
-                              (unsigned char*)additionalAuthenticatedData.data(),
-                              additionalAuthenticatedData.size()) != 1) {
-            LOG(ERROR) << "EVP_EncryptUpdate: failed for additionalAuthenticatedData";
-            return {};
-        }
-        if ((size_t)numWritten != additionalAuthenticatedData.size()) {
-            LOG(ERROR) << "EVP_EncryptUpdate: Unexpected outl=" << numWritten << " (expected "
-                       << additionalAuthenticatedData.size() << ") for additionalAuthenticatedData";
-            return {};
-        }
+    vector<uint8_t> plainText;
+    plainText.resize(encryptedData.size() - kAesGcmIvSize - kAesGcmTagSize);
+    if (!decryptAes128Gcm(span<const uint8_t>(key), encryptedData, additionalAuthenticatedData,
+                          plainText)) {
+        return {};
     }
+    return plainText;
+}
 
-    if (data.size() > 0) {
-        if (EVP_EncryptUpdate(ctx.get(), cipherText, &numWritten, (unsigned char*)data.data(),
-                              data.size()) != 1) {
-            LOG(ERROR) << "EVP_EncryptUpdate: failed";
-            return {};
-        }
-        if ((size_t)numWritten != data.size()) {
-            LOG(ERROR) << "EVP_EncryptUpdate: Unexpected outl=" << numWritten << " (expected "
-                       << data.size() << ")";
-            return {};
-        }
+bool encryptAes128Gcm(span<const uint8_t> key, span<const uint8_t> nonce, span<const uint8_t> data,
+                      span<const uint8_t> additionalAuthenticatedData,
+                      span<uint8_t> encryptedData) {
+    if (encryptedData.size() != data.size() + kAesGcmIvSize + kAesGcmTagSize) {
+        LOG(ERROR) << "encryptedData is " << encryptedData.size() << " bytes, expected "
+                   << data.size() + kAesGcmIvSize + kAesGcmTagSize;
+        return false;
     }
 
-    if (EVP_EncryptFinal_ex(ctx.get(), cipherText + numWritten, &numWritten) != 1) {
-        LOG(ERROR) << "EVP_EncryptFinal_ex: failed";
-        return {};
-    }
-    if (numWritten != 0) {
-        LOG(ERROR) << "EVP_EncryptFinal_ex: Unexpected non-zero outl=" << numWritten;
-        return {};
+    optional<Aes128GcmEncrypter> encrypter =
+            Aes128GcmEncrypter::create(key, nonce, additionalAuthenticatedData);
+    if (!encrypter) {
+        return false;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, kAesGcmTagSize, tag) != 1) {
-        LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed getting tag";
+    // The result is the nonce (kAesGcmIvSize bytes), the ciphertext, and
+    // finally the tag (kAesGcmTagSize bytes).
+    memcpy(encryptedData.data(), nonce.data(), kAesGcmIvSize);
+    return encrypter->update(data, encryptedData.subspan(kAesGcmIvSize, data.size())) &&
+           encrypter->final(encryptedData.last(kAesGcmTagSize));
+}
+
+optional<vector<uint8_t>> encryptAes128Gcm(const vector<uint8_t>& key, const vector<uint8_t>& nonce,
+                                           const vector<uint8_t>& data,
+                                           const vector<uint8_t>& additionalAuthenticatedData) {
+    vector<uint8_t> encryptedData;
+    encryptedData.resize(data.size() + kAesGcmIvSize + kAesGcmTagSize);
+    if (!encryptAes128Gcm(span<const uint8_t>(key), nonce, data, additionalAuthenticatedData,
+                          encryptedData)) {
         return {};
     }
-
     return encryptedData;
 }
 
@@ -625,54 +666,68 @@ optional<vector<vector<uint8_t>>> certificateChainSplit(const vector<uint8_t>& c
     return certificates;
 }
 
-static bool parseX509Certificates(const vector<uint8_t>& certificateChain,
-                                  vector<X509_Ptr>& parsedCertificates) {
+static bool parseX509Certificates(span<const uint8_t> certificateChain,
+                                  vector<X509_Ptr>& parsedCertificates,
+                                  vector<size_t>* encodedSizes = nullptr) {
     const unsigned char* p = (unsigned char*)certificateChain.data();
     const unsigned char* pEnd = p + certificateChain.size();
     parsedCertificates.resize(0);
+    if (encodedSizes != nullptr) encodedSizes->resize(0);
     while (p < pEnd) {
+        const unsigned char* pBegin = p;
         auto x509 = X509_Ptr(d2i_X509(nullptr, &p, pEnd - p));
         if (x509 == nullptr) {
             LOG(ERROR) << "Error parsing X509 certificate";
             return false;
         }
         parsedCertificates.push_back(std::move(x509));
+        if (encodedSizes != nullptr) encodedSizes->push_back(p - pBegin);
     }
     return true;
 }
 
-bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
-                                  const vector<uint8_t>& publicKey) {
-    const unsigned char* p = certificate.data();
-    auto x509 = X509_Ptr(d2i_X509(nullptr, &p, certificate.size()));
-    if (x509 == nullptr) {
-        LOG(ERROR) << "Error parsing X509 certificate";
-        return false;
-    }
-
+// Returns an EVP_PKEY for |publicKey|, which must be in the format returned by
+// ecKeyPairGetPublicKey().
+static EVP_PKEY_Ptr parseEcPublicKey(span<const uint8_t> publicKey) {
     auto group = EC_GROUP_Ptr(EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1));
     auto point = EC_POINT_Ptr(EC_POINT_new(group.get()));
     if (EC_POINT_oct2point(group.get(), point.get(), publicKey.data(), publicKey.size(), nullptr) !=
         1) {
         LOG(ERROR) << "Error decoding publicKey";
-        return false;
+        return nullptr;
     }
     auto ecKey = EC_KEY_Ptr(EC_KEY_new());
     auto pkey = EVP_PKEY_Ptr(EVP_PKEY_new());
     if (ecKey.get() == nullptr || pkey.get() == nullptr) {
         LOG(ERROR) << "Memory allocation failed";
-        return false;
+        return nullptr;
     }
     if (EC_KEY_set_group(ecKey.get(), group.get()) != 1) {
         LOG(ERROR) << "Error setting group";
-        return false;
+        return nullptr;
     }
     if (EC_KEY_set_public_key(ecKey.get(), point.get()) != 1) {
         LOG(ERROR) << "Error setting point";
-        return false;
+        return nullptr;
     }
     if (EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get()) != 1) {
         LOG(ERROR) << "Error setting key";
+        return nullptr;
+    }
+    return pkey;
+}
+
+bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
+                                  const vector<uint8_t>& publicKey) {
+    const unsigned char* p = certificate.data();
+    auto x509 = X509_Ptr(d2i_X509(nullptr, &p, certificate.size()));
+    if (x509 == nullptr) {
+        LOG(ERROR) << "Error parsing X509 certificate";
+        return false;
+    }
+
+    auto pkey = parseEcPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
         return false;
     }
 
@@ -689,14 +744,7 @@ bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
 //
 //       It would be nice to use X509_verify_cert() instead of doing our own thing.
 //
-bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
-    vector<X509_Ptr> certs;
-
-    if (!parseX509Certificates(certificateChain, certs)) {
-        LOG(ERROR) << "Error parsing X509 certificates";
-        return false;
-    }
-
+static bool certificateChainValidate(const vector<X509_Ptr>& certs) {
     if (certs.size() == 1) {
         return true;
     }
@@ -715,8 +763,19 @@ bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
     return true;
 }
 
-bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& signature,
-                         const vector<uint8_t>& publicKey) {
+bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
+    vector<X509_Ptr> certs;
+
+    if (!parseX509Certificates(certificateChain, certs)) {
+        LOG(ERROR) << "Error parsing X509 certificates";
+        return false;
+    }
+
+    return certificateChainValidate(certs);
+}
+
+static bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& signature,
+                                EVP_PKEY* publicKey) {
     const unsigned char* p = (unsigned char*)signature.data();
     auto sig = ECDSA_SIG_Ptr(d2i_ECDSA_SIG(nullptr, &p, signature.size()));
     if (sig.get() == nullptr) {
@@ -724,33 +783,8 @@ bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& s
         return false;
     }
 
-    auto group = EC_GROUP_Ptr(EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1));
-    auto point = EC_POINT_Ptr(EC_POINT_new(group.get()));
-    if (EC_POINT_oct2point(group.get(), point.get(), publicKey.data(), publicKey.size(), nullptr) !=
-        1) {
-        LOG(ERROR) << "Error decoding publicKey";
-        return false;
-    }
-    auto ecKey = EC_KEY_Ptr(EC_KEY_new());
-    auto pkey = EVP_PKEY_Ptr(EVP_PKEY_new());
-    if (ecKey.get() == nullptr || pkey.get() == nullptr) {
-        LOG(ERROR) << "Memory allocation failed";
-        return false;
-    }
-    if (EC_KEY_set_group(ecKey.get(), group.get()) != 1) {
-        LOG(ERROR) << "Error setting group";
-        return false;
-    }
-    if (EC_KEY_set_public_key(ecKey.get(), point.get()) != 1) {
-        LOG(ERROR) << "Error setting point";
-        return false;
-    }
-    if (EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get()) != 1) {
-        LOG(ERROR) << "Error setting key";
-        return false;
-    }
-
-    int rc = ECDSA_do_verify(digest.data(), digest.size(), sig.get(), ecKey.get());
+    int rc = ECDSA_do_verify(digest.data(), digest.size(), sig.get(),
+                             EVP_PKEY_get0_EC_KEY(publicKey));
     if (rc != 1) {
         LOG(ERROR) << "Error verifying signature (rc=" << rc << ")";
         return false;
@@ -759,16 +793,36 @@ bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& s
     return true;
 }
 
-vector<uint8_t> sha256(const vector<uint8_t>& data) {
+bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& signature,
+                         const vector<uint8_t>& publicKey) {
+    auto pkey = parseEcPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
+        return false;
+    }
+    return checkEcDsaSignature(digest, signature, pkey.get());
+}
+
+Sha256::Sha256() {
+    SHA256_Init(&ctx_);
+}
+
+void Sha256::update(span<const uint8_t> data) {
+    SHA256_Update(&ctx_, data.data(), data.size());
+}
+
+vector<uint8_t> Sha256::final() {
     vector<uint8_t> ret;
     ret.resize(SHA256_DIGEST_LENGTH);
-    SHA256_CTX ctx;
-    SHA256_Init(&ctx);
-    SHA256_Update(&ctx, data.data(), data.size());
-    SHA256_Final((unsigned char*)ret.data(), &ctx);
+    SHA256_Final((unsigned char*)ret.data(), &ctx_);
     return ret;
 }
 
+vector<uint8_t> sha256(const vector<uint8_t>& data) {
+    Sha256 digest;
+    digest.update(data);
+    return digest.final();
+}
+
 optional<vector<uint8_t>> signEcDsaDigest(const vector<uint8_t>& key,
                                           const vector<uint8_t>& dataDigest) {
     auto bn = BIGNUM_Ptr(BN_bin2bn(key.data(), key.size(), nullptr));
@@ -797,25 +851,40 @@ optional<vector<uint8_t>> signEcDsaDigest(const vector<uint8_t>& key,
     return signature;
 }
 
+optional<vector<uint8_t>> EcDsaSigner::final() {
+    return signEcDsaDigest(key_, digest_.final());
+}
+
 optional<vector<uint8_t>> signEcDsa(const vector<uint8_t>& key, const vector<uint8_t>& data) {
     return signEcDsaDigest(key, sha256(data));
 }
 
-optional<vector<uint8_t>> hmacSha256(const vector<uint8_t>& key, const vector<uint8_t>& data) {
-    HMAC_CTX ctx;
-    HMAC_CTX_init(&ctx);
-    if (HMAC_Init_ex(&ctx, key.data(), key.size(), EVP_sha256(), nullptr /* impl */) != 1) {
+optional<HmacSha256> HmacSha256::create(span<const uint8_t> key) {
+    auto ctx = bssl::UniquePtr<HMAC_CTX>(HMAC_CTX_new());
+    if (ctx.get() == nullptr) {
+        LOG(ERROR) << "Error allocating HMAC_CTX";
+        return {};
+    }
+    if (HMAC_Init_ex(ctx.get(), key.data(), key.size(), EVP_sha256(), nullptr /* impl */) != 1) {
         LOG(ERROR) << "Error initializing HMAC_CTX";
         return {};
     }
-    if (HMAC_Update(&ctx, data.data(), data.size()) != 1) {
+    return HmacSha256(std::move(ctx));
+}
+
+bool HmacSha256::update(span<const uint8_t> data) {
+    if (HMAC_Update(ctx_.get(), data.data(), data.size()) != 1) {
         LOG(ERROR) << "Error updating HMAC_CTX";
-        return {};
+        return false;
     }
+    return true;
+}
+
+optional<vector<uint8_t>> HmacSha256::final() {
     vector<uint8_t> hmac;
     hmac.resize(32);
     unsigned int size = 0;
-    if (HMAC_Final(&ctx, hmac.data(), &size) != 1) {
+    if (HMAC_Final(ctx_.get(), hmac.data(), &size) != 1) {
         LOG(ERROR) << "Error finalizing HMAC_CTX";
         return {};
     }
@@ -826,6 +895,14 @@ optional<vector<uint8_t>> hmacSha256(const vector<uint8_t>& key, const vector<ui
     return hmac;
 }
 
+optional<vector<uint8_t>> hmacSha256(const vector<uint8_t>& key, const vector<uint8_t>& data) {
+    optional<HmacSha256> hmac = HmacSha256::create(key);
+    if (!hmac || !hmac->update(data)) {
+        return {};
+    }
+    return hmac->final();
+}
+
 optional<std::pair<vector<uint8_t>, vector<vector<uint8_t>>>> createEcKeyPairAndAttestation(
         const vector<uint8_t>& challenge, const vector<uint8_t>& applicationId,
         bool isTestCredential) {
@@ -974,22 +1051,27 @@ optional<vector<uint8_t>> createEcKeyPair() {
     return keyPair;
 }
 
-optional<vector<uint8_t>> ecKeyPairGetPublicKey(const vector<uint8_t>& keyPair) {
+// Returns an EVP_PKEY for |keyPair|, which must be in the format returned by
+// createEcKeyPair().
+static EVP_PKEY_Ptr parseEcKeyPair(span<const uint8_t> keyPair) {
     const unsigned char* p = (const unsigned char*)keyPair.data();
     auto pkey = EVP_PKEY_Ptr(d2i_PrivateKey(EVP_PKEY_EC, nullptr, &p, keyPair.size()));
     if (pkey.get() == nullptr) {
         LOG(ERROR) << "Error parsing keyPair";
-        return {};
     }
+    return pkey;
+}
 
-    auto ecKey = EC_KEY_Ptr(EVP_PKEY_get1_EC_KEY(pkey.get()));
-    if (ecKey.get() == nullptr) {
+// Returns the public key of |pkey| in uncompressed point form.
+static optional<vector<uint8_t>> ecKeyGetPublicKey(EVP_PKEY* pkey) {
+    const EC_KEY* ecKey = EVP_PKEY_get0_EC_KEY(pkey);
+    if (ecKey == nullptr) {
         LOG(ERROR) << "Failed getting EC key";
         return {};
     }
 
-    auto ecGroup = EC_KEY_get0_group(ecKey.get());
-    auto ecPoint = EC_KEY_get0_public_key(ecKey.get());
+    auto ecGroup = EC_KEY_get0_group(ecKey);
+    auto ecPoint = EC_KEY_get0_public_key(ecKey);
     int size = EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, nullptr, 0,
                                   nullptr);
     if (size == 0) {
@@ -1004,21 +1086,15 @@ optional<vector<uint8_t>> ecKeyPairGetPublicKey(const vector<uint8_t>& keyPair)
     return publicKey;
 }
 
-optional<vector<uint8_t>> ecKeyPairGetPrivateKey(const vector<uint8_t>& keyPair) {
-    const unsigned char* p = (const unsigned char*)keyPair.data();
-    auto pkey = EVP_PKEY_Ptr(d2i_PrivateKey(EVP_PKEY_EC, nullptr, &p, keyPair.size()));
-    if (pkey.get() == nullptr) {
-        LOG(ERROR) << "Error parsing keyPair";
-        return {};
-    }
-
-    auto ecKey = EC_KEY_Ptr(EVP_PKEY_get1_EC_KEY(pkey.get()));
-    if (ecKey.get() == nullptr) {
+// Returns the private key of |pkey| as 32 bytes.
+static optional<vector<uint8_t>> ecKeyGetPrivateKey(EVP_PKEY* pkey) {
+    const EC_KEY* ecKey = EVP_PKEY_get0_EC_KEY(pkey);
+    if (ecKey == nullptr) {
         LOG(ERROR) << "Failed getting EC key";
         return {};
     }
 
-    const BIGNUM* bignum = EC_KEY_get0_private_key(ecKey.get());
+    const BIGNUM* bignum = EC_KEY_get0_private_key(ecKey);
     if (bignum == nullptr) {
         LOG(ERROR) << "Error getting bignum from private key";
         return {};
@@ -1040,6 +1116,22 @@ optional<vector<uint8_t>> ecKeyPairGetPrivateKey(const vector<uint8_t>& keyPair)
     return privateKey;
 }
 
+optional<vector<uint8_t>> ecKeyPairGetPublicKey(const vector<uint8_t>& keyPair) {
+    auto pkey = parseEcKeyPair(keyPair);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecKeyGetPublicKey(pkey.get());
+}
+
+optional<vector<uint8_t>> ecKeyPairGetPrivateKey(const vector<uint8_t>& keyPair) {
+    auto pkey = parseEcKeyPair(keyPair);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecKeyGetPrivateKey(pkey.get());
+}
+
 optional<vector<uint8_t>> ecPrivateKeyToKeyPair(const vector<uint8_t>& privateKey) {
     auto bn = BIGNUM_Ptr(BN_bin2bn(privateKey.data(), privateKey.size(), nullptr));
     if (bn.get() == nullptr) {
@@ -1350,34 +1442,7 @@ optional<vector<uint8_t>> ecPublicKeyGenerateCertificate(
     return certificate;
 }
 
-optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey,
-                               const vector<uint8_t>& privateKey) {
-    auto group = EC_GROUP_Ptr(EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1));
-    auto point = EC_POINT_Ptr(EC_POINT_new(group.get()));
-    if (EC_POINT_oct2point(group.get(), point.get(), publicKey.data(), publicKey.size(), nullptr) !=
-        1) {
-        LOG(ERROR) << "Error decoding publicKey";
-        return {};
-    }
-    auto ecKey = EC_KEY_Ptr(EC_KEY_new());
-    auto pkey = EVP_PKEY_Ptr(EVP_PKEY_new());
-    if (ecKey.get() == nullptr || pkey.get() == nullptr) {
-        LOG(ERROR) << "Memory allocation failed";
-        return {};
-    }
-    if (EC_KEY_set_group(ecKey.get(), group.get()) != 1) {
-        LOG(ERROR) << "Error setting group";
-        return {};
-    }
-    if (EC_KEY_set_public_key(ecKey.get(), point.get()) != 1) {
-        LOG(ERROR) << "Error setting point";
-        return {};
-    }
-    if (EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get()) != 1) {
-        LOG(ERROR) << "Error setting key";
-        return {};
-    }
-
+static optional<vector<uint8_t>> ecdh(EVP_PKEY* publicKey, const vector<uint8_t>& privateKey) {
     auto bn = BIGNUM_Ptr(BN_bin2bn(privateKey.data(), privateKey.size(), nullptr));
     if (bn.get() == nullptr) {
         LOG(ERROR) << "Error creating BIGNUM for private key";
@@ -1405,7 +1470,7 @@ optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey,
         return {};
     }
 
-    if (EVP_PKEY_derive_set_peer(ctx.get(), pkey.get()) != 1) {
+    if (EVP_PKEY_derive_set_peer(ctx.get(), publicKey) != 1) {
         LOG(ERROR) << "Error setting peer";
         return {};
     }
@@ -1426,6 +1491,15 @@ optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey,
     return sharedSecret;
 }
 
+optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey,
+                               const vector<uint8_t>& privateKey) {
+    auto pkey = parseEcPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecdh(pkey.get(), privateKey);
+}
+
 optional<vector<uint8_t>> hkdf(const vector<uint8_t>& sharedSecret, const vector<uint8_t>& salt,
                                const vector<uint8_t>& info, size_t size) {
     vector<uint8_t> derivedKey;
@@ -1462,41 +1536,26 @@ tuple<bool, vector<uint8_t>, vector<uint8_t>> ecPublicKeyGetXandY(
     return std::make_tuple(true, x, y);
 }
 
-optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& certificateChain) {
-    vector<X509_Ptr> certs;
-    if (!parseX509Certificates(certificateChain, certs)) {
-        return {};
-    }
-    if (certs.size() < 1) {
-        LOG(ERROR) << "No certificates in chain";
-        return {};
-    }
-
-    auto pkey = EVP_PKEY_Ptr(X509_get_pubkey(certs[0].get()));
+// Returns the public key of |x509| in uncompressed point form.
+static optional<vector<uint8_t>> certificateGetPublicKey(X509* x509) {
+    auto pkey = EVP_PKEY_Ptr(X509_get_pubkey(x509));
     if (pkey.get() == nullptr) {
         LOG(ERROR) << "No public key";
         return {};
     }
+    return ecKeyGetPublicKey(pkey.get());
+}
 
-    auto ecKey = EC_KEY_Ptr(EVP_PKEY_get1_EC_KEY(pkey.get()));
-    if (ecKey.get() == nullptr) {
-        LOG(ERROR) << "Failed getting EC key";
+optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& certificateChain) {
+    vector<X509_Ptr> certs;
+    if (!parseX509Certificates(certificateChain, certs)) {
         return {};
     }
-
-    auto ecGroup = EC_KEY_get0_group(ecKey.get());
-    auto ecPoint = EC_KEY_get0_public_key(ecKey.get());
-    int size = EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, nullptr, 0,
-                                  nullptr);
-    if (size == 0) {
-        LOG(ERROR) << "Error generating public key encoding";
+    if (certs.size() < 1) {
+        LOG(ERROR) << "No certificates in chain";
         return {};
     }
-    vector<uint8_t> publicKey;
-    publicKey.resize(size);
-    EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, publicKey.data(),
-                       publicKey.size(), nullptr);
-    return publicKey;
+    return certificateGetPublicKey(certs[0].get());
 }
 
 optional<vector<uint8_t>> certificateGetExtension(const vector<uint8_t>& x509Certificate,
@@ -1537,45 +1596,18 @@ optional<vector<uint8_t>> certificateGetExtension(const vector<uint8_t>& x509Cer
     return result;
 }
 
-optional<pair<size_t, size_t>> certificateFindPublicKey(const vector<uint8_t>& x509Certificate) {
-    vector<X509_Ptr> certs;
-    if (!parseX509Certificates(x509Certificate, certs)) {
-        return {};
-    }
-    if (certs.size() < 1) {
-        LOG(ERROR) << "No certificates in chain";
-        return {};
-    }
-
-    auto pkey = EVP_PKEY_Ptr(X509_get_pubkey(certs[0].get()));
-    if (pkey.get() == nullptr) {
-        LOG(ERROR) << "No public key";
-        return {};
-    }
-
-    auto ecKey = EC_KEY_Ptr(EVP_PKEY_get1_EC_KEY(pkey.get()));
-    if (ecKey.get() == nullptr) {
-        LOG(ERROR) << "Failed getting EC key";
-        return {};
-    }
-
-    auto ecGroup = EC_KEY_get0_group(ecKey.get());
-    auto ecPoint = EC_KEY_get0_public_key(ecKey.get());
-    int size = EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, nullptr, 0,
-                                  nullptr);
-    if (size == 0) {
-        LOG(ERROR) << "Error generating public key encoding";
+// Like certificateFindPublicKey() with |x509| being the parsed |x509Certificate|.
+static optional<pair<size_t, size_t>> certificateFindPublicKey(
+        const vector<uint8_t>& x509Certificate, X509* x509) {
+    optional<vector<uint8_t>> publicKey = certificateGetPublicKey(x509);
+    if (!publicKey) {
         return {};
     }
-    vector<uint8_t> publicKey;
-    publicKey.resize(size);
-    EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, publicKey.data(),
-                       publicKey.size(), nullptr);
 
     size_t publicKeyOffset = 0;
-    size_t publicKeySize = (size_t)size;
+    size_t publicKeySize = publicKey.value().size();
     void* location = memmem((const void*)x509Certificate.data(), x509Certificate.size(),
-                            (const void*)publicKey.data(), publicKey.size());
+                            (const void*)publicKey.value().data(), publicKey.value().size());
 
     if (location == NULL) {
         LOG(ERROR) << "Error finding publicKey from x509Certificate";
@@ -1586,6 +1618,18 @@ optional<pair<size_t, size_t>> certificateFindPublicKey(const vector<uint8_t>& x
     return std::make_pair(publicKeyOffset, publicKeySize);
 }
 
+optional<pair<size_t, size_t>> certificateFindPublicKey(const vector<uint8_t>& x509Certificate) {
+    vector<X509_Ptr> certs;
+    if (!parseX509Certificates(x509Certificate, certs)) {
+        return {};
+    }
+    if (certs.size() < 1) {
+        LOG(ERROR) << "No certificates in chain";
+        return {};
+    }
+    return certificateFindPublicKey(x509Certificate, certs[0].get());
+}
+
 optional<pair<size_t, size_t>> certificateTbsCertificate(const vector<uint8_t>& x509Certificate) {
     vector<X509_Ptr> certs;
     if (!parseX509Certificates(x509Certificate, certs)) {
@@ -1681,27 +1725,33 @@ optional<pair<size_t, size_t>> certificateFindSignature(const vector<uint8_t>& x
 // COSE Utility Functions
 // ---------------------------------------------------------------------------
 
-vector<uint8_t> coseBuildToBeSigned(const vector<uint8_t>& encodedProtectedHeaders,
-                                    const vector<uint8_t>& data,
-                                    const vector<uint8_t>& detachedContent) {
-    cppbor::Array sigStructure;
-    sigStructure.add("Signature1");
-    sigStructure.add(encodedProtectedHeaders);
+// Passes the CBOR encoding of the Sig_structure or MAC_structure (RFC 8152
+// sections 4.4 and 6.3) with the given |context| to |update|, piece by piece,
+// so the payload never has to be copied into the structure.
+static void coseFeedToBeSigned(const string& context,
+                               const vector<uint8_t>& encodedProtectedHeaders,
+                               span<const uint8_t> payload,
+                               const std::function<void(span<const uint8_t>)>& update) {
+    uint8_t header[9];
+    auto feedHeader = [&](cppbor::MajorType type, uint64_t addlInfo) {
+        uint8_t* end = cppbor::encodeHeader(type, addlInfo, header, header + sizeof(header));
+        update(span<const uint8_t>(header, end));
+    };
+
+    feedHeader(cppbor::ARRAY, 4);
+    feedHeader(cppbor::TSTR, context.size());
+    update(span<const uint8_t>((const uint8_t*)context.data(), context.size()));
+    feedHeader(cppbor::BSTR, encodedProtectedHeaders.size());
+    update(encodedProtectedHeaders);
 
     // We currently don't support Externally Supplied Data (RFC 8152 section 4.3)
     // so external_aad is the empty bstr
-    vector<uint8_t> emptyExternalAad;
-    sigStructure.add(emptyExternalAad);
+    feedHeader(cppbor::BSTR, 0);
 
     // Next field is the payload, independently of how it's transported (RFC
-    // 8152 section 4.4). Since our API specifies only one of |data| and
-    // |detachedContent| can be non-empty, it's simply just the non-empty one.
-    if (data.size() > 0) {
-        sigStructure.add(data);
-    } else {
-        sigStructure.add(detachedContent);
-    }
-    return sigStructure.encode();
+    // 8152 section 4.4).
+    feedHeader(cppbor::BSTR, payload.size());
+    update(payload);
 }
 
 vector<uint8_t> coseEncodeHeaders(const cppbor::Map& protectedHeaders) {
@@ -1854,10 +1904,15 @@ optional<vector<uint8_t>> coseSignEcDsa(const vector<uint8_t>& key, const vector
     }
 
     vector<uint8_t> encodedProtectedHeaders = coseEncodeHeaders(protectedHeaders);
-    vector<uint8_t> toBeSigned =
-            coseBuildToBeSigned(encodedProtectedHeaders, data, detachedContent);
 
-    optional<vector<uint8_t>> derSignature = signEcDsa(key, toBeSigned);
+    // Since our API specifies only one of |data| and |detachedContent| can be
+    // non-empty, the payload is simply just the non-empty one.
+    EcDsaSigner signer(key);
+    coseFeedToBeSigned("Signature1", encodedProtectedHeaders,
+                       data.size() > 0 ? data : detachedContent,
+                       [&signer](span<const uint8_t> chunk) { signer.update(chunk); });
+
+    optional<vector<uint8_t>> derSignature = signer.final();
     if (!derSignature) {
         LOG(ERROR) << "Error signing toBeSigned data";
         return {};
@@ -1915,7 +1970,7 @@ bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
         return false;
     }
 
-    vector<uint8_t> data;
+    span<const uint8_t> data;
     const cppbor::Simple* payloadAsSimple = (*array)[2]->asSimple();
     if (payloadAsSimple != nullptr) {
         if (payloadAsSimple->asNull() == nullptr) {
@@ -1928,7 +1983,7 @@ bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
             LOG(ERROR) << "Value for payload is not null or a bstr";
             return false;
         }
-        data = payloadAsBstr->value();  // TODO: avoid copy
+        data = payloadAsBstr->value();
     }
 
     if (data.size() > 0 && detachedContent.size() > 0) {
@@ -1949,9 +2004,11 @@ bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
         return false;
     }
 
-    vector<uint8_t> toBeSigned =
-            coseBuildToBeSigned(encodedProtectedHeaders, data, detachedContent);
-    if (!checkEcDsaSignature(support::sha256(toBeSigned), derSignature, publicKey)) {
+    Sha256 digest;
+    coseFeedToBeSigned("Signature1", encodedProtectedHeaders,
+                       data.size() > 0 ? data : span<const uint8_t>(detachedContent),
+                       [&digest](span<const uint8_t> chunk) { digest.update(chunk); });
+    if (!checkEcDsaSignature(digest.final(), derSignature, publicKey)) {
         LOG(ERROR) << "Signature check failed";
         return false;
     }
@@ -2134,30 +2191,6 @@ optional<vector<uint8_t>> coseSignGetX5Chain(const vector<uint8_t>& signatureCos
     return {};
 }
 
-vector<uint8_t> coseBuildToBeMACed(const vector<uint8_t>& encodedProtectedHeaders,
-                                   const vector<uint8_t>& data,
-                                   const vector<uint8_t>& detachedContent) {
-    cppbor::Array macStructure;
-    macStructure.add("MAC0");
-    macStructure.add(encodedProtectedHeaders);
-
-    // We currently don't support Externally Supplied Data (RFC 8152 section 4.3)
-    // so external_aad is the empty bstr
-    vector<uint8_t> emptyExternalAad;
-    macStructure.add(emptyExternalAad);
-
-    // Next field is the payload, independently of how it's transported (RFC
-    // 8152 section 4.4). Since our API specifies only one of |data| and
-    // |detachedContent| can be non-empty, it's simply just the non-empty one.
-    if (data.size() > 0) {
-        macStructure.add(data);
-    } else {
-        macStructure.add(detachedContent);
-    }
-
-    return macStructure.encode();
-}
-
 optional<vector<uint8_t>> coseMac0(const vector<uint8_t>& key, const vector<uint8_t>& data,
                                    const vector<uint8_t>& detachedContent) {
     cppbor::Map unprotectedHeaders;
@@ -2171,9 +2204,18 @@ optional<vector<uint8_t>> coseMac0(const vector<uint8_t>& key, const vector<uint
     protectedHeaders.add(COSE_LABEL_ALG, COSE_ALG_HMAC_256_256);
 
     vector<uint8_t> encodedProtectedHeaders = coseEncodeHeaders(protectedHeaders);
-    vector<uint8_t> toBeMACed = coseBuildToBeMACed(encodedProtectedHeaders, data, detachedContent);
+    optional<HmacSha256> hmac = HmacSha256::create(key);
+    if (!hmac) {
+        LOG(ERROR) << "Error MACing toBeMACed data";
+        return {};
+    }
+    bool updated = true;
+    coseFeedToBeSigned("MAC0", encodedProtectedHeaders, data.size() > 0 ? data : detachedContent,
+                       [&hmac, &updated](span<const uint8_t> chunk) {
+                           updated = hmac->update(chunk) && updated;
+                       });
 
-    optional<vector<uint8_t>> mac = hmacSha256(key, toBeMACed);
+    optional<vector<uint8_t>> mac = updated ? hmac->final() : std::nullopt;
     if (!mac) {
         LOG(ERROR) << "Error MACing toBeMACed data";
         return {};
@@ -2214,6 +2256,190 @@ optional<vector<uint8_t>> coseMacWithDigest(const vector<uint8_t>& digestToBeMac
     return array.encode();
 }
 
+// ---------------------------------------------------------------------------
+// Caching of parsed keys and certificates.
+// ---------------------------------------------------------------------------
+
+ParsedObjectCache::ParsedObjectCache(size_t maxEntries)
+    : maxEntries_(std::max<size_t>(maxEntries, 1)) {}
+
+optional<ParsedObjectCache::Entry> ParsedObjectCache::lookup(
+        char kind, span<const uint8_t> encoded,
+        bool (*parse)(span<const uint8_t> encoded, Entry* entry)) {
+    Sha256 digest;
+    digest.update(encoded);
+    vector<uint8_t> key = digest.final();
+    key.push_back(kind);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        Entry entry;
+        if (!parse(encoded, &entry)) {
+            return {};
+        }
+        while (order_.size() >= maxEntries_) {
+            entries_.erase(order_.front());
+            order_.pop_front();
+        }
+        order_.push_back(key);
+        it = entries_.emplace(std::move(key), std::move(entry)).first;
+    }
+
+    // Hand out new references, the cached ones may be dropped as soon as the
+    // lock is released.
+    Entry ret;
+    if (it->second.key.get() != nullptr) {
+        EVP_PKEY_up_ref(it->second.key.get());
+        ret.key.reset(it->second.key.get());
+    }
+    for (const X509_Ptr& certificate : it->second.certificates) {
+        X509_up_ref(certificate.get());
+        ret.certificates.push_back(X509_Ptr(certificate.get()));
+    }
+    ret.encodedSizes = it->second.encodedSizes;
+    return ret;
+}
+
+bssl::UniquePtr<EVP_PKEY> ParsedObjectCache::ecKeyPair(span<const uint8_t> keyPair) {
+    optional<Entry> entry = lookup('k', keyPair, [](span<const uint8_t> encoded, Entry* entry) {
+        entry->key = parseEcKeyPair(encoded);
+        return entry->key.get() != nullptr;
+    });
+    if (!entry) {
+        return nullptr;
+    }
+    return std::move(entry.value().key);
+}
+
+bssl::UniquePtr<EVP_PKEY> ParsedObjectCache::ecPublicKey(span<const uint8_t> publicKey) {
+    optional<Entry> entry = lookup('p', publicKey, [](span<const uint8_t> encoded, Entry* entry) {
+        entry->key = parseEcPublicKey(encoded);
+        return entry->key.get() != nullptr;
+    });
+    if (!entry) {
+        return nullptr;
+    }
+    return std::move(entry.value().key);
+}
+
+optional<vector<bssl::UniquePtr<X509>>> ParsedObjectCache::certificateChain(
+        span<const uint8_t> certificateChain, vector<size_t>* encodedSizes) {
+    optional<Entry> entry =
+            lookup('c', certificateChain, [](span<const uint8_t> encoded, Entry* entry) {
+                return parseX509Certificates(encoded, entry->certificates, &entry->encodedSizes);
+            });
+    if (!entry) {
+        return {};
+    }
+    if (encodedSizes != nullptr) {
+        *encodedSizes = std::move(entry.value().encodedSizes);
+    }
+    return std::move(entry.value().certificates);
+}
+
+optional<vector<uint8_t>> ecKeyPairGetPublicKey(const vector<uint8_t>& keyPair,
+                                                ParsedObjectCache& cache) {
+    auto pkey = cache.ecKeyPair(keyPair);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecKeyGetPublicKey(pkey.get());
+}
+
+optional<vector<uint8_t>> ecKeyPairGetPrivateKey(const vector<uint8_t>& keyPair,
+                                                 ParsedObjectCache& cache) {
+    auto pkey = cache.ecKeyPair(keyPair);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecKeyGetPrivateKey(pkey.get());
+}
+
+optional<vector<vector<uint8_t>>> certificateChainSplit(const vector<uint8_t>& certificateChain,
+                                                        ParsedObjectCache& cache) {
+    vector<size_t> encodedSizes;
+    if (!cache.certificateChain(certificateChain, &encodedSizes)) {
+        return {};
+    }
+    vector<vector<uint8_t>> certificates;
+    auto begin = certificateChain.begin();
+    for (size_t size : encodedSizes) {
+        certificates.emplace_back(begin, begin + size);
+        begin += size;
+    }
+    return certificates;
+}
+
+bool certificateChainValidate(const vector<uint8_t>& certificateChain, ParsedObjectCache& cache) {
+    optional<vector<X509_Ptr>> certs = cache.certificateChain(certificateChain);
+    if (!certs) {
+        LOG(ERROR) << "Error parsing X509 certificates";
+        return false;
+    }
+    return certificateChainValidate(certs.value());
+}
+
+optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& certificateChain,
+                                                        ParsedObjectCache& cache) {
+    optional<vector<X509_Ptr>> certs = cache.certificateChain(certificateChain);
+    if (!certs) {
+        return {};
+    }
+    if (certs.value().size() < 1) {
+        LOG(ERROR) << "No certificates in chain";
+        return {};
+    }
+    return certificateGetPublicKey(certs.value()[0].get());
+}
+
+optional<pair<size_t, size_t>> certificateFindPublicKey(const vector<uint8_t>& x509Certificate,
+                                                        ParsedObjectCache& cache) {
+    optional<vector<X509_Ptr>> certs = cache.certificateChain(x509Certificate);
+    if (!certs) {
+        return {};
+    }
+    if (certs.value().size() < 1) {
+        LOG(ERROR) << "No certificates in chain";
+        return {};
+    }
+    return certificateFindPublicKey(x509Certificate, certs.value()[0].get());
+}
+
+bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
+                                  const vector<uint8_t>& publicKey, ParsedObjectCache& cache) {
+    optional<vector<X509_Ptr>> certs = cache.certificateChain(certificate);
+    if (!certs || certs.value().size() < 1) {
+        LOG(ERROR) << "Error parsing X509 certificate";
+        return false;
+    }
+
+    auto pkey = cache.ecPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
+        return false;
+    }
+
+    return X509_verify(certs.value()[0].get(), pkey.get()) == 1;
+}
+
+bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& signature,
+                         const vector<uint8_t>& publicKey, ParsedObjectCache& cache) {
+    auto pkey = cache.ecPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
+        return false;
+    }
+    return checkEcDsaSignature(digest, signature, pkey.get());
+}
+
+optional<vector<uint8_t>> ecdh(const vector<uint8_t>& publicKey, const vector<uint8_t>& privateKey,
+                               ParsedObjectCache& cache) {
+    auto pkey = cache.ecPublicKey(publicKey);
+    if (pkey.get() == nullptr) {
+        return {};
+    }
+    return ecdh(pkey.get(), privateKey);
+}
+
 // ---------------------------------------------------------------------------
 // Utility functions specific to IdentityCredential.
 // ---------------------------------------------------------------------------
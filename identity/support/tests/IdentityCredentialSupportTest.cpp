@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <span>
 #include <sstream>
 
 #include <gmock/gmock.h>
@@ -277,6 +279,48 @@ TEST(IdentityCredentialSupport, CertificateChain) {
     ASSERT_EQ(certs2, splitCerts2.value());
 }
 
+TEST(IdentityCredentialSupport, ParsedObjectCache) {
+    support::ParsedObjectCache cache(2);
+
+    optional<vector<uint8_t>> keyPair = support::createEcKeyPair();
+    ASSERT_TRUE(keyPair);
+    optional<vector<uint8_t>> privKey = support::ecKeyPairGetPrivateKey(keyPair.value(), cache);
+    ASSERT_TRUE(privKey);
+    ASSERT_EQ(support::ecKeyPairGetPrivateKey(keyPair.value()).value(), privKey.value());
+    optional<vector<uint8_t>> pubKey = support::ecKeyPairGetPublicKey(keyPair.value(), cache);
+    ASSERT_TRUE(pubKey);
+    ASSERT_EQ(support::ecKeyPairGetPublicKey(keyPair.value()).value(), pubKey.value());
+
+    optional<vector<uint8_t>> cert = support::ecPublicKeyGenerateCertificate(
+            pubKey.value(), privKey.value(), "0001", "someIssuer", "someSubject", 0, 0, {});
+    ASSERT_TRUE(cert);
+    const vector<vector<uint8_t>> certs2 = {cert.value(), cert.value()};
+    vector<uint8_t> certs2combined = support::certificateChainJoin(certs2);
+
+    // Use more objects than the cache holds, so that some of them get dropped
+    // and parsed again.
+    for (int n = 0; n < 3; n++) {
+        optional<vector<uint8_t>> extractedPubKey =
+                support::certificateChainGetTopMostKey(cert.value(), cache);
+        ASSERT_TRUE(extractedPubKey);
+        ASSERT_EQ(pubKey.value(), extractedPubKey.value());
+        ASSERT_EQ(certs2, support::certificateChainSplit(certs2combined, cache).value());
+        ASSERT_TRUE(support::certificateChainValidate(certs2combined, cache));
+        ASSERT_TRUE(support::certificateSignedByPublicKey(cert.value(), pubKey.value(), cache));
+        ASSERT_EQ(support::certificateFindPublicKey(cert.value()).value(),
+                  support::certificateFindPublicKey(cert.value(), cache).value());
+    }
+
+    vector<uint8_t> digest = support::sha256(cert.value());
+    optional<vector<uint8_t>> signature = support::signEcDsaDigest(privKey.value(), digest);
+    ASSERT_TRUE(signature);
+    ASSERT_TRUE(support::checkEcDsaSignature(digest, signature.value(), pubKey.value(), cache));
+
+    vector<uint8_t> invalidCert = cert.value();
+    invalidCert.resize(invalidCert.size() / 2);
+    ASSERT_FALSE(support::certificateChainGetTopMostKey(invalidCert, cache));
+}
+
 vector<uint8_t> strToVec(const string& str) {
     vector<uint8_t> ret;
     size_t size = str.size();
@@ -299,6 +343,77 @@ TEST(IdentityCredentialSupport, hmacSha256) {
     ASSERT_EQ(expected, hmac.value());
 }
 
+TEST(IdentityCredentialSupport, hmacSha256Incremental) {
+    vector<uint8_t> key = strToVec("key");
+    vector<uint8_t> data = strToVec("The quick brown fox jumps over the lazy dog");
+
+    optional<support::HmacSha256> hmac = support::HmacSha256::create(key);
+    ASSERT_TRUE(hmac);
+    std::span<const uint8_t> remaining = data;
+    while (!remaining.empty()) {
+        size_t chunkSize = std::min<size_t>(remaining.size(), 5);
+        ASSERT_TRUE(hmac->update(remaining.first(chunkSize)));
+        remaining = remaining.subspan(chunkSize);
+    }
+    optional<vector<uint8_t>> mac = hmac->final();
+    ASSERT_TRUE(mac);
+    ASSERT_EQ(support::hmacSha256(key, data).value(), mac.value());
+}
+
+TEST(IdentityCredentialSupport, sha256Incremental) {
+    vector<uint8_t> data = strToVec("The quick brown fox jumps over the lazy dog");
+
+    support::Sha256 digest;
+    digest.update(std::span<const uint8_t>(data).first(10));
+    digest.update(std::span<const uint8_t>(data).subspan(10));
+    ASSERT_EQ(support::sha256(data), digest.final());
+}
+
+TEST(IdentityCredentialSupport, Aes128GcmIncremental) {
+    vector<uint8_t> key(support::kAes128GcmKeySize, 0x42);
+    vector<uint8_t> nonce(support::kAesGcmIvSize, 0x17);
+    vector<uint8_t> aad = strToVec("additional data");
+    vector<uint8_t> data(1000);
+    for (size_t n = 0; n < data.size(); n++) {
+        data[n] = n & 0xff;
+    }
+
+    optional<vector<uint8_t>> expected = support::encryptAes128Gcm(key, nonce, data, aad);
+    ASSERT_TRUE(expected);
+
+    // Encrypt in uneven chunks, the result must be the same as encrypting at once.
+    optional<support::Aes128GcmEncrypter> encrypter =
+            support::Aes128GcmEncrypter::create(key, nonce, aad);
+    ASSERT_TRUE(encrypter);
+    vector<uint8_t> encryptedData(data.size() + support::kAesGcmIvSize + support::kAesGcmTagSize);
+    memcpy(encryptedData.data(), nonce.data(), nonce.size());
+    std::span<uint8_t> cipherText =
+            std::span<uint8_t>(encryptedData).subspan(support::kAesGcmIvSize, data.size());
+    for (size_t offset = 0; offset < data.size(); offset += 333) {
+        size_t chunkSize = std::min<size_t>(data.size() - offset, 333);
+        ASSERT_TRUE(encrypter->update(std::span<const uint8_t>(data).subspan(offset, chunkSize),
+                                      cipherText.subspan(offset, chunkSize)));
+    }
+    ASSERT_TRUE(encrypter->final(std::span<uint8_t>(encryptedData).last(support::kAesGcmTagSize)));
+    ASSERT_EQ(expected.value(), encryptedData);
+
+    optional<support::Aes128GcmDecrypter> decrypter =
+            support::Aes128GcmDecrypter::create(key, nonce, aad);
+    ASSERT_TRUE(decrypter);
+    vector<uint8_t> decryptedData(data.size());
+    ASSERT_TRUE(decrypter->update(cipherText, decryptedData));
+    ASSERT_TRUE(decrypter->final(std::span<uint8_t>(encryptedData).last(support::kAesGcmTagSize)));
+    ASSERT_EQ(data, decryptedData);
+
+    // Decryption must fail if the tag doesn't match.
+    encryptedData.back() ^= 0x01;
+    decrypter = support::Aes128GcmDecrypter::create(key, nonce, aad);
+    ASSERT_TRUE(decrypter);
+    ASSERT_TRUE(decrypter->update(cipherText, decryptedData));
+    ASSERT_FALSE(decrypter->final(std::span<uint8_t>(encryptedData).last(support::kAesGcmTagSize)));
+    ASSERT_FALSE(support::decryptAes128Gcm(key, encryptedData, aad));
+}
+
 // See also CoseMac0 test in UtilUnitTest.java inside cts/tests/tests/identity/
 TEST(IdentityCredentialSupport, CoseMac0) {
     vector<uint8_t> key;
@@ -31,24 +31,18 @@ namespace V1_0 {
 namespace implementation {
 
 // Methods from ::android::hardware::input::classifier::V1_0::IInputClassifier follow.
-Return<Classification> InputClassifier::classify(const MotionEvent& /*event*/) {
-    /**
-     * The touchscreen data is highly device-dependent.
-     * As a result, the implementation of this method will likely be hardware-specific.
-     * Here we just report gesture as not having any classification, which means that the
-     * default action will be taken in the framework.
-     * This is equivalent to not having the InputClassifier HAL at all.
-     */
-    return Classification::NONE;
+Return<Classification> InputClassifier::classify(const MotionEvent& event) {
+    // The gesture is classified in the background, this only returns the latest result.
+    return mMotionClassifier.classify(event);
 }
 
 Return<void> InputClassifier::reset() {
-    // We don't have any internal state, so no work needed here.
+    mMotionClassifier.reset();
     return Void();
 }
 
-Return<void> InputClassifier::resetDevice(int32_t /*deviceId*/) {
-    // We don't have any internal per-device state, so no work needed here.
+Return<void> InputClassifier::resetDevice(int32_t deviceId) {
+    mMotionClassifier.resetDevice(deviceId);
     return Void();
 }
 
@@ -20,6 +20,8 @@
 #include <android/hardware/input/classifier/1.0/IInputClassifier.h>
 #include <hidl/Status.h>
 
+#include "MotionClassifier.h"
+
 namespace android {
 namespace hardware {
 namespace input {
@@ -37,6 +39,9 @@ struct InputClassifier : public IInputClassifier {
 
     Return<void> reset() override;
     Return<void> resetDevice(int32_t deviceId) override;
+
+  private:
+    MotionClassifier mMotionClassifier;
 };
 
 }  // namespace implementation
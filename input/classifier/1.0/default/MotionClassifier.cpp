@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MotionClassifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace android::hardware::input::common::V1_0;
+
+namespace android {
+namespace hardware {
+namespace input {
+namespace classifier {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+float getAxisValue(const PointerCoords& coords, Axis axis) {
+    // Axes are flagged from the most significant bit down, and only those flagged have a value.
+    const uint64_t shift = static_cast<uint64_t>(axis);
+    const uint64_t bits = static_cast<uint64_t>(coords.bits);
+    if ((bits & (UINT64_C(0x8000000000000000) >> shift)) == 0) {
+        return 0;
+    }
+    const size_t index = __builtin_popcountll(bits & ~(UINT64_MAX >> shift));
+    return index < coords.values.size() ? coords.values[index] : 0;
+}
+
+}  // namespace
+
+MotionClassifier::MotionClassifier() : mThread(&MotionClassifier::run, this) {}
+
+MotionClassifier::~MotionClassifier() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mShutdown = true;
+    }
+    mCv.notify_one();
+    mThread.join();
+}
+
+Classification MotionClassifier::classify(const MotionEvent& event) {
+    std::lock_guard<std::mutex> lock(mLock);
+    DeviceHistory& history = mDevices[event.deviceId];
+    if (event.action == Action::DOWN || event.downTime != history.downTime) {
+        history.written = 0;
+        history.processed = 0;
+        history.gesture = ++mGestureCount;
+        history.downTime = event.downTime;
+        history.features = {};
+        history.classification = Classification::NONE;
+    }
+
+    if (!event.pointerCoords.empty()) {
+        const PointerCoords& coords = event.pointerCoords[0];
+        const size_t slot = history.written % kHistorySize;
+        history.ring.eventTime[slot] = event.eventTime;
+        history.ring.x[slot] = getAxisValue(coords, Axis::X);
+        history.ring.y[slot] = getAxisValue(coords, Axis::Y);
+        history.ring.pressure[slot] = getAxisValue(coords, Axis::PRESSURE);
+        history.ring.touchMajor[slot] = getAxisValue(coords, Axis::TOUCH_MAJOR);
+        history.written++;
+        if (!mPending) {
+            mPending = true;
+            mCv.notify_one();
+        }
+    }
+    return history.classification;
+}
+
+void MotionClassifier::reset() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mDevices.clear();
+}
+
+void MotionClassifier::resetDevice(int32_t deviceId) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mDevices.erase(deviceId);
+}
+
+size_t MotionClassifier::takeBatchLocked(DeviceHistory& history) {
+    // Samples overwritten before the worker got to them are lost.
+    const uint64_t oldest = history.written > kHistorySize ? history.written - kHistorySize : 0;
+    const uint64_t first = std::max(history.processed, oldest);
+    const size_t count = history.written - first;
+    for (size_t i = 0; i < count; i++) {
+        const size_t slot = (first + i) % kHistorySize;
+        mBatch.eventTime[i] = history.ring.eventTime[slot];
+        mBatch.x[i] = history.ring.x[slot];
+        mBatch.y[i] = history.ring.y[slot];
+        mBatch.pressure[i] = history.ring.pressure[slot];
+        mBatch.touchMajor[i] = history.ring.touchMajor[slot];
+    }
+    history.processed = history.written;
+    return count;
+}
+
+void MotionClassifier::extractFeatures(const Samples& batch, size_t count, Features* features) {
+    if (count == 0) {
+        return;
+    }
+    if (features->samples == 0) {
+        features->lastX = batch.x[0];
+        features->lastY = batch.y[0];
+        features->firstEventTime = batch.eventTime[0];
+    }
+    for (size_t i = 0; i < count; i++) {
+        features->maxPressure = std::max(features->maxPressure, batch.pressure[i]);
+        features->pressureSum += batch.pressure[i];
+        features->maxTouchMajor = std::max(features->maxTouchMajor, batch.touchMajor[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        features->pathLength += std::hypot(batch.x[i] - features->lastX,
+                                           batch.y[i] - features->lastY);
+        features->lastX = batch.x[i];
+        features->lastY = batch.y[i];
+    }
+    features->durationNs = batch.eventTime[count - 1] - features->firstEventTime;
+    features->samples += count;
+}
+
+Classification MotionClassifier::runModel(const Features& /*features*/) {
+    /**
+     * The touchscreen data is highly device-dependent, and so is a model classifying it.
+     * Here we just report gesture as not having any classification, which means that the
+     * default action will be taken in the framework.
+     */
+    return Classification::NONE;
+}
+
+void MotionClassifier::run() {
+    std::vector<int32_t> pendingDevices;
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mShutdown) {
+        if (!mPending) {
+            mCv.wait(lock);
+            continue;
+        }
+        mPending = false;
+
+        pendingDevices.clear();
+        for (const auto& [deviceId, history] : mDevices) {
+            if (history.written != history.processed) {
+                pendingDevices.push_back(deviceId);
+            }
+        }
+
+        for (int32_t deviceId : pendingDevices) {
+            auto it = mDevices.find(deviceId);
+            if (it == mDevices.end()) {
+                continue;
+            }
+            const size_t count = takeBatchLocked(it->second);
+            const uint64_t gesture = it->second.gesture;
+            Features features = it->second.features;
+
+            // Events keep being recorded while the model runs.
+            lock.unlock();
+            extractFeatures(mBatch, count, &features);
+            const Classification classification = runModel(features);
+            lock.lock();
+
+            // The device may have been reset or started a new gesture in the meantime.
+            it = mDevices.find(deviceId);
+            if (it == mDevices.end() || it->second.gesture != gesture) {
+                continue;
+            }
+            it->second.features = features;
+            it->second.classification = classification;
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace classifier
+}  // namespace input
+}  // namespace hardware
+}  // namespace android
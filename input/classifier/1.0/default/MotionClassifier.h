@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INPUT_CLASSIFIER_V1_0_MOTIONCLASSIFIER_H
+#define ANDROID_HARDWARE_INPUT_CLASSIFIER_V1_0_MOTIONCLASSIFIER_H
+
+#include <android/hardware/input/common/1.0/types.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+namespace hardware {
+namespace input {
+namespace classifier {
+namespace V1_0 {
+namespace implementation {
+
+/**
+ * Classifies the gestures of each device away from the input dispatcher's thread.
+ *
+ * classify() only records the primary pointer of an event into a fixed-size history of its
+ * device and returns the latest classification of the ongoing gesture, so it takes the same time
+ * whatever the model costs. A worker thread picks up the new samples of each device in batches,
+ * extracts features from them and runs the model, whose result is then cached for the following
+ * events of the gesture.
+ */
+class MotionClassifier {
+  public:
+    MotionClassifier();
+    ~MotionClassifier();
+
+    ::android::hardware::input::common::V1_0::Classification classify(
+            const ::android::hardware::input::common::V1_0::MotionEvent& event);
+    void reset();
+    void resetDevice(int32_t deviceId);
+
+  private:
+    // Samples kept for each device, older ones are overwritten if the worker falls behind.
+    static constexpr size_t kHistorySize = 64;
+
+    // Features of a gesture so far, accumulated over the batches of samples.
+    struct Features {
+        size_t samples = 0;
+        int64_t firstEventTime = 0;
+        int64_t durationNs = 0;
+        float pathLength = 0;
+        float maxPressure = 0;
+        float pressureSum = 0;
+        float maxTouchMajor = 0;
+        float lastX = 0;
+        float lastY = 0;
+    };
+
+    // A batch of samples, one array per axis so features are extracted over contiguous values.
+    struct Samples {
+        std::array<int64_t, kHistorySize> eventTime;
+        std::array<float, kHistorySize> x;
+        std::array<float, kHistorySize> y;
+        std::array<float, kHistorySize> pressure;
+        std::array<float, kHistorySize> touchMajor;
+    };
+
+    struct DeviceHistory {
+        Samples ring;
+        // Samples of the gesture recorded by classify() and processed by the worker.
+        uint64_t written = 0;
+        uint64_t processed = 0;
+        // Changes with each new gesture, so the worker drops results of an earlier one.
+        uint64_t gesture = 0;
+        int64_t downTime = 0;
+        Features features;
+        ::android::hardware::input::common::V1_0::Classification classification =
+                ::android::hardware::input::common::V1_0::Classification::NONE;
+    };
+
+    void run();
+    // Copies the unprocessed samples of a device into mBatch, mLock must be held.
+    size_t takeBatchLocked(DeviceHistory& history);
+    static void extractFeatures(const Samples& batch, size_t count, Features* features);
+    static ::android::hardware::input::common::V1_0::Classification runModel(
+            const Features& features);
+
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::unordered_map<int32_t, DeviceHistory> mDevices;
+    uint64_t mGestureCount = 0;
+    bool mPending = false;
+    bool mShutdown = false;
+
+    // Only used by the worker.
+    Samples mBatch;
+
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace classifier
+}  // namespace input
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_INPUT_CLASSIFIER_V1_0_MOTIONCLASSIFIER_H
@@ -20,6 +20,8 @@
 
 #include <android-base/logging.h>
 
+#include <iterator>
+
 namespace android {
 namespace hardware {
 namespace keymaster {
@@ -83,8 +85,30 @@ bool keyParamEqual(const KeyParameter& a, const KeyParameter& b) {
     return false;
 }
 
+namespace {
+
+bool tagLess(const KeyParameter& param, Tag tag) {
+    return param.tag < tag;
+}
+
+bool tagGreater(Tag tag, const KeyParameter& param) {
+    return tag < param.tag;
+}
+
+/** Returns \p data sorted, copying it into \p copy only if it isn't sorted already. */
+const std::vector<KeyParameter>& sortedData(const std::vector<KeyParameter>& data, bool sorted,
+                                            std::vector<KeyParameter>* copy) {
+    if (sorted) return data;
+    *copy = data;
+    std::sort(copy->begin(), copy->end(), keyParamLess);
+    return *copy;
+}
+
+}  // namespace
+
 void AuthorizationSet::Sort() {
-    std::sort(data_.begin(), data_.end(), keyParamLess);
+    if (!sorted_) std::sort(data_.begin(), data_.end(), keyParamLess);
+    sorted_ = true;
 }
 
 void AuthorizationSet::Deduplicate() {
@@ -108,25 +132,27 @@ void AuthorizationSet::Deduplicate() {
 }
 
 void AuthorizationSet::Union(const AuthorizationSet& other) {
-    data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+    Sort();
+    std::vector<KeyParameter> otherCopy;
+    const auto& otherData = sortedData(other.data_, other.sorted_, &otherCopy);
+
+    std::vector<KeyParameter> result;
+    result.reserve(data_.size() + otherData.size());
+    std::merge(data_.begin(), data_.end(), otherData.begin(), otherData.end(),
+               std::back_inserter(result), keyParamLess);
+    std::swap(data_, result);
     Deduplicate();
 }
 
 void AuthorizationSet::Subtract(const AuthorizationSet& other) {
     Deduplicate();
+    std::vector<KeyParameter> otherCopy;
+    const auto& otherData = sortedData(other.data_, other.sorted_, &otherCopy);
 
-    auto i = other.begin();
-    while (i != other.end()) {
-        int pos = -1;
-        do {
-            pos = find(i->tag, pos);
-            if (pos != -1 && keyParamEqual(*i, data_[pos])) {
-                data_.erase(data_.begin() + pos);
-                break;
-            }
-        } while (pos != -1);
-        ++i;
-    }
+    std::vector<KeyParameter> result;
+    std::set_difference(data_.begin(), data_.end(), otherData.begin(), otherData.end(),
+                        std::back_inserter(result), keyParamLess);
+    std::swap(data_, result);
 }
 
 void AuthorizationSet::Filter(std::function<bool(const KeyParameter&)> doKeep) {
@@ -140,6 +166,8 @@ void AuthorizationSet::Filter(std::function<bool(const KeyParameter&)> doKeep) {
 }
 
 KeyParameter& AuthorizationSet::operator[](int at) {
+    // The entry may be modified through the reference.
+    sorted_ = false;
     return data_[at];
 }
 
@@ -149,9 +177,14 @@ const KeyParameter& AuthorizationSet::operator[](int at) const {
 
 void AuthorizationSet::Clear() {
     data_.clear();
+    sorted_ = true;
 }
 
 size_t AuthorizationSet::GetTagCount(Tag tag) const {
+    if (sorted_) {
+        auto begin = std::lower_bound(data_.begin(), data_.end(), tag, tagLess);
+        return std::upper_bound(begin, data_.end(), tag, tagGreater) - begin;
+    }
     size_t count = 0;
     for (int pos = -1; (pos = find(tag, pos)) != -1;) ++count;
     return count;
@@ -160,6 +193,12 @@ size_t AuthorizationSet::GetTagCount(Tag tag) const {
 int AuthorizationSet::find(Tag tag, int begin) const {
     auto iter = data_.begin() + (1 + begin);
 
+    if (sorted_) {
+        iter = std::lower_bound(iter, data_.end(), tag, tagLess);
+        if (iter != data_.end() && iter->tag == tag) return iter - data_.begin();
+        return -1;
+    }
+
     while (iter != data_.end() && iter->tag != tag) ++iter;
 
     if (iter != data_.end()) return iter - data_.begin();
@@ -450,6 +489,7 @@ void AuthorizationSet::Serialize(std::ostream* out) const {
 
 void AuthorizationSet::Deserialize(std::istream* in) {
     deserialize(*in, &data_);
+    sorted_ = std::is_sorted(data_.begin(), data_.end(), keyParamLess);
 }
 
 AuthorizationSetBuilder& AuthorizationSetBuilder::RsaKey(uint32_t key_size,
@@ -17,6 +17,7 @@
 #ifndef SYSTEM_SECURITY_KEYSTORE_KM4_AUTHORIZATION_SET_H_
 #define SYSTEM_SECURITY_KEYSTORE_KM4_AUTHORIZATION_SET_H_
 
+#include <algorithm>
 #include <functional>
 #include <vector>
 
@@ -29,10 +30,21 @@ namespace V4_0 {
 
 class AuthorizationSetBuilder;
 
+/**
+ * Ordering of KeyParameters used to sort AuthorizationSets: by tag, then by value.
+ */
+bool keyParamLess(const KeyParameter& a, const KeyParameter& b);
+bool keyParamEqual(const KeyParameter& a, const KeyParameter& b);
+
 /**
  * An ordered collection of KeyParameters. It provides memory ownership and some convenient
  * functionality for sorting, deduplicating, joining, and subtracting sets of KeyParameters.
  * For serialization, wrap the backing store of this structure in a hidl_vec<KeyParameter>.
+ *
+ * Entries keep the order they were added in, since callers work with their indices. The set keeps
+ * track of whether that order happens to be sorted (e.g. after Sort(), Deduplicate(), Union() or
+ * Subtract(), or when entries were added in order), in which case tag lookups use binary search
+ * instead of a linear scan.
  */
 class AuthorizationSet {
    public:
@@ -44,10 +56,11 @@ class AuthorizationSet {
     AuthorizationSet(){};
 
     // Copy constructor.
-    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_) {}
+    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_), sorted_(other.sorted_) {}
 
     // Move constructor.
-    AuthorizationSet(AuthorizationSet&& other) noexcept : data_(std::move(other.data_)) {}
+    AuthorizationSet(AuthorizationSet&& other) noexcept
+        : data_(std::move(other.data_)), sorted_(other.sorted_) {}
 
     // Constructor from hidl_vec<KeyParameter>
     AuthorizationSet(const hidl_vec<KeyParameter>& other) { *this = other; }
@@ -55,12 +68,14 @@ class AuthorizationSet {
     // Copy assignment.
     AuthorizationSet& operator=(const AuthorizationSet& other) {
         data_ = other.data_;
+        sorted_ = other.sorted_;
         return *this;
     }
 
     // Move assignment.
     AuthorizationSet& operator=(AuthorizationSet&& other) noexcept {
         data_ = std::move(other.data_);
+        sorted_ = other.sorted_;
         return *this;
     }
 
@@ -72,6 +87,7 @@ class AuthorizationSet {
                  * See assignment operator/copy constructor of hidl_vec.*/
                 data_[i] = other[i];
             }
+            sorted_ = std::is_sorted(data_.begin(), data_.end(), keyParamLess);
         }
         return *this;
     }
@@ -169,8 +185,8 @@ class AuthorizationSet {
     template <TagType tag_type, Tag tag, typename ValueT, typename Comparator = std::equal_to<>>
     bool Contains(TypedTag<tag_type, tag> ttag, const ValueT& value,
                   Comparator cmp = Comparator()) const {
-        for (const auto& param : data_) {
-            auto entry = authorizationValue(ttag, param);
+        for (int pos = -1; (pos = find(tag, pos)) != -1;) {
+            auto entry = authorizationValue(ttag, data_[pos]);
             if (entry.isOk() && cmp(static_cast<ValueT>(entry.value()), value)) return true;
         }
         return false;
@@ -187,8 +203,14 @@ class AuthorizationSet {
         return {};
     }
 
-    void push_back(const KeyParameter& param) { data_.push_back(param); }
-    void push_back(KeyParameter&& param) { data_.push_back(std::move(param)); }
+    void push_back(const KeyParameter& param) {
+        sorted_ = sorted_ && (data_.empty() || !keyParamLess(param, data_.back()));
+        data_.push_back(param);
+    }
+    void push_back(KeyParameter&& param) {
+        sorted_ = sorted_ && (data_.empty() || !keyParamLess(param, data_.back()));
+        data_.push_back(std::move(param));
+    }
     void push_back(const AuthorizationSet& set) {
         for (auto& entry : set) {
             push_back(entry);
@@ -228,6 +250,8 @@ class AuthorizationSet {
     NullOr<const KeyParameter&> GetEntry(Tag tag) const;
 
     std::vector<KeyParameter> data_;
+    /** Whether data_ is known to be sorted by keyParamLess. */
+    bool sorted_ = true;
 };
 
 class AuthorizationSetBuilder : public AuthorizationSet {
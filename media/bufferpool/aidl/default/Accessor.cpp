@@ -21,6 +21,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <utils/Log.h>
+#include <chrono>
 #include <thread>
 
 #include "Accessor.h"
@@ -32,6 +33,7 @@ namespace aidl::android::hardware::media::bufferpool2::implementation {
 namespace {
     static constexpr nsecs_t kEvictGranularityNs = 1000000000; // 1 sec
     static constexpr nsecs_t kEvictDurationNs = 5000000000; // 5 secs
+    static constexpr std::chrono::milliseconds kInvalidationPollInterval(5);
 }
 
 #ifdef __ANDROID_VNDK__
@@ -183,6 +185,9 @@ BufferPoolStatus Accessor::allocate(
         ConnectionId connectionId,
         const std::vector<uint8_t> &params,
         BufferId *bufferId, const native_handle_t** handle) {
+    // Reads status messages before locking, so that only handling them
+    // is done with the lock held.
+    mBufferPool.mObserver.drainBufferStatusChanges();
     std::unique_lock<std::mutex> lock(mBufferPool.mMutex);
     mBufferPool.processStatusMessages();
     BufferPoolStatus status = ResultStatus::OK;
@@ -210,6 +215,7 @@ BufferPoolStatus Accessor::allocate(
 BufferPoolStatus Accessor::fetch(
         ConnectionId connectionId, TransactionId transactionId,
         BufferId bufferId, const native_handle_t** handle) {
+    mBufferPool.mObserver.drainBufferStatusChanges();
     std::lock_guard<std::mutex> lock(mBufferPool.mMutex);
     mBufferPool.processStatusMessages();
     auto found = mBufferPool.mTransactions.find(transactionId);
@@ -252,7 +258,7 @@ BufferPoolStatus Accessor::connect(
                 *connection = newConnection;
                 *pConnectionId = id;
                 *pMsgId = mBufferPool.mInvalidation.mInvalidationId;
-                mBufferPool.mConnectionIds.insert(id);
+                mBufferPool.handleConnect(id);
                 mBufferPool.mInvalidationChannel.getDesc(invDescPtr);
                 mBufferPool.mInvalidation.onConnect(id, observer);
                 if (sSeqId == kSeqIdMax) {
@@ -298,6 +304,12 @@ void Accessor::cleanUp(bool clearCache) {
     mBufferPool.cleanUp(clearCache);
 }
 
+void Accessor::trim(MemoryPressure pressure) {
+    std::lock_guard<std::mutex> lock(mBufferPool.mMutex);
+    mBufferPool.processStatusMessages();
+    mBufferPool.trim(pressure);
+}
+
 void Accessor::handleInvalidateAck() {
     std::map<ConnectionId, const std::shared_ptr<IObserver>> observers;
     uint32_t invalidationId;
@@ -326,22 +338,16 @@ void Accessor::invalidatorThread(
             std::map<uint32_t, const std::weak_ptr<Accessor>> &accessors,
             std::mutex &mutex,
             std::condition_variable &cv,
-            bool &ready) {
-    constexpr uint32_t NUM_SPIN_TO_INCREASE_SLEEP = 1024;
-    constexpr uint32_t NUM_SPIN_TO_LOG = 1024*8;
-    constexpr useconds_t MAX_SLEEP_US = 10000;
-    uint32_t numSpin = 0;
-    useconds_t sleepUs = 1;
-
+            bool &ready,
+            bool &event) {
     while(true) {
         std::map<uint32_t, const std::weak_ptr<Accessor>> copied;
         {
             std::unique_lock<std::mutex> lock(mutex);
             while (!ready) {
-                numSpin = 0;
-                sleepUs = 1;
                 cv.wait(lock);
             }
+            event = false;
             copied.insert(accessors.begin(), accessors.end());
         }
         std::list<ConnectionId> erased;
@@ -361,50 +367,38 @@ void Accessor::invalidatorThread(
             if (accessors.size() == 0) {
                 ready = false;
             } else {
-                // N.B. Since there is not a efficient way to wait over FMQ,
-                // polling over the FMQ is the current way to prevent draining
-                // CPU.
-                lock.unlock();
-                ++numSpin;
-                if (numSpin % NUM_SPIN_TO_INCREASE_SLEEP == 0 &&
-                    sleepUs < MAX_SLEEP_US) {
-                    sleepUs *= 10;
-                }
-                if (numSpin % NUM_SPIN_TO_LOG == 0) {
-                    ALOGW("invalidator thread spinning");
-                }
-                ::usleep(sleepUs);
+                // Invalidations are posted when the invalidated buffers are
+                // released, which wakes this thread up. Since buffer releases
+                // are only noticed when the status FMQs are processed, the
+                // FMQs are still polled as a fallback.
+                cv.wait_for(lock, kInvalidationPollInterval, [&event] { return event; });
             }
         }
     }
 }
 
-Accessor::AccessorInvalidator::AccessorInvalidator() : mReady(false) {
+Accessor::AccessorInvalidator::AccessorInvalidator() : mReady(false), mEvent(false) {
     std::thread invalidator(
             invalidatorThread,
             std::ref(mAccessors),
             std::ref(mMutex),
             std::ref(mCv),
-            std::ref(mReady));
+            std::ref(mReady),
+            std::ref(mEvent));
     invalidator.detach();
 }
 
 void Accessor::AccessorInvalidator::addAccessor(
         uint32_t accessorId, const std::weak_ptr<Accessor> &accessor) {
-    bool notify = false;
     std::unique_lock<std::mutex> lock(mMutex);
     if (mAccessors.find(accessorId) == mAccessors.end()) {
-        if (!mReady) {
-            mReady = true;
-            notify = true;
-        }
         mAccessors.emplace(accessorId, accessor);
-        ALOGV("buffer invalidation added bp:%u %d", accessorId, notify);
+        ALOGV("buffer invalidation added bp:%u %d", accessorId, !mReady);
     }
+    mReady = true;
+    mEvent = true;
     lock.unlock();
-    if (notify) {
-        mCv.notify_one();
-    }
+    mCv.notify_one();
 }
 
 void Accessor::AccessorInvalidator::delAccessor(uint32_t accessorId) {
@@ -416,6 +410,16 @@ void Accessor::AccessorInvalidator::delAccessor(uint32_t accessorId) {
     }
 }
 
+void Accessor::AccessorInvalidator::wake() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mReady || mEvent) {
+        return;
+    }
+    mEvent = true;
+    lock.unlock();
+    mCv.notify_one();
+}
+
 std::unique_ptr<Accessor::AccessorInvalidator> Accessor::sInvalidator;
 
 void Accessor::createInvalidator() {
@@ -429,6 +433,7 @@ void Accessor::evictorThread(
         std::mutex &mutex,
         std::condition_variable &cv) {
     std::list<const std::weak_ptr<Accessor>> evictList;
+    std::list<const std::weak_ptr<Accessor>> trimList;
     while (true) {
         int expired = 0;
         int evicted = 0;
@@ -445,6 +450,7 @@ void Accessor::evictorThread(
                     evictList.push_back(it->first);
                     it = accessors.erase(it);
                 } else {
+                    trimList.push_back(it->first);
                     ++it;
                 }
             }
@@ -461,6 +467,15 @@ void Accessor::evictorThread(
             ALOGD("evictor expired: %d, evicted: %d", expired, evicted);
         }
         evictList.clear();
+        // trim unused buffers of active accessors off the allocation path.
+        MemoryPressure pressure = trimList.empty() ? MemoryPressure::NONE : readMemoryPressure();
+        for (auto it = trimList.begin(); it != trimList.end(); ++it) {
+            const std::shared_ptr<Accessor> accessor = it->lock();
+            if (accessor) {
+                accessor->trim(pressure);
+            }
+        }
+        trimList.clear();
         ::usleep(kEvictGranularityNs / 1000);
     }
 }
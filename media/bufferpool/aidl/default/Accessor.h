@@ -172,6 +172,14 @@ struct Accessor : public BnAccessor {
      */
     void cleanUp(bool clearCache);
 
+    /**
+     * Processes pending buffer status messages and trims unused buffers
+     * according to the memory pressure.
+     *
+     * @param pressure  the current memory pressure level.
+     */
+    void trim(MemoryPressure pressure);
+
     /**
      * ACK on buffer invalidation messages
      */
@@ -200,10 +208,14 @@ private:
         std::mutex mMutex;
         std::condition_variable mCv;
         bool mReady;
+        // Whether the accessors have invalidations to be notified.
+        bool mEvent;
 
         AccessorInvalidator();
         void addAccessor(uint32_t accessorId, const std::weak_ptr<Accessor> &accessor);
         void delAccessor(uint32_t accessorId);
+        // Makes the invalidator thread handle the accessors right away.
+        void wake();
     };
 
     static std::unique_ptr<AccessorInvalidator> sInvalidator;
@@ -212,7 +224,8 @@ private:
         std::map<uint32_t, const std::weak_ptr<Accessor>> &accessors,
         std::mutex &mutex,
         std::condition_variable &cv,
-        bool &ready);
+        bool &ready,
+        bool &event);
 
     struct AccessorEvictor {
         std::map<const std::weak_ptr<Accessor>, nsecs_t, std::owner_less<>> mAccessors;
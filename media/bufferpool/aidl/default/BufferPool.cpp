@@ -22,6 +22,8 @@
 #include <time.h>
 #include <unistd.h>
 #include <utils/Log.h>
+#include <algorithm>
+#include <string_view>
 #include <thread>
 #include "Accessor.h"
 #include "BufferPool.h"
@@ -31,21 +33,21 @@
 namespace aidl::android::hardware::media::bufferpool2::implementation {
 
 namespace {
-    static constexpr int64_t kCleanUpDurationMs = 500; // 0.5 sec
     static constexpr int64_t kLogDurationMs = 5000; // 5 secs
 
-    static constexpr size_t kMinAllocBytesForEviction = 1024*1024*15;
-    static constexpr size_t kMinBufferCountForEviction = 25;
-    static constexpr size_t kMaxUnusedBufferCount = 64;
-    static constexpr size_t kUnusedBufferCountTarget = kMaxUnusedBufferCount - 16;
+    size_t configHash(const std::vector<uint8_t> &config) {
+        return std::hash<std::string_view>()(std::string_view(
+                reinterpret_cast<const char *>(config.data()), config.size()));
+    }
 }
 
 BufferPool::BufferPool()
     : mTimestampMs(::android::elapsedRealtime()),
-      mLastCleanUpMs(mTimestampMs),
       mLastLogMs(mTimestampMs),
       mSeq(0),
-      mStartSeq(0) {
+      mStartSeq(0),
+      mMemoryPressure(MemoryPressure::NONE),
+      mEvictionPolicy(std::make_unique<FrequencyEvictionPolicy>()) {
     mValid = mInvalidationChannel.isValid();
 }
 
@@ -62,13 +64,20 @@ BufferPool::~BufferPool() {
     std::lock_guard<std::mutex> lock(mMutex);
     ALOGD("Destruction - bufferpool2 %p "
           "cached: %zu/%zuM, %zu/%d%% in use; "
-          "allocs: %zu, %d%% recycled; "
-          "transfers: %zu, %d%% unfetched",
+          "allocs: %zu, %d%% recycled (%d%% exact), %zu scanned; "
+          "transfers: %zu, %d%% unfetched; "
+          "invalidations: %zu, %lldms avg, %lldms max",
           this, mStats.mBuffersCached, mStats.mSizeCached >> 20,
           mStats.mBuffersInUse, percentage(mStats.mBuffersInUse, mStats.mBuffersCached),
           mStats.mTotalAllocations, percentage(mStats.mTotalRecycles, mStats.mTotalAllocations),
+          percentage(mStats.mTotalExactRecycles, mStats.mTotalRecycles),
+          mStats.mTotalScannedBuffers,
           mStats.mTotalTransfers,
-          percentage(mStats.mTotalTransfers - mStats.mTotalFetches, mStats.mTotalTransfers));
+          percentage(mStats.mTotalTransfers - mStats.mTotalFetches, mStats.mTotalTransfers),
+          mInvalidation.mTotalPosted,
+          (long long)(mInvalidation.mTotalPosted ?
+                      mInvalidation.mTotalLatencyMs / (int64_t)mInvalidation.mTotalPosted : 0),
+          (long long)mInvalidation.mMaxLatencyMs);
 }
 
 void BufferPool::Invalidation::onConnect(
@@ -109,7 +118,10 @@ void BufferPool::Invalidation::onBufferInvalidated(
                 }
             }
             channel.postInvalidation(msgId, it->mFrom, it->mTo);
+            onPosted(it->mRequestMs);
             it = mPendings.erase(it);
+            // Notify the connections without waiting for the next poll.
+            Accessor::sInvalidator->wake();
             continue;
         }
         ++it;
@@ -132,16 +144,26 @@ void BufferPool::Invalidation::onInvalidationRequest(
         }
     }
     ALOGV("bufferpool2 invalidation requested and queued");
+    int64_t nowMs = ::android::elapsedRealtime();
     if (left == 0) {
         channel.postInvalidation(msgId, from, to);
+        onPosted(nowMs);
     } else {
         ALOGV("bufferpoo2 invalidation requested and pending");
-        Pending pending(needsAck, from, to, left, impl);
+        Pending pending(needsAck, from, to, left, impl, nowMs);
         mPendings.push_back(pending);
     }
     Accessor::sInvalidator->addAccessor(mId, impl);
 }
 
+void BufferPool::Invalidation::onPosted(int64_t requestMs) {
+    int64_t latencyMs = ::android::elapsedRealtime() - requestMs;
+    mTotalPosted++;
+    mTotalLatencyMs += latencyMs;
+    mMaxLatencyMs = std::max(mMaxLatencyMs, latencyMs);
+    ALOGV("bufferpool2 invalidation posted bp:%u after %lldms", mId, (long long)latencyMs);
+}
+
 void BufferPool::Invalidation::onHandleAck(
         std::map<ConnectionId, const std::shared_ptr<IObserver>> *observers,
         uint32_t *invalidationId) {
@@ -176,29 +198,39 @@ void BufferPool::Invalidation::onHandleAck(
     }
 }
 
+void BufferPool::handleConnect(ConnectionId connectionId) {
+    uint32_t slot;
+    if (!mFreeConnectionSlots.empty()) {
+        slot = mFreeConnectionSlots.back();
+        mFreeConnectionSlots.pop_back();
+    } else {
+        slot = mConnectionSlots.size();
+    }
+    mConnectionSlots.emplace(connectionId, slot);
+}
+
 bool BufferPool::handleOwnBuffer(
         ConnectionId connectionId, BufferId bufferId) {
-
-    bool added = insert(&mUsingBuffers, connectionId, bufferId);
-    if (added) {
-        auto iter = mBuffers.find(bufferId);
-        iter->second->mOwnerCount++;
+    auto slot = mConnectionSlots.find(connectionId);
+    auto iter = mBuffers.find(bufferId);
+    if (slot == mConnectionSlots.end() || iter == mBuffers.end()) {
+        return false;
     }
-    insert(&mUsingConnections, bufferId, connectionId);
-    return added;
+    return iter->second->addOwner(slot->second);
 }
 
 bool BufferPool::handleReleaseBuffer(
         ConnectionId connectionId, BufferId bufferId) {
-    bool deleted = erase(&mUsingBuffers, connectionId, bufferId);
+    auto slot = mConnectionSlots.find(connectionId);
+    auto iter = mBuffers.find(bufferId);
+    bool deleted = slot != mConnectionSlots.end() && iter != mBuffers.end() &&
+            iter->second->removeOwner(slot->second);
     if (deleted) {
-        auto iter = mBuffers.find(bufferId);
-        iter->second->mOwnerCount--;
         if (iter->second->mOwnerCount == 0 &&
                 iter->second->mTransactionCount == 0) {
             if (!iter->second->mInvalidated) {
                 mStats.onBufferUnused(iter->second->mAllocSize);
-                mFreeBuffers.insert(bufferId);
+                addFreeBuffer(bufferId, iter->second->mConfig);
             } else {
                 mStats.onBufferUnused(iter->second->mAllocSize);
                 mStats.onBufferEvicted(iter->second->mAllocSize);
@@ -207,7 +239,6 @@ bool BufferPool::handleReleaseBuffer(
             }
         }
     }
-    erase(&mUsingConnections, bufferId, connectionId);
     ALOGV("release buffer %u : %d", bufferId, deleted);
     return deleted;
 }
@@ -222,8 +253,9 @@ bool BufferPool::handleTransferTo(const BufferStatusMessage &message) {
     }
     // the buffer should exist and be owned.
     auto bufferIter = mBuffers.find(message.bufferId);
-    if (bufferIter == mBuffers.end() ||
-            !contains(&mUsingBuffers, message.connectionId, FromAidl(message.bufferId))) {
+    auto slot = mConnectionSlots.find(message.connectionId);
+    if (bufferIter == mBuffers.end() || slot == mConnectionSlots.end() ||
+            !bufferIter->second->isOwnedBy(slot->second)) {
         return false;
     }
     auto found = mTransactions.find(message.transactionId);
@@ -233,7 +265,7 @@ bool BufferPool::handleTransferTo(const BufferStatusMessage &message) {
         found->second->mSenderValidated = true;
         return true;
     }
-    if (mConnectionIds.find(message.targetConnectionId) == mConnectionIds.end()) {
+    if (mConnectionSlots.find(message.targetConnectionId) == mConnectionSlots.end()) {
         // N.B: it could be fake or receive connection already closed.
         ALOGD("bufferpool2 %p receiver connection %lld is no longer valid",
               this, (long long)message.targetConnectionId);
@@ -287,7 +319,7 @@ bool BufferPool::handleTransferResult(const BufferStatusMessage &message) {
                 && bufferIter->second->mTransactionCount == 0) {
                 if (!bufferIter->second->mInvalidated) {
                     mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                    mFreeBuffers.insert(message.bufferId);
+                    addFreeBuffer(message.bufferId, bufferIter->second->mConfig);
                 } else {
                     mStats.onBufferUnused(bufferIter->second->mAllocSize);
                     mStats.onBufferEvicted(bufferIter->second->mAllocSize);
@@ -307,7 +339,7 @@ bool BufferPool::handleTransferResult(const BufferStatusMessage &message) {
 }
 
 void BufferPool::processStatusMessages() {
-    std::vector<BufferStatusMessage> messages;
+    std::vector<BufferStatusMessage> &messages = mStatusMessages;
     mObserver.getBufferStatusChanges(messages);
     mTimestampMs = ::android::elapsedRealtime();
     for (BufferStatusMessage& message: messages) {
@@ -354,29 +386,28 @@ void BufferPool::processStatusMessages() {
 
 bool BufferPool::handleClose(ConnectionId connectionId) {
     // Cleaning buffers
-    auto buffers = mUsingBuffers.find(connectionId);
-    if (buffers != mUsingBuffers.end()) {
-        for (const BufferId& bufferId : buffers->second) {
-            bool deleted = erase(&mUsingConnections, bufferId, connectionId);
-            if (deleted) {
-                auto bufferIter = mBuffers.find(bufferId);
-                bufferIter->second->mOwnerCount--;
-                if (bufferIter->second->mOwnerCount == 0 &&
-                        bufferIter->second->mTransactionCount == 0) {
-                    // TODO: handle freebuffer insert fail
-                    if (!bufferIter->second->mInvalidated) {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mFreeBuffers.insert(bufferId);
-                    } else {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mStats.onBufferEvicted(bufferIter->second->mAllocSize);
-                        mBuffers.erase(bufferIter);
-                        mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
-                    }
-                }
+    auto slot = mConnectionSlots.find(connectionId);
+    if (slot != mConnectionSlots.end()) {
+        for (auto bufferIter = mBuffers.begin(); bufferIter != mBuffers.end();) {
+            if (!bufferIter->second->removeOwner(slot->second) ||
+                    bufferIter->second->mTransactionCount > 0 ||
+                    bufferIter->second->mOwnerCount > 0) {
+                ++bufferIter;
+                continue;
+            }
+            BufferId bufferId = bufferIter->first;
+            // TODO: handle freebuffer insert fail
+            if (!bufferIter->second->mInvalidated) {
+                mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                addFreeBuffer(bufferId, bufferIter->second->mConfig);
+                ++bufferIter;
+            } else {
+                mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                mStats.onBufferEvicted(bufferIter->second->mAllocSize);
+                bufferIter = mBuffers.erase(bufferIter);
+                mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
             }
         }
-        mUsingBuffers.erase(buffers);
     }
 
     // Cleaning transactions
@@ -396,7 +427,7 @@ bool BufferPool::handleClose(ConnectionId connectionId) {
                     // TODO: handle freebuffer insert fail
                     if (!bufferIter->second->mInvalidated) {
                         mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mFreeBuffers.insert(bufferId);
+                        addFreeBuffer(bufferId, bufferIter->second->mConfig);
                     } else {
                         mStats.onBufferUnused(bufferIter->second->mAllocSize);
                         mStats.onBufferEvicted(bufferIter->second->mAllocSize);
@@ -408,24 +439,61 @@ bool BufferPool::handleClose(ConnectionId connectionId) {
             }
         }
     }
-    mConnectionIds.erase(connectionId);
+    if (slot != mConnectionSlots.end()) {
+        mFreeConnectionSlots.push_back(slot->second);
+        mConnectionSlots.erase(slot);
+    }
     return true;
 }
 
+void BufferPool::addFreeBuffer(BufferId bufferId, const std::vector<uint8_t> &config) {
+    mFreeBuffers.insert(bufferId);
+    mFreeBuffersByConfig[configHash(config)].insert(bufferId);
+}
+
+std::set<BufferId>::iterator BufferPool::eraseFreeBuffer(
+        std::set<BufferId>::iterator freeIt, const std::vector<uint8_t> &config) {
+    auto bucket = mFreeBuffersByConfig.find(configHash(config));
+    if (bucket != mFreeBuffersByConfig.end()) {
+        bucket->second.erase(*freeIt);
+        if (bucket->second.empty()) {
+            mFreeBuffersByConfig.erase(bucket);
+        }
+    }
+    return mFreeBuffers.erase(freeIt);
+}
+
 bool BufferPool::getFreeBuffer(
         const std::shared_ptr<BufferPoolAllocator> &allocator,
         const std::vector<uint8_t> &params, BufferId *pId,
         const native_handle_t** handle) {
-    auto bufferIt = mFreeBuffers.begin();
-    for (;bufferIt != mFreeBuffers.end(); ++bufferIt) {
-        BufferId bufferId = *bufferIt;
-        if (allocator->compatible(params, mBuffers[bufferId]->mConfig)) {
-            break;
+    const size_t hash = configHash(params);
+    mEvictionPolicy->onRequested(hash, mTimestampMs);
+    auto bufferIt = mFreeBuffers.end();
+    auto bucket = mFreeBuffersByConfig.find(hash);
+    if (bucket != mFreeBuffersByConfig.end()) {
+        for (BufferId bufferId : bucket->second) {
+            // Tolerate hash collisions.
+            const std::vector<uint8_t> &config = mBuffers[bufferId]->mConfig;
+            if (config == params && allocator->compatible(params, config)) {
+                bufferIt = mFreeBuffers.find(bufferId);
+                mStats.onExactRecycle();
+                break;
+            }
+        }
+    }
+    if (bufferIt == mFreeBuffers.end()) {
+        for (bufferIt = mFreeBuffers.begin(); bufferIt != mFreeBuffers.end(); ++bufferIt) {
+            BufferId bufferId = *bufferIt;
+            mStats.onBufferScanned();
+            if (allocator->compatible(params, mBuffers[bufferId]->mConfig)) {
+                break;
+            }
         }
     }
     if (bufferIt != mFreeBuffers.end()) {
         BufferId id = *bufferIt;
-        mFreeBuffers.erase(bufferIt);
+        eraseFreeBuffer(bufferIt, mBuffers[id]->mConfig);
         mStats.onBufferRecycled(mBuffers[id]->mAllocSize);
         *handle = mBuffers[id]->handle();
         *pId = id;
@@ -463,34 +531,91 @@ BufferPoolStatus BufferPool::addNewBuffer(
 }
 
 void BufferPool::cleanUp(bool clearCache) {
-    if (clearCache || mTimestampMs > mLastCleanUpMs + kCleanUpDurationMs ||
-            mStats.buffersNotInUse() > kMaxUnusedBufferCount) {
-        mLastCleanUpMs = mTimestampMs;
-        if (mTimestampMs > mLastLogMs + kLogDurationMs ||
-                mStats.buffersNotInUse() > kMaxUnusedBufferCount) {
-            mLastLogMs = mTimestampMs;
-            ALOGD("bufferpool2 %p : %zu(%zu size) total buffers - "
-                  "%zu(%zu size) used buffers - %zu/%zu (recycle/alloc) - "
-                  "%zu/%zu (fetch/transfer)",
-                  this, mStats.mBuffersCached, mStats.mSizeCached,
-                  mStats.mBuffersInUse, mStats.mSizeInUse,
-                  mStats.mTotalRecycles, mStats.mTotalAllocations,
-                  mStats.mTotalFetches, mStats.mTotalTransfers);
+    if (mTimestampMs > mLastLogMs + kLogDurationMs) {
+        mLastLogMs = mTimestampMs;
+        ALOGD("bufferpool2 %p : %zu(%zu size) total buffers - "
+              "%zu(%zu size) used buffers - %zu/%zu (recycle/alloc) - "
+              "%zu exact recycles - %zu scanned - "
+              "%zu/%zu (fetch/transfer) - "
+              "%zu invalidations(%lldms max latency)",
+              this, mStats.mBuffersCached, mStats.mSizeCached,
+              mStats.mBuffersInUse, mStats.mSizeInUse,
+              mStats.mTotalRecycles, mStats.mTotalAllocations,
+              mStats.mTotalExactRecycles, mStats.mTotalScannedBuffers,
+              mStats.mTotalFetches, mStats.mTotalTransfers,
+              mInvalidation.mTotalPosted, (long long)mInvalidation.mMaxLatencyMs);
+    }
+    if (!clearCache) {
+        // Only the limits are enforced here, idle buffers are trimmed in the
+        // background by trim().
+        evictFreeBuffers(false);
+        return;
+    }
+    for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end();) {
+        auto it = mBuffers.find(*freeIt);
+        if (it != mBuffers.end() &&
+                it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
+            mStats.onBufferEvicted(it->second->mAllocSize);
+            freeIt = eraseFreeBuffer(freeIt, it->second->mConfig);
+            mBuffers.erase(it);
+        } else {
+            ++freeIt;
+            ALOGW("bufferpool2 inconsistent!");
         }
-        for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end();) {
-            if (!clearCache && mStats.buffersNotInUse() <= kUnusedBufferCountTarget &&
-                    (mStats.mSizeCached < kMinAllocBytesForEviction ||
-                     mBuffers.size() < kMinBufferCountForEviction)) {
-                break;
+    }
+}
+
+void BufferPool::trim(MemoryPressure pressure) {
+    if (pressure != mMemoryPressure) {
+        ALOGD("bufferpool2 %p : memory pressure %d -> %d",
+              this, (int)mMemoryPressure, (int)pressure);
+        mMemoryPressure = pressure;
+    }
+    evictFreeBuffers(true);
+    evictFreeBuffers(false);
+    mEvictionPolicy->prune(mTimestampMs);
+}
+
+void BufferPool::evictFreeBuffers(bool idleOnly) {
+    const size_t sizeLimit = mEvictionPolicy->getUnusedSizeLimit(mMemoryPressure);
+    const size_t countLimit = mEvictionPolicy->getUnusedCountLimit(mMemoryPressure);
+    auto overLimits = [&]() {
+        return mStats.mSizeCached - mStats.mSizeInUse > sizeLimit ||
+                mStats.buffersNotInUse() > countLimit;
+    };
+    if (!idleOnly && !overLimits()) {
+        return;
+    }
+
+    // Configs in eviction order, lowest priority first.
+    std::vector<std::pair<double, size_t>> configs;
+    for (const auto &bucket : mFreeBuffersByConfig) {
+        if (!idleOnly || mEvictionPolicy->isIdle(bucket.first, mTimestampMs)) {
+            configs.emplace_back(
+                    mEvictionPolicy->getPriority(bucket.first, mTimestampMs), bucket.first);
+        }
+    }
+    std::sort(configs.begin(), configs.end());
+
+    for (const auto &config : configs) {
+        auto bucket = mFreeBuffersByConfig.find(config.second);
+        if (bucket == mFreeBuffersByConfig.end()) {
+            continue;
+        }
+        // Evicting a buffer modifies the bucket.
+        const std::vector<BufferId> bufferIds(bucket->second.begin(), bucket->second.end());
+        for (BufferId bufferId : bufferIds) {
+            if (!idleOnly && !overLimits()) {
+                return;
             }
-            auto it = mBuffers.find(*freeIt);
-            if (it != mBuffers.end() &&
+            auto freeIt = mFreeBuffers.find(bufferId);
+            auto it = mBuffers.find(bufferId);
+            if (freeIt != mFreeBuffers.end() && it != mBuffers.end() &&
                     it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
                 mStats.onBufferEvicted(it->second->mAllocSize);
+                eraseFreeBuffer(freeIt, it->second->mConfig);
                 mBuffers.erase(it);
-                freeIt = mFreeBuffers.erase(freeIt);
             } else {
-                ++freeIt;
                 ALOGW("bufferpool2 inconsistent!");
             }
         }
@@ -506,8 +631,8 @@ void BufferPool::invalidate(
             if (it != mBuffers.end() &&
                 it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
                 mStats.onBufferEvicted(it->second->mAllocSize);
+                freeIt = eraseFreeBuffer(freeIt, it->second->mConfig);
                 mBuffers.erase(it);
-                freeIt = mFreeBuffers.erase(freeIt);
                 continue;
             } else {
                 ALOGW("bufferpool2 inconsistent!");
@@ -18,12 +18,14 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <utils/Timers.h>
 
 #include "BufferStatus.h"
+#include "EvictionPolicy.h"
 
 namespace aidl::android::hardware::media::bufferpool2::implementation {
 
@@ -44,7 +46,6 @@ struct BufferPool {
 private:
     std::mutex mMutex;
     int64_t mTimestampMs;
-    int64_t mLastCleanUpMs;
     int64_t mLastLogMs;
     BufferId mSeq;
     BufferId mStartSeq;
@@ -52,8 +53,12 @@ private:
     BufferStatusObserver mObserver;
     BufferInvalidationChannel mInvalidationChannel;
 
-    std::map<ConnectionId, std::set<BufferId>> mUsingBuffers;
-    std::map<BufferId, std::set<ConnectionId>> mUsingConnections;
+    // Slots of the connections, which index the owner bitsets of buffers.
+    std::unordered_map<ConnectionId, uint32_t> mConnectionSlots;
+    // Slots of closed connections, to be reused.
+    std::vector<uint32_t> mFreeConnectionSlots;
+    // Storage for status messages being handled, reused to avoid allocation.
+    std::vector<BufferStatusMessage> mStatusMessages;
 
     std::map<ConnectionId, std::set<TransactionId>> mPendingTransactions;
     // Transactions completed before TRANSFER_TO message arrival.
@@ -64,9 +69,16 @@ private:
     std::map<TransactionId, std::unique_ptr<TransactionStatus>>
             mTransactions;
 
-    std::map<BufferId, std::unique_ptr<InternalBuffer>> mBuffers;
+    std::unordered_map<BufferId, std::unique_ptr<InternalBuffer>> mBuffers;
     std::set<BufferId> mFreeBuffers;
-    std::set<ConnectionId> mConnectionIds;
+    // mFreeBuffers bucketed by the hash of their allocation parameters, so
+    // buffers with the exact requested configuration are found without
+    // scanning the whole free list.
+    std::unordered_map<size_t, std::set<BufferId>> mFreeBuffersByConfig;
+
+    // The last memory pressure level reported to trim().
+    MemoryPressure mMemoryPressure;
+    std::unique_ptr<EvictionPolicy> mEvictionPolicy;
 
     struct Invalidation {
         static std::atomic<std::uint32_t> sInvSeqId;
@@ -77,13 +89,16 @@ private:
             uint32_t mTo;
             size_t mLeft;
             const std::weak_ptr<Accessor> mImpl;
+            // When the invalidation was requested.
+            int64_t mRequestMs;
             Pending(bool needsAck, uint32_t from, uint32_t to, size_t left,
-                    const std::shared_ptr<Accessor> &impl)
+                    const std::shared_ptr<Accessor> &impl, int64_t requestMs)
                     : mNeedsAck(needsAck),
                       mFrom(from),
                       mTo(to),
                       mLeft(left),
-                      mImpl(impl)
+                      mImpl(impl),
+                      mRequestMs(requestMs)
             {}
 
             bool isInvalidated(uint32_t bufferId) {
@@ -97,7 +112,17 @@ private:
         uint32_t mInvalidationId;
         uint32_t mId;
 
-        Invalidation() : mInvalidationId(0), mId(sInvSeqId.fetch_add(1)) {}
+        /// # of invalidations posted to the connections.
+        size_t mTotalPosted;
+        /// Total and maximum time from an invalidation request to the
+        /// invalidation being posted, which waits for the invalidated buffers
+        /// to be released.
+        int64_t mTotalLatencyMs;
+        int64_t mMaxLatencyMs;
+
+        Invalidation()
+            : mInvalidationId(0), mId(sInvSeqId.fetch_add(1)),
+              mTotalPosted(0), mTotalLatencyMs(0), mMaxLatencyMs(0) {}
 
         void onConnect(ConnectionId conId, const std::shared_ptr<IObserver> &observer);
 
@@ -117,6 +142,8 @@ private:
         void onHandleAck(
                 std::map<ConnectionId, const std::shared_ptr<IObserver>> *observers,
                 uint32_t *invalidationId);
+
+        void onPosted(int64_t requestMs);
     } mInvalidation;
     /// Buffer pool statistics which tracks allocation and transfer statistics.
     struct Stats {
@@ -135,6 +162,10 @@ private:
         /// # of allocations that were served from the cache.
         /// (# of allocator alloc prevented)
         size_t mTotalRecycles;
+        /// # of recycles served from the exact configuration bucket.
+        size_t mTotalExactRecycles;
+        /// # of free buffers examined by the compatibility scan on recycling.
+        size_t mTotalScannedBuffers;
         /// # of buffer transfers initiated.
         size_t mTotalTransfers;
         /// # of transfers that had to be fetched.
@@ -142,7 +173,8 @@ private:
 
         Stats()
             : mSizeCached(0), mBuffersCached(0), mSizeInUse(0), mBuffersInUse(0),
-              mTotalAllocations(0), mTotalRecycles(0), mTotalTransfers(0), mTotalFetches(0) {}
+              mTotalAllocations(0), mTotalRecycles(0), mTotalExactRecycles(0),
+              mTotalScannedBuffers(0), mTotalTransfers(0), mTotalFetches(0) {}
 
         /// # of currently unused buffers
         size_t buffersNotInUse() const {
@@ -176,6 +208,16 @@ private:
             mTotalRecycles++;
         }
 
+        /// A recycle request is served from the exact configuration bucket.
+        void onExactRecycle() {
+            mTotalExactRecycles++;
+        }
+
+        /// The compatibility scan examined a free buffer.
+        void onBufferScanned() {
+            mTotalScannedBuffers++;
+        }
+
         /// A buffer is available to be recycled.
         void onBufferUnused(size_t allocSize) {
             mSizeInUse -= allocSize;
@@ -202,6 +244,27 @@ private:
 
     static void createInvalidator();
 
+    /** Adds an unused buffer to the free buffer list and its config bucket. */
+    void addFreeBuffer(BufferId bufferId, const std::vector<uint8_t> &config);
+
+    /**
+     * Removes a buffer from the free buffer list and its config bucket.
+     *
+     * @return the iterator following the removed free buffer.
+     */
+    std::set<BufferId>::iterator eraseFreeBuffer(
+            std::set<BufferId>::iterator freeIt, const std::vector<uint8_t> &config);
+
+    /**
+     * Evicts free buffers in the order of the eviction policy.
+     *
+     * @param idleOnly  if idleOnly is true, it evicts all free buffers of idle
+     *                  configs. Otherwise it evicts free buffers until the
+     *                  unused buffers are within the limits of the current
+     *                  memory pressure level.
+     */
+    void evictFreeBuffers(bool idleOnly);
+
 public:
     /** Creates a buffer pool. */
     BufferPool();
@@ -215,6 +278,13 @@ public:
      */
     void processStatusMessages();
 
+    /**
+     * Handles a connection being made, and assigns a slot to the connection.
+     *
+     * @param connectionId  the id of the connection.
+     */
+    void handleConnect(ConnectionId connectionId);
+
     /**
      * Handles a buffer being owned by a connection.
      *
@@ -282,6 +352,10 @@ public:
     /**
      * Recycles a existing free buffer if it is possible.
      *
+     * Free buffers allocated with exactly the same parameters are looked up
+     * first. The allocator is asked about the compatibility of every free
+     * buffer only if there is none.
+     *
      * @param allocator the buffer allocator
      * @param params    the allocation parameters.
      * @param pId       the id of the recycled buffer.
@@ -316,14 +390,24 @@ public:
             const native_handle_t **handle);
 
     /**
-     * Processes pending buffer status messages and performs periodic cache
-     * cleaning.
+     * Enforces the unused buffer limits of the eviction policy. This is cheap
+     * when the limits are not exceeded, and is done on every buffer pool
+     * operation.
      *
      * @param clearCache    if clearCache is true, it frees all buffers
      *                      waiting to be recycled.
      */
     void cleanUp(bool clearCache = false);
 
+    /**
+     * Trims the free buffers of idle configs, and enforces the unused buffer
+     * limits of the memory pressure level. This is done periodically from
+     * the background.
+     *
+     * @param pressure  the current memory pressure level.
+     */
+    void trim(MemoryPressure pressure);
+
     /**
      * Processes pending buffer status messages and invalidate all current
      * free buffers. Active buffers are invalidated after being inactive.
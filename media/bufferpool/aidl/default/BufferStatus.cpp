@@ -43,6 +43,7 @@ static constexpr int kMinElementsToSyncInQueue = 128;
 
 BufferPoolStatus BufferStatusObserver::open(
         ConnectionId id, StatusDescriptor* fmqDescPtr) {
+    std::lock_guard<std::mutex> lock(mLock);
     if (mBufferStatusQueues.find(id) != mBufferStatusQueues.end()) {
         ALOGE("connection id collision %lld", (unsigned long long)id);
         return ResultStatus::CRITICAL_ERROR;
@@ -61,32 +62,50 @@ BufferPoolStatus BufferStatusObserver::open(
 }
 
 BufferPoolStatus BufferStatusObserver::close(ConnectionId id) {
+    std::lock_guard<std::mutex> lock(mLock);
     if (mBufferStatusQueues.find(id) == mBufferStatusQueues.end()) {
         return ResultStatus::CRITICAL_ERROR;
     }
     mBufferStatusQueues.erase(id);
+    std::erase_if(mDrainedMessages, [id](const BufferStatusMessage &message) {
+        return message.connectionId == id;
+    });
     return ResultStatus::OK;
 }
 
-void BufferStatusObserver::getBufferStatusChanges(std::vector<BufferStatusMessage> &messages) {
+void BufferStatusObserver::drainLocked() {
     for (auto it = mBufferStatusQueues.begin(); it != mBufferStatusQueues.end(); ++it) {
-        BufferStatusMessage message;
         size_t avail = it->second->availableToRead();
-        while (avail > 0) {
-            if (!it->second->read(&message, 1)) {
-                // Since available # of reads are already confirmed,
-                // this should not happen.
-                // TODO: error handling (spurious client?)
-                ALOGW("FMQ message cannot be read from %lld", (long long)it->first);
-                return;
-            }
-            message.connectionId = it->first;
-            messages.push_back(message);
-            --avail;
+        if (avail == 0) {
+            continue;
+        }
+        size_t start = mDrainedMessages.size();
+        mDrainedMessages.resize(start + avail);
+        if (!it->second->read(&mDrainedMessages[start], avail)) {
+            // Since available # of reads are already confirmed,
+            // this should not happen.
+            // TODO: error handling (spurious client?)
+            ALOGW("FMQ message cannot be read from %lld", (long long)it->first);
+            mDrainedMessages.resize(start);
+            return;
+        }
+        for (size_t i = start; i < mDrainedMessages.size(); ++i) {
+            mDrainedMessages[i].connectionId = it->first;
         }
     }
 }
 
+void BufferStatusObserver::drainBufferStatusChanges() {
+    std::lock_guard<std::mutex> lock(mLock);
+    drainLocked();
+}
+
+void BufferStatusObserver::getBufferStatusChanges(std::vector<BufferStatusMessage> &messages) {
+    std::lock_guard<std::mutex> lock(mLock);
+    drainLocked();
+    std::swap(messages, mDrainedMessages);
+}
+
 BufferStatusChannel::BufferStatusChannel(
         const StatusDescriptor &fmqDesc) {
     auto queue = std::make_unique<BufferStatusQueue>(fmqDesc);
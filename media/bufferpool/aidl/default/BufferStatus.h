@@ -35,8 +35,13 @@ bool isBufferInRange(BufferId from, BufferId to, BufferId bufferId);
  */
 class BufferStatusObserver {
 private:
+    std::mutex mLock;
     std::map<ConnectionId, std::unique_ptr<BufferStatusQueue>>
             mBufferStatusQueues;
+    // Messages which are read from the FMQs but not retrieved yet.
+    std::vector<BufferStatusMessage> mDrainedMessages;
+
+    void drainLocked();
 
 public:
     /** Creates a buffer status message FMQ for the specified
@@ -52,7 +57,8 @@ public:
     BufferPoolStatus open(ConnectionId id, StatusDescriptor* _Nonnull fmqDescPtr);
 
     /** Closes a buffer status message FMQ for the specified
-     * connection(client).
+     * connection(client). Drained messages from the connection which are not
+     * retrieved yet are discarded as well.
      *
      * @param connectionId  connection Id of the specified client.
      *
@@ -61,9 +67,18 @@ public:
      */
     BufferPoolStatus close(ConnectionId id);
 
+    /** Reads all pending FMQ buffer status messages from clients, and keeps
+     * them in order until they are retrieved. This can be called without
+     * the buffer pool lock, so that the lock is held only for handling the
+     * messages.
+     */
+    void drainBufferStatusChanges();
+
     /** Retrieves all pending FMQ buffer status messages from clients.
      *
-     * @param messages  retrieved pending messages.
+     * @param messages  retrieved pending messages. The vector is swapped
+     *                  with the internal one in order to reuse the storage,
+     *                  so it should be empty.
      */
     void getBufferStatusChanges(std::vector<BufferStatusMessage> &messages);
 };
@@ -21,6 +21,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 
 namespace aidl::android::hardware::media::bufferpool2::implementation {
 
@@ -75,6 +76,8 @@ struct InternalBuffer {
     const size_t mAllocSize;
     const std::vector<uint8_t> mConfig;
     bool mInvalidated;
+    // Bitset of the slots of the connections owning the buffer.
+    std::vector<uint64_t> mOwnerSlots;
 
     InternalBuffer(
             BufferId id,
@@ -92,6 +95,36 @@ struct InternalBuffer {
     void invalidate() {
         mInvalidated = true;
     }
+
+    bool isOwnedBy(uint32_t slot) const {
+        size_t word = slot / 64;
+        return word < mOwnerSlots.size() && (mOwnerSlots[word] >> (slot % 64) & 1);
+    }
+
+    // Returns true when the connection was not an owner.
+    bool addOwner(uint32_t slot) {
+        size_t word = slot / 64;
+        if (word >= mOwnerSlots.size()) {
+            mOwnerSlots.resize(word + 1, 0);
+        }
+        uint64_t bit = 1ULL << (slot % 64);
+        if (mOwnerSlots[word] & bit) {
+            return false;
+        }
+        mOwnerSlots[word] |= bit;
+        mOwnerCount++;
+        return true;
+    }
+
+    // Returns true when the connection was an owner.
+    bool removeOwner(uint32_t slot) {
+        if (!isOwnedBy(slot)) {
+            return false;
+        }
+        mOwnerSlots[slot / 64] &= ~(1ULL << (slot % 64));
+        mOwnerCount--;
+        return true;
+    }
 };
 
 // Buffer transacion status/message data structure for internal BufferPool use.
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AidlBufferPoolEvict"
+//#define LOG_NDEBUG 0
+
+#include <cutils/properties.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <algorithm>
+
+#include "EvictionPolicy.h"
+
+namespace aidl::android::hardware::media::bufferpool2::implementation {
+
+namespace {
+    static constexpr const char *kMemoryPressurePath = "/proc/pressure/memory";
+    // % of time in the last 10 secs some tasks were stalled on memory.
+    static constexpr float kModerateSomeAvg10 = 10.f;
+    // % of time in the last 10 secs all tasks were stalled on memory.
+    static constexpr float kCriticalFullAvg10 = 5.f;
+
+    static constexpr size_t kMinBudget = 1024*1024*15;
+    static constexpr size_t kMaxBudget = 1024*1024*512;
+    // Share of the device memory used as the default budget.
+    static constexpr size_t kBudgetMemoryDivisor = 64;
+
+    static constexpr size_t kMaxUnusedBufferCount = 64;
+    static constexpr size_t kModerateUnusedBufferCount = 16;
+
+    static constexpr int64_t kScoreHalfLifeMs = 1000; // 1 sec
+    // A config requested once is idle after ~3 secs.
+    static constexpr double kIdleScore = 0.1;
+}
+
+MemoryPressure readMemoryPressure() {
+    FILE *file = fopen(kMemoryPressurePath, "re");
+    if (!file) {
+        return MemoryPressure::NONE;
+    }
+    MemoryPressure pressure = MemoryPressure::NONE;
+    char kind[8];
+    float avg10;
+    // "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    // "full avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    while (fscanf(file, "%7s avg10=%f %*[^\n]", kind, &avg10) == 2) {
+        if (strcmp(kind, "full") == 0 && avg10 >= kCriticalFullAvg10) {
+            pressure = MemoryPressure::CRITICAL;
+        } else if (strcmp(kind, "some") == 0 && avg10 >= kModerateSomeAvg10 &&
+                pressure == MemoryPressure::NONE) {
+            pressure = MemoryPressure::MODERATE;
+        }
+    }
+    fclose(file);
+    return pressure;
+}
+
+namespace {
+    size_t defaultBudget() {
+        int64_t budgetMb = property_get_int64("ro.media.bufferpool.cache_budget_mb", 0);
+        if (budgetMb > 0) {
+            return budgetMb * 1024 * 1024;
+        }
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        if (pages <= 0 || pageSize <= 0) {
+            return kMinBudget;
+        }
+        size_t budget = (size_t)pages * pageSize / kBudgetMemoryDivisor;
+        return std::clamp(budget, kMinBudget, kMaxBudget);
+    }
+}
+
+FrequencyEvictionPolicy::FrequencyEvictionPolicy(size_t budget)
+    : mBudget(budget ? budget : defaultBudget()) {
+    ALOGV("unused buffer budget %zu", mBudget);
+}
+
+double FrequencyEvictionPolicy::decayedScore(const Usage &usage, int64_t nowMs) {
+    int64_t elapsedMs = std::max<int64_t>(nowMs - usage.mLastRequestMs, 0);
+    return usage.mScore * exp2(-(double)elapsedMs / kScoreHalfLifeMs);
+}
+
+void FrequencyEvictionPolicy::onRequested(size_t configHash, int64_t nowMs) {
+    auto it = mUsages.find(configHash);
+    if (it == mUsages.end()) {
+        mUsages.emplace(configHash, Usage{1., nowMs});
+    } else {
+        it->second.mScore = decayedScore(it->second, nowMs) + 1.;
+        it->second.mLastRequestMs = nowMs;
+    }
+}
+
+double FrequencyEvictionPolicy::getPriority(size_t configHash, int64_t nowMs) {
+    auto it = mUsages.find(configHash);
+    return it == mUsages.end() ? 0. : decayedScore(it->second, nowMs);
+}
+
+bool FrequencyEvictionPolicy::isIdle(size_t configHash, int64_t nowMs) {
+    return getPriority(configHash, nowMs) < kIdleScore;
+}
+
+void FrequencyEvictionPolicy::prune(int64_t nowMs) {
+    for (auto it = mUsages.begin(); it != mUsages.end();) {
+        if (decayedScore(it->second, nowMs) < kIdleScore) {
+            it = mUsages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t FrequencyEvictionPolicy::getUnusedSizeLimit(MemoryPressure pressure) {
+    switch (pressure) {
+        case MemoryPressure::NONE:
+            return mBudget;
+        case MemoryPressure::MODERATE:
+            return mBudget / 4;
+        case MemoryPressure::CRITICAL:
+            return 0;
+    }
+    return mBudget;
+}
+
+size_t FrequencyEvictionPolicy::getUnusedCountLimit(MemoryPressure pressure) {
+    switch (pressure) {
+        case MemoryPressure::NONE:
+            return kMaxUnusedBufferCount;
+        case MemoryPressure::MODERATE:
+            return kModerateUnusedBufferCount;
+        case MemoryPressure::CRITICAL:
+            return 0;
+    }
+    return kMaxUnusedBufferCount;
+}
+
+}  // namespace aidl::android::hardware::media::bufferpool2::implementation
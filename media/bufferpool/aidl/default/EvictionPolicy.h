@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+namespace aidl::android::hardware::media::bufferpool2::implementation {
+
+/** System memory pressure level. */
+enum class MemoryPressure {
+    NONE,
+    MODERATE,
+    CRITICAL,
+};
+
+/**
+ * Reads the current memory pressure level from PSI(pressure stall information).
+ *
+ * @return the memory pressure level, NONE when PSI is not available.
+ */
+MemoryPressure readMemoryPressure();
+
+/**
+ * Buffer pool eviction policy.
+ *
+ * Decides how many unused buffers a buffer pool caches and which of them are
+ * evicted first. Buffers are grouped by the hash of their allocation
+ * parameters(config). Methods are called with the buffer pool lock held.
+ */
+struct EvictionPolicy {
+    virtual ~EvictionPolicy() = default;
+
+    /**
+     * Notifies that a buffer with the config is requested.
+     *
+     * @param configHash    the hash of the allocation parameters.
+     * @param nowMs         the current time.
+     */
+    virtual void onRequested(size_t configHash, int64_t nowMs) = 0;
+
+    /**
+     * Returns the retention priority of the config. Unused buffers of the
+     * lowest priority config are evicted first.
+     */
+    virtual double getPriority(size_t configHash, int64_t nowMs) = 0;
+
+    /**
+     * Returns whether the config is idle. Unused buffers of idle configs are
+     * trimmed in the background.
+     */
+    virtual bool isIdle(size_t configHash, int64_t nowMs) = 0;
+
+    /** Forgets the state of idle configs. */
+    virtual void prune(int64_t nowMs) = 0;
+
+    /** Returns the maximum total size of unused buffers. (bytes or pixels) */
+    virtual size_t getUnusedSizeLimit(MemoryPressure pressure) = 0;
+
+    /** Returns the maximum # of unused buffers. */
+    virtual size_t getUnusedCountLimit(MemoryPressure pressure) = 0;
+};
+
+/**
+ * Default buffer pool eviction policy.
+ *
+ * Counts the requests of each config with an exponentially decaying counter,
+ * so unused buffers of frequently and recently requested configs are kept
+ * longest(LFU with aging). Unused buffers are bounded by a memory budget, which
+ * is reduced under memory pressure.
+ */
+struct FrequencyEvictionPolicy : public EvictionPolicy {
+    /**
+     * Creates a policy.
+     *
+     * @param budget    the total size of unused buffers to keep without memory
+     *                  pressure. 0 derives the budget from the device memory
+     *                  and the "ro.media.bufferpool.cache_budget_mb" property.
+     */
+    explicit FrequencyEvictionPolicy(size_t budget = 0);
+
+    void onRequested(size_t configHash, int64_t nowMs) override;
+    double getPriority(size_t configHash, int64_t nowMs) override;
+    bool isIdle(size_t configHash, int64_t nowMs) override;
+    void prune(int64_t nowMs) override;
+    size_t getUnusedSizeLimit(MemoryPressure pressure) override;
+    size_t getUnusedCountLimit(MemoryPressure pressure) override;
+
+private:
+    struct Usage {
+        double mScore;
+        int64_t mLastRequestMs;
+    };
+
+    static double decayedScore(const Usage &usage, int64_t nowMs);
+
+    const size_t mBudget;
+    std::unordered_map<size_t, Usage> mUsages;
+};
+
+}  // namespace aidl::android::hardware::media::bufferpool2::implementation
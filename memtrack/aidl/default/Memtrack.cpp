@@ -16,6 +16,15 @@
 
 #include "Memtrack.h"
 
+#include <dirent.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include <android-base/file.h>
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -31,13 +40,47 @@ ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
     }
     _aidl_return->clear();
+
+    // DMA-BUFs, including gralloc buffers, are reported as GRAPHICS and GPU private memory as
+    // GL. There is no memory of the other types that smaps does not account for.
+    std::optional<int64_t> size;
+    int32_t flags = MemtrackRecord::FLAG_SMAPS_UNACCOUNTED;
+    if (type == MemtrackType::GRAPHICS && pid != 0) {
+        size = mCache.getDmabufPss(pid);
+        flags |= MemtrackRecord::FLAG_SHARED_PSS;
+    } else if (type == MemtrackType::GL) {
+        size = pid == 0 ? mCache.getTotalGpuPrivateMemory() : mCache.getGpuPrivateMemory(pid);
+        flags |= MemtrackRecord::FLAG_PRIVATE;
+    }
+    if (size.has_value()) {
+        _aidl_return->push_back({.flags = flags, .sizeInBytes = *size});
+    }
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Memtrack::getGpuDeviceInfo(std::vector<DeviceInfo>* _aidl_return) {
     _aidl_return->clear();
-    DeviceInfo dev_info = {.id = 0, .name = "virtio_gpu"};
-    _aidl_return->emplace_back(dev_info);
+
+    // Each DRM card is a GPU, named after its driver.
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir("/sys/class/drm"), closedir);
+    if (dir == nullptr) {
+        return ndk::ScopedAStatus::ok();
+    }
+    while (struct dirent* entry = readdir(dir.get())) {
+        int id;
+        int length = 0;
+        if (sscanf(entry->d_name, "card%d%n", &id, &length) != 1 ||
+            entry->d_name[length] != '\0') {
+            continue;
+        }
+        std::string driver;
+        const std::string path = std::string("/sys/class/drm/") + entry->d_name + "/device/driver";
+        if (::android::base::Readlink(path, &driver)) {
+            _aidl_return->push_back({.id = id, .name = ::android::base::Basename(driver)});
+        }
+    }
+    std::sort(_aidl_return->begin(), _aidl_return->end(),
+              [](const DeviceInfo& a, const DeviceInfo& b) { return a.id < b.id; });
     return ndk::ScopedAStatus::ok();
 }
 
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MemtrackCache.h"
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+using ::android::base::ParseInt;
+using ::android::base::ParseUint;
+using ::android::base::ReadFileToString;
+using ::android::base::Readlink;
+using ::android::base::Split;
+using ::android::base::StartsWith;
+using ::android::base::Trim;
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace memtrack {
+
+namespace {
+
+using DirPtr = std::unique_ptr<DIR, decltype(&closedir)>;
+
+DirPtr openDir(const std::string& path) {
+    return DirPtr(opendir(path.c_str()), closedir);
+}
+
+// Parse the "key:\tvalue" lines of an fdinfo file.
+std::unordered_map<std::string, std::string> readFdInfo(const std::string& path) {
+    std::unordered_map<std::string, std::string> fields;
+    std::string content;
+    if (!ReadFileToString(path, &content)) {
+        return fields;
+    }
+    for (const auto& line : Split(content, "\n")) {
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            fields.emplace(line.substr(0, colon), Trim(line.substr(colon + 1)));
+        }
+    }
+    return fields;
+}
+
+// Parse a drm-* memory value, in bytes unless followed by KiB or MiB.
+int64_t parseDrmMemory(const std::string& value) {
+    std::vector<std::string> parts = Split(value, " ");
+    int64_t size;
+    if (parts.empty() || !ParseInt(parts[0], &size, int64_t{0})) {
+        return 0;
+    }
+    if (parts.size() > 1 && parts[1] == "KiB") {
+        return size * 1024;
+    }
+    if (parts.size() > 1 && parts[1] == "MiB") {
+        return size * 1024 * 1024;
+    }
+    return size;
+}
+
+// GPU private memory of a DRM client, as described by the DRM client usage stats: the total
+// size of the objects of each region less the shared ones, or the legacy resident memory.
+int64_t getDrmPrivateMemory(const std::unordered_map<std::string, std::string>& fdInfo) {
+    int64_t total = 0;
+    int64_t shared = 0;
+    int64_t legacy = 0;
+    bool hasTotal = false;
+    for (const auto& [key, value] : fdInfo) {
+        if (StartsWith(key, "drm-total-")) {
+            total += parseDrmMemory(value);
+            hasTotal = true;
+        } else if (StartsWith(key, "drm-shared-")) {
+            shared += parseDrmMemory(value);
+        } else if (StartsWith(key, "drm-memory-")) {
+            legacy += parseDrmMemory(value);
+        }
+    }
+    return hasTotal ? std::max<int64_t>(total - shared, 0) : legacy;
+}
+
+// Size of a DMA-BUF from the (deprecated) DMA-BUF sysfs stats.
+std::optional<int64_t> readDmabufSize(uint64_t inode) {
+    std::string content;
+    int64_t size;
+    if (!ReadFileToString("/sys/kernel/dmabuf/buffers/" + std::to_string(inode) + "/size",
+                          &content) ||
+        !ParseInt(Trim(content), &size, int64_t{0})) {
+        return std::nullopt;
+    }
+    return size;
+}
+
+}  // namespace
+
+bool MemtrackCache::scanProcess(int pid, Process* process) {
+    const std::string procDir = "/proc/" + std::to_string(pid) + "/";
+    DirPtr fdDir = openDir(procDir + "fd");
+    if (fdDir == nullptr) {
+        return false;
+    }
+
+    while (struct dirent* entry = readdir(fdDir.get())) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        const std::string fdPath = procDir + "fd/" + entry->d_name;
+        std::string target;
+        if (!Readlink(fdPath, &target)) {
+            continue;
+        }
+
+        if (StartsWith(target, "/dmabuf:") || target == "anon_inode:dmabuf") {
+            struct stat st;
+            int64_t size;
+            auto fdInfo = readFdInfo(procDir + "fdinfo/" + entry->d_name);
+            if (stat(fdPath.c_str(), &st) == 0 && ParseInt(fdInfo["size"], &size, int64_t{0})) {
+                process->dmabufs[st.st_ino] = size;
+            }
+        } else if (StartsWith(target, "/dev/dri/")) {
+            auto fdInfo = readFdInfo(procDir + "fdinfo/" + entry->d_name);
+            uint64_t clientId;
+            if (ParseUint(fdInfo["drm-client-id"], &clientId)) {
+                process->gpuClients[clientId] = getDrmPrivateMemory(fdInfo);
+            }
+        }
+    }
+
+    // Buffers may stay mapped after their fds are closed.
+    std::string maps;
+    if (!ReadFileToString(procDir + "maps", &maps)) {
+        return true;
+    }
+    std::unordered_map<uint64_t, int64_t> mappedSizes;
+    for (const auto& line : Split(maps, "\n")) {
+        if (line.find("/dmabuf") == std::string::npos) {
+            continue;
+        }
+        uint64_t start, end, inode;
+        if (sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %*s %*s %*s %" SCNu64, &start, &end,
+                   &inode) != 3 ||
+            process->dmabufs.count(inode) > 0) {
+            continue;
+        }
+        auto& mappedSize = mappedSizes[inode];
+        mappedSize = std::max<int64_t>(mappedSize, end - start);
+    }
+    for (const auto& [inode, mappedSize] : mappedSizes) {
+        process->dmabufs[inode] = readDmabufSize(inode).value_or(mappedSize);
+    }
+    return true;
+}
+
+MemtrackCache::Process* MemtrackCache::getProcessLocked(int pid) {
+    const auto now = Clock::now();
+    auto it = mProcesses.find(pid);
+    if (it != mProcesses.end() && now - it->second.sampleTime < kMaxAge) {
+        return &it->second;
+    }
+
+    Process process;
+    const bool exists = scanProcess(pid, &process);
+    if (it != mProcesses.end()) {
+        forgetProcessLocked(it);
+    }
+    if (!exists) {
+        return nullptr;
+    }
+
+    process.sampleTime = now;
+    for (const auto& [inode, size] : process.dmabufs) {
+        mDmabufHolders[inode]++;
+    }
+    return &(mProcesses[pid] = std::move(process));
+}
+
+void MemtrackCache::forgetProcessLocked(std::map<int, Process>::iterator it) {
+    for (const auto& [inode, size] : it->second.dmabufs) {
+        auto holders = mDmabufHolders.find(inode);
+        if (holders != mDmabufHolders.end() && --holders->second <= 0) {
+            mDmabufHolders.erase(holders);
+        }
+    }
+    mProcesses.erase(it);
+}
+
+void MemtrackCache::fullScanLocked() {
+    const auto now = Clock::now();
+    if (mFullScanTime.has_value() && now - *mFullScanTime < kFullScanInterval) {
+        return;
+    }
+    mFullScanTime = now;
+
+    DirPtr procDir = openDir("/proc");
+    if (procDir == nullptr) {
+        return;
+    }
+    std::unordered_set<int> pids;
+    while (struct dirent* entry = readdir(procDir.get())) {
+        int pid;
+        if (ParseInt(entry->d_name, &pid, 1) && getProcessLocked(pid) != nullptr) {
+            pids.insert(pid);
+        }
+    }
+
+    // Forget the processes that have exited since they were scanned.
+    for (auto it = mProcesses.begin(); it != mProcesses.end();) {
+        auto next = std::next(it);
+        if (pids.count(it->first) == 0) {
+            forgetProcessLocked(it);
+        }
+        it = next;
+    }
+}
+
+std::optional<int64_t> MemtrackCache::getDmabufPss(int pid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    fullScanLocked();
+    const Process* process = getProcessLocked(pid);
+    if (process == nullptr) {
+        return std::nullopt;
+    }
+
+    int64_t pss = 0;
+    for (const auto& [inode, size] : process->dmabufs) {
+        auto holders = mDmabufHolders.find(inode);
+        pss += size / std::max(holders != mDmabufHolders.end() ? holders->second : 1, 1);
+    }
+    return pss;
+}
+
+std::optional<int64_t> MemtrackCache::getGpuPrivateMemory(int pid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const Process* process = getProcessLocked(pid);
+    if (process == nullptr) {
+        return std::nullopt;
+    }
+
+    int64_t total = 0;
+    for (const auto& [clientId, size] : process->gpuClients) {
+        total += size;
+    }
+    return total;
+}
+
+int64_t MemtrackCache::getTotalGpuPrivateMemory() {
+    std::lock_guard<std::mutex> lock(mLock);
+    fullScanLocked();
+
+    // A DRM client shared between processes is counted once.
+    std::unordered_map<uint64_t, int64_t> clients;
+    for (const auto& [pid, process] : mProcesses) {
+        clients.insert(process.gpuClients.begin(), process.gpuClients.end());
+    }
+    int64_t total = 0;
+    for (const auto& [clientId, size] : clients) {
+        total += size;
+    }
+    return total;
+}
+
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
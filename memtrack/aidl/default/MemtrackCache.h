@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace memtrack {
+
+// Attributes DMA-BUF and GPU memory to processes.
+//
+// The DMA-BUFs of a process are those it holds an fd to or has mapped, and the PSS of a buffer is
+// its size shared in equal parts between the processes holding it. GPU private memory is read
+// from the drm-* keys of the fdinfo of the DRM fds of a process.
+//
+// getMemory() is called for every process and memory type in a row, so samples are cached: a
+// process is only scanned again once its sample is older than kMaxAge, and the whole of /proc,
+// which finds the other holders of the buffers, is walked at most once every kFullScanInterval.
+class MemtrackCache {
+  public:
+    static constexpr std::chrono::milliseconds kMaxAge{1000};
+    static constexpr std::chrono::milliseconds kFullScanInterval{10000};
+
+    // Return std::nullopt if the process does not exist.
+    std::optional<int64_t> getDmabufPss(int pid);
+    std::optional<int64_t> getGpuPrivateMemory(int pid);
+
+    // GPU private memory of all the processes.
+    int64_t getTotalGpuPrivateMemory();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Process {
+        Clock::time_point sampleTime;
+        // Inode to size of the DMA-BUFs held or mapped by the process.
+        std::unordered_map<uint64_t, int64_t> dmabufs;
+        // DRM client id to GPU private memory of the DRM clients the process has an fd to.
+        std::unordered_map<uint64_t, int64_t> gpuClients;
+    };
+
+    static bool scanProcess(int pid, Process* process);
+
+    // Return the process, scanned again if its sample is stale, or nullptr if it has exited.
+    Process* getProcessLocked(int pid);
+    void forgetProcessLocked(std::map<int, Process>::iterator it);
+    void fullScanLocked();
+
+    std::mutex mLock;
+    std::map<int, Process> mProcesses;
+    // Number of processes holding each DMA-BUF.
+    std::unordered_map<uint64_t, int> mDmabufHolders;
+    std::optional<Clock::time_point> mFullScanTime;
+};
+
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -26,11 +26,13 @@
 #include <nnapi/hal/CommonUtils.h>
 
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 // See hardware/interfaces/neuralnetworks/utils/README.md for more information on AIDL interface
 // lifetimes across processes and for protecting asynchronous calls across AIDL.
@@ -38,6 +40,11 @@
 namespace aidl::android::hardware::neuralnetworks::utils {
 
 // Class that adapts aidl_hal::IBurst to nn::IBurst.
+//
+// An aidl_hal::IBurst may only run one execution at a time. To let executions overlap, Burst keeps
+// a pool of aidl_hal::IBurst objects, each with its own MemoryCache. The pool starts with the burst
+// it is created with, and grows on demand up to `maxSlots` bursts made by `burstFactory`. Memory
+// cached with cacheMemory is cached on every burst of the pool that executes with it.
 class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst> {
     struct PrivateConstructorTag {};
 
@@ -45,6 +52,10 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
     /**
      * Thread-safe, self-cleaning cache that relates an nn::Memory object to a unique int64_t
      * identifier.
+     *
+     * The cache holds at most `capacity` memory objects. Caching another memory object evicts the
+     * least recently used entry that is not pinned by an execution and releases it from the
+     * driver. If every entry is pinned, the cache temporarily grows past its capacity.
      */
     class MemoryCache : public std::enable_shared_from_this<MemoryCache> {
       public:
@@ -53,7 +64,10 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
         using SharedCleanup = std::shared_ptr<const Cleanup>;
         using WeakCleanup = std::weak_ptr<const Cleanup>;
 
-        explicit MemoryCache(std::shared_ptr<aidl_hal::IBurst> burst);
+        static constexpr size_t kDefaultCapacity = 64;
+
+        explicit MemoryCache(std::shared_ptr<aidl_hal::IBurst> burst,
+                             size_t capacity = kDefaultCapacity);
 
         /**
          * Get or cache a memory object in the MemoryCache object.
@@ -70,28 +84,49 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
          *
          * @param memory Memory object to be cached while the returned `SharedCleanup` is alive.
          * @return A pair of (1) a unique identifier for the cache entry and (2) a ref-counted
-         *     "hold" object which preserves the cache as long as the hold object is alive. IF the
-         *     cache entry is not present, std::nullopt is returned instead.
+         *     "hold" object which preserves the cache as long as the hold object is alive and
+         *     pins it so it is not evicted. IF the cache entry is not present, std::nullopt is
+         *     returned instead.
          */
         std::optional<std::pair<int64_t, SharedCleanup>> getMemoryIfAvailable(
                 const nn::SharedMemory& memory);
 
       private:
-        void tryFreeMemory(const nn::SharedMemory& memory, int64_t identifier);
+        struct Entry {
+            int64_t identifier;
+            WeakCleanup hold;
+            // Set once the identifier is released from the driver, either by eviction or when the
+            // hold expires.
+            std::shared_ptr<std::atomic_bool> released;
+            uint64_t lastUse;
+            uint32_t pinCount;
+        };
+
+        void tryFreeMemory(const nn::SharedMemory& memory, int64_t identifier,
+                           const std::shared_ptr<std::atomic_bool>& released);
+        // Evicts the least recently used entry other than `memory` that is not pinned, and returns
+        // its identifier if it still has to be released from the driver.
+        std::optional<int64_t> evictLocked(const nn::SharedMemory& memory) REQUIRES(mMutex);
 
         const std::shared_ptr<aidl_hal::IBurst> kBurst;
+        const size_t kCapacity;
         std::mutex mMutex;
+        uint64_t mUseCounter GUARDED_BY(mMutex) = 0;
         int64_t mUnusedIdentifier GUARDED_BY(mMutex) = 0;
-        std::unordered_map<nn::SharedMemory, std::pair<int64_t, WeakCleanup>> mCache
-                GUARDED_BY(mMutex);
+        std::unordered_map<nn::SharedMemory, Entry> mCache GUARDED_BY(mMutex);
     };
 
-    // featureLevel is for testing purposes.
+    using BurstFactory = std::function<nn::GeneralResult<std::shared_ptr<aidl_hal::IBurst>>()>;
+
+    static constexpr size_t kDefaultMaxSlots = 4;
+
+    // featureLevel is for testing purposes. Without burstFactory, executions cannot overlap.
     static nn::GeneralResult<std::shared_ptr<const Burst>> create(
-            std::shared_ptr<aidl_hal::IBurst> burst, nn::Version featureLevel);
+            std::shared_ptr<aidl_hal::IBurst> burst, nn::Version featureLevel,
+            BurstFactory burstFactory = nullptr, size_t maxSlots = kDefaultMaxSlots);
 
     Burst(PrivateConstructorTag tag, std::shared_ptr<aidl_hal::IBurst> burst,
-          nn::Version featureLevel);
+          nn::Version featureLevel, BurstFactory burstFactory, size_t maxSlots);
 
     // See IBurst::cacheMemory for information.
     OptionalCacheHold cacheMemory(const nn::SharedMemory& memory) const override;
@@ -110,18 +145,43 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
             const std::vector<nn::TokenValuePair>& hints,
             const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const override;
 
+    // `memories` has the memory of each pool of the request, or nullptr for other pools.
     nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> executeInternal(
-            const aidl_hal::Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+            const aidl_hal::Request& request, const std::vector<nn::SharedMemory>& memories,
             bool measure, int64_t deadline, int64_t loopTimeoutDuration,
             const std::vector<nn::TokenValuePair>& hints,
             const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
             const hal::utils::RequestRelocation& relocation) const;
 
   private:
-    mutable std::atomic_flag mExecutionInFlight = ATOMIC_FLAG_INIT;
-    const std::shared_ptr<aidl_hal::IBurst> kBurst;
-    const std::shared_ptr<MemoryCache> kMemoryCache;
+    struct Slot {
+        explicit Slot(std::shared_ptr<aidl_hal::IBurst> burst);
+
+        const std::shared_ptr<aidl_hal::IBurst> kBurst;
+        const std::shared_ptr<MemoryCache> kMemoryCache;
+        std::atomic_flag executionInFlight = ATOMIC_FLAG_INIT;
+    };
+
+    // Memory cached by cacheMemory, with the holds on the caches of the slots that have used it.
+    struct CachedMemory {
+        MemoryCache::WeakCleanup hold;
+        std::vector<MemoryCache::SharedCleanup> slotHolds;
+    };
+
+    // Returns a slot with no execution in flight, marked as in flight.
+    nn::GeneralResult<Slot*> acquireSlot() const;
+    std::vector<int64_t> getMemoryIdentifierTokens(
+            Slot* slot, const std::vector<nn::SharedMemory>& memories,
+            std::vector<MemoryCache::SharedCleanup>* pins) const;
+    void releaseCachedMemory(const nn::SharedMemory& memory) const;
+
+    const BurstFactory kBurstFactory;
+    const size_t kMaxSlots;
     const nn::Version kFeatureLevel;
+    mutable std::mutex mMutex;
+    // Slots are never removed, so pointers to them stay valid.
+    mutable std::vector<std::unique_ptr<Slot>> mSlots GUARDED_BY(mMutex);
+    mutable std::unordered_map<nn::SharedMemory, CachedMemory> mCachedMemories GUARDED_BY(mMutex);
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::utils
@@ -19,12 +19,15 @@
 
 #include <aidl/android/hardware/neuralnetworks/IPreparedModel.h>
 #include <aidl/android/hardware/neuralnetworks/Request.h>
+#include <android-base/thread_annotations.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
 #include <nnapi/hal/CommonUtils.h>
 
+#include <list>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -88,8 +91,20 @@ class PreparedModel final : public nn::IPreparedModel,
                           const hal::utils::RequestRelocation& relocation) const;
 
   private:
+    // Converts a request, reusing the result of a recent conversion of the same request unless it
+    // was relocated from pointer-based memory.
+    nn::GeneralResult<std::shared_ptr<const Request>> convertRequest(const nn::Request& request,
+                                                                     bool isRelocated) const;
+
     const std::shared_ptr<aidl_hal::IPreparedModel> kPreparedModel;
     const nn::Version kFeatureLevel;
+
+    // Recently converted requests, most recently used first. The canonical request is kept to
+    // match later executions against, which also keeps its memory pools alive.
+    static constexpr size_t kMaxCachedRequests = 8;
+    mutable std::mutex mMutex;
+    mutable std::list<std::pair<nn::Request, std::shared_ptr<const Request>>> mCachedRequests
+            GUARDED_BY(mMutex);
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::utils
@@ -26,6 +26,8 @@
 #include <nnapi/Types.h>
 #include <nnapi/Validation.h>
 
+#include <functional>
+#include <optional>
 #include <type_traits>
 
 namespace aidl::android::hardware::neuralnetworks::utils {
@@ -92,6 +94,17 @@ nn::GeneralResult<Request> clone(const Request& request);
 nn::GeneralResult<RequestMemoryPool> clone(const RequestMemoryPool& requestPool);
 nn::GeneralResult<Model> clone(const Model& model);
 
+// Operand values of at least this many bytes are passed to the driver in shared memory.
+constexpr size_t kMinSharedOperandValuesSize = 64 * 1024;
+
+// Moves the CONSTANT_COPY operand values of `model` into a single shared memory pool so that they
+// are not copied into the parcel. If `model->operandValues` is smaller than
+// kMinSharedOperandValuesSize, `*model` is returned unchanged. Otherwise, the rewritten model is
+// stored in `*maybeModelInSharedOut` and returned. `model` may point to the contents of
+// `*maybeModelInSharedOut`, e.g. after hal::utils::flushDataFromPointerToShared.
+nn::GeneralResult<std::reference_wrapper<const nn::Model>> moveOperandValuesToShared(
+        const nn::Model* model, std::optional<nn::Model>* maybeModelInSharedOut);
+
 nn::GeneralResult<void> handleTransportError(const ndk::ScopedAStatus& ret);
 
 #define HANDLE_ASTATUS(ret)                                            \
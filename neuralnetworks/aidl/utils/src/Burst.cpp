@@ -27,6 +27,7 @@
 #include <nnapi/TypeUtils.h>
 #include <nnapi/Types.h>
 
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -42,14 +43,14 @@ class BurstExecution final : public nn::IExecution,
   public:
     static nn::GeneralResult<std::shared_ptr<const BurstExecution>> create(
             std::shared_ptr<const Burst> burst, Request request,
-            std::vector<int64_t> memoryIdentifierTokens, bool measure, int64_t loopTimeoutDuration,
+            std::vector<nn::SharedMemory> memories, bool measure, int64_t loopTimeoutDuration,
             const std::vector<nn::TokenValuePair>& hints,
             const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
             hal::utils::RequestRelocation relocation,
             std::vector<Burst::OptionalCacheHold> cacheHolds);
 
     BurstExecution(PrivateConstructorTag tag, std::shared_ptr<const Burst> burst, Request request,
-                   std::vector<int64_t> memoryIdentifierTokens, bool measure,
+                   std::vector<nn::SharedMemory> memories, bool measure,
                    int64_t loopTimeoutDuration, const std::vector<nn::TokenValuePair>& hints,
                    const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
                    hal::utils::RequestRelocation relocation,
@@ -65,7 +66,7 @@ class BurstExecution final : public nn::IExecution,
   private:
     const std::shared_ptr<const Burst> kBurst;
     const Request kRequest;
-    const std::vector<int64_t> kMemoryIdentifierTokens;
+    const std::vector<nn::SharedMemory> kMemories;
     const bool kMeasure;
     const int64_t kLoopTimeoutDuration;
     const std::vector<nn::TokenValuePair> kHints;
@@ -81,64 +82,121 @@ nn::GeneralResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> convertEx
 
 }  // namespace
 
-Burst::MemoryCache::MemoryCache(std::shared_ptr<aidl_hal::IBurst> burst)
-    : kBurst(std::move(burst)) {}
+Burst::MemoryCache::MemoryCache(std::shared_ptr<aidl_hal::IBurst> burst, size_t capacity)
+    : kBurst(std::move(burst)), kCapacity(capacity) {}
 
 std::pair<int64_t, Burst::MemoryCache::SharedCleanup> Burst::MemoryCache::getOrCacheMemory(
         const nn::SharedMemory& memory) {
-    std::lock_guard lock(mMutex);
-
-    // Get the cache payload or create it (with default values) if it does not exist.
-    auto& cachedPayload = mCache[memory];
+    std::pair<int64_t, SharedCleanup> result;
+    std::optional<int64_t> evictedIdentifier;
     {
-        const auto& [identifier, maybeCleaner] = cachedPayload;
+        std::lock_guard lock(mMutex);
+
+        // Get the cache payload or create it if it does not exist.
+        auto [iter, inserted] = mCache.try_emplace(memory);
+        auto& entry = iter->second;
         // If cache payload already exists, reuse it.
-        if (auto cleaner = maybeCleaner.lock()) {
-            return std::make_pair(identifier, std::move(cleaner));
+        if (!inserted) {
+            if (auto cleaner = entry.hold.lock()) {
+                entry.lastUse = ++mUseCounter;
+                return std::make_pair(entry.identifier, std::move(cleaner));
+            }
         }
-    }
 
-    // If the code reaches this point, the cached payload either did not exist or expired prior to
-    // this call.
+        // If the code reaches this point, the cached payload either did not exist or expired prior
+        // to this call.
 
-    // Allocate a new identifier.
-    CHECK_LT(mUnusedIdentifier, std::numeric_limits<int64_t>::max());
-    const int64_t identifier = mUnusedIdentifier++;
+        // Allocate a new identifier.
+        CHECK_LT(mUnusedIdentifier, std::numeric_limits<int64_t>::max());
+        const int64_t identifier = mUnusedIdentifier++;
 
-    // Create reference-counted self-cleaning cache object.
-    auto self = weak_from_this();
-    Task cleanup = [memory, identifier, maybeMemoryCache = std::move(self)] {
-        if (const auto memoryCache = maybeMemoryCache.lock()) {
-            memoryCache->tryFreeMemory(memory, identifier);
+        // Create reference-counted self-cleaning cache object.
+        auto self = weak_from_this();
+        auto released = std::make_shared<std::atomic_bool>(false);
+        Task cleanup = [memory, identifier, released, maybeMemoryCache = std::move(self)] {
+            if (const auto memoryCache = maybeMemoryCache.lock()) {
+                memoryCache->tryFreeMemory(memory, identifier, released);
+            }
+        };
+        auto cleaner = std::make_shared<const Cleanup>(std::move(cleanup));
+
+        // Store the result in the cache.
+        entry.identifier = identifier;
+        entry.hold = cleaner;
+        entry.released = std::move(released);
+        entry.lastUse = ++mUseCounter;
+        entry.pinCount = 0;
+        result = std::make_pair(identifier, std::move(cleaner));
+
+        if (mCache.size() > kCapacity) {
+            evictedIdentifier = evictLocked(memory);
         }
-    };
-    auto cleaner = std::make_shared<const Cleanup>(std::move(cleanup));
+    }
 
-    // Store the result in the cache and return it.
-    auto result = std::make_pair(identifier, std::move(cleaner));
-    cachedPayload = result;
+    if (evictedIdentifier.has_value()) {
+        kBurst->releaseMemoryResource(*evictedIdentifier);
+    }
     return result;
 }
 
 std::optional<std::pair<int64_t, Burst::MemoryCache::SharedCleanup>>
 Burst::MemoryCache::getMemoryIfAvailable(const nn::SharedMemory& memory) {
-    std::lock_guard lock(mMutex);
+    int64_t identifier;
+    SharedCleanup cleaner;
+    uint32_t* pinCount;
+    {
+        std::lock_guard lock(mMutex);
 
-    // Get the existing cached entry if it exists.
-    const auto iter = mCache.find(memory);
-    if (iter != mCache.end()) {
-        const auto& [identifier, maybeCleaner] = iter->second;
-        if (auto cleaner = maybeCleaner.lock()) {
-            return std::make_pair(identifier, std::move(cleaner));
+        // Get the existing cached entry if it exists.
+        const auto iter = mCache.find(memory);
+        if (iter == mCache.end()) {
+            return std::nullopt;
+        }
+        auto& entry = iter->second;
+        cleaner = entry.hold.lock();
+        if (cleaner == nullptr) {
+            // The cached payload was actively being deleted.
+            return std::nullopt;
         }
+        entry.lastUse = ++mUseCounter;
+        ++entry.pinCount;
+        identifier = entry.identifier;
+        pinCount = &entry.pinCount;
     }
 
-    // If the code reaches this point, the cached payload did not exist or was actively being
-    // deleted.
-    return std::nullopt;
+    // Pin the entry until the returned hold is released. The entry is not erased while `cleaner`
+    // is alive, so the pin can refer to it directly.
+    Task unpin = [pinCount, cleaner = std::move(cleaner), memoryCache = shared_from_this()] {
+        std::lock_guard lock(memoryCache->mMutex);
+        --*pinCount;
+    };
+    return std::make_pair(identifier, std::make_shared<const Cleanup>(std::move(unpin)));
+}
+
+std::optional<int64_t> Burst::MemoryCache::evictLocked(const nn::SharedMemory& memory) {
+    auto victim = mCache.end();
+    for (auto iter = mCache.begin(); iter != mCache.end(); ++iter) {
+        if (iter->first == memory || iter->second.pinCount > 0) {
+            continue;
+        }
+        if (victim == mCache.end() || iter->second.lastUse < victim->second.lastUse) {
+            victim = iter;
+        }
+    }
+    if (victim == mCache.end()) {
+        return std::nullopt;
+    }
+    const int64_t identifier = victim->second.identifier;
+    const bool alreadyReleased = victim->second.released->exchange(true);
+    mCache.erase(victim);
+    if (alreadyReleased) {
+        return std::nullopt;
+    }
+    return identifier;
 }
 
-void Burst::MemoryCache::tryFreeMemory(const nn::SharedMemory& memory, int64_t identifier) {
+void Burst::MemoryCache::tryFreeMemory(const nn::SharedMemory& memory, int64_t identifier,
+                                       const std::shared_ptr<std::atomic_bool>& released) {
     {
         std::lock_guard guard(mMutex);
         // Remove the cached memory and payload if it is present but expired. Note that it may not
@@ -146,37 +204,170 @@ void Burst::MemoryCache::tryFreeMemory(const nn::SharedMemory& memory, int64_t i
         // same memory object before the current thread locked mMutex in tryFreeMemory.
         const auto iter = mCache.find(memory);
         if (iter != mCache.end()) {
-            if (std::get<WeakCleanup>(iter->second).expired()) {
+            if (iter->second.hold.expired()) {
                 mCache.erase(iter);
             }
         }
     }
-    kBurst->releaseMemoryResource(identifier);
+    // An evicted entry has already been released.
+    if (!released->exchange(true)) {
+        kBurst->releaseMemoryResource(identifier);
+    }
 }
 
 nn::GeneralResult<std::shared_ptr<const Burst>> Burst::create(
-        std::shared_ptr<aidl_hal::IBurst> burst, nn::Version featureLevel) {
+        std::shared_ptr<aidl_hal::IBurst> burst, nn::Version featureLevel,
+        BurstFactory burstFactory, size_t maxSlots) {
     if (burst == nullptr) {
         return NN_ERROR(nn::ErrorStatus::GENERAL_FAILURE)
                << "aidl_hal::utils::Burst::create must have non-null burst";
     }
+    if (maxSlots == 0) {
+        return NN_ERROR(nn::ErrorStatus::GENERAL_FAILURE)
+               << "aidl_hal::utils::Burst::create must have at least one slot";
+    }
 
-    return std::make_shared<const Burst>(PrivateConstructorTag{}, std::move(burst), featureLevel);
+    return std::make_shared<const Burst>(PrivateConstructorTag{}, std::move(burst), featureLevel,
+                                         std::move(burstFactory), maxSlots);
 }
 
-Burst::Burst(PrivateConstructorTag /*tag*/, std::shared_ptr<aidl_hal::IBurst> burst,
-             nn::Version featureLevel)
-    : kBurst(std::move(burst)),
-      kMemoryCache(std::make_shared<MemoryCache>(kBurst)),
-      kFeatureLevel(featureLevel) {
+Burst::Slot::Slot(std::shared_ptr<aidl_hal::IBurst> burst)
+    : kBurst(std::move(burst)), kMemoryCache(std::make_shared<MemoryCache>(kBurst)) {
     CHECK(kBurst != nullptr);
 }
 
+Burst::Burst(PrivateConstructorTag /*tag*/, std::shared_ptr<aidl_hal::IBurst> burst,
+             nn::Version featureLevel, BurstFactory burstFactory, size_t maxSlots)
+    : kBurstFactory(std::move(burstFactory)), kMaxSlots(maxSlots), kFeatureLevel(featureLevel) {
+    mSlots.push_back(std::make_unique<Slot>(std::move(burst)));
+}
+
 Burst::OptionalCacheHold Burst::cacheMemory(const nn::SharedMemory& memory) const {
-    auto [identifier, hold] = kMemoryCache->getOrCacheMemory(memory);
+    MemoryCache::SharedCleanup hold;
+    std::vector<Slot*> slots;
+    // Holds of an entry whose hold expired but which was not erased yet, released after mMutex.
+    std::vector<MemoryCache::SharedCleanup> staleSlotHolds;
+    {
+        std::lock_guard lock(mMutex);
+        auto& cachedMemory = mCachedMemories[memory];
+        if (auto existingHold = cachedMemory.hold.lock()) {
+            return existingHold;
+        }
+
+        MemoryCache::Task release = [memory, maybeBurst = weak_from_this()] {
+            if (const auto burst = maybeBurst.lock()) {
+                burst->releaseCachedMemory(memory);
+            }
+        };
+        hold = std::make_shared<const MemoryCache::Cleanup>(std::move(release));
+        cachedMemory.hold = hold;
+        staleSlotHolds = std::move(cachedMemory.slotHolds);
+        cachedMemory.slotHolds.clear();
+
+        slots.reserve(mSlots.size());
+        for (const auto& slot : mSlots) {
+            slots.push_back(slot.get());
+        }
+    }
+
+    // Cache the memory on the slots that already exist, other slots cache it on first use. This
+    // is done without mMutex because evicting memory from a MemoryCache calls into the driver.
+    std::vector<MemoryCache::SharedCleanup> slotHolds;
+    slotHolds.reserve(slots.size());
+    for (Slot* slot : slots) {
+        slotHolds.push_back(slot->kMemoryCache->getOrCacheMemory(memory).second);
+    }
+    {
+        std::lock_guard lock(mMutex);
+        auto& cachedMemory = mCachedMemories[memory];
+        cachedMemory.slotHolds.insert(cachedMemory.slotHolds.end(),
+                                      std::make_move_iterator(slotHolds.begin()),
+                                      std::make_move_iterator(slotHolds.end()));
+    }
     return hold;
 }
 
+void Burst::releaseCachedMemory(const nn::SharedMemory& memory) const {
+    std::vector<MemoryCache::SharedCleanup> slotHolds;
+    {
+        std::lock_guard lock(mMutex);
+        // The memory may have been cached again before the lock was taken.
+        const auto iter = mCachedMemories.find(memory);
+        if (iter == mCachedMemories.end() || !iter->second.hold.expired()) {
+            return;
+        }
+        slotHolds = std::move(iter->second.slotHolds);
+        mCachedMemories.erase(iter);
+    }
+    // The holds are released outside of mMutex, as releasing them calls into the driver.
+}
+
+nn::GeneralResult<Burst::Slot*> Burst::acquireSlot() const {
+    std::lock_guard lock(mMutex);
+    for (const auto& slot : mSlots) {
+        if (!slot->executionInFlight.test_and_set()) {
+            return slot.get();
+        }
+    }
+
+    if (mSlots.size() >= kMaxSlots || kBurstFactory == nullptr) {
+        return NN_ERROR() << "IBurst already has an execution in flight";
+    }
+    // Slots are only added when executions actually overlap, so this is rare enough to be done
+    // under mMutex.
+    auto burst = NN_TRY(kBurstFactory());
+    if (burst == nullptr) {
+        return NN_ERROR() << "IBurst factory returned a null burst";
+    }
+    auto& slot = mSlots.emplace_back(std::make_unique<Slot>(std::move(burst)));
+    slot->executionInFlight.test_and_set();
+    return slot.get();
+}
+
+std::vector<int64_t> Burst::getMemoryIdentifierTokens(
+        Slot* slot, const std::vector<nn::SharedMemory>& memories,
+        std::vector<MemoryCache::SharedCleanup>* pins) const {
+    std::vector<int64_t> memoryIdentifierTokens;
+    memoryIdentifierTokens.reserve(memories.size());
+    for (const auto& memory : memories) {
+        if (memory == nullptr) {
+            memoryIdentifierTokens.push_back(-1);
+            continue;
+        }
+
+        auto cached = slot->kMemoryCache->getMemoryIfAvailable(memory);
+        if (!cached.has_value()) {
+            // Memory cached with cacheMemory before this slot was created or while the slot was
+            // evicting it is cached on the slot now, for as long as the cacheMemory hold lives.
+            bool wasCachedByClient;
+            {
+                std::lock_guard lock(mMutex);
+                const auto iter = mCachedMemories.find(memory);
+                wasCachedByClient = iter != mCachedMemories.end() && !iter->second.hold.expired();
+            }
+            if (wasCachedByClient) {
+                auto slotHold = slot->kMemoryCache->getOrCacheMemory(memory).second;
+                cached = slot->kMemoryCache->getMemoryIfAvailable(memory);
+                std::lock_guard lock(mMutex);
+                const auto iter = mCachedMemories.find(memory);
+                if (iter != mCachedMemories.end()) {
+                    iter->second.slotHolds.push_back(std::move(slotHold));
+                }
+            }
+        }
+
+        if (cached.has_value()) {
+            auto& [identifier, pin] = *cached;
+            memoryIdentifierTokens.push_back(identifier);
+            pins->push_back(std::move(pin));
+        } else {
+            memoryIdentifierTokens.push_back(-1);
+        }
+    }
+    CHECK_EQ(memories.size(), memoryIdentifierTokens.size());
+    return memoryIdentifierTokens;
+}
+
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::execute(
         const nn::Request& request, nn::MeasureTiming measure,
         const nn::OptionalTimePoint& deadline, const nn::OptionalDuration& loopTimeoutDuration,
@@ -194,37 +385,28 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::
     const auto aidlDeadline = NN_TRY(convert(deadline));
     const auto aidlLoopTimeoutDuration = NN_TRY(convert(loopTimeoutDuration));
 
-    std::vector<int64_t> memoryIdentifierTokens;
-    std::vector<OptionalCacheHold> holds;
-    memoryIdentifierTokens.reserve(requestInShared.pools.size());
-    holds.reserve(requestInShared.pools.size());
+    std::vector<nn::SharedMemory> memories;
+    memories.reserve(requestInShared.pools.size());
     for (const auto& memoryPool : requestInShared.pools) {
-        if (const auto* memory = std::get_if<nn::SharedMemory>(&memoryPool)) {
-            if (auto cached = kMemoryCache->getMemoryIfAvailable(*memory)) {
-                auto& [identifier, hold] = *cached;
-                memoryIdentifierTokens.push_back(identifier);
-                holds.push_back(std::move(hold));
-                continue;
-            }
-        }
-        memoryIdentifierTokens.push_back(-1);
+        const auto* memory = std::get_if<nn::SharedMemory>(&memoryPool);
+        memories.push_back(memory != nullptr ? *memory : nullptr);
     }
-    CHECK_EQ(requestInShared.pools.size(), memoryIdentifierTokens.size());
-    return executeInternal(aidlRequest, memoryIdentifierTokens, aidlMeasure, aidlDeadline,
+    return executeInternal(aidlRequest, memories, aidlMeasure, aidlDeadline,
                            aidlLoopTimeoutDuration, hints, extensionNameToPrefix, relocation);
 }
 
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::executeInternal(
-        const Request& request, const std::vector<int64_t>& memoryIdentifierTokens, bool measure,
+        const Request& request, const std::vector<nn::SharedMemory>& memories, bool measure,
         int64_t deadline, int64_t loopTimeoutDuration, const std::vector<nn::TokenValuePair>& hints,
         const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
         const hal::utils::RequestRelocation& relocation) const {
-    // Ensure that at most one execution is in flight at any given time.
-    const bool alreadyInFlight = mExecutionInFlight.test_and_set();
-    if (alreadyInFlight) {
-        return NN_ERROR() << "IBurst already has an execution in flight";
-    }
-    const auto guard = ::android::base::make_scope_guard([this] { mExecutionInFlight.clear(); });
+    // Ensure that each aidl_hal::IBurst has at most one execution in flight at any given time.
+    Slot* const slot = NN_TRY(acquireSlot());
+    const auto guard =
+            ::android::base::make_scope_guard([slot] { slot->executionInFlight.clear(); });
+
+    std::vector<MemoryCache::SharedCleanup> pins;
+    const auto memoryIdentifierTokens = getMemoryIdentifierTokens(slot, memories, &pins);
 
     if (relocation.input) {
         relocation.input->flush();
@@ -234,7 +416,7 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::
     if (kFeatureLevel.level >= nn::Version::Level::FEATURE_LEVEL_8) {
         auto aidlHints = NN_TRY(convert(hints));
         auto aidlExtensionPrefix = NN_TRY(convert(extensionNameToPrefix));
-        const auto ret = kBurst->executeSynchronouslyWithConfig(
+        const auto ret = slot->kBurst->executeSynchronouslyWithConfig(
                 request, memoryIdentifierTokens,
                 {measure, loopTimeoutDuration, std::move(aidlHints),
                  std::move(aidlExtensionPrefix)},
@@ -242,8 +424,8 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::
         HANDLE_ASTATUS(ret) << "execute failed";
     } else {
         const auto ret =
-                kBurst->executeSynchronously(request, memoryIdentifierTokens, measure, deadline,
-                                             loopTimeoutDuration, &executionResult);
+                slot->kBurst->executeSynchronously(request, memoryIdentifierTokens, measure,
+                                                   deadline, loopTimeoutDuration, &executionResult);
         HANDLE_ASTATUS(ret) << "execute failed";
     }
     if (!executionResult.outputSufficientSize) {
@@ -277,32 +459,30 @@ nn::GeneralResult<nn::SharedExecution> Burst::createReusableExecution(
     const auto aidlMeasure = NN_TRY(convert(measure));
     const auto aidlLoopTimeoutDuration = NN_TRY(convert(loopTimeoutDuration));
 
-    std::vector<int64_t> memoryIdentifierTokens;
+    std::vector<nn::SharedMemory> memories;
     std::vector<OptionalCacheHold> holds;
-    memoryIdentifierTokens.reserve(requestInShared.pools.size());
+    memories.reserve(requestInShared.pools.size());
     holds.reserve(requestInShared.pools.size());
     for (const auto& memoryPool : requestInShared.pools) {
-        if (const auto* memory = std::get_if<nn::SharedMemory>(&memoryPool)) {
-            if (auto cached = kMemoryCache->getMemoryIfAvailable(*memory)) {
-                auto& [identifier, hold] = *cached;
-                memoryIdentifierTokens.push_back(identifier);
-                holds.push_back(std::move(hold));
-                continue;
-            }
+        const auto* memory = std::get_if<nn::SharedMemory>(&memoryPool);
+        memories.push_back(memory != nullptr ? *memory : nullptr);
+        // Unlike a one-off execution, cache the memory now so that every compute of this reusable
+        // execution refers to it by identifier, whichever slot it runs on, until the execution is
+        // destroyed.
+        if (memory != nullptr) {
+            holds.push_back(cacheMemory(*memory));
         }
-        memoryIdentifierTokens.push_back(-1);
     }
-    CHECK_EQ(requestInShared.pools.size(), memoryIdentifierTokens.size());
 
     return BurstExecution::create(shared_from_this(), std::move(aidlRequest),
-                                  std::move(memoryIdentifierTokens), aidlMeasure,
+                                  std::move(memories), aidlMeasure,
                                   aidlLoopTimeoutDuration, hints, extensionNameToPrefix,
                                   std::move(relocation), std::move(holds));
 }
 
 nn::GeneralResult<std::shared_ptr<const BurstExecution>> BurstExecution::create(
         std::shared_ptr<const Burst> burst, Request request,
-        std::vector<int64_t> memoryIdentifierTokens, bool measure, int64_t loopTimeoutDuration,
+        std::vector<nn::SharedMemory> memories, bool measure, int64_t loopTimeoutDuration,
         const std::vector<nn::TokenValuePair>& hints,
         const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
         hal::utils::RequestRelocation relocation,
@@ -313,12 +493,12 @@ nn::GeneralResult<std::shared_ptr<const BurstExecution>> BurstExecution::create(
 
     return std::make_shared<const BurstExecution>(
             PrivateConstructorTag{}, std::move(burst), std::move(request),
-            std::move(memoryIdentifierTokens), measure, loopTimeoutDuration, hints,
+            std::move(memories), measure, loopTimeoutDuration, hints,
             extensionNameToPrefix, std::move(relocation), std::move(cacheHolds));
 }
 
 BurstExecution::BurstExecution(PrivateConstructorTag /*tag*/, std::shared_ptr<const Burst> burst,
-                               Request request, std::vector<int64_t> memoryIdentifierTokens,
+                               Request request, std::vector<nn::SharedMemory> memories,
                                bool measure, int64_t loopTimeoutDuration,
                                const std::vector<nn::TokenValuePair>& hints,
                                const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix,
@@ -326,7 +506,7 @@ BurstExecution::BurstExecution(PrivateConstructorTag /*tag*/, std::shared_ptr<co
                                std::vector<Burst::OptionalCacheHold> cacheHolds)
     : kBurst(std::move(burst)),
       kRequest(std::move(request)),
-      kMemoryIdentifierTokens(std::move(memoryIdentifierTokens)),
+      kMemories(std::move(memories)),
       kMeasure(measure),
       kLoopTimeoutDuration(loopTimeoutDuration),
       kHints(hints),
@@ -337,7 +517,7 @@ BurstExecution::BurstExecution(PrivateConstructorTag /*tag*/, std::shared_ptr<co
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> BurstExecution::compute(
         const nn::OptionalTimePoint& deadline) const {
     const auto aidlDeadline = NN_TRY(convert(deadline));
-    return kBurst->executeInternal(kRequest, kMemoryIdentifierTokens, kMeasure, aidlDeadline,
+    return kBurst->executeInternal(kRequest, kMemories, kMeasure, aidlDeadline,
                                    kLoopTimeoutDuration, kHints, kExtensionNameToPrefix,
                                    kRelocation);
 }
@@ -38,6 +38,7 @@
 #include <algorithm>
 #include <chrono>
 #include <functional>
+#include <future>
 #include <iterator>
 #include <limits>
 #include <type_traits>
@@ -798,6 +799,53 @@ nn::GeneralResult<std::vector<UnvalidatedConvertOutput<Type>>> unvalidatedConver
     return halObject;
 }
 
+// Operand and operation tables of large models are converted in chunks of at least this many
+// elements, each on its own thread.
+constexpr size_t kMinParallelConversionChunkSize = 512;
+constexpr size_t kMaxParallelConversionTasks = 4;
+
+template <typename Type>
+nn::GeneralResult<std::vector<UnvalidatedConvertOutput<Type>>> unvalidatedConvertParallel(
+        const std::vector<Type>& arguments) {
+    const size_t size = arguments.size();
+    const size_t numTasks =
+            std::min(kMaxParallelConversionTasks, size / kMinParallelConversionChunkSize);
+    if (numTasks <= 1) {
+        return unvalidatedConvert(arguments);
+    }
+
+    // Each chunk writes to its own slice of the preallocated output.
+    std::vector<UnvalidatedConvertOutput<Type>> halObject(size);
+    const auto convertChunk = [&arguments, &halObject](size_t begin,
+                                                       size_t end) -> nn::GeneralResult<void> {
+        for (size_t i = begin; i < end; ++i) {
+            halObject[i] = NN_TRY(unvalidatedConvert(arguments[i]));
+        }
+        return {};
+    };
+
+    const size_t chunkSize = (size + numTasks - 1) / numTasks;
+    std::vector<std::future<nn::GeneralResult<void>>> chunks;
+    chunks.reserve(numTasks - 1);
+    for (size_t begin = chunkSize; begin < size; begin += chunkSize) {
+        chunks.push_back(std::async(std::launch::async, convertChunk, begin,
+                                    std::min(begin + chunkSize, size)));
+    }
+    auto result = convertChunk(0, chunkSize);
+
+    // Wait for every chunk before returning, as they all refer to `halObject`.
+    for (auto& chunk : chunks) {
+        auto chunkResult = chunk.get();
+        if (result.has_value() && !chunkResult.has_value()) {
+            result = std::move(chunkResult);
+        }
+    }
+    if (!result.has_value()) {
+        return NN_ERROR(result.error().code) << result.error().message;
+    }
+    return halObject;
+}
+
 template <typename Type>
 nn::GeneralResult<UnvalidatedConvertOutput<Type>> validatedConvert(const Type& canonical) {
     NN_TRY(compliantVersion(canonical));
@@ -985,8 +1033,8 @@ nn::GeneralResult<Operation> unvalidatedConvert(const nn::Operation& operation)
 }
 
 nn::GeneralResult<Subgraph> unvalidatedConvert(const nn::Model::Subgraph& subgraph) {
-    auto operands = NN_TRY(unvalidatedConvert(subgraph.operands));
-    auto operations = NN_TRY(unvalidatedConvert(subgraph.operations));
+    auto operands = NN_TRY(unvalidatedConvertParallel(subgraph.operands));
+    auto operations = NN_TRY(unvalidatedConvertParallel(subgraph.operations));
     auto inputIndexes = NN_TRY(toSigned(subgraph.inputIndexes));
     auto outputIndexes = NN_TRY(toSigned(subgraph.outputIndexes));
     return Subgraph{
@@ -1016,8 +1064,18 @@ nn::GeneralResult<Model> unvalidatedConvert(const nn::Model& model) {
                << "Model cannot be unvalidatedConverted because it contains pointer-based memory";
     }
 
-    auto main = NN_TRY(unvalidatedConvert(model.main));
-    auto referenced = NN_TRY(unvalidatedConvert(model.referenced));
+    // Convert the referenced subgraphs of large models concurrently with the main subgraph.
+    std::future<nn::GeneralResult<std::vector<Subgraph>>> maybeReferenced;
+    if (!model.referenced.empty() &&
+        model.main.operations.size() >= kMinParallelConversionChunkSize) {
+        maybeReferenced = std::async(std::launch::async, [&model] {
+            return unvalidatedConvert(model.referenced);
+        });
+    }
+    auto maybeMain = unvalidatedConvert(model.main);
+    auto referenced = NN_TRY(maybeReferenced.valid() ? maybeReferenced.get()
+                                                     : unvalidatedConvert(model.referenced));
+    auto main = NN_TRY(std::move(maybeMain));
     auto operandValues = NN_TRY(unvalidatedConvert(model.operandValues));
     auto pools = NN_TRY(unvalidatedConvert(model.pools));
     auto extensionNameToPrefix = NN_TRY(unvalidatedConvert(model.extensionNameToPrefix));
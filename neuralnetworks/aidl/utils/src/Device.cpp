@@ -200,8 +200,10 @@ nn::GeneralResult<void> Device::wait() const {
 nn::GeneralResult<std::vector<bool>> Device::getSupportedOperations(const nn::Model& model) const {
     // Ensure that model is ready for IPC.
     std::optional<nn::Model> maybeModelInShared;
-    const nn::Model& modelInShared =
+    const nn::Model& modelWithFlushedData =
             NN_TRY(hal::utils::flushDataFromPointerToShared(&model, &maybeModelInShared));
+    const nn::Model& modelInShared =
+            NN_TRY(moveOperandValuesToShared(&modelWithFlushedData, &maybeModelInShared));
 
     const auto aidlModel = NN_TRY(convert(modelInShared));
 
@@ -220,8 +222,10 @@ nn::GeneralResult<nn::SharedPreparedModel> Device::prepareModel(
         const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const {
     // Ensure that model is ready for IPC.
     std::optional<nn::Model> maybeModelInShared;
-    const nn::Model& modelInShared =
+    const nn::Model& modelWithFlushedData =
             NN_TRY(hal::utils::flushDataFromPointerToShared(&model, &maybeModelInShared));
+    const nn::Model& modelInShared =
+            NN_TRY(moveOperandValuesToShared(&modelWithFlushedData, &maybeModelInShared));
 
     const auto aidlModel = NN_TRY(convert(modelInShared));
     const auto aidlPreference = NN_TRY(convert(preference));
@@ -31,7 +31,9 @@
 #include <nnapi/Types.h>
 #include <nnapi/hal/CommonUtils.h>
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -47,6 +49,21 @@ nn::GeneralResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> convertEx
     return std::make_pair(NN_TRY(nn::convert(outputShapes)), NN_TRY(nn::convert(timing)));
 }
 
+bool isSameArgument(const nn::Request::Argument& a, const nn::Request::Argument& b) {
+    return a.lifetime == b.lifetime && a.location.poolIndex == b.location.poolIndex &&
+           a.location.offset == b.location.offset && a.location.length == b.location.length &&
+           a.location.padding == b.location.padding && a.dimensions == b.dimensions;
+}
+
+bool isSameRequest(const nn::Request& a, const nn::Request& b) {
+    // Memory pools are compared by identity.
+    return a.pools == b.pools &&
+           std::equal(a.inputs.begin(), a.inputs.end(), b.inputs.begin(), b.inputs.end(),
+                      isSameArgument) &&
+           std::equal(a.outputs.begin(), a.outputs.end(), b.outputs.begin(), b.outputs.end(),
+                      isSameArgument);
+}
+
 nn::GeneralResult<std::pair<nn::Timing, nn::Timing>> convertFencedExecutionResults(
         ErrorStatus status, const aidl_hal::Timing& timingLaunched,
         const aidl_hal::Timing& timingFenced) {
@@ -126,6 +143,34 @@ PreparedModel::PreparedModel(PrivateConstructorTag /*tag*/,
                              nn::Version featureLevel)
     : kPreparedModel(std::move(preparedModel)), kFeatureLevel(featureLevel) {}
 
+nn::GeneralResult<std::shared_ptr<const Request>> PreparedModel::convertRequest(
+        const nn::Request& request, bool isRelocated) const {
+    // A relocated request gets a new shared memory pool on every call, so it is never cached.
+    if (isRelocated) {
+        return std::make_shared<const Request>(NN_TRY(convert(request)));
+    }
+
+    {
+        std::lock_guard guard(mMutex);
+        const auto iter = std::find_if(
+                mCachedRequests.begin(), mCachedRequests.end(),
+                [&request](const auto& cached) { return isSameRequest(cached.first, request); });
+        if (iter != mCachedRequests.end()) {
+            mCachedRequests.splice(mCachedRequests.begin(), mCachedRequests, iter);
+            return iter->second;
+        }
+    }
+
+    auto aidlRequest = std::make_shared<const Request>(NN_TRY(convert(request)));
+
+    std::lock_guard guard(mMutex);
+    mCachedRequests.emplace_front(request, aidlRequest);
+    if (mCachedRequests.size() > kMaxCachedRequests) {
+        mCachedRequests.pop_back();
+    }
+    return aidlRequest;
+}
+
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> PreparedModel::execute(
         const nn::Request& request, nn::MeasureTiming measure,
         const nn::OptionalTimePoint& deadline, const nn::OptionalDuration& loopTimeoutDuration,
@@ -138,11 +183,12 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Prepare
             &request, nn::kDefaultRequestMemoryAlignment, nn::kDefaultRequestMemoryPadding,
             &maybeRequestInShared, &relocation));
 
-    const auto aidlRequest = NN_TRY(convert(requestInShared));
+    const auto aidlRequest =
+            NN_TRY(convertRequest(requestInShared, maybeRequestInShared.has_value()));
     const auto aidlMeasure = NN_TRY(convert(measure));
     const auto aidlDeadline = NN_TRY(convert(deadline));
     const auto aidlLoopTimeoutDuration = NN_TRY(convert(loopTimeoutDuration));
-    return executeInternal(aidlRequest, aidlMeasure, aidlDeadline, aidlLoopTimeoutDuration, hints,
+    return executeInternal(*aidlRequest, aidlMeasure, aidlDeadline, aidlLoopTimeoutDuration, hints,
                            extensionNameToPrefix, relocation);
 }
 
@@ -189,13 +235,14 @@ PreparedModel::executeFenced(
             &request, nn::kDefaultRequestMemoryAlignment, nn::kDefaultRequestMemoryPadding,
             &maybeRequestInShared, &relocation));
 
-    const auto aidlRequest = NN_TRY(convert(requestInShared));
+    const auto aidlRequest =
+            NN_TRY(convertRequest(requestInShared, maybeRequestInShared.has_value()));
     const auto aidlWaitFor = NN_TRY(convert(waitFor));
     const auto aidlMeasure = NN_TRY(convert(measure));
     const auto aidlDeadline = NN_TRY(convert(deadline));
     const auto aidlLoopTimeoutDuration = NN_TRY(convert(loopTimeoutDuration));
     const auto aidlTimeoutDurationAfterFence = NN_TRY(convert(timeoutDurationAfterFence));
-    return executeFencedInternal(aidlRequest, aidlWaitFor, aidlMeasure, aidlDeadline,
+    return executeFencedInternal(*aidlRequest, aidlWaitFor, aidlMeasure, aidlDeadline,
                                  aidlLoopTimeoutDuration, aidlTimeoutDurationAfterFence, hints,
                                  extensionNameToPrefix, relocation);
 }
@@ -269,7 +316,16 @@ nn::GeneralResult<nn::SharedBurst> PreparedModel::configureExecutionBurst() cons
     std::shared_ptr<IBurst> burst;
     const auto ret = kPreparedModel->configureExecutionBurst(&burst);
     HANDLE_ASTATUS(ret) << "configureExecutionBurst failed";
-    return Burst::create(std::move(burst), kFeatureLevel);
+
+    // Additional bursts let executions on the returned burst overlap.
+    auto burstFactory = [preparedModel = kPreparedModel]()
+            -> nn::GeneralResult<std::shared_ptr<IBurst>> {
+        std::shared_ptr<IBurst> burst;
+        const auto ret = preparedModel->configureExecutionBurst(&burst);
+        HANDLE_ASTATUS(ret) << "configureExecutionBurst failed";
+        return burst;
+    };
+    return Burst::create(std::move(burst), kFeatureLevel, std::move(burstFactory));
 }
 
 std::any PreparedModel::getUnderlyingResource() const {
@@ -24,6 +24,9 @@
 #include <nnapi/Result.h>
 #include <nnapi/SharedMemory.h>
 
+#include <cstring>
+#include <variant>
+
 namespace aidl::android::hardware::neuralnetworks::utils {
 namespace {
 
@@ -58,6 +61,15 @@ nn::GeneralResult<common::NativeHandle> clone(const common::NativeHandle& handle
     };
 }
 
+void makeOperandValuesShared(nn::Model::Subgraph* subgraph, uint32_t poolIndex) {
+    for (auto& operand : subgraph->operands) {
+        if (operand.lifetime == nn::Operand::LifeTime::CONSTANT_COPY) {
+            operand.lifetime = nn::Operand::LifeTime::CONSTANT_REFERENCE;
+            operand.location.poolIndex = poolIndex;
+        }
+    }
+}
+
 }  // namespace
 
 nn::GeneralResult<Memory> clone(const Memory& memory) {
@@ -133,6 +145,39 @@ nn::GeneralResult<Model> clone(const Model& model) {
     };
 }
 
+nn::GeneralResult<std::reference_wrapper<const nn::Model>> moveOperandValuesToShared(
+        const nn::Model* model, std::optional<nn::Model>* maybeModelInSharedOut) {
+    CHECK(model != nullptr);
+    CHECK(maybeModelInSharedOut != nullptr);
+
+    const size_t size = model->operandValues.size();
+    if (size < kMinSharedOperandValuesSize) {
+        return *model;
+    }
+
+    // Copy all operand values into one region with a single memcpy. Offsets of the operands are
+    // unchanged, and the operand values are already laid out with the required alignment.
+    const auto memory = NN_TRY(nn::createSharedMemory(size));
+    {
+        const auto mapping = NN_TRY(nn::map(memory));
+        void* data = std::get<void*>(mapping.pointer);
+        std::memcpy(data, model->operandValues.data(), size);
+    }
+
+    if (!maybeModelInSharedOut->has_value() || &maybeModelInSharedOut->value() != model) {
+        *maybeModelInSharedOut = *model;
+    }
+    nn::Model& modelInShared = maybeModelInSharedOut->value();
+    const auto poolIndex = static_cast<uint32_t>(modelInShared.pools.size());
+    modelInShared.pools.push_back(memory);
+    makeOperandValuesShared(&modelInShared.main, poolIndex);
+    for (auto& subgraph : modelInShared.referenced) {
+        makeOperandValuesShared(&subgraph, poolIndex);
+    }
+    modelInShared.operandValues = nn::Model::OperandValues();
+    return modelInShared;
+}
+
 nn::GeneralResult<void> handleTransportError(const ndk::ScopedAStatus& ret) {
     if (ret.getStatus() == STATUS_DEAD_OBJECT) {
         return nn::error(nn::ErrorStatus::DEAD_OBJECT)
@@ -54,6 +54,36 @@ const nn::Model kSimpleModel = {
                  .inputIndexes = {0},
                  .outputIndexes = {1}}};
 
+nn::Model createModelWithLargeOperandValues() {
+    constexpr uint32_t kNumElements = 32 * 1024;
+    const std::vector<float> values(kNumElements, 1.0f);
+    const int32_t activation = 0;
+
+    nn::Model model = {
+            .main = {.operands = {{.type = nn::OperandType::TENSOR_FLOAT32,
+                                   .dimensions = {kNumElements},
+                                   .lifetime = nn::Operand::LifeTime::SUBGRAPH_INPUT},
+                                  {.type = nn::OperandType::TENSOR_FLOAT32,
+                                   .dimensions = {kNumElements},
+                                   .lifetime = nn::Operand::LifeTime::CONSTANT_COPY},
+                                  {.type = nn::OperandType::INT32,
+                                   .lifetime = nn::Operand::LifeTime::CONSTANT_COPY},
+                                  {.type = nn::OperandType::TENSOR_FLOAT32,
+                                   .dimensions = {kNumElements},
+                                   .lifetime = nn::Operand::LifeTime::SUBGRAPH_OUTPUT}},
+                     .operations = {{.type = nn::OperationType::ADD,
+                                     .inputs = {0, 1, 2},
+                                     .outputs = {3}}},
+                     .inputIndexes = {0},
+                     .outputIndexes = {3}}};
+    model.main.operands[1].location =
+            model.operandValues.append(reinterpret_cast<const uint8_t*>(values.data()),
+                                       values.size() * sizeof(float));
+    model.main.operands[2].location = model.operandValues.append(
+            reinterpret_cast<const uint8_t*>(&activation), sizeof(activation));
+    return model;
+}
+
 const std::string kName = "Google-MockV1";
 const std::string kInvalidName = "";
 const std::shared_ptr<BnDevice> kInvalidDevice;
@@ -522,6 +552,30 @@ TEST_P(DeviceTest, getSupportedOperations) {
     EXPECT_THAT(supportedOperations, Each(testing::IsTrue()));
 }
 
+TEST_P(DeviceTest, getSupportedOperationsLargeOperandValuesInSharedMemory) {
+    // setup call
+    const auto mockDevice = createMockDevice();
+    const auto device = Device::create(kName, mockDevice, kVersion).value();
+    const auto model = createModelWithLargeOperandValues();
+    EXPECT_CALL(*mockDevice, getSupportedOperations(_, _))
+            .Times(1)
+            .WillOnce(Invoke([&model](const Model& aidlModel,
+                                      std::vector<bool>* supportedOperations) {
+                EXPECT_TRUE(aidlModel.operandValues.empty());
+                EXPECT_EQ(aidlModel.pools.size(), model.pools.size() + 1);
+                *supportedOperations = std::vector<bool>(aidlModel.main.operations.size(), true);
+                return ndk::ScopedAStatus::ok();
+            }));
+
+    // run test
+    const auto result = device->getSupportedOperations(model);
+
+    // verify result
+    ASSERT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    EXPECT_EQ(result.value().size(), model.main.operations.size());
+}
+
 TEST_P(DeviceTest, getSupportedOperationsError) {
     // setup call
     const auto mockDevice = createMockDevice();
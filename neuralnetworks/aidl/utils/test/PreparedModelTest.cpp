@@ -23,6 +23,7 @@
 #include <aidl/android/hardware/neuralnetworks/IFencedExecutionCallback.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <nnapi/IBurst.h>
 #include <nnapi/IExecution.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/TypeUtils.h>
@@ -31,6 +32,8 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace aidl::android::hardware::neuralnetworks::utils {
 namespace {
@@ -120,6 +123,41 @@ TEST_P(PreparedModelTest, executeSync) {
             << "Failed with " << result.error().code << ": " << result.error().message;
 }
 
+TEST_P(PreparedModelTest, executeSyncReusesConvertedRequest) {
+    if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) return;
+
+    // setup call
+    const auto mockPreparedModel = MockPreparedModel::create();
+    const auto preparedModel = PreparedModel::create(mockPreparedModel, kVersion).value();
+    const auto mockExecutionResult = ExecutionResult{
+            .outputSufficientSize = true,
+            .outputShapes = {},
+            .timing = kNoTiming,
+    };
+    std::vector<const Request*> requests;
+    const auto recordRequest = [&requests](const Request& request, bool /*measureTiming*/,
+                                           int64_t /*deadline*/, int64_t /*loopTimeoutDuration*/,
+                                           ExecutionResult* /*executionResult*/) {
+        requests.push_back(&request);
+        return ndk::ScopedAStatus::ok();
+    };
+    EXPECT_CALL(*mockPreparedModel, executeSynchronously(_, _, _, _, _))
+            .Times(2)
+            .WillRepeatedly(DoAll(SetArgPointee<4>(mockExecutionResult), Invoke(recordRequest)));
+
+    // run test
+    const auto result1 = preparedModel->execute({}, {}, {}, {}, {}, {});
+    const auto result2 = preparedModel->execute({}, {}, {}, {}, {}, {});
+
+    // verify result
+    EXPECT_TRUE(result1.has_value())
+            << "Failed with " << result1.error().code << ": " << result1.error().message;
+    EXPECT_TRUE(result2.has_value())
+            << "Failed with " << result2.error().code << ": " << result2.error().message;
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_EQ(requests[0], requests[1]);
+}
+
 TEST_P(PreparedModelTest, executeSyncError) {
     if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) return;
 
@@ -746,6 +784,53 @@ TEST_P(PreparedModelTest, configureExecutionBurst) {
     EXPECT_NE(result.value(), nullptr);
 }
 
+TEST_P(PreparedModelTest, configureExecutionBurstOverlappingExecutions) {
+    if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) return;
+
+    // setup test
+    const auto mockPreparedModel = MockPreparedModel::create();
+    const auto mockBurst = ndk::SharedRefBase::make<MockBurst>();
+    const auto mockOverlappingBurst = ndk::SharedRefBase::make<MockBurst>();
+    EXPECT_CALL(*mockPreparedModel, configureExecutionBurst(_))
+            .Times(2)
+            .WillOnce(DoAll(SetArgPointee<0>(mockBurst), Invoke(makeStatusOk)))
+            .WillOnce(DoAll(SetArgPointee<0>(mockOverlappingBurst), Invoke(makeStatusOk)));
+    const auto preparedModel = PreparedModel::create(mockPreparedModel, kVersion).value();
+    const auto burst = preparedModel->configureExecutionBurst().value();
+    const auto mockExecutionResult = ExecutionResult{
+            .outputSufficientSize = true,
+            .outputShapes = {},
+            .timing = kNoTiming,
+    };
+
+    // Start a second execution while the first one is in flight on the driver's burst.
+    std::optional<nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>>>
+            overlappingResult;
+    const auto executeOverlapping = [&burst, &overlappingResult] {
+        overlappingResult = burst->execute({}, {}, {}, {}, {}, {});
+    };
+    EXPECT_CALL(*mockBurst, executeSynchronously(_, _, _, _, _, _))
+            .Times(1)
+            .WillOnce(DoAll(InvokeWithoutArgs(executeOverlapping),
+                            SetArgPointee<5>(mockExecutionResult),
+                            InvokeWithoutArgs(makeStatusOk)));
+    EXPECT_CALL(*mockOverlappingBurst, executeSynchronously(_, _, _, _, _, _))
+            .Times(1)
+            .WillOnce(
+                    DoAll(SetArgPointee<5>(mockExecutionResult), InvokeWithoutArgs(makeStatusOk)));
+
+    // run test
+    const auto result = burst->execute({}, {}, {}, {}, {}, {});
+
+    // verify result
+    EXPECT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    ASSERT_TRUE(overlappingResult.has_value());
+    EXPECT_TRUE(overlappingResult->has_value())
+            << "Failed with " << overlappingResult->error().code << ": "
+            << overlappingResult->error().message;
+}
+
 TEST_P(PreparedModelTest, configureExecutionBurstError) {
     // setup test
     const auto mockPreparedModel = MockPreparedModel::create();
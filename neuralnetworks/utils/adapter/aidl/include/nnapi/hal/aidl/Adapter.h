@@ -52,6 +52,23 @@ using Executor = std::function<void(Task, ::android::nn::OptionalTimePoint)>;
  */
 std::shared_ptr<BnDevice> adapt(::android::nn::SharedDevice device, Executor executor);
 
+/**
+ * Adapt an NNAPI canonical interface object to a AIDL NN HAL interface object.
+ *
+ * Synchronous executions of all prepared models created from the returned device are run from a
+ * queue served by a pool of worker threads instead of on the binder thread that received them.
+ * Requests are converted on the binder thread while earlier executions are computing. When timing
+ * is measured, the time an execution waited in the queue is included in its time in driver.
+ *
+ * @param device NNAPI canonical IDevice interface object to be adapted.
+ * @param executor Type-erased executor to handle executing tasks asynchronously.
+ * @param numExecutionWorkers Number of worker threads serving the execution queue. Must be
+ *     greater than zero.
+ * @return AIDL NN HAL IDevice interface object.
+ */
+std::shared_ptr<BnDevice> adapt(::android::nn::SharedDevice device, Executor executor,
+                                size_t numExecutionWorkers);
+
 /**
  * Adapt an NNAPI canonical interface object to a AIDL NN HAL interface object.
  *
@@ -18,6 +18,7 @@
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_DEVICE_H
 
 #include "nnapi/hal/aidl/Adapter.h"
+#include "nnapi/hal/aidl/ExecutionQueue.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnDevice.h>
 #include <aidl/android/hardware/neuralnetworks/BufferDesc.h>
@@ -48,7 +49,9 @@ namespace aidl::android::hardware::neuralnetworks::adapter {
 // Class that adapts nn::IDevice to BnDevice.
 class Device : public BnDevice {
   public:
-    Device(::android::nn::SharedDevice device, Executor executor);
+    // Synchronous executions are run on `executionQueue` if it is not null.
+    Device(::android::nn::SharedDevice device, Executor executor,
+           std::shared_ptr<ExecutionQueue> executionQueue = nullptr);
 
     ndk::ScopedAStatus allocate(const BufferDesc& desc,
                                 const std::vector<IPreparedModelParcel>& preparedModels,
@@ -80,6 +83,7 @@ class Device : public BnDevice {
   protected:
     const ::android::nn::SharedDevice kDevice;
     const Executor kExecutor;
+    const std::shared_ptr<ExecutionQueue> kExecutionQueue;
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::adapter
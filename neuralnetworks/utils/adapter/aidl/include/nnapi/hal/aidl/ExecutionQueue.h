@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_QUEUE_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_QUEUE_H
+
+#include "nnapi/hal/aidl/Adapter.h"
+
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+
+// Submission queue that runs executions in FIFO order on a fixed pool of worker threads.
+//
+// The queue is shared by all prepared models of a Device, so that the number of concurrent
+// executions in the driver is bounded by the number of workers rather than by the number of
+// binder threads, and the conversion of a request on a binder thread overlaps the compute of the
+// requests ahead of it.
+class ExecutionQueue {
+  public:
+    explicit ExecutionQueue(size_t numWorkers);
+
+    // Runs all tasks still in the queue, then joins the workers.
+    ~ExecutionQueue();
+
+    void submit(Task task);
+
+  private:
+    void run();
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Task> mTasks GUARDED_BY(mMutex);
+    bool mStopping GUARDED_BY(mMutex) = false;
+    std::vector<std::thread> mWorkers;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_QUEUE_H
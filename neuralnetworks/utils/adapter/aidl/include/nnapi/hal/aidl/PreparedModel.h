@@ -18,6 +18,7 @@
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_PREPARED_MDOEL_H
 
 #include "nnapi/hal/aidl/Adapter.h"
+#include "nnapi/hal/aidl/ExecutionQueue.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnPreparedModel.h>
 #include <aidl/android/hardware/neuralnetworks/ExecutionResult.h>
@@ -40,7 +41,9 @@ namespace aidl::android::hardware::neuralnetworks::adapter {
 // Class that adapts nn::IPreparedModel to BnPreparedModel.
 class PreparedModel : public BnPreparedModel {
   public:
-    explicit PreparedModel(::android::nn::SharedPreparedModel preparedModel);
+    // Synchronous executions are run on `executionQueue` if it is not null.
+    explicit PreparedModel(::android::nn::SharedPreparedModel preparedModel,
+                           std::shared_ptr<ExecutionQueue> executionQueue = nullptr);
 
     ndk::ScopedAStatus executeSynchronously(const Request& request, bool measureTiming,
                                             int64_t deadlineNs, int64_t loopTimeoutDurationNs,
@@ -67,6 +70,7 @@ class PreparedModel : public BnPreparedModel {
 
   protected:
     const ::android::nn::SharedPreparedModel kPreparedModel;
+    const std::shared_ptr<ExecutionQueue> kExecutionQueue;
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::adapter
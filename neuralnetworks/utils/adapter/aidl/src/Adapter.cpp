@@ -17,6 +17,7 @@
 #include "Adapter.h"
 
 #include "Device.h"
+#include "ExecutionQueue.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnDevice.h>
 #include <android/binder_interface_utils.h>
@@ -36,6 +37,13 @@ std::shared_ptr<BnDevice> adapt(::android::nn::SharedDevice device, Executor exe
     return ndk::SharedRefBase::make<Device>(std::move(device), std::move(executor));
 }
 
+std::shared_ptr<BnDevice> adapt(::android::nn::SharedDevice device, Executor executor,
+                                size_t numExecutionWorkers) {
+    auto executionQueue = std::make_shared<ExecutionQueue>(numExecutionWorkers);
+    return ndk::SharedRefBase::make<Device>(std::move(device), std::move(executor),
+                                            std::move(executionQueue));
+}
+
 std::shared_ptr<BnDevice> adapt(::android::nn::SharedDevice device) {
     Executor defaultExecutor = [](Task task, ::android::nn::OptionalTimePoint /*deadline*/) {
         std::thread(std::move(task)).detach();
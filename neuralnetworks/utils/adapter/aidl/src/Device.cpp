@@ -128,11 +128,13 @@ nn::GeneralResult<std::vector<bool>> getSupportedOperations(const nn::IDevice& d
 
 using PrepareModelResult = nn::GeneralResult<nn::SharedPreparedModel>;
 
-std::shared_ptr<PreparedModel> adaptPreparedModel(nn::SharedPreparedModel preparedModel) {
+std::shared_ptr<PreparedModel> adaptPreparedModel(
+        nn::SharedPreparedModel preparedModel,
+        const std::shared_ptr<ExecutionQueue>& executionQueue) {
     if (preparedModel == nullptr) {
         return nullptr;
     }
-    return ndk::SharedRefBase::make<PreparedModel>(std::move(preparedModel));
+    return ndk::SharedRefBase::make<PreparedModel>(std::move(preparedModel), executionQueue);
 }
 
 void notify(IPreparedModelCallback* callback, ErrorStatus status,
@@ -145,7 +147,8 @@ void notify(IPreparedModelCallback* callback, ErrorStatus status,
     }
 }
 
-void notify(IPreparedModelCallback* callback, PrepareModelResult result) {
+void notify(IPreparedModelCallback* callback, PrepareModelResult result,
+            const std::shared_ptr<ExecutionQueue>& executionQueue) {
     if (!result.has_value()) {
         const auto& [message, status] = result.error();
         LOG(ERROR) << message;
@@ -153,13 +156,14 @@ void notify(IPreparedModelCallback* callback, PrepareModelResult result) {
         notify(callback, aidlCode, nullptr);
     } else {
         auto preparedModel = std::move(result).value();
-        auto aidlPreparedModel = adaptPreparedModel(std::move(preparedModel));
+        auto aidlPreparedModel = adaptPreparedModel(std::move(preparedModel), executionQueue);
         notify(callback, ErrorStatus::NONE, std::move(aidlPreparedModel));
     }
 }
 
 nn::GeneralResult<void> prepareModel(
-        const nn::SharedDevice& device, const Executor& executor, const Model& model,
+        const nn::SharedDevice& device, const Executor& executor,
+        const std::shared_ptr<ExecutionQueue>& executionQueue, const Model& model,
         ExecutionPreference preference, Priority priority, int64_t deadlineNs,
         const std::vector<ndk::ScopedFileDescriptor>& modelCache,
         const std::vector<ndk::ScopedFileDescriptor>& dataCache, const std::vector<uint8_t>& token,
@@ -183,11 +187,12 @@ nn::GeneralResult<void> prepareModel(
     Task task = [device, nnModel = std::move(nnModel), nnPreference, nnPriority, nnDeadline,
                  nnModelCache = std::move(nnModelCache), nnDataCache = std::move(nnDataCache),
                  nnToken, nnHints = std::move(nnHints),
-                 nnExtensionNameToPrefix = std::move(nnExtensionNameToPrefix), callback] {
+                 nnExtensionNameToPrefix = std::move(nnExtensionNameToPrefix), executionQueue,
+                 callback] {
         auto result =
                 device->prepareModel(nnModel, nnPreference, nnPriority, nnDeadline, nnModelCache,
                                      nnDataCache, nnToken, nnHints, nnExtensionNameToPrefix);
-        notify(callback.get(), std::move(result));
+        notify(callback.get(), std::move(result), executionQueue);
     };
     executor(std::move(task), nnDeadline);
 
@@ -195,7 +200,8 @@ nn::GeneralResult<void> prepareModel(
 }
 
 nn::GeneralResult<void> prepareModelFromCache(
-        const nn::SharedDevice& device, const Executor& executor, int64_t deadlineNs,
+        const nn::SharedDevice& device, const Executor& executor,
+        const std::shared_ptr<ExecutionQueue>& executionQueue, int64_t deadlineNs,
         const std::vector<ndk::ScopedFileDescriptor>& modelCache,
         const std::vector<ndk::ScopedFileDescriptor>& dataCache, const std::vector<uint8_t>& token,
         const std::shared_ptr<IPreparedModelCallback>& callback) {
@@ -209,9 +215,9 @@ nn::GeneralResult<void> prepareModelFromCache(
     const auto nnToken = NN_TRY(convertCacheToken(token));
 
     auto task = [device, nnDeadline, nnModelCache = std::move(nnModelCache),
-                 nnDataCache = std::move(nnDataCache), nnToken, callback] {
+                 nnDataCache = std::move(nnDataCache), nnToken, executionQueue, callback] {
         auto result = device->prepareModelFromCache(nnDeadline, nnModelCache, nnDataCache, nnToken);
-        notify(callback.get(), std::move(result));
+        notify(callback.get(), std::move(result), executionQueue);
     };
     executor(std::move(task), nnDeadline);
 
@@ -220,8 +226,11 @@ nn::GeneralResult<void> prepareModelFromCache(
 
 }  // namespace
 
-Device::Device(::android::nn::SharedDevice device, Executor executor)
-    : kDevice(std::move(device)), kExecutor(std::move(executor)) {
+Device::Device(::android::nn::SharedDevice device, Executor executor,
+               std::shared_ptr<ExecutionQueue> executionQueue)
+    : kDevice(std::move(device)),
+      kExecutor(std::move(executor)),
+      kExecutionQueue(std::move(executionQueue)) {
     CHECK(kDevice != nullptr);
     CHECK(kExecutor != nullptr);
 }
@@ -289,8 +298,8 @@ ndk::ScopedAStatus Device::prepareModel(const Model& model, ExecutionPreference
                                         const std::vector<uint8_t>& token,
                                         const std::shared_ptr<IPreparedModelCallback>& callback) {
     const auto result =
-            adapter::prepareModel(kDevice, kExecutor, model, preference, priority, deadlineNs,
-                                  modelCache, dataCache, token, {}, {}, callback);
+            adapter::prepareModel(kDevice, kExecutor, kExecutionQueue, model, preference, priority,
+                                  deadlineNs, modelCache, dataCache, token, {}, {}, callback);
     if (!result.has_value()) {
         const auto& [message, code] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -305,8 +314,9 @@ ndk::ScopedAStatus Device::prepareModelFromCache(
         int64_t deadlineNs, const std::vector<ndk::ScopedFileDescriptor>& modelCache,
         const std::vector<ndk::ScopedFileDescriptor>& dataCache, const std::vector<uint8_t>& token,
         const std::shared_ptr<IPreparedModelCallback>& callback) {
-    const auto result = adapter::prepareModelFromCache(kDevice, kExecutor, deadlineNs, modelCache,
-                                                       dataCache, token, callback);
+    const auto result = adapter::prepareModelFromCache(kDevice, kExecutor, kExecutionQueue,
+                                                       deadlineNs, modelCache, dataCache, token,
+                                                       callback);
     if (!result.has_value()) {
         const auto& [message, code] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -321,9 +331,10 @@ ndk::ScopedAStatus Device::prepareModelWithConfig(
         const Model& model, const PrepareModelConfig& config,
         const std::shared_ptr<IPreparedModelCallback>& callback) {
     const auto result = adapter::prepareModel(
-            kDevice, kExecutor, model, config.preference, config.priority, config.deadlineNs,
-            config.modelCache, config.dataCache, utils::toVec(config.cacheToken),
-            config.compilationHints, config.extensionNameToPrefix, callback);
+            kDevice, kExecutor, kExecutionQueue, model, config.preference, config.priority,
+            config.deadlineNs, config.modelCache, config.dataCache,
+            utils::toVec(config.cacheToken), config.compilationHints,
+            config.extensionNameToPrefix, callback);
     if (!result.has_value()) {
         const auto& [message, code] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
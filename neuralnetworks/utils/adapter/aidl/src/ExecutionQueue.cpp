@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ExecutionQueue.h"
+
+#include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
+
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+
+ExecutionQueue::ExecutionQueue(size_t numWorkers) {
+    CHECK_GT(numWorkers, 0u);
+    mWorkers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        mWorkers.emplace_back([this] { run(); });
+    }
+}
+
+ExecutionQueue::~ExecutionQueue() {
+    {
+        std::lock_guard guard(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void ExecutionQueue::submit(Task task) {
+    {
+        std::lock_guard guard(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void ExecutionQueue::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(mMutex);
+            ::android::base::ScopedLockAssertion lockAssertion(mMutex);
+            while (!mStopping && mTasks.empty()) {
+                mCondition.wait(lock);
+            }
+            // Tasks still queued when stopping are run before the worker exits.
+            if (mTasks.empty()) {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
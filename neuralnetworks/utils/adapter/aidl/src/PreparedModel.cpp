@@ -18,6 +18,7 @@
 
 #include "Burst.h"
 #include "Execution.h"
+#include "ExecutionQueue.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnFencedExecutionCallback.h>
 #include <aidl/android/hardware/neuralnetworks/BnPreparedModel.h>
@@ -36,6 +37,8 @@
 #include <nnapi/hal/aidl/Conversions.h>
 #include <nnapi/hal/aidl/Utils.h>
 
+#include <chrono>
+#include <future>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -118,8 +121,33 @@ nn::GeneralResult<nn::OptionalTimePoint> makeOptionalTimePoint(int64_t durationN
     return durationNs < 0 ? nn::OptionalTimePoint{} : nn::TimePoint(makeDuration(durationNs));
 }
 
+// Runs `execute` on `executionQueue` and waits for its result. When timing is measured, the time
+// the execution waited in the queue is added to its time in driver.
+template <typename Execute>
+auto executeOnQueue(ExecutionQueue* executionQueue, const Execute& execute,
+                    nn::MeasureTiming measure) -> decltype(execute()) {
+    std::promise<decltype(execute())> promise;
+    auto future = promise.get_future();
+    const auto submitted = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration queueingDelay{};
+    executionQueue->submit([&execute, &promise, &queueingDelay, submitted] {
+        queueingDelay = std::chrono::steady_clock::now() - submitted;
+        promise.set_value(execute());
+    });
+
+    auto result = future.get();
+    if (measure == nn::MeasureTiming::YES && result.has_value()) {
+        auto& timeInDriver = result.value().second.timeInDriver;
+        if (timeInDriver.has_value()) {
+            *timeInDriver += std::chrono::duration_cast<nn::Duration>(queueingDelay);
+        }
+    }
+    return result;
+}
+
 nn::ExecutionResult<ExecutionResult> executeSynchronously(
-        const nn::IPreparedModel& preparedModel, const Request& request, bool measureTiming,
+        const nn::IPreparedModel& preparedModel, ExecutionQueue* executionQueue,
+        const Request& request, bool measureTiming,
         int64_t deadlineNs, int64_t loopTimeoutDurationNs, const std::vector<TokenValuePair>& hints,
         const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix) {
     const auto nnRequest = NN_TRY(convertInput(request));
@@ -129,9 +157,15 @@ nn::ExecutionResult<ExecutionResult> executeSynchronously(
     auto nnHints = NN_TRY(convertInput(hints));
     auto nnExtensionNameToPrefix = NN_TRY(convertInput(extensionNameToPrefix));
 
-    const auto result =
-            preparedModel.execute(nnRequest, nnMeasureTiming, nnDeadline, nnLoopTimeoutDuration,
-                                  nnHints, nnExtensionNameToPrefix);
+    // The request is converted on the calling binder thread, so that its conversion overlaps the
+    // compute of executions already in the queue.
+    const auto execute = [&] {
+        return preparedModel.execute(nnRequest, nnMeasureTiming, nnDeadline,
+                                     nnLoopTimeoutDuration, nnHints, nnExtensionNameToPrefix);
+    };
+    const auto result = executionQueue != nullptr
+                                ? executeOnQueue(executionQueue, execute, nnMeasureTiming)
+                                : execute();
 
     if (!result.ok() && result.error().code == nn::ErrorStatus::OUTPUT_INSUFFICIENT_SIZE) {
         const auto& [message, code, outputShapes] = result.error();
@@ -234,8 +268,9 @@ nn::GeneralResult<FencedExecutionResult> executeFenced(
 
 }  // namespace
 
-PreparedModel::PreparedModel(nn::SharedPreparedModel preparedModel)
-    : kPreparedModel(std::move(preparedModel)) {
+PreparedModel::PreparedModel(nn::SharedPreparedModel preparedModel,
+                             std::shared_ptr<ExecutionQueue> executionQueue)
+    : kPreparedModel(std::move(preparedModel)), kExecutionQueue(std::move(executionQueue)) {
     CHECK(kPreparedModel != nullptr);
 }
 
@@ -243,8 +278,9 @@ ndk::ScopedAStatus PreparedModel::executeSynchronously(const Request& request, b
                                                        int64_t deadlineNs,
                                                        int64_t loopTimeoutDurationNs,
                                                        ExecutionResult* executionResult) {
-    auto result = adapter::executeSynchronously(*kPreparedModel, request, measureTiming, deadlineNs,
-                                                loopTimeoutDurationNs, {}, {});
+    auto result = adapter::executeSynchronously(*kPreparedModel, kExecutionQueue.get(), request,
+                                                measureTiming, deadlineNs, loopTimeoutDurationNs,
+                                                {}, {});
     if (!result.has_value()) {
         const auto& [message, code, _] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -276,7 +312,7 @@ ndk::ScopedAStatus PreparedModel::executeSynchronouslyWithConfig(const Request&
                                                                  int64_t deadlineNs,
                                                                  ExecutionResult* executionResult) {
     auto result = adapter::executeSynchronously(
-            *kPreparedModel, request, config.measureTiming, deadlineNs,
+            *kPreparedModel, kExecutionQueue.get(), request, config.measureTiming, deadlineNs,
             config.loopTimeoutDurationNs, config.executionHints, config.extensionNameToPrefix);
     if (!result.has_value()) {
         const auto& [message, code, _] = result.error();
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the per-call cost that the Resilient* wrappers add on top of the object they wrap. The
+// wrapped objects do no work, so each benchmark reports the cost of the call path alone. Run each
+// benchmark with "/direct" and "/resilient" to compare the two.
+
+#include <benchmark/benchmark.h>
+#include <nnapi/IBurst.h>
+#include <nnapi/IExecution.h>
+#include <nnapi/IPreparedModel.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/ResilientPreparedModel.h>
+
+#include <any>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+using ExecutionResult = nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>>;
+using FencedExecutionResult =
+        nn::GeneralResult<std::pair<nn::SyncFence, nn::ExecuteFencedInfoCallback>>;
+
+FencedExecutionResult makeFencedExecutionResult() {
+    auto syncFence = nn::SyncFence::createAsSignaled();
+    nn::ExecuteFencedInfoCallback callback = [] {
+        return nn::GeneralResult<std::pair<nn::Timing, nn::Timing>>{};
+    };
+    return std::make_pair(std::move(syncFence), std::move(callback));
+}
+
+class NullExecution final : public nn::IExecution {
+  public:
+    ExecutionResult compute(const nn::OptionalTimePoint& /*deadline*/) const override {
+        return {};
+    }
+    FencedExecutionResult computeFenced(
+            const std::vector<nn::SyncFence>& /*waitFor*/,
+            const nn::OptionalTimePoint& /*deadline*/,
+            const nn::OptionalDuration& /*timeoutDurationAfterFence*/) const override {
+        return makeFencedExecutionResult();
+    }
+};
+
+class NullBurst final : public nn::IBurst {
+  public:
+    OptionalCacheHold cacheMemory(const nn::SharedMemory& /*memory*/) const override {
+        return nullptr;
+    }
+    ExecutionResult execute(
+            const nn::Request& /*request*/, nn::MeasureTiming /*measure*/,
+            const nn::OptionalTimePoint& /*deadline*/,
+            const nn::OptionalDuration& /*loopTimeoutDuration*/,
+            const std::vector<nn::TokenValuePair>& /*hints*/,
+            const std::vector<nn::ExtensionNameAndPrefix>& /*extensionNameToPrefix*/)
+            const override {
+        return {};
+    }
+    nn::GeneralResult<nn::SharedExecution> createReusableExecution(
+            const nn::Request& /*request*/, nn::MeasureTiming /*measure*/,
+            const nn::OptionalDuration& /*loopTimeoutDuration*/,
+            const std::vector<nn::TokenValuePair>& /*hints*/,
+            const std::vector<nn::ExtensionNameAndPrefix>& /*extensionNameToPrefix*/)
+            const override {
+        return std::make_shared<const NullExecution>();
+    }
+};
+
+class NullPreparedModel final : public nn::IPreparedModel {
+  public:
+    ExecutionResult execute(
+            const nn::Request& /*request*/, nn::MeasureTiming /*measure*/,
+            const nn::OptionalTimePoint& /*deadline*/,
+            const nn::OptionalDuration& /*loopTimeoutDuration*/,
+            const std::vector<nn::TokenValuePair>& /*hints*/,
+            const std::vector<nn::ExtensionNameAndPrefix>& /*extensionNameToPrefix*/)
+            const override {
+        return {};
+    }
+    FencedExecutionResult executeFenced(
+            const nn::Request& /*request*/, const std::vector<nn::SyncFence>& /*waitFor*/,
+            nn::MeasureTiming /*measure*/, const nn::OptionalTimePoint& /*deadline*/,
+            const nn::OptionalDuration& /*loopTimeoutDuration*/,
+            const nn::OptionalDuration& /*timeoutDurationAfterFence*/,
+            const std::vector<nn::TokenValuePair>& /*hints*/,
+            const std::vector<nn::ExtensionNameAndPrefix>& /*extensionNameToPrefix*/)
+            const override {
+        return makeFencedExecutionResult();
+    }
+    nn::GeneralResult<nn::SharedExecution> createReusableExecution(
+            const nn::Request& /*request*/, nn::MeasureTiming /*measure*/,
+            const nn::OptionalDuration& /*loopTimeoutDuration*/,
+            const std::vector<nn::TokenValuePair>& /*hints*/,
+            const std::vector<nn::ExtensionNameAndPrefix>& /*extensionNameToPrefix*/)
+            const override {
+        return std::make_shared<const NullExecution>();
+    }
+    nn::GeneralResult<nn::SharedBurst> configureExecutionBurst() const override {
+        return std::make_shared<const NullBurst>();
+    }
+    std::any getUnderlyingResource() const override { return {}; }
+};
+
+nn::SharedPreparedModel createPreparedModel(bool resilient) {
+    if (!resilient) {
+        return std::make_shared<const NullPreparedModel>();
+    }
+    auto makePreparedModel = []() -> nn::GeneralResult<nn::SharedPreparedModel> {
+        return std::make_shared<const NullPreparedModel>();
+    };
+    return ResilientPreparedModel::create(std::move(makePreparedModel)).value();
+}
+
+void BM_execute(benchmark::State& state, bool resilient) {
+    const auto preparedModel = createPreparedModel(resilient);
+    const nn::Request request;
+    for (auto _ : state) {
+        auto result = preparedModel->execute(request, nn::MeasureTiming::NO, {}, {}, {}, {});
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK_CAPTURE(BM_execute, direct, false);
+BENCHMARK_CAPTURE(BM_execute, resilient, true);
+
+void BM_executeFenced(benchmark::State& state, bool resilient) {
+    const auto preparedModel = createPreparedModel(resilient);
+    const nn::Request request;
+    for (auto _ : state) {
+        auto result = preparedModel->executeFenced(request, {}, nn::MeasureTiming::NO, {}, {}, {},
+                                                   {}, {});
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK_CAPTURE(BM_executeFenced, direct, false);
+BENCHMARK_CAPTURE(BM_executeFenced, resilient, true);
+
+void BM_burstExecute(benchmark::State& state, bool resilient) {
+    const auto preparedModel = createPreparedModel(resilient);
+    const auto burst = preparedModel->configureExecutionBurst().value();
+    const nn::Request request;
+    for (auto _ : state) {
+        auto result = burst->execute(request, nn::MeasureTiming::NO, {}, {}, {}, {});
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK_CAPTURE(BM_burstExecute, direct, false);
+BENCHMARK_CAPTURE(BM_burstExecute, resilient, true);
+
+void BM_reusableExecutionCompute(benchmark::State& state, bool resilient) {
+    const auto preparedModel = createPreparedModel(resilient);
+    const nn::Request request;
+    const auto execution =
+            preparedModel->createReusableExecution(request, nn::MeasureTiming::NO, {}, {}, {})
+                    .value();
+    for (auto _ : state) {
+        auto result = execution->compute({});
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK_CAPTURE(BM_reusableExecutionCompute, direct, false);
+BENCHMARK_CAPTURE(BM_reusableExecutionCompute, resilient, true);
+
+}  // namespace
+}  // namespace android::hardware::neuralnetworks::utils
+
+BENCHMARK_MAIN();
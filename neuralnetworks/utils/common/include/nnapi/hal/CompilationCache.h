@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_COMPILATION_CACHE_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_COMPILATION_CACHE_H
+
+#include <android-base/mapped_file.h>
+#include <android-base/thread_annotations.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+
+/**
+ * On-disk store of compiled models, indexed by the cache token of the model.
+ *
+ * The cache token is a hash of the model and its compilation settings, so each blob is stored at
+ * a content-addressed path derived from it: "<directory>/<2 hex digits>/<62 hex digits>". Blobs
+ * are loaded through read-only file mappings. Stores are written back asynchronously on a worker
+ * thread, through a temporary file that is renamed into place, so that a blob is either complete
+ * or absent. When the total size of the blobs exceeds the size cap, the least recently used blobs
+ * are evicted.
+ *
+ * This class is intended for drivers that keep their own compilation cache instead of, or in
+ * addition to, the cache files passed to IDevice::prepareModel.
+ */
+class CompilationCache final {
+    struct PrivateConstructorTag {};
+
+  public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t writes = 0;
+        uint64_t evictions = 0;
+        size_t sizeBytes = 0;
+    };
+
+    /**
+     * Opens the cache in `directory`, creating the directory if needed. Blobs left by a previous
+     * instance are indexed, and the oldest are evicted if they exceed `maxSizeBytes`.
+     */
+    static nn::GeneralResult<std::unique_ptr<CompilationCache>> create(std::string directory,
+                                                                      size_t maxSizeBytes);
+
+    CompilationCache(PrivateConstructorTag tag, std::string directory, size_t maxSizeBytes);
+
+    // Finishes all pending stores before returning.
+    ~CompilationCache();
+
+    /**
+     * Returns a read-only mapping of the blob stored for `token`, or nullptr on a miss. The
+     * mapping stays valid even if the blob is later evicted or replaced.
+     */
+    std::unique_ptr<base::MappedFile> load(const nn::CacheToken& token) EXCLUDES(mMutex);
+
+    /**
+     * Queues `blob` to be written for `token`, replacing any blob already stored for it. Empty
+     * blobs and blobs larger than the size cap are ignored.
+     */
+    void store(const nn::CacheToken& token, std::vector<uint8_t> blob) EXCLUDES(mMutex);
+
+    // Blocks until all stores queued before the call have been written.
+    void flush() EXCLUDES(mMutex);
+
+    Stats getStats() const EXCLUDES(mMutex);
+
+  private:
+    struct Entry {
+        size_t size;
+        uint64_t lastUse;
+    };
+
+    nn::GeneralResult<void> loadIndex() EXCLUDES(mMutex);
+    void writeBack();
+    void writeBlob(const std::string& key, const std::vector<uint8_t>& blob) EXCLUDES(mMutex);
+    std::vector<std::string> evictLocked(const std::string& keep) REQUIRES(mMutex);
+    std::string getPath(const std::string& key) const;
+
+    const std::string kDirectory;
+    const size_t kMaxSizeBytes;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::unordered_map<std::string, Entry> mEntries GUARDED_BY(mMutex);
+    uint64_t mUseCounter GUARDED_BY(mMutex) = 0;
+    Stats mStats GUARDED_BY(mMutex);
+    std::deque<std::pair<std::string, std::vector<uint8_t>>> mPendingStores GUARDED_BY(mMutex);
+    bool mWriting GUARDED_BY(mMutex) = false;
+    bool mStopping GUARDED_BY(mMutex) = false;
+    std::thread mWriter;
+};
+
+}  // namespace android::hardware::neuralnetworks::utils
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_COMPILATION_CACHE_H
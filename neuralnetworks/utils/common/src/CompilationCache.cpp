@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompilationCache.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/mapped_file.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+constexpr size_t kFanOutDigits = 2;
+constexpr const char kTemporarySuffix[] = ".tmp";
+
+std::string toKey(const nn::CacheToken& token) {
+    constexpr char kHexDigits[] = "0123456789abcdef";
+    std::string key;
+    key.reserve(token.size() * 2);
+    for (const uint8_t byte : token) {
+        key.push_back(kHexDigits[byte >> 4]);
+        key.push_back(kHexDigits[byte & 0xf]);
+    }
+    return key;
+}
+
+bool isKey(const std::string& key) {
+    return key.size() == std::tuple_size_v<nn::CacheToken> * 2 &&
+           std::all_of(key.begin(), key.end(),
+                       [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
+}  // namespace
+
+nn::GeneralResult<std::unique_ptr<CompilationCache>> CompilationCache::create(
+        std::string directory, size_t maxSizeBytes) {
+    if (directory.empty()) {
+        return NN_ERROR(nn::ErrorStatus::INVALID_ARGUMENT)
+               << "utils::CompilationCache::create must have a non-empty directory";
+    }
+    if (maxSizeBytes == 0) {
+        return NN_ERROR(nn::ErrorStatus::INVALID_ARGUMENT)
+               << "utils::CompilationCache::create must have a non-zero size cap";
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return NN_ERROR() << "Failed to create compilation cache directory " << directory << ": "
+                          << error.message();
+    }
+
+    auto cache = std::make_unique<CompilationCache>(PrivateConstructorTag{}, std::move(directory),
+                                                    maxSizeBytes);
+    NN_TRY(cache->loadIndex());
+    return cache;
+}
+
+CompilationCache::CompilationCache(PrivateConstructorTag /*tag*/, std::string directory,
+                                   size_t maxSizeBytes)
+    : kDirectory(std::move(directory)),
+      kMaxSizeBytes(maxSizeBytes),
+      mWriter([this] { writeBack(); }) {}
+
+CompilationCache::~CompilationCache() {
+    {
+        std::lock_guard guard(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    mWriter.join();
+}
+
+nn::GeneralResult<void> CompilationCache::loadIndex() {
+    struct Blob {
+        std::string key;
+        size_t size;
+        std::filesystem::file_time_type writeTime;
+    };
+    std::vector<Blob> blobs;
+
+    std::error_code error;
+    for (const auto& fanOut : std::filesystem::directory_iterator(kDirectory, error)) {
+        if (!fanOut.is_directory(error)) {
+            continue;
+        }
+        const std::string prefix = fanOut.path().filename();
+        for (const auto& file : std::filesystem::directory_iterator(fanOut.path(), error)) {
+            const std::string name = file.path().filename();
+            std::string key = prefix + name;
+            if (!file.is_regular_file(error) || !isKey(key)) {
+                // Remove temporary files of stores that were interrupted.
+                if (name.size() > sizeof(kTemporarySuffix) - 1 &&
+                    name.compare(name.size() - (sizeof(kTemporarySuffix) - 1),
+                                 std::string::npos, kTemporarySuffix) == 0) {
+                    std::filesystem::remove(file.path(), error);
+                }
+                continue;
+            }
+            const auto size = file.file_size(error);
+            const auto writeTime = file.last_write_time(error);
+            if (error) {
+                continue;
+            }
+            blobs.push_back({.key = std::move(key), .size = size, .writeTime = writeTime});
+        }
+    }
+    if (error) {
+        return NN_ERROR() << "Failed to index compilation cache directory " << kDirectory << ": "
+                          << error.message();
+    }
+
+    // Blobs written by earlier instances are ordered by their last write.
+    std::sort(blobs.begin(), blobs.end(),
+              [](const Blob& a, const Blob& b) { return a.writeTime < b.writeTime; });
+
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard guard(mMutex);
+        for (auto& blob : blobs) {
+            mStats.sizeBytes += blob.size;
+            mEntries.emplace(std::move(blob.key),
+                             Entry{.size = blob.size, .lastUse = ++mUseCounter});
+        }
+        evicted = evictLocked({});
+    }
+    for (const auto& key : evicted) {
+        std::filesystem::remove(getPath(key), error);
+    }
+    return {};
+}
+
+std::unique_ptr<base::MappedFile> CompilationCache::load(const nn::CacheToken& token) {
+    const auto key = toKey(token);
+    size_t size;
+    {
+        std::lock_guard guard(mMutex);
+        const auto iter = mEntries.find(key);
+        if (iter == mEntries.end()) {
+            ++mStats.misses;
+            return nullptr;
+        }
+        iter->second.lastUse = ++mUseCounter;
+        size = iter->second.size;
+    }
+
+    // The blob may have been evicted or replaced since the index was consulted. A mapping of the
+    // file opened here stays valid either way.
+    auto mapping = [this, &key, size]() -> std::unique_ptr<base::MappedFile> {
+        const base::unique_fd fd(
+                TEMP_FAILURE_RETRY(open(getPath(key).c_str(), O_RDONLY | O_CLOEXEC)));
+        if (fd.get() < 0) {
+            return nullptr;
+        }
+        return base::MappedFile::FromFd(fd, 0, size, PROT_READ);
+    }();
+
+    std::lock_guard guard(mMutex);
+    if (mapping == nullptr) {
+        ++mStats.misses;
+        return nullptr;
+    }
+    ++mStats.hits;
+    return mapping;
+}
+
+void CompilationCache::store(const nn::CacheToken& token, std::vector<uint8_t> blob) {
+    if (blob.empty() || blob.size() > kMaxSizeBytes) {
+        return;
+    }
+    {
+        std::lock_guard guard(mMutex);
+        mPendingStores.emplace_back(toKey(token), std::move(blob));
+    }
+    mCondition.notify_all();
+}
+
+void CompilationCache::flush() {
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion lockAssertion(mMutex);
+    while (!mPendingStores.empty() || mWriting) {
+        mCondition.wait(lock);
+    }
+}
+
+CompilationCache::Stats CompilationCache::getStats() const {
+    std::lock_guard guard(mMutex);
+    return mStats;
+}
+
+void CompilationCache::writeBack() {
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion lockAssertion(mMutex);
+    while (true) {
+        while (!mStopping && mPendingStores.empty()) {
+            mCondition.wait(lock);
+        }
+        // Pending stores are written before the writer exits.
+        if (mPendingStores.empty()) {
+            return;
+        }
+        auto [key, blob] = std::move(mPendingStores.front());
+        mPendingStores.pop_front();
+        mWriting = true;
+
+        lock.unlock();
+        writeBlob(key, blob);
+        lock.lock();
+
+        mWriting = false;
+        mCondition.notify_all();
+    }
+}
+
+void CompilationCache::writeBlob(const std::string& key, const std::vector<uint8_t>& blob) {
+    const std::string path = getPath(key);
+    const std::string temporaryPath = path + kTemporarySuffix;
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    {
+        const base::unique_fd fd(TEMP_FAILURE_RETRY(
+                open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)));
+        if (fd.get() < 0 || !base::WriteFully(fd, blob.data(), blob.size()) ||
+            fdatasync(fd.get()) != 0) {
+            PLOG(ERROR) << "Failed to write compilation cache blob " << temporaryPath;
+            unlink(temporaryPath.c_str());
+            return;
+        }
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to rename compilation cache blob to " << path;
+        unlink(temporaryPath.c_str());
+        return;
+    }
+
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard guard(mMutex);
+        auto& entry = mEntries[key];
+        mStats.sizeBytes = mStats.sizeBytes - entry.size + blob.size();
+        entry.size = blob.size();
+        entry.lastUse = ++mUseCounter;
+        ++mStats.writes;
+        evicted = evictLocked(key);
+    }
+    for (const auto& evictedKey : evicted) {
+        unlink(getPath(evictedKey).c_str());
+    }
+}
+
+std::vector<std::string> CompilationCache::evictLocked(const std::string& keep) {
+    std::vector<std::string> evicted;
+    while (mStats.sizeBytes > kMaxSizeBytes) {
+        auto victim = mEntries.end();
+        for (auto iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+            if (iter->first == keep) {
+                continue;
+            }
+            if (victim == mEntries.end() || iter->second.lastUse < victim->second.lastUse) {
+                victim = iter;
+            }
+        }
+        if (victim == mEntries.end()) {
+            break;
+        }
+        mStats.sizeBytes -= victim->second.size;
+        ++mStats.evictions;
+        evicted.push_back(victim->first);
+        mEntries.erase(victim);
+    }
+    return evicted;
+}
+
+std::string CompilationCache::getPath(const std::string& key) const {
+    return kDirectory + "/" + key.substr(0, kFanOutDigits) + "/" + key.substr(kFanOutDigits);
+}
+
+}  // namespace android::hardware::neuralnetworks::utils
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gmock/gmock.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/CompilationCache.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+nn::CacheToken makeToken(uint8_t value) {
+    nn::CacheToken token;
+    token.fill(value);
+    return token;
+}
+
+std::unique_ptr<CompilationCache> createCache(const TemporaryDir& dir, size_t maxSizeBytes) {
+    auto result = CompilationCache::create(dir.path, maxSizeBytes);
+    EXPECT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    return std::move(result).value();
+}
+
+bool contains(const base::MappedFile& mapping, const std::vector<uint8_t>& blob) {
+    return mapping.size() == blob.size() &&
+           std::memcmp(mapping.data(), blob.data(), blob.size()) == 0;
+}
+
+}  // namespace
+
+TEST(CompilationCacheTest, invalidSizeCap) {
+    // run test
+    const TemporaryDir dir;
+    const auto result = CompilationCache::create(dir.path, 0);
+
+    // verify result
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, nn::ErrorStatus::INVALID_ARGUMENT);
+}
+
+TEST(CompilationCacheTest, loadMiss) {
+    // setup test
+    const TemporaryDir dir;
+    const auto cache = createCache(dir, 1024);
+
+    // run test
+    const auto mapping = cache->load(makeToken(1));
+
+    // verify result
+    EXPECT_EQ(mapping, nullptr);
+    EXPECT_EQ(cache->getStats().misses, 1u);
+}
+
+TEST(CompilationCacheTest, storeAndLoad) {
+    // setup test
+    const TemporaryDir dir;
+    const auto cache = createCache(dir, 1024);
+    const std::vector<uint8_t> blob(100, 7);
+
+    // run test
+    cache->store(makeToken(1), blob);
+    cache->flush();
+    const auto mapping = cache->load(makeToken(1));
+
+    // verify result
+    ASSERT_NE(mapping, nullptr);
+    EXPECT_TRUE(contains(*mapping, blob));
+    const auto stats = cache->getStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.writes, 1u);
+    EXPECT_EQ(stats.sizeBytes, blob.size());
+}
+
+TEST(CompilationCacheTest, loadAfterReopen) {
+    // setup test
+    const TemporaryDir dir;
+    const std::vector<uint8_t> blob(100, 7);
+    {
+        const auto cache = createCache(dir, 1024);
+        cache->store(makeToken(1), blob);
+    }
+
+    // run test
+    const auto cache = createCache(dir, 1024);
+    const auto mapping = cache->load(makeToken(1));
+
+    // verify result
+    ASSERT_NE(mapping, nullptr);
+    EXPECT_TRUE(contains(*mapping, blob));
+}
+
+TEST(CompilationCacheTest, evictLeastRecentlyUsed) {
+    // setup test
+    const TemporaryDir dir;
+    const auto cache = createCache(dir, 250);
+    const std::vector<uint8_t> blob(100, 7);
+    cache->store(makeToken(1), blob);
+    cache->store(makeToken(2), blob);
+    cache->flush();
+    EXPECT_NE(cache->load(makeToken(1)), nullptr);
+
+    // run test
+    cache->store(makeToken(3), blob);
+    cache->flush();
+
+    // verify result
+    EXPECT_NE(cache->load(makeToken(1)), nullptr);
+    EXPECT_EQ(cache->load(makeToken(2)), nullptr);
+    EXPECT_NE(cache->load(makeToken(3)), nullptr);
+    const auto stats = cache->getStats();
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.sizeBytes, 2 * blob.size());
+}
+
+}  // namespace android::hardware::neuralnetworks::utils
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AdpfTunables.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+#include <functional>
+#include <map>
+
+namespace aidl::android::hardware::power::impl::example {
+
+using ::android::base::ParseDouble;
+using ::android::base::ParseInt;
+using ::android::base::ParseUint;
+using ::android::base::ReadFileToString;
+using ::android::base::Split;
+using ::android::base::Trim;
+
+namespace {
+
+using Setter = std::function<bool(AdpfTunables&, const std::string&)>;
+
+Setter doubleValue(double AdpfTunables::*field) {
+    return [field](AdpfTunables& t, const std::string& value) {
+        return ParseDouble(value, &(t.*field));
+    };
+}
+
+Setter uclampValue(int32_t AdpfTunables::*field) {
+    return [field](AdpfTunables& t, const std::string& value) {
+        return ParseInt(value, &(t.*field), 0, 1024);
+    };
+}
+
+Setter sizeValue(size_t AdpfTunables::*field) {
+    return [field](AdpfTunables& t, const std::string& value) {
+        return ParseUint(value, &(t.*field)) && t.*field > 0;
+    };
+}
+
+template <typename Duration>
+Setter durationValue(Duration AdpfTunables::*field) {
+    return [field](AdpfTunables& t, const std::string& value) {
+        typename Duration::rep count;
+        if (!ParseInt(value, &count, typename Duration::rep(1))) return false;
+        t.*field = Duration(count);
+        return true;
+    };
+}
+
+const std::map<std::string, Setter>& setters() {
+    static const std::map<std::string, Setter> kSetters = {
+            {"pid_p_over", doubleValue(&AdpfTunables::pOver)},
+            {"pid_p_under", doubleValue(&AdpfTunables::pUnder)},
+            {"pid_i", doubleValue(&AdpfTunables::i)},
+            {"pid_i_min", doubleValue(&AdpfTunables::iMin)},
+            {"pid_i_max", doubleValue(&AdpfTunables::iMax)},
+            {"pid_d_over", doubleValue(&AdpfTunables::dOver)},
+            {"pid_d_under", doubleValue(&AdpfTunables::dUnder)},
+            {"uclamp_min_init", uclampValue(&AdpfTunables::uclampMinInit)},
+            {"uclamp_min_low", uclampValue(&AdpfTunables::uclampMinLow)},
+            {"uclamp_min_high", uclampValue(&AdpfTunables::uclampMinHigh)},
+            {"uclamp_min_power_efficient", uclampValue(&AdpfTunables::uclampMinPowerEfficient)},
+            {"uclamp_min_load_up", uclampValue(&AdpfTunables::uclampMinLoadUp)},
+            {"samples_window", sizeValue(&AdpfTunables::samplesWindow)},
+            {"stale_timeout_ms", durationValue(&AdpfTunables::staleTimeout)},
+            {"reporting_rate_ns", durationValue(&AdpfTunables::reportingRate)},
+            {"channel_depth", sizeValue(&AdpfTunables::channelDepth)},
+    };
+    return kSetters;
+}
+
+}  // namespace
+
+AdpfTunables AdpfTunables::load(const std::string& path) {
+    AdpfTunables tunables;
+    std::string content;
+    if (!ReadFileToString(path, &content)) {
+        PLOG(INFO) << "No ADPF tunables at " << path << ", using the defaults";
+        return tunables;
+    }
+
+    int lineNo = 0;
+    for (const auto& rawLine : Split(content, "\n")) {
+        lineNo++;
+        const auto line = Trim(rawLine.substr(0, rawLine.find('#')));
+        if (line.empty()) continue;
+
+        const auto separator = line.find('=');
+        if (separator == std::string::npos) {
+            LOG(WARNING) << path << ":" << lineNo << ": expected \"name = value\"";
+            continue;
+        }
+        const auto name = Trim(line.substr(0, separator));
+        const auto value = Trim(line.substr(separator + 1));
+        const auto it = setters().find(name);
+        if (it == setters().end()) {
+            LOG(WARNING) << path << ":" << lineNo << ": unknown tunable " << name;
+        } else if (!it->second(tunables, value)) {
+            LOG(WARNING) << path << ":" << lineNo << ": invalid value for " << name << ": "
+                         << value;
+        }
+    }
+
+    if (tunables.uclampMinLow > tunables.uclampMinHigh) {
+        LOG(WARNING) << "uclamp_min_low is above uclamp_min_high, ignoring it";
+        tunables.uclampMinLow = 0;
+    }
+    if (tunables.iMin > tunables.iMax) {
+        LOG(WARNING) << "pid_i_min is above pid_i_max, ignoring the integral bounds";
+        tunables.iMin = AdpfTunables{}.iMin;
+        tunables.iMax = AdpfTunables{}.iMax;
+    }
+    return tunables;
+}
+
+}  // namespace aidl::android::hardware::power::impl::example
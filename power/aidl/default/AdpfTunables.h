@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace aidl::android::hardware::power::impl::example {
+
+/**
+ * Tunables of the hint session controller.
+ *
+ * The defaults are usable as is; a device may override any of them in the tunables file, which
+ * holds one "name = value" pair per line.
+ */
+struct AdpfTunables {
+    static constexpr const char* kDefaultPath = "/vendor/etc/power-adpf-tunables.txt";
+
+    // PID gains, applied to the error relative to the target duration and producing a change of
+    // uclamp.min. Overruns and underruns use separate P and D gains, so that the controller can
+    // react to missed deadlines faster than it gives the boost back.
+    double pOver = 500.0;
+    double pUnder = 100.0;
+    double i = 20.0;
+    double dOver = 100.0;
+    double dUnder = 0.0;
+    // Bounds of the integral term, in uclamp.min units.
+    double iMin = -128.0;
+    double iMax = 256.0;
+
+    // uclamp.min bounds, out of 1024.
+    int32_t uclampMinInit = 162;
+    int32_t uclampMinLow = 0;
+    int32_t uclampMinHigh = 512;
+    // Cap of uclamp.min while the session is in SessionMode::POWER_EFFICIENCY.
+    int32_t uclampMinPowerEfficient = 128;
+    // Boost applied on SessionHint::CPU_LOAD_UP.
+    int32_t uclampMinLoadUp = 384;
+
+    // Only the last samplesWindow reports of a batch are considered.
+    size_t samplesWindow = 1;
+    // The boost of a session not reporting anything for this long is dropped.
+    std::chrono::milliseconds staleTimeout{100};
+    // Preferred interval between reports, returned by getHintSessionPreferredRate().
+    std::chrono::nanoseconds reportingRate{std::chrono::milliseconds(1)};
+
+    // Depth of the per-process FMQ channel, in messages.
+    size_t channelDepth = 64;
+
+    /**
+     * Loads the tunables file.
+     *
+     * Unknown names and malformed lines are logged and skipped. If the file can't be read, the
+     * defaults are returned.
+     */
+    static AdpfTunables load(const std::string& path = kDefaultPath);
+};
+
+}  // namespace aidl::android::hardware::power::impl::example
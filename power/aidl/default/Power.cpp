@@ -18,9 +18,6 @@
 #include "PowerHintSession.h"
 
 #include <android-base/logging.h>
-#include <fmq/AidlMessageQueue.h>
-#include <fmq/EventFlag.h>
-#include <thread>
 
 namespace aidl {
 namespace android {
@@ -29,18 +26,16 @@ namespace power {
 namespace impl {
 namespace example {
 
-using namespace std::chrono_literals;
-using ::aidl::android::hardware::common::fmq::MQDescriptor;
-using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
-using ::aidl::android::hardware::power::ChannelMessage;
-using ::android::AidlMessageQueue;
-
 using ndk::ScopedAStatus;
 
 const std::vector<Boost> BOOST_RANGE{ndk::enum_range<Boost>().begin(),
                                      ndk::enum_range<Boost>().end()};
 const std::vector<Mode> MODE_RANGE{ndk::enum_range<Mode>().begin(), ndk::enum_range<Mode>().end()};
 
+Power::Power()
+    : mSessionManager(std::make_shared<SessionManager>(AdpfTunables::load())),
+      mSessionChannels(mSessionManager) {}
+
 ScopedAStatus Power::setMode(Mode type, bool enabled) {
     LOG(VERBOSE) << "Power setMode: " << static_cast<int32_t>(type) << " to: " << enabled;
     return ScopedAStatus::ok();
@@ -64,16 +59,15 @@ ScopedAStatus Power::isBoostSupported(Boost type, bool* _aidl_return) {
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus Power::createHintSession(int32_t, int32_t, const std::vector<int32_t>& tids, int64_t,
+ScopedAStatus Power::createHintSession(int32_t tgid, int32_t, const std::vector<int32_t>& tids,
+                                       int64_t durationNanos,
                                        std::shared_ptr<IPowerHintSession>* _aidl_return) {
-    if (tids.size() == 0) {
+    if (tids.size() == 0 || durationNanos <= 0) {
         *_aidl_return = nullptr;
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
-    std::shared_ptr<IPowerHintSession> powerHintSession =
-            ndk::SharedRefBase::make<PowerHintSession>();
-    mPowerHintSessions.push_back(powerHintSession);
-    *_aidl_return = powerHintSession;
+    // The manager only keeps track of the session, its lifetime is up to the client.
+    *_aidl_return = PowerHintSession::create(mSessionManager, tgid, tids, durationNanos);
     return ScopedAStatus::ok();
 }
 
@@ -81,32 +75,26 @@ ndk::ScopedAStatus Power::createHintSessionWithConfig(
         int32_t tgid, int32_t uid, const std::vector<int32_t>& threadIds, int64_t durationNanos,
         SessionTag, SessionConfig* config, std::shared_ptr<IPowerHintSession>* _aidl_return) {
     auto out = createHintSession(tgid, uid, threadIds, durationNanos, _aidl_return);
+    if (!out.isOk()) return out;
     static_cast<PowerHintSession*>(_aidl_return->get())->getSessionConfig(config);
     return out;
 }
 
-ndk::ScopedAStatus Power::getSessionChannel(int32_t, int32_t, ChannelConfig* _aidl_return) {
-    static AidlMessageQueue<ChannelMessage, SynchronizedReadWrite> stubQueue{20, true};
-    static std::thread stubThread([&] {
-        ChannelMessage data;
-        // This loop will only run while there is data waiting
-        // to be processed, and blocks on a futex all other times
-        while (stubQueue.readBlocking(&data, 1, 0)) {
-        }
-    });
-    _aidl_return->channelDescriptor = stubQueue.dupeDesc();
-    _aidl_return->readFlagBitmask = 0x01;
-    _aidl_return->writeFlagBitmask = 0x02;
-    _aidl_return->eventFlagDescriptor = std::nullopt;
+ndk::ScopedAStatus Power::getSessionChannel(int32_t tgid, int32_t uid,
+                                            ChannelConfig* _aidl_return) {
+    if (!mSessionChannels.open(tgid, uid, _aidl_return)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Power::closeSessionChannel(int32_t, int32_t) {
+ndk::ScopedAStatus Power::closeSessionChannel(int32_t tgid, int32_t uid) {
+    mSessionChannels.close(tgid, uid);
     return ndk::ScopedAStatus::ok();
 }
 
 ScopedAStatus Power::getHintSessionPreferredRate(int64_t* outNanoseconds) {
-    *outNanoseconds = std::chrono::nanoseconds(1ms).count();
+    *outNanoseconds = mSessionManager->tunables().reportingRate.count();
     return ScopedAStatus::ok();
 }
 
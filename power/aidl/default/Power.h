@@ -16,9 +16,14 @@
 
 #pragma once
 
+#include "SessionChannels.h"
+#include "SessionManager.h"
+
 #include <aidl/android/hardware/power/BnPower.h>
 #include "aidl/android/hardware/power/SessionTag.h"
 
+#include <memory>
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -28,6 +33,8 @@ namespace example {
 
 class Power : public BnPower {
   public:
+    Power();
+
     ndk::ScopedAStatus setMode(Mode type, bool enabled) override;
     ndk::ScopedAStatus isModeSupported(Mode type, bool* _aidl_return) override;
     ndk::ScopedAStatus setBoost(Boost type, int32_t durationMs) override;
@@ -46,7 +53,8 @@ class Power : public BnPower {
     ndk::ScopedAStatus closeSessionChannel(int32_t tgid, int32_t uid) override;
 
   private:
-    std::vector<std::shared_ptr<IPowerHintSession>> mPowerHintSessions;
+    const std::shared_ptr<SessionManager> mSessionManager;
+    SessionChannels mSessionChannels;
 };
 
 }  // namespace example
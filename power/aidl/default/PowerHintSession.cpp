@@ -19,36 +19,164 @@
 #include <android-base/logging.h>
 #include "android/binder_auto_utils.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace aidl::android::hardware::power::impl::example {
 
 using ndk::ScopedAStatus;
 
-PowerHintSession::PowerHintSession() {}
+std::shared_ptr<PowerHintSession> PowerHintSession::create(std::shared_ptr<SessionManager> manager,
+                                                           int32_t tgid,
+                                                           const std::vector<int32_t>& threadIds,
+                                                           int64_t durationNanos) {
+    auto session = ndk::SharedRefBase::make<PowerHintSession>(manager, threadIds, durationNanos);
+    session->mId = manager->addSession(tgid, session);
+    return session;
+}
+
+PowerHintSession::PowerHintSession(std::shared_ptr<SessionManager> manager,
+                                   const std::vector<int32_t>& threadIds, int64_t durationNanos)
+    : mManager(std::move(manager)),
+      mTunables(mManager->tunables()),
+      mThreadIds(threadIds),
+      mTargetNanos(durationNanos) {}
+
+PowerHintSession::~PowerHintSession() {
+    close();
+}
+
+void PowerHintSession::resetLocked() {
+    mIntegral = 0;
+    mPrevError = 0;
+    mOutput = 0;
+}
+
+int32_t PowerHintSession::uclampMinLocked() const {
+    int32_t high = mTunables.uclampMinHigh;
+    if (mPowerEfficient) high = std::min(high, mTunables.uclampMinPowerEfficient);
+    const int32_t low = std::min(mTunables.uclampMinLow, high);
+    return std::clamp(static_cast<int32_t>(std::lround(mTunables.uclampMinInit + mOutput)), low,
+                      high);
+}
+
+void PowerHintSession::voteLocked(bool active) {
+    mManager->setVote(mId, mThreadIds, mPaused ? 0 : uclampMinLocked(), active);
+}
 
 ScopedAStatus PowerHintSession::updateTargetWorkDuration(int64_t targetDurationNanos) {
     LOG(VERBOSE) << __func__ << "target duration in nanoseconds: " << targetDurationNanos;
+    if (targetDurationNanos <= 0) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    mTargetNanos = targetDurationNanos;
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus PowerHintSession::reportActualWorkDuration(
-        const std::vector<WorkDuration>& /* durations */) {
+        const std::vector<WorkDuration>& durations) {
     LOG(VERBOSE) << __func__;
+    if (durations.empty()) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (mPaused || mTargetNanos <= 0) return ScopedAStatus::ok();
+
+    // After a long enough gap the old state says nothing about the upcoming work.
+    const auto now = SessionManager::Clock::now();
+    if (mLastReport.has_value() && now - *mLastReport > mTunables.staleTimeout) resetLocked();
+    mLastReport = now;
+
+    const size_t window = std::min(durations.size(), mTunables.samplesWindow);
+    double proportional = 0;
+    double derivative = 0;
+    for (auto it = durations.end() - window; it != durations.end(); ++it) {
+        const double error =
+                static_cast<double>(it->durationNanos - mTargetNanos) / mTargetNanos;
+        proportional = error * (error > 0 ? mTunables.pOver : mTunables.pUnder);
+        mIntegral = std::clamp(mIntegral + error * mTunables.i, mTunables.iMin, mTunables.iMax);
+        const double change = error - mPrevError;
+        derivative = change * (change > 0 ? mTunables.dOver : mTunables.dUnder);
+        mPrevError = error;
+    }
+    mOutput = proportional + mIntegral + derivative;
+
+    voteLocked(true);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus PowerHintSession::pause() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (mPaused) return ScopedAStatus::ok();
+    mPaused = true;
+    voteLocked(false);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus PowerHintSession::resume() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (!mPaused) return ScopedAStatus::ok();
+    mPaused = false;
+    mLastReport.reset();
+    resetLocked();
+    voteLocked(true);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus PowerHintSession::close() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mClosed) return ScopedAStatus::ok();
+        mClosed = true;
+    }
+    mManager->removeSession(mId);
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus PowerHintSession::sendHint(SessionHint /* hint */) {
+ScopedAStatus PowerHintSession::sendHint(SessionHint hint) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    switch (hint) {
+        case SessionHint::CPU_LOAD_UP: {
+            // Jump straight to the boost instead of waiting for the controller to catch up.
+            const double boost = mTunables.uclampMinLoadUp - mTunables.uclampMinInit;
+            mIntegral = std::clamp(std::max(mIntegral, boost), mTunables.iMin, mTunables.iMax);
+            mOutput = std::max(mOutput, boost);
+            break;
+        }
+        case SessionHint::CPU_LOAD_DOWN:
+            mIntegral = std::min(mIntegral, 0.0);
+            mOutput = std::min(mOutput, 0.0);
+            break;
+        case SessionHint::CPU_LOAD_RESET:
+            mSavedIntegral = mIntegral;
+            resetLocked();
+            break;
+        case SessionHint::CPU_LOAD_RESUME:
+            if (mSavedIntegral.has_value()) {
+                mIntegral = *mSavedIntegral;
+                mOutput = mIntegral;
+                mPrevError = 0;
+                mSavedIntegral.reset();
+            }
+            break;
+        case SessionHint::POWER_EFFICIENCY:
+            mPowerEfficient = true;
+            break;
+        case SessionHint::GPU_LOAD_UP:
+        case SessionHint::GPU_LOAD_DOWN:
+        case SessionHint::GPU_LOAD_RESET:
+            // Only the CPU is boosted by this implementation.
+            return ScopedAStatus::ok();
+        default:
+            return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    if (!mPaused) voteLocked(true);
     return ScopedAStatus::ok();
 }
 
@@ -57,15 +185,26 @@ ScopedAStatus PowerHintSession::setThreads(const std::vector<int32_t>& threadIds
         LOG(ERROR) << "Error: threadIds.size() shouldn't be " << threadIds.size();
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    mThreadIds = threadIds;
+    voteLocked(!mPaused);
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus PowerHintSession::setMode(SessionMode /* mode */, bool /* enabled */) {
+ScopedAStatus PowerHintSession::setMode(SessionMode mode, bool enabled) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClosed) return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (mode != SessionMode::POWER_EFFICIENCY) {
+        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    mPowerEfficient = enabled;
+    if (!mPaused) voteLocked(true);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus PowerHintSession::getSessionConfig(SessionConfig* _aidl_return) {
-    _aidl_return->id = 1;
+    _aidl_return->id = mId;
     return ScopedAStatus::ok();
 }
 
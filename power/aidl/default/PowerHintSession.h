@@ -16,16 +16,40 @@
 
 #pragma once
 
+#include "SessionManager.h"
+
 #include <aidl/android/hardware/power/BnPowerHintSession.h>
 #include <aidl/android/hardware/power/SessionHint.h>
 #include <aidl/android/hardware/power/SessionMode.h>
 #include <aidl/android/hardware/power/WorkDuration.h>
+#include <android-base/thread_annotations.h>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace aidl::android::hardware::power::impl::example {
 
+/**
+ * Hint session driving uclamp.min of its threads from the reported work durations.
+ *
+ * Each report feeds a PID controller over the error relative to the target duration: overruns
+ * raise uclamp.min, underruns give the boost back. The resulting value is a vote, combined with
+ * the votes of the other sessions by the SessionManager.
+ */
 class PowerHintSession : public BnPowerHintSession {
   public:
-    explicit PowerHintSession();
+    /** Creates a session and registers it with the manager. */
+    static std::shared_ptr<PowerHintSession> create(std::shared_ptr<SessionManager> manager,
+                                                    int32_t tgid,
+                                                    const std::vector<int32_t>& threadIds,
+                                                    int64_t durationNanos);
+
+    PowerHintSession(std::shared_ptr<SessionManager> manager,
+                     const std::vector<int32_t>& threadIds, int64_t durationNanos);
+    ~PowerHintSession();
+
     ndk::ScopedAStatus updateTargetWorkDuration(int64_t targetDurationNanos) override;
     ndk::ScopedAStatus reportActualWorkDuration(
             const std::vector<WorkDuration>& durations) override;
@@ -36,6 +60,35 @@ class PowerHintSession : public BnPowerHintSession {
     ndk::ScopedAStatus setThreads(const std::vector<int32_t>& threadIds) override;
     ndk::ScopedAStatus setMode(SessionMode mode, bool enabled) override;
     ndk::ScopedAStatus getSessionConfig(SessionConfig* _aidl_return) override;
+
+    int64_t getId() const { return mId; }
+
+  private:
+    /** Restarts the controller from the initial uclamp.min. */
+    void resetLocked() REQUIRES(mLock);
+    /** Computes uclamp.min from the controller state and the mode. */
+    int32_t uclampMinLocked() const REQUIRES(mLock);
+    /** Publishes the current uclamp.min to the manager. */
+    void voteLocked(bool active) REQUIRES(mLock);
+
+    const std::shared_ptr<SessionManager> mManager;
+    const AdpfTunables& mTunables;
+    int64_t mId = 0;
+
+    std::mutex mLock;
+    std::vector<int32_t> mThreadIds GUARDED_BY(mLock);
+    int64_t mTargetNanos GUARDED_BY(mLock);
+    bool mPaused GUARDED_BY(mLock) = false;
+    bool mClosed GUARDED_BY(mLock) = false;
+    bool mPowerEfficient GUARDED_BY(mLock) = false;
+
+    // Controller state. The integral is kept in uclamp.min units, on top of the initial value.
+    double mIntegral GUARDED_BY(mLock) = 0;
+    double mPrevError GUARDED_BY(mLock) = 0;
+    double mOutput GUARDED_BY(mLock) = 0;
+    std::optional<SessionManager::Clock::time_point> mLastReport GUARDED_BY(mLock);
+    /** Integral before the last SessionHint::CPU_LOAD_RESET, restored on CPU_LOAD_RESUME. */
+    std::optional<double> mSavedIntegral GUARDED_BY(mLock);
 };
 
 }  // namespace aidl::android::hardware::power::impl::example
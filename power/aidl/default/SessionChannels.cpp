@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SessionChannels.h"
+#include "PowerHintSession.h"
+
+#include <android-base/logging.h>
+
+namespace aidl::android::hardware::power::impl::example {
+
+using ::android::hardware::EventFlag;
+
+SessionChannels::SessionChannels(std::shared_ptr<SessionManager> manager)
+    : mManager(std::move(manager)), mFlagQueue(1, true) {
+    if (!mFlagQueue.isValid() ||
+        EventFlag::createEventFlag(mFlagQueue.getEventFlagWord(), &mEventFlag) != ::android::OK) {
+        LOG(ERROR) << "Failed to create the session channel event flag";
+        mEventFlag = nullptr;
+        return;
+    }
+    mWorker = std::thread(&SessionChannels::run, this);
+}
+
+SessionChannels::~SessionChannels() {
+    if (mEventFlag == nullptr) return;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopped = true;
+    }
+    mEventFlag->wake(kStopFlagBitmask);
+    mWorker.join();
+    EventFlag::deleteEventFlag(&mEventFlag);
+}
+
+bool SessionChannels::open(int32_t tgid, int32_t uid, ChannelConfig* config) {
+    if (mEventFlag == nullptr) return false;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto& channel = mChannels[{tgid, uid}];
+    if (!channel) {
+        channel = std::make_shared<Channel>(tgid, mManager->tunables().channelDepth);
+        if (!channel->queue.isValid()) {
+            LOG(ERROR) << "Failed to create the session channel of " << tgid << "/" << uid;
+            mChannels.erase({tgid, uid});
+            return false;
+        }
+    }
+
+    config->channelDescriptor = channel->queue.dupeDesc();
+    config->eventFlagDescriptor = mFlagQueue.dupeDesc();
+    config->readFlagBitmask = kReadFlagBitmask;
+    config->writeFlagBitmask = kWriteFlagBitmask;
+    return true;
+}
+
+void SessionChannels::close(int32_t tgid, int32_t uid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mChannels.erase({tgid, uid});
+}
+
+void SessionChannels::run() {
+    while (true) {
+        // Wake-ups are sticky: bits set while draining make the next wait return right away, so
+        // messages written after the availability check below aren't missed.
+        uint32_t state = 0;
+        mEventFlag->wait(kWriteFlagBitmask | kStopFlagBitmask, &state, 0, true);
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (mStopped) return;
+            for (const auto& [key, channel] : mChannels) {
+                if (channel->queue.availableToRead() > 0) mPending.push_back(channel);
+            }
+        }
+        for (const auto& channel : mPending) drain(*channel);
+        mPending.clear();
+    }
+}
+
+void SessionChannels::drain(Channel& channel) {
+    const size_t available = channel.queue.availableToRead();
+    mMessages.resize(available);
+    if (!channel.queue.read(mMessages.data(), available)) {
+        LOG(WARNING) << "Failed to read the session channel of " << channel.tgid;
+        mMessages.clear();
+        return;
+    }
+    // Writers blocked on a full queue can go on.
+    mEventFlag->wake(kReadFlagBitmask);
+    dispatch(channel.tgid);
+    mMessages.clear();
+}
+
+void SessionChannels::dispatch(int32_t tgid) {
+    using Tag = ChannelMessage::ChannelMessageContents::Tag;
+
+    std::shared_ptr<PowerHintSession> session;
+    int32_t sessionId = 0;
+    const auto flush = [&] {
+        if (session && !mDurations.empty()) session->reportActualWorkDuration(mDurations);
+        mDurations.clear();
+    };
+
+    for (const auto& message : mMessages) {
+        if (!session || message.sessionID != sessionId) {
+            flush();
+            sessionId = message.sessionID;
+            session = mManager->getSession(sessionId, tgid);
+            if (!session) {
+                LOG(VERBOSE) << "Dropping message for unknown session " << sessionId;
+            }
+        }
+        if (!session) continue;
+
+        const auto& data = message.data;
+        if (data.getTag() == Tag::workDuration) {
+            const auto& fixed = data.get<Tag::workDuration>();
+            mDurations.push_back({
+                    .timeStampNanos = message.timeStampNanos,
+                    .durationNanos = fixed.durationNanos,
+                    .workPeriodStartTimestampNanos = fixed.workPeriodStartTimestampNanos,
+                    .cpuDurationNanos = fixed.cpuDurationNanos,
+                    .gpuDurationNanos = fixed.gpuDurationNanos,
+            });
+            continue;
+        }
+
+        // Anything else applies in order with the reports around it.
+        flush();
+        switch (data.getTag()) {
+            case Tag::targetDuration:
+                session->updateTargetWorkDuration(data.get<Tag::targetDuration>());
+                break;
+            case Tag::hint:
+                session->sendHint(data.get<Tag::hint>());
+                break;
+            case Tag::mode: {
+                const auto& mode = data.get<Tag::mode>();
+                session->setMode(mode.modeInt, mode.enabled);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    flush();
+}
+
+}  // namespace aidl::android::hardware::power::impl::example
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "SessionManager.h"
+
+#include <aidl/android/hardware/power/ChannelConfig.h>
+#include <aidl/android/hardware/power/ChannelMessage.h>
+#include <aidl/android/hardware/power/WorkDuration.h>
+#include <android-base/thread_annotations.h>
+#include <fmq/AidlMessageQueue.h>
+#include <fmq/EventFlag.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::power::impl::example {
+
+/**
+ * FMQ channels of the processes using hint sessions, drained by a single worker thread.
+ *
+ * Each process gets its own queue of ChannelMessages, but all of them share one event flag: a
+ * writer wakes the worker with the write bit, the worker drains every queue with pending messages
+ * and wakes blocked writers with the read bit. Messages are dispatched straight to the sessions,
+ * so per-frame reports don't go through binder, and consecutive work durations of a session are
+ * handed over as a single batch.
+ */
+class SessionChannels {
+  public:
+    static constexpr uint32_t kReadFlagBitmask = 0x01;
+    static constexpr uint32_t kWriteFlagBitmask = 0x02;
+
+    explicit SessionChannels(std::shared_ptr<SessionManager> manager);
+    ~SessionChannels();
+
+    /**
+     * Gets the channel of a process, creating it if needed.
+     *
+     * \return true on success, false if the channel couldn't be created
+     */
+    bool open(int32_t tgid, int32_t uid, ChannelConfig* config);
+    /** Closes the channel of a process. Messages still in it are dropped. */
+    void close(int32_t tgid, int32_t uid);
+
+  private:
+    using ChannelQueue = ::android::AidlMessageQueue<
+            ChannelMessage, ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>;
+    using FlagQueue = ::android::AidlMessageQueue<
+            int8_t, ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>;
+
+    struct Channel {
+        Channel(int32_t tgid, size_t depth) : tgid(tgid), queue(depth, false) {}
+
+        const int32_t tgid;
+        ChannelQueue queue;
+    };
+
+    /** Wakes the worker without a message, to make it notice it's being stopped. */
+    static constexpr uint32_t kStopFlagBitmask = 0x04;
+
+    void run();
+    void drain(Channel& channel);
+    void dispatch(int32_t tgid);
+
+    const std::shared_ptr<SessionManager> mManager;
+
+    /** Holds the event flag word shared by all channels. */
+    FlagQueue mFlagQueue;
+    ::android::hardware::EventFlag* mEventFlag = nullptr;
+
+    std::mutex mLock;
+    /** Channels, by tgid and uid. The worker holds a reference while draining one. */
+    std::map<std::pair<int32_t, int32_t>, std::shared_ptr<Channel>> mChannels GUARDED_BY(mLock);
+    bool mStopped GUARDED_BY(mLock) = false;
+
+    /** Worker state, only touched by the worker. */
+    std::vector<std::shared_ptr<Channel>> mPending;
+    std::vector<ChannelMessage> mMessages;
+    std::vector<WorkDuration> mDurations;
+
+    std::thread mWorker;
+};
+
+}  // namespace aidl::android::hardware::power::impl::example
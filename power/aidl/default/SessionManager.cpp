@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SessionManager.h"
+#include "PowerHintSession.h"
+
+#include <android-base/logging.h>
+#include <linux/sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifndef SCHED_FLAG_KEEP_ALL
+#define SCHED_FLAG_KEEP_ALL 0x18
+#endif
+#ifndef SCHED_FLAG_UTIL_CLAMP_MIN
+#define SCHED_FLAG_UTIL_CLAMP_MIN 0x20
+#endif
+
+namespace aidl::android::hardware::power::impl::example {
+
+namespace {
+
+// Layout of the kernel's struct sched_attr, up to the utilization clamps.
+struct SchedAttr {
+    uint32_t size;
+    uint32_t schedPolicy;
+    uint64_t schedFlags;
+    int32_t schedNice;
+    uint32_t schedPriority;
+    uint64_t schedRuntime;
+    uint64_t schedDeadline;
+    uint64_t schedPeriod;
+    uint32_t schedUtilMin;
+    uint32_t schedUtilMax;
+};
+
+/** Sets uclamp.min of a thread, keeping its policy and the rest of its attributes. */
+bool setUclampMin(int32_t tid, int32_t uclampMin) {
+    SchedAttr attr = {};
+    attr.size = sizeof(attr);
+    attr.schedFlags = SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP_MIN;
+    attr.schedUtilMin = uclampMin;
+    if (syscall(__NR_sched_setattr, tid, &attr, 0) != 0) {
+        if (errno != ESRCH) PLOG(WARNING) << "Failed to set uclamp.min of thread " << tid;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+SessionManager::SessionManager(AdpfTunables tunables)
+    : mTunables(std::move(tunables)), mStaleThread(&SessionManager::staleThread, this) {}
+
+SessionManager::~SessionManager() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStop = true;
+    }
+    mStaleCv.notify_one();
+    mStaleThread.join();
+}
+
+int64_t SessionManager::addSession(int32_t tgid, const std::shared_ptr<PowerHintSession>& session) {
+    const int64_t id = mNextSessionId++;
+    std::lock_guard<std::mutex> lock(mLock);
+    auto& entry = mSessions[id];
+    entry.tgid = tgid;
+    entry.session = session;
+    return id;
+}
+
+void SessionManager::removeSession(int64_t id) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mSessions.find(id);
+    if (it == mSessions.end()) return;
+    const auto threadIds = std::move(it->second.threadIds);
+    mSessions.erase(it);
+    applyLocked(threadIds);
+}
+
+std::shared_ptr<PowerHintSession> SessionManager::getSession(int64_t id, int32_t tgid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mSessions.find(id);
+    if (it == mSessions.end() || it->second.tgid != tgid) return nullptr;
+    return it->second.session.lock();
+}
+
+void SessionManager::setVote(int64_t id, const std::vector<int32_t>& threadIds, int32_t uclampMin,
+                             bool active) {
+    bool newDeadline = false;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mSessions.find(id);
+        if (it == mSessions.end()) return;
+        auto& entry = it->second;
+
+        // Threads dropped from the session need to be recomputed as well.
+        std::vector<int32_t> affected = threadIds;
+        for (const auto tid : entry.threadIds) {
+            if (std::find(threadIds.begin(), threadIds.end(), tid) == threadIds.end()) {
+                affected.push_back(tid);
+            }
+        }
+
+        if (active) {
+            newDeadline = !entry.staleDeadline.has_value();
+            entry.staleDeadline = Clock::now() + mTunables.staleTimeout;
+        } else {
+            entry.staleDeadline.reset();
+        }
+        const bool changed = entry.uclampMin != uclampMin || entry.threadIds != threadIds;
+        entry.threadIds = threadIds;
+        entry.uclampMin = uclampMin;
+        if (changed) applyLocked(affected);
+    }
+    // Deadlines of sessions already being tracked only move later, so the stale thread only
+    // needs waking up when there may be a new earliest one.
+    if (newDeadline) mStaleCv.notify_one();
+}
+
+void SessionManager::applyLocked(const std::vector<int32_t>& threadIds) {
+    for (const auto tid : threadIds) {
+        int32_t uclampMin = 0;
+        for (const auto& [id, entry] : mSessions) {
+            if (entry.uclampMin <= uclampMin) continue;
+            if (std::find(entry.threadIds.begin(), entry.threadIds.end(), tid) !=
+                entry.threadIds.end()) {
+                uclampMin = entry.uclampMin;
+            }
+        }
+
+        auto applied = mApplied.find(tid);
+        const int32_t current = applied == mApplied.end() ? 0 : applied->second;
+        if (current == uclampMin) continue;
+        if (!setUclampMin(tid, uclampMin) || uclampMin == 0) {
+            if (applied != mApplied.end()) mApplied.erase(applied);
+        } else {
+            mApplied[tid] = uclampMin;
+        }
+    }
+}
+
+void SessionManager::staleThread() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mStop) {
+        const auto now = Clock::now();
+        std::optional<Clock::time_point> next;
+        for (auto& [id, entry] : mSessions) {
+            if (!entry.staleDeadline.has_value()) continue;
+            if (*entry.staleDeadline <= now) {
+                LOG(VERBOSE) << "Session " << id << " went stale, dropping its boost";
+                entry.staleDeadline.reset();
+                entry.uclampMin = 0;
+                applyLocked(entry.threadIds);
+            } else if (!next.has_value() || *entry.staleDeadline < *next) {
+                next = entry.staleDeadline;
+            }
+        }
+
+        if (next.has_value()) {
+            mStaleCv.wait_until(lock, *next);
+        } else {
+            mStaleCv.wait(lock);
+        }
+    }
+}
+
+}  // namespace aidl::android::hardware::power::impl::example
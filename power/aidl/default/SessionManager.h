@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "AdpfTunables.h"
+
+#include <android-base/thread_annotations.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace aidl::android::hardware::power::impl::example {
+
+class PowerHintSession;
+
+/**
+ * Keeps track of the hint sessions and applies their boosts.
+ *
+ * Each session votes for a uclamp.min value for its threads. A thread may belong to multiple
+ * sessions of its process, so the value applied to it is the highest vote among them; threads are
+ * only updated when that value changes. Votes of sessions that stop reporting are dropped after
+ * the stale timeout, until they report again.
+ */
+class SessionManager {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SessionManager(AdpfTunables tunables);
+    ~SessionManager();
+
+    const AdpfTunables& tunables() const { return mTunables; }
+
+    /** Registers a new session, returning its id. */
+    int64_t addSession(int32_t tgid, const std::shared_ptr<PowerHintSession>& session);
+    /** Unregisters a session, dropping its vote. */
+    void removeSession(int64_t id);
+    /** Finds a live session of the given process, or returns nullptr. */
+    std::shared_ptr<PowerHintSession> getSession(int64_t id, int32_t tgid);
+
+    /**
+     * Updates the vote of a session.
+     *
+     * \param id Session id
+     * \param threadIds Threads of the session
+     * \param uclampMin uclamp.min wanted for the threads, 0 for no boost
+     * \param active Whether the session just reported work, in which case its vote is kept until
+     *               the stale timeout expires; otherwise the vote is kept indefinitely
+     */
+    void setVote(int64_t id, const std::vector<int32_t>& threadIds, int32_t uclampMin, bool active);
+
+  private:
+    struct Entry {
+        int32_t tgid;
+        std::weak_ptr<PowerHintSession> session;
+        std::vector<int32_t> threadIds;
+        int32_t uclampMin = 0;
+        std::optional<Clock::time_point> staleDeadline;
+    };
+
+    /** Recomputes and applies uclamp.min of the given threads. */
+    void applyLocked(const std::vector<int32_t>& threadIds) REQUIRES(mLock);
+    void staleThread();
+
+    const AdpfTunables mTunables;
+    std::atomic<int64_t> mNextSessionId = 1;
+
+    std::mutex mLock;
+    std::map<int64_t, Entry> mSessions GUARDED_BY(mLock);
+    /** uclamp.min currently applied to each boosted thread. */
+    std::unordered_map<int32_t, int32_t> mApplied GUARDED_BY(mLock);
+
+    std::condition_variable mStaleCv;
+    bool mStop GUARDED_BY(mLock) = false;
+    std::thread mStaleThread;
+};
+
+}  // namespace aidl::android::hardware::power::impl::example
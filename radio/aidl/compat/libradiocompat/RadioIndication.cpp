@@ -16,8 +16,32 @@
 
 #include <libradiocompat/RadioIndication.h>
 
+using namespace std::literals::chrono_literals;
+
 namespace android::hardware::radio::compat {
 
-RadioIndication::RadioIndication(std::shared_ptr<DriverContext> context) : mContext(context) {}
+namespace aidl = ::aidl::android::hardware::radio;
+
+/**
+ * Minimum time between two indications that supersede each other, like signal strength reports.
+ *
+ * The framework doesn't act on every single report anyway, but a modem in 5G NSA mode may send
+ * them many times a second.
+ */
+static constexpr auto kCoalescingWindow = 200ms;
+
+RadioIndication::RadioIndication(std::shared_ptr<DriverContext> context)
+    : mContext(context),
+      mSignalStrength(kCoalescingWindow,
+                      [this](aidl::RadioIndicationType type,
+                             const aidl::network::SignalStrength& signalStrength) {
+                          networkCb()->currentSignalStrength(type, signalStrength);
+                      }),
+      mPhysicalChannelConfigs(
+              kCoalescingWindow,
+              [this](aidl::RadioIndicationType type,
+                     const std::vector<aidl::network::PhysicalChannelConfig>& configs) {
+                  networkCb()->currentPhysicalChannelConfigs(type, configs);
+              }) {}
 
 }  // namespace android::hardware::radio::compat
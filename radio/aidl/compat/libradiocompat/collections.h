@@ -38,6 +38,22 @@ auto toAidl(const hidl_vec<T>& inp) {
     return out;
 }
 
+/**
+ * Converts hidl_vec<T> HIDL list into an existing std::vector<U> AIDL list.
+ *
+ * Unlike toAidl(const hidl_vec<T>&), this reuses the storage already allocated by the output list.
+ *
+ * \param inp vector to convert
+ * \param out vector to store the result in
+ */
+template <typename T, typename U>
+void toAidl(const hidl_vec<T>& inp, std::vector<U>& out) {
+    out.resize(inp.size());
+    for (size_t i = 0; i < inp.size(); i++) {
+        out[i] = toAidl(inp[i]);
+    }
+}
+
 /**
  * Converts std::vector<T> AIDL list to hidl_vec<T> HIDL list.
  *
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/radio/RadioIndicationType.h>
+#include <utils/Mutex.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace android::hardware::radio::compat {
+
+/**
+ * Rate-limits an indication where each report supersedes the previous one, such as signal strength.
+ *
+ * An indication is delivered right away if the previous one went out at least one window ago.
+ * Otherwise it's held back until the window ends, and replaced if another one arrives before that.
+ * Indications expecting an acknowledgement are never held back, since the modem waits for it.
+ *
+ * Indications are converted in place into a single value, so in a steady state the conversion
+ * reuses memory allocated for the previous ones.
+ */
+template <typename T>
+class IndicationCoalescer {
+    using Clock = std::chrono::steady_clock;
+    using Deliver = std::function<void(::aidl::android::hardware::radio::RadioIndicationType,
+                                       const T&)>;
+
+    const Clock::duration mWindow;
+    const Deliver mDeliver;
+
+    std::mutex mGuard;
+    std::condition_variable mCv;
+    T mValue GUARDED_BY(mGuard);
+    bool mPending GUARDED_BY(mGuard) = false;
+    Clock::time_point mNextDelivery GUARDED_BY(mGuard);
+    bool mDestroy GUARDED_BY(mGuard) = false;
+
+    /** Delivers held back indications, started when the first one is held back. */
+    std::thread mThread;
+
+    void deliverLocked(::aidl::android::hardware::radio::RadioIndicationType type)
+            REQUIRES(mGuard) {
+        // Delivery is a oneway call, so keeping the lock doesn't hold up the next indication long.
+        mPending = false;
+        mNextDelivery = Clock::now() + mWindow;
+        mDeliver(type, mValue);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mGuard);
+        while (!mDestroy) {
+            if (!mPending) {
+                mCv.wait(lock);
+                continue;
+            }
+            if (Clock::now() < mNextDelivery) {
+                mCv.wait_until(lock, mNextDelivery);
+                continue;
+            }
+            deliverLocked(::aidl::android::hardware::radio::RadioIndicationType::UNSOLICITED);
+        }
+    }
+
+  public:
+    IndicationCoalescer(Clock::duration window, Deliver deliver)
+        : mWindow(window), mDeliver(std::move(deliver)) {}
+
+    ~IndicationCoalescer() {
+        {
+            std::unique_lock<std::mutex> lock(mGuard);
+            mDestroy = true;
+            mCv.notify_all();
+        }
+        if (mThread.joinable()) mThread.join();
+    }
+
+    /**
+     * Posts an indication.
+     *
+     * \param type Indication type
+     * \param convert Called with the value to convert the indication into, reusing its storage
+     */
+    template <typename Convert>
+    void post(::aidl::android::hardware::radio::RadioIndicationType type, Convert&& convert) {
+        std::unique_lock<std::mutex> lock(mGuard);
+        convert(mValue);
+        mPending = true;
+
+        if (type == ::aidl::android::hardware::radio::RadioIndicationType::UNSOLICITED &&
+            Clock::now() < mNextDelivery) {
+            if (!mThread.joinable()) mThread = std::thread(&IndicationCoalescer::run, this);
+            mCv.notify_all();
+            return;
+        }
+        deliverLocked(type);
+    }
+};
+
+}  // namespace android::hardware::radio::compat
@@ -17,6 +17,7 @@
 
 #include "DriverContext.h"
 #include "GuaranteedCallback.h"
+#include "IndicationCoalescer.h"
 
 #include <aidl/android/hardware/radio/data/IRadioDataIndication.h>
 #include <aidl/android/hardware/radio/ims/IRadioImsIndication.h>
@@ -62,6 +63,12 @@ class RadioIndication : public V1_6::IRadioIndication {
             ::aidl::android::hardware::radio::ims::IRadioImsIndicationDefault, true>
             mImsCb;
 
+    IndicationCoalescer<::aidl::android::hardware::radio::network::SignalStrength>
+            mSignalStrength;
+    IndicationCoalescer<  //
+            std::vector<::aidl::android::hardware::radio::network::PhysicalChannelConfig>>
+            mPhysicalChannelConfigs;
+
     // IRadioIndication @ 1.0
     Return<void> radioStateChanged(V1_0::RadioIndicationType type,
                                    V1_0::RadioState radioState) override;
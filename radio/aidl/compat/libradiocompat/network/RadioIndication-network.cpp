@@ -110,14 +110,14 @@ Return<void> RadioIndication::currentPhysicalChannelConfigs(
 Return<void> RadioIndication::currentPhysicalChannelConfigs_1_4(
         V1_0::RadioIndicationType type, const hidl_vec<V1_4::PhysicalChannelConfig>& configs) {
     LOG_CALL << type;
-    networkCb()->currentPhysicalChannelConfigs(toAidl(type), toAidl(configs));
+    mPhysicalChannelConfigs.post(toAidl(type), [&configs](auto& out) { toAidl(configs, out); });
     return {};
 }
 
 Return<void> RadioIndication::currentPhysicalChannelConfigs_1_6(
         V1_0::RadioIndicationType type, const hidl_vec<V1_6::PhysicalChannelConfig>& configs) {
     LOG_CALL << type;
-    networkCb()->currentPhysicalChannelConfigs(toAidl(type), toAidl(configs));
+    mPhysicalChannelConfigs.post(toAidl(type), [&configs](auto& out) { toAidl(configs, out); });
     return {};
 }
 
@@ -138,14 +138,18 @@ Return<void> RadioIndication::currentSignalStrength_1_2(V1_0::RadioIndicationTyp
 Return<void> RadioIndication::currentSignalStrength_1_4(
         V1_0::RadioIndicationType type, const V1_4::SignalStrength& signalStrength) {
     LOG_CALL << type;
-    networkCb()->currentSignalStrength(toAidl(type), toAidl(signalStrength));
+    mSignalStrength.post(toAidl(type), [&signalStrength](auto& out) {
+        out = toAidl(signalStrength);
+    });
     return {};
 }
 
 Return<void> RadioIndication::currentSignalStrength_1_6(
         V1_0::RadioIndicationType type, const V1_6::SignalStrength& signalStrength) {
     LOG_CALL << type;
-    networkCb()->currentSignalStrength(toAidl(type), toAidl(signalStrength));
+    mSignalStrength.post(toAidl(type), [&signalStrength](auto& out) {
+        out = toAidl(signalStrength);
+    });
     return {};
 }
 
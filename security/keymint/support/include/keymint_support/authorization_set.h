@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include <aidl/android/hardware/security/keymint/BlockMode.h>
@@ -34,6 +35,11 @@ class AuthorizationSetBuilder;
 /**
  * A collection of KeyParameters. It provides memory ownership and some convenient functionality for
  * sorting, deduplicating, joining, and subtracting sets of KeyParameters.
+ *
+ * Entries keep the order they were added in, since callers work with their indices. The set keeps
+ * track of whether that order happens to be sorted (e.g. after Sort(), Deduplicate(), Union() or
+ * Subtract(), or when entries were added in order), in which case tag lookups use binary search
+ * instead of a linear scan.
  */
 class AuthorizationSet {
   public:
@@ -45,10 +51,11 @@ class AuthorizationSet {
     AuthorizationSet(){};
 
     // Copy constructor.
-    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_) {}
+    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_), sorted_(other.sorted_) {}
 
     // Move constructor.
-    AuthorizationSet(AuthorizationSet&& other) noexcept : data_(std::move(other.data_)) {}
+    AuthorizationSet(AuthorizationSet&& other) noexcept
+        : data_(std::move(other.data_)), sorted_(other.sorted_) {}
 
     // Constructor from vector<KeyParameter>
     AuthorizationSet(const vector<KeyParameter>& other) { *this = other; }
@@ -56,12 +63,14 @@ class AuthorizationSet {
     // Copy assignment.
     AuthorizationSet& operator=(const AuthorizationSet& other) {
         data_ = other.data_;
+        sorted_ = other.sorted_;
         return *this;
     }
 
     // Move assignment.
     AuthorizationSet& operator=(AuthorizationSet&& other) noexcept {
         data_ = std::move(other.data_);
+        sorted_ = other.sorted_;
         return *this;
     }
 
@@ -73,6 +82,7 @@ class AuthorizationSet {
                  * See assignment operator/copy constructor of vector.*/
                 data_[i] = other[i];
             }
+            sorted_ = std::is_sorted(data_.begin(), data_.end());
         }
         return *this;
     }
@@ -136,7 +146,11 @@ class AuthorizationSet {
     /**
      * Returns iterator (pointer) to beginning of elems array, to enable STL-style iteration
      */
-    auto begin() { return data_.begin(); }
+    auto begin() {
+        // The entries may be modified through the iterator.
+        sorted_ = false;
+        return data_.begin();
+    }
     auto begin() const { return data_.begin(); }
 
     /**
@@ -166,8 +180,8 @@ class AuthorizationSet {
 
     template <TagType tag_type, Tag tag, typename ValueT>
     bool Contains(TypedTag<tag_type, tag> ttag, const ValueT& value) const {
-        for (const auto& param : data_) {
-            auto entry = authorizationValue(ttag, param);
+        for (int pos = -1; (pos = find(tag, pos)) != -1;) {
+            auto entry = authorizationValue(ttag, data_[pos]);
             if (entry && static_cast<ValueT>(*entry) == value) return true;
         }
         return false;
@@ -184,8 +198,14 @@ class AuthorizationSet {
         return {};
     }
 
-    void push_back(const KeyParameter& param) { data_.push_back(param); }
-    void push_back(KeyParameter&& param) { data_.push_back(std::move(param)); }
+    void push_back(const KeyParameter& param) {
+        sorted_ = sorted_ && (data_.empty() || !(param < data_.back()));
+        data_.push_back(param);
+    }
+    void push_back(KeyParameter&& param) {
+        sorted_ = sorted_ && (data_.empty() || !(param < data_.back()));
+        data_.push_back(std::move(param));
+    }
     void push_back(const AuthorizationSet& set) {
         for (auto& entry : set) {
             push_back(entry);
@@ -222,6 +242,8 @@ class AuthorizationSet {
     std::optional<std::reference_wrapper<const KeyParameter>> GetEntry(Tag tag) const;
 
     std::vector<KeyParameter> data_;
+    /** Whether data_ is known to be sorted. */
+    bool sorted_ = true;
 };
 
 class AuthorizationSetBuilder : public AuthorizationSet {
@@ -109,6 +109,17 @@ struct BccEntryData {
     bytevec pubKey;
 };
 
+/**
+ * Validates a batch of CBOR-encoded DICE chains against the DICE chain profile of the vendor API
+ * level, and returns the public keys of each chain, from the root to the leaf, or the reason it
+ * is invalid. This is meant for the factory provisioning tools, which check many CSRs at once:
+ * identical chains are only validated once, distinct chains are validated in parallel, and the
+ * results are remembered for the chains seen again later, including by the verify*Csr and
+ * verify*ProtectedData functions.
+ */
+std::vector<ErrMsgOr<std::vector<BccEntryData>>> validateDiceChains(
+        const std::vector<bytevec>& encodedChains);
+
 struct JsonOutput {
     static JsonOutput Ok(std::string json) { return {std::move(json), ""}; }
     static JsonOutput Error(std::string error) { return {"", std::move(error)}; }
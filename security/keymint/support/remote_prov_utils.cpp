@@ -14,11 +14,17 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <array>
+#include <future>
 #include <iomanip>
 #include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include "aidl/android/hardware/security/keymint/IRemotelyProvisionedComponent.h"
 
@@ -35,6 +41,7 @@
 #include <openssl/base64.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 #include <remote_prov/remote_prov_utils.h>
 
@@ -323,18 +330,121 @@ bytevec getProdEekChain(int32_t supportedEekCurve) {
     return chain.encode();
 }
 
-ErrMsgOr<std::vector<BccEntryData>> validateBcc(const cppbor::Array* bcc,
-                                                hwtrust::DiceChain::Kind kind) {
-    auto encodedBcc = bcc->encode();
-    auto chain = hwtrust::DiceChain::Verify(encodedBcc, kind);
-    if (!chain.ok()) return chain.error().message();
+namespace {
+
+// Results of the DICE chains validated so far, keyed by the hash of their kind and encoding.
+// Provisioning tools see the same chains over and over, and each validation verifies every
+// signature of the chain.
+constexpr size_t kMaxCachedDiceChains = 1024;
+
+struct DiceChainResult {
+    std::optional<std::vector<BccEntryData>> entries;
+    std::string errMsg;
+};
+
+using DiceChainHash = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+std::mutex gDiceChainCacheLock;
+std::map<DiceChainHash, DiceChainResult> gDiceChainCache;
+
+DiceChainHash hashDiceChain(const bytevec& encodedChain, hwtrust::DiceChain::Kind kind) {
+    DiceChainHash hash;
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &kind, sizeof(kind));
+    SHA256_Update(&ctx, encodedChain.data(), encodedChain.size());
+    SHA256_Final(hash.data(), &ctx);
+    return hash;
+}
+
+DiceChainResult verifyDiceChain(const bytevec& encodedChain, hwtrust::DiceChain::Kind kind) {
+    auto chain = hwtrust::DiceChain::Verify(encodedChain, kind);
+    if (!chain.ok()) return {std::nullopt, chain.error().message()};
     auto keys = chain->CosePublicKeys();
-    if (!keys.ok()) return keys.error().message();
+    if (!keys.ok()) return {std::nullopt, keys.error().message()};
     std::vector<BccEntryData> result;
     for (auto& key : *keys) {
         result.push_back({std::move(key)});
     }
-    return result;
+    return {std::move(result), ""};
+}
+
+ErrMsgOr<std::vector<BccEntryData>> toErrMsgOr(const DiceChainResult& result) {
+    if (!result.entries) return result.errMsg;
+    return *result.entries;
+}
+
+std::optional<DiceChainResult> findCachedDiceChain(const DiceChainHash& hash) {
+    std::lock_guard<std::mutex> lock(gDiceChainCacheLock);
+    auto it = gDiceChainCache.find(hash);
+    if (it == gDiceChainCache.end()) return std::nullopt;
+    return it->second;
+}
+
+void cacheDiceChain(const DiceChainHash& hash, const DiceChainResult& result) {
+    std::lock_guard<std::mutex> lock(gDiceChainCacheLock);
+    if (gDiceChainCache.size() >= kMaxCachedDiceChains) {
+        gDiceChainCache.clear();
+    }
+    gDiceChainCache.emplace(hash, result);
+}
+
+std::vector<ErrMsgOr<std::vector<BccEntryData>>> validateDiceChains(
+        const std::vector<bytevec>& encodedChains, hwtrust::DiceChain::Kind kind) {
+    // Distinct chains that are not cached yet, in order of first appearance.
+    std::vector<DiceChainHash> hashes;
+    std::map<DiceChainHash, DiceChainResult> results;
+    std::vector<std::pair<DiceChainHash, const bytevec*>> pending;
+    hashes.reserve(encodedChains.size());
+    for (const auto& encodedChain : encodedChains) {
+        hashes.push_back(hashDiceChain(encodedChain, kind));
+        if (results.count(hashes.back()) != 0) continue;
+        if (auto cached = findCachedDiceChain(hashes.back())) {
+            results.emplace(hashes.back(), std::move(*cached));
+        } else {
+            results.emplace(hashes.back(), DiceChainResult{});
+            pending.emplace_back(hashes.back(), &encodedChain);
+        }
+    }
+
+    // The chains are independent, so split them between the available cores.
+    const size_t numWorkers =
+            std::min<size_t>(pending.size(), std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> workers;
+    for (size_t worker = 0; worker < numWorkers; ++worker) {
+        workers.push_back(std::async(std::launch::async, [&, worker] {
+            for (size_t i = worker; i < pending.size(); i += numWorkers) {
+                auto result = verifyDiceChain(*pending[i].second, kind);
+                cacheDiceChain(pending[i].first, result);
+                // Each entry is only written by one worker, and the map is not modified.
+                results.find(pending[i].first)->second = std::move(result);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    std::vector<ErrMsgOr<std::vector<BccEntryData>>> output;
+    output.reserve(hashes.size());
+    for (const auto& hash : hashes) {
+        output.push_back(toErrMsgOr(results.find(hash)->second));
+    }
+    return output;
+}
+
+}  // namespace
+
+ErrMsgOr<std::vector<BccEntryData>> validateBcc(const cppbor::Array* bcc,
+                                                hwtrust::DiceChain::Kind kind) {
+    auto encodedBcc = bcc->encode();
+    auto hash = hashDiceChain(encodedBcc, kind);
+    if (auto cached = findCachedDiceChain(hash)) {
+        return toErrMsgOr(*cached);
+    }
+    auto result = verifyDiceChain(encodedBcc, kind);
+    cacheDiceChain(hash, result);
+    return toErrMsgOr(result);
 }
 
 JsonOutput jsonEncodeCsrWithBuild(const std::string& instance_name, const cppbor::Array& csr,
@@ -985,6 +1095,19 @@ ErrMsgOr<hwtrust::DiceChain::Kind> getDiceChainKind() {
     }
 }
 
+std::vector<ErrMsgOr<std::vector<BccEntryData>>> validateDiceChains(
+        const std::vector<bytevec>& encodedChains) {
+    auto diceChainKind = getDiceChainKind();
+    if (!diceChainKind) {
+        std::vector<ErrMsgOr<std::vector<BccEntryData>>> output;
+        for (size_t i = 0; i < encodedChains.size(); ++i) {
+            output.push_back(diceChainKind.message());
+        }
+        return output;
+    }
+    return validateDiceChains(encodedChains, *diceChainKind);
+}
+
 ErrMsgOr<bytevec> parseAndValidateAuthenticatedRequest(const std::vector<uint8_t>& request,
                                                        const std::vector<uint8_t>& challenge) {
     auto [parsedRequest, _, csrErrMsg] = cppbor::parse(request);
@@ -206,6 +206,22 @@ TEST(RemoteProvUtilsTest, JsonEncodeCsr) {
     ASSERT_EQ(json, expected);
 }
 
+TEST(RemoteProvUtilsTest, ValidateDiceChainsRejectsInvalidChains) {
+    cppbor::Array notAChain;
+    notAChain.add(1);
+    const bytevec encoded = notAChain.encode();
+
+    // The same chain twice, so the second result comes from the first validation.
+    auto results = validateDiceChains({encoded, encoded, bytevec{}});
+
+    ASSERT_EQ(results.size(), 3U);
+    for (const auto& result : results) {
+        EXPECT_FALSE(result);
+        EXPECT_FALSE(result.message().empty());
+    }
+    EXPECT_EQ(results[0].message(), results[1].message());
+}
+
 TEST(RemoteProvUtilsTest, GenerateEcdsaEekChainInvalidLength) {
     ASSERT_FALSE(generateEekChain(RpcHardwareInfo::CURVE_P256, 1, /*eekId=*/{}));
 }
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensors-impl/DirectChannel.h"
+
+#include <log/log.h>
+#include <sys/mman.h>
+
+#include <cstring>
+
+using ::aidl::android::hardware::sensors::Event;
+using ::aidl::android::hardware::sensors::ISensors;
+using ::ndk::ScopedAStatus;
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+
+namespace {
+
+constexpr size_t kEventSize = ISensors::DIRECT_REPORT_SENSOR_EVENT_TOTAL_LENGTH;
+constexpr size_t kDataSize = ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_RESERVED -
+                             ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_DATA;
+
+template <typename T>
+void writeField(uint8_t* record, int32_t offset, const T& value) {
+    memcpy(record + offset, &value, sizeof(value));
+}
+
+// Lays out the payload the same way as the data of sensors_event_t
+void writePayload(uint8_t* data, const Event::EventPayload& payload) {
+    using Tag = Event::EventPayload::Tag;
+    switch (payload.getTag()) {
+        case Tag::vec3: {
+            const auto& vec3 = payload.get<Tag::vec3>();
+            const float values[] = {vec3.x, vec3.y, vec3.z};
+            memcpy(data, values, sizeof(values));
+            break;
+        }
+        case Tag::scalar: {
+            const float value = payload.get<Tag::scalar>();
+            memcpy(data, &value, sizeof(value));
+            break;
+        }
+        case Tag::stepCount: {
+            const int64_t value = payload.get<Tag::stepCount>();
+            memcpy(data, &value, sizeof(value));
+            break;
+        }
+        case Tag::data: {
+            const auto& values = payload.get<Tag::data>().values;
+            static_assert(sizeof(values) == kDataSize);
+            memcpy(data, values.data(), sizeof(values));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+}  // namespace
+
+ScopedAStatus DirectChannel::create(const SharedMemInfo& mem,
+                                    std::shared_ptr<DirectChannel>* channel) {
+    if (mem.format != SharedMemInfo::SharedMemFormat::SENSORS_EVENT ||
+        mem.size < static_cast<int32_t>(kEventSize) || mem.memoryHandle.fds.empty() ||
+        mem.memoryHandle.fds[0].get() < 0) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    void* base = mmap(nullptr, mem.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mem.memoryHandle.fds[0].get(), 0 /* offset */);
+    if (base == MAP_FAILED) {
+        ALOGE("Failed to map direct channel memory of size %d: %s", mem.size, strerror(errno));
+        return ScopedAStatus::fromServiceSpecificError(
+                static_cast<int32_t>(ISensors::ERROR_NO_MEMORY));
+    }
+    memset(base, 0, mem.size);
+
+    channel->reset(new DirectChannel(static_cast<uint8_t*>(base), mem.size));
+    return ScopedAStatus::ok();
+}
+
+DirectChannel::DirectChannel(uint8_t* base, size_t size)
+    : mBase(base), mSize(size), mWriteOffset(0), mAtomicCounter(0) {}
+
+DirectChannel::~DirectChannel() {
+    munmap(mBase, mSize);
+}
+
+void DirectChannel::write(int32_t reportToken, const std::vector<Event>& events) {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    for (const Event& event : events) {
+        writeEvent(reportToken, event);
+    }
+}
+
+void DirectChannel::writeEvent(int32_t reportToken, const Event& event) {
+    if (mWriteOffset + kEventSize > mSize) {
+        mWriteOffset = 0;
+    }
+    uint8_t* record = mBase + mWriteOffset;
+    mWriteOffset += kEventSize;
+
+    // The counter starts from 1 and skips 0 when it wraps around, as 0 marks an unwritten record
+    if (++mAtomicCounter == 0) {
+        mAtomicCounter = 1;
+    }
+
+    writeField(record, ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_FIELD,
+               static_cast<int32_t>(kEventSize));
+    writeField(record, ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_REPORT_TOKEN, reportToken);
+    writeField(record, ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_SENSOR_TYPE,
+               static_cast<int32_t>(event.sensorType));
+    writeField(record, ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_TIMESTAMP, event.timestamp);
+    uint8_t* data = record + ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_DATA;
+    memset(data, 0, kEventSize - ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_DATA);
+    writePayload(data, event.payload);
+
+    auto* counter = reinterpret_cast<uint32_t*>(
+            record + ISensors::DIRECT_REPORT_SENSOR_EVENT_OFFSET_SIZE_ATOMIC_COUNTER);
+    __atomic_store_n(counter, mAtomicCounter, __ATOMIC_RELEASE);
+}
+
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -15,10 +15,13 @@
  */
 
 #include "sensors-impl/Sensor.h"
+#include "sensors-impl/SensorScheduler.h"
 
 #include "utils/SystemClock.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 using ::ndk::ScopedAStatus;
 
@@ -29,23 +32,37 @@ namespace sensors {
 
 static constexpr int32_t kDefaultMaxDelayUs = 10 * 1000 * 1000;
 
-Sensor::Sensor(ISensorsEventCallback* callback)
+// Flags of the sensors that report to both kinds of direct channel, at up to RateLevel::VERY_FAST
+static constexpr uint32_t kDirectReportFlags =
+        static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_ASHMEM |
+                              SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_GRALLOC) |
+        (static_cast<uint32_t>(ISensors::RateLevel::VERY_FAST)
+         << static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_SHIFT_DIRECT_REPORT));
+
+// Nominal rates of the direct report rate levels
+static int64_t directReportSamplingPeriodNs(ISensors::RateLevel rate) {
+    switch (rate) {
+        case ISensors::RateLevel::NORMAL:
+            return 1000 * 1000 * 1000 / 50;
+        case ISensors::RateLevel::FAST:
+            return 1000 * 1000 * 1000 / 200;
+        case ISensors::RateLevel::VERY_FAST:
+            return 1000 * 1000 * 1000 / 800;
+        default:
+            return 0;
+    }
+}
+
+Sensor::Sensor(ISensorsEventCallback* callback, SensorScheduler* scheduler)
     : mIsEnabled(false),
       mSamplingPeriodNs(0),
       mLastSampleTimeNs(0),
       mCallback(callback),
-      mMode(OperationMode::NORMAL) {
-    mRunThread = std::thread(startThread, this);
-}
+      mScheduler(scheduler),
+      mMode(OperationMode::NORMAL),
+      mScheduleGeneration(0) {}
 
-Sensor::~Sensor() {
-    std::unique_lock<std::mutex> lock(mRunMutex);
-    mStopThread = true;
-    mIsEnabled = false;
-    mWaitCV.notify_all();
-    lock.release();
-    mRunThread.join();
-}
+Sensor::~Sensor() {}
 
 const SensorInfo& Sensor::getSensorInfo() const {
     return mSensorInfo;
@@ -58,18 +75,19 @@ void Sensor::batch(int64_t samplingPeriodNs) {
         samplingPeriodNs = mSensorInfo.maxDelayUs * 1000LL;
     }
 
+    std::lock_guard<std::mutex> lock(mScheduler->getLock());
     if (mSamplingPeriodNs != samplingPeriodNs) {
         mSamplingPeriodNs = samplingPeriodNs;
-        // Wake up the 'run' thread to check if a new event should be generated now
-        mWaitCV.notify_all();
+        // Check if a new event should be generated now
+        rescheduleLocked();
     }
 }
 
 void Sensor::activate(bool enable) {
+    std::lock_guard<std::mutex> lock(mScheduler->getLock());
     if (mIsEnabled != enable) {
-        std::unique_lock<std::mutex> lock(mRunMutex);
         mIsEnabled = enable;
-        mWaitCV.notify_all();
+        rescheduleLocked();
     }
 }
 
@@ -97,57 +115,70 @@ ScopedAStatus Sensor::flush() {
     return ScopedAStatus::ok();
 }
 
-void Sensor::startThread(Sensor* sensor) {
-    sensor->run();
-}
+void Sensor::sampleLocked(int64_t now, std::vector<Event>* events) {
+    bool isFmqDue = mIsEnabled && now >= mLastSampleTimeNs + mSamplingPeriodNs;
+    bool isDirectReportDue = false;
+    for (const auto& [channelHandle, report] : mDirectReports) {
+        isDirectReportDue |= now >= report.lastSampleTimeNs + report.samplingPeriodNs;
+    }
+    if (!isFmqDue && !isDirectReportDue) {
+        return;
+    }
 
-void Sensor::run() {
-    std::unique_lock<std::mutex> runLock(mRunMutex);
-    constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
-
-    while (!mStopThread) {
-        if (!mIsEnabled || mMode == OperationMode::DATA_INJECTION) {
-            mWaitCV.wait(runLock, [&] {
-                return ((mIsEnabled && mMode == OperationMode::NORMAL) || mStopThread);
-            });
-        } else {
-            timespec curTime;
-            clock_gettime(CLOCK_BOOTTIME, &curTime);
-            int64_t now = (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
-            int64_t nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-
-            if (now >= nextSampleTime) {
-                mLastSampleTimeNs = now;
-                nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-                mCallback->postEvents(readEvents(), isWakeUpSensor());
-            }
-
-            mWaitCV.wait_for(runLock, std::chrono::nanoseconds(nextSampleTime - now));
+    mSampleEvents.clear();
+    readEvents(&mSampleEvents);
+
+    if (isFmqDue) {
+        mLastSampleTimeNs = now;
+        events->insert(events->end(), mSampleEvents.begin(), mSampleEvents.end());
+    }
+    // Each direct report runs at the rate of its own level, independently of the rate requested
+    // through batch()
+    for (auto& [channelHandle, report] : mDirectReports) {
+        if (now >= report.lastSampleTimeNs + report.samplingPeriodNs) {
+            report.lastSampleTimeNs = now;
+            report.channel->write(mSensorInfo.sensorHandle, mSampleEvents);
         }
     }
 }
 
-bool Sensor::isWakeUpSensor() {
+int64_t Sensor::getNextSampleTimeLocked() const {
+    int64_t nextSampleTime = std::numeric_limits<int64_t>::max();
+    if (mMode != OperationMode::NORMAL) {
+        return nextSampleTime;
+    }
+    if (mIsEnabled) {
+        nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
+    }
+    for (const auto& [channelHandle, report] : mDirectReports) {
+        nextSampleTime =
+                std::min(nextSampleTime, report.lastSampleTimeNs + report.samplingPeriodNs);
+    }
+    return nextSampleTime;
+}
+
+void Sensor::rescheduleLocked() {
+    mScheduler->scheduleLocked(this, getNextSampleTimeLocked());
+}
+
+bool Sensor::isWakeUpSensor() const {
     return mSensorInfo.flags & static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_WAKE_UP);
 }
 
-std::vector<Event> Sensor::readEvents() {
-    std::vector<Event> events;
-    Event event;
+void Sensor::readEvents(std::vector<Event>* events) {
+    Event& event = events->emplace_back();
     event.sensorHandle = mSensorInfo.sensorHandle;
     event.sensorType = mSensorInfo.type;
     event.timestamp = ::android::elapsedRealtimeNano();
     memset(&event.payload, 0, sizeof(event.payload));
     readEventPayload(event.payload);
-    events.push_back(event);
-    return events;
 }
 
 void Sensor::setOperationMode(OperationMode mode) {
+    std::lock_guard<std::mutex> lock(mScheduler->getLock());
     if (mMode != mode) {
-        std::unique_lock<std::mutex> lock(mRunMutex);
         mMode = mode;
-        mWaitCV.notify_all();
+        rescheduleLocked();
     }
 }
 
@@ -175,33 +206,77 @@ ScopedAStatus Sensor::injectEvent(const Event& event) {
             static_cast<int32_t>(BnSensors::ERROR_BAD_VALUE));
 }
 
-OnChangeSensor::OnChangeSensor(ISensorsEventCallback* callback)
-    : Sensor(callback), mPreviousEventSet(false) {}
+bool Sensor::supportsDirectReport() const {
+    return mSensorInfo.flags &
+           static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_MASK_DIRECT_CHANNEL);
+}
+
+bool Sensor::supportsDirectChannel(SharedMemType type) const {
+    switch (type) {
+        case SharedMemType::ASHMEM:
+            return mSensorInfo.flags &
+                   static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_ASHMEM);
+        case SharedMemType::GRALLOC:
+            return mSensorInfo.flags &
+                   static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_GRALLOC);
+        default:
+            return false;
+    }
+}
+
+bool Sensor::supportsDirectReportRate(RateLevel rate) const {
+    uint32_t maxRate =
+            (mSensorInfo.flags &
+             static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_MASK_DIRECT_REPORT)) >>
+            static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_SHIFT_DIRECT_REPORT);
+    return maxRate >= static_cast<uint32_t>(rate);
+}
+
+void Sensor::configDirectReport(int32_t channelHandle,
+                                const std::shared_ptr<DirectChannel>& channel, RateLevel rate) {
+    std::lock_guard<std::mutex> lock(mScheduler->getLock());
+    if (rate == RateLevel::STOP) {
+        mDirectReports.erase(channelHandle);
+    } else {
+        DirectReport& report = mDirectReports[channelHandle];
+        report.channel = channel;
+        report.samplingPeriodNs = directReportSamplingPeriodNs(rate);
+        report.lastSampleTimeNs = 0;
+    }
+    rescheduleLocked();
+}
+
+OnChangeSensor::OnChangeSensor(ISensorsEventCallback* callback, SensorScheduler* scheduler)
+    : Sensor(callback, scheduler), mPreviousEventSet(false) {}
 
 void OnChangeSensor::activate(bool enable) {
     Sensor::activate(enable);
     if (!enable) {
+        std::lock_guard<std::mutex> lock(mScheduler->getLock());
         mPreviousEventSet = false;
     }
 }
 
-std::vector<Event> OnChangeSensor::readEvents() {
-    std::vector<Event> events = Sensor::readEvents();
-    std::vector<Event> outputEvents;
+void OnChangeSensor::readEvents(std::vector<Event>* events) {
+    size_t firstEvent = events->size();
+    Sensor::readEvents(events);
 
-    for (auto iter = events.begin(); iter != events.end(); ++iter) {
-        Event ev = *iter;
+    // Only keep the events whose payload changed
+    auto output = events->begin() + firstEvent;
+    for (auto iter = output; iter != events->end(); ++iter) {
         if (!mPreviousEventSet ||
-            memcmp(&mPreviousEvent.payload, &ev.payload, sizeof(ev.payload)) != 0) {
-            outputEvents.push_back(ev);
-            mPreviousEvent = ev;
+            memcmp(&mPreviousEvent.payload, &iter->payload, sizeof(iter->payload)) != 0) {
+            mPreviousEvent = *iter;
             mPreviousEventSet = true;
+            *output++ = *iter;
         }
     }
-    return outputEvents;
+    events->erase(output, events->end());
 }
 
-AccelSensor::AccelSensor(int32_t sensorHandle, ISensorsEventCallback* callback) : Sensor(callback) {
+AccelSensor::AccelSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                         SensorScheduler* scheduler)
+    : Sensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Accel Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -216,7 +291,8 @@ AccelSensor::AccelSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
     mSensorInfo.fifoReservedEventCount = 0;
     mSensorInfo.fifoMaxEventCount = 0;
     mSensorInfo.requiredPermission = "";
-    mSensorInfo.flags = static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DATA_INJECTION);
+    mSensorInfo.flags =
+            static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DATA_INJECTION) | kDirectReportFlags;
 };
 
 void AccelSensor::readEventPayload(EventPayload& payload) {
@@ -229,8 +305,9 @@ void AccelSensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::vec3>(vec3);
 }
 
-PressureSensor::PressureSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : Sensor(callback) {
+PressureSensor::PressureSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                               SensorScheduler* scheduler)
+    : Sensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Pressure Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -252,8 +329,9 @@ void PressureSensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::scalar>(1013.25f);
 }
 
-MagnetometerSensor::MagnetometerSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : Sensor(callback) {
+MagnetometerSensor::MagnetometerSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                                       SensorScheduler* scheduler)
+    : Sensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Magnetic Field Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -281,8 +359,9 @@ void MagnetometerSensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::vec3>(vec3);
 }
 
-LightSensor::LightSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : OnChangeSensor(callback) {
+LightSensor::LightSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                         SensorScheduler* scheduler)
+    : OnChangeSensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Light Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -304,8 +383,9 @@ void LightSensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::scalar>(80.0f);
 }
 
-ProximitySensor::ProximitySensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : OnChangeSensor(callback) {
+ProximitySensor::ProximitySensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                                 SensorScheduler* scheduler)
+    : OnChangeSensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Proximity Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -328,7 +408,9 @@ void ProximitySensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::scalar>(2.5f);
 }
 
-GyroSensor::GyroSensor(int32_t sensorHandle, ISensorsEventCallback* callback) : Sensor(callback) {
+GyroSensor::GyroSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                       SensorScheduler* scheduler)
+    : Sensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Gyro Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -343,7 +425,8 @@ GyroSensor::GyroSensor(int32_t sensorHandle, ISensorsEventCallback* callback) :
     mSensorInfo.fifoReservedEventCount = 0;
     mSensorInfo.fifoMaxEventCount = 0;
     mSensorInfo.requiredPermission = "";
-    mSensorInfo.flags = static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DATA_INJECTION);
+    mSensorInfo.flags =
+            static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_DATA_INJECTION) | kDirectReportFlags;
 };
 
 void GyroSensor::readEventPayload(EventPayload& payload) {
@@ -356,8 +439,9 @@ void GyroSensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::vec3>(vec3);
 }
 
-AmbientTempSensor::AmbientTempSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : OnChangeSensor(callback) {
+AmbientTempSensor::AmbientTempSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                                     SensorScheduler* scheduler)
+    : OnChangeSensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Ambient Temp Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -380,8 +464,9 @@ void AmbientTempSensor::readEventPayload(EventPayload& payload) {
 }
 
 RelativeHumiditySensor::RelativeHumiditySensor(int32_t sensorHandle,
-                                               ISensorsEventCallback* callback)
-    : OnChangeSensor(callback) {
+                                               ISensorsEventCallback* callback,
+                                               SensorScheduler* scheduler)
+    : OnChangeSensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Relative Humidity Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -403,8 +488,9 @@ void RelativeHumiditySensor::readEventPayload(EventPayload& payload) {
     payload.set<EventPayload::Tag::scalar>(50.0f);
 }
 
-HingeAngleSensor::HingeAngleSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : OnChangeSensor(callback) {
+HingeAngleSensor::HingeAngleSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                                   SensorScheduler* scheduler)
+    : OnChangeSensor(callback, scheduler) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.name = "Hinge Angle Sensor";
     mSensorInfo.vendor = "Vendor String";
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensors-impl/SensorScheduler.h"
+
+#include "utils/SystemClock.h"
+
+#include <limits>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+
+SensorScheduler::SensorScheduler(ISensorsEventCallback* callback)
+    : mCallback(callback), mStopped(false) {
+    mThread = std::thread([this] { run(); });
+}
+
+SensorScheduler::~SensorScheduler() {
+    stop();
+}
+
+void SensorScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopped = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void SensorScheduler::scheduleLocked(Sensor* sensor, int64_t sampleTimeNs) {
+    // Earlier entries of the sensor are left in the heap and skipped when they come up
+    uint64_t generation = ++sensor->mScheduleGeneration;
+    if (sampleTimeNs == std::numeric_limits<int64_t>::max()) {
+        return;
+    }
+
+    bool isEarliest = mQueue.empty() || sampleTimeNs < mQueue.top().sampleTimeNs;
+    mQueue.push({sampleTimeNs, sensor, generation});
+    if (isEarliest) {
+        mCondition.notify_all();
+    }
+}
+
+void SensorScheduler::run() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mStopped) {
+        if (mQueue.empty()) {
+            mCondition.wait(lock);
+            continue;
+        }
+
+        int64_t now = ::android::elapsedRealtimeNano();
+        if (mQueue.top().sampleTimeNs > now) {
+            mCondition.wait_for(lock, std::chrono::nanoseconds(mQueue.top().sampleTimeNs - now));
+            continue;
+        }
+
+        // Collect the due sensors before sampling them, as sampling schedules them again
+        mDueSensors.clear();
+        while (!mQueue.empty() && mQueue.top().sampleTimeNs <= now) {
+            const Entry entry = mQueue.top();
+            mQueue.pop();
+            if (entry.generation == entry.sensor->mScheduleGeneration) {
+                mDueSensors.push_back(entry.sensor);
+            }
+        }
+
+        for (Sensor* sensor : mDueSensors) {
+            sensor->sampleLocked(now, sensor->isWakeUpSensor() ? &mWakeUpEvents : &mEvents);
+            scheduleLocked(sensor, sensor->getNextSampleTimeLocked());
+        }
+
+        if (mEvents.empty() && mWakeUpEvents.empty()) {
+            continue;
+        }
+
+        // The event buffers are only used by this thread, so they can be posted without holding
+        // the lock, which would otherwise block activate() and batch() behind the FMQ write
+        lock.unlock();
+        if (!mEvents.empty()) {
+            mCallback->postEvents(mEvents, false /* wakeup */);
+            mEvents.clear();
+        }
+        if (!mWakeUpEvents.empty()) {
+            mCallback->postEvents(mWakeUpEvents, true /* wakeup */);
+            mWakeUpEvents.clear();
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
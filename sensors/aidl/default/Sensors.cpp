@@ -14,9 +14,15 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_HAL
+
 #include "sensors-impl/Sensors.h"
 
 #include <aidl/android/hardware/common/fmq/SynchronizedReadWrite.h>
+#include <android-base/file.h>
+#include <utils/Trace.h>
+
+#include <sstream>
 
 using ::aidl::android::hardware::common::fmq::MQDescriptor;
 using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
@@ -52,13 +58,40 @@ ScopedAStatus Sensors::batch(int32_t in_sensorHandle, int64_t in_samplingPeriodN
     return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
 }
 
-ScopedAStatus Sensors::configDirectReport(int32_t /* in_sensorHandle */,
-                                          int32_t /* in_channelHandle */,
-                                          ISensors::RateLevel /* in_rate */,
-                                          int32_t* _aidl_return) {
-    *_aidl_return = EX_UNSUPPORTED_OPERATION;
+ScopedAStatus Sensors::configDirectReport(int32_t in_sensorHandle, int32_t in_channelHandle,
+                                          ISensors::RateLevel in_rate, int32_t* _aidl_return) {
+    *_aidl_return = -1;
+    if (!supportsDirectReport()) {
+        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    auto channel = mDirectChannels.find(in_channelHandle);
+    if (channel == mDirectChannels.end()) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    // A sensor handle of -1 stops all the reports of the channel
+    if (in_sensorHandle == -1) {
+        if (in_rate != ISensors::RateLevel::STOP) {
+            return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        for (const auto& sensor : mSensors) {
+            sensor.second->configDirectReport(in_channelHandle, nullptr, ISensors::RateLevel::STOP);
+        }
+        *_aidl_return = 0;
+        return ScopedAStatus::ok();
+    }
+
+    auto sensor = mSensors.find(in_sensorHandle);
+    if (sensor == mSensors.end() || !sensor->second->supportsDirectReport() ||
+        !sensor->second->supportsDirectReportRate(in_rate)) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
 
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    sensor->second->configDirectReport(in_channelHandle, channel->second, in_rate);
+    *_aidl_return = in_rate == ISensors::RateLevel::STOP ? 0 : in_sensorHandle;
+    return ScopedAStatus::ok();
 }
 
 ScopedAStatus Sensors::flush(int32_t in_sensorHandle) {
@@ -133,11 +166,27 @@ ScopedAStatus Sensors::injectSensorData(const Event& in_event) {
     return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(ERROR_BAD_VALUE));
 }
 
-ScopedAStatus Sensors::registerDirectChannel(const ISensors::SharedMemInfo& /* in_mem */,
+ScopedAStatus Sensors::registerDirectChannel(const ISensors::SharedMemInfo& in_mem,
                                              int32_t* _aidl_return) {
-    *_aidl_return = EX_UNSUPPORTED_OPERATION;
+    *_aidl_return = -1;
+    if (!supportsDirectReport()) {
+        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    if (!supportsDirectChannel(in_mem.type)) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    std::shared_ptr<DirectChannel> channel;
+    ScopedAStatus status = DirectChannel::create(in_mem, &channel);
+    if (!status.isOk()) {
+        return status;
+    }
 
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    int32_t channelHandle = mNextDirectChannelHandle++;
+    mDirectChannels[channelHandle] = channel;
+    *_aidl_return = channelHandle;
+    return ScopedAStatus::ok();
 }
 
 ScopedAStatus Sensors::setOperationMode(OperationMode in_mode) {
@@ -147,8 +196,63 @@ ScopedAStatus Sensors::setOperationMode(OperationMode in_mode) {
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus Sensors::unregisterDirectChannel(int32_t /* in_channelHandle */) {
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ScopedAStatus Sensors::unregisterDirectChannel(int32_t in_channelHandle) {
+    if (!supportsDirectReport()) {
+        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+
+    // Unregistering a channel that isn't registered is not an error. The memory is unmapped once
+    // the sensors have dropped their reports to the channel.
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    if (mDirectChannels.erase(in_channelHandle) > 0) {
+        for (const auto& sensor : mSensors) {
+            sensor.second->configDirectReport(in_channelHandle, nullptr, ISensors::RateLevel::STOP);
+        }
+    }
+    return ScopedAStatus::ok();
+}
+
+binder_status_t Sensors::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    std::ostringstream stream;
+    {
+        std::lock_guard<std::mutex> lock(mWriteLock);
+        stream << "Event latency from timestamp to Event FMQ write:" << std::endl;
+        for (const auto& [sensorType, histogram] : mEventWriteLatencies) {
+            stream << "  " << toString(sensorType) << ": ";
+            histogram.dump(stream);
+            stream << std::endl;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWakeLockLock);
+        stream << "WAKE_UP event latency from Event FMQ write to acknowledgment: ";
+        mAckLatencyTracker.getHistogram().dump(stream);
+        stream << std::endl;
+    }
+    return ::android::base::WriteStringToFd(stream.str(), fd) ? STATUS_OK : STATUS_UNKNOWN_ERROR;
+}
+
+void Sensors::postEvents(const std::vector<Event>& events, bool wakeup) {
+    ATRACE_NAME("Sensors::postEvents");
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    if (mEventQueue == nullptr) {
+        return;
+    }
+    if (mEventQueue->write(&events.front(), events.size())) {
+        mEventQueueFlag->wake(
+                static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
+
+        int64_t now = ::android::elapsedRealtimeNano();
+        for (const Event& event : events) {
+            mEventWriteLatencies[event.sensorType].record(now - event.timestamp);
+        }
+
+        if (wakeup) {
+            // Keep track of the number of outstanding WAKE_UP events in order to properly hold
+            // a wake lock until the framework has secured a wake lock
+            updateWakeLock(events.size(), 0 /* eventsHandled */);
+        }
+    }
 }
 
 }  // namespace sensors
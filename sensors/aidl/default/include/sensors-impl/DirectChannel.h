@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aidl/android/hardware/sensors/BnSensors.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+
+// A direct report channel backed by shared memory registered by the framework. Sensors configured
+// on the channel write their events straight into the memory, which is used as a ring of
+// DIRECT_REPORT_SENSOR_EVENT_TOTAL_LENGTH byte records.
+class DirectChannel {
+  public:
+    using Event = ::aidl::android::hardware::sensors::Event;
+    using SharedMemInfo = ::aidl::android::hardware::sensors::ISensors::SharedMemInfo;
+
+    // Maps the memory described by |mem| and zeroes it. Both ASHMEM and GRALLOC memory are mapped
+    // through the first file descriptor of the handle.
+    static ndk::ScopedAStatus create(const SharedMemInfo& mem,
+                                     std::shared_ptr<DirectChannel>* channel);
+
+    ~DirectChannel();
+
+    // Writes |events| to the next records of the ring, tagged with |reportToken|. The atomic
+    // counter of a record is written after the rest of the record, so that a reader that sees the
+    // new counter value also sees the new event.
+    void write(int32_t reportToken, const std::vector<Event>& events);
+
+  private:
+    DirectChannel(uint8_t* base, size_t size);
+
+    void writeEvent(int32_t reportToken, const Event& event);
+
+    uint8_t* const mBase;
+    const size_t mSize;
+
+    // Protects the write position and the counter, as sensors write from their own threads
+    std::mutex mWriteLock;
+    size_t mWriteOffset;
+    uint32_t mAtomicCounter;
+};
+
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
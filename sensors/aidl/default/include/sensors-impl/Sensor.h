@@ -14,15 +14,23 @@
  * limitations under the License.
  */
 
-#include <thread>
+#pragma once
+
+#include <limits>
+#include <map>
+#include <vector>
 
 #include <aidl/android/hardware/sensors/BnSensors.h>
 
+#include "DirectChannel.h"
+
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace sensors {
 
+class SensorScheduler;
+
 class ISensorsEventCallback {
   public:
     using Event = ::aidl::android::hardware::sensors::Event;
@@ -34,6 +42,9 @@ class ISensorsEventCallback {
 class Sensor {
   public:
     using OperationMode = ::aidl::android::hardware::sensors::ISensors::OperationMode;
+    using RateLevel = ::aidl::android::hardware::sensors::ISensors::RateLevel;
+    using SharedMemType =
+            ::aidl::android::hardware::sensors::ISensors::SharedMemInfo::SharedMemType;
     using Event = ::aidl::android::hardware::sensors::Event;
     using EventPayload = ::aidl::android::hardware::sensors::Event::EventPayload;
     using SensorInfo = ::aidl::android::hardware::sensors::SensorInfo;
@@ -41,7 +52,7 @@ class Sensor {
     using MetaDataEventType =
             ::aidl::android::hardware::sensors::Event::EventPayload::MetaData::MetaDataEventType;
 
-    Sensor(ISensorsEventCallback* callback);
+    Sensor(ISensorsEventCallback* callback, SensorScheduler* scheduler);
     virtual ~Sensor();
 
     const SensorInfo& getSensorInfo() const;
@@ -53,37 +64,65 @@ class Sensor {
     bool supportsDataInjection() const;
     ndk::ScopedAStatus injectEvent(const Event& event);
 
+    bool supportsDirectReport() const;
+    bool supportsDirectChannel(SharedMemType type) const;
+    bool supportsDirectReportRate(RateLevel rate) const;
+    // Starts reporting to |channel| at |rate|, or stops reporting to the channel registered as
+    // |channelHandle| if |rate| is STOP. Events written to the channel are tagged with the sensor
+    // handle as the report token.
+    void configDirectReport(int32_t channelHandle, const std::shared_ptr<DirectChannel>& channel,
+                            RateLevel rate);
+
   protected:
-    void run();
-    virtual std::vector<Event> readEvents();
+    struct DirectReport {
+        std::shared_ptr<DirectChannel> channel;
+        int64_t samplingPeriodNs;
+        int64_t lastSampleTimeNs;
+    };
+
+    friend class SensorScheduler;
+
+    // Samples the sensor if it is due at |now|, appending the events for the Event FMQ to
+    // |events| and writing the events of the due direct reports to their channels
+    void sampleLocked(int64_t now, std::vector<Event>* events);
+    // Returns the time at which the sensor is next due, or std::numeric_limits<int64_t>::max() if
+    // it is idle
+    int64_t getNextSampleTimeLocked() const;
+    void rescheduleLocked();
+
+    // Appends the current events of the sensor to |events|
+    virtual void readEvents(std::vector<Event>* events);
     virtual void readEventPayload(EventPayload&) = 0;
-    static void startThread(Sensor* sensor);
 
-    bool isWakeUpSensor();
+    bool isWakeUpSensor() const;
 
     bool mIsEnabled;
     int64_t mSamplingPeriodNs;
     int64_t mLastSampleTimeNs;
     SensorInfo mSensorInfo;
 
-    std::atomic_bool mStopThread;
-    std::condition_variable mWaitCV;
-    std::mutex mRunMutex;
-    std::thread mRunThread;
-
     ISensorsEventCallback* mCallback;
+    SensorScheduler* mScheduler;
 
     OperationMode mMode;
+
+    // Direct reports configured on this sensor, keyed by channel handle
+    std::map<int32_t, DirectReport> mDirectReports;
+
+    // Events of the current sample, reused across samples
+    std::vector<Event> mSampleEvents;
+    // Identifies the latest schedule of the sensor in the scheduler heap
+    uint64_t mScheduleGeneration;
 };
 
 class OnChangeSensor : public Sensor {
   public:
-    OnChangeSensor(ISensorsEventCallback* callback);
+    OnChangeSensor(ISensorsEventCallback* callback, SensorScheduler* scheduler);
 
     virtual void activate(bool enable) override;
 
   protected:
-    virtual std::vector<Event> readEvents() override;
+    virtual void readEvents(std::vector<Event>* events) override;
 
   protected:
     Event mPreviousEvent;
@@ -92,7 +131,7 @@ class OnChangeSensor : public Sensor {
 
 class AccelSensor : public Sensor {
   public:
-    AccelSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    AccelSensor(int32_t sensorHandle, ISensorsEventCallback* callback, SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -100,7 +139,7 @@ class AccelSensor : public Sensor {
 
 class GyroSensor : public Sensor {
   public:
-    GyroSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    GyroSensor(int32_t sensorHandle, ISensorsEventCallback* callback, SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -108,7 +147,8 @@ class GyroSensor : public Sensor {
 
 class AmbientTempSensor : public OnChangeSensor {
   public:
-    AmbientTempSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    AmbientTempSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                      SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -116,7 +156,8 @@ class AmbientTempSensor : public OnChangeSensor {
 
 class PressureSensor : public Sensor {
   public:
-    PressureSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    PressureSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                   SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -124,7 +165,8 @@ class PressureSensor : public Sensor {
 
 class MagnetometerSensor : public Sensor {
   public:
-    MagnetometerSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    MagnetometerSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                       SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -132,7 +174,7 @@ class MagnetometerSensor : public Sensor {
 
 class LightSensor : public OnChangeSensor {
   public:
-    LightSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    LightSensor(int32_t sensorHandle, ISensorsEventCallback* callback, SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -140,7 +182,8 @@ class LightSensor : public OnChangeSensor {
 
 class ProximitySensor : public OnChangeSensor {
   public:
-    ProximitySensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    ProximitySensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                    SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -148,7 +191,8 @@ class ProximitySensor : public OnChangeSensor {
 
 class RelativeHumiditySensor : public OnChangeSensor {
   public:
-    RelativeHumiditySensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    RelativeHumiditySensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                           SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -156,7 +200,8 @@ class RelativeHumiditySensor : public OnChangeSensor {
 
 class HingeAngleSensor : public OnChangeSensor {
   public:
-    HingeAngleSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    HingeAngleSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                     SensorScheduler* scheduler);
 
   protected:
     virtual void readEventPayload(EventPayload& payload) override;
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "Sensor.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+
+// Samples all the sensors of the HAL from a single thread. Sensors are kept in a heap ordered by
+// their next sample time. The sensors that are due in the same tick are sampled together and
+// their events are posted with a single call per wake-up kind.
+class SensorScheduler {
+  public:
+    using Event = ::aidl::android::hardware::sensors::Event;
+
+    explicit SensorScheduler(ISensorsEventCallback* callback);
+    ~SensorScheduler();
+
+    // Stops the sampling thread. No events are posted once this returns.
+    void stop();
+
+    // Guards the sampling state of all the sensors of the scheduler
+    std::mutex& getLock() { return mLock; }
+
+    // Schedules |sensor| to be sampled at |sampleTimeNs|, replacing any earlier schedule of the
+    // sensor. A time of std::numeric_limits<int64_t>::max() unschedules it. Must be called with
+    // getLock() held.
+    void scheduleLocked(Sensor* sensor, int64_t sampleTimeNs);
+
+  private:
+    struct Entry {
+        int64_t sampleTimeNs;
+        Sensor* sensor;
+        uint64_t generation;
+
+        bool operator>(const Entry& other) const { return sampleTimeNs > other.sampleTimeNs; }
+    };
+
+    void run();
+
+    ISensorsEventCallback* const mCallback;
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    bool mStopped;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> mQueue;
+
+    // Only used by the sampling thread, and reused across ticks
+    std::vector<Sensor*> mDueSensors;
+    std::vector<Event> mEvents;
+    std::vector<Event> mWakeUpEvents;
+
+    std::thread mThread;
+};
+
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -20,8 +20,12 @@
 #include <aidl/android/hardware/sensors/BnSensors.h>
 #include <fmq/AidlMessageQueue.h>
 #include <hardware_legacy/power.h>
+#include <utils/SystemClock.h>
 #include <map>
+#include "DirectChannel.h"
+#include "SensorLatencyHistogram.h"
 #include "Sensor.h"
+#include "SensorScheduler.h"
 
 namespace aidl {
 namespace android {
@@ -44,7 +48,9 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
           mOutstandingWakeUpEvents(0),
           mReadWakeLockQueueRun(false),
           mAutoReleaseWakeLockTime(0),
-          mHasWakeLock(false) {
+          mHasWakeLock(false),
+          mNextDirectChannelHandle(1),
+          mScheduler(this /* callback */) {
         AddSensor<AccelSensor>();
         AddSensor<GyroSensor>();
         AddSensor<AmbientTempSensor>();
@@ -57,6 +63,8 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
     }
 
     virtual ~Sensors() {
+        // Stop sampling before the Event FMQ and its flag go away
+        mScheduler.stop();
         deleteEventFlag();
         mReadWakeLockQueueRun = false;
         mWakeLockThread.join();
@@ -91,32 +99,40 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
             ::aidl::android::hardware::sensors::ISensors::OperationMode in_mode) override;
     ::ndk::ScopedAStatus unregisterDirectChannel(int32_t in_channelHandle) override;
 
-    void postEvents(const std::vector<Event>& events, bool wakeup) override {
-        std::lock_guard<std::mutex> lock(mWriteLock);
-        if (mEventQueue == nullptr) {
-            return;
-        }
-        if (mEventQueue->write(&events.front(), events.size())) {
-            mEventQueueFlag->wake(
-                    static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
-
-            if (wakeup) {
-                // Keep track of the number of outstanding WAKE_UP events in order to properly hold
-                // a wake lock until the framework has secured a wake lock
-                updateWakeLock(events.size(), 0 /* eventsHandled */);
-            }
-        }
-    }
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
+    void postEvents(const std::vector<Event>& events, bool wakeup) override;
 
   protected:
     // Add a new sensor
     template <class SensorType>
     void AddSensor() {
         std::shared_ptr<SensorType> sensor =
-                std::make_shared<SensorType>(mNextHandle++ /* sensorHandle */, this /* callback */);
+                std::make_shared<SensorType>(mNextHandle++ /* sensorHandle */, this /* callback */,
+                                             &mScheduler);
         mSensors[sensor->getSensorInfo().sensorHandle] = sensor;
     }
 
+    // Returns true if any sensor reports to direct channels
+    bool supportsDirectReport() const {
+        for (const auto& sensor : mSensors) {
+            if (sensor.second->supportsDirectReport()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true if any sensor reports to direct channels of |type|
+    bool supportsDirectChannel(ISensors::SharedMemInfo::SharedMemType type) const {
+        for (const auto& sensor : mSensors) {
+            if (sensor.second->supportsDirectChannel(type)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     // Utility function to delete the Event Flag
     void deleteEventFlag() {
         if (mEventQueueFlag != nullptr) {
@@ -149,6 +165,14 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
      */
     void updateWakeLock(int32_t eventsWritten, int32_t eventsHandled) {
         std::lock_guard<std::mutex> lock(mWakeLockLock);
+        int64_t now = ::android::elapsedRealtimeNano();
+        if (eventsWritten > 0) {
+            mAckLatencyTracker.onWakeupEventsWritten(now, eventsWritten);
+        }
+        if (eventsHandled > 0) {
+            mAckLatencyTracker.onWakeupEventsHandled(now, eventsHandled);
+        }
+
         int32_t newVal = mOutstandingWakeUpEvents + eventsWritten - eventsHandled;
         if (newVal < 0) {
             mOutstandingWakeUpEvents = 0;
@@ -173,6 +197,7 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
                 ALOGD("No events read from wake lock FMQ for %d seconds, auto releasing wake lock",
                       WAKE_LOCK_TIMEOUT_SECONDS);
                 mOutstandingWakeUpEvents = 0;
+                mAckLatencyTracker.clearPendingWrites();
             }
 
             if (mOutstandingWakeUpEvents == 0 && release_wake_lock(kWakeLockName) == 0) {
@@ -198,8 +223,15 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
     std::mutex mWriteLock;
     // Lock to protect acquiring and releasing the wake lock
     std::mutex mWakeLockLock;
+    // Latency from the event timestamp to the Event FMQ write, per sensor type. Protected by
+    // mWriteLock.
+    std::map<SensorType, ::android::hardware::sensors::common::SensorLatencyHistogram>
+            mEventWriteLatencies;
     // Track the number of WAKE_UP events that have not been handled by the framework
     uint32_t mOutstandingWakeUpEvents;
+    // Latency from the Event FMQ write of WAKE_UP events to their acknowledgment through the Wake
+    // Lock FMQ. Protected by mWakeLockLock.
+    ::android::hardware::sensors::common::SensorAckLatencyTracker mAckLatencyTracker;
     // A thread to read the Wake Lock FMQ
     std::thread mWakeLockThread;
     // Flag to indicate that the Wake Lock Thread should continue to run
@@ -208,6 +240,15 @@ class Sensors : public BnSensors, public ISensorsEventCallback {
     int64_t mAutoReleaseWakeLockTime;
     // Flag to indicate if a wake lock has been acquired
     bool mHasWakeLock;
+    // Lock to protect the direct channels and the next direct channel handle
+    std::mutex mDirectChannelLock;
+    // The registered direct channels, keyed by channel handle
+    std::map<int32_t, std::shared_ptr<DirectChannel>> mDirectChannels;
+    // The next available direct channel handle
+    int32_t mNextDirectChannelHandle;
+    // Samples all the sensors from a single thread. Declared last so that it is destroyed, and its
+    // thread stopped, before the sensors it samples.
+    SensorScheduler mScheduler;
 };
 
 }  // namespace sensors
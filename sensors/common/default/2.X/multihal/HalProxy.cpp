@@ -14,19 +14,25 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_HAL
+
 #include "HalProxy.h"
 
 #include <android/hardware/sensors/2.0/types.h>
 
 #include <android-base/file.h>
+#include <utils/SystemClock.h>
+#include <utils/Trace.h>
 #include "hardware_legacy/power.h"
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <thread>
 
 namespace android {
@@ -46,6 +52,31 @@ typedef V2_1::implementation::ISensorsSubHal*(SensorsHalGetSubHalV2_1Func)(uint3
 
 static constexpr int32_t kBitsAfterSubHalIndex = 24;
 
+static constexpr int32_t kBitsAfterWakelockGeneration = 32;
+static constexpr uint64_t kWakelockRefCountMask = (uint64_t{1} << kBitsAfterWakelockGeneration) - 1;
+
+/**
+ * Extract the refcount from the packed wakelock state.
+ *
+ * @param state The wakelock state to extract from.
+ *
+ * @return The wakelock refcount.
+ */
+size_t extractWakelockRefCount(uint64_t state) {
+    return static_cast<size_t>(state & kWakelockRefCountMask);
+}
+
+/**
+ * Extract the generation from the packed wakelock state.
+ *
+ * @param state The wakelock state to extract from.
+ *
+ * @return The wakelock generation, odd while a reset is in progress.
+ */
+uint64_t extractWakelockGeneration(uint64_t state) {
+    return state >> kBitsAfterWakelockGeneration;
+}
+
 /**
  * Set the subhal index as first byte of sensor handle and return this modified version.
  *
@@ -84,9 +115,11 @@ int64_t msFromNs(int64_t nanos) {
 HalProxy::HalProxy() {
     static const std::string kMultiHalConfigFiles[] = {"/vendor/etc/sensors/hals.conf",
                                                        "/odm/etc/sensors/hals.conf"};
+    std::vector<std::string> subHalLibraryFiles;
     for (const std::string& configFile : kMultiHalConfigFiles) {
-        initializeSubHalListFromConfigFile(configFile.c_str());
+        readSubHalLibraryFiles(configFile.c_str(), &subHalLibraryFiles);
     }
+    initializeSubHalList(subHalLibraryFiles);
     init();
 }
 
@@ -223,8 +256,9 @@ Return<Result> HalProxy::initializeCommon(
     // again we do not get new events until after initialize resets the subhals.
     disableAllSensors();
 
-    // Clears the queue if any events were pending write before.
-    mPendingWriteEventsQueue = std::queue<std::pair<std::vector<V2_1::Event>, size_t>>();
+    // Clears the queue if any events were pending write before. Its storage is kept for reuse.
+    mPendingWriteEventsHead = 0;
+    mPendingWriteEventsCount = 0;
     mSizePendingWriteEventsQueue = 0;
 
     // Clears previously connected dynamic sensors
@@ -341,6 +375,13 @@ Return<void> HalProxy::configDirectReport(int32_t sensorHandle, int32_t channelH
         _hidl_cb(Result::INVALID_OPERATION, -1 /* reportToken */);
     } else if (sensorHandle == -1 && rate != RateLevel::STOP) {
         _hidl_cb(Result::BAD_VALUE, -1 /* reportToken */);
+    } else if (sensorHandle != -1 &&
+               (!isSubHalIndexValid(sensorHandle) ||
+                getSubHalForSensorHandle(sensorHandle) != mDirectChannelSubHal)) {
+        // Only the sensors of the direct channel subhal report to its channels. Forwarding the
+        // handle of another subhal's sensor would configure an unrelated sensor once the subhal
+        // index is cleared.
+        _hidl_cb(Result::BAD_VALUE, -1 /* reportToken */);
     } else {
         // -1 denotes all sensors should be disabled
         if (sensorHandle != -1) {
@@ -364,19 +405,37 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
     stream << "Internal values:" << std::endl;
     stream << "  Threads are running: " << (mThreadsRun.load() ? "true" : "false") << std::endl;
     int64_t now = getTimeNow();
-    stream << "  Wakelock timeout start time: " << msFromNs(now - mWakelockTimeoutStartTime)
-           << " ms ago" << std::endl;
-    stream << "  Wakelock timeout reset time: " << msFromNs(now - mWakelockTimeoutResetTime)
-           << " ms ago" << std::endl;
+    stream << "  Wakelock timeout start time: "
+           << msFromNs(now - mWakelockTimeoutStartTime.load()) << " ms ago" << std::endl;
+    stream << "  Wakelock timeout reset time: "
+           << msFromNs(now - mWakelockTimeoutResetTime.load()) << " ms ago" << std::endl;
     // TODO(b/142969448): Add logging for history of wakelock acquisition per subhal.
-    stream << "  Wakelock ref count: " << mWakelockRefCount << std::endl;
+    stream << "  Wakelock ref count: " << extractWakelockRefCount(mWakelockState.load())
+           << std::endl;
     stream << "  # of events on pending write writes queue: " << mSizePendingWriteEventsQueue
            << std::endl;
     stream << " Most events seen on pending write events queue: "
            << mMostEventsObservedPendingWriteEventsQueue << std::endl;
-    if (!mPendingWriteEventsQueue.empty()) {
-        stream << "  Size of events list on front of pending writes queue: "
-               << mPendingWriteEventsQueue.front().first.size() << std::endl;
+    stream << "  Capacity of pending write events queue: " << mPendingWriteEvents.size()
+           << std::endl;
+    stream << "  # of events deferred to pending write events queue: " << mNumDeferredEvents
+           << std::endl;
+    stream << "  # of events dropped with pending write events queue full: " << mNumDroppedEvents
+           << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        stream << "  Event latency from timestamp to event fmq write:" << std::endl;
+        for (const auto& [key, histogram] : mEventWriteLatencies) {
+            stream << "    SubHal " << key.first << " " << V2_1::toString(key.second) << ": ";
+            histogram.dump(stream);
+            stream << std::endl;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mAckLatencyMutex);
+        stream << "  Wakeup event latency from event fmq write to acknowledgment: ";
+        mAckLatencyTracker.getHistogram().dump(stream);
+        stream << std::endl;
     }
     stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
     stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
@@ -435,74 +494,101 @@ Return<void> HalProxy::onDynamicSensorsDisconnected(
     return Return<void>();
 }
 
-void HalProxy::initializeSubHalListFromConfigFile(const char* configFileName) {
+void HalProxy::readSubHalLibraryFiles(const char* configFileName,
+                                      std::vector<std::string>* subHalLibraryFiles) {
     std::ifstream subHalConfigStream(configFileName);
     if (!subHalConfigStream) {
         ALOGE("Failed to load subHal config file: %s", configFileName);
-    } else {
-        std::string subHalLibraryFile;
-        while (subHalConfigStream >> subHalLibraryFile) {
-            void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
-            if (handle == nullptr) {
-                ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
-            } else {
-                SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
-                        (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
-                if (sensorsHalGetSubHalPtr != nullptr) {
-                    std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal =
-                            *sensorsHalGetSubHalPtr;
-                    uint32_t version;
-                    ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
-                    if (version != SUB_HAL_2_0_VERSION) {
-                        ALOGE("SubHal version was not 2.0 for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                        mSubHalList.push_back(std::make_unique<SubHalWrapperV2_0>(subHal));
-                    }
-                } else {
-                    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
-                            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
-
-                    if (getSubHalV2_1Ptr == nullptr) {
-                        ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 =
-                                *getSubHalV2_1Ptr;
-                        uint32_t version;
-                        ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
-                        if (version != SUB_HAL_2_1_VERSION) {
-                            ALOGE("SubHal version was not 2.1 for library: %s",
-                                  subHalLibraryFile.c_str());
-                        } else {
-                            ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                            mSubHalList.push_back(std::make_unique<SubHalWrapperV2_1>(subHal));
-                        }
-                    }
-                }
-            }
+        return;
+    }
+    std::string subHalLibraryFile;
+    while (subHalConfigStream >> subHalLibraryFile) {
+        subHalLibraryFiles->push_back(subHalLibraryFile);
+    }
+}
+
+void HalProxy::initializeSubHalList(const std::vector<std::string>& subHalLibraryFiles) {
+    // Load the subhals concurrently so that a slow one doesn't hold up the others, but add them
+    // in the order of the config files so that subhal indices don't depend on load times.
+    std::vector<std::future<std::shared_ptr<ISubHalWrapperBase>>> subHals;
+    for (const std::string& subHalLibraryFile : subHalLibraryFiles) {
+        subHals.push_back(std::async(std::launch::async, [this, &subHalLibraryFile] {
+            return loadSubHal(subHalLibraryFile);
+        }));
+    }
+    for (auto& subHal : subHals) {
+        std::shared_ptr<ISubHalWrapperBase> wrapper = subHal.get();
+        if (wrapper != nullptr) {
+            mSubHalList.push_back(std::move(wrapper));
+        }
+    }
+}
+
+std::shared_ptr<ISubHalWrapperBase> HalProxy::loadSubHal(const std::string& subHalLibraryFile) {
+    void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
+    if (handle == nullptr) {
+        ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
+        return nullptr;
+    }
+
+    SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
+            (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
+    if (sensorsHalGetSubHalPtr != nullptr) {
+        std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal = *sensorsHalGetSubHalPtr;
+        uint32_t version;
+        ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
+        if (version != SUB_HAL_2_0_VERSION) {
+            ALOGE("SubHal version was not 2.0 for library: %s", subHalLibraryFile.c_str());
+            return nullptr;
         }
+        ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+        return std::make_shared<SubHalWrapperV2_0>(subHal);
+    }
+
+    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
+            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
+    if (getSubHalV2_1Ptr == nullptr) {
+        ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
+              subHalLibraryFile.c_str());
+        return nullptr;
     }
+    std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 = *getSubHalV2_1Ptr;
+    uint32_t version;
+    ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
+    if (version != SUB_HAL_2_1_VERSION) {
+        ALOGE("SubHal version was not 2.1 for library: %s", subHalLibraryFile.c_str());
+        return nullptr;
+    }
+    ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+    return std::make_shared<SubHalWrapperV2_1>(subHal);
 }
 
 void HalProxy::initializeSensorList() {
+    // Query the subhals concurrently, then merge their sensors in subhal order so that the
+    // handles and the subhal picked for direct channels are the same on every start.
+    std::vector<std::future<std::vector<SensorInfo>>> sensorLists;
+    for (const std::shared_ptr<ISubHalWrapperBase>& subHal : mSubHalList) {
+        sensorLists.push_back(std::async(std::launch::async, [subHal] {
+            std::vector<SensorInfo> sensors;
+            auto result = subHal->getSensorsList(
+                    [&](const auto& list) { sensors.assign(list.begin(), list.end()); });
+            if (!result.isOk()) {
+                ALOGE("getSensorsList call failed for SubHal: %s", subHal->getName().c_str());
+            }
+            return sensors;
+        }));
+    }
+
     for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
-        auto result = mSubHalList[subHalIndex]->getSensorsList([&](const auto& list) {
-            for (SensorInfo sensor : list) {
-                if (!subHalIndexIsClear(sensor.sensorHandle)) {
-                    ALOGE("SubHal sensorHandle's first byte was not 0");
-                } else {
-                    ALOGV("Loaded sensor: %s", sensor.name.c_str());
-                    sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
-                    setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
-                    mSensors[sensor.sensorHandle] = sensor;
-                }
+        for (SensorInfo sensor : sensorLists[subHalIndex].get()) {
+            if (!subHalIndexIsClear(sensor.sensorHandle)) {
+                ALOGE("SubHal sensorHandle's first byte was not 0");
+            } else {
+                ALOGV("Loaded sensor: %s", sensor.name.c_str());
+                sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
+                setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
+                mSensors[sensor.sensorHandle] = sensor;
             }
-        });
-        if (!result.isOk()) {
-            ALOGE("getSensorsList call failed for SubHal: %s",
-                  mSubHalList[subHalIndex]->getName().c_str());
         }
     }
 }
@@ -570,43 +656,47 @@ void HalProxy::startPendingWritesThread(HalProxy* halProxy) {
 }
 
 void HalProxy::handlePendingWrites() {
-    // TODO(b/143302327): Find a way to optimize locking strategy maybe using two mutexes instead of
-    // one.
     std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
     while (mThreadsRun.load()) {
         mEventQueueWriteCV.wait(
-                lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
+                lock, [&] { return mPendingWriteEventsCount > 0 || !mThreadsRun.load(); });
         if (mThreadsRun.load()) {
-            std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-            size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-            size_t eventQueueSize = mEventQueue->getQuantumCount();
-            size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
+            // Take up to a full event queue of events out of the ring, so that the ring can keep
+            // taking events and grow while they are written. They still count as pending, so that
+            // posting threads queue behind them instead of writing to the fmq out of order.
+            size_t numToWrite = std::min(mPendingWriteEventsCount, mEventQueue->getQuantumCount());
+            mPendingWriteBatch.resize(numToWrite);
+            for (size_t i = 0; i < numToWrite; i++) {
+                mPendingWriteBatch[i] = mPendingWriteEvents[mPendingWriteEventsHead];
+                mPendingWriteEventsHead =
+                        (mPendingWriteEventsHead + 1) % mPendingWriteEvents.size();
+            }
+            mPendingWriteEventsCount -= numToWrite;
+
             lock.unlock();
-            if (!mEventQueue->writeBlocking(
-                        pendingWriteEvents.data(), numToWrite,
+            bool written;
+            {
+                ATRACE_NAME("HalProxy::writePendingEvents");
+                written = mEventQueue->writeBlocking(
+                        mPendingWriteBatch.data(), numToWrite,
                         static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
                         static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
-                        kPendingWriteTimeoutNs, mEventQueueFlag)) {
+                        kPendingWriteTimeoutNs, mEventQueueFlag);
+            }
+            if (!written) {
                 ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
+                size_t numWakeupEvents =
+                        countNumWakeupEvents(mPendingWriteBatch.data(), numToWrite);
                 if (numWakeupEvents > 0) {
-                    if (pendingWriteEvents.size() > eventQueueSize) {
-                        decrementRefCountAndMaybeReleaseWakelock(
-                                countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-                    } else {
-                        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-                    }
+                    decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
                 }
             }
             lock.lock();
-            mSizePendingWriteEventsQueue -= numToWrite;
-            if (pendingWriteEvents.size() > eventQueueSize) {
-                // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-                // all the events ahead of it down to fill gap off array at front after the erase.
-                pendingWriteEvents.erase(pendingWriteEvents.begin(),
-                                         pendingWriteEvents.begin() + eventQueueSize);
-            } else {
-                mPendingWriteEventsQueue.pop();
+            if (written) {
+                recordEventsWrittenLocked(mPendingWriteBatch.data(), numToWrite);
             }
+            mSizePendingWriteEventsQueue -= numToWrite;
+            ATRACE_INT("SensorsHalPendingWriteEvents", mSizePendingWriteEventsQueue);
         }
     }
 }
@@ -618,7 +708,9 @@ void HalProxy::startWakelockThread(HalProxy* halProxy) {
 void HalProxy::handleWakelocks() {
     std::unique_lock<std::recursive_mutex> lock(mWakelockMutex);
     while (mThreadsRun.load()) {
-        mWakelockCV.wait(lock, [&] { return mWakelockRefCount > 0 || !mThreadsRun.load(); });
+        mWakelockCV.wait(lock, [&] {
+            return extractWakelockRefCount(mWakelockState.load()) > 0 || !mThreadsRun.load();
+        });
         if (mThreadsRun.load()) {
             int64_t timeLeft;
             if (sharedWakelockDidTimeout(&timeLeft)) {
@@ -631,6 +723,11 @@ void HalProxy::handleWakelocks() {
                         static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), timeLeft);
                 lock.lock();
                 if (success) {
+                    {
+                        std::lock_guard<std::mutex> ackLock(mAckLatencyMutex);
+                        mAckLatencyTracker.onWakeupEventsHandled(
+                                ::android::elapsedRealtimeNano(), numWakeLocksProcessed);
+                    }
                     decrementRefCountAndMaybeReleaseWakelock(
                             static_cast<size_t>(numWakeLocksProcessed));
                 }
@@ -642,7 +739,7 @@ void HalProxy::handleWakelocks() {
 
 bool HalProxy::sharedWakelockDidTimeout(int64_t* timeLeft) {
     bool didTimeout;
-    int64_t duration = getTimeNow() - mWakelockTimeoutStartTime;
+    int64_t duration = getTimeNow() - mWakelockTimeoutStartTime.load();
     if (duration > kWakelockTimeoutNs) {
         didTimeout = true;
     } else {
@@ -654,53 +751,150 @@ bool HalProxy::sharedWakelockDidTimeout(int64_t* timeLeft) {
 
 void HalProxy::resetSharedWakelock() {
     std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    decrementRefCountAndMaybeReleaseWakelock(mWakelockRefCount);
+    // The generation only changes under mWakelockMutex. Moving it to an odd value keeps the
+    // lock-free paths away from the state until the new reset time is published, and the reset
+    // time is only taken once the refcount is cleared so that any reference cleared here was
+    // taken earlier than it.
+    uint64_t generation = extractWakelockGeneration(mWakelockState.load());
+    uint64_t state = mWakelockState.exchange((generation + 1) << kBitsAfterWakelockGeneration);
+    if (extractWakelockRefCount(state) > 0) {
+        release_wake_lock(kWakelockName);
+    }
     mWakelockTimeoutResetTime = getTimeNow();
+    {
+        // The acknowledgments of the events written so far would no longer match them
+        std::lock_guard<std::mutex> ackLock(mAckLatencyMutex);
+        mAckLatencyTracker.clearPendingWrites();
+    }
+    mWakelockState.store((generation + 2) << kBitsAfterWakelockGeneration);
 }
 
 void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
                                         V2_0::implementation::ScopedWakelock wakelock) {
-    size_t numToWrite = 0;
-    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    // The wakelock is accounted for before taking mEventQueueWriteMutex, so that acquiring it
+    // doesn't hold back the events of other sub-HALs
     if (wakelock.isLocked()) {
         incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
     }
-    if (mPendingWriteEventsQueue.empty()) {
-        numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
+    size_t numDroppedWakeupEvents = writeOrDeferEvents(events, wakelock.isLocked());
+    if (numDroppedWakeupEvents > 0) {
+        decrementRefCountAndMaybeReleaseWakelock(numDroppedWakeupEvents);
+    }
+}
+
+size_t HalProxy::writeOrDeferEvents(const std::vector<Event>& events, bool countWakeupEvents) {
+    size_t numToWrite = 0;
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    // Events already waiting for the background thread must reach the fmq first.
+    if (mSizePendingWriteEventsQueue == 0) {
+        numToWrite = writeToEventQueueLocked(events.data(), events.size());
         if (numToWrite > 0) {
-            if (mEventQueue->write(events.data(), numToWrite)) {
-                // TODO(b/143302327): While loop if mEventQueue->avaiableToWrite > 0 to possibly fit
-                // in more writes immediately
-                mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
-            } else {
-                numToWrite = 0;
-            }
+            mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
         }
     }
     size_t numLeft = events.size() - numToWrite;
-    if (numToWrite < events.size() &&
-        mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-        std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-        mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
+    if (numLeft == 0) {
+        return 0;
+    }
+    if (mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
+        pushPendingWriteEventsLocked(events.data() + numToWrite, numLeft);
         mSizePendingWriteEventsQueue += numLeft;
+        mNumDeferredEvents += numLeft;
         mMostEventsObservedPendingWriteEventsQueue =
                 std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
+        ATRACE_INT("SensorsHalPendingWriteEvents", mSizePendingWriteEventsQueue);
         mEventQueueWriteCV.notify_one();
+        return 0;
+    }
+    ALOGE("Dropping %zu events with the pending write events queue full.", numLeft);
+    mNumDroppedEvents += numLeft;
+    return countWakeupEvents ? countNumWakeupEvents(events.data() + numToWrite, numLeft) : 0;
+}
+
+size_t HalProxy::writeToEventQueueLocked(const Event* events, size_t numEvents) {
+    ATRACE_NAME("HalProxy::writeEvents");
+    size_t numWritten = 0;
+    while (numWritten < numEvents) {
+        size_t numToWrite = std::min(numEvents - numWritten, mEventQueue->availableToWrite());
+        if (numToWrite == 0 || !mEventQueue->write(events + numWritten, numToWrite)) {
+            break;
+        }
+        numWritten += numToWrite;
+    }
+    recordEventsWrittenLocked(events, numWritten);
+    return numWritten;
+}
+
+void HalProxy::recordEventsWrittenLocked(const Event* events, size_t numEvents) {
+    if (numEvents == 0) {
+        return;
+    }
+    int64_t now = ::android::elapsedRealtimeNano();
+    size_t numWakeupEvents = 0;
+    for (size_t i = 0; i < numEvents; i++) {
+        const Event& event = events[i];
+        auto key = std::make_pair(extractSubHalIndex(event.sensorHandle), event.sensorType);
+        mEventWriteLatencies[key].record(now - event.timestamp);
+        auto sensor = mSensors.find(event.sensorHandle);
+        if (sensor != mSensors.end() &&
+            (sensor->second.flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP))) {
+            numWakeupEvents++;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mAckLatencyMutex);
+    mAckLatencyTracker.onWakeupEventsWritten(now, numWakeupEvents);
+}
+
+void HalProxy::pushPendingWriteEventsLocked(const Event* events, size_t numEvents) {
+    size_t capacity = mPendingWriteEvents.size();
+    if (mPendingWriteEventsCount + numEvents > capacity) {
+        // Grow geometrically, unwrapping the pending events to the front of the new storage.
+        constexpr size_t kMinCapacity = 64;
+        size_t newCapacity =
+                std::max({kMinCapacity, capacity * 2, mPendingWriteEventsCount + numEvents});
+        newCapacity = std::min(newCapacity, kMaxSizePendingWriteEventsQueue);
+        std::vector<Event> newEvents(newCapacity);
+        for (size_t i = 0; i < mPendingWriteEventsCount; i++) {
+            newEvents[i] = std::move(mPendingWriteEvents[(mPendingWriteEventsHead + i) % capacity]);
+        }
+        mPendingWriteEvents = std::move(newEvents);
+        mPendingWriteEventsHead = 0;
+        capacity = newCapacity;
+    }
+    size_t tail = (mPendingWriteEventsHead + mPendingWriteEventsCount) % capacity;
+    for (size_t i = 0; i < numEvents; i++) {
+        mPendingWriteEvents[tail] = events[i];
+        tail = (tail + 1) % capacity;
     }
+    mPendingWriteEventsCount += numEvents;
 }
 
 bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
                                                         int64_t* timeoutStart /* = nullptr */) {
     if (!mThreadsRun.load()) return false;
+    // While the wakelock is held, a reference can be taken without mWakelockMutex. The time is
+    // read first so that a reset clearing the reference afterwards has a later reset time.
+    int64_t now = getTimeNow();
+    uint64_t state = mWakelockState.load();
+    while (extractWakelockRefCount(state) > 0 && extractWakelockGeneration(state) % 2 == 0) {
+        if (mWakelockState.compare_exchange_weak(state, state + delta)) {
+            mWakelockTimeoutStartTime = now;
+            if (timeoutStart != nullptr) {
+                *timeoutStart = now;
+            }
+            return true;
+        }
+    }
+
     std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (mWakelockRefCount == 0) {
+    now = getTimeNow();
+    if (extractWakelockRefCount(mWakelockState.fetch_add(delta)) == 0) {
         acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakelockName);
         mWakelockCV.notify_one();
     }
-    mWakelockTimeoutStartTime = getTimeNow();
-    mWakelockRefCount += delta;
+    mWakelockTimeoutStartTime = now;
     if (timeoutStart != nullptr) {
-        *timeoutStart = mWakelockTimeoutStartTime;
+        *timeoutStart = now;
     }
     return true;
 }
@@ -708,15 +902,33 @@ bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
 void HalProxy::decrementRefCountAndMaybeReleaseWakelock(size_t delta,
                                                         int64_t timeoutStart /* = -1 */) {
     if (!mThreadsRun.load()) return;
+    // References can be dropped without mWakelockMutex as long as some remain afterwards. The
+    // reset time is read after the state, so that a reset that completed in between is seen, and
+    // one that starts in between makes the exchange fail.
+    uint64_t state = mWakelockState.load();
+    while (extractWakelockRefCount(state) > delta && extractWakelockGeneration(state) % 2 == 0) {
+        if (timeoutStart != -1 && timeoutStart < mWakelockTimeoutResetTime.load()) return;
+        if (mWakelockState.compare_exchange_weak(state, state - delta)) return;
+    }
+
     std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (delta > mWakelockRefCount) {
-        ALOGE("Decrementing wakelock ref count by %zu when count is %zu",
-              delta, mWakelockRefCount);
-    }
-    if (timeoutStart == -1) timeoutStart = mWakelockTimeoutResetTime;
-    if (mWakelockRefCount == 0 || timeoutStart < mWakelockTimeoutResetTime) return;
-    mWakelockRefCount -= std::min(mWakelockRefCount, delta);
-    if (mWakelockRefCount == 0) {
+    state = mWakelockState.load();
+    if (delta > extractWakelockRefCount(state)) {
+        ALOGE("Decrementing wakelock ref count by %zu when count is %zu", delta,
+              extractWakelockRefCount(state));
+    }
+    if (timeoutStart == -1) timeoutStart = mWakelockTimeoutResetTime.load();
+    if (timeoutStart < mWakelockTimeoutResetTime.load()) return;
+    // References may still be taken and dropped concurrently by the lock-free paths, but the
+    // refcount can only reach zero under mWakelockMutex
+    size_t refCount;
+    size_t numToRelease;
+    do {
+        refCount = extractWakelockRefCount(state);
+        if (refCount == 0) return;
+        numToRelease = std::min(refCount, delta);
+    } while (!mWakelockState.compare_exchange_weak(state, state - numToRelease));
+    if (refCount == numToRelease) {
         release_wake_lock(kWakelockName);
     }
 }
@@ -744,7 +956,7 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
     return extractSubHalIndex(sensorHandle) < mSubHalList.size();
 }
 
-size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
+size_t HalProxy::countNumWakeupEvents(const Event* events, size_t n) {
     size_t numWakeupEvents = 0;
     for (size_t i = 0; i < n; i++) {
         int32_t sensorHandle = events[i].sensorHandle;
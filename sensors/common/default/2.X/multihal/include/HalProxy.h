@@ -19,6 +19,7 @@
 #include "EventMessageQueueWrapper.h"
 #include "HalProxyCallback.h"
 #include "ISensorsCallbackWrapper.h"
+#include "SensorLatencyHistogram.h"
 #include "SubHalWrapper.h"
 #include "V2_0/ScopedWakelock.h"
 #include "V2_0/SubHal.h"
@@ -37,7 +38,7 @@
 #include <condition_variable>
 #include <map>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
 #include <utility>
 
@@ -61,6 +62,7 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     using RateLevel = ::android::hardware::sensors::V1_0::RateLevel;
     using Result = ::android::hardware::sensors::V1_0::Result;
     using SensorInfo = ::android::hardware::sensors::V2_1::SensorInfo;
+    using SensorType = ::android::hardware::sensors::V2_1::SensorType;
     using SharedMemInfo = ::android::hardware::sensors::V1_0::SharedMemInfo;
     using IHalProxyCallbackV2_0 = V2_0::implementation::IHalProxyCallback;
     using IHalProxyCallbackV2_1 = V2_1::implementation::IHalProxyCallback;
@@ -202,10 +204,21 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     static constexpr int32_t kSensorHandleSubHalIndexMask = 0xFF000000;
 
     /**
-     * A FIFO queue of pairs of vector of events and the number of wakeup events in that vector
-     * which are waiting to be written to the events fmq in the background thread.
+     * A ring buffer of the events waiting to be written to the events fmq in the background thread,
+     * in the order they were posted. It grows up to kMaxSizePendingWriteEventsQueue events as the
+     * backlog requires and keeps its storage afterwards, so that deferring events doesn't allocate
+     * once it has reached the size of the largest bursts.
      */
-    std::queue<std::pair<std::vector<Event>, size_t>> mPendingWriteEventsQueue;
+    std::vector<Event> mPendingWriteEvents;
+
+    //! The index in mPendingWriteEvents of the oldest pending event.
+    size_t mPendingWriteEventsHead = 0;
+
+    //! The number of events in mPendingWriteEvents.
+    size_t mPendingWriteEventsCount = 0;
+
+    //! The events being written by the background thread, copied out of mPendingWriteEvents.
+    std::vector<Event> mPendingWriteBatch;
 
     //! The most events observed on the pending write events queue for debug purposes.
     size_t mMostEventsObservedPendingWriteEventsQueue = 0;
@@ -213,9 +226,26 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     //! The max number of events allowed in the pending write events queue
     static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
 
-    //! The number of events in the pending write events queue
+    //! The number of events in the pending write events queue, including the ones being written
     size_t mSizePendingWriteEventsQueue = 0;
 
+    //! The number of events that could not be written directly and were queued, for debug purposes
+    size_t mNumDeferredEvents = 0;
+
+    //! The number of events dropped because the pending write events queue was full
+    size_t mNumDroppedEvents = 0;
+
+    //! The latency from the event timestamp to the event fmq write, per subhal index and sensor
+    //! type. Guarded by mEventQueueWriteMutex.
+    std::map<std::pair<size_t, SensorType>, common::SensorLatencyHistogram> mEventWriteLatencies;
+
+    //! The mutex protecting mAckLatencyTracker, as acknowledgments are read by the wakelock thread
+    std::mutex mAckLatencyMutex;
+
+    //! The latency from the event fmq write of wakeup events to their acknowledgment through the
+    //! wake lock fmq
+    common::SensorAckLatencyTracker mAckLatencyTracker;
+
     //! The mutex protecting writing to the fmq and the pending events queue
     std::mutex mEventQueueWriteMutex;
 
@@ -242,20 +272,38 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
 
     std::condition_variable_any mWakelockCV;
 
-    //! The refcount of how many ScopedWakelocks and pending wakeup events are active
-    size_t mWakelockRefCount = 0;
+    //! The refcount of how many ScopedWakelocks and pending wakeup events are active in the low
+    //! 32 bits, and a generation bumped by each reset in the high bits. The refcount is updated
+    //! without mWakelockMutex while the wakelock stays held, and only goes from or to zero under
+    //! it. The generation is odd while a reset is in progress.
+    std::atomic<uint64_t> mWakelockState = 0;
 
-    int64_t mWakelockTimeoutStartTime = V2_0::implementation::getTimeNow();
+    std::atomic<int64_t> mWakelockTimeoutStartTime = V2_0::implementation::getTimeNow();
 
-    int64_t mWakelockTimeoutResetTime = V2_0::implementation::getTimeNow();
+    std::atomic<int64_t> mWakelockTimeoutResetTime = V2_0::implementation::getTimeNow();
 
     const char* kWakelockName = "SensorsHAL_WAKEUP";
 
     /**
-     * Initialize the list of SubHal objects in mSubHalList by reading from dynamic libraries
-     * listed in a config file.
+     * Append the dynamic libraries listed in a config file to subHalLibraryFiles.
      */
-    void initializeSubHalListFromConfigFile(const char* configFileName);
+    void readSubHalLibraryFiles(const char* configFileName,
+                                std::vector<std::string>* subHalLibraryFiles);
+
+    /**
+     * Initialize the list of SubHal objects in mSubHalList by loading the given dynamic
+     * libraries concurrently. The subhals are listed in the same order as the libraries.
+     */
+    void initializeSubHalList(const std::vector<std::string>& subHalLibraryFiles);
+
+    /**
+     * Load a subhal from a dynamic library.
+     *
+     * @param subHalLibraryFile The file name of the library.
+     *
+     * @return The subhal or nullptr if it couldn't be loaded.
+     */
+    std::shared_ptr<ISubHalWrapperBase> loadSubHal(const std::string& subHalLibraryFile);
 
     /**
      * Initialize the HalProxyCallback vector using the list of subhals.
@@ -264,7 +312,7 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
 
     /**
      * Initialize the list of SensorInfo objects in mSensorList by getting sensors from each
-     * subhal.
+     * subhal. The subhals are queried concurrently.
      */
     void initializeSensorList();
 
@@ -303,6 +351,46 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     //! Handles the pending writes on events to eventqueue.
     void handlePendingWrites();
 
+    /**
+     * Writes the events to the event fmq, deferring the ones that don't fit to the pending write
+     * events queue, and dropping them if that is full too.
+     *
+     * @param events The events to post.
+     * @param countWakeupEvents Whether the wakeup events that are dropped should be counted.
+     *
+     * @return The number of wakeup events dropped if countWakeupEvents is true, 0 otherwise.
+     */
+    size_t writeOrDeferEvents(const std::vector<Event>& events, bool countWakeupEvents);
+
+    /**
+     * Writes as many of the events as the event fmq can take, looping as long as the reader makes
+     * room. Must be called with mEventQueueWriteMutex held.
+     *
+     * @param events The events to write.
+     * @param numEvents The number of events to write.
+     *
+     * @return The number of events written.
+     */
+    size_t writeToEventQueueLocked(const Event* events, size_t numEvents);
+
+    /**
+     * Records the latency of events just written to the event fmq. Must be called with
+     * mEventQueueWriteMutex held.
+     *
+     * @param events The events written.
+     * @param numEvents The number of events written.
+     */
+    void recordEventsWrittenLocked(const Event* events, size_t numEvents);
+
+    /**
+     * Appends events to the pending write events queue, growing its ring buffer if needed. Must be
+     * called with mEventQueueWriteMutex held, and with room for the events in the queue.
+     *
+     * @param events The events to append.
+     * @param numEvents The number of events to append.
+     */
+    void pushPendingWriteEventsLocked(const Event* events, size_t numEvents);
+
     /**
      * Starts the thread that handles decrementing the ref count on wakeup events processed by the
      * framework and timing out wakelocks.
@@ -357,14 +445,14 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     bool isSubHalIndexValid(int32_t sensorHandle);
 
     /**
-     * Count the number of wakeup events in the first n events of the vector.
+     * Count the number of wakeup events in the first n events of the array.
      *
-     * @param events The vector of Event objects.
+     * @param events The array of Event objects.
      * @param n The end index not inclusive of events to consider.
      *
      * @return The number of wakeup events of the considered events.
      */
-    size_t countNumWakeupEvents(const std::vector<Event>& events, size_t n);
+    size_t countNumWakeupEvents(const Event* events, size_t n);
 
     /*
      * Clear out the subhal index bytes from a sensorHandle.
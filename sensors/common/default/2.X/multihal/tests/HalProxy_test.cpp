@@ -310,6 +310,31 @@ TEST(HalProxyTest, InitDirectChannelThreeSubHalsUnitTest) {
     });
 }
 
+TEST(HalProxyTest, ConfigDirectReportRejectsSensorsOfOtherSubHals) {
+    AllSupportDirectChannelSensorsSubHal subHal1, subHal2;
+    std::vector<ISensorsSubHal*> fakeSubHals{&subHal1, &subHal2};
+    HalProxy proxy(fakeSubHals);
+
+    std::vector<int32_t> otherSubHalSensorHandles;
+    proxy.getSensorsList([&](const auto& sensorsList) {
+        for (const SensorInfo& sensor : sensorsList) {
+            if (static_cast<size_t>(sensor.sensorHandle >> 24) == 1) {
+                otherSubHalSensorHandles.push_back(sensor.sensorHandle);
+            }
+        }
+    });
+    ASSERT_FALSE(otherSubHalSensorHandles.empty());
+
+    for (int32_t sensorHandle : otherSubHalSensorHandles) {
+        Result result = Result::OK;
+        proxy.configDirectReport(sensorHandle, 1 /* channelHandle */, HalProxy::RateLevel::NORMAL,
+                                 [&result](Result r, int32_t /* reportToken */) {
+                                     result = r;
+                                 });
+        EXPECT_EQ(result, Result::BAD_VALUE);
+    }
+}
+
 TEST(HalProxyTest, PostSingleNonWakeupEvent) {
     constexpr size_t kQueueSize = 5;
     AllSensorsSubHal<SensorsSubHalV2_0> subHal;
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace common {
+
+/**
+ * Histogram of latencies with power of two buckets in microseconds, cheap enough to be updated
+ * for every event. Bucket 0 holds latencies under 1 us, bucket i latencies in [2^(i-1), 2^i) us,
+ * and the last bucket everything from about 4 s up.
+ */
+class SensorLatencyHistogram {
+  public:
+    static constexpr size_t kNumBuckets = 24;
+
+    void record(int64_t latencyNs, uint64_t count = 1) {
+        // Timestamps from a sensor clock running slightly ahead count as no latency
+        latencyNs = std::max<int64_t>(latencyNs, 0);
+        uint64_t latencyUs = static_cast<uint64_t>(latencyNs) / 1000;
+        size_t bucket = latencyUs == 0 ? 0 : 64 - __builtin_clzll(latencyUs);
+        mBuckets[std::min(bucket, kNumBuckets - 1)] += count;
+        mCount += count;
+        mSumNs += static_cast<uint64_t>(latencyNs) * count;
+        mMaxNs = std::max(mMaxNs, latencyNs);
+    }
+
+    uint64_t getCount() const { return mCount; }
+
+    /**
+     * @return The upper bound in microseconds of the bucket holding the given percentile.
+     */
+    uint64_t getPercentileUs(uint32_t percentile) const {
+        uint64_t threshold = (mCount * percentile + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            seen += mBuckets[i];
+            if (seen >= threshold) {
+                return uint64_t{1} << i;
+            }
+        }
+        return uint64_t{1} << (kNumBuckets - 1);
+    }
+
+    /**
+     * Writes a single line summary of the histogram, with the percentiles rounded up to the upper
+     * bound of their bucket.
+     */
+    void dump(std::ostream& stream) const {
+        if (mCount == 0) {
+            stream << "no samples";
+            return;
+        }
+        stream << "count=" << mCount << " mean=" << mSumNs / mCount / 1000
+               << "us p50<=" << getPercentileUs(50) << "us p90<=" << getPercentileUs(90)
+               << "us p99<=" << getPercentileUs(99) << "us max=" << mMaxNs / 1000 << "us";
+    }
+
+  private:
+    std::array<uint64_t, kNumBuckets> mBuckets{};
+    uint64_t mCount = 0;
+    uint64_t mSumNs = 0;
+    int64_t mMaxNs = 0;
+};
+
+/**
+ * Matches the wakeup events written to the event FMQ with the acknowledgments the framework
+ * writes to the wake lock FMQ, which only carry a number of events handled. The framework handles
+ * the events in the order they were written, so the oldest writes are acknowledged first.
+ */
+class SensorAckLatencyTracker {
+  public:
+    //! Bounds the memory used if the framework stops acknowledging events
+    static constexpr size_t kMaxPendingWrites = 1024;
+
+    void onWakeupEventsWritten(int64_t writeTimeNs, uint64_t numEvents) {
+        if (numEvents == 0) {
+            return;
+        }
+        if (mPendingWrites.size() == kMaxPendingWrites) {
+            mPendingWrites.pop_front();
+        }
+        mPendingWrites.push_back({writeTimeNs, numEvents});
+    }
+
+    void onWakeupEventsHandled(int64_t ackTimeNs, uint64_t numEvents) {
+        while (numEvents > 0 && !mPendingWrites.empty()) {
+            PendingWrite& write = mPendingWrites.front();
+            uint64_t numAcked = std::min(numEvents, write.numEvents);
+            mHistogram.record(ackTimeNs - write.writeTimeNs, numAcked);
+            numEvents -= numAcked;
+            write.numEvents -= numAcked;
+            if (write.numEvents == 0) {
+                mPendingWrites.pop_front();
+            }
+        }
+    }
+
+    //! Forgets the pending writes, e.g. when the wake lock is reset without acknowledgment
+    void clearPendingWrites() { mPendingWrites.clear(); }
+
+    const SensorLatencyHistogram& getHistogram() const { return mHistogram; }
+
+  private:
+    struct PendingWrite {
+        int64_t writeTimeNs;
+        uint64_t numEvents;
+    };
+
+    std::deque<PendingWrite> mPendingWrites;
+    SensorLatencyHistogram mHistogram;
+};
+
+}  // namespace common
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
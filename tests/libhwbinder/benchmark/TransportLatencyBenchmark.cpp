@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency under load of the HAL transports. A server process, forked at startup, serves the
+// default implementations of the HIDL IBenchmark and IScheduleTest, an AIDL IBenchmark, and
+// echoes messages over FMQ pairs. The benchmarks send the same payloads over each transport from
+// several client threads at once, so that HIDL, AIDL and FMQ can be compared side by side, and
+// report:
+//   - p50_us, p90_us, p99_us, p999_us, max_us: percentiles of the round trip time, per client
+//     thread and averaged over the threads,
+//   - pi_miss_ratio: for IScheduleTest, the share of calls served by a thread that did not
+//     inherit the real-time priority of the caller.
+//
+// Run as root, so that the server can register its services and the clients can switch to
+// SCHED_FIFO:
+//   atest libhwbinder_latency_benchmark
+// or push the binary to the device and run it with --benchmark_filter=<regex>.
+
+#include <android/hardware/tests/libhwbinder/1.0/IBenchmark.h>
+#include <android/hardware/tests/libhwbinder/1.0/IScheduleTest.h>
+#include <android/tests/binder/BnBenchmark.h>
+#include <benchmark/benchmark.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <fmq/MessageQueue.h>
+#include <hidl/HidlTransportSupport.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ::android::sp;
+using ::android::String16;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::kSynchronizedReadWrite;
+using ::android::hardware::MessageQueue;
+using ::android::hardware::Return;
+using ::android::hardware::tests::libhwbinder::V1_0::IScheduleTest;
+
+using HidlBenchmark = ::android::hardware::tests::libhwbinder::V1_0::IBenchmark;
+using AidlBenchmark = ::android::tests::binder::IBenchmark;
+using Queue = MessageQueue<uint8_t, kSynchronizedReadWrite>;
+
+const char kServiceName[] = "libhwbinder_latency_benchmark";
+// Client threads, each with its own FMQ pair
+constexpr int kMaxClients = 8;
+constexpr size_t kMaxPayloadSize = 64 * 1024;
+// Payloads are prefixed with their size on FMQ
+constexpr size_t kQueueSize = 2 * (sizeof(uint32_t) + kMaxPayloadSize);
+
+struct FmqPair {
+    std::unique_ptr<Queue> request;
+    std::unique_ptr<Queue> response;
+};
+
+// Created before forking, so that the client and the server map the same queues
+std::array<FmqPair, kMaxClients> gFmqPairs;
+
+class AidlBenchmarkService : public ::android::tests::binder::BnBenchmark {
+  public:
+    ::android::binder::Status sendVec(const std::vector<int8_t>& data,
+                                      std::vector<int8_t>* _aidl_return) override {
+        *_aidl_return = data;
+        return ::android::binder::Status::ok();
+    }
+};
+
+void echoFmq(FmqPair* pair) {
+    std::vector<uint8_t> message(sizeof(uint32_t) + kMaxPayloadSize);
+    while (true) {
+        uint32_t size;
+        if (!pair->request->readBlocking(message.data(), sizeof(size))) {
+            continue;
+        }
+        memcpy(&size, message.data(), sizeof(size));
+        size = std::min<uint32_t>(size, kMaxPayloadSize);
+        if (pair->request->readBlocking(message.data() + sizeof(size), size)) {
+            pair->response->writeBlocking(message.data(), sizeof(size) + size);
+        }
+    }
+}
+
+[[noreturn]] void runServer() {
+    // The default implementations of tests/libhwbinder, served over hwbinder. hwbinder nodes
+    // inherit the real-time priority of their callers.
+    ::android::hardware::configureRpcThreadpool(kMaxClients, true /* callerWillJoin */);
+    sp<HidlBenchmark> hidlBenchmark = HidlBenchmark::getService("default", true /* getStub */);
+    sp<IScheduleTest> scheduleTest = IScheduleTest::getService("default", true /* getStub */);
+    if (hidlBenchmark == nullptr || scheduleTest == nullptr ||
+        hidlBenchmark->registerAsService(kServiceName) != ::android::OK ||
+        scheduleTest->registerAsService(kServiceName) != ::android::OK) {
+        _exit(EXIT_FAILURE);
+    }
+
+    sp<AidlBenchmarkService> aidlBenchmark = sp<AidlBenchmarkService>::make();
+    aidlBenchmark->setInheritRt(true);
+    if (::android::defaultServiceManager()->addService(String16(kServiceName), aidlBenchmark) !=
+        ::android::OK) {
+        _exit(EXIT_FAILURE);
+    }
+    ::android::ProcessState::self()->setThreadPoolMaxThreadCount(kMaxClients);
+    ::android::ProcessState::self()->startThreadPool();
+
+    for (auto& pair : gFmqPairs) {
+        std::thread(echoFmq, &pair).detach();
+    }
+
+    ::android::hardware::joinRpcThreadpool();
+    _exit(EXIT_FAILURE);
+}
+
+void reportLatencies(benchmark::State& state, std::vector<int64_t>* latenciesNs) {
+    if (latenciesNs->empty()) {
+        return;
+    }
+    std::sort(latenciesNs->begin(), latenciesNs->end());
+    auto percentileUs = [latenciesNs](double percentile) {
+        size_t index = std::min(latenciesNs->size() - 1,
+                                static_cast<size_t>(percentile * latenciesNs->size()));
+        return (*latenciesNs)[index] / 1000.0;
+    };
+    for (const auto& [name, percentile] : {std::make_pair("p50_us", 0.5),
+                                           std::make_pair("p90_us", 0.9),
+                                           std::make_pair("p99_us", 0.99),
+                                           std::make_pair("p999_us", 0.999),
+                                           std::make_pair("max_us", 1.0)}) {
+        state.counters[name] =
+                benchmark::Counter(percentileUs(percentile), benchmark::Counter::kAvgThreads);
+    }
+}
+
+// Times each call, which returns false on failure
+template <typename Call>
+void measure(benchmark::State& state, Call call) {
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(64 * 1024);
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        if (!call()) {
+            state.SkipWithError("call failed");
+            break;
+        }
+        latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+    }
+    reportLatencies(state, &latenciesNs);
+    state.SetBytesProcessed(2 * state.iterations() * state.range(0));
+}
+
+void BM_HidlSendVec(benchmark::State& state) {
+    sp<HidlBenchmark> service = HidlBenchmark::getService(kServiceName);
+    if (service == nullptr) {
+        state.SkipWithError("HIDL service not found");
+        return;
+    }
+    hidl_vec<uint8_t> data(state.range(0));
+    measure(state, [&] {
+        bool echoed = false;
+        Return<void> ret = service->sendVec(data, [&](const hidl_vec<uint8_t>& reply) {
+            echoed = reply.size() == data.size();
+        });
+        return ret.isOk() && echoed;
+    });
+}
+
+void BM_AidlSendVec(benchmark::State& state) {
+    sp<AidlBenchmark> service = ::android::interface_cast<AidlBenchmark>(
+            ::android::defaultServiceManager()->checkService(String16(kServiceName)));
+    if (service == nullptr) {
+        state.SkipWithError("AIDL service not found");
+        return;
+    }
+    std::vector<int8_t> data(state.range(0));
+    std::vector<int8_t> reply;
+    measure(state, [&] { return service->sendVec(data, &reply).isOk() && reply == data; });
+}
+
+void BM_FmqSendVec(benchmark::State& state) {
+    FmqPair& pair = gFmqPairs[state.thread_index() % kMaxClients];
+    const uint32_t size = state.range(0);
+    std::vector<uint8_t> message(sizeof(size) + size);
+    std::vector<uint8_t> reply(message.size());
+    memcpy(message.data(), &size, sizeof(size));
+    measure(state, [&] {
+        return pair.request->writeBlocking(message.data(), message.size()) &&
+               pair.response->readBlocking(reply.data(), reply.size());
+    });
+}
+
+// Calls IScheduleTest at the SCHED_FIFO priority of the argument, or SCHED_OTHER for 0, and
+// counts the calls served by a thread at another priority.
+void BM_HidlScheduleTest(benchmark::State& state) {
+    const int priority = state.range(0);
+    struct sched_param param = {.sched_priority = priority};
+    if (sched_setscheduler(0, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) != 0) {
+        state.SkipWithError("cannot change the scheduling policy, run as root");
+        return;
+    }
+    sp<IScheduleTest> service = IScheduleTest::getService(kServiceName);
+    if (service == nullptr) {
+        state.SkipWithError("HIDL service not found");
+        return;
+    }
+
+    int64_t priorityMisses = 0;
+    measure(state, [&] {
+        uint32_t callerState = (priority << 16) | (sched_getcpu() & 0xffff);
+        Return<uint32_t> ret = service->send(0 /* cfg */, callerState);
+        if (!ret.isOk()) {
+            return false;
+        }
+        priorityMisses += static_cast<uint32_t>(ret) >> 16;
+        return true;
+    });
+    state.counters["pi_miss_ratio"] = benchmark::Counter(
+            static_cast<double>(priorityMisses) / std::max<int64_t>(state.iterations(), 1),
+            benchmark::Counter::kAvgThreads);
+
+    param.sched_priority = 0;
+    sched_setscheduler(0, SCHED_OTHER, &param);
+}
+
+void payloadSizes(benchmark::internal::Benchmark* b) {
+    for (int64_t size : {0, 64, 1024, 4096, 16 * 1024, 64 * 1024}) {
+        b->Arg(size);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(BM_HidlSendVec)->Apply(payloadSizes)->Threads(1)->Threads(4)->Threads(kMaxClients);
+BENCHMARK(BM_AidlSendVec)->Apply(payloadSizes)->Threads(1)->Threads(4)->Threads(kMaxClients);
+BENCHMARK(BM_FmqSendVec)->Apply(payloadSizes)->Threads(1)->Threads(4)->Threads(kMaxClients);
+BENCHMARK(BM_HidlScheduleTest)->Arg(0)->Arg(1)->Arg(50)->Threads(1)->Threads(kMaxClients);
+
+int main(int argc, char** argv) {
+    for (auto& pair : gFmqPairs) {
+        pair.request = std::make_unique<Queue>(kQueueSize, true /* configureEventFlagWord */);
+        pair.response = std::make_unique<Queue>(kQueueSize, true /* configureEventFlagWord */);
+        if (!pair.request->isValid() || !pair.response->isValid()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Fork before any binder state is set up in this process.
+    pid_t server = fork();
+    if (server == 0) {
+        runServer();
+    }
+    if (server < 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Wait for the server to be up.
+    int status = EXIT_SUCCESS;
+    if (HidlBenchmark::getService(kServiceName) == nullptr ||
+        ::android::waitForService<AidlBenchmark>(String16(kServiceName)) == nullptr) {
+        status = EXIT_FAILURE;
+    } else {
+        ::benchmark::Initialize(&argc, argv);
+        ::benchmark::RunSpecifiedBenchmarks();
+    }
+
+    kill(server, SIGKILL);
+    waitpid(server, nullptr, 0);
+    return status;
+}
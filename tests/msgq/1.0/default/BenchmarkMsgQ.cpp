@@ -15,8 +15,15 @@
  */
 
 #include "BenchmarkMsgQ.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <thread>
+#include <vector>
+#include <fmq/AidlMessageQueue.h>
+#include <fmq/EventFlag.h>
 #include <fmq/MessageQueue.h>
 
 namespace android {
@@ -144,6 +151,210 @@ void BenchmarkMsgQ::QueuePairReadWrite(
     }
 }
 
+using aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using aidl::android::hardware::common::fmq::UnsynchronizedWrite;
+using android::hardware::EventFlag;
+using android::hardware::kUnsynchronizedWrite;
+
+/*
+ * Size in bytes of the queues used by benchmarkMatrix().
+ */
+static constexpr size_t kMatrixQueueSize = 16 * 1024;
+/*
+ * How far the writer may get ahead of the reader in benchmarkMatrix(). This
+ * keeps unsynchronized queues from overflowing, and applies to all
+ * experiments so that they stay comparable.
+ */
+static constexpr size_t kMatrixMaxBytesInFlight = kMatrixQueueSize / 2;
+static constexpr uint32_t kMatrixNotEmpty = 1 << 0;
+static constexpr int64_t kMatrixEventFlagTimeoutNs = 100 * 1000 * 1000;
+
+struct MatrixConfig {
+    const char* mqType;
+    const char* flavor;
+    bool eventFlag;
+    bool zeroCopy;
+    size_t messageSize;
+};
+
+static int64_t matrixNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+/*
+ * Writes a message starting with its send time. In zero-copy mode only the
+ * send time is written, in place.
+ */
+template <typename Queue>
+static bool writeMatrixMessage(Queue* mq, uint8_t* data, size_t size, int64_t sendTimeNs,
+                               bool zeroCopy) {
+    if (!zeroCopy) {
+        memcpy(data, &sendTimeNs, sizeof(sendTimeNs));
+        return mq->write(data, size);
+    }
+    typename Queue::MemTransaction tx;
+    if (!mq->beginWrite(size, &tx)) return false;
+    const uint8_t* sendTime = reinterpret_cast<const uint8_t*>(&sendTimeNs);
+    for (size_t i = 0; i < sizeof(sendTimeNs); i++) {
+        *tx.getSlot(i) = sendTime[i];
+    }
+    return mq->commitWrite(size);
+}
+
+/*
+ * Reads a message and returns its send time. In zero-copy mode only the send
+ * time is read, in place.
+ */
+template <typename Queue>
+static bool readMatrixMessage(Queue* mq, uint8_t* data, size_t size, int64_t* sendTimeNs,
+                              bool zeroCopy) {
+    if (!zeroCopy) {
+        if (!mq->read(data, size)) return false;
+        memcpy(sendTimeNs, data, sizeof(*sendTimeNs));
+        return true;
+    }
+    typename Queue::MemTransaction tx;
+    if (!mq->beginRead(size, &tx)) return false;
+    uint8_t* sendTime = reinterpret_cast<uint8_t*>(sendTimeNs);
+    for (size_t i = 0; i < sizeof(*sendTimeNs); i++) {
+        sendTime[i] = *tx.getSlot(i);
+    }
+    return mq->commitRead(size);
+}
+
+static std::string formatMatrixResult(const MatrixConfig& config, uint32_t numIter,
+                                      std::vector<int64_t>* latencies, int64_t elapsedNs,
+                                      const char* error) {
+    std::ostringstream out;
+    out << "{\"mq\":\"" << config.mqType << "\",\"flavor\":\"" << config.flavor
+        << "\",\"wakeup\":\"" << (config.eventFlag ? "eventflag" : "polling")
+        << "\",\"transfer\":\"" << (config.zeroCopy ? "zerocopy" : "copy")
+        << "\",\"messageSize\":" << config.messageSize << ",\"numIter\":" << numIter;
+    if (error != nullptr) {
+        out << ",\"error\":\"" << error << "\"}\n";
+        return out.str();
+    }
+
+    std::sort(latencies->begin(), latencies->end());
+    auto percentile = [latencies](size_t perMille) {
+        return (*latencies)[std::min(latencies->size() - 1, latencies->size() * perMille / 1000)];
+    };
+    double seconds = std::max<int64_t>(elapsedNs, 1) / 1e9;
+    out << ",\"p50Ns\":" << percentile(500) << ",\"p90Ns\":" << percentile(900)
+        << ",\"p99Ns\":" << percentile(990) << ",\"p999Ns\":" << percentile(999)
+        << ",\"maxNs\":" << latencies->back()
+        << ",\"messagesPerSecond\":" << static_cast<int64_t>(numIter / seconds)
+        << ",\"bytesPerSecond\":" << static_cast<int64_t>(numIter * config.messageSize / seconds)
+        << "}\n";
+    return out.str();
+}
+
+/*
+ * Sends numIter messages from writer to reader, which must be two ends of
+ * the same queue, and measures the latency of each message from just before
+ * it's written until it's read.
+ */
+template <typename Queue>
+static std::string runMatrixExperiment(const MatrixConfig& config, uint32_t numIter,
+                                       Queue* writer, Queue* reader) {
+    if (!writer->isValid() || !reader->isValid()) {
+        return formatMatrixResult(config, numIter, nullptr, 0, "invalid queue");
+    }
+
+    EventFlag* writerEventFlag = nullptr;
+    EventFlag* readerEventFlag = nullptr;
+    if (config.eventFlag &&
+        (EventFlag::createEventFlag(writer->getEventFlagWord(), &writerEventFlag) != OK ||
+         EventFlag::createEventFlag(reader->getEventFlagWord(), &readerEventFlag) != OK)) {
+        if (writerEventFlag != nullptr) EventFlag::deleteEventFlag(&writerEventFlag);
+        return formatMatrixResult(config, numIter, nullptr, 0, "no event flag");
+    }
+
+    std::vector<int64_t> latencies(numIter);
+    std::atomic<uint32_t> numReceived = 0;
+    int64_t startNs = matrixNowNs();
+
+    std::thread readerThread([&] {
+        std::vector<uint8_t> data(config.messageSize);
+        for (uint32_t i = 0; i < numIter; i++) {
+            int64_t sendTimeNs;
+            while (!readMatrixMessage(reader, data.data(), config.messageSize, &sendTimeNs,
+                                      config.zeroCopy)) {
+                if (readerEventFlag != nullptr) {
+                    uint32_t efState = 0;
+                    readerEventFlag->wait(kMatrixNotEmpty, &efState, kMatrixEventFlagTimeoutNs);
+                }
+            }
+            latencies[i] = matrixNowNs() - sendTimeNs;
+            numReceived.store(i + 1, std::memory_order_release);
+        }
+    });
+
+    std::vector<uint8_t> data(config.messageSize, 0xa5);
+    for (uint32_t i = 0; i < numIter; i++) {
+        while ((i - numReceived.load(std::memory_order_acquire)) * config.messageSize >=
+               kMatrixMaxBytesInFlight)
+            ;
+        int64_t sendTimeNs = matrixNowNs();
+        while (!writeMatrixMessage(writer, data.data(), config.messageSize, sendTimeNs,
+                                   config.zeroCopy))
+            ;
+        if (writerEventFlag != nullptr) writerEventFlag->wake(kMatrixNotEmpty);
+    }
+    readerThread.join();
+    int64_t elapsedNs = matrixNowNs() - startNs;
+
+    if (writerEventFlag != nullptr) EventFlag::deleteEventFlag(&writerEventFlag);
+    if (readerEventFlag != nullptr) EventFlag::deleteEventFlag(&readerEventFlag);
+    return formatMatrixResult(config, numIter, &latencies, elapsedNs, nullptr);
+}
+
+template <MQFlavor flavor>
+static std::string runHidlMatrixExperiment(const MatrixConfig& config, uint32_t numIter) {
+    android::hardware::MessageQueue<uint8_t, flavor> writer(kMatrixQueueSize, config.eventFlag);
+    android::hardware::MessageQueue<uint8_t, flavor> reader(*writer.getDesc(),
+                                                            false /* resetPointers */);
+    return runMatrixExperiment(config, numIter, &writer, &reader);
+}
+
+template <typename Flavor>
+static std::string runAidlMatrixExperiment(const MatrixConfig& config, uint32_t numIter) {
+    android::AidlMessageQueue<uint8_t, Flavor> writer(kMatrixQueueSize, config.eventFlag);
+    android::AidlMessageQueue<uint8_t, Flavor> reader(writer.dupeDesc(),
+                                                      false /* resetPointers */);
+    return runMatrixExperiment(config, numIter, &writer, &reader);
+}
+
+Return<void> BenchmarkMsgQ::benchmarkMatrix(uint32_t numIter, benchmarkMatrix_cb _hidl_cb) {
+    std::string results;
+    if (numIter == 0) {
+        _hidl_cb(results);
+        return Void();
+    }
+
+    for (size_t messageSize :
+         {kPacketSize64, kPacketSize128, kPacketSize256, kPacketSize512, kPacketSize1024}) {
+        for (bool eventFlag : {false, true}) {
+            for (bool zeroCopy : {false, true}) {
+                results += runHidlMatrixExperiment<kSynchronizedReadWrite>(
+                        {"hidl", "sync", eventFlag, zeroCopy, messageSize}, numIter);
+                results += runHidlMatrixExperiment<kUnsynchronizedWrite>(
+                        {"hidl", "unsync", eventFlag, zeroCopy, messageSize}, numIter);
+                results += runAidlMatrixExperiment<SynchronizedReadWrite>(
+                        {"aidl", "sync", eventFlag, zeroCopy, messageSize}, numIter);
+                results += runAidlMatrixExperiment<UnsynchronizedWrite>(
+                        {"aidl", "unsync", eventFlag, zeroCopy, messageSize}, numIter);
+            }
+        }
+    }
+
+    std::cout << results;
+    _hidl_cb(results);
+    return Void();
+}
+
 IBenchmarkMsgQ* HIDL_FETCH_IBenchmarkMsgQ(const char* /* name */) {
     return new BenchmarkMsgQ();
 }
@@ -62,6 +62,7 @@ struct BenchmarkMsgQ : public IBenchmarkMsgQ {
     Return<void> benchmarkPingPong(uint32_t numIter) override;
     Return<void> benchmarkServiceWriteClientRead(uint32_t numIter) override;
     Return<void> sendTimeData(const hidl_vec<int64_t>& timeData) override;
+    Return<void> benchmarkMatrix(uint32_t numIter, benchmarkMatrix_cb _hidl_cb) override;
 
      /*
      * This method writes numIter packets into the mFmqOutbox queue
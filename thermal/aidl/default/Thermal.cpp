@@ -20,12 +20,17 @@
 
 #include <android-base/logging.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace aidl::android::hardware::thermal::impl::example {
 
 using ndk::ScopedAStatus;
 
 namespace {
 
+constexpr char kThermalSysfsRoot[] = "/sys/class/thermal";
+
 bool interfacesEqual(const std::shared_ptr<::ndk::ICInterface>& left,
                      const std::shared_ptr<::ndk::ICInterface>& right) {
     if (left == nullptr || right == nullptr || !left->isRemote() || !right->isRemote()) {
@@ -36,66 +41,82 @@ bool interfacesEqual(const std::shared_ptr<::ndk::ICInterface>& left,
 
 }  // namespace
 
-ScopedAStatus Thermal::getCoolingDevices(std::vector<CoolingDevice>* /* out_devices */) {
+Thermal::Thermal()
+    : sampler_(
+              kThermalSysfsRoot,
+              [this](const Temperature& temperature) { notifyThrottling(temperature); },
+              [this](const CoolingDevice& device) { notifyCoolingDeviceChanged(device); }) {}
+
+ScopedAStatus Thermal::getCoolingDevices(std::vector<CoolingDevice>* out_devices) {
     LOG(VERBOSE) << __func__;
+    *out_devices = sampler_.getSnapshot()->coolingDevices;
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus Thermal::getCoolingDevicesWithType(CoolingType in_type,
-                                                 std::vector<CoolingDevice>* /* out_devices */) {
+                                                 std::vector<CoolingDevice>* out_devices) {
     LOG(VERBOSE) << __func__ << " CoolingType: " << static_cast<int32_t>(in_type);
+    const auto snapshot = sampler_.getSnapshot();
+    out_devices->clear();
+    std::copy_if(snapshot->coolingDevices.begin(), snapshot->coolingDevices.end(),
+                 std::back_inserter(*out_devices),
+                 [in_type](const CoolingDevice& device) { return device.type == in_type; });
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus Thermal::getTemperatures(std::vector<Temperature>* /* out_temperatures */) {
+ScopedAStatus Thermal::getTemperatures(std::vector<Temperature>* out_temperatures) {
     LOG(VERBOSE) << __func__;
+    *out_temperatures = sampler_.getSnapshot()->temperatures;
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus Thermal::getTemperaturesWithType(TemperatureType in_type,
-                                               std::vector<Temperature>* /* out_temperatures */) {
+                                               std::vector<Temperature>* out_temperatures) {
     LOG(VERBOSE) << __func__ << " TemperatureType: " << static_cast<int32_t>(in_type);
+    const auto snapshot = sampler_.getSnapshot();
+    out_temperatures->clear();
+    std::copy_if(snapshot->temperatures.begin(), snapshot->temperatures.end(),
+                 std::back_inserter(*out_temperatures),
+                 [in_type](const Temperature& temperature) { return temperature.type == in_type; });
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus Thermal::getTemperatureThresholds(
-        std::vector<TemperatureThreshold>* /* out_temperatureThresholds */) {
+        std::vector<TemperatureThreshold>* out_temperatureThresholds) {
     LOG(VERBOSE) << __func__;
+    *out_temperatureThresholds = sampler_.getThresholds();
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus Thermal::getTemperatureThresholdsWithType(
-        TemperatureType in_type,
-        std::vector<TemperatureThreshold>* /* out_temperatureThresholds */) {
+        TemperatureType in_type, std::vector<TemperatureThreshold>* out_temperatureThresholds) {
     LOG(VERBOSE) << __func__ << " TemperatureType: " << static_cast<int32_t>(in_type);
+    const auto& thresholds = sampler_.getThresholds();
+    out_temperatureThresholds->clear();
+    std::copy_if(thresholds.begin(), thresholds.end(),
+                 std::back_inserter(*out_temperatureThresholds),
+                 [in_type](const TemperatureThreshold& threshold) {
+                     return threshold.type == in_type;
+                 });
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus Thermal::registerThermalChangedCallback(
         const std::shared_ptr<IThermalChangedCallback>& in_callback) {
     LOG(VERBOSE) << __func__ << " IThermalChangedCallback: " << in_callback;
-    if (in_callback == nullptr) {
-        return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
-                                                                "Invalid nullptr callback");
-    }
-    {
-        std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
-        if (std::any_of(thermal_callbacks_.begin(), thermal_callbacks_.end(),
-                        [&](const std::shared_ptr<IThermalChangedCallback>& c) {
-                            return interfacesEqual(c, in_callback);
-                        })) {
-            return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
-                                                                    "Callback already registered");
-        }
-        thermal_callbacks_.push_back(in_callback);
-    }
-    return ScopedAStatus::ok();
+    return registerThermalChangedCallbackInternal(in_callback, std::nullopt);
 }
 
 ScopedAStatus Thermal::registerThermalChangedCallbackWithType(
         const std::shared_ptr<IThermalChangedCallback>& in_callback, TemperatureType in_type) {
     LOG(VERBOSE) << __func__ << " IThermalChangedCallback: " << in_callback
                  << ", TemperatureType: " << static_cast<int32_t>(in_type);
+    return registerThermalChangedCallbackInternal(in_callback, in_type);
+}
+
+ScopedAStatus Thermal::registerThermalChangedCallbackInternal(
+        const std::shared_ptr<IThermalChangedCallback>& in_callback,
+        std::optional<TemperatureType> type) {
     if (in_callback == nullptr) {
         return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                 "Invalid nullptr callback");
@@ -103,13 +124,13 @@ ScopedAStatus Thermal::registerThermalChangedCallbackWithType(
     {
         std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
         if (std::any_of(thermal_callbacks_.begin(), thermal_callbacks_.end(),
-                        [&](const std::shared_ptr<IThermalChangedCallback>& c) {
-                            return interfacesEqual(c, in_callback);
+                        [&](const ThermalCallbackSetting& c) {
+                            return interfacesEqual(c.callback, in_callback);
                         })) {
             return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                     "Callback already registered");
         }
-        thermal_callbacks_.push_back(in_callback);
+        thermal_callbacks_.push_back({in_callback, type});
     }
     return ScopedAStatus::ok();
 }
@@ -126,8 +147,8 @@ ScopedAStatus Thermal::unregisterThermalChangedCallback(
         bool removed = false;
         thermal_callbacks_.erase(
                 std::remove_if(thermal_callbacks_.begin(), thermal_callbacks_.end(),
-                               [&](const std::shared_ptr<IThermalChangedCallback>& c) {
-                                   if (interfacesEqual(c, in_callback)) {
+                               [&](const ThermalCallbackSetting& c) {
+                                   if (interfacesEqual(c.callback, in_callback)) {
                                        removed = true;
                                        return true;
                                    }
@@ -153,13 +174,13 @@ ScopedAStatus Thermal::registerCoolingDeviceChangedCallbackWithType(
     {
         std::lock_guard<std::mutex> _lock(cdev_callback_mutex_);
         if (std::any_of(cdev_callbacks_.begin(), cdev_callbacks_.end(),
-                        [&](const std::shared_ptr<ICoolingDeviceChangedCallback>& c) {
-                            return interfacesEqual(c, in_callback);
+                        [&](const CoolingDeviceCallbackSetting& c) {
+                            return interfacesEqual(c.callback, in_callback);
                         })) {
             return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                     "Callback already registered");
         }
-        cdev_callbacks_.push_back(in_callback);
+        cdev_callbacks_.push_back({in_callback, in_type});
     }
     return ScopedAStatus::ok();
 }
@@ -176,8 +197,8 @@ ScopedAStatus Thermal::unregisterCoolingDeviceChangedCallback(
         bool removed = false;
         cdev_callbacks_.erase(
                 std::remove_if(cdev_callbacks_.begin(), cdev_callbacks_.end(),
-                               [&](const std::shared_ptr<ICoolingDeviceChangedCallback>& c) {
-                                   if (interfacesEqual(c, in_callback)) {
+                               [&](const CoolingDeviceCallbackSetting& c) {
+                                   if (interfacesEqual(c.callback, in_callback)) {
                                        removed = true;
                                        return true;
                                    }
@@ -191,4 +212,39 @@ ScopedAStatus Thermal::unregisterCoolingDeviceChangedCallback(
     }
     return ScopedAStatus::ok();
 }
+
+void Thermal::notifyThrottling(const Temperature& temperature) {
+    // Called from the sampler thread; the callbacks are oneway, but still called without the lock
+    // so registrations never wait on binder.
+    std::vector<std::shared_ptr<IThermalChangedCallback>> callbacks;
+    {
+        std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
+        for (const auto& c : thermal_callbacks_) {
+            if (!c.type.has_value() || *c.type == temperature.type) {
+                callbacks.push_back(c.callback);
+            }
+        }
+    }
+    for (const auto& callback : callbacks) {
+        if (!callback->notifyThrottling(temperature).isOk()) {
+            LOG(WARNING) << "Failed to notify a thermal changed callback";
+        }
+    }
+}
+
+void Thermal::notifyCoolingDeviceChanged(const CoolingDevice& device) {
+    std::vector<std::shared_ptr<ICoolingDeviceChangedCallback>> callbacks;
+    {
+        std::lock_guard<std::mutex> _lock(cdev_callback_mutex_);
+        for (const auto& c : cdev_callbacks_) {
+            if (!c.type.has_value() || *c.type == device.type) callbacks.push_back(c.callback);
+        }
+    }
+    for (const auto& callback : callbacks) {
+        if (!callback->notifyCoolingDeviceChanged(device).isOk()) {
+            LOG(WARNING) << "Failed to notify a cooling device changed callback";
+        }
+    }
+}
+
 }  // namespace aidl::android::hardware::thermal::impl::example
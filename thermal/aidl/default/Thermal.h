@@ -16,10 +16,15 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 
 #include <aidl/android/hardware/thermal/BnThermal.h>
 
+#include "ThermalSampler.h"
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -29,6 +34,8 @@ namespace example {
 
 class Thermal : public BnThermal {
   public:
+    Thermal();
+
     ndk::ScopedAStatus getCoolingDevices(std::vector<CoolingDevice>* out_devices) override;
     ndk::ScopedAStatus getCoolingDevicesWithType(CoolingType in_type,
                                                  std::vector<CoolingDevice>* out_devices) override;
@@ -62,10 +69,29 @@ class Thermal : public BnThermal {
             const std::shared_ptr<ICoolingDeviceChangedCallback>& in_callback) override;
 
   private:
+    template <typename C, typename T>
+    struct CallbackSetting {
+        std::shared_ptr<C> callback;
+        /** Only notify about this type, or about all of them if empty. */
+        std::optional<T> type;
+    };
+    using ThermalCallbackSetting = CallbackSetting<IThermalChangedCallback, TemperatureType>;
+    using CoolingDeviceCallbackSetting =
+            CallbackSetting<ICoolingDeviceChangedCallback, CoolingType>;
+
+    ndk::ScopedAStatus registerThermalChangedCallbackInternal(
+            const std::shared_ptr<IThermalChangedCallback>& in_callback,
+            std::optional<TemperatureType> type);
+    void notifyThrottling(const Temperature& temperature);
+    void notifyCoolingDeviceChanged(const CoolingDevice& device);
+
     std::mutex thermal_callback_mutex_;
-    std::vector<std::shared_ptr<IThermalChangedCallback>> thermal_callbacks_;
+    std::vector<ThermalCallbackSetting> thermal_callbacks_;
     std::mutex cdev_callback_mutex_;
-    std::vector<std::shared_ptr<ICoolingDeviceChangedCallback>> cdev_callbacks_;
+    std::vector<CoolingDeviceCallbackSetting> cdev_callbacks_;
+
+    // Declared last, so it stops calling into the callbacks before they are destroyed.
+    ThermalSampler sampler_;
 };
 
 }  // namespace example
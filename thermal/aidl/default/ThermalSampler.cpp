@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "thermal_service_example"
+
+#include "ThermalSampler.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <utility>
+
+namespace aidl::android::hardware::thermal::impl::example {
+
+using namespace std::chrono_literals;
+using ::android::base::ParseInt;
+using ::android::base::ReadFileToString;
+using ::android::base::StartsWith;
+using ::android::base::Trim;
+using ::android::base::unique_fd;
+
+namespace {
+
+/** Sampling interval of a sensor far from its thresholds. */
+constexpr auto kSlowInterval = 5s;
+/** Sampling interval of a sensor close to a threshold or throttling. */
+constexpr auto kFastInterval = 1s;
+/** How close to the first hot threshold a sensor counts as near it, in Celsius. */
+constexpr float kNearMargin = 5.0f;
+/** Hysteresis of trip points that don't specify one, in Celsius. */
+constexpr float kDefaultHysteresis = 1.0f;
+
+constexpr size_t kSeverityCount = static_cast<size_t>(ThrottlingSeverity::SHUTDOWN) + 1;
+
+/** Sensor types, by a substring of the thermal zone type. The first match wins. */
+constexpr std::pair<const char*, TemperatureType> kTemperatureTypes[] = {
+        {"cpu", TemperatureType::CPU},
+        {"gpu", TemperatureType::GPU},
+        {"battery", TemperatureType::BATTERY},
+        {"skin", TemperatureType::SKIN},
+        {"usb", TemperatureType::USB_PORT},
+        {"npu", TemperatureType::NPU},
+        {"tpu", TemperatureType::TPU},
+        {"disp", TemperatureType::DISPLAY},
+        {"modem", TemperatureType::MODEM},
+        {"soc", TemperatureType::SOC},
+        {"wifi", TemperatureType::WIFI},
+        {"wlan", TemperatureType::WIFI},
+        {"camera", TemperatureType::CAMERA},
+        {"flash", TemperatureType::FLASHLIGHT},
+        {"speaker", TemperatureType::SPEAKER},
+        {"ambient", TemperatureType::AMBIENT},
+};
+
+/** Cooling device types, by a substring of the cooling device type. The first match wins. */
+constexpr std::pair<const char*, CoolingType> kCoolingTypes[] = {
+        {"fan", CoolingType::FAN},
+        {"cpu", CoolingType::CPU},
+        {"gpu", CoolingType::GPU},
+        {"battery", CoolingType::BATTERY},
+        {"modem", CoolingType::MODEM},
+        {"npu", CoolingType::NPU},
+        {"tpu", CoolingType::TPU},
+        {"disp", CoolingType::DISPLAY},
+        {"backlight", CoolingType::DISPLAY},
+        {"wifi", CoolingType::WIFI},
+        {"camera", CoolingType::CAMERA},
+        {"usb", CoolingType::USB_PORT},
+};
+
+template <typename T, size_t N>
+T typeOf(const std::string& name, const std::pair<const char*, T> (&table)[N], T fallback) {
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    for (const auto& [substring, type] : table) {
+        if (key.find(substring) != std::string::npos) return type;
+    }
+    return fallback;
+}
+
+std::optional<std::string> readAttribute(const std::string& path) {
+    std::string value;
+    if (!ReadFileToString(path, &value)) return std::nullopt;
+    return Trim(value);
+}
+
+std::optional<int64_t> readValue(int fd) {
+    char buf[32];
+    const ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf) - 1, 0));
+    if (n <= 0) return std::nullopt;
+    buf[n] = '\0';
+    int64_t value;
+    if (!ParseInt(Trim(buf), &value)) return std::nullopt;
+    return value;
+}
+
+/** Lists the entries of a directory with the given prefix, ordered by their numeric suffix. */
+std::vector<std::string> listNodes(const std::string& root, const std::string& prefix) {
+    std::vector<std::pair<int, std::string>> nodes;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(root.c_str()), closedir);
+    if (!dir) {
+        PLOG(ERROR) << "Failed to open " << root;
+        return {};
+    }
+    while (const auto* entry = readdir(dir.get())) {
+        const std::string name = entry->d_name;
+        int index;
+        if (!StartsWith(name, prefix) || !ParseInt(name.substr(prefix.size()), &index)) continue;
+        nodes.emplace_back(index, root + "/" + name);
+    }
+    std::sort(nodes.begin(), nodes.end());
+
+    std::vector<std::string> paths;
+    for (auto& [index, path] : nodes) paths.push_back(std::move(path));
+    return paths;
+}
+
+}  // namespace
+
+ThermalSampler::ThermalSampler(const std::string& root, TemperatureListener onSeverityChanged,
+                               CoolingDeviceListener onCoolingDeviceChanged)
+    : mOnSeverityChanged(std::move(onSeverityChanged)),
+      mOnCoolingDeviceChanged(std::move(onCoolingDeviceChanged)),
+      mSnapshot(std::make_shared<Snapshot>()) {
+    discover(root);
+    LOG(INFO) << "Found " << mSensors.size() << " thermal zones and " << mCoolers.size()
+              << " cooling devices";
+    if (mSensors.empty() && mCoolers.empty()) return;
+
+    // Have values in place before the first query.
+    const auto next = sample(Clock::now());
+    publish();
+    mThread = std::thread([this, next] {
+        auto wakeTime = next;
+        std::unique_lock<std::mutex> lock(mStopLock);
+        while (!mStopCv.wait_until(lock, wakeTime, [this] { return mStop; })) {
+            lock.unlock();
+            wakeTime = sample(Clock::now());
+            lock.lock();
+        }
+    });
+}
+
+ThermalSampler::~ThermalSampler() {
+    {
+        std::lock_guard<std::mutex> lock(mStopLock);
+        mStop = true;
+    }
+    mStopCv.notify_one();
+    if (mThread.joinable()) mThread.join();
+}
+
+std::shared_ptr<const ThermalSampler::Snapshot> ThermalSampler::getSnapshot() const {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    return mSnapshot;
+}
+
+void ThermalSampler::discover(const std::string& root) {
+    for (const auto& zoneDir : listNodes(root, "thermal_zone")) addSensor(zoneDir);
+    for (const auto& deviceDir : listNodes(root, "cooling_device")) addCooler(deviceDir);
+}
+
+void ThermalSampler::addSensor(const std::string& zoneDir) {
+    const auto type = readAttribute(zoneDir + "/type");
+    unique_fd fd(TEMP_FAILURE_RETRY(open((zoneDir + "/temp").c_str(), O_RDONLY | O_CLOEXEC)));
+    if (!type.has_value() || fd < 0) {
+        LOG(WARNING) << "Skipping unreadable thermal zone " << zoneDir;
+        return;
+    }
+
+    // Passive and hot trip points map to increasing severities, the critical one to shutdown.
+    std::vector<float> throttling;
+    float shutdown = NAN;
+    float hysteresis = 0;
+    for (int i = 0;; i++) {
+        const auto prefix = zoneDir + "/trip_point_" + std::to_string(i);
+        const auto tripTemp = readAttribute(prefix + "_temp");
+        const auto tripType = readAttribute(prefix + "_type");
+        if (!tripTemp.has_value() || !tripType.has_value()) break;
+        int64_t milliCelsius;
+        if (!ParseInt(*tripTemp, &milliCelsius)) continue;
+
+        if (*tripType == "critical") {
+            shutdown = milliCelsius / 1000.0f;
+        } else if (*tripType == "passive" || *tripType == "hot") {
+            throttling.push_back(milliCelsius / 1000.0f);
+        } else {
+            continue;
+        }
+        int64_t hyst;
+        if (const auto tripHyst = readAttribute(prefix + "_hyst");
+            tripHyst.has_value() && ParseInt(*tripHyst, &hyst)) {
+            hysteresis = std::max(hysteresis, hyst / 1000.0f);
+        }
+    }
+    std::sort(throttling.begin(), throttling.end());
+
+    std::vector<float> hotThresholds(kSeverityCount, NAN);
+    const size_t first = static_cast<size_t>(ThrottlingSeverity::LIGHT);
+    const size_t last = static_cast<size_t>(ThrottlingSeverity::CRITICAL);
+    for (size_t i = 0; i < throttling.size() && first + i <= last; i++) {
+        hotThresholds[first + i] = throttling[i];
+    }
+    hotThresholds[static_cast<size_t>(ThrottlingSeverity::SHUTDOWN)] = shutdown;
+
+    Sensor sensor;
+    sensor.temperature.type = typeOf(*type, kTemperatureTypes, TemperatureType::UNKNOWN);
+    sensor.temperature.name = *type;
+    sensor.temperature.throttlingStatus = ThrottlingSeverity::NONE;
+    sensor.fd = std::move(fd);
+    sensor.hotThresholds = hotThresholds;
+    sensor.hysteresis = hysteresis > 0 ? hysteresis : kDefaultHysteresis;
+    mSensors.push_back(std::move(sensor));
+
+    mThresholds.push_back({
+            .type = mSensors.back().temperature.type,
+            .name = *type,
+            .hotThrottlingThresholds = std::move(hotThresholds),
+            .coldThrottlingThresholds = std::vector<float>(kSeverityCount, NAN),
+    });
+}
+
+void ThermalSampler::addCooler(const std::string& deviceDir) {
+    const auto type = readAttribute(deviceDir + "/type");
+    unique_fd fd(
+            TEMP_FAILURE_RETRY(open((deviceDir + "/cur_state").c_str(), O_RDONLY | O_CLOEXEC)));
+    if (!type.has_value() || fd < 0) {
+        LOG(WARNING) << "Skipping unreadable cooling device " << deviceDir;
+        return;
+    }
+
+    Cooler cooler;
+    cooler.device.type = typeOf(*type, kCoolingTypes, CoolingType::COMPONENT);
+    cooler.device.name = *type;
+    cooler.fd = std::move(fd);
+    mCoolers.push_back(std::move(cooler));
+}
+
+void ThermalSampler::publish() {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->temperatures.reserve(mSensors.size());
+    for (const auto& sensor : mSensors) snapshot->temperatures.push_back(sensor.temperature);
+    snapshot->coolingDevices.reserve(mCoolers.size());
+    for (const auto& cooler : mCoolers) snapshot->coolingDevices.push_back(cooler.device);
+
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    mSnapshot = std::move(snapshot);
+}
+
+ThrottlingSeverity ThermalSampler::severityOf(const Sensor& sensor, float value) const {
+    const auto& hot = sensor.hotThresholds;
+    size_t severity = 0;
+    for (size_t s = hot.size() - 1; s > 0; s--) {
+        if (!std::isnan(hot[s]) && value >= hot[s]) {
+            severity = s;
+            break;
+        }
+    }
+
+    // Rising takes effect right away, falling only once clear of the hysteresis.
+    const size_t current = static_cast<size_t>(sensor.temperature.throttlingStatus);
+    for (size_t s = current; s > severity; s--) {
+        if (!std::isnan(hot[s]) && value > hot[s] - sensor.hysteresis) {
+            severity = s;
+            break;
+        }
+    }
+    return static_cast<ThrottlingSeverity>(severity);
+}
+
+bool ThermalSampler::isNearThreshold(const Sensor& sensor) const {
+    if (sensor.temperature.throttlingStatus != ThrottlingSeverity::NONE) return true;
+    const auto first = std::find_if(sensor.hotThresholds.begin(), sensor.hotThresholds.end(),
+                                    [](float t) { return !std::isnan(t); });
+    return first != sensor.hotThresholds.end() && sensor.temperature.value >= *first - kNearMargin;
+}
+
+ThermalSampler::Clock::time_point ThermalSampler::sample(Clock::time_point now) {
+    bool changed = false;
+    bool anyNear = false;
+    std::vector<Temperature> severityChanges;
+    std::vector<CoolingDevice> coolerChanges;
+    auto next = Clock::time_point::max();
+
+    for (auto& sensor : mSensors) {
+        if (sensor.nextSample <= now) {
+            if (const auto milliCelsius = readValue(sensor.fd); milliCelsius.has_value()) {
+                const float value = *milliCelsius / 1000.0f;
+                const auto severity = severityOf(sensor, value);
+                changed |= value != sensor.temperature.value;
+                sensor.temperature.value = value;
+                if (severity != sensor.temperature.throttlingStatus) {
+                    sensor.temperature.throttlingStatus = severity;
+                    severityChanges.push_back(sensor.temperature);
+                }
+            }
+            sensor.nextSample = now + (isNearThreshold(sensor) ? kFastInterval : kSlowInterval);
+        }
+        anyNear |= isNearThreshold(sensor);
+        next = std::min(next, sensor.nextSample);
+    }
+
+    // Cooling devices react to the sensors, so they follow the cadence of the busiest one.
+    if (!mCoolers.empty()) {
+        if (mNextCoolerSample <= now) {
+            for (auto& cooler : mCoolers) {
+                const auto state = readValue(cooler.fd);
+                if (!state.has_value() || *state == cooler.device.value) continue;
+                cooler.device.value = *state;
+                coolerChanges.push_back(cooler.device);
+            }
+            changed |= !coolerChanges.empty();
+            mNextCoolerSample = now + (anyNear ? kFastInterval : kSlowInterval);
+        }
+        next = std::min(next, mNextCoolerSample);
+    }
+
+    if (changed) publish();
+
+    for (const auto& temperature : severityChanges) {
+        LOG(INFO) << temperature.name << " at " << temperature.value << "C, severity "
+                  << toString(temperature.throttlingStatus);
+        mOnSeverityChanged(temperature);
+    }
+    for (const auto& device : coolerChanges) mOnCoolingDeviceChanged(device);
+    return next;
+}
+
+}  // namespace aidl::android::hardware::thermal::impl::example
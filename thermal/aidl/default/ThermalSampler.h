@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/thermal/CoolingDevice.h>
+#include <aidl/android/hardware/thermal/Temperature.h>
+#include <aidl/android/hardware/thermal/TemperatureThreshold.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::hardware::thermal::impl::example {
+
+/**
+ * Samples the kernel thermal zones and cooling devices in the background.
+ *
+ * The sysfs nodes are discovered and opened once; each sample is a pread() on the cached fd.
+ * Sensors are sampled at a slow cadence while they are far from their thresholds and at a fast
+ * one when they get close or are throttling. The latest values are published as an immutable
+ * snapshot, so queries never touch sysfs.
+ *
+ * Severity changes are filtered with hysteresis: a sensor only leaves a severity once it drops
+ * below the threshold by the hysteresis of the zone's trip point, so noise around a threshold
+ * doesn't turn into a stream of notifications.
+ */
+class ThermalSampler {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using TemperatureListener = std::function<void(const Temperature&)>;
+    using CoolingDeviceListener = std::function<void(const CoolingDevice&)>;
+
+    struct Snapshot {
+        std::vector<Temperature> temperatures;
+        std::vector<CoolingDevice> coolingDevices;
+    };
+
+    /**
+     * Discovers the sensors and starts sampling them.
+     *
+     * \param root Directory holding the thermal_zone* and cooling_device* nodes
+     * \param onSeverityChanged Called from the sampler thread when the severity of a sensor
+     *                          changes
+     * \param onCoolingDeviceChanged Called from the sampler thread when the state of a cooling
+     *                               device changes
+     */
+    ThermalSampler(const std::string& root, TemperatureListener onSeverityChanged,
+                   CoolingDeviceListener onCoolingDeviceChanged);
+    ~ThermalSampler();
+
+    /** Latest values of all sensors and cooling devices. */
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+    /** Thresholds of the sensors, as read from the trip points at startup. */
+    const std::vector<TemperatureThreshold>& getThresholds() const { return mThresholds; }
+
+  private:
+    struct Sensor {
+        Temperature temperature;
+        ::android::base::unique_fd fd;
+        /** Hot thresholds, indexed by severity, NaN where there is none. */
+        std::vector<float> hotThresholds;
+        float hysteresis;
+        Clock::time_point nextSample;
+    };
+
+    struct Cooler {
+        CoolingDevice device;
+        ::android::base::unique_fd fd;
+    };
+
+    void discover(const std::string& root);
+    void addSensor(const std::string& zoneDir);
+    void addCooler(const std::string& deviceDir);
+
+    /** Samples the sensors that are due, returning when the next one is. */
+    Clock::time_point sample(Clock::time_point now);
+    /** Publishes the current values as the new snapshot. */
+    void publish();
+    ThrottlingSeverity severityOf(const Sensor& sensor, float value) const;
+    bool isNearThreshold(const Sensor& sensor) const;
+
+    const TemperatureListener mOnSeverityChanged;
+    const CoolingDeviceListener mOnCoolingDeviceChanged;
+
+    /** Sampler state, only touched by the sampler thread after construction. */
+    std::vector<Sensor> mSensors;
+    std::vector<Cooler> mCoolers;
+    Clock::time_point mNextCoolerSample;
+    std::vector<TemperatureThreshold> mThresholds;
+
+    mutable std::mutex mSnapshotLock;
+    /** Only held to swap or copy the pointer, never during sysfs I/O. */
+    std::shared_ptr<const Snapshot> mSnapshot GUARDED_BY(mSnapshotLock);
+
+    std::mutex mStopLock;
+    std::condition_variable mStopCv;
+    bool mStop GUARDED_BY(mStopLock) = false;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::thermal::impl::example
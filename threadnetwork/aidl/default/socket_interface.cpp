@@ -24,6 +24,7 @@
 
 #include <errno.h>
 #include <openthread/logging.h>
+#include <sys/epoll.h>
 #include <sys/inotify.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -31,6 +32,8 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <climits>
 #include <string>
 
 #include "common/code_utils.hpp"
@@ -47,6 +50,7 @@ SocketInterface::SocketInterface(const ot::Url::Url& aRadioUrl)
       mReceiveFrameContext(nullptr),
       mReceiveFrameBuffer(nullptr),
       mSockFd(-1),
+      mEpollFd(-1),
       mRadioUrl(aRadioUrl) {
     memset(&mInterfaceMetrics, 0, sizeof(mInterfaceMetrics));
     mInterfaceMetrics.mRcpInterfaceType = kSpinelInterfaceTypeVendor;
@@ -63,6 +67,16 @@ otError SocketInterface::Init(ReceiveFrameCallback aCallback, void* aCallbackCon
     mSockFd = OpenFile(mRadioUrl);
     VerifyOrExit(mSockFd != -1, error = OT_ERROR_FAILED);
 
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    VerifyOrDie(mEpollFd != -1, OT_EXIT_ERROR_ERRNO);
+    {
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLERR;
+        event.data.fd = mSockFd;
+        VerifyOrDie(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mSockFd, &event) == 0,
+                    OT_EXIT_ERROR_ERRNO);
+    }
+
     mReceiveFrameCallback = aCallback;
     mReceiveFrameContext = aCallbackContext;
     mReceiveFrameBuffer = &aFrameBuffer;
@@ -91,25 +105,18 @@ otError SocketInterface::SendFrame(const uint8_t* aFrame, uint16_t aLength) {
 
 otError SocketInterface::WaitForFrame(uint64_t aTimeoutUs) {
     otError error = OT_ERROR_NONE;
-    struct timeval timeout;
-    timeout.tv_sec = static_cast<time_t>(aTimeoutUs / US_PER_S);
-    timeout.tv_usec = static_cast<suseconds_t>(aTimeoutUs % US_PER_S);
-
-    fd_set readFds;
-    fd_set errorFds;
+    // epoll only has millisecond resolution, round up so that we never return early.
+    int timeoutMs = static_cast<int>(std::min<uint64_t>((aTimeoutUs + US_PER_MS - 1) / US_PER_MS,
+                                                        INT_MAX));
+    struct epoll_event event;
     int rval;
 
-    FD_ZERO(&readFds);
-    FD_ZERO(&errorFds);
-    FD_SET(mSockFd, &readFds);
-    FD_SET(mSockFd, &errorFds);
-
-    rval = TEMP_FAILURE_RETRY(select(mSockFd + 1, &readFds, nullptr, &errorFds, &timeout));
+    rval = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, &event, 1, timeoutMs));
 
     if (rval > 0) {
-        if (FD_ISSET(mSockFd, &readFds)) {
+        if (event.events & EPOLLIN) {
             Read();
-        } else if (FD_ISSET(mSockFd, &errorFds)) {
+        } else if (event.events & EPOLLERR) {
             DieNowWithMessage("RCP error", OT_EXIT_FAILURE);
         } else {
             DieNow(OT_EXIT_FAILURE);
@@ -150,15 +157,23 @@ void SocketInterface::Process(const void* aMainloopContext) {
 void SocketInterface::Read(void) {
     uint8_t buffer[kMaxFrameSize];
 
-    ssize_t rval = TEMP_FAILURE_RETRY(read(mSockFd, buffer, sizeof(buffer)));
+    // Each read returns a single frame, as the socket is SOCK_SEQPACKET. Drain the frames
+    // already queued rather than waiting for another wakeup for each of them.
+    for (uint16_t frames = 0; frames < kMaxFramesPerRead; frames++) {
+        ssize_t rval = TEMP_FAILURE_RETRY(recv(mSockFd, buffer, sizeof(buffer),
+                                               frames == 0 ? 0 : MSG_DONTWAIT));
 
-    if (rval > 0) {
-        ProcessReceivedData(buffer, static_cast<uint16_t>(rval));
-    } else if (rval < 0) {
-        DieNow(OT_EXIT_ERROR_ERRNO);
-    } else {
-        otLogCritPlat("Socket connection is closed by remote.");
-        exit(OT_EXIT_FAILURE);
+        if (rval > 0) {
+            ProcessReceivedData(buffer, static_cast<uint16_t>(rval));
+        } else if (rval < 0) {
+            if (frames > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            DieNow(OT_EXIT_ERROR_ERRNO);
+        } else {
+            otLogCritPlat("Socket connection is closed by remote.");
+            exit(OT_EXIT_FAILURE);
+        }
     }
 }
 
@@ -169,15 +184,16 @@ void SocketInterface::Write(const uint8_t* aFrame, uint16_t aLength) {
 }
 
 void SocketInterface::ProcessReceivedData(const uint8_t* aBuffer, uint16_t aLength) {
-    while (aLength--) {
-        uint8_t byte = *aBuffer++;
-        if (mReceiveFrameBuffer->CanWrite(sizeof(uint8_t))) {
-            IgnoreError(mReceiveFrameBuffer->WriteByte(byte));
-        } else {
-            HandleSocketFrame(this, OT_ERROR_NO_BUFS);
-            return;
-        }
+    // The whole frame is written at once, so a frame that doesn't fit isn't written at all.
+    if (!mReceiveFrameBuffer->CanWrite(aLength)) {
+        HandleSocketFrame(this, OT_ERROR_NO_BUFS);
+        return;
     }
+
+    uint16_t length = mReceiveFrameBuffer->GetLength();
+    memcpy(mReceiveFrameBuffer->GetFrame() + length, aBuffer, aLength);
+    IgnoreError(mReceiveFrameBuffer->SetLength(length + aLength));
+
     HandleSocketFrame(this, OT_ERROR_NONE);
 }
 
@@ -225,6 +241,11 @@ exit:
 void SocketInterface::CloseFile(void) {
     VerifyOrExit(mSockFd != -1);
 
+    if (mEpollFd != -1) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
     VerifyOrExit(0 == close(mSockFd), otLogCritPlat("close(): errno=%s", strerror(errno)));
     VerifyOrExit(wait(nullptr) != -1 || errno == ECHILD,
                  otLogCritPlat("wait(): errno=%s", strerror(errno)));
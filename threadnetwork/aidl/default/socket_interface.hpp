@@ -236,6 +236,7 @@ class SocketInterface : public ot::Spinel::SpinelInterface {
     enum {
         kMaxSelectTimeMs = 2000,  ///< Maximum wait time in Milliseconds for file
                                   ///< descriptor to become available.
+        kMaxFramesPerRead = 16,   ///< Maximum number of frames handled per `Read()`.
     };
 
     ReceiveFrameCallback mReceiveFrameCallback;
@@ -243,6 +244,7 @@ class SocketInterface : public ot::Spinel::SpinelInterface {
     RxFrameBuffer* mReceiveFrameBuffer;
 
     int mSockFd;
+    int mEpollFd;
     const ot::Url::Url& mRadioUrl;
 
     otRcpInterfaceMetrics mInterfaceMetrics;
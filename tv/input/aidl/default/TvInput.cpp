@@ -120,39 +120,53 @@ void TvInput::init() {
                                          NativeHandle* _aidl_return) {
     ALOGV("%s", __FUNCTION__);
 
-    if (mStreamConfigs.count(in_deviceId) == 0 ||
-        mStreamConfigs[in_deviceId].count(in_streamId) == 0) {
+    shared_ptr<TvStreamConfigWrapper> stream = findStreamConfig(in_deviceId, in_streamId);
+    if (stream == nullptr) {
         ALOGW("Stream with device id %d, stream id %d isn't available", in_deviceId, in_streamId);
         return ::ndk::ScopedAStatus::fromServiceSpecificError(STATUS_INVALID_ARGUMENTS);
     }
-    if (mStreamConfigs[in_deviceId][in_streamId]->isOpen) {
+    if (stream->isOpen) {
         ALOGW("Stream with device id %d, stream id %d is already opened", in_deviceId, in_streamId);
         return ::ndk::ScopedAStatus::fromServiceSpecificError(STATUS_INVALID_STATE);
     }
-    mStreamConfigs[in_deviceId][in_streamId]->handle = createNativeHandle(in_streamId);
-    *_aidl_return = makeToAidl(mStreamConfigs[in_deviceId][in_streamId]->handle);
-    mStreamConfigs[in_deviceId][in_streamId]->isOpen = true;
+    stream->handle = createNativeHandle(in_streamId);
+    if (stream->handle == nullptr) {
+        return ::ndk::ScopedAStatus::fromServiceSpecificError(STATUS_UNKNOWN);
+    }
+    *_aidl_return = makeToAidl(stream->handle);
+    stream->isOpen = true;
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus TvInput::closeStream(int32_t in_deviceId, int32_t in_streamId) {
     ALOGV("%s", __FUNCTION__);
 
-    if (mStreamConfigs.count(in_deviceId) == 0 ||
-        mStreamConfigs[in_deviceId].count(in_streamId) == 0) {
+    shared_ptr<TvStreamConfigWrapper> stream = findStreamConfig(in_deviceId, in_streamId);
+    if (stream == nullptr) {
         ALOGW("Stream with device id %d, stream id %d isn't available", in_deviceId, in_streamId);
         return ::ndk::ScopedAStatus::fromServiceSpecificError(STATUS_INVALID_ARGUMENTS);
     }
-    if (!mStreamConfigs[in_deviceId][in_streamId]->isOpen) {
+    if (!stream->isOpen) {
         ALOGW("Stream with device id %d, stream id %d is already closed", in_deviceId, in_streamId);
         return ::ndk::ScopedAStatus::fromServiceSpecificError(STATUS_INVALID_STATE);
     }
-    native_handle_delete(mStreamConfigs[in_deviceId][in_streamId]->handle);
-    mStreamConfigs[in_deviceId][in_streamId]->handle = nullptr;
-    mStreamConfigs[in_deviceId][in_streamId]->isOpen = false;
+    // The handle owns the fd it was created with, makeToAidl handed out a duplicate of it.
+    native_handle_close(stream->handle);
+    native_handle_delete(stream->handle);
+    stream->handle = nullptr;
+    stream->isOpen = false;
     return ::ndk::ScopedAStatus::ok();
 }
 
+shared_ptr<TvStreamConfigWrapper> TvInput::findStreamConfig(int32_t deviceId, int32_t streamId) {
+    auto device = mStreamConfigs.find(deviceId);
+    if (device == mStreamConfigs.end()) {
+        return nullptr;
+    }
+    auto stream = device->second.find(streamId);
+    return stream == device->second.end() ? nullptr : stream->second;
+}
+
 native_handle_t* TvInput::createNativeHandle(int fd) {
     native_handle_t* handle = native_handle_create(1, 1);
     if (handle == nullptr) {
@@ -160,6 +174,11 @@ native_handle_t* TvInput::createNativeHandle(int fd) {
         return nullptr;
     }
     handle->data[0] = dup(0);
+    if (handle->data[0] < 0) {
+        ALOGE("[TVInput] Failed to dup fd %d", errno);
+        native_handle_delete(handle);
+        return nullptr;
+    }
     handle->data[1] = fd;
     return handle;
 }
@@ -61,6 +61,7 @@ class TvInput : public BnTvInput {
 
   private:
     native_handle_t* createNativeHandle(int fd);
+    shared_ptr<TvStreamConfigWrapper> findStreamConfig(int32_t deviceId, int32_t streamId);
 
     shared_ptr<ITvInputCallback> mCallback;
     map<int32_t, shared_ptr<TvInputDeviceInfoWrapper>> mDeviceInfos;
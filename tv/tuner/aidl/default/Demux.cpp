@@ -21,9 +21,14 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 
 #include <fmq/AidlMessageQueue.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include <utils/Log.h>
+#include <algorithm>
+#include <chrono>
 #include <thread>
 #include "Demux.h"
+#include "Descrambler.h"
 
 namespace aidl {
 namespace android {
@@ -45,6 +50,8 @@ using AidlMQDesc = MQDescriptor<int8_t, SynchronizedReadWrite>;
 Demux::Demux(int32_t demuxId, uint32_t filterTypes) {
     mDemuxId = demuxId;
     mFilterTypes = filterTypes;
+    mPlaybackFiltersByTpid.resize(TS_PID_COUNT);
+    mKeySlotsByPid.resize(TS_PID_COUNT);
 }
 
 void Demux::setTunerService(std::shared_ptr<Tuner> tuner) {
@@ -120,71 +127,132 @@ void Demux::setIptvThreadRunning(bool isIptvThreadRunning) {
     mIsIptvThreadRunningCv.notify_all();
 }
 
-void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, void* buf) {
-    Timer *timer, *fullBufferTimer;
+void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* streamer) {
     bool isTuneBytePushedToDvr = false;
+    // Reads dropped while the ring is full still drain the socket
+    vector<int8_t> dropBuffer;
     while (true) {
-        std::unique_lock<std::mutex> lock(mIsIptvThreadRunningMutex);
-        mIsIptvThreadRunningCv.wait(
-                lock, [this] { return mIsIptvReadThreadRunning || mIsIptvReadThreadTerminated; });
-        if (mIsIptvReadThreadTerminated) {
-            ALOGI("[Demux] IPTV reading thread for playback terminated");
-            break;
+        {
+            std::unique_lock<std::mutex> lock(mIsIptvThreadRunningMutex);
+            mIsIptvThreadRunningCv.wait(lock, [this] {
+                return mIsIptvReadThreadRunning || mIsIptvReadThreadTerminated;
+            });
+            if (mIsIptvReadThreadTerminated) {
+                ALOGI("[Demux] IPTV reading thread for playback terminated");
+                break;
+            }
         }
-        if (mIsIptvDvrFMQFull &&
-            fullBufferTimer->get_elapsed_time_ms() > IPTV_PLAYBACK_BUFFER_TIMEOUT) {
-            ALOGE("DVR FMQ has not been flushed within timeout of %d ms",
-                  IPTV_PLAYBACK_BUFFER_TIMEOUT);
-            delete fullBufferTimer;
-            break;
+
+        uint32_t head = mIptvInputHead.load(std::memory_order_relaxed);
+        bool isRingFull =
+                head - mIptvInputTail.load(std::memory_order_acquire) == IPTV_INPUT_BUFFER_COUNT;
+        IptvInputBuffer& buffer = mIptvInputBuffers[head % IPTV_INPUT_BUFFER_COUNT];
+        if (isRingFull) {
+            dropBuffer.resize(IPTV_BUFFER_SIZE);
         }
-        timer = new Timer();
-        ssize_t bytes_read;
+        int8_t* data = isRingFull ? dropBuffer.data() : buffer.data.data();
+        size_t offset = 0;
         void* tuneByteBuffer = mFrontend->getTuneByteBuffer();
-        if (!isTuneBytePushedToDvr && tuneByteBuffer != nullptr) {
-            memcpy(buf, tuneByteBuffer, 1);
-            char* offsetBuf = (char*)buf + 1;
-            bytes_read = interface->read_stream(streamer, (void*)offsetBuf, IPTV_BUFFER_SIZE - 1,
-                                                IPTV_PLAYBACK_TIMEOUT);
+        if (!isTuneBytePushedToDvr && !isRingFull && tuneByteBuffer != nullptr) {
+            memcpy(data, tuneByteBuffer, 1);
+            offset = 1;
             isTuneBytePushedToDvr = true;
-        } else {
-            bytes_read =
-                    interface->read_stream(streamer, buf, IPTV_BUFFER_SIZE, IPTV_PLAYBACK_TIMEOUT);
         }
 
+        auto readStart = std::chrono::steady_clock::now();
+        ssize_t bytes_read = interface->read_stream(
+                streamer, data + offset, IPTV_BUFFER_SIZE - offset, IPTV_PLAYBACK_TIMEOUT);
+        int64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - readStart)
+                                    .count();
         if (bytes_read <= 0) {
-            double elapsed_time = timer->get_elapsed_time_ms();
+            double elapsed_time = latencyUs / 1000.0;
             if (elapsed_time > IPTV_PLAYBACK_TIMEOUT) {
                 ALOGE("[Demux] timeout reached - elapsed_time: %f, timeout: %d", elapsed_time,
                       IPTV_PLAYBACK_TIMEOUT);
             }
             ALOGE("[Demux] Cannot read data from the socket");
-            delete timer;
+            mIptvInputStats.readErrors++;
             break;
         }
 
-        delete timer;
-        ALOGI("Number of bytes read: %zd", bytes_read);
-        int result = mDvrPlayback->writePlaybackFMQ(buf, bytes_read);
+        mIptvInputStats.reads++;
+        mIptvInputStats.bytes += bytes_read;
+        mIptvInputStats.totalReadLatencyUs += latencyUs;
+        if (latencyUs > mIptvInputStats.maxReadLatencyUs) {
+            mIptvInputStats.maxReadLatencyUs = latencyUs;
+        }
+        ALOGV("Number of bytes read: %zd", bytes_read);
+        if (isRingFull) {
+            mIptvInputStats.droppedReads++;
+            continue;
+        }
 
+        buffer.size = offset + bytes_read;
+        mIptvInputHead.store(head + 1, std::memory_order_release);
+        {
+            // Taken so that the write thread can not miss the wake up
+            std::lock_guard<std::mutex> lock(mIptvInputMutex);
+        }
+        mIptvInputCv.notify_one();
+    }
+    terminateIptvInput();
+}
+
+void Demux::frontendIptvOutputThreadLoop() {
+    std::unique_ptr<Timer> fullBufferTimer;
+    while (!mIsIptvReadThreadTerminated) {
+        uint32_t tail = mIptvInputTail.load(std::memory_order_relaxed);
+        if (tail == mIptvInputHead.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> lock(mIptvInputMutex);
+            mIptvInputCv.wait(lock, [this, tail] {
+                return mIptvInputHead.load(std::memory_order_acquire) != tail ||
+                       mIsIptvReadThreadTerminated;
+            });
+            continue;
+        }
+
+        IptvInputBuffer& buffer = mIptvInputBuffers[tail % IPTV_INPUT_BUFFER_COUNT];
+        int result = mDvrPlayback->writePlaybackFMQ(buffer.data.data(), buffer.size);
         switch (result) {
             case DVR_WRITE_FAILURE_REASON_FMQ_FULL:
-                if (!mIsIptvDvrFMQFull) {
-                    mIsIptvDvrFMQFull = true;
-                    fullBufferTimer = new Timer();
+                if (fullBufferTimer == nullptr) {
+                    fullBufferTimer = std::make_unique<Timer>();
+                    mIptvInputStats.fmqFullCount++;
+                    ALOGI("Waiting for client to flush DVR FMQ.");
+                } else if (fullBufferTimer->get_elapsed_time_ms() > IPTV_PLAYBACK_BUFFER_TIMEOUT) {
+                    ALOGE("DVR FMQ has not been flushed within timeout of %d ms",
+                          IPTV_PLAYBACK_BUFFER_TIMEOUT);
+                    terminateIptvInput();
+                    return;
                 }
-                ALOGI("Waiting for client to flush DVR FMQ.");
-                break;
+                // Keep the buffer and retry, the next reads are queued meanwhile
+                usleep(IPTV_FMQ_RETRY_INTERVAL * 1000);
+                continue;
             case DVR_WRITE_FAILURE_REASON_UNKNOWN:
                 ALOGE("Failed to write data into DVR FMQ for unknown reason");
                 break;
             case DVR_WRITE_SUCCESS:
-                ALOGI("Wrote %zd bytes to DVR FMQ", bytes_read);
+                ALOGV("Wrote %zu bytes to DVR FMQ", buffer.size);
                 break;
             default:
                 ALOGI("Invalid DVR Status");
         }
+        fullBufferTimer = nullptr;
+        mIptvInputTail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+void Demux::terminateIptvInput() {
+    {
+        std::lock_guard<std::mutex> lock(mIsIptvThreadRunningMutex);
+        mIsIptvReadThreadTerminated = true;
     }
+    mIsIptvThreadRunningCv.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(mIptvInputMutex);
+    }
+    mIptvInputCv.notify_all();
 }
 
 ::ndk::ScopedAStatus Demux::setFrontendDataSource(int32_t in_frontendId) {
@@ -248,14 +316,15 @@ void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* str
         }
         stopIptvFrontendInput();
         mIsIptvReadThreadTerminated = false;
-        void* buf = malloc(sizeof(char) * IPTV_BUFFER_SIZE);
-        if (buf == nullptr) {
-            ALOGE("[Demux] Buffer allocation failed");
-            return ::ndk::ScopedAStatus::fromServiceSpecificError(
-                    static_cast<int32_t>(Result::INVALID_STATE));
+        mIptvInputBuffers.resize(IPTV_INPUT_BUFFER_COUNT);
+        for (auto& buffer : mIptvInputBuffers) {
+            buffer.data.resize(IPTV_BUFFER_SIZE);
         }
+        mIptvInputHead = 0;
+        mIptvInputTail = 0;
         mDemuxIptvReadThread =
-                std::thread(&Demux::frontendIptvInputThreadLoop, this, interface, streamer, buf);
+                std::thread(&Demux::frontendIptvInputThreadLoop, this, interface, streamer);
+        mDemuxIptvWriteThread = std::thread(&Demux::frontendIptvOutputThreadLoop, this);
     }
     return ::ndk::ScopedAStatus::ok();
 }
@@ -373,6 +442,7 @@ void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* str
 
     stopFrontendInput();
     stopIptvFrontendInput();
+    mFilterExecutor.removeAll();
 
     set<int64_t>::iterator it;
     for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
@@ -380,6 +450,13 @@ void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* str
     }
     mPlaybackFilterIds.clear();
     mRecordFilterIds.clear();
+    {
+        std::lock_guard<std::mutex> lock(mFilterTpidLock);
+        for (auto& filters : mPlaybackFiltersByTpid) {
+            filters.clear();
+        }
+        mFilterTpids.clear();
+    }
     mFilters.clear();
     mLastUsedFilterId = -1;
     if (mTuner != nullptr) {
@@ -407,9 +484,14 @@ void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* str
 ::ndk::ScopedAStatus Demux::removeFilter(int64_t filterId) {
     ALOGV("%s", __FUNCTION__);
 
+    mFilterExecutor.remove(filterId);
     if (mDvrPlayback != nullptr) {
         mDvrPlayback->removePlaybackFilter(filterId);
     }
+    {
+        std::lock_guard<std::mutex> lock(mFilterTpidLock);
+        removeFilterTpidLocked(filterId);
+    }
     mPlaybackFilterIds.erase(filterId);
     mRecordFilterIds.erase(filterId);
     mFilters.erase(filterId);
@@ -417,31 +499,129 @@ void Demux::frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* str
     return ::ndk::ScopedAStatus::ok();
 }
 
-void Demux::startBroadcastTsFilter(vector<int8_t> data) {
-    set<int64_t>::iterator it;
-    uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-    if (DEBUG_DEMUX) {
-        ALOGW("[Demux] start ts filter pid: %d", pid);
+void Demux::setFilterTpid(int64_t filterId, uint16_t tpid) {
+    std::lock_guard<std::mutex> lock(mFilterTpidLock);
+    removeFilterTpidLocked(filterId);
+    mFilterTpids[filterId] = tpid;
+    auto filter = mFilters.find(filterId);
+    if (filter != mFilters.end() && mPlaybackFilterIds.count(filterId) != 0) {
+        mPlaybackFiltersByTpid[tpid % TS_PID_COUNT].push_back(filter->second);
     }
-    for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        if (pid == mFilters[*it]->getTpid()) {
-            mFilters[*it]->updateFilterOutput(data);
+}
+
+void Demux::removeFilterTpidLocked(int64_t filterId) {
+    auto tpid = mFilterTpids.find(filterId);
+    if (tpid == mFilterTpids.end()) {
+        return;
+    }
+    auto filter = mFilters.find(filterId);
+    if (filter != mFilters.end()) {
+        vector<std::shared_ptr<Filter>>& filters =
+                mPlaybackFiltersByTpid[tpid->second % TS_PID_COUNT];
+        filters.erase(std::remove(filters.begin(), filters.end(), filter->second), filters.end());
+    }
+    mFilterTpids.erase(tpid);
+}
+
+void Demux::startBroadcastTsFilter(const TsPacketBatch& batch, size_t packetSize) {
+    std::lock_guard<std::mutex> lock(mFilterTpidLock);
+    for (size_t i = 0; i < batch.packets.size(); i++) {
+        if (DEBUG_DEMUX) {
+            ALOGW("[Demux] start ts filter pid: %d", batch.pids[i]);
+        }
+        for (const auto& filter : mPlaybackFiltersByTpid[batch.pids[i]]) {
+            filter->updateFilterOutput(batch.packets[i], packetSize);
         }
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data) {
+void Demux::setPidKeySlot(uint16_t pid, const std::shared_ptr<DescramblerKeySlot>& keySlot,
+                          const std::shared_ptr<DescramblerKeySlot>& owner) {
+    std::lock_guard<std::mutex> lock(mKeySlotLock);
+    std::shared_ptr<DescramblerKeySlot>& slot = mKeySlotsByPid[pid % TS_PID_COUNT];
+    if (keySlot == nullptr && slot != owner) {
+        return;
+    }
+    if (slot == nullptr && keySlot != nullptr) {
+        mKeySlotCount++;
+    } else if (slot != nullptr && keySlot == nullptr) {
+        mKeySlotCount--;
+    }
+    slot = keySlot;
+}
+
+void Demux::descrambleTsPackets(TsPacketBatch* batch, size_t packetSize) {
+    if (mKeySlotCount == 0) {
+        return;
+    }
+    const size_t syncOffset = packetSize == 192 ? 4 : 0;
+    std::lock_guard<std::mutex> lock(mKeySlotLock);
+
+    // Count the packets to copy first, so the copies do not move while the batch points to them
+    size_t scrambledCount = 0;
+    for (size_t i = 0; i < batch->packets.size(); i++) {
+        if ((batch->packets[i][syncOffset + 3] & 0xc0) != 0 &&
+            mKeySlotsByPid[batch->pids[i]] != nullptr) {
+            scrambledCount++;
+        }
+    }
+    if (scrambledCount == 0) {
+        return;
+    }
+    if (mDescrambledPackets.size() < scrambledCount * packetSize) {
+        mDescrambledPackets.resize(scrambledCount * packetSize);
+    }
+
+    // Descramble the copies in runs of consecutive packets of the same key slot
+    int8_t* copy = mDescrambledPackets.data();
+    DescramblerKeySlot* runSlot = nullptr;
+    mDescrambleRun.clear();
+    for (size_t i = 0; i < batch->packets.size(); i++) {
+        DescramblerKeySlot* slot = mKeySlotsByPid[batch->pids[i]].get();
+        if ((batch->packets[i][syncOffset + 3] & 0xc0) == 0 || slot == nullptr) {
+            continue;
+        }
+        if (slot != runSlot && !mDescrambleRun.empty()) {
+            runSlot->descramble(mDescrambleRun.data(), mDescrambleRun.size(), syncOffset);
+            mDescrambleRun.clear();
+        }
+        runSlot = slot;
+        memcpy(copy, batch->packets[i], packetSize);
+        batch->packets[i] = copy;
+        mDescrambleRun.push_back(copy);
+        copy += packetSize;
+    }
+    if (!mDescrambleRun.empty()) {
+        runSlot->descramble(mDescrambleRun.data(), mDescrambleRun.size(), syncOffset);
+    }
+}
+
+void Demux::sendFrontendInputToRecord(const int8_t* data, size_t size) {
     set<int64_t>::iterator it;
     if (DEBUG_DEMUX) {
         ALOGW("[Demux] update record filter output");
     }
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
-        mFilters[*it]->updateRecordOutput(data);
+        mFilters[*it]->updateRecordOutput(data, size);
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts) {
-    sendFrontendInputToRecord(data);
+void Demux::sendFrontendInputToRecord(const TsPacketBatch& batch, size_t packetSize) {
+    if (mDvrRecord == nullptr || mRecordFilterIds.empty()) {
+        return;
+    }
+    vector<std::shared_ptr<Filter>> filters;
+    filters.reserve(mRecordFilterIds.size());
+    for (int64_t filterId : mRecordFilterIds) {
+        filters.push_back(mFilters[filterId]);
+    }
+    if (!mDvrRecord->writeRecordFMQ(batch, packetSize, filters)) {
+        ALOGD("[Demux] dvr fails to write into record FMQ.");
+    }
+}
+
+void Demux::sendFrontendInputToRecord(const vector<int8_t>& data, uint16_t pid, uint64_t pts) {
+    sendFrontendInputToRecord(data.data(), data.size());
     set<int64_t>::iterator it;
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
         if (pid == mFilters[*it]->getTpid()) {
@@ -452,38 +632,40 @@ void Demux::sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_
 
 bool Demux::startBroadcastFilterDispatcher() {
     set<int64_t>::iterator it;
+    bool result = true;
 
     // Handle the output data per filter type
     for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        if (!mFilters[*it]->startFilterHandler().isOk()) {
-            return false;
+        if (!mFilterExecutor.schedule(*it, mFilters[*it], false /*isRecord*/)) {
+            result = false;
         }
     }
 
-    return true;
+    return result;
 }
 
 bool Demux::startRecordFilterDispatcher() {
     set<int64_t>::iterator it;
+    bool result = true;
 
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
-        if (!mFilters[*it]->startRecordFilterHandler().isOk()) {
-            return false;
+        if (!mFilterExecutor.schedule(*it, mFilters[*it], true /*isRecord*/)) {
+            result = false;
         }
     }
 
-    return true;
+    return result;
 }
 
-::ndk::ScopedAStatus Demux::startFilterHandler(int64_t filterId) {
-    return mFilters[filterId]->startFilterHandler();
+void Demux::waitFilterHandlers() {
+    mFilterExecutor.waitIdle();
 }
 
-void Demux::updateFilterOutput(int64_t filterId, vector<int8_t> data) {
-    mFilters[filterId]->updateFilterOutput(data);
+void Demux::updateFilterOutput(int64_t filterId, const vector<int8_t>& data) {
+    mFilters[filterId]->updateFilterOutput(data.data(), data.size());
 }
 
-void Demux::updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts) {
+void Demux::updateMediaFilterOutput(int64_t filterId, const vector<int8_t>& data, uint64_t pts) {
     updateFilterOutput(filterId, data);
     mFilters[filterId]->updatePts(pts);
 }
@@ -570,11 +752,13 @@ void Demux::stopFrontendInput() {
 
 void Demux::stopIptvFrontendInput() {
     ALOGD("[Demux] stop iptv frontend on demux");
+    terminateIptvInput();
     if (mDemuxIptvReadThread.joinable()) {
-        mIsIptvReadThreadTerminated = true;
-        mIsIptvThreadRunningCv.notify_all();
         mDemuxIptvReadThread.join();
     }
+    if (mDemuxIptvWriteThread.joinable()) {
+        mDemuxIptvWriteThread.join();
+    }
 }
 
 void Demux::setIsRecording(bool isRecording) {
@@ -613,9 +797,41 @@ binder_status_t Demux::dump(int fd, const char** args, uint32_t numArgs) {
             mDvrRecord->dump(fd, args, numArgs);
         }
     }
+    if (mFrontend != nullptr && mFrontend->getFrontendType() == FrontendType::IPTV) {
+        dumpIptvInput(fd);
+    }
     return STATUS_OK;
 }
 
+void Demux::dumpIptvInput(int fd) {
+    dprintf(fd, "  IptvInput:\n");
+    uint64_t reads = mIptvInputStats.reads;
+    dprintf(fd, "    reads: %" PRIu64 ", bytes: %" PRIu64 "\n", reads,
+            mIptvInputStats.bytes.load());
+    dprintf(fd, "    read errors: %" PRIu64 ", dropped reads: %" PRIu64 "\n",
+            mIptvInputStats.readErrors.load(), mIptvInputStats.droppedReads.load());
+    dprintf(fd, "    DVR FMQ full: %" PRIu64 ", queued reads: %u\n",
+            mIptvInputStats.fmqFullCount.load(), mIptvInputHead - mIptvInputTail);
+    dprintf(fd, "    plugin read latency: average %" PRId64 " us, max %" PRId64 " us\n",
+            reads > 0 ? mIptvInputStats.totalReadLatencyUs / static_cast<int64_t>(reads) : 0,
+            mIptvInputStats.maxReadLatencyUs.load());
+
+    // The packet loss is counted by the plugin, which receives the datagrams
+    dtv_plugin* interface = mFrontend->getIptvPluginInterface();
+    dtv_streamer* streamer = mFrontend->getIptvPluginStreamer();
+    if (interface == nullptr || streamer == nullptr || interface->get_property == nullptr) {
+        return;
+    }
+    int size = interface->get_property(streamer, PROPERTY_STATISTICS, nullptr, 0);
+    if (size <= 0) {
+        return;
+    }
+    vector<char> statistics(size);
+    if (interface->get_property(streamer, PROPERTY_STATISTICS, statistics.data(), size) >= 0) {
+        dprintf(fd, "    plugin statistics: %.*s\n", size, statistics.data());
+    }
+}
+
 bool Demux::attachRecordFilter(int64_t filterId) {
     if (mFilters[filterId] == nullptr || mDvrRecord == nullptr ||
         !mFilters[filterId]->isRecordFilter()) {
@@ -22,11 +22,14 @@
 #include <fmq/AidlMessageQueue.h>
 #include <math.h>
 #include <atomic>
+#include <mutex>
 #include <set>
 #include <thread>
+#include <vector>
 
 #include "Dvr.h"
 #include "Filter.h"
+#include "FilterExecutor.h"
 #include "Frontend.h"
 #include "TimeFilter.h"
 #include "Timer.h"
@@ -50,14 +53,22 @@ using FilterMQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
 using AidlMQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
 using AidlMQDesc = MQDescriptor<int8_t, SynchronizedReadWrite>;
 
+class DescramblerKeySlot;
 class Dvr;
 class Filter;
 class Frontend;
 class TimeFilter;
 class Tuner;
+struct TsPacketBatch;
+
+// Number of the PIDs of TS packets, which have 13 bits
+const size_t TS_PID_COUNT = 8192;
 
 const int IPTV_PLAYBACK_TIMEOUT = 20;            // ms
 const int IPTV_PLAYBACK_BUFFER_TIMEOUT = 20000;  // ms
+// Reads of the IPTV input queued between the plugin and the DVR FMQ
+const uint32_t IPTV_INPUT_BUFFER_COUNT = 16;
+const int IPTV_FMQ_RETRY_INTERVAL = 2;  // ms
 
 class DvrPlaybackCallback : public BnDvrCallback {
   public:
@@ -99,25 +110,60 @@ class Demux : public BnDemux {
     ::ndk::ScopedAStatus removeFilter(int64_t filterId);
     bool attachRecordFilter(int64_t filterId);
     bool detachRecordFilter(int64_t filterId);
-    ::ndk::ScopedAStatus startFilterHandler(int64_t filterId);
-    void updateFilterOutput(int64_t filterId, vector<int8_t> data);
-    void updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts);
+    void updateFilterOutput(int64_t filterId, const vector<int8_t>& data);
+    void updateMediaFilterOutput(int64_t filterId, const vector<int8_t>& data, uint64_t pts);
     uint16_t getFilterTpid(int64_t filterId);
+    /**
+     * Called when a TS filter is configured with the PID 'tpid', to dispatch the TS packets of
+     * that PID to the filter if it is a playback filter.
+     */
+    void setFilterTpid(int64_t filterId, uint16_t tpid);
     void setIsRecording(bool isRecording);
     bool isRecording();
     void startFrontendInputLoop();
-    void frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* streamer, void* buf);
+    /**
+     * The IPTV input runs in two stages: the read thread keeps reading the plugin stream into
+     * the input buffers, and the write thread writes them into the DVR FMQ, so the reads are
+     * not held up while the client flushes the DVR.
+     */
+    void frontendIptvInputThreadLoop(dtv_plugin* interface, dtv_streamer* streamer);
+    void frontendIptvOutputThreadLoop();
 
     /**
      * A dispatcher to read and dispatch input data to all the started filters.
      * Each filter handler handles the data filtering/output writing/filterEvent updating.
      * Note that recording filters are not included.
+     *
+     * The handlers run on the filter executor, waitFilterHandlers waits for them.
      */
     bool startBroadcastFilterDispatcher();
-    void startBroadcastTsFilter(vector<int8_t> data);
+    void waitFilterHandlers();
+    /**
+     * Appends the TS packets of 'packetSize' bytes of 'batch' to the output of the playback
+     * filters of their PID. A packet is copied once, into the output of each filter.
+     */
+    void startBroadcastTsFilter(const TsPacketBatch& batch, size_t packetSize);
+
+    /**
+     * Descrambles the TS packets of 'pid' with 'keySlot' from now on. A null 'keySlot' stops
+     * descrambling the PID, unless another descrambler than 'owner' took it over in between.
+     */
+    void setPidKeySlot(uint16_t pid, const std::shared_ptr<DescramblerKeySlot>& keySlot,
+                       const std::shared_ptr<DescramblerKeySlot>& owner);
+    /**
+     * The descrambling stage, between the ingest of a batch and its dispatch to the filters:
+     * points the scrambled TS packets of 'packetSize' bytes of 'batch' whose PID has a key
+     * slot to descrambled copies. The input FMQ is left as it is.
+     */
+    void descrambleTsPackets(TsPacketBatch* batch, size_t packetSize);
 
-    void sendFrontendInputToRecord(vector<int8_t> data);
-    void sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts);
+    void sendFrontendInputToRecord(const int8_t* data, size_t size);
+    /**
+     * Writes the TS packets of 'packetSize' bytes of 'batch' straight into the record DVR FMQ,
+     * and indexes them for the record filters on the way.
+     */
+    void sendFrontendInputToRecord(const TsPacketBatch& batch, size_t packetSize);
+    void sendFrontendInputToRecord(const vector<int8_t>& data, uint16_t pid, uint64_t pts);
     bool startRecordFilterDispatcher();
 
     void getDemuxInfo(DemuxInfo* demuxInfo);
@@ -131,11 +177,15 @@ class Demux : public BnDemux {
      */
     void setIptvThreadRunning(bool isIptvThreadRunning);
     /**
-     * Stops IPTV playback reading thread.
+     * Stops IPTV playback reading and writing threads.
      */
     void stopIptvFrontendInput();
 
   private:
+    // Ends both IPTV input threads
+    void terminateIptvInput();
+    void dumpIptvInput(int fd);
+
     // Tuner service
     std::shared_ptr<Tuner> mTuner;
 
@@ -160,6 +210,7 @@ class Demux : public BnDemux {
      */
     void deleteEventFlag();
     bool readDataFromMQ();
+    void removeFilterTpidLocked(int64_t filterId);
 
     int32_t mDemuxId = -1;
     int32_t mCiCamId;
@@ -184,6 +235,27 @@ class Demux : public BnDemux {
      * The array number is the filter ID.
      */
     std::map<int64_t, std::shared_ptr<Filter>> mFilters;
+    /**
+     * The playback filters by the PID of the TS packets they take, TS_PID_COUNT lists, and the
+     * PIDs of the configured TS filters. Updated on filter configure and close, and read for each
+     * TS packet.
+     */
+    std::vector<std::vector<std::shared_ptr<Filter>>> mPlaybackFiltersByTpid;
+    std::map<int64_t, uint16_t> mFilterTpids;
+    std::mutex mFilterTpidLock;
+
+    /**
+     * The key slots of the descramblers by the PID of the TS packets they descramble,
+     * TS_PID_COUNT of them, and the number of PIDs with one, so that clear streams skip the
+     * descrambling stage.
+     */
+    std::vector<std::shared_ptr<DescramblerKeySlot>> mKeySlotsByPid;
+    std::atomic<size_t> mKeySlotCount = 0;
+    std::mutex mKeySlotLock;
+    // The descrambled copies of the packets of the batch being dispatched, and their runs by
+    // key slot, reused across batches
+    vector<int8_t> mDescrambledPackets;
+    vector<int8_t*> mDescrambleRun;
 
     /**
      * Local reference to the opened Timer Filter instance.
@@ -199,9 +271,35 @@ class Demux : public BnDemux {
     // Thread handlers
     std::thread mFrontendInputThread;
     std::thread mDemuxIptvReadThread;
+    std::thread mDemuxIptvWriteThread;
 
-    // track whether the DVR FMQ for IPTV Playback is full
-    bool mIsIptvDvrFMQFull = false;
+    /**
+     * The reads of the IPTV input, handed from the read thread to the write thread through a
+     * single producer single consumer ring. Only the read thread advances mIptvInputHead and
+     * only the write thread advances mIptvInputTail, the buffers in between are queued.
+     */
+    struct IptvInputBuffer {
+        vector<int8_t> data;
+        size_t size = 0;
+    };
+    vector<IptvInputBuffer> mIptvInputBuffers;
+    std::atomic<uint32_t> mIptvInputHead = 0;
+    std::atomic<uint32_t> mIptvInputTail = 0;
+    // Only used by the write thread to sleep on an empty ring
+    std::mutex mIptvInputMutex;
+    std::condition_variable mIptvInputCv;
+
+    // Statistics of the IPTV input, reported by dump
+    struct IptvInputStats {
+        std::atomic<uint64_t> reads = 0;
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> readErrors = 0;
+        // reads dropped because the write thread was IPTV_INPUT_BUFFER_COUNT reads behind
+        std::atomic<uint64_t> droppedReads = 0;
+        std::atomic<uint64_t> fmqFullCount = 0;
+        std::atomic<int64_t> totalReadLatencyUs = 0;
+        std::atomic<int64_t> maxReadLatencyUs = 0;
+    } mIptvInputStats;
 
     /**
      * If a specific filter's writing loop is still running
@@ -235,6 +333,9 @@ class Demux : public BnDemux {
 
     int32_t mFilterTypes;
     bool mInUse = false;
+
+    // Runs the filter handlers, destroyed first to stop them before the filters
+    FilterExecutor mFilterExecutor;
 };
 
 }  // namespace tuner
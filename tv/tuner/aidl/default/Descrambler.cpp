@@ -21,7 +21,10 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 #include <utils/Log.h>
 
+#include <string.h>
+
 #include "Descrambler.h"
+#include "Tuner.h"
 
 namespace aidl {
 namespace android {
@@ -29,12 +32,112 @@ namespace hardware {
 namespace tv {
 namespace tuner {
 
-Descrambler::Descrambler() {}
+namespace {
+
+const uint8_t SOFTWARE_KEY_TOKEN_MAGIC[] = {'S', 'W', 'D', 'K'};
+// The IV of DVB-CISSA
+const uint8_t CISSA_IV[AES_BLOCK_SIZE] = {'D', 'V', 'B', 'T', 'M', 'C', 'P', 'T',
+                                          'A', 'E', 'S', 'C', 'I', 'S', 'S', 'A'};
+const size_t TS_PACKET_SIZE = 188;
+const size_t TS_HEADER_SIZE = 4;
+const uint8_t SCRAMBLING_CONTROL_EVEN = 0x2;
+const uint8_t SCRAMBLING_CONTROL_ODD = 0x3;
+
+}  // namespace
+
+bool DescramblerKeySlot::setKeyToken(const std::vector<uint8_t>& keyToken) {
+    const size_t magicSize = sizeof(SOFTWARE_KEY_TOKEN_MAGIC);
+    if (keyToken.size() < magicSize ||
+        memcmp(keyToken.data(), SOFTWARE_KEY_TOKEN_MAGIC, magicSize) != 0) {
+        ALOGV("%s: not a software key token, keeping the keys", __FUNCTION__);
+        return true;
+    }
+    const size_t recordSize = 1 + KEY_SIZE;
+    if ((keyToken.size() - magicSize) % recordSize != 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mUpdateLock);
+    std::shared_ptr<const Keys> current = std::atomic_load(&mKeys);
+    auto keys = current != nullptr ? std::make_shared<Keys>(*current) : std::make_shared<Keys>();
+    for (size_t offset = magicSize; offset < keyToken.size(); offset += recordSize) {
+        const uint8_t parity = keyToken[offset];
+        if (parity > 1) {
+            return false;
+        }
+        AES_KEY* key = parity == 0 ? &keys->even : &keys->odd;
+        if (AES_set_decrypt_key(&keyToken[offset + 1], KEY_SIZE * 8, key) != 0) {
+            return false;
+        }
+        (parity == 0 ? keys->hasEven : keys->hasOdd) = true;
+    }
+    std::atomic_store(&mKeys, std::shared_ptr<const Keys>(std::move(keys)));
+    return true;
+}
+
+size_t DescramblerKeySlot::descramble(int8_t* const* packets, size_t count,
+                                      size_t syncOffset) const {
+    std::shared_ptr<const Keys> keys = std::atomic_load(&mKeys);
+    if (keys == nullptr) {
+        return 0;
+    }
+
+    size_t descrambled = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* header = reinterpret_cast<uint8_t*>(packets[i]) + syncOffset;
+        const uint8_t scramblingControl = header[3] >> 6;
+        const AES_KEY* key = nullptr;
+        if (scramblingControl == SCRAMBLING_CONTROL_EVEN && keys->hasEven) {
+            key = &keys->even;
+        } else if (scramblingControl == SCRAMBLING_CONTROL_ODD && keys->hasOdd) {
+            key = &keys->odd;
+        }
+        if (key == nullptr) {
+            continue;
+        }
+
+        // Skip the adaptation field, if any
+        const uint8_t adaptationFieldControl = (header[3] >> 4) & 0x3;
+        size_t payloadOffset = TS_HEADER_SIZE;
+        if (adaptationFieldControl & 0x2) {
+            payloadOffset += 1 + header[TS_HEADER_SIZE];
+        }
+        if ((adaptationFieldControl & 0x1) && payloadOffset < TS_PACKET_SIZE) {
+            size_t length = (TS_PACKET_SIZE - payloadOffset) / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+            uint8_t iv[AES_BLOCK_SIZE];
+            memcpy(iv, CISSA_IV, sizeof(iv));
+            AES_cbc_encrypt(header + payloadOffset, header + payloadOffset, length, key, iv,
+                            AES_DECRYPT);
+        }
+        header[3] &= 0x3f;
+        descrambled++;
+    }
+    return descrambled;
+}
 
-Descrambler::~Descrambler() {}
+Descrambler::Descrambler(std::shared_ptr<Tuner> tuner) : mTuner(tuner) {}
+
+Descrambler::~Descrambler() {
+    close();
+}
+
+void Descrambler::updateDemuxPids(const std::set<uint16_t>& pids,
+                                  const std::shared_ptr<DescramblerKeySlot>& keySlot) {
+    if (!mDemuxSet || mTuner == nullptr) {
+        return;
+    }
+    std::shared_ptr<Demux> demux = mTuner->getDemux(mSourceDemuxId);
+    if (demux == nullptr) {
+        return;
+    }
+    for (uint16_t pid : pids) {
+        demux->setPidKeySlot(pid, keySlot, mKeySlot);
+    }
+}
 
 ::ndk::ScopedAStatus Descrambler::setDemuxSource(int32_t in_demuxId) {
     ALOGV("%s", __FUNCTION__);
+    std::lock_guard<std::mutex> lock(mLock);
     if (mDemuxSet) {
         ALOGW("[   WARN   ] Descrambler has already been set with a demux id %" PRIu32,
               mSourceDemuxId);
@@ -43,34 +146,57 @@ Descrambler::~Descrambler() {}
     }
     mDemuxSet = true;
     mSourceDemuxId = in_demuxId;
+    updateDemuxPids(mPids, mKeySlot);
 
     return ::ndk::ScopedAStatus::ok();
 }
 
-::ndk::ScopedAStatus Descrambler::setKeyToken(const std::vector<uint8_t>& /* in_keyToken */) {
+::ndk::ScopedAStatus Descrambler::setKeyToken(const std::vector<uint8_t>& in_keyToken) {
     ALOGV("%s", __FUNCTION__);
+    if (!mKeySlot->setKeyToken(in_keyToken)) {
+        ALOGW("[   WARN   ] Malformed software key token of %zu bytes", in_keyToken.size());
+        return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                static_cast<int32_t>(Result::INVALID_ARGUMENT));
+    }
 
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus Descrambler::addPid(
-        const DemuxPid& /* in_pid */,
-        const std::shared_ptr<IFilter>& /* in_optionalSourceFilter */) {
+        const DemuxPid& in_pid, const std::shared_ptr<IFilter>& /* in_optionalSourceFilter */) {
     ALOGV("%s", __FUNCTION__);
+    // Only TS packets are descrambled
+    if (in_pid.getTag() != DemuxPid::Tag::tPid) {
+        return ::ndk::ScopedAStatus::ok();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    uint16_t pid = static_cast<uint16_t>(in_pid.get<DemuxPid::Tag::tPid>());
+    mPids.insert(pid);
+    updateDemuxPids({pid}, mKeySlot);
 
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus Descrambler::removePid(
-        const DemuxPid& /* in_pid */,
-        const std::shared_ptr<IFilter>& /* in_optionalSourceFilter */) {
+        const DemuxPid& in_pid, const std::shared_ptr<IFilter>& /* in_optionalSourceFilter */) {
     ALOGV("%s", __FUNCTION__);
+    if (in_pid.getTag() != DemuxPid::Tag::tPid) {
+        return ::ndk::ScopedAStatus::ok();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    uint16_t pid = static_cast<uint16_t>(in_pid.get<DemuxPid::Tag::tPid>());
+    if (mPids.erase(pid) != 0) {
+        updateDemuxPids({pid}, nullptr);
+    }
 
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus Descrambler::close() {
     ALOGV("%s", __FUNCTION__);
+    std::lock_guard<std::mutex> lock(mLock);
+    updateDemuxPids(mPids, nullptr);
+    mPids.clear();
     mDemuxSet = false;
 
     return ::ndk::ScopedAStatus::ok();
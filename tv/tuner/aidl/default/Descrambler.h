@@ -19,6 +19,11 @@
 #include <aidl/android/hardware/tv/tuner/BnDescrambler.h>
 #include <aidl/android/hardware/tv/tuner/ITuner.h>
 #include <inttypes.h>
+#include <openssl/aes.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
 
 using namespace std;
 
@@ -28,9 +33,52 @@ namespace hardware {
 namespace tv {
 namespace tuner {
 
+class Tuner;
+
+/**
+ * The even and odd keys of a descrambler, shared with the demux for the PIDs it descrambles.
+ *
+ * The reference HAL has no CAS, so the keys come in software key tokens: the 4 bytes "SWDK",
+ * followed by records of a parity byte, 0 for even and 1 for odd, and a 16 byte AES-128 key.
+ * Other tokens, such as CAS session ids, are accepted and leave the keys as they are.
+ *
+ * The payload of a scrambled TS packet is descrambled as in DVB-CISSA: AES-128-CBC over its
+ * whole 16 byte blocks from a fixed IV, the remaining bytes being in the clear.
+ */
+class DescramblerKeySlot {
+  public:
+    static constexpr size_t KEY_SIZE = 16;
+
+    /**
+     * Replaces the keys of the parities in the token and keeps the other one, so that the
+     * packets still scrambled with the current key are descrambled while the next is loaded.
+     * Returns false if the token is a malformed software key token.
+     */
+    bool setKeyToken(const std::vector<uint8_t>& keyToken);
+    /**
+     * Descrambles in place the TS packets, the sync byte of which is at 'syncOffset', and marks
+     * them as not scrambled. Returns the number of packets descrambled, packets without a key
+     * for their parity are left as they are.
+     */
+    size_t descramble(int8_t* const* packets, size_t count, size_t syncOffset) const;
+
+  private:
+    struct Keys {
+        AES_KEY even;
+        AES_KEY odd;
+        bool hasEven = false;
+        bool hasOdd = false;
+    };
+
+    // Replaced as a whole on each token, so the demux thread never waits for a key change
+    std::shared_ptr<const Keys> mKeys;
+    // Serializes the key changes
+    std::mutex mUpdateLock;
+};
+
 class Descrambler : public BnDescrambler {
   public:
-    Descrambler();
+    Descrambler(std::shared_ptr<Tuner> tuner);
 
     ::ndk::ScopedAStatus setDemuxSource(int32_t in_demuxId) override;
     ::ndk::ScopedAStatus setKeyToken(const std::vector<uint8_t>& in_keyToken) override;
@@ -43,8 +91,16 @@ class Descrambler : public BnDescrambler {
 
   private:
     virtual ~Descrambler();
+    // Sets the key slot of the PIDs on the source demux, nullptr to stop descrambling them
+    void updateDemuxPids(const std::set<uint16_t>& pids,
+                         const std::shared_ptr<DescramblerKeySlot>& keySlot);
+
+    std::shared_ptr<Tuner> mTuner;
     int32_t mSourceDemuxId;
     bool mDemuxSet = false;
+    std::mutex mLock;
+    std::set<uint16_t> mPids;
+    const std::shared_ptr<DescramblerKeySlot> mKeySlot = std::make_shared<DescramblerKeySlot>();
 };
 
 }  // namespace tuner
@@ -21,6 +21,8 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 
 #include <utils/Log.h>
+#include <algorithm>
+#include <cstring>
 #include "Dvr.h"
 
 namespace aidl {
@@ -241,9 +243,9 @@ void Dvr::maySendIptvPlaybackStatusCallback() {
     int availableToRead = mDvrMQ->availableToRead();
     int availableToWrite = mDvrMQ->availableToWrite();
 
-    PlaybackStatus newStatus = checkPlaybackStatusChange(availableToWrite, availableToRead,
-                                                         IPTV_PLAYBACK_STATUS_THRESHOLD_HIGH,
-                                                         IPTV_PLAYBACK_STATUS_THRESHOLD_LOW);
+    PlaybackStatus newStatus = checkPlaybackStatusChange(
+            availableToWrite, availableToRead, IPTV_PLAYBACK_STATUS_THRESHOLD_HIGH,
+            IPTV_PLAYBACK_STATUS_THRESHOLD_LOW, IPTV_BUFFER_SIZE * STATUS_HYSTERESIS_PERCENT);
     if (mPlaybackStatus != newStatus) {
         map<int64_t, std::shared_ptr<Filter>>::iterator it;
         for (it = mFilters.begin(); it != mFilters.end(); it++) {
@@ -263,7 +265,8 @@ void Dvr::maySendPlaybackStatusCallback() {
     PlaybackStatus newStatus =
             checkPlaybackStatusChange(availableToWrite, availableToRead,
                                       mDvrSettings.get<DvrSettings::Tag::playback>().highThreshold,
-                                      mDvrSettings.get<DvrSettings::Tag::playback>().lowThreshold);
+                                      mDvrSettings.get<DvrSettings::Tag::playback>().lowThreshold,
+                                      mBufferSize * STATUS_HYSTERESIS_PERCENT);
     if (mPlaybackStatus != newStatus) {
         mCallback->onPlaybackStatus(newStatus);
         mPlaybackStatus = newStatus;
@@ -271,9 +274,14 @@ void Dvr::maySendPlaybackStatusCallback() {
 }
 
 PlaybackStatus Dvr::checkPlaybackStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
-                                              int64_t highThreshold, int64_t lowThreshold) {
+                                              int64_t highThreshold, int64_t lowThreshold,
+                                              int64_t hysteresis) {
+    // A full buffer is only reported as having space again once the hysteresis has been read
+    // back, so a producer writing into an almost full buffer does not flip the status each write.
     if (availableToWrite == 0) {
         return PlaybackStatus::SPACE_FULL;
+    } else if (mPlaybackStatus == PlaybackStatus::SPACE_FULL && availableToWrite < hysteresis) {
+        return PlaybackStatus::SPACE_FULL;
     } else if (availableToRead > highThreshold) {
         return PlaybackStatus::SPACE_ALMOST_FULL;
     } else if (availableToRead < lowThreshold) {
@@ -285,28 +293,87 @@ PlaybackStatus Dvr::checkPlaybackStatusChange(uint32_t availableToWrite, uint32_
 }
 
 bool Dvr::readPlaybackFMQ(bool isVirtualFrontend, bool isRecording) {
-    // Read playback data from the input FMQ
+    // Map the playback data in the input FMQ, and dispatch its packets in place
     size_t size = mDvrMQ->availableToRead();
     int64_t playbackPacketSize = mDvrSettings.get<DvrSettings::Tag::playback>().packetSize;
-    vector<int8_t> dataOutputBuffer;
-    dataOutputBuffer.resize(playbackPacketSize);
+    if (playbackPacketSize <= 0 || size < playbackPacketSize) {
+        return true;
+    }
+    DvrMQ::MemTransaction tx;
+    if (!mDvrMQ->beginRead(size, &tx)) {
+        return false;
+    }
+    size_t consumed = scanTsPackets(tx, size, playbackPacketSize, &mPlaybackBatch);
+    if (mPlaybackBatch.lostBytes > 0) {
+        ALOGW("[Dvr] skipped %zu bytes to find the TS sync bytes", mPlaybackBatch.lostBytes);
+    }
     // Dispatch the packet to the PID matching filter output buffer
-    for (int i = 0; i < size / playbackPacketSize; i++) {
-        if (!mDvrMQ->read(dataOutputBuffer.data(), playbackPacketSize)) {
-            return false;
-        }
-        if (isVirtualFrontend) {
-            if (isRecording) {
-                mDemux->sendFrontendInputToRecord(dataOutputBuffer);
-            } else {
-                mDemux->startBroadcastTsFilter(dataOutputBuffer);
+    if (isVirtualFrontend && isRecording) {
+        mDemux->sendFrontendInputToRecord(mPlaybackBatch, playbackPacketSize);
+    } else {
+        mDemux->descrambleTsPackets(&mPlaybackBatch, playbackPacketSize);
+        mDemux->startBroadcastTsFilter(mPlaybackBatch, playbackPacketSize);
+    }
+
+    return mDvrMQ->commitRead(consumed);
+}
+
+size_t Dvr::scanTsPackets(const DvrMQ::MemTransaction& tx, size_t size, size_t packetSize,
+                          TsPacketBatch* batch) {
+    batch->clear();
+    const int8_t* first = tx.getFirstRegion().getAddress();
+    size_t firstLength = std::min(tx.getFirstRegion().getLength(), size);
+    const int8_t* second = tx.getSecondRegion().getAddress();
+    auto at = [&](size_t offset) {
+        return offset < firstLength ? first + offset : second + (offset - firstLength);
+    };
+    // The sync byte follows the 4 bytes of the arrival timestamp in 192 byte packets, and the
+    // 16 bytes of Reed-Solomon parity follow the TS packet in 204 byte packets.
+    const size_t syncOffset = packetSize == 192 ? 4 : 0;
+
+    size_t offset = 0;
+    while (offset + packetSize <= size) {
+        if (*at(offset + syncOffset) != TS_SYNC_BYTE) {
+            // Resync on the next sync byte, with memchr scanning each region
+            size_t from = offset + syncOffset + 1;
+            const void* found = nullptr;
+            if (from < firstLength) {
+                found = memchr(first + from, TS_SYNC_BYTE, firstLength - from);
+                if (found != nullptr) {
+                    from = static_cast<const int8_t*>(found) - first;
+                } else {
+                    from = firstLength;
+                }
+            }
+            if (found == nullptr && from < size) {
+                size_t secondFrom = from - firstLength;
+                found = memchr(second + secondFrom, TS_SYNC_BYTE, size - from);
+                from = found != nullptr ? firstLength + (static_cast<const int8_t*>(found) - second)
+                                        : size;
             }
+            // Keep the bytes that can still hold the start of a packet for the next read
+            size_t next = from >= size ? size - std::min(size, syncOffset) : from - syncOffset;
+            batch->lostBytes += next - offset;
+            offset = next;
+            continue;
+        }
+        const int8_t* packet;
+        if (offset + packetSize <= firstLength || offset >= firstLength) {
+            packet = at(offset);
         } else {
-            startTpidFilter(dataOutputBuffer);
+            // The packet wraps around the end of the FMQ
+            size_t head = firstLength - offset;
+            batch->wrappedPacket.assign(first + offset, first + firstLength);
+            batch->wrappedPacket.insert(batch->wrappedPacket.end(), second,
+                                        second + (packetSize - head));
+            packet = batch->wrappedPacket.data();
         }
+        const int8_t* header = packet + syncOffset;
+        batch->packets.push_back(packet);
+        batch->pids.push_back(((header[1] & 0x1f) << 8) | (header[2] & 0xff));
+        offset += packetSize;
     }
-
-    return true;
+    return offset;
 }
 
 bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
@@ -416,6 +483,8 @@ bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
             mDemux->sendFrontendInputToRecord(frameData, pid, static_cast<uint64_t>(esMeta[i].pts));
         }
         startFilterDispatcher(isVirtualFrontend, isRecording);
+        // The next frame updates the PTS of the filters, wait for the handlers of this one
+        mDemux->waitFilterHandlers();
         frameData.clear();
     }
 
@@ -429,37 +498,12 @@ void Dvr::getMetaDataValue(int& index, int8_t* dataOutputBuffer, int& value) {
     }
 }
 
-void Dvr::startTpidFilter(vector<int8_t> data) {
-    map<int64_t, std::shared_ptr<Filter>>::iterator it;
-    for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_DVR) {
-            ALOGW("[Dvr] start ts filter pid: %d", pid);
-        }
-        if (pid == mDemux->getFilterTpid(it->first)) {
-            mDemux->updateFilterOutput(it->first, data);
-        }
-    }
-}
-
 bool Dvr::startFilterDispatcher(bool isVirtualFrontend, bool isRecording) {
-    if (isVirtualFrontend) {
-        if (isRecording) {
-            return mDemux->startRecordFilterDispatcher();
-        } else {
-            return mDemux->startBroadcastFilterDispatcher();
-        }
-    }
-
-    map<int64_t, std::shared_ptr<Filter>>::iterator it;
-    // Handle the output data per filter type
-    for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        if (!mDemux->startFilterHandler(it->first).isOk()) {
-            return false;
-        }
+    if (isVirtualFrontend && isRecording) {
+        return mDemux->startRecordFilterDispatcher();
     }
-
-    return true;
+    // The filters of the playback DVR are the playback filters of the demux
+    return mDemux->startBroadcastFilterDispatcher();
 }
 
 int Dvr::writePlaybackFMQ(void* buf, size_t size) {
@@ -496,6 +540,37 @@ bool Dvr::writeRecordFMQ(const vector<int8_t>& data) {
     return false;
 }
 
+bool Dvr::writeRecordFMQ(const TsPacketBatch& batch, size_t packetSize,
+                         const vector<std::shared_ptr<Filter>>& filters) {
+    lock_guard<mutex> lock(mWriteLock);
+    if (mRecordStatus == RecordStatus::OVERFLOW) {
+        ALOGW("[Dvr] stops writing and wait for the client side flushing.");
+        return true;
+    }
+    size_t size = batch.packets.size() * packetSize;
+    DvrMQ::MemTransaction tx;
+    if (size == 0 || !mDvrMQ->beginWrite(size, &tx)) {
+        maySendRecordStatusCallback();
+        return size == 0;
+    }
+    const size_t syncOffset = packetSize == 192 ? 4 : 0;
+    for (size_t i = 0; i < batch.packets.size(); i++) {
+        const int8_t* packet = batch.packets[i];
+        tx.copyTo(packet, i * packetSize, packetSize);
+        for (const auto& filter : filters) {
+            filter->indexRecordPacket(reinterpret_cast<const uint8_t*>(packet + syncOffset),
+                                      batch.pids[i], packetSize);
+        }
+    }
+    if (!mDvrMQ->commitWrite(size)) {
+        maySendRecordStatusCallback();
+        return false;
+    }
+    mDvrEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
+    maySendRecordStatusCallback();
+    return true;
+}
+
 void Dvr::maySendRecordStatusCallback() {
     lock_guard<mutex> lock(mRecordStatusLock);
     int availableToRead = mDvrMQ->availableToRead();
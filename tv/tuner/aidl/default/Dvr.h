@@ -55,6 +55,29 @@ const double HIGH_THRESHOLD_PERCENT = 0.90;
 const double LOW_THRESHOLD_PERCENT = 0.15;
 const int IPTV_PLAYBACK_STATUS_THRESHOLD_HIGH = IPTV_BUFFER_SIZE * HIGH_THRESHOLD_PERCENT;
 const int IPTV_PLAYBACK_STATUS_THRESHOLD_LOW = IPTV_BUFFER_SIZE * LOW_THRESHOLD_PERCENT;
+// Share of a buffer its fill level must move by to leave a full or empty status.
+const double STATUS_HYSTERESIS_PERCENT = 0.05;
+
+const int8_t TS_SYNC_BYTE = 0x47;
+
+/**
+ * The TS packets of a batch read from the playback FMQ, as parallel arrays of the packet
+ * addresses and PIDs. The packets are in the FMQ, except for one that wraps around its end.
+ */
+struct TsPacketBatch {
+    vector<const int8_t*> packets;
+    vector<uint16_t> pids;
+    // Bytes skipped to find the sync bytes of the packets
+    size_t lostBytes = 0;
+    // Copy of the packet that wraps around the end of the FMQ
+    vector<int8_t> wrappedPacket;
+
+    void clear() {
+        packets.clear();
+        pids.clear();
+        lostBytes = 0;
+    }
+};
 
 struct MediaEsMetaData {
     bool isAudio;
@@ -95,6 +118,12 @@ class Dvr : public BnDvr {
     bool createDvrMQ();
     int writePlaybackFMQ(void* buf, size_t size);
     bool writeRecordFMQ(const std::vector<int8_t>& data);
+    /**
+     * Copies the TS packets of 'batch' into the record FMQ in a single write, and lets each of
+     * the record 'filters' index the packets at their position in the record.
+     */
+    bool writeRecordFMQ(const TsPacketBatch& batch, size_t packetSize,
+                        const std::vector<std::shared_ptr<Filter>>& filters);
     bool addPlaybackFilter(int64_t filterId, std::shared_ptr<Filter> filter);
     bool removePlaybackFilter(int64_t filterId);
     bool readPlaybackFMQ(bool isVirtualFrontend, bool isRecording);
@@ -115,21 +144,24 @@ class Dvr : public BnDvr {
     void deleteEventFlag();
     bool readDataFromMQ();
     void getMetaDataValue(int& index, int8_t* dataOutputBuffer, int& value);
+    /**
+     * Finds the TS packets of 'packetSize' bytes (188, 192 or 204) in the 'size' bytes of 'tx',
+     * resyncing on the sync bytes. Returns the number of bytes to commit.
+     */
+    static size_t scanTsPackets(const DvrMQ::MemTransaction& tx, size_t size, size_t packetSize,
+                                TsPacketBatch* batch);
     void maySendPlaybackStatusCallback();
     void maySendIptvPlaybackStatusCallback();
     void maySendRecordStatusCallback();
     PlaybackStatus checkPlaybackStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
-                                             int64_t highThreshold, int64_t lowThreshold);
+                                             int64_t highThreshold, int64_t lowThreshold,
+                                             int64_t hysteresis);
     RecordStatus checkRecordStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                          int64_t highThreshold, int64_t lowThreshold);
-    /**
-     * A dispatcher to read and dispatch input data to all the started filters.
-     * Each filter handler handles the data filtering/output writing/filterEvent updating.
-     */
-    void startTpidFilter(vector<int8_t> data);
     void playbackThreadLoop();
 
     unique_ptr<DvrMQ> mDvrMQ;
+    TsPacketBatch mPlaybackBatch;
     EventFlag* mDvrEventFlag;
     /**
      * Demux callbacks used on filter events or IO buffer status
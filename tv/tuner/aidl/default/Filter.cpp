@@ -20,10 +20,12 @@
 #include <BufferAllocator/BufferAllocator.h>
 #include <aidl/android/hardware/tv/tuner/DemuxFilterMonitorEventType.h>
 #include <aidl/android/hardware/tv/tuner/DemuxQueueNotifyBits.h>
+#include <aidl/android/hardware/tv/tuner/DemuxTsIndex.h>
 #include <aidl/android/hardware/tv/tuner/Result.h>
 #include <aidlcommonsupport/NativeHandle.h>
 #include <inttypes.h>
 #include <utils/Log.h>
+#include <algorithm>
 
 #include "Filter.h"
 
@@ -50,10 +52,10 @@ FilterCallbackScheduler::~FilterCallbackScheduler() {
 
 void FilterCallbackScheduler::onFilterEvent(DemuxFilterEvent&& event) {
     std::unique_lock<std::mutex> lock(mLock);
-    mCallbackBuffer.push_back(std::move(event));
     mDataLength += getDemuxFilterEventDataLength(event);
+    mCallbackBuffer.push_back(std::move(event));
 
-    if (isDataSizeDelayConditionMetLocked()) {
+    if (isDelayConditionMetLocked()) {
         mIsConditionMet = true;
         // unlock, so thread is not immediately blocked when it is notified.
         lock.unlock();
@@ -61,6 +63,24 @@ void FilterCallbackScheduler::onFilterEvent(DemuxFilterEvent&& event) {
     }
 }
 
+void FilterCallbackScheduler::onFilterEvents(std::vector<DemuxFilterEvent>&& events) {
+    if (events.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    for (auto&& event : events) {
+        mDataLength += getDemuxFilterEventDataLength(event);
+        mCallbackBuffer.push_back(std::move(event));
+    }
+
+    // Wake the callback thread once for all the events
+    if (isDelayConditionMetLocked()) {
+        mIsConditionMet = true;
+        lock.unlock();
+        mCv.notify_all();
+    }
+}
+
 void FilterCallbackScheduler::onFilterStatus(const DemuxFilterStatus& status) {
     if (mCallback) {
         mCallback->onFilterStatus(status);
@@ -85,7 +105,7 @@ void FilterCallbackScheduler::setTimeDelayHint(int timeDelay) {
 void FilterCallbackScheduler::setDataSizeDelayHint(int dataSizeDelay) {
     std::unique_lock<std::mutex> lock(mLock);
     mDataSizeDelayInBytes = dataSizeDelay;
-    if (isDataSizeDelayConditionMetLocked()) {
+    if (isDelayConditionMetLocked()) {
         mIsConditionMet = true;
         lock.unlock();
         mCv.notify_all();
@@ -144,7 +164,11 @@ void FilterCallbackScheduler::threadLoopOnce() {
 }
 
 // mLock needs to be held to call this function
-bool FilterCallbackScheduler::isDataSizeDelayConditionMetLocked() {
+bool FilterCallbackScheduler::isDelayConditionMetLocked() {
+    if (mCallbackBuffer.size() >= MAX_COALESCED_FILTER_EVENT_COUNT) {
+        // Send the events early rather than in an oversized transaction.
+        return true;
+    }
     if (mDataSizeDelayInBytes == 0) {
         // Data size delay is disabled.
         if (mTimeDelayInMs == 0) {
@@ -232,10 +256,19 @@ Filter::Filter(DemuxFilterType type, int64_t filterId, uint32_t bufferSize,
         default:
             break;
     }
+
+    if (mIsRecordFilter) {
+        mRecordFilterInput.reserve(FILTER_OUTPUT_RESERVED_SIZE);
+        mRecordFilterOutput.reserve(FILTER_OUTPUT_RESERVED_SIZE);
+    } else {
+        mFilterInput.reserve(FILTER_OUTPUT_RESERVED_SIZE);
+        mFilterOutput.reserve(FILTER_OUTPUT_RESERVED_SIZE);
+    }
 }
 
 Filter::~Filter() {
     close();
+    freeAvBuffers();
 }
 
 ::ndk::ScopedAStatus Filter::getId64Bit(int64_t* _aidl_return) {
@@ -305,6 +338,13 @@ Filter::~Filter() {
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
             mTpid = in_settings.get<DemuxFilterSettings::Tag::ts>().tpid;
+            mDemux->setFilterTpid(mFilterId, mTpid);
+            // Restart the reassembly on the new stream
+            dropSection();
+            mSectionSynced = false;
+            mSectionCrcs.clear();
+            mContinuityCounter = -1;
+            mRecordIndexStarted = false;
             break;
         case DemuxFilterMainType::MMTP:
             break;
@@ -405,12 +445,19 @@ Filter::~Filter() {
         return ::ndk::ScopedAStatus::ok();
     }
 
-    if (mDataId2Avfd.find(in_avDataId) == mDataId2Avfd.end()) {
-        return ::ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int32_t>(Result::INVALID_ARGUMENT));
+    AvBuffer buffer;
+    {
+        std::lock_guard<std::mutex> lock(mAvBufferLock);
+        auto it = mDataId2AvBuffer.find(in_avDataId);
+        if (it == mDataId2AvBuffer.end()) {
+            return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int32_t>(Result::INVALID_ARGUMENT));
+        }
+        buffer = it->second;
+        mDataId2AvBuffer.erase(it);
     }
 
-    ::close(mDataId2Avfd[in_avDataId]);
+    recycleAvBuffer(buffer);
     return ::ndk::ScopedAStatus::ok();
 }
 
@@ -462,7 +509,15 @@ Filter::~Filter() {
         return ::ndk::ScopedAStatus::fromServiceSpecificError(
                 static_cast<int32_t>(Result::UNKNOWN_ERROR));
     }
+    // Map the shared memory once, the media data is written straight into it
+    mSharedAvMem = getIonBuffer(av_fd, BUFFER_SIZE);
     ::close(av_fd);
+    if (mSharedAvMem == nullptr) {
+        freeSharedAvHandle();
+        *_aidl_return = 0;
+        return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                static_cast<int32_t>(Result::OUT_OF_MEMORY));
+    }
     mUsingSharedAvMem = true;
 
     *out_avMemory = ::android::dupToAidl(mSharedAvMemHandle);
@@ -601,9 +656,7 @@ void Filter::filterThreadLoop() {
             }
 
             // lock is still being held
-            for (auto&& event : mFilterEvents) {
-                mCallbackScheduler.onFilterEvent(std::move(event));
-            }
+            mCallbackScheduler.onFilterEvents(std::move(mFilterEvents));
         } else {
             ALOGD("[Filter] filter callback is not configured yet.");
             mFilterThreadRunning = false;
@@ -643,9 +696,7 @@ void Filter::filterThreadLoop() {
                     continue;
                 }
                 // After successfully write, send a callback and wait for the read to be done
-                for (auto&& event : mFilterEvents) {
-                    mCallbackScheduler.onFilterEvent(std::move(event));
-                }
+                mCallbackScheduler.onFilterEvents(std::move(mFilterEvents));
                 mFilterEvents.clear();
                 break;
             }
@@ -665,9 +716,15 @@ void Filter::freeSharedAvHandle() {
     if (!mIsMediaFilter) {
         return;
     }
+    if (mSharedAvMem != nullptr) {
+        munmap(mSharedAvMem, BUFFER_SIZE);
+        mSharedAvMem = nullptr;
+    }
     native_handle_close(mSharedAvMemHandle);
     native_handle_delete(mSharedAvMemHandle);
     mSharedAvMemHandle = nullptr;
+    mSharedAvMemOffset = 0;
+    mSharedAvMemPendingSize = 0;
 }
 
 binder_status_t Filter::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
@@ -691,7 +748,8 @@ void Filter::maySendFilterStatusCallback() {
     int fmqSize = mFilterMQ->getQuantumCount();
 
     DemuxFilterStatus newStatus = checkFilterStatusChange(
-            availableToWrite, availableToRead, ceil(fmqSize * 0.75), ceil(fmqSize * 0.25));
+            availableToWrite, availableToRead, ceil(fmqSize * 0.75), ceil(fmqSize * 0.25),
+            ceil(fmqSize * STATUS_HYSTERESIS_PERCENT));
     if (mFilterStatus != newStatus) {
         mCallbackScheduler.onFilterStatus(newStatus);
         mFilterStatus = newStatus;
@@ -700,13 +758,20 @@ void Filter::maySendFilterStatusCallback() {
 
 DemuxFilterStatus Filter::checkFilterStatusChange(uint32_t availableToWrite,
                                                   uint32_t availableToRead, uint32_t highThreshold,
-                                                  uint32_t lowThreshold) {
+                                                  uint32_t lowThreshold, uint32_t hysteresis) {
+    // The status in between the watermarks is kept, and the overflow and no data statuses are
+    // only left once the FMQ has moved away from them by the hysteresis, so a queue hovering
+    // around a boundary does not report a status change for every write or read.
     if (availableToWrite == 0) {
         return DemuxFilterStatus::OVERFLOW;
+    } else if (mFilterStatus == DemuxFilterStatus::OVERFLOW && availableToWrite < hysteresis) {
+        return DemuxFilterStatus::OVERFLOW;
     } else if (availableToRead > highThreshold) {
         return DemuxFilterStatus::HIGH_WATER;
     } else if (availableToRead == 0) {
         return DemuxFilterStatus::NO_DATA;
+    } else if (mFilterStatus == DemuxFilterStatus::NO_DATA && availableToRead < hysteresis) {
+        return DemuxFilterStatus::NO_DATA;
     } else if (availableToRead < lowThreshold) {
         return DemuxFilterStatus::LOW_WATER;
     }
@@ -717,9 +782,9 @@ uint16_t Filter::getTpid() {
     return mTpid;
 }
 
-void Filter::updateFilterOutput(vector<int8_t>& data) {
-    std::lock_guard<std::mutex> lock(mFilterOutputLock);
-    mFilterOutput.insert(mFilterOutput.end(), data.begin(), data.end());
+void Filter::updateFilterOutput(const int8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mFilterInputLock);
+    mFilterInput.insert(mFilterInput.end(), data, data + size);
 }
 
 void Filter::updatePts(uint64_t pts) {
@@ -727,13 +792,24 @@ void Filter::updatePts(uint64_t pts) {
     mPts = pts;
 }
 
-void Filter::updateRecordOutput(vector<int8_t>& data) {
-    std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
-    mRecordFilterOutput.insert(mRecordFilterOutput.end(), data.begin(), data.end());
+void Filter::updateRecordOutput(const int8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mFilterInputLock);
+    mRecordFilterInput.insert(mRecordFilterInput.end(), data, data + size);
+}
+
+void Filter::takeFilterInput(vector<int8_t>& input, vector<int8_t>& output) {
+    std::lock_guard<std::mutex> lock(mFilterInputLock);
+    if (output.empty()) {
+        output.swap(input);
+    } else {
+        output.insert(output.end(), input.begin(), input.end());
+        input.clear();
+    }
 }
 
 ::ndk::ScopedAStatus Filter::startFilterHandler() {
     std::lock_guard<std::mutex> lock(mFilterOutputLock);
+    takeFilterInput(mFilterInput, mFilterOutput);
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
             switch (mType.subType.get<DemuxFilterSubType::Tag::tsFilterType>()) {
@@ -800,70 +876,121 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
         return ::ndk::ScopedAStatus::ok();
     }
 
-    for (int i = 0; i < mFilterOutput.size(); i += 188) {
-        if (mPesSizeLeft == 0) {
-            uint32_t prefix = (mFilterOutput[i + 4] << 16) | (mFilterOutput[i + 5] << 8) |
-                              mFilterOutput[i + 6];
-            if (DEBUG_FILTER) {
-                ALOGD("[Filter] prefix %d", prefix);
+    for (size_t i = 0; i + TS_SIZE <= mFilterOutput.size(); i += TS_SIZE) {
+        const uint8_t* packet = reinterpret_cast<const uint8_t*>(mFilterOutput.data() + i);
+        bool discontinuity = false;
+        int offset = getTsPayloadOffset(packet, &discontinuity);
+        if (offset < 0) {
+            continue;
+        }
+        const uint8_t* payload = packet + offset;
+        size_t size = TS_SIZE - offset;
+        if (discontinuity) {
+            ALOGW("[Filter] filter %" PRIu64 " lost TS packets, dropping the PES packet",
+                  mFilterId);
+            dropFilterMQ();
+            mPesInProgress = false;
+        }
+
+        if (packet[1] & 0x40) {
+            // A PES packet of unspecified length, e.g. video, ends where the next one starts
+            if (mPesInProgress && mPesLength == 0 && !finishPesPacket()) {
+                mFilterOutput.clear();
+                return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                        static_cast<int32_t>(Result::INVALID_ARGUMENT));
             }
-            if (prefix == 0x000001) {
-                // TODO handle mulptiple Pes filters
-                mPesSizeLeft = (static_cast<uint8_t>(mFilterOutput[i + 8]) << 8) |
-                               static_cast<uint8_t>(mFilterOutput[i + 9]);
-                mPesSizeLeft += 6;
-                if (DEBUG_FILTER) {
-                    ALOGD("[Filter] pes data length %d", mPesSizeLeft);
-                }
-            } else {
+            dropFilterMQ();
+            mPesInProgress = false;
+            // Packet Start Code Prefix, stream id and PES packet length (ISO/IEC 13818-1 2.4.3.6)
+            if (size < 6 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1) {
                 continue;
             }
+            mPesInProgress = true;
+            mPesStreamId = payload[3];
+            uint32_t pesPacketLength = (payload[4] << 8) | payload[5];
+            mPesLength = pesPacketLength == 0 ? 0 : pesPacketLength + 6;
+            mPesWritten = 0;
+            if (DEBUG_FILTER) {
+                ALOGD("[Filter] pes data length %d", mPesLength);
+            }
+        } else if (!mPesInProgress) {
+            continue;
         }
 
-        uint32_t endPoint = min(184u, mPesSizeLeft);
-        // append data and check size
-        vector<int8_t>::const_iterator first = mFilterOutput.begin() + i + 4;
-        vector<int8_t>::const_iterator last = mFilterOutput.begin() + i + 4 + endPoint;
-        mPesOutput.insert(mPesOutput.end(), first, last);
-        // size does not match then continue
-        mPesSizeLeft -= endPoint;
-        if (DEBUG_FILTER) {
-            ALOGD("[Filter] pes data left %d", mPesSizeLeft);
-        }
-        if (mPesSizeLeft > 0) {
-            continue;
+        if (mPesLength != 0) {
+            size = min<size_t>(size, mPesLength - mPesWritten);
         }
-        // size match then create event
-        if (!writeDataToFilterMQ(mPesOutput)) {
+        if (!appendToFilterMQ(reinterpret_cast<const int8_t*>(payload), size)) {
             ALOGD("[Filter] pes data write failed");
+            dropFilterMQ();
+            mPesInProgress = false;
             mFilterOutput.clear();
             return ::ndk::ScopedAStatus::fromServiceSpecificError(
                     static_cast<int32_t>(Result::INVALID_ARGUMENT));
         }
-        maySendFilterStatusCallback();
-        DemuxFilterPesEvent pesEvent;
-        pesEvent = {
-                // temp dump meta data
-                .streamId = static_cast<int32_t>(mPesOutput[3]),
-                .dataLength = static_cast<int32_t>(mPesOutput.size()),
-        };
+        mPesWritten += size;
         if (DEBUG_FILTER) {
-            ALOGD("[Filter] assembled pes data length %d", pesEvent.dataLength);
+            ALOGD("[Filter] pes data written %d", mPesWritten);
         }
-
-        {
-            std::lock_guard<std::mutex> lock(mFilterEventsLock);
-            mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::pes>(pesEvent));
+        if (mPesWritten == mPesLength && !finishPesPacket()) {
+            mFilterOutput.clear();
+            return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int32_t>(Result::INVALID_ARGUMENT));
         }
-
-        mPesOutput.clear();
     }
 
     mFilterOutput.clear();
+    // Check the status once for all the packets of the run
+    maySendFilterStatusCallback();
 
     return ::ndk::ScopedAStatus::ok();
 }
 
+bool Filter::finishPesPacket() {
+    mPesInProgress = false;
+    if (!commitFilterMQ()) {
+        ALOGD("[Filter] pes data write failed");
+        return false;
+    }
+    DemuxFilterPesEvent pesEvent;
+    pesEvent = {
+            // temp dump meta data
+            .streamId = static_cast<int32_t>(mPesStreamId),
+            .dataLength = static_cast<int32_t>(mPesWritten),
+    };
+    if (DEBUG_FILTER) {
+        ALOGD("[Filter] assembled pes data length %d", pesEvent.dataLength);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::pes>(pesEvent));
+    }
+    return true;
+}
+
+int Filter::getTsPayloadOffset(const uint8_t* packet, bool* discontinuity) {
+    uint8_t adaptationFieldControl = (packet[3] >> 4) & 0x3;
+    uint8_t continuityCounter = packet[3] & 0xf;
+    // The continuity counter only increments on packets with payload
+    if (!(adaptationFieldControl & 0x1)) {
+        return -1;
+    }
+    if (mContinuityCounter >= 0) {
+        if (continuityCounter == mContinuityCounter) {
+            // A duplicate packet
+            return -1;
+        }
+        *discontinuity = continuityCounter != ((mContinuityCounter + 1) & 0xf);
+    }
+    mContinuityCounter = continuityCounter;
+    int offset = 4;
+    if (adaptationFieldControl == 0x3) {
+        offset += 1 + packet[4];
+    }
+    return offset < TS_SIZE ? offset : -1;
+}
+
 ::ndk::ScopedAStatus Filter::startTsFilterHandler() {
     // TODO handle starting TS filter
     return ::ndk::ScopedAStatus::ok();
@@ -932,9 +1059,11 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
 
         uint32_t endPoint = min(188u - headerSize, mPesSizeLeft);
         // append data and check size
-        vector<int8_t>::const_iterator first = mFilterOutput.begin() + i + headerSize;
-        vector<int8_t>::const_iterator last = mFilterOutput.begin() + i + headerSize + endPoint;
-        mPesOutput.insert(mPesOutput.end(), first, last);
+        if (!appendMediaOutput(mFilterOutput.data() + i + headerSize, endPoint)) {
+            mFilterOutput.clear();
+            return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int32_t>(Result::OUT_OF_MEMORY));
+        }
         // size does not match then continue
         mPesSizeLeft -= endPoint;
         if (DEBUG_FILTER) {
@@ -956,13 +1085,41 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
     return ::ndk::ScopedAStatus::ok();
 }
 
+bool Filter::appendMediaOutput(const int8_t* data, size_t size) {
+    if (mUsingSharedAvMem) {
+        return appendSharedAvMem(data, size);
+    }
+    mPesOutput.insert(mPesOutput.end(), data, data + size);
+    return true;
+}
+
+bool Filter::appendSharedAvMem(const int8_t* data, size_t size) {
+    if (mSharedAvMem == nullptr) {
+        return false;
+    }
+    size_t offset = mSharedAvMemOffset + mSharedAvMemPendingSize;
+    if (offset + size > BUFFER_SIZE) {
+        ALOGE("[Filter] shared av memory full, %zu bytes dropped", size);
+        return false;
+    }
+    memcpy(mSharedAvMem + offset, data, size);
+    mSharedAvMemPendingSize += size;
+    return true;
+}
+
 ::ndk::ScopedAStatus Filter::createMediaFilterEventWithIon(vector<int8_t>& output) {
     if (mUsingSharedAvMem) {
         if (mSharedAvMemHandle == nullptr) {
             return ::ndk::ScopedAStatus::fromServiceSpecificError(
                     static_cast<int32_t>(Result::UNKNOWN_ERROR));
         }
-        return createShareMemMediaEvents(output);
+        // The data of the PES packets is already in the shared memory
+        if (!output.empty() && !appendSharedAvMem(output.data(), output.size())) {
+            return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                    static_cast<int32_t>(Result::OUT_OF_MEMORY));
+        }
+        output.clear();
+        return createShareMemMediaEvents();
     }
 
     return createIndependentMediaEvents(output);
@@ -970,6 +1127,7 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
 
 ::ndk::ScopedAStatus Filter::startRecordFilterHandler() {
     std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
+    takeFilterInput(mRecordFilterInput, mRecordFilterOutput);
     if (mRecordFilterOutput.empty()) {
         return ::ndk::ScopedAStatus::ok();
     }
@@ -1010,77 +1168,294 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
 // Read PSI (Program Specific Information) Sections from TransportStreams
 // as defined in ISO/IEC 13818-1 Section 2.4.4
 bool Filter::writeSectionsAndCreateEvent(vector<int8_t>& data) {
-    // TODO check how many sections has been read
-    ALOGD("[Filter] section handler");
+    if (DEBUG_FILTER) {
+        ALOGD("[Filter] section handler");
+    }
 
     // Transport Stream Packets are 188 bytes long, as defined in the
     // Introduction of ISO/IEC 13818-1
-    for (int i = 0; i < data.size(); i += 188) {
-        if (mSectionSizeLeft == 0) {
-            // Location for sectionSize as defined by Section 2.4.4
-            // Note that the first 4 bytes skipped are the TsHeader
-            mSectionSizeLeft = ((static_cast<uint8_t>(data[i + 5]) & 0x0f) << 8) |
-                               static_cast<uint8_t>(data[i + 6]);
-            mSectionSizeLeft += 3;
-            if (DEBUG_FILTER) {
-                ALOGD("[Filter] section data length %d", mSectionSizeLeft);
-            }
+    for (size_t i = 0; i + TS_SIZE <= data.size(); i += TS_SIZE) {
+        const uint8_t* packet = reinterpret_cast<const uint8_t*>(data.data() + i);
+        bool discontinuity = false;
+        int offset = getTsPayloadOffset(packet, &discontinuity);
+        if (offset < 0) {
+            continue;
+        }
+        const uint8_t* payload = packet + offset;
+        size_t size = TS_SIZE - offset;
+        if (discontinuity) {
+            ALOGW("[Filter] filter %" PRIu64 " lost TS packets, dropping the section", mFilterId);
+            dropSection();
+            mSectionSynced = false;
         }
 
-        // 184 bytes per packet is derived by subtracting the 4 byte length of
-        // the TsHeader from its 188 byte packet size
-        uint32_t endPoint = min(184u, mSectionSizeLeft);
-        // append data and check size
-        vector<int8_t>::const_iterator first = data.begin() + i + 4;
-        vector<int8_t>::const_iterator last = data.begin() + i + 4 + endPoint;
-        mSectionOutput.insert(mSectionOutput.end(), first, last);
-        // size does not match then continue
-        mSectionSizeLeft -= endPoint;
-        if (DEBUG_FILTER) {
-            ALOGD("[Filter] section data left %d", mSectionSizeLeft);
+        if (packet[1] & 0x40) {
+            // The pointer field gives the number of bytes ending the section in progress
+            size_t pointerField = payload[0];
+            if (1 + pointerField > size) {
+                dropSection();
+                mSectionSynced = false;
+                continue;
+            }
+            if (mSectionSynced && mSectionInProgress) {
+                int consumed = appendSectionData(payload + 1, pointerField);
+                if (consumed < 0) {
+                    return false;
+                }
+            }
+            // A section not done by the pointer field is corrupt
+            dropSection();
+            payload += 1 + pointerField;
+            size -= 1 + pointerField;
+            mSectionSynced = true;
         }
-        if (mSectionSizeLeft > 0) {
-            continue;
+        // Several sections can follow each other in a packet
+        while (mSectionSynced && size > 0) {
+            int consumed = appendSectionData(payload, size);
+            if (consumed < 0) {
+                return false;
+            }
+            payload += consumed;
+            size -= consumed;
         }
+    }
 
-        if (!writeDataToFilterMQ(mSectionOutput)) {
-            mSectionOutput.clear();
-            return false;
+    return true;
+}
+
+int Filter::appendSectionData(const uint8_t* data, size_t size) {
+    if (!mSectionInProgress) {
+        if (size == 0) {
+            return 0;
         }
+        if (data[0] == 0xff) {
+            // Stuffing bytes until the next packet starting a section
+            mSectionSynced = false;
+            return size;
+        }
+        mSectionInProgress = true;
+        mSectionHeaderSize = 0;
+        mSectionLength = 0;
+        mSectionWritten = 0;
+        mSectionCrc = 0xffffffff;
+    }
 
-        DemuxFilterSectionEvent secEvent;
-        secEvent = {
-                // temp dump meta data
-                .tableId = 0,
-                .version = 1,
-                .sectionNum = 1,
-                .dataLength = static_cast<int32_t>(mSectionOutput.size()),
-        };
+    // The section length is known once the 3 first bytes are in
+    size_t count = mSectionLength != 0 ? min<size_t>(size, mSectionLength - mSectionWritten)
+                                       : min<size_t>(size, 3 - mSectionHeaderSize);
+    for (size_t i = 0; i < count && mSectionHeaderSize < sizeof(mSectionHeader); i++) {
+        mSectionHeader[mSectionHeaderSize++] = data[i];
+    }
+    mSectionCrc = updateCrc32(mSectionCrc, data, count);
+    for (size_t i = count > 4 ? count - 4 : 0; i < count; i++) {
+        mSectionTail = (mSectionTail << 8) | data[i];
+    }
+    if (!appendToFilterMQ(reinterpret_cast<const int8_t*>(data), count)) {
+        dropSection();
+        return -1;
+    }
+    mSectionWritten += count;
+    if (mSectionLength == 0 && mSectionHeaderSize >= 3) {
+        mSectionLength = 3 + (((mSectionHeader[1] & 0x0f) << 8) | mSectionHeader[2]);
         if (DEBUG_FILTER) {
-            ALOGD("[Filter] assembled section data length %" PRIu64, secEvent.dataLength);
+            ALOGD("[Filter] section data length %d", mSectionLength);
+        }
+        if (mSectionLength > MAX_SECTION_SIZE) {
+            dropSection();
+            mSectionSynced = false;
+            return size;
+        }
+    }
+    if (mSectionLength != 0 && mSectionWritten == mSectionLength && !finishSection()) {
+        return -1;
+    }
+    return count;
+}
+
+bool Filter::finishSection() {
+    mSectionInProgress = false;
+    // Sections of the long form (section_syntax_indicator set) end with a CRC_32, which
+    // identifies them: a section repeated with the same version has the same CRC_32.
+    // mSectionTail holds that CRC_32.
+    bool isLongForm = (mSectionHeader[1] & 0x80) && mSectionLength >= 12;
+    if (isLongForm) {
+        const DemuxTsFilterSettings& tsSettings =
+                mFilterSettings.get<DemuxFilterSettings::Tag::ts>();
+        bool isCheckCrc =
+                tsSettings.filterSettings.getTag() ==
+                        DemuxTsFilterSettingsFilterSettings::Tag::section &&
+                tsSettings.filterSettings.get<DemuxTsFilterSettingsFilterSettings::Tag::section>()
+                        .isCheckCrc;
+        // The CRC of a whole section, its CRC_32 included, is 0
+        if (isCheckCrc && mSectionCrc != 0) {
+            ALOGW("[Filter] filter %" PRIu64 " drops a section with a wrong CRC", mFilterId);
+            dropFilterMQ();
+            return true;
         }
+        // table_id, table_id_extension and section_number
+        uint32_t key = (mSectionHeader[0] << 24) | (mSectionHeader[3] << 16) |
+                       (mSectionHeader[4] << 8) | mSectionHeader[6];
+        auto it = mSectionCrcs.find(key);
+        if (it != mSectionCrcs.end() && it->second == mSectionTail) {
+            dropFilterMQ();
+            return true;
+        }
+        mSectionCrcs[key] = mSectionTail;
+    }
+    if (!commitFilterMQ()) {
+        return false;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(mFilterEventsLock);
-            mFilterEvents.push_back(
-                    DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
+    DemuxFilterSectionEvent secEvent;
+    secEvent = {
+            .tableId = mSectionHeader[0],
+            .version = isLongForm ? (mSectionHeader[5] >> 1) & 0x1f : 0,
+            .sectionNum = isLongForm ? mSectionHeader[6] : 0,
+            .dataLength = static_cast<int64_t>(mSectionLength),
+    };
+    if (DEBUG_FILTER) {
+        ALOGD("[Filter] assembled section data length %" PRIu64, secEvent.dataLength);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
+    }
+    return true;
+}
+
+void Filter::dropSection() {
+    if (mSectionInProgress) {
+        dropFilterMQ();
+        mSectionInProgress = false;
+    }
+}
+
+uint32_t Filter::updateCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+    // CRC-32/MPEG-2 of ISO/IEC 13818-1 Annex A, polynomial 0x04c11db7 without reflection
+    static const vector<uint32_t> table = [] {
+        vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 0x80000000) ? (value << 1) ^ 0x04c11db7 : value << 1;
+            }
+            table[i] = value;
         }
-        mSectionOutput.clear();
+        return table;
+    }();
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xff];
     }
+    return crc;
+}
 
+bool Filter::appendToFilterMQ(const int8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    FilterMQ::MemTransaction tx;
+    if (!mFilterMQ->beginWrite(mPendingFilterMQSize + size, &tx) ||
+        !tx.copyTo(data, mPendingFilterMQSize, size)) {
+        return false;
+    }
+    mPendingFilterMQSize += size;
     return true;
 }
 
-bool Filter::writeDataToFilterMQ(const std::vector<int8_t>& data) {
+bool Filter::commitFilterMQ() {
     std::lock_guard<std::mutex> lock(mWriteLock);
-    if (mFilterMQ->write(data.data(), data.size())) {
-        return true;
+    bool result = mFilterMQ->commitWrite(mPendingFilterMQSize);
+    mPendingFilterMQSize = 0;
+    return result;
+}
+
+void Filter::dropFilterMQ() {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    mPendingFilterMQSize = 0;
+}
+
+void Filter::indexRecordPacket(const uint8_t* header, uint16_t pid, size_t packetSize) {
+    // The byte number counts from the beginning of the output of the filter
+    int64_t byteNumber = mRecordByteNumber;
+    mRecordByteNumber += packetSize;
+    if (pid != mTpid || mFilterSettings.getTag() != DemuxFilterSettings::Tag::ts) {
+        return;
+    }
+    const DemuxTsFilterSettings& tsSettings = mFilterSettings.get<DemuxFilterSettings::Tag::ts>();
+    if (tsSettings.filterSettings.getTag() != DemuxTsFilterSettingsFilterSettings::Tag::record) {
+        return;
+    }
+    int32_t tsIndexMask =
+            tsSettings.filterSettings.get<DemuxTsFilterSettingsFilterSettings::Tag::record>()
+                    .tsIndexMask;
+    if (tsIndexMask == 0) {
+        return;
+    }
+
+    int32_t index = 0;
+    if (!mRecordIndexStarted) {
+        index |= static_cast<int32_t>(DemuxTsIndex::FIRST_PACKET);
+        mRecordIndexStarted = true;
+    }
+    if (header[1] & 0x40) {
+        index |= static_cast<int32_t>(DemuxTsIndex::PAYLOAD_UNIT_START_INDICATOR);
+    }
+    uint8_t scramblingControl = header[3] >> 6;
+    if (scramblingControl != mRecordScramblingControl) {
+        switch (scramblingControl) {
+            case 0:
+                index |= static_cast<int32_t>(DemuxTsIndex::CHANGE_TO_NOT_SCRAMBLED);
+                break;
+            case 2:
+                index |= static_cast<int32_t>(DemuxTsIndex::CHANGE_TO_EVEN_SCRAMBLED);
+                break;
+            case 3:
+                index |= static_cast<int32_t>(DemuxTsIndex::CHANGE_TO_ODD_SCRAMBLED);
+                break;
+            default:
+                break;
+        }
+        mRecordScramblingControl = scramblingControl;
+    }
+    // The flags of the adaptation field (ISO/IEC 13818-1 2.4.3.4)
+    if ((header[3] & 0x20) && header[4] > 0) {
+        static const std::pair<uint8_t, DemuxTsIndex> kAdaptationFlags[] = {
+                {0x80, DemuxTsIndex::DISCONTINUITY_INDICATOR},
+                {0x40, DemuxTsIndex::RANDOM_ACCESS_INDICATOR},
+                {0x20, DemuxTsIndex::PRIORITY_INDICATOR},
+                {0x10, DemuxTsIndex::PCR_FLAG},
+                {0x08, DemuxTsIndex::OPCR_FLAG},
+                {0x04, DemuxTsIndex::SPLICING_POINT_FLAG},
+                {0x02, DemuxTsIndex::PRIVATE_DATA},
+                {0x01, DemuxTsIndex::ADAPTATION_EXTENSION_FLAG},
+        };
+        for (const auto& [flag, flagIndex] : kAdaptationFlags) {
+            if (header[5] & flag) {
+                index |= static_cast<int32_t>(flagIndex);
+            }
+        }
+    }
+    index &= tsIndexMask;
+    if (index == 0) {
+        return;
+    }
+
+    DemuxFilterTsRecordEvent recordEvent;
+    recordEvent.pid.set<DemuxPid::Tag::tPid>(pid);
+    recordEvent.tsIndexMask = index;
+    recordEvent.byteNumber = byteNumber;
+    recordEvent.pts = mPts;
+    {
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterEvents.push_back(
+                DemuxFilterEvent::make<DemuxFilterEvent::Tag::tsRecord>(recordEvent));
     }
-    return false;
 }
 
 void Filter::attachFilterToRecord(const std::shared_ptr<Dvr> dvr) {
     mDvr = dvr;
+    mRecordByteNumber = 0;
+    mRecordIndexStarted = false;
+    mRecordScramblingControl = 0;
 }
 
 void Filter::detachFilterFromRecord() {
@@ -1131,29 +1506,91 @@ native_handle_t* Filter::createNativeHandle(int fd) {
     return nativeHandle;
 }
 
+bool Filter::acquireAvBuffer(size_t size, AvBuffer* buffer) {
+    {
+        // Reuse the smallest released buffer the data fits in
+        std::lock_guard<std::mutex> lock(mAvBufferLock);
+        auto best = mFreeAvBuffers.end();
+        for (auto it = mFreeAvBuffers.begin(); it != mFreeAvBuffers.end(); it++) {
+            if (it->size >= size && (best == mFreeAvBuffers.end() || it->size < best->size)) {
+                best = it;
+            }
+        }
+        if (best != mFreeAvBuffers.end()) {
+            *buffer = *best;
+            mFreeAvBuffers.erase(best);
+            return true;
+        }
+    }
+
+    // A full pool of buffers takes about the buffer size of the filter. The buffer stays mapped
+    // until it is freed, so a reused buffer costs neither an allocation nor a mapping.
+    size_t bufferSize = std::max<size_t>(size, mBufferSize / AV_BUFFER_POOL_SIZE);
+    buffer->fd = createAvIonFd(bufferSize);
+    if (buffer->fd < 0) {
+        return false;
+    }
+    buffer->data = getIonBuffer(buffer->fd, bufferSize);
+    if (buffer->data == nullptr) {
+        ::close(buffer->fd);
+        return false;
+    }
+    buffer->size = bufferSize;
+    return true;
+}
+
+void Filter::recycleAvBuffer(const AvBuffer& buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mAvBufferLock);
+        if (mFreeAvBuffers.size() < AV_BUFFER_POOL_SIZE) {
+            mFreeAvBuffers.push_back(buffer);
+            return;
+        }
+    }
+    freeAvBuffer(buffer);
+}
+
+void Filter::freeAvBuffer(const AvBuffer& buffer) {
+    munmap(buffer.data, buffer.size);
+    ::close(buffer.fd);
+}
+
+void Filter::freeAvBuffers() {
+    std::lock_guard<std::mutex> lock(mAvBufferLock);
+    for (const auto& buffer : mFreeAvBuffers) {
+        freeAvBuffer(buffer);
+    }
+    mFreeAvBuffers.clear();
+    // The client keeps its own fds of the buffers it has not released
+    for (const auto& [dataId, buffer] : mDataId2AvBuffer) {
+        freeAvBuffer(buffer);
+    }
+    mDataId2AvBuffer.clear();
+}
+
 ::ndk::ScopedAStatus Filter::createIndependentMediaEvents(vector<int8_t>& output) {
-    int av_fd = createAvIonFd(output.size());
-    if (av_fd == -1) {
+    AvBuffer buffer;
+    if (!acquireAvBuffer(output.size(), &buffer)) {
         return ::ndk::ScopedAStatus::fromServiceSpecificError(
                 static_cast<int32_t>(Result::UNKNOWN_ERROR));
     }
     // copy the filtered data to the buffer
-    uint8_t* avBuffer = getIonBuffer(av_fd, output.size());
-    if (avBuffer == NULL) {
-        return ::ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int32_t>(Result::UNKNOWN_ERROR));
-    }
-    memcpy(avBuffer, output.data(), output.size() * sizeof(uint8_t));
+    memcpy(buffer.data, output.data(), output.size() * sizeof(uint8_t));
 
-    native_handle_t* nativeHandle = createNativeHandle(av_fd);
+    native_handle_t* nativeHandle = createNativeHandle(buffer.fd);
     if (nativeHandle == NULL) {
+        recycleAvBuffer(buffer);
         return ::ndk::ScopedAStatus::fromServiceSpecificError(
                 static_cast<int32_t>(Result::UNKNOWN_ERROR));
     }
 
-    // Create a dataId and add a <dataId, av_fd> pair into the dataId2Avfd map
-    uint64_t dataId = mLastUsedDataId++ /*createdUID*/;
-    mDataId2Avfd[dataId] = dup(av_fd);
+    // Create a dataId and hold the buffer for the client until it releases the dataId
+    uint64_t dataId;
+    {
+        std::lock_guard<std::mutex> lock(mAvBufferLock);
+        dataId = mLastUsedDataId++ /*createdUID*/;
+        mDataId2AvBuffer[dataId] = buffer;
+    }
 
     // Create mediaEvent and send callback
     auto event = DemuxFilterEvent::make<DemuxFilterEvent::Tag::media>();
@@ -1182,16 +1619,7 @@ native_handle_t* Filter::createNativeHandle(int fd) {
     return ::ndk::ScopedAStatus::ok();
 }
 
-::ndk::ScopedAStatus Filter::createShareMemMediaEvents(vector<int8_t>& output) {
-    // copy the filtered data to the shared buffer
-    uint8_t* sharedAvBuffer =
-            getIonBuffer(mSharedAvMemHandle->data[0], output.size() + mSharedAvMemOffset);
-    if (sharedAvBuffer == NULL) {
-        return ::ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int32_t>(Result::UNKNOWN_ERROR));
-    }
-    memcpy(sharedAvBuffer + mSharedAvMemOffset, output.data(), output.size() * sizeof(uint8_t));
-
+::ndk::ScopedAStatus Filter::createShareMemMediaEvents() {
     // Create a memory handle with numFds == 0
     native_handle_t* nativeHandle = createNativeHandle(-1);
     if (nativeHandle == NULL) {
@@ -1204,7 +1632,7 @@ native_handle_t* Filter::createNativeHandle(int fd) {
     auto& mediaEvent = event.get<DemuxFilterEvent::Tag::media>();
     mediaEvent.avMemory = ::android::dupToAidl(nativeHandle);
     mediaEvent.offset = mSharedAvMemOffset;
-    mediaEvent.dataLength = static_cast<int64_t>(output.size());
+    mediaEvent.dataLength = static_cast<int64_t>(mSharedAvMemPendingSize);
     if (mPts) {
         mediaEvent.pts = mPts;
         mPts = 0;
@@ -1215,15 +1643,15 @@ native_handle_t* Filter::createNativeHandle(int fd) {
         mFilterEvents.push_back(std::move(event));
     }
 
-    mSharedAvMemOffset += output.size();
+    mSharedAvMemOffset += mSharedAvMemPendingSize;
 
     // Clear and log
     native_handle_close(nativeHandle);
     native_handle_delete(nativeHandle);
-    output.clear();
     if (DEBUG_FILTER) {
-        ALOGD("[Filter] shared av data length %d", static_cast<int32_t>(output.size()));
+        ALOGD("[Filter] shared av data length %zu", mSharedAvMemPendingSize);
     }
+    mSharedAvMemPendingSize = 0;
     return ::ndk::ScopedAStatus::ok();
 }
 
@@ -1283,21 +1711,25 @@ void Filter::createMediaEvent(vector<DemuxFilterEvent>& events, bool isAudioPres
         mediaEvent.extraMetaData.set<DemuxFilterMediaEventExtraMetaData::Tag::audio>(audio);
     }
 
-    int av_fd = createAvIonFd(BUFFER_SIZE);
-    if (av_fd == -1) {
+    AvBuffer buffer;
+    if (!acquireAvBuffer(BUFFER_SIZE, &buffer)) {
         return;
     }
 
-    native_handle_t* nativeHandle = createNativeHandle(av_fd);
+    native_handle_t* nativeHandle = createNativeHandle(buffer.fd);
     if (nativeHandle == nullptr) {
-        ::close(av_fd);
+        recycleAvBuffer(buffer);
         ALOGE("[Filter] Failed to create native_handle %d", errno);
         return;
     }
 
-    // Create a dataId and add a <dataId, av_fd> pair into the dataId2Avfd map
-    uint64_t dataId = mLastUsedDataId++ /*createdUID*/;
-    mDataId2Avfd[dataId] = dup(av_fd);
+    // Create a dataId and hold the buffer for the client until it releases the dataId
+    uint64_t dataId;
+    {
+        std::lock_guard<std::mutex> lock(mAvBufferLock);
+        dataId = mLastUsedDataId++ /*createdUID*/;
+        mDataId2AvBuffer[dataId] = buffer;
+    }
 
     mediaEvent.avDataId = static_cast<int64_t>(dataId);
     mediaEvent.avMemory = ::android::dupToAidl(nativeHandle);
@@ -52,6 +52,14 @@ using ::android::hardware::EventFlag;
 using FilterMQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
 
 const uint32_t BUFFER_SIZE = 0x800000;  // 8 MB
+// Largest private section (ISO/IEC 13818-1 2.4.4.10)
+const uint32_t MAX_SECTION_SIZE = 4096;
+// Capacity reserved for the TS packets dispatched to a filter between two handler runs
+const uint32_t FILTER_OUTPUT_RESERVED_SIZE = 188 * 512;
+// Most events coalesced into one filter callback, to bound the size of its binder transaction
+const size_t MAX_COALESCED_FILTER_EVENT_COUNT = 1024;
+// Most released A/V buffers kept mapped for the next media events of a filter
+const size_t AV_BUFFER_POOL_SIZE = 8;
 
 class Demux;
 class Dvr;
@@ -62,6 +70,8 @@ class FilterCallbackScheduler final {
     ~FilterCallbackScheduler();
 
     void onFilterEvent(DemuxFilterEvent&& event);
+    // Queues the events of a handler run, to be sent in the same callback
+    void onFilterEvents(std::vector<DemuxFilterEvent>&& events);
     void onFilterStatus(const DemuxFilterStatus& status);
 
     void setTimeDelayHint(int timeDelay);
@@ -79,7 +89,7 @@ class FilterCallbackScheduler final {
     void threadLoopOnce();
 
     // function needs to be called while holding mLock
-    bool isDataSizeDelayConditionMetLocked();
+    bool isDelayConditionMetLocked();
 
     static int getDemuxFilterEventDataLength(const DemuxFilterEvent& event);
 
@@ -136,11 +146,16 @@ class Filter : public BnFilter {
      */
     bool createFilterMQ();
     uint16_t getTpid();
-    void updateFilterOutput(vector<int8_t>& data);
-    void updateRecordOutput(vector<int8_t>& data);
+    void updateFilterOutput(const int8_t* data, size_t size);
+    void updateRecordOutput(const int8_t* data, size_t size);
     void updatePts(uint64_t pts);
     ::ndk::ScopedAStatus startFilterHandler();
     ::ndk::ScopedAStatus startRecordFilterHandler();
+    /**
+     * Called for each TS packet written into the record FMQ of the filter, with its TS header.
+     * Creates the ts record event of the indexes of the record settings found in the packet.
+     */
+    void indexRecordPacket(const uint8_t* header, uint16_t pid, size_t packetSize);
     void attachFilterToRecord(const std::shared_ptr<Dvr> dvr);
     void detachFilterFromRecord();
     void freeSharedAvHandle();
@@ -169,9 +184,20 @@ class Filter : public BnFilter {
     uint16_t mTpid;
     std::shared_ptr<IFilter> mDataSource;
     bool mIsDataSourceDemux = true;
+    /**
+     * The data dispatched to the filter goes to the input buffers, which the handlers swap
+     * with their output buffers, so the dispatch does not wait for a running handler.
+     */
+    vector<int8_t> mFilterInput;
+    vector<int8_t> mRecordFilterInput;
     vector<int8_t> mFilterOutput;
     vector<int8_t> mRecordFilterOutput;
     int64_t mPts = 0;
+
+    // Indexing of the TS packets of the record, only used by the DVR thread
+    int64_t mRecordByteNumber = 0;
+    bool mRecordIndexStarted = false;
+    uint8_t mRecordScramblingControl = 0;
     unique_ptr<FilterMQ> mFilterMQ;
     bool mIsUsingFMQ = false;
     EventFlag* mFilterEventsFlag;
@@ -209,12 +235,36 @@ class Filter : public BnFilter {
     ::ndk::ScopedAStatus startFilterLoop();
 
     void deleteEventFlag();
-    bool writeDataToFilterMQ(const std::vector<int8_t>& data);
+    /**
+     * The data of a section or a PES packet is assembled in place in the free space of the
+     * filter FMQ, and only made readable once complete by commitFilterMQ.
+     * appendToFilterMQ returns false if the FMQ is full.
+     */
+    bool appendToFilterMQ(const int8_t* data, size_t size);
+    bool commitFilterMQ();
+    void dropFilterMQ();
     bool readDataFromMQ();
     bool writeSectionsAndCreateEvent(vector<int8_t>& data);
+    // Moves the data of 'input' to the end of 'output'
+    void takeFilterInput(vector<int8_t>& input, vector<int8_t>& output);
+    /**
+     * The section and PES packet reassembly. Each TS packet is parsed once, as it arrives,
+     * following the continuity counter, and the data is written to the filter FMQ.
+     *
+     * Returns the offset of the payload of 'packet', or -1 if it has none or is a duplicate.
+     * 'discontinuity' is set if packets were lost before it.
+     */
+    int getTsPayloadOffset(const uint8_t* packet, bool* discontinuity);
+    // Returns the bytes of 'data' consumed by the section in progress, or -1 on error.
+    int appendSectionData(const uint8_t* data, size_t size);
+    bool finishSection();
+    void dropSection();
+    bool finishPesPacket();
+    static uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size);
     void maySendFilterStatusCallback();
     DemuxFilterStatus checkFilterStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
-                                              uint32_t highThreshold, uint32_t lowThreshold);
+                                              uint32_t highThreshold, uint32_t lowThreshold,
+                                              uint32_t hysteresis);
     /**
      * A dispatcher to read and dispatch input data to all the started filters.
      * Each filter handler handles the data filtering/output writing/filterEvent updating.
@@ -223,12 +273,29 @@ class Filter : public BnFilter {
     static void* __threadLoopFilter(void* user);
     void filterThreadLoop();
 
+    // A mapped A/V buffer of an independent media event
+    struct AvBuffer {
+        int fd = -1;
+        uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
     int createAvIonFd(int size);
     uint8_t* getIonBuffer(int fd, int size);
     native_handle_t* createNativeHandle(int fd);
+    bool acquireAvBuffer(size_t size, AvBuffer* buffer);
+    void recycleAvBuffer(const AvBuffer& buffer);
+    static void freeAvBuffer(const AvBuffer& buffer);
+    void freeAvBuffers();
+    /**
+     * Appends media data to the pending output of the next media event. The data goes
+     * straight into the shared A/V memory when the client uses it, otherwise into mPesOutput.
+     */
+    bool appendMediaOutput(const int8_t* data, size_t size);
+    bool appendSharedAvMem(const int8_t* data, size_t size);
     ::ndk::ScopedAStatus createMediaFilterEventWithIon(vector<int8_t>& output);
     ::ndk::ScopedAStatus createIndependentMediaEvents(vector<int8_t>& output);
-    ::ndk::ScopedAStatus createShareMemMediaEvents(vector<int8_t>& output);
+    ::ndk::ScopedAStatus createShareMemMediaEvents();
     bool sameFile(int fd1, int fd2);
 
     void createMediaEvent(vector<DemuxFilterEvent>&, bool isAudioPresentation);
@@ -255,27 +322,59 @@ class Filter : public BnFilter {
      * Lock to protect writes to the input status
      */
     std::mutex mFilterStatusLock;
+    std::mutex mAvBufferLock;
+    std::mutex mFilterInputLock;
     std::mutex mFilterOutputLock;
     std::mutex mRecordFilterOutputLock;
 
-    // handle single Section filter
-    uint32_t mSectionSizeLeft = 0;
-    vector<int8_t> mSectionOutput;
+    // Size of the data assembled in the free space of the filter FMQ, protected by mWriteLock
+    size_t mPendingFilterMQSize = 0;
 
-    // temp handle single PES filter
-    // TODO handle mulptiple Pes filters
+    // Continuity counter of the last TS packet with payload, -1 if none
+    int mContinuityCounter = -1;
+
+    // handle single Section filter
+    // If a packet starting a section was received since the last loss
+    bool mSectionSynced = false;
+    bool mSectionInProgress = false;
+    // The first bytes of the section in progress, up to section_number
+    uint8_t mSectionHeader[7];
+    size_t mSectionHeaderSize = 0;
+    // 0 until the section_length is read
+    uint32_t mSectionLength = 0;
+    uint32_t mSectionWritten = 0;
+    // CRC of the section in progress, and its last 4 bytes
+    uint32_t mSectionCrc = 0;
+    uint32_t mSectionTail = 0;
+    // CRC_32 of the last section by table_id, table_id_extension and section_number
+    std::map<uint32_t, uint32_t> mSectionCrcs;
+
+    // handle single PES filter
+    bool mPesInProgress = false;
+    uint8_t mPesStreamId = 0;
+    // 0 for an unspecified length
+    uint32_t mPesLength = 0;
+    uint32_t mPesWritten = 0;
+
+    // temp handle single media PES
     uint32_t mPesSizeLeft = 0;
     vector<int8_t> mPesOutput;
 
-    // A map from data id to ion handle
-    std::map<uint64_t, int> mDataId2Avfd;
+    // A map from data id to the A/V buffer held by the client, and the released buffers
+    // waiting to be reused. Both are protected by mAvBufferLock.
+    std::map<uint64_t, AvBuffer> mDataId2AvBuffer;
+    vector<AvBuffer> mFreeAvBuffers;
     uint64_t mLastUsedDataId = 1;
     int mAvBufferCopyCount = 0;
 
     // Shared A/V memory handle
     native_handle_t* mSharedAvMemHandle = nullptr;
+    // Mapping of the BUFFER_SIZE bytes of the shared A/V memory
+    uint8_t* mSharedAvMem = nullptr;
     bool mUsingSharedAvMem = false;
     int64_t mSharedAvMemOffset = 0;
+    // Size of the data written after mSharedAvMemOffset for the next media event
+    size_t mSharedAvMemPendingSize = 0;
 
     uint32_t mAudioStreamType;
     uint32_t mVideoStreamType;
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.tv.tuner-service.example-FilterExecutor"
+
+#include "FilterExecutor.h"
+
+#include <utils/Log.h>
+#include <algorithm>
+
+#include "Filter.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+// The handlers mostly copy data, more workers than this contend on the FMQs
+const size_t MAX_FILTER_WORKER_COUNT = 4;
+
+FilterExecutor::FilterExecutor() {}
+
+FilterExecutor::~FilterExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mWorkCondition.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+bool FilterExecutor::schedule(int64_t filterId, const std::shared_ptr<Filter>& filter,
+                              bool isRecord) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mWorkers.empty()) {
+        size_t count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1,
+                                          MAX_FILTER_WORKER_COUNT);
+        for (size_t i = 0; i < count; i++) {
+            mWorkers.emplace_back(&FilterExecutor::workerLoop, this);
+        }
+    }
+
+    Entry& entry = mEntries[filterId];
+    if (entry.filter == nullptr) {
+        entry.filter = filter;
+        entry.isRecord = isRecord;
+    }
+    if (entry.running) {
+        entry.rerun = true;
+    } else if (!entry.queued) {
+        entry.queued = true;
+        mQueue.push_back(&entry);
+        mWorkCondition.notify_one();
+    }
+
+    bool result = !mFailed;
+    mFailed = false;
+    return result;
+}
+
+void FilterExecutor::waitIdle() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mIdleCondition.wait(lock, [this] { return mQueue.empty() && mRunningCount == 0; });
+}
+
+void FilterExecutor::remove(int64_t filterId) {
+    std::shared_ptr<Filter> filter;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        auto it = mEntries.find(filterId);
+        if (it == mEntries.end()) {
+            return;
+        }
+        Entry* entry = &it->second;
+        mIdleCondition.wait(lock, [entry] { return !entry->running; });
+        mQueue.erase(std::remove(mQueue.begin(), mQueue.end(), entry), mQueue.end());
+        // The last reference to the filter is dropped without the lock
+        filter = std::move(entry->filter);
+        mEntries.erase(it);
+    }
+}
+
+void FilterExecutor::removeAll() {
+    std::map<int64_t, Entry> entries;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mIdleCondition.wait(lock, [this] { return mRunningCount == 0; });
+        mQueue.clear();
+        entries.swap(mEntries);
+    }
+}
+
+void FilterExecutor::workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mWorkCondition.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+        if (mStopping) {
+            return;
+        }
+        Entry* entry = mQueue.front();
+        mQueue.pop_front();
+        entry->queued = false;
+        entry->running = true;
+        mRunningCount++;
+        // remove() waits for the run, so the entry and its filter outlive it
+        Filter* filter = entry->filter.get();
+        bool isRecord = entry->isRecord;
+        lock.unlock();
+
+        bool result = isRecord ? filter->startRecordFilterHandler().isOk()
+                               : filter->startFilterHandler().isOk();
+
+        lock.lock();
+        entry->running = false;
+        mRunningCount--;
+        if (!result) {
+            mFailed = true;
+        }
+        if (entry->rerun) {
+            entry->rerun = false;
+            entry->queued = true;
+            mQueue.push_back(entry);
+            mWorkCondition.notify_one();
+        }
+        mIdleCondition.notify_all();
+    }
+}
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+class Filter;
+
+/**
+ * Runs the filter handlers of a demux on a pool of worker threads, so the input thread of the
+ * demux goes back to dispatching data while the filters process theirs.
+ *
+ * The runs of a filter are serialized: a filter scheduled while its handler runs is run again
+ * once the handler returns, and sees its data in order. The handlers of different filters run
+ * in parallel.
+ */
+class FilterExecutor {
+  public:
+    FilterExecutor();
+    ~FilterExecutor();
+
+    /**
+     * Runs the filter handler, or the record filter handler, of 'filter' on a worker thread.
+     * Returns false if a handler failed since the last call.
+     */
+    bool schedule(int64_t filterId, const std::shared_ptr<Filter>& filter, bool isRecord);
+    // Waits for the scheduled runs of all the filters.
+    void waitIdle();
+    // Waits for the scheduled runs of the filter, and forgets it.
+    void remove(int64_t filterId);
+    void removeAll();
+
+  private:
+    struct Entry {
+        std::shared_ptr<Filter> filter;
+        bool isRecord = false;
+        bool queued = false;
+        bool running = false;
+        // scheduled while running
+        bool rerun = false;
+    };
+
+    void workerLoop();
+
+    std::mutex mLock;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mIdleCondition;
+    std::map<int64_t, Entry> mEntries;
+    std::deque<Entry*> mQueue;
+    size_t mRunningCount = 0;
+    bool mFailed = false;
+    bool mStopping = false;
+    // Started on the first schedule() call
+    std::vector<std::thread> mWorkers;
+};
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
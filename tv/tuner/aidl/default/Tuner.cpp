@@ -200,7 +200,7 @@ Tuner::~Tuner() {}
 ::ndk::ScopedAStatus Tuner::openDescrambler(std::shared_ptr<IDescrambler>* _aidl_return) {
     ALOGV("%s", __FUNCTION__);
 
-    *_aidl_return = ndk::SharedRefBase::make<Descrambler>();
+    *_aidl_return = ndk::SharedRefBase::make<Descrambler>(this->ref<Tuner>());
 
     return ndk::ScopedAStatus::ok();
 }
@@ -247,6 +247,13 @@ std::shared_ptr<Frontend> Tuner::getFrontendById(int32_t frontendId) {
     return mFrontends[frontendId];
 }
 
+std::shared_ptr<Demux> Tuner::getDemux(int32_t demuxId) {
+    ALOGV("%s", __FUNCTION__);
+
+    auto demux = mDemuxes.find(demuxId);
+    return demux != mDemuxes.end() ? demux->second : nullptr;
+}
+
 ::ndk::ScopedAStatus Tuner::openLnbByName(const std::string& /* in_lnbName */,
                                           std::vector<int32_t>* out_lnbId,
                                           std::shared_ptr<ILnb>* _aidl_return) {
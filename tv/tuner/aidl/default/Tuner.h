@@ -70,6 +70,7 @@ class Tuner : public BnTuner {
     binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
 
     std::shared_ptr<Frontend> getFrontendById(int32_t frontendId);
+    std::shared_ptr<Demux> getDemux(int32_t demuxId);
     void setFrontendAsDemuxSource(int32_t frontendId, int32_t demuxId);
     void frontendStartTune(int32_t frontendId);
     void frontendStopTune(int32_t frontendId);
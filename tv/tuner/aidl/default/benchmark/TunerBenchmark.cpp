@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput benchmark of the DVR playback path of the default tuner HAL. A synthetic TS
+// stream, with one PID per filter, is written into the playback FMQ of a Dvr running in this
+// process, and the benchmark reads the output of the section and PES filters back from their
+// FMQs, the way a client of the HAL does.
+//
+// The benchmarks sweep the bitrate the stream is paced at (0 for as fast as the HAL goes), the
+// number of filters and the mix of their types, and report:
+//   - packets_per_s: the TS packets going through the demux per second,
+//   - filter_latency_us: the average time from the write of a batch into the playback FMQ to
+//     the end of the output of a filter for that batch,
+//   - cpu_us_per_Mbit: the CPU time of the HAL threads per megabit of the stream,
+//   - allocs_per_packet: the heap allocations of the process per TS packet.
+//
+// Run with:
+//   atest android.hardware.tv.tuner-benchmark.example
+// or push the binary to the device and run it with --benchmark_filter=<regex>.
+
+#include <aidl/android/hardware/tv/tuner/BnDvrCallback.h>
+#include <aidl/android/hardware/tv/tuner/BnFilterCallback.h>
+#include <aidl/android/hardware/tv/tuner/DemuxQueueNotifyBits.h>
+#include <benchmark/benchmark.h>
+#include <fmq/AidlMessageQueue.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "Tuner.h"
+
+namespace {
+
+std::atomic<uint64_t> gAllocationCount = 0;
+
+}  // namespace
+
+// Count the heap allocations of the whole process, the HAL threads included
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        abort();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+namespace {
+
+using ::aidl::android::hardware::common::fmq::MQDescriptor;
+using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using ::android::AidlMessageQueue;
+using ::android::hardware::EventFlag;
+
+using MQ = AidlMessageQueue<int8_t, SynchronizedReadWrite>;
+
+const int32_t DVR_BUFFER_SIZE = 4 * 1024 * 1024;
+const int32_t FILTER_BUFFER_SIZE = 1024 * 1024;
+// TS packets of each filter in a batch, a multiple of 16 to keep the continuity counters going
+const int PACKETS_PER_FILTER = 64;
+const int FIRST_PID = 0x100;
+// Size of the long form section carried by each section packet, after the pointer field
+const size_t SECTION_SIZE = 180;
+const auto OUTPUT_TIMEOUT = std::chrono::seconds(2);
+
+enum FilterMix { SECTIONS, PES, MIXED };
+
+class BenchmarkDvrCallback : public BnDvrCallback {
+  public:
+    ::ndk::ScopedAStatus onPlaybackStatus(PlaybackStatus /* status */) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+    ::ndk::ScopedAStatus onRecordStatus(RecordStatus /* status */) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+};
+
+class BenchmarkFilterCallback : public BnFilterCallback {
+  public:
+    ::ndk::ScopedAStatus onFilterEvent(const std::vector<DemuxFilterEvent>& /* events */) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+    ::ndk::ScopedAStatus onFilterStatus(DemuxFilterStatus /* status */) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+};
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    // CRC-32/MPEG-2 of ISO/IEC 13818-1 Annex A
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i] << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Writes a TS packet of 'pid' starting a section or a PES packet, which fills its payload
+void makePacket(uint8_t* packet, uint16_t pid, uint8_t continuityCounter, bool isSection,
+                uint8_t version, uint32_t counter) {
+    packet[0] = 0x47;
+    packet[1] = 0x40 | (pid >> 8);
+    packet[2] = pid & 0xff;
+    packet[3] = 0x10 | (continuityCounter & 0x0f);
+    uint8_t* payload = packet + 4;
+    memset(payload, 0xff, TS_SIZE - 4);
+    if (isSection) {
+        // pointer_field, then a private section with the syntax of ISO/IEC 13818-1 2.4.4.11
+        uint8_t* section = payload + 1;
+        payload[0] = 0;
+        section[0] = 0x80;
+        section[1] = 0xb0 | ((SECTION_SIZE - 3) >> 8);
+        section[2] = (SECTION_SIZE - 3) & 0xff;
+        section[3] = pid >> 8;
+        section[4] = pid & 0xff;
+        section[5] = 0xc1 | (version & 0x1f) << 1;
+        section[6] = counter % PACKETS_PER_FILTER;
+        section[7] = PACKETS_PER_FILTER - 1;
+        for (size_t i = 8; i + 4 < SECTION_SIZE; i++) {
+            section[i] = static_cast<uint8_t>(counter + i);
+        }
+        uint32_t crc = crc32(section, SECTION_SIZE - 4);
+        for (int i = 0; i < 4; i++) {
+            section[SECTION_SIZE - 4 + i] = crc >> (24 - 8 * i);
+        }
+    } else {
+        // A video PES packet filling the payload (ISO/IEC 13818-1 2.4.3.6)
+        size_t pesPacketLength = TS_SIZE - 4 - 6;
+        payload[0] = 0;
+        payload[1] = 0;
+        payload[2] = 1;
+        payload[3] = 0xe0;
+        payload[4] = pesPacketLength >> 8;
+        payload[5] = pesPacketLength & 0xff;
+        payload[6] = 0x80;
+        payload[7] = 0;
+        payload[8] = 0;
+        for (size_t i = 9; i < TS_SIZE - 4; i++) {
+            payload[i] = static_cast<uint8_t>(counter + i);
+        }
+    }
+}
+
+struct BenchmarkFilter {
+    std::shared_ptr<IFilter> filter;
+    std::unique_ptr<MQ> mq;
+    EventFlag* eventFlag = nullptr;
+    bool isSection = false;
+    // bytes of filter output for a batch
+    size_t batchOutputSize = 0;
+};
+
+class DemuxBenchmark {
+  public:
+    bool setUp(int filterCount, FilterMix mix) {
+        mTuner = ::ndk::SharedRefBase::make<Tuner>();
+        mTuner->init();
+        std::vector<int32_t> demuxId;
+        if (!mTuner->openDemux(&demuxId, &mDemux).isOk()) {
+            return false;
+        }
+        for (int i = 0; i < filterCount; i++) {
+            bool isSection = mix == SECTIONS || (mix == MIXED && i % 2 == 0);
+            if (!openFilter(FIRST_PID + i, isSection)) {
+                return false;
+            }
+        }
+
+        if (!mDemux->openDvr(DvrType::PLAYBACK, DVR_BUFFER_SIZE,
+                             ::ndk::SharedRefBase::make<BenchmarkDvrCallback>(), &mDvr)
+                     .isOk()) {
+            return false;
+        }
+        MQDescriptor<int8_t, SynchronizedReadWrite> desc;
+        mDvr->getQueueDesc(&desc);
+        mDvrMQ = std::make_unique<MQ>(desc, true /* resetPointers */);
+        if (EventFlag::createEventFlag(mDvrMQ->getEventFlagWord(), &mDvrEventFlag) !=
+            ::android::OK) {
+            return false;
+        }
+        PlaybackSettings playback{
+                .statusMask = 0,
+                .lowThreshold = DVR_BUFFER_SIZE / 4,
+                .highThreshold = DVR_BUFFER_SIZE * 3 / 4,
+                .dataFormat = DataFormat::TS,
+                .packetSize = TS_SIZE,
+        };
+        if (!mDvr->configure(DvrSettings::make<DvrSettings::Tag::playback>(playback)).isOk() ||
+            !mDvr->start().isOk()) {
+            return false;
+        }
+
+        // Two versions of the stream, alternated so that no section is a repeat of the last
+        // section with the same number
+        for (uint8_t version = 0; version < 2; version++) {
+            mBatches[version].resize(filterCount * PACKETS_PER_FILTER * TS_SIZE);
+            uint8_t* packet = mBatches[version].data();
+            for (int i = 0; i < PACKETS_PER_FILTER; i++) {
+                for (int f = 0; f < filterCount; f++) {
+                    makePacket(packet, FIRST_PID + f, i, mFilters[f].isSection, version,
+                               version * PACKETS_PER_FILTER + i);
+                    packet += TS_SIZE;
+                }
+            }
+        }
+        return true;
+    }
+
+    void tearDown() {
+        if (mDvr != nullptr) {
+            mDvr->stop();
+            mDvr->close();
+        }
+        for (auto& filter : mFilters) {
+            filter.filter->stop();
+            filter.filter->close();
+            EventFlag::deleteEventFlag(&filter.eventFlag);
+        }
+        mFilters.clear();
+        if (mDvrEventFlag != nullptr) {
+            EventFlag::deleteEventFlag(&mDvrEventFlag);
+        }
+        if (mDemux != nullptr) {
+            mDemux->close();
+        }
+    }
+
+    // Writes a batch into the playback FMQ and reads the output of all the filters for it.
+    // Returns the sum of the output latencies of the filters, or a negative duration on timeout.
+    std::chrono::nanoseconds runBatch() {
+        const std::vector<uint8_t>& batch = mBatches[mBatchCount++ % 2];
+        auto start = std::chrono::steady_clock::now();
+        if (!mDvrMQ->write(reinterpret_cast<const int8_t*>(batch.data()), batch.size())) {
+            return std::chrono::nanoseconds(-1);
+        }
+        mDvrEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_READY));
+
+        std::chrono::nanoseconds latency(0);
+        std::vector<size_t> received(mFilters.size(), 0);
+        size_t pending = mFilters.size();
+        while (pending > 0) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - start > OUTPUT_TIMEOUT) {
+                return std::chrono::nanoseconds(-1);
+            }
+            for (size_t i = 0; i < mFilters.size(); i++) {
+                BenchmarkFilter& filter = mFilters[i];
+                if (received[i] >= filter.batchOutputSize) {
+                    continue;
+                }
+                size_t size = filter.mq->availableToRead();
+                if (size == 0) {
+                    continue;
+                }
+                mOutput.resize(std::max(mOutput.size(), size));
+                filter.mq->read(mOutput.data(), size);
+                filter.eventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
+                received[i] += size;
+                if (received[i] >= filter.batchOutputSize) {
+                    latency += now - start;
+                    pending--;
+                }
+            }
+            if (pending > 0) {
+                // Leave the CPU to the HAL threads
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        }
+        return latency;
+    }
+
+    size_t batchSize() const { return mBatches[0].size(); }
+
+  private:
+    bool openFilter(uint16_t pid, bool isSection) {
+        DemuxFilterType type{
+                .mainType = DemuxFilterMainType::TS,
+        };
+        type.subType.set<DemuxFilterSubType::Tag::tsFilterType>(
+                isSection ? DemuxTsFilterType::SECTION : DemuxTsFilterType::PES);
+        BenchmarkFilter filter;
+        filter.isSection = isSection;
+        filter.batchOutputSize = PACKETS_PER_FILTER * (isSection ? SECTION_SIZE : TS_SIZE - 4);
+        if (!mDemux->openFilter(type, FILTER_BUFFER_SIZE,
+                                ::ndk::SharedRefBase::make<BenchmarkFilterCallback>(),
+                                &filter.filter)
+                     .isOk()) {
+            return false;
+        }
+        MQDescriptor<int8_t, SynchronizedReadWrite> desc;
+        filter.filter->getQueueDesc(&desc);
+        filter.mq = std::make_unique<MQ>(desc, true /* resetPointers */);
+        if (EventFlag::createEventFlag(filter.mq->getEventFlagWord(), &filter.eventFlag) !=
+            ::android::OK) {
+            return false;
+        }
+
+        DemuxTsFilterSettings ts{
+                .tpid = pid,
+        };
+        if (isSection) {
+            ts.filterSettings.set<DemuxTsFilterSettingsFilterSettings::Tag::section>(
+                    DemuxFilterSectionSettings{.isCheckCrc = true});
+        } else {
+            ts.filterSettings.set<DemuxTsFilterSettingsFilterSettings::Tag::pesData>(
+                    DemuxFilterPesDataSettings{.streamId = 0xe0});
+        }
+        if (!filter.filter->configure(DemuxFilterSettings::make<DemuxFilterSettings::Tag::ts>(ts))
+                     .isOk() ||
+            !filter.filter->start().isOk()) {
+            return false;
+        }
+        mFilters.push_back(std::move(filter));
+        return true;
+    }
+
+    std::shared_ptr<Tuner> mTuner;
+    std::shared_ptr<IDemux> mDemux;
+    std::shared_ptr<IDvr> mDvr;
+    std::unique_ptr<MQ> mDvrMQ;
+    EventFlag* mDvrEventFlag = nullptr;
+    std::vector<BenchmarkFilter> mFilters;
+    std::vector<uint8_t> mBatches[2];
+    uint64_t mBatchCount = 0;
+    std::vector<int8_t> mOutput;
+};
+
+int64_t cpuTimeUs(int who) {
+    rusage usage{};
+    getrusage(who, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_usec;
+}
+
+// Args: the bitrate in Mbps the stream is paced at, 0 for unpaced, the filter count and the
+// FilterMix of the filters
+void BM_DvrPlayback(benchmark::State& state) {
+    const int64_t bitrateMbps = state.range(0);
+    DemuxBenchmark demux;
+    if (!demux.setUp(state.range(1), static_cast<FilterMix>(state.range(2)))) {
+        demux.tearDown();
+        state.SkipWithError("failed to set up the demux");
+        return;
+    }
+    const size_t packetCount = demux.batchSize() / TS_SIZE;
+    const auto batchDuration = std::chrono::nanoseconds(
+            bitrateMbps > 0 ? demux.batchSize() * 8 * 1000 / bitrateMbps : 0);
+
+    // The CPU time of the HAL threads is the one of the process less the one of this thread,
+    // which writes the stream and reads the filter output.
+    int64_t processCpuStart = cpuTimeUs(RUSAGE_SELF);
+    int64_t threadCpuStart = cpuTimeUs(RUSAGE_THREAD);
+    uint64_t allocationStart = gAllocationCount.load();
+    std::chrono::nanoseconds latency(0);
+    auto next = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        std::chrono::nanoseconds batchLatency = demux.runBatch();
+        if (batchLatency.count() < 0) {
+            state.SkipWithError("timed out waiting for the filter output");
+            break;
+        }
+        latency += batchLatency;
+        if (bitrateMbps > 0) {
+            next += batchDuration;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    int64_t halCpuUs = (cpuTimeUs(RUSAGE_SELF) - processCpuStart) -
+                       (cpuTimeUs(RUSAGE_THREAD) - threadCpuStart);
+    uint64_t allocations = gAllocationCount.load() - allocationStart;
+    demux.tearDown();
+
+    const double packets = static_cast<double>(state.iterations()) * packetCount;
+    const double megabits = packets * TS_SIZE * 8 / 1e6;
+    state.counters["packets_per_s"] = benchmark::Counter(packets, benchmark::Counter::kIsRate);
+    state.counters["filter_latency_us"] =
+            state.iterations() > 0
+                    ? latency.count() / 1e3 / (state.iterations() * state.range(1))
+                    : 0;
+    state.counters["cpu_us_per_Mbit"] = megabits > 0 ? halCpuUs / megabits : 0;
+    state.counters["allocs_per_packet"] = packets > 0 ? allocations / packets : 0;
+    state.SetBytesProcessed(packets * TS_SIZE);
+}
+
+BENCHMARK(BM_DvrPlayback)
+        ->ArgNames({"mbps", "filters", "mix"})
+        ->ArgsProduct({{0, 20, 80}, {1, 4, 16}, {SECTIONS, PES, MIXED}})
+        ->UseRealTime()
+        ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
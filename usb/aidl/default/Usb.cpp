@@ -26,7 +26,9 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
+#include <map>
 #include <regex>
 #include <thread>
 #include <unordered_map>
@@ -254,7 +256,9 @@ Usb::Usb()
     : mLock(PTHREAD_MUTEX_INITIALIZER),
       mRoleSwitchLock(PTHREAD_MUTEX_INITIALIZER),
       mPartnerLock(PTHREAD_MUTEX_INITIALIZER),
-      mPartnerUp(false)
+      mPartnerUp(false),
+      mPortStatusResult(Status::ERROR),
+      mPortStatusValid(false)
 {
     pthread_condattr_t attr;
     if (pthread_condattr_init(&attr)) {
@@ -470,89 +474,144 @@ bool canSwitchRoleHelper(const string &portName) {
     return false;
 }
 
+Status getPortStatusForPortHelper(const string &portName, bool connected,
+                                  PortStatus *portStatus) {
+    *portStatus = PortStatus();
+    portStatus->portName = portName;
+
+    PortRole currentRole;
+    currentRole.set<PortRole::powerRole>(PortPowerRole::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS){
+        portStatus->currentPowerRole = currentRole.get<PortRole::powerRole>();
+    } else {
+        ALOGE("Error while retrieving portNames");
+        return Status::ERROR;
+    }
+
+    currentRole.set<PortRole::dataRole>(PortDataRole::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS) {
+        portStatus->currentDataRole = currentRole.get<PortRole::dataRole>();
+    } else {
+        ALOGE("Error while retrieving current port role");
+        return Status::ERROR;
+    }
+
+    currentRole.set<PortRole::mode>(PortMode::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS) {
+        portStatus->currentMode = currentRole.get<PortRole::mode>();
+    } else {
+        ALOGE("Error while retrieving current data role");
+        return Status::ERROR;
+    }
+
+    portStatus->canChangeMode = true;
+    portStatus->canChangeDataRole = connected ? canSwitchRoleHelper(portName) : false;
+    portStatus->canChangePowerRole = connected ? canSwitchRoleHelper(portName) : false;
+
+    portStatus->supportedModes.push_back(PortMode::DRP);
+    portStatus->usbDataStatus.push_back(UsbDataStatus::ENABLED);
+
+    ALOGI("%s connected:%d canChangeMode:%d canChagedata:%d canChangePower:%d "
+          "usbDataEnabled:%d plugOrientation:%d",
+          portName.c_str(), connected, portStatus->canChangeMode,
+          portStatus->canChangeDataRole, portStatus->canChangePowerRole, 0,
+          portStatus->plugOrientation);
+
+    return Status::SUCCESS;
+}
+
 Status getPortStatusHelper(std::vector<PortStatus> *currentPortStatus) {
     std::unordered_map<string, bool> names;
     Status result = getTypeCPortNamesHelper(&names);
-    int i = -1;
-
-    if (result == Status::SUCCESS) {
-        currentPortStatus->resize(names.size());
-        for (std::pair<string, bool> port : names) {
-            i++;
-            ALOGI("%s", port.first.c_str());
-            (*currentPortStatus)[i].portName = port.first;
-
-            PortRole currentRole;
-            currentRole.set<PortRole::powerRole>(PortPowerRole::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS){
-                (*currentPortStatus)[i].currentPowerRole = currentRole.get<PortRole::powerRole>();
-            } else {
-                ALOGE("Error while retrieving portNames");
-                goto done;
-            }
-
-            currentRole.set<PortRole::dataRole>(PortDataRole::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS) {
-                (*currentPortStatus)[i].currentDataRole = currentRole.get<PortRole::dataRole>();
-            } else {
-                ALOGE("Error while retrieving current port role");
-                goto done;
-            }
 
-            currentRole.set<PortRole::mode>(PortMode::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS) {
-                (*currentPortStatus)[i].currentMode = currentRole.get<PortRole::mode>();
-            } else {
-                ALOGE("Error while retrieving current data role");
-                goto done;
-            }
+    if (result != Status::SUCCESS)
+        return Status::ERROR;
 
-            (*currentPortStatus)[i].canChangeMode = true;
-            (*currentPortStatus)[i].canChangeDataRole =
-                port.second ? canSwitchRoleHelper(port.first) : false;
-            (*currentPortStatus)[i].canChangePowerRole =
-                port.second ? canSwitchRoleHelper(port.first) : false;
-
-            (*currentPortStatus)[i].supportedModes.push_back(PortMode::DRP);
-            (*currentPortStatus)[i].usbDataStatus.push_back(UsbDataStatus::ENABLED);
-
-            ALOGI("%d:%s connected:%d canChangeMode:%d canChagedata:%d canChangePower:%d "
-                  "usbDataEnabled:%d plugOrientation:%d",
-                  i, port.first.c_str(), port.second, (*currentPortStatus)[i].canChangeMode,
-                  (*currentPortStatus)[i].canChangeDataRole,
-                  (*currentPortStatus)[i].canChangePowerRole, 0,
-                  (*currentPortStatus)[i].plugOrientation);
+    // Sorted by name, so that snapshots of the same ports compare equal.
+    std::map<string, bool> sortedNames(names.begin(), names.end());
+    currentPortStatus->resize(sortedNames.size());
+    int i = 0;
+    for (const auto &port : sortedNames) {
+        if (getPortStatusForPortHelper(port.first, port.second, &(*currentPortStatus)[i++]) !=
+            Status::SUCCESS) {
+            return Status::ERROR;
         }
-
-        return Status::SUCCESS;
     }
-done:
-    return Status::ERROR;
+
+    return Status::SUCCESS;
 }
 
-void queryVersionHelper(android::hardware::usb::Usb *usb,
-                        std::vector<PortStatus> *currentPortStatus) {
-    Status status;
-    pthread_mutex_lock(&usb->mLock);
-    status = getPortStatusHelper(currentPortStatus);
-    queryMoistureDetectionStatus(currentPortStatus);
-    queryNonCompliantChargerStatus(currentPortStatus);
+// Sends the cached port status to userspace. usb->mLock must be held.
+void notifyPortStatusLocked(android::hardware::usb::Usb *usb) {
     if (usb->mCallback != NULL) {
-        ScopedAStatus ret = usb->mCallback->notifyPortStatusChange(*currentPortStatus,
-            status);
+        ScopedAStatus ret = usb->mCallback->notifyPortStatusChange(usb->mPortStatus,
+            usb->mPortStatusResult);
         if (!ret.isOk())
             ALOGE("queryPortStatus error %s", ret.getDescription().c_str());
     } else {
         ALOGI("Notifying userspace skipped. Callback is NULL");
     }
-    pthread_mutex_unlock(&usb->mLock);
 }
 
-ScopedAStatus Usb::queryPortStatus(int64_t in_transactionId) {
+// Reads the status of all the ports into the cache and notifies userspace if it changed.
+// usb->mLock must be held.
+void refreshPortStatusLocked(android::hardware::usb::Usb *usb) {
     std::vector<PortStatus> currentPortStatus;
+    Status status = getPortStatusHelper(&currentPortStatus);
+    queryMoistureDetectionStatus(&currentPortStatus);
+    queryNonCompliantChargerStatus(&currentPortStatus);
+
+    bool changed = !usb->mPortStatusValid || status != usb->mPortStatusResult ||
+                   currentPortStatus != usb->mPortStatus;
+    usb->mPortStatus = std::move(currentPortStatus);
+    usb->mPortStatusResult = status;
+    // Without a callback there is no uevent thread to keep the cache up to date.
+    usb->mPortStatusValid = status == Status::SUCCESS && usb->mCallback != NULL;
+    if (changed)
+        notifyPortStatusLocked(usb);
+}
 
-    queryVersionHelper(this, &currentPortStatus);
+// Re-reads a single port after a uevent about it, falling back to reading all the ports if it
+// isn't in the cache. usb->mLock must be held.
+void updatePortStatusLocked(android::hardware::usb::Usb *usb, const string &portName) {
+    auto cached = std::find_if(usb->mPortStatus.begin(), usb->mPortStatus.end(),
+                               [&](const PortStatus &port) { return port.portName == portName; });
+    if (!usb->mPortStatusValid || cached == usb->mPortStatus.end()) {
+        refreshPortStatusLocked(usb);
+        return;
+    }
+
+    bool connected = access((kTypecPath + portName + "-partner").c_str(), F_OK) == 0;
+    std::vector<PortStatus> portStatus(1);
+    if (getPortStatusForPortHelper(portName, connected, &portStatus[0]) != Status::SUCCESS) {
+        refreshPortStatusLocked(usb);
+        return;
+    }
+    queryMoistureDetectionStatus(&portStatus);
+    queryNonCompliantChargerStatus(&portStatus);
+
+    if (portStatus[0] != *cached) {
+        *cached = std::move(portStatus[0]);
+        notifyPortStatusLocked(usb);
+    }
+}
+
+void queryVersionHelper(android::hardware::usb::Usb *usb,
+                        std::vector<PortStatus> *currentPortStatus) {
+    pthread_mutex_lock(&usb->mLock);
+    refreshPortStatusLocked(usb);
+    *currentPortStatus = usb->mPortStatus;
+    pthread_mutex_unlock(&usb->mLock);
+}
+
+ScopedAStatus Usb::queryPortStatus(int64_t in_transactionId) {
     pthread_mutex_lock(&mLock);
+    // The cache is kept up to date by the uevent thread, so sysfs is only read when it isn't
+    // running yet or the last read failed.
+    if (mPortStatusValid)
+        notifyPortStatusLocked(this);
+    else
+        refreshPortStatusLocked(this);
     if (mCallback != NULL) {
         ScopedAStatus ret = mCallback->notifyQueryPortStatus(
             "all", Status::SUCCESS, in_transactionId);
@@ -606,6 +665,7 @@ static void uevent_event(uint32_t /*epevents*/, struct data *payload) {
     msg[n + 1] = '\0';
     cp = msg;
 
+    string action, portName;
     while (*cp) {
         if (std::regex_match(cp, std::regex("(add)(.*)(-partner)"))) {
             ALOGI("partner added");
@@ -613,9 +673,25 @@ static void uevent_event(uint32_t /*epevents*/, struct data *payload) {
             payload->usb->mPartnerUp = true;
             pthread_cond_signal(&payload->usb->mPartnerCV);
             pthread_mutex_unlock(&payload->usb->mPartnerLock);
+        } else if (!strncmp(cp, "ACTION=", strlen("ACTION="))) {
+            action = cp + strlen("ACTION=");
+        } else if (!strncmp(cp, "DEVPATH=", strlen("DEVPATH="))) {
+            // The port is the start of the last path element, e.g. port0 for port0-partner.
+            string devPath = cp + strlen("DEVPATH=");
+            string device = devPath.substr(devPath.find_last_of('/') + 1);
+            portName = device.substr(0, device.find_first_of("-."));
         } else if (!strncmp(cp, "DEVTYPE=typec_", strlen("DEVTYPE=typec_"))) {
             std::vector<PortStatus> currentPortStatus;
-            queryVersionHelper(payload->usb, &currentPortStatus);
+            pthread_mutex_lock(&payload->usb->mLock);
+            // Ports coming and going change the list of ports, anything else only changes the
+            // port the device belongs to.
+            if (!strcmp(cp, "DEVTYPE=typec_port") && action != "change") {
+                refreshPortStatusLocked(payload->usb);
+            } else {
+                updatePortStatusLocked(payload->usb, portName);
+            }
+            currentPortStatus = payload->usb->mPortStatus;
+            pthread_mutex_unlock(&payload->usb->mLock);
 
             // Role switch is not in progress and port is in disconnected state
             if (!pthread_mutex_trylock(&payload->usb->mRoleSwitchLock)) {
@@ -720,6 +796,8 @@ ScopedAStatus Usb::setCallback(
     }
 
     mCallback = in_callback;
+    // Whether the uevent thread is starting or stopping, it hasn't been watching the ports.
+    mPortStatusValid = false;
     ALOGI("registering callback");
 
     if (mCallback == NULL) {
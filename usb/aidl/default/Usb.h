@@ -72,6 +72,12 @@ struct Usb : public BnUsb {
     pthread_mutex_t mPartnerLock;
     // Variable to signal partner coming back online after type switch
     bool mPartnerUp;
+    // Last port status read from sysfs, kept up to date by the uevent thread.
+    // Protected by mLock.
+    std::vector<PortStatus> mPortStatus;
+    Status mPortStatusResult;
+    // Whether mPortStatus can be served without reading sysfs. Protected by mLock.
+    bool mPortStatusValid;
   private:
     pthread_t mPoll;
 };
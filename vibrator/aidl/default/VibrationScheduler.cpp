@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vibrator-impl/VibrationScheduler.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+VibrationScheduler::~VibrationScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mCv.notify_one();
+    if (mThread.joinable()) mThread.join();
+}
+
+void VibrationScheduler::play(std::chrono::milliseconds duration, std::vector<Step> steps,
+                              std::shared_ptr<IVibratorCallback> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        endLocked();
+
+        mCurrent.emplace();
+        mCurrent->start = Clock::now();
+        mCurrent->end = mCurrent->start + duration;
+        mCurrent->steps = std::move(steps);
+        mCurrent->callback = std::move(callback);
+
+        if (!mThread.joinable()) mThread = std::thread(&VibrationScheduler::run, this);
+    }
+    mCv.notify_one();
+}
+
+void VibrationScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mCurrent.has_value()) return;
+        endLocked();
+    }
+    mCv.notify_one();
+}
+
+void VibrationScheduler::endLocked() {
+    if (!mCurrent.has_value()) return;
+    if (mCurrent->callback != nullptr) mCompleted.push_back(std::move(mCurrent->callback));
+    mCurrent.reset();
+}
+
+void VibrationScheduler::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mShutdown) {
+        if (!mCompleted.empty()) {
+            auto completed = std::move(mCompleted);
+            mCompleted.clear();
+            lock.unlock();
+            for (const auto& callback : completed) {
+                LOG(VERBOSE) << "Notifying vibration complete";
+                if (!callback->onComplete().isOk()) {
+                    LOG(ERROR) << "Failed to call onComplete";
+                }
+            }
+            lock.lock();
+            continue;
+        }
+
+        if (!mCurrent.has_value()) {
+            mCv.wait(lock);
+            continue;
+        }
+
+        // Deadlines are absolute, so the time spent running steps doesn't add up over the
+        // vibration.
+        auto& vibration = *mCurrent;
+        const bool hasStep = vibration.nextStep < vibration.steps.size();
+        const auto deadline = hasStep
+                                      ? vibration.start + vibration.steps[vibration.nextStep].offset
+                                      : vibration.end;
+        if (Clock::now() < deadline) {
+            mCv.wait_until(lock, deadline);
+            continue;
+        }
+
+        if (!hasStep) {
+            endLocked();
+            continue;
+        }
+
+        // The vibration may be ended while the step runs, so don't hold on to it.
+        auto action = std::move(vibration.steps[vibration.nextStep++].action);
+        lock.unlock();
+        if (action) action();
+        lock.lock();
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
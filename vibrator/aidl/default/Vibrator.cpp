@@ -17,7 +17,6 @@
 #include "vibrator-impl/Vibrator.h"
 
 #include <android-base/logging.h>
-#include <thread>
 
 namespace aidl {
 namespace android {
@@ -52,25 +51,14 @@ ndk::ScopedAStatus Vibrator::getCapabilities(int32_t* _aidl_return) {
 
 ndk::ScopedAStatus Vibrator::off() {
     LOG(VERBOSE) << "Vibrator off";
+    mScheduler.stop();
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
                                 const std::shared_ptr<IVibratorCallback>& callback) {
     LOG(VERBOSE) << "Vibrator on for timeoutMs: " << timeoutMs;
-    if (callback != nullptr) {
-        // Note that thread lambdas aren't using implicit capture [=], to avoid capturing "this",
-        // which may be asynchronously destructed.
-        // If "this" is needed, use [sharedThis = this->ref<Vibrator>()].
-        std::thread([timeoutMs, callback] {
-            LOG(VERBOSE) << "Starting on on another thread";
-            usleep(timeoutMs * 1000);
-            LOG(VERBOSE) << "Notifying on complete";
-            if (!callback->onComplete().isOk()) {
-                LOG(ERROR) << "Failed to call onComplete";
-            }
-        }).detach();
-    }
+    mScheduler.play(std::chrono::milliseconds(timeoutMs), {}, callback);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -89,14 +77,7 @@ ndk::ScopedAStatus Vibrator::perform(Effect effect, EffectStrength strength,
 
     constexpr size_t kEffectMillis = 100;
 
-    if (callback != nullptr) {
-        std::thread([callback] {
-            LOG(VERBOSE) << "Starting perform on another thread";
-            usleep(kEffectMillis * 1000);
-            LOG(VERBOSE) << "Notifying perform complete";
-            callback->onComplete();
-        }).detach();
-    }
+    mScheduler.play(std::chrono::milliseconds(kEffectMillis), {}, callback);
 
     *_aidl_return = kEffectMillis;
     return ndk::ScopedAStatus::ok();
@@ -177,27 +158,21 @@ ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect>& composi
         }
     }
 
-    // The thread may theoretically outlive the vibrator, so take a proper reference to it.
-    std::thread([sharedThis = this->ref<Vibrator>(), composite, callback] {
-        LOG(VERBOSE) << "Starting compose on another thread";
-
-        for (auto& e : composite) {
-            if (e.delayMs) {
-                usleep(e.delayMs * 1000);
-            }
-            LOG(VERBOSE) << "triggering primitive " << static_cast<int>(e.primitive) << " @ scale "
-                         << e.scale;
-
-            int32_t durationMs;
-            sharedThis->getPrimitiveDuration(e.primitive, &durationMs);
-            usleep(durationMs * 1000);
-        }
-
-        if (callback != nullptr) {
-            LOG(VERBOSE) << "Notifying perform complete";
-            callback->onComplete();
-        }
-    }).detach();
+    std::vector<VibrationScheduler::Step> steps;
+    steps.reserve(composite.size());
+    std::chrono::milliseconds offset(0);
+    for (auto& e : composite) {
+        offset += std::chrono::milliseconds(e.delayMs);
+        steps.push_back({offset, [primitive = e.primitive, scale = e.scale] {
+                             LOG(VERBOSE) << "triggering primitive "
+                                          << static_cast<int>(primitive) << " @ scale " << scale;
+                         }});
+
+        int32_t durationMs;
+        getPrimitiveDuration(e.primitive, &durationMs);
+        offset += std::chrono::milliseconds(durationMs);
+    }
+    mScheduler.play(offset, std::move(steps), callback);
 
     return ndk::ScopedAStatus::ok();
 }
@@ -400,14 +375,7 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
         }
     }
 
-    std::thread([totalDuration, callback] {
-        LOG(VERBOSE) << "Starting composePwle on another thread";
-        usleep(totalDuration * 1000);
-        if (callback != nullptr) {
-            LOG(VERBOSE) << "Notifying compose PWLE complete";
-            callback->onComplete();
-        }
-    }).detach();
+    mScheduler.play(std::chrono::milliseconds(totalDuration), {}, callback);
 
     return ndk::ScopedAStatus::ok();
 }
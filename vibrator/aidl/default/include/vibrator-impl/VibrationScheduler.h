@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/vibrator/IVibratorCallback.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+/**
+ * Plays vibrations on a single thread, shared by all of them.
+ *
+ * Only one vibration plays at a time: starting a new one or calling stop() ends the current one
+ * early. Either way the callback of a vibration is notified exactly once, from the scheduler
+ * thread.
+ */
+class VibrationScheduler {
+  public:
+    /** Something to do at a given point of a vibration. */
+    struct Step {
+        /** Time since the start of the vibration. */
+        std::chrono::milliseconds offset;
+        std::function<void()> action;
+    };
+
+    VibrationScheduler() = default;
+    ~VibrationScheduler();
+
+    /**
+     * Start a vibration, ending the current one.
+     *
+     * \param duration Length of the whole vibration
+     * \param steps Steps to run during the vibration, ordered by offset
+     * \param callback Notified when the vibration ends, may be null
+     */
+    void play(std::chrono::milliseconds duration, std::vector<Step> steps,
+              std::shared_ptr<IVibratorCallback> callback);
+
+    /** End the current vibration, if any. */
+    void stop();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Vibration {
+        Clock::time_point start;
+        Clock::time_point end;
+        std::vector<Step> steps;
+        size_t nextStep = 0;
+        std::shared_ptr<IVibratorCallback> callback;
+    };
+
+    void run();
+    /** Ends the current vibration, mMutex must be held. */
+    void endLocked();
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::optional<Vibration> mCurrent;
+    /** Callbacks of ended vibrations, waiting to be notified by the scheduler thread. */
+    std::vector<std::shared_ptr<IVibratorCallback>> mCompleted;
+    bool mShutdown = false;
+
+    /** Started along with the first vibration. */
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -18,6 +18,8 @@
 
 #include <aidl/android/hardware/vibrator/BnVibrator.h>
 
+#include "vibrator-impl/VibrationScheduler.h"
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -55,6 +57,8 @@ class Vibrator : public BnVibrator {
     ndk::ScopedAStatus composePwle(const std::vector<PrimitivePwle> &composite,
                                    const std::shared_ptr<IVibratorCallback> &callback) override;
 
+  private:
+    VibrationScheduler mScheduler;
 };
 
 }  // namespace vibrator
@@ -65,7 +65,9 @@ class AidlCallbackHandler {
         return true;
     }
 
-    const std::set<std::shared_ptr<CallbackType>>& getCallbacks() {
+    // Returns a copy, so that callers may iterate over it while callbacks are
+    // added or removed on other threads.
+    std::set<std::shared_ptr<CallbackType>> getCallbacks() {
         std::unique_lock<std::mutex> lk(callback_handler_lock_);
         // unique_lock unlocked here
         return cb_set_;
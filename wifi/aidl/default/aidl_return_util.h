@@ -69,7 +69,7 @@ template <typename ObjT, typename WorkFuncT, typename ReturnT, typename... Args>
     const auto lock = acquireGlobalLock();
     if (obj->isValid()) {
         auto call_pair = (obj->*work)(std::forward<Args>(args)...);
-        *ret_val = call_pair.first;
+        *ret_val = std::move(call_pair.first);
         return std::forward<::ndk::ScopedAStatus>(call_pair.second);
     } else {
         return ndk::ScopedAStatus::fromServiceSpecificError(
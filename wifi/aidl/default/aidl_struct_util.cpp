@@ -17,6 +17,8 @@
 #include <android-base/logging.h>
 #include <utils/SystemClock.h>
 
+#include <tuple>
+
 #include "aidl_struct_util.h"
 
 namespace aidl {
@@ -41,6 +43,16 @@ inline std::vector<int32_t> uintToIntVec(const std::vector<uint32_t>& in) {
     return std::vector<int32_t>(in.begin(), in.end());
 }
 
+// Resets |*aidl| to its default value, but keeps the storage of the vector
+// members |vectors|. A caller converting into the same object on every poll
+// then only allocates when the sizes grow.
+template <typename T, typename... V>
+void resetKeepingVectors(T* aidl, std::vector<V> T::*... vectors) {
+    std::tuple<std::vector<V>...> kept{std::move(aidl->*vectors)...};
+    *aidl = {};
+    std::tie(aidl->*vectors...) = std::move(kept);
+}
+
 IWifiChip::FeatureSetMask convertLegacyChipFeatureToAidl(uint64_t feature) {
     switch (feature) {
         case WIFI_FEATURE_SET_TX_POWER_LIMIT:
@@ -689,14 +701,12 @@ bool convertLegacyCachedGscanResultsToAidl(
 
     CHECK(legacy_cached_scan_result.num_results >= 0 &&
           legacy_cached_scan_result.num_results <= MAX_AP_CACHE_PER_SCAN);
-    std::vector<StaScanResult> aidl_scan_results;
+    std::vector<StaScanResult> aidl_scan_results(legacy_cached_scan_result.num_results);
     for (int32_t result_idx = 0; result_idx < legacy_cached_scan_result.num_results; result_idx++) {
-        StaScanResult aidl_scan_result;
         if (!convertLegacyGscanResultToAidl(legacy_cached_scan_result.results[result_idx], false,
-                                            &aidl_scan_result)) {
+                                            &aidl_scan_results[result_idx])) {
             return false;
         }
-        aidl_scan_results.push_back(aidl_scan_result);
     }
     aidl_scan_data->results = std::move(aidl_scan_results);
     return true;
@@ -709,12 +719,12 @@ bool convertLegacyVectorOfCachedGscanResultsToAidl(
         return false;
     }
     *aidl_scan_datas = {};
-    for (const auto& legacy_cached_scan_result : legacy_cached_scan_results) {
-        StaScanData aidl_scan_data;
-        if (!convertLegacyCachedGscanResultsToAidl(legacy_cached_scan_result, &aidl_scan_data)) {
+    aidl_scan_datas->resize(legacy_cached_scan_results.size());
+    for (size_t i = 0; i < legacy_cached_scan_results.size(); i++) {
+        if (!convertLegacyCachedGscanResultsToAidl(legacy_cached_scan_results[i],
+                                                   &(*aidl_scan_datas)[i])) {
             return false;
         }
-        aidl_scan_datas->push_back(aidl_scan_data);
     }
     return true;
 }
@@ -863,35 +873,57 @@ bool convertLegacyLinkLayerRadioStatsToAidl(
     if (!aidl_radio_stat) {
         return false;
     }
-    *aidl_radio_stat = {};
+    resetKeepingVectors(aidl_radio_stat, &StaLinkLayerRadioStats::txTimeInMsPerLevel,
+                        &StaLinkLayerRadioStats::channelStats);
 
     aidl_radio_stat->radioId = legacy_radio_stat.stats.radio;
     aidl_radio_stat->onTimeInMs = legacy_radio_stat.stats.on_time;
     aidl_radio_stat->txTimeInMs = legacy_radio_stat.stats.tx_time;
     aidl_radio_stat->rxTimeInMs = legacy_radio_stat.stats.rx_time;
     aidl_radio_stat->onTimeInMsForScan = legacy_radio_stat.stats.on_time_scan;
-    aidl_radio_stat->txTimeInMsPerLevel = uintToIntVec(legacy_radio_stat.tx_time_per_levels);
+    aidl_radio_stat->txTimeInMsPerLevel.assign(legacy_radio_stat.tx_time_per_levels.begin(),
+                                               legacy_radio_stat.tx_time_per_levels.end());
     aidl_radio_stat->onTimeInMsForNanScan = legacy_radio_stat.stats.on_time_nbd;
     aidl_radio_stat->onTimeInMsForBgScan = legacy_radio_stat.stats.on_time_gscan;
     aidl_radio_stat->onTimeInMsForRoamScan = legacy_radio_stat.stats.on_time_roam_scan;
     aidl_radio_stat->onTimeInMsForPnoScan = legacy_radio_stat.stats.on_time_pno_scan;
     aidl_radio_stat->onTimeInMsForHs20Scan = legacy_radio_stat.stats.on_time_hs20;
 
-    std::vector<WifiChannelStats> aidl_channel_stats;
-
-    for (const auto& channel_stat : legacy_radio_stat.channel_stats) {
-        WifiChannelStats aidl_channel_stat;
+    aidl_radio_stat->channelStats.resize(legacy_radio_stat.channel_stats.size());
+    for (size_t i = 0; i < legacy_radio_stat.channel_stats.size(); i++) {
+        const auto& channel_stat = legacy_radio_stat.channel_stats[i];
+        WifiChannelStats& aidl_channel_stat = aidl_radio_stat->channelStats[i];
+        aidl_channel_stat = {};
         aidl_channel_stat.onTimeInMs = channel_stat.on_time;
         aidl_channel_stat.ccaBusyTimeInMs = channel_stat.cca_busy_time;
         aidl_channel_stat.channel.width = WifiChannelWidthInMhz::WIDTH_20;
         aidl_channel_stat.channel.centerFreq = channel_stat.channel.center_freq;
         aidl_channel_stat.channel.centerFreq0 = channel_stat.channel.center_freq0;
         aidl_channel_stat.channel.centerFreq1 = channel_stat.channel.center_freq1;
-        aidl_channel_stats.push_back(aidl_channel_stat);
     }
 
-    aidl_radio_stat->channelStats = aidl_channel_stats;
+    return true;
+}
+
+// Resets |aidl_stats| like "*aidl_stats = {}", but keeps the storage of its
+// links and radios.
+void resetLinkLayerStats(StaLinkLayerStats* aidl_stats) {
+    StaLinkLayerIfaceStats iface = std::move(aidl_stats->iface);
+    resetKeepingVectors(aidl_stats, &StaLinkLayerStats::radios);
+    aidl_stats->iface = std::move(iface);
+    resetKeepingVectors(&aidl_stats->iface, &StaLinkLayerIfaceStats::links);
+}
 
+bool convertLegacyLinkLayerRadiosStatsToAidl(
+        const std::vector<legacy_hal::LinkLayerRadioStats>& legacy_radios_stats,
+        StaLinkLayerStats* aidl_stats) {
+    aidl_stats->radios.resize(legacy_radios_stats.size());
+    for (size_t i = 0; i < legacy_radios_stats.size(); i++) {
+        if (!convertLegacyLinkLayerRadioStatsToAidl(legacy_radios_stats[i],
+                                                    &aidl_stats->radios[i])) {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -909,11 +941,13 @@ bool convertLegacyLinkLayerMlStatsToAidl(const legacy_hal::LinkLayerMlStats& leg
     if (!aidl_stats) {
         return false;
     }
-    *aidl_stats = {};
-    std::vector<StaLinkLayerLinkStats> links;
+    resetLinkLayerStats(aidl_stats);
     // Iterate over each links
-    for (const auto& link : legacy_ml_stats.links) {
-        StaLinkLayerLinkStats linkStats = {};
+    aidl_stats->iface.links.resize(legacy_ml_stats.links.size());
+    for (size_t l = 0; l < legacy_ml_stats.links.size(); l++) {
+        const auto& link = legacy_ml_stats.links[l];
+        StaLinkLayerLinkStats& linkStats = aidl_stats->iface.links[l];
+        resetKeepingVectors(&linkStats, &StaLinkLayerLinkStats::peers);
         linkStats.linkId = link.stat.link_id;
         linkStats.state = convertLegacyMlLinkStateToAidl(link.stat.state);
         linkStats.radioId = link.stat.radio;
@@ -970,29 +1004,17 @@ bool convertLegacyLinkLayerMlStatsToAidl(const legacy_hal::LinkLayerMlStats& leg
                 link.stat.ac[legacy_hal::WIFI_AC_VO].contention_num_samples;
         linkStats.timeSliceDutyCycleInPercent = link.stat.time_slicing_duty_cycle_percent;
         // peer info legacy_stats conversion.
-        std::vector<StaPeerInfo> aidl_peers_info_stats;
-        for (const auto& legacy_peer_info_stats : link.peers) {
-            StaPeerInfo aidl_peer_info_stats;
-            if (!convertLegacyPeerInfoStatsToAidl(legacy_peer_info_stats, &aidl_peer_info_stats)) {
+        linkStats.peers.resize(link.peers.size());
+        for (size_t i = 0; i < link.peers.size(); i++) {
+            if (!convertLegacyPeerInfoStatsToAidl(link.peers[i], &linkStats.peers[i])) {
                 return false;
             }
-            aidl_peers_info_stats.push_back(aidl_peer_info_stats);
         }
-        linkStats.peers = aidl_peers_info_stats;
-        // Push link stats to aidl stats.
-        links.push_back(linkStats);
     }
-    aidl_stats->iface.links = links;
     // radio legacy_stats conversion.
-    std::vector<StaLinkLayerRadioStats> aidl_radios_stats;
-    for (const auto& legacy_radio_stats : legacy_ml_stats.radios) {
-        StaLinkLayerRadioStats aidl_radio_stats;
-        if (!convertLegacyLinkLayerRadioStatsToAidl(legacy_radio_stats, &aidl_radio_stats)) {
-            return false;
-        }
-        aidl_radios_stats.push_back(aidl_radio_stats);
+    if (!convertLegacyLinkLayerRadiosStatsToAidl(legacy_ml_stats.radios, aidl_stats)) {
+        return false;
     }
-    aidl_stats->radios = aidl_radios_stats;
     aidl_stats->timeStampInMs = ::android::uptimeMillis();
 
     return true;
@@ -1003,9 +1025,10 @@ bool convertLegacyLinkLayerStatsToAidl(const legacy_hal::LinkLayerStats& legacy_
     if (!aidl_stats) {
         return false;
     }
-    *aidl_stats = {};
-    std::vector<StaLinkLayerLinkStats> links;
-    StaLinkLayerLinkStats linkStats = {};
+    resetLinkLayerStats(aidl_stats);
+    aidl_stats->iface.links.resize(1);
+    StaLinkLayerLinkStats& linkStats = aidl_stats->iface.links[0];
+    resetKeepingVectors(&linkStats, &StaLinkLayerLinkStats::peers);
     // iface legacy_stats conversion.
     linkStats.linkId = 0;
     linkStats.beaconRx = legacy_stats.iface.beacon_rx;
@@ -1060,27 +1083,16 @@ bool convertLegacyLinkLayerStatsToAidl(const legacy_hal::LinkLayerStats& legacy_
             legacy_stats.iface.ac[legacy_hal::WIFI_AC_VO].contention_num_samples;
     linkStats.timeSliceDutyCycleInPercent = legacy_stats.iface.info.time_slicing_duty_cycle_percent;
     // peer info legacy_stats conversion.
-    std::vector<StaPeerInfo> aidl_peers_info_stats;
-    for (const auto& legacy_peer_info_stats : legacy_stats.peers) {
-        StaPeerInfo aidl_peer_info_stats;
-        if (!convertLegacyPeerInfoStatsToAidl(legacy_peer_info_stats, &aidl_peer_info_stats)) {
+    linkStats.peers.resize(legacy_stats.peers.size());
+    for (size_t i = 0; i < legacy_stats.peers.size(); i++) {
+        if (!convertLegacyPeerInfoStatsToAidl(legacy_stats.peers[i], &linkStats.peers[i])) {
             return false;
         }
-        aidl_peers_info_stats.push_back(aidl_peer_info_stats);
     }
-    linkStats.peers = aidl_peers_info_stats;
-    links.push_back(linkStats);
-    aidl_stats->iface.links = links;
     // radio legacy_stats conversion.
-    std::vector<StaLinkLayerRadioStats> aidl_radios_stats;
-    for (const auto& legacy_radio_stats : legacy_stats.radios) {
-        StaLinkLayerRadioStats aidl_radio_stats;
-        if (!convertLegacyLinkLayerRadioStatsToAidl(legacy_radio_stats, &aidl_radio_stats)) {
-            return false;
-        }
-        aidl_radios_stats.push_back(aidl_radio_stats);
+    if (!convertLegacyLinkLayerRadiosStatsToAidl(legacy_stats.radios, aidl_stats)) {
+        return false;
     }
-    aidl_stats->radios = aidl_radios_stats;
     aidl_stats->timeStampInMs = ::android::uptimeMillis();
     return true;
 }
@@ -1125,13 +1137,15 @@ bool convertLegacyPeerInfoStatsToAidl(const legacy_hal::WifiPeerInfo& legacy_pee
     if (!aidl_peer_info_stats) {
         return false;
     }
-    *aidl_peer_info_stats = {};
+    resetKeepingVectors(aidl_peer_info_stats, &StaPeerInfo::rateStats);
     aidl_peer_info_stats->staCount = legacy_peer_info_stats.peer_info.bssload.sta_count;
     aidl_peer_info_stats->chanUtil = legacy_peer_info_stats.peer_info.bssload.chan_util;
 
-    std::vector<StaRateStat> aidlRateStats;
-    for (const auto& legacy_rate_stats : legacy_peer_info_stats.rate_stats) {
-        StaRateStat rateStat;
+    aidl_peer_info_stats->rateStats.resize(legacy_peer_info_stats.rate_stats.size());
+    for (size_t i = 0; i < legacy_peer_info_stats.rate_stats.size(); i++) {
+        const auto& legacy_rate_stats = legacy_peer_info_stats.rate_stats[i];
+        StaRateStat& rateStat = aidl_peer_info_stats->rateStats[i];
+        rateStat = {};
         if (!convertLegacyWifiRateInfoToAidl(legacy_rate_stats.rate, &rateStat.rateInfo)) {
             return false;
         }
@@ -1139,9 +1153,7 @@ bool convertLegacyPeerInfoStatsToAidl(const legacy_hal::WifiPeerInfo& legacy_pee
         rateStat.rxMpdu = legacy_rate_stats.rx_mpdu;
         rateStat.mpduLost = legacy_rate_stats.mpdu_lost;
         rateStat.retries = legacy_rate_stats.retries;
-        aidlRateStats.push_back(rateStat);
     }
-    aidl_peer_info_stats->rateStats = aidlRateStats;
     return true;
 }
 
@@ -3554,22 +3566,65 @@ bool convertLegacyIfaceCombinationsMatrixToChipMode(
     return true;
 }
 
+// Assigns every field of |aidl_scan_result|, reusing the storage of its SSID.
+bool updateCachedScanResultFromLegacy(const legacy_hal::wifi_cached_scan_result& legacy_scan_result,
+                                      uint64_t ts_us, CachedScanResult* aidl_scan_result) {
+    aidl_scan_result->timeStampInUs = ts_us - legacy_scan_result.age_ms * 1000;
+    if (aidl_scan_result->timeStampInUs < 0) {
+        aidl_scan_result->timeStampInUs = 0;
+        return false;
+    }
+    size_t max_len_excluding_null = sizeof(legacy_scan_result.ssid) - 1;
+    size_t ssid_len = strnlen((const char*)legacy_scan_result.ssid, max_len_excluding_null);
+    aidl_scan_result->ssid.assign(legacy_scan_result.ssid, legacy_scan_result.ssid + ssid_len);
+    std::copy(legacy_scan_result.bssid, legacy_scan_result.bssid + 6,
+              std::begin(aidl_scan_result->bssid));
+    aidl_scan_result->frequencyMhz = legacy_scan_result.chanspec.primary_frequency;
+    aidl_scan_result->channelWidthMhz =
+            convertLegacyWifiChannelWidthToAidl(legacy_scan_result.chanspec.width);
+    aidl_scan_result->rssiDbm = legacy_scan_result.rssi;
+    aidl_scan_result->preambleType = convertScanResultFlagsToPreambleType(legacy_scan_result.flags);
+    return true;
+}
+
 bool convertCachedScanReportToAidl(const legacy_hal::WifiCachedScanReport& report,
                                    CachedScanData* aidl_scan_data) {
-    if (!aidl_scan_data) {
+    CachedScanBssTable bss_table;
+    return convertCachedScanReportToAidl(report, &bss_table, aidl_scan_data);
+}
+
+bool convertCachedScanReportToAidl(const legacy_hal::WifiCachedScanReport& report,
+                                   CachedScanBssTable* bss_table, CachedScanData* aidl_scan_data) {
+    if (!bss_table || !aidl_scan_data) {
         return false;
     }
     *aidl_scan_data = {};
 
-    std::vector<CachedScanResult> aidl_scan_results;
-    for (const auto& result : report.results) {
-        CachedScanResult aidl_scan_result;
-        if (!convertCachedScanResultToAidl(result, report.ts, &aidl_scan_result)) {
+    std::vector<CachedScanResult> aidl_scan_results(report.results.size());
+    for (size_t i = 0; i < report.results.size(); i++) {
+        const auto& result = report.results[i];
+        CachedScanBssTable::key_type key;
+        std::copy(result.bssid, result.bssid + 6, std::begin(key.first));
+        key.second = result.chanspec.primary_frequency;
+        auto [it, inserted] = bss_table->try_emplace(key);
+        // A BSS reported twice in the same report keeps its first entry.
+        if (!inserted && it->second.report_ts == report.ts) {
+            if (!convertCachedScanResultToAidl(result, report.ts, &aidl_scan_results[i])) {
+                return false;
+            }
+            continue;
+        }
+        if (!updateCachedScanResultFromLegacy(result, report.ts, &it->second.result)) {
+            bss_table->erase(it);
             return false;
         }
-        aidl_scan_results.push_back(aidl_scan_result);
+        it->second.report_ts = report.ts;
+        aidl_scan_results[i] = it->second.result;
+    }
+    for (auto it = bss_table->begin(); it != bss_table->end();) {
+        it = it->second.report_ts == report.ts ? std::next(it) : bss_table->erase(it);
     }
-    aidl_scan_data->cachedScanResults = aidl_scan_results;
+    aidl_scan_data->cachedScanResults = std::move(aidl_scan_results);
 
     aidl_scan_data->scannedFrequenciesMhz = report.scanned_freqs;
     return true;
@@ -3581,24 +3636,7 @@ bool convertCachedScanResultToAidl(const legacy_hal::wifi_cached_scan_result& le
         return false;
     }
     *aidl_scan_result = {};
-    aidl_scan_result->timeStampInUs = ts_us - legacy_scan_result.age_ms * 1000;
-    if (aidl_scan_result->timeStampInUs < 0) {
-        aidl_scan_result->timeStampInUs = 0;
-        return false;
-    }
-    size_t max_len_excluding_null = sizeof(legacy_scan_result.ssid) - 1;
-    size_t ssid_len = strnlen((const char*)legacy_scan_result.ssid, max_len_excluding_null);
-    aidl_scan_result->ssid =
-            std::vector<uint8_t>(legacy_scan_result.ssid, legacy_scan_result.ssid + ssid_len);
-    aidl_scan_result->bssid = std::array<uint8_t, 6>();
-    std::copy(legacy_scan_result.bssid, legacy_scan_result.bssid + 6,
-              std::begin(aidl_scan_result->bssid));
-    aidl_scan_result->frequencyMhz = legacy_scan_result.chanspec.primary_frequency;
-    aidl_scan_result->channelWidthMhz =
-            convertLegacyWifiChannelWidthToAidl(legacy_scan_result.chanspec.width);
-    aidl_scan_result->rssiDbm = legacy_scan_result.rssi;
-    aidl_scan_result->preambleType = convertScanResultFlagsToPreambleType(legacy_scan_result.flags);
-    return true;
+    return updateCachedScanResultFromLegacy(legacy_scan_result, ts_us, aidl_scan_result);
 }
 
 WifiRatePreamble convertScanResultFlagsToPreambleType(int flags) {
@@ -25,6 +25,7 @@
 #include <aidl/android/hardware/wifi/WifiDebugRingBufferFlags.h>
 #include <aidl/android/hardware/wifi/WifiIfaceMode.h>
 
+#include <map>
 #include <vector>
 
 #include "wifi_legacy_hal.h"
@@ -90,6 +91,9 @@ bool convertLegacyGscanResultToAidl(const legacy_hal::wifi_scan_result& legacy_s
 bool convertLegacyVectorOfCachedGscanResultsToAidl(
         const std::vector<legacy_hal::wifi_cached_scan_results>& legacy_cached_scan_results,
         std::vector<StaScanData>* aidl_scan_datas);
+// The link layer stats conversions overwrite |aidl_stats| but keep the storage
+// of its vectors, so converting into the same object again does not allocate
+// unless the sizes grow.
 bool convertLegacyLinkLayerMlStatsToAidl(const legacy_hal::LinkLayerMlStats& legacy_ml_stats,
                                          StaLinkLayerStats* aidl_stats);
 bool convertLegacyLinkLayerStatsToAidl(const legacy_hal::LinkLayerStats& legacy_stats,
@@ -216,6 +220,18 @@ bool convertLegacyNanBootstrappingConfirmIndToAidl(
 uint32_t convertAidlChannelCategoryToLegacy(uint32_t aidl_channel_category_mask);
 bool convertCachedScanReportToAidl(const legacy_hal::WifiCachedScanReport& report,
                                    CachedScanData* aidl_scan_data);
+// Converted cached scan results of the BSSes in the last report, keyed by
+// BSSID and primary frequency.
+struct CachedScanBssEntry {
+    CachedScanResult result;
+    uint64_t report_ts;
+};
+using CachedScanBssTable = std::map<std::pair<std::array<uint8_t, 6>, int32_t>, CachedScanBssEntry>;
+// Same as above, but updates the entries of |bss_table| in place instead of
+// converting every result from scratch. BSSes missing from |report| are
+// dropped from the table.
+bool convertCachedScanReportToAidl(const legacy_hal::WifiCachedScanReport& report,
+                                   CachedScanBssTable* bss_table, CachedScanData* aidl_scan_data);
 bool convertCachedScanResultToAidl(const legacy_hal::wifi_cached_scan_result& legacy_scan_result,
                                    uint64_t ts_us, CachedScanResult* aidl_scan_result);
 WifiRatePreamble convertScanResultFlagsToPreambleType(int flags);
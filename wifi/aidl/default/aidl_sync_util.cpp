@@ -18,6 +18,8 @@
 
 namespace {
 std::recursive_mutex g_mutex;
+std::mutex g_nan_callback_mutex;
+std::mutex g_rtt_callback_mutex;
 }  // namespace
 
 namespace aidl {
@@ -30,6 +32,14 @@ std::unique_lock<std::recursive_mutex> acquireGlobalLock() {
     return std::unique_lock<std::recursive_mutex>{g_mutex};
 }
 
+std::unique_lock<std::mutex> acquireNanCallbackLock() {
+    return std::unique_lock<std::mutex>{g_nan_callback_mutex};
+}
+
+std::unique_lock<std::mutex> acquireRttCallbackLock() {
+    return std::unique_lock<std::mutex>{g_rtt_callback_mutex};
+}
+
 }  // namespace aidl_sync_util
 }  // namespace wifi
 }  // namespace hardware
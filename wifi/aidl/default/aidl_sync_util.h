@@ -20,13 +20,16 @@
 #include <mutex>
 
 // Utility that provides a global lock to synchronize access between
-// the AIDL thread and the legacy HAL's event loop.
+// the AIDL thread and the legacy HAL's event loop, and the locks of the
+// callback domains that do not need the global lock (see THREADING.README).
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace wifi {
 namespace aidl_sync_util {
 std::unique_lock<std::recursive_mutex> acquireGlobalLock();
+std::unique_lock<std::mutex> acquireNanCallbackLock();
+std::unique_lock<std::mutex> acquireRttCallbackLock();
 }  // namespace aidl_sync_util
 }  // namespace wifi
 }  // namespace hardware
@@ -18,42 +18,117 @@
 
 #include <android-base/logging.h>
 
+#include <cstring>
+
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace wifi {
 
-Ringbuffer::Ringbuffer(size_t maxSize) : size_(0), maxSize_(maxSize) {}
+Ringbuffer::Ringbuffer(size_t maxSize) : head_(0), tail_(0), numRecords_(0), maxSize_(maxSize) {}
 
-enum Ringbuffer::AppendStatus Ringbuffer::append(const std::vector<uint8_t>& input) {
-    if (input.size() == 0) {
+enum Ringbuffer::AppendStatus Ringbuffer::append(const uint8_t* data, size_t size) {
+    if (size == 0) {
         return AppendStatus::FAIL_IP_BUFFER_ZERO;
     }
-    if (input.size() > maxSize_) {
-        LOG(INFO) << "Oversized message of " << input.size() << " bytes is dropped";
+    if (size > maxSize_ || maxSize_ - size < kRecordHeaderSize) {
+        LOG(INFO) << "Oversized message of " << size << " bytes is dropped";
         return AppendStatus::FAIL_IP_BUFFER_EXCEEDED_MAXSIZE;
     }
-    data_.push_back(input);
-    size_ += input.size() * sizeof(input[0]);
-    while (size_ > maxSize_) {
-        if (data_.front().size() <= 0 || data_.front().size() > maxSize_) {
-            LOG(ERROR) << "First buffer in the ring buffer is Invalid. Size: "
-                       << data_.front().size();
+    if (data_.empty()) {
+        data_.resize(maxSize_);
+    }
+    const size_t recordLength = kRecordHeaderSize + size;
+    size_t offset = findRoom(recordLength);
+    while (offset == maxSize_) {
+        head_ = recordOffset(head_);
+        const size_t oldestSize = recordSize(head_);
+        if (oldestSize == 0) {
+            LOG(ERROR) << "First buffer in the ring buffer is Invalid. Offset: " << head_;
             return AppendStatus::FAIL_RING_BUFFER_CORRUPTED;
         }
-        size_ -= data_.front().size() * sizeof(data_.front()[0]);
-        data_.pop_front();
+        head_ += kRecordHeaderSize + oldestSize;
+        if (--numRecords_ == 0) {
+            head_ = 0;
+            tail_ = 0;
+        }
+        offset = findRoom(recordLength);
     }
+    if (offset != tail_ && tail_ + kRecordHeaderSize <= maxSize_) {
+        // Tell the readers that the next record is at the start of the ring.
+        memset(&data_[tail_], 0, kRecordHeaderSize);
+    }
+    const uint32_t header = size;
+    memcpy(&data_[offset], &header, kRecordHeaderSize);
+    memcpy(&data_[offset + kRecordHeaderSize], data, size);
+    tail_ = offset + recordLength;
+    numRecords_++;
     return AppendStatus::SUCCESS;
 }
 
-const std::list<std::vector<uint8_t>>& Ringbuffer::getData() const {
-    return data_;
+enum Ringbuffer::AppendStatus Ringbuffer::append(const std::vector<uint8_t>& input) {
+    return append(input.data(), input.size());
+}
+
+bool Ringbuffer::forEachRecord(const std::function<void(const uint8_t*, size_t)>& visitor) const {
+    size_t offset = head_;
+    for (size_t i = 0; i < numRecords_; i++) {
+        offset = recordOffset(offset);
+        const size_t size = recordSize(offset);
+        if (size == 0) {
+            return false;
+        }
+        visitor(&data_[offset + kRecordHeaderSize], size);
+        offset += kRecordHeaderSize + size;
+    }
+    return true;
+}
+
+bool Ringbuffer::empty() const {
+    return numRecords_ == 0;
+}
+
+size_t Ringbuffer::getNumRecords() const {
+    return numRecords_;
 }
 
 void Ringbuffer::clear() {
-    data_.clear();
-    size_ = 0;
+    head_ = 0;
+    tail_ = 0;
+    numRecords_ = 0;
+}
+
+size_t Ringbuffer::recordOffset(size_t offset) const {
+    if (offset + kRecordHeaderSize > maxSize_) {
+        return 0;
+    }
+    uint32_t header;
+    memcpy(&header, &data_[offset], kRecordHeaderSize);
+    return header == 0 ? 0 : offset;
+}
+
+size_t Ringbuffer::recordSize(size_t offset) const {
+    uint32_t header;
+    memcpy(&header, &data_[offset], kRecordHeaderSize);
+    if (header > maxSize_ - offset - kRecordHeaderSize) {
+        return 0;
+    }
+    return header;
+}
+
+size_t Ringbuffer::findRoom(size_t recordLength) const {
+    if (numRecords_ == 0) {
+        return 0;
+    }
+    if (tail_ > head_) {
+        // The records do not wrap: use the end of the ring, then its start.
+        if (tail_ + recordLength <= maxSize_) {
+            return tail_;
+        }
+        return recordLength <= head_ ? 0 : maxSize_;
+    }
+    // The records wrap: the free bytes are between the tail and the head.
+    return tail_ + recordLength <= head_ ? tail_ : maxSize_;
 }
 
 }  // namespace wifi
@@ -17,7 +17,8 @@
 #ifndef RINGBUFFER_H_
 #define RINGBUFFER_H_
 
-#include <list>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace aidl {
@@ -27,6 +28,12 @@ namespace wifi {
 
 /**
  * Ringbuffer object used to store debug data.
+ *
+ * Records are stored back to back in a single contiguous byte ring, each one
+ * prefixed by its length, so that appending a record does not allocate. The
+ * storage is allocated on the first append and a record is never split across
+ * the end of the ring: if it does not fit before the end, the remaining bytes
+ * are skipped and the record is written at the start of the ring.
  */
 class Ringbuffer {
   public:
@@ -38,17 +45,39 @@ class Ringbuffer {
         FAIL_IP_BUFFER_EXCEEDED_MAXSIZE,
         FAIL_RING_BUFFER_CORRUPTED
     };
+    // Size of the length prefix stored in front of every record.
+    static constexpr size_t kRecordHeaderSize = sizeof(uint32_t);
+
+    // |maxSize| is the capacity of the ring in bytes, length prefixes
+    // included.
     explicit Ringbuffer(size_t maxSize);
 
-    // Appends the data buffer and deletes from the front until buffer is
+    // Appends the data buffer and deletes the oldest records until it fits
     // within |maxSize_|.
+    enum AppendStatus append(const uint8_t* data, size_t size);
     enum AppendStatus append(const std::vector<uint8_t>& input);
-    const std::list<std::vector<uint8_t>>& getData() const;
+    // Calls |visitor| on every record, oldest first. Returns false if a
+    // corrupted record was found; the records before it have been visited.
+    bool forEachRecord(const std::function<void(const uint8_t*, size_t)>& visitor) const;
+    bool empty() const;
+    size_t getNumRecords() const;
     void clear();
 
   private:
-    std::list<std::vector<uint8_t>> data_;
-    size_t size_;
+    // Returns the offset of the record whose header would be at |offset|,
+    // skipping the unused bytes at the end of the ring.
+    size_t recordOffset(size_t offset) const;
+    // Returns the payload size of the record at |offset|, or 0 if the record
+    // does not lie within the ring.
+    size_t recordSize(size_t offset) const;
+    // Returns the offset |recordSize| bytes can be written at, or |maxSize_|
+    // if there is no room for them.
+    size_t findRoom(size_t recordSize) const;
+
+    std::vector<uint8_t> data_;
+    size_t head_;
+    size_t tail_;
+    size_t numRecords_;
     size_t maxSize_;
 };
 
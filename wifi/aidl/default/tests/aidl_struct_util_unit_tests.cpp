@@ -679,6 +679,36 @@ TEST_F(AidlStructUtilTest, canConvertLegacyLinkLayerStatsToAidl) {
     }
 }
 
+TEST_F(AidlStructUtilTest, canConvertLegacyLinkLayerStatsIntoReusedAidlStats) {
+    legacy_hal::LinkLayerStats large_stats{};
+    large_stats.radios.resize(2);
+    large_stats.radios[0].channel_stats.resize(3);
+    large_stats.radios[0].tx_time_per_levels = {1, 2, 3};
+    large_stats.peers.resize(2);
+    large_stats.peers[0].rate_stats.resize(4);
+    large_stats.iface.beacon_rx = rand();
+
+    legacy_hal::LinkLayerStats small_stats{};
+    small_stats.radios.resize(1);
+    small_stats.radios[0].stats.on_time = rand();
+    small_stats.peers.resize(1);
+    small_stats.peers[0].peer_info.bssload.sta_count = rand();
+
+    StaLinkLayerStats reused;
+    ASSERT_TRUE(aidl_struct_util::convertLegacyLinkLayerStatsToAidl(large_stats, &reused));
+    ASSERT_TRUE(aidl_struct_util::convertLegacyLinkLayerStatsToAidl(small_stats, &reused));
+    StaLinkLayerStats fresh;
+    ASSERT_TRUE(aidl_struct_util::convertLegacyLinkLayerStatsToAidl(small_stats, &fresh));
+
+    // Nothing of the previous conversion is left, but its storage is kept.
+    reused.timeStampInMs = fresh.timeStampInMs = 0;
+    EXPECT_EQ(fresh, reused);
+    EXPECT_LE(2u, reused.radios.capacity());
+    EXPECT_LE(3u, reused.radios[0].channelStats.capacity());
+    EXPECT_LE(2u, reused.iface.links[0].peers.capacity());
+    EXPECT_LE(4u, reused.iface.links[0].peers[0].rateStats.capacity());
+}
+
 TEST_F(AidlStructUtilTest, CanConvertLegacyFeaturesToAidl) {
     using AidlChipCaps = IWifiChip::FeatureSetMask;
 
@@ -934,6 +964,40 @@ TEST_F(AidlStructUtilTest, convertCachedScanReportToAidl) {
     }
 }
 
+TEST_F(AidlStructUtilTest, convertCachedScanReportToAidlWithBssTable) {
+    legacy_hal::WifiCachedScanReport hw_report;
+    hw_report.ts = 10000000;
+    for (int i = 0; i < kNumScanResult; i++) {
+        wifi_cached_scan_result result = {};
+        result.age_ms = i * 1000;
+        memcpy(result.ssid, kSsid, kSsidLen);
+        memcpy(result.bssid, kBssid, 6);
+        result.bssid[5] = i;
+        result.rssi = kRssi[i];
+        result.chanspec = {legacy_hal::WIFI_CHAN_WIDTH_40, 0, 0, 2437};
+        hw_report.results.push_back(result);
+    }
+
+    aidl_struct_util::CachedScanBssTable bss_table;
+    CachedScanData aidl_data;
+    ASSERT_TRUE(aidl_struct_util::convertCachedScanReportToAidl(hw_report, &bss_table, &aidl_data));
+    EXPECT_EQ(kNumScanResult, (int)bss_table.size());
+
+    // Next report: the first BSS is gone and the second one moved.
+    hw_report.ts += 5000000;
+    hw_report.results.erase(hw_report.results.begin());
+    hw_report.results[0].age_ms = 0;
+    hw_report.results[0].rssi = -50;
+    ASSERT_TRUE(aidl_struct_util::convertCachedScanReportToAidl(hw_report, &bss_table, &aidl_data));
+    EXPECT_EQ(1u, bss_table.size());
+    ASSERT_EQ(1u, aidl_data.cachedScanResults.size());
+    const auto& aidl_result = aidl_data.cachedScanResults[0];
+    EXPECT_EQ(-50, aidl_result.rssiDbm);
+    EXPECT_EQ(15000000, aidl_result.timeStampInUs);
+    EXPECT_EQ(1, aidl_result.bssid[5]);
+    EXPECT_EQ(std::vector<uint8_t>(kSsid, kSsid + kSsidLen - 1), aidl_result.ssid);
+}
+
 }  // namespace wifi
 }  // namespace hardware
 }  // namespace android
@@ -16,6 +16,8 @@
 
 #include <gmock/gmock.h>
 
+#include <algorithm>
+
 #include "ringbuffer.h"
 
 using testing::Return;
@@ -28,66 +30,105 @@ namespace wifi {
 
 class RingbufferTest : public Test {
   public:
-    const uint32_t maxBufferSize_ = 10;
+    std::vector<std::vector<uint8_t>> getRecords() {
+        std::vector<std::vector<uint8_t>> records;
+        EXPECT_TRUE(buffer_.forEachRecord([&records](const uint8_t* data, size_t size) {
+            records.emplace_back(data, data + size);
+        }));
+        return records;
+    }
+
+    // Room for two records of |maxRecordSize_ / 2| bytes.
+    const uint32_t maxBufferSize_ = 10 + 2 * Ringbuffer::kRecordHeaderSize;
+    const uint32_t maxRecordSize_ = maxBufferSize_ - Ringbuffer::kRecordHeaderSize;
     Ringbuffer buffer_{maxBufferSize_};
 };
 
 TEST_F(RingbufferTest, CreateEmptyBuffer) {
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
+    ASSERT_TRUE(getRecords().empty());
 }
 
 TEST_F(RingbufferTest, CanUseFullBufferCapacity) {
-    const std::vector<uint8_t> input(maxBufferSize_ / 2, '0');
-    const std::vector<uint8_t> input2(maxBufferSize_ / 2, '1');
+    const std::vector<uint8_t> input(5, '0');
+    const std::vector<uint8_t> input2(5, '1');
     buffer_.append(input);
     buffer_.append(input2);
-    ASSERT_EQ(2u, buffer_.getData().size());
-    EXPECT_EQ(input, buffer_.getData().front());
-    EXPECT_EQ(input2, buffer_.getData().back());
+    const auto records = getRecords();
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(input, records.front());
+    EXPECT_EQ(input2, records.back());
 }
 
 TEST_F(RingbufferTest, OldDataIsRemovedOnOverflow) {
-    const std::vector<uint8_t> input(maxBufferSize_ / 2, '0');
-    const std::vector<uint8_t> input2(maxBufferSize_ / 2, '1');
+    const std::vector<uint8_t> input(5, '0');
+    const std::vector<uint8_t> input2(5, '1');
     const std::vector<uint8_t> input3 = {'G'};
     buffer_.append(input);
     buffer_.append(input2);
     buffer_.append(input3);
-    ASSERT_EQ(2u, buffer_.getData().size());
-    EXPECT_EQ(input2, buffer_.getData().front());
-    EXPECT_EQ(input3, buffer_.getData().back());
+    const auto records = getRecords();
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(input2, records.front());
+    EXPECT_EQ(input3, records.back());
 }
 
 TEST_F(RingbufferTest, MultipleOldDataIsRemovedOnOverflow) {
-    const std::vector<uint8_t> input(maxBufferSize_ / 2, '0');
-    const std::vector<uint8_t> input2(maxBufferSize_ / 2, '1');
-    const std::vector<uint8_t> input3(maxBufferSize_, '2');
+    const std::vector<uint8_t> input(5, '0');
+    const std::vector<uint8_t> input2(5, '1');
+    const std::vector<uint8_t> input3(maxRecordSize_, '2');
     buffer_.append(input);
     buffer_.append(input2);
     buffer_.append(input3);
-    ASSERT_EQ(1u, buffer_.getData().size());
-    EXPECT_EQ(input3, buffer_.getData().front());
+    const auto records = getRecords();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(input3, records.front());
+}
+
+TEST_F(RingbufferTest, RecordsWrapAroundInOrder) {
+    std::vector<std::vector<uint8_t>> inputs;
+    for (uint8_t i = 0; i < 20; i++) {
+        inputs.emplace_back(1 + i % 4, i);
+        ASSERT_EQ(Ringbuffer::AppendStatus::SUCCESS, buffer_.append(inputs.back()));
+    }
+    const auto records = getRecords();
+    ASSERT_EQ(buffer_.getNumRecords(), records.size());
+    ASSERT_FALSE(records.empty());
+    EXPECT_TRUE(std::equal(records.begin(), records.end(), inputs.end() - records.size()));
 }
 
 TEST_F(RingbufferTest, AppendingEmptyBufferDoesNotAddGarbage) {
     const std::vector<uint8_t> input = {};
     buffer_.append(input);
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
 }
 
 TEST_F(RingbufferTest, OversizedAppendIsDropped) {
-    const std::vector<uint8_t> input(maxBufferSize_ + 1, '0');
+    const std::vector<uint8_t> input(maxRecordSize_ + 1, '0');
     buffer_.append(input);
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
 }
 
 TEST_F(RingbufferTest, OversizedAppendDoesNotDropExistingData) {
-    const std::vector<uint8_t> input(maxBufferSize_, '0');
-    const std::vector<uint8_t> input2(maxBufferSize_ + 1, '1');
+    const std::vector<uint8_t> input(maxRecordSize_, '0');
+    const std::vector<uint8_t> input2(maxRecordSize_ + 1, '1');
+    buffer_.append(input);
+    buffer_.append(input2);
+    const auto records = getRecords();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(input, records.front());
+}
+
+TEST_F(RingbufferTest, ClearRemovesAllRecords) {
+    const std::vector<uint8_t> input(5, '0');
+    const std::vector<uint8_t> input2 = {'G'};
     buffer_.append(input);
+    buffer_.clear();
+    ASSERT_TRUE(buffer_.empty());
     buffer_.append(input2);
-    ASSERT_EQ(1u, buffer_.getData().size());
-    EXPECT_EQ(input, buffer_.getData().front());
+    const auto records = getRecords();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(input2, records.front());
 }
 
 }  // namespace wifi
@@ -19,9 +19,12 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <cutils/properties.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 
+#include <chrono>
+
 #include "aidl_return_util.h"
 #include "aidl_sync_util.h"
 #include "wifi_status_util.h"
@@ -33,6 +36,9 @@ using android::base::unique_fd;
 static constexpr int32_t kPrimaryChipId = 0;
 constexpr char kCpioMagic[] = "070701";
 constexpr char kTombstoneFolderPath[] = "/data/vendor/tombstones/wifi/";
+// Files are no longer added to the dump once archiving took this long, so
+// that a bugreport does not wait on a large tombstone folder.
+constexpr auto kMaxCpioArchiveDuration = std::chrono::seconds(10);
 
 // Helper function for |cpioArchiveFilesInDir|
 bool cpioWriteHeader(int out_fd, struct stat& st, const char* file_name, size_t file_name_len) {
@@ -65,31 +71,52 @@ bool cpioWriteHeader(int out_fd, struct stat& st, const char* file_name, size_t
     return true;
 }
 
+// Helper function for |cpioWriteFileContent|, used when |out_fd| does not
+// support sendfile(). Returns the number of bytes copied, or -1 on error.
+ssize_t cpioCopyFileChunk(int fd_read, int out_fd, off_t* offset, size_t len) {
+    std::array<char, 32 * 1024> read_buf;
+    ssize_t bytes_read =
+            pread(fd_read, read_buf.data(), std::min(len, read_buf.size()), *offset);
+    if (bytes_read <= 0) {
+        return bytes_read;
+    }
+    if (!::android::base::WriteFully(out_fd, read_buf.data(), bytes_read)) {
+        return -1;
+    }
+    *offset += bytes_read;
+    return bytes_read;
+}
+
 // Helper function for |cpioArchiveFilesInDir|
 size_t cpioWriteFileContent(int fd_read, int out_fd, struct stat& st) {
-    // writing content of file
-    std::array<char, 32 * 1024> read_buf;
-    ssize_t llen = st.st_size;
+    // writing content of file, from the page cache straight to |out_fd| when
+    // the kernel supports it
+    off_t offset = 0;
+    bool use_sendfile = true;
     size_t n_error = 0;
-    while (llen > 0) {
-        ssize_t bytes_read = read(fd_read, read_buf.data(), read_buf.size());
-        if (bytes_read == -1) {
-            PLOG(ERROR) << "Error reading file";
-            return ++n_error;
+    while (offset < st.st_size) {
+        const size_t len = st.st_size - offset;
+        ssize_t bytes_written;
+        if (use_sendfile) {
+            bytes_written = sendfile(out_fd, fd_read, &offset, len);
+            if (bytes_written == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                use_sendfile = false;
+                continue;
+            }
+        } else {
+            bytes_written = cpioCopyFileChunk(fd_read, out_fd, &offset, len);
         }
-        llen -= bytes_read;
-        if (write(out_fd, read_buf.data(), bytes_read) == -1) {
+        if (bytes_written == -1) {
             PLOG(ERROR) << "Error writing data to file";
             return ++n_error;
         }
-        if (bytes_read == 0) {  // this should never happen, but just in case
-                                // to unstuck from while loop
-            PLOG(ERROR) << "Unexpected read result";
+        if (bytes_written == 0) {  // the file was truncated after stat()
+            LOG(ERROR) << "Unexpected end of file";
             n_error++;
             break;
         }
     }
-    llen = st.st_size % 4;
+    ssize_t llen = st.st_size % 4;
     if (llen != 0) {
         const uint32_t zero = 0;
         if (write(out_fd, &zero, 4 - llen) == -1) {
@@ -124,10 +151,15 @@ size_t cpioArchiveFilesInDir(int out_fd, const char* input_dir) {
         PLOG(ERROR) << "Failed to open directory";
         return ++n_error;
     }
+    const auto deadline = std::chrono::steady_clock::now() + kMaxCpioArchiveDuration;
     while ((dp = readdir(dir_dump.get()))) {
         if (dp->d_type != DT_REG) {
             continue;
         }
+        if (std::chrono::steady_clock::now() > deadline) {
+            LOG(WARNING) << "Archiving took too long, skipping the remaining files";
+            break;
+        }
         std::string cur_file_name(dp->d_name);
         struct stat st;
         const std::string cur_file_path = kTombstoneFolderPath + cur_file_name;
@@ -21,9 +21,11 @@
 #include <cutils/properties.h>
 #include <fcntl.h>
 #include <hardware_legacy/wifi_hal.h>
+#include <limits.h>
 #include <net/if.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
+#include <sys/uio.h>
 
 #include "aidl_return_util.h"
 #include "aidl_struct_util.h"
@@ -244,10 +246,25 @@ WifiChip::WifiChip(int32_t chip_id, bool is_primary,
       modes_(feature_flags.lock()->getChipModes(is_primary)),
       debug_ring_buffer_cb_registered_(false),
       using_dynamic_iface_combination_(using_dynamic_iface_combination),
-      subsystemCallbackHandler_(handler) {
+      subsystemCallbackHandler_(handler),
+      ringbuffer_flush_requested_(0),
+      ringbuffer_flush_completed_(0),
+      ringbuffer_flush_result_(true),
+      ringbuffer_flush_stop_(false) {
     setActiveWlanIfaceNameProperty(kNoActiveWlanIfaceNamePropertyValue);
 }
 
+WifiChip::~WifiChip() {
+    {
+        std::unique_lock<std::mutex> lk(ringbuffer_flush_lock_);
+        ringbuffer_flush_stop_ = true;
+    }
+    ringbuffer_flush_cv_.notify_all();
+    if (ringbuffer_flush_thread_.joinable()) {
+        ringbuffer_flush_thread_.join();
+    }
+}
+
 void WifiChip::retrieveDynamicIfaceCombination() {
     if (using_dynamic_iface_combination_) return;
 
@@ -612,6 +629,7 @@ ndk::ScopedAStatus WifiChip::setVoipMode(const VoipMode in_mode) {
 }
 
 void WifiChip::invalidateAndRemoveAllIfaces() {
+    invalidateFeatureSetCache();
     invalidateAndClearBridgedApAll();
     invalidateAndClearAll(ap_ifaces_);
     invalidateAndClearAll(nan_ifaces_);
@@ -625,6 +643,13 @@ void WifiChip::invalidateAndRemoveAllIfaces() {
     rtt_controllers_.clear();
 }
 
+void WifiChip::invalidateFeatureSetCache() {
+    feature_set_cache_.clear();
+    for (const auto& iface : sta_ifaces_) {
+        iface->invalidateFeatureSetCache();
+    }
+}
+
 void WifiChip::invalidateAndRemoveDependencies(const std::string& removed_iface_name) {
     for (auto it = nan_ifaces_.begin(); it != nan_ifaces_.end();) {
         auto nan_iface = *it;
@@ -665,25 +690,23 @@ ndk::ScopedAStatus WifiChip::registerEventCallbackInternal(
 }
 
 std::pair<int32_t, ndk::ScopedAStatus> WifiChip::getFeatureSetInternal() {
+    const auto ifname = getFirstActiveWlanIfaceName();
+    const auto cached = feature_set_cache_.find(ifname);
+    if (cached != feature_set_cache_.end()) {
+        return {cached->second, ndk::ScopedAStatus::ok()};
+    }
     legacy_hal::wifi_error legacy_status;
     uint64_t legacy_feature_set;
-    uint32_t legacy_logger_feature_set;
-    const auto ifname = getFirstActiveWlanIfaceName();
     std::tie(legacy_status, legacy_feature_set) =
             legacy_hal_.lock()->getSupportedFeatureSet(ifname);
     if (legacy_status != legacy_hal::WIFI_SUCCESS) {
         return {0, createWifiStatusFromLegacyError(legacy_status)};
     }
-    std::tie(legacy_status, legacy_logger_feature_set) =
-            legacy_hal_.lock()->getLoggerSupportedFeatureSet(ifname);
-    if (legacy_status != legacy_hal::WIFI_SUCCESS) {
-        // some devices don't support querying logger feature set
-        legacy_logger_feature_set = 0;
-    }
     uint32_t aidl_feature_set;
     if (!aidl_struct_util::convertLegacyChipFeaturesToAidl(legacy_feature_set, &aidl_feature_set)) {
         return {0, createWifiStatus(WifiStatusCode::ERROR_UNKNOWN)};
     }
+    feature_set_cache_[ifname] = aidl_feature_set;
     return {aidl_feature_set, ndk::ScopedAStatus::ok()};
 }
 
@@ -720,7 +743,16 @@ ndk::ScopedAStatus WifiChip::configureChipInternal(
     LOG(INFO) << "Configured chip in mode " << mode_id;
     setActiveWlanIfaceNameProperty(getFirstActiveWlanIfaceName());
 
-    legacy_hal_.lock()->registerSubsystemRestartCallbackHandler(subsystemCallbackHandler_);
+    legacy_hal_.lock()->registerSubsystemRestartCallbackHandler(
+            [weak_ptr_this = weak_ptr_this_, handler = subsystemCallbackHandler_](
+                    const std::string& error) {
+                // The firmware may come back with other features.
+                const auto shared_ptr_this = weak_ptr_this.lock();
+                if (shared_ptr_this.get() && shared_ptr_this->isValid()) {
+                    shared_ptr_this->invalidateFeatureSetCache();
+                }
+                handler(error);
+            });
 
     return status;
 }
@@ -805,6 +837,7 @@ std::shared_ptr<WifiApIface> WifiChip::newWifiApIface(std::string& ifname) {
     std::shared_ptr<WifiApIface> iface =
             ndk::SharedRefBase::make<WifiApIface>(ifname, ap_instances, legacy_hal_, iface_util_);
     ap_ifaces_.push_back(iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceAdded(IfaceType::AP, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceAdded callback";
@@ -908,6 +941,7 @@ ndk::ScopedAStatus WifiChip::removeApIfaceInternal(const std::string& ifname) {
     invalidateAndRemoveDependencies(ifname);
     deleteApIface(ifname);
     invalidateAndClear(ap_ifaces_, iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceRemoved(IfaceType::AP, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceRemoved callback";
@@ -952,6 +986,7 @@ ndk::ScopedAStatus WifiChip::removeIfaceInstanceFromBridgedApIfaceInternal(
         }
     }
     iface->removeInstance(ifInstanceName);
+    invalidateFeatureSetCache();
     setActiveWlanIfaceNameProperty(getFirstActiveWlanIfaceName());
 
     return ndk::ScopedAStatus::ok();
@@ -972,6 +1007,7 @@ std::pair<std::shared_ptr<IWifiNanIface>, ndk::ScopedAStatus> WifiChip::createNa
     std::shared_ptr<WifiNanIface> iface =
             WifiNanIface::create(ifname, is_dedicated_iface, legacy_hal_, iface_util_);
     nan_ifaces_.push_back(iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceAdded(IfaceType::NAN_IFACE, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceAdded callback";
@@ -1002,6 +1038,7 @@ ndk::ScopedAStatus WifiChip::removeNanIfaceInternal(const std::string& ifname) {
         return createWifiStatus(WifiStatusCode::ERROR_INVALID_ARGS);
     }
     invalidateAndClear(nan_ifaces_, iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceRemoved(IfaceType::NAN_IFACE, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceAdded callback";
@@ -1018,6 +1055,7 @@ std::pair<std::shared_ptr<IWifiP2pIface>, ndk::ScopedAStatus> WifiChip::createP2
     std::shared_ptr<WifiP2pIface> iface =
             ndk::SharedRefBase::make<WifiP2pIface>(ifname, legacy_hal_);
     p2p_ifaces_.push_back(iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceAdded(IfaceType::P2P, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceAdded callback";
@@ -1048,6 +1086,7 @@ ndk::ScopedAStatus WifiChip::removeP2pIfaceInternal(const std::string& ifname) {
         return createWifiStatus(WifiStatusCode::ERROR_INVALID_ARGS);
     }
     invalidateAndClear(p2p_ifaces_, iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceRemoved(IfaceType::P2P, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceRemoved callback";
@@ -1070,6 +1109,7 @@ std::pair<std::shared_ptr<IWifiStaIface>, ndk::ScopedAStatus> WifiChip::createSt
     }
     std::shared_ptr<WifiStaIface> iface = WifiStaIface::create(ifname, legacy_hal_, iface_util_);
     sta_ifaces_.push_back(iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceAdded(IfaceType::STA, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceAdded callback";
@@ -1108,6 +1148,7 @@ ndk::ScopedAStatus WifiChip::removeStaIfaceInternal(const std::string& ifname) {
                    << legacyErrorToString(legacy_status);
     }
     invalidateAndClear(sta_ifaces_, iface);
+    invalidateFeatureSetCache();
     for (const auto& callback : event_cb_handler_.getCallbacks()) {
         if (!callback->onIfaceRemoved(IfaceType::STA, ifname).isOk()) {
             LOG(ERROR) << "Failed to invoke onIfaceRemoved callback";
@@ -1448,7 +1489,7 @@ ndk::ScopedAStatus WifiChip::registerDebugRingBufferCallback() {
 
     std::weak_ptr<WifiChip> weak_ptr_this = weak_ptr_this_;
     const auto& on_ring_buffer_data_callback =
-            [weak_ptr_this](const std::string& name, const std::vector<uint8_t>& data,
+            [weak_ptr_this](const std::string& name, const uint8_t* data, size_t size,
                             const legacy_hal::wifi_ring_buffer_status& status) {
                 const auto shared_ptr_this = weak_ptr_this.lock();
                 if (!shared_ptr_this.get() || !shared_ptr_this->isValid()) {
@@ -1467,7 +1508,7 @@ ndk::ScopedAStatus WifiChip::registerDebugRingBufferCallback() {
                     const auto& target = shared_ptr_this->ringbuffer_map_.find(name);
                     if (target != shared_ptr_this->ringbuffer_map_.end()) {
                         Ringbuffer& cur_buffer = target->second;
-                        appendstatus = cur_buffer.append(data);
+                        appendstatus = cur_buffer.append(data, size);
                     } else {
                         LOG(ERROR) << "Ringname " << name << " not found";
                         return;
@@ -1476,7 +1517,7 @@ ndk::ScopedAStatus WifiChip::registerDebugRingBufferCallback() {
                 }
                 if (appendstatus == Ringbuffer::AppendStatus::FAIL_RING_BUFFER_CORRUPTED) {
                     LOG(ERROR) << "Ringname " << name << " is corrupted. Clear the ring buffer";
-                    shared_ptr_this->writeRingbufferFilesInternal();
+                    shared_ptr_this->requestRingbufferFlush();
                     return;
                 }
             };
@@ -1801,41 +1842,104 @@ std::string WifiChip::allocateStaIfaceName() {
 }
 
 bool WifiChip::writeRingbufferFilesInternal() {
+    const uint64_t request = requestRingbufferFlush();
+    std::unique_lock<std::mutex> lk(ringbuffer_flush_lock_);
+    ringbuffer_flush_cv_.wait(lk, [&] { return ringbuffer_flush_completed_ >= request; });
+    return ringbuffer_flush_result_;
+}
+
+uint64_t WifiChip::requestRingbufferFlush() {
+    uint64_t request;
+    {
+        std::unique_lock<std::mutex> lk(ringbuffer_flush_lock_);
+        if (!ringbuffer_flush_thread_.joinable()) {
+            ringbuffer_flush_thread_ = std::thread(&WifiChip::runRingbufferFlushLoop, this);
+        }
+        request = ++ringbuffer_flush_requested_;
+    }
+    ringbuffer_flush_cv_.notify_all();
+    return request;
+}
+
+void WifiChip::runRingbufferFlushLoop() {
+    std::unique_lock<std::mutex> lk(ringbuffer_flush_lock_);
+    while (true) {
+        ringbuffer_flush_cv_.wait(lk, [this] {
+            return ringbuffer_flush_stop_ ||
+                   ringbuffer_flush_completed_ < ringbuffer_flush_requested_;
+        });
+        if (ringbuffer_flush_completed_ == ringbuffer_flush_requested_) {
+            return;
+        }
+        // Requests made while the files are written are served by the next
+        // iteration.
+        const uint64_t request = ringbuffer_flush_requested_;
+        lk.unlock();
+        const bool result = flushRingbuffersToFiles();
+        lk.lock();
+        ringbuffer_flush_completed_ = request;
+        ringbuffer_flush_result_ = result;
+        ringbuffer_flush_cv_.notify_all();
+    }
+}
+
+bool WifiChip::flushRingbuffersToFiles() {
     if (!removeOldFilesInternal()) {
         LOG(ERROR) << "Error occurred while deleting old tombstone files";
         return false;
     }
-    // write ringbuffers to file
+    // swap the ringbuffers with their spares
     {
         std::unique_lock<std::mutex> lk(lock_t);
         for (auto& item : ringbuffer_map_) {
-            Ringbuffer& cur_buffer = item.second;
-            if (cur_buffer.getData().empty()) {
+            if (item.second.empty()) {
                 continue;
             }
-            const std::string file_path_raw = kTombstoneFolderPath + item.first + "XXXXXXXXXX";
-            const int dump_fd = mkstemp(makeCharVec(file_path_raw).data());
-            if (dump_fd == -1) {
-                PLOG(ERROR) << "create file failed";
-                return false;
-            }
-            unique_fd file_auto_closer(dump_fd);
-            for (const auto& cur_block : cur_buffer.getData()) {
-                if (cur_block.size() <= 0 || cur_block.size() > kMaxBufferSizeBytes) {
-                    PLOG(ERROR) << "Ring buffer: " << item.first
-                                << " is corrupted. Invalid block size: " << cur_block.size();
-                    break;
-                }
-                if (write(dump_fd, cur_block.data(), sizeof(cur_block[0]) * cur_block.size()) ==
-                    -1) {
-                    PLOG(ERROR) << "Error writing to file";
-                }
+            auto spare = ringbuffer_flush_map_.find(item.first);
+            if (spare == ringbuffer_flush_map_.end()) {
+                spare = ringbuffer_flush_map_
+                                .emplace(item.first, Ringbuffer(kMaxBufferSizeBytes))
+                                .first;
             }
-            cur_buffer.clear();
+            std::swap(item.second, spare->second);
         }
         // unique_lock unlocked here
     }
-    return true;
+    // write the spares to file
+    bool success = true;
+    std::vector<iovec> iov;
+    for (auto& item : ringbuffer_flush_map_) {
+        Ringbuffer& cur_buffer = item.second;
+        if (cur_buffer.empty()) {
+            continue;
+        }
+        const std::string file_path_raw = kTombstoneFolderPath + item.first + "XXXXXXXXXX";
+        const int dump_fd = mkstemp(makeCharVec(file_path_raw).data());
+        if (dump_fd == -1) {
+            PLOG(ERROR) << "create file failed";
+            cur_buffer.clear();
+            success = false;
+            continue;
+        }
+        unique_fd file_auto_closer(dump_fd);
+        const auto write_iov = [dump_fd, &iov]() {
+            if (!iov.empty() && writev(dump_fd, iov.data(), iov.size()) == -1) {
+                PLOG(ERROR) << "Error writing to file";
+            }
+            iov.clear();
+        };
+        if (!cur_buffer.forEachRecord([&iov, &write_iov](const uint8_t* data, size_t size) {
+                iov.push_back({const_cast<uint8_t*>(data), size});
+                if (iov.size() == IOV_MAX) {
+                    write_iov();
+                }
+            })) {
+            LOG(ERROR) << "Ring buffer: " << item.first << " is corrupted";
+        }
+        write_iov();
+        cur_buffer.clear();
+    }
+    return success;
 }
 
 std::string WifiChip::getWlanIfaceNameWithType(IfaceType type, unsigned idx) {
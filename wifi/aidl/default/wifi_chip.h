@@ -22,9 +22,11 @@
 #include <aidl/android/hardware/wifi/common/OuiKeyedData.h>
 #include <android-base/macros.h>
 
+#include <condition_variable>
 #include <list>
 #include <map>
 #include <mutex>
+#include <thread>
 
 #include "aidl_callback_util.h"
 #include "ringbuffer.h"
@@ -56,6 +58,7 @@ class WifiChip : public BnWifiChip {
              const std::weak_ptr<feature_flags::WifiFeatureFlags> feature_flags,
              const std::function<void(const std::string&)>& subsystemCallbackHandler,
              bool using_dynamic_iface_combination);
+    ~WifiChip();
 
     // Factory method - use instead of default constructor.
     static std::shared_ptr<WifiChip> create(
@@ -162,6 +165,8 @@ class WifiChip : public BnWifiChip {
 
   private:
     void invalidateAndRemoveAllIfaces();
+    // Drops the cached feature sets of the chip and of its STA ifaces.
+    void invalidateFeatureSetCache();
     // When a STA iface is removed any dependent NAN-ifaces/RTT-controllers are
     // invalidated & removed.
     void invalidateAndRemoveDependencies(const std::string& removed_iface_name);
@@ -261,6 +266,9 @@ class WifiChip : public BnWifiChip {
     std::vector<std::string> allocateBridgedApInstanceNames();
     std::string allocateStaIfaceName();
     bool writeRingbufferFilesInternal();
+    uint64_t requestRingbufferFlush();
+    void runRingbufferFlushLoop();
+    bool flushRingbuffersToFiles();
     std::string getWlanIfaceNameWithType(IfaceType type, unsigned idx);
     void invalidateAndClearBridgedApAll();
     void deleteApIface(const std::string& if_name);
@@ -299,6 +307,22 @@ class WifiChip : public BnWifiChip {
 
     const std::function<void(const std::string&)> subsystemCallbackHandler_;
     std::map<std::string, std::vector<std::string>> br_ifaces_ap_instances_;
+    // Feature set of the chip, keyed by the first active wlan iface it was
+    // queried on. Cleared whenever an iface is added or removed, the chip
+    // mode changes or the subsystem restarts.
+    std::map<std::string, int32_t> feature_set_cache_;
+    // Ring buffer contents are written to files on |ringbuffer_flush_thread_|.
+    // It swaps each ring with its spare in |ringbuffer_flush_map_| under
+    // |lock_t| and writes the spares out without holding it, so the ring
+    // buffer data callback is never blocked on file I/O.
+    std::map<std::string, Ringbuffer> ringbuffer_flush_map_;
+    std::thread ringbuffer_flush_thread_;
+    std::mutex ringbuffer_flush_lock_;
+    std::condition_variable ringbuffer_flush_cv_;
+    uint64_t ringbuffer_flush_requested_;
+    uint64_t ringbuffer_flush_completed_;
+    bool ringbuffer_flush_result_;
+    bool ringbuffer_flush_stop_;
     DISALLOW_COPY_AND_ASSIGN(WifiChip);
 };
 
@@ -193,28 +193,34 @@ void invalidateRttResultsCallbacks() {
 };
 
 void onAsyncRttResults(wifi_request_id id, unsigned num_results, wifi_rtt_result* rtt_results[]) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    auto lock = aidl_sync_util::acquireRttCallbackLock();
     if (on_rtt_results_internal_callback) {
-        on_rtt_results_internal_callback(id, num_results, rtt_results);
+        const auto callback = std::move(on_rtt_results_internal_callback);
         invalidateRttResultsCallbacks();
+        lock.unlock();
+        callback(id, num_results, rtt_results);
     }
 }
 
 void onAsyncRttResultsV2(wifi_request_id id, unsigned num_results,
                          wifi_rtt_result_v2* rtt_results_v2[]) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    auto lock = aidl_sync_util::acquireRttCallbackLock();
     if (on_rtt_results_internal_callback_v2) {
-        on_rtt_results_internal_callback_v2(id, num_results, rtt_results_v2);
+        const auto callback = std::move(on_rtt_results_internal_callback_v2);
         invalidateRttResultsCallbacks();
+        lock.unlock();
+        callback(id, num_results, rtt_results_v2);
     }
 }
 
 void onAsyncRttResultsV3(wifi_request_id id, unsigned num_results,
                          wifi_rtt_result_v3* rtt_results_v3[]) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    auto lock = aidl_sync_util::acquireRttCallbackLock();
     if (on_rtt_results_internal_callback_v3) {
-        on_rtt_results_internal_callback_v3(id, num_results, rtt_results_v3);
+        const auto callback = std::move(on_rtt_results_internal_callback_v3);
         invalidateRttResultsCallbacks();
+        lock.unlock();
+        callback(id, num_results, rtt_results_v3);
     }
 }
 
@@ -224,7 +230,7 @@ void onAsyncRttResultsV3(wifi_request_id id, unsigned num_results,
 // So, handle all of them here directly to avoid adding an unnecessary layer.
 std::function<void(transaction_id, const NanResponseMsg&)> on_nan_notify_response_user_callback;
 void onAsyncNanNotifyResponse(transaction_id id, NanResponseMsg* msg) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_notify_response_user_callback && msg) {
         on_nan_notify_response_user_callback(id, *msg);
     }
@@ -237,7 +243,7 @@ void onAsyncNanEventPublishReplied(NanPublishRepliedInd* /* event */) {
 
 std::function<void(const NanPublishTerminatedInd&)> on_nan_event_publish_terminated_user_callback;
 void onAsyncNanEventPublishTerminated(NanPublishTerminatedInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_publish_terminated_user_callback && event) {
         on_nan_event_publish_terminated_user_callback(*event);
     }
@@ -245,7 +251,7 @@ void onAsyncNanEventPublishTerminated(NanPublishTerminatedInd* event) {
 
 std::function<void(const NanMatchInd&)> on_nan_event_match_user_callback;
 void onAsyncNanEventMatch(NanMatchInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_match_user_callback && event) {
         on_nan_event_match_user_callback(*event);
     }
@@ -253,7 +259,7 @@ void onAsyncNanEventMatch(NanMatchInd* event) {
 
 std::function<void(const NanMatchExpiredInd&)> on_nan_event_match_expired_user_callback;
 void onAsyncNanEventMatchExpired(NanMatchExpiredInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_match_expired_user_callback && event) {
         on_nan_event_match_expired_user_callback(*event);
     }
@@ -262,7 +268,7 @@ void onAsyncNanEventMatchExpired(NanMatchExpiredInd* event) {
 std::function<void(const NanSubscribeTerminatedInd&)>
         on_nan_event_subscribe_terminated_user_callback;
 void onAsyncNanEventSubscribeTerminated(NanSubscribeTerminatedInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_subscribe_terminated_user_callback && event) {
         on_nan_event_subscribe_terminated_user_callback(*event);
     }
@@ -270,7 +276,7 @@ void onAsyncNanEventSubscribeTerminated(NanSubscribeTerminatedInd* event) {
 
 std::function<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
 void onAsyncNanEventFollowup(NanFollowupInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_followup_user_callback && event) {
         on_nan_event_followup_user_callback(*event);
     }
@@ -278,7 +284,7 @@ void onAsyncNanEventFollowup(NanFollowupInd* event) {
 
 std::function<void(const NanDiscEngEventInd&)> on_nan_event_disc_eng_event_user_callback;
 void onAsyncNanEventDiscEngEvent(NanDiscEngEventInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_disc_eng_event_user_callback && event) {
         on_nan_event_disc_eng_event_user_callback(*event);
     }
@@ -286,7 +292,7 @@ void onAsyncNanEventDiscEngEvent(NanDiscEngEventInd* event) {
 
 std::function<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
 void onAsyncNanEventDisabled(NanDisabledInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_disabled_user_callback && event) {
         on_nan_event_disabled_user_callback(*event);
     }
@@ -294,7 +300,7 @@ void onAsyncNanEventDisabled(NanDisabledInd* event) {
 
 std::function<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
 void onAsyncNanEventTca(NanTCAInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_tca_user_callback && event) {
         on_nan_event_tca_user_callback(*event);
     }
@@ -302,7 +308,7 @@ void onAsyncNanEventTca(NanTCAInd* event) {
 
 std::function<void(const NanBeaconSdfPayloadInd&)> on_nan_event_beacon_sdf_payload_user_callback;
 void onAsyncNanEventBeaconSdfPayload(NanBeaconSdfPayloadInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_beacon_sdf_payload_user_callback && event) {
         on_nan_event_beacon_sdf_payload_user_callback(*event);
     }
@@ -310,14 +316,14 @@ void onAsyncNanEventBeaconSdfPayload(NanBeaconSdfPayloadInd* event) {
 
 std::function<void(const NanDataPathRequestInd&)> on_nan_event_data_path_request_user_callback;
 void onAsyncNanEventDataPathRequest(NanDataPathRequestInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_data_path_request_user_callback && event) {
         on_nan_event_data_path_request_user_callback(*event);
     }
 }
 std::function<void(const NanDataPathConfirmInd&)> on_nan_event_data_path_confirm_user_callback;
 void onAsyncNanEventDataPathConfirm(NanDataPathConfirmInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_data_path_confirm_user_callback && event) {
         on_nan_event_data_path_confirm_user_callback(*event);
     }
@@ -325,7 +331,7 @@ void onAsyncNanEventDataPathConfirm(NanDataPathConfirmInd* event) {
 
 std::function<void(const NanDataPathEndInd&)> on_nan_event_data_path_end_user_callback;
 void onAsyncNanEventDataPathEnd(NanDataPathEndInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_data_path_end_user_callback && event) {
         on_nan_event_data_path_end_user_callback(*event);
     }
@@ -333,7 +339,7 @@ void onAsyncNanEventDataPathEnd(NanDataPathEndInd* event) {
 
 std::function<void(const NanTransmitFollowupInd&)> on_nan_event_transmit_follow_up_user_callback;
 void onAsyncNanEventTransmitFollowUp(NanTransmitFollowupInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_transmit_follow_up_user_callback && event) {
         on_nan_event_transmit_follow_up_user_callback(*event);
     }
@@ -341,7 +347,7 @@ void onAsyncNanEventTransmitFollowUp(NanTransmitFollowupInd* event) {
 
 std::function<void(const NanRangeRequestInd&)> on_nan_event_range_request_user_callback;
 void onAsyncNanEventRangeRequest(NanRangeRequestInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_range_request_user_callback && event) {
         on_nan_event_range_request_user_callback(*event);
     }
@@ -349,7 +355,7 @@ void onAsyncNanEventRangeRequest(NanRangeRequestInd* event) {
 
 std::function<void(const NanRangeReportInd&)> on_nan_event_range_report_user_callback;
 void onAsyncNanEventRangeReport(NanRangeReportInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_range_report_user_callback && event) {
         on_nan_event_range_report_user_callback(*event);
     }
@@ -357,7 +363,7 @@ void onAsyncNanEventRangeReport(NanRangeReportInd* event) {
 
 std::function<void(const NanDataPathScheduleUpdateInd&)> on_nan_event_schedule_update_user_callback;
 void onAsyncNanEventScheduleUpdate(NanDataPathScheduleUpdateInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_schedule_update_user_callback && event) {
         on_nan_event_schedule_update_user_callback(*event);
     }
@@ -366,7 +372,7 @@ void onAsyncNanEventScheduleUpdate(NanDataPathScheduleUpdateInd* event) {
 std::function<void(const NanSuspensionModeChangeInd&)>
         on_nan_event_suspension_mode_change_user_callback;
 void onAsyncNanEventSuspensionModeChange(NanSuspensionModeChangeInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_suspension_mode_change_user_callback && event) {
         on_nan_event_suspension_mode_change_user_callback(*event);
     }
@@ -374,7 +380,7 @@ void onAsyncNanEventSuspensionModeChange(NanSuspensionModeChangeInd* event) {
 
 std::function<void(const NanPairingRequestInd&)> on_nan_event_pairing_request_user_callback;
 void onAsyncNanEventPairingRequest(NanPairingRequestInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_pairing_request_user_callback && event) {
         on_nan_event_pairing_request_user_callback(*event);
     }
@@ -382,7 +388,7 @@ void onAsyncNanEventPairingRequest(NanPairingRequestInd* event) {
 
 std::function<void(const NanPairingConfirmInd&)> on_nan_event_pairing_confirm_user_callback;
 void onAsyncNanEventPairingConfirm(NanPairingConfirmInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_pairing_confirm_user_callback && event) {
         on_nan_event_pairing_confirm_user_callback(*event);
     }
@@ -391,7 +397,7 @@ void onAsyncNanEventPairingConfirm(NanPairingConfirmInd* event) {
 std::function<void(const NanBootstrappingRequestInd&)>
         on_nan_event_bootstrapping_request_user_callback;
 void onAsyncNanEventBootstrappingRequest(NanBootstrappingRequestInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_bootstrapping_request_user_callback && event) {
         on_nan_event_bootstrapping_request_user_callback(*event);
     }
@@ -400,7 +406,7 @@ void onAsyncNanEventBootstrappingRequest(NanBootstrappingRequestInd* event) {
 std::function<void(const NanBootstrappingConfirmInd&)>
         on_nan_event_bootstrapping_confirm_user_callback;
 void onAsyncNanEventBootstrappingConfirm(NanBootstrappingConfirmInd* event) {
-    const auto lock = aidl_sync_util::acquireGlobalLock();
+    const auto lock = aidl_sync_util::acquireNanCallbackLock();
     if (on_nan_event_bootstrapping_confirm_user_callback && event) {
         on_nan_event_bootstrapping_confirm_user_callback(*event);
     }
@@ -570,6 +576,7 @@ wifi_error WifiLegacyHal::start() {
     }
 
     LOG(DEBUG) << "Starting legacy HAL";
+    chip_feature_set_.reset();
     status = global_func_table_.wifi_initialize(&global_handle_);
     if (status != WIFI_SUCCESS || !global_handle_) {
         LOG(ERROR) << "Failed to retrieve global handle";
@@ -679,8 +686,17 @@ std::pair<wifi_error, uint64_t> WifiLegacyHal::getSupportedFeatureSet(
                   "Some feature_flags can not be represented in output");
     wifi_interface_handle iface_handle = getIfaceHandle(iface_name);
 
-    global_func_table_.wifi_get_chip_feature_set(
-            global_handle_, &chip_set); /* ignore error, chip_set will stay 0 */
+    // The chip features do not change while the HAL is started, so they are
+    // only queried on first use.
+    if (chip_feature_set_) {
+        chip_set = *chip_feature_set_;
+    } else {
+        wifi_error chip_status = global_func_table_.wifi_get_chip_feature_set(
+                global_handle_, &chip_set); /* ignore error, chip_set will stay 0 */
+        if (chip_status == WIFI_SUCCESS || chip_status == WIFI_ERROR_NOT_SUPPORTED) {
+            chip_feature_set_ = chip_set;
+        }
+    }
 
     if (iface_handle) {
         status = global_func_table_.wifi_get_supported_feature_set(iface_handle, &set);
@@ -846,7 +862,7 @@ wifi_peer_info* WifiLegacyHal::copyPeerInfo(wifi_peer_info* peer_ptr,
     }
     peer.peer_info.num_rate = 0;
     // Push peer info.
-    peers.push_back(peer);
+    peers.push_back(std::move(peer));
     // Return the address of next peer info.
     return (wifi_peer_info*)((u8*)peer_ptr + sizeof(wifi_peer_info) +
                              (sizeof(wifi_rate_stat) * peer_ptr->num_rate));
@@ -857,13 +873,14 @@ wifi_link_stat* WifiLegacyHal::copyLinkStat(wifi_link_stat* stat_ptr,
     LinkStats linkStat;
     linkStat.stat = *stat_ptr;
     wifi_peer_info* l_peer_info_stats_ptr = stat_ptr->peer_info;
+    linkStat.peers.reserve(linkStat.stat.num_peers);
     for (uint32_t i = 0; i < linkStat.stat.num_peers; i++) {
         l_peer_info_stats_ptr = copyPeerInfo(l_peer_info_stats_ptr, linkStat.peers);
     }
     // Copied all peers to linkStat.peers.
     linkStat.stat.num_peers = 0;
     // Push link stat.
-    stats.push_back(linkStat);
+    stats.push_back(std::move(linkStat));
     // Read all peers, return the address of next wifi_link_stat.
     return (wifi_link_stat*)l_peer_info_stats_ptr;
 }
@@ -886,6 +903,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
         if (iface_stats_ptr != nullptr) {
             link_stats_ptr->iface = *iface_stats_ptr;
             l_peer_info_stats_ptr = iface_stats_ptr->peer_info;
+            link_stats_ptr->peers.reserve(iface_stats_ptr->num_peers);
             for (uint32_t i = 0; i < iface_stats_ptr->num_peers; i++) {
                 WifiPeerInfo peer;
                 peer.peer_info = *l_peer_info_stats_ptr;
@@ -896,7 +914,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
                             l_peer_info_stats_ptr->rate_stats + l_peer_info_stats_ptr->num_rate);
                 }
                 peer.peer_info.num_rate = 0;
-                link_stats_ptr->peers.push_back(peer);
+                link_stats_ptr->peers.push_back(std::move(peer));
                 l_peer_info_stats_ptr =
                         (wifi_peer_info*)((u8*)l_peer_info_stats_ptr + sizeof(wifi_peer_info) +
                                           (sizeof(wifi_rate_stat) *
@@ -911,6 +929,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
             return;
         }
         l_radio_stats_ptr = radio_stats_ptr;
+        link_stats_ptr->radios.reserve(num_radios);
         for (int i = 0; i < num_radios; i++) {
             LinkLayerRadioStats radio;
 
@@ -931,7 +950,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
                         l_radio_stats_ptr->channels,
                         l_radio_stats_ptr->channels + l_radio_stats_ptr->num_channels);
             }
-            link_stats_ptr->radios.push_back(radio);
+            link_stats_ptr->radios.push_back(std::move(radio));
             l_radio_stats_ptr =
                     (wifi_radio_stat*)((u8*)l_radio_stats_ptr + sizeof(wifi_radio_stat) +
                                        (sizeof(wifi_channel_stat) *
@@ -956,6 +975,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
                     //  - num_peers * peer_info[] to vector of links[i].peers.
                     link_ml_stats_ptr->iface = *iface_ml_stats_ptr;
                     l_link_stat_ptr = iface_ml_stats_ptr->links;
+                    link_ml_stats_ptr->links.reserve(iface_ml_stats_ptr->num_links);
                     for (int l = 0; l < iface_ml_stats_ptr->num_links; ++l) {
                         l_link_stat_ptr = copyLinkStat(l_link_stat_ptr, link_ml_stats_ptr->links);
                     }
@@ -967,6 +987,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
                     return;
                 }
                 l_radio_stats_ptr = radio_stats_ptr;
+                link_ml_stats_ptr->radios.reserve(num_radios);
                 for (int i = 0; i < num_radios; i++) {
                     LinkLayerRadioStats radio;
 
@@ -987,7 +1008,7 @@ wifi_error WifiLegacyHal::getLinkLayerStats(const std::string& iface_name,
                                 l_radio_stats_ptr->channels,
                                 l_radio_stats_ptr->channels + l_radio_stats_ptr->num_channels);
                     }
-                    link_ml_stats_ptr->radios.push_back(radio);
+                    link_ml_stats_ptr->radios.push_back(std::move(radio));
                     l_radio_stats_ptr =
                             (wifi_radio_stat*)((u8*)l_radio_stats_ptr + sizeof(wifi_radio_stat) +
                                                (sizeof(wifi_channel_stat) *
@@ -1204,10 +1225,9 @@ wifi_error WifiLegacyHal::registerRingBufferCallbackHandler(
     on_ring_buffer_data_internal_callback = [on_user_data_callback](
                                                     char* ring_name, char* buffer, int buffer_size,
                                                     wifi_ring_buffer_status* status) {
-        if (status && buffer) {
-            std::vector<uint8_t> buffer_vector(reinterpret_cast<uint8_t*>(buffer),
-                                               reinterpret_cast<uint8_t*>(buffer) + buffer_size);
-            on_user_data_callback(ring_name, buffer_vector, *status);
+        if (status && buffer && buffer_size >= 0) {
+            on_user_data_callback(ring_name, reinterpret_cast<const uint8_t*>(buffer), buffer_size,
+                                  *status);
         }
     };
     wifi_error status = global_func_table_.wifi_set_log_handler(0, getIfaceHandle(iface_name),
@@ -1338,6 +1358,7 @@ wifi_error WifiLegacyHal::startRttRangeRequestV3(
         const std::string& iface_name, wifi_request_id id,
         const std::vector<wifi_rtt_config_v3>& rtt_configs,
         const on_rtt_results_callback_v3& on_results_user_callback_v3) {
+    auto rtt_lock = aidl_sync_util::acquireRttCallbackLock();
     if (on_rtt_results_internal_callback_v3) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
@@ -1355,12 +1376,14 @@ wifi_error WifiLegacyHal::startRttRangeRequestV3(
                      [](wifi_rtt_result_v3* rtt_result_v3) { return rtt_result_v3 != nullptr; });
         on_results_user_callback_v3(id, rtt_results_vec_v3);
     };
+    rtt_lock.unlock();
 
     std::vector<wifi_rtt_config_v3> rtt_configs_internal(rtt_configs);
     wifi_error status = global_func_table_.wifi_rtt_range_request_v3(
             id, getIfaceHandle(iface_name), rtt_configs.size(), rtt_configs_internal.data(),
             {onAsyncRttResultsV3});
     if (status != WIFI_SUCCESS) {
+        rtt_lock.lock();
         invalidateRttResultsCallbacks();
     }
     return status;
@@ -1371,6 +1394,7 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
         const std::vector<wifi_rtt_config>& rtt_configs,
         const on_rtt_results_callback& on_results_user_callback,
         const on_rtt_results_callback_v2& on_results_user_callback_v2) {
+    auto rtt_lock = aidl_sync_util::acquireRttCallbackLock();
     if (on_rtt_results_internal_callback || on_rtt_results_internal_callback_v2) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
@@ -1401,12 +1425,14 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
                      [](wifi_rtt_result_v2* rtt_result_v2) { return rtt_result_v2 != nullptr; });
         on_results_user_callback_v2(id, rtt_results_vec_v2);
     };
+    rtt_lock.unlock();
 
     std::vector<wifi_rtt_config> rtt_configs_internal(rtt_configs);
     wifi_error status = global_func_table_.wifi_rtt_range_request(
             id, getIfaceHandle(iface_name), rtt_configs.size(), rtt_configs_internal.data(),
             {onAsyncRttResults, onAsyncRttResultsV2});
     if (status != WIFI_SUCCESS) {
+        rtt_lock.lock();
         invalidateRttResultsCallbacks();
     }
     return status;
@@ -1415,9 +1441,11 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
 wifi_error WifiLegacyHal::cancelRttRangeRequest(
         const std::string& iface_name, wifi_request_id id,
         const std::vector<std::array<uint8_t, ETH_ALEN>>& mac_addrs) {
+    auto rtt_lock = aidl_sync_util::acquireRttCallbackLock();
     if (!on_rtt_results_internal_callback && !on_rtt_results_internal_callback_v2) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
+    rtt_lock.unlock();
     static_assert(sizeof(mac_addr) == sizeof(std::array<uint8_t, ETH_ALEN>),
                   "MAC address size mismatch");
     // TODO: How do we handle partial cancels (i.e only a subset of enabled mac
@@ -1429,6 +1457,7 @@ wifi_error WifiLegacyHal::cancelRttRangeRequest(
     // If the request Id is wrong, don't stop the ongoing range request. Any
     // other error should be treated as the end of rtt ranging.
     if (status != WIFI_ERROR_INVALID_REQUEST_ID) {
+        rtt_lock.lock();
         invalidateRttResultsCallbacks();
     }
     return status;
@@ -1485,6 +1514,7 @@ wifi_error WifiLegacyHal::setRttLcr(const std::string& iface_name, wifi_request_
 
 wifi_error WifiLegacyHal::nanRegisterCallbackHandlers(const std::string& iface_name,
                                                       const NanCallbackHandlers& user_callbacks) {
+    auto nan_lock = aidl_sync_util::acquireNanCallbackLock();
     on_nan_notify_response_user_callback = user_callbacks.on_notify_response;
     on_nan_event_publish_terminated_user_callback = user_callbacks.on_event_publish_terminated;
     on_nan_event_match_user_callback = user_callbacks.on_event_match;
@@ -1510,6 +1540,7 @@ wifi_error WifiLegacyHal::nanRegisterCallbackHandlers(const std::string& iface_n
     on_nan_event_schedule_update_user_callback = user_callbacks.on_event_schedule_update;
     on_nan_event_suspension_mode_change_user_callback =
             user_callbacks.on_event_suspension_mode_change;
+    nan_lock.unlock();
 
     return global_func_table_.wifi_nan_register_handler(getIfaceHandle(iface_name),
                                                         {onAsyncNanNotifyResponse,
@@ -2130,28 +2161,34 @@ void WifiLegacyHal::invalidate() {
     on_error_alert_internal_callback = nullptr;
     on_radio_mode_change_internal_callback = nullptr;
     on_subsystem_restart_internal_callback = nullptr;
-    invalidateRttResultsCallbacks();
-    on_nan_notify_response_user_callback = nullptr;
-    on_nan_event_publish_terminated_user_callback = nullptr;
-    on_nan_event_match_user_callback = nullptr;
-    on_nan_event_match_expired_user_callback = nullptr;
-    on_nan_event_subscribe_terminated_user_callback = nullptr;
-    on_nan_event_followup_user_callback = nullptr;
-    on_nan_event_disc_eng_event_user_callback = nullptr;
-    on_nan_event_disabled_user_callback = nullptr;
-    on_nan_event_tca_user_callback = nullptr;
-    on_nan_event_beacon_sdf_payload_user_callback = nullptr;
-    on_nan_event_data_path_request_user_callback = nullptr;
-    on_nan_event_pairing_request_user_callback = nullptr;
-    on_nan_event_pairing_confirm_user_callback = nullptr;
-    on_nan_event_bootstrapping_request_user_callback = nullptr;
-    on_nan_event_bootstrapping_confirm_user_callback = nullptr;
-    on_nan_event_data_path_confirm_user_callback = nullptr;
-    on_nan_event_data_path_end_user_callback = nullptr;
-    on_nan_event_transmit_follow_up_user_callback = nullptr;
-    on_nan_event_range_request_user_callback = nullptr;
-    on_nan_event_range_report_user_callback = nullptr;
-    on_nan_event_schedule_update_user_callback = nullptr;
+    {
+        const auto rtt_lock = aidl_sync_util::acquireRttCallbackLock();
+        invalidateRttResultsCallbacks();
+    }
+    {
+        const auto nan_lock = aidl_sync_util::acquireNanCallbackLock();
+        on_nan_notify_response_user_callback = nullptr;
+        on_nan_event_publish_terminated_user_callback = nullptr;
+        on_nan_event_match_user_callback = nullptr;
+        on_nan_event_match_expired_user_callback = nullptr;
+        on_nan_event_subscribe_terminated_user_callback = nullptr;
+        on_nan_event_followup_user_callback = nullptr;
+        on_nan_event_disc_eng_event_user_callback = nullptr;
+        on_nan_event_disabled_user_callback = nullptr;
+        on_nan_event_tca_user_callback = nullptr;
+        on_nan_event_beacon_sdf_payload_user_callback = nullptr;
+        on_nan_event_data_path_request_user_callback = nullptr;
+        on_nan_event_pairing_request_user_callback = nullptr;
+        on_nan_event_pairing_confirm_user_callback = nullptr;
+        on_nan_event_bootstrapping_request_user_callback = nullptr;
+        on_nan_event_bootstrapping_confirm_user_callback = nullptr;
+        on_nan_event_data_path_confirm_user_callback = nullptr;
+        on_nan_event_data_path_end_user_callback = nullptr;
+        on_nan_event_transmit_follow_up_user_callback = nullptr;
+        on_nan_event_range_request_user_callback = nullptr;
+        on_nan_event_range_report_user_callback = nullptr;
+        on_nan_event_schedule_update_user_callback = nullptr;
+    }
     on_twt_event_setup_response_callback = nullptr;
     on_twt_event_teardown_completion_callback = nullptr;
     on_twt_event_info_frame_received_callback = nullptr;
@@ -24,6 +24,7 @@
 #include <functional>
 #include <map>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <vector>
 
@@ -511,7 +512,7 @@ using on_rtt_results_callback_v3 =
 
 // Callback for ring buffer data.
 using on_ring_buffer_data_callback = std::function<void(
-        const std::string&, const std::vector<uint8_t>&, const wifi_ring_buffer_status&)>;
+        const std::string&, const uint8_t*, size_t, const wifi_ring_buffer_status&)>;
 
 // Callback for alerts.
 using on_error_alert_callback = std::function<void(int32_t, const std::vector<uint8_t>&)>;
@@ -871,6 +872,8 @@ class WifiLegacyHal {
     std::condition_variable_any stop_wait_cv_;
     // Flag to indicate if the legacy HAL has been started.
     bool is_started_;
+    // Chip feature set, queried on first use after every start.
+    std::optional<feature_set> chip_feature_set_;
     std::weak_ptr<::android::wifi_system::InterfaceTool> iface_tool_;
     // Flag to indicate if this HAL is for the primary chip. This is used
     // in order to avoid some hard-coded behavior used with older HALs,
@@ -25,6 +25,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <future>
+
 #include "wifi_legacy_hal_stubs.h"
 
 namespace {
@@ -132,6 +134,7 @@ void WifiLegacyHalFactory::initVendorHalsDescriptorList() {
     std::string path;
     xmlChar* value;
     wifi_hal_lib_desc desc;
+    std::vector<std::pair<std::string, wifi_hal_lib_desc>> hal_libs;
 
     LOG(INFO) << "processing vendor HALs descriptions in " << kVendorHalsDescPath;
     DIR* dirPtr = ::opendir(kVendorHalsDescPath);
@@ -192,12 +195,7 @@ void WifiLegacyHalFactory::initVendorHalsDescriptorList() {
                        << ", skipping...";
             goto skip;
         }
-        if (loadVendorHalLib(path, desc)) {
-            if (desc.primary)
-                descs_.insert(descs_.begin(), desc);
-            else
-                descs_.push_back(desc);
-        }
+        hal_libs.emplace_back(path, desc);
     skip:
         xmlFreeDoc(xml);
         if (version) {
@@ -206,6 +204,22 @@ void WifiLegacyHalFactory::initVendorHalsDescriptorList() {
         }
     }
     ::closedir(dirPtr);
+
+    // dlopen() and the early initialization of a vendor HAL library can take
+    // a while, so all of them are probed in parallel.
+    std::vector<std::future<bool>> loaded;
+    for (auto& [lib_path, lib_desc] : hal_libs) {
+        loaded.push_back(std::async(std::launch::async, &WifiLegacyHalFactory::loadVendorHalLib,
+                                    this, std::cref(lib_path), std::ref(lib_desc)));
+    }
+    for (size_t i = 0; i < hal_libs.size(); i++) {
+        if (!loaded[i].get()) continue;
+        const wifi_hal_lib_desc& lib_desc = hal_libs[i].second;
+        if (lib_desc.primary)
+            descs_.insert(descs_.begin(), lib_desc);
+        else
+            descs_.push_back(lib_desc);
+    }
 }
 
 bool WifiLegacyHalFactory::loadVendorHalLib(const std::string& path, wifi_hal_lib_desc& desc) {
@@ -18,6 +18,8 @@
 
 #include <android-base/logging.h>
 
+#include <algorithm>
+
 #include "aidl_return_util.h"
 #include "aidl_struct_util.h"
 #include "wifi_status_util.h"
@@ -28,10 +30,19 @@ namespace hardware {
 namespace wifi {
 using aidl_return_util::validateAndCall;
 
+namespace {
+// Most firmware can not range more peers than this in one request.
+constexpr size_t kMaxRttPeersPerBurst = 10;
+}  // namespace
+
 WifiRttController::WifiRttController(const std::string& iface_name,
                                      const std::shared_ptr<IWifiStaIface>& bound_iface,
                                      const std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal)
-    : ifname_(iface_name), bound_iface_(bound_iface), legacy_hal_(legacy_hal), is_valid_(true) {}
+    : ifname_(iface_name),
+      bound_iface_(bound_iface),
+      legacy_hal_(legacy_hal),
+      is_valid_(true),
+      use_rtt_v3_(true) {}
 
 std::shared_ptr<WifiRttController> WifiRttController::create(
         const std::string& iface_name, const std::shared_ptr<IWifiStaIface>& bound_iface,
@@ -44,8 +55,18 @@ std::shared_ptr<WifiRttController> WifiRttController::create(
 }
 
 void WifiRttController::invalidate() {
-    legacy_hal_.reset();
-    event_callbacks_.clear();
+    {
+        // The ranging engine reads |legacy_hal_| from the RTT callbacks.
+        const std::lock_guard<std::mutex> lock(ranging_lock_);
+        legacy_hal_.reset();
+        pending_peers_.clear();
+        ranging_requests_.clear();
+        in_flight_burst_.reset();
+    }
+    {
+        const auto lock = aidl_sync_util::acquireRttCallbackLock();
+        event_callbacks_.clear();
+    }
     is_valid_ = false;
 };
 
@@ -59,6 +80,7 @@ void WifiRttController::setWeakPtr(std::weak_ptr<WifiRttController> ptr) {
 
 std::vector<std::shared_ptr<IWifiRttControllerEventCallback>>
 WifiRttController::getEventCallbacks() {
+    const auto lock = aidl_sync_util::acquireRttCallbackLock();
     return event_callbacks_;
 }
 
@@ -130,107 +152,266 @@ WifiRttController::getBoundIfaceInternal() {
 
 ndk::ScopedAStatus WifiRttController::registerEventCallbackInternal(
         const std::shared_ptr<IWifiRttControllerEventCallback>& callback) {
+    const auto lock = aidl_sync_util::acquireRttCallbackLock();
     event_callbacks_.emplace_back(callback);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus WifiRttController::rangeRequestInternal(
         int32_t cmd_id, const std::vector<RttConfig>& rtt_configs) {
-    // Try 11mc & 11az ranging (v3)
+    // Converted once for the 11mc & 11az ranging (v3) API. The 11mc fallback
+    // uses the embedded legacy configs.
     std::vector<legacy_hal::wifi_rtt_config_v3> legacy_configs_v3;
-    if (!aidl_struct_util::convertAidlVectorOfRttConfigToLegacyV3(rtt_configs,
+    if (rtt_configs.empty() ||
+        !aidl_struct_util::convertAidlVectorOfRttConfigToLegacyV3(rtt_configs,
                                                                   &legacy_configs_v3)) {
         return createWifiStatus(WifiStatusCode::ERROR_INVALID_ARGS);
     }
+    const std::lock_guard<std::mutex> lock(ranging_lock_);
+    if (ranging_requests_.count(cmd_id)) {
+        return createWifiStatus(WifiStatusCode::ERROR_BUSY);
+    }
+    ranging_requests_[cmd_id] = {legacy_configs_v3.size(), {}};
+    for (const auto& legacy_config_v3 : legacy_configs_v3) {
+        pending_peers_.push_back({cmd_id, legacy_config_v3});
+    }
+    if (in_flight_burst_) {
+        // Sent along with the queued peers once the burst in flight completes.
+        return ndk::ScopedAStatus::ok();
+    }
+    // Nothing else is queued while no burst is in flight, so a failure only
+    // drops this request.
+    legacy_hal::wifi_error legacy_status = startNextRangingBurstLocked(nullptr);
+    if (legacy_status != legacy_hal::WIFI_SUCCESS) {
+        pending_peers_.clear();
+        ranging_requests_.erase(cmd_id);
+    }
+    return createWifiStatusFromLegacyError(legacy_status);
+}
+
+ndk::ScopedAStatus WifiRttController::rangeCancelInternal(int32_t cmd_id,
+                                                          const std::vector<MacAddress>& addrs) {
+    std::vector<std::array<uint8_t, ETH_ALEN>> legacy_addrs;
+    for (const auto& addr : addrs) {
+        std::array<uint8_t, ETH_ALEN> addr_array;
+        std::copy_n(addr.data.begin(), ETH_ALEN, addr_array.begin());
+        legacy_addrs.push_back(addr_array);
+    }
+    const auto is_cancelled = [&legacy_addrs](const std::array<uint8_t, ETH_ALEN>& addr) {
+        return std::find(legacy_addrs.begin(), legacy_addrs.end(), addr) != legacy_addrs.end();
+    };
+    legacy_hal::wifi_request_id burst_id = cmd_id;
+    bool cancel_in_legacy_hal = true;
+    FinishedRangingRequests finished;
+    {
+        const std::lock_guard<std::mutex> lock(ranging_lock_);
+        const auto request = ranging_requests_.find(cmd_id);
+        if (request != ranging_requests_.end()) {
+            // Queued peers are dropped here, the legacy HAL only knows about
+            // the burst in flight.
+            const auto removed = std::remove_if(
+                    pending_peers_.begin(), pending_peers_.end(),
+                    [cmd_id, &is_cancelled](const RangingPeer& peer) {
+                        std::array<uint8_t, ETH_ALEN> addr;
+                        std::copy_n(peer.config.rtt_config.addr, ETH_ALEN, addr.begin());
+                        return peer.cmd_id == cmd_id && is_cancelled(addr);
+                    });
+            request->second.num_outstanding_peers -= std::distance(removed, pending_peers_.end());
+            pending_peers_.erase(removed, pending_peers_.end());
+
+            std::vector<std::array<uint8_t, ETH_ALEN>> in_flight_addrs;
+            if (in_flight_burst_) {
+                burst_id = in_flight_burst_->id;
+                for (const auto& [addr, peer_cmd_id] : in_flight_burst_->peers) {
+                    if (peer_cmd_id == cmd_id && is_cancelled(addr)) {
+                        in_flight_addrs.push_back(addr);
+                    }
+                }
+            }
+            legacy_addrs = std::move(in_flight_addrs);
+            cancel_in_legacy_hal = !legacy_addrs.empty();
+
+            if (request->second.num_outstanding_peers == 0) {
+                if (!request->second.results.empty()) {
+                    finished.emplace_back(cmd_id, std::move(request->second.results));
+                }
+                ranging_requests_.erase(request);
+            }
+        }
+    }
+    deliverRangingResults(finished);
+    if (!cancel_in_legacy_hal) {
+        return ndk::ScopedAStatus::ok();
+    }
+    legacy_hal::wifi_error legacy_status =
+            legacy_hal_.lock()->cancelRttRangeRequest(ifname_, burst_id, legacy_addrs);
+    return createWifiStatusFromLegacyError(legacy_status);
+}
+
+legacy_hal::wifi_error WifiRttController::startNextRangingBurstLocked(RangingBurst* failed_burst) {
+    RangingBurst burst;
+    std::vector<legacy_hal::wifi_rtt_config_v3> legacy_configs_v3;
+    while (!pending_peers_.empty() && burst.peers.size() < kMaxRttPeersPerBurst) {
+        const RangingPeer& peer = pending_peers_.front();
+        std::array<uint8_t, ETH_ALEN> addr;
+        std::copy_n(peer.config.rtt_config.addr, ETH_ALEN, addr.begin());
+        // Results are matched to their request by peer address, so a burst
+        // must not range the same peer twice.
+        if (std::any_of(burst.peers.begin(), burst.peers.end(),
+                        [&addr](const auto& burst_peer) { return burst_peer.first == addr; })) {
+            break;
+        }
+        burst.peers.emplace_back(addr, peer.cmd_id);
+        legacy_configs_v3.push_back(peer.config);
+        pending_peers_.pop_front();
+    }
+    burst.id = burst.peers.front().second;
+    burst.start_time = std::chrono::steady_clock::now();
+
     std::weak_ptr<WifiRttController> weak_ptr_this = weak_ptr_this_;
     const auto& on_results_callback_v3 =
-            [weak_ptr_this](legacy_hal::wifi_request_id id,
+            [weak_ptr_this](legacy_hal::wifi_request_id /* id */,
                             const std::vector<const legacy_hal::wifi_rtt_result_v3*>& results) {
                 const auto shared_ptr_this = weak_ptr_this.lock();
                 if (!shared_ptr_this.get() || !shared_ptr_this->isValid()) {
                     LOG(ERROR) << "v3 Callback invoked on an invalid object";
                     return;
                 }
+                const RangingBurst burst = shared_ptr_this->finishRangingBurstAndStartNext();
                 std::vector<RttResult> aidl_results;
                 if (!aidl_struct_util::convertLegacyVectorOfRttResultV3ToAidl(results,
                                                                               &aidl_results)) {
                     LOG(ERROR) << "Failed to convert rtt results v3 to AIDL structs";
-                    return;
-                }
-                for (const auto& callback : shared_ptr_this->getEventCallbacks()) {
-                    if (!callback->onResults(id, aidl_results).isOk()) {
-                        LOG(ERROR) << "Failed to invoke the v3 callback";
-                    }
+                    aidl_results.clear();
                 }
+                shared_ptr_this->onRangingBurstResults(burst, std::move(aidl_results));
             };
-    legacy_hal::wifi_error legacy_status = legacy_hal_.lock()->startRttRangeRequestV3(
-            ifname_, cmd_id, legacy_configs_v3, on_results_callback_v3);
-
-    if (legacy_status != legacy_hal::WIFI_ERROR_NOT_SUPPORTED) {
-        return createWifiStatusFromLegacyError(legacy_status);
-    }
-
-    // Fallback to 11mc ranging.
-    std::vector<legacy_hal::wifi_rtt_config> legacy_configs;
-    if (!aidl_struct_util::convertAidlVectorOfRttConfigToLegacy(rtt_configs, &legacy_configs)) {
-        return createWifiStatus(WifiStatusCode::ERROR_INVALID_ARGS);
-    }
     const auto& on_results_callback =
-            [weak_ptr_this](legacy_hal::wifi_request_id id,
+            [weak_ptr_this](legacy_hal::wifi_request_id /* id */,
                             const std::vector<const legacy_hal::wifi_rtt_result*>& results) {
                 const auto shared_ptr_this = weak_ptr_this.lock();
                 if (!shared_ptr_this.get() || !shared_ptr_this->isValid()) {
                     LOG(ERROR) << "Callback invoked on an invalid object";
                     return;
                 }
+                const RangingBurst burst = shared_ptr_this->finishRangingBurstAndStartNext();
                 std::vector<RttResult> aidl_results;
                 if (!aidl_struct_util::convertLegacyVectorOfRttResultToAidl(results,
                                                                             &aidl_results)) {
                     LOG(ERROR) << "Failed to convert rtt results to AIDL structs";
-                    return;
-                }
-                for (const auto& callback : shared_ptr_this->getEventCallbacks()) {
-                    if (!callback->onResults(id, aidl_results).isOk()) {
-                        LOG(ERROR) << "Failed to invoke the callback";
-                    }
+                    aidl_results.clear();
                 }
+                shared_ptr_this->onRangingBurstResults(burst, std::move(aidl_results));
             };
     const auto& on_results_callback_v2 =
-            [weak_ptr_this](legacy_hal::wifi_request_id id,
+            [weak_ptr_this](legacy_hal::wifi_request_id /* id */,
                             const std::vector<const legacy_hal::wifi_rtt_result_v2*>& results) {
                 const auto shared_ptr_this = weak_ptr_this.lock();
                 if (!shared_ptr_this.get() || !shared_ptr_this->isValid()) {
                     LOG(ERROR) << "v2 Callback invoked on an invalid object";
                     return;
                 }
+                const RangingBurst burst = shared_ptr_this->finishRangingBurstAndStartNext();
                 std::vector<RttResult> aidl_results;
                 if (!aidl_struct_util::convertLegacyVectorOfRttResultV2ToAidl(results,
                                                                               &aidl_results)) {
                     LOG(ERROR) << "Failed to convert rtt results v2 to AIDL structs";
-                    return;
-                }
-                for (const auto& callback : shared_ptr_this->getEventCallbacks()) {
-                    if (!callback->onResults(id, aidl_results).isOk()) {
-                        LOG(ERROR) << "Failed to invoke the v2 callback";
-                    }
+                    aidl_results.clear();
                 }
+                shared_ptr_this->onRangingBurstResults(burst, std::move(aidl_results));
             };
-    legacy_status = legacy_hal_.lock()->startRttRangeRequest(
-            ifname_, cmd_id, legacy_configs, on_results_callback, on_results_callback_v2);
-    return createWifiStatusFromLegacyError(legacy_status);
+
+    legacy_hal::wifi_error legacy_status = legacy_hal::WIFI_ERROR_NOT_AVAILABLE;
+    const auto legacy_hal = legacy_hal_.lock();
+    if (legacy_hal && use_rtt_v3_) {
+        // Try 11mc & 11az ranging (v3)
+        legacy_status = legacy_hal->startRttRangeRequestV3(ifname_, burst.id, legacy_configs_v3,
+                                                           on_results_callback_v3);
+        use_rtt_v3_ = legacy_status != legacy_hal::WIFI_ERROR_NOT_SUPPORTED;
+    }
+    if (legacy_hal && !use_rtt_v3_) {
+        // Fallback to 11mc ranging.
+        std::vector<legacy_hal::wifi_rtt_config> legacy_configs;
+        legacy_configs.reserve(legacy_configs_v3.size());
+        for (const auto& legacy_config_v3 : legacy_configs_v3) {
+            legacy_configs.push_back(legacy_config_v3.rtt_config);
+        }
+        legacy_status = legacy_hal->startRttRangeRequest(
+                ifname_, burst.id, legacy_configs, on_results_callback, on_results_callback_v2);
+    }
+    if (legacy_status == legacy_hal::WIFI_SUCCESS) {
+        in_flight_burst_ = std::move(burst);
+    } else if (failed_burst) {
+        *failed_burst = std::move(burst);
+    }
+    return legacy_status;
 }
 
-ndk::ScopedAStatus WifiRttController::rangeCancelInternal(int32_t cmd_id,
-                                                          const std::vector<MacAddress>& addrs) {
-    std::vector<std::array<uint8_t, ETH_ALEN>> legacy_addrs;
-    for (const auto& addr : addrs) {
-        std::array<uint8_t, ETH_ALEN> addr_array;
-        std::copy_n(addr.data.begin(), ETH_ALEN, addr_array.begin());
-        legacy_addrs.push_back(addr_array);
+WifiRttController::RangingBurst WifiRttController::finishRangingBurstAndStartNext() {
+    const std::lock_guard<std::mutex> lock(ranging_lock_);
+    if (!in_flight_burst_) {
+        return {};
+    }
+    RangingBurst burst = std::move(*in_flight_burst_);
+    in_flight_burst_.reset();
+    LOG(DEBUG) << "RTT burst " << burst.id << " of " << burst.peers.size() << " peers took "
+               << std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - burst.start_time)
+                          .count()
+               << " ms";
+    while (!pending_peers_.empty()) {
+        RangingBurst failed_burst;
+        legacy_hal::wifi_error legacy_status = startNextRangingBurstLocked(&failed_burst);
+        if (legacy_status == legacy_hal::WIFI_SUCCESS) {
+            break;
+        }
+        LOG(ERROR) << "Failed to start RTT burst: " << legacyErrorToString(legacy_status);
+        burst.peers.insert(burst.peers.end(), failed_burst.peers.begin(),
+                           failed_burst.peers.end());
+    }
+    return burst;
+}
+
+void WifiRttController::onRangingBurstResults(const RangingBurst& burst,
+                                              std::vector<RttResult> results) {
+    FinishedRangingRequests finished;
+    {
+        const std::lock_guard<std::mutex> lock(ranging_lock_);
+        for (auto& result : results) {
+            const auto peer = std::find_if(
+                    burst.peers.begin(), burst.peers.end(),
+                    [&result](const auto& burst_peer) { return burst_peer.first == result.addr; });
+            if (peer == burst.peers.end()) {
+                LOG(ERROR) << "Dropping RTT result of a peer not in the burst";
+                continue;
+            }
+            const auto request = ranging_requests_.find(peer->second);
+            if (request != ranging_requests_.end()) {
+                request->second.results.push_back(std::move(result));
+            }
+        }
+        for (const auto& [addr, cmd_id] : burst.peers) {
+            const auto request = ranging_requests_.find(cmd_id);
+            if (request == ranging_requests_.end()) {
+                continue;
+            }
+            if (--request->second.num_outstanding_peers == 0) {
+                finished.emplace_back(cmd_id, std::move(request->second.results));
+                ranging_requests_.erase(request);
+            }
+        }
+    }
+    deliverRangingResults(finished);
+}
+
+void WifiRttController::deliverRangingResults(const FinishedRangingRequests& finished) {
+    for (const auto& [cmd_id, results] : finished) {
+        for (const auto& callback : getEventCallbacks()) {
+            if (!callback->onResults(cmd_id, results).isOk()) {
+                LOG(ERROR) << "Failed to invoke the callback";
+            }
+        }
     }
-    legacy_hal::wifi_error legacy_status =
-            legacy_hal_.lock()->cancelRttRangeRequest(ifname_, cmd_id, legacy_addrs);
-    return createWifiStatusFromLegacyError(legacy_status);
 }
 
 std::pair<RttCapabilities, ndk::ScopedAStatus> WifiRttController::getCapabilitiesInternal() {
@@ -22,6 +22,13 @@
 #include <aidl/android/hardware/wifi/IWifiStaIface.h>
 #include <android-base/macros.h>
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+
 #include "wifi_legacy_hal.h"
 
 namespace aidl {
@@ -66,6 +73,24 @@ class WifiRttController : public BnWifiRttController {
     ndk::ScopedAStatus disableResponder(int32_t in_cmdId) override;
 
   private:
+    // A peer of a client ranging request, queued until it fits in a burst.
+    struct RangingPeer {
+        int32_t cmd_id;
+        legacy_hal::wifi_rtt_config_v3 config;
+    };
+    // Peers sent to the legacy HAL in one request, with their |cmd_id|.
+    struct RangingBurst {
+        legacy_hal::wifi_request_id id;
+        std::vector<std::pair<std::array<uint8_t, ETH_ALEN>, int32_t>> peers;
+        std::chrono::steady_clock::time_point start_time;
+    };
+    // Results of a client ranging request, collected across its bursts.
+    struct RangingRequest {
+        size_t num_outstanding_peers;
+        std::vector<RttResult> results;
+    };
+    using FinishedRangingRequests = std::vector<std::pair<int32_t, std::vector<RttResult>>>;
+
     // Corresponding worker functions for the AIDL methods.
     std::pair<std::shared_ptr<IWifiStaIface>, ndk::ScopedAStatus> getBoundIfaceInternal();
     ndk::ScopedAStatus registerEventCallbackInternal(
@@ -82,14 +107,36 @@ class WifiRttController : public BnWifiRttController {
                                                const RttResponder& info);
     ndk::ScopedAStatus disableResponderInternal(int32_t cmd_id);
 
+    // Ranging engine. Client requests are split into bursts of at most
+    // |kMaxRttPeersPerBurst| peers, and peers of concurrent requests share
+    // bursts. The next burst is sent as soon as the results of the previous
+    // one arrive, before they are converted.
+    // Sends the next burst of |pending_peers_|. |ranging_lock_| must be held
+    // and no burst may be in flight.
+    legacy_hal::wifi_error startNextRangingBurstLocked(RangingBurst* failed_burst);
+    // Returns the burst that completed, followed by the peers of any burst
+    // that could not be sent after it.
+    RangingBurst finishRangingBurstAndStartNext();
+    void onRangingBurstResults(const RangingBurst& burst, std::vector<RttResult> results);
+    void deliverRangingResults(const FinishedRangingRequests& finished);
+
     void setWeakPtr(std::weak_ptr<WifiRttController> ptr);
 
     std::string ifname_;
     std::shared_ptr<IWifiStaIface> bound_iface_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
+    // Guarded by the RTT callback lock.
     std::vector<std::shared_ptr<IWifiRttControllerEventCallback>> event_callbacks_;
     std::weak_ptr<WifiRttController> weak_ptr_this_;
-    bool is_valid_;
+    // Read by the RTT callbacks, which do not hold the global lock.
+    std::atomic<bool> is_valid_;
+    // Guards the ranging engine state below. Acquired before the RTT callback
+    // lock.
+    std::mutex ranging_lock_;
+    std::deque<RangingPeer> pending_peers_;
+    std::map<int32_t, RangingRequest> ranging_requests_;
+    std::optional<RangingBurst> in_flight_burst_;
+    bool use_rtt_v3_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiRttController);
 };
@@ -52,9 +52,15 @@ std::shared_ptr<WifiStaIface> WifiStaIface::create(
 void WifiStaIface::invalidate() {
     legacy_hal_.reset();
     event_cb_handler_.invalidate();
+    cached_scan_bss_table_.clear();
+    feature_set_.reset();
     is_valid_ = false;
 }
 
+void WifiStaIface::invalidateFeatureSetCache() {
+    feature_set_.reset();
+}
+
 void WifiStaIface::setWeakPtr(std::weak_ptr<WifiStaIface> ptr) {
     weak_ptr_this_ = ptr;
 }
@@ -275,6 +281,9 @@ ndk::ScopedAStatus WifiStaIface::registerEventCallbackInternal(
 }
 
 std::pair<int32_t, ndk::ScopedAStatus> WifiStaIface::getFeatureSetInternal() {
+    if (feature_set_.has_value()) {
+        return {*feature_set_, ndk::ScopedAStatus::ok()};
+    }
     legacy_hal::wifi_error legacy_status;
     uint64_t legacy_feature_set;
     std::tie(legacy_status, legacy_feature_set) =
@@ -287,6 +296,7 @@ std::pair<int32_t, ndk::ScopedAStatus> WifiStaIface::getFeatureSetInternal() {
                                                                &aidl_feature_set)) {
         return {0, createWifiStatus(WifiStatusCode::ERROR_UNKNOWN)};
     }
+    feature_set_ = aidl_feature_set;
     return {aidl_feature_set, ndk::ScopedAStatus::ok()};
 }
 
@@ -436,7 +446,7 @@ std::pair<StaLinkLayerStats, ndk::ScopedAStatus> WifiStaIface::getLinkLayerStats
         return {StaLinkLayerStats{}, createWifiStatus(WifiStatusCode::ERROR_UNKNOWN)};
     }
     aidl_struct_util::logAidlLinkLayerStatsSize(aidl_stats);
-    return {aidl_stats, ndk::ScopedAStatus::ok()};
+    return {std::move(aidl_stats), ndk::ScopedAStatus::ok()};
 }
 
 ndk::ScopedAStatus WifiStaIface::startRssiMonitoringInternal(int32_t cmd_id, int32_t max_rssi,
@@ -592,11 +602,12 @@ std::pair<CachedScanData, ndk::ScopedAStatus> WifiStaIface::getCachedScanDataInt
         return {CachedScanData{}, createWifiStatusFromLegacyError(legacy_status)};
     }
     CachedScanData aidl_scan_data;
-    if (!aidl_struct_util::convertCachedScanReportToAidl(cached_scan_report, &aidl_scan_data)) {
+    if (!aidl_struct_util::convertCachedScanReportToAidl(
+                cached_scan_report, &cached_scan_bss_table_, &aidl_scan_data)) {
         return {CachedScanData{}, createWifiStatus(WifiStatusCode::ERROR_UNKNOWN)};
     }
 
-    return {aidl_scan_data, ndk::ScopedAStatus::ok()};
+    return {std::move(aidl_scan_data), ndk::ScopedAStatus::ok()};
 }
 
 std::pair<TwtCapabilities, ndk::ScopedAStatus> WifiStaIface::twtGetCapabilitiesInternal() {
@@ -21,7 +21,10 @@
 #include <aidl/android/hardware/wifi/IWifiStaIfaceEventCallback.h>
 #include <android-base/macros.h>
 
+#include <optional>
+
 #include "aidl_callback_util.h"
+#include "aidl_struct_util.h"
 #include "wifi_iface_util.h"
 #include "wifi_legacy_hal.h"
 
@@ -47,6 +50,8 @@ class WifiStaIface : public BnWifiStaIface {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Refer to |WifiChip::invalidateFeatureSetCache()|.
+    void invalidateFeatureSetCache();
     std::set<std::shared_ptr<IWifiStaIfaceEventCallback>> getEventCallbacks();
     std::string getName();
 
@@ -157,6 +162,10 @@ class WifiStaIface : public BnWifiStaIface {
     std::weak_ptr<WifiStaIface> weak_ptr_this_;
     bool is_valid_;
     aidl_callback_util::AidlCallbackHandler<IWifiStaIfaceEventCallback> event_cb_handler_;
+    // BSSes of the last cached scan report, reused by |getCachedScanData|.
+    aidl_struct_util::CachedScanBssTable cached_scan_bss_table_;
+    // Result of the last successful |getFeatureSet|.
+    std::optional<int32_t> feature_set_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiStaIface);
 };